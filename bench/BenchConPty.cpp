@@ -0,0 +1,88 @@
+// Console3 - BenchConPty.cpp
+// End-to-end throughput through a real pseudo console
+
+#include "BenchConPty.h"
+
+#include <atomic>
+#include <chrono>
+
+namespace Console3::Bench {
+
+namespace {
+
+/// Longest wait for output before checking on the child again
+constexpr DWORD kPollMs = 10;
+
+/// Output settles this long after the child exits before the run ends
+/// (the pipe may still hold the child's last writes)
+constexpr auto kQuietTime = std::chrono::milliseconds(250);
+
+/// A child that runs longer than this is given up on
+constexpr auto kTimeout = std::chrono::minutes(10);
+
+} // namespace
+
+bool RunConPty(const Core::SessionConfig& config, ConPtyResult& result) {
+    using Clock = std::chrono::steady_clock;
+
+    Core::Session session;
+    std::atomic<bool> exited{false};
+    session.SetExitCallback([&exited](DWORD) {
+        exited.store(true, std::memory_order_release);
+    });
+
+    const Clock::time_point start = Clock::now();
+    if (!session.Start(config)) {
+        return false;
+    }
+
+    // Progress is anything read or parsed; the run ends at the last of it
+    uint64_t progress = 0;
+    Clock::time_point lastProgress = start;
+    bool finished = false;
+    while (Clock::now() - start < kTimeout) {
+        WaitForSingleObject(session.GetOutputEvent(), kPollMs);
+        session.ProcessOutput();
+
+        const Core::SessionStats stats = session.GetStats();
+        const Clock::time_point now = Clock::now();
+        if (stats.parseCalls != 0 && result.firstOutputSeconds == 0.0) {
+            result.firstOutputSeconds = std::chrono::duration<double>(now - start).count();
+        }
+        if (stats.bytesIn + stats.parseCalls != progress) {
+            progress = stats.bytesIn + stats.parseCalls;
+            lastProgress = now;
+        }
+        if (exited.load(std::memory_order_acquire) && stats.bufferedBytes == 0 &&
+            now - lastProgress >= kQuietTime) {
+            finished = true;
+            break;
+        }
+    }
+
+    const Core::SessionStats stats = session.GetStats();
+    result.bytes = stats.bytesIn;
+    result.seconds = std::chrono::duration<double>(lastProgress - start).count();
+    result.reads = stats.readCount;
+    result.stallMicros = stats.stallMicros;
+    result.parseMicros = stats.parseMicros;
+    result.exitCode = session.GetExitCode();
+
+    session.Stop();
+    return finished;
+}
+
+std::wstring GetGeneratorPath() {
+    wchar_t path[MAX_PATH];
+    const DWORD length = GetModuleFileNameW(nullptr, path, MAX_PATH);
+    if (length == 0 || length == MAX_PATH) {
+        return L"Console3BenchGen.exe";
+    }
+
+    std::wstring result(path, length);
+    const size_t slash = result.find_last_of(L"\\/");
+    result.resize(slash == std::wstring::npos ? 0 : slash + 1);
+    return result + L"Console3BenchGen.exe";
+}
+
+} // namespace Console3::Bench
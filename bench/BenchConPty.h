@@ -0,0 +1,41 @@
+#pragma once
+// Console3 - BenchConPty.h
+// End-to-end throughput through a real pseudo console
+//
+// The detached runs of Console3Bench time the parser alone. This harness
+// starts a real ConPTY child through Session::Start - `cmd /c type` of a
+// corpus file, or Console3BenchGen writing a corpus to its stdout - and
+// drives ProcessOutput() as fast as output arrives, with nothing rendered.
+// The time reported runs from Start() to the last output that reached the
+// screen, so the transport, conhost, the output ring, backpressure and the
+// parser all count. Comparing transports or watermark settings on one
+// machine gives comparable numbers; comparing machines does not.
+
+#include "Core/Session.h"
+
+#include <cstdint>
+#include <string>
+
+namespace Console3::Bench {
+
+/// Result of one pseudo console run
+struct ConPtyResult {
+    uint64_t bytes = 0;         ///< Bytes read from the pseudo console
+    double seconds = 0.0;       ///< Start to the last output on screen
+    double firstOutputSeconds = 0.0; ///< Start to the first output on screen (0 = none)
+    uint64_t reads = 0;         ///< Reads the transport completed
+    uint64_t stallMicros = 0;   ///< Reader time throttled by backpressure
+    uint64_t parseMicros = 0;   ///< Time in the parser and buffer sync
+    DWORD exitCode = 0;
+};
+
+/// Run a command in a pseudo console until it exits and its output is on screen
+/// @param config Session settings; shell and args are the command
+/// @param result Receives the measurements
+/// @return False if the session did not start or the child never exited
+[[nodiscard]] bool RunConPty(const Core::SessionConfig& config, ConPtyResult& result);
+
+/// Get the path of Console3BenchGen, next to the running executable
+[[nodiscard]] std::wstring GetGeneratorPath();
+
+} // namespace Console3::Bench
@@ -0,0 +1,386 @@
+// Console3 - BenchCorpus.cpp
+// Synthetic VT output corpora for the throughput benchmark
+
+#include "BenchCorpus.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <random>
+
+namespace Console3::Bench {
+
+namespace {
+
+constexpr std::array<CorpusInfo, 6> kCorpora = {{
+    {"ascii-log", "Plain ASCII log lines (build output, server logs)"},
+    {"sgr-color", "SGR-heavy listings: ls --color, ripgrep matches, 256-color and truecolor"},
+    {"cjk-emoji", "UTF-8 CJK, Hangul, emoji, ZWJ sequences and combining marks"},
+    {"fullscreen", "vim/htop style full-screen redraws on the alternate screen"},
+    {"cursor-storm", "Cursor addressing storms: CUP, relative moves, save/restore"},
+    {"scroll-region", "Scroll regions: DECSTBM, IND/RI, SU/SD and line insert/delete (tmux, less)"},
+}};
+
+/// Deterministic generator state shared by the corpus builders
+class Generator {
+public:
+    explicit Generator(uint32_t seed) : m_rng(seed) {}
+
+    /// Uniform integer in [lo, hi]
+    int Next(int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(m_rng); }
+
+    /// Pick one element of a list
+    template <typename T, size_t N>
+    const T& Pick(const std::array<T, N>& items) { return items[Next(0, static_cast<int>(N) - 1)]; }
+
+    /// Random lowercase word
+    void Word(std::string& out, int minLen, int maxLen) {
+        const int len = Next(minLen, maxLen);
+        for (int i = 0; i < len; ++i) {
+            out += static_cast<char>('a' + Next(0, 25));
+        }
+    }
+
+private:
+    std::mt19937 m_rng;
+};
+
+void Csi(std::string& out, int a, char command) {
+    out += "\x1b[";
+    out += std::to_string(a);
+    out += command;
+}
+
+void Csi(std::string& out, int a, int b, char command) {
+    out += "\x1b[";
+    out += std::to_string(a);
+    out += ';';
+    out += std::to_string(b);
+    out += command;
+}
+
+void Sgr256(std::string& out, int color) {
+    out += "\x1b[38;5;";
+    out += std::to_string(color);
+    out += 'm';
+}
+
+// ============================================================================
+// Corpus builders
+// ============================================================================
+
+void BuildAsciiLog(Generator& gen, std::string& out, size_t bytes) {
+    static constexpr std::array<const char*, 4> levels = {"INFO ", "DEBUG", "WARN ", "ERROR"};
+    static constexpr std::array<const char*, 5> verbs = {"GET", "POST", "PUT", "DELETE", "PATCH"};
+
+    for (int line = 0; out.size() < bytes; ++line) {
+        out += "2026-03-14T09:";
+        out += std::to_string(10 + (line / 6000) % 50);
+        out += ':';
+        out += std::to_string(10 + (line / 100) % 50);
+        out += '.';
+        out += std::to_string(100 + line % 900);
+        out += "Z ";
+        out += gen.Pick(levels);
+        out += " [worker-";
+        out += std::to_string(gen.Next(0, 15));
+        out += "] ";
+        out += gen.Pick(verbs);
+        out += " /api/v1/";
+        gen.Word(out, 4, 10);
+        out += '/';
+        out += std::to_string(gen.Next(1, 99999));
+        out += " status=";
+        out += std::to_string(gen.Next(0, 9) == 0 ? 500 : 200);
+        out += " ms=";
+        out += std::to_string(gen.Next(1, 900));
+        out += " msg=\"";
+        for (int words = gen.Next(2, 12); words > 0; --words) {
+            gen.Word(out, 2, 9);
+            out += ' ';
+        }
+        out += "\"\r\n";
+    }
+}
+
+void BuildSgrColor(Generator& gen, std::string& out, size_t bytes, int cols) {
+    static constexpr std::array<const char*, 6> lsColors = {
+        "\x1b[01;34m", "\x1b[01;32m", "\x1b[01;36m", "\x1b[00m", "\x1b[40;33;01m", "\x1b[01;35m"};
+    static constexpr std::array<const char*, 4> exts = {".cpp", ".h", ".txt", ".json"};
+
+    while (out.size() < bytes) {
+        switch (gen.Next(0, 2)) {
+        case 0: {
+            // ls --color: one row of colored names
+            int used = 0;
+            while (used < cols - 20) {
+                out += gen.Pick(lsColors);
+                const size_t start = out.size();
+                gen.Word(out, 3, 14);
+                out += gen.Pick(exts);
+                used += static_cast<int>(out.size() - start) + 2;
+                out += "\x1b[0m  ";
+            }
+            out += "\r\n";
+            break;
+        }
+        case 1: {
+            // ripgrep: path, line number, highlighted match
+            out += "\x1b[0m\x1b[35msrc/";
+            gen.Word(out, 4, 10);
+            out += '/';
+            gen.Word(out, 4, 12);
+            out += gen.Pick(exts);
+            out += "\x1b[0m:\x1b[32m";
+            out += std::to_string(gen.Next(1, 4000));
+            out += "\x1b[0m:    ";
+            gen.Word(out, 3, 8);
+            out += " = \x1b[0m\x1b[1m\x1b[31m";
+            gen.Word(out, 4, 10);
+            out += "\x1b[0m(";
+            gen.Word(out, 2, 6);
+            out += ");\r\n";
+            break;
+        }
+        default:
+            // Syntax highlighter: 256-color and truecolor runs
+            for (int tokens = gen.Next(4, 12); tokens > 0; --tokens) {
+                if (gen.Next(0, 1) == 0) {
+                    Sgr256(out, gen.Next(16, 231));
+                } else {
+                    out += "\x1b[38;2;";
+                    out += std::to_string(gen.Next(0, 255));
+                    out += ';';
+                    out += std::to_string(gen.Next(0, 255));
+                    out += ';';
+                    out += std::to_string(gen.Next(0, 255));
+                    out += 'm';
+                }
+                gen.Word(out, 1, 10);
+                out += ' ';
+            }
+            out += "\x1b[0m\r\n";
+            break;
+        }
+    }
+}
+
+void BuildCjkEmoji(Generator& gen, std::string& out, size_t bytes) {
+    static constexpr std::array<const char*, 12> pieces = {
+        "\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e",                     // 日本語
+        "\xe4\xb8\xad\xe6\x96\x87\xe5\xad\x97\xe7\xac\xa6",         // 中文字符
+        "\xed\x95\x9c\xea\xb5\xad\xec\x96\xb4",                     // 한국어
+        "\xe3\x83\x86\xe3\x82\xb9\xe3\x83\x88",                     // テスト
+        "\xf0\x9f\x98\x80",                                         // 😀
+        "\xf0\x9f\x9a\x80",                                         // 🚀
+        "\xe2\x9c\xa8",                                             // ✨
+        "\xf0\x9f\x91\xa8\xe2\x80\x8d\xf0\x9f\x91\xa9\xe2\x80\x8d\xf0\x9f\x91\xa7", // family (ZWJ)
+        "e\xcc\x81",                                                // e + combining acute
+        "n\xcc\x83",                                                // n + combining tilde
+        "\xc3\xa9t\xc3\xa9",                                        // été
+        "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82",         // Привет
+    };
+
+    while (out.size() < bytes) {
+        for (int words = gen.Next(3, 14); words > 0; --words) {
+            if (gen.Next(0, 3) == 0) {
+                gen.Word(out, 2, 7);
+            } else {
+                out += gen.Pick(pieces);
+            }
+            out += ' ';
+        }
+        out += "\r\n";
+    }
+}
+
+/// htop: meters, then a process table, every row but the last redrawn
+void AppendHtopScreen(Generator& gen, std::string& out, int rows, int cols) {
+    out += "\x1b[H";
+    for (int row = 1; row <= rows - 1; ++row) {
+        Csi(out, row, 1, 'H');
+        if (row <= 4) {
+            out += "\x1b[36m";
+            out += std::to_string(row - 1);
+            out += "\x1b[0m[\x1b[32m";
+            const int bar = gen.Next(0, std::max(1, cols / 2 - 10));
+            out.append(bar, '|');
+            out += "\x1b[0m";
+            out.append(cols / 2 - 10 - bar, ' ');
+            out += std::to_string(gen.Next(0, 99));
+            out += ".";
+            out += std::to_string(gen.Next(0, 9));
+            out += "%]";
+        } else {
+            if (row == 6) out += "\x1b[30;42m";
+            out += std::to_string(gen.Next(100, 99999));
+            out += " root      20   0 ";
+            out += std::to_string(gen.Next(1000, 999999));
+            out += " \x1b[1m";
+            out += std::to_string(gen.Next(0, 99));
+            out += ".0\x1b[22m  ";
+            gen.Word(out, 4, 16);
+            if (row == 6) out += "\x1b[0m";
+        }
+        out += "\x1b[K";
+    }
+}
+
+/// Status line in reverse video on the last row
+void AppendStatusLine(Generator& gen, std::string& out, int rows) {
+    Csi(out, rows, 1, 'H');
+    out += "\x1b[7m ";
+    gen.Word(out, 4, 12);
+    out += ".cpp [+]   ";
+    out += std::to_string(gen.Next(1, 9999));
+    out += ',';
+    out += std::to_string(gen.Next(1, 120));
+    out += "\x1b[K\x1b[0m";
+}
+
+void BuildFullscreen(Generator& gen, std::string& out, size_t bytes, int rows, int cols) {
+    out += "\x1b[?1049h\x1b[?25l";
+
+    for (int frame = 0; out.size() < bytes; ++frame) {
+        if (frame % 2 == 0) {
+            AppendHtopScreen(gen, out, rows, cols);
+        } else {
+            // vim: scroll the text area inside a region, redraw a few lines
+            Csi(out, 1, rows - 2, 'r');
+            Csi(out, rows - 2, 1, 'H');
+            for (int lines = gen.Next(1, 5); lines > 0; --lines) {
+                out += "\n\x1b[33m";
+                out += std::to_string(gen.Next(1, 9999));
+                out += "\x1b[0m  ";
+                Sgr256(out, gen.Next(16, 231));
+                gen.Word(out, 2, 12);
+                out += "\x1b[0m(";
+                gen.Word(out, 1, 30);
+                out += ");\x1b[K";
+            }
+            out += "\x1b[r";
+        }
+        AppendStatusLine(gen, out, rows);
+    }
+
+    out += "\x1b[?25h\x1b[?1049l";
+}
+
+void BuildCursorStorm(Generator& gen, std::string& out, size_t bytes, int rows, int cols) {
+    while (out.size() < bytes) {
+        switch (gen.Next(0, 5)) {
+        case 0:
+        case 1:
+            Csi(out, gen.Next(1, rows), gen.Next(1, cols), 'H');
+            break;
+        case 2:
+            Csi(out, gen.Next(1, 10), "ABCD"[gen.Next(0, 3)]);
+            break;
+        case 3:
+            out += gen.Next(0, 1) == 0 ? "\x1b" "7" : "\x1b" "8";
+            break;
+        case 4:
+            Sgr256(out, gen.Next(0, 255));
+            break;
+        default:
+            Csi(out, gen.Next(1, cols), 'G');
+            break;
+        }
+        out += static_cast<char>('!' + gen.Next(0, 93));
+    }
+    out += "\x1b[0m";
+}
+
+void BuildScrollRegion(Generator& gen, std::string& out, size_t bytes, int rows, int cols) {
+    while (out.size() < bytes) {
+        // A region below the first row, so nothing reaches the scrollback
+        const int top = gen.Next(2, rows / 2);
+        const int bottom = gen.Next(top + 2, rows - 1);
+        Csi(out, top, bottom, 'r');
+
+        for (int ops = gen.Next(4, 16); ops > 0; --ops) {
+            switch (gen.Next(0, 5)) {
+            case 0:
+                // less: a line enters at the bottom (IND)
+                Csi(out, bottom, 1, 'H');
+                out += "\x1b" "D";
+                gen.Word(out, 2, std::min(cols - 1, 60));
+                break;
+            case 1:
+                // Scrolling back: a line enters at the top (RI)
+                Csi(out, top, 1, 'H');
+                out += "\x1b" "M";
+                gen.Word(out, 2, std::min(cols - 1, 60));
+                break;
+            case 2:
+                Csi(out, gen.Next(1, 4), gen.Next(0, 1) == 0 ? 'S' : 'T');
+                break;
+            case 3:
+                // tmux pane: insert or delete lines mid-region
+                Csi(out, gen.Next(top, bottom), 1, 'H');
+                Csi(out, gen.Next(1, 3), gen.Next(0, 1) == 0 ? 'L' : 'M');
+                break;
+            case 4:
+                Csi(out, gen.Next(top, bottom), 1, 'H');
+                Sgr256(out, gen.Next(16, 231));
+                gen.Word(out, 4, std::min(cols - 1, 40));
+                out += "\x1b[0m\x1b[K";
+                break;
+            default:
+                Csi(out, gen.Next(top, bottom), 1, 'H');
+                out += "\r\n";
+                break;
+            }
+        }
+    }
+    out += "\x1b[r\x1b[0m";
+}
+
+} // namespace
+
+std::span<const CorpusInfo> GetCorpora() noexcept {
+    return kCorpora;
+}
+
+std::optional<std::string> GenerateCorpus(std::string_view name, int rows, int cols, size_t bytes) {
+    rows = std::max(rows, 8);
+    cols = std::max(cols, 40);
+
+    std::string out;
+    out.reserve(bytes + 4096);
+    Generator gen(0xC0503u);
+
+    if (name == "ascii-log") {
+        BuildAsciiLog(gen, out, bytes);
+    } else if (name == "sgr-color") {
+        BuildSgrColor(gen, out, bytes, cols);
+    } else if (name == "cjk-emoji") {
+        BuildCjkEmoji(gen, out, bytes);
+    } else if (name == "fullscreen") {
+        BuildFullscreen(gen, out, bytes, rows, cols);
+    } else if (name == "cursor-storm") {
+        BuildCursorStorm(gen, out, bytes, rows, cols);
+    } else if (name == "scroll-region") {
+        BuildScrollRegion(gen, out, bytes, rows, cols);
+    } else {
+        return std::nullopt;
+    }
+    return out;
+}
+
+std::vector<std::string> GenerateFrames(int rows, int cols, size_t count) {
+    rows = std::max(rows, 8);
+    cols = std::max(cols, 40);
+
+    std::vector<std::string> frames;
+    frames.reserve(count);
+    Generator gen(0xF4A3Eu);
+    for (size_t i = 0; i < count; ++i) {
+        std::string frame;
+        AppendHtopScreen(gen, frame, rows, cols);
+        AppendStatusLine(gen, frame, rows);
+        frames.push_back(std::move(frame));
+    }
+    return frames;
+}
+
+} // namespace Console3::Bench
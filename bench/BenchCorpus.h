@@ -0,0 +1,42 @@
+#pragma once
+// Console3 - BenchCorpus.h
+// Synthetic VT output corpora for the throughput benchmark
+//
+// Each corpus imitates one kind of real terminal traffic closely enough to
+// exercise the same parser and buffer paths: plain logs, SGR-heavy listings,
+// wide and combining text, full-screen redraws and cursor addressing. The
+// generators are seeded, so every run replays exactly the same bytes.
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Console3::Bench {
+
+/// Built-in corpus description
+struct CorpusInfo {
+    const char* name;           ///< Name used on the command line
+    const char* description;    ///< One-line summary for --list
+};
+
+/// Get the built-in corpora, in report order
+[[nodiscard]] std::span<const CorpusInfo> GetCorpora() noexcept;
+
+/// Generate a built-in corpus
+/// @param name Corpus name (see GetCorpora())
+/// @param rows Screen height the output is laid out for
+/// @param cols Screen width the output is laid out for
+/// @param bytes Approximate size to generate
+/// @return Generated output, or nullopt if the name is unknown
+[[nodiscard]] std::optional<std::string> GenerateCorpus(std::string_view name, int rows, int cols,
+                                                        size_t bytes);
+
+/// Generate full-screen repaints, each redrawing every row of the screen
+/// (for output paced in frames; enter the alternate screen first)
+/// @param count Distinct frames to generate
+[[nodiscard]] std::vector<std::string> GenerateFrames(int rows, int cols, size_t count);
+
+} // namespace Console3::Bench
@@ -0,0 +1,227 @@
+// Console3 - BenchDiff.cpp
+// Differential check of the optimized emulation paths against the reference
+
+#include "BenchDiff.h"
+#include "Core/TerminalBuffer.h"
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace Console3::Bench {
+
+using namespace std::string_view_literals;
+
+namespace {
+
+constexpr EmulationPath kReference = {"reference", Emulation::EmulationBackend::Screen,
+                                      Emulation::DamageMerge::Cell, false};
+
+constexpr std::array<EmulationPath, 4> kOptimized = {{
+    {"scroll-merge", Emulation::EmulationBackend::Screen, Emulation::DamageMerge::Scroll, false},
+    {"front-parser", Emulation::EmulationBackend::Screen, Emulation::DamageMerge::Scroll, true},
+    {"grid", Emulation::EmulationBackend::Grid, Emulation::DamageMerge::Scroll, false},
+    {"grid+front", Emulation::EmulationBackend::Grid, Emulation::DamageMerge::Scroll, true},
+}};
+
+/// Reads compared between full comparisons
+constexpr unsigned kCompareEvery = 64;
+
+/// Tokens for generated streams: the fast-path subset, the sequences around
+/// it, and the partial and malformed forms a fuzzer should try
+constexpr std::array kTokens = {
+    "\r\n"sv, "\r"sv, "\n"sv, "\b"sv, "\t"sv, "\a"sv, "\x1b[m"sv, "\x1b[0m"sv, "\x1b[1;31m"sv,
+    "\x1b[7m"sv, "\x1b[4:3m"sv, "\x1b[38;5;208m"sv, "\x1b[48;5;17m"sv, "\x1b[38;2;10;200;30m"sv,
+    "\x1b[48:2::1:2:3m"sv, "\x1b[39;49m"sv, "\x1b[H"sv, "\x1b[5;12H"sv, "\x1b[;7H"sv, "\x1b[3A"sv,
+    "\x1b[B"sv, "\x1b[12C"sv, "\x1b[2D"sv, "\x1b[K"sv, "\x1b[1K"sv, "\x1b[2K"sv, "\x1b[J"sv,
+    "\x1b[1J"sv, "\x1b[2J"sv, "\x1b[3J"sv, "\x1b[4;10r"sv, "\x1b[r"sv, "\x1b[2L"sv, "\x1b[M"sv,
+    "\x1b[3@"sv, "\x1b[2P"sv, "\x1b[4X"sv, "\x1b[S"sv, "\x1b[2T"sv, "\x1b[20G"sv, "\x1b[3d"sv,
+    "\x1b[4h"sv, "\x1b[4l"sv, "\x1b[?7l"sv, "\x1b[?7h"sv, "\x1b[?6h"sv, "\x1b[?6l"sv,
+    "\x1b[?25l"sv, "\x1b[?25h"sv, "\x1b[?1049h"sv, "\x1b[?1049l"sv, "\x1b[?1000h"sv, "\x1b[2 q"sv,
+    "\x1b" "7"sv, "\x1b" "8"sv, "\x1b" "D"sv, "\x1b" "E"sv, "\x1b" "M"sv, "\x1b(0lqk\x1b(B"sv,
+    "\x1b]0;title\a"sv, "\x1b]2;name\x1b\\"sv, "\x1b]8;;https://example.com\x1b\\link\x1b]8;;\x1b\\"sv,
+    "\x1b]133;A\a"sv, "\x1bP$q m\x1b\\"sv, "\x1b[6n"sv, "\x1b[c"sv, "\xc3\xa9"sv, "e\xcc\x81"sv,
+    "\xe4\xb8\xad\xe6\x96\x87"sv, "\xf0\x9f\x98\x80"sv, "\xe2\x80\x8d"sv, "\x1b["sv, "\x1b"sv,
+    "\x1b[1;"sv, "\xe4\xb8"sv, "\x00"sv, "\x7f"sv, "\x18"sv, "\x1a"sv, "\x9b"sv, "\x1b[99999H"sv,
+};
+
+/// Describe the first difference between two sessions (empty if none)
+std::string FindDifference(const Core::Session& expected, const Core::Session& actual) {
+    const Core::TerminalBuffer& a = *expected.GetBuffer();
+    const Core::TerminalBuffer& b = *actual.GetBuffer();
+
+    for (int row = 0; row < a.GetRows(); ++row) {
+        const std::span<const Core::Cell> aRow = a.GetRow(row);
+        const std::span<const Core::Cell> bRow = b.GetRow(row);
+        const auto mismatch = std::mismatch(aRow.begin(), aRow.end(), bRow.begin(), bRow.end());
+        if (mismatch.first != aRow.end() || mismatch.second != bRow.end()) {
+            return "cell " + std::to_string(row) + "," + std::to_string(mismatch.first - aRow.begin());
+        }
+        if (a.IsContinuation(row) != b.IsContinuation(row)) {
+            return "wrap flag of row " + std::to_string(row);
+        }
+    }
+
+    if (a.GetScrollbackSize() != b.GetScrollbackSize()) {
+        return "scrollback size " + std::to_string(a.GetScrollbackSize()) + " vs " +
+               std::to_string(b.GetScrollbackSize());
+    }
+    for (size_t index = 0; index < a.GetScrollbackSize(); ++index) {
+        // Lines are only valid until the next read: copy one side
+        const Core::Row* aLine = a.GetScrollbackLine(index);
+        const Core::Row expectedLine = aLine ? *aLine : Core::Row{};
+        const Core::Row* bLine = b.GetScrollbackLine(index);
+        if (!bLine || *bLine != expectedLine) {
+            return "scrollback line " + std::to_string(index);
+        }
+    }
+
+    int aRow = 0, aCol = 0, bRow = 0, bCol = 0;
+    expected.GetVTerm()->GetCursorPos(aRow, aCol);
+    actual.GetVTerm()->GetCursorPos(bRow, bCol);
+    if (aRow != bRow || aCol != bCol) {
+        return "cursor " + std::to_string(aRow) + "," + std::to_string(aCol) + " vs " +
+               std::to_string(bRow) + "," + std::to_string(bCol);
+    }
+
+    const Emulation::TermProps& aProps = expected.GetVTerm()->GetProps();
+    const Emulation::TermProps& bProps = actual.GetVTerm()->GetProps();
+    if (aProps.title != bProps.title || aProps.iconName != bProps.iconName ||
+        aProps.cursorVisible != bProps.cursorVisible || aProps.cursorBlink != bProps.cursorBlink ||
+        aProps.cursorShape != bProps.cursorShape || aProps.altScreen != bProps.altScreen ||
+        aProps.mouseMode != bProps.mouseMode) {
+        return "terminal properties";
+    }
+    return {};
+}
+
+} // namespace
+
+const EmulationPath& GetReferencePath() noexcept {
+    return kReference;
+}
+
+std::span<const EmulationPath> GetOptimizedPaths() noexcept {
+    return kOptimized;
+}
+
+DiffResult CompareStream(std::string_view stream, int rows, int cols, uint32_t seed, size_t maxRead) {
+    DiffResult result;
+
+    // Reference first, then the optimized paths in order
+    std::vector<const EmulationPath*> paths = {&kReference};
+    for (const EmulationPath& path : kOptimized) {
+        paths.push_back(&path);
+    }
+
+    std::vector<std::unique_ptr<Core::Session>> sessions;
+    for (const EmulationPath* path : paths) {
+        Core::SessionConfig config;
+        config.rows = rows;
+        config.cols = cols;
+        config.damageMerge = path->damageMerge;
+        config.emulationBackend = path->backend;
+        config.frontParser = path->frontParser;
+        config.fastForwardBytesPerSec = 0;  // Every read reaches the buffer
+
+        auto session = std::make_unique<Core::Session>();
+        if (!session->StartDetached(config)) {
+            result.match = false;
+            result.path = path->name;
+            result.detail = "session did not start";
+            return result;
+        }
+        sessions.push_back(std::move(session));
+    }
+
+    auto compare = [&](size_t offset) {
+        for (size_t i = 1; i < sessions.size(); ++i) {
+            std::string difference = FindDifference(*sessions[0], *sessions[i]);
+            if (!difference.empty()) {
+                result.match = false;
+                result.path = paths[i]->name;
+                result.detail = difference + " after byte " + std::to_string(offset);
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // Mostly tiny reads, so sequences and characters are split everywhere
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<size_t> tinyRead(1, 8);
+    std::uniform_int_distribution<size_t> anyRead(1, std::max<size_t>(maxRead, 1));
+
+    size_t offset = 0;
+    for (unsigned reads = 1; offset < stream.size(); ++reads) {
+        const size_t want = (rng() % 4 != 0) ? tinyRead(rng) : anyRead(rng);
+        const size_t length = std::min(want, stream.size() - offset);
+        for (auto& session : sessions) {
+            (void)session->FeedOutput(stream.data() + offset, length);
+        }
+        offset += length;
+
+        if (reads % kCompareEvery == 0 && !compare(offset)) {
+            break;
+        }
+    }
+    if (result.match) {
+        (void)compare(offset);
+    }
+
+    for (auto& session : sessions) {
+        session->Stop();
+    }
+    return result;
+}
+
+std::string GenerateFuzzStream(std::mt19937& rng, size_t bytes) {
+    std::string out;
+    out.reserve(bytes + 64);
+    std::uniform_int_distribution<size_t> token(0, kTokens.size() - 1);
+    std::uniform_int_distribution<int> kind(0, 9);
+    std::uniform_int_distribution<int> printable(0x20, 0x7E);
+    std::uniform_int_distribution<int> anyByte(0, 0xFF);
+    std::uniform_int_distribution<int> runLength(1, 40);
+
+    while (out.size() < bytes) {
+        const int k = kind(rng);
+        if (k < 4) {
+            out += kTokens[token(rng)];
+        } else if (k < 9) {
+            for (int i = runLength(rng); i > 0; --i) {
+                out += static_cast<char>(printable(rng));
+            }
+        } else {
+            out += static_cast<char>(anyByte(rng));
+        }
+    }
+    return out;
+}
+
+std::string MutateStream(std::mt19937& rng, std::string_view base, size_t bytes) {
+    if (base.empty()) {
+        return GenerateFuzzStream(rng, bytes);
+    }
+
+    const size_t length = std::min(bytes, base.size());
+    const size_t start = std::uniform_int_distribution<size_t>(0, base.size() - length)(rng);
+    std::string out(base.substr(start, length));
+
+    std::uniform_int_distribution<int> anyByte(0, 0xFF);
+    std::uniform_int_distribution<size_t> token(0, kTokens.size() - 1);
+    const size_t mutations = 1 + out.size() / 256;
+    for (size_t i = 0; i < mutations && !out.empty(); ++i) {
+        const size_t at = std::uniform_int_distribution<size_t>(0, out.size() - 1)(rng);
+        const size_t span = std::min<size_t>(out.size() - at, 1 + rng() % 16);
+        switch (rng() % 4) {
+            case 0: out[at] = static_cast<char>(anyByte(rng)); break;                 // Flip
+            case 1: out.insert(at, kTokens[token(rng)]); break;                        // Insert
+            case 2: out.erase(at, span); break;                                        // Drop
+            default: out.insert(at, out.substr(at, span)); break;                      // Repeat
+        }
+    }
+    return out;
+}
+
+} // namespace Console3::Bench
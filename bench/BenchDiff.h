@@ -0,0 +1,68 @@
+#pragma once
+// Console3 - BenchDiff.h
+// Differential check of the optimized emulation paths against the reference
+//
+// Every optimization of the output path (the Grid backend, the native front
+// parser, merged damage) must leave the terminal exactly as the plain path
+// would: libvterm's screen layer and parser, with every cell's damage synced
+// into the TerminalBuffer. The check feeds one byte stream, in the same
+// reads, to a detached session per path and compares what the renderer
+// reads: every screen cell and its wrap flag, the scrollback, the cursor and
+// the terminal properties.
+//
+// Streams come from the built-in corpora, captured files, or the fuzz
+// generators below: token soup over the sequences every path supports, and
+// corpus slices with bytes flipped, inserted, dropped and repeated. The Grid
+// backend's documented differences (DECSCA protection, DECSCNM; see
+// VTermGrid.h) are left out of generated tokens.
+//
+// Console3Tests runs the check on every build (tests/test_EmulationDiff.cpp);
+// Console3Bench --verify and --fuzz run it at any size or seed.
+
+#include "Core/Session.h"
+
+#include <cstdint>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace Console3::Bench {
+
+/// One way of running output through a session
+struct EmulationPath {
+    const char* name;
+    Emulation::EmulationBackend backend;
+    Emulation::DamageMerge damageMerge;
+    bool frontParser;
+};
+
+/// Get the reference path everything is compared against
+[[nodiscard]] const EmulationPath& GetReferencePath() noexcept;
+
+/// Get the optimized paths
+[[nodiscard]] std::span<const EmulationPath> GetOptimizedPaths() noexcept;
+
+/// Result of one differential run
+struct DiffResult {
+    bool match = true;
+    std::string path;       ///< First path that differs
+    std::string detail;     ///< What differs, and after how many bytes
+};
+
+/// Feed a stream to the reference and every optimized path and compare
+/// @param stream Output bytes
+/// @param rows, cols Screen size
+/// @param seed Picks the read sizes (1 to maxRead bytes, often tiny, so
+///             sequences are cut anywhere)
+/// @param maxRead Largest read
+[[nodiscard]] DiffResult CompareStream(std::string_view stream, int rows, int cols, uint32_t seed,
+                                       size_t maxRead);
+
+/// Generate a random stream of VT tokens, text and stray bytes
+[[nodiscard]] std::string GenerateFuzzStream(std::mt19937& rng, size_t bytes);
+
+/// Take a random slice of a stream and damage it
+[[nodiscard]] std::string MutateStream(std::mt19937& rng, std::string_view base, size_t bytes);
+
+} // namespace Console3::Bench
@@ -0,0 +1,98 @@
+// Console3 - BenchReport.cpp
+// Machine-readable benchmark results for the regression gate
+
+#include "BenchReport.h"
+
+#include <nlohmann/json.hpp>
+
+#include <fstream>
+
+namespace Console3::Bench {
+
+void BenchReport::Add(std::string name, double value, std::string unit, MetricGoal goal) {
+    for (Metric& metric : m_metrics) {
+        if (metric.name == name) {
+            metric = Metric{std::move(name), value, std::move(unit), goal};
+            return;
+        }
+    }
+    m_metrics.push_back(Metric{std::move(name), value, std::move(unit), goal});
+}
+
+void BenchReport::MergeBest(const BenchReport& other) {
+    for (const Metric& theirs : other.m_metrics) {
+        Metric* ours = nullptr;
+        for (Metric& metric : m_metrics) {
+            if (metric.name == theirs.name) {
+                ours = &metric;
+                break;
+            }
+        }
+        if (!ours) {
+            m_metrics.push_back(theirs);
+        } else if (theirs.goal == MetricGoal::Higher ? theirs.value > ours->value
+                                                     : theirs.value < ours->value) {
+            ours->value = theirs.value;
+        }
+    }
+}
+
+const Metric* BenchReport::Find(std::string_view name) const noexcept {
+    for (const Metric& metric : m_metrics) {
+        if (metric.name == name) {
+            return &metric;
+        }
+    }
+    return nullptr;
+}
+
+bool BenchReport::Write(const std::string& path) const {
+    nlohmann::json metrics = nlohmann::json::array();
+    for (const Metric& metric : m_metrics) {
+        metrics.push_back({
+            {"name", metric.name},
+            {"value", metric.value},
+            {"unit", metric.unit},
+            {"better", GetGoalName(metric.goal)},
+        });
+    }
+
+    std::ofstream file(path, std::ios::trunc);
+    file << nlohmann::json{{"metrics", std::move(metrics)}}.dump(2) << '\n';
+    return static_cast<bool>(file);
+}
+
+std::optional<BenchReport> BenchReport::Load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        return std::nullopt;
+    }
+
+    const nlohmann::json json = nlohmann::json::parse(file, nullptr, false);
+    if (json.is_discarded() || !json.contains("metrics") || !json["metrics"].is_array()) {
+        return std::nullopt;
+    }
+
+    BenchReport report;
+    for (const nlohmann::json& entry : json["metrics"]) {
+        if (!entry.contains("name") || !entry.contains("value") || !entry["value"].is_number()) {
+            continue;
+        }
+        const std::optional<MetricGoal> goal = ParseGoal(entry.value("better", std::string()));
+        report.Add(entry["name"].get<std::string>(), entry["value"].get<double>(),
+                   entry.value("unit", std::string()), goal.value_or(MetricGoal::Lower));
+    }
+    return report;
+}
+
+const char* BenchReport::GetGoalName(MetricGoal goal) noexcept {
+    return goal == MetricGoal::Higher ? "higher" : "lower";
+}
+
+std::optional<MetricGoal> BenchReport::ParseGoal(std::string_view name) noexcept {
+    if (name == "higher") return MetricGoal::Higher;
+    if (name == "lower") return MetricGoal::Lower;
+    return std::nullopt;
+}
+
+} // namespace Console3::Bench
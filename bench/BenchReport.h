@@ -0,0 +1,68 @@
+#pragma once
+// Console3 - BenchReport.h
+// Machine-readable benchmark results for the regression gate
+//
+// Console3Bench and Console3RenderBench print tables for people; with
+// --json they also write the numbers worth gating on as a flat list of
+// named metrics, each with its unit and whether higher or lower is better.
+// Console3PerfCheck runs the suites, reads these reports and compares them
+// with the checked-in baseline (bench/baselines/perf-baseline.json).
+//
+// Names are dotted paths, suite first: "parser.ascii-log.mb_per_s",
+// "render.htop.cellgrid.p99_ms". A name means the same measurement from one
+// version to the next; change what a metric measures and rename it.
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Console3::Bench {
+
+/// Which way a metric improves
+enum class MetricGoal {
+    Higher,     ///< Throughput and the like
+    Lower       ///< Times, memory
+};
+
+/// One measured number
+struct Metric {
+    std::string name;
+    double value = 0.0;
+    std::string unit;
+    MetricGoal goal = MetricGoal::Lower;
+};
+
+/// Metrics of one or more benchmark runs
+class BenchReport {
+public:
+    /// Add a metric (a second one with the same name replaces the first)
+    void Add(std::string name, double value, std::string unit, MetricGoal goal);
+
+    /// Keep the better of two measurements of each metric
+    /// Metrics only the other report has are added.
+    void MergeBest(const BenchReport& other);
+
+    /// Get the metrics, in the order they were added
+    [[nodiscard]] const std::vector<Metric>& GetMetrics() const noexcept { return m_metrics; }
+
+    /// Find a metric by name
+    [[nodiscard]] const Metric* Find(std::string_view name) const noexcept;
+
+    /// Write the report as JSON
+    [[nodiscard]] bool Write(const std::string& path) const;
+
+    /// Read a report Write() wrote
+    [[nodiscard]] static std::optional<BenchReport> Load(const std::string& path);
+
+    /// Get a goal's name in JSON ("higher" or "lower")
+    [[nodiscard]] static const char* GetGoalName(MetricGoal goal) noexcept;
+
+    /// Parse a goal's name
+    [[nodiscard]] static std::optional<MetricGoal> ParseGoal(std::string_view name) noexcept;
+
+private:
+    std::vector<Metric> m_metrics;
+};
+
+} // namespace Console3::Bench
@@ -0,0 +1,274 @@
+// Console3 - RenderScenes.cpp
+// Scripted screen updates for the render benchmark
+
+#include "RenderScenes.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <random>
+
+namespace Console3::Bench {
+
+namespace {
+
+constexpr std::array<SceneInfo, 4> kScenes = {{
+    {"color-churn", "Every cell repainted each frame with new truecolor foreground and background"},
+    {"scroll-log", "A colored log scrolling a few lines per frame"},
+    {"htop", "A top-style table on the alternate screen, a few rows changing per frame"},
+    {"cjk-box", "Wide CJK text and block elements inside box-drawing frames"},
+}};
+
+/// Deterministic generator state shared by the scene builders
+class Generator {
+public:
+    explicit Generator(uint32_t seed) : m_rng(seed) {}
+
+    /// Uniform integer in [lo, hi]
+    int Next(int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(m_rng); }
+
+    /// Pick one element of a list
+    template <typename T, size_t N>
+    const T& Pick(const std::array<T, N>& items) { return items[Next(0, static_cast<int>(N) - 1)]; }
+
+    /// Random lowercase word
+    void Word(std::string& out, int minLen, int maxLen) {
+        const int len = Next(minLen, maxLen);
+        for (int i = 0; i < len; ++i) {
+            out += static_cast<char>('a' + Next(0, 25));
+        }
+    }
+
+private:
+    std::mt19937 m_rng;
+};
+
+void MoveTo(std::string& out, int row, int col) {
+    out += "\x1b[";
+    out += std::to_string(row);
+    out += ';';
+    out += std::to_string(col);
+    out += 'H';
+}
+
+void SgrRgb(std::string& out, int selector, int r, int g, int b) {
+    out += "\x1b[";
+    out += std::to_string(selector);
+    out += ";2;";
+    out += std::to_string(r);
+    out += ';';
+    out += std::to_string(g);
+    out += ';';
+    out += std::to_string(b);
+    out += 'm';
+}
+
+// ============================================================================
+// Scene builders
+// ============================================================================
+
+void BuildColorChurn(Generator& gen, std::vector<std::string>& frames, int rows, int cols) {
+    for (std::string& out : frames) {
+        out += "\x1b[H";
+        for (int row = 1; row <= rows; ++row) {
+            MoveTo(out, row, 1);
+            for (int col = 0; col < cols;) {
+                const int run = std::min(gen.Next(3, 12), cols - col);
+                SgrRgb(out, 38, gen.Next(128, 255), gen.Next(128, 255), gen.Next(128, 255));
+                SgrRgb(out, 48, gen.Next(0, 96), gen.Next(0, 96), gen.Next(0, 96));
+                if (gen.Next(0, 5) == 0) {
+                    out += "\x1b[1m";
+                }
+                for (int i = 0; i < run; ++i) {
+                    out += static_cast<char>('!' + gen.Next(0, 93));
+                }
+                out += "\x1b[0m";
+                col += run;
+            }
+        }
+    }
+}
+
+void BuildScrollLog(Generator& gen, std::vector<std::string>& frames, int rows) {
+    static constexpr std::array<const char*, 4> levels = {
+        "\x1b[32mINFO \x1b[0m", "\x1b[36mDEBUG\x1b[0m", "\x1b[33mWARN \x1b[0m", "\x1b[1;31mERROR\x1b[0m"};
+
+    int line = 0;
+    for (std::string& out : frames) {
+        if (&out == &frames.front()) {
+            MoveTo(out, rows, 1);
+        }
+        for (int lines = gen.Next(1, 4); lines > 0; --lines, ++line) {
+            out += "\r\n\x1b[90m09:";
+            out += std::to_string(10 + (line / 60) % 50);
+            out += ':';
+            out += std::to_string(10 + line % 50);
+            out += "\x1b[0m ";
+            out += gen.Pick(levels);
+            out += " \x1b[35m[worker-";
+            out += std::to_string(gen.Next(0, 15));
+            out += "]\x1b[0m ";
+            for (int words = gen.Next(3, 14); words > 0; --words) {
+                gen.Word(out, 2, 9);
+                out += ' ';
+            }
+        }
+    }
+}
+
+/// One row of the htop process table
+void HtopRow(Generator& gen, std::string& out, int row, bool selected) {
+    MoveTo(out, row, 1);
+    if (selected) {
+        out += "\x1b[30;46m";
+    }
+    out += std::to_string(gen.Next(100, 99999));
+    out += " root      20   0 ";
+    out += std::to_string(gen.Next(1000, 999999));
+    out += " \x1b[1m";
+    out += std::to_string(gen.Next(0, 99));
+    out += ".0\x1b[22m  ";
+    gen.Word(out, 4, 16);
+    out += "\x1b[K";
+    if (selected) {
+        out += "\x1b[0m";
+    }
+}
+
+void BuildHtop(Generator& gen, std::vector<std::string>& frames, int rows, int cols) {
+    constexpr int kMeters = 4;
+    const int barWidth = std::max(1, cols / 2 - 10);
+
+    for (std::string& out : frames) {
+        const bool first = &out == &frames.front();
+        if (first) {
+            // The whole table once, then only what changes
+            out += "\x1b[?1049h\x1b[?25l\x1b[H\x1b[2J";
+            MoveTo(out, kMeters + 2, 1);
+            out += "\x1b[30;42m  PID USER      PRI  NI  VIRT   CPU%  Command\x1b[K\x1b[0m";
+            for (int row = kMeters + 3; row < rows; ++row) {
+                HtopRow(gen, out, row, row == kMeters + 3);
+            }
+        }
+
+        for (int meter = 1; meter <= kMeters; ++meter) {
+            MoveTo(out, meter, 1);
+            out += "\x1b[36m";
+            out += std::to_string(meter - 1);
+            out += "\x1b[0m[\x1b[32m";
+            const int bar = gen.Next(0, barWidth);
+            out.append(bar, '|');
+            out += "\x1b[0m";
+            out.append(barWidth - bar, ' ');
+            out += std::to_string(gen.Next(0, 99));
+            out += '.';
+            out += std::to_string(gen.Next(0, 9));
+            out += "%]\x1b[K";
+        }
+        for (int changed = gen.Next(2, 8); changed > 0 && rows > kMeters + 4; --changed) {
+            HtopRow(gen, out, gen.Next(kMeters + 4, rows - 1), false);
+        }
+
+        // Function key bar
+        MoveTo(out, rows, 1);
+        out += "\x1b[7mF1\x1b[0mHelp \x1b[7mF2\x1b[0mSetup \x1b[7mF10\x1b[0mQuit\x1b[K";
+    }
+}
+
+void BuildCjkBox(Generator& gen, std::vector<std::string>& frames, int rows, int cols) {
+    // Every piece is three wide characters: six cells
+    static constexpr std::array<const char*, 6> pieces = {
+        "\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e",     // 日本語
+        "\xe4\xb8\xad\xe6\x96\x87\xe5\xad\x97",     // 中文字
+        "\xed\x95\x9c\xea\xb5\xad\xec\x96\xb4",     // 한국어
+        "\xe3\x83\x86\xe3\x82\xb9\xe3\x83\x88",     // テスト
+        "\xe6\xbc\xa2\xe5\xad\x97\xe8\xa1\xa8",     // 漢字表
+        "\xe8\xa8\xad\xe5\xae\x9a\xe5\x80\xa4",     // 設定値
+    };
+    static constexpr std::array<const char*, 4> shades = {
+        "\xe2\x96\x91", "\xe2\x96\x92", "\xe2\x96\x93", "\xe2\x96\x88"};  // ░▒▓█
+    static constexpr const char* kHorizontal = "\xe2\x94\x80";           // ─
+    static constexpr const char* kVertical = "\xe2\x94\x82";             // │
+
+    const int middle = rows / 2;
+    const auto rule = [&](std::string& out, int row, const char* left, const char* right) {
+        MoveTo(out, row, 1);
+        out += left;
+        for (int col = 2; col < cols; ++col) {
+            out += kHorizontal;
+        }
+        out += right;
+    };
+
+    for (std::string& out : frames) {
+        if (&out == &frames.front()) {
+            // The frames once: ┌─┐ ├─┤ └─┘ and the sides
+            out += "\x1b[H\x1b[2J\x1b[34m";
+            rule(out, 1, "\xe2\x94\x8c", "\xe2\x94\x90");
+            rule(out, middle, "\xe2\x94\x9c", "\xe2\x94\xa4");
+            rule(out, rows, "\xe2\x94\x94", "\xe2\x94\x98");
+            for (int row = 2; row < rows; ++row) {
+                if (row != middle) {
+                    MoveTo(out, row, 1);
+                    out += kVertical;
+                    MoveTo(out, row, cols);
+                    out += kVertical;
+                }
+            }
+            out += "\x1b[0m";
+        }
+
+        // Rewrite some rows inside: text above the divider, meters below
+        for (int changed = gen.Next(3, 8); changed > 0; --changed) {
+            const int row = gen.Next(2, rows - 1);
+            if (row == middle) {
+                continue;
+            }
+            MoveTo(out, row, 2);
+            int used = 0;
+            if (row < middle) {
+                while (used + 7 <= cols - 2) {
+                    out += gen.Pick(pieces);
+                    out += ' ';
+                    used += 7;
+                }
+            } else {
+                out += "\x1b[32m";
+                for (const int end = gen.Next(0, cols - 2); used < end; ++used) {
+                    out += gen.Pick(shades);
+                }
+                out += "\x1b[0m";
+            }
+            out.append(static_cast<size_t>(cols - 2 - used), ' ');
+        }
+    }
+}
+
+} // namespace
+
+std::span<const SceneInfo> GetScenes() noexcept {
+    return kScenes;
+}
+
+std::optional<std::vector<std::string>> GenerateScene(std::string_view name, int rows, int cols,
+                                                      int frames) {
+    rows = std::max(rows, 12);
+    cols = std::max(cols, 40);
+
+    std::vector<std::string> out(static_cast<size_t>(std::max(frames, 1)));
+    Generator gen(0xC0503u);
+
+    if (name == "color-churn") {
+        BuildColorChurn(gen, out, rows, cols);
+    } else if (name == "scroll-log") {
+        BuildScrollLog(gen, out, rows);
+    } else if (name == "htop") {
+        BuildHtop(gen, out, rows, cols);
+    } else if (name == "cjk-box") {
+        BuildCjkBox(gen, out, rows, cols);
+    } else {
+        return std::nullopt;
+    }
+    return out;
+}
+
+} // namespace Console3::Bench
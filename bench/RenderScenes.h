@@ -0,0 +1,38 @@
+#pragma once
+// Console3 - RenderScenes.h
+// Scripted screen updates for the render benchmark
+//
+// Where the corpora of BenchCorpus are sized in bytes for the parser, a
+// scene is a list of frames: the output a program writes between two
+// paints. Each one exercises a different part of the renderer - attribute
+// churn over the whole screen, a scrolling log, a few rows of a top-style
+// table changing in place, wide CJK text inside box-drawing frames. The
+// generators are seeded, so every run paints exactly the same frames.
+
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Console3::Bench {
+
+/// Built-in scene description
+struct SceneInfo {
+    const char* name;           ///< Name used on the command line
+    const char* description;    ///< One-line summary for --list
+};
+
+/// Get the built-in scenes, in report order
+[[nodiscard]] std::span<const SceneInfo> GetScenes() noexcept;
+
+/// Generate a built-in scene
+/// @param name Scene name (see GetScenes())
+/// @param rows Screen height the frames are laid out for
+/// @param cols Screen width the frames are laid out for
+/// @param frames Number of frames
+/// @return The output of each frame, or nullopt if the name is unknown
+[[nodiscard]] std::optional<std::vector<std::string>> GenerateScene(std::string_view name, int rows,
+                                                                    int cols, int frames);
+
+} // namespace Console3::Bench
@@ -0,0 +1,633 @@
+// Console3 - bench_main.cpp
+// Headless parser throughput benchmark
+//
+// Replays VT output corpora through a detached Core::Session - output ring,
+// VTermWrapper::InputWrite, damage callbacks and TerminalBuffer sync - and
+// reports throughput, cost per byte, heap allocations and per-chunk latency.
+// No window or pseudo console is created.
+//
+// --verify instead replays each corpus through the reference emulation path
+// and every optimized one (BenchDiff.h) and checks that the screens match;
+// --fuzz N does the same for N generated and mutated streams.
+//
+// --conpty runs each corpus through a real pseudo console instead
+// (BenchConPty.h): `cmd /c type` of the corpus written to a file, or the
+// Console3BenchGen child generating it, timed to the final screen.
+//
+// --startup N times N sessions from Start() to the shell's first output on
+// screen. --json writes the numbers the regression gate compares
+// (BenchReport.h).
+//
+//   Console3Bench [--corpus name[,name...]] [--file path] [--mb N]
+//                 [--chunk bytes] [--rows N] [--cols N]
+//                 [--damage cell|row|screen|scroll] [--backend screen|grid]
+//                 [--front-parser] [--verify] [--fuzz N] [--seed N]
+//                 [--fast-forward] [--conpty type|gen] [--iocp] [--watermark bytes]
+//                 [--emulation-thread] [--startup N] [--json path] [--list]
+
+#include "BenchConPty.h"
+#include "BenchCorpus.h"
+#include "BenchDiff.h"
+#include "BenchReport.h"
+#include "Core/AllocTracker.h"
+#include "Core/PtyRecording.h"
+#include "Core/Session.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <new>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// ============================================================================
+// Allocation counting
+// ============================================================================
+
+#if !CONSOLE3_ALLOC_TRACKING
+
+namespace {
+std::atomic<uint64_t> g_allocations{0};
+} // namespace
+
+// Replacing the global operators counts every C++ heap allocation in the
+// process; libvterm's own mallocs are counted by the session's emulator
+void* operator new(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+#endif // !CONSOLE3_ALLOC_TRACKING
+
+namespace {
+
+using namespace Console3;
+
+/// Command line options
+struct BenchOptions {
+    std::vector<std::string> corpora;   ///< Built-in corpora to run (empty = all)
+    std::string file;                   ///< Captured output to replay instead
+    size_t megabytes = 64;              ///< Bytes fed per corpus
+    size_t chunkSize = 4096;            ///< Bytes per FeedOutput() call (one "read")
+    int rows = 50;
+    int cols = 160;
+    Emulation::DamageMerge damageMerge = Emulation::DamageMerge::Scroll;
+    Emulation::EmulationBackend backend = Emulation::EmulationBackend::Screen;
+    bool frontParser = false;           ///< Parse with the native front parser
+    bool verify = false;                ///< Compare the emulation paths instead of timing
+    unsigned fuzzRuns = 0;              ///< Compare the paths on this many fuzz streams
+    uint32_t seed = 1;                  ///< First fuzz stream's seed
+    bool fastForward = false;           ///< Leave the fast-forward governor enabled
+    std::string conpty;                 ///< Run through a pseudo console: "type" or "gen" (empty = detached)
+    bool completionPort = false;        ///< --conpty: read with the shared completion port
+    size_t highWatermark = 0;           ///< --conpty: throttle the reader at this fill level (0 = full)
+    bool emulationThread = false;       ///< --conpty: parse on a worker thread
+    unsigned startupRuns = 0;           ///< Time this many session startups instead
+    std::string json;                   ///< Write the gated metrics here (empty = off)
+};
+
+/// Result of one corpus run
+struct BenchResult {
+    uint64_t bytes = 0;
+    double seconds = 0.0;
+    uint64_t allocations = 0;
+    Core::AllocSnapshot allocsBySubsystem{};  ///< Instrumented builds only
+    double p50Micros = 0.0;
+    double p99Micros = 0.0;
+    double scrollbackKBPer10k = 0.0;    ///< History memory per 10,000 lines (0 = none kept)
+};
+
+/// Heap allocations so far: the instrumented build's counters (which
+/// include libvterm's), or the operators above plus the session's emulator
+uint64_t CountAllocations(const Core::Session& session) {
+#if CONSOLE3_ALLOC_TRACKING
+    (void)session;
+    return Core::AllocTracker::Total().allocations;
+#else
+    return g_allocations.load(std::memory_order_relaxed) + session.GetStats().vtermAllocations;
+#endif
+}
+
+uint64_t NowNanos() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+double Percentile(std::vector<uint64_t>& samples, double fraction) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    const size_t index = std::min(samples.size() - 1,
+                                  static_cast<size_t>(fraction * static_cast<double>(samples.size())));
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index] / 1000.0;
+}
+
+void PrintUsage() {
+    std::printf(
+        "Usage: Console3Bench [options]\n"
+        "  --corpus a,b      Built-in corpora to run (default: all, see --list)\n"
+        "  --file path       Replay captured output instead (raw bytes or a recording)\n"
+        "  --mb N            Megabytes fed per corpus (default 64)\n"
+        "  --chunk bytes     Bytes per read (default 4096)\n"
+        "  --rows N          Screen rows (default 50)\n"
+        "  --cols N          Screen columns (default 160)\n"
+        "  --damage mode     cell, row, screen or scroll (default scroll)\n"
+        "  --backend name    screen or grid (default screen)\n"
+        "  --front-parser    Parse the common VT subset natively ahead of libvterm\n"
+        "  --verify          Check every emulation path against the reference on the corpora\n"
+        "                    (up to --mb each, reads of random size)\n"
+        "  --fuzz N          Check every emulation path on N generated or mutated streams\n"
+        "  --seed N          Seed of the first fuzz stream (default 1; failures print theirs)\n"
+        "  --fast-forward    Keep the fast-forward governor enabled\n"
+        "  --conpty mode     Run through a real pseudo console: type (cmd /c type of the\n"
+        "                    corpus) or gen (Console3BenchGen), timed to the final screen\n"
+        "  --iocp            With --conpty: read through the shared completion port\n"
+        "  --watermark bytes With --conpty: throttle the reader at this output buffer level\n"
+        "  --emulation-thread  With --conpty: parse on a worker thread\n"
+        "  --startup N       Time N session startups (Start() to the shell's first output)\n"
+        "  --json path       Also write the results as metrics for Console3PerfCheck\n"
+        "  --list            List built-in corpora\n");
+}
+
+bool ParseDamageMerge(std::string_view text, Emulation::DamageMerge& merge) {
+    if (text == "cell") merge = Emulation::DamageMerge::Cell;
+    else if (text == "row") merge = Emulation::DamageMerge::Row;
+    else if (text == "screen") merge = Emulation::DamageMerge::Screen;
+    else if (text == "scroll") merge = Emulation::DamageMerge::Scroll;
+    else return false;
+    return true;
+}
+
+bool ParseOptions(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        const bool takesValue = arg == "--corpus" || arg == "--file" || arg == "--mb" ||
+                                arg == "--chunk" || arg == "--rows" || arg == "--cols" ||
+                                arg == "--damage" || arg == "--backend" || arg == "--fuzz" ||
+                                arg == "--seed" || arg == "--conpty" || arg == "--watermark" ||
+                                arg == "--startup" || arg == "--json";
+        if (takesValue && !value) {
+            std::fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return false;
+        }
+
+        if (arg == "--corpus") {
+            std::string_view list = value;
+            while (!list.empty()) {
+                const size_t comma = list.find(',');
+                options.corpora.emplace_back(list.substr(0, comma));
+                list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+            }
+        } else if (arg == "--file") {
+            options.file = value;
+        } else if (arg == "--mb") {
+            options.megabytes = std::strtoull(value, nullptr, 10);
+        } else if (arg == "--chunk") {
+            options.chunkSize = std::strtoull(value, nullptr, 10);
+        } else if (arg == "--rows") {
+            options.rows = std::atoi(value);
+        } else if (arg == "--cols") {
+            options.cols = std::atoi(value);
+        } else if (arg == "--damage") {
+            if (!ParseDamageMerge(value, options.damageMerge)) {
+                std::fprintf(stderr, "Unknown damage mode: %s\n", value);
+                return false;
+            }
+        } else if (arg == "--backend") {
+            if (std::string_view(value) == "screen") {
+                options.backend = Emulation::EmulationBackend::Screen;
+            } else if (std::string_view(value) == "grid") {
+                options.backend = Emulation::EmulationBackend::Grid;
+            } else {
+                std::fprintf(stderr, "Unknown backend: %s\n", value);
+                return false;
+            }
+        } else if (arg == "--front-parser") {
+            options.frontParser = true;
+        } else if (arg == "--verify") {
+            options.verify = true;
+        } else if (arg == "--fuzz") {
+            options.fuzzRuns = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--seed") {
+            options.seed = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--fast-forward") {
+            options.fastForward = true;
+        } else if (arg == "--conpty") {
+            options.conpty = value;
+            if (options.conpty != "type" && options.conpty != "gen") {
+                std::fprintf(stderr, "Unknown pseudo console mode: %s\n", value);
+                return false;
+            }
+        } else if (arg == "--iocp") {
+            options.completionPort = true;
+        } else if (arg == "--watermark") {
+            options.highWatermark = std::strtoull(value, nullptr, 10);
+        } else if (arg == "--emulation-thread") {
+            options.emulationThread = true;
+        } else if (arg == "--startup") {
+            options.startupRuns = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--json") {
+            options.json = value;
+        } else {
+            std::fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return false;
+        }
+        if (takesValue) {
+            ++i;
+        }
+    }
+
+    if (options.megabytes == 0 || options.chunkSize == 0 || options.rows <= 0 || options.cols <= 0) {
+        std::fprintf(stderr, "Sizes must be positive\n");
+        return false;
+    }
+    return true;
+}
+
+/// Feed data through a fresh detached session until totalBytes were parsed
+bool RunCorpus(const std::string& data, const BenchOptions& options, BenchResult& result) {
+    Core::SessionConfig config;
+    config.rows = options.rows;
+    config.cols = options.cols;
+    config.damageMerge = options.damageMerge;
+    config.emulationBackend = options.backend;
+    config.frontParser = options.frontParser;
+    if (!options.fastForward) {
+        config.fastForwardBytesPerSec = 0;  // Measure the full sync path
+    }
+
+    Core::Session session;
+    if (!session.StartDetached(config)) {
+        std::fprintf(stderr, "Failed to start a detached session\n");
+        return false;
+    }
+
+    const size_t totalBytes = options.megabytes * 1024 * 1024;
+    const size_t chunk = options.chunkSize;
+
+    // Warm up: grow the ring, scrollback and scratch rows to steady state
+    for (size_t offset = 0; offset < std::min(data.size(), totalBytes / 8); offset += chunk) {
+        session.FeedOutput(data.data() + offset, std::min(chunk, data.size() - offset));
+    }
+
+    std::vector<uint64_t> samples;
+    samples.reserve(totalBytes / chunk + data.size() / chunk + 2);
+
+    const uint64_t allocationsBefore = CountAllocations(session);
+    const Core::AllocSnapshot subsystemsBefore = Core::AllocTracker::Snapshot();
+    const uint64_t start = NowNanos();
+
+    size_t fed = 0;
+    size_t offset = 0;
+    while (fed < totalBytes) {
+        if (offset >= data.size()) {
+            offset = 0;
+        }
+        const size_t length = std::min(chunk, data.size() - offset);
+
+        const uint64_t chunkStart = NowNanos();
+        session.FeedOutput(data.data() + offset, length);
+        samples.push_back(NowNanos() - chunkStart);
+
+        offset += length;
+        fed += length;
+    }
+
+    const uint64_t elapsed = NowNanos() - start;
+    result.allocations = CountAllocations(session) - allocationsBefore;
+    const Core::AllocSnapshot subsystemsAfter = Core::AllocTracker::Snapshot();
+    for (size_t i = 0; i < subsystemsAfter.size(); ++i) {
+        result.allocsBySubsystem[i].allocations = subsystemsAfter[i].allocations - subsystemsBefore[i].allocations;
+        result.allocsBySubsystem[i].bytes = subsystemsAfter[i].bytes - subsystemsBefore[i].bytes;
+    }
+    result.bytes = fed;
+    result.seconds = elapsed / 1e9;
+    result.p50Micros = Percentile(samples, 0.50);
+    result.p99Micros = Percentile(samples, 0.99);
+
+    // Whatever mix of hot rows and compressed blocks the run left behind
+    const Core::SessionStats stats = session.GetStats();
+    if (stats.scrollbackLines > 0) {
+        result.scrollbackKBPer10k = stats.scrollbackBytes / 1024.0 * 10000.0 /
+                                    static_cast<double>(stats.scrollbackLines);
+    }
+
+    session.Stop();
+    return true;
+}
+
+/// Write a corpus, looped to the run's size, to a temporary file
+/// @return The file's path, or empty on failure
+std::wstring WriteCorpusFile(const std::string& data, size_t totalBytes) {
+    wchar_t directory[MAX_PATH];
+    wchar_t path[MAX_PATH];
+    if (GetTempPathW(MAX_PATH, directory) == 0 || GetTempFileNameW(directory, L"c3b", 0, path) == 0) {
+        return {};
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    for (size_t written = 0; file && written < totalBytes;) {
+        const size_t length = std::min(data.size(), totalBytes - written);
+        file.write(data.data(), static_cast<std::streamsize>(length));
+        written += length;
+    }
+    if (!file) {
+        DeleteFileW(path);
+        return {};
+    }
+    return path;
+}
+
+/// Run every corpus through a real pseudo console (--conpty)
+/// @return Process exit code
+int RunConPty(const std::vector<std::pair<std::string, std::string>>& runs, const BenchOptions& options) {
+    Core::SessionConfig config;
+    config.rows = options.rows;
+    config.cols = options.cols;
+    config.damageMerge = options.damageMerge;
+    config.emulationBackend = options.backend;
+    config.frontParser = options.frontParser;
+    config.useCompletionPort = options.completionPort;
+    config.outputHighWatermark = options.highWatermark;
+    config.emulationThread = options.emulationThread;
+    if (!options.fastForward) {
+        config.fastForwardBytesPerSec = 0;
+    }
+
+    const size_t totalBytes = options.megabytes * 1024 * 1024;
+    std::printf("%dx%d, %zu MB per corpus through the pseudo console (%s, %s reads%s)\n\n",
+                options.cols, options.rows, options.megabytes, options.conpty.c_str(),
+                options.completionPort ? "completion port" : "blocking",
+                options.emulationThread ? ", emulation thread" : "");
+    std::printf("%-14s %10s %9s %9s %11s %9s\n", "corpus", "MB/s", "seconds", "reads",
+                "stall ms", "parse %");
+
+    for (const auto& [name, data] : runs) {
+        std::wstring file;
+        if (options.conpty == "type") {
+            file = WriteCorpusFile(data, totalBytes);
+            if (file.empty()) {
+                std::fprintf(stderr, "Cannot write the corpus file\n");
+                return 1;
+            }
+            config.shell = L"cmd.exe";
+            config.args = L"/c type \"" + file + L"\"";
+        } else {
+            // Corpus names are ASCII
+            config.shell = Bench::GetGeneratorPath();
+            config.args = L"--corpus " + std::wstring(name.begin(), name.end()) +
+                          L" --mb " + std::to_wstring(options.megabytes) +
+                          L" --rows " + std::to_wstring(options.rows) +
+                          L" --cols " + std::to_wstring(options.cols);
+        }
+
+        Bench::ConPtyResult result;
+        const bool finished = Bench::RunConPty(config, result);
+        if (!file.empty()) {
+            DeleteFileW(file.c_str());
+        }
+        if (!finished) {
+            std::fprintf(stderr, "%s: the child did not start or finish\n", name.c_str());
+            return 1;
+        }
+
+        const double megabytes = result.bytes / (1024.0 * 1024.0);
+        std::printf("%-14s %10.1f %9.2f %9llu %11.1f %9.1f\n", name.c_str(),
+                    result.seconds > 0 ? megabytes / result.seconds : 0.0, result.seconds,
+                    static_cast<unsigned long long>(result.reads), result.stallMicros / 1000.0,
+                    result.seconds > 0 ? result.parseMicros / (result.seconds * 1e4) : 0.0);
+    }
+    return 0;
+}
+
+/// Time session startups through a real pseudo console (--startup)
+/// @return Process exit code
+int RunStartup(const BenchOptions& options, Bench::BenchReport& report) {
+    Core::SessionConfig config;
+    config.rows = options.rows;
+    config.cols = options.cols;
+    config.shell = L"cmd.exe";
+    config.args = L"/c echo ready";
+
+    std::printf("%dx%d, %u session startups (cmd /c echo)\n\n", options.cols, options.rows,
+                options.startupRuns);
+
+    std::vector<uint64_t> samples;
+    for (unsigned run = 0; run < options.startupRuns; ++run) {
+        Bench::ConPtyResult result;
+        if (!Bench::RunConPty(config, result) || result.firstOutputSeconds == 0.0) {
+            std::fprintf(stderr, "The shell did not start or print\n");
+            return 1;
+        }
+        samples.push_back(static_cast<uint64_t>(result.firstOutputSeconds * 1e9));
+    }
+
+    // Percentile() reports microseconds
+    const double minMillis = *std::min_element(samples.begin(), samples.end()) / 1e6;
+    const double medianMillis = Percentile(samples, 0.50) / 1000.0;
+    std::printf("%-14s %9s %9s\n", "", "min ms", "p50 ms");
+    std::printf("%-14s %9.1f %9.1f\n", "first output", minMillis, medianMillis);
+
+    report.Add("startup.first_output_ms", medianMillis, "ms", Bench::MetricGoal::Lower);
+    return 0;
+}
+
+/// Compare the emulation paths on the corpora (--verify) and fuzz streams (--fuzz)
+/// @return Process exit code
+int RunDiff(const std::vector<std::pair<std::string, std::string>>& runs, const BenchOptions& options) {
+    bool allMatch = true;
+    auto report = [&](const std::string& name, const Bench::DiffResult& result) {
+        if (!result.match) {
+            std::printf("%-14s DIFFER  %s: %s\n", name.c_str(), result.path.c_str(), result.detail.c_str());
+            allMatch = false;
+        }
+    };
+
+    if (options.verify) {
+        for (const auto& [name, data] : runs) {
+            const std::string_view stream(data.data(), std::min(data.size(), options.megabytes * 1024 * 1024));
+            const Bench::DiffResult result =
+                Bench::CompareStream(stream, options.rows, options.cols, options.seed, options.chunkSize);
+            report(name, result);
+            if (result.match) {
+                std::printf("%-14s match\n", name.c_str());
+            }
+        }
+    }
+
+    // Half the streams are token soup, half damaged slices of the corpora
+    unsigned failures = 0;
+    for (unsigned run = 0; run < options.fuzzRuns; ++run) {
+        const uint32_t seed = options.seed + run;
+        std::mt19937 rng(seed);
+        const size_t bytes = 256 + rng() % (64 * 1024);
+        const std::string stream = (run % 2 == 0 || runs.empty())
+            ? Bench::GenerateFuzzStream(rng, bytes)
+            : Bench::MutateStream(rng, runs[run / 2 % runs.size()].second, bytes);
+
+        const Bench::DiffResult result =
+            Bench::CompareStream(stream, options.rows, options.cols, seed, options.chunkSize);
+        if (!result.match) {
+            report("seed " + std::to_string(seed), result);
+            ++failures;
+        }
+    }
+    if (options.fuzzRuns > 0) {
+        std::printf("fuzz: %u of %u streams differ (seeds %u-%u)\n", failures, options.fuzzRuns,
+                    options.seed, options.seed + options.fuzzRuns - 1);
+    }
+    return allMatch ? 0 : 1;
+}
+
+double MegabytesPerSecond(const BenchResult& result) {
+    return result.seconds > 0 ? result.bytes / (1024.0 * 1024.0) / result.seconds : 0.0;
+}
+
+void PrintResult(const std::string& name, const BenchResult& result) {
+    const double megabytes = result.bytes / (1024.0 * 1024.0);
+    std::printf("%-14s %10.1f %9.2f %11.1f %9.1f %9.1f %12.1f\n", name.c_str(),
+                MegabytesPerSecond(result),
+                result.bytes > 0 ? result.seconds * 1e9 / result.bytes : 0.0,
+                megabytes > 0 ? result.allocations / megabytes : 0.0,
+                result.p50Micros, result.p99Micros, result.scrollbackKBPer10k);
+
+    // Instrumented builds: where the allocations came from
+    if constexpr (Core::AllocTracker::kEnabled) {
+        std::printf("%-14s", "");
+        for (size_t i = 0; i < result.allocsBySubsystem.size(); ++i) {
+            const Core::AllocCounts& counts = result.allocsBySubsystem[i];
+            if (counts.allocations != 0) {
+                std::printf(" %s %llu (%.1f KB)", Core::AllocTracker::GetName(static_cast<Core::AllocSubsystem>(i)),
+                            static_cast<unsigned long long>(counts.allocations), counts.bytes / 1024.0);
+            }
+        }
+        std::printf("\n");
+    }
+}
+
+bool LoadFile(const std::string& path, std::string& data) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    // A session recording (binary or asciicast) replays its output bytes;
+    // anything else is taken as raw output
+    if (auto recording = Core::PtyRecording::Parse(data)) {
+        data = std::move(recording->data);
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--help") == 0 || std::strcmp(argv[i], "-h") == 0) {
+            PrintUsage();
+            return 0;
+        }
+        if (std::strcmp(argv[i], "--list") == 0) {
+            for (const Bench::CorpusInfo& info : Bench::GetCorpora()) {
+                std::printf("%-14s %s\n", info.name, info.description);
+            }
+            return 0;
+        }
+    }
+
+    BenchOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return 2;
+    }
+
+    // What to run: a captured stream, or the selected built-in corpora
+    std::vector<std::pair<std::string, std::string>> runs;
+    if (!options.file.empty()) {
+        std::string data;
+        if (!LoadFile(options.file, data) || data.empty()) {
+            std::fprintf(stderr, "Cannot read %s\n", options.file.c_str());
+            return 1;
+        }
+        runs.emplace_back(options.file, std::move(data));
+    } else {
+        if (options.corpora.empty()) {
+            for (const Bench::CorpusInfo& info : Bench::GetCorpora()) {
+                options.corpora.emplace_back(info.name);
+            }
+        }
+        for (const std::string& name : options.corpora) {
+            // A few MB is plenty; the run loops over it
+            auto data = Bench::GenerateCorpus(name, options.rows, options.cols, 4 * 1024 * 1024);
+            if (!data) {
+                std::fprintf(stderr, "Unknown corpus: %s (see --list)\n", name.c_str());
+                return 2;
+            }
+            runs.emplace_back(name, std::move(*data));
+        }
+    }
+
+    if (options.verify || options.fuzzRuns > 0) {
+        return RunDiff(runs, options);
+    }
+    if (!options.conpty.empty()) {
+        return RunConPty(runs, options);
+    }
+
+    Bench::BenchReport report;
+    const auto writeReport = [&](int exitCode) {
+        if (exitCode == 0 && !options.json.empty() && !report.Write(options.json)) {
+            std::fprintf(stderr, "Cannot write %s\n", options.json.c_str());
+            return 1;
+        }
+        return exitCode;
+    };
+    if (options.startupRuns > 0) {
+        return writeReport(RunStartup(options, report));
+    }
+
+    std::printf("%dx%d, %zu MB per corpus, %zu byte reads\n\n", options.cols, options.rows,
+                options.megabytes, options.chunkSize);
+    std::printf("%-14s %10s %9s %11s %9s %9s %12s\n", "corpus", "MB/s", "ns/byte", "allocs/MB",
+                "p50 us", "p99 us", "KB/10k lines");
+
+    for (const auto& [name, data] : runs) {
+        BenchResult result;
+        if (!RunCorpus(data, options, result)) {
+            return 1;
+        }
+        PrintResult(name, result);
+
+        report.Add("parser." + name + ".mb_per_s", MegabytesPerSecond(result), "MB/s",
+                   Bench::MetricGoal::Higher);
+        report.Add("parser." + name + ".p99_us", result.p99Micros, "us", Bench::MetricGoal::Lower);
+        if (result.scrollbackKBPer10k > 0.0) {
+            report.Add("scrollback." + name + ".kb_per_10k_lines", result.scrollbackKBPer10k, "KB",
+                       Bench::MetricGoal::Lower);
+        }
+    }
+    return writeReport(0);
+}
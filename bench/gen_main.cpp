@@ -0,0 +1,236 @@
+// Console3 - gen_main.cpp
+// VT workload generator for benchmarks and soak tests
+//
+// Writes a built-in corpus to stdout, so Console3Bench --conpty gen measures
+// a child that produces output rather than one that copies a file. The same
+// seeded generators as the detached runs are used, so both see the same
+// kind of traffic.
+//
+// Run it as the shell of a Console3 profile (or by hand in one) to drive the
+// whole terminal. --rate paces a flood to a target throughput, --fps paces
+// full-screen repaints on the alternate screen instead, and --seconds turns
+// either into a soak test that runs for hours while the terminal's memory is
+// watched for growth (Console3.exe --diagnostics).
+//
+//   Console3BenchGen [--corpus name] [--mb N] [--seconds N] [--rate MB/s]
+//                    [--fps N] [--chunk bytes] [--rows N] [--cols N] [--list]
+
+#include "BenchCorpus.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <fcntl.h>
+#include <io.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/// Distinct frames --fps cycles through
+constexpr size_t kFrameCount = 64;
+
+/// Generator settings
+struct Options {
+    std::string corpus = "ascii-log";
+    size_t megabytes = 64;      ///< Stop after this much (0 = no limit)
+    double seconds = 0.0;       ///< Stop after this long (0 = no limit)
+    double rate = 0.0;          ///< Target MB/s (0 = as fast as the pipe takes it)
+    double fps = 0.0;           ///< Full-screen repaints per second (0 = stream the corpus)
+    size_t chunk = 64 * 1024;
+    int rows = 50;
+    int cols = 160;
+    bool list = false;
+};
+
+void PrintUsage() {
+    std::fprintf(stderr,
+        "Usage: Console3BenchGen [options]\n"
+        "  --corpus name     Corpus to write (default ascii-log; see --list)\n"
+        "  --mb N            Stop after N MB (default 64; 0 = no limit)\n"
+        "  --seconds N       Stop after N seconds (default 0 = no limit)\n"
+        "  --rate MB/s       Pace the output to this throughput (default: unpaced)\n"
+        "  --fps N           Write full-screen repaints on the alternate screen at N\n"
+        "                    per second instead of a corpus\n"
+        "  --chunk bytes     Largest single write (default 65536)\n"
+        "  --rows N          Screen height to lay out for (default 50)\n"
+        "  --cols N          Screen width to lay out for (default 160)\n"
+        "  --list            List the corpora\n"
+        "With --mb 0 and --seconds 0 it runs until killed.\n");
+}
+
+bool ParseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg == "--list") {
+            options.list = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return false;
+        }
+
+        const char* value = argv[++i];
+        if (arg == "--corpus") {
+            options.corpus = value;
+        } else if (arg == "--mb") {
+            options.megabytes = std::strtoull(value, nullptr, 10);
+        } else if (arg == "--seconds") {
+            options.seconds = std::atof(value);
+        } else if (arg == "--rate") {
+            options.rate = std::atof(value);
+        } else if (arg == "--fps") {
+            options.fps = std::atof(value);
+        } else if (arg == "--chunk") {
+            options.chunk = std::strtoull(value, nullptr, 10);
+        } else if (arg == "--rows") {
+            options.rows = std::atoi(value);
+        } else if (arg == "--cols") {
+            options.cols = std::atoi(value);
+        } else {
+            std::fprintf(stderr, "Unknown option: %s\n", argv[i - 1]);
+            return false;
+        }
+    }
+
+    if (options.chunk == 0 || options.rows <= 0 || options.cols <= 0 || options.seconds < 0.0 ||
+        options.rate < 0.0 || options.fps < 0.0) {
+        std::fprintf(stderr, "Sizes and rates must be positive\n");
+        return false;
+    }
+    return true;
+}
+
+/// Write everything, unbuffered
+bool WriteAll(const char* data, size_t length) {
+    return std::fwrite(data, 1, length, stdout) == length;
+}
+
+/// Stops a run at its byte or time limit
+class Limits {
+public:
+    explicit Limits(const Options& options)
+        : m_bytes(options.megabytes * 1024 * 1024),
+          m_end(options.seconds > 0.0
+                    ? Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                         std::chrono::duration<double>(options.seconds))
+                    : Clock::time_point::max()) {}
+
+    /// Get the most that may still be written (SIZE_MAX = no limit)
+    [[nodiscard]] size_t Remaining(size_t written) const noexcept {
+        return m_bytes == 0 ? SIZE_MAX : m_bytes - std::min(written, m_bytes);
+    }
+
+    [[nodiscard]] bool Done(size_t written) const {
+        return Remaining(written) == 0 || Clock::now() >= m_end;
+    }
+
+private:
+    size_t m_bytes;
+    Clock::time_point m_end;
+};
+
+/// Stream a corpus, looping over it, optionally paced to a throughput
+int StreamCorpus(const Options& options) {
+    // A few MB is plenty; the output loops over it
+    const auto data = Console3::Bench::GenerateCorpus(options.corpus, options.rows, options.cols,
+                                                      4 * 1024 * 1024);
+    if (!data || data->empty()) {
+        std::fprintf(stderr, "Unknown corpus: %s\n", options.corpus.c_str());
+        return 2;
+    }
+
+    // Paced: writes of about 10 ms worth, each sent once it is due
+    const double bytesPerSecond = options.rate * 1024 * 1024;
+    size_t chunk = options.chunk;
+    if (bytesPerSecond > 0.0) {
+        chunk = std::clamp(static_cast<size_t>(bytesPerSecond / 100), size_t{1}, options.chunk);
+    }
+
+    const Limits limits(options);
+    const Clock::time_point start = Clock::now();
+    size_t offset = 0;
+    for (size_t written = 0; !limits.Done(written);) {
+        if (bytesPerSecond > 0.0) {
+            const auto due = start + std::chrono::duration_cast<Clock::duration>(
+                                         std::chrono::duration<double>(written / bytesPerSecond));
+            std::this_thread::sleep_until(due);
+        }
+
+        if (offset >= data->size()) {
+            offset = 0;
+        }
+        const size_t length = std::min({chunk, data->size() - offset, limits.Remaining(written)});
+        if (!WriteAll(data->data() + offset, length)) {
+            return 1;
+        }
+        offset += length;
+        written += length;
+    }
+    return 0;
+}
+
+/// Repaint the alternate screen at a frame rate
+int PaintFrames(const Options& options) {
+    const auto frames = Console3::Bench::GenerateFrames(options.rows, options.cols, kFrameCount);
+    const auto interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / options.fps));
+
+    static constexpr char kEnter[] = "\x1b[?1049h\x1b[?25l";
+    static constexpr char kLeave[] = "\x1b[0m\x1b[?25h\x1b[?1049l";
+    if (!WriteAll(kEnter, sizeof(kEnter) - 1)) {
+        return 1;
+    }
+
+    // Frames are due on a fixed clock; after one written late the clock
+    // restarts from now instead of bursting to catch up
+    const Limits limits(options);
+    Clock::time_point due = Clock::now();
+    size_t written = 0;
+    for (size_t frame = 0; !limits.Done(written); ++frame) {
+        std::this_thread::sleep_until(due);
+        const std::string& data = frames[frame % frames.size()];
+        if (!WriteAll(data.data(), data.size())) {
+            return 1;
+        }
+        written += data.size();
+
+        due += interval;
+        const Clock::time_point now = Clock::now();
+        if (due < now) {
+            due = now;
+        }
+    }
+    return WriteAll(kLeave, sizeof(kLeave) - 1) ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return 2;
+    }
+
+    if (options.list) {
+        for (const auto& corpus : Console3::Bench::GetCorpora()) {
+            std::printf("%-14s %s\n", corpus.name, corpus.description);
+        }
+        return 0;
+    }
+
+    // Bytes go out as generated: no newline translation, no stdio buffering
+    _setmode(_fileno(stdout), _O_BINARY);
+    std::setvbuf(stdout, nullptr, _IONBF, 0);
+
+    return options.fps > 0.0 ? PaintFrames(options) : StreamCorpus(options);
+}
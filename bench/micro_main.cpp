@@ -0,0 +1,422 @@
+// Console3 - micro_main.cpp
+// Microbenchmarks of the hot paths, for regression tracking
+//
+// Where Console3Bench replays whole corpora through a session, these time
+// one operation at a time with google/benchmark: the output ring at
+// different chunk sizes with and without a producer thread, the terminal
+// buffer's scroll, cell, text and resize operations, libvterm parsing each
+// built-in corpus, a detached session syncing full-screen redraws, and
+// copying a selection out of the buffer.
+//
+// Results are written as JSON unless another --benchmark_format is given,
+// so runs can be stored and compared (google/benchmark's compare.py). In an
+// ALLOC_TRACKING build each benchmark also reports its heap allocations:
+// the totals through google/benchmark's memory manager, and per iteration
+// by subsystem as allocs_<name> and bytes_<name> counters.
+//
+//   Console3Benchmarks [--benchmark_filter=regex] [--benchmark_out=file]
+
+#include "BenchCorpus.h"
+#include "Core/AllocTracker.h"
+#include "Core/RingBuffer.h"
+#include "Core/SegmentedRingBuffer.h"
+#include "Core/Session.h"
+#include "Core/TerminalBuffer.h"
+#include "Emulation/VTermWrapper.h"
+#include "UI/TerminalView.h"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// The UI library's windows refer to the application's WTL module
+CAppModule _Module;
+
+using namespace Console3;
+
+namespace {
+
+constexpr int kRows = 50;
+constexpr int kCols = 160;
+
+/// Corpus bytes parsed per benchmark iteration
+constexpr size_t kCorpusBytes = 1024 * 1024;
+
+/// Adds a benchmark's allocations by subsystem to its counters when it
+/// finishes (instrumented builds; see AllocTracker.h)
+class SubsystemAllocs {
+public:
+    explicit SubsystemAllocs(benchmark::State& state) : m_state(state), m_before(Core::AllocTracker::Snapshot()) {}
+
+    ~SubsystemAllocs() {
+        if constexpr (Core::AllocTracker::kEnabled) {
+            const Core::AllocSnapshot after = Core::AllocTracker::Snapshot();
+            for (size_t i = 0; i < after.size(); ++i) {
+                const std::string name = Core::AllocTracker::GetName(static_cast<Core::AllocSubsystem>(i));
+                m_state.counters["allocs_" + name] = benchmark::Counter(
+                    static_cast<double>(after[i].allocations - m_before[i].allocations),
+                    benchmark::Counter::kAvgIterations);
+                m_state.counters["bytes_" + name] = benchmark::Counter(
+                    static_cast<double>(after[i].bytes - m_before[i].bytes), benchmark::Counter::kAvgIterations);
+            }
+        }
+    }
+
+    SubsystemAllocs(const SubsystemAllocs&) = delete;
+    SubsystemAllocs& operator=(const SubsystemAllocs&) = delete;
+
+private:
+    benchmark::State& m_state;
+    Core::AllocSnapshot m_before;
+};
+
+/// Allocation totals for google/benchmark's memory measurement run
+class TrackerMemoryManager : public benchmark::MemoryManager {
+public:
+    void Start() override { m_before = Core::AllocTracker::Total(); }
+
+    void Stop(Result& result) override {
+        const Core::AllocCounts after = Core::AllocTracker::Total();
+        result.num_allocs = static_cast<int64_t>(after.allocations - m_before.allocations);
+        result.total_allocated_bytes = static_cast<int64_t>(after.bytes - m_before.bytes);
+    }
+
+private:
+    Core::AllocCounts m_before;
+};
+
+/// A buffer with every screen cell and some scrollback filled
+Core::TerminalBuffer MakeFilledBuffer(size_t scrollbackLines) {
+    Core::TerminalBuffer buffer({kRows, kCols, scrollbackLines + 1});
+    Core::Cell cell;
+    for (int row = 0; row < kRows; ++row) {
+        for (int col = 0; col < kCols; ++col) {
+            cell.SetCodepoint(U'a' + static_cast<uint32_t>((row + col) % 26));
+            buffer.SetCell(row, col, cell);
+        }
+    }
+    for (size_t line = 0; line < scrollbackLines; ++line) {
+        buffer.PushScrollback(buffer.GetRow(static_cast<int>(line % kRows)));
+    }
+    buffer.ClearDirty();
+    return buffer;
+}
+
+// ============================================================================
+// RingBuffer
+// ============================================================================
+
+/// Write a chunk and read it back on one thread
+void BM_RingBuffer_WriteRead(benchmark::State& state) {
+    const auto chunk = static_cast<size_t>(state.range(0));
+    Core::RingBuffer<char> ring(1024 * 1024);
+    std::vector<char> in(chunk, 'x');
+    std::vector<char> out(chunk);
+
+    SubsystemAllocs allocs(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ring.Write(in.data(), chunk));
+        benchmark::DoNotOptimize(ring.Read(out.data(), chunk));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * chunk));
+}
+BENCHMARK(BM_RingBuffer_WriteRead)->RangeMultiplier(8)->Range(64, 64 * 1024);
+
+/// Read chunks while a producer thread keeps the ring full
+void BM_RingBuffer_Contended(benchmark::State& state) {
+    const auto chunk = static_cast<size_t>(state.range(0));
+    Core::RingBuffer<char> ring(256 * 1024);
+    std::atomic<bool> stop{false};
+    std::thread producer([&]() {
+        std::vector<char> in(chunk, 'x');
+        while (!stop.load(std::memory_order_relaxed)) {
+            if (ring.Write(in.data(), chunk) == 0) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::vector<char> out(chunk);
+    size_t bytes = 0;
+    SubsystemAllocs allocs(state);
+    for (auto _ : state) {
+        size_t got = 0;
+        while (got == 0) {
+            got = ring.Read(out.data(), chunk);
+        }
+        bytes += got;
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+
+    stop.store(true);
+    producer.join();
+}
+BENCHMARK(BM_RingBuffer_Contended)->RangeMultiplier(8)->Range(64, 64 * 1024)->UseRealTime();
+
+/// Small writes from a producer thread, read in 4 KB chunks: the traffic
+/// the cached indices are for. Cached = false loads the other side's index
+/// on every call (the protocol before them); Batch > 1 stages that many
+/// writes per publish.
+template <bool Cached, int Batch>
+void BM_RingBuffer_SmallWrites(benchmark::State& state) {
+    const auto chunk = static_cast<size_t>(state.range(0));
+    Core::RingBuffer<char, Cached> ring(256 * 1024);
+    std::atomic<bool> stop{false};
+    std::thread producer([&]() {
+        std::vector<char> in(chunk, 'x');
+        int staged = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+            if (ring.Stage(in.data(), chunk) == 0) {
+                ring.Publish();
+                staged = 0;
+                std::this_thread::yield();
+            } else if (++staged == Batch) {
+                ring.Publish();
+                staged = 0;
+            }
+        }
+    });
+
+    std::vector<char> out(4096);
+    size_t bytes = 0;
+    SubsystemAllocs allocs(state);
+    for (auto _ : state) {
+        size_t got = 0;
+        while (got == 0) {
+            got = ring.Read(out.data(), out.size());
+        }
+        bytes += got;
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+
+    stop.store(true);
+    producer.join();
+}
+BENCHMARK_TEMPLATE(BM_RingBuffer_SmallWrites, false, 1)->Arg(16)->Arg(64)->Arg(256)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_RingBuffer_SmallWrites, true, 1)->Arg(16)->Arg(64)->Arg(256)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_RingBuffer_SmallWrites, true, 16)->Arg(16)->Arg(64)->Arg(256)->UseRealTime();
+
+/// The same traffic through the chunked ring sessions use; Batch > 1
+/// stages that many writes per publish
+template <int Batch>
+void BM_SegmentedRing_SmallWrites(benchmark::State& state) {
+    const auto chunk = static_cast<size_t>(state.range(0));
+    Core::SegmentedRingBuffer ring(256 * 1024);
+    std::atomic<bool> stop{false};
+    std::thread producer([&]() {
+        std::vector<char> in(chunk, 'x');
+        int staged = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+            if (ring.Stage(in.data(), chunk) == 0) {
+                ring.Publish();
+                staged = 0;
+                std::this_thread::yield();
+            } else if (++staged == Batch) {
+                ring.Publish();
+                staged = 0;
+            }
+        }
+    });
+
+    std::vector<char> out(4096);
+    size_t bytes = 0;
+    SubsystemAllocs allocs(state);
+    for (auto _ : state) {
+        size_t got = 0;
+        while (got == 0) {
+            got = ring.Read(out.data(), out.size());
+        }
+        bytes += got;
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+
+    stop.store(true);
+    producer.join();
+}
+BENCHMARK_TEMPLATE(BM_SegmentedRing_SmallWrites, 1)->Arg(16)->Arg(64)->Arg(256)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_SegmentedRing_SmallWrites, 16)->Arg(16)->Arg(64)->Arg(256)->UseRealTime();
+
+// ============================================================================
+// TerminalBuffer
+// ============================================================================
+
+/// Scroll the whole screen by a line, pushing into a full scrollback
+void BM_TerminalBuffer_Scroll(benchmark::State& state) {
+    Core::TerminalBuffer buffer = MakeFilledBuffer(Core::ScrollbackStore::kDefaultHotLines);
+    SubsystemAllocs allocs(state);
+    for (auto _ : state) {
+        buffer.Scroll(1, 0, kRows);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TerminalBuffer_Scroll);
+
+/// Write every cell of the screen
+void BM_TerminalBuffer_SetCell(benchmark::State& state) {
+    Core::TerminalBuffer buffer({kRows, kCols, 0});
+    Core::Cell cell;
+    cell.SetCodepoint(U'x');
+    SubsystemAllocs allocs(state);
+    for (auto _ : state) {
+        for (int row = 0; row < kRows; ++row) {
+            for (int col = 0; col < kCols; ++col) {
+                buffer.SetCell(row, col, cell);
+            }
+        }
+        buffer.ClearDirty();
+    }
+    state.SetItemsProcessed(state.iterations() * kRows * kCols);
+}
+BENCHMARK(BM_TerminalBuffer_SetCell);
+
+/// Read every screen row as UTF-8
+void BM_TerminalBuffer_GetRowText(benchmark::State& state) {
+    const Core::TerminalBuffer buffer = MakeFilledBuffer(0);
+    SubsystemAllocs allocs(state);
+    for (auto _ : state) {
+        for (int row = 0; row < kRows; ++row) {
+            benchmark::DoNotOptimize(buffer.GetRowText(row));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kRows);
+}
+BENCHMARK(BM_TerminalBuffer_GetRowText);
+
+/// Re-wrap the screen to a narrower width and back
+void BM_TerminalBuffer_Resize(benchmark::State& state) {
+    Core::TerminalBuffer buffer = MakeFilledBuffer(0);
+    SubsystemAllocs allocs(state);
+    for (auto _ : state) {
+        buffer.Resize(kRows, kCols / 2);
+        buffer.Resize(kRows, kCols);
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_TerminalBuffer_Resize);
+
+// ============================================================================
+// Emulation
+// ============================================================================
+
+/// Parse a corpus with libvterm's screen layer
+void BM_VTerm_InputWrite(benchmark::State& state, const std::string& corpus) {
+    Emulation::VTermWrapper vterm(kRows, kCols);
+    SubsystemAllocs allocs(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(vterm.InputWrite(corpus.data(), corpus.size()));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * corpus.size()));
+}
+
+/// Redraw the whole screen through a detached session: parse, damage
+/// callbacks and the sync of every cell into the terminal buffer
+void BM_Session_FullScreenSync(benchmark::State& state) {
+    Core::SessionConfig config;
+    config.rows = kRows;
+    config.cols = kCols;
+    config.fastForwardBytesPerSec = 0;  // Every frame reaches the buffer
+    Core::Session session;
+    if (!session.StartDetached(config)) {
+        state.SkipWithError("session did not start");
+        return;
+    }
+
+    // Two frames that differ in every cell, so each one damages everything
+    std::string frames[2];
+    for (int frame = 0; frame < 2; ++frame) {
+        frames[frame] = "\x1b[H";
+        for (int row = 0; row < kRows; ++row) {
+            frames[frame] += row % 2 ? "\x1b[1;32m" : "\x1b[0m";
+            frames[frame].append(kCols, static_cast<char>('A' + (row + frame) % 26));
+        }
+    }
+
+    size_t bytes = 0;
+    SubsystemAllocs allocs(state);
+    for (auto _ : state) {
+        for (const std::string& frame : frames) {
+            bytes += session.FeedOutput(frame.data(), frame.size());
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+    state.SetItemsProcessed(state.iterations() * 2);
+    session.Stop();
+}
+BENCHMARK(BM_Session_FullScreenSync);
+
+// ============================================================================
+// Selection
+// ============================================================================
+
+/// Copy a selection spanning the scrollback and the screen
+void BM_Selection_Export(benchmark::State& state) {
+    const auto lines = static_cast<int64_t>(state.range(0));
+    const Core::TerminalBuffer buffer = MakeFilledBuffer(static_cast<size_t>(lines));
+
+    UI::Selection selection;
+    selection.startLine = static_cast<int64_t>(buffer.GetScreenLine()) - lines;
+    selection.endLine = static_cast<int64_t>(buffer.GetScreenLine()) + kRows - 1;
+    selection.endCol = kCols;
+    selection.epoch = buffer.GetScrollbackEpoch();
+    selection.active = true;
+
+    SubsystemAllocs allocs(state);
+    for (auto _ : state) {
+        HGLOBAL text = selection.Export(buffer);
+        benchmark::DoNotOptimize(text);
+        if (text) {
+            GlobalFree(text);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * (lines + kRows));
+}
+BENCHMARK(BM_Selection_Export)->Arg(0)->Arg(1000)->Arg(10000);
+
+/// Register the parse benchmark once per built-in corpus
+void RegisterCorpusBenchmarks() {
+    for (const Bench::CorpusInfo& info : Bench::GetCorpora()) {
+        std::optional<std::string> corpus = Bench::GenerateCorpus(info.name, kRows, kCols, kCorpusBytes);
+        if (!corpus) {
+            continue;
+        }
+        benchmark::RegisterBenchmark((std::string("BM_VTerm_InputWrite/") + info.name).c_str(),
+                                     [data = std::move(*corpus)](benchmark::State& state) {
+                                         BM_VTerm_InputWrite(state, data);
+                                     });
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    // JSON unless the caller picked a format
+    std::vector<char*> args(argv, argv + argc);
+    bool formatGiven = false;
+    for (const char* arg : args) {
+        formatGiven = formatGiven || std::strncmp(arg, "--benchmark_format", 18) == 0;
+    }
+    static char jsonFormat[] = "--benchmark_format=json";
+    if (!formatGiven) {
+        args.insert(args.begin() + (args.empty() ? 0 : 1), jsonFormat);
+    }
+
+    int count = static_cast<int>(args.size());
+    RegisterCorpusBenchmarks();
+
+    TrackerMemoryManager memoryManager;
+    if constexpr (Core::AllocTracker::kEnabled) {
+        benchmark::RegisterMemoryManager(&memoryManager);
+    }
+    benchmark::Initialize(&count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(count, args.data())) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,545 @@
+// Console3 - perfcheck_main.cpp
+// Performance regression gate: runs the benchmark suites against a baseline
+//
+// Runs the suites built next to this executable, keeps the best of --runs
+// repetitions of every metric (BenchReport.h) and compares them with a
+// checked-in baseline:
+//
+//   parser    Console3Bench: MB/s and p99 read latency per corpus, and the
+//             scrollback memory per 10,000 lines each corpus left behind
+//   startup   Console3Bench --startup: session Start() to the shell's first
+//             output on screen
+//   render    Console3RenderBench: mean and p99 frame time per scene and
+//             renderer configuration (scroll-log is scrolling as painted)
+//   scroll    Console3Benchmarks (google/benchmark): TerminalBuffer scroll
+//             and full-screen sync, when the microbenchmarks are built
+//
+// A metric regresses when it is worse than its baseline by more than its
+// tolerance (its own, or the baseline's threshold). Every metric is listed
+// with its change, and the exit code is 1 if anything regressed, so the
+// perf-check target and the CTest test fail. A metric without a baseline
+// value checks nothing: with no regressions elsewhere the exit code is 77
+// (kExitNoBaseline), which CTest reports as skipped rather than passed,
+// as it does a run where no suite was built. --update writes what was
+// measured into the baseline instead, keeping its tolerances.
+//
+// Numbers belong to the machine they were measured on: the checked-in
+// baseline is the reference machine's, and contributors compare against
+// their own with --baseline (the CONSOLE3_PERF_BASELINE CMake variable).
+//
+//   Console3PerfCheck [--baseline path] [--suite name[,name...]] [--runs N]
+//                     [--threshold percent] [--update] [--verbose] [--list]
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+
+#include "BenchReport.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+using namespace Console3;
+
+/// A benchmark run the gate knows how to start
+struct Suite {
+    const char* name;
+    const char* description;
+    const wchar_t* executable;
+    const wchar_t* arguments;
+    bool googleBenchmark;                   ///< Results in google/benchmark's JSON
+    std::array<const char*, 2> prefixes;    ///< First name component of its metrics
+};
+
+constexpr Suite kSuites[] = {
+    {"parser", "Parser throughput, read latency and scrollback memory per corpus",
+     L"Console3Bench.exe", L"--mb 32", false, {"parser", "scrollback"}},
+    {"startup", "Session start to the shell's first output",
+     L"Console3Bench.exe", L"--startup 5", false, {"startup", nullptr}},
+    {"render", "Frame times per scene and renderer configuration",
+     L"Console3RenderBench.exe", L"--frames 300", false, {"render", nullptr}},
+    {"scroll", "TerminalBuffer scroll and full-screen sync (microbenchmarks)",
+     L"Console3Benchmarks.exe", L"--benchmark_filter=BM_TerminalBuffer_Scroll|BM_Session_FullScreenSync",
+     true, {"scroll", nullptr}},
+};
+
+/// Exit code when nothing regressed but some metric could not be checked
+/// (the perf-check test's SKIP_RETURN_CODE)
+constexpr int kExitNoBaseline = 77;
+
+/// Tolerance when neither the metric nor the baseline has one
+constexpr double kDefaultThreshold = 0.10;
+
+/// Command line options
+struct CheckOptions {
+    std::string baseline = "perf-baseline.json";
+    std::vector<std::string> suites;    ///< Suites to run (empty = all)
+    unsigned runs = 3;                  ///< Repetitions per suite, best kept
+    std::optional<double> threshold;    ///< Overrides the baseline's threshold
+    bool update = false;                ///< Write the baseline instead of checking
+    bool verbose = false;               ///< Show the suites' own output
+};
+
+/// One metric of the baseline
+struct BaselineEntry {
+    std::string name;
+    std::optional<double> value;        ///< Not recorded yet when empty
+    std::string unit;
+    Bench::MetricGoal goal = Bench::MetricGoal::Lower;
+    std::optional<double> tolerance;
+};
+
+/// The checked-in reference numbers
+struct Baseline {
+    double threshold = kDefaultThreshold;
+    std::string machine;                ///< Where the numbers were recorded
+    std::vector<BaselineEntry> entries;
+};
+
+void PrintUsage() {
+    std::printf(
+        "Usage: Console3PerfCheck [options]\n"
+        "  --baseline path   Baseline to compare with (default perf-baseline.json)\n"
+        "  --suite a,b       Suites to run (default: all, see --list)\n"
+        "  --runs N          Runs per suite, best result kept (default 3)\n"
+        "  --threshold pct   Tolerance for metrics without their own (default: the baseline's)\n"
+        "  --update          Record the results as the new baseline instead of checking\n"
+        "  --verbose         Show the suites' own output\n"
+        "  --list            List suites\n");
+}
+
+bool ParseOptions(int argc, char** argv, CheckOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        const bool takesValue = arg == "--baseline" || arg == "--suite" || arg == "--runs" ||
+                                arg == "--threshold";
+        if (takesValue && !value) {
+            std::fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return false;
+        }
+
+        if (arg == "--baseline") {
+            options.baseline = value;
+        } else if (arg == "--suite") {
+            std::string_view list = value;
+            while (!list.empty()) {
+                const size_t comma = list.find(',');
+                options.suites.emplace_back(list.substr(0, comma));
+                list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+            }
+        } else if (arg == "--runs") {
+            options.runs = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--threshold") {
+            options.threshold = std::atof(value) / 100.0;
+        } else if (arg == "--update") {
+            options.update = true;
+        } else if (arg == "--verbose") {
+            options.verbose = true;
+        } else {
+            std::fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return false;
+        }
+        if (takesValue) {
+            ++i;
+        }
+    }
+
+    if (options.runs == 0 || (options.threshold && *options.threshold <= 0.0)) {
+        std::fprintf(stderr, "Runs and threshold must be positive\n");
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// Baseline file
+// ============================================================================
+
+std::optional<Baseline> LoadBaseline(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        return Baseline{};  // First --update creates it
+    }
+
+    const nlohmann::ordered_json json = nlohmann::ordered_json::parse(file, nullptr, false);
+    if (json.is_discarded() || !json.is_object()) {
+        return std::nullopt;
+    }
+
+    Baseline baseline;
+    baseline.threshold = json.value("threshold", kDefaultThreshold);
+    baseline.machine = json.value("machine", std::string());
+    if (json.contains("metrics") && json["metrics"].is_object()) {
+        for (const auto& [name, entry] : json["metrics"].items()) {
+            BaselineEntry parsed;
+            parsed.name = name;
+            if (entry.contains("value") && entry["value"].is_number()) {
+                parsed.value = entry["value"].get<double>();
+            }
+            parsed.unit = entry.value("unit", std::string());
+            parsed.goal = Bench::BenchReport::ParseGoal(entry.value("better", std::string()))
+                              .value_or(Bench::MetricGoal::Lower);
+            if (entry.contains("tolerance") && entry["tolerance"].is_number()) {
+                parsed.tolerance = entry["tolerance"].get<double>();
+            }
+            baseline.entries.push_back(std::move(parsed));
+        }
+    }
+    return baseline;
+}
+
+bool WriteBaseline(const std::string& path, const Baseline& baseline) {
+    nlohmann::ordered_json metrics = nlohmann::ordered_json::object();
+    for (const BaselineEntry& entry : baseline.entries) {
+        nlohmann::ordered_json json;
+        json["value"] = entry.value ? nlohmann::ordered_json(*entry.value) : nlohmann::ordered_json();
+        json["unit"] = entry.unit;
+        json["better"] = Bench::BenchReport::GetGoalName(entry.goal);
+        if (entry.tolerance) {
+            json["tolerance"] = *entry.tolerance;
+        }
+        metrics[entry.name] = std::move(json);
+    }
+
+    nlohmann::ordered_json json;
+    json["threshold"] = baseline.threshold;
+    json["machine"] = baseline.machine;
+    json["metrics"] = std::move(metrics);
+
+    std::ofstream file(path, std::ios::trunc);
+    file << json.dump(2) << '\n';
+    return static_cast<bool>(file);
+}
+
+// ============================================================================
+// Running the suites
+// ============================================================================
+
+/// Directory of this executable, with a trailing separator
+std::wstring GetExecutableDirectory() {
+    wchar_t path[MAX_PATH];
+    const DWORD length = GetModuleFileNameW(nullptr, path, MAX_PATH);
+    if (length == 0 || length == MAX_PATH) {
+        return {};
+    }
+    std::wstring directory(path, length);
+    const size_t slash = directory.find_last_of(L"\\/");
+    directory.resize(slash == std::wstring::npos ? 0 : slash + 1);
+    return directory;
+}
+
+std::wstring GetTempFile() {
+    wchar_t directory[MAX_PATH];
+    wchar_t path[MAX_PATH];
+    if (GetTempPathW(MAX_PATH, directory) == 0 || GetTempFileNameW(directory, L"c3p", 0, path) == 0) {
+        return {};
+    }
+    return path;
+}
+
+std::string Narrow(const std::wstring& text) {
+    const int length = WideCharToMultiByte(CP_ACP, 0, text.c_str(), -1, nullptr, 0, nullptr, nullptr);
+    std::string result(length > 0 ? length - 1 : 0, '\0');
+    WideCharToMultiByte(CP_ACP, 0, text.c_str(), -1, result.data(), length, nullptr, nullptr);
+    return result;
+}
+
+/// Run a command line and wait for it
+/// @return Its exit code, or -1 if it could not be started
+int RunProcess(std::wstring commandLine, bool showOutput) {
+    STARTUPINFOW startup{};
+    startup.cb = sizeof(startup);
+
+    // The suites print tables of their own; keep them out of the report
+    SECURITY_ATTRIBUTES inherit{sizeof(inherit), nullptr, TRUE};
+    HANDLE nul = INVALID_HANDLE_VALUE;
+    if (!showOutput) {
+        nul = CreateFileW(L"NUL", GENERIC_WRITE, FILE_SHARE_WRITE, &inherit, OPEN_EXISTING, 0, nullptr);
+        startup.dwFlags = STARTF_USESTDHANDLES;
+        startup.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+        startup.hStdOutput = nul;
+        startup.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+    }
+
+    PROCESS_INFORMATION process{};
+    const BOOL started = CreateProcessW(nullptr, commandLine.data(), nullptr, nullptr, TRUE, 0, nullptr,
+                                       nullptr, &startup, &process);
+    if (nul != INVALID_HANDLE_VALUE) {
+        CloseHandle(nul);
+    }
+    if (!started) {
+        return -1;
+    }
+
+    WaitForSingleObject(process.hProcess, INFINITE);
+    DWORD exitCode = 1;
+    GetExitCodeProcess(process.hProcess, &exitCode);
+    CloseHandle(process.hThread);
+    CloseHandle(process.hProcess);
+    return static_cast<int>(exitCode);
+}
+
+/// Read google/benchmark's JSON output as metrics (nanoseconds per iteration)
+std::optional<Bench::BenchReport> LoadGoogleBenchmark(const std::string& path, const char* prefix) {
+    std::ifstream file(path);
+    const nlohmann::json json = nlohmann::json::parse(file, nullptr, false);
+    if (json.is_discarded() || !json.contains("benchmarks")) {
+        return std::nullopt;
+    }
+
+    Bench::BenchReport report;
+    for (const nlohmann::json& entry : json["benchmarks"]) {
+        if (entry.value("run_type", std::string("iteration")) != "iteration" || !entry.contains("real_time")) {
+            continue;
+        }
+        const std::string unit = entry.value("time_unit", std::string("ns"));
+        const double scale = unit == "s" ? 1e9 : unit == "ms" ? 1e6 : unit == "us" ? 1e3 : 1.0;
+        report.Add(std::string(prefix) + "." + entry["name"].get<std::string>() + ".ns",
+                   entry["real_time"].get<double>() * scale, "ns", Bench::MetricGoal::Lower);
+    }
+    return report;
+}
+
+/// Run one suite once
+/// @return Its metrics, or nullopt if it failed (missing is set when it isn't built)
+std::optional<Bench::BenchReport> RunSuite(const Suite& suite, const CheckOptions& options, bool& missing) {
+    const std::wstring executable = GetExecutableDirectory() + suite.executable;
+    missing = GetFileAttributesW(executable.c_str()) == INVALID_FILE_ATTRIBUTES;
+    if (missing) {
+        return std::nullopt;
+    }
+
+    const std::wstring output = GetTempFile();
+    if (output.empty()) {
+        return std::nullopt;
+    }
+
+    std::wstring commandLine = L"\"" + executable + L"\" " + suite.arguments;
+    commandLine += suite.googleBenchmark
+        ? L" --benchmark_out_format=json \"--benchmark_out=" + output + L"\""
+        : L" --json \"" + output + L"\"";
+
+    const int exitCode = RunProcess(std::move(commandLine), options.verbose);
+    std::optional<Bench::BenchReport> report;
+    if (exitCode == 0) {
+        report = suite.googleBenchmark ? LoadGoogleBenchmark(Narrow(output), suite.prefixes[0])
+                                       : Bench::BenchReport::Load(Narrow(output));
+    }
+    DeleteFileW(output.c_str());
+    return report;
+}
+
+// ============================================================================
+// Comparison
+// ============================================================================
+
+bool BelongsTo(const std::string& metric, const Suite& suite) {
+    const std::string_view first = std::string_view(metric).substr(0, metric.find('.'));
+    return std::any_of(suite.prefixes.begin(), suite.prefixes.end(),
+                       [first](const char* prefix) { return prefix && first == prefix; });
+}
+
+std::string FormatValue(double value, const std::string& unit) {
+    char text[64];
+    std::snprintf(text, sizeof(text), std::fabs(value) >= 100.0 ? "%.1f %s" : "%.3f %s", value, unit.c_str());
+    return text;
+}
+
+/// Print the comparison table
+/// @param unchecked Set to the number of metrics measured without a baseline value
+/// @return Number of regressions
+size_t Compare(const Baseline& baseline, const Bench::BenchReport& measured,
+               const std::vector<const Suite*>& suites, double threshold, size_t& unchecked) {
+    std::printf("%-46s %16s %16s %8s  %s\n", "metric", "baseline", "current", "change", "status");
+
+    size_t regressions = 0;
+    unchecked = 0;
+    for (const BaselineEntry& entry : baseline.entries) {
+        const bool ran = std::any_of(suites.begin(), suites.end(),
+                                     [&](const Suite* suite) { return BelongsTo(entry.name, *suite); });
+        if (!ran) {
+            continue;
+        }
+
+        const Bench::Metric* metric = measured.Find(entry.name);
+        const std::string base = entry.value ? FormatValue(*entry.value, entry.unit) : "-";
+        if (!metric) {
+            std::printf("%-46s %16s %16s %8s  %s\n", entry.name.c_str(), base.c_str(), "-", "", "not measured");
+            continue;
+        }
+
+        const std::string current = FormatValue(metric->value, metric->unit);
+        if (!entry.value || *entry.value == 0.0) {
+            std::printf("%-46s %16s %16s %8s  %s\n", entry.name.c_str(), base.c_str(), current.c_str(), "",
+                        "no baseline");
+            ++unchecked;
+            continue;
+        }
+
+        // Positive change is better whichever way the metric goes
+        const double change = (metric->value - *entry.value) / *entry.value;
+        const double improvement = entry.goal == Bench::MetricGoal::Higher ? change : -change;
+        const double tolerance = entry.tolerance.value_or(threshold);
+        const char* status = improvement < -tolerance ? "REGRESSED"
+                           : improvement > tolerance  ? "better"
+                                                      : "ok";
+        if (improvement < -tolerance) {
+            ++regressions;
+        }
+        std::printf("%-46s %16s %16s %+7.1f%%  %s\n", entry.name.c_str(), base.c_str(), current.c_str(),
+                    change * 100.0, status);
+    }
+
+    // Measured but not in the baseline yet
+    for (const Bench::Metric& metric : measured.GetMetrics()) {
+        const bool known = std::any_of(baseline.entries.begin(), baseline.entries.end(),
+                                       [&](const BaselineEntry& entry) { return entry.name == metric.name; });
+        if (!known) {
+            std::printf("%-46s %16s %16s %8s  %s\n", metric.name.c_str(), "-",
+                        FormatValue(metric.value, metric.unit).c_str(), "", "new");
+            ++unchecked;
+        }
+    }
+    return regressions;
+}
+
+/// Record measured values in the baseline, keeping tolerances and metrics
+/// of suites that did not run
+void UpdateBaseline(Baseline& baseline, const Bench::BenchReport& measured) {
+    for (const Bench::Metric& metric : measured.GetMetrics()) {
+        auto entry = std::find_if(baseline.entries.begin(), baseline.entries.end(),
+                                  [&](const BaselineEntry& e) { return e.name == metric.name; });
+        if (entry == baseline.entries.end()) {
+            baseline.entries.push_back(BaselineEntry{metric.name});
+            entry = std::prev(baseline.entries.end());
+        }
+        entry->value = metric.value;
+        entry->unit = metric.unit;
+        entry->goal = metric.goal;
+    }
+
+    wchar_t computer[MAX_COMPUTERNAME_LENGTH + 1];
+    DWORD length = MAX_COMPUTERNAME_LENGTH + 1;
+    if (GetComputerNameW(computer, &length)) {
+        baseline.machine = Narrow(std::wstring(computer, length));
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            PrintUsage();
+            return 0;
+        }
+        if (arg == "--list") {
+            for (const Suite& suite : kSuites) {
+                std::printf("%-10s %s\n", suite.name, suite.description);
+            }
+            return 0;
+        }
+    }
+
+    CheckOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return 2;
+    }
+
+    std::vector<const Suite*> suites;
+    for (const Suite& suite : kSuites) {
+        if (options.suites.empty() ||
+            std::find(options.suites.begin(), options.suites.end(), suite.name) != options.suites.end()) {
+            suites.push_back(&suite);
+        }
+    }
+    if (suites.size() != (options.suites.empty() ? std::size(kSuites) : options.suites.size())) {
+        std::fprintf(stderr, "Unknown suite (see --list)\n");
+        return 2;
+    }
+
+    std::optional<Baseline> baseline = LoadBaseline(options.baseline);
+    if (!baseline) {
+        std::fprintf(stderr, "Cannot parse %s\n", options.baseline.c_str());
+        return 2;
+    }
+
+    // Best of the runs: noise only ever makes a run slower
+    Bench::BenchReport measured;
+    std::vector<const Suite*> ran;
+    for (const Suite* suite : suites) {
+        std::printf("Running %s (%u run%s)...\n", suite->name, options.runs, options.runs == 1 ? "" : "s");
+        bool missing = false;
+        for (unsigned run = 0; run < options.runs; ++run) {
+            std::optional<Bench::BenchReport> report = RunSuite(*suite, options, missing);
+            if (missing) {
+                break;
+            }
+            if (!report) {
+                std::fprintf(stderr, "%s failed; run it with --verbose to see why\n", suite->name);
+                return 1;
+            }
+            measured.MergeBest(*report);
+        }
+        if (missing) {
+            std::printf("  skipped: %ls is not built\n", suite->executable);
+        } else {
+            ran.push_back(suite);
+        }
+    }
+    std::printf("\n");
+
+    if (options.update) {
+        UpdateBaseline(*baseline, measured);
+        if (!WriteBaseline(options.baseline, *baseline)) {
+            std::fprintf(stderr, "Cannot write %s\n", options.baseline.c_str());
+            return 1;
+        }
+        std::printf("Recorded %zu metrics in %s\n", measured.GetMetrics().size(), options.baseline.c_str());
+        return 0;
+    }
+
+    if (!baseline->machine.empty()) {
+        std::printf("Baseline recorded on %s\n", baseline->machine.c_str());
+    }
+    size_t unchecked = 0;
+    const size_t regressions =
+        Compare(*baseline, measured, ran, options.threshold.value_or(baseline->threshold), unchecked);
+    std::printf("\n%zu regression%s\n", regressions, regressions == 1 ? "" : "s");
+    if (regressions != 0) {
+        return 1;
+    }
+
+    // Passing would claim a check that never happened
+    if (ran.empty()) {
+        std::printf("No suite is built; nothing was checked\n");
+        return kExitNoBaseline;
+    }
+    if (unchecked != 0) {
+        std::printf("%zu metric%s without a baseline value; record one with the perf-baseline target\n",
+                    unchecked, unchecked == 1 ? " has" : "s have");
+        return kExitNoBaseline;
+    }
+    return 0;
+}
@@ -0,0 +1,526 @@
+// Console3 - render_main.cpp
+// Render benchmark: scripted frames painted offscreen
+//
+// Plays each scene (RenderScenes.h) through a detached Core::Session into a
+// hidden TerminalView, and paints every frame with the real render path -
+// frame retention, row damage, glyph atlas, box drawing, ligature shaping or
+// the cell grid shader. The offscreen backend draws into a texture that is
+// never presented, so a frame's time is the CPU work plus waiting for the
+// GPU to finish it, without the compositor's clock in it. Each scene runs
+// once per renderer configuration; the first frame, which fills the atlas,
+// is reported apart from the rest.
+//
+// --golden dir keeps the last frame of each run as a bitmap: the first run
+// writes it, later runs compare against it, so a renderer change that moves
+// pixels shows up. Images differ between GPUs and font versions; keep a
+// directory per machine.
+//
+// --json writes each run's mean and p99 frame time for the regression gate
+// (BenchReport.h).
+//
+// --replay paints a render capture (UI/RenderCapture.h, Ctrl+Shift+F9 in
+// Console3) instead of the scenes: the user's font, size, DPI and grid,
+// with the configuration they ran (unless --config names others), each
+// frame's screen fed to the emulator as VT and its selection and cursor
+// applied to the view, so a frame costs what it cost them, less their GPU.
+//
+//   Console3RenderBench [--scene name[,name...]] [--config name[,name...]]
+//                       [--frames N] [--rows N] [--cols N] [--font name]
+//                       [--size points] [--golden dir] [--update-golden]
+//                       [--json path] [--replay capture] [--list]
+
+#include "UI/RenderCapture.h"
+#include "UI/RenderFactories.h"
+#include "UI/TerminalView.h"
+
+// The UI library's windows refer to the application's WTL module
+CAppModule _Module;
+
+#include "BenchReport.h"
+#include "RenderScenes.h"
+#include "Core/Session.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+using namespace Console3;
+
+/// A renderer configuration to run every scene with
+struct RenderConfig {
+    const char* name;
+    const char* description;
+    UI::RenderBackend backend;
+    bool cellGrid;
+    bool ligatures;
+};
+
+constexpr RenderConfig kConfigs[] = {
+    {"d2d", "Direct2D on the GPU, glyph atlas in bitmap pages", UI::RenderBackend::Offscreen, false, false},
+    {"ligatures", "Direct2D with ligature shaping", UI::RenderBackend::Offscreen, false, true},
+    {"cellgrid", "Cell grid shader, glyph atlas in a texture array", UI::RenderBackend::Offscreen, true, false},
+    {"software", "Direct2D software rasterizer on a DIB section", UI::RenderBackend::Software, false, false},
+};
+
+/// A golden image differs when more than this share of its pixels do
+constexpr double kGoldenTolerance = 0.001;
+
+/// A pixel differs when a channel is further off than this (antialiasing
+/// may round differently between runs)
+constexpr int kChannelTolerance = 8;
+
+/// Command line options
+struct RenderOptions {
+    std::vector<std::string> scenes;    ///< Scenes to run (empty = all)
+    std::vector<std::string> configs;   ///< Configurations to run (empty = all)
+    int frames = 600;
+    int rows = 50;
+    int cols = 160;
+    std::wstring font = L"Consolas";
+    float fontSize = 12.0f;
+    std::wstring goldenDir;             ///< Keep and compare last frames here (empty = off)
+    bool updateGolden = false;          ///< Overwrite golden images instead of comparing
+    std::string json;                   ///< Write the gated metrics here (empty = off)
+    std::wstring replay;                ///< Paint this render capture instead of the scenes
+    unsigned dpi = 0;                   ///< Lay out for this DPI (0 = the monitor's)
+};
+
+/// Frames to paint: each one's output, and with a replay its captured view state
+struct SceneFrames {
+    std::vector<std::string> output;
+    std::vector<UI::RenderCaptureFrame> captured;   ///< Empty for a scripted scene
+};
+
+/// Result of one scene with one configuration
+struct RenderResult {
+    double firstMillis = 0.0;           ///< The frame that fills the atlas
+    double meanMillis = 0.0;
+    double p50Millis = 0.0;
+    double p99Millis = 0.0;
+    double maxMillis = 0.0;
+    const char* golden = "";            ///< Golden image outcome (empty = not checked)
+};
+
+uint64_t NowNanos() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+double Percentile(std::vector<uint64_t>& samples, double fraction) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    const size_t index = std::min(samples.size() - 1,
+                                  static_cast<size_t>(fraction * static_cast<double>(samples.size())));
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index] / 1e6;
+}
+
+void SplitList(std::string_view list, std::vector<std::string>& out) {
+    while (!list.empty()) {
+        const size_t comma = list.find(',');
+        out.emplace_back(list.substr(0, comma));
+        list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+    }
+}
+
+void PrintUsage() {
+    std::printf(
+        "Usage: Console3RenderBench [options]\n"
+        "  --scene a,b       Scenes to paint (default: all, see --list)\n"
+        "  --config a,b      Renderer configurations (default: all, see --list)\n"
+        "  --frames N        Frames per scene (default 600)\n"
+        "  --rows N          Screen rows (default 50)\n"
+        "  --cols N          Screen columns (default 160)\n"
+        "  --font name       Font family (default Consolas)\n"
+        "  --size points     Font size (default 12)\n"
+        "  --golden dir      Compare each run's last frame with a bitmap kept there\n"
+        "                    (written on the first run)\n"
+        "  --update-golden   With --golden: write the bitmaps instead of comparing\n"
+        "  --json path       Also write the frame times as metrics for Console3PerfCheck\n"
+        "  --replay path     Paint a render capture (Ctrl+Shift+F9) with its setup\n"
+        "  --list            List scenes and configurations\n");
+}
+
+bool ParseOptions(int argc, char** argv, RenderOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        const bool takesValue = arg == "--scene" || arg == "--config" || arg == "--frames" ||
+                                arg == "--rows" || arg == "--cols" || arg == "--font" ||
+                                arg == "--size" || arg == "--golden" || arg == "--json" ||
+                                arg == "--replay";
+        if (takesValue && !value) {
+            std::fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return false;
+        }
+
+        if (arg == "--scene") {
+            SplitList(value, options.scenes);
+        } else if (arg == "--config") {
+            SplitList(value, options.configs);
+        } else if (arg == "--frames") {
+            options.frames = std::atoi(value);
+        } else if (arg == "--rows") {
+            options.rows = std::atoi(value);
+        } else if (arg == "--cols") {
+            options.cols = std::atoi(value);
+        } else if (arg == "--font" || arg == "--golden" || arg == "--replay") {
+            // Paths and font names on the command line are the ANSI code page
+            const int length = MultiByteToWideChar(CP_ACP, 0, value, -1, nullptr, 0);
+            std::wstring text(length > 0 ? length - 1 : 0, L'\0');
+            MultiByteToWideChar(CP_ACP, 0, value, -1, text.data(), length);
+            (arg == "--font" ? options.font : arg == "--golden" ? options.goldenDir : options.replay) =
+                std::move(text);
+        } else if (arg == "--size") {
+            options.fontSize = static_cast<float>(std::atof(value));
+        } else if (arg == "--update-golden") {
+            options.updateGolden = true;
+        } else if (arg == "--json") {
+            options.json = value;
+        } else {
+            std::fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return false;
+        }
+        if (takesValue) {
+            ++i;
+        }
+    }
+
+    if (options.frames <= 1 || options.rows <= 0 || options.cols <= 0 || options.fontSize <= 0.0f) {
+        std::fprintf(stderr, "Frames must be more than one, sizes positive\n");
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// Golden images
+// ============================================================================
+
+/// Write pixels as a top-down 32-bit bitmap
+bool WriteBitmap(const std::wstring& path, const std::vector<uint32_t>& pixels, UINT width, UINT height) {
+    BITMAPINFOHEADER info{};
+    info.biSize = sizeof(info);
+    info.biWidth = static_cast<LONG>(width);
+    info.biHeight = -static_cast<LONG>(height);
+    info.biPlanes = 1;
+    info.biBitCount = 32;
+    info.biCompression = BI_RGB;
+
+    const DWORD bytes = static_cast<DWORD>(pixels.size() * sizeof(uint32_t));
+    BITMAPFILEHEADER header{};
+    header.bfType = 0x4D42;  // "BM"
+    header.bfOffBits = sizeof(header) + sizeof(info);
+    header.bfSize = header.bfOffBits + bytes;
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(&info), sizeof(info));
+    file.write(reinterpret_cast<const char*>(pixels.data()), bytes);
+    return static_cast<bool>(file);
+}
+
+/// Read a bitmap WriteBitmap() wrote
+bool ReadBitmap(const std::wstring& path, std::vector<uint32_t>& pixels, UINT& width, UINT& height) {
+    std::ifstream file(path, std::ios::binary);
+    BITMAPFILEHEADER header{};
+    BITMAPINFOHEADER info{};
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        !file.read(reinterpret_cast<char*>(&info), sizeof(info)) ||
+        header.bfType != 0x4D42 || info.biBitCount != 32 || info.biWidth <= 0 || info.biHeight >= 0) {
+        return false;
+    }
+
+    width = static_cast<UINT>(info.biWidth);
+    height = static_cast<UINT>(-info.biHeight);
+    pixels.resize(static_cast<size_t>(width) * height);
+    file.seekg(header.bfOffBits);
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(pixels.data()),
+                                       static_cast<std::streamsize>(pixels.size() * sizeof(uint32_t))));
+}
+
+/// Count the pixels that differ beyond the channel tolerance
+size_t CountDifferences(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+    size_t differences = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        for (int shift = 0; shift < 24; shift += 8) {
+            const int delta = static_cast<int>((a[i] >> shift) & 0xFF) - static_cast<int>((b[i] >> shift) & 0xFF);
+            if (std::abs(delta) > kChannelTolerance) {
+                ++differences;
+                break;
+            }
+        }
+    }
+    return differences;
+}
+
+/// Keep or compare the view's last frame
+/// @return Outcome for the report
+const char* CheckGolden(UI::D2DRenderer& renderer, const std::wstring& path, bool update) {
+    std::vector<uint32_t> pixels;
+    UINT width = 0;
+    UINT height = 0;
+    if (!renderer.ReadPixels(pixels, width, height)) {
+        return "n/a";
+    }
+
+    std::vector<uint32_t> golden;
+    UINT goldenWidth = 0;
+    UINT goldenHeight = 0;
+    if (update || !ReadBitmap(path, golden, goldenWidth, goldenHeight)) {
+        return WriteBitmap(path, pixels, width, height) ? "written" : "write failed";
+    }
+    if (goldenWidth != width || goldenHeight != height) {
+        return "DIFFER (size)";
+    }
+    const size_t differences = CountDifferences(pixels, golden);
+    return differences <= static_cast<size_t>(kGoldenTolerance * static_cast<double>(pixels.size()))
+        ? "match" : "DIFFER";
+}
+
+// ============================================================================
+// Runs
+// ============================================================================
+
+/// Paint a scene's frames with one configuration
+/// @return false if the configuration can't run on this machine
+bool RunScene(const std::string& name, const SceneFrames& frames, const RenderConfig& renderConfig,
+              const RenderOptions& options, RenderResult& result) {
+    Core::SessionConfig config;
+    config.rows = options.rows;
+    config.cols = options.cols;
+    config.fastForwardBytesPerSec = 0;  // Every frame reaches the buffer
+
+    Core::Session session;
+    if (!session.StartDetached(config)) {
+        std::fprintf(stderr, "Failed to start a detached session\n");
+        return false;
+    }
+
+    // A hidden window: the view lays out from its client area, and the
+    // software backend needs a DC to be compatible with
+    UI::TerminalView view;
+    CRect rect(0, 0, 640, 480);
+    if (!view.Create(nullptr, rect, L"Console3RenderBench", WS_POPUP) ||
+        !view.Initialize(UI::RenderFactories::GetD2DFactory(), UI::RenderFactories::GetDWriteFactory(),
+                         session.GetBuffer(), renderConfig.backend) ||
+        !view.SetFont(options.font, options.fontSize)) {
+        session.Stop();
+        return false;
+    }
+    if (options.dpi != 0) {
+        view.SetDpi(options.dpi);
+    }
+
+    UI::D2DRenderer& renderer = *view.GetRenderer();
+    const bool ready = (!renderConfig.cellGrid || view.SetCellGridShader(true)) &&
+                       renderer.GetBackend() == renderConfig.backend;
+    if (ready) {
+        view.SetLigatures(renderConfig.ligatures);
+        view.SetVTerm(session.GetVTerm());
+
+        // Exactly the screen's cells
+        const float scale =
+            static_cast<float>(options.dpi != 0 ? options.dpi : GetDpiForWindow(view.m_hWnd)) / 96.0f;
+        const auto width = static_cast<int>(std::ceil(options.cols * renderer.GetCellWidth() * scale));
+        const auto height = static_cast<int>(std::ceil(options.rows * renderer.GetCellHeight() * scale));
+        view.SetWindowPos(nullptr, 0, 0, width, height, SWP_NOMOVE | SWP_NOZORDER | SWP_NOACTIVATE);
+
+        std::vector<uint64_t> samples;
+        samples.reserve(frames.output.size());
+        for (size_t i = 0; i < frames.output.size(); ++i) {
+            const std::string& frame = frames.output[i];
+            session.FeedOutput(frame.data(), frame.size());
+            if (i < frames.captured.size()) {
+                view.ApplyCapturedFrame(frames.captured[i]);
+            }
+
+            // Timers and posted messages are handled between frames, untimed
+            MSG msg;
+            while (PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE)) {
+                DispatchMessageW(&msg);
+            }
+
+            const uint64_t start = NowNanos();
+            view.RenderNow();
+            (void)renderer.WaitForGpu();
+            samples.push_back(NowNanos() - start);
+        }
+
+        result.firstMillis = samples.front() / 1e6;
+        samples.erase(samples.begin());
+        uint64_t total = 0;
+        for (const uint64_t sample : samples) {
+            total += sample;
+        }
+        result.meanMillis = total / 1e6 / static_cast<double>(samples.size());
+        result.maxMillis = *std::max_element(samples.begin(), samples.end()) / 1e6;
+        result.p50Millis = Percentile(samples, 0.50);
+        result.p99Millis = Percentile(samples, 0.99);
+
+        if (!options.goldenDir.empty()) {
+            // Names are ASCII
+            const std::wstring file = options.goldenDir + L"\\" + std::wstring(name.begin(), name.end()) +
+                                      L"-" + std::wstring(renderConfig.name,
+                                                          renderConfig.name + std::strlen(renderConfig.name)) +
+                                      L".bmp";
+            result.golden = CheckGolden(renderer, file, options.updateGolden);
+        }
+    }
+
+    view.DestroyWindow();
+    session.Stop();
+    return ready;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    RenderOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            PrintUsage();
+            return 0;
+        }
+        if (arg == "--list") {
+            for (const Bench::SceneInfo& info : Bench::GetScenes()) {
+                std::printf("%-12s %s\n", info.name, info.description);
+            }
+            std::printf("\n");
+            for (const RenderConfig& config : kConfigs) {
+                std::printf("%-12s %s\n", config.name, config.description);
+            }
+            return 0;
+        }
+    }
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return 2;
+    }
+
+    std::vector<const RenderConfig*> configs;
+    for (const RenderConfig& config : kConfigs) {
+        if (options.configs.empty() ||
+            std::find(options.configs.begin(), options.configs.end(), config.name) != options.configs.end()) {
+            configs.push_back(&config);
+        }
+    }
+    if (configs.size() != (options.configs.empty() ? std::size(kConfigs) : options.configs.size())) {
+        std::fprintf(stderr, "Unknown configuration (see --list)\n");
+        return 2;
+    }
+
+    std::vector<std::pair<std::string, SceneFrames>> scenes;
+    if (!options.replay.empty()) {
+        auto capture = UI::RenderCapture::Load(options.replay);
+        if (!capture || capture->frames.size() < 2) {
+            std::fprintf(stderr, "Not a render capture, or fewer than two frames\n");
+            return 2;
+        }
+
+        // The user's setup, and their configuration unless others are asked for
+        const UI::RenderCaptureSetup& setup = capture->setup;
+        options.rows = setup.rows;
+        options.cols = setup.cols;
+        options.font = setup.font;
+        options.fontSize = setup.fontSize;
+        options.dpi = setup.dpi;
+        options.frames = static_cast<int>(capture->frames.size());
+        if (options.configs.empty()) {
+            configs.clear();
+            for (const RenderConfig& config : kConfigs) {
+                const bool software = setup.backend == UI::RenderBackend::Software;
+                if ((config.backend == UI::RenderBackend::Software) == software &&
+                    (software || (config.cellGrid == setup.cellGrid && config.ligatures == setup.ligatures))) {
+                    configs.push_back(&config);
+                    break;
+                }
+            }
+            if (configs.empty()) {
+                configs.push_back(&kConfigs[0]);
+            }
+        }
+
+        // Each delta becomes the VT that moves the screen on from the frame before
+        SceneFrames replay;
+        Core::ScreenDeltaDecoder decoder;
+        for (UI::RenderCaptureFrame& frame : capture->frames) {
+            std::string& vt = replay.output.emplace_back();
+            if (!frame.delta.empty()) {
+                if (!decoder.Apply(frame.delta)) {
+                    std::fprintf(stderr, "Render capture is damaged\n");
+                    return 2;
+                }
+                decoder.RenderVt(vt, setup.rows, setup.cols);
+            }
+            replay.captured.push_back(std::move(frame));
+        }
+        scenes.emplace_back("replay", std::move(replay));
+        options.scenes.clear();
+    } else if (options.scenes.empty()) {
+        for (const Bench::SceneInfo& info : Bench::GetScenes()) {
+            options.scenes.emplace_back(info.name);
+        }
+    }
+    for (const std::string& name : options.scenes) {
+        auto frames = Bench::GenerateScene(name, options.rows, options.cols, options.frames);
+        if (!frames) {
+            std::fprintf(stderr, "Unknown scene: %s (see --list)\n", name.c_str());
+            return 2;
+        }
+        scenes.emplace_back(name, SceneFrames{std::move(*frames), {}});
+    }
+
+    if (FAILED(CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED)) ||
+        FAILED(_Module.Init(nullptr, GetModuleHandleW(nullptr)))) {
+        std::fprintf(stderr, "Cannot initialize COM\n");
+        return 1;
+    }
+
+    std::printf("%dx%d, %d frames per scene\n\n", options.cols, options.rows, options.frames);
+    std::printf("%-12s %-10s %9s %9s %9s %9s %9s  %s\n", "scene", "config", "first ms", "mean ms",
+                "p50 ms", "p99 ms", "max ms", options.goldenDir.empty() ? "" : "golden");
+
+    Bench::BenchReport report;
+    int exitCode = 0;
+    for (const auto& [name, frames] : scenes) {
+        for (const RenderConfig* config : configs) {
+            RenderResult result;
+            if (!RunScene(name, frames, *config, options, result)) {
+                std::printf("%-12s %-10s unavailable on this machine\n", name.c_str(), config->name);
+                continue;
+            }
+            std::printf("%-12s %-10s %9.3f %9.3f %9.3f %9.3f %9.3f  %s\n", name.c_str(), config->name,
+                        result.firstMillis, result.meanMillis, result.p50Millis, result.p99Millis,
+                        result.maxMillis, result.golden);
+            if (std::string_view(result.golden).starts_with("DIFFER")) {
+                exitCode = 1;
+            }
+
+            const std::string prefix = "render." + name + "." + config->name;
+            report.Add(prefix + ".mean_ms", result.meanMillis, "ms", Bench::MetricGoal::Lower);
+            report.Add(prefix + ".p99_ms", result.p99Millis, "ms", Bench::MetricGoal::Lower);
+        }
+    }
+
+    if (!options.json.empty() && !report.Write(options.json)) {
+        std::fprintf(stderr, "Cannot write %s\n", options.json.c_str());
+        exitCode = 1;
+    }
+
+    _Module.Term();
+    CoUninitialize();
+    return exitCode;
+}
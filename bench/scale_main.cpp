@@ -0,0 +1,510 @@
+// Console3 - scale_main.cpp
+// Scalability benchmark: what each tab costs, at a few hundred of them
+//
+// Every tab is a window with its own session, view and render thread
+// (MainFrame, RenderThread.h), and the tab bar lays out every tab, so the
+// costs grow with the tab count; this measures how. For each count in
+// --tabs it opens that many tabs the way the app does - a ConPTY session
+// running cmd.exe, a hidden TerminalView, a render thread waiting on the
+// session's output - plus a tab bar holding them all, and runs two phases:
+//
+//   idle  Every shell at its prompt: threads, private bytes and CPU time
+//         of the process, each divided by the tab count.
+//   load  Console3BenchGen typed into a share of the shells: every tenth
+//         streams at --rate, every tenth (offset five) repaints at 30 fps,
+//         every fifth (offset two) trickles at 10 KB/s, the rest stay idle.
+//
+// In both phases a thread posts the UI thread a message every few
+// milliseconds, handled under the render lock as a window's input is
+// (RenderLock.h); how long it took to be handled is the input latency
+// reported. Tab titles are updated and the tab bar repainted ten times a
+// second, timed. The first tab is the one on screen: its view paints on
+// every output, the others only parse.
+//
+// Each count runs from scratch. The table at the end gives each measure's
+// growth as an exponent of the tab count, a log-log fit over the counts
+// run: about 1 is linear, more is worse; --csv keeps the rows for a chart.
+// Child processes (conhost, shells, generators) are not counted.
+//
+//   Console3Scale [--tabs N[,N...]] [--seconds N] [--settle N] [--rate MB/s]
+//                 [--rows N] [--cols N] [--csv path]
+
+#include "UI/RenderFactories.h"
+#include "UI/RenderLock.h"
+#include "UI/RenderThread.h"
+#include "UI/TabControl.h"
+#include "UI/TerminalView.h"
+
+// The UI library's windows refer to the application's WTL module
+CAppModule _Module;
+
+#include "BenchConPty.h"
+#include "Core/PerfClock.h"
+#include "Core/Session.h"
+
+#include <psapi.h>
+#include <tlhelp32.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace Console3;
+using Clock = std::chrono::steady_clock;
+
+/// Posted to the UI thread by the latency probe; lParam is its time
+constexpr UINT kProbeMessage = WM_APP + 1;
+constexpr auto kProbeInterval = std::chrono::milliseconds(5);
+
+/// Tab title updates (and tab bar repaints) while measuring
+constexpr auto kTitleInterval = std::chrono::milliseconds(100);
+
+/// Output of the trickling tabs
+constexpr double kLightRate = 0.01;
+constexpr int kGeneratorFps = 30;
+
+/// Command line options
+struct ScaleOptions {
+    std::vector<int> tabs = {25, 50, 100, 200, 300};
+    double seconds = 20.0;              ///< Length of each phase
+    double settle = 10.0;               ///< Wait for the shells' prompts (and again for the workloads)
+    double rate = 1.0;                  ///< MB/s per streaming tab
+    int rows = 30;
+    int cols = 120;
+    std::string csv;                    ///< Write the rows here (empty = off)
+};
+
+/// One tab: a window's session, view and render thread
+struct Tab {
+    Core::Session session;
+    std::unique_ptr<UI::TerminalView> view;
+    UI::RenderThread thread;
+};
+
+/// Measurements of one tab count
+struct ScaleResult {
+    int tabs = 0;
+    double threads = 0.0;               ///< Of the process, with every tab open
+    double privateMB = 0.0;             ///< Added by the tabs
+    double idleCpuMs = 0.0;             ///< CPU per second of the idle phase
+    double loadCpuMs = 0.0;             ///< CPU per second of the load phase
+    double idleP99Ms = 0.0;             ///< Input latency
+    double loadP50Ms = 0.0;
+    double loadP99Ms = 0.0;
+    double loadMaxMs = 0.0;
+    double tabBarMs = 0.0;              ///< Mean title update and repaint, under load
+    double addTabMs = 0.0;              ///< Adding the last tab to the bar
+};
+
+/// Samples taken while a phase is measured
+struct Probe {
+    bool measuring = false;
+    std::vector<uint64_t> latency;      ///< Microseconds
+    std::vector<uint64_t> tabBar;
+};
+
+void PrintUsage() {
+    std::printf(
+        "Usage: Console3Scale [options]\n"
+        "  --tabs N[,N...]   Tab counts to run (default 25,50,100,200,300)\n"
+        "  --seconds N       Length of the idle and the load phase (default 20)\n"
+        "  --settle N        Wait before each phase (default 10)\n"
+        "  --rate MB/s       Output per streaming tab (default 1)\n"
+        "  --rows N          Screen rows (default 30)\n"
+        "  --cols N          Screen columns (default 120)\n"
+        "  --csv path        Write a row per tab count for charting\n");
+}
+
+bool ParseOptions(int argc, char** argv, ScaleOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        const bool takesValue = arg == "--tabs" || arg == "--seconds" || arg == "--settle" ||
+                                arg == "--rate" || arg == "--rows" || arg == "--cols" || arg == "--csv";
+        if (takesValue && !value) {
+            std::fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return false;
+        }
+
+        if (arg == "--tabs") {
+            options.tabs.clear();
+            for (std::string_view list = value; !list.empty();) {
+                const size_t comma = list.find(',');
+                options.tabs.push_back(std::atoi(std::string(list.substr(0, comma)).c_str()));
+                list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+            }
+        } else if (arg == "--seconds") {
+            options.seconds = std::atof(value);
+        } else if (arg == "--settle") {
+            options.settle = std::atof(value);
+        } else if (arg == "--rate") {
+            options.rate = std::atof(value);
+        } else if (arg == "--rows") {
+            options.rows = std::atoi(value);
+        } else if (arg == "--cols") {
+            options.cols = std::atoi(value);
+        } else if (arg == "--csv") {
+            options.csv = value;
+        } else {
+            std::fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return false;
+        }
+        if (takesValue) {
+            ++i;
+        }
+    }
+
+    if (options.tabs.empty() || std::any_of(options.tabs.begin(), options.tabs.end(), [](int n) { return n <= 0; }) ||
+        options.seconds <= 0.0 || options.settle < 0.0 || options.rate <= 0.0 || options.rows <= 0 ||
+        options.cols <= 0) {
+        std::fprintf(stderr, "Tab counts, times, rates and sizes must be positive\n");
+        return false;
+    }
+    std::sort(options.tabs.begin(), options.tabs.end());
+    return true;
+}
+
+// ============================================================================
+// Process counters
+// ============================================================================
+
+double GetPrivateMB() {
+    PROCESS_MEMORY_COUNTERS_EX counters{};
+    (void)GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters),
+                               sizeof(counters));
+    return counters.PrivateUsage / (1024.0 * 1024.0);
+}
+
+/// Get the process's CPU time, kernel and user, in milliseconds
+double GetCpuMs() {
+    FILETIME created{}, exited{}, kernel{}, user{};
+    if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) {
+        return 0.0;
+    }
+    const auto ticks = [](const FILETIME& time) {
+        return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    };
+    return (ticks(kernel) + ticks(user)) / 10000.0;
+}
+
+int CountThreads() {
+    wil::unique_hfile snapshot(CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0));
+    if (!snapshot) {
+        return 0;
+    }
+    const DWORD process = GetCurrentProcessId();
+    int threads = 0;
+    THREADENTRY32 entry{sizeof(entry)};
+    for (BOOL more = Thread32First(snapshot.get(), &entry); more; more = Thread32Next(snapshot.get(), &entry)) {
+        threads += entry.th32OwnerProcessID == process;
+    }
+    return threads;
+}
+
+double Percentile(std::vector<uint64_t>& samples, double fraction) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    const size_t index = std::min(samples.size() - 1,
+                                  static_cast<size_t>(fraction * static_cast<double>(samples.size())));
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index] / 1e3;
+}
+
+// ============================================================================
+// Runs
+// ============================================================================
+
+/// Open a tab the way a window does: its session feeds its view on its
+/// render thread
+bool OpenTab(Tab& tab, bool visible, const ScaleOptions& options) {
+    Core::SessionConfig config;
+    config.rows = options.rows;
+    config.cols = options.cols;
+    config.shell = L"cmd.exe";
+    if (!tab.session.Start(config)) {
+        return false;
+    }
+
+    tab.view = std::make_unique<UI::TerminalView>();
+    CRect rect(0, 0, 640, 480);
+    if (!tab.view->Create(nullptr, rect, L"Console3Scale", WS_POPUP) ||
+        !tab.view->Initialize(UI::RenderFactories::GetD2DFactory(), UI::RenderFactories::GetDWriteFactory(),
+                              tab.session.GetBuffer(), UI::RenderBackend::Offscreen)) {
+        return false;
+    }
+    tab.view->SetVTerm(tab.session.GetVTerm());
+
+    if (!tab.thread.Start()) {
+        return false;
+    }
+    return tab.thread.AddWaitHandle(tab.session.GetOutputEvent(), [&tab, visible]() {
+        tab.session.ProcessOutput();
+        if (visible) {
+            tab.view->RenderNow();
+        }
+    });
+}
+
+/// Type a workload into a tab's shell, by its place among the tabs (see
+/// file comment)
+void StartWorkload(Tab& tab, size_t index, const ScaleOptions& options) {
+    std::wstring args;
+    if (index % 10 == 0) {
+        args = L"--corpus ascii-log --rate " + std::to_wstring(options.rate);
+    } else if (index % 10 == 5) {
+        args = L"--fps " + std::to_wstring(kGeneratorFps);
+    } else if (index % 5 == 2) {
+        args = L"--corpus sgr-color --rate " + std::to_wstring(kLightRate);
+    } else {
+        return;
+    }
+
+    // Paths are ASCII in practice; cmd reads its input as the console's code page
+    const std::wstring command = L"\"" + Bench::GetGeneratorPath() + L"\" " + args + L" --mb 0 --rows " +
+                                 std::to_wstring(options.rows) + L" --cols " + std::to_wstring(options.cols) +
+                                 L"\r";
+    const std::string input(command.begin(), command.end());
+    (void)tab.session.Write(input.data(), input.size());
+}
+
+/// Run the UI thread's loop for a while: messages, probes and tab titles
+void Pump(double seconds, UI::TabControl& tabBar, Probe& probe) {
+    const Clock::time_point end =
+        Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    Clock::time_point nextTitle = Clock::now();
+    int title = 0;
+
+    while (Clock::now() < end) {
+        MsgWaitForMultipleObjectsEx(0, nullptr, 10, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+        MSG msg;
+        while (PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE)) {
+            if (msg.message == kProbeMessage) {
+                // Handled as a window's input would be
+                UI::RenderLock::Scope lock(UI::RenderLock::Shared());
+                if (probe.measuring) {
+                    probe.latency.push_back(Core::PerfClock::NowMicros() - static_cast<uint64_t>(msg.lParam));
+                }
+                continue;
+            }
+            DispatchMessageW(&msg);
+        }
+
+        // A title changes (an OSC from the shell, say) and the bar repaints
+        if (probe.measuring && Clock::now() >= nextTitle && tabBar.GetTabCount() > 0) {
+            const uint64_t start = Core::PerfClock::NowMicros();
+            const UI::TabItem* tab = tabBar.GetTab(title++ % tabBar.GetTabCount());
+            tabBar.SetTabTitle(tab->id, L"Tab " + std::to_wstring(title));
+            tabBar.RedrawWindow(nullptr, nullptr, RDW_INVALIDATE | RDW_UPDATENOW);
+            probe.tabBar.push_back(Core::PerfClock::NowMicros() - start);
+            nextTitle = Clock::now() + kTitleInterval;
+        }
+    }
+}
+
+/// Open the tabs, run both phases, close them
+/// @return false if a tab could not be opened
+bool RunCount(int count, const ScaleOptions& options, ScaleResult& result) {
+    result.tabs = count;
+    const double privateBefore = GetPrivateMB();
+
+    UI::TabControl tabBar;
+    CRect barRect(0, 0, 1280, 32);
+    if (!tabBar.Create(nullptr, barRect, L"Console3Scale", WS_POPUP)) {
+        return false;
+    }
+
+    std::vector<std::unique_ptr<Tab>> tabs;
+    bool opened = true;
+    for (int i = 0; i < count && opened; ++i) {
+        auto tab = std::make_unique<Tab>();
+        opened = OpenTab(*tab, i == 0, options);
+        const uint64_t start = Core::PerfClock::NowMicros();
+        (void)tabBar.AddTab(L"cmd", tab.get());
+        result.addTabMs = (Core::PerfClock::NowMicros() - start) / 1e3;
+        tabs.push_back(std::move(tab));
+        if (!opened) {
+            std::fprintf(stderr, "Failed to open tab %d of %d\n", i + 1, count);
+        }
+    }
+
+    if (opened) {
+        // The latency probe posts for the whole run; only measured phases keep it
+        std::atomic<bool> stop{false};
+        const DWORD uiThread = GetCurrentThreadId();
+        std::thread poster([&stop, uiThread]() {
+            while (!stop.load(std::memory_order_relaxed)) {
+                (void)PostThreadMessageW(uiThread, kProbeMessage, 0,
+                                         static_cast<LPARAM>(Core::PerfClock::NowMicros()));
+                std::this_thread::sleep_for(kProbeInterval);
+            }
+        });
+
+        Probe probe;
+        Pump(options.settle, tabBar, probe);
+        result.threads = CountThreads();
+        result.privateMB = GetPrivateMB() - privateBefore;
+
+        // Idle: every shell at its prompt
+        probe.measuring = true;
+        double cpu = GetCpuMs();
+        Pump(options.seconds, tabBar, probe);
+        result.idleCpuMs = (GetCpuMs() - cpu) / options.seconds;
+        result.idleP99Ms = Percentile(probe.latency, 0.99);
+
+        // Load: workloads typed into a share of the shells
+        probe = Probe{};
+        for (size_t i = 0; i < tabs.size(); ++i) {
+            StartWorkload(*tabs[i], i, options);
+        }
+        Pump(options.settle, tabBar, probe);
+        probe.measuring = true;
+        cpu = GetCpuMs();
+        Pump(options.seconds, tabBar, probe);
+        result.loadCpuMs = (GetCpuMs() - cpu) / options.seconds;
+        result.loadP50Ms = Percentile(probe.latency, 0.50);
+        result.loadP99Ms = Percentile(probe.latency, 0.99);
+        result.loadMaxMs = probe.latency.empty()
+            ? 0.0 : *std::max_element(probe.latency.begin(), probe.latency.end()) / 1e3;
+        uint64_t tabBarTotal = 0;
+        for (const uint64_t sample : probe.tabBar) {
+            tabBarTotal += sample;
+        }
+        result.tabBarMs = probe.tabBar.empty() ? 0.0 : tabBarTotal / 1e3 / static_cast<double>(probe.tabBar.size());
+
+        stop.store(true);
+        poster.join();
+    }
+
+    // Threads first (they draw the views), then views (they draw the buffers)
+    for (const auto& tab : tabs) {
+        tab->thread.Stop();
+        if (tab->view && tab->view->IsWindow()) {
+            tab->view->DestroyWindow();
+        }
+        tab->session.Stop();
+    }
+    tabBar.DestroyWindow();
+
+    // Drop the probes posted meanwhile
+    MSG msg;
+    while (PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE)) {
+        if (msg.message != kProbeMessage) {
+            DispatchMessageW(&msg);
+        }
+    }
+    return opened;
+}
+
+/// Fit y = a * n^k over the counts run
+/// @return k (0 with fewer than two usable points)
+double GrowthExponent(const std::vector<ScaleResult>& results, double ScaleResult::*measure) {
+    double sumX = 0.0, sumY = 0.0, sumXX = 0.0, sumXY = 0.0;
+    int points = 0;
+    for (const ScaleResult& result : results) {
+        if (result.*measure <= 0.0) {
+            continue;
+        }
+        const double x = std::log(static_cast<double>(result.tabs));
+        const double y = std::log(result.*measure);
+        sumX += x;
+        sumY += y;
+        sumXX += x * x;
+        sumXY += x * y;
+        ++points;
+    }
+    const double denominator = points * sumXX - sumX * sumX;
+    return points < 2 || denominator == 0.0 ? 0.0 : (points * sumXY - sumX * sumY) / denominator;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    ScaleOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            PrintUsage();
+            return 0;
+        }
+    }
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return 2;
+    }
+
+    if (FAILED(CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED)) ||
+        FAILED(_Module.Init(nullptr, GetModuleHandleW(nullptr)))) {
+        std::fprintf(stderr, "Cannot initialize COM\n");
+        return 1;
+    }
+
+    std::printf("%dx%d, %.0f s idle and %.0f s under load per tab count\n\n", options.cols, options.rows,
+                options.seconds, options.seconds);
+    std::printf("%6s %8s %8s %8s %9s %9s %9s %9s %9s %9s %9s %9s\n", "tabs", "threads", "thr/tab", "MB/tab",
+                "idle ms/s", "ms/s/tab", "load ms/s", "idle p99", "load p50", "load p99", "load max", "tabbar ms");
+
+    std::ofstream csv;
+    if (!options.csv.empty()) {
+        csv.open(options.csv, std::ios::trunc);
+        csv << "tabs,threads,private_mb,idle_cpu_ms_per_s,load_cpu_ms_per_s,idle_p99_ms,load_p50_ms,"
+               "load_p99_ms,load_max_ms,tabbar_ms,add_tab_ms\n";
+    }
+
+    std::vector<ScaleResult> results;
+    int exitCode = 0;
+    for (const int count : options.tabs) {
+        ScaleResult result;
+        if (!RunCount(count, options, result)) {
+            std::printf("%6d could not open every tab; larger counts skipped\n", count);
+            exitCode = 1;
+            break;
+        }
+        std::printf("%6d %8.0f %8.2f %8.2f %9.1f %9.3f %9.1f %9.2f %9.2f %9.2f %9.2f %9.3f\n", count,
+                    result.threads, result.threads / count, result.privateMB / count, result.idleCpuMs,
+                    result.idleCpuMs / count, result.loadCpuMs, result.idleP99Ms, result.loadP50Ms,
+                    result.loadP99Ms, result.loadMaxMs, result.tabBarMs);
+        if (csv.is_open()) {
+            csv << count << ',' << result.threads << ',' << result.privateMB << ',' << result.idleCpuMs << ','
+                << result.loadCpuMs << ',' << result.idleP99Ms << ',' << result.loadP50Ms << ','
+                << result.loadP99Ms << ',' << result.loadMaxMs << ',' << result.tabBarMs << ','
+                << result.addTabMs << '\n';
+        }
+        results.push_back(result);
+    }
+
+    if (results.size() >= 2) {
+        struct Growth {
+            const char* name;
+            double ScaleResult::*measure;
+        };
+        constexpr Growth kGrowth[] = {
+            {"threads", &ScaleResult::threads},
+            {"private bytes", &ScaleResult::privateMB},
+            {"idle CPU", &ScaleResult::idleCpuMs},
+            {"load CPU", &ScaleResult::loadCpuMs},
+            {"input p99 (load)", &ScaleResult::loadP99Ms},
+            {"tab bar update", &ScaleResult::tabBarMs},
+            {"add a tab", &ScaleResult::addTabMs},
+        };
+        std::printf("\nGrowth with the tab count (n^k; 1 = linear):\n");
+        for (const Growth& growth : kGrowth) {
+            std::printf("  %-17s k = %5.2f\n", growth.name, GrowthExponent(results, growth.measure));
+        }
+    }
+
+    _Module.Term();
+    CoUninitialize();
+    return exitCode;
+}
@@ -0,0 +1,398 @@
+// Console3 - soak_main.cpp
+// Soak test: hours of generated output across many sessions, watched for growth
+//
+// Starts --tabs sessions, each a real ConPTY child running Console3BenchGen
+// (the corpora in turn, paced with --rate; every fourth tab repaints the
+// alternate screen at 30 fps instead), and paints each into a hidden
+// TerminalView the way a window would. Every --sample seconds it records
+// the process's private bytes, handles, GDI and USER objects, and what the
+// sessions hold (SessionMemory, the renderers' brush caches), printing a
+// line and appending it to --csv as it goes.
+//
+// At the end each series is checked for growth after the warm-up, which has
+// to cover the scrollback filling up to its limit: a series that rose on
+// most samples and ended more than --growth above where it started is
+// flagged, and the exit code is 1. Short runs see noise; the check means
+// something over hours.
+//
+//   Console3Soak [--tabs N] [--minutes N] [--sample seconds] [--warmup minutes]
+//                [--rate MB/s] [--growth fraction] [--csv path] [--no-render]
+
+#include "UI/RenderFactories.h"
+#include "UI/TerminalView.h"
+
+// The UI library's windows refer to the application's WTL module
+CAppModule _Module;
+
+#include "BenchConPty.h"
+#include "BenchCorpus.h"
+#include "Core/Session.h"
+
+#include <psapi.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+using namespace Console3;
+using Clock = std::chrono::steady_clock;
+
+/// Frame interval of the views, and of the frame-rate tabs' generator
+constexpr auto kRenderInterval = std::chrono::milliseconds(33);
+constexpr int kGeneratorFps = 30;
+
+/// Command line options
+struct SoakOptions {
+    int tabs = 8;
+    double minutes = 240.0;
+    double sampleSeconds = 60.0;
+    double warmupMinutes = 15.0;        ///< Samples before this are not checked for growth
+    double rate = 1.0;                  ///< MB/s per streaming tab
+    double growth = 0.05;               ///< Rise past which a rising series is flagged
+    int rows = 50;
+    int cols = 160;
+    std::string csv;                    ///< Append samples here (empty = off)
+    bool render = true;
+};
+
+/// One session and its hidden view
+struct Tab {
+    Core::Session session;
+    std::unique_ptr<UI::TerminalView> view;
+    std::atomic<bool> exited{false};
+    std::string workload;
+};
+
+/// A measured quantity over the run
+struct Series {
+    const char* name;
+    const char* unit;
+    std::vector<double> values;
+};
+
+enum SeriesIndex {
+    kPrivateBytes,
+    kHandles,
+    kGdiObjects,
+    kUserObjects,
+    kScreen,
+    kScrollback,
+    kRing,
+    kVTerm,
+    kFrames,
+    kAtlas,
+    kBrushes,
+    kSeriesCount
+};
+
+void PrintUsage() {
+    std::printf(
+        "Usage: Console3Soak [options]\n"
+        "  --tabs N          Sessions to run at once (default 8)\n"
+        "  --minutes N       Length of the run (default 240)\n"
+        "  --sample seconds  Time between samples (default 60)\n"
+        "  --warmup minutes  Samples not checked for growth (default 15)\n"
+        "  --rate MB/s       Output per streaming tab (default 1)\n"
+        "  --growth fraction Rise that flags a rising series (default 0.05)\n"
+        "  --rows N          Screen rows (default 50)\n"
+        "  --cols N          Screen columns (default 160)\n"
+        "  --csv path        Append every sample to a CSV file\n"
+        "  --no-render       Parse only; no views, no render caches\n");
+}
+
+bool ParseOptions(int argc, char** argv, SoakOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        const bool takesValue = arg == "--tabs" || arg == "--minutes" || arg == "--sample" ||
+                                arg == "--warmup" || arg == "--rate" || arg == "--growth" ||
+                                arg == "--rows" || arg == "--cols" || arg == "--csv";
+        if (takesValue && !value) {
+            std::fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return false;
+        }
+
+        if (arg == "--tabs") {
+            options.tabs = std::atoi(value);
+        } else if (arg == "--minutes") {
+            options.minutes = std::atof(value);
+        } else if (arg == "--sample") {
+            options.sampleSeconds = std::atof(value);
+        } else if (arg == "--warmup") {
+            options.warmupMinutes = std::atof(value);
+        } else if (arg == "--rate") {
+            options.rate = std::atof(value);
+        } else if (arg == "--growth") {
+            options.growth = std::atof(value);
+        } else if (arg == "--rows") {
+            options.rows = std::atoi(value);
+        } else if (arg == "--cols") {
+            options.cols = std::atoi(value);
+        } else if (arg == "--csv") {
+            options.csv = value;
+        } else if (arg == "--no-render") {
+            options.render = false;
+        } else {
+            std::fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return false;
+        }
+        if (takesValue) {
+            ++i;
+        }
+    }
+
+    // Sessions wait on their output events together (MAXIMUM_WAIT_OBJECTS)
+    if (options.tabs <= 0 || options.tabs > MAXIMUM_WAIT_OBJECTS || options.minutes <= 0.0 ||
+        options.sampleSeconds <= 0.0 || options.warmupMinutes < 0.0 || options.rate <= 0.0 ||
+        options.growth <= 0.0 || options.rows <= 0 || options.cols <= 0) {
+        std::fprintf(stderr, "Tabs must be 1 to %d, times, rates and sizes positive\n", MAXIMUM_WAIT_OBJECTS);
+        return false;
+    }
+    return true;
+}
+
+/// Start a tab's generator and its view
+bool StartTab(Tab& tab, size_t index, const SoakOptions& options) {
+    const auto corpora = Bench::GetCorpora();
+    const std::wstring size = L" --mb 0 --rows " + std::to_wstring(options.rows) +
+                              L" --cols " + std::to_wstring(options.cols);
+
+    Core::SessionConfig config;
+    config.rows = options.rows;
+    config.cols = options.cols;
+    config.shell = Bench::GetGeneratorPath();
+    if (index % 4 == 3) {
+        tab.workload = "fps " + std::to_string(kGeneratorFps);
+        config.args = L"--fps " + std::to_wstring(kGeneratorFps) + size;
+    } else {
+        const std::string corpus = corpora[index % corpora.size()].name;
+        tab.workload = corpus;
+        config.args = L"--corpus " + std::wstring(corpus.begin(), corpus.end()) +
+                      L" --rate " + std::to_wstring(options.rate) + size;
+    }
+
+    tab.session.SetExitCallback([&tab](DWORD) {
+        tab.exited.store(true, std::memory_order_release);
+    });
+    if (!tab.session.Start(config)) {
+        return false;
+    }
+    if (!options.render) {
+        return true;
+    }
+
+    tab.view = std::make_unique<UI::TerminalView>();
+    CRect rect(0, 0, 640, 480);
+    if (!tab.view->Create(nullptr, rect, L"Console3Soak", WS_POPUP) ||
+        !tab.view->Initialize(UI::RenderFactories::GetD2DFactory(), UI::RenderFactories::GetDWriteFactory(),
+                              tab.session.GetBuffer(), UI::RenderBackend::Offscreen)) {
+        return false;
+    }
+    tab.view->SetVTerm(tab.session.GetVTerm());
+    return true;
+}
+
+/// Take one sample of every series
+void Sample(const std::vector<std::unique_ptr<Tab>>& tabs, std::vector<Series>& series) {
+    PROCESS_MEMORY_COUNTERS_EX counters{};
+    (void)GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters),
+                               sizeof(counters));
+    DWORD handles = 0;
+    (void)GetProcessHandleCount(GetCurrentProcess(), &handles);
+
+    Core::SessionMemory total;
+    size_t brushes = 0;
+    for (const auto& tab : tabs) {
+        Core::SessionMemory memory = tab->session.GetMemory();
+        if (tab->view) {
+            tab->view->GetRenderMemory(memory);
+            brushes += tab->view->GetRenderer()->GetBrushCount();
+        }
+        total.screenBytes += memory.screenBytes;
+        total.scrollbackHotBytes += memory.scrollbackHotBytes + memory.scrollbackColdBytes;
+        total.ringBytes += memory.ringBytes;
+        total.vtermBytes += memory.vtermBytes;
+        total.frameBytes += memory.frameBytes;
+        total.atlasBytes += memory.atlasBytes;
+    }
+
+    constexpr double kMB = 1024.0 * 1024.0;
+    series[kPrivateBytes].values.push_back(counters.PrivateUsage / kMB);
+    series[kHandles].values.push_back(handles);
+    series[kGdiObjects].values.push_back(GetGuiResources(GetCurrentProcess(), GR_GDIOBJECTS));
+    series[kUserObjects].values.push_back(GetGuiResources(GetCurrentProcess(), GR_USEROBJECTS));
+    series[kScreen].values.push_back(total.screenBytes / kMB);
+    series[kScrollback].values.push_back(total.scrollbackHotBytes / kMB);
+    series[kRing].values.push_back(total.ringBytes / kMB);
+    series[kVTerm].values.push_back(total.vtermBytes / kMB);
+    series[kFrames].values.push_back(total.frameBytes / kMB);
+    series[kAtlas].values.push_back(total.atlasBytes / kMB);
+    series[kBrushes].values.push_back(static_cast<double>(brushes));
+}
+
+/// Check a series for growth after the warm-up (see file comment)
+bool IsGrowing(const std::vector<double>& values, size_t warmup, double growth) {
+    if (values.size() < warmup + 4) {
+        return false;
+    }
+
+    size_t rises = 0;
+    size_t falls = 0;
+    for (size_t i = warmup + 1; i < values.size(); ++i) {
+        rises += values[i] > values[i - 1];
+        falls += values[i] < values[i - 1];
+    }
+    const double first = values[warmup];
+    const double last = values.back();
+    return rises > 3 * falls && last > first + growth * std::max(first, 1.0);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    SoakOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            PrintUsage();
+            return 0;
+        }
+    }
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return 2;
+    }
+
+    if (FAILED(CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED)) ||
+        FAILED(_Module.Init(nullptr, GetModuleHandleW(nullptr)))) {
+        std::fprintf(stderr, "Cannot initialize COM\n");
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<Tab>> tabs;
+    std::vector<HANDLE> events;
+    for (int i = 0; i < options.tabs; ++i) {
+        auto tab = std::make_unique<Tab>();
+        if (!StartTab(*tab, tabs.size(), options)) {
+            std::fprintf(stderr, "Failed to start tab %d\n", i + 1);
+            return 1;
+        }
+        events.push_back(tab->session.GetOutputEvent());
+        tabs.push_back(std::move(tab));
+    }
+
+    std::vector<Series> series = {
+        {"private", "MB", {}}, {"handles", "", {}}, {"gdi", "", {}}, {"user", "", {}},
+        {"screen", "MB", {}}, {"scrollback", "MB", {}}, {"ring", "MB", {}}, {"vterm", "MB", {}},
+        {"frames", "MB", {}}, {"atlas", "MB", {}}, {"brushes", "", {}},
+    };
+
+    std::ofstream csv;
+    if (!options.csv.empty()) {
+        csv.open(options.csv, std::ios::app);
+        csv << "minutes";
+        for (const Series& s : series) {
+            csv << ',' << s.name;
+        }
+        csv << '\n';
+    }
+
+    std::printf("%d tabs, %.0f minutes, a sample every %.0f s\n\n", options.tabs, options.minutes,
+                options.sampleSeconds);
+    std::printf("%8s", "minutes");
+    for (const Series& s : series) {
+        std::printf(" %10s", s.name);
+    }
+    std::printf("\n");
+
+    const auto toDuration = [](double seconds) {
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    };
+    const Clock::time_point start = Clock::now();
+    const Clock::time_point end = start + toDuration(options.minutes * 60.0);
+    Clock::time_point nextSample = start + toDuration(options.sampleSeconds);
+    Clock::time_point nextFrame = start;
+    size_t exits = 0;
+
+    while (Clock::now() < end) {
+        WaitForMultipleObjects(static_cast<DWORD>(events.size()), events.data(), FALSE, 10);
+        for (const auto& tab : tabs) {
+            tab->session.ProcessOutput();
+            if (tab->exited.exchange(false, std::memory_order_acq_rel)) {
+                std::fprintf(stderr, "A generator exited (%s)\n", tab->workload.c_str());
+                ++exits;
+            }
+        }
+
+        MSG msg;
+        while (PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE)) {
+            DispatchMessageW(&msg);
+        }
+
+        const Clock::time_point now = Clock::now();
+        if (options.render && now >= nextFrame) {
+            for (const auto& tab : tabs) {
+                tab->view->RenderNow();
+            }
+            nextFrame = now + kRenderInterval;
+        }
+
+        if (now >= nextSample) {
+            Sample(tabs, series);
+            const double minutes = std::chrono::duration<double>(now - start).count() / 60.0;
+            std::printf("%8.1f", minutes);
+            if (csv.is_open()) {
+                csv << minutes;
+            }
+            for (const Series& s : series) {
+                std::printf(" %10.2f", s.values.back());
+                if (csv.is_open()) {
+                    csv << ',' << s.values.back();
+                }
+            }
+            std::printf("\n");
+            if (csv.is_open()) {
+                csv << std::endl;
+            }
+            nextSample += toDuration(options.sampleSeconds);
+        }
+    }
+
+    // Views first: they draw the sessions' buffers
+    for (const auto& tab : tabs) {
+        if (tab->view) {
+            tab->view->DestroyWindow();
+        }
+        tab->session.Stop();
+    }
+
+    const auto warmup = static_cast<size_t>(options.warmupMinutes * 60.0 / options.sampleSeconds);
+    std::printf("\nGrowth after %.0f minutes of warm-up:\n", options.warmupMinutes);
+    bool growing = false;
+    for (const Series& s : series) {
+        if (s.values.size() < warmup + 4) {
+            std::printf("  %-11s not enough samples\n", s.name);
+            continue;
+        }
+        const bool grows = IsGrowing(s.values, warmup, options.growth);
+        growing = growing || grows;
+        std::printf("  %-11s %10.2f -> %10.2f %-2s %s\n", s.name, s.values[warmup], s.values.back(), s.unit,
+                    grows ? "GROWING" : "ok");
+    }
+    if (exits != 0) {
+        std::printf("\n%zu generator exit(s): the run did not keep every tab busy\n", exits);
+    }
+
+    _Module.Term();
+    CoUninitialize();
+    return growing || exits != 0 ? 1 : 0;
+}
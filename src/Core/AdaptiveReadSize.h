@@ -0,0 +1,80 @@
+#pragma once
+// Console3 - AdaptiveReadSize.h
+// Read size that follows observed pipe throughput
+//
+// Interactive use produces a trickle of short reads, where a small buffer is
+// all that is needed. Bulk output (builds, cat of a large file) fills every
+// read, and each extra ReadFile is pure syscall overhead. The sizer doubles
+// the read size after consecutive full reads and halves it after consecutive
+// short ones, staying between a minimum and a maximum.
+
+#include <algorithm>
+#include <cstddef>
+
+namespace Console3::Core {
+
+/// Doubling/halving read size policy
+class AdaptiveReadSize {
+public:
+    static constexpr size_t kDefaultMin = 4096;
+    static constexpr size_t kDefaultMax = 256 * 1024;
+
+    /// Full reads in a row before growing
+    static constexpr int kGrowAfter = 2;
+
+    /// Short reads (under a quarter of the size) in a row before shrinking
+    static constexpr int kShrinkAfter = 4;
+
+    /// @param minSize Smallest read size (also the starting size)
+    /// @param maxSize Largest read size
+    explicit AdaptiveReadSize(size_t minSize = kDefaultMin, size_t maxSize = kDefaultMax) noexcept
+        : m_min(std::max<size_t>(minSize, 1))
+        , m_max(std::max(maxSize, m_min))
+        , m_current(m_min) {}
+
+    /// Get the size to request for the next read
+    [[nodiscard]] size_t Get() const noexcept { return m_current; }
+
+    [[nodiscard]] size_t GetMin() const noexcept { return m_min; }
+    [[nodiscard]] size_t GetMax() const noexcept { return m_max; }
+
+    /// Record the outcome of a read
+    /// @param requested Size passed to ReadFile (may be below Get() when the
+    /// destination had less room)
+    /// @param received Bytes actually read
+    void OnRead(size_t requested, size_t received) noexcept {
+        if (received >= requested) {
+            m_shortReads = 0;
+            // Only a read at the full current size says the pipe had more
+            if (requested >= m_current && ++m_fullReads >= kGrowAfter) {
+                m_current = std::min(m_current * 2, m_max);
+                m_fullReads = 0;
+            }
+        } else if (received < m_current / 4) {
+            m_fullReads = 0;
+            if (++m_shortReads >= kShrinkAfter) {
+                m_current = std::max(m_current / 2, m_min);
+                m_shortReads = 0;
+            }
+        } else {
+            m_fullReads = 0;
+            m_shortReads = 0;
+        }
+    }
+
+    /// Return to the minimum size
+    void Reset() noexcept {
+        m_current = m_min;
+        m_fullReads = 0;
+        m_shortReads = 0;
+    }
+
+private:
+    size_t m_min;
+    size_t m_max;
+    size_t m_current;
+    int m_fullReads = 0;
+    int m_shortReads = 0;
+};
+
+} // namespace Console3::Core
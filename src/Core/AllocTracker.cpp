@@ -0,0 +1,128 @@
+// Console3 - AllocTracker.cpp
+// Heap allocation counts per subsystem (instrumented builds)
+
+#include "Core/AllocTracker.h"
+#include <Windows.h>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace Console3::Core {
+
+namespace {
+
+constexpr size_t kSubsystems = static_cast<size_t>(AllocSubsystem::Count);
+
+/// One cache line per subsystem: threads of different subsystems don't
+/// share the lines they count on
+struct alignas(64) Counter {
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> bytes{0};
+};
+
+Counter g_counters[kSubsystems];
+
+thread_local AllocSubsystem t_subsystem = AllocSubsystem::Other;
+thread_local AllocTrap* t_trap = nullptr;
+
+} // namespace
+
+void AllocTracker::Record(size_t bytes) noexcept {
+    Record(t_subsystem, bytes);
+}
+
+void AllocTracker::Record(AllocSubsystem subsystem, size_t bytes) noexcept {
+    Counter& counter = g_counters[static_cast<size_t>(subsystem)];
+    counter.allocations.fetch_add(1, std::memory_order_relaxed);
+    counter.bytes.fetch_add(bytes, std::memory_order_relaxed);
+
+    if (AllocTrap* trap = t_trap) {
+        // Capturing the stack doesn't allocate; Record's own frame is skipped
+        if (trap->allocations++ == 0) {
+            trap->frameCount = CaptureStackBackTrace(1, static_cast<DWORD>(AllocTrap::kMaxFrames),
+                                                     trap->frames.data(), nullptr);
+        }
+        trap->bytes += bytes;
+    }
+}
+
+AllocSnapshot AllocTracker::Snapshot() noexcept {
+    AllocSnapshot snapshot;
+    for (size_t i = 0; i < kSubsystems; ++i) {
+        snapshot[i].allocations = g_counters[i].allocations.load(std::memory_order_relaxed);
+        snapshot[i].bytes = g_counters[i].bytes.load(std::memory_order_relaxed);
+    }
+    return snapshot;
+}
+
+AllocCounts AllocTracker::Total() noexcept {
+    AllocCounts total;
+    for (const AllocCounts& counts : Snapshot()) {
+        total.allocations += counts.allocations;
+        total.bytes += counts.bytes;
+    }
+    return total;
+}
+
+const char* AllocTracker::GetName(AllocSubsystem subsystem) noexcept {
+    switch (subsystem) {
+    case AllocSubsystem::Io: return "io";
+    case AllocSubsystem::Emulation: return "emulation";
+    case AllocSubsystem::Buffer: return "buffer";
+    case AllocSubsystem::Render: return "render";
+    default: return "other";
+    }
+}
+
+AllocSubsystem AllocTracker::SetThreadSubsystem(AllocSubsystem subsystem) noexcept {
+    const AllocSubsystem previous = t_subsystem;
+    t_subsystem = subsystem;
+    return previous;
+}
+
+AllocTrap* AllocTracker::SetThreadTrap(AllocTrap* trap) noexcept {
+    AllocTrap* previous = t_trap;
+    t_trap = trap;
+    return previous;
+}
+
+} // namespace Console3::Core
+
+#if CONSOLE3_ALLOC_TRACKING
+
+// ============================================================================
+// Global allocation operators
+// ============================================================================
+
+// Every C++ heap allocation in the process goes through these. Aligned
+// allocations keep the runtime's operators and are not counted.
+
+void* operator new(size_t size) {
+    Console3::Core::AllocTracker::Record(size);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    Console3::Core::AllocTracker::Record(size);
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+
+#endif // CONSOLE3_ALLOC_TRACKING
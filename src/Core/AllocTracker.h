@@ -0,0 +1,138 @@
+#pragma once
+// Console3 - AllocTracker.h
+// Heap allocation counts per subsystem (instrumented builds)
+//
+// Built with CONSOLE3_ALLOC_TRACKING (the ALLOC_TRACKING CMake option), the
+// global operator new is replaced to count every C++ allocation, and its
+// bytes, against the subsystem the allocating thread is working for; the
+// libvterm allocator (VTermHeap) counts its mallocs as emulation. Work is
+// tagged with an AllocScope: the transport and writer threads as I/O,
+// parsing as emulation, copying into the terminal buffer as buffer, painting
+// as render. Anything untagged counts as other.
+//
+// Counts are cumulative since the process started, so a caller interested
+// in one stretch of work takes the difference of two snapshots. Without the
+// option AllocScope compiles to nothing and every count reads zero.
+//
+// An AllocTrapScope marks a stretch of a thread's work that must not
+// allocate at all: each allocation it makes is counted into the trap, and
+// the first one's call stack is kept so a report can say where it came
+// from (the allocation contracts, tests/test_AllocContracts.cpp).
+
+#ifndef CONSOLE3_ALLOC_TRACKING
+#define CONSOLE3_ALLOC_TRACKING 0
+#endif
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace Console3::Core {
+
+/// What a thread is allocating for
+enum class AllocSubsystem : uint8_t {
+    Other,
+    Io,         ///< Transport, completion port, input writer and recorder threads
+    Emulation,  ///< Parsing, and everything libvterm allocates
+    Buffer,     ///< Terminal buffer and scrollback updates
+    Render,     ///< Painting frames
+    Count
+};
+
+/// Allocations of one subsystem
+struct AllocCounts {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+};
+
+/// Counts of every subsystem, indexed by AllocSubsystem
+using AllocSnapshot = std::array<AllocCounts, static_cast<size_t>(AllocSubsystem::Count)>;
+
+/// Allocations caught in a section that must not allocate (see file comment)
+struct AllocTrap {
+    static constexpr size_t kMaxFrames = 32;
+
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    std::array<void*, kMaxFrames> frames{};   ///< Return addresses of the first allocation, innermost first
+    size_t frameCount = 0;
+};
+
+/// Process-wide allocation counters (see file comment)
+class AllocTracker {
+public:
+    /// Whether this build counts allocations
+    static constexpr bool kEnabled = CONSOLE3_ALLOC_TRACKING != 0;
+
+    /// Count an allocation against the calling thread's subsystem
+    static void Record(size_t bytes) noexcept;
+
+    /// Count an allocation against a given subsystem
+    static void Record(AllocSubsystem subsystem, size_t bytes) noexcept;
+
+    /// Get the counts of every subsystem
+    [[nodiscard]] static AllocSnapshot Snapshot() noexcept;
+
+    /// Get the counts of all subsystems together
+    [[nodiscard]] static AllocCounts Total() noexcept;
+
+    /// Get a subsystem's short name for reports
+    [[nodiscard]] static const char* GetName(AllocSubsystem subsystem) noexcept;
+
+    /// Set the calling thread's subsystem
+    /// @return The one it replaces
+    static AllocSubsystem SetThreadSubsystem(AllocSubsystem subsystem) noexcept;
+
+    /// Set the trap the calling thread's allocations are caught in
+    /// @param trap The trap, or nullptr for none
+    /// @return The one it replaces
+    static AllocTrap* SetThreadTrap(AllocTrap* trap) noexcept;
+};
+
+/// Tags the calling thread's allocations with a subsystem until it goes
+/// out of scope (scopes nest)
+class AllocScope {
+public:
+    explicit AllocScope([[maybe_unused]] AllocSubsystem subsystem) noexcept {
+        if constexpr (AllocTracker::kEnabled) {
+            m_previous = AllocTracker::SetThreadSubsystem(subsystem);
+        }
+    }
+
+    ~AllocScope() {
+        if constexpr (AllocTracker::kEnabled) {
+            AllocTracker::SetThreadSubsystem(m_previous);
+        }
+    }
+
+    AllocScope(const AllocScope&) = delete;
+    AllocScope& operator=(const AllocScope&) = delete;
+
+private:
+    AllocSubsystem m_previous = AllocSubsystem::Other;
+};
+
+/// Catches the calling thread's allocations in a trap until it goes out of
+/// scope (instrumented builds; the trap stays empty otherwise)
+class AllocTrapScope {
+public:
+    explicit AllocTrapScope([[maybe_unused]] AllocTrap& trap) noexcept {
+        if constexpr (AllocTracker::kEnabled) {
+            m_previous = AllocTracker::SetThreadTrap(&trap);
+        }
+    }
+
+    ~AllocTrapScope() {
+        if constexpr (AllocTracker::kEnabled) {
+            AllocTracker::SetThreadTrap(m_previous);
+        }
+    }
+
+    AllocTrapScope(const AllocTrapScope&) = delete;
+    AllocTrapScope& operator=(const AllocTrapScope&) = delete;
+
+private:
+    AllocTrap* m_previous = nullptr;
+};
+
+} // namespace Console3::Core
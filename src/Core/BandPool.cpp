@@ -0,0 +1,119 @@
+// Console3 - BandPool.cpp
+// Worker threads splitting one large job into bands
+
+#include "Core/BandPool.h"
+
+#include <algorithm>
+#include <system_error>
+
+namespace Console3::Core {
+
+BandPool& BandPool::Shared() {
+    static BandPool s_pool;
+    return s_pool;
+}
+
+BandPool::~BandPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+}
+
+unsigned BandPool::GetConcurrency() {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (!m_started) {
+        (void)StartThreads();
+    }
+    return static_cast<unsigned>(m_threads.size()) + 1;
+}
+
+void BandPool::RunBands(int bands, BandProc proc, void* context) {
+    if (bands <= 0) {
+        return;
+    }
+
+    // Busy with another caller's job, or no threads: do it all here
+    std::unique_lock<std::mutex> run(m_runLock, std::try_to_lock);
+    bool threads = false;
+    if (run && bands > 1) {
+        std::lock_guard<std::mutex> lock(m_lock);
+        threads = (m_started || StartThreads()) && !m_threads.empty();
+    }
+    if (!threads) {
+        for (int band = 0; band < bands; ++band) {
+            proc(context, band);
+        }
+        return;
+    }
+
+    auto job = std::make_shared<Job>();
+    job->proc = proc;
+    job->context = context;
+    job->bands = bands;
+    job->pending.store(bands, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_job = job;
+        ++m_generation;
+    }
+    m_wake.notify_all();
+
+    Work(*job);
+
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_done.wait(lock, [&job]() { return job->pending.load(std::memory_order_acquire) == 0; });
+    m_job.reset();
+}
+
+void BandPool::Work(Job& job) {
+    for (int band = job.next.fetch_add(1, std::memory_order_relaxed); band < job.bands;
+         band = job.next.fetch_add(1, std::memory_order_relaxed)) {
+        job.proc(job.context, band);
+        if (job.pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            // Taking the lock orders the wake after the caller's check
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_done.notify_all();
+        }
+    }
+}
+
+bool BandPool::StartThreads() {
+    m_started = true;
+
+    // The caller is one of the hands; the rest of the cores, up to the cap
+    const unsigned cores = std::max(std::thread::hardware_concurrency(), 1u);
+    const unsigned count = std::min(cores - 1, kMaxThreads);
+    try {
+        for (unsigned index = 0; index < count; ++index) {
+            m_threads.emplace_back(&BandPool::WorkerProc, this);
+        }
+    } catch (const std::system_error&) {
+        // Whatever started serves
+    }
+    return !m_threads.empty();
+}
+
+void BandPool::WorkerProc() {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(m_lock);
+    while (true) {
+        m_wake.wait(lock, [this, &seen]() { return m_stopping || (m_job && m_generation != seen); });
+        if (m_stopping) {
+            return;
+        }
+        seen = m_generation;
+
+        // A job finished meanwhile has no band left to take
+        const std::shared_ptr<Job> job = m_job;
+        lock.unlock();
+        Work(*job);
+        lock.lock();
+    }
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,81 @@
+#pragma once
+// Console3 - BandPool.h
+// Worker threads splitting one large job into bands
+//
+// A full repaint of a very large grid (a 400x120 TUI on a 4K display is
+// 48k cells) is one damage rect whose rows are independent of each other.
+// Run() splits such a job into bands, runs them on a small pool of threads
+// and on the calling thread together, and returns once all are done: a
+// fork and a join, nothing queued past the call.
+//
+// One job runs at a time. A caller finding the pool busy (another
+// session's repaint) runs its bands itself rather than waiting, as does
+// one when no thread could be started, so Run() always does the work.
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Console3::Core {
+
+/// Process-wide fork-join pool (see file comment)
+class BandPool {
+public:
+    static constexpr unsigned kMaxThreads = 4;
+
+    /// Get the process's pool
+    static BandPool& Shared();
+
+    BandPool() = default;
+    ~BandPool();
+
+    BandPool(const BandPool&) = delete;
+    BandPool& operator=(const BandPool&) = delete;
+
+    /// Run work(band) for every band in [0, bands), the calling thread
+    /// taking part, starting the threads on first use. The bands must not
+    /// touch the same memory; work must not throw.
+    template <class Work>
+    void Run(int bands, Work& work) {
+        RunBands(bands, [](void* context, int band) { (*static_cast<Work*>(context))(band); }, &work);
+    }
+
+    /// Get how many bands can run at once (the threads and the caller)
+    [[nodiscard]] unsigned GetConcurrency();
+
+private:
+    using BandProc = void (*)(void* context, int band);
+
+    struct Job {
+        BandProc proc = nullptr;
+        void* context = nullptr;
+        int bands = 0;
+        std::atomic<int> next{0};       ///< Band to take next
+        std::atomic<int> pending{0};    ///< Bands not finished
+    };
+
+    void RunBands(int bands, BandProc proc, void* context);
+
+    /// Take and run the job's bands until none are left
+    void Work(Job& job);
+
+    bool StartThreads();
+    void WorkerProc();
+
+    std::mutex m_runLock;               ///< Held by the caller whose job runs
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    std::shared_ptr<Job> m_job;         ///< Current job (m_lock); workers keep theirs alive
+    uint64_t m_generation = 0;          ///< Counts jobs started (m_lock)
+    std::vector<std::thread> m_threads;
+    bool m_started = false;
+    bool m_stopping = false;
+};
+
+} // namespace Console3::Core
@@ -0,0 +1,262 @@
+#pragma once
+// Console3 - Cell.h
+// Terminal cell types shared by the screen buffer and scrollback storage
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "Core/GraphemeTable.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define CONSOLE3_CELL_SSE2 1
+#endif
+
+namespace Console3::Core {
+
+/// Cell attributes packed into a single byte
+struct CellAttributes {
+    uint8_t bold : 1 = 0;
+    uint8_t italic : 1 = 0;
+    uint8_t underline : 2 = 0;      ///< 0=none, 1=single, 2=double, 3=curly
+    uint8_t blink : 1 = 0;
+    uint8_t reverse : 1 = 0;
+    uint8_t strikethrough : 1 = 0;
+    uint8_t conceal : 1 = 0;
+
+    bool operator==(const CellAttributes& other) const noexcept = default;
+};
+
+/// 24-bit RGB color with type flags
+struct CellColor {
+    uint8_t r = 0;
+    uint8_t g = 0;
+    uint8_t b = 0;
+    uint8_t flags = 0;  ///< Bit 0: isDefault, Bit 1: isIndexed
+    
+    static constexpr uint8_t FLAG_DEFAULT = 0x01;
+    static constexpr uint8_t FLAG_INDEXED = 0x02;
+
+    [[nodiscard]] bool IsDefault() const noexcept { return (flags & FLAG_DEFAULT) != 0; }
+    [[nodiscard]] bool IsIndexed() const noexcept { return (flags & FLAG_INDEXED) != 0; }
+
+    /// Create a default color
+    static CellColor Default() {
+        CellColor c;
+        c.flags = FLAG_DEFAULT;
+        return c;
+    }
+
+    /// Create an RGB color
+    static CellColor Rgb(uint8_t r, uint8_t g, uint8_t b) {
+        CellColor c;
+        c.r = r;
+        c.g = g;
+        c.b = b;
+        c.flags = 0;
+        return c;
+    }
+
+    /// Create an indexed palette color (index stored in r)
+    static CellColor Indexed(uint8_t index) {
+        CellColor c;
+        c.r = index;
+        c.flags = FLAG_INDEXED;
+        return c;
+    }
+
+    bool operator==(const CellColor& other) const noexcept = default;
+};
+
+/// A single terminal cell, packed into 12 bytes
+/// Colors and attributes are stored inline. The character is a 21-bit
+/// codepoint, or, for the rare cell with combining characters, an index into
+/// GraphemeTable; use Codepoint() and Combining() rather than the raw field.
+struct Cell {
+    /// libvterm's continuation marker ((uint32_t)-1) as stored in 21 bits
+    static constexpr uint32_t kContinuation = 0x1FFFFF;
+
+    CellColor fg = CellColor::Default();
+    CellColor bg = CellColor::Default();
+    uint32_t code : 21 = U' ';      ///< Codepoint, or GraphemeTable index if grapheme is set
+    uint32_t grapheme : 1 = 0;      ///< code indexes GraphemeTable
+    uint32_t width : 2 = 1;         ///< Cell width (1 or 2 for wide chars)
+    uint32_t attrBits : 8 = 0;      ///< CellAttributes (see Attributes())
+
+    /// Reset to default empty cell
+    void Clear() {
+        *this = Cell{};
+    }
+
+    /// Get the base codepoint
+    [[nodiscard]] uint32_t Codepoint() const noexcept {
+        return grapheme ? GraphemeTable::Shared().Get(code).base : code;
+    }
+
+    /// Get the combining characters (empty for most cells)
+    [[nodiscard]] std::span<const uint32_t> Combining() const noexcept {
+        if (!grapheme) {
+            return {};
+        }
+        return GraphemeTable::Shared().Get(code).Combining();
+    }
+
+    /// Check if cell has combining characters
+    [[nodiscard]] bool HasCombining() const noexcept {
+        return grapheme != 0;
+    }
+
+    /// Get the GraphemeTable index (only if HasCombining()); equal
+    /// sequences have equal indices, so it can key caches of drawn glyphs
+    [[nodiscard]] uint32_t GraphemeIndex() const noexcept {
+        return code;
+    }
+
+    /// Set a single codepoint, dropping any combining characters
+    void SetCodepoint(uint32_t cp) noexcept {
+        code = cp;
+        grapheme = 0;
+    }
+
+    /// Set a base codepoint with combining characters
+    /// Marks are dropped if the grapheme table is full.
+    /// @param combining Combining characters, 0-terminated if fewer than 3
+    void SetChars(uint32_t base, const uint32_t (&combining)[GraphemeTable::kMaxCombining]) {
+        if (combining[0] != 0) {
+            if (const auto index = GraphemeTable::Shared().Intern(base, combining)) {
+                code = *index;
+                grapheme = 1;
+                return;
+            }
+        }
+        SetCodepoint(base);
+    }
+
+    [[nodiscard]] CellAttributes Attributes() const noexcept {
+        return std::bit_cast<CellAttributes>(static_cast<uint8_t>(attrBits));
+    }
+
+    void SetAttributes(CellAttributes attrs) noexcept {
+        attrBits = std::bit_cast<uint8_t>(attrs);
+    }
+
+    bool operator==(const Cell& other) const noexcept = default;
+};
+
+static_assert(sizeof(Cell) == 12, "Cell should stay packed");
+static_assert(std::is_trivially_copyable_v<Cell>, "Cells are compared and copied as bytes");
+
+/// A row of cells
+using Row = std::vector<Cell>;
+
+/// Find where a line's trailing fill starts: the blanks it ends in, all in
+/// the style of its last cell (an erase in a colored background leaves
+/// such a fill; most lines end in default blanks)
+/// @param fill Receives the blank the line ends in (a default cell if it
+///             does not end in one)
+/// @return Cells before the fill
+[[nodiscard]] inline size_t FindTrailingFill(std::span<const Cell> cells, Cell& fill) noexcept {
+    fill = Cell{};
+    if (cells.empty()) {
+        return 0;
+    }
+    const Cell& last = cells.back();
+    if (last.grapheme || last.width != 1 || (last.code != U' ' && last.code != 0)) {
+        return cells.size();
+    }
+    fill = last;
+    size_t used = cells.size() - 1;
+    while (used > 0 && cells[used - 1] == fill) {
+        --used;
+    }
+    return used;
+}
+
+/// Check if two cells are drawn in the same style (colors and attributes;
+/// the characters aside)
+[[nodiscard]] inline bool SameStyle(const Cell& a, const Cell& b) noexcept {
+    return a.fg == b.fg && a.bg == b.bg && a.attrBits == b.attrBits;
+}
+
+/// Columns [start, start + length) of a line drawn in one style
+/// The style is that of the cell at start. A wide character's continuation
+/// cell always belongs to the run of its character, whatever it holds.
+struct StyleRun {
+    uint16_t start = 0;
+    uint16_t length = 0;
+
+    [[nodiscard]] int End() const noexcept { return start + length; }
+};
+
+/// Append the style runs of cells [start, end) of a line to runs, whose
+/// last run (if any) must end at start: the first cells extend it while
+/// they keep its style
+inline void AppendStyleRuns(std::span<const Cell> cells, size_t start, size_t end, std::vector<StyleRun>& runs) {
+    const Cell* style = runs.empty() ? nullptr : &cells[runs.back().start];
+    for (size_t col = start; col < end; ++col) {
+        const Cell& cell = cells[col];
+        if (style && (cell.width == 0 || SameStyle(cell, *style))) {
+            ++runs.back().length;
+        } else {
+            runs.push_back(StyleRun{static_cast<uint16_t>(col), 1});
+            style = &cell;
+        }
+    }
+}
+
+/// Fill cells with one cell (erases and clears)
+/// A 12-byte cell defeats the C runtime's fill; four of them are 48 bytes,
+/// three 16-byte stores of a pattern built once.
+inline void FillCells(std::span<Cell> cells, const Cell& fill) noexcept {
+    size_t done = 0;
+#ifdef CONSOLE3_CELL_SSE2
+    const Cell pattern[4] = {fill, fill, fill, fill};
+    const auto* in = reinterpret_cast<const __m128i*>(pattern);
+    const __m128i a = _mm_loadu_si128(in);
+    const __m128i b = _mm_loadu_si128(in + 1);
+    const __m128i c = _mm_loadu_si128(in + 2);
+    auto* out = reinterpret_cast<__m128i*>(cells.data());
+    for (; done + 4 <= cells.size(); done += 4, out += 3) {
+        _mm_storeu_si128(out, a);
+        _mm_storeu_si128(out + 1, b);
+        _mm_storeu_si128(out + 2, c);
+    }
+#endif
+    std::fill(cells.begin() + done, cells.end(), fill);
+}
+
+/// Cells [start, end) of a run that differ from another run
+struct CellChange {
+    size_t start = 0;
+    size_t end = 0;
+
+    [[nodiscard]] bool IsEmpty() const noexcept { return start >= end; }
+};
+
+/// Find the cells that differ between two runs of the same length
+/// Applications and ConPTY often resend rows unchanged; those compare
+/// with one memcmp (vectorized by the C runtime), as a Cell's 12 bytes have
+/// no padding, and only a changed run is scanned for its ends.
+[[nodiscard]] inline CellChange FindChangedCells(std::span<const Cell> before, std::span<const Cell> after) noexcept {
+    const size_t count = std::min(before.size(), after.size());
+    if (count == 0 || std::memcmp(before.data(), after.data(), count * sizeof(Cell)) == 0) {
+        return {};
+    }
+    size_t start = 0;
+    while (before[start] == after[start]) {
+        ++start;
+    }
+    size_t end = count;
+    while (before[end - 1] == after[end - 1]) {
+        --end;
+    }
+    return {start, end};
+}
+
+} // namespace Console3::Core
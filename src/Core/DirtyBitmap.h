@@ -0,0 +1,115 @@
+#pragma once
+// Console3 - DirtyBitmap.h
+// Word-packed bit set for dirty tracking
+//
+// One bit per row, 64 to a word, so the common questions a renderer asks
+// ("anything to do?", "how much?", "which row next?") cost a word per 64
+// rows instead of a bit-by-bit walk, and nothing is allocated to answer them.
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Console3::Core {
+
+/// Fixed-size bit set with popcount and find-next-set scanning
+class DirtyBitmap {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    DirtyBitmap() = default;
+    explicit DirtyBitmap(size_t size, bool value = false) { Assign(size, value); }
+
+    /// Resize to size bits, all set to value
+    void Assign(size_t size, bool value) {
+        m_size = size;
+        m_words.assign((size + 63) / 64, 0);
+        if (value) {
+            SetAll();
+        }
+    }
+
+    [[nodiscard]] size_t Size() const noexcept { return m_size; }
+
+    [[nodiscard]] bool Test(size_t bit) const noexcept {
+        return (m_words[bit / 64] >> (bit % 64)) & 1;
+    }
+
+    void Set(size_t bit) noexcept { m_words[bit / 64] |= Mask(bit); }
+    void Reset(size_t bit) noexcept { m_words[bit / 64] &= ~Mask(bit); }
+
+    /// Exchange two bits
+    void Swap(size_t a, size_t b) noexcept {
+        if (Test(a) != Test(b)) {
+            m_words[a / 64] ^= Mask(a);
+            m_words[b / 64] ^= Mask(b);
+        }
+    }
+
+    /// Set bits [first, last)
+    void SetRange(size_t first, size_t last) noexcept {
+        last = std::min(last, m_size);
+        while (first < last) {
+            const size_t end = std::min(last, (first / 64 + 1) * 64);
+            const size_t count = end - first;
+            const uint64_t bits = count == 64 ? ~uint64_t{0} : ((uint64_t{1} << count) - 1);
+            m_words[first / 64] |= bits << (first % 64);
+            first = end;
+        }
+    }
+
+    void SetAll() noexcept {
+        std::fill(m_words.begin(), m_words.end(), ~uint64_t{0});
+        // Bits past the end stay clear, so Count() and FindNext() need no mask
+        if (m_size % 64 != 0) {
+            m_words.back() = (uint64_t{1} << (m_size % 64)) - 1;
+        }
+    }
+
+    void ClearAll() noexcept { std::fill(m_words.begin(), m_words.end(), 0); }
+
+    [[nodiscard]] bool Any() const noexcept {
+        return std::any_of(m_words.begin(), m_words.end(), [](uint64_t word) { return word != 0; });
+    }
+
+    /// Number of set bits
+    [[nodiscard]] size_t Count() const noexcept {
+        size_t count = 0;
+        for (uint64_t word : m_words) {
+            count += static_cast<size_t>(std::popcount(word));
+        }
+        return count;
+    }
+
+    /// Find the first set bit in [from, last)
+    /// @return Its index, or npos if none
+    [[nodiscard]] size_t FindNext(size_t from, size_t last = npos) const noexcept {
+        last = std::min(last, m_size);
+        if (from >= last) {
+            return npos;
+        }
+
+        size_t index = from / 64;
+        uint64_t word = m_words[index] & (~uint64_t{0} << (from % 64));
+        const size_t lastIndex = (last - 1) / 64;
+        while (word == 0) {
+            if (++index > lastIndex) {
+                return npos;
+            }
+            word = m_words[index];
+        }
+
+        const size_t bit = index * 64 + static_cast<size_t>(std::countr_zero(word));
+        return bit < last ? bit : npos;
+    }
+
+private:
+    [[nodiscard]] static uint64_t Mask(size_t bit) noexcept { return uint64_t{1} << (bit % 64); }
+
+    std::vector<uint64_t> m_words;
+    size_t m_size = 0;
+};
+
+} // namespace Console3::Core
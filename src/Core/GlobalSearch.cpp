@@ -0,0 +1,335 @@
+// Console3 - GlobalSearch.cpp
+// One search over the history of every open session
+
+#include "Core/GlobalSearch.h"
+#include "Core/TerminalBuffer.h"
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+namespace Console3::Core {
+
+struct GlobalSearch::Run {
+    explicit Run(const SearchQuery& query)
+        : matcher(query), fromMs(query.fromMs), toMs(query.toMs),
+          everyLine(query.text.empty() && (query.fromMs != 0 || query.toMs != UINT64_MAX)) {}
+
+    [[nodiscard]] bool HasRange() const noexcept { return fromMs != 0 || toMs != UINT64_MAX; }
+
+    const TextMatcher matcher;
+    const uint64_t fromMs;
+    const uint64_t toMs;
+    const bool everyLine;                   ///< No text, a time range: every line in it is a hit
+    std::atomic<bool> stopped{false};
+
+    std::mutex lock;
+    HitsCallback onHits;                    ///< Guarded by lock
+    std::vector<GlobalSearchHit> hits;      ///< Found, not yet taken (guarded)
+    GlobalSearchProgress progress;          ///< Guarded by lock
+    size_t inFlight = 0;                    ///< Slices queued or running (guarded)
+    bool allQueued = false;                 ///< No source is left to read (guarded)
+};
+
+struct GlobalSearch::Task {
+    std::shared_ptr<Run> run;
+    Slice slice;
+};
+
+namespace {
+
+/// Check if a byte continues a UTF-8 sequence
+[[nodiscard]] bool IsContinuationByte(char c) noexcept {
+    return (static_cast<uint8_t>(c) & 0xC0) == 0x80;
+}
+
+} // namespace
+
+GlobalSearch::~GlobalSearch() {
+    Stop();
+}
+
+bool GlobalSearch::Start(const SearchQuery& query, HitsCallback onHits) {
+    Stop();
+    auto run = std::make_shared<Run>(query);
+    if (!run->matcher.IsValid() && !run->everyLine) {
+        return false;
+    }
+    run->onHits = std::move(onHits);
+    m_run = std::move(run);
+    m_active = true;
+    return true;
+}
+
+void GlobalSearch::AddSource(uint32_t source, const TerminalBuffer& buffer) {
+    if (!m_active) {
+        return;
+    }
+    const ScrollbackStore& store = buffer.GetScrollbackStore();
+    Source added;
+    added.id = source;
+    added.buffer = &buffer;
+    added.epoch = buffer.GetScrollbackEpoch();
+    added.nextId = store.GetFirstId();
+    added.storeEnd = store.GetEndId();
+    added.endLine = buffer.GetScreenLine() + static_cast<uint64_t>(buffer.GetRows());
+
+    // Only the lines completed in the time range, from the stamps alone
+    uint64_t first = 0;
+    uint64_t end = added.endLine;
+    if (m_run->HasRange() && !buffer.GetLineTimes().FindLines(m_run->fromMs, m_run->toMs, first, end)) {
+        first = end = 0;
+    }
+    added.nextId = std::max(added.nextId, first);
+    added.storeEnd = std::max(added.nextId, std::min(added.storeEnd, end));
+
+    // The screen changes every frame; it is searched as it is now
+    Slice& screen = added.screen;
+    screen.source = source;
+    screen.epoch = added.epoch;
+    const uint64_t screenLine = buffer.GetScreenLine();
+    const uint64_t screenFirst = std::clamp(first, screenLine, added.endLine);
+    const uint64_t screenEnd = std::clamp(end, screenFirst, added.endLine);
+    screen.firstLine = screenFirst;
+    screen.endLine = added.endLine;
+    for (uint64_t line = screenFirst; line < screenEnd; ++line) {
+        ScrollbackSearch::AppendLineText(screen.text, buffer.GetRow(static_cast<int>(line - screenLine)));
+        screen.text += '\n';
+        screen.lineEnds.push_back(static_cast<uint32_t>(screen.text.size()));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_run->lock);
+        m_run->progress.linesTotal += (added.storeEnd - added.nextId) + screen.lineEnds.size();
+        m_run->allQueued = false;
+    }
+    m_sources.push_back(std::move(added));
+}
+
+void GlobalSearch::RemoveSource(uint32_t source) {
+    const auto it = std::ranges::find(m_sources, source, &Source::id);
+    if (it == m_sources.end()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_run->lock);
+        m_run->progress.linesSkipped += (it->storeEnd > it->nextId ? it->storeEnd - it->nextId : 0) +
+                                        it->screen.lineEnds.size();
+    }
+    m_sources.erase(it);
+}
+
+bool GlobalSearch::Update(size_t lines) {
+    if (!m_active) {
+        return false;
+    }
+
+    size_t taken = 0;
+    while (!m_sources.empty() && taken < lines) {
+        {
+            std::lock_guard<std::mutex> lock(m_run->lock);
+            if (m_run->inFlight >= kMaxSlicesInFlight) {
+                return true;
+            }
+        }
+
+        // Lines popped back to the screen, trimmed, or cleared with the
+        // scrollback are no longer there to search
+        Source& source = m_sources.front();
+        const ScrollbackStore& store = source.buffer->GetScrollbackStore();
+        uint64_t skipped = 0;
+        if (source.buffer->GetScrollbackEpoch() != source.epoch) {
+            source.storeEnd = source.nextId;
+        }
+        source.storeEnd = std::min(source.storeEnd, store.GetEndId());
+        if (source.nextId < store.GetFirstId()) {
+            const uint64_t first = std::min(store.GetFirstId(), source.storeEnd);
+            skipped += first > source.nextId ? first - source.nextId : 0;
+            source.nextId = std::max(source.nextId, first);
+        }
+
+        Slice slice;
+        slice.source = source.id;
+        slice.epoch = source.epoch;
+        slice.firstLine = source.nextId;
+        slice.endLine = source.endLine;
+        if (source.nextId < source.storeEnd) {
+            // Oldest first, so each block is decoded once; sealed and
+            // spilled lines are decoded on the pool. Store line i has id
+            // GetEndId() - 1 - i, and a line's id is its absolute line.
+            const uint64_t end = std::min<uint64_t>(source.storeEnd, source.nextId + kSliceLines);
+            slice.view = store.ShareLines(source.nextId, end, true);
+            if (!slice.view.Empty()) {
+                source.nextId += slice.view.Size();
+            } else {
+                for (uint64_t id = source.nextId; id < end; ++id) {
+                    const auto index = static_cast<size_t>(store.GetEndId() - 1 - id);
+                    if (const Row* row = store.Get(index)) {
+                        ScrollbackSearch::AppendLineText(slice.text, *row);
+                    }
+                    // An unreadable line stays in place, empty
+                    slice.text += '\n';
+                    slice.lineEnds.push_back(static_cast<uint32_t>(slice.text.size()));
+                }
+                source.nextId = end;
+            }
+            taken += slice.view.Size() + slice.lineEnds.size();
+        } else {
+            slice = std::move(source.screen);
+            taken += slice.lineEnds.size();
+            m_sources.erase(m_sources.begin());
+        }
+
+        if (skipped != 0) {
+            std::lock_guard<std::mutex> lock(m_run->lock);
+            m_run->progress.linesSkipped += skipped;
+        }
+        Submit(std::move(slice));
+    }
+
+    if (m_sources.empty()) {
+        std::lock_guard<std::mutex> lock(m_run->lock);
+        m_run->allQueued = true;
+        m_run->progress.finished = m_run->inFlight == 0;
+    }
+    return !m_sources.empty();
+}
+
+void GlobalSearch::Stop() {
+    if (!m_active) {
+        return;
+    }
+    m_active = false;
+    m_sources.clear();
+    m_run->stopped.store(true);
+    std::lock_guard<std::mutex> lock(m_run->lock);
+    m_run->onHits = nullptr;
+}
+
+bool GlobalSearch::TakeHits(std::vector<GlobalSearchHit>& hits) {
+    if (!m_run) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_run->lock);
+    if (m_run->hits.empty()) {
+        return false;
+    }
+    hits.insert(hits.end(), std::make_move_iterator(m_run->hits.begin()), std::make_move_iterator(m_run->hits.end()));
+    m_run->hits.clear();
+    return true;
+}
+
+GlobalSearchProgress GlobalSearch::GetProgress() const {
+    if (!m_run) {
+        return {};
+    }
+    std::lock_guard<std::mutex> lock(m_run->lock);
+    return m_run->progress;
+}
+
+void GlobalSearch::Submit(Slice&& slice) {
+    {
+        std::lock_guard<std::mutex> lock(m_run->lock);
+        ++m_run->inFlight;
+    }
+    auto task = std::make_unique<Task>(Task{m_run, std::move(slice)});
+    if (TrySubmitThreadpoolCallback(&GlobalSearch::SliceProc, task.get(), nullptr)) {
+        (void)task.release();
+        return;
+    }
+    // No pool to run it: search it here
+    SliceProc(nullptr, task.release());
+}
+
+void CALLBACK GlobalSearch::SliceProc(PTP_CALLBACK_INSTANCE /*instance*/, void* context) {
+    std::unique_ptr<Task> task(static_cast<Task*>(context));
+    const std::shared_ptr<Run> run = std::move(task->run);
+    if (!run->stopped.load()) {
+        Search(*run, task->slice);
+    }
+    // Its blocks go now, not with the search
+    task.reset();
+
+    HitsCallback notify;
+    {
+        std::lock_guard<std::mutex> lock(run->lock);
+        --run->inFlight;
+        if (run->allQueued && run->inFlight == 0 && !run->progress.finished) {
+            run->progress.finished = true;
+            notify = run->onHits;
+        }
+    }
+    if (notify) {
+        notify();
+    }
+}
+
+void GlobalSearch::Search(Run& run, Slice& slice) {
+    thread_local Row row;
+    thread_local std::string text;
+    std::vector<GlobalSearchHit> found;
+    uint64_t searched = 0;
+
+    const auto match = [&](std::string_view line, uint64_t number) {
+        ++searched;
+        size_t length = 0;
+        const size_t offset = run.everyLine ? 0 : run.matcher.Find(line, 0, length);
+        if (offset == std::string_view::npos) {
+            return;
+        }
+
+        // The match with some text each side, cut at whole characters
+        size_t start = offset > kContextBytes ? offset - kContextBytes : 0;
+        while (start < offset && IsContinuationByte(line[start])) {
+            ++start;
+        }
+        size_t end = std::min(line.size(), offset + length + kContextBytes);
+        while (end < line.size() && end > offset + length && IsContinuationByte(line[end])) {
+            --end;
+        }
+
+        GlobalSearchHit& hit = found.emplace_back();
+        hit.source = slice.source;
+        hit.line = number;
+        hit.epoch = slice.epoch;
+        hit.age = slice.endLine > number ? slice.endLine - number : 0;
+        hit.offset = static_cast<uint32_t>(offset);
+        hit.length = static_cast<uint32_t>(length);
+        hit.context.assign(line.substr(start, end - start));
+        hit.contextOffset = static_cast<uint32_t>(offset - start);
+    };
+
+    for (size_t i = 0; i < slice.view.Size() && !run.stopped.load(std::memory_order_relaxed); ++i) {
+        text.clear();
+        if (slice.view.Get(i, row)) {
+            ScrollbackSearch::AppendLineText(text, row);
+        }
+        match(text, slice.firstLine + i);
+    }
+    uint32_t lineStart = 0;
+    for (size_t i = 0; i < slice.lineEnds.size() && !run.stopped.load(std::memory_order_relaxed); ++i) {
+        const uint32_t lineEnd = slice.lineEnds[i];
+        match(std::string_view(slice.text).substr(lineStart, lineEnd - 1 - lineStart), slice.firstLine + i);
+        lineStart = lineEnd;
+    }
+
+    HitsCallback notify;
+    {
+        std::lock_guard<std::mutex> lock(run.lock);
+        run.progress.linesSearched += searched;
+        const size_t room = kMaxHits > run.progress.hits ? kMaxHits - run.progress.hits : 0;
+        if (found.size() > room) {
+            found.resize(room);
+        }
+        if (!found.empty()) {
+            run.progress.hits += found.size();
+            run.hits.insert(run.hits.end(), std::make_move_iterator(found.begin()),
+                            std::make_move_iterator(found.end()));
+            notify = run.onHits;
+        }
+    }
+    if (notify) {
+        notify();
+    }
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,162 @@
+#pragma once
+// Console3 - GlobalSearch.h
+// One search over the history of every open session
+//
+// "Which tab printed this request ID?" means searching every session's
+// scrollback and screen at once. Each session added as a source is read a
+// slice at a time on the UI thread (the only thread that may read its
+// buffer), oldest lines first, like an export (ScrollbackExport): lines in
+// sealed blocks are handed over as a ScrollbackView, spilled ones included
+// (their compressed bytes copied out of the spill file, so a hibernated
+// session's store is not brought back into memory); the hot window,
+// staging and screen are copied out as text. Slices are matched on the
+// system thread pool, many at once across sessions, each block decoded
+// once into the worker's scratch and never cached in the store. At most
+// kMaxSlicesInFlight wait or run, so a search over a large history bounds
+// its memory rather than the UI.
+//
+// Hits are streamed to the caller as they are found and ranked by recency:
+// how many lines from the end of its session's history the line is, so the
+// screen comes first in every session and older output after, whichever
+// session it is in. Each source is searched as it was when added: lines
+// printed later are not searched, and lines its store drops before they
+// are reached are skipped. A match split by a soft wrap is not found.
+//
+// A query with a time range (SearchQuery::fromMs, toMs) searches only the
+// lines its sources completed then, found from their stamps
+// (ScrollbackTimes::FindLines) without reading the scrollback's text; with
+// no text, every such line is a hit. Sources keeping no stamps have none.
+//
+// Sessions' own ScrollbackSearch shadows are not used: one is built only
+// for the focused session while its find bar (UI/FindBar.h) is open, and
+// building one per session would keep a plain-text copy of every history.
+
+#include <Windows.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Core/ScrollbackSearch.h"
+#include "Core/ScrollbackStore.h"
+
+namespace Console3::Core {
+
+class TerminalBuffer;
+
+/// A match in one source
+struct GlobalSearchHit {
+    uint32_t source = 0;            ///< Id the source was added with
+    uint64_t line = 0;              ///< Absolute line (see TerminalBuffer::GetScreenLine)
+    uint64_t epoch = 0;             ///< TerminalBuffer::GetScrollbackEpoch() of the line
+    uint64_t age = 0;               ///< Lines from the end of the source's history (the rank)
+    uint32_t offset = 0;            ///< Byte offset in the line's text
+    uint32_t length = 0;            ///< Bytes matched
+    std::string context;            ///< Text around the match (UTF-8)
+    uint32_t contextOffset = 0;     ///< Where the match starts in it
+};
+
+/// How far a search has got
+struct GlobalSearchProgress {
+    uint64_t linesTotal = 0;        ///< In the sources added
+    uint64_t linesSearched = 0;
+    uint64_t linesSkipped = 0;      ///< Dropped by a store before they were reached
+    size_t hits = 0;                ///< Found so far
+    bool finished = false;          ///< Every source searched
+};
+
+/// Search across sessions (see file comment)
+class GlobalSearch {
+public:
+    static constexpr size_t kSliceLines = 4 * ScrollbackStore::kBlockLines;  ///< Lines per slice at most
+    static constexpr size_t kMaxSlicesInFlight = 16;
+    static constexpr size_t kMaxHits = 10000;             ///< Hits past this are not reported
+    static constexpr size_t kContextBytes = 60;           ///< Text kept on each side of a match
+
+    /// Called on a pool thread when hits are ready to take
+    using HitsCallback = std::function<void()>;
+
+    GlobalSearch() = default;
+    ~GlobalSearch();
+
+    // Non-copyable, non-movable
+    GlobalSearch(const GlobalSearch&) = delete;
+    GlobalSearch& operator=(const GlobalSearch&) = delete;
+
+    /// Start a search, replacing the one before, with no sources yet (UI thread)
+    /// @return false if the query can't match (see TextMatcher::IsValid;
+    ///         empty text matches every line with a time range)
+    [[nodiscard]] bool Start(const SearchQuery& query, HitsCallback onHits = {});
+
+    /// Search a buffer's history and screen as they are now (UI thread)
+    /// @param source Id the hits carry (unique among the sources)
+    void AddSource(uint32_t source, const TerminalBuffer& buffer);
+
+    /// Stop reading a source, whose buffer is going away (UI thread); hits
+    /// found in it are kept
+    void RemoveSource(uint32_t source);
+
+    /// Hand more lines to the pool (UI thread, while a search runs)
+    /// @param lines Lines to take from the sources at most
+    /// @return true while lines remain to be handed over
+    bool Update(size_t lines);
+
+    /// End the search; slices on the pool finish on their own (UI thread)
+    void Stop();
+
+    /// Check if a search is open
+    [[nodiscard]] bool IsActive() const noexcept { return m_active; }
+
+    /// Take the hits found since the last call (UI thread), unordered
+    /// @return false if there were none
+    bool TakeHits(std::vector<GlobalSearchHit>& hits);
+
+    /// Get the progress of the open or last search (UI thread)
+    [[nodiscard]] GlobalSearchProgress GetProgress() const;
+
+private:
+    /// Lines of one source, oldest first: shared sealed lines, or text
+    struct Slice {
+        uint32_t source = 0;
+        uint64_t epoch = 0;
+        uint64_t firstLine = 0;             ///< Absolute line of the first
+        uint64_t endLine = 0;               ///< The source's end when added (for ages)
+        ScrollbackView view;
+        std::string text;                   ///< Lines each ending in '\n'
+        std::vector<uint32_t> lineEnds;     ///< Offset past each line's '\n'
+    };
+
+    /// State of one search, shared with its slices on the pool
+    struct Run;
+
+    /// A slice on its way to the pool, with its search
+    struct Task;
+
+    /// A source not yet read to its end (UI thread)
+    struct Source {
+        uint32_t id = 0;
+        const TerminalBuffer* buffer = nullptr;
+        uint64_t epoch = 0;
+        uint64_t nextId = 0;                ///< Next stored line to take
+        uint64_t storeEnd = 0;              ///< Store end id when added
+        uint64_t endLine = 0;               ///< Screen end when added
+        Slice screen;                       ///< Captured when added
+    };
+
+    /// Match a slice (pool thread)
+    static void Search(Run& run, Slice& slice);
+
+    /// Pool callback: search one slice, then free it
+    static void CALLBACK SliceProc(PTP_CALLBACK_INSTANCE instance, void* context);
+
+    /// Queue a slice on the pool (UI thread)
+    void Submit(Slice&& slice);
+
+    bool m_active = false;                  ///< UI thread
+    std::shared_ptr<Run> m_run;             ///< UI thread: the open or last search
+    std::vector<Source> m_sources;          ///< UI thread: sources left to read
+};
+
+} // namespace Console3::Core
@@ -0,0 +1,94 @@
+// Console3 - GraphemeTable.cpp
+// Interned combining-character sequences referenced by packed cells
+
+#include "Core/GraphemeTable.h"
+
+#include <algorithm>
+
+namespace Console3::Core {
+
+GraphemeTable& GraphemeTable::Shared() {
+    static GraphemeTable s_table;
+    return s_table;
+}
+
+uint32_t GraphemeTable::Hash(const Key& key) noexcept {
+    // FNV-1a over the codepoints
+    uint64_t hash = 14695981039346656037ull;
+    for (uint32_t cp : key) {
+        hash = (hash ^ cp) * 1099511628211ull;
+    }
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+std::optional<uint32_t> GraphemeTable::Find(const Key& key, uint32_t& slot) const noexcept {
+    const std::atomic<uint32_t>* slots = m_slots.load(std::memory_order_acquire);
+    slot = Hash(key) & (kSlots - 1);
+    if (!slots) {
+        return std::nullopt;
+    }
+
+    // A slot is written after its entry, so an entry seen through it is whole
+    for (;; slot = (slot + 1) & (kSlots - 1)) {
+        const uint32_t value = slots[slot].load(std::memory_order_acquire);
+        if (value == 0) {
+            return std::nullopt;
+        }
+        const Entry& entry = Get(value - 1);
+        if (entry.base == key[0] && std::equal(entry.combining.begin(), entry.combining.end(), key.begin() + 1)) {
+            return value - 1;
+        }
+    }
+}
+
+std::optional<uint32_t> GraphemeTable::Intern(uint32_t base, const uint32_t (&combining)[kMaxCombining]) {
+    Key key{base};
+    uint32_t count = 0;
+    while (count < kMaxCombining && combining[count] != 0) {
+        key[1 + count] = combining[count];
+        ++count;
+    }
+
+    uint32_t slot = 0;
+    if (const auto found = Find(key, slot)) {
+        return found;
+    }
+
+    // Not there: look again under the lock, another thread may have added it
+    std::lock_guard lock(m_lock);
+    if (const auto found = Find(key, slot)) {
+        return found;
+    }
+    if (m_size == kChunkSize * kMaxChunks) {
+        return std::nullopt;
+    }
+    if (!m_slotStorage) {
+        m_slotStorage = std::make_unique<std::atomic<uint32_t>[]>(kSlots);
+        m_slots.store(m_slotStorage.get(), std::memory_order_release);
+    }
+
+    // Chunks are published before any index into them is handed out
+    const uint32_t index = m_size;
+    if (index % kChunkSize == 0) {
+        m_storage.push_back(std::make_unique<Entry[]>(kChunkSize));
+        m_chunks[index / kChunkSize].store(m_storage.back().get(), std::memory_order_release);
+    }
+
+    Entry& entry = m_storage[index / kChunkSize][index % kChunkSize];
+    entry.base = base;
+    for (uint32_t i = 0; i < count; ++i) {
+        entry.combining[i] = key[1 + i];
+    }
+    entry.count = count;
+
+    m_slotStorage[slot].store(index + 1, std::memory_order_release);
+    ++m_size;
+    return index;
+}
+
+size_t GraphemeTable::GetSize() const {
+    std::lock_guard lock(m_lock);
+    return m_size;
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,94 @@
+#pragma once
+// Console3 - GraphemeTable.h
+// Interned combining-character sequences referenced by packed cells
+//
+// Almost every cell holds a single codepoint, so Cell has no room for
+// combining characters. A cell that needs them stores an index into this
+// table instead. Sequences are interned once for the whole process: the same
+// sequence always gets the same index, so cells compare equal across buffers
+// and can be copied between the emulation and UI buffers and scrollback
+// without translation. Entries are never removed or moved, which lets Get()
+// run without a lock on any thread.
+//
+// Every session's emulator interns the sequences it prints, on its own
+// thread, and nearly every call finds one already there (the same emoji and
+// accented letters, over and over), so finding one takes no lock either:
+// the index is an open-addressed table of entry numbers, each slot written
+// once, after its entry, and never cleared. Only adding a sequence takes the
+// lock. The index (kSlots, twice the entries at most) is allocated with the
+// first sequence, so a process that never sees one pays nothing for it.
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace Console3::Core {
+
+/// Process-wide table of base + combining character sequences
+class GraphemeTable {
+public:
+    static constexpr size_t kMaxCombining = 3;
+    static constexpr uint32_t kChunkSize = 4096;
+    static constexpr uint32_t kMaxChunks = 16;   ///< 65536 sequences, 1 MB at most
+    static constexpr uint32_t kSlots = 2 * kChunkSize * kMaxChunks;   ///< Index slots (512 KB)
+
+    /// One interned sequence
+    struct Entry {
+        uint32_t base = 0;
+        std::array<uint32_t, kMaxCombining> combining{};
+        uint32_t count = 0;                      ///< Combining characters in use
+
+        [[nodiscard]] std::span<const uint32_t> Combining() const noexcept {
+            return {combining.data(), count};
+        }
+    };
+
+    GraphemeTable() = default;
+
+    // Non-copyable, non-movable
+    GraphemeTable(const GraphemeTable&) = delete;
+    GraphemeTable& operator=(const GraphemeTable&) = delete;
+
+    /// Get the table used by every terminal buffer
+    static GraphemeTable& Shared();
+
+    /// Find or add a sequence (lock-free if it is there already)
+    /// @param combining Combining characters, 0-terminated if fewer than kMaxCombining
+    /// @return Index for Get(), or nullopt if the table is full
+    [[nodiscard]] std::optional<uint32_t> Intern(uint32_t base, const uint32_t (&combining)[kMaxCombining]);
+
+    /// Look up an index returned by Intern() (lock-free)
+    [[nodiscard]] const Entry& Get(uint32_t index) const noexcept {
+        return m_chunks[index / kChunkSize].load(std::memory_order_acquire)[index % kChunkSize];
+    }
+
+    /// Number of sequences interned so far
+    [[nodiscard]] size_t GetSize() const;
+
+private:
+    using Key = std::array<uint32_t, 1 + kMaxCombining>;
+
+    /// Hash over the base and combining characters
+    [[nodiscard]] static uint32_t Hash(const Key& key) noexcept;
+
+    /// Look a sequence up in the index
+    /// @param slot Receives the slot it was found in, or the empty slot that
+    ///             ended the search
+    /// @return Its index, or nullopt if it is not there (yet)
+    [[nodiscard]] std::optional<uint32_t> Find(const Key& key, uint32_t& slot) const noexcept;
+
+    std::array<std::atomic<Entry*>, kMaxChunks> m_chunks{};
+    std::atomic<std::atomic<uint32_t>*> m_slots{nullptr};   ///< Entry index + 1 (0 = empty)
+
+    mutable std::mutex m_lock;
+    std::vector<std::unique_ptr<Entry[]>> m_storage;
+    std::unique_ptr<std::atomic<uint32_t>[]> m_slotStorage;
+    uint32_t m_size = 0;
+};
+
+} // namespace Console3::Core
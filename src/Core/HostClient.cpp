@@ -0,0 +1,184 @@
+// Console3 - HostClient.cpp
+// A window's end of a session host's pipe
+
+#include "Core/HostClient.h"
+#include "Core/SegmentedRingBuffer.h"
+
+namespace Console3::Core {
+
+HostClient::~HostClient() {
+    Stop();
+}
+
+bool HostClient::Connect(const std::wstring& pipePath) {
+    if (!m_cancel && !m_cancel.try_create(wil::EventOptions::ManualReset, nullptr)) {
+        return false;
+    }
+
+    // Identification only: a server squatting the name cannot act as us
+    const DWORD flags = FILE_FLAG_OVERLAPPED | SECURITY_SQOS_PRESENT | SECURITY_IDENTIFICATION;
+    const ULONGLONG deadline = GetTickCount64() + kConnectTimeoutMs;
+    for (;;) {
+        const HANDLE pipe = CreateFileW(pipePath.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+                                        OPEN_EXISTING, flags, nullptr);
+        if (pipe != INVALID_HANDLE_VALUE) {
+            m_pipe.reset(pipe);
+            return true;
+        }
+        const DWORD error = GetLastError();
+        const ULONGLONG now = GetTickCount64();
+        if (error != ERROR_PIPE_BUSY || now >= deadline ||
+            !WaitNamedPipeW(pipePath.c_str(), static_cast<DWORD>(deadline - now))) {
+            return false;
+        }
+    }
+}
+
+bool HostClient::Start(SegmentedRingBuffer* output, int rows, int cols, std::function<void(DWORD)> onExit) {
+    if (!m_pipe || !output || m_reader.joinable()) {
+        return false;
+    }
+    m_output = output;
+    m_onExit = std::move(onExit);
+    m_localSize.store((static_cast<uint64_t>(rows) << 32) | static_cast<uint32_t>(cols));
+    ResetEvent(m_cancel.get());
+    {
+        std::lock_guard<std::mutex> lock(m_waitLock);
+        m_closed = false;
+    }
+
+    // The host takes this window's size; its first frame is the whole screen
+    (void)Resize(cols, rows);
+    m_reader = std::thread([this]() { ReaderThreadProc(); });
+    return true;
+}
+
+void HostClient::Stop() {
+    if (m_cancel) {
+        SetEvent(m_cancel.get());
+    }
+    if (m_output) {
+        m_output->CancelWaits();
+    }
+    if (m_reader.joinable()) {
+        m_reader.join();
+    }
+    m_pipe.reset();
+}
+
+bool HostClient::Write(std::string_view data) {
+    return Send(HostMessage::Input, data);
+}
+
+bool HostClient::Paste(std::string_view text, bool bracketed) {
+    std::string payload;
+    payload.reserve(1 + text.size());
+    payload += static_cast<char>(bracketed ? 1 : 0);
+    payload += text;
+    return Send(HostMessage::Paste, payload);
+}
+
+bool HostClient::SendMouse(const Emulation::MouseEvent& event) {
+    return Send(HostMessage::Mouse, EncodeHostMouse(event));
+}
+
+bool HostClient::Resize(int cols, int rows) {
+    m_localSize.store((static_cast<uint64_t>(rows) << 32) | static_cast<uint32_t>(cols));
+    return Send(HostMessage::Resize, EncodeHostResize(cols, rows));
+}
+
+bool HostClient::WaitForText(const SearchQuery& query, DWORD timeoutMs, HostWaitResult& result) {
+    PendingWait pending;
+    if (!pending.answered.try_create(wil::EventOptions::ManualReset, nullptr)) {
+        return false;
+    }
+    HostWaitRequest request;
+    request.timeoutMs = timeoutMs;
+    request.query = query;
+    {
+        std::lock_guard<std::mutex> lock(m_waitLock);
+        if (m_closed || !m_reader.joinable()) {
+            return false;
+        }
+        request.id = m_nextWaitId++;
+        m_waits.emplace(request.id, &pending);
+    }
+
+    // The host answers by the timeout, or the reader gives up on the pipe
+    const bool sent = Send(HostMessage::Wait, EncodeHostWait(request));
+    if (sent) {
+        (void)WaitForSingleObject(pending.answered.get(), INFINITE);
+    }
+    std::lock_guard<std::mutex> lock(m_waitLock);
+    m_waits.erase(request.id);
+    result = pending.result;
+    return sent && result.id == request.id;
+}
+
+void HostClient::Answer(const HostWaitResult* result) {
+    std::lock_guard<std::mutex> lock(m_waitLock);
+    if (!result) {
+        m_closed = true;
+        for (const auto& [id, pending] : m_waits) {
+            pending->answered.SetEvent();
+        }
+        return;
+    }
+    const auto it = m_waits.find(result->id);
+    if (it != m_waits.end()) {
+        it->second->result = *result;
+        it->second->answered.SetEvent();
+    }
+}
+
+bool HostClient::Send(HostMessage type, std::string_view payload) {
+    std::lock_guard<std::mutex> lock(m_writeLock);
+    return m_pipe && WriteHostMessage(m_pipe.get(), m_cancel.get(), type, payload);
+}
+
+void HostClient::ReaderThreadProc() {
+    HostMessage type = HostMessage::Frame;
+    std::string payload;
+    std::string vt;
+    DWORD exitCode = ERROR_BROKEN_PIPE;     // The host went away without saying
+    while (ReadHostMessage(m_pipe.get(), m_cancel.get(), type, payload)) {
+        if (type == HostMessage::Exit) {
+            (void)DecodeHostExit(payload, exitCode);
+            break;
+        }
+        if (type == HostMessage::WaitResult) {
+            HostWaitResult result;
+            if (DecodeHostWaitResult(payload, result)) {
+                Answer(&result);
+            }
+            continue;
+        }
+        if (type != HostMessage::Frame || !m_decoder.Apply(payload)) {
+            continue;
+        }
+        m_frames.fetch_add(1, std::memory_order_relaxed);
+        m_frameBytes.fetch_add(payload.size(), std::memory_order_relaxed);
+
+        // The window may have been resized since the host drew this frame
+        const uint64_t size = m_localSize.load();
+        vt.clear();
+        m_decoder.RenderVt(vt, static_cast<int>(size >> 32), static_cast<int>(size & 0xFFFFFFFF));
+
+        size_t done = 0;
+        while (done < vt.size()) {
+            done += m_output->Write(vt.data() + done, vt.size() - done);
+            if (done < vt.size() && !m_output->WaitForSpace()) {
+                Answer(nullptr);
+                return;     // Stopping
+            }
+        }
+    }
+
+    // Waits still pending are never answered now
+    Answer(nullptr);
+    if (WaitForSingleObject(m_cancel.get(), 0) != WAIT_OBJECT_0 && m_onExit) {
+        m_onExit(exitCode);
+    }
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,106 @@
+#pragma once
+// Console3 - HostClient.h
+// A window's end of a session host's pipe
+//
+// An attached session (SessionConfig::hostPipe) has no PTY: input goes to
+// the host over its pipe, and a reader thread applies the host's screen
+// frames to a ScreenDeltaDecoder and renders each as VT into the session's
+// output ring, where the session's own emulator parses it like any shell
+// output. The local screen is a copy of the host's, a frame behind at most,
+// and lines the host scrolled off pass through the local scrollback.
+//
+// The host's exit message, or the pipe breaking, is reported as the
+// session's shell exiting. WaitForText() waits on the host's own matching
+// (HostMessage::Wait), for callers that drive a host without a screen.
+
+#include <Windows.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <wil/resource.h>
+
+#include "Core/HostProtocol.h"
+#include "Core/ScreenDelta.h"
+
+namespace Console3::Core {
+
+class SegmentedRingBuffer;
+
+/// Connects a session to a host
+class HostClient {
+public:
+    /// Time Connect() waits for a busy pipe
+    static constexpr DWORD kConnectTimeoutMs = 5000;
+
+    HostClient() = default;
+    ~HostClient();
+
+    HostClient(const HostClient&) = delete;
+    HostClient& operator=(const HostClient&) = delete;
+
+    /// Open a host's pipe (without starting to read)
+    /// @return false if there is no such host
+    [[nodiscard]] bool Connect(const std::wstring& pipePath);
+
+    /// Start rendering frames into output
+    /// @param rows Local screen size: frames are clipped to it
+    /// @param onExit Called on the reader thread when the host is gone
+    [[nodiscard]] bool Start(SegmentedRingBuffer* output, int rows, int cols, std::function<void(DWORD)> onExit);
+
+    /// Stop reading and close the pipe
+    void Stop();
+
+    // Input for the host's shell (any thread; false once the pipe broke)
+    bool Write(std::string_view data);
+    bool Paste(std::string_view text, bool bracketed);
+    bool SendMouse(const Emulation::MouseEvent& event);
+    bool Resize(int cols, int rows);
+
+    /// Have the host wait for text in its output, and wait for its answer
+    /// (any thread, once Start() has been called)
+    /// @return false if the pipe broke first
+    [[nodiscard]] bool WaitForText(const SearchQuery& query, DWORD timeoutMs, HostWaitResult& result);
+
+    /// Get frames applied, and the bytes they came in
+    [[nodiscard]] uint64_t GetFrames() const noexcept { return m_frames.load(std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t GetFrameBytes() const noexcept { return m_frameBytes.load(std::memory_order_relaxed); }
+
+private:
+    void ReaderThreadProc();
+
+    /// Send a message under the write lock
+    bool Send(HostMessage type, std::string_view payload);
+
+    /// A WaitForText() call waiting for its answer
+    struct PendingWait {
+        wil::unique_event_nothrow answered;
+        HostWaitResult result;
+    };
+
+    /// Answer a pending wait, or all of them (the pipe broke)
+    void Answer(const HostWaitResult* result);
+
+    wil::unique_hfile m_pipe;
+    wil::unique_event m_cancel;     ///< Manual reset: ends the reader and any transfer
+    std::thread m_reader;
+    std::mutex m_writeLock;
+    SegmentedRingBuffer* m_output = nullptr;
+    std::function<void(DWORD)> m_onExit;
+
+    ScreenDeltaDecoder m_decoder;   ///< Reader thread
+    std::atomic<uint64_t> m_localSize{0};  ///< rows << 32 | cols
+    std::atomic<uint64_t> m_frames{0};
+    std::atomic<uint64_t> m_frameBytes{0};
+
+    std::mutex m_waitLock;
+    std::map<uint32_t, PendingWait*> m_waits;   ///< Guarded by m_waitLock
+    uint32_t m_nextWaitId = 1;                  ///< Guarded by m_waitLock
+    bool m_closed = false;                      ///< The reader is done (guarded)
+};
+
+} // namespace Console3::Core
@@ -0,0 +1,217 @@
+// Console3 - HostProtocol.cpp
+// Messages between a session host and the windows attached to it
+
+#include "Core/HostProtocol.h"
+#include <algorithm>
+#include <wil/resource.h>
+
+namespace Console3::Core {
+
+namespace {
+
+constexpr size_t kHeaderBytes = 5;
+
+void PutU16(std::string& out, uint32_t value) {
+    out += static_cast<char>(value & 0xFF);
+    out += static_cast<char>((value >> 8) & 0xFF);
+}
+
+void PutU32(std::string& out, uint32_t value) {
+    PutU16(out, value & 0xFFFF);
+    PutU16(out, value >> 16);
+}
+
+void PutU64(std::string& out, uint64_t value) {
+    PutU32(out, static_cast<uint32_t>(value));
+    PutU32(out, static_cast<uint32_t>(value >> 32));
+}
+
+[[nodiscard]] uint32_t GetU16(std::string_view data, size_t pos) noexcept {
+    return static_cast<uint8_t>(data[pos]) | (static_cast<uint32_t>(static_cast<uint8_t>(data[pos + 1])) << 8);
+}
+
+[[nodiscard]] uint32_t GetU32(std::string_view data, size_t pos) noexcept {
+    return GetU16(data, pos) | (GetU16(data, pos + 2) << 16);
+}
+
+[[nodiscard]] uint64_t GetU64(std::string_view data, size_t pos) noexcept {
+    return GetU32(data, pos) | (static_cast<uint64_t>(GetU32(data, pos + 4)) << 32);
+}
+
+constexpr uint8_t kWaitMatchCase = 1;
+constexpr uint8_t kWaitRegex = 2;
+
+/// Move exactly length bytes, waiting on each transfer and the cancel event
+bool Transfer(HANDLE pipe, HANDLE cancel, char* data, size_t length, bool write) {
+    wil::unique_event done;
+    if (!done.try_create(wil::EventOptions::ManualReset, nullptr)) {
+        return false;
+    }
+
+    size_t moved = 0;
+    while (moved < length) {
+        OVERLAPPED overlapped = {};
+        overlapped.hEvent = done.get();
+        const DWORD request = static_cast<DWORD>(std::min<size_t>(length - moved, 1 << 20));
+        DWORD bytes = 0;
+        const BOOL ok = write ? WriteFile(pipe, data + moved, request, &bytes, &overlapped)
+                              : ReadFile(pipe, data + moved, request, &bytes, &overlapped);
+        if (!ok) {
+            if (GetLastError() != ERROR_IO_PENDING) {
+                return false;
+            }
+            const HANDLE waits[] = {done.get(), cancel};
+            const DWORD wait = WaitForMultipleObjects(cancel ? 2 : 1, waits, FALSE, INFINITE);
+            if (wait != WAIT_OBJECT_0) {
+                CancelIoEx(pipe, &overlapped);
+                (void)GetOverlappedResult(pipe, &overlapped, &bytes, TRUE);
+                return false;
+            }
+            if (!GetOverlappedResult(pipe, &overlapped, &bytes, FALSE)) {
+                return false;
+            }
+        }
+        if (bytes == 0 && request != 0) {
+            return false;
+        }
+        moved += bytes;
+    }
+    return true;
+}
+
+} // namespace
+
+std::wstring GetHostPipePath(std::wstring_view name, std::wstring_view server) {
+    std::wstring path = L"\\\\";
+    path += server.empty() ? std::wstring_view(L".") : server;
+    path += L"\\pipe\\Console3-host-";
+    path += name;
+    return path;
+}
+
+bool WriteHostMessage(HANDLE pipe, HANDLE cancel, HostMessage type, std::string_view payload) {
+    if (payload.size() > kMaxHostMessageBytes) {
+        return false;
+    }
+    // Header and payload in one write
+    std::string message;
+    message.reserve(kHeaderBytes + payload.size());
+    message += static_cast<char>(type);
+    PutU32(message, static_cast<uint32_t>(payload.size()));
+    message += payload;
+    return Transfer(pipe, cancel, message.data(), message.size(), true);
+}
+
+bool ReadHostMessage(HANDLE pipe, HANDLE cancel, HostMessage& type, std::string& payload) {
+    char header[kHeaderBytes];
+    if (!Transfer(pipe, cancel, header, sizeof(header), false)) {
+        return false;
+    }
+    const uint32_t length = GetU32(std::string_view(header, sizeof(header)), 1);
+    if (length > kMaxHostMessageBytes) {
+        return false;
+    }
+    type = static_cast<HostMessage>(header[0]);
+    payload.resize(length);
+    return Transfer(pipe, cancel, payload.data(), length, false);
+}
+
+std::string EncodeHostResize(int cols, int rows) {
+    std::string payload;
+    PutU16(payload, static_cast<uint32_t>(cols));
+    PutU16(payload, static_cast<uint32_t>(rows));
+    return payload;
+}
+
+bool DecodeHostResize(std::string_view payload, int& cols, int& rows) {
+    if (payload.size() != 4) {
+        return false;
+    }
+    cols = static_cast<int>(GetU16(payload, 0));
+    rows = static_cast<int>(GetU16(payload, 2));
+    return cols > 0 && rows > 0;
+}
+
+std::string EncodeHostMouse(const Emulation::MouseEvent& event) {
+    std::string payload;
+    PutU16(payload, static_cast<uint32_t>(event.row));
+    PutU16(payload, static_cast<uint32_t>(event.col));
+    payload += static_cast<char>(event.button);
+    payload += static_cast<char>(event.pressed ? 1 : 0);
+    payload += static_cast<char>(event.modifiers);
+    return payload;
+}
+
+bool DecodeHostMouse(std::string_view payload, Emulation::MouseEvent& event) {
+    if (payload.size() != 7) {
+        return false;
+    }
+    event.row = static_cast<int>(GetU16(payload, 0));
+    event.col = static_cast<int>(GetU16(payload, 2));
+    event.button = static_cast<uint8_t>(payload[4]);
+    event.pressed = payload[5] != 0;
+    event.modifiers = static_cast<uint8_t>(payload[6]);
+    return true;
+}
+
+std::string EncodeHostExit(DWORD exitCode) {
+    std::string payload;
+    PutU32(payload, exitCode);
+    return payload;
+}
+
+bool DecodeHostExit(std::string_view payload, DWORD& exitCode) {
+    if (payload.size() != 4) {
+        return false;
+    }
+    exitCode = GetU32(payload, 0);
+    return true;
+}
+
+std::string EncodeHostWait(const HostWaitRequest& request) {
+    std::string payload;
+    PutU32(payload, request.id);
+    PutU32(payload, request.timeoutMs);
+    payload += static_cast<char>((request.query.matchCase ? kWaitMatchCase : 0) |
+                                 (request.query.regex ? kWaitRegex : 0));
+    payload += request.query.text;
+    return payload;
+}
+
+bool DecodeHostWait(std::string_view payload, HostWaitRequest& request) {
+    if (payload.size() < 9) {
+        return false;
+    }
+    request.id = GetU32(payload, 0);
+    request.timeoutMs = GetU32(payload, 4);
+    const uint8_t flags = static_cast<uint8_t>(payload[8]);
+    request.query.matchCase = (flags & kWaitMatchCase) != 0;
+    request.query.regex = (flags & kWaitRegex) != 0;
+    request.query.text = payload.substr(9);
+    return true;
+}
+
+std::string EncodeHostWaitResult(const HostWaitResult& result) {
+    std::string payload;
+    PutU32(payload, result.id);
+    payload += static_cast<char>(result.status);
+    PutU64(payload, result.match.line);
+    PutU32(payload, static_cast<uint32_t>(result.match.offset));
+    payload += result.match.text;
+    return payload;
+}
+
+bool DecodeHostWaitResult(std::string_view payload, HostWaitResult& result) {
+    if (payload.size() < 17 || static_cast<uint8_t>(payload[4]) > static_cast<uint8_t>(HostWaitStatus::Invalid)) {
+        return false;
+    }
+    result.id = GetU32(payload, 0);
+    result.status = static_cast<HostWaitStatus>(payload[4]);
+    result.match.line = GetU64(payload, 5);
+    result.match.offset = GetU32(payload, 13);
+    result.match.text = payload.substr(17);
+    result.match.length = result.match.text.size();
+    return true;
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,99 @@
+#pragma once
+// Console3 - HostProtocol.h
+// Messages between a session host and the windows attached to it
+//
+// A session host (SessionHost, "Console3.exe --host NAME") serves its
+// session on the named pipe \\.\pipe\Console3-host-NAME. Each message is a
+// type byte and a 32-bit little-endian payload length, then the payload.
+// The host sends screen frames (ScreenDelta) and, once, the shell's exit
+// code; a window sends keyboard input, pastes, mouse events and resizes.
+//
+// A window (or a script) can also wait for text in the output: the host
+// matches the wait as it parses (OutputWaits) and answers once, when it
+// matched, timed out or the shell exited, after the frame that shows it.
+//
+// Pipes are opened for overlapped I/O so a transfer can be given up on: the
+// helpers here wait on the transfer and a cancel event, and cancel the I/O
+// if the event is signaled first.
+
+#include <Windows.h>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "Core/OutputWaits.h"
+#include "Core/ScrollbackSearch.h"
+#include "Emulation/VTermWrapper.h"
+
+namespace Console3::Core {
+
+/// Message types
+enum class HostMessage : uint8_t {
+    // Host to window
+    Frame = 1,      ///< A ScreenDelta frame
+    Exit = 2,       ///< The shell exited: u32 exit code
+    WaitResult = 3, ///< EncodeHostWaitResult()
+
+    // Window to host
+    Input = 16,     ///< Bytes for the shell's input
+    Paste = 17,     ///< u8 bracketed, then UTF-8 text
+    Mouse = 18,     ///< EncodeHostMouse()
+    Resize = 19,    ///< u16 cols, u16 rows
+    Wait = 20,      ///< EncodeHostWait()
+};
+
+/// How a wait ended
+enum class HostWaitStatus : uint8_t {
+    Matched = 0,
+    TimedOut = 1,
+    Exited = 2,     ///< The shell exited first
+    Invalid = 3     ///< The pattern can't match (an invalid expression)
+};
+
+/// A wait for text, sent by a window
+struct HostWaitRequest {
+    uint32_t id = 0;                ///< Echoed in the result
+    uint32_t timeoutMs = 0;
+    SearchQuery query;
+};
+
+/// The answer to a wait
+struct HostWaitResult {
+    uint32_t id = 0;
+    HostWaitStatus status = HostWaitStatus::TimedOut;
+    OutputMatch match;              ///< Line numbers are the host's (Matched only)
+};
+
+/// Largest payload accepted (a full frame of a 4096-column screen fits)
+constexpr uint32_t kMaxHostMessageBytes = 64 * 1024 * 1024;
+
+/// Get the pipe path for a host name
+/// @param server Machine the host runs on (empty = this one)
+[[nodiscard]] std::wstring GetHostPipePath(std::wstring_view name, std::wstring_view server = {});
+
+/// Write one message
+/// @param cancel Event that abandons the write (may be null)
+/// @return false on a broken pipe or cancellation
+bool WriteHostMessage(HANDLE pipe, HANDLE cancel, HostMessage type, std::string_view payload);
+
+/// Read one message
+/// @return false on a broken pipe, cancellation or an oversized message
+bool ReadHostMessage(HANDLE pipe, HANDLE cancel, HostMessage& type, std::string& payload);
+
+/// Payloads of the fixed-size messages
+[[nodiscard]] std::string EncodeHostResize(int cols, int rows);
+[[nodiscard]] bool DecodeHostResize(std::string_view payload, int& cols, int& rows);
+[[nodiscard]] std::string EncodeHostMouse(const Emulation::MouseEvent& event);
+[[nodiscard]] bool DecodeHostMouse(std::string_view payload, Emulation::MouseEvent& event);
+[[nodiscard]] std::string EncodeHostExit(DWORD exitCode);
+[[nodiscard]] bool DecodeHostExit(std::string_view payload, DWORD& exitCode);
+
+/// Wait payloads: u32 id, u32 timeout, u8 flags (1 = match case, 2 = regex),
+/// then the UTF-8 pattern; and u32 id, u8 status, u64 line, u32 offset,
+/// then the UTF-8 text matched
+[[nodiscard]] std::string EncodeHostWait(const HostWaitRequest& request);
+[[nodiscard]] bool DecodeHostWait(std::string_view payload, HostWaitRequest& request);
+[[nodiscard]] std::string EncodeHostWaitResult(const HostWaitResult& result);
+[[nodiscard]] bool DecodeHostWaitResult(std::string_view payload, HostWaitResult& result);
+
+} // namespace Console3::Core
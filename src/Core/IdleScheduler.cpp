@@ -0,0 +1,236 @@
+// Console3 - IdleScheduler.cpp
+// Maintenance work for when the machine is quiet
+
+#include "Core/IdleScheduler.h"
+#include "Core/PerfClock.h"
+#include "Core/ThreadPolicy.h"
+#include <algorithm>
+#include <system_error>
+
+namespace Console3::Core {
+
+bool IdleBudget::ShouldYield() const noexcept {
+    if (PerfClock::NowMicros() >= m_deadlineMicros) {
+        return true;
+    }
+    if (m_activity.load(std::memory_order_relaxed) != m_startActivity) {
+        return true;
+    }
+    return m_uiThread && (HIWORD(GetQueueStatus(QS_INPUT | QS_POSTMESSAGE)) & (QS_INPUT | QS_POSTMESSAGE)) != 0;
+}
+
+IdleScheduler& IdleScheduler::Shared() {
+    static IdleScheduler scheduler;
+    return scheduler;
+}
+
+IdleScheduler::~IdleScheduler() {
+    Stop();
+}
+
+uint32_t IdleScheduler::Add(IdleVenue venue, IdleTask task, bool repeat) {
+    auto entry = std::make_shared<Task>();
+    entry->venue = venue;
+    entry->step = std::move(task);
+    entry->repeat = repeat;
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (venue == IdleVenue::Worker && !m_worker.joinable()) {
+        if (m_stopping || (!m_wake && !m_wake.try_create(wil::EventOptions::None, nullptr))) {
+            return 0;
+        }
+        try {
+            m_worker = std::thread([this]() { WorkerProc(); });
+        } catch (const std::system_error&) {
+            return 0;
+        }
+    }
+    entry->id = m_nextId++;
+    if (m_nextId == 0) {
+        m_nextId = 1;
+    }
+    m_tasks.push_back(entry);
+    if (venue == IdleVenue::Worker) {
+        SetEvent(m_wake.get());
+    }
+    return entry->id;
+}
+
+void IdleScheduler::Cancel(uint32_t id) {
+    if (id == 0) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(m_lock);
+    const auto it = std::find_if(m_tasks.begin(), m_tasks.end(),
+                                 [id](const std::shared_ptr<Task>& task) { return task->id == id; });
+    if (it != m_tasks.end()) {
+        (*it)->cancelled = true;
+        m_tasks.erase(it);
+    }
+
+    // The worker may be in its step; a step cancelling itself goes on
+    if (m_worker.joinable() && std::this_thread::get_id() != m_worker.get_id()) {
+        m_stepDone.wait(lock, [this, id]() { return m_workerStep != id; });
+    }
+}
+
+void IdleScheduler::NoteActivity() noexcept {
+    m_lastActivityMs.store(GetTickCount64(), std::memory_order_relaxed);
+    m_activity.fetch_add(1);
+
+    // Repeating worker tasks are due again once this activity ends
+    if (m_parked.load(std::memory_order_relaxed) && m_parked.exchange(false)) {
+        SetEvent(m_wake.get());
+    }
+}
+
+uint64_t IdleScheduler::QuietRemainingMs() const noexcept {
+    const uint64_t now = GetTickCount64();
+    const uint64_t since = now - std::min(now, m_lastActivityMs.load(std::memory_order_relaxed));
+    uint64_t remaining = since < kQuietMs ? kQuietMs - since : 0;
+
+    // The desktop's last input; its tick wraps with GetTickCount
+    LASTINPUTINFO input{sizeof(input)};
+    if (GetLastInputInfo(&input)) {
+        const DWORD sinceInput = GetTickCount() - input.dwTime;
+        if (sinceInput < kQuietMs) {
+            remaining = std::max<uint64_t>(remaining, kQuietMs - sinceInput);
+        }
+    }
+    return remaining;
+}
+
+std::shared_ptr<IdleScheduler::Task> IdleScheduler::NextTask(IdleVenue venue) {
+    const uint64_t activity = m_activity.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < m_tasks.size(); ++i) {
+        const size_t index = (m_next + i) % m_tasks.size();
+        const std::shared_ptr<Task>& task = m_tasks[index];
+        if (task->venue == venue && task->doneActivity != activity) {
+            m_next = index + 1;
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+bool IdleScheduler::HasTask(IdleVenue venue) const {
+    const uint64_t activity = m_activity.load();
+    return std::any_of(m_tasks.begin(), m_tasks.end(), [venue, activity](const std::shared_ptr<Task>& task) {
+        return task->venue == venue && task->doneActivity != activity;
+    });
+}
+
+bool IdleScheduler::HasAnyTask(IdleVenue venue) const {
+    return std::any_of(m_tasks.begin(), m_tasks.end(),
+                       [venue](const std::shared_ptr<Task>& task) { return task->venue == venue; });
+}
+
+void IdleScheduler::Step(const std::shared_ptr<Task>& task, bool uiThread) {
+    const uint64_t activity = m_activity.load(std::memory_order_relaxed);
+    const IdleBudget budget(PerfClock::NowMicros() + kSliceMicros, m_activity, uiThread);
+    const bool more = task->step(budget);
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (more || task->cancelled) {
+        return;
+    }
+    if (task->repeat) {
+        task->doneActivity = activity;
+        return;
+    }
+    const auto it = std::find(m_tasks.begin(), m_tasks.end(), task);
+    if (it != m_tasks.end()) {
+        m_tasks.erase(it);
+    }
+}
+
+bool IdleScheduler::RunUiSlice() {
+    std::shared_ptr<Task> task;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (!HasTask(IdleVenue::UiThread)) {
+            return false;
+        }
+        if (const uint64_t remaining = QuietRemainingMs()) {
+            // Come back when it may be quiet; activity meanwhile moves it on
+            if (m_uiTimer) {
+                LARGE_INTEGER due{};
+                due.QuadPart = -static_cast<LONGLONG>(remaining) * 10000;
+                SetWaitableTimer(m_uiTimer.get(), &due, 0, nullptr, nullptr, FALSE);
+            }
+            return false;
+        }
+        task = NextTask(IdleVenue::UiThread);
+    }
+    Step(task, true);
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    return HasTask(IdleVenue::UiThread);
+}
+
+HANDLE IdleScheduler::GetUiWakeEvent() {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (!m_uiTimer) {
+        m_uiTimer.reset(CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS));
+    }
+    return m_uiTimer.get();
+}
+
+void IdleScheduler::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stopping = true;
+        if (!m_worker.joinable()) {
+            return;
+        }
+        SetEvent(m_wake.get());
+    }
+    m_worker.join();
+}
+
+void IdleScheduler::WorkerProc() {
+    ThreadPolicy::SetCurrentQos(ThreadQos::Eco);
+
+    for (;;) {
+        DWORD waitMs = INFINITE;
+        std::shared_ptr<Task> task;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            if (m_stopping) {
+                return;
+            }
+            if (HasTask(IdleVenue::Worker)) {
+                const uint64_t remaining = QuietRemainingMs();
+                if (remaining == 0) {
+                    task = NextTask(IdleVenue::Worker);
+                    m_workerStep = task->id;
+                } else {
+                    waitMs = static_cast<DWORD>(remaining);
+                }
+            } else if (HasAnyTask(IdleVenue::Worker)) {
+                // Only repeating tasks, done: NoteActivity() wakes the
+                // worker, so look again after parking in case it just ran
+                m_parked.store(true);
+                if (HasTask(IdleVenue::Worker)) {
+                    m_parked.store(false);
+                    continue;
+                }
+            }
+        }
+
+        if (!task) {
+            WaitForSingleObject(m_wake.get(), waitMs);
+            continue;
+        }
+
+        Step(task, false);
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_workerStep = 0;
+        }
+        m_stepDone.notify_all();
+        WaitForSingleObject(m_wake.get(), kWorkerRestMs);
+    }
+}
+
+} // namespace Console3::Core
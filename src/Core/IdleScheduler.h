@@ -0,0 +1,161 @@
+#pragma once
+// Console3 - IdleScheduler.h
+// Maintenance work for when the machine is quiet
+//
+// Giving memory back (compressing and spilling a hidden tab's scrollback,
+// trimming the ring chunk cache) costs time nobody should wait for, so it
+// does not run on the hot path. It runs here, as tasks that do a slice of
+// work per call:
+//
+//   UI thread - tasks that touch what the UI thread owns (sessions,
+//               buffers, views) run from the message loop's idle
+//               processing (WaitableMessageLoop::OnIdle), after the idle
+//               handlers, so only while the queue is empty.
+//   Worker    - the rest run on a thread of the scheduler's own, at
+//               EcoQoS (ThreadPolicy.h), resting kWorkerRestMs between
+//               slices.
+//
+// Nothing runs until kQuietMs after the last input anywhere on the desktop
+// and the last output or input in Console3 (NoteActivity()). A slice gets
+// kSliceMicros; the task checks IdleBudget::ShouldYield() between pieces of
+// its work, which turns true once the time is up and at once when input or
+// output arrives, so a task yields within one piece. A task returns true
+// while it has work left, and is dropped once it returns false, unless it
+// repeats: then it runs again after the next activity ends. Cancel() drops
+// a task at any time; a step running on the worker finishes first.
+
+#include <Windows.h>
+#include <wil/resource.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Console3::Core {
+
+/// Where an idle task runs (see file comment)
+enum class IdleVenue : uint8_t {
+    UiThread,   ///< The message loop's idle processing
+    Worker      ///< The scheduler's EcoQoS thread
+};
+
+/// What a step of an idle task may spend
+class IdleBudget {
+public:
+    IdleBudget(uint64_t deadlineMicros, const std::atomic<uint64_t>& activity, bool uiThread) noexcept
+        : m_deadlineMicros(deadlineMicros), m_activity(activity),
+          m_startActivity(activity.load(std::memory_order_relaxed)), m_uiThread(uiThread) {}
+
+    /// Check if the step must return: its time is up, or input or output
+    /// arrived since it started
+    [[nodiscard]] bool ShouldYield() const noexcept;
+
+private:
+    uint64_t m_deadlineMicros;
+    const std::atomic<uint64_t>& m_activity;    ///< The scheduler's activity count
+    uint64_t m_startActivity;
+    bool m_uiThread;                    ///< Also yield to messages in the queue
+};
+
+/// A step of an idle task
+/// @return true while the task has work left
+using IdleTask = std::function<bool(const IdleBudget& budget)>;
+
+/// Runs maintenance when the machine is quiet (see file comment)
+class IdleScheduler {
+public:
+    static constexpr uint64_t kQuietMs = 2000;          ///< Since the last input or output
+    static constexpr uint64_t kSliceMicros = 2000;      ///< A step's time
+    static constexpr DWORD kWorkerRestMs = 8;           ///< Worker: between slices
+
+    /// Get the process's scheduler
+    static IdleScheduler& Shared();
+
+    IdleScheduler() = default;
+    ~IdleScheduler();
+
+    // Non-copyable, non-movable
+    IdleScheduler(const IdleScheduler&) = delete;
+    IdleScheduler& operator=(const IdleScheduler&) = delete;
+
+    /// Add a task (any thread; UI thread tasks run on the thread calling
+    /// RunUiSlice())
+    /// @param repeat Run it again after each activity ends, instead of
+    ///               dropping it once it returns false
+    /// @return Its id for Cancel() (never 0), or 0 if the worker could not
+    ///         be started
+    uint32_t Add(IdleVenue venue, IdleTask task, bool repeat = false);
+
+    /// Drop a task (any thread; nothing if it is gone). A worker step
+    /// running now finishes first: the caller must not hold what it takes.
+    void Cancel(uint32_t id);
+
+    /// Note input or output: steps running yield, and nothing runs until
+    /// kQuietMs from now (any thread; cheap)
+    void NoteActivity() noexcept;
+
+    /// Check if Console3 and the desktop have been quiet for kQuietMs
+    [[nodiscard]] bool IsQuiet() const noexcept { return QuietRemainingMs() == 0; }
+
+    /// Run a step of the next UI thread task (message loop idle processing)
+    /// @return true if UI thread work is left to run now; false with work
+    ///         left but the machine busy arms GetUiWakeEvent()
+    bool RunUiSlice();
+
+    /// Get the timer signaled when UI thread tasks may run again; the
+    /// message loop waits on it, so its idle processing runs
+    [[nodiscard]] HANDLE GetUiWakeEvent();
+
+    /// Stop the worker, waiting for a step running (process exit)
+    void Stop();
+
+private:
+    struct Task {
+        uint32_t id = 0;
+        IdleVenue venue = IdleVenue::Worker;
+        IdleTask step;
+        bool repeat = false;
+        bool cancelled = false;
+        uint64_t doneActivity = UINT64_MAX;     ///< Repeating: the activity count it finished at
+    };
+
+    /// Milliseconds until the machine counts as quiet (0 if it does)
+    [[nodiscard]] uint64_t QuietRemainingMs() const noexcept;
+
+    /// Find the next task of a venue to step, round robin (m_lock held)
+    [[nodiscard]] std::shared_ptr<Task> NextTask(IdleVenue venue);
+
+    /// Check if a venue has a task to step (m_lock held)
+    [[nodiscard]] bool HasTask(IdleVenue venue) const;
+
+    /// Check if a venue has a task at all, done repeating ones too (m_lock held)
+    [[nodiscard]] bool HasAnyTask(IdleVenue venue) const;
+
+    /// Run a step of a task and drop it if it is done
+    void Step(const std::shared_ptr<Task>& task, bool uiThread);
+
+    void WorkerProc();
+
+    std::atomic<uint64_t> m_activity{0};        ///< Bumped by NoteActivity()
+    std::atomic<uint64_t> m_lastActivityMs{0};  ///< GetTickCount64 of the last activity
+    std::atomic<bool> m_parked{false};          ///< Worker waits for activity to rerun repeating tasks
+
+    mutable std::mutex m_lock;
+    std::condition_variable m_stepDone;
+    std::vector<std::shared_ptr<Task>> m_tasks; ///< Guarded by m_lock
+    size_t m_next = 0;                          ///< Guarded by m_lock: round robin position
+    uint32_t m_nextId = 1;                      ///< Guarded by m_lock
+    uint32_t m_workerStep = 0;                  ///< Guarded by m_lock: task the worker is stepping
+    bool m_stopping = false;                    ///< Guarded by m_lock
+
+    wil::unique_handle m_uiTimer;               ///< Waitable timer (auto reset)
+    wil::unique_event m_wake;                   ///< Auto reset: a task was added, or stop
+    std::thread m_worker;
+};
+
+} // namespace Console3::Core
@@ -0,0 +1,95 @@
+// Console3 - ImageDecoder.cpp
+// The thread decoding inline images off the emulator's thread
+
+#include "Core/ImageDecoder.h"
+
+#include <algorithm>
+#include <string_view>
+#include <system_error>
+
+namespace Console3::Core {
+
+ImageDecoder& ImageDecoder::Shared() {
+    static ImageDecoder s_decoder;
+    return s_decoder;
+}
+
+ImageDecoder::~ImageDecoder() {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stopping = true;
+        m_jobs.clear();
+    }
+    m_wake.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+bool ImageDecoder::Submit(ImageJob&& job) {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_stopping || m_queuedBytes + job.payload.size() > kMaxQueuedBytes) {
+            return false;
+        }
+        if (!m_thread.joinable()) {
+            try {
+                m_thread = std::thread(&ImageDecoder::ThreadProc, this);
+            } catch (const std::system_error&) {
+                return false;
+            }
+        }
+        m_queuedBytes += job.payload.size();
+        m_jobs.push_back(std::move(job));
+    }
+    m_wake.notify_one();
+    return true;
+}
+
+void ImageDecoder::AddListener(HWND hwnd, UINT message) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_listeners.emplace_back(hwnd, message);
+}
+
+void ImageDecoder::RemoveListener(HWND hwnd) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    std::erase_if(m_listeners, [hwnd](const auto& listener) { return listener.first == hwnd; });
+}
+
+void ImageDecoder::ThreadProc() {
+    std::unique_lock<std::mutex> lock(m_lock);
+    while (true) {
+        m_wake.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+        if (m_stopping) {
+            return;
+        }
+        ImageJob job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+        m_queuedBytes -= job.payload.size();
+
+        lock.unlock();
+        // A buffer closed meanwhile needs nothing decoded
+        if (const std::shared_ptr<ImageStore> store = job.store.lock()) {
+            DecodedImage image;
+            image.width = job.size.width;
+            image.height = job.size.height;
+            if (DecodeSixel(std::string_view(job.payload.data(), job.payload.size()), job.size, image.pixels)) {
+                store->Put(job.id, std::move(image));
+            }
+        }
+        job = {};
+        lock.lock();
+
+        if (m_jobs.empty()) {
+            Notify();
+        }
+    }
+}
+
+void ImageDecoder::Notify() {
+    for (const auto& [hwnd, message] : m_listeners) {
+        PostMessageW(hwnd, message, 0, 0);
+    }
+}
+
+} // namespace Console3::Core
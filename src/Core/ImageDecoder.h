@@ -0,0 +1,87 @@
+#pragma once
+// Console3 - ImageDecoder.h
+// The thread decoding inline images off the emulator's thread
+//
+// Decoding a sixel image inside the emulator's DCS callback would hold up
+// all the output behind it, and a large plot takes far longer to decode
+// than the text around it takes to parse. The emulator only measures the
+// image, to move the cursor past it, and hands its payload here as it
+// was received: the bytes are moved from the emulator into the job and
+// from the job to the decode, never copied. One thread decodes the jobs
+// in order into their buffers' image stores (ImageStore) and tells the
+// windows that asked (AddListener) once each batch is in.
+//
+// At most kMaxQueuedBytes of payloads wait; an image past that is dropped
+// (its placement draws nothing), so a program printing images faster than
+// they decode costs bounded memory.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Core/ImageStore.h"
+#include "Core/SixelImage.h"
+
+namespace Console3::Core {
+
+/// A sixel image to decode into its store
+struct ImageJob {
+    std::weak_ptr<ImageStore> store;    ///< Gone if the buffer closed meanwhile
+    uint64_t id = 0;                    ///< ImageStore::Reserve
+    std::vector<char> payload;          ///< The data after the DCS q
+    SixelSize size;                     ///< MeasureSixel
+};
+
+/// Process-wide image decoding thread (see file comment)
+class ImageDecoder {
+public:
+    static constexpr size_t kMaxQueuedBytes = 64u << 20;
+
+    /// Get the process's decoder
+    static ImageDecoder& Shared();
+
+    ImageDecoder() = default;
+    ~ImageDecoder();
+
+    ImageDecoder(const ImageDecoder&) = delete;
+    ImageDecoder& operator=(const ImageDecoder&) = delete;
+
+    /// Queue an image, starting the thread on first use
+    /// @return false if it was dropped (queue full, or no thread)
+    [[nodiscard]] bool Submit(ImageJob&& job);
+
+    /// Post a message to a window whenever decoded images are put
+    void AddListener(HWND hwnd, UINT message);
+    void RemoveListener(HWND hwnd);
+
+private:
+    void ThreadProc();
+
+    /// Post to the listeners (lock held)
+    void Notify();
+
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::deque<ImageJob> m_jobs;
+    size_t m_queuedBytes = 0;
+    std::thread m_thread;
+    bool m_stopping = false;
+    std::vector<std::pair<HWND, UINT>> m_listeners;
+};
+
+} // namespace Console3::Core
@@ -0,0 +1,100 @@
+// Console3 - ImageStore.cpp
+// Decoded inline images of one terminal buffer, under a memory budget
+
+#include "Core/ImageStore.h"
+
+namespace Console3::Core {
+
+uint64_t ImageStore::Reserve() {
+    std::lock_guard<std::mutex> lock(m_lock);
+    const uint64_t id = m_nextId++;
+    m_images.emplace(id, Entry{});
+    return id;
+}
+
+void ImageStore::Put(uint64_t id, DecodedImage&& image) {
+    const size_t bytes = image.GetBytes();
+    auto shared = std::make_shared<const DecodedImage>(std::move(image));
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    const auto it = m_images.find(id);
+    if (it == m_images.end() || it->second.image || bytes > m_budget) {
+        return;
+    }
+    Evict(m_budget - bytes);
+    it->second.image = std::move(shared);
+    it->second.lastUsed = ++m_clock;
+    m_bytes += bytes;
+    ++m_version;
+}
+
+std::shared_ptr<const DecodedImage> ImageStore::Get(uint64_t id) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    const auto it = m_images.find(id);
+    if (it == m_images.end() || !it->second.image) {
+        return nullptr;
+    }
+    it->second.lastUsed = ++m_clock;
+    return it->second.image;
+}
+
+void ImageStore::Release(uint64_t id) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    const auto it = m_images.find(id);
+    if (it == m_images.end()) {
+        return;
+    }
+    if (it->second.image) {
+        m_bytes -= it->second.image->GetBytes();
+        ++m_version;
+    }
+    m_images.erase(it);
+}
+
+void ImageStore::Clear() {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_images.clear();
+    m_bytes = 0;
+    ++m_version;
+}
+
+void ImageStore::SetBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_budget = bytes;
+    Evict(bytes);
+}
+
+size_t ImageStore::GetBudget() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_budget;
+}
+
+size_t ImageStore::GetBytes() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_bytes;
+}
+
+uint64_t ImageStore::GetVersion() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_version;
+}
+
+void ImageStore::Evict(size_t bytes) {
+    // A few images at most: a scan for the oldest beats keeping an order
+    while (m_bytes > bytes) {
+        Entry* oldest = nullptr;
+        for (auto& [id, entry] : m_images) {
+            if (entry.image && (!oldest || entry.lastUsed < oldest->lastUsed)) {
+                oldest = &entry;
+            }
+        }
+        if (!oldest) {
+            break;
+        }
+        m_bytes -= oldest->image->GetBytes();
+        oldest->image.reset();
+        ++m_version;
+    }
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,90 @@
+#pragma once
+// Console3 - ImageStore.h
+// Decoded inline images of one terminal buffer, under a memory budget
+//
+// An image arrives in three steps: the emulator measures it and the buffer
+// places it at the cursor's cell (TerminalBuffer::AddImage) with an id
+// reserved here; the image decoder's thread decodes it and puts the pixels
+// here (ImageDecoder); the view draws it from them, uploaded once as a
+// texture (D2DRenderer::DrawImage). Until the pixels arrive the placement
+// draws nothing.
+//
+// Decoded pixels count against the store's budget (kDefaultBudget unless
+// set), and the images drawn least recently are dropped to stay within it;
+// a placement of a dropped image draws nothing, as one whose image did not
+// fit the budget at all. Images no placement shows any more (trimmed with
+// their lines) are released at once.
+//
+// The emulator's thread reserves, the decoder's puts and the UI's gets:
+// every call takes the store's lock.
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Console3::Core {
+
+/// An image's pixels
+struct DecodedImage {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint32_t> pixels;   ///< Premultiplied BGRA, width * height
+
+    [[nodiscard]] size_t GetBytes() const noexcept { return pixels.size() * sizeof(uint32_t); }
+};
+
+/// Images of one buffer by id (see file comment)
+class ImageStore {
+public:
+    static constexpr size_t kDefaultBudget = 64u << 20;
+
+    /// Reserve an id for an image about to be decoded
+    [[nodiscard]] uint64_t Reserve();
+
+    /// Put an image's pixels (dropped if it was released meanwhile, or is
+    /// over the whole budget)
+    void Put(uint64_t id, DecodedImage&& image);
+
+    /// Get an image's pixels, marking it used
+    /// @return The image, or nullptr while it is decoded or once it was dropped
+    [[nodiscard]] std::shared_ptr<const DecodedImage> Get(uint64_t id);
+
+    /// Forget an image no placement shows
+    void Release(uint64_t id);
+
+    /// Forget every image
+    void Clear();
+
+    /// Set the budget (0 = keep no images), dropping images to fit
+    void SetBudget(size_t bytes);
+
+    [[nodiscard]] size_t GetBudget() const;
+
+    /// Get the bytes of pixels held
+    [[nodiscard]] size_t GetBytes() const;
+
+    /// Get a count that changes whenever an image arrives or is dropped
+    [[nodiscard]] uint64_t GetVersion() const;
+
+private:
+    struct Entry {
+        std::shared_ptr<const DecodedImage> image;  ///< nullptr while decoded, or dropped
+        uint64_t lastUsed = 0;
+    };
+
+    /// Drop the least recently used images until the bytes fit (lock held)
+    void Evict(size_t bytes);
+
+    mutable std::mutex m_lock;
+    std::unordered_map<uint64_t, Entry> m_images;
+    uint64_t m_nextId = 1;
+    uint64_t m_clock = 0;
+    uint64_t m_version = 0;
+    size_t m_bytes = 0;
+    size_t m_budget = kDefaultBudget;
+};
+
+} // namespace Console3::Core
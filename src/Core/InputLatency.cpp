@@ -0,0 +1,133 @@
+// Console3 - InputLatency.cpp
+// Keypress-to-photon latency measurement
+
+#include "Core/InputLatency.h"
+#include "Core/PerfClock.h"
+#include <algorithm>
+#include <bit>
+
+namespace Console3::Core {
+
+// ============================================================================
+// LatencyHistogram
+// ============================================================================
+
+size_t LatencyHistogram::BucketOf(uint64_t micros) noexcept {
+    if (micros < kSubBuckets) {
+        return static_cast<size_t>(micros);
+    }
+
+    // Octave from the top bit, sub-bucket from the two bits below it
+    const auto octave = static_cast<size_t>(std::bit_width(micros) - 1);
+    const auto sub = static_cast<size_t>((micros >> (octave - 2)) & (kSubBuckets - 1));
+    return std::min((octave - 1) * kSubBuckets + sub, kBuckets - 1);
+}
+
+uint64_t LatencyHistogram::UpperBound(size_t bucket) noexcept {
+    if (bucket < kSubBuckets) {
+        return bucket + 1;
+    }
+    const size_t octave = bucket / kSubBuckets + 1;
+    const uint64_t sub = bucket % kSubBuckets;
+    return ((kSubBuckets + sub + 1) << (octave - 2));
+}
+
+void LatencyHistogram::Add(uint64_t micros) noexcept {
+    ++m_buckets[BucketOf(micros)];
+    ++m_count;
+    m_max = std::max(m_max, micros);
+}
+
+void LatencyHistogram::Reset() noexcept {
+    m_buckets.fill(0);
+    m_count = 0;
+    m_max = 0;
+}
+
+uint64_t LatencyHistogram::Percentile(double fraction) const noexcept {
+    if (m_count == 0) {
+        return 0;
+    }
+
+    const auto target = std::max<uint64_t>(
+        1, static_cast<uint64_t>(std::clamp(fraction, 0.0, 1.0) * static_cast<double>(m_count) + 0.5));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < kBuckets; ++bucket) {
+        seen += m_buckets[bucket];
+        if (seen >= target) {
+            return std::min(UpperBound(bucket), m_max);
+        }
+    }
+    return m_max;
+}
+
+// ============================================================================
+// InputLatencyProbe
+// ============================================================================
+
+void InputLatencyProbe::SetEnabled(bool enabled) noexcept {
+    if (enabled && !IsEnabled()) {
+        for (LatencyHistogram& histogram : m_histograms) {
+            histogram.Reset();
+        }
+        m_dropped = 0;
+    }
+    for (auto& stamp : m_stamps) {
+        stamp.store(0, std::memory_order_relaxed);
+    }
+    m_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void InputLatencyProbe::BeginKey() noexcept {
+    if (!IsEnabled()) {
+        return;
+    }
+
+    const uint64_t now = PerfClock::NowMicros();
+    const uint64_t started = m_stamps[0].load(std::memory_order_relaxed);
+    if (started != 0) {
+        if (now - started < kTimeoutMicros) {
+            return;     // Ride along with the probe in flight
+        }
+        ++m_dropped;
+    }
+
+    // Clear the later stamps before the key stamp makes them reachable
+    m_stamps[0].store(0, std::memory_order_relaxed);
+    for (size_t index = 1; index < m_stamps.size(); ++index) {
+        m_stamps[index].store(0, std::memory_order_relaxed);
+    }
+    m_stamps[0].store(now, std::memory_order_release);
+}
+
+void InputLatencyProbe::MarkSlow(size_t index) noexcept {
+    uint64_t expected = 0;
+    m_stamps[index].compare_exchange_strong(expected, PerfClock::NowMicros(), std::memory_order_release,
+                                            std::memory_order_relaxed);
+}
+
+void InputLatencyProbe::Present() noexcept {
+    if (m_stamps[static_cast<size_t>(LatencyPoint::Rendered)].load(std::memory_order_acquire) == 0) {
+        return;
+    }
+    Mark(LatencyPoint::Presented);
+
+    std::array<uint64_t, 6> stamps{};
+    for (size_t index = 0; index < stamps.size(); ++index) {
+        stamps[index] = m_stamps[index].load(std::memory_order_relaxed);
+    }
+    m_stamps[0].store(0, std::memory_order_relaxed);
+
+    // Stamps come from several threads; a reordered pair is a measurement
+    // glitch, not a sample
+    if (!std::is_sorted(stamps.begin(), stamps.end())) {
+        ++m_dropped;
+        return;
+    }
+    for (size_t stage = 0; stage + 1 < stamps.size(); ++stage) {
+        m_histograms[stage].Add(stamps[stage + 1] - stamps[stage]);
+    }
+    m_histograms[static_cast<size_t>(LatencyStage::Total)].Add(stamps.back() - stamps.front());
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,125 @@
+#pragma once
+// Console3 - InputLatency.h
+// Keypress-to-photon latency measurement
+//
+// While measurement is on, a keystroke starts a probe: the view stamps the
+// key, the input writer stamps the WriteFile that sent it, the output ring
+// stamps the first output that arrives afterwards (the echo), the session
+// stamps the buffer update that parsed it, and the view stamps the render
+// that picked it up and the Present that showed it. Each stamp is taken on
+// the thread that does the work, only when the previous one is set, so an
+// idle probe costs those threads one relaxed load. Only one probe is in
+// flight at a time; keys typed meanwhile ride along, and a probe that gets
+// no echo (a key the shell swallows) is dropped after kTimeoutMicros.
+//
+// Completed probes go into a histogram per stage, read on the UI thread for
+// the latency overlay or by a harness that types into a session.
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace Console3::Core {
+
+/// Points a probe is stamped at, in order
+enum class LatencyPoint : uint8_t {
+    Key = 0,            ///< Key message handled by the view
+    Written = 1,        ///< Input written to the PTY pipe
+    Echoed = 2,         ///< First output after the write arrived
+    Parsed = 3,         ///< Output parsed into the buffer the view renders
+    Rendered = 4,       ///< Render started with the updated buffer
+    Presented = 5,      ///< Frame presented
+};
+
+/// Stages between consecutive points, plus the whole trip
+enum class LatencyStage : uint8_t {
+    Write = 0,          ///< Key to pipe write (input queue, writer thread)
+    Echo = 1,           ///< Pipe write to echo (console host and shell)
+    Parse = 2,          ///< Echo to buffer update (wakeup, parse, damage)
+    Schedule = 3,       ///< Buffer update to render (frame pacing)
+    Render = 4,         ///< Render to Present returning
+    Total = 5,          ///< Key to Present
+};
+
+inline constexpr size_t kLatencyStageCount = 6;
+
+/// Log-scale histogram of microsecond durations
+/// Four buckets per power of two, so a percentile is within 19%.
+class LatencyHistogram {
+public:
+    static constexpr size_t kSubBuckets = 4;
+    static constexpr size_t kBuckets = 30 * kSubBuckets;   ///< Up to 2^30 us (~18 minutes)
+
+    void Add(uint64_t micros) noexcept;
+    void Reset() noexcept;
+
+    /// Get the upper bound of the bucket holding a fraction of the samples
+    /// (0.5 = median); 0 without samples
+    [[nodiscard]] uint64_t Percentile(double fraction) const noexcept;
+
+    [[nodiscard]] uint64_t GetCount() const noexcept { return m_count; }
+    [[nodiscard]] uint64_t GetMax() const noexcept { return m_max; }
+
+    /// Get every bucket's samples, and a bucket's upper bound (microseconds),
+    /// to export the whole distribution
+    [[nodiscard]] const std::array<uint32_t, kBuckets>& GetBuckets() const noexcept { return m_buckets; }
+    [[nodiscard]] static uint64_t GetUpperBound(size_t bucket) noexcept { return UpperBound(bucket); }
+
+private:
+    [[nodiscard]] static size_t BucketOf(uint64_t micros) noexcept;
+    [[nodiscard]] static uint64_t UpperBound(size_t bucket) noexcept;
+
+    std::array<uint32_t, kBuckets> m_buckets{};
+    uint64_t m_count = 0;
+    uint64_t m_max = 0;
+};
+
+/// Tracks one keystroke at a time through input, echo, parse and render
+class InputLatencyProbe {
+public:
+    static constexpr uint64_t kTimeoutMicros = 1'000'000;  ///< Drop probes without an echo
+
+    /// Turn measurement on or off; turning it on clears the histograms
+    /// (call from the UI thread)
+    void SetEnabled(bool enabled) noexcept;
+
+    [[nodiscard]] bool IsEnabled() const noexcept { return m_enabled.load(std::memory_order_relaxed); }
+
+    /// A key was pressed: start a probe unless one is in flight (UI thread)
+    void BeginKey() noexcept;
+
+    /// Stamp a point if the probe reached the one before it (any thread)
+    void Mark(LatencyPoint point) noexcept {
+        const auto index = static_cast<size_t>(point);
+        if (index == 0 || m_stamps[index - 1].load(std::memory_order_acquire) == 0 ||
+            m_stamps[index].load(std::memory_order_relaxed) != 0) {
+            return;
+        }
+        MarkSlow(index);
+    }
+
+    /// A frame was presented: complete the probe if it was rendered (UI thread)
+    void Present() noexcept;
+
+    /// Get a stage's histogram (UI thread)
+    [[nodiscard]] const LatencyHistogram& GetHistogram(LatencyStage stage) const noexcept {
+        return m_histograms[static_cast<size_t>(stage)];
+    }
+
+    /// Get the number of probes dropped without a Present
+    [[nodiscard]] uint64_t GetDropped() const noexcept { return m_dropped; }
+
+private:
+    void MarkSlow(size_t index) noexcept;
+
+    /// PerfClock stamps by LatencyPoint (0 = not reached)
+    std::array<std::atomic<uint64_t>, 6> m_stamps{};
+    std::atomic<bool> m_enabled{false};
+
+    // UI thread
+    std::array<LatencyHistogram, kLatencyStageCount> m_histograms{};
+    uint64_t m_dropped = 0;
+};
+
+} // namespace Console3::Core
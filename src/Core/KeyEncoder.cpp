@@ -0,0 +1,264 @@
+// Console3 - KeyEncoder.cpp
+// Keys to the bytes a terminal application expects, from precomputed tables
+
+#include "Core/KeyEncoder.h"
+#include "Core/Utf.h"
+
+#include <array>
+#include <cstring>
+
+namespace Console3::Core {
+
+namespace {
+
+/// How a key's sequence is formed
+enum class KeyKind : uint8_t {
+    Cursor,         ///< CSI final, SS3 final in application mode, CSI 1;m final modified
+    Tilde,          ///< CSI n ~, CSI n;m ~ modified
+    Function,       ///< SS3 final (F1-F4), CSI 1;m final modified
+    Keypad,         ///< SS3 final in application keypad mode, else text
+    KeypadEnter,    ///< SS3 M in application keypad mode, else text (extended VK_RETURN only)
+    Escape,         ///< ESC, ESC ESC with Alt
+    Backspace,      ///< DEL, BS with Ctrl, ESC prefix with Alt
+    Tab             ///< CSI Z with Shift, else text
+};
+
+struct KeyDef {
+    unsigned vkey;
+    KeyKind kind;
+    char final;
+    uint8_t number = 0;
+};
+
+constexpr KeyDef kKeys[] = {
+    {VK_UP, KeyKind::Cursor, 'A'},
+    {VK_DOWN, KeyKind::Cursor, 'B'},
+    {VK_RIGHT, KeyKind::Cursor, 'C'},
+    {VK_LEFT, KeyKind::Cursor, 'D'},
+    {VK_HOME, KeyKind::Cursor, 'H'},
+    {VK_END, KeyKind::Cursor, 'F'},
+    {VK_INSERT, KeyKind::Tilde, '~', 2},
+    {VK_DELETE, KeyKind::Tilde, '~', 3},
+    {VK_PRIOR, KeyKind::Tilde, '~', 5},
+    {VK_NEXT, KeyKind::Tilde, '~', 6},
+    {VK_F1, KeyKind::Function, 'P'},
+    {VK_F2, KeyKind::Function, 'Q'},
+    {VK_F3, KeyKind::Function, 'R'},
+    {VK_F4, KeyKind::Function, 'S'},
+    {VK_F5, KeyKind::Tilde, '~', 15},
+    {VK_F6, KeyKind::Tilde, '~', 17},
+    {VK_F7, KeyKind::Tilde, '~', 18},
+    {VK_F8, KeyKind::Tilde, '~', 19},
+    {VK_F9, KeyKind::Tilde, '~', 20},
+    {VK_F10, KeyKind::Tilde, '~', 21},
+    {VK_F11, KeyKind::Tilde, '~', 23},
+    {VK_F12, KeyKind::Tilde, '~', 24},
+    {VK_ESCAPE, KeyKind::Escape, 0},
+    {VK_BACK, KeyKind::Backspace, 0},
+    {VK_TAB, KeyKind::Tab, 'Z'},
+    {VK_RETURN, KeyKind::KeypadEnter, 'M'},
+    {VK_NUMPAD0, KeyKind::Keypad, 'p'},
+    {VK_NUMPAD1, KeyKind::Keypad, 'q'},
+    {VK_NUMPAD2, KeyKind::Keypad, 'r'},
+    {VK_NUMPAD3, KeyKind::Keypad, 's'},
+    {VK_NUMPAD4, KeyKind::Keypad, 't'},
+    {VK_NUMPAD5, KeyKind::Keypad, 'u'},
+    {VK_NUMPAD6, KeyKind::Keypad, 'v'},
+    {VK_NUMPAD7, KeyKind::Keypad, 'w'},
+    {VK_NUMPAD8, KeyKind::Keypad, 'x'},
+    {VK_NUMPAD9, KeyKind::Keypad, 'y'},
+    {VK_MULTIPLY, KeyKind::Keypad, 'j'},
+    {VK_ADD, KeyKind::Keypad, 'k'},
+    {VK_SEPARATOR, KeyKind::Keypad, 'l'},
+    {VK_SUBTRACT, KeyKind::Keypad, 'm'},
+    {VK_DECIMAL, KeyKind::Keypad, 'n'},
+    {VK_DIVIDE, KeyKind::Keypad, 'o'},
+};
+constexpr size_t kKeyCount = std::size(kKeys);
+constexpr size_t kModifierCombos = 8;
+
+/// Builds a sequence at compile time
+struct SequenceBuilder {
+    KeySequence sequence;
+
+    constexpr SequenceBuilder& Put(char c) {
+        sequence.bytes[sequence.length++] = c;
+        return *this;
+    }
+    constexpr SequenceBuilder& Put(const char* text) {
+        while (*text) {
+            Put(*text++);
+        }
+        return *this;
+    }
+    constexpr SequenceBuilder& PutNumber(unsigned value) {
+        if (value >= 10) {
+            Put(static_cast<char>('0' + value / 10));
+        }
+        return Put(static_cast<char>('0' + value % 10));
+    }
+};
+
+/// A key's sequence under some modifiers, in normal (mode false) or
+/// application cursor or keypad mode
+constexpr KeySequence MakeSequence(const KeyDef& key, unsigned modifiers, bool mode) {
+    SequenceBuilder out;
+    const unsigned parameter = modifiers + 1;
+    switch (key.kind) {
+    case KeyKind::Cursor:
+    case KeyKind::Function:
+        if (modifiers != 0) {
+            out.Put("\x1b[1;").PutNumber(parameter).Put(key.final);
+        } else if (mode || key.kind == KeyKind::Function) {
+            out.Put("\x1bO").Put(key.final);
+        } else {
+            out.Put("\x1b[").Put(key.final);
+        }
+        break;
+    case KeyKind::Tilde:
+        out.Put("\x1b[").PutNumber(key.number);
+        if (modifiers != 0) {
+            out.Put(';').PutNumber(parameter);
+        }
+        out.Put('~');
+        break;
+    case KeyKind::Keypad:
+    case KeyKind::KeypadEnter:
+        if (mode && modifiers == 0) {
+            out.Put("\x1bO").Put(key.final);
+        }
+        break;
+    case KeyKind::Escape:
+        if (modifiers & kKeyAlt) {
+            out.Put('\x1b');
+        }
+        out.Put('\x1b');
+        break;
+    case KeyKind::Backspace:
+        if (modifiers & kKeyAlt) {
+            out.Put('\x1b');
+        }
+        out.Put((modifiers & kKeyCtrl) ? '\x08' : '\x7f');
+        break;
+    case KeyKind::Tab:
+        if ((modifiers & ~static_cast<unsigned>(kKeyAlt)) == kKeyShift) {
+            out.Put("\x1b[").Put(key.final);
+        }
+        break;
+    }
+    return out.sequence;
+}
+
+/// Every key's sequence: [key][modifiers][mode]
+using SequenceTable = std::array<std::array<std::array<KeySequence, 2>, kModifierCombos>, kKeyCount>;
+
+constexpr SequenceTable MakeSequenceTable() {
+    SequenceTable table{};
+    for (size_t key = 0; key < kKeyCount; ++key) {
+        for (unsigned modifiers = 0; modifiers < kModifierCombos; ++modifiers) {
+            table[key][modifiers][0] = MakeSequence(kKeys[key], modifiers, false);
+            table[key][modifiers][1] = MakeSequence(kKeys[key], modifiers, true);
+        }
+    }
+    return table;
+}
+
+/// Row in kKeys by virtual key, plus one (0 = not a special key)
+constexpr std::array<uint8_t, 256> MakeKeyIndex() {
+    std::array<uint8_t, 256> index{};
+    for (size_t key = 0; key < kKeyCount; ++key) {
+        index[kKeys[key].vkey] = static_cast<uint8_t>(key + 1);
+    }
+    return index;
+}
+
+/// Control character Ctrl+key types, by virtual key (0xFF = none)
+constexpr std::array<uint8_t, 256> MakeControlChars() {
+    std::array<uint8_t, 256> chars{};
+    for (uint8_t& c : chars) {
+        c = 0xFF;
+    }
+    for (unsigned vkey = 'A'; vkey <= 'Z'; ++vkey) {
+        chars[vkey] = static_cast<uint8_t>(vkey - 'A' + 1);
+    }
+    chars[VK_SPACE] = 0x00;
+    chars['2'] = 0x00;
+    chars[VK_OEM_4] = 0x1B;     // [
+    chars[VK_OEM_5] = 0x1C;     // backslash
+    chars[VK_OEM_6] = 0x1D;     // ]
+    chars['6'] = 0x1E;
+    chars[VK_OEM_MINUS] = 0x1F;
+    return chars;
+}
+
+constexpr SequenceTable kSequences = MakeSequenceTable();
+constexpr std::array<uint8_t, 256> kKeyIndex = MakeKeyIndex();
+constexpr std::array<uint8_t, 256> kControlChars = MakeControlChars();
+
+static_assert(kSequences[0][0][0].View() == "\x1b[A");
+static_assert(kSequences[0][0][1].View() == "\x1bOA");
+static_assert(kSequences[0][kKeyCtrl | kKeyShift][1].View() == "\x1b[1;6A");
+static_assert(kSequences[21][kModifierCombos - 1][0].View() == "\x1b[24;8~");
+
+} // namespace
+
+KeySequence EncodeKey(unsigned vkey, unsigned modifiers, bool extended, KeyboardModes modes) noexcept {
+    if (vkey >= kKeyIndex.size()) {
+        return {};
+    }
+    modifiers &= kModifierCombos - 1;
+
+    if (const uint8_t row = kKeyIndex[vkey]) {
+        const KeyDef& key = kKeys[row - 1];
+        if (key.kind == KeyKind::KeypadEnter && !extended) {
+            return {};
+        }
+        const bool keypad = key.kind == KeyKind::Keypad || key.kind == KeyKind::KeypadEnter;
+        const bool mode = keypad ? modes.applicationKeypad : modes.applicationCursor;
+        return kSequences[row - 1][modifiers][mode ? 1 : 0];
+    }
+
+    // Ctrl+key types a control character; with Alt as well it is AltGr,
+    // which types text
+    KeySequence sequence;
+    const bool ctrl = (modifiers & kKeyCtrl) != 0;
+    const bool alt = (modifiers & kKeyAlt) != 0;
+    if (ctrl && !alt && kControlChars[vkey] != 0xFF) {
+        sequence.bytes[sequence.length++] = static_cast<char>(kControlChars[vkey]);
+    } else if (alt && !ctrl && vkey >= 'A' && vkey <= 'Z') {
+        // Alt+letter is Meta: ESC and the letter (no WM_CHAR comes for it)
+        sequence.bytes[sequence.length++] = '\x1b';
+        sequence.bytes[sequence.length++] =
+            static_cast<char>((modifiers & kKeyShift) ? vkey : vkey - 'A' + 'a');
+    }
+    return sequence;
+}
+
+size_t EncodeUtf16(wchar_t unit, wchar_t& pendingHigh, char (&out)[8]) noexcept {
+    size_t length = 0;
+    const auto put = [&out, &length](char32_t codepoint) {
+        length += PutUtf8(codepoint, out + length);
+    };
+
+    const bool high = unit >= 0xD800 && unit <= 0xDBFF;
+    const bool low = unit >= 0xDC00 && unit <= 0xDFFF;
+    if (low && pendingHigh) {
+        put(0x10000 + ((static_cast<char32_t>(pendingHigh) - 0xD800) << 10) + (unit - 0xDC00));
+        pendingHigh = 0;
+        return length;
+    }
+
+    // A high surrogate left without its pair
+    if (pendingHigh) {
+        put(0xFFFD);
+        pendingHigh = 0;
+    }
+    if (high) {
+        pendingHigh = unit;
+    } else {
+        put(low ? 0xFFFD : static_cast<char32_t>(unit));
+    }
+    return length;
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,72 @@
+#pragma once
+// Console3 - KeyEncoder.h
+// Keys to the bytes a terminal application expects, from precomputed tables
+//
+// Keys that type no character (cursor, editing and function keys, the
+// keypad in application mode) and modified keys the window gets no WM_CHAR
+// for (Ctrl+letter, Alt+letter) are sent as the xterm sequences for them.
+// Every sequence is generated at compile time: a table by virtual key gives
+// the key's row, and the row holds its bytes for each combination of Shift,
+// Alt and Ctrl in both cursor (or keypad) modes, so encoding a key press is
+// two lookups and a copy. Text keys are left to WM_CHAR, whose UTF-16 is
+// encoded by EncodeUtf16.
+//
+// The modes are the application's (DECCKM and DECKPAM, reported by the
+// emulator as TermProps); the view encodes with the ones it was last told.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace Console3::Core {
+
+/// Key modes the application set
+struct KeyboardModes {
+    bool applicationCursor = false; ///< DECCKM: unmodified cursor keys send SS3 sequences
+    bool applicationKeypad = false; ///< DECKPAM: keypad keys send SS3 sequences
+
+    bool operator==(const KeyboardModes&) const = default;
+};
+
+/// Modifier bits, as xterm numbers them (its parameter is these plus one)
+enum KeyModifier : uint8_t {
+    kKeyShift = 1,
+    kKeyAlt = 2,
+    kKeyCtrl = 4
+};
+
+/// Longest sequence a key encodes to ("\x1b[24;8~")
+inline constexpr size_t kMaxKeySequence = 8;
+
+/// Bytes for one key press
+struct KeySequence {
+    char bytes[kMaxKeySequence] = {};
+    uint8_t length = 0;
+
+    [[nodiscard]] constexpr bool IsEmpty() const noexcept { return length == 0; }
+    [[nodiscard]] constexpr std::string_view View() const noexcept { return {bytes, length}; }
+};
+
+/// Encode a key press
+/// @param vkey Virtual key
+/// @param modifiers KeyModifier bits held
+/// @param extended The key is an extended key (the keypad's Enter rather than the main one)
+/// @param modes The application's key modes
+/// @return The bytes to send, or empty if the key is text (WM_CHAR sends it) or sends nothing
+[[nodiscard]] KeySequence EncodeKey(unsigned vkey, unsigned modifiers, bool extended, KeyboardModes modes) noexcept;
+
+/// Encode a UTF-16 unit (WM_CHAR, IME results) as UTF-8
+/// A high surrogate is held in pendingHigh until the low one comes; an
+/// unpaired surrogate is sent as U+FFFD.
+/// @return Bytes written to out (0 while a surrogate is pending)
+size_t EncodeUtf16(wchar_t unit, wchar_t& pendingHigh, char (&out)[8]) noexcept;
+
+} // namespace Console3::Core
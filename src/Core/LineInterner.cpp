@@ -0,0 +1,91 @@
+// Console3 - LineInterner.cpp
+// One shared copy of each scrollback line that keeps repeating
+
+#include "Core/LineInterner.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace Console3::Core {
+
+namespace {
+
+/// Bytes of the index per entry, roughly (node, bucket), and of a shared
+/// copy's control block
+constexpr size_t kIndexBytes = 32;
+constexpr size_t kShareBytes = 16;
+
+[[nodiscard]] uint64_t HashBytes(std::span<const char> bytes) noexcept {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (const char byte : bytes) {
+        hash = (hash ^ static_cast<uint8_t>(byte)) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+} // namespace
+
+uint32_t LineInterner::Intern(std::span<const char> bytes) {
+    if (bytes.size() < kMinLineBytes) {
+        return 0;
+    }
+
+    const uint64_t hash = HashBytes(bytes);
+    if (const auto it = m_index.find(hash); it != m_index.end()) {
+        Entry& entry = m_entries[it->second - 1];
+        if (!std::equal(bytes.begin(), bytes.end(), entry.bytes->begin(), entry.bytes->end())) {
+            return 0;
+        }
+        ++entry.references;
+        ++m_references;
+        return it->second;
+    }
+
+    // Only a line seen lately is shared; a one-off stays inline
+    if (std::find(std::begin(m_recent), std::end(m_recent), hash) == std::end(m_recent)) {
+        m_recent[m_recentNext] = hash;
+        m_recentNext = (m_recentNext + 1) % kRecentLines;
+        return 0;
+    }
+
+    uint32_t id = 0;
+    if (!m_free.empty()) {
+        id = m_free.back();
+        m_free.pop_back();
+    } else {
+        m_entries.emplace_back();
+        id = static_cast<uint32_t>(m_entries.size());
+    }
+    Entry& entry = m_entries[id - 1];
+    entry.bytes = std::make_shared<const std::vector<char>>(bytes.begin(), bytes.end());
+    entry.hash = hash;
+    entry.references = 1;
+    m_index.emplace(hash, id);
+    ++m_references;
+    m_bytes += entry.bytes->capacity() + sizeof(Entry) + kIndexBytes + kShareBytes;
+    return id;
+}
+
+void LineInterner::Release(uint32_t id) {
+    Entry& entry = m_entries[id - 1];
+    --m_references;
+    if (--entry.references != 0) {
+        return;
+    }
+    m_index.erase(entry.hash);
+    m_bytes -= entry.bytes->capacity() + sizeof(Entry) + kIndexBytes + kShareBytes;
+    entry.bytes.reset();
+    m_free.push_back(id);
+}
+
+void LineInterner::Clear() {
+    m_entries.clear();
+    m_free.clear();
+    m_index.clear();
+    std::fill(std::begin(m_recent), std::end(m_recent), 0);
+    m_recentNext = 0;
+    m_references = 0;
+    m_bytes = 0;
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,85 @@
+#pragma once
+// Console3 - LineInterner.h
+// One shared copy of each scrollback line that keeps repeating
+//
+// Progress bars redrawn on new lines, spinners, the same warning a few
+// thousand times: a noisy build log repeats whole lines. A compressed
+// block only finds repeats within itself, and lines wait uncompressed in
+// staging until a block fills. The cold tier of ScrollbackStore therefore
+// hands each encoded line here first. A line seen again among the last
+// kRecentLines gets one shared copy, found by hash and then compared byte
+// for byte; it and every later occurrence are stored as a reference to
+// that copy, counted, and the copy goes with its last reference.
+//
+// Lines are only worth sharing past kMinLineBytes: a blank line encodes to
+// fewer bytes than a reference. Two different lines with the same hash are
+// simply not shared.
+//
+// Each copy is reference counted on its own as well (Share()), so a reader
+// on another thread holding a sealed block keeps the lines it refers to.
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace Console3::Core {
+
+/// Shared encoded lines of one scrollback store (see file comment)
+class LineInterner {
+public:
+    static constexpr size_t kMinLineBytes = 16;
+    static constexpr size_t kRecentLines = 64;
+
+    /// Share an encoded line if it repeats, counting a reference to it
+    /// @return Its id, or 0 if the line is to be stored as it is
+    [[nodiscard]] uint32_t Intern(std::span<const char> bytes);
+
+    /// Count another reference to a line already shared
+    void Retain(uint32_t id) noexcept {
+        ++m_entries[id - 1].references;
+        ++m_references;
+    }
+
+    /// Drop a reference; the copy goes with the last one
+    void Release(uint32_t id);
+
+    /// Get the encoded line an id stands for
+    [[nodiscard]] std::span<const char> Get(uint32_t id) const noexcept {
+        const std::vector<char>& bytes = *m_entries[id - 1].bytes;
+        return {bytes.data(), bytes.size()};
+    }
+
+    /// Get the encoded line an id stands for, to keep past its release
+    [[nodiscard]] std::shared_ptr<const std::vector<char>> Share(uint32_t id) const {
+        return m_entries[id - 1].bytes;
+    }
+
+    /// Get the references held (lines stored as one)
+    [[nodiscard]] size_t GetReferenceCount() const noexcept { return m_references; }
+
+    /// Get the memory the shared copies and the index hold
+    [[nodiscard]] size_t GetBytes() const noexcept { return m_bytes; }
+
+    /// Drop every copy and reference
+    void Clear();
+
+private:
+    struct Entry {
+        std::shared_ptr<const std::vector<char>> bytes;
+        uint64_t hash = 0;
+        uint32_t references = 0;    ///< 0 = free
+    };
+
+    std::vector<Entry> m_entries;                   ///< Entry id - 1
+    std::vector<uint32_t> m_free;                   ///< Ids of free entries
+    std::unordered_map<uint64_t, uint32_t> m_index; ///< Hash to id
+    uint64_t m_recent[kRecentLines] = {};           ///< Hashes of the last lines not shared
+    size_t m_recentNext = 0;
+    size_t m_references = 0;
+    size_t m_bytes = 0;
+};
+
+} // namespace Console3::Core
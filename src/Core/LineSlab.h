@@ -0,0 +1,199 @@
+#pragma once
+// Console3 - LineSlab.h
+// Ring of scrollback lines, cut at their trailing fill, in one cell arena
+//
+// Most lines are far shorter than the window is wide: a build log at 200
+// columns uses a fraction of each row. A line is stored only up to its
+// trailing fill (the blanks it ends in, in the style of its last cell; see
+// FindTrailingFill), and keeps its width and fill, so reading it back
+// gives the row as it was pushed.
+//
+// The cut lines sit back to back in one ring of cells, oldest to newest.
+// A line never wraps around the end of the ring: one that would starts at
+// the beginning instead, leaving the end unused until the ring comes round.
+// Scrollback grows at one end and is trimmed at the other, so a line
+// leaving at the old end frees its cells for the lines pushed at the new
+// end: once the arena has grown to its working size, pushing and trimming
+// never touch the heap.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "Core/Cell.h"
+
+namespace Console3::Core {
+
+/// Lines, most recent first, cut at their trailing fill (see file comment)
+class LineSlab {
+public:
+    static constexpr size_t kMinCells = 4096;   ///< Arena cells allocated at least
+
+    [[nodiscard]] size_t Size() const noexcept { return m_size; }
+    [[nodiscard]] bool Empty() const noexcept { return m_size == 0; }
+
+    /// Get a line's cells before its fill (0 = most recent)
+    [[nodiscard]] std::span<const Cell> Cells(size_t index) const noexcept {
+        const Line& line = m_lines[Slot(index)];
+        return {m_cells.data() + Offset(line), line.used};
+    }
+
+    /// Get a line's width as pushed (its cells, then its fill up to here)
+    [[nodiscard]] size_t Width(size_t index) const noexcept { return m_lines[Slot(index)].width; }
+
+    /// Get the blank a line's cells are followed by
+    [[nodiscard]] const Cell& Fill(size_t index) const noexcept { return m_lines[Slot(index)].fill; }
+
+    /// Check if a line continues the one before it (soft wrap)
+    [[nodiscard]] bool IsContinuation(size_t index) const noexcept { return m_lines[Slot(index)].continuation != 0; }
+
+    /// Copy a line as pushed into out: its cells, then its fill up to its
+    /// width (cells of out past that are left alone)
+    void CopyTo(size_t index, std::span<Cell> out) const noexcept {
+        const std::span<const Cell> cells = Cells(index);
+        const size_t width = std::min(Width(index), out.size());
+        const size_t used = std::min(cells.size(), width);
+        std::copy_n(cells.begin(), used, out.begin());
+        std::fill(out.begin() + used, out.begin() + width, Fill(index));
+    }
+
+    /// Get a line as pushed
+    void Expand(size_t index, Row& out) const {
+        out.resize(Width(index));
+        CopyTo(index, out);
+    }
+
+    /// Add a line as the most recent
+    /// Allocates only to grow past the most cells held so far.
+    void PushFront(std::span<const Cell> cells, bool continuation) {
+        Line line;
+        line.used = static_cast<uint32_t>(FindTrailingFill(cells, line.fill));
+        line.width = static_cast<uint32_t>(cells.size());
+        line.continuation = continuation ? 1 : 0;
+        line.position = Allocate(line.used);
+
+        if (m_size == m_lines.size()) {
+            GrowLines();
+        }
+        m_head = (m_head + m_lines.size() - 1) % m_lines.size();
+        ++m_size;
+        m_lines[m_head] = line;
+        std::copy_n(cells.begin(), line.used, m_cells.begin() + Offset(line));
+        m_cellCount += line.used;
+    }
+
+    /// Remove the most recent line, freeing its cells for the next push
+    void PopFront() noexcept {
+        const Line& line = m_lines[m_head];
+        m_cellCount -= line.used;
+        m_write = line.position;
+        m_head = (m_head + 1) % m_lines.size();
+        if (--m_size == 0) {
+            m_write = 0;
+        }
+    }
+
+    /// Remove the oldest line, freeing its cells for the next push
+    void PopBack() noexcept {
+        m_cellCount -= m_lines[Slot(m_size - 1)].used;
+        if (--m_size == 0) {
+            m_write = 0;
+        }
+    }
+
+    /// Get the cells the lines hold (before their fills)
+    [[nodiscard]] size_t GetCellCount() const noexcept { return m_cellCount; }
+
+    /// Get the memory allocated (the arena and the line records)
+    [[nodiscard]] size_t GetBytes() const noexcept {
+        return m_cells.capacity() * sizeof(Cell) + m_lines.capacity() * sizeof(Line);
+    }
+
+    /// Shrink the arena to the cells the lines hold
+    void ReleaseSpare() { Relocate(m_cellCount); }
+
+    /// Remove all lines and free all storage
+    void Clear() noexcept {
+        std::vector<Cell>().swap(m_cells);
+        std::vector<Line>().swap(m_lines);
+        m_head = 0;
+        m_size = 0;
+        m_write = 0;
+        m_cellCount = 0;
+    }
+
+private:
+    struct Line {
+        uint64_t position = 0;      ///< Arena cells allocated before this line's (offset = position % arena size)
+        uint32_t used = 0;          ///< Cells before the fill
+        uint32_t width = 0;
+        Cell fill;
+        uint8_t continuation = 0;   ///< Soft-wrap flag
+    };
+
+    [[nodiscard]] size_t Slot(size_t index) const noexcept { return (m_head + index) % m_lines.size(); }
+
+    [[nodiscard]] size_t Offset(const Line& line) const noexcept {
+        return m_cells.empty() ? 0 : static_cast<size_t>(line.position % m_cells.size());
+    }
+
+    /// Find room for a line of cells after the newest, growing the arena if
+    /// the ring has none
+    /// @return The line's position
+    uint64_t Allocate(size_t cells) {
+        if (cells == 0) {
+            return m_write;
+        }
+        const size_t capacity = m_cells.size();
+        uint64_t position = m_write;
+        if (capacity != 0) {
+            const auto offset = static_cast<size_t>(position % capacity);
+            if (offset + cells > capacity) {
+                position += capacity - offset;
+            }
+        }
+        const uint64_t oldest = m_size != 0 ? m_lines[Slot(m_size - 1)].position : position;
+        if (capacity == 0 || position + cells - oldest > capacity) {
+            Relocate(std::max({capacity + capacity / 2, (m_cellCount + cells) * 3 / 2, kMinCells}));
+            position = m_write;
+        }
+        m_write = position + cells;
+        return position;
+    }
+
+    /// Move the lines into a new arena of a size, packed from the start
+    void Relocate(size_t capacity) {
+        std::vector<Cell> cells(capacity);
+        uint64_t position = 0;
+        for (size_t index = m_size; index-- > 0;) {
+            Line& line = m_lines[Slot(index)];
+            std::copy_n(m_cells.begin() + Offset(line), line.used, cells.begin() + position);
+            line.position = position;
+            position += line.used;
+        }
+        m_cells = std::move(cells);
+        m_write = position;
+    }
+
+    /// Double the line records, moving lines to their new places
+    void GrowLines() {
+        const size_t capacity = std::max<size_t>(m_lines.size() * 2, 64);
+        std::vector<Line> lines(capacity);
+        for (size_t index = 0; index < m_size; ++index) {
+            lines[index] = m_lines[Slot(index)];
+        }
+        m_lines = std::move(lines);
+        m_head = 0;
+    }
+
+    std::vector<Cell> m_cells;              ///< The arena
+    std::vector<Line> m_lines;
+    size_t m_head = 0;                      ///< Slot of the most recent line
+    size_t m_size = 0;
+    uint64_t m_write = 0;                   ///< Position past the newest line's cells
+    size_t m_cellCount = 0;                 ///< Cells the lines hold
+};
+
+} // namespace Console3::Core
@@ -0,0 +1,212 @@
+// Console3 - LinkDetector.cpp
+// Clickable links on screen rows: URLs, file:line locations and OSC 8
+
+#include "Core/LinkDetector.h"
+#include "Core/ScrollbackSearch.h"
+#include "Core/TerminalBuffer.h"
+#include <algorithm>
+#include <charconv>
+
+namespace Console3::Core {
+
+namespace {
+
+/// URLs run to the first blank, quote or angle bracket
+constexpr const char* kUrlPattern = R"((?:https?|ftp|file)://[^\s<>"'`]+)";
+
+/// path:line[:column] or path(line[,column]); the path has an extension and
+/// may start with a drive letter
+constexpr const char* kLocationPattern =
+    R"(((?:[A-Za-z]:)?[\w.\\/~+-]*\w\.\w+)(?::(\d+)(?::(\d+))?|\((\d+)(?:,(\d+))?\)))";
+
+/// Punctuation that ends a sentence rather than a URL
+[[nodiscard]] bool IsTrailingPunctuation(char c) noexcept {
+    return c == '.' || c == ',' || c == ';' || c == ':' || c == '!' || c == '?' || c == ')' || c == ']' ||
+           c == '}';
+}
+
+[[nodiscard]] uint32_t ParseNumber(const std::csub_match& match) noexcept {
+    uint32_t value = 0;
+    if (match.matched) {
+        (void)std::from_chars(match.first, match.second, value);
+    }
+    return value;
+}
+
+} // namespace
+
+// ============================================================================
+// HyperlinkTable
+// ============================================================================
+
+void HyperlinkTable::Add(uint64_t line, int startCol, int endCol, std::string_view uri) {
+    if (startCol >= endCol || uri.empty()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_lines[line].push_back(Link{startCol, endCol, LinkKind::Hyperlink, std::string(uri)});
+    ++m_count;
+    ++m_version;
+
+    // Lines long scrolled away go first
+    while (m_count > kMaxLinks && !m_lines.empty()) {
+        m_count -= m_lines.begin()->second.size();
+        m_lines.erase(m_lines.begin());
+    }
+}
+
+void HyperlinkTable::Find(uint64_t line, std::vector<Link>& links) const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (const auto found = m_lines.find(line); found != m_lines.end()) {
+        links.insert(links.end(), found->second.begin(), found->second.end());
+    }
+}
+
+uint64_t HyperlinkTable::GetVersion() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_version;
+}
+
+void HyperlinkTable::Clear() {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_lines.clear();
+    m_count = 0;
+    ++m_version;
+}
+
+// ============================================================================
+// LinkDetector
+// ============================================================================
+
+LinkDetector::LinkDetector()
+    : m_url(kUrlPattern, std::regex::ECMAScript | std::regex::optimize | std::regex::icase)
+    , m_location(kLocationPattern, std::regex::ECMAScript | std::regex::optimize) {}
+
+void LinkDetector::SetHyperlinks(const HyperlinkTable* table) {
+    m_hyperlinks = table;
+    m_rows.clear();
+}
+
+const std::vector<Link>& LinkDetector::GetLinks(const TerminalBuffer& buffer, int row) {
+    ++m_tick;
+    const uint64_t generation = buffer.GetRowGeneration(row);
+    const uint64_t line = buffer.GetScreenLine() + static_cast<uint64_t>(row);
+    const uint64_t hyperlinks = m_hyperlinks ? m_hyperlinks->GetVersion() : 0;
+
+    const auto [found, added] = m_rows.try_emplace(generation);
+    Entry& entry = found->second;
+    entry.lastUsed = m_tick;
+    if (!added && entry.line == line && entry.hyperlinks == hyperlinks) {
+        return entry.links;
+    }
+
+    // Patterns only when the cells changed; explicit links whenever the
+    // table did, or the row now stands on another line
+    if (added) {
+        Detect(buffer.GetRow(row), entry.links);
+    } else {
+        std::erase_if(entry.links, [](const Link& link) { return link.kind == LinkKind::Hyperlink; });
+    }
+    if (m_hyperlinks) {
+        m_hyperlinks->Find(line, entry.links);
+        std::stable_sort(entry.links.begin(), entry.links.end(),
+                         [](const Link& a, const Link& b) { return a.startCol < b.startCol; });
+    }
+    entry.line = line;
+    entry.hyperlinks = hyperlinks;
+
+    // Rows scrolled off or rewritten leave their entries behind
+    if (m_rows.size() > static_cast<size_t>(buffer.GetRows()) * 4) {
+        Trim(static_cast<size_t>(buffer.GetRows()) * 2);
+    }
+    return m_rows.find(generation)->second.links;
+}
+
+const Link* LinkDetector::HitTest(const TerminalBuffer& buffer, int row, int col) {
+    if (row < 0 || row >= buffer.GetRows()) {
+        return nullptr;
+    }
+
+    // An explicit link wins over a pattern under it
+    const Link* hit = nullptr;
+    for (const Link& link : GetLinks(buffer, row)) {
+        if (col >= link.startCol && col < link.endCol && (!hit || link.kind == LinkKind::Hyperlink)) {
+            hit = &link;
+        }
+    }
+    return hit;
+}
+
+void LinkDetector::Clear() {
+    m_rows.clear();
+}
+
+void LinkDetector::Detect(std::span<const Cell> cells, std::vector<Link>& links) {
+    links.clear();
+    m_text.clear();
+    ScrollbackSearch::AppendLineText(m_text, cells);
+
+    // Quick rejects: no URL without "://", no location without a digit
+    const bool maybeUrl = m_text.find("://") != std::string::npos;
+    const bool maybeLocation = m_text.find_first_of("0123456789") != std::string::npos;
+    const auto columns = [&](size_t offset, size_t length, Link& link) {
+        link.startCol = ScrollbackSearch::ColumnOf(cells, offset);
+        link.endCol = ScrollbackSearch::ColumnOf(cells, offset + length);
+    };
+
+    if (maybeUrl) {
+        for (auto it = std::cregex_iterator(m_text.data(), m_text.data() + m_text.size(), m_url);
+             it != std::cregex_iterator(); ++it) {
+            const std::cmatch& match = *it;
+            size_t length = static_cast<size_t>(match.length(0));
+            while (length > 0 && IsTrailingPunctuation(match[0].first[length - 1])) {
+                --length;
+            }
+            Link& link = links.emplace_back();
+            link.kind = LinkKind::Url;
+            link.target.assign(match[0].first, length);
+            columns(static_cast<size_t>(match.position(0)), length, link);
+        }
+    }
+
+    if (maybeLocation) {
+        for (auto it = std::cregex_iterator(m_text.data(), m_text.data() + m_text.size(), m_location);
+             it != std::cregex_iterator(); ++it) {
+            const std::cmatch& match = *it;
+            const auto start = static_cast<size_t>(match.position(0));
+            const auto length = static_cast<size_t>(match.length(0));
+
+            // Inside a URL is part of the URL
+            const int startCol = ScrollbackSearch::ColumnOf(cells, start);
+            if (std::any_of(links.begin(), links.end(), [startCol](const Link& url) {
+                    return startCol >= url.startCol && startCol < url.endCol;
+                })) {
+                continue;
+            }
+
+            Link& link = links.emplace_back();
+            link.kind = LinkKind::FileLocation;
+            link.target = match[1].str();
+            link.line = ParseNumber(match[2].matched ? match[2] : match[4]);
+            link.column = ParseNumber(match[3].matched ? match[3] : match[5]);
+            columns(start, length, link);
+        }
+    }
+
+    std::sort(links.begin(), links.end(), [](const Link& a, const Link& b) { return a.startCol < b.startCol; });
+}
+
+void LinkDetector::Trim(size_t keep) {
+    // Keep the most recently asked about
+    std::vector<uint64_t> used;
+    used.reserve(m_rows.size());
+    for (const auto& [generation, entry] : m_rows) {
+        used.push_back(entry.lastUsed);
+    }
+    std::nth_element(used.begin(), used.end() - static_cast<std::ptrdiff_t>(keep), used.end());
+    const uint64_t cutoff = used[used.size() - keep];
+    std::erase_if(m_rows, [cutoff](const auto& item) { return item.second.lastUsed < cutoff; });
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,114 @@
+#pragma once
+// Console3 - LinkDetector.h
+// Clickable links on screen rows: URLs, file:line locations and OSC 8
+//
+// Matching regular expressions against every row each frame would cost far
+// more than drawing them, so links are found lazily: only when a row is
+// asked about (the view does so for the row under the mouse), and then kept
+// under the row's generation (TerminalBuffer::GetRowGeneration), which
+// changes only when the row's cells do. A row that scrolls keeps its
+// generation and with it its links; the render path never scans at all.
+//
+// Explicit hyperlinks (OSC 8) come from the emulator, which knows the
+// cells printed between a link's opening and closing sequences. It records
+// them in a HyperlinkTable by absolute line (TerminalBuffer::GetScreenLine
+// numbering), shared with the view across threads; the detector merges
+// them over the patterns it finds.
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <regex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Core/Cell.h"
+
+namespace Console3::Core {
+
+class TerminalBuffer;
+
+/// What a link points at
+enum class LinkKind {
+    Url,            ///< scheme://... found in the text
+    FileLocation,   ///< path:line[:column] or path(line[,column]), as compilers print
+    Hyperlink       ///< OSC 8 explicit hyperlink
+};
+
+/// A link on a row
+struct Link {
+    int startCol = 0;
+    int endCol = 0;                 ///< Exclusive
+    LinkKind kind = LinkKind::Url;
+    std::string target;             ///< URL, URI or path (UTF-8)
+    uint32_t line = 0;              ///< FileLocation: 1-based line
+    uint32_t column = 0;            ///< FileLocation: 1-based column (0 = none)
+};
+
+/// OSC 8 hyperlinks by absolute line (emulator thread writes, UI reads)
+class HyperlinkTable {
+public:
+    static constexpr size_t kMaxLinks = 4096;   ///< Oldest lines' links go past this
+
+    /// Record a link's cells on one line
+    void Add(uint64_t line, int startCol, int endCol, std::string_view uri);
+
+    /// Append the links on a line to a list
+    void Find(uint64_t line, std::vector<Link>& links) const;
+
+    /// Get a count that changes with every Add
+    [[nodiscard]] uint64_t GetVersion() const;
+
+    void Clear();
+
+private:
+    mutable std::mutex m_lock;
+    std::map<uint64_t, std::vector<Link>> m_lines;
+    size_t m_count = 0;
+    uint64_t m_version = 0;
+};
+
+/// Lazy, cached link detection over a buffer's screen rows
+class LinkDetector {
+public:
+    LinkDetector();
+
+    /// Set the explicit hyperlinks to merge in (nullptr for none)
+    void SetHyperlinks(const HyperlinkTable* table);
+
+    /// Get the links on a screen row, detecting them if the row changed
+    /// @return Links in column order (valid until the next call)
+    const std::vector<Link>& GetLinks(const TerminalBuffer& buffer, int row);
+
+    /// Find the link over a cell
+    /// @return The link (valid until the next call), or nullptr
+    const Link* HitTest(const TerminalBuffer& buffer, int row, int col);
+
+    /// Drop everything detected
+    void Clear();
+
+    /// Find the URLs and file locations in a line of cells
+    void Detect(std::span<const Cell> cells, std::vector<Link>& links);
+
+private:
+    struct Entry {
+        std::vector<Link> links;
+        uint64_t line = 0;                  ///< Absolute line it was merged for
+        uint64_t hyperlinks = 0;            ///< HyperlinkTable version merged
+        uint64_t lastUsed = 0;
+    };
+
+    void Trim(size_t keep);
+
+    const HyperlinkTable* m_hyperlinks = nullptr;
+    std::regex m_url;
+    std::regex m_location;
+    std::unordered_map<uint64_t, Entry> m_rows;     ///< By row generation
+    uint64_t m_tick = 0;
+    std::string m_text;                             ///< Scratch: the row as UTF-8
+};
+
+} // namespace Console3::Core
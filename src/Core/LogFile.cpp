@@ -0,0 +1,263 @@
+// Console3 - LogFile.cpp
+// A log file shown as scrollback, read from its mapping as it is drawn
+
+#include "Core/LogFile.h"
+#include "Core/ScrollbackSearch.h"
+#include "Emulation/VTermWrapper.h"
+
+#include <algorithm>
+#include <bit>
+#include <iterator>
+#include <system_error>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define CONSOLE3_LOG_SSE2 1
+#endif
+
+namespace Console3::Core {
+
+namespace {
+
+/// Find the last '\n' in [begin, end)
+/// @return Its address, or nullptr if there is none
+[[nodiscard]] const char* FindLastNewline(const char* begin, const char* end) noexcept {
+#ifdef CONSOLE3_LOG_SSE2
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (end - begin >= 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(end - 16));
+        const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)));
+        if (mask != 0) {
+            return end - 16 + (31 - std::countl_zero(mask));
+        }
+        end -= 16;
+    }
+#endif
+    while (end != begin) {
+        if (*--end == '\n') {
+            return end;
+        }
+    }
+    return nullptr;
+}
+
+/// Get a line's text without the CR of a CR LF end
+[[nodiscard]] std::string_view TrimCr(std::string_view line) noexcept {
+    return !line.empty() && line.back() == '\r' ? line.substr(0, line.size() - 1) : line;
+}
+
+/// Find the last match of a matcher in text
+/// @return Its offset, or npos
+[[nodiscard]] size_t FindLast(const TextMatcher& matcher, std::string_view text, size_t& length) {
+    size_t found = std::string_view::npos;
+    size_t matched = 0;
+    for (size_t at = matcher.Find(text, 0, matched); at != std::string_view::npos;
+         at = matcher.Find(text, at + 1, matched)) {
+        found = at;
+        length = matched;
+    }
+    return found;
+}
+
+} // namespace
+
+std::shared_ptr<LogFile> LogFile::Open(const std::filesystem::path& path, int rows) {
+    std::shared_ptr<const MappedFile> file = MappedFile::Open(path);
+    if (!file) {
+        return nullptr;
+    }
+
+    std::shared_ptr<LogFile> log(new LogFile());
+    log->m_file = std::move(file);
+    log->m_bytes = log->m_file->GetBytes();
+
+    // The screen's lines, back from the end; a final line end starts no line
+    const char* data = log->m_bytes.data();
+    const char* end = data + log->m_bytes.size();
+    if (end[-1] == '\n') {
+        --end;
+    }
+    size_t tailStart = 0;
+    for (int row = 0; row < std::max(rows, 1); ++row) {
+        const char* newline = FindLastNewline(data, end);
+        if (!newline) {
+            tailStart = 0;
+            break;
+        }
+        tailStart = static_cast<size_t>(newline - data) + 1;
+        end = newline;
+    }
+    log->m_tailStart = tailStart;
+
+    if (tailStart == 0) {
+        log->m_indexed.store(true, std::memory_order_release);
+        return log;
+    }
+    try {
+        log->m_scanner = std::thread(&LogFile::ScanProc, log.get());
+    } catch (const std::system_error&) {
+        return nullptr;
+    }
+    return log;
+}
+
+LogFile::~LogFile() {
+    m_stop.store(true, std::memory_order_relaxed);
+    if (m_scanner.joinable()) {
+        m_scanner.join();
+    }
+}
+
+std::string LogFile::GetTail() const {
+    std::string tail;
+    std::string_view rest(m_bytes.data() + m_tailStart, m_bytes.size() - m_tailStart);
+    while (!rest.empty()) {
+        const size_t newline = rest.find('\n');
+        const std::string_view line = TrimCr(rest.substr(0, newline));
+        tail.append(line.substr(0, kMaxLineBytes));
+        if (newline == std::string_view::npos || newline + 1 == rest.size()) {
+            break;
+        }
+        tail.append("\r\n");
+        rest.remove_prefix(newline + 1);
+    }
+    return tail;
+}
+
+size_t LogFile::GetLineEnd(size_t index) const {
+    size_t end = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        end = m_marks[index / kMarkLines];
+    }
+    for (size_t step = index % kMarkLines; step != 0; --step) {
+        end = static_cast<size_t>(FindLastNewline(m_bytes.data(), m_bytes.data() + end) - m_bytes.data());
+    }
+    return end;
+}
+
+std::string_view LogFile::GetLine(size_t index) const {
+    const size_t end = GetLineEnd(index);
+    const char* newline = FindLastNewline(m_bytes.data(), m_bytes.data() + end);
+    const size_t start = newline ? static_cast<size_t>(newline - m_bytes.data()) + 1 : 0;
+    return TrimCr({m_bytes.data() + start, end - start});
+}
+
+const Row* LogFile::Decode(size_t index, int cols) const {
+    if (index >= GetLineCount() || cols <= 0) {
+        return nullptr;
+    }
+
+    // One row, no autowrap: a long line is cut where the row ends
+    if (!m_decoder) {
+        m_decoder = std::make_unique<Emulation::VTermWrapper>(1, cols);
+        static constexpr char kNoWrap[] = "\x1b[?7l";
+        (void)m_decoder->InputWrite(kNoWrap, sizeof(kNoWrap) - 1);
+    } else if (m_decoderCols != cols) {
+        m_decoder->Resize(1, cols);
+    }
+    m_decoderCols = cols;
+
+    // Each line on its own: cancel whatever the last left open, then start
+    // from the default style on a blank row
+    const std::string_view line = GetLine(index).substr(0, kMaxLineBytes);
+    m_decodeScratch.assign("\x18\x1b[0m\r\x1b[2K");
+    std::remove_copy(line.begin(), line.end(), std::back_inserter(m_decodeScratch), '\r');
+    (void)m_decoder->InputWrite(m_decodeScratch.data(), m_decodeScratch.size());
+
+    m_row.resize(static_cast<size_t>(cols));
+    (void)m_decoder->ReadRow(0, 0, m_row);
+    return &m_row;
+}
+
+std::optional<LogMatch> LogFile::Find(const TextMatcher& matcher, size_t& from, size_t bytes) const {
+    const char* data = m_bytes.data();
+    size_t searched = 0;
+    while (from < GetLineCount() && searched < bytes) {
+        // A window of whole lines, ending with line from
+        const size_t windowEnd = GetLineEnd(from);
+        size_t windowStart = windowEnd > kSearchWindowBytes ? windowEnd - kSearchWindowBytes : 0;
+        if (windowStart != 0) {
+            const char* newline = FindLastNewline(data, data + windowStart);
+            windowStart = newline ? static_cast<size_t>(newline - data) + 1 : 0;
+        }
+        const std::string_view window(data + windowStart, windowEnd - windowStart);
+        searched += window.size() + 1;
+
+        // Plain text is matched across the window, expressions a line at a time
+        size_t at = std::string_view::npos;
+        size_t length = 0;
+        if (!matcher.IsLineBased()) {
+            at = FindLast(matcher, window, length);
+        } else {
+            for (size_t lineEnd = window.size(); at == std::string_view::npos;) {
+                const char* newline = FindLastNewline(window.data(), window.data() + lineEnd);
+                const size_t lineStart = newline ? static_cast<size_t>(newline - window.data()) + 1 : 0;
+                const size_t found = FindLast(matcher, TrimCr(window.substr(lineStart, lineEnd - lineStart)), length);
+                if (found != std::string_view::npos) {
+                    at = lineStart + found;
+                } else if (lineStart == 0) {
+                    break;
+                } else {
+                    lineEnd = lineStart - 1;
+                }
+            }
+        }
+
+        const size_t lines = static_cast<size_t>(std::count(window.begin(), window.end(), '\n'));
+        if (at != std::string_view::npos) {
+            const auto after = static_cast<size_t>(std::count(window.begin() + static_cast<std::ptrdiff_t>(at),
+                                                              window.end(), '\n'));
+            const char* newline = FindLastNewline(window.data(), window.data() + at);
+            const size_t lineStart = newline ? static_cast<size_t>(newline - window.data()) + 1 : 0;
+            LogMatch match;
+            match.line = from + after;
+            match.offset = at - lineStart;
+            match.length = length;
+            if (match.line >= GetLineCount()) {
+                // In lines the index has yet to reach
+                return std::nullopt;
+            }
+            from = match.line + 1;
+            return match;
+        }
+        from += lines + 1;
+    }
+    return std::nullopt;
+}
+
+void LogFile::ScanProc() {
+    const char* data = m_bytes.data();
+    size_t end = m_tailStart - 1;           // The '\n' the last line before the tail ends in
+    size_t ends = 1;                        // Line ends found
+    std::vector<size_t> marks{end};
+    while (!m_stop.load(std::memory_order_relaxed)) {
+        // A slice at a time, published whole
+        const size_t sliceStart = end > kScanBytes ? end - kScanBytes : 0;
+        const char* newline = FindLastNewline(data + sliceStart, data + end);
+        for (; newline; newline = FindLastNewline(data + sliceStart, newline)) {
+            if (ends % kMarkLines == 0) {
+                marks.push_back(static_cast<size_t>(newline - data));
+            }
+            ++ends;
+        }
+        end = sliceStart;
+
+        const bool done = sliceStart == 0;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_marks.insert(m_marks.end(), marks.begin(), marks.end());
+        }
+        marks.clear();
+
+        // The oldest end found starts a line only once the one before it
+        // ends, or the file does
+        m_lineCount.store(done ? ends : ends - 1, std::memory_order_release);
+        if (done) {
+            m_indexed.store(true, std::memory_order_release);
+            return;
+        }
+    }
+}
+
+} // namespace Console3::Core
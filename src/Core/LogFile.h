@@ -0,0 +1,138 @@
+#pragma once
+// Console3 - LogFile.h
+// A log file shown as scrollback, read from its mapping as it is drawn
+//
+// Reading a multi-gigabyte log into the scrollback would parse every byte
+// and store every line before the first frame. A log view (console3 --view
+// <file>) maps the file instead (MappedFile) and leaves it where it is:
+//
+//   Tail      - the lines that fit the screen, found by scanning back from
+//               the end, go through the session's emulator like output.
+//   Index     - a worker thread scans back from the tail for newlines (SSE2,
+//               16 bytes a step) and records where every kMarkLines-th
+//               line ends. Lines are numbered from the tail back, so the
+//               newest are there at once and each line keeps its number as
+//               the scan goes on; the scrollback grows at its old end until
+//               the start of the file is reached.
+//   Decode    - a line is parsed only when it is drawn: its bytes go
+//               through a one-row emulator of the view's width, so SGR and
+//               the rest render as they would in the terminal. Each line
+//               starts in the default style; lines are cut at the width.
+//   Search    - Find() runs a TextMatcher over the mapped bytes, a window
+//               at a time from a line back toward the start of the file.
+//
+// The file is mapped as it was when opened; lines written to it later are
+// not shown.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "Core/Cell.h"
+#include "Core/MappedFile.h"
+
+namespace Console3::Emulation {
+class VTermWrapper;
+}
+
+namespace Console3::Core {
+
+class TextMatcher;
+
+/// A match in a log file's lines
+struct LogMatch {
+    size_t line = 0;        ///< LogFile line index
+    size_t offset = 0;      ///< Byte offset in the line
+    size_t length = 0;      ///< Bytes matched
+};
+
+/// A mapped log file, indexed in the background (see file comment)
+class LogFile {
+public:
+    static constexpr size_t kMarkLines = 32;                ///< Lines between recorded line ends
+    static constexpr size_t kScanBytes = 4 << 20;           ///< Bytes scanned between publishing marks
+    static constexpr size_t kMaxLineBytes = 64 * 1024;      ///< Bytes of a line decoded at most
+    static constexpr size_t kSearchWindowBytes = 1 << 20;   ///< Bytes searched per step, about
+
+    /// Map a file and start indexing it
+    /// @param rows Lines the screen shows (the tail)
+    /// @return The file, or nullptr if it can't be opened or is empty
+    [[nodiscard]] static std::shared_ptr<LogFile> Open(const std::filesystem::path& path, int rows);
+
+    ~LogFile();
+
+    // Non-copyable, non-movable (the worker holds this)
+    LogFile(const LogFile&) = delete;
+    LogFile& operator=(const LogFile&) = delete;
+    LogFile(LogFile&&) = delete;
+    LogFile& operator=(LogFile&&) = delete;
+
+    /// Get the last lines, the ones the screen shows, as terminal output
+    /// (line ends as CR LF, each line cut at kMaxLineBytes)
+    [[nodiscard]] std::string GetTail() const;
+
+    /// Get the lines before the tail indexed so far
+    [[nodiscard]] size_t GetLineCount() const noexcept { return m_lineCount.load(std::memory_order_acquire); }
+
+    /// Check if the index reached the start of the file
+    [[nodiscard]] bool IsIndexed() const noexcept { return m_indexed.load(std::memory_order_acquire); }
+
+    /// Get the size of the file
+    [[nodiscard]] size_t GetSize() const noexcept { return m_bytes.size(); }
+
+    /// Get a line's bytes, without its line end
+    /// @param index Line before the tail (0 = the last), below GetLineCount()
+    [[nodiscard]] std::string_view GetLine(size_t index) const;
+
+    /// Decode a line for display, cut at a width
+    /// The row is scratch storage: it stays valid until the next call. One
+    /// thread at a time (the one drawing the buffer).
+    /// @return The line, or nullptr if out of range
+    [[nodiscard]] const Row* Decode(size_t index, int cols) const;
+
+    /// Find the nearest match at or before a line, back toward the start of
+    /// the file; only lines indexed so far are searched
+    /// @param from Line to start at (0 = the last before the tail); receives
+    ///             the line to go on from (past the match, or past the
+    ///             lines searched)
+    /// @param bytes Bytes to search before giving up for now, about
+    /// @return The match, or nullopt if there was none within bytes (more
+    ///         remain while from < GetLineCount())
+    [[nodiscard]] std::optional<LogMatch> Find(const TextMatcher& matcher, size_t& from, size_t bytes) const;
+
+private:
+    LogFile() = default;
+
+    /// Get the offset of the '\n' a line ends in
+    [[nodiscard]] size_t GetLineEnd(size_t index) const;
+
+    void ScanProc();
+
+    std::shared_ptr<const MappedFile> m_file;
+    std::span<const char> m_bytes;
+    size_t m_tailStart = 0;                 ///< Offset of the first line on the screen
+
+    // Written by the worker
+    mutable std::mutex m_lock;
+    std::vector<size_t> m_marks;            ///< Line end of every kMarkLines-th line (guarded)
+    std::atomic<size_t> m_lineCount{0};
+    std::atomic<bool> m_indexed{false};
+    std::atomic<bool> m_stop{false};
+    std::thread m_scanner;
+
+    // Decoding (the drawing thread)
+    mutable std::unique_ptr<Emulation::VTermWrapper> m_decoder;
+    mutable int m_decoderCols = 0;
+    mutable std::string m_decodeScratch;
+    mutable Row m_row;
+};
+
+} // namespace Console3::Core
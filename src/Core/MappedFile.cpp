@@ -0,0 +1,32 @@
+// Console3 - MappedFile.cpp
+// A read-only file mapped whole
+
+#include "Core/MappedFile.h"
+
+#include <cstdint>
+
+namespace Console3::Core {
+
+std::shared_ptr<const MappedFile> MappedFile::Open(const std::filesystem::path& path) {
+    auto file = std::make_shared<MappedFile>();
+    file->m_file.reset(CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                                   OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
+    LARGE_INTEGER size{};
+    if (!file->m_file || !GetFileSizeEx(file->m_file.get(), &size) || size.QuadPart <= 0 ||
+        static_cast<uint64_t>(size.QuadPart) > SIZE_MAX) {
+        return nullptr;
+    }
+
+    file->m_mapping.reset(CreateFileMappingW(file->m_file.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+    if (!file->m_mapping) {
+        return nullptr;
+    }
+    file->m_view.reset(static_cast<char*>(MapViewOfFile(file->m_mapping.get(), FILE_MAP_READ, 0, 0, 0)));
+    if (!file->m_view) {
+        return nullptr;
+    }
+    file->m_size = static_cast<size_t>(size.QuadPart);
+    return file;
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,42 @@
+#pragma once
+// Console3 - MappedFile.h
+// A read-only file mapped whole
+//
+// Startup reads files written by an earlier run (session history, the
+// settings cache) straight from a mapping instead of copying them into
+// buffers first. The file is opened with FILE_SHARE_DELETE, so a writer can
+// rename a new version over it while it is mapped.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+#include <filesystem>
+#include <memory>
+#include <span>
+
+#include <wil/resource.h>
+
+namespace Console3::Core {
+
+/// A read-only file mapped whole
+class MappedFile {
+public:
+    /// Map a file
+    /// @return The mapping, or nullptr if the file can't be opened or is empty
+    [[nodiscard]] static std::shared_ptr<const MappedFile> Open(const std::filesystem::path& path);
+
+    [[nodiscard]] std::span<const char> GetBytes() const noexcept { return {m_view.get(), m_size}; }
+
+private:
+    wil::unique_hfile m_file;
+    wil::unique_handle m_mapping;
+    wil::unique_mapview_ptr<char> m_view;
+    size_t m_size = 0;
+};
+
+} // namespace Console3::Core
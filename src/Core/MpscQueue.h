@@ -0,0 +1,80 @@
+#pragma once
+// Console3 - MpscQueue.h
+// Lock-free multi-producer, single-consumer queue
+//
+// Several threads produce input for one shell: the UI thread (keys, mouse
+// reports) and the parse side (the emulator's replies, which may run on a
+// worker). Each pushes without a lock; the session's input writer thread is
+// the only consumer. The queue is an intrusive linked list (Vyukov's): a
+// push is one exchange and one store, a pop touches only the consumer's end.
+//
+// A push is visible to the consumer once it has linked its node, which is
+// the second of its two steps; until then the queue may look empty to
+// IsEmpty()/TryPop() even though the exchange happened. Producers that need
+// the consumer woken do so after Push() returns.
+
+#include <atomic>
+#include <utility>
+
+namespace Console3::Core {
+
+/// Unbounded lock-free MPSC queue
+/// Push() from any thread; TryPop() and IsEmpty() from the one consumer.
+template <typename T> class MpscQueue {
+public:
+  MpscQueue() : m_head(new Node), m_tail(m_head.load()) {}
+
+  ~MpscQueue() {
+    T value;
+    while (TryPop(value)) {
+    }
+    delete m_tail;
+  }
+
+  // Non-copyable, non-movable (atomic members)
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue &operator=(const MpscQueue &) = delete;
+  MpscQueue(MpscQueue &&) = delete;
+  MpscQueue &operator=(MpscQueue &&) = delete;
+
+  /// Add a value (any thread)
+  void Push(T value) {
+    Node *node = new Node;
+    node->value = std::move(value);
+    Node *prev = m_head.exchange(node, std::memory_order_acq_rel);
+    // Sequentially consistent, so a producer that checks a "consumer is
+    // idle" flag afterwards and the consumer that set it before looking
+    // can't both miss each other
+    prev->next.store(node, std::memory_order_seq_cst);
+  }
+
+  /// Take the oldest value (consumer only)
+  /// @return false if the queue is empty
+  bool TryPop(T &value) {
+    Node *next = m_tail->next.load(std::memory_order_acquire);
+    if (!next) {
+      return false;
+    }
+    // The popped node becomes the new stub; its value moves out
+    value = std::move(next->value);
+    delete m_tail;
+    m_tail = next;
+    return true;
+  }
+
+  /// Check if there is nothing to pop (consumer only)
+  [[nodiscard]] bool IsEmpty() const {
+    return m_tail->next.load(std::memory_order_seq_cst) == nullptr;
+  }
+
+private:
+  struct Node {
+    std::atomic<Node *> next{nullptr};
+    T value{};
+  };
+
+  std::atomic<Node *> m_head; ///< Newest node (producers)
+  Node *m_tail;               ///< Stub before the oldest value (consumer)
+};
+
+} // namespace Console3::Core
@@ -0,0 +1,50 @@
+// Console3 - OutputPacer.cpp
+// How long a parse pass runs before it yields
+
+#include "Core/OutputPacer.h"
+#include "Core/PerfClock.h"
+#include <algorithm>
+
+namespace Console3::Core {
+
+void OutputPacer::NoteInput() noexcept {
+    // Typing ahead: the first key still waiting is the one measured
+    uint64_t none = 0;
+    m_inputMicros.compare_exchange_strong(none, PerfClock::NowMicros(), std::memory_order_relaxed);
+}
+
+uint64_t OutputPacer::GetBudget() noexcept {
+    const uint64_t input = m_inputMicros.load(std::memory_order_relaxed);
+    if (input == 0) {
+        return kMaxMicros;
+    }
+    if (PerfClock::NowMicros() - input >= kEchoWindowMicros) {
+        // Not a key the program echoes (or it is busy elsewhere)
+        uint64_t expected = input;
+        m_inputMicros.compare_exchange_strong(expected, 0, std::memory_order_relaxed);
+        return kMaxMicros;
+    }
+    return m_echoBudget;
+}
+
+void OutputPacer::EndPass(bool parsed) noexcept {
+    if (!parsed) {
+        return;
+    }
+    const uint64_t input = m_inputMicros.exchange(0, std::memory_order_relaxed);
+    if (input == 0) {
+        return;
+    }
+    const uint64_t now = PerfClock::NowMicros();
+    const uint64_t echo = now > input ? now - input : 0;
+    if (echo >= kEchoWindowMicros) {
+        return;
+    }
+    if (echo > kEchoTargetMicros) {
+        m_echoBudget = std::max(kMinMicros, m_echoBudget / 2);
+    } else {
+        m_echoBudget = std::min(kMaxMicros, m_echoBudget + kStepMicros);
+    }
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,47 @@
+#pragma once
+// Console3 - OutputPacer.h
+// How long a parse pass runs before it yields
+//
+// A pass that parsed until the output ring was empty held its thread for as
+// long as a flood kept up: the render thread could not present, and held
+// the render lock the UI thread takes for every key. A pass now stops at a
+// time budget, flushes the damage and leaves the rest for the next pass,
+// after the frame and the input queued meanwhile.
+//
+// The budget follows the echo, measured from a key being written to the
+// end of the first pass that parsed output after it. An echo slower than
+// kEchoTargetMicros halves the budget, down to kMinMicros, so keys and
+// frames get in between passes sooner; one within the target adds
+// kStepMicros, up to kMaxMicros, back toward fewer and longer passes. With
+// no key waiting for its echo a pass takes kMaxMicros: throughput first.
+
+#include <atomic>
+#include <cstdint>
+
+namespace Console3::Core {
+
+/// Sizes a session's parse passes (see file comment)
+class OutputPacer {
+public:
+    static constexpr uint64_t kMinMicros = 1000;
+    static constexpr uint64_t kMaxMicros = 16000;
+    static constexpr uint64_t kStepMicros = 1000;
+    static constexpr uint64_t kEchoTargetMicros = 8000;     ///< Key written to its echo parsed
+    static constexpr uint64_t kEchoWindowMicros = 250'000;  ///< A key unanswered longer has no echo
+
+    /// Note a key written to the program (any thread)
+    void NoteInput() noexcept;
+
+    /// Get the next pass's time budget (parse side)
+    [[nodiscard]] uint64_t GetBudget() noexcept;
+
+    /// Note the end of a pass (parse side)
+    /// @param parsed The pass parsed output
+    void EndPass(bool parsed) noexcept;
+
+private:
+    std::atomic<uint64_t> m_inputMicros{0};     ///< Oldest key without its echo (0 = none)
+    uint64_t m_echoBudget = kMaxMicros;         ///< Parse side
+};
+
+} // namespace Console3::Core
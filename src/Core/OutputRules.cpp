@@ -0,0 +1,174 @@
+// Console3 - OutputRules.cpp
+// Highlight and bell rules evaluated on the output stream
+
+#include "Core/OutputRules.h"
+#include "Core/ScrollbackSearch.h"
+#include <algorithm>
+#include <deque>
+
+namespace Console3::Core {
+
+namespace {
+
+constexpr uint32_t kNoState = 0xFFFFFFFF;
+
+} // namespace
+
+// ============================================================================
+// MultiPatternMatcher
+// ============================================================================
+
+void MultiPatternMatcher::Build(std::span<const Pattern> patterns) {
+    m_patterns.assign(patterns.begin(), patterns.end());
+    m_next.assign(256, kNoState);
+    std::vector<std::vector<uint32_t>> outputs(1);
+
+    // The trie of folded patterns
+    for (uint32_t index = 0; index < m_patterns.size(); ++index) {
+        const std::string& text = m_patterns[index].text;
+        if (text.empty()) {
+            continue;
+        }
+        uint32_t state = 0;
+        for (const char c : text) {
+            uint32_t& next = m_next[static_cast<size_t>(state) * 256 + Fold(static_cast<uint8_t>(c))];
+            if (next == kNoState) {
+                next = static_cast<uint32_t>(outputs.size());
+                outputs.emplace_back();
+                m_next.resize(m_next.size() + 256, kNoState);
+            }
+            state = m_next[static_cast<size_t>(state) * 256 + Fold(static_cast<uint8_t>(c))];
+        }
+        outputs[state].push_back(index);
+    }
+
+    // Breadth first, each state's missing transitions become its failure
+    // state's, and it inherits the failure state's outputs
+    std::vector<uint32_t> fail(outputs.size(), 0);
+    std::deque<uint32_t> queue;
+    for (size_t c = 0; c < 256; ++c) {
+        uint32_t& next = m_next[c];
+        if (next == kNoState) {
+            next = 0;
+        } else {
+            queue.push_back(next);
+        }
+    }
+    while (!queue.empty()) {
+        const uint32_t state = queue.front();
+        queue.pop_front();
+        const std::vector<uint32_t>& inherited = outputs[fail[state]];
+        outputs[state].insert(outputs[state].end(), inherited.begin(), inherited.end());
+
+        for (size_t c = 0; c < 256; ++c) {
+            uint32_t& next = m_next[static_cast<size_t>(state) * 256 + c];
+            const uint32_t fallback = m_next[static_cast<size_t>(fail[state]) * 256 + c];
+            if (next == kNoState) {
+                next = fallback;
+            } else {
+                fail[next] = fallback;
+                queue.push_back(next);
+            }
+        }
+    }
+
+    m_outputStart.clear();
+    m_outputs.clear();
+    for (const std::vector<uint32_t>& out : outputs) {
+        m_outputStart.push_back(static_cast<uint32_t>(m_outputs.size()));
+        m_outputs.insert(m_outputs.end(), out.begin(), out.end());
+    }
+    m_outputStart.push_back(static_cast<uint32_t>(m_outputs.size()));
+
+    if (std::all_of(m_patterns.begin(), m_patterns.end(), [](const Pattern& p) { return p.text.empty(); })) {
+        m_patterns.clear();
+    }
+}
+
+bool MultiPatternMatcher::Verify(uint32_t index, std::string_view text, size_t end) const noexcept {
+    const std::string& pattern = m_patterns[index].text;
+    return end >= pattern.size() && text.compare(end - pattern.size(), pattern.size(), pattern) == 0;
+}
+
+// ============================================================================
+// OutputRules
+// ============================================================================
+
+void OutputRules::SetRules(std::vector<OutputRule> rules) {
+    m_rules = std::move(rules);
+
+    std::vector<MultiPatternMatcher::Pattern> patterns;
+    patterns.reserve(m_rules.size());
+    for (const OutputRule& rule : m_rules) {
+        patterns.push_back({rule.text, rule.matchCase});
+    }
+    m_matcher.Build(patterns);
+    m_fired.assign(m_rules.size(), 0);
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_highlights.clear();
+    ++m_highlightGeneration;
+    m_events.clear();
+}
+
+void OutputRules::ScanLine(uint64_t line, std::span<const Cell> cells) {
+    if (m_matcher.IsEmpty()) {
+        return;
+    }
+
+    m_text.clear();
+    ScrollbackSearch::AppendLineText(m_text, cells);
+    bool matched = false;
+    m_matcher.Scan(m_text, [&](uint32_t rule, size_t) {
+        m_fired[rule] = 1;
+        matched = true;
+    });
+    if (!matched) {
+        return;
+    }
+
+    // Each rule fires once per line; the first rule with a highlight colors it
+    std::lock_guard<std::mutex> lock(m_lock);
+    bool highlighted = false;
+    for (size_t rule = 0; rule < m_rules.size(); ++rule) {
+        if (!m_fired[rule]) {
+            continue;
+        }
+        m_fired[rule] = 0;
+        if (m_rules[rule].highlight && !highlighted) {
+            m_highlights[line] = m_rules[rule].color;
+            ++m_highlightGeneration;
+            highlighted = true;
+        }
+        if (m_rules[rule].bell && m_events.size() < kMaxEvents) {
+            m_events.push_back(RuleEvent{rule, line});
+        }
+    }
+    while (m_highlights.size() > kMaxHighlights) {
+        m_highlights.erase(m_highlights.begin());
+    }
+}
+
+void OutputRules::FindHighlights(uint64_t first, uint64_t last, std::vector<LineHighlight>& highlights) const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    for (auto it = m_highlights.lower_bound(first); it != m_highlights.end() && it->first <= last; ++it) {
+        highlights.push_back(LineHighlight{it->first, it->second});
+    }
+}
+
+uint64_t OutputRules::GetHighlightGeneration() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_highlightGeneration;
+}
+
+bool OutputRules::TakeEvents(std::vector<RuleEvent>& events) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_events.empty()) {
+        return false;
+    }
+    events.insert(events.end(), m_events.begin(), m_events.end());
+    m_events.clear();
+    return true;
+}
+
+} // namespace Console3::Core
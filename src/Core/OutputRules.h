@@ -0,0 +1,130 @@
+#pragma once
+// Console3 - OutputRules.h
+// Highlight and bell rules evaluated on the output stream
+//
+// Rules watch for texts in the output ("ERROR", "BUILD FAILED"). Scanning
+// what is rendered would mean reading every row again each frame; instead
+// each line is scanned once, on the emulation side, when it is complete:
+// when the cursor has moved below it, or it is pushed to the scrollback
+// (Session does both and keeps each line to one scan). All rules' texts are
+// compiled into one Aho-Corasick automaton, expanded to a full transition
+// table, so a line costs one table lookup per byte however many rules there
+// are. Only a match produces anything: a highlight for the line, kept by
+// absolute line for the view to draw, and an event for the UI to take.
+//
+// Rules match literal text within one line; a match split by a soft wrap
+// is not found.
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Core/Cell.h"
+#include "Core/Settings.h"
+
+namespace Console3::Core {
+
+/// Finds many literal patterns at once (Aho-Corasick as a DFA)
+class MultiPatternMatcher {
+public:
+    /// A pattern and how it is compared
+    struct Pattern {
+        std::string text;           ///< UTF-8
+        bool matchCase = false;     ///< Case-insensitive compares ASCII letters only
+    };
+
+    /// Compile patterns, replacing any before (empty ones never match)
+    void Build(std::span<const Pattern> patterns);
+
+    /// Check if there is anything to find
+    [[nodiscard]] bool IsEmpty() const noexcept { return m_patterns.empty(); }
+
+    /// Find every occurrence of every pattern
+    /// @param found Called with the pattern's index and the offset past the match
+    template <typename Found>
+    void Scan(std::string_view text, Found&& found) const {
+        if (m_patterns.empty()) {
+            return;
+        }
+        uint32_t state = 0;
+        for (size_t i = 0; i < text.size(); ++i) {
+            state = m_next[static_cast<size_t>(state) * 256 + Fold(static_cast<uint8_t>(text[i]))];
+            for (uint32_t out = m_outputStart[state]; out < m_outputStart[state + 1]; ++out) {
+                const uint32_t index = m_outputs[out];
+                if (!m_patterns[index].matchCase || Verify(index, text, i + 1)) {
+                    found(index, i + 1);
+                }
+            }
+        }
+    }
+
+private:
+    [[nodiscard]] static uint8_t Fold(uint8_t c) noexcept {
+        return c >= 'A' && c <= 'Z' ? static_cast<uint8_t>(c + ('a' - 'A')) : c;
+    }
+
+    [[nodiscard]] bool Verify(uint32_t index, std::string_view text, size_t end) const noexcept;
+
+    std::vector<Pattern> m_patterns;
+    std::vector<uint32_t> m_next;           ///< State * 256 + folded byte -> state
+    std::vector<uint32_t> m_outputStart;    ///< Per state, into m_outputs (plus an end)
+    std::vector<uint32_t> m_outputs;        ///< Patterns ending at each state
+};
+
+/// A rule that fired
+struct RuleEvent {
+    size_t rule = 0;                ///< Index in the rules given to SetRules()
+    uint64_t line = 0;              ///< Absolute line (see TerminalBuffer::GetScreenLine)
+};
+
+/// A highlighted line
+struct LineHighlight {
+    uint64_t line = 0;
+    uint32_t color = 0;             ///< 0xRRGGBB
+};
+
+/// Output rules of one session (see file comment)
+class OutputRules {
+public:
+    static constexpr size_t kMaxHighlights = 65536;   ///< Oldest lines' highlights go past this
+    static constexpr size_t kMaxEvents = 256;         ///< Events not taken past this are dropped
+
+    /// Set the rules (before output is scanned)
+    void SetRules(std::vector<OutputRule> rules);
+
+    /// Check if any rule is set
+    [[nodiscard]] bool IsEmpty() const noexcept { return m_matcher.IsEmpty(); }
+
+    /// Get the rules set
+    [[nodiscard]] const std::vector<OutputRule>& GetRules() const noexcept { return m_rules; }
+
+    /// Scan a complete line (emulation side)
+    void ScanLine(uint64_t line, std::span<const Cell> cells);
+
+    /// Append the highlights on lines [first, last] (any thread)
+    void FindHighlights(uint64_t first, uint64_t last, std::vector<LineHighlight>& highlights) const;
+
+    /// Get a count that changes whenever the highlights do (any thread)
+    [[nodiscard]] uint64_t GetHighlightGeneration() const;
+
+    /// Take the events since the last call (any thread)
+    /// @return false if there were none
+    bool TakeEvents(std::vector<RuleEvent>& events);
+
+private:
+    std::vector<OutputRule> m_rules;
+    MultiPatternMatcher m_matcher;
+    std::string m_text;                     ///< Emulation side: the line as UTF-8
+    std::vector<uint8_t> m_fired;           ///< Emulation side: rules matched in the line
+
+    mutable std::mutex m_lock;
+    std::map<uint64_t, uint32_t> m_highlights;
+    uint64_t m_highlightGeneration = 0;
+    std::vector<RuleEvent> m_events;
+};
+
+} // namespace Console3::Core
@@ -0,0 +1,198 @@
+// Console3 - OutputTaps.cpp
+// Extensions that watch a session's output
+
+#include "Core/OutputTaps.h"
+#include "Core/PerfClock.h"
+#include "Core/TerminalBuffer.h"
+#include <algorithm>
+#include <utility>
+
+namespace Console3::Core {
+
+namespace {
+
+/// Run a call into an extension, charging its time to the extension
+template <typename TapType, typename Call>
+void Timed(TapType& tap, Call&& call) {
+    const uint64_t start = PerfClock::NowMicros();
+    call();
+    const uint64_t elapsed = PerfClock::NowMicros() - start;
+    tap.usedMicros += elapsed;
+    tap.micros.fetch_add(elapsed, std::memory_order_relaxed);
+}
+
+} // namespace
+
+uint32_t OutputTaps::Add(std::shared_ptr<OutputExtension> extension, const OutputTapOptions& options) {
+    auto tap = std::make_shared<Tap>();
+    tap->extension = std::move(extension);
+    tap->options = options;
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    tap->id = m_nextId++;
+    m_all.push_back(tap);
+    ++m_allVersion;
+    m_count.store(m_all.size(), std::memory_order_release);
+    return tap->id;
+}
+
+void OutputTaps::Remove(uint32_t id) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    const auto it = std::ranges::find(m_all, id, [](const auto& tap) { return tap->id; });
+    if (it == m_all.end()) {
+        return;
+    }
+    (*it)->removed.store(true, std::memory_order_release);
+    m_all.erase(it);
+    ++m_allVersion;
+    m_count.store(m_all.size(), std::memory_order_release);
+}
+
+bool OutputTaps::GetStats(uint32_t id, OutputTapStats& stats) const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    const auto it = std::ranges::find(m_all, id, [](const auto& tap) { return tap->id; });
+    if (it == m_all.end()) {
+        return false;
+    }
+    const Tap& tap = **it;
+    stats.bytes = tap.bytes.load(std::memory_order_relaxed);
+    stats.lines = tap.lines.load(std::memory_order_relaxed);
+    stats.droppedBytes = tap.droppedBytes.load(std::memory_order_relaxed);
+    stats.droppedLines = tap.droppedLines.load(std::memory_order_relaxed);
+    stats.micros = tap.micros.load(std::memory_order_relaxed);
+    stats.passesOverBudget = tap.passesOverBudget.load(std::memory_order_relaxed);
+    stats.queuedBytes = tap.queuedBytes.load(std::memory_order_relaxed);
+    return true;
+}
+
+void OutputTaps::BeginPass() {
+    if (m_taps.empty() && !IsActive()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_version != m_allVersion) {
+            m_taps = m_all;
+            m_version = m_allVersion;
+        }
+    }
+
+    // What waited is handed over before anything new, within the budget
+    for (const auto& tap : m_taps) {
+        tap->usedMicros = 0;
+        tap->overBudget = false;
+        while (!tap->queue.empty() && !IsOverBudget(*tap)) {
+            Queued queued = std::move(tap->queue.front());
+            tap->queue.pop_front();
+            tap->queueBytes -= queued.text.size() + queued.cells.size() * sizeof(Cell);
+            tap->queuedBytes.store(tap->queueBytes, std::memory_order_relaxed);
+            Deliver(*tap, queued);
+        }
+    }
+}
+
+bool OutputTaps::HasQueued() const noexcept {
+    return std::ranges::any_of(m_taps, [](const auto& tap) { return !tap->queue.empty(); });
+}
+
+void OutputTaps::OnBytes(std::span<const char> bytes) {
+    for (const auto& tap : m_taps) {
+        if (!tap->options.bytes || bytes.empty()) {
+            continue;
+        }
+        if (tap->queue.empty() && !IsOverBudget(*tap)) {
+            Timed(*tap, [&] { tap->extension->OnOutputBytes(bytes); });
+            tap->bytes.fetch_add(bytes.size(), std::memory_order_relaxed);
+            continue;
+        }
+        Queued queued;
+        queued.text.assign(bytes.begin(), bytes.end());
+        Enqueue(*tap, std::move(queued));
+    }
+}
+
+void OutputTaps::OnLine(uint64_t line, std::span<const Cell> cells, bool continuation) {
+    bool textMade = false;
+    for (const auto& tap : m_taps) {
+        if (!tap->options.lines) {
+            continue;
+        }
+        if (!textMade) {
+            m_text.clear();
+            TerminalBuffer::AppendColumnText(m_text, cells, 0, static_cast<int>(cells.size()));
+            textMade = true;
+        }
+        if (tap->queue.empty() && !IsOverBudget(*tap)) {
+            const OutputTapLine tapLine{line, cells, m_text, continuation};
+            Timed(*tap, [&] { tap->extension->OnOutputLine(tapLine); });
+            tap->lines.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        Queued queued;
+        queued.isLine = true;
+        queued.continuation = continuation;
+        queued.line = line;
+        queued.text = m_text;
+        queued.cells.assign(cells.begin(), cells.end());
+        Enqueue(*tap, std::move(queued));
+    }
+}
+
+void OutputTaps::Clear() {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        for (const auto& tap : m_all) {
+            tap->removed.store(true, std::memory_order_release);
+        }
+        m_all.clear();
+        ++m_allVersion;
+        m_count.store(0, std::memory_order_release);
+    }
+    m_taps.clear();
+}
+
+bool OutputTaps::IsOverBudget(Tap& tap) noexcept {
+    if (tap.removed.load(std::memory_order_acquire)) {
+        // Not called again; its queue goes with it at the next pass
+        return true;
+    }
+    if (tap.usedMicros < tap.options.budgetMicros) {
+        return false;
+    }
+    if (!tap.overBudget) {
+        tap.overBudget = true;
+        tap.passesOverBudget.fetch_add(1, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+void OutputTaps::Deliver(Tap& tap, const Queued& queued) {
+    if (!queued.isLine) {
+        Timed(tap, [&] { tap.extension->OnOutputBytes(queued.text); });
+        tap.bytes.fetch_add(queued.text.size(), std::memory_order_relaxed);
+        return;
+    }
+    const OutputTapLine line{queued.line, queued.cells, queued.text, queued.continuation};
+    Timed(tap, [&] { tap.extension->OnOutputLine(line); });
+    tap.lines.fetch_add(1, std::memory_order_relaxed);
+}
+
+void OutputTaps::Enqueue(Tap& tap, Queued&& queued) {
+    if (tap.removed.load(std::memory_order_acquire)) {
+        return;
+    }
+    const size_t bytes = queued.text.size() + queued.cells.size() * sizeof(Cell);
+    if (tap.queueBytes + bytes > tap.options.maxQueuedBytes) {
+        if (queued.isLine) {
+            tap.droppedLines.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            tap.droppedBytes.fetch_add(queued.text.size(), std::memory_order_relaxed);
+        }
+        return;
+    }
+    tap.queueBytes += bytes;
+    tap.queuedBytes.store(tap.queueBytes, std::memory_order_relaxed);
+    tap.queue.push_back(std::move(queued));
+}
+
+} // namespace Console3::Core
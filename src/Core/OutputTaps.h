@@ -0,0 +1,168 @@
+#pragma once
+// Console3 - OutputTaps.h
+// Extensions that watch a session's output
+//
+// In-house tools (error parsers, metric scrapers) want the output as it
+// goes by. An extension gets it on the side that parses (the emulation
+// worker, or the UI thread without one), without copies:
+//
+//   Bytes - each piece of the output ring, as read from the pseudo console
+//           and before it is parsed, as a span into the ring.
+//   Lines - each line as it leaves the screen for the scrollback, finished:
+//           its cells as the emulator produced them, and its UTF-8 text.
+//
+// The spans are valid only during the call. Every extension has a time
+// budget per parse pass. Calls past it are not made inline: the bytes or
+// line are copied into the extension's queue instead, and handed over at
+// the start of the next passes, oldest first, within the budget again, so
+// a slow extension delays itself and not the pipeline. The queue is
+// bounded; what does not fit is dropped and counted. A call already
+// running can't be cut short, so an extension doing slow work (I/O, a
+// lock) hands it to a thread of its own.
+//
+// Lines are the scrollback's: the screen, and output on the alternate
+// screen (full-screen programs), are not lines until they scroll off.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Core/Cell.h"
+
+namespace Console3::Core {
+
+/// A finished line as an extension sees it
+struct OutputTapLine {
+    uint64_t line = 0;                  ///< Absolute line (see TerminalBuffer::GetScreenLine)
+    std::span<const Cell> cells;
+    std::string_view text;              ///< UTF-8, trailing blanks included
+    bool continuation = false;          ///< Continues the line before (soft wrap)
+};
+
+/// Watches a session's output (see file comment); called on the side that
+/// parses, one call at a time
+class OutputExtension {
+public:
+    virtual ~OutputExtension() = default;
+
+    /// Output as read, before it is parsed (if OutputTapOptions::bytes)
+    virtual void OnOutputBytes(std::span<const char> bytes) { (void)bytes; }
+
+    /// A line that left the screen (if OutputTapOptions::lines)
+    virtual void OnOutputLine(const OutputTapLine& line) { (void)line; }
+};
+
+/// How an extension is fed
+struct OutputTapOptions {
+    bool bytes = true;                  ///< Call OnOutputBytes()
+    bool lines = true;                  ///< Call OnOutputLine()
+    uint32_t budgetMicros = 500;        ///< Time in the extension per parse pass
+    size_t maxQueuedBytes = 1 << 20;    ///< Held for it past its budget at most
+};
+
+/// What an extension was given and what it cost
+struct OutputTapStats {
+    uint64_t bytes = 0;                 ///< Output bytes delivered
+    uint64_t lines = 0;                 ///< Lines delivered
+    uint64_t droppedBytes = 0;          ///< Output bytes its queue had no room for
+    uint64_t droppedLines = 0;          ///< Lines likewise
+    uint64_t micros = 0;                ///< Time spent in it
+    uint64_t passesOverBudget = 0;      ///< Parse passes it ran out of budget in
+    size_t queuedBytes = 0;             ///< Held for it now
+};
+
+/// A session's extensions (see file comment)
+class OutputTaps {
+public:
+    /// Add an extension (any thread); the next parse pass starts feeding it
+    /// @return Its id (never 0)
+    uint32_t Add(std::shared_ptr<OutputExtension> extension, const OutputTapOptions& options = {});
+
+    /// Remove an extension (any thread); a call running now still returns,
+    /// and what is queued for it is dropped
+    void Remove(uint32_t id);
+
+    /// Get an extension's stats (any thread)
+    /// @return false if no extension has the id
+    bool GetStats(uint32_t id, OutputTapStats& stats) const;
+
+    /// Check if any extension is added (any thread)
+    [[nodiscard]] bool IsActive() const noexcept { return m_count.load(std::memory_order_acquire) != 0; }
+
+    /// Start a parse pass: take the extensions added or removed, renew
+    /// their budgets and hand over what is queued within them (parse side)
+    void BeginPass();
+
+    /// Check if anything is still queued after a pass (parse side)
+    [[nodiscard]] bool HasQueued() const noexcept;
+
+    /// Feed output about to be parsed (parse side)
+    void OnBytes(std::span<const char> bytes);
+
+    /// Feed a line leaving the screen (parse side)
+    void OnLine(uint64_t line, std::span<const Cell> cells, bool continuation);
+
+    /// Drop every extension (the session is stopping, its parse side done)
+    void Clear();
+
+private:
+    /// Bytes or a line held past an extension's budget
+    struct Queued {
+        bool isLine = false;
+        bool continuation = false;
+        uint64_t line = 0;
+        std::string text;               ///< The bytes, or the line's text
+        Row cells;
+    };
+
+    /// One extension
+    struct Tap {
+        uint32_t id = 0;
+        std::shared_ptr<OutputExtension> extension;
+        OutputTapOptions options;
+        std::atomic<bool> removed{false};
+
+        // Parse side
+        uint64_t usedMicros = 0;        ///< Spent in this pass
+        bool overBudget = false;        ///< Counted in this pass
+        std::deque<Queued> queue;
+        size_t queueBytes = 0;
+
+        // Read by GetStats()
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> lines{0};
+        std::atomic<uint64_t> droppedBytes{0};
+        std::atomic<uint64_t> droppedLines{0};
+        std::atomic<uint64_t> micros{0};
+        std::atomic<uint64_t> passesOverBudget{0};
+        std::atomic<size_t> queuedBytes{0};
+    };
+
+    /// Check if an extension used its budget, counting the pass once
+    static bool IsOverBudget(Tap& tap) noexcept;
+
+    /// Hand an extension bytes or a line from its queue
+    static void Deliver(Tap& tap, const Queued& queued);
+
+    /// Hold bytes or a line for an extension, or drop them if it has no room
+    static void Enqueue(Tap& tap, Queued&& queued);
+
+    std::vector<std::shared_ptr<Tap>> m_taps;   ///< Parse side
+    uint64_t m_version = 0;                     ///< Parse side: m_all's version in m_taps
+    std::string m_text;                         ///< Parse side: the line as UTF-8
+
+    mutable std::mutex m_lock;
+    std::vector<std::shared_ptr<Tap>> m_all;    ///< Guarded by m_lock
+    uint64_t m_allVersion = 0;                  ///< Guarded by m_lock
+    uint32_t m_nextId = 1;                      ///< Guarded by m_lock
+    std::atomic<size_t> m_count{0};             ///< Extensions in m_all
+};
+
+} // namespace Console3::Core
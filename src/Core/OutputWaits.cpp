@@ -0,0 +1,166 @@
+// Console3 - OutputWaits.cpp
+// Waits for text to appear in a session's output
+
+#include "Core/OutputWaits.h"
+#include "Core/TerminalBuffer.h"
+#include <algorithm>
+#include <utility>
+
+namespace Console3::Core {
+
+// ============================================================================
+// OutputWait
+// ============================================================================
+
+OutputWait::OutputWait(const SearchQuery& query)
+    : m_matcher(query) {
+    (void)m_done.try_create(wil::EventOptions::ManualReset, nullptr);
+}
+
+OutputWait::State OutputWait::Wait(DWORD timeoutMs) const {
+    if (m_done) {
+        (void)WaitForSingleObject(m_done.get(), timeoutMs);
+    }
+    return GetState();
+}
+
+OutputWait::State OutputWait::GetState() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_state;
+}
+
+OutputMatch OutputWait::GetMatch() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_match;
+}
+
+void OutputWait::Cancel() {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_state != State::Pending) {
+            return;
+        }
+        m_state = State::Cancelled;
+    }
+    if (m_done) {
+        SetEvent(m_done.get());
+    }
+}
+
+void OutputWait::Complete(OutputMatch match) {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_state != State::Pending) {
+            return;
+        }
+        m_state = State::Matched;
+        m_match = std::move(match);
+    }
+    if (m_done) {
+        SetEvent(m_done.get());
+    }
+}
+
+// ============================================================================
+// OutputWaits
+// ============================================================================
+
+std::shared_ptr<OutputWait> OutputWaits::Add(const SearchQuery& query) {
+    auto wait = std::make_shared<OutputWait>(query);
+    if (!wait->m_matcher.IsValid() || !wait->m_done) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_added.push_back(wait);
+    m_active.fetch_add(1, std::memory_order_release);
+    return wait;
+}
+
+void OutputWaits::ScanLine(uint64_t line, std::span<const Cell> cells) {
+    Collect();
+    if (m_waits.empty()) {
+        return;
+    }
+    m_text.clear();
+    TerminalBuffer::AppendColumnText(m_text, cells, 0, static_cast<int>(cells.size()));
+    Match(line, false);
+}
+
+void OutputWaits::ScanScreen(const TerminalBuffer& buffer, uint64_t screenLine) {
+    Collect();
+    if (m_waits.empty()) {
+        m_seen.clear();
+        return;
+    }
+
+    // Rows kept since the last scan were matched then, by all but new waits
+    const bool added = std::any_of(m_waits.begin(), m_waits.end(),
+                                   [](const auto& wait) { return !wait->m_screenScanned; });
+    m_generations.clear();
+    for (int row = 0; row < buffer.GetRows(); ++row) {
+        const uint64_t generation = buffer.GetRowGeneration(row);
+        m_generations.push_back(generation);
+        const bool changed = !std::binary_search(m_seen.begin(), m_seen.end(), generation);
+        if (!changed && !added) {
+            continue;
+        }
+        m_text.clear();
+        TerminalBuffer::AppendColumnText(m_text, buffer.GetRow(row), 0, buffer.GetCols());
+        Match(screenLine + static_cast<uint64_t>(row), !changed);
+    }
+    for (const auto& wait : m_waits) {
+        wait->m_screenScanned = true;
+    }
+    std::sort(m_generations.begin(), m_generations.end());
+    std::swap(m_seen, m_generations);
+    Collect();
+}
+
+void OutputWaits::CancelAll() {
+    std::vector<std::shared_ptr<OutputWait>> waits;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        waits = std::exchange(m_added, {});
+        m_active.store(0, std::memory_order_release);
+    }
+    waits.insert(waits.end(), m_waits.begin(), m_waits.end());
+    m_waits.clear();
+    m_seen.clear();
+    for (const auto& wait : waits) {
+        wait->Cancel();
+    }
+}
+
+void OutputWaits::Collect() {
+    if (!IsActive()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        for (auto& wait : m_added) {
+            m_waits.push_back(std::move(wait));
+        }
+        m_added.clear();
+    }
+    const auto done = std::remove_if(m_waits.begin(), m_waits.end(), [](const auto& wait) {
+        return wait->GetState() != OutputWait::State::Pending;
+    });
+    m_active.fetch_sub(static_cast<size_t>(m_waits.end() - done), std::memory_order_release);
+    m_waits.erase(done, m_waits.end());
+}
+
+void OutputWaits::Match(uint64_t line, bool newOnly) {
+    for (const auto& wait : m_waits) {
+        if (newOnly && wait->m_screenScanned) {
+            continue;
+        }
+        size_t length = 0;
+        const size_t offset = wait->m_matcher.Find(m_text, 0, length);
+        if (offset == std::string::npos) {
+            continue;
+        }
+        wait->Complete(OutputMatch{line, offset, length, m_text.substr(offset, length)});
+    }
+}
+
+} // namespace Console3::Core
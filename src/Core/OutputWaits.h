@@ -0,0 +1,142 @@
+#pragma once
+// Console3 - OutputWaits.h
+// Waits for text to appear in a session's output
+//
+// Automation waits for a prompt or a message ("Password:", "BUILD OK")
+// before it types the next thing. Polling the whole screen and scrollback
+// for it after every read costs more the longer the session runs; instead
+// a wait is matched on the emulation side, as the pipeline produces text,
+// like the output rules (OutputRules):
+//
+//   Screen    - after each parse the screen rows whose generation changed
+//               since the last scan are turned to text and matched; a wait
+//               added since then is matched against every row once.
+//   Scrolled  - a line leaving the screen is matched on its way to the
+//               scrollback, so output that scrolls past between two scans
+//               is seen too. A line matched on the screen is matched once
+//               more here by the waits still pending, never again after.
+//
+// Nothing already in the scrollback is searched: a wait is for output that
+// is on the screen or still to come. A match split by a soft wrap is not
+// found. While the screen is deferred (fast-forward, a background session)
+// only scrolled lines are matched; the screen is once it is presented.
+//
+// A wait completes once: matched, or cancelled by its owner (a timeout) or
+// by the session stopping. Its event is set either way, so any thread can
+// wait on it, alone or with other handles.
+
+#include <Windows.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <wil/resource.h>
+
+#include "Core/Cell.h"
+#include "Core/ScrollbackSearch.h"
+
+namespace Console3::Core {
+
+class TerminalBuffer;
+
+/// Where a wait matched
+struct OutputMatch {
+    uint64_t line = 0;          ///< Absolute line (see TerminalBuffer::GetScreenLine)
+    size_t offset = 0;          ///< Byte offset in the line's UTF-8 text
+    size_t length = 0;          ///< Bytes matched
+    std::string text;           ///< The text matched
+};
+
+/// One pending wait (see file comment)
+class OutputWait {
+public:
+    enum class State {
+        Pending,
+        Matched,
+        Cancelled
+    };
+
+    /// Use OutputWaits::Add()
+    explicit OutputWait(const SearchQuery& query);
+
+    // Non-copyable, non-movable (shared with the emulation side)
+    OutputWait(const OutputWait&) = delete;
+    OutputWait& operator=(const OutputWait&) = delete;
+
+    /// Get the event set when the wait completes (manual reset)
+    [[nodiscard]] HANDLE GetEvent() const noexcept { return m_done.get(); }
+
+    /// Wait for the wait to complete
+    /// Only while another thread parses the session's output (an emulation
+    /// thread); a caller that parses waits on GetEvent() with the output.
+    /// @return The state after the wait (Pending if it timed out)
+    State Wait(DWORD timeoutMs) const;
+
+    /// Get the state (any thread)
+    [[nodiscard]] State GetState() const;
+
+    /// Get the match (valid once the state is Matched)
+    [[nodiscard]] OutputMatch GetMatch() const;
+
+    /// Give up on the wait (any thread; does nothing once it completed)
+    void Cancel();
+
+private:
+    friend class OutputWaits;
+
+    /// Complete the wait with a match, unless it already completed
+    void Complete(OutputMatch match);
+
+    TextMatcher m_matcher;              ///< Emulation side
+    bool m_screenScanned = false;       ///< Emulation side: every screen row was matched
+
+    mutable std::mutex m_lock;
+    State m_state = State::Pending;     ///< Guarded by m_lock
+    OutputMatch m_match;                ///< Guarded by m_lock
+    wil::unique_event_nothrow m_done;
+};
+
+/// A session's pending waits (see file comment)
+class OutputWaits {
+public:
+    /// Start waiting for a query (any thread)
+    /// @return The wait, or nullptr if the query can't match
+    [[nodiscard]] std::shared_ptr<OutputWait> Add(const SearchQuery& query);
+
+    /// Check if any wait is pending (any thread)
+    [[nodiscard]] bool IsActive() const noexcept { return m_active.load(std::memory_order_acquire) != 0; }
+
+    /// Match a line leaving the screen (emulation side)
+    void ScanLine(uint64_t line, std::span<const Cell> cells);
+
+    /// Match the screen rows changed since the last scan (emulation side)
+    /// @param screenLine Absolute line of the top row
+    void ScanScreen(const TerminalBuffer& buffer, uint64_t screenLine);
+
+    /// Cancel every wait (the session is stopping, its emulation side done)
+    void CancelAll();
+
+private:
+    /// Take the waits added since the last scan and drop completed ones
+    void Collect();
+
+    /// Match a line's text with the waits, completing the ones it matches
+    /// @param newOnly Only the waits not matched against the whole screen yet
+    void Match(uint64_t line, bool newOnly);
+
+    std::vector<std::shared_ptr<OutputWait>> m_waits;   ///< Emulation side
+    std::vector<uint64_t> m_seen;           ///< Emulation side: row generations last scanned (sorted)
+    std::vector<uint64_t> m_generations;    ///< Emulation side: scratch
+    std::string m_text;                     ///< Emulation side: the line as UTF-8
+
+    std::mutex m_lock;
+    std::vector<std::shared_ptr<OutputWait>> m_added;   ///< Guarded by m_lock
+    std::atomic<size_t> m_active{0};        ///< Waits added and not yet dropped
+};
+
+} // namespace Console3::Core
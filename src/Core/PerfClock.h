@@ -0,0 +1,53 @@
+#pragma once
+// Console3 - PerfClock.h
+// Microsecond timestamps for telemetry counters
+//
+// QueryPerformanceCounter is cheap enough to call around every parse and
+// stall, and unlike GetTickCount64 it resolves sub-millisecond intervals.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+#include <atomic>
+#include <cstdint>
+
+namespace Console3::Core {
+
+/// Monotonic microsecond clock
+class PerfClock {
+public:
+    /// Get the current time in microseconds (arbitrary epoch)
+    [[nodiscard]] static uint64_t NowMicros() noexcept {
+        static const uint64_t frequency = QueryFrequency();
+
+        LARGE_INTEGER counter{};
+        QueryPerformanceCounter(&counter);
+        const auto ticks = static_cast<uint64_t>(counter.QuadPart);
+
+        // Split to avoid overflowing ticks * 1'000'000
+        return (ticks / frequency) * 1'000'000 + (ticks % frequency) * 1'000'000 / frequency;
+    }
+
+private:
+    static uint64_t QueryFrequency() noexcept {
+        LARGE_INTEGER frequency{};
+        QueryPerformanceFrequency(&frequency);
+        return frequency.QuadPart > 0 ? static_cast<uint64_t>(frequency.QuadPart) : 1;
+    }
+};
+
+/// Raise an atomic to at least the given value (lock-free max)
+template <typename T>
+inline void AtomicFetchMax(std::atomic<T>& target, T value) noexcept {
+    T current = target.load(std::memory_order_relaxed);
+    while (current < value &&
+           !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,87 @@
+// Console3 - PipeListener.cpp
+// Server end of a named pipe: its access list, instances and accept loop
+
+#include "Core/PipeListener.h"
+#include <sddl.h>
+#include <vector>
+
+namespace Console3::Core {
+
+bool PipeListener::Listen(const std::wstring& path, std::wstring_view extraAces, bool allowRemote) {
+    m_path = path;
+    m_pipeMode = PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT |
+                 (allowRemote ? PIPE_ACCEPT_REMOTE_CLIENTS : PIPE_REJECT_REMOTE_CLIENTS);
+    if (!m_connected && !m_connected.try_create(wil::EventOptions::ManualReset, nullptr)) {
+        return false;
+    }
+    if (!CreateSecurity(extraAces)) {
+        return false;
+    }
+    m_pending = CreateInstance(true);
+    return static_cast<bool>(m_pending);
+}
+
+wil::unique_hfile PipeListener::Accept(HANDLE stop, const IdleCallback& idle) {
+    while (m_pending) {
+        OVERLAPPED overlapped = {};
+        overlapped.hEvent = m_connected.get();
+        ResetEvent(m_connected.get());
+        DWORD error = ConnectNamedPipe(m_pending.get(), &overlapped) ? ERROR_PIPE_CONNECTED : GetLastError();
+        while (error == ERROR_IO_PENDING) {
+            const DWORD timeout = idle ? idle() : INFINITE;
+            const HANDLE waits[] = {m_connected.get(), stop};
+            const DWORD wait = WaitForMultipleObjects(ARRAYSIZE(waits), waits, FALSE, timeout);
+            if (wait == WAIT_TIMEOUT) {
+                continue;
+            }
+            if (wait != WAIT_OBJECT_0) {
+                CancelIoEx(m_pending.get(), &overlapped);
+                DWORD bytes = 0;
+                (void)GetOverlappedResult(m_pending.get(), &overlapped, &bytes, TRUE);
+                return {};
+            }
+            DWORD bytes = 0;
+            error = GetOverlappedResult(m_pending.get(), &overlapped, &bytes, FALSE) ? ERROR_PIPE_CONNECTED
+                                                                                      : GetLastError();
+        }
+
+        // The next client waits on a new instance while this one is served
+        wil::unique_hfile pipe = std::move(m_pending);
+        m_pending = CreateInstance(false);
+        if (error == ERROR_PIPE_CONNECTED) {
+            return pipe;
+        }
+    }
+    return {};
+}
+
+bool PipeListener::CreateSecurity(std::wstring_view extraAces) {
+    wil::unique_handle token;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, token.put())) {
+        return false;
+    }
+    DWORD size = 0;
+    (void)GetTokenInformation(token.get(), TokenUser, nullptr, 0, &size);
+    std::vector<BYTE> user(size);
+    if (size == 0 || !GetTokenInformation(token.get(), TokenUser, user.data(), size, &size)) {
+        return false;
+    }
+    wil::unique_hlocal_string sid;
+    if (!ConvertSidToStringSidW(reinterpret_cast<const TOKEN_USER*>(user.data())->User.Sid, sid.put())) {
+        return false;
+    }
+
+    // Protected DACL: full access for the user, nothing inherited
+    const std::wstring sddl = std::wstring(L"D:P(A;;GA;;;") + sid.get() + L")" + std::wstring(extraAces);
+    return ConvertStringSecurityDescriptorToSecurityDescriptorW(sddl.c_str(), SDDL_REVISION_1,
+                                                                m_security.put(), nullptr) != FALSE;
+}
+
+wil::unique_hfile PipeListener::CreateInstance(bool first) const {
+    SECURITY_ATTRIBUTES attributes = {sizeof(attributes), m_security.get(), FALSE};
+    const DWORD openMode = PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0);
+    return wil::unique_hfile(CreateNamedPipeW(m_path.c_str(), openMode, m_pipeMode, PIPE_UNLIMITED_INSTANCES,
+                                              kBufferBytes, kBufferBytes, 0, &attributes));
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,73 @@
+#pragma once
+// Console3 - PipeListener.h
+// Server end of a named pipe: its access list, instances and accept loop
+//
+// The session host and the telemetry endpoint both serve clients on a
+// named pipe the same way. The pipe's DACL is protected and gives the
+// user running the process full access; a server may add ACEs for others
+// (SDDL strings). Listen() claims the name with the first instance, so a
+// second server on the same name fails rather than sharing it. Accept()
+// waits for a client on the pending instance, overlapped so a stop event
+// ends the wait, and creates the next instance before handing the
+// connected one over: closing it without disconnecting lets the client
+// still read what was written.
+
+#include <Windows.h>
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include <wil/resource.h>
+
+namespace Console3::Core {
+
+/// Accepts clients on a named pipe (see file comment)
+class PipeListener {
+public:
+    /// In and out buffer size of each instance
+    static constexpr DWORD kBufferBytes = 64 * 1024;
+
+    /// Called before each wait for a client: does what is due and returns
+    /// how long the wait may last (ms, INFINITE for no limit)
+    using IdleCallback = std::function<DWORD()>;
+
+    PipeListener() = default;
+
+    PipeListener(const PipeListener&) = delete;
+    PipeListener& operator=(const PipeListener&) = delete;
+
+    /// Claim the name with the pipe's first instance
+    /// @param path Pipe path (\\.\pipe\...)
+    /// @param extraAces SDDL ACEs granted besides the current user's full access
+    /// @param allowRemote Accept clients on other machines
+    /// @return false if the security or the instance can't be created (the
+    ///         name taken included)
+    [[nodiscard]] bool Listen(const std::wstring& path, std::wstring_view extraAces = {}, bool allowRemote = false);
+
+    /// Wait for the next client (one thread at a time)
+    /// @param stop Manual-reset event that ends the wait
+    /// @param idle Called before each wait (see IdleCallback); none waits without limit
+    /// @return The connected instance, or none once stop is set or no
+    ///         instance can be created
+    [[nodiscard]] wil::unique_hfile Accept(HANDLE stop, const IdleCallback& idle = nullptr);
+
+    /// Close the pending instance, releasing the name
+    void Close() noexcept { m_pending.reset(); }
+
+    [[nodiscard]] const std::wstring& GetPath() const noexcept { return m_path; }
+
+private:
+    /// Build the protected DACL (see file comment)
+    [[nodiscard]] bool CreateSecurity(std::wstring_view extraAces);
+
+    /// Create an instance (the first claims the name)
+    [[nodiscard]] wil::unique_hfile CreateInstance(bool first) const;
+
+    std::wstring m_path;
+    DWORD m_pipeMode = 0;
+    wil::unique_hlocal_security_descriptor m_security;
+    wil::unique_hfile m_pending;        ///< Waits for the next client
+    wil::unique_event m_connected;      ///< Manual reset, ConnectNamedPipe's
+};
+
+} // namespace Console3::Core
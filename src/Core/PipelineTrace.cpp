@@ -0,0 +1,105 @@
+// Console3 - PipelineTrace.cpp
+// ETW activities for the stages of the output pipeline
+
+#include "Core/PipelineTrace.h"
+#include <wil/Tracelogging.h>
+#include <atomic>
+
+namespace Console3::Core {
+
+namespace {
+
+/// TraceLogging provider "Console3.Pipeline"
+class PipelineTraceProvider final : public wil::TraceLoggingProvider {
+    // 991b1a34-e906-586e-bec9-6a5420da0be5
+    IMPLEMENT_TRACELOGGING_CLASS_WITHOUT_TELEMETRY(
+        PipelineTraceProvider, "Console3.Pipeline",
+        (0x991b1a34, 0xe906, 0x586e, 0xbe, 0xc9, 0x6a, 0x54, 0x20, 0xda, 0x0b, 0xe5));
+};
+
+std::atomic<uint32_t> g_nextSessionId{1};
+
+// Event names must be string literals, so each stage gets its own write
+#define CONSOLE3_WRITE_STAGE(stage, activityId, ...)                                          \
+    switch (stage) {                                                                          \
+    case PipelineStage::PtyRead:                                                              \
+        TraceLoggingWriteActivity(PipelineTraceProvider::Provider(), "PtyRead", activityId,   \
+                                  nullptr, __VA_ARGS__);                                      \
+        break;                                                                                \
+    case PipelineStage::RingWrite:                                                            \
+        TraceLoggingWriteActivity(PipelineTraceProvider::Provider(), "RingWrite", activityId, \
+                                  nullptr, __VA_ARGS__);                                      \
+        break;                                                                                \
+    case PipelineStage::ProcessOutput:                                                        \
+        TraceLoggingWriteActivity(PipelineTraceProvider::Provider(), "ProcessOutput",         \
+                                  activityId, nullptr, __VA_ARGS__);                          \
+        break;                                                                                \
+    case PipelineStage::Parse:                                                                \
+        TraceLoggingWriteActivity(PipelineTraceProvider::Provider(), "Parse", activityId,     \
+                                  nullptr, __VA_ARGS__);                                      \
+        break;                                                                                \
+    case PipelineStage::DamageSync:                                                           \
+        TraceLoggingWriteActivity(PipelineTraceProvider::Provider(), "DamageSync",            \
+                                  activityId, nullptr, __VA_ARGS__);                          \
+        break;                                                                                \
+    case PipelineStage::Render:                                                               \
+        TraceLoggingWriteActivity(PipelineTraceProvider::Provider(), "Render", activityId,    \
+                                  nullptr, __VA_ARGS__);                                      \
+        break;                                                                                \
+    case PipelineStage::Present:                                                              \
+        TraceLoggingWriteActivity(PipelineTraceProvider::Provider(), "Present", activityId,   \
+                                  nullptr, __VA_ARGS__);                                      \
+        break;                                                                                \
+    }
+
+} // namespace
+
+uint32_t PipelineTrace::NewSessionId() noexcept {
+    return g_nextSessionId.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool PipelineTrace::IsEnabled() noexcept {
+    return PipelineTraceProvider::IsEnabled(WINEVENT_LEVEL_VERBOSE);
+}
+
+void PipelineTrace::WriteStartupPhase(const wchar_t* phase, uint64_t micros) noexcept {
+    TraceLoggingWrite(PipelineTraceProvider::Provider(), "StartupPhase",
+                      TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+                      TraceLoggingWideString(phase, "Phase"),
+                      TraceLoggingUInt64(micros, "Micros"));
+}
+
+PipelineActivity::PipelineActivity(PipelineStage stage, uint32_t sessionId) noexcept
+    : m_sessionId(sessionId), m_stage(stage) {
+    if (!PipelineTrace::IsEnabled()) {
+        return;
+    }
+    if (EventActivityIdControl(EVENT_ACTIVITY_CTRL_CREATE_ID, &m_activityId) != ERROR_SUCCESS) {
+        return;
+    }
+
+    m_active = true;
+    CONSOLE3_WRITE_STAGE(m_stage, &m_activityId,
+                         TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE),
+                         TraceLoggingOpcode(WINEVENT_OPCODE_START),
+                         TraceLoggingUInt32(m_sessionId, "SessionId"));
+}
+
+PipelineActivity::~PipelineActivity() {
+    // Written even if the listener went away in between, so no start is
+    // left without its stop
+    if (!m_active) {
+        return;
+    }
+
+    CONSOLE3_WRITE_STAGE(m_stage, &m_activityId,
+                         TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE),
+                         TraceLoggingOpcode(WINEVENT_OPCODE_STOP),
+                         TraceLoggingUInt32(m_sessionId, "SessionId"),
+                         TraceLoggingUInt64(m_bytes, "Bytes"),
+                         TraceLoggingUInt32(m_rows, "Rows"));
+}
+
+#undef CONSOLE3_WRITE_STAGE
+
+} // namespace Console3::Core
@@ -0,0 +1,87 @@
+#pragma once
+// Console3 - PipelineTrace.h
+// ETW activities for the stages of the output pipeline
+//
+// The TraceLogging provider "Console3.Pipeline" (GUID
+// 991b1a34-e906-586e-bec9-6a5420da0be5) brackets each stage output passes
+// through with a start and a stop event sharing an activity ID: the PTY
+// read, the write into the output ring, a ProcessOutput batch, each libvterm
+// parse, each damage sync into the terminal buffer, rendering a frame and
+// presenting it. Every event carries the session's trace ID; stop events
+// add the bytes and rows the stage handled. Startup milestones are single
+// "StartupPhase" events on the same provider. Recorded with WPR next to the
+// kernel and GPU providers, WPA lines stalls up with what the rest of the
+// machine was doing - on a release build, nothing to install.
+//
+// With no trace session listening an activity costs the provider's enabled
+// check. The completion port engine reads overlapped, so there the read
+// activity covers handing the completed read over rather than the wait.
+
+// Target Windows 10 RS5 (1809) or later
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+#include <cstdint>
+
+namespace Console3::Core {
+
+/// Stage of the output pipeline
+enum class PipelineStage : uint8_t {
+    PtyRead,        ///< Reading from the pseudo console pipe
+    RingWrite,      ///< Publishing read bytes into the output ring
+    ProcessOutput,  ///< One batch of draining the ring into the emulator
+    Parse,          ///< One libvterm input write
+    DamageSync,     ///< Copying a damaged region into the terminal buffer
+    Render,         ///< Painting a frame
+    Present         ///< Presenting the painted frame
+};
+
+/// Process-wide pipeline tracing
+class PipelineTrace {
+public:
+    /// Get a new process-unique session trace ID (never 0)
+    [[nodiscard]] static uint32_t NewSessionId() noexcept;
+
+    /// Check if a trace session is listening to the provider
+    [[nodiscard]] static bool IsEnabled() noexcept;
+
+    /// Write a startup milestone (see Core/StartupTrace.h)
+    /// @param micros Time since the process was created
+    static void WriteStartupPhase(const wchar_t* phase, uint64_t micros) noexcept;
+};
+
+/// One stage's start and stop events, written on construction and
+/// destruction (see file comment)
+class PipelineActivity {
+public:
+    /// @param sessionId Session trace ID (0 if none)
+    PipelineActivity(PipelineStage stage, uint32_t sessionId) noexcept;
+    ~PipelineActivity();
+
+    PipelineActivity(const PipelineActivity&) = delete;
+    PipelineActivity& operator=(const PipelineActivity&) = delete;
+
+    /// Set the bytes the stop event reports
+    void SetBytes(uint64_t bytes) noexcept { m_bytes = bytes; }
+
+    /// Add to the bytes the stop event reports
+    void AddBytes(uint64_t bytes) noexcept { m_bytes += bytes; }
+
+    /// Set the rows the stop event reports
+    void SetRows(uint32_t rows) noexcept { m_rows = rows; }
+
+private:
+    GUID m_activityId{};
+    uint64_t m_bytes = 0;
+    uint32_t m_rows = 0;
+    uint32_t m_sessionId = 0;
+    PipelineStage m_stage;
+    bool m_active = false;     ///< Start was written; so is stop
+};
+
+} // namespace Console3::Core
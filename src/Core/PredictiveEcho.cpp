@@ -0,0 +1,128 @@
+// Console3 - PredictiveEcho.cpp
+// Local echo of typed text ahead of a slow shell's own
+
+#include "Core/PredictiveEcho.h"
+#include "Core/TerminalBuffer.h"
+#include <algorithm>
+
+namespace Console3::Core {
+
+namespace {
+
+/// Codepoints predicted: one column wide for certain (below the CJK and
+/// emoji ranges), and not C1 controls
+[[nodiscard]] bool IsPredictable(uint32_t codepoint) noexcept {
+    return codepoint >= 0x20 && codepoint < 0x1100 && !(codepoint >= 0x7F && codepoint < 0xA0);
+}
+
+} // namespace
+
+void PredictiveEcho::SetEnabled(bool enabled) noexcept {
+    m_enabled = enabled;
+    if (!enabled) {
+        m_pending.clear();
+        m_trusted = false;
+    }
+}
+
+void PredictiveEcho::OnTyped(uint32_t codepoint, int cursorRow, int cursorCol, int cols, uint64_t nowMicros) {
+    if (!m_enabled || m_alternate || m_pending.size() >= kMaxPending) {
+        return;
+    }
+    const int row = m_pending.empty() ? cursorRow : m_cursorRow;
+    const int col = m_pending.empty() ? cursorCol : m_cursorCol;
+    if (!IsPredictable(codepoint) || col + 1 >= cols) {
+        OnOtherInput();
+        return;
+    }
+    Predict(row, col, codepoint, nowMicros);
+    m_cursorRow = row;
+    m_cursorCol = col + 1;
+}
+
+void PredictiveEcho::OnBackspace(int cursorRow, int cursorCol, uint64_t nowMicros) {
+    if (!m_enabled || m_alternate || m_pending.size() >= kMaxPending) {
+        return;
+    }
+    const int row = m_pending.empty() ? cursorRow : m_cursorRow;
+    const int col = m_pending.empty() ? cursorCol : m_cursorCol;
+    if (col == 0) {
+        OnOtherInput();     // Wrapping back is the line editor's business
+        return;
+    }
+    Predict(row, col - 1, U' ', nowMicros);
+    m_cursorRow = row;
+    m_cursorCol = col - 1;
+}
+
+void PredictiveEcho::OnOtherInput() noexcept {
+    m_pending.clear();
+    m_trusted = false;
+}
+
+bool PredictiveEcho::Reconcile(const TerminalBuffer& buffer, int cursorRow, int cursorCol, uint64_t nowMicros) {
+    const bool wasShown = IsShown();
+    const size_t wasPending = m_pending.size();
+
+    m_alternate = buffer.IsAlternateScreen();
+    if (m_alternate) {
+        OnOtherInput();
+    }
+
+    // The echo comes in the order the keys went out, so the oldest
+    // prediction is judged first and the rest wait behind it
+    size_t judged = 0;
+    for (; judged < m_pending.size(); ++judged) {
+        const PredictedCell& cell = m_pending[judged];
+        if (cell.row >= buffer.GetRows() || cell.col >= buffer.GetCols() || cursorRow != cell.row) {
+            Refute();       // Output moved the line, or the shell went elsewhere
+            return wasShown || wasPending != 0;
+        }
+
+        if (buffer.GetCell(cell.row, cell.col).Codepoint() == cell.codepoint) {
+            ++m_confirmed;
+            m_trusted = true;
+            // An erase may "confirm" on a blank that was already there
+            if (cell.codepoint != U' ' && nowMicros > cell.typedMicros) {
+                const uint64_t sample = nowMicros - cell.typedMicros;
+                m_echoMicros = m_echoMicros ? (m_echoMicros * 7 + sample) / 8 : sample;
+            }
+            continue;
+        }
+
+        // A typed character's echo moves the cursor past its cell
+        const bool passed = cell.codepoint != U' ' && cursorCol > cell.col;
+        if (passed || nowMicros - cell.typedMicros > kJudgeTimeoutMicros) {
+            Refute();
+            return wasShown || wasPending != 0;
+        }
+        break;
+    }
+    m_pending.erase(m_pending.begin(), m_pending.begin() + static_cast<ptrdiff_t>(judged));
+
+    return wasShown != IsShown() || (wasShown && judged != 0);
+}
+
+bool PredictiveEcho::IsShown() const noexcept {
+    return m_enabled && !m_alternate && m_trusted && m_echoMicros >= kShowAboveMicros && !m_pending.empty();
+}
+
+std::optional<std::pair<int, int>> PredictiveEcho::GetCursor() const noexcept {
+    if (!IsShown()) {
+        return std::nullopt;
+    }
+    return std::pair(m_cursorRow, m_cursorCol);
+}
+
+void PredictiveEcho::Predict(int row, int col, uint32_t codepoint, uint64_t nowMicros) {
+    std::erase_if(m_pending, [row, col](const PredictedCell& cell) { return cell.row == row && cell.col == col; });
+    m_pending.push_back(PredictedCell{row, col, codepoint, nowMicros});
+}
+
+void PredictiveEcho::Refute() noexcept {
+    m_pending.clear();
+    m_trusted = false;
+    ++m_refuted;
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,105 @@
+#pragma once
+// Console3 - PredictiveEcho.h
+// Local echo of typed text ahead of a slow shell's own
+//
+// Over a high-latency link (ssh to a far host) every keystroke shows only
+// after a round trip. With predictions on, the view draws what a printable
+// key or Backspace will most likely do to the line being edited the moment
+// it is typed, and the shell's echo replaces the guess when it arrives.
+//
+// Each prediction is a cell (what the key should leave there) and is judged
+// against the buffer after every update: the cell showing the predicted
+// character confirms it, the shell's cursor moving past it without it there
+// (or no echo within kJudgeTimeoutMicros) refutes it, and a refutation drops
+// every prediction. Predictions are made all the time but only shown when
+// they have earned it: the echo round trip is slower than kShowAboveMicros,
+// a prediction made since the last Enter or other non-text key (an "epoch")
+// has been confirmed, and none was refuted since. A password prompt never
+// echoes, so its keys are never shown; nothing is predicted on the
+// alternate screen, where full-screen programs draw keys however they like.
+//
+// The model is driven on the UI thread; TerminalView draws the predictions
+// as an overlay and never writes them into the buffer.
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace Console3::Core {
+
+class TerminalBuffer;
+
+/// A cell a key is predicted to leave
+struct PredictedCell {
+    int row = 0;
+    int col = 0;
+    uint32_t codepoint = U' ';      ///< U' ' for a Backspace's erase
+    uint64_t typedMicros = 0;       ///< PerfClock time of the key
+};
+
+/// Predicts the echo of typed text and checks the guesses against the buffer
+class PredictiveEcho {
+public:
+    static constexpr uint64_t kShowAboveMicros = 30'000;      ///< Echo round trip worth predicting over
+    static constexpr uint64_t kJudgeTimeoutMicros = 1'000'000; ///< No echo this long refutes a prediction
+    static constexpr size_t kMaxPending = 256;                 ///< Keys typed ahead of the echo
+
+    /// Turn predictions on or off (off drops any pending)
+    void SetEnabled(bool enabled) noexcept;
+
+    [[nodiscard]] bool IsEnabled() const noexcept { return m_enabled; }
+
+    /// A printable character was typed at the shell's cursor
+    /// Wide characters, and a line about to wrap, end the epoch instead.
+    void OnTyped(uint32_t codepoint, int cursorRow, int cursorCol, int cols, uint64_t nowMicros);
+
+    /// Backspace was typed
+    void OnBackspace(int cursorRow, int cursorCol, uint64_t nowMicros);
+
+    /// Any other input went out (Enter, Tab, cursor keys, a paste): what it
+    /// does is the application's choice, so the epoch ends
+    void OnOtherInput() noexcept;
+
+    /// Check the predictions against the buffer after it changed
+    /// @return true if what is shown changed (repaint)
+    bool Reconcile(const TerminalBuffer& buffer, int cursorRow, int cursorCol, uint64_t nowMicros);
+
+    /// Check if the predictions are to be drawn
+    [[nodiscard]] bool IsShown() const noexcept;
+
+    /// Check if any prediction awaits its echo
+    [[nodiscard]] bool HasPending() const noexcept { return !m_pending.empty(); }
+
+    /// Get the predictions awaiting their echo, oldest first
+    [[nodiscard]] const std::vector<PredictedCell>& GetPending() const noexcept { return m_pending; }
+
+    /// Get where the cursor should be drawn while predictions are shown
+    [[nodiscard]] std::optional<std::pair<int, int>> GetCursor() const noexcept;
+
+    /// Get the smoothed echo round trip (microseconds, 0 = not measured)
+    [[nodiscard]] uint64_t GetEchoMicros() const noexcept { return m_echoMicros; }
+
+    [[nodiscard]] uint64_t GetConfirmed() const noexcept { return m_confirmed; }
+    [[nodiscard]] uint64_t GetRefuted() const noexcept { return m_refuted; }
+
+private:
+    /// Add a prediction, replacing an older one for the same cell
+    void Predict(int row, int col, uint32_t codepoint, uint64_t nowMicros);
+
+    /// Drop every prediction; the epoch loses its confirmation
+    void Refute() noexcept;
+
+    std::vector<PredictedCell> m_pending;
+    int m_cursorRow = 0;            ///< Cursor after the newest prediction
+    int m_cursorCol = 0;
+    bool m_enabled = false;
+    bool m_alternate = false;       ///< Buffer on the alternate screen at the last check
+    bool m_trusted = false;         ///< A prediction in this epoch was confirmed
+    uint64_t m_echoMicros = 0;
+    uint64_t m_confirmed = 0;
+    uint64_t m_refuted = 0;
+};
+
+} // namespace Console3::Core
@@ -0,0 +1,84 @@
+// Console3 - ProcessJob.cpp
+// A session's process tree in a job object: its CPU share and accounting
+
+#include "Core/ProcessJob.h"
+
+namespace Console3::Core {
+
+bool ProcessJob::Create() {
+    m_job.reset(CreateJobObjectW(nullptr, nullptr));
+    return static_cast<bool>(m_job);
+}
+
+bool ProcessJob::SetPriority(SessionPriority priority) {
+    if (!m_job) {
+        return false;
+    }
+
+    bool applied = true;
+    if (priority == SessionPriority::Background) {
+        applied &= SetPriorityClass(BELOW_NORMAL_PRIORITY_CLASS);
+        applied &= SetCpuWeight(kBackgroundWeight);
+    } else {
+        // Back to normal, then free to change again
+        if (m_priority == SessionPriority::Background) {
+            applied &= SetPriorityClass(NORMAL_PRIORITY_CLASS);
+            applied &= SetPriorityClass(0);
+        }
+        applied &= SetCpuWeight(priority == SessionPriority::Focused ? kFocusedWeight : kVisibleWeight);
+    }
+    m_priority = priority;
+    return applied;
+}
+
+JobAccounting ProcessJob::GetAccounting() const noexcept {
+    JobAccounting accounting;
+    if (!m_job) {
+        return accounting;
+    }
+
+    JOBOBJECT_BASIC_AND_IO_ACCOUNTING_INFORMATION usage{};
+    if (QueryInformationJobObject(m_job.get(), JobObjectBasicAndIoAccountingInformation, &usage,
+                                  sizeof(usage), nullptr)) {
+        // 100 ns units
+        accounting.cpuMicros = static_cast<uint64_t>(usage.BasicInfo.TotalUserTime.QuadPart +
+                                                     usage.BasicInfo.TotalKernelTime.QuadPart) / 10;
+        accounting.activeProcesses = usage.BasicInfo.ActiveProcesses;
+        accounting.totalProcesses = usage.BasicInfo.TotalProcesses;
+        accounting.readBytes = usage.IoInfo.ReadTransferCount;
+        accounting.writeBytes = usage.IoInfo.WriteTransferCount;
+    }
+
+    JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits{};
+    if (QueryInformationJobObject(m_job.get(), JobObjectExtendedLimitInformation, &limits,
+                                  sizeof(limits), nullptr)) {
+        accounting.peakMemory = limits.PeakJobMemoryUsed;
+    }
+    return accounting;
+}
+
+bool ProcessJob::SetPriorityClass(DWORD priorityClass) {
+    JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits{};
+    if (!QueryInformationJobObject(m_job.get(), JobObjectExtendedLimitInformation, &limits,
+                                   sizeof(limits), nullptr)) {
+        return false;
+    }
+    if (priorityClass != 0) {
+        limits.BasicLimitInformation.LimitFlags |= JOB_OBJECT_LIMIT_PRIORITY_CLASS;
+        limits.BasicLimitInformation.PriorityClass = priorityClass;
+    } else {
+        limits.BasicLimitInformation.LimitFlags &= ~JOB_OBJECT_LIMIT_PRIORITY_CLASS;
+    }
+    return SetInformationJobObject(m_job.get(), JobObjectExtendedLimitInformation, &limits,
+                                   sizeof(limits)) != FALSE;
+}
+
+bool ProcessJob::SetCpuWeight(DWORD weight) {
+    JOBOBJECT_CPU_RATE_CONTROL_INFORMATION rate{};
+    rate.ControlFlags = JOB_OBJECT_CPU_RATE_CONTROL_ENABLE | JOB_OBJECT_CPU_RATE_CONTROL_WEIGHT_BASED;
+    rate.Weight = weight;
+    return SetInformationJobObject(m_job.get(), JobObjectCpuRateControlInformation, &rate,
+                                   sizeof(rate)) != FALSE;
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,95 @@
+#pragma once
+// Console3 - ProcessJob.h
+// A session's process tree in a job object: its CPU share and accounting
+//
+// Every tab's shell, and whatever the shell starts, runs in a job of its
+// own (the shell is created in it, so no child can start before it is
+// assigned). The job is how a hidden tab's build stops competing with the
+// tab being typed in: SetPriority() gives a background job a lower
+// priority class and the smallest CPU weight, and a shown one its normal
+// class and weight back. Processes keep their own class while the job
+// leaves it alone, so a restored job sets the normal class once and then
+// lifts the limit again.
+//
+// Windows offers no I/O priority for a job, nor a documented way to set
+// another process's; the priority class is what a job can lower, and the
+// scheduler's weights decide between busy tabs.
+//
+// The job also counts what its processes use, whenever they exited:
+// CPU time, I/O and peak committed memory, per tab for nothing.
+//
+// Nothing is limited otherwise. Closing the job does not end its
+// processes: a window a shell opened outlives the tab, as it always did.
+
+// Target Windows 10 RS5 (1809) or later for ConPTY APIs
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+#include <cstdint>
+
+#include <wil/resource.h>
+
+#include "Core/SessionScheduler.h"
+
+namespace Console3::Core {
+
+/// What a job's processes have used (all of them, exited ones too)
+struct JobAccounting {
+    uint64_t cpuMicros = 0;         ///< User and kernel time
+    uint32_t activeProcesses = 0;   ///< Running now
+    uint32_t totalProcesses = 0;    ///< Ever started in the job
+    uint64_t readBytes = 0;         ///< I/O read transfers
+    uint64_t writeBytes = 0;        ///< I/O write transfers
+    size_t peakMemory = 0;          ///< Most memory committed by the job at once
+};
+
+/// Job object holding one session's processes (see file comment)
+class ProcessJob {
+public:
+    /// CPU weights (1-9, 5 = as if not weighted) by session priority
+    static constexpr DWORD kFocusedWeight = 9;
+    static constexpr DWORD kVisibleWeight = 5;
+    static constexpr DWORD kBackgroundWeight = 1;
+
+    ProcessJob() = default;
+
+    ProcessJob(const ProcessJob&) = delete;
+    ProcessJob& operator=(const ProcessJob&) = delete;
+    ProcessJob(ProcessJob&&) noexcept = default;
+    ProcessJob& operator=(ProcessJob&&) noexcept = default;
+
+    /// Create the job
+    /// @return false if it could not be (processes then run outside one)
+    [[nodiscard]] bool Create();
+
+    /// Get the job handle (null without one)
+    [[nodiscard]] HANDLE Get() const noexcept { return m_job.get(); }
+
+    /// Set the CPU priority of the job's processes, present and future
+    /// @return false without a job, or if Windows refused
+    bool SetPriority(SessionPriority priority);
+
+    /// Get the priority last set
+    [[nodiscard]] SessionPriority GetPriority() const noexcept { return m_priority; }
+
+    /// Get what the processes have used so far
+    [[nodiscard]] JobAccounting GetAccounting() const noexcept;
+
+private:
+    /// Apply or lift the priority class limit
+    /// @param priorityClass Class to hold the processes at (0 = lift)
+    bool SetPriorityClass(DWORD priorityClass);
+
+    /// Set the job's CPU weight
+    bool SetCpuWeight(DWORD weight);
+
+    wil::unique_handle m_job;
+    SessionPriority m_priority = SessionPriority::Visible;
+};
+
+} // namespace Console3::Core
@@ -0,0 +1,88 @@
+// Console3 - PseudoConsole.cpp
+// The pseudo console implementation a session runs on
+
+#include "Core/PseudoConsole.h"
+
+namespace Console3::Core {
+
+namespace {
+
+// Flags of the side-by-side conpty.dll (Windows Terminal's names); the
+// in-box API takes none of them
+constexpr DWORD kResizeQuirk = 0x2;         ///< PSEUDOCONSOLE_RESIZE_QUIRK: no repaint on resize
+constexpr DWORD kPassthroughMode = 0x8;     ///< PSEUDOCONSOLE_PASSTHROUGH_MODE: VT output as written
+
+/// Load conpty.dll from the executable's directory only: a DLL of that name
+/// anywhere else on the search path is not ours to run
+PseudoConsoleApi LoadSideBySide() noexcept {
+    PseudoConsoleApi api;
+    HMODULE module = LoadLibraryExW(L"conpty.dll", nullptr, LOAD_LIBRARY_SEARCH_APPLICATION_DIR);
+    if (!module) {
+        return api;
+    }
+
+    api.create = reinterpret_cast<PseudoConsoleApi::CreateFn>(GetProcAddress(module, "ConptyCreatePseudoConsole"));
+    api.resize = reinterpret_cast<PseudoConsoleApi::ResizeFn>(GetProcAddress(module, "ConptyResizePseudoConsole"));
+    api.close = reinterpret_cast<PseudoConsoleApi::CloseFn>(GetProcAddress(module, "ConptyClosePseudoConsole"));
+    api.sideBySide = true;
+    if (!api.create || !api.resize || !api.close) {
+        FreeLibrary(module);
+        return PseudoConsoleApi{};
+    }
+
+    // Kept loaded for the life of the process; consoles may outlive any
+    // one session's references to it
+    return api;
+}
+
+} // namespace
+
+const wchar_t* GetPseudoConsoleName(PseudoConsoleKind kind) noexcept {
+    switch (kind) {
+    case PseudoConsoleKind::InBox: return L"in-box";
+    case PseudoConsoleKind::SideBySide: return L"side-by-side";
+    case PseudoConsoleKind::Passthrough: return L"passthrough";
+    case PseudoConsoleKind::WslRelay: return L"wsl-relay";
+    case PseudoConsoleKind::Serial: return L"serial";
+    case PseudoConsoleKind::None: break;
+    }
+    return L"none";
+}
+
+const PseudoConsoleApi& PseudoConsoleApi::InBox() noexcept {
+    static const PseudoConsoleApi api{&CreatePseudoConsole, &ResizePseudoConsole, &ClosePseudoConsole, false};
+    return api;
+}
+
+const PseudoConsoleApi* PseudoConsoleApi::SideBySide() noexcept {
+    static const PseudoConsoleApi api = LoadSideBySide();
+    return api.create ? &api : nullptr;
+}
+
+HRESULT CreateBestPseudoConsole(COORD size, HANDLE input, HANDLE output, bool allowSideBySide, HPCON& console,
+                                const PseudoConsoleApi*& api, PseudoConsoleKind& kind) {
+    console = nullptr;
+    if (const PseudoConsoleApi* sideBySide = allowSideBySide ? PseudoConsoleApi::SideBySide() : nullptr) {
+        // Builds from before passthrough reject the flag
+        if (SUCCEEDED(sideBySide->create(size, input, output, kResizeQuirk | kPassthroughMode, &console))) {
+            api = sideBySide;
+            kind = PseudoConsoleKind::Passthrough;
+            return S_OK;
+        }
+        if (SUCCEEDED(sideBySide->create(size, input, output, kResizeQuirk, &console))) {
+            api = sideBySide;
+            kind = PseudoConsoleKind::SideBySide;
+            return S_OK;
+        }
+    }
+
+    const PseudoConsoleApi& inBox = PseudoConsoleApi::InBox();
+    const HRESULT hr = inBox.create(size, input, output, 0, &console);
+    if (SUCCEEDED(hr)) {
+        api = &inBox;
+        kind = PseudoConsoleKind::InBox;
+    }
+    return hr;
+}
+
+} // namespace Console3::Core
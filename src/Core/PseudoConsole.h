@@ -0,0 +1,70 @@
+#pragma once
+// Console3 - PseudoConsole.h
+// The pseudo console implementation a session runs on
+//
+// The in-box pseudo console (kernel32's CreatePseudoConsole) runs every
+// byte the shell writes through conhost's own screen buffer and serializes
+// that buffer back to VT, so output is emulated twice and a resize repaints
+// the whole screen. A newer conpty.dll shipped next to Console3.exe (with
+// the OpenConsole.exe it starts) is preferred when present: it is asked not
+// to repaint on resize, and to pass the shell's VT output through instead
+// of re-rendering it. The in-box API is the fallback when there is no such
+// DLL, or it can't create a console.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+#include <cstdint>
+
+namespace Console3::Core {
+
+/// Which pseudo console a session got
+enum class PseudoConsoleKind : uint8_t {
+    None,           ///< No pseudo console (not started, or a replay)
+    InBox,          ///< kernel32's, through conhost
+    SideBySide,     ///< conpty.dll next to the executable, re-rendering
+    Passthrough,    ///< conpty.dll next to the executable, passing VT through
+    WslRelay,       ///< No pseudo console: a Linux pty behind console3-relay (WslRelay.h)
+    Serial,         ///< No pseudo console: a serial port (SerialPort.h)
+};
+
+/// Get a short name for diagnostics ("in-box", "side-by-side", "passthrough", "wsl-relay",
+/// "serial")
+[[nodiscard]] const wchar_t* GetPseudoConsoleName(PseudoConsoleKind kind) noexcept;
+
+/// Entry points of one pseudo console implementation
+struct PseudoConsoleApi {
+    using CreateFn = HRESULT(WINAPI*)(COORD size, HANDLE input, HANDLE output, DWORD flags, HPCON* console);
+    using ResizeFn = HRESULT(WINAPI*)(HPCON console, COORD size);
+    using CloseFn = void(WINAPI*)(HPCON console);
+
+    CreateFn create = nullptr;
+    ResizeFn resize = nullptr;
+    CloseFn close = nullptr;
+    bool sideBySide = false;
+
+    /// Get kernel32's
+    [[nodiscard]] static const PseudoConsoleApi& InBox() noexcept;
+
+    /// Get the conpty.dll next to the executable's, loaded on first use
+    /// @return nullptr if there is none, or it lacks an entry point
+    [[nodiscard]] static const PseudoConsoleApi* SideBySide() noexcept;
+};
+
+/// Create a pseudo console on the best implementation available
+/// The side-by-side DLL is tried first (if allowed), with passthrough and
+/// then without; the in-box API is the last resort.
+/// @param allowSideBySide Consider conpty.dll at all
+/// @param[out] console The new console
+/// @param[out] api Its implementation (resize and close it through this)
+/// @param[out] kind Which one it is
+/// @return The in-box API's result if every attempt failed
+HRESULT CreateBestPseudoConsole(COORD size, HANDLE input, HANDLE output, bool allowSideBySide, HPCON& console,
+                                const PseudoConsoleApi*& api, PseudoConsoleKind& kind);
+
+} // namespace Console3::Core
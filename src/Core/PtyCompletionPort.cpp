@@ -0,0 +1,347 @@
+// Console3 - PtyCompletionPort.cpp
+// Shared I/O completion port and overlapped pipe reader implementation
+
+#include "Core/PtyCompletionPort.h"
+#include "Core/AllocTracker.h"
+#include <algorithm>
+
+namespace Console3::Core {
+
+// ============================================================================
+// PtyCompletionPort
+// ============================================================================
+
+PtyCompletionPort& PtyCompletionPort::Instance() {
+    static PtyCompletionPort s_instance;
+    return s_instance;
+}
+
+PtyCompletionPort::PtyCompletionPort() {
+    // A handful of threads is plenty: each completion is a short memcpy into
+    // the session's ring buffer followed by a new ReadFile
+    const DWORD workerCount = std::clamp(std::thread::hardware_concurrency() / 2, 1u, 4u);
+
+    m_port.reset(CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, workerCount));
+    if (!m_port) {
+        return;
+    }
+
+    m_workers.reserve(workerCount);
+    for (DWORD i = 0; i < workerCount; ++i) {
+        m_workers.emplace_back(&PtyCompletionPort::WorkerProc, this);
+    }
+}
+
+PtyCompletionPort::~PtyCompletionPort() {
+    // A packet with a null OVERLAPPED tells a worker to exit
+    for (size_t i = 0; i < m_workers.size(); ++i) {
+        PostQueuedCompletionStatus(m_port.get(), 0, 0, nullptr);
+    }
+
+    for (auto& worker : m_workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+bool PtyCompletionPort::Post(ULONG_PTR key, OVERLAPPED* overlapped) {
+    if (!m_port || key == 0 || !overlapped) {
+        return false;
+    }
+    return PostQueuedCompletionStatus(m_port.get(), 0, key, overlapped) != FALSE;
+}
+
+bool PtyCompletionPort::Associate(HANDLE handle, ULONG_PTR key) {
+    if (!m_port || !handle || handle == INVALID_HANDLE_VALUE || key == 0) {
+        return false;
+    }
+    return CreateIoCompletionPort(handle, m_port.get(), key, 0) != nullptr;
+}
+
+void PtyCompletionPort::WorkerProc() {
+    AllocScope allocScope(AllocSubsystem::Io);
+    for (;;) {
+        DWORD bytes = 0;
+        ULONG_PTR key = 0;
+        OVERLAPPED* overlapped = nullptr;
+
+        BOOL success = GetQueuedCompletionStatus(m_port.get(), &bytes, &key, &overlapped, INFINITE);
+
+        // Quit packet, or the port itself was closed
+        if (!overlapped) {
+            break;
+        }
+
+        DWORD error = success ? ERROR_SUCCESS : ::GetLastError();
+        reinterpret_cast<PtyCompletionReader*>(key)->OnCompletion(overlapped, bytes, error);
+    }
+}
+
+// ============================================================================
+// PtyCompletionReader
+// ============================================================================
+
+PtyCompletionReader::~PtyCompletionReader() {
+    Stop();
+}
+
+bool PtyCompletionReader::Start(const CompletionReaderConfig& config) {
+    if (m_running.load() || m_inFlight.load() > 0) {
+        return false;
+    }
+
+    if (!config.readHandle || config.readHandle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    // Signaled while no reads are pending, so Stop() never waits on a reader
+    // that failed to start
+    if (!m_drained &&
+        !m_drained.try_create(wil::EventOptions::ManualReset | wil::EventOptions::Signaled, nullptr)) {
+        return false;
+    }
+
+    m_readHandle = config.readHandle;
+    m_onData = config.onData;
+    m_onClosed = config.onClosed;
+
+    const size_t chunkSize = config.chunkSize > 0 ? config.chunkSize : 4096;
+    const size_t slotCount = std::max<size_t>(config.readsInFlight, 1);
+
+    m_slots.clear();
+    m_slots.reserve(slotCount);
+    for (size_t i = 0; i < slotCount; ++i) {
+        auto slot = std::make_unique<ReadSlot>();
+        slot->buffer.resize(chunkSize);
+        m_slots.push_back(std::move(slot));
+    }
+
+    m_nextIssue = 0;
+    m_nextDeliver = 0;
+    m_delivering = false;
+    m_blocked = false;
+    m_resumeRequested = false;
+    m_closeError = ERROR_SUCCESS;
+    m_bytesRead.store(0);
+
+    if (!PtyCompletionPort::Instance().Associate(m_readHandle, reinterpret_cast<ULONG_PTR>(this))) {
+        return false;
+    }
+
+    m_running.store(true);
+    m_drained.ResetEvent();
+
+    for (auto& slot : m_slots) {
+        IssueRead(*slot);
+    }
+
+    return true;
+}
+
+void PtyCompletionReader::Stop() {
+    m_running.store(false);
+
+    if (!m_drained) {
+        return;
+    }
+
+    // A blocked slot has no read pending and would never be released; let
+    // a pool thread run delivery once more so it drops the data
+    PostResume();
+
+    // Aborted reads still complete through the port; wait until they have
+    // and the closed callback has returned
+    if (m_inFlight.load() > 0 && m_readHandle && m_readHandle != INVALID_HANDLE_VALUE) {
+        CancelIoEx(m_readHandle, nullptr);
+    }
+
+    WaitForSingleObject(m_drained.get(), INFINITE);
+}
+
+void PtyCompletionReader::Resume() {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        // Seen by a delivery still deciding whether to block
+        m_resumeRequested = true;
+    }
+    PostResume();
+}
+
+bool PtyCompletionReader::IsBlocked() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_blocked;
+}
+
+void PtyCompletionReader::PostResume() {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (!m_blocked || m_delivering) {
+            return;
+        }
+        m_blocked = false;
+        m_delivering = true;
+    }
+
+    // Deliver on a pool thread rather than the caller's (usually the UI
+    // thread draining the output buffer)
+    if (!PtyCompletionPort::Instance().Post(reinterpret_cast<ULONG_PTR>(this), &m_resumePacket)) {
+        DeliverInOrder();
+    }
+}
+
+void PtyCompletionReader::IssueRead(ReadSlot& slot) {
+    m_inFlight.fetch_add(1);
+
+    DWORD error = ERROR_SUCCESS;
+    {
+        // Sequence assignment and ReadFile must happen together so that
+        // sequence order matches the order the pipe will complete reads in
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        slot.overlapped = OVERLAPPED{};
+        slot.sequence = m_nextIssue++;
+        slot.completed = false;
+
+        if (!ReadFile(m_readHandle, slot.buffer.data(), static_cast<DWORD>(slot.buffer.size()),
+                      nullptr, &slot.overlapped)) {
+            error = ::GetLastError();
+        }
+    }
+
+    if (error == ERROR_SUCCESS || error == ERROR_IO_PENDING) {
+        // A completion packet will arrive; if Stop() raced with us, make
+        // sure this read does not stay pending forever
+        if (!m_running.load()) {
+            CancelIoEx(m_readHandle, &slot.overlapped);
+        }
+        return;
+    }
+
+    // Failed synchronously - no packet will be queued
+    CompleteSlot(slot, 0, error);
+}
+
+void PtyCompletionReader::OnCompletion(OVERLAPPED* overlapped, DWORD bytes, DWORD error) {
+    if (overlapped == &m_resumePacket) {
+        // PostResume() already claimed delivery for this thread
+        DeliverInOrder();
+        return;
+    }
+
+    auto* slot = CONTAINING_RECORD(overlapped, ReadSlot, overlapped);
+    CompleteSlot(*slot, bytes, error);
+}
+
+void PtyCompletionReader::CompleteSlot(ReadSlot& slot, DWORD bytes, DWORD error) {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        slot.bytes = bytes;
+        slot.offset = 0;
+        slot.error = error;
+        slot.completed = true;
+
+        // Another pool thread is already delivering and will pick this up,
+        // or delivery is blocked and Resume() will
+        if (m_delivering || m_blocked) {
+            return;
+        }
+        m_delivering = true;
+    }
+
+    DeliverInOrder();
+}
+
+void PtyCompletionReader::DeliverInOrder() {
+    for (;;) {
+        ReadSlot* next = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            for (auto& candidate : m_slots) {
+                if (candidate->completed && candidate->sequence == m_nextDeliver) {
+                    next = candidate.get();
+                    break;
+                }
+            }
+
+            if (!next) {
+                m_delivering = false;
+                return;
+            }
+            m_resumeRequested = false;
+        }
+
+        const bool hasData = next->error == ERROR_SUCCESS && next->bytes > 0;
+        if (hasData && m_running.load()) {
+            const size_t remaining = next->bytes - next->offset;
+            const size_t accepted = m_onData
+                ? std::min(m_onData(next->buffer.data() + next->offset, remaining), remaining)
+                : remaining;
+            next->offset += static_cast<DWORD>(accepted);
+            m_bytesRead.fetch_add(accepted, std::memory_order_relaxed);
+
+            if (next->offset < next->bytes) {
+                std::lock_guard<std::mutex> lock(m_lock);
+                if (m_resumeRequested || !m_running.load()) {
+                    // Space was freed while the callback ran, or Stop() needs
+                    // the slot released; go round again
+                    continue;
+                }
+
+                // Keeps its in-flight reference; no read is reissued until
+                // Resume(), so the pipe fills up behind it
+                m_blocked = true;
+                m_delivering = false;
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_lock);
+                next->completed = false;
+                ++m_nextDeliver;
+            }
+            if (m_running.load()) {
+                IssueRead(*next);
+            }
+        } else {
+            // EOF, broken pipe or cancellation - stop issuing reads. Data
+            // that arrived after Stop() is dropped.
+            std::lock_guard<std::mutex> lock(m_lock);
+            next->completed = false;
+            ++m_nextDeliver;
+            if (m_closeError == ERROR_SUCCESS) {
+                m_closeError = next->error != ERROR_SUCCESS ? next->error
+                             : hasData                     ? ERROR_OPERATION_ABORTED
+                                                           : ERROR_BROKEN_PIPE;
+            }
+            m_running.store(false);
+        }
+
+        if (ReleaseInFlight()) {
+            // Stop() may already be returning; do not touch members again
+            return;
+        }
+    }
+}
+
+bool PtyCompletionReader::ReleaseInFlight() {
+    if (m_inFlight.fetch_sub(1) != 1) {
+        return false;
+    }
+
+    // Last read drained - only reachable once reads stopped being reissued
+    DWORD closeError = ERROR_SUCCESS;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        closeError = m_closeError;
+    }
+
+    if (m_onClosed) {
+        m_onClosed(closeError);
+    }
+
+    m_drained.SetEvent();
+    return true;
+}
+
+} // namespace Console3::Core
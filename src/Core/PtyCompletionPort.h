@@ -0,0 +1,178 @@
+#pragma once
+// Console3 - PtyCompletionPort.h
+// Shared I/O completion port for overlapped PTY output reads
+//
+// Instead of dedicating one blocking reader thread to every tab, sessions
+// running in completion port mode register their overlapped output pipe with
+// a process-wide completion port. A small pool of worker threads services
+// every registered pipe, and each pipe keeps several reads in flight so that
+// a burst of output never finds the pipe without a pending read.
+
+// Target Windows 10 RS5 (1809) or later for ConPTY APIs
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <wil/resource.h>
+
+namespace Console3::Core {
+
+/// Callback invoked with each chunk read from the pipe, in pipe order
+/// @return Bytes accepted. Accepting less blocks delivery (the rest of the
+/// chunk is offered again) until PtyCompletionReader::Resume() is called.
+using CompletionDataCallback = std::function<size_t(const char* data, size_t length)>;
+
+/// Callback invoked once after the pipe closed and all reads have drained
+/// @param errorCode Win32 error that ended the read loop (ERROR_BROKEN_PIPE on EOF)
+using CompletionClosedCallback = std::function<void(DWORD errorCode)>;
+
+/// Configuration for an overlapped pipe reader
+struct CompletionReaderConfig {
+    HANDLE readHandle = nullptr;     ///< Overlapped pipe handle to read from
+    size_t chunkSize = 4096;         ///< Size of each read buffer in bytes
+    size_t readsInFlight = 2;        ///< Number of reads kept pending at once
+    CompletionDataCallback onData;   ///< Called from a pool thread for each chunk
+    CompletionClosedCallback onClosed; ///< Called once when the pipe is done
+};
+
+/// Process-wide completion port and worker pool shared by all PTY sessions
+class PtyCompletionPort {
+public:
+    /// Get the shared instance (created on first use)
+    static PtyCompletionPort& Instance();
+
+    ~PtyCompletionPort();
+
+    // Non-copyable, non-movable
+    PtyCompletionPort(const PtyCompletionPort&) = delete;
+    PtyCompletionPort& operator=(const PtyCompletionPort&) = delete;
+    PtyCompletionPort(PtyCompletionPort&&) = delete;
+    PtyCompletionPort& operator=(PtyCompletionPort&&) = delete;
+
+    /// Queue a custom packet for a reader
+    /// @return true on success
+    bool Post(ULONG_PTR key, OVERLAPPED* overlapped);
+
+    /// Associate an overlapped handle with the port
+    /// @param handle Handle opened with FILE_FLAG_OVERLAPPED
+    /// @param key Completion key delivered with each packet (non-zero)
+    /// @return true on success
+    [[nodiscard]] bool Associate(HANDLE handle, ULONG_PTR key);
+
+    /// Get the number of worker threads servicing the port
+    [[nodiscard]] size_t GetWorkerCount() const noexcept { return m_workers.size(); }
+
+private:
+    PtyCompletionPort();
+
+    /// Worker thread procedure - dequeues and dispatches completion packets
+    void WorkerProc();
+
+private:
+    wil::unique_handle m_port;
+    std::vector<std::thread> m_workers;
+};
+
+/// Keeps several overlapped reads pending on one pipe and delivers the data
+/// in order, regardless of which pool thread dequeued each completion
+class PtyCompletionReader {
+public:
+    PtyCompletionReader() = default;
+    ~PtyCompletionReader();
+
+    // Non-copyable, non-movable (address is the completion key)
+    PtyCompletionReader(const PtyCompletionReader&) = delete;
+    PtyCompletionReader& operator=(const PtyCompletionReader&) = delete;
+    PtyCompletionReader(PtyCompletionReader&&) = delete;
+    PtyCompletionReader& operator=(PtyCompletionReader&&) = delete;
+
+    /// Register the pipe with the shared port and issue the initial reads
+    /// @param config Reader configuration
+    /// @return true on success
+    [[nodiscard]] bool Start(const CompletionReaderConfig& config);
+
+    /// Cancel pending reads and wait until every read has completed
+    void Stop();
+
+    /// Continue delivery after the data callback accepted only part of a
+    /// chunk (backpressure). While blocked no reads are reissued, so the pipe
+    /// fills up and ConPTY throttles the child. Safe to call from any thread.
+    void Resume();
+
+    /// Check if reads are still being issued
+    [[nodiscard]] bool IsRunning() const noexcept { return m_running.load(); }
+
+    /// Check if delivery is waiting for Resume()
+    [[nodiscard]] bool IsBlocked() const;
+
+    /// Get total bytes delivered since start
+    [[nodiscard]] uint64_t GetBytesRead() const noexcept { return m_bytesRead.load(); }
+
+private:
+    friend class PtyCompletionPort;
+
+    /// One overlapped read and its buffer
+    struct ReadSlot {
+        OVERLAPPED overlapped{};     ///< Recovered via CONTAINING_RECORD on completion
+        std::vector<char> buffer;
+        uint64_t sequence = 0;       ///< Issue order, used to restore pipe order
+        DWORD bytes = 0;
+        DWORD offset = 0;            ///< Bytes already accepted by the data callback
+        DWORD error = ERROR_SUCCESS;
+        bool completed = false;
+    };
+
+    /// Issue a read into the given slot
+    void IssueRead(ReadSlot& slot);
+
+    /// Handle a completion packet (called from a pool thread)
+    void OnCompletion(OVERLAPPED* overlapped, DWORD bytes, DWORD error);
+
+    /// Record a completed slot and deliver everything now in order
+    void CompleteSlot(ReadSlot& slot, DWORD bytes, DWORD error);
+
+    /// Deliver completed slots in sequence order (single deliverer at a time)
+    void DeliverInOrder();
+
+    /// Hand blocked delivery to a pool thread via a resume packet
+    void PostResume();
+
+    /// Drop one in-flight read; fires the closed callback after the last one
+    /// @return true if this was the last read (the reader may be gone)
+    bool ReleaseInFlight();
+
+private:
+    HANDLE m_readHandle = nullptr;
+    CompletionDataCallback m_onData;
+    CompletionClosedCallback m_onClosed;
+
+    std::vector<std::unique_ptr<ReadSlot>> m_slots;
+
+    mutable std::mutex m_lock;       ///< Guards the sequencing state below
+    uint64_t m_nextIssue = 0;        ///< Sequence number for the next read
+    uint64_t m_nextDeliver = 0;      ///< Sequence number expected next
+    bool m_delivering = false;       ///< A pool thread is draining in-order slots
+    bool m_blocked = false;          ///< Waiting for Resume() after a partial accept
+    bool m_resumeRequested = false;  ///< Resume() arrived during a delivery
+    DWORD m_closeError = ERROR_SUCCESS;
+    OVERLAPPED m_resumePacket{};     ///< Identifies resume packets on the port
+
+    std::atomic<bool> m_running{false};
+    std::atomic<size_t> m_inFlight{0};  ///< Pending or undelivered reads
+    std::atomic<uint64_t> m_bytesRead{0};
+    wil::unique_event_nothrow m_drained; ///< Signaled when no reads are pending
+};
+
+} // namespace Console3::Core
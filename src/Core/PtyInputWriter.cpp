@@ -0,0 +1,443 @@
+// Console3 - PtyInputWriter.cpp
+// Asynchronous, coalescing writer for PTY input
+
+#include "Core/PtyInputWriter.h"
+#include "Core/AllocTracker.h"
+#include "Core/Utf.h"
+#include <algorithm>
+#include <chrono>
+
+namespace Console3::Core {
+
+namespace {
+
+// Bracketed paste markers (DECSET 2004)
+constexpr std::string_view kPasteStart = "\x1b[200~";
+constexpr std::string_view kPasteEnd = "\x1b[201~";
+
+} // namespace
+
+PtyInputWriter::~PtyInputWriter() {
+    Stop();
+}
+
+bool PtyInputWriter::Start(const PtyInputWriterConfig& config) {
+    if (m_running.load() || m_thread.joinable()) {
+        return false;
+    }
+
+    if (!config.writeHandle || config.writeHandle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    m_writeHandle = config.writeHandle;
+    m_overlapped = config.overlapped;
+    if (m_overlapped && !m_writeDone && !m_writeDone.try_create(wil::EventOptions::ManualReset, nullptr)) {
+        return false;
+    }
+    m_maxWriteSize = config.maxWriteSize > 0 ? config.maxWriteSize : 16384;
+    m_coalesceDelayMs = config.coalesceDelayMs;
+    m_maxQueuedBytes = config.maxQueuedBytes;
+    m_latencyProbe = config.latencyProbe;
+    m_pasteChunkSize = config.pasteChunkSize > 0 ? std::min(config.pasteChunkSize, m_maxWriteSize) : m_maxWriteSize;
+    m_pastePauseMs = config.pastePauseMs;
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_queue.clear();
+        ClearInput();
+        m_queuedBytes = 0;
+        m_queuedPasteBytes = 0;
+        m_writingPaste = false;
+        m_pasteProgress = PasteProgress{};
+        m_stopRequested = false;
+    }
+    m_error.store(ERROR_SUCCESS);
+    m_bytesWritten.store(0);
+
+    m_running.store(true);
+    m_thread = std::thread(&PtyInputWriter::ThreadProc, this);
+    return true;
+}
+
+void PtyInputWriter::Stop() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stopRequested = true;
+        m_queue.clear();
+        m_queuedBytes = 0;
+        m_queuedPasteBytes = 0;
+        m_pasteProgress.unitsSent = m_pasteProgress.unitsTotal;
+    }
+    m_wake.notify_all();
+
+    // A write blocked on a full pipe only returns when cancelled. Keep
+    // cancelling until the thread is out: it may have been just about to
+    // enter WriteFile when the first cancel landed.
+    const HANDLE thread = m_thread.native_handle();
+    while (WaitForSingleObject(thread, 10) == WAIT_TIMEOUT) {
+        CancelWrite();
+    }
+
+    m_thread.join();
+    m_running.store(false);
+
+    // The writer is gone, so this thread may consume
+    ClearInput();
+    m_queuedBytes = 0;
+}
+
+bool PtyInputWriter::Enqueue(std::string_view data) {
+    if (data.empty()) {
+        return true;
+    }
+    if (!m_running.load()) {
+        return false;
+    }
+
+    // Reserve the bytes first, so racing producers can't overshoot the cap
+    if (m_queuedBytes.fetch_add(data.size()) + data.size() > m_maxQueuedBytes) {
+        m_queuedBytes.fetch_sub(data.size());
+        return false;
+    }
+    m_inputQueue.Push(std::string(data));
+    WakeIfIdle();
+    return true;
+}
+
+bool PtyInputWriter::EnqueuePaste(std::string_view text, bool bracketed) {
+    if (!bracketed) {
+        return text.empty() || PushPaste(text);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        const size_t total = kPasteStart.size() + text.size() + kPasteEnd.size();
+        if (!m_running.load() || m_stopRequested || m_queuedBytes + total > m_maxQueuedBytes) {
+            return false;
+        }
+
+        // The markers are ordinary input so a cancelled paste still leaves
+        // the shell out of paste mode; only the body is cancellable
+        m_queue.push_back(Segment{std::string(kPasteStart), 0, false});
+        if (!text.empty()) {
+            m_queue.push_back(Segment{std::string(text), 0, true});
+        }
+        m_queue.push_back(Segment{std::string(kPasteEnd), 0, false});
+        m_queuedBytes += total;
+        m_queuedPasteBytes += text.size();
+    }
+    m_wake.notify_one();
+    return true;
+}
+
+bool PtyInputWriter::EnqueuePaste(std::wstring text, bool bracketed) {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        const size_t markers = bracketed ? kPasteStart.size() + kPasteEnd.size() : 0;
+        if (!m_running.load() || m_stopRequested || m_queuedBytes + markers > m_maxQueuedBytes) {
+            return false;
+        }
+
+        // Progress restarts with the first paste after an idle spell
+        if (m_queuedPasteBytes == 0 && !m_writingPaste &&
+            m_pasteProgress.unitsSent == m_pasteProgress.unitsTotal) {
+            m_pasteProgress = PasteProgress{};
+        }
+        m_pasteProgress.unitsTotal += text.size();
+
+        if (bracketed) {
+            m_queue.push_back(Segment{std::string(kPasteStart), 0, false});
+        }
+        if (!text.empty()) {
+            Segment& body = m_queue.emplace_back();
+            body.paste = true;
+            body.source = std::move(text);
+        }
+        if (bracketed) {
+            m_queue.push_back(Segment{std::string(kPasteEnd), 0, false});
+        }
+        m_queuedBytes += markers;
+    }
+    m_wake.notify_one();
+    return true;
+}
+
+size_t PtyInputWriter::CancelPaste() {
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    size_t dropped = 0;
+    for (auto it = m_queue.begin(); it != m_queue.end();) {
+        if (it->paste) {
+            dropped += it->bytes.size() - it->offset;
+            it = m_queue.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    m_queuedBytes -= dropped;
+    m_queuedPasteBytes = 0;
+    m_pasteProgress.unitsSent = m_pasteProgress.unitsTotal;
+    m_wake.notify_all();
+
+    // Abort the chunk currently being written as well
+    if (m_writingPaste && m_thread.joinable()) {
+        CancelWrite();
+    }
+    return dropped;
+}
+
+size_t PtyInputWriter::GetPendingBytes() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_queuedBytes;
+}
+
+bool PtyInputWriter::IsPasting() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_queuedPasteBytes > 0 || m_writingPaste || m_pasteProgress.unitsSent < m_pasteProgress.unitsTotal;
+}
+
+PasteProgress PtyInputWriter::GetPasteProgress() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_pasteProgress;
+}
+
+bool PtyInputWriter::PushPaste(std::string_view data) {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (!m_running.load() || m_stopRequested || m_queuedBytes + data.size() > m_maxQueuedBytes) {
+            return false;
+        }
+        m_queue.push_back(Segment{std::string(data), 0, true});
+        m_queuedBytes += data.size();
+        m_queuedPasteBytes += data.size();
+    }
+    m_wake.notify_one();
+    return true;
+}
+
+void PtyInputWriter::WakeIfIdle() {
+    // Checked after the push is linked; IsReady() sets the flag before it
+    // looks at the queue, so one of the two sees the other
+    if (m_idle.load()) {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_wake.notify_one();
+    }
+}
+
+bool PtyInputWriter::IsReady() {
+    m_idle.store(true);
+    const bool ready = m_stopRequested || !m_queue.empty() || m_inputOffset < m_input.size() ||
+                       !m_inputQueue.IsEmpty();
+    if (ready) {
+        m_idle.store(false);
+    }
+    return ready;
+}
+
+void PtyInputWriter::TakeInput(std::string& batch) {
+    if (m_inputOffset == m_input.size()) {
+        m_input.clear();
+        m_inputOffset = 0;
+    }
+
+    // Everything typed so far goes out together
+    std::string item;
+    while (m_input.size() - m_inputOffset < m_maxWriteSize && m_inputQueue.TryPop(item)) {
+        m_input += item;
+    }
+
+    const size_t take = std::min(m_input.size() - m_inputOffset, m_maxWriteSize);
+    batch.append(m_input, m_inputOffset, take);
+    m_inputOffset += take;
+    m_queuedBytes -= take;
+}
+
+void PtyInputWriter::ClearInput() {
+    std::string item;
+    while (m_inputQueue.TryPop(item)) {
+    }
+    m_input.clear();
+    m_inputOffset = 0;
+}
+
+bool PtyInputWriter::TakeBatch(std::string& batch) {
+    // Typed input first, so it never waits behind a paste. A batch never
+    // mixes paste and typed input, so cancelling a paste write cannot
+    // swallow keystrokes.
+    TakeInput(batch);
+    if (!batch.empty() || m_queue.empty()) {
+        return false;
+    }
+
+    const bool paste = m_queue.front().paste;
+    const size_t limit = paste ? m_pasteChunkSize : m_maxWriteSize;
+
+    while (!m_queue.empty() && m_queue.front().paste == paste && batch.size() < limit) {
+        Segment& segment = m_queue.front();
+        if (segment.offset == segment.bytes.size()) {
+            ConvertPaste(segment);
+            if (segment.offset == segment.bytes.size()) {
+                m_queue.pop_front();
+                continue;
+            }
+        }
+        const size_t take = std::min(segment.bytes.size() - segment.offset, limit - batch.size());
+
+        batch.append(segment.bytes, segment.offset, take);
+        segment.offset += take;
+        m_queuedBytes -= take;
+        if (paste) {
+            m_queuedPasteBytes -= take;
+        }
+
+        if (segment.offset == segment.bytes.size() && segment.sourceOffset == segment.source.size()) {
+            m_queue.pop_front();
+        }
+    }
+    return paste;
+}
+
+void PtyInputWriter::ConvertPaste(Segment& segment) {
+    const size_t left = segment.source.size() - segment.sourceOffset;
+    if (left == 0) {
+        return;
+    }
+
+    // A UTF-16 unit becomes at most three bytes; a surrogate pair is never split
+    const wchar_t* text = segment.source.data() + segment.sourceOffset;
+    size_t count = std::min(left, std::max<size_t>(m_pasteChunkSize / 3, 2));
+    if (count < left && IS_HIGH_SURROGATE(text[count - 1])) {
+        --count;
+    }
+    const std::wstring_view chunk(text, count);
+    segment.bytes.resize(Utf8Length(chunk));
+    Utf16ToUtf8(chunk, segment.bytes.data());
+    segment.offset = 0;
+    segment.sourceOffset += count;
+    m_queuedBytes += segment.bytes.size();
+    m_queuedPasteBytes += segment.bytes.size();
+    m_pasteProgress.unitsSent += count;
+
+    // The text is done with; give its memory back before the last chunk goes
+    if (segment.sourceOffset == segment.source.size()) {
+        segment.source = std::wstring();
+        segment.sourceOffset = 0;
+    }
+}
+
+BOOL PtyInputWriter::WriteChunk(const char* data, DWORD length, DWORD& written) {
+    if (!m_overlapped) {
+        return WriteFile(m_writeHandle, data, length, &written, nullptr);
+    }
+
+    m_writeOverlapped = OVERLAPPED{};
+    m_writeOverlapped.hEvent = m_writeDone.get();
+    if (!WriteFile(m_writeHandle, data, length, nullptr, &m_writeOverlapped) &&
+        ::GetLastError() != ERROR_IO_PENDING) {
+        return FALSE;
+    }
+    return GetOverlappedResult(m_writeHandle, &m_writeOverlapped, &written, TRUE);
+}
+
+void PtyInputWriter::CancelWrite() {
+    if (m_overlapped) {
+        // Only this write: the transport reads the same handle
+        CancelIoEx(m_writeHandle, &m_writeOverlapped);
+    } else {
+        CancelSynchronousIo(m_thread.native_handle());
+    }
+}
+
+void PtyInputWriter::ThreadProc() {
+    AllocScope allocScope(AllocSubsystem::Io);
+    std::string batch;
+    batch.reserve(m_maxWriteSize);
+
+    for (;;) {
+        bool paste = false;
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_writingPaste = false;
+            m_wake.wait(lock, [this] { return IsReady(); });
+            if (m_stopRequested) {
+                break;
+            }
+
+            // Optionally let a burst of small input accumulate
+            if (m_coalesceDelayMs > 0 && m_queuedBytes < m_maxWriteSize) {
+                m_wake.wait_for(lock, std::chrono::milliseconds(m_coalesceDelayMs), [this] {
+                    return m_stopRequested || m_queuedBytes >= m_maxWriteSize;
+                });
+                if (m_stopRequested) {
+                    break;
+                }
+            }
+
+            batch.clear();
+            paste = TakeBatch(batch);
+            m_writingPaste = paste;
+        }
+        if (batch.empty()) {
+            continue;
+        }
+
+        size_t done = 0;
+        while (done < batch.size()) {
+            DWORD written = 0;
+            if (WriteChunk(batch.data() + done, static_cast<DWORD>(batch.size() - done), written)) {
+                done += written;
+                m_bytesWritten.fetch_add(written, std::memory_order_relaxed);
+                continue;
+            }
+
+            const DWORD error = ::GetLastError();
+            if (error == ERROR_OPERATION_ABORTED) {
+                // CancelPaste() or Stop() - drop the rest of this chunk
+                break;
+            }
+
+            // Pipe broken or handle invalid - nothing more can be written
+            m_error.store(error);
+            {
+                std::lock_guard<std::mutex> lock(m_lock);
+                m_queue.clear();
+                ClearInput();
+                m_queuedBytes = 0;
+                m_queuedPasteBytes = 0;
+                m_writingPaste = false;
+            }
+            m_running.store(false);
+            return;
+        }
+
+        InputLatencyProbe* probe = m_latencyProbe.load();
+        if (probe && !paste && done == batch.size()) {
+            probe->Mark(LatencyPoint::Written);
+        }
+
+        // Let the reader catch up between paste chunks; a cancel, stop or
+        // typed input ends the pause early
+        if (paste && m_pastePauseMs > 0 && done == batch.size()) {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_wake.wait_for(lock, std::chrono::milliseconds(m_pastePauseMs), [this] {
+                m_idle.store(true);
+                const bool resume = m_stopRequested || m_queue.empty() || !m_queue.front().paste ||
+                                    !m_inputQueue.IsEmpty();
+                if (resume) {
+                    m_idle.store(false);
+                }
+                return resume;
+            });
+            m_idle.store(false);
+        }
+    }
+
+    m_running.store(false);
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,215 @@
+#pragma once
+// Console3 - PtyInputWriter.h
+// Asynchronous, coalescing writer for PTY input
+//
+// WriteFile on the ConPTY input pipe blocks whenever the console host is not
+// reading, which is exactly what happens while a large paste is being
+// echoed. Doing that on the UI thread freezes the window. The writer accepts
+// input without blocking and hands it to a dedicated thread. Keystrokes queued
+// while a write is in progress go out together in the next WriteFile, and
+// pastes are streamed in bounded chunks so they can be cancelled midway.
+//
+// A clipboard paste can be many megabytes. Its text is queued as UTF-16 and
+// converted to UTF-8 one chunk at a time, just before that chunk is written,
+// so the converted data in memory never exceeds a chunk. Paste chunks are
+// small and paced: readers such as PSReadLine process a paste a key at a
+// time, and a short pause between chunks lets them keep up instead of the
+// console host buffering everything at once.
+//
+// Input has two lanes. Keystrokes, mouse reports and the emulator's replies
+// come from several threads and go through a lock-free queue (MpscQueue.h)
+// that the writer always drains first, so a Ctrl+C typed during a
+// multi-megabyte paste goes out after the chunk being written, not after
+// the paste. Pastes and their bracketing markers keep their own ordered
+// queue under a lock. A producer takes that lock only to wake the writer
+// when it is asleep.
+//
+// A serial port is opened once, for overlapped I/O, and its reads and
+// writes share the handle (see SerialPort.h); with `overlapped` set the
+// writer issues each WriteFile with an OVERLAPPED of its own and waits for
+// it, and a cancel aborts only that write, not the transport's read.
+
+// Target Windows 10 RS5 (1809) or later for ConPTY APIs
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <wil/resource.h>
+
+#include "Core/InputLatency.h"
+#include "Core/MpscQueue.h"
+
+namespace Console3::Core {
+
+/// Configuration for the input writer
+struct PtyInputWriterConfig {
+    HANDLE writeHandle = nullptr;        ///< PTY input pipe (synchronous handle)
+    bool overlapped = false;             ///< writeHandle was opened for overlapped I/O
+    size_t maxWriteSize = 16384;         ///< Largest single WriteFile in bytes
+    DWORD coalesceDelayMs = 0;           ///< Extra wait for more small input (0 = none)
+    size_t maxQueuedBytes = 64 * 1024 * 1024; ///< Enqueue fails beyond this
+    InputLatencyProbe* latencyProbe = nullptr; ///< Stamped when keystrokes are written (optional)
+    size_t pasteChunkSize = 4096;        ///< Largest single WriteFile of paste data in bytes
+    DWORD pastePauseMs = 1;              ///< Pause after each paste chunk (0 = none)
+};
+
+/// How far the pastes queued since the writer was last idle have got
+struct PasteProgress {
+    uint64_t unitsSent = 0;              ///< UTF-16 units converted and queued for writing
+    uint64_t unitsTotal = 0;             ///< UTF-16 units pasted
+};
+
+/// Dedicated thread that drains queued input into the PTY
+class PtyInputWriter {
+public:
+    PtyInputWriter() = default;
+    ~PtyInputWriter();
+
+    // Non-copyable, non-movable
+    PtyInputWriter(const PtyInputWriter&) = delete;
+    PtyInputWriter& operator=(const PtyInputWriter&) = delete;
+    PtyInputWriter(PtyInputWriter&&) = delete;
+    PtyInputWriter& operator=(PtyInputWriter&&) = delete;
+
+    /// Start the writer thread
+    /// @return true on success
+    [[nodiscard]] bool Start(const PtyInputWriterConfig& config);
+
+    /// Abort any blocked write, drop queued input and join the thread
+    void Stop();
+
+    /// Queue input (keystrokes, control sequences); never blocks on the pipe
+    /// or on a lock. Written ahead of any queued paste data. Any thread.
+    /// @return false if the writer is stopped, failed, or the queue is full
+    bool Enqueue(std::string_view data);
+
+    /// Queue a paste; the body can be dropped by CancelPaste()
+    /// @param text Paste contents (UTF-8)
+    /// @param bracketed Wrap in bracketed paste markers. The end marker is
+    /// always sent, even when the paste is cancelled.
+    /// @return false if the writer is stopped, failed, or the queue is full
+    bool EnqueuePaste(std::string_view text, bool bracketed);
+
+    /// Queue a paste of UTF-16 text, converted as it is written (see file
+    /// comment). The text itself does not count against maxQueuedBytes.
+    /// @param bracketed As for EnqueuePaste()
+    /// @return false if the writer is stopped, failed, or the queue is full
+    bool EnqueuePaste(std::wstring text, bool bracketed);
+
+    /// Drop all queued paste data and abort a paste write in progress
+    /// @return Number of queued bytes discarded
+    size_t CancelPaste();
+
+    /// Get the number of bytes waiting to be written
+    [[nodiscard]] size_t GetPendingBytes() const;
+
+    /// Replace the latency probe while running (a warm shell changing hands)
+    void SetLatencyProbe(InputLatencyProbe* probe) noexcept { m_latencyProbe.store(probe); }
+
+    /// Check if a paste is still being streamed
+    [[nodiscard]] bool IsPasting() const;
+
+    /// Get the progress of the pastes in flight (cancelled ones count as sent)
+    [[nodiscard]] PasteProgress GetPasteProgress() const;
+
+    /// Get the total bytes written to the pipe since start
+    [[nodiscard]] uint64_t GetBytesWritten() const noexcept {
+        return m_bytesWritten.load(std::memory_order_relaxed);
+    }
+
+    /// Get the Win32 error that stopped the writer (ERROR_SUCCESS if none)
+    [[nodiscard]] DWORD GetLastErrorCode() const noexcept { return m_error.load(); }
+
+private:
+    /// One queued run of input
+    struct Segment {
+        std::string bytes;
+        size_t offset = 0;      ///< Bytes already written
+        bool paste = false;     ///< Dropped by CancelPaste()
+        std::wstring source;    ///< Paste text still to convert into bytes
+        size_t sourceOffset = 0;
+    };
+
+    /// Append a paste segment under the lock; fails when the queue is full
+    bool PushPaste(std::string_view data);
+
+    /// Wake the writer if it is waiting for input (any thread)
+    void WakeIfIdle();
+
+    /// Check for anything to write (called with the lock held); marks the
+    /// writer idle until there is
+    bool IsReady();
+
+    /// Move typed input into a batch, up to maxWriteSize (writer thread)
+    void TakeInput(std::string& batch);
+
+    /// Drop all typed input (writer thread, or once it has exited)
+    void ClearInput();
+
+    /// Convert the next chunk of a segment's source text into its bytes
+    /// (called with the lock held, once the bytes are all taken)
+    void ConvertPaste(Segment& segment);
+
+    /// Writer thread procedure
+    void ThreadProc();
+
+    /// Gather the next batch of input (called with the lock held): typed
+    /// input if there is any, else the next of the paste queue
+    /// @param batch Receives up to maxWriteSize bytes (pasteChunkSize of paste)
+    /// @return true if the batch contains paste data
+    bool TakeBatch(std::string& batch);
+
+    /// Write once to the handle, waiting for an overlapped write to finish
+    /// @return As WriteFile (ERROR_OPERATION_ABORTED when cancelled)
+    BOOL WriteChunk(const char* data, DWORD length, DWORD& written);
+
+    /// Abort the write in progress, if any (any thread)
+    void CancelWrite();
+
+private:
+    HANDLE m_writeHandle = nullptr;
+    bool m_overlapped = false;
+    OVERLAPPED m_writeOverlapped{};      ///< Writer thread (and CancelWrite)
+    wil::unique_event_nothrow m_writeDone;
+    size_t m_maxWriteSize = 16384;
+    DWORD m_coalesceDelayMs = 0;
+    size_t m_maxQueuedBytes = 0;
+    size_t m_pasteChunkSize = 4096;
+    DWORD m_pastePauseMs = 0;
+    std::atomic<InputLatencyProbe*> m_latencyProbe{nullptr};
+
+    // Typed input lane: pushed lock-free, drained by the writer thread
+    MpscQueue<std::string> m_inputQueue;
+    std::string m_input;             ///< Popped and not yet written (writer thread)
+    size_t m_inputOffset = 0;        ///< Bytes of m_input written (writer thread)
+    std::atomic<bool> m_idle{false}; ///< Writer is waiting on m_wake for input
+
+    mutable std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::deque<Segment> m_queue;     ///< Pastes and their markers; guarded by m_lock
+    std::atomic<size_t> m_queuedBytes{0}; ///< Both lanes
+    size_t m_queuedPasteBytes = 0;   ///< Guarded by m_lock
+    bool m_writingPaste = false;     ///< Guarded by m_lock
+    PasteProgress m_pasteProgress;   ///< Guarded by m_lock
+    bool m_stopRequested = false;    ///< Guarded by m_lock
+
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+    std::atomic<DWORD> m_error{ERROR_SUCCESS};
+    std::atomic<uint64_t> m_bytesWritten{0};
+};
+
+} // namespace Console3::Core
@@ -0,0 +1,476 @@
+// Console3 - PtyRecorder.cpp
+// Asynchronous tap that records PTY output to a file
+
+#include "Core/PtyRecorder.h"
+#include "Core/AllocTracker.h"
+#include "Core/PerfClock.h"
+#include <lz4frame.h>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+
+namespace Console3::Core {
+
+namespace {
+
+/// Bytes of a read's header in a spill file: time, then length
+constexpr size_t kSpillHeaderBytes = 2 * sizeof(uint64_t);
+
+/// LZ4 frames of 1 MB linked blocks, checksummed, so the lz4 tool reads them
+[[nodiscard]] LZ4F_preferences_t GetFramePreferences() noexcept {
+    LZ4F_preferences_t preferences = LZ4F_INIT_PREFERENCES;
+    preferences.frameInfo.blockSizeID = LZ4F_max1MB;
+    preferences.frameInfo.blockMode = LZ4F_blockLinked;
+    preferences.frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+    return preferences;
+}
+
+/// Get the path of a file after rotation (0 = the path as given)
+[[nodiscard]] std::wstring GetFilePath(const std::wstring& path, uint32_t index) {
+    if (index == 0) {
+        return path;
+    }
+    const std::filesystem::path file(path);
+    const std::wstring name = file.filename().wstring();
+    const size_t dot = name.find(L'.', 1);
+    const std::wstring numbered = dot == std::wstring::npos
+        ? name + L"." + std::to_wstring(index)
+        : name.substr(0, dot) + L"." + std::to_wstring(index) + name.substr(dot);
+    return (file.parent_path() / numbered).wstring();
+}
+
+/// Get the path of a spill file
+[[nodiscard]] std::wstring GetSpillPath(const std::wstring& path, uint32_t index) {
+    return path + L".spill" + std::to_wstring(index);
+}
+
+} // namespace
+
+PtyRecorder::~PtyRecorder() {
+    Stop();
+}
+
+bool PtyRecorder::Start(const PtyRecorderConfig& config) {
+    m_lastError.clear();
+
+    if (m_running.load() || m_thread.joinable()) {
+        m_lastError = L"Recorder already running";
+        return false;
+    }
+
+    if (config.path.empty()) {
+        m_lastError = L"No recording path";
+        return false;
+    }
+
+    for (Write& write : m_writes) {
+        if (!write.done && !write.done.try_create(wil::EventOptions::ManualReset, nullptr)) {
+            m_lastError = L"Failed to create recording events";
+            return false;
+        }
+        write.pending = false;
+        write.data.reserve(kWriteBytes);
+    }
+    if (!OpenFile(config.path)) {
+        m_lastError = L"Failed to create recording file: " + config.path;
+        return false;
+    }
+    if (config.compress && !m_compressor) {
+        LZ4F_cctx* compressor = nullptr;
+        if (LZ4F_isError(LZ4F_createCompressionContext(&compressor, LZ4F_VERSION))) {
+            m_file.reset();
+            DeleteFileW(config.path.c_str());
+            m_lastError = L"Failed to start recording compression";
+            return false;
+        }
+        m_compressor = compressor;
+    } else if (!config.compress && m_compressor) {
+        LZ4F_freeCompressionContext(m_compressor);
+        m_compressor = nullptr;
+    }
+
+    m_path = config.path;
+    m_format = config.format;
+    m_cols = config.cols;
+    m_rows = config.rows;
+    m_maxQueuedBytes = config.maxQueuedBytes;
+    m_overflow = config.overflow;
+    m_maxSpillBytes = config.maxSpillBytes;
+    m_rotateBytes = config.rotateBytes;
+    m_rotateMicros = static_cast<uint64_t>(config.rotateSeconds) * 1000000;
+    m_startMicros = PerfClock::NowMicros();
+    m_fileIndex = 0;
+    m_fileMicros = 0;
+    m_out.clear();
+    m_out.reserve(kWriteBytes);
+    m_unflushed = false;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_pending.Clear();
+        m_spillBytes = 0;
+        m_spillBroken = false;
+        m_stopRequested = false;
+    }
+    m_bytesRecorded.store(0);
+    m_bytesDropped.store(0);
+    m_bytesSpilled.store(0);
+    m_writeFailed.store(false);
+
+    m_running.store(true);
+    m_thread = std::thread(&PtyRecorder::ThreadProc, this);
+    return true;
+}
+
+void PtyRecorder::Stop() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stopRequested = true;
+    }
+    m_wake.notify_all();
+    m_room.notify_all();
+
+    // The thread drains the pending batch and any spill file before it exits
+    m_thread.join();
+    m_running.store(false);
+
+    if (m_compressor) {
+        LZ4F_freeCompressionContext(m_compressor);
+        m_compressor = nullptr;
+    }
+}
+
+void PtyRecorder::Record(const char* data, size_t length) {
+    if (length == 0 || !m_running.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    const uint64_t micros = PerfClock::NowMicros() - m_startMicros;
+    bool wake = false;
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+        const auto full = [&] {
+            return !m_pending.reads.empty() && m_pending.bytes.size() + length > m_maxQueuedBytes;
+        };
+        if (m_overflow == RecorderOverflow::Block) {
+            m_room.wait(lock, [&] {
+                return m_stopRequested || m_writeFailed.load(std::memory_order_relaxed) || !full();
+            });
+        }
+        if (m_stopRequested || m_writeFailed.load(std::memory_order_relaxed)) {
+            m_bytesDropped.fetch_add(length, std::memory_order_relaxed);
+            return;
+        }
+
+        // Once spilling, everything spills until the writer takes the file,
+        // so the output stays in order
+        if (m_spill || full()) {
+            const bool started = !m_spill;
+            if (m_overflow != RecorderOverflow::Spill || !Spill(micros, data, length)) {
+                m_bytesDropped.fetch_add(length, std::memory_order_relaxed);
+                return;
+            }
+            wake = started;
+        } else {
+            wake = m_pending.reads.empty();
+            m_pending.bytes.append(data, length);
+            m_pending.reads.emplace_back(micros, length);
+        }
+    }
+    m_bytesRecorded.fetch_add(length, std::memory_order_relaxed);
+
+    if (wake) {
+        m_wake.notify_one();
+    }
+}
+
+bool PtyRecorder::Spill(uint64_t micros, const char* data, size_t length) {
+    if (m_spillBroken || m_spillBytes + kSpillHeaderBytes + length > m_maxSpillBytes) {
+        return false;
+    }
+    if (!m_spill) {
+        const std::wstring path = GetSpillPath(m_path, ++m_spillFiles);
+        if (_wfopen_s(&m_spill, path.c_str(), L"w+b") != 0 || !m_spill) {
+            m_spill = nullptr;
+            return false;
+        }
+        m_spillBytes = 0;
+    }
+
+    // A failed write leaves a partial read past m_spillBytes; the writer
+    // stops short of it and later reads are dropped
+    const uint64_t header[2] = {micros, length};
+    if (std::fwrite(header, 1, kSpillHeaderBytes, m_spill) != kSpillHeaderBytes ||
+        std::fwrite(data, 1, length, m_spill) != length) {
+        m_spillBroken = true;
+        return false;
+    }
+    m_spillBytes += kSpillHeaderBytes + length;
+    m_bytesSpilled.fetch_add(length, std::memory_order_relaxed);
+    return true;
+}
+
+// ============================================================================
+// Writer thread
+// ============================================================================
+
+void PtyRecorder::ThreadProc() {
+    AllocScope allocScope(AllocSubsystem::Io);
+    // Swapping batches keeps both buffers' capacity, so steady-state
+    // recording does not allocate
+    Batch batch;
+    std::string encoded;
+    BeginFile(encoded);
+
+    for (;;) {
+        std::FILE* spill = nullptr;
+        uint64_t spillBytes = 0;
+        uint32_t spillIndex = 0;
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            const auto ready = [this] { return m_stopRequested || !m_pending.reads.empty() || m_spill; };
+            if (m_unflushed && !m_wake.wait_for(lock, std::chrono::milliseconds(kIdleFlushMillis), ready)) {
+                lock.unlock();
+                Flush();
+                lock.lock();
+            }
+            m_wake.wait(lock, ready);
+
+            // The batch first: it was queued before the spill file started
+            if (!m_pending.reads.empty()) {
+                std::swap(batch, m_pending);
+            } else if (m_spill) {
+                spill = std::exchange(m_spill, nullptr);
+                spillBytes = m_spillBytes;
+                spillIndex = m_spillFiles;
+                m_spillBytes = 0;
+                m_spillBroken = false;
+            } else {
+                break;  // Stop requested and everything written
+            }
+        }
+        m_room.notify_all();
+
+        if (spill) {
+            WriteSpill(spill, spillBytes, batch, encoded);
+            std::fclose(spill);
+            _wremove(GetSpillPath(m_path, spillIndex).c_str());
+        } else {
+            WriteBatch(batch, encoded);
+            batch.Clear();
+        }
+
+        // Rotate between batches, so each file holds whole reads
+        const uint64_t now = PerfClock::NowMicros() - m_startMicros;
+        if ((m_rotateBytes != 0 && m_fileOffset + m_out.size() >= m_rotateBytes) ||
+            (m_rotateMicros != 0 && now - m_fileMicros >= m_rotateMicros)) {
+            EndFile(encoded);
+            if (!m_writeFailed.load(std::memory_order_relaxed) && !OpenFile(GetFilePath(m_path, ++m_fileIndex))) {
+                Fail();
+            }
+            BeginFile(encoded);
+        }
+    }
+
+    EndFile(encoded);
+}
+
+bool PtyRecorder::OpenFile(const std::wstring& path) {
+    m_file.reset(CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                             FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, nullptr));
+    m_nextWrite = 0;
+    m_fileOffset = 0;
+    return static_cast<bool>(m_file);
+}
+
+void PtyRecorder::BeginFile(std::string& encoded) {
+    m_fileMicros = PerfClock::NowMicros() - m_startMicros;
+    if (m_compressor) {
+        const LZ4F_preferences_t preferences = GetFramePreferences();
+        m_out.resize(LZ4F_HEADER_SIZE_MAX);
+        const size_t size = LZ4F_compressBegin(m_compressor, m_out.data(), m_out.size(), &preferences);
+        m_out.resize(LZ4F_isError(size) ? 0 : size);
+        m_unflushed = true;
+    }
+
+    m_encoder = RecordingEncoder(m_format);
+    encoded.clear();
+    m_encoder.EncodeHeader(m_cols, m_rows, static_cast<int64_t>(std::time(nullptr)), encoded);
+    Emit(encoded);
+}
+
+void PtyRecorder::EndFile(std::string& encoded) {
+    encoded.clear();
+    m_encoder.Finish(encoded);
+    Emit(encoded);
+    if (m_compressor) {
+        const size_t used = m_out.size();
+        const LZ4F_preferences_t preferences = GetFramePreferences();
+        m_out.resize(used + LZ4F_compressBound(0, &preferences));
+        const size_t size = LZ4F_compressEnd(m_compressor, m_out.data() + used, m_out.size() - used, nullptr);
+        m_out.resize(used + (LZ4F_isError(size) ? 0 : size));
+    }
+    if (!m_out.empty() && !m_writeFailed.load(std::memory_order_relaxed) && !Submit()) {
+        Fail();
+    }
+    m_out.clear();
+    m_unflushed = false;
+
+    for (Write& write : m_writes) {
+        if (write.pending && !Complete(write)) {
+            Fail();
+        }
+    }
+    m_file.reset();
+}
+
+void PtyRecorder::WriteBatch(const Batch& batch, std::string& encoded) {
+    if (m_format == RecordingFormat::Raw) {
+        Emit(batch.bytes);
+        return;
+    }
+
+    // Times start again with each file
+    encoded.clear();
+    size_t offset = 0;
+    for (const auto& [micros, length] : batch.reads) {
+        m_encoder.EncodeEvent(micros > m_fileMicros ? micros - m_fileMicros : 0,
+                              std::string_view(batch.bytes).substr(offset, length), encoded);
+        offset += length;
+        if (encoded.size() >= kWriteBytes) {
+            Emit(encoded);
+            encoded.clear();
+        }
+    }
+    Emit(encoded);
+}
+
+void PtyRecorder::WriteSpill(std::FILE* spill, uint64_t bytes, Batch& batch, std::string& encoded) {
+    // Read back a batch's worth at a time; the spill file's own buffer was
+    // flushed by the seek
+    batch.Clear();
+    if (std::fseek(spill, 0, SEEK_SET) != 0) {
+        Fail();
+        return;
+    }
+    for (uint64_t offset = 0; offset + kSpillHeaderBytes <= bytes;) {
+        uint64_t header[2] = {};
+        if (std::fread(header, 1, kSpillHeaderBytes, spill) != kSpillHeaderBytes) {
+            break;
+        }
+        const auto length = static_cast<size_t>(header[1]);
+        const size_t start = batch.bytes.size();
+        batch.bytes.resize(start + length);
+        if (std::fread(batch.bytes.data() + start, 1, length, spill) != length) {
+            batch.bytes.resize(start);
+            break;
+        }
+        batch.reads.emplace_back(header[0], length);
+        offset += kSpillHeaderBytes + length;
+        if (batch.bytes.size() >= kWriteBytes) {
+            WriteBatch(batch, encoded);
+            batch.Clear();
+        }
+    }
+    WriteBatch(batch, encoded);
+    batch.Clear();
+}
+
+void PtyRecorder::Emit(std::string_view bytes) {
+    if (bytes.empty() || m_writeFailed.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    if (!m_compressor) {
+        m_out.append(bytes);
+    } else {
+        const size_t used = m_out.size();
+        const LZ4F_preferences_t preferences = GetFramePreferences();
+        m_out.resize(used + LZ4F_compressBound(bytes.size(), &preferences));
+        const size_t size = LZ4F_compressUpdate(m_compressor, m_out.data() + used, m_out.size() - used,
+                                                bytes.data(), bytes.size(), nullptr);
+        if (LZ4F_isError(size)) {
+            m_out.resize(used);
+            Fail();
+            return;
+        }
+        m_out.resize(used + size);
+    }
+    m_unflushed = true;
+
+    if (m_out.size() >= kWriteBytes && !Submit()) {
+        Fail();
+    }
+}
+
+void PtyRecorder::Flush() {
+    m_unflushed = false;
+    if (m_writeFailed.load(std::memory_order_relaxed)) {
+        m_out.clear();
+        return;
+    }
+
+    // The compressor holds up to a block back; the frame goes on after it
+    if (m_compressor) {
+        const size_t used = m_out.size();
+        const LZ4F_preferences_t preferences = GetFramePreferences();
+        m_out.resize(used + LZ4F_compressBound(0, &preferences));
+        const size_t size = LZ4F_flush(m_compressor, m_out.data() + used, m_out.size() - used, nullptr);
+        m_out.resize(used + (LZ4F_isError(size) ? 0 : size));
+    }
+    if (!m_out.empty() && !Submit()) {
+        Fail();
+    }
+}
+
+bool PtyRecorder::Submit() {
+    if (!m_file) {
+        return false;
+    }
+
+    // The slot's buffer comes back to be filled next
+    Write& write = m_writes[m_nextWrite];
+    m_nextWrite = (m_nextWrite + 1) % kWritesInFlight;
+    if (write.pending && !Complete(write)) {
+        return false;
+    }
+    write.data.swap(m_out);
+    m_out.clear();
+
+    write.overlapped = OVERLAPPED{};
+    write.overlapped.Offset = static_cast<DWORD>(m_fileOffset);
+    write.overlapped.OffsetHigh = static_cast<DWORD>(m_fileOffset >> 32);
+    write.overlapped.hEvent = write.done.get();
+    write.done.ResetEvent();
+    m_fileOffset += write.data.size();
+
+    if (!WriteFile(m_file.get(), write.data.data(), static_cast<DWORD>(write.data.size()), nullptr,
+                   &write.overlapped) &&
+        ::GetLastError() != ERROR_IO_PENDING) {
+        return false;
+    }
+    write.pending = true;
+    return true;
+}
+
+bool PtyRecorder::Complete(Write& write) {
+    DWORD bytes = 0;
+    const BOOL ok = GetOverlappedResult(m_file.get(), &write.overlapped, &bytes, TRUE);
+    write.pending = false;
+    return ok && bytes == write.data.size();
+}
+
+void PtyRecorder::Fail() {
+    m_out.clear();
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_writeFailed.store(true);
+    }
+    m_room.notify_all();
+}
+
+} // namespace Console3::Core
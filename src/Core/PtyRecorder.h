@@ -0,0 +1,212 @@
+#pragma once
+// Console3 - PtyRecorder.h
+// Asynchronous tap that records PTY output to a file
+//
+// The transport hands every read to Record() right after it completes and
+// before the bytes enter the output ring. Record() only appends to an
+// in-memory batch; a dedicated thread encodes and writes batches, so a slow
+// disk never stalls the read path. The same tap serves timestamped
+// recordings and plain session logs (RecordingFormat::Raw), which the
+// writer passes through without encoding.
+//
+// The writer gathers output into kWriteBytes buffers written with
+// overlapped I/O, kWritesInFlight at a time; one that stays idle for
+// kIdleFlushMillis writes out what it holds, so a log is current a moment
+// after the shell goes quiet. Optionally it compresses on the way out (an
+// LZ4 frame per file, readable with the lz4 tool) and starts a new file
+// past a size or an age, checked after each batch: the first file is the
+// path given, the next ones are numbered before its first extension
+// (session.log, session.1.log, ...). Each file is a complete recording
+// with its own header, times starting from its own start.
+//
+// When the writer falls maxQueuedBytes behind, the overflow policy decides:
+//
+//   Drop   - the excess output is dropped and counted.
+//   Block  - Record() waits for room, holding up the reader, so the shell
+//            stalls behind the disk (ConPTY's pipe fills) and nothing is
+//            lost.
+//   Spill  - the excess goes to a temporary file next to the log, appended
+//            as it comes; the writer copies it in after the batch ahead of
+//            it, in order. Reads go to the spill file until the writer takes
+//            it, and are dropped past maxSpillBytes.
+//
+// The batch is a copy: the ring reuses a read's storage as soon as the
+// parser has it, and holding that storage for the writer would hold up the
+// parser behind the disk.
+
+#include <Windows.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <wil/resource.h>
+
+#include "Core/PtyRecording.h"
+
+struct LZ4F_cctx_s;
+
+namespace Console3::Core {
+
+/// What Record() does when the writer is maxQueuedBytes behind
+enum class RecorderOverflow {
+    Drop,       ///< Drop the excess (counted)
+    Block,      ///< Wait for the writer
+    Spill       ///< Queue the excess in a temporary file
+};
+
+/// Configuration for the recorder
+struct PtyRecorderConfig {
+    std::wstring path;                        ///< Output file (created or truncated)
+    RecordingFormat format = RecordingFormat::Binary;
+    int cols = 80;                            ///< Terminal size written to the header
+    int rows = 25;
+    size_t maxQueuedBytes = 64 * 1024 * 1024; ///< Output waiting in memory at most
+    RecorderOverflow overflow = RecorderOverflow::Drop;
+    uint64_t maxSpillBytes = 1ull << 30;      ///< Spill: output waiting on disk at most
+    bool compress = false;                    ///< Write LZ4 frames
+    uint64_t rotateBytes = 0;                 ///< Start a new file past this size (0 = never)
+    uint32_t rotateSeconds = 0;               ///< Start a new file past this age (0 = never)
+};
+
+/// Records PTY output with timestamps on a background thread
+class PtyRecorder {
+public:
+    static constexpr size_t kWriteBytes = 1024 * 1024;    ///< Bytes per write
+    static constexpr size_t kWritesInFlight = 4;
+    static constexpr uint32_t kIdleFlushMillis = 1000;
+
+    PtyRecorder() = default;
+    ~PtyRecorder();
+
+    // Non-copyable, non-movable
+    PtyRecorder(const PtyRecorder&) = delete;
+    PtyRecorder& operator=(const PtyRecorder&) = delete;
+    PtyRecorder(PtyRecorder&&) = delete;
+    PtyRecorder& operator=(PtyRecorder&&) = delete;
+
+    /// Open the file, write the header and start the writer thread
+    /// @return true on success; on failure GetLastError() has the reason
+    [[nodiscard]] bool Start(const PtyRecorderConfig& config);
+
+    /// Write everything recorded so far, close the file and join the thread
+    void Stop();
+
+    /// Record one read of PTY output (any thread; never blocks on disk
+    /// unless the overflow policy is Block)
+    void Record(const char* data, size_t length);
+
+    /// Check if the recorder is running
+    [[nodiscard]] bool IsRecording() const noexcept { return m_running.load(); }
+
+    /// Get the number of bytes accepted for recording
+    [[nodiscard]] uint64_t GetBytesRecorded() const noexcept {
+        return m_bytesRecorded.load(std::memory_order_relaxed);
+    }
+
+    /// Get the number of bytes dropped because the writer fell behind
+    [[nodiscard]] uint64_t GetBytesDropped() const noexcept {
+        return m_bytesDropped.load(std::memory_order_relaxed);
+    }
+
+    /// Get the number of bytes that went through a spill file
+    [[nodiscard]] uint64_t GetBytesSpilled() const noexcept {
+        return m_bytesSpilled.load(std::memory_order_relaxed);
+    }
+
+    /// Check if a file write failed (later output is dropped)
+    [[nodiscard]] bool HasWriteFailed() const noexcept { return m_writeFailed.load(); }
+
+    /// Get the last error message
+    [[nodiscard]] const std::wstring& GetLastError() const noexcept { return m_lastError; }
+
+private:
+    /// Reads waiting to be written
+    struct Batch {
+        std::string bytes;
+        std::vector<std::pair<uint64_t, size_t>> reads; ///< (micros, length)
+
+        void Clear() {
+            bytes.clear();
+            reads.clear();
+        }
+    };
+
+    /// One overlapped write and its buffer
+    struct Write {
+        std::string data;
+        OVERLAPPED overlapped{};
+        wil::unique_event_nothrow done;
+        bool pending = false;
+    };
+
+    /// Writer thread procedure
+    void ThreadProc();
+
+    /// Append a read to the spill file (m_lock held)
+    /// @return false if it was dropped instead
+    [[nodiscard]] bool Spill(uint64_t micros, const char* data, size_t length);
+
+    // Writer thread
+    [[nodiscard]] bool OpenFile(const std::wstring& path);
+    void BeginFile(std::string& encoded);
+    void EndFile(std::string& encoded);
+    void WriteBatch(const Batch& batch, std::string& encoded);
+    void WriteSpill(std::FILE* spill, uint64_t bytes, Batch& batch, std::string& encoded);
+    void Emit(std::string_view bytes);
+    void Flush();
+    [[nodiscard]] bool Submit();
+    [[nodiscard]] bool Complete(Write& write);
+    void Fail();
+
+private:
+    // Set by Start()
+    std::wstring m_path;
+    RecordingFormat m_format = RecordingFormat::Binary;
+    int m_cols = 80;
+    int m_rows = 25;
+    size_t m_maxQueuedBytes = 0;
+    RecorderOverflow m_overflow = RecorderOverflow::Drop;
+    uint64_t m_maxSpillBytes = 0;
+    uint64_t m_rotateBytes = 0;
+    uint64_t m_rotateMicros = 0;
+    uint64_t m_startMicros = 0;
+
+    // Writer thread
+    RecordingEncoder m_encoder;
+    wil::unique_hfile m_file;
+    Write m_writes[kWritesInFlight];
+    size_t m_nextWrite = 0;
+    uint64_t m_fileOffset = 0;
+    uint32_t m_fileIndex = 0;
+    uint64_t m_fileMicros = 0;              ///< Recording time the current file started at
+    std::string m_out;                      ///< Output not yet submitted
+    bool m_unflushed = false;               ///< Output held in m_out or the compressor
+    LZ4F_cctx_s* m_compressor = nullptr;    ///< Null when not compressing
+
+    std::mutex m_lock;
+    std::condition_variable m_wake;         ///< Writer: output waiting or stop
+    std::condition_variable m_room;         ///< Block: the writer took a batch
+    Batch m_pending;                        ///< Guarded by m_lock
+    std::FILE* m_spill = nullptr;           ///< Guarded by m_lock
+    uint64_t m_spillBytes = 0;              ///< Complete reads in m_spill (guarded)
+    bool m_spillBroken = false;             ///< A spill write failed (guarded)
+    uint32_t m_spillFiles = 0;              ///< Guarded by m_lock
+    bool m_stopRequested = false;           ///< Guarded by m_lock
+
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+    std::atomic<uint64_t> m_bytesRecorded{0};
+    std::atomic<uint64_t> m_bytesDropped{0};
+    std::atomic<uint64_t> m_bytesSpilled{0};
+    std::atomic<bool> m_writeFailed{false};
+    std::wstring m_lastError;
+};
+
+} // namespace Console3::Core
@@ -0,0 +1,307 @@
+// Console3 - PtyRecording.cpp
+// Captured PTY output streams and their on-disk formats
+
+#include "Core/PtyRecording.h"
+#include "Core/Varint.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <nlohmann/json.hpp>
+
+namespace Console3::Core {
+
+using json = nlohmann::json;
+
+namespace {
+
+constexpr std::string_view kBinaryMagic = "C3PTYREC";
+constexpr uint64_t kBinaryVersion = 1;
+
+// U+FFFD REPLACEMENT CHARACTER
+constexpr std::string_view kReplacement = "\xEF\xBF\xBD";
+
+// ============================================================================
+// Binary format helpers
+// ============================================================================
+
+std::optional<PtyRecording> ParseBinary(std::string_view content) {
+    size_t pos = kBinaryMagic.size();
+    uint64_t version = 0, cols = 0, rows = 0, unixTime = 0;
+    if (!GetVarint(content, pos, version) || version != kBinaryVersion ||
+        !GetVarint(content, pos, cols) || !GetVarint(content, pos, rows) ||
+        !GetVarint(content, pos, unixTime)) {
+        return std::nullopt;
+    }
+
+    PtyRecording recording;
+    recording.cols = static_cast<int>(cols);
+    recording.rows = static_cast<int>(rows);
+
+    uint64_t micros = 0;
+    while (pos < content.size()) {
+        uint64_t delta = 0, length = 0;
+        if (!GetVarint(content, pos, delta) || !GetVarint(content, pos, length) ||
+            length > content.size() - pos) {
+            break;  // Truncated tail (recording cut short) - keep what is complete
+        }
+        micros += delta;
+        recording.Append(micros, content.substr(pos, static_cast<size_t>(length)));
+        pos += static_cast<size_t>(length);
+    }
+    return recording;
+}
+
+// ============================================================================
+// Asciicast helpers
+// ============================================================================
+
+/// Length of the UTF-8 sequence starting at bytes[pos]
+/// @return Sequence length, 0 if invalid, or -1 if valid so far but cut off
+int Utf8SequenceLength(std::string_view bytes, size_t pos) {
+    const auto lead = static_cast<uint8_t>(bytes[pos]);
+    int length = 0;
+    uint8_t lo = 0x80, hi = 0xBF;  // Allowed range of the second byte
+
+    if (lead < 0x80) return 1;
+    if (lead >= 0xC2 && lead <= 0xDF) length = 2;
+    else if (lead >= 0xE0 && lead <= 0xEF) {
+        length = 3;
+        if (lead == 0xE0) lo = 0xA0;        // Overlong
+        if (lead == 0xED) hi = 0x9F;        // Surrogates
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        length = 4;
+        if (lead == 0xF0) lo = 0x90;        // Overlong
+        if (lead == 0xF4) hi = 0x8F;        // Beyond U+10FFFF
+    } else {
+        return 0;
+    }
+
+    for (int i = 1; i < length; ++i) {
+        if (pos + i >= bytes.size()) {
+            return -1;
+        }
+        const auto c = static_cast<uint8_t>(bytes[pos + i]);
+        if (i == 1 ? (c < lo || c > hi) : (c < 0x80 || c > 0xBF)) {
+            return 0;
+        }
+    }
+    return length;
+}
+
+/// Append bytes as the body of a JSON string
+/// @return Bytes consumed; a cut-off UTF-8 sequence at the end is left over
+size_t AppendJsonText(std::string_view bytes, std::string& out) {
+    static constexpr char hex[] = "0123456789abcdef";
+
+    size_t pos = 0;
+    while (pos < bytes.size()) {
+        const auto c = static_cast<uint8_t>(bytes[pos]);
+        if (c >= 0x80) {
+            const int length = Utf8SequenceLength(bytes, pos);
+            if (length < 0) {
+                break;
+            }
+            if (length == 0) {
+                out += kReplacement;
+                ++pos;
+            } else {
+                out.append(bytes.substr(pos, length));
+                pos += length;
+            }
+            continue;
+        }
+
+        switch (c) {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        default:
+            if (c < 0x20 || c == 0x7F) {
+                out += "\\u00";
+                out += hex[c >> 4];
+                out += hex[c & 0xF];
+            } else {
+                out += static_cast<char>(c);
+            }
+            break;
+        }
+        ++pos;
+    }
+    return pos;
+}
+
+void AppendAsciicastEvent(uint64_t micros, std::string_view text, std::string& out) {
+    char time[32];
+    std::snprintf(time, sizeof(time), "[%.6f, \"o\", \"", micros / 1e6);
+    out += time;
+    out += text;
+    out += "\"]\n";
+}
+
+std::optional<PtyRecording> ParseAsciicast(std::string_view content) {
+    PtyRecording recording;
+    bool haveHeader = false;
+
+    size_t pos = 0;
+    while (pos < content.size()) {
+        size_t end = content.find('\n', pos);
+        if (end == std::string_view::npos) end = content.size();
+        const std::string_view line = content.substr(pos, end - pos);
+        pos = end + 1;
+
+        if (line.find_first_not_of(" \t\r") == std::string_view::npos) {
+            continue;
+        }
+
+        const json value = json::parse(line.begin(), line.end(), nullptr, false);
+        if (value.is_discarded()) {
+            if (!haveHeader) return std::nullopt;
+            continue;  // Skip a damaged line rather than lose the rest
+        }
+
+        if (!haveHeader) {
+            if (!value.is_object() || value.value("version", 0) != 2) {
+                return std::nullopt;
+            }
+            recording.cols = value.value("width", 80);
+            recording.rows = value.value("height", 25);
+            haveHeader = true;
+            continue;
+        }
+
+        // [time, "o", data]; input and resize events are not replayed
+        if (!value.is_array() || value.size() < 3 || !value[0].is_number() ||
+            value[1] != "o" || !value[2].is_string()) {
+            continue;
+        }
+        const double seconds = value[0].get<double>();
+        const auto micros = static_cast<uint64_t>(std::llround(std::max(seconds, 0.0) * 1e6));
+        recording.Append(std::max(micros, recording.GetDurationMicros()),
+                         value[2].get_ref<const std::string&>());
+    }
+
+    if (!haveHeader) {
+        return std::nullopt;
+    }
+    return recording;
+}
+
+} // namespace
+
+// ============================================================================
+// PtyRecording
+// ============================================================================
+
+void PtyRecording::Append(uint64_t micros, std::string_view bytes) {
+    if (bytes.empty()) {
+        return;
+    }
+    events.push_back({micros, data.size(), bytes.size()});
+    data.append(bytes);
+}
+
+std::optional<PtyRecording> PtyRecording::Parse(std::string_view content) {
+    if (content.substr(0, kBinaryMagic.size()) == kBinaryMagic) {
+        return ParseBinary(content);
+    }
+
+    const size_t first = content.find_first_not_of(" \t\r\n");
+    if (first != std::string_view::npos && content[first] == '{') {
+        return ParseAsciicast(content);
+    }
+    return std::nullopt;
+}
+
+std::optional<PtyRecording> PtyRecording::Load(const std::wstring& path) {
+    std::ifstream file(std::filesystem::path(path), std::ios::binary);
+    if (!file) {
+        return std::nullopt;
+    }
+
+    const std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return Parse(content);
+}
+
+// ============================================================================
+// RecordingEncoder
+// ============================================================================
+
+void RecordingEncoder::EncodeHeader(int cols, int rows, int64_t unixTime, std::string& out) {
+    m_lastMicros = 0;
+    m_carry.clear();
+
+    if (m_format == RecordingFormat::Raw) {
+        return;
+    }
+    if (m_format == RecordingFormat::Binary) {
+        out += kBinaryMagic;
+        PutVarint(out, kBinaryVersion);
+        PutVarint(out, static_cast<uint64_t>(std::max(cols, 0)));
+        PutVarint(out, static_cast<uint64_t>(std::max(rows, 0)));
+        PutVarint(out, static_cast<uint64_t>(std::max<int64_t>(unixTime, 0)));
+        return;
+    }
+
+    char header[160];
+    std::snprintf(header, sizeof(header),
+                  "{\"version\": 2, \"width\": %d, \"height\": %d, \"timestamp\": %lld}\n",
+                  cols, rows, static_cast<long long>(unixTime));
+    out += header;
+}
+
+void RecordingEncoder::EncodeEvent(uint64_t micros, std::string_view bytes, std::string& out) {
+    micros = std::max(micros, m_lastMicros);
+
+    if (m_format == RecordingFormat::Raw) {
+        out.append(bytes);
+        return;
+    }
+    if (m_format == RecordingFormat::Binary) {
+        if (bytes.empty()) {
+            return;
+        }
+        PutVarint(out, micros - m_lastMicros);
+        PutVarint(out, bytes.size());
+        out.append(bytes);
+        m_lastMicros = micros;
+        return;
+    }
+
+    // A UTF-8 sequence split across reads is emitted with the later read.
+    // Splits are rare, so joining the carried bytes with a copy is fine.
+    std::string joined;
+    if (!m_carry.empty()) {
+        joined = std::move(m_carry);
+        joined.append(bytes);
+        bytes = joined;
+    }
+
+    std::string text;
+    const size_t consumed = AppendJsonText(bytes, text);
+    m_carry.assign(bytes.substr(consumed));
+
+    if (!text.empty()) {
+        AppendAsciicastEvent(micros, text, out);
+        m_lastMicros = micros;
+    }
+}
+
+void RecordingEncoder::Finish(std::string& out) {
+    if (m_format == RecordingFormat::Asciicast && !m_carry.empty()) {
+        std::string text;
+        for (size_t i = 0; i < m_carry.size(); ++i) {
+            text += kReplacement;
+        }
+        AppendAsciicastEvent(m_lastMicros, text, out);
+    }
+    m_carry.clear();
+}
+
+} // namespace Console3::Core
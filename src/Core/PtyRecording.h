@@ -0,0 +1,86 @@
+#pragma once
+// Console3 - PtyRecording.h
+// Captured PTY output streams and their on-disk formats
+//
+// A recording is the raw ConPTY output of a session, split at the original
+// read boundaries and timestamped, so a performance problem seen in the wild
+// can be replayed byte for byte - at recorded speed or as fast as possible.
+//
+//   Binary    - "C3PTYREC" header, then per read a LEB128 time delta in
+//               microseconds, a LEB128 length and the bytes. Exact.
+//   Asciicast - asciicast v2 (JSON lines, playable with asciinema). Output
+//               is stored as UTF-8 text, so invalid bytes become U+FFFD.
+//   Raw       - the output bytes alone, no header or times: a session log
+//               (console3 --view shows one). Not parsed as a recording.
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Console3::Core {
+
+/// On-disk recording format
+enum class RecordingFormat {
+    Binary,     ///< Compact timestamped chunks, exact bytes
+    Asciicast,  ///< asciicast v2 JSON lines
+    Raw         ///< Output bytes only
+};
+
+/// One read of PTY output
+struct RecordingEvent {
+    uint64_t micros = 0;    ///< Time since the recording started
+    size_t offset = 0;      ///< Start of the bytes in PtyRecording::data
+    size_t length = 0;      ///< Number of bytes
+};
+
+/// A captured PTY output stream
+struct PtyRecording {
+    int cols = 80;                       ///< Terminal size when recording started
+    int rows = 25;
+    std::string data;                    ///< All output bytes, in order
+    std::vector<RecordingEvent> events;  ///< Read boundaries and timestamps
+
+    /// Append one read
+    void Append(uint64_t micros, std::string_view bytes);
+
+    /// Get the time of the last event
+    [[nodiscard]] uint64_t GetDurationMicros() const noexcept {
+        return events.empty() ? 0 : events.back().micros;
+    }
+
+    /// Parse a recording in either format (detected from the content)
+    /// @return The recording, or nullopt if the content is not a recording
+    [[nodiscard]] static std::optional<PtyRecording> Parse(std::string_view content);
+
+    /// Load and parse a recording file
+    /// @return The recording, or nullopt if the file cannot be read or parsed
+    [[nodiscard]] static std::optional<PtyRecording> Load(const std::wstring& path);
+};
+
+/// Incremental writer for either recording format
+class RecordingEncoder {
+public:
+    explicit RecordingEncoder(RecordingFormat format = RecordingFormat::Binary) noexcept
+        : m_format(format) {}
+
+    /// Append the file header
+    /// @param unixTime Recording start (asciicast "timestamp")
+    void EncodeHeader(int cols, int rows, int64_t unixTime, std::string& out);
+
+    /// Append one read
+    /// @param micros Time since the recording started (non-decreasing)
+    void EncodeEvent(uint64_t micros, std::string_view bytes, std::string& out);
+
+    /// Append anything still held back (a UTF-8 sequence cut off at the end)
+    void Finish(std::string& out);
+
+private:
+    RecordingFormat m_format;
+    uint64_t m_lastMicros = 0;
+    std::string m_carry;    ///< Asciicast: incomplete UTF-8 tail of the last read
+};
+
+} // namespace Console3::Core
@@ -4,7 +4,7 @@
 // Implements pipe creation, pseudo console lifecycle, and process management
 
 #include "Core/PtySession.h"
-#include <array>
+#include "Core/WslRelay.h"
 #include <cassert>
 #include <vector>
 
@@ -13,6 +13,14 @@ namespace Console3::Core {
 // Buffer size for PTY I/O operations
 constexpr DWORD kPtyBufferSize = 4096;
 
+// How long to wait for wsl.exe to exit once the relay's output ends
+constexpr DWORD kRelayExitWaitMs = 1000;
+
+namespace {
+// Unique suffix for overlapped output pipe names within this process
+std::atomic<uint32_t> g_pipeSerial{0};
+} // namespace
+
 PtySession::~PtySession() { Stop(); }
 
 bool PtySession::Start(const PtyConfig &config) {
@@ -26,24 +34,98 @@ bool PtySession::Start(const PtyConfig &config) {
   m_cols = config.cols;
   m_rows = config.rows;
 
-  // Step 1: Create the pipes for PTY communication
-  if (!CreatePipes()) {
+  if (!m_outputBuffer) {
+    m_lastError = L"No output buffer set";
     return false;
   }
 
-  // Step 2: Create the pseudo console with initial size
-  if (!CreatePseudoConsoleHandle(config.cols, config.rows)) {
+  // Replay has no pipe to read; it is for driving a buffer without a PTY
+  if (config.transport == PtyTransportEngine::Replay) {
+    m_lastError = L"Replay transport cannot read a pseudo console";
     return false;
   }
 
-  // Step 3: Launch the shell process
-  if (!LaunchProcess(config)) {
+  const bool serial = !config.serial.port.empty();
+  const bool useCompletionPort =
+      config.transport == PtyTransportEngine::CompletionPort;
+
+  // A serial port stands in for steps 1 to 3: no pipes, no pseudo
+  // console, no process
+  if (serial) {
+    if (!StartSerial(config.serial)) {
+      return false;
+    }
+  } else {
+    // Step 1: Create the pipes for PTY communication
+    if (!CreatePipes(useCompletionPort)) {
+      return false;
+    }
+
+    // The shell's process tree gets a job of its own (without one it runs
+    // like any child of ours, just without per-tab priority and accounting)
+    (void)m_job.Create();
+
+    // Steps 2 and 3: Create the pseudo console with initial size and
+    // launch the shell on it, or give a plain WSL shell the pipes themselves
+    const std::optional<std::wstring> relayDistro =
+        config.wslRelay ? GetWslRelayDistro(config.shell, config.args)
+                        : std::nullopt;
+    if (relayDistro && IsWslRelayInstalled()) {
+      if (!StartWslRelay(config, *relayDistro)) {
+        return false;
+      }
+    } else {
+      if (!CreatePseudoConsoleHandle(config.cols, config.rows,
+                                     config.sideBySideConpty)) {
+        return false;
+      }
+      if (!LaunchProcess(config)) {
+        return false;
+      }
+    }
+  }
+
+  // Step 4: Start the input writer so Write() never blocks the caller; a
+  // serial port is written on the handle it is read on
+  PtyInputWriterConfig writerConfig;
+  writerConfig.writeHandle = serial ? m_ptyOut.get() : m_ptyIn.get();
+  writerConfig.overlapped = serial;
+  writerConfig.latencyProbe = config.latencyProbe;
+  m_inputWriter = std::make_unique<PtyInputWriter>();
+  if (!m_inputWriter->Start(writerConfig)) {
+    m_inputWriter.reset();
+    m_lastError = L"Failed to start PTY input writer";
     return false;
   }
 
-  // Step 4: Start the I/O reader thread
+  // Step 5: Start reading output into the buffer
+  PtyTransportConfig transportConfig;
+  transportConfig.readHandle = m_ptyOut.get();
+  transportConfig.output = m_outputBuffer;
+  transportConfig.onClosed = [this](DWORD errorCode) { OnOutputClosed(errorCode); };
+  transportConfig.readSize = kPtyBufferSize;
+  transportConfig.adaptiveReadSize = config.adaptiveReadSize;
+  transportConfig.maxReadSize = config.maxReadSize;
+  transportConfig.readsInFlight = config.readsInFlight;
+  transportConfig.recorder = config.recorder;
+  if (config.earlyQueryReplies) {
+    // Replies take the writer's priority lane, ahead of any paste
+    m_responder = std::make_shared<QueryResponder>(
+        [writer = m_inputWriter.get()](std::string_view reply) {
+          (void)writer->Enqueue(reply);
+        });
+    transportConfig.responder = m_responder;
+  }
+
   m_running.store(true);
-  m_ioThread = std::thread(&PtySession::IoThreadProc, this);
+  m_transport =
+      PtyTransport::Create(serial ? PtyTransportEngine::Serial : config.transport);
+  if (!m_transport->Start(transportConfig)) {
+    m_running.store(false);
+    m_lastError = m_transport->GetLastError();
+    m_transport.reset();
+    return false;
+  }
 
   return true;
 }
@@ -56,9 +138,18 @@ void PtySession::Stop() {
   // and unblock any pending ReadFile calls
   m_hPCon.reset();
 
-  // Wait for IO thread to finish
-  if (m_ioThread.joinable()) {
-    m_ioThread.join();
+  // Abort pending reads and wait until the transport is done with the
+  // output buffer (and its query responder with the input writer)
+  if (m_transport) {
+    m_transport->Stop();
+    m_transport.reset();
+  }
+  m_responder.reset();
+
+  // Drop queued input and abort a write blocked on the input pipe
+  if (m_inputWriter) {
+    m_inputWriter->Stop();
+    m_inputWriter.reset();
   }
 
   // Terminate process if still running
@@ -67,6 +158,13 @@ void PtySession::Stop() {
     m_processInfo.reset();
   }
 
+  // The relay's forwarder exits when its pipe closes; make sure of it
+  m_controlIn.reset();
+  if (m_controlProcess.hProcess) {
+    TerminateProcess(m_controlProcess.hProcess, 0);
+    m_controlProcess.reset();
+  }
+
   // Close all pipes
   m_pipeIn.reset();
   m_pipeOut.reset();
@@ -77,25 +175,80 @@ void PtySession::Stop() {
 bool PtySession::IsRunning() const noexcept { return m_running.load(); }
 
 int PtySession::Write(const char *data, size_t length) {
-  if (!m_running.load() || !m_ptyIn) {
+  if (!m_running.load() || !m_inputWriter) {
     return -1;
   }
 
-  DWORD bytesWritten = 0;
-  if (!WriteFile(m_ptyIn.get(), data, static_cast<DWORD>(length), &bytesWritten,
-                 nullptr)) {
-    SetLastErrorFromWin32();
+  if (!m_inputWriter->Enqueue(std::string_view(data, length))) {
+    if (m_inputWriter->GetLastErrorCode() != ERROR_SUCCESS) {
+      ::SetLastError(m_inputWriter->GetLastErrorCode());
+      SetLastErrorFromWin32();
+    } else {
+      m_lastError = L"PTY input queue is full";
+    }
     return -1;
   }
 
-  return static_cast<int>(bytesWritten);
+  return static_cast<int>(length);
 }
 
 int PtySession::Write(std::string_view text) {
   return Write(text.data(), text.size());
 }
 
+bool PtySession::Paste(std::string_view text, bool bracketed) {
+  if (!m_running.load() || !m_inputWriter) {
+    return false;
+  }
+  return m_inputWriter->EnqueuePaste(text, bracketed);
+}
+
+bool PtySession::Paste(std::wstring text, bool bracketed) {
+  if (!m_running.load() || !m_inputWriter) {
+    return false;
+  }
+  return m_inputWriter->EnqueuePaste(std::move(text), bracketed);
+}
+
+size_t PtySession::CancelPaste() {
+  return m_inputWriter ? m_inputWriter->CancelPaste() : 0;
+}
+
+bool PtySession::IsPasting() const {
+  return m_inputWriter && m_inputWriter->IsPasting();
+}
+
+PasteProgress PtySession::GetPasteProgress() const {
+  return m_inputWriter ? m_inputWriter->GetPasteProgress() : PasteProgress{};
+}
+
+size_t PtySession::GetPendingInput() const {
+  return m_inputWriter ? m_inputWriter->GetPendingBytes() : 0;
+}
+
 bool PtySession::Resize(int cols, int rows) {
+  // The device on the line has no idea of our size
+  if (m_consoleKind == PseudoConsoleKind::Serial) {
+    m_cols = cols;
+    m_rows = rows;
+    return true;
+  }
+
+  if (m_consoleKind == PseudoConsoleKind::WslRelay) {
+    const std::string message = MakeWslRelayResize(cols, rows);
+    DWORD written = 0;
+    if (!m_controlIn ||
+        !WriteFile(m_controlIn.get(), message.data(),
+                   static_cast<DWORD>(message.size()), &written, nullptr) ||
+        written != message.size()) {
+      m_lastError = L"WSL relay control pipe is closed or full";
+      return false;
+    }
+    m_cols = cols;
+    m_rows = rows;
+    return true;
+  }
+
   if (!m_hPCon) {
     m_lastError = L"Pseudo console not initialized";
     return false;
@@ -105,7 +258,7 @@ bool PtySession::Resize(int cols, int rows) {
   size.X = static_cast<SHORT>(cols);
   size.Y = static_cast<SHORT>(rows);
 
-  HRESULT hr = ResizePseudoConsole(m_hPCon.get(), size);
+  HRESULT hr = m_hPCon.get_deleter().api->resize(m_hPCon.get(), size);
   if (FAILED(hr)) {
     m_lastError =
         L"ResizePseudoConsole failed with HRESULT: " + std::to_wstring(hr);
@@ -117,8 +270,8 @@ bool PtySession::Resize(int cols, int rows) {
   return true;
 }
 
-void PtySession::SetOutputCallback(OutputCallback callback) {
-  m_outputCallback = std::move(callback);
+void PtySession::SetOutputBuffer(SegmentedRingBuffer *buffer) {
+  m_outputBuffer = buffer;
 }
 
 void PtySession::SetExitCallback(ExitCallback callback) {
@@ -141,7 +294,7 @@ const std::wstring &PtySession::GetLastError() const noexcept {
 // Private Implementation
 // ============================================================================
 
-bool PtySession::CreatePipes() {
+bool PtySession::CreatePipes(bool overlappedOutput) {
   // We need two pairs of pipes:
   // 1. pipeIn/ptyIn: We write to ptyIn, PTY reads from pipeIn
   // 2. ptyOut/pipeOut: PTY writes to pipeOut, we read from ptyOut
@@ -174,9 +327,15 @@ bool PtySession::CreatePipes() {
 
   // Create the OUTPUT pipe pair (shell's stdout comes to us)
   // PTY writes to m_pipeOut, we read from m_ptyOut
+  if (overlappedOutput) {
+    return CreateOverlappedOutputPipe(sa);
+  }
+
+  // Size the pipe like the overlapped one so large adaptive reads can
+  // actually be satisfied in one call
   HANDLE hPipeOutRead = nullptr;
   HANDLE hPipeOutWrite = nullptr;
-  if (!CreatePipe(&hPipeOutRead, &hPipeOutWrite, &sa, 0)) {
+  if (!CreatePipe(&hPipeOutRead, &hPipeOutWrite, &sa, kPtyBufferSize * 16)) {
     SetLastErrorFromWin32();
     return false;
   }
@@ -192,20 +351,59 @@ bool PtySession::CreatePipes() {
   return true;
 }
 
-bool PtySession::CreatePseudoConsoleHandle(int cols, int rows) {
+bool PtySession::CreateOverlappedOutputPipe(SECURITY_ATTRIBUTES &sa) {
+  // Anonymous pipes cannot be read with OVERLAPPED, so create a uniquely
+  // named pipe instead. Only our read end is overlapped; ConPTY writes to
+  // the client end synchronously as usual.
+  const std::wstring name = L"\\\\.\\pipe\\Console3-PtyOut-" +
+                            std::to_wstring(::GetCurrentProcessId()) + L"-" +
+                            std::to_wstring(g_pipeSerial.fetch_add(1));
+
+  HANDLE hPipeOutRead = CreateNamedPipeW(
+      name.c_str(),
+      PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+      PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT |
+          PIPE_REJECT_REMOTE_CLIENTS,
+      1,                                 // nMaxInstances
+      kPtyBufferSize * 16,               // nOutBufferSize
+      kPtyBufferSize * 16,               // nInBufferSize
+      0,                                 // nDefaultTimeOut
+      nullptr); // Not inherited by the child process
+  if (hPipeOutRead == INVALID_HANDLE_VALUE) {
+    SetLastErrorFromWin32();
+    return false;
+  }
+  m_ptyOut.reset(hPipeOutRead);
+
+  // Client end handed to ConPTY (inheritable, like the anonymous pipe)
+  HANDLE hPipeOutWrite =
+      CreateFileW(name.c_str(), GENERIC_WRITE, 0, &sa, OPEN_EXISTING,
+                  FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (hPipeOutWrite == INVALID_HANDLE_VALUE) {
+    SetLastErrorFromWin32();
+    return false;
+  }
+  m_pipeOut.reset(hPipeOutWrite);
+
+  return true;
+}
+
+bool PtySession::CreatePseudoConsoleHandle(int cols, int rows,
+                                           bool allowSideBySide) {
   COORD size{};
   size.X = static_cast<SHORT>(cols);
   size.Y = static_cast<SHORT>(rows);
 
-  // CreatePseudoConsole requires:
+  // The pseudo console needs:
   // - Input handle: where PTY reads from (our m_pipeIn read end)
   // - Output handle: where PTY writes to (our m_pipeOut write end)
   HPCON hPCon = nullptr;
-  HRESULT hr = CreatePseudoConsole(size,
-                                   m_pipeIn.get(),  // PTY reads input from here
-                                   m_pipeOut.get(), // PTY writes output here
-                                   0, // dwFlags (0 for default behavior)
-                                   &hPCon);
+  const PseudoConsoleApi *api = nullptr;
+  PseudoConsoleKind kind = PseudoConsoleKind::None;
+  HRESULT hr = CreateBestPseudoConsole(size,
+                                       m_pipeIn.get(),  // PTY reads input from here
+                                       m_pipeOut.get(), // PTY writes output here
+                                       allowSideBySide, hPCon, api, kind);
 
   if (FAILED(hr)) {
     m_lastError =
@@ -213,8 +411,9 @@ bool PtySession::CreatePseudoConsoleHandle(int cols, int rows) {
     return false;
   }
 
-  // Store in RAII wrapper
-  m_hPCon.reset(hPCon);
+  // Store in RAII wrapper, closed by the implementation that made it
+  m_hPCon = unique_hpcon(hPCon, HpconDeleter{api});
+  m_consoleKind = kind;
   return true;
 }
 
@@ -265,7 +464,7 @@ bool PtySession::LaunchProcess(const PtyConfig &config) {
                      nullptr,        // lpProcessAttributes
                      nullptr,        // lpThreadAttributes
                      FALSE,          // bInheritHandles
-                     EXTENDED_STARTUPINFO_PRESENT |
+                     EXTENDED_STARTUPINFO_PRESENT | CREATE_SUSPENDED |
                          CREATE_UNICODE_ENVIRONMENT, // dwCreationFlags
                      nullptr,                        // lpEnvironment
                      config.workingDir.empty()
@@ -282,6 +481,7 @@ bool PtySession::LaunchProcess(const PtyConfig &config) {
     SetLastErrorFromWin32();
     return false;
   }
+  EnterJob(procInfo);
 
   // Store the process information using WIL RAII wrapper
   m_processInfo.hProcess = procInfo.hProcess;
@@ -292,30 +492,151 @@ bool PtySession::LaunchProcess(const PtyConfig &config) {
   return true;
 }
 
-void PtySession::IoThreadProc() {
-  std::array<char, kPtyBufferSize> buffer{};
+bool PtySession::StartSerial(const SerialSettings &serial) {
+  m_ptyOut = OpenSerialPort(serial);
+  if (!m_ptyOut) {
+    SetLastErrorFromWin32();
+    m_lastError = serial.port + L": " + m_lastError;
+    return false;
+  }
+  m_consoleKind = PseudoConsoleKind::Serial;
+  return true;
+}
+
+bool PtySession::StartWslRelay(const PtyConfig &config,
+                               const std::wstring &distro) {
+  const WslRelayCommands commands =
+      MakeWslRelayCommands(distro, config.cols, config.rows);
+
+  // Control pipe: the forwarder reads the resize messages we write
+  SECURITY_ATTRIBUTES sa{};
+  sa.nLength = sizeof(sa);
+  sa.bInheritHandle = TRUE;
+  HANDLE hControlRead = nullptr;
+  HANDLE hControlWrite = nullptr;
+  if (!CreatePipe(&hControlRead, &hControlWrite, &sa, 0)) {
+    SetLastErrorFromWin32();
+    return false;
+  }
+  wil::unique_hfile controlRead(hControlRead);
+  m_controlIn.reset(hControlWrite);
+
+  // Our end is neither inherited nor blocking: a stalled forwarder loses a
+  // resize rather than hanging the caller
+  DWORD mode = PIPE_NOWAIT;
+  if (!SetHandleInformation(m_controlIn.get(), HANDLE_FLAG_INHERIT, 0) ||
+      !SetNamedPipeHandleState(m_controlIn.get(), &mode, nullptr, nullptr)) {
+    SetLastErrorFromWin32();
+    return false;
+  }
+
+  PROCESS_INFORMATION procInfo{};
+  if (!LaunchPiped(commands.relay, m_pipeIn.get(), m_pipeOut.get(),
+                   procInfo)) {
+    return false;
+  }
+  m_processInfo.hProcess = procInfo.hProcess;
+  m_processInfo.hThread = procInfo.hThread;
+  m_processInfo.dwProcessId = procInfo.dwProcessId;
+  m_processInfo.dwThreadId = procInfo.dwThreadId;
+
+  // wsl.exe holds the only other copies of these ends now, so its exit
+  // closes the output pipe as a pseudo console's would
+  m_pipeIn.reset();
+  m_pipeOut.reset();
+
+  // Without the forwarder the shell still runs, at its initial size
+  PROCESS_INFORMATION forwardInfo{};
+  if (LaunchPiped(commands.forward, controlRead.get(), nullptr,
+                  forwardInfo)) {
+    m_controlProcess.hProcess = forwardInfo.hProcess;
+    m_controlProcess.hThread = forwardInfo.hThread;
+    m_controlProcess.dwProcessId = forwardInfo.dwProcessId;
+    m_controlProcess.dwThreadId = forwardInfo.dwThreadId;
+  } else {
+    m_controlIn.reset();
+  }
+
+  m_consoleKind = PseudoConsoleKind::WslRelay;
+  return true;
+}
+
+bool PtySession::LaunchPiped(std::wstring cmdLine, HANDLE input, HANDLE output,
+                             PROCESS_INFORMATION &procInfo) {
+  STARTUPINFOEXW siEx{};
+  siEx.StartupInfo.cb = sizeof(STARTUPINFOEXW);
+  siEx.StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+  siEx.StartupInfo.hStdInput = input;
+  siEx.StartupInfo.hStdOutput = output;
+  siEx.StartupInfo.hStdError = output;
+
+  SIZE_T attrListSize = 0;
+  InitializeProcThreadAttributeList(nullptr, 1, 0, &attrListSize);
+  std::vector<BYTE> attrListBuffer(attrListSize);
+  siEx.lpAttributeList =
+      reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(attrListBuffer.data());
+  if (attrListSize == 0 ||
+      !InitializeProcThreadAttributeList(siEx.lpAttributeList, 1, 0,
+                                         &attrListSize)) {
+    SetLastErrorFromWin32();
+    return false;
+  }
+
+  // Inherit just the standard handles, not every inheritable handle of ours
+  HANDLE inherit[2] = {input, output};
+  const SIZE_T inheritCount = output ? 2 : 1;
+  if (!UpdateProcThreadAttribute(siEx.lpAttributeList, 0,
+                                 PROC_THREAD_ATTRIBUTE_HANDLE_LIST, inherit,
+                                 inheritCount * sizeof(HANDLE), nullptr,
+                                 nullptr)) {
+    DeleteProcThreadAttributeList(siEx.lpAttributeList);
+    SetLastErrorFromWin32();
+    return false;
+  }
 
-  while (m_running.load()) {
-    DWORD bytesRead = 0;
+  const BOOL success = CreateProcessW(
+      nullptr, cmdLine.data(), nullptr, nullptr,
+      TRUE, // bInheritHandles (limited by the handle list)
+      EXTENDED_STARTUPINFO_PRESENT | CREATE_NO_WINDOW | CREATE_SUSPENDED |
+          CREATE_UNICODE_ENVIRONMENT,
+      nullptr, nullptr, &siEx.StartupInfo, &procInfo);
+  DeleteProcThreadAttributeList(siEx.lpAttributeList);
 
-    // Read from the PTY output pipe (blocking call)
-    BOOL success =
-        ReadFile(m_ptyOut.get(), buffer.data(),
-                 static_cast<DWORD>(buffer.size()), &bytesRead, nullptr);
+  if (!success) {
+    SetLastErrorFromWin32();
+    return false;
+  }
+  EnterJob(procInfo);
+  return true;
+}
 
-    if (!success || bytesRead == 0) {
-      // Pipe closed or error - shell probably exited
-      break;
-    }
+void PtySession::EnterJob(const PROCESS_INFORMATION &procInfo) {
+  // Created suspended, so nothing it starts can escape the job; a process
+  // the job cannot take (ours may be in a job that forbids nesting) runs
+  // outside it
+  if (m_job.Get()) {
+    (void)AssignProcessToJobObject(m_job.Get(), procInfo.hProcess);
+  }
+  ResumeThread(procInfo.hThread);
+}
 
-    // Dispatch output to callback
-    if (m_outputCallback && bytesRead > 0) {
-      m_outputCallback(buffer.data(), static_cast<size_t>(bytesRead));
+void PtySession::OnOutputClosed(DWORD errorCode) {
+  // A serial port ends when it goes away (an adapter unplugged); the
+  // session exits with the error, as a shell would with its code
+  if (m_consoleKind == PseudoConsoleKind::Serial) {
+    if (m_running.load() && m_exitCallback) {
+      m_exitCallback(errorCode);
     }
+    m_running.store(false);
+    return;
   }
 
   // Check for process exit
   if (m_processInfo.hProcess) {
+    // wsl.exe exits a moment after the relay's output ends
+    if (m_consoleKind == PseudoConsoleKind::WslRelay) {
+      WaitForSingleObject(m_processInfo.hProcess, kRelayExitWaitMs);
+    }
     DWORD exitCode = 0;
     if (GetExitCodeProcess(m_processInfo.hProcess, &exitCode)) {
       if (exitCode != STILL_ACTIVE && m_exitCallback) {
@@ -4,8 +4,11 @@
 //
 // This class manages a single pseudo console session, including:
 // - Creating pipes for input/output
-// - Creating the pseudo console via CreatePseudoConsole
-// - Launching the shell process
+// - Creating the pseudo console (a side-by-side conpty.dll if present, see
+//   PseudoConsole.h; CreatePseudoConsole otherwise), or none for a WSL
+//   shell run through console3-relay (WslRelay.h), or none and no process
+//   for a serial port (SerialPort.h)
+// - Launching the shell process, in a job of its own (ProcessJob.h)
 // - Resizing the terminal
 // - Graceful shutdown
 
@@ -20,18 +23,21 @@
 #include <Windows.h>
 #include <atomic>
 #include <functional>
+#include <memory>
 #include <string>
-#include <thread>
 
+#include "Core/ProcessJob.h"
+#include "Core/PseudoConsole.h"
+#include "Core/PtyInputWriter.h"
+#include "Core/PtyTransport.h"
+#include "Core/SegmentedRingBuffer.h"
+#include "Core/SerialPort.h"
 
 // WIL for RAII handle management
 #include <wil/resource.h>
 
 namespace Console3::Core {
 
-/// Callback type for receiving output data from the PTY
-using OutputCallback = std::function<void(const char *data, size_t length)>;
-
 /// Callback type for process exit notification
 using ExitCallback = std::function<void(DWORD exitCode)>;
 
@@ -42,13 +48,26 @@ struct PtyConfig {
   std::wstring workingDir;         ///< Initial working directory
   int cols = 80;                   ///< Initial column count
   int rows = 25;                   ///< Initial row count
+  PtyTransportEngine transport = PtyTransportEngine::Thread; ///< Output engine
+  size_t readsInFlight = 2; ///< Pending reads per pipe (CompletionPort)
+  bool adaptiveReadSize = true; ///< Grow reads during bulk output (Thread)
+  size_t maxReadSize = AdaptiveReadSize::kDefaultMax; ///< Adaptive read cap
+  std::shared_ptr<PtyRecorder> recorder; ///< Records all output (optional)
+  InputLatencyProbe *latencyProbe = nullptr; ///< Keystroke latency probe (optional)
+  bool sideBySideConpty = true; ///< Prefer a conpty.dll next to the executable
+  bool wslRelay = true; ///< Run a plain wsl.exe through console3-relay if installed
+  bool earlyQueryReplies = true; ///< Answer DA/DSR as output arrives (QueryResponder.h)
+  SerialSettings serial; ///< Open this port instead of a shell (when port is set)
 };
 
 /// RAII wrapper for HPCON (Pseudo Console handle)
+/// Closed by the implementation that created it.
 struct HpconDeleter {
+  const PseudoConsoleApi *api = nullptr;
+
   void operator()(HPCON hpc) const noexcept {
-    if (hpc) {
-      ClosePseudoConsole(hpc);
+    if (hpc && api) {
+      api->close(hpc);
     }
   }
 };
@@ -79,28 +98,73 @@ public:
   [[nodiscard]] bool IsRunning() const noexcept;
 
   /// Write data to the PTY input (sends to shell)
+  /// The data is queued for the input writer thread, so this never blocks
+  /// on a full pipe; keystrokes queued during a write are coalesced.
   /// @param data Data buffer to write
   /// @param length Length of data in bytes
-  /// @return Number of bytes written, or -1 on error
+  /// @return Number of bytes queued, or -1 on error
   [[nodiscard]] int Write(const char *data, size_t length);
 
   /// Write a string to the PTY input
   /// @param text String to write
-  /// @return Number of bytes written, or -1 on error
+  /// @return Number of bytes queued, or -1 on error
   [[nodiscard]] int Write(std::string_view text);
 
+  /// Queue a paste, streamed to the PTY in bounded chunks
+  /// @param text Paste contents (UTF-8)
+  /// @param bracketed Wrap in bracketed paste markers
+  /// @return true if queued
+  [[nodiscard]] bool Paste(std::string_view text, bool bracketed);
+
+  /// Queue a paste of UTF-16 text, converted to UTF-8 a chunk at a time as
+  /// it is written
+  /// @return true if queued
+  [[nodiscard]] bool Paste(std::wstring text, bool bracketed);
+
+  /// Abort a paste in progress (input typed since is kept)
+  /// @return Number of paste bytes discarded
+  size_t CancelPaste();
+
+  /// Check if a paste is still being streamed
+  [[nodiscard]] bool IsPasting() const;
+
+  /// Get how far the pastes in flight have got
+  [[nodiscard]] PasteProgress GetPasteProgress() const;
+
+  /// Get the number of input bytes waiting to be written
+  [[nodiscard]] size_t GetPendingInput() const;
+
   /// Resize the pseudo console
   /// @param cols New column count
   /// @param rows New row count
   /// @return true on success
   [[nodiscard]] bool Resize(int cols, int rows);
 
-  /// Set callback for receiving output data
-  void SetOutputCallback(OutputCallback callback);
+  /// Set the buffer PTY output is delivered into (required)
+  /// The transport applies the buffer's watermarks as backpressure. Must be
+  /// called before Start() and outlive the session.
+  /// @param buffer Buffer to fill (not owned)
+  void SetOutputBuffer(SegmentedRingBuffer *buffer);
 
   /// Set callback for process exit notification
+  /// Called on the transport thread, so set it before Start().
   void SetExitCallback(ExitCallback callback);
 
+  /// Replace the keystroke latency probe of a running session
+  void SetLatencyProbe(InputLatencyProbe *probe) noexcept {
+    if (m_inputWriter) {
+      m_inputWriter->SetLatencyProbe(probe);
+    }
+  }
+
+  /// Set the session ID the transport's pipeline trace events are tagged
+  /// with (see PipelineTrace.h)
+  void SetTraceSessionId(uint32_t sessionId) noexcept {
+    if (m_transport) {
+      m_transport->SetTraceSessionId(sessionId);
+    }
+  }
+
   /// Get the current terminal size
   [[nodiscard]] std::pair<int, int> GetSize() const noexcept;
 
@@ -110,18 +174,78 @@ public:
   /// Get the last error message
   [[nodiscard]] const std::wstring &GetLastError() const noexcept;
 
+  /// Get which pseudo console the session runs on
+  [[nodiscard]] PseudoConsoleKind GetConsoleKind() const noexcept {
+    return m_consoleKind;
+  }
+
+  /// Get output transport statistics (bytes, reads, current read size)
+  [[nodiscard]] PtyTransportStats GetTransportStats() const noexcept {
+    return m_transport ? m_transport->GetStats() : PtyTransportStats{};
+  }
+
+  /// Get the responder answering queries ahead of the parser (null if off)
+  [[nodiscard]] const QueryResponder *GetQueryResponder() const noexcept {
+    return m_responder.get();
+  }
+
+  /// Get input bytes written to the pseudo console since start
+  [[nodiscard]] uint64_t GetBytesWritten() const noexcept {
+    return m_inputWriter ? m_inputWriter->GetBytesWritten() : 0;
+  }
+
+  /// Set the CPU priority of the shell and everything it started
+  /// (see ProcessJob.h)
+  void SetProcessPriority(SessionPriority priority) {
+    (void)m_job.SetPriority(priority);
+  }
+
+  /// Set the QoS of the thread reading the output (see ThreadPolicy.h)
+  void SetReaderQos(ThreadQos qos) {
+    if (m_transport) {
+      m_transport->SetReaderQos(qos);
+    }
+  }
+
+  /// Get what the shell's process tree has used (CPU, I/O, memory)
+  [[nodiscard]] JobAccounting GetJobAccounting() const noexcept {
+    return m_job.GetAccounting();
+  }
+
 private:
   /// Create the input/output pipes
-  bool CreatePipes();
+  /// @param overlappedOutput Create the output pipe for overlapped reads
+  bool CreatePipes(bool overlappedOutput);
+
+  /// Create the output pipe pair as an overlapped named pipe
+  bool CreateOverlappedOutputPipe(SECURITY_ATTRIBUTES &sa);
 
   /// Create the pseudo console
-  bool CreatePseudoConsoleHandle(int cols, int rows);
+  /// @param allowSideBySide Consider a side-by-side conpty.dll
+  bool CreatePseudoConsoleHandle(int cols, int rows, bool allowSideBySide);
 
   /// Launch the shell process
   bool LaunchProcess(const PtyConfig &config);
 
-  /// IO thread function - reads from PTY output
-  void IoThreadProc();
+  /// Start a WSL shell through console3-relay, on the pipes directly
+  /// @param distro Distribution (empty for the default one)
+  bool StartWslRelay(const PtyConfig &config, const std::wstring &distro);
+
+  /// Open a serial port as the session's input and output
+  bool StartSerial(const SerialSettings &serial);
+
+  /// Launch a process with its standard handles on our pipes, inheriting
+  /// nothing else
+  /// @param output stdout and stderr (may be null)
+  bool LaunchPiped(std::wstring cmdLine, HANDLE input, HANDLE output,
+                   PROCESS_INFORMATION &procInfo);
+
+  /// Put a process created suspended in the job and let it run
+  void EnterJob(const PROCESS_INFORMATION &procInfo);
+
+  /// Notify exit once the output pipe is closed (called by the transport)
+  /// @param errorCode What ended the stream (a serial session's exit code)
+  void OnOutputClosed(DWORD errorCode);
 
   /// Set last error from Windows error code
   void SetLastErrorFromWin32();
@@ -131,21 +255,33 @@ private:
   wil::unique_hfile m_pipeIn;  ///< Pipe for writing to PTY
   wil::unique_hfile m_pipeOut; ///< Pipe for reading from PTY
   wil::unique_hfile m_ptyIn;   ///< PTY input pipe (we write here)
-  wil::unique_hfile m_ptyOut;  ///< PTY output pipe (we read here)
+  wil::unique_hfile m_ptyOut;  ///< PTY output pipe (we read here), or the serial port
   unique_hpcon m_hPCon;        ///< Pseudo console handle
   wil::unique_process_information m_processInfo; ///< Shell process info
+  wil::unique_hfile m_controlIn; ///< WSL relay resize messages (we write here)
+  wil::unique_process_information m_controlProcess; ///< WSL relay forwarder
+  ProcessJob m_job; ///< Shell's process tree (see ProcessJob.h)
 
-  // IO thread
-  std::thread m_ioThread;
+  // Output transport (reads m_ptyOut into m_outputBuffer)
+  std::unique_ptr<PtyTransport> m_transport;
   std::atomic<bool> m_running{false};
 
+  // Input writer thread (owns all writes to m_ptyIn)
+  std::unique_ptr<PtyInputWriter> m_inputWriter;
+
+  // Answers queries on the transport thread, through m_inputWriter
+  std::shared_ptr<QueryResponder> m_responder;
+
   // Callbacks
-  OutputCallback m_outputCallback;
   ExitCallback m_exitCallback;
 
+  // Output destination (not owned)
+  SegmentedRingBuffer *m_outputBuffer = nullptr;
+
   // State
   int m_cols = 80;
   int m_rows = 25;
+  PseudoConsoleKind m_consoleKind = PseudoConsoleKind::None;
   std::wstring m_lastError;
 };
 
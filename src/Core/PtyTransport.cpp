@@ -0,0 +1,588 @@
+// Console3 - PtyTransport.cpp
+// PTY output transport engines
+
+#include "Core/PtyTransport.h"
+#include "Core/AllocTracker.h"
+#include "Core/PipelineTrace.h"
+#include "Core/PtyCompletionPort.h"
+#include <algorithm>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <thread>
+
+#include <wil/resource.h>
+
+namespace Console3::Core {
+
+namespace {
+
+// ============================================================================
+// Thread engine
+// ============================================================================
+
+/// Blocking ReadFile loop on a dedicated thread, reading straight into the ring
+class ThreadTransport final : public PtyTransport {
+public:
+    ~ThreadTransport() override { Stop(); }
+
+    bool Start(const PtyTransportConfig& config) override {
+        if (m_thread.joinable()) {
+            m_lastError = L"Transport already running";
+            return false;
+        }
+        if (!ValidateConfig(config, true)) {
+            return false;
+        }
+
+        m_config = config;
+        m_recorder = config.recorder;
+        m_responder = config.responder;
+        m_readSize = AdaptiveReadSize(config.readSize,
+                                      config.adaptiveReadSize ? config.maxReadSize : config.readSize);
+        ResetStats(m_readSize.Get());
+        m_stopRequested.store(false);
+
+        m_thread = std::thread(&ThreadTransport::ThreadProc, this);
+        return true;
+    }
+
+    void Stop() override {
+        if (!m_thread.joinable()) {
+            return;
+        }
+
+        m_stopRequested.store(true);
+
+        // Wake the thread if it is blocked waiting for buffer space, then
+        // abort a blocking ReadFile. Keep cancelling until the thread is out:
+        // it may have been just about to enter ReadFile when the first
+        // cancel landed.
+        m_config.output->CancelWaits();
+        const HANDLE thread = m_thread.native_handle();
+        do {
+            CancelIoEx(m_config.readHandle, nullptr);
+        } while (WaitForSingleObject(thread, 10) == WAIT_TIMEOUT);
+
+        m_thread.join();
+    }
+
+    PtyTransportEngine GetEngine() const noexcept override { return PtyTransportEngine::Thread; }
+
+    void SetReaderQos(ThreadQos qos) override {
+        if (m_thread.joinable()) {
+            (void)ThreadPolicy::SetQos(m_thread.native_handle(), qos);
+        }
+    }
+
+private:
+    void ThreadProc() {
+        AllocScope allocScope(AllocSubsystem::Io);
+        SegmentedRingBuffer& output = *m_config.output;
+        DWORD closeError = ERROR_OPERATION_ABORTED;
+
+        while (!m_stopRequested.load()) {
+            // Block above the high watermark until the consumer drains; the
+            // pipe then fills up and ConPTY throttles the child
+            if (!WaitForSpaceTimed(output)) {
+                break;
+            }
+
+            // Read straight into ring storage - no intermediate buffer
+            std::span<char> target = output.BeginWrite(m_readSize.Get());
+            if (target.empty()) {
+                // Chunk pool exhausted - give the consumer a moment
+                Sleep(1);
+                continue;
+            }
+
+            DWORD bytesRead = 0;
+            BOOL readOk = FALSE;
+            {
+                PipelineActivity activity(PipelineStage::PtyRead, GetTraceSessionId());
+                readOk = ReadFile(m_config.readHandle, target.data(),
+                                  static_cast<DWORD>(target.size()), &bytesRead, nullptr);
+                activity.SetBytes(bytesRead);
+            }
+            if (!readOk) {
+                // ERROR_BROKEN_PIPE means the process exited;
+                // ERROR_OPERATION_ABORTED is expected from Stop()
+                closeError = ::GetLastError();
+                break;
+            }
+
+            if (bytesRead == 0) {
+                // EOF - pipe closed
+                closeError = ERROR_BROKEN_PIPE;
+                break;
+            }
+
+            // Tap before publishing: once committed the consumer may reuse the storage
+            Record(target.data(), bytesRead);
+
+            // Publish to the consumer (signals it if the buffer was empty)
+            {
+                PipelineActivity activity(PipelineStage::RingWrite, GetTraceSessionId());
+                activity.SetBytes(bytesRead);
+                output.CommitWrite(bytesRead);
+            }
+            CountRead(bytesRead);
+
+            // Larger reads during bulk output, small ones again when it calms down
+            m_readSize.OnRead(target.size(), bytesRead);
+            PublishReadSize(m_readSize.Get());
+        }
+
+        if (m_config.onClosed) {
+            m_config.onClosed(closeError);
+        }
+    }
+
+private:
+    PtyTransportConfig m_config;
+    AdaptiveReadSize m_readSize;
+    std::atomic<bool> m_stopRequested{false};
+    std::thread m_thread;
+};
+
+// ============================================================================
+// CompletionPort engine
+// ============================================================================
+
+/// Overlapped reads on the shared completion port, copied into the ring
+/// Pool threads never block: when the ring is above its high watermark the
+/// reader stops reissuing reads and is resumed by the ring's space callback.
+/// Read buffers have a fixed size, so adaptiveReadSize does not apply.
+class CompletionPortTransport final : public PtyTransport {
+public:
+    ~CompletionPortTransport() override { Stop(); }
+
+    bool Start(const PtyTransportConfig& config) override {
+        if (m_started) {
+            m_lastError = L"Transport already running";
+            return false;
+        }
+        if (!ValidateConfig(config, true)) {
+            return false;
+        }
+
+        m_output = config.output;
+        m_recorder = config.recorder;
+        m_responder = config.responder;
+        ResetStats(config.readSize);
+        m_stallStart = 0;
+        m_partialLength = 0;
+
+        // Fired on the consumer thread once it drains to the low watermark
+        m_output->SetSpaceAvailableCallback([this] { m_reader.Resume(); });
+
+        CompletionReaderConfig readerConfig;
+        readerConfig.readHandle = config.readHandle;
+        readerConfig.chunkSize = config.readSize;
+        readerConfig.readsInFlight = config.readsInFlight;
+        readerConfig.onData = [this](const char* data, size_t length) {
+            return Deliver(data, length);
+        };
+        readerConfig.onClosed = config.onClosed;
+
+        if (!m_reader.Start(readerConfig)) {
+            m_output->SetSpaceAvailableCallback(nullptr);
+            m_lastError = L"Failed to start overlapped reads";
+            return false;
+        }
+
+        m_started = true;
+        return true;
+    }
+
+    void Stop() override {
+        if (!m_started) {
+            return;
+        }
+
+        m_reader.Stop();
+        m_output->SetSpaceAvailableCallback(nullptr);
+        m_started = false;
+    }
+
+    PtyTransportEngine GetEngine() const noexcept override {
+        return PtyTransportEngine::CompletionPort;
+    }
+
+private:
+    /// Copy a completed read into the ring (called on a pool thread)
+    /// @return Bytes accepted; less than length blocks the reader
+    size_t Deliver(const char* data, size_t length) {
+        SegmentedRingBuffer& output = *m_output;
+        PipelineActivity readActivity(PipelineStage::PtyRead, GetTraceSessionId());
+        readActivity.SetBytes(length);
+
+        // Redelivery after a stall: the reader was throttled until now
+        if (m_stallStart != 0) {
+            AddStall(PerfClock::NowMicros() - m_stallStart);
+            m_stallStart = 0;
+        }
+
+        size_t done = 0;
+        while (done < length && m_reader.IsRunning()) {
+            size_t written = 0;
+            if (output.Size() < output.GetHighWatermark() && !output.IsPaused()) {
+                PipelineActivity activity(PipelineStage::RingWrite, GetTraceSessionId());
+                written = output.Write(data + done, length - done);
+                activity.SetBytes(written);
+                done += written;
+                if (done == length) {
+                    break;
+                }
+            }
+
+            // Above the watermark: park the rest until the consumer drains
+            if (output.NotifyWhenSpace()) {
+                break;
+            }
+
+            if (written == 0) {
+                // Room by the watermark but no chunk available - give the
+                // consumer a moment
+                Sleep(1);
+            }
+        }
+
+        // Only the accepted part; the rest is recorded when it is offered again
+        Record(data, done);
+
+        if (done == length) {
+            CountRead(done, m_partialLength > 0 ? m_partialLength : length);
+            m_partialLength = 0;
+        } else {
+            CountBytes(done);
+            if (m_partialLength == 0) {
+                m_partialLength = length;
+            }
+            m_stallStart = PerfClock::NowMicros();
+        }
+        return done;
+    }
+
+private:
+    SegmentedRingBuffer* m_output = nullptr;
+    PtyCompletionReader m_reader;
+    bool m_started = false;
+
+    // Delivery state (one pool thread at a time)
+    uint64_t m_stallStart = 0;      ///< When the reader was last blocked
+    size_t m_partialLength = 0;     ///< Full length of a read delivered in parts
+};
+
+// ============================================================================
+// Serial engine
+// ============================================================================
+
+/// Overlapped ReadFile loop on a serial port, reading straight into the ring
+/// The port's timeouts (SerialPort.h) return a read as soon as bytes are
+/// there, or empty after a while of silence, which is not the end of the
+/// stream. Only this read is ever cancelled: the input writer writes the
+/// same handle. Above the high watermark the loop stops reading; the
+/// driver's queue then fills and flow control holds off the device.
+class SerialTransport final : public PtyTransport {
+public:
+    ~SerialTransport() override { Stop(); }
+
+    bool Start(const PtyTransportConfig& config) override {
+        if (m_thread.joinable()) {
+            m_lastError = L"Transport already running";
+            return false;
+        }
+        if (!ValidateConfig(config, true)) {
+            return false;
+        }
+        if (!m_readDone && !m_readDone.try_create(wil::EventOptions::ManualReset, nullptr)) {
+            m_lastError = L"Failed to create read event";
+            return false;
+        }
+
+        m_config = config;
+        m_recorder = config.recorder;
+        m_responder = config.responder;
+        m_readSize = AdaptiveReadSize(config.readSize,
+                                      config.adaptiveReadSize ? config.maxReadSize : config.readSize);
+        ResetStats(m_readSize.Get());
+        m_stopRequested.store(false);
+
+        m_thread = std::thread(&SerialTransport::ThreadProc, this);
+        return true;
+    }
+
+    void Stop() override {
+        if (!m_thread.joinable()) {
+            return;
+        }
+
+        m_stopRequested.store(true);
+
+        // As the Thread engine, but cancelling only the read
+        m_config.output->CancelWaits();
+        const HANDLE thread = m_thread.native_handle();
+        do {
+            CancelIoEx(m_config.readHandle, &m_overlapped);
+        } while (WaitForSingleObject(thread, 10) == WAIT_TIMEOUT);
+
+        m_thread.join();
+    }
+
+    PtyTransportEngine GetEngine() const noexcept override { return PtyTransportEngine::Serial; }
+
+    void SetReaderQos(ThreadQos qos) override {
+        if (m_thread.joinable()) {
+            (void)ThreadPolicy::SetQos(m_thread.native_handle(), qos);
+        }
+    }
+
+private:
+    void ThreadProc() {
+        AllocScope allocScope(AllocSubsystem::Io);
+        SegmentedRingBuffer& output = *m_config.output;
+        DWORD closeError = ERROR_OPERATION_ABORTED;
+
+        while (!m_stopRequested.load()) {
+            if (!WaitForSpaceTimed(output)) {
+                break;
+            }
+
+            std::span<char> target = output.BeginWrite(m_readSize.Get());
+            if (target.empty()) {
+                Sleep(1);
+                continue;
+            }
+
+            DWORD bytesRead = 0;
+            BOOL readOk = FALSE;
+            {
+                PipelineActivity activity(PipelineStage::PtyRead, GetTraceSessionId());
+                m_overlapped = OVERLAPPED{};
+                m_overlapped.hEvent = m_readDone.get();
+                readOk = ReadFile(m_config.readHandle, target.data(),
+                                  static_cast<DWORD>(target.size()), nullptr, &m_overlapped);
+                if (readOk || ::GetLastError() == ERROR_IO_PENDING) {
+                    readOk = GetOverlappedResult(m_config.readHandle, &m_overlapped, &bytesRead, TRUE);
+                }
+                activity.SetBytes(bytesRead);
+            }
+            if (!readOk) {
+                // ERROR_OPERATION_ABORTED from Stop(); anything else means
+                // the port went away (a USB adapter unplugged)
+                closeError = ::GetLastError();
+                break;
+            }
+
+            if (bytesRead == 0) {
+                // The read timed out with the line quiet
+                continue;
+            }
+
+            Record(target.data(), bytesRead);
+            {
+                PipelineActivity activity(PipelineStage::RingWrite, GetTraceSessionId());
+                activity.SetBytes(bytesRead);
+                output.CommitWrite(bytesRead);
+            }
+            CountRead(bytesRead);
+
+            m_readSize.OnRead(target.size(), bytesRead);
+            PublishReadSize(m_readSize.Get());
+        }
+
+        if (m_config.onClosed) {
+            m_config.onClosed(closeError);
+        }
+    }
+
+private:
+    PtyTransportConfig m_config;
+    AdaptiveReadSize m_readSize;
+    OVERLAPPED m_overlapped{};
+    wil::unique_event_nothrow m_readDone;
+    std::atomic<bool> m_stopRequested{false};
+    std::thread m_thread;
+};
+
+// ============================================================================
+// Replay engine
+// ============================================================================
+
+/// Replays captured output into the ring, honouring the same flow control
+/// A PtyRecording is replayed read by read, optionally at its recorded pace.
+class ReplayTransport final : public PtyTransport {
+public:
+    ~ReplayTransport() override { Stop(); }
+
+    bool Start(const PtyTransportConfig& config) override {
+        if (m_thread.joinable()) {
+            m_lastError = L"Transport already running";
+            return false;
+        }
+        if (!ValidateConfig(config, false)) {
+            return false;
+        }
+        if (!config.replayData && !config.replayRecording) {
+            m_lastError = L"No replay data";
+            return false;
+        }
+
+        m_config = config;
+        m_recorder = config.recorder;
+        m_responder = config.responder;
+        ResetStats(config.readSize);
+        m_stopRequested.store(false);
+
+        m_thread = std::thread(&ReplayTransport::ThreadProc, this);
+        return true;
+    }
+
+    void Stop() override {
+        if (!m_thread.joinable()) {
+            return;
+        }
+
+        m_stopRequested.store(true);
+        m_config.output->CancelWaits();
+        m_thread.join();
+    }
+
+    PtyTransportEngine GetEngine() const noexcept override { return PtyTransportEngine::Replay; }
+
+private:
+    void ThreadProc() {
+        AllocScope allocScope(AllocSubsystem::Io);
+        DWORD closeError = ERROR_BROKEN_PIPE;
+
+        for (size_t pass = 0; pass < m_config.replayRepeat && closeError == ERROR_BROKEN_PIPE; ++pass) {
+            const bool ok = m_config.replayRecording ? ReplayRecording(*m_config.replayRecording)
+                                                     : Deliver(*m_config.replayData);
+            if (!ok) {
+                closeError = ERROR_OPERATION_ABORTED;
+            }
+        }
+
+        if (m_config.onClosed) {
+            m_config.onClosed(closeError);
+        }
+    }
+
+    /// Replay each recorded read, paced by replaySpeed
+    /// @return false if stopped
+    bool ReplayRecording(const PtyRecording& recording) {
+        const std::string_view data = recording.data;
+        const double speed = m_config.replaySpeed;
+        const uint64_t start = PerfClock::NowMicros();
+
+        for (const RecordingEvent& event : recording.events) {
+            if (speed > 0.0) {
+                const uint64_t due = start + static_cast<uint64_t>(event.micros / speed);
+                // Sleep in slices so Stop() is not held up by a long idle gap
+                for (uint64_t now = PerfClock::NowMicros(); now < due; now = PerfClock::NowMicros()) {
+                    if (m_stopRequested.load()) {
+                        return false;
+                    }
+                    Sleep(static_cast<DWORD>(std::min<uint64_t>((due - now + 999) / 1000, 50)));
+                }
+            }
+            if (!Deliver(data.substr(event.offset, event.length))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// Copy bytes into the ring in readSize pieces, honouring flow control
+    /// @return false if stopped
+    bool Deliver(std::string_view data) {
+        SegmentedRingBuffer& output = *m_config.output;
+
+        size_t offset = 0;
+        while (offset < data.size()) {
+            if (m_stopRequested.load() || !WaitForSpaceTimed(output)) {
+                return false;
+            }
+
+            std::span<char> target = output.BeginWrite(std::min(m_config.readSize, data.size() - offset));
+            if (target.empty()) {
+                Sleep(1);
+                continue;
+            }
+
+            PipelineActivity activity(PipelineStage::RingWrite, GetTraceSessionId());
+            activity.SetBytes(target.size());
+            std::memcpy(target.data(), data.data() + offset, target.size());
+            Record(target.data(), target.size());
+            output.CommitWrite(target.size());
+            CountRead(target.size());
+            offset += target.size();
+        }
+        return true;
+    }
+
+private:
+    PtyTransportConfig m_config;
+    std::atomic<bool> m_stopRequested{false};
+    std::thread m_thread;
+};
+
+} // namespace
+
+// ============================================================================
+// PtyTransport
+// ============================================================================
+
+std::unique_ptr<PtyTransport> PtyTransport::Create(PtyTransportEngine engine) {
+    switch (engine) {
+    case PtyTransportEngine::CompletionPort:
+        return std::make_unique<CompletionPortTransport>();
+    case PtyTransportEngine::Replay:
+        return std::make_unique<ReplayTransport>();
+    case PtyTransportEngine::Serial:
+        return std::make_unique<SerialTransport>();
+    case PtyTransportEngine::Thread:
+    default:
+        return std::make_unique<ThreadTransport>();
+    }
+}
+
+bool PtyTransport::WaitForSpaceTimed(SegmentedRingBuffer& output) {
+    // Only time real stalls; the common case is a single Size() check
+    const bool paused = output.IsPaused();
+    if (output.Size() < output.GetHighWatermark() && !paused) {
+        return true;
+    }
+
+    // A user's pause is not backpressure
+    const uint64_t start = PerfClock::NowMicros();
+    const bool ok = output.WaitForSpace();
+    if (!paused) {
+        AddStall(PerfClock::NowMicros() - start);
+    }
+    return ok;
+}
+
+bool PtyTransport::ValidateConfig(const PtyTransportConfig& config, bool needsHandle) {
+    m_lastError.clear();
+
+    if (!config.output) {
+        m_lastError = L"Output buffer is null";
+        return false;
+    }
+
+    if (needsHandle && (!config.readHandle || config.readHandle == INVALID_HANDLE_VALUE)) {
+        m_lastError = L"Invalid read handle";
+        return false;
+    }
+
+    if (config.readSize == 0) {
+        m_lastError = L"Invalid read size";
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,213 @@
+#pragma once
+// Console3 - PtyTransport.h
+// Pluggable PTY output transports feeding the session output buffer
+//
+// Every way of getting bytes out of a pseudo console delivers into the same
+// SegmentedRingBuffer, with the same flow control, statistics and shutdown
+// contract, so read-path optimizations land once and engines can be compared
+// head to head:
+//
+//   Thread         - one thread per session, blocking ReadFile straight into
+//                    ring storage, adaptive read size
+//   CompletionPort - overlapped reads serviced by the shared completion port
+//                    pool, several reads in flight per pipe
+//   Replay         - replays a captured byte stream or PtyRecording (tests,
+//                    benchmarks and bug reports, no pseudo console needed)
+//   Serial         - overlapped reads of a serial port on a dedicated
+//                    thread, straight into ring storage (SerialPort.h)
+//
+// Any engine can tap its reads into a PtyRecorder before they enter the ring.
+
+// Target Windows 10 RS5 (1809) or later for ConPTY APIs
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "Core/AdaptiveReadSize.h"
+#include "Core/PerfClock.h"
+#include "Core/PtyRecorder.h"
+#include "Core/PtyRecording.h"
+#include "Core/QueryResponder.h"
+#include "Core/SegmentedRingBuffer.h"
+#include "Core/ThreadPolicy.h"
+
+namespace Console3::Core {
+
+/// Available transport engines
+enum class PtyTransportEngine {
+    Thread,         ///< Dedicated thread with blocking ReadFile
+    CompletionPort, ///< Overlapped reads on the shared completion port
+    Replay,         ///< Replays captured output from memory
+    Serial          ///< Overlapped reads of a serial port
+};
+
+/// Callback invoked once when the transport stops delivering
+/// @param errorCode Win32 error that ended the stream (ERROR_BROKEN_PIPE on
+/// EOF, ERROR_OPERATION_ABORTED when stopped)
+using TransportClosedCallback = std::function<void(DWORD errorCode)>;
+
+/// Transport configuration
+struct PtyTransportConfig {
+    HANDLE readHandle = nullptr;              ///< Output pipe (Thread/CompletionPort) or port (Serial)
+    SegmentedRingBuffer* output = nullptr;    ///< Destination buffer (required, not owned)
+    TransportClosedCallback onClosed;         ///< End-of-stream notification
+
+    // Read sizing
+    size_t readSize = 4096;                   ///< Read size (minimum when adaptive)
+    bool adaptiveReadSize = true;             ///< Grow reads while they come back full
+    size_t maxReadSize = AdaptiveReadSize::kDefaultMax; ///< Adaptive read cap
+
+    // CompletionPort engine
+    size_t readsInFlight = 2;                 ///< Pending reads per pipe
+
+    // Taps (any engine)
+    std::shared_ptr<PtyRecorder> recorder;    ///< Receives every read (optional)
+    std::shared_ptr<QueryResponder> responder; ///< Answers queries in every read (optional)
+
+    // Replay engine
+    std::shared_ptr<const std::string> replayData; ///< Captured output to replay
+    std::shared_ptr<const PtyRecording> replayRecording; ///< Timed capture (used over replayData)
+    double replaySpeed = 0.0;                 ///< Recording playback rate (1 = as recorded, 0 = unthrottled)
+    size_t replayRepeat = 1;                  ///< Times to replay the data
+};
+
+/// Transport statistics
+struct PtyTransportStats {
+    uint64_t bytesRead = 0;     ///< Bytes delivered into the output buffer
+    uint64_t readCount = 0;     ///< ReadFile calls (or replay chunks) issued
+    size_t readSize = 0;        ///< Read size currently requested
+    size_t maxReadSize = 0;     ///< Largest single read returned
+    uint64_t stallMicros = 0;   ///< Time spent throttled by output backpressure
+};
+
+/// Source of PTY output bytes
+class PtyTransport {
+public:
+    /// Create a transport for the given engine
+    [[nodiscard]] static std::unique_ptr<PtyTransport> Create(PtyTransportEngine engine);
+
+    virtual ~PtyTransport() = default;
+
+    // Non-copyable, non-movable
+    PtyTransport(const PtyTransport&) = delete;
+    PtyTransport& operator=(const PtyTransport&) = delete;
+
+    /// Start delivering into config.output
+    /// @return true on success; on failure GetLastError() has the reason
+    [[nodiscard]] virtual bool Start(const PtyTransportConfig& config) = 0;
+
+    /// Stop delivering and release the output buffer
+    /// When this returns, onClosed has run (if the transport started) and no
+    /// further writes into the buffer will happen.
+    virtual void Stop() = 0;
+
+    /// Get the engine this transport implements
+    [[nodiscard]] virtual PtyTransportEngine GetEngine() const noexcept = 0;
+
+    /// Set the QoS of the thread reading for this session, for engines with
+    /// one of their own (see ThreadPolicy.h; the completion port pool is
+    /// shared and keeps the default)
+    virtual void SetReaderQos(ThreadQos qos) { (void)qos; }
+
+    /// Get delivery statistics (readable from any thread)
+    [[nodiscard]] PtyTransportStats GetStats() const noexcept {
+        PtyTransportStats stats;
+        stats.bytesRead = m_bytesRead.load(std::memory_order_relaxed);
+        stats.readCount = m_readCount.load(std::memory_order_relaxed);
+        stats.readSize = m_currentReadSize.load(std::memory_order_relaxed);
+        stats.maxReadSize = m_maxReadSize.load(std::memory_order_relaxed);
+        stats.stallMicros = m_stallMicros.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    /// Get the last error message
+    [[nodiscard]] const std::wstring& GetLastError() const noexcept { return m_lastError; }
+
+    /// Set the session ID pipeline trace events are tagged with (any thread,
+    /// see PipelineTrace.h)
+    void SetTraceSessionId(uint32_t sessionId) noexcept {
+        m_traceSessionId.store(sessionId, std::memory_order_relaxed);
+    }
+
+protected:
+    PtyTransport() = default;
+
+    /// Validate the common configuration fields
+    bool ValidateConfig(const PtyTransportConfig& config, bool needsHandle);
+
+    /// SegmentedRingBuffer::WaitForSpace() that records the stall time
+    bool WaitForSpaceTimed(SegmentedRingBuffer& output);
+
+    /// Record one completed read
+    /// @param bytes Bytes delivered by this call
+    /// @param readLength Full length of the read (differs after a partial delivery)
+    void CountRead(size_t bytes, size_t readLength = 0) noexcept {
+        m_readCount.fetch_add(1, std::memory_order_relaxed);
+        m_bytesRead.fetch_add(bytes, std::memory_order_relaxed);
+        AtomicFetchMax(m_maxReadSize, readLength > 0 ? readLength : bytes);
+    }
+
+    /// Pass one read to the recorder and the query responder, if any
+    void Record(const char* data, size_t length) {
+        if (m_recorder) {
+            m_recorder->Record(data, length);
+        }
+        if (m_responder) {
+            m_responder->Scan(data, length);
+        }
+    }
+
+    /// Record time spent throttled by backpressure
+    void AddStall(uint64_t micros) noexcept {
+        m_stallMicros.fetch_add(micros, std::memory_order_relaxed);
+    }
+
+    /// Record bytes delivered without finishing a read (partial delivery)
+    void CountBytes(size_t bytes) noexcept {
+        m_bytesRead.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    /// Publish the read size currently requested
+    void PublishReadSize(size_t readSize) noexcept {
+        m_currentReadSize.store(readSize, std::memory_order_relaxed);
+    }
+
+    /// Get the session ID for pipeline trace events
+    [[nodiscard]] uint32_t GetTraceSessionId() const noexcept {
+        return m_traceSessionId.load(std::memory_order_relaxed);
+    }
+
+    /// Reset statistics at start
+    void ResetStats(size_t readSize) noexcept {
+        m_bytesRead.store(0, std::memory_order_relaxed);
+        m_readCount.store(0, std::memory_order_relaxed);
+        m_currentReadSize.store(readSize, std::memory_order_relaxed);
+        m_maxReadSize.store(0, std::memory_order_relaxed);
+        m_stallMicros.store(0, std::memory_order_relaxed);
+    }
+
+protected:
+    std::wstring m_lastError;
+    std::shared_ptr<PtyRecorder> m_recorder;  ///< Set by Start() from config.recorder
+    std::shared_ptr<QueryResponder> m_responder; ///< Set by Start() from config.responder
+
+private:
+    std::atomic<uint64_t> m_bytesRead{0};
+    std::atomic<uint64_t> m_readCount{0};
+    std::atomic<size_t> m_currentReadSize{0};
+    std::atomic<size_t> m_maxReadSize{0};
+    std::atomic<uint64_t> m_stallMicros{0};
+    std::atomic<uint32_t> m_traceSessionId{0};
+};
+
+} // namespace Console3::Core
@@ -0,0 +1,183 @@
+// Console3 - QueryResponder.cpp
+// Answers terminal queries as output arrives, ahead of the parse backlog
+
+#include "Core/QueryResponder.h"
+
+namespace Console3::Core {
+
+namespace {
+
+// The emulator's replies, byte for byte (libvterm's state.c), so its own
+// copies can be recognized and dropped
+constexpr std::string_view kPrimaryAttributes = "\x1b[?1;2c";
+constexpr std::string_view kSecondaryAttributes = "\x1b[>0;100;0c";
+constexpr std::string_view kStatusOk = "\x1b[0n";
+constexpr std::string_view kPrivateStatusOk = "\x1b[?0n";
+
+constexpr std::string_view kReplies[] = {kPrimaryAttributes, kSecondaryAttributes, kStatusOk, kPrivateStatusOk};
+
+constexpr char kEsc = '\x1b';
+constexpr char kCan = '\x18';
+constexpr char kSub = '\x1a';
+constexpr char kBel = '\x07';
+
+} // namespace
+
+void QueryResponder::Scan(const char* data, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        const char c = data[i];
+        const auto byte = static_cast<unsigned char>(c);
+
+        // NUL and DEL are ignored everywhere; CAN and SUB abort anything
+        if (byte == 0x00 || byte == 0x7F) {
+            continue;
+        }
+        if (c == kCan || c == kSub) {
+            m_state = State::Ground;
+            continue;
+        }
+
+        switch (m_state) {
+        case State::Ground:
+            if (c == kEsc) {
+                m_state = State::Escape;
+            }
+            break;
+
+        case State::Escape:
+            if (c == '[') {
+                m_state = State::Csi;
+                m_leader = 0;
+                m_firstArg = 0;
+                m_firstArgDone = false;
+                m_hasArg = false;
+            } else if (c == ']' || c == 'P' || c == 'X' || c == '^' || c == '_') {
+                m_state = State::String;
+            } else if (byte >= 0x20 && byte <= 0x2F) {
+                m_state = State::EscapeIntermediate;
+            } else if (byte >= 0x30) {
+                m_state = State::Ground;
+            }
+            // ESC again restarts; C0 controls leave the escape open
+            break;
+
+        case State::EscapeIntermediate:
+            if (c == kEsc) {
+                m_state = State::Escape;
+            } else if (byte >= 0x30) {
+                m_state = State::Ground;
+            }
+            break;
+
+        case State::Csi:
+        case State::CsiIgnore:
+            if (c == kEsc) {
+                m_state = State::Escape;
+            } else if (byte >= 0x40 && byte <= 0x7E) {
+                if (m_state == State::Csi) {
+                    OnCsi(c, m_offset + i + 1);
+                }
+                m_state = State::Ground;
+            } else if (m_state == State::CsiIgnore || byte < 0x20) {
+                // C0 controls are executed in the middle of a sequence
+            } else if (byte >= 0x3C && byte <= 0x3F) {
+                // A private marker leads; anywhere else it spoils the sequence
+                if (m_leader == 0 && !m_hasArg && !m_firstArgDone) {
+                    m_leader = c;
+                } else {
+                    m_state = State::CsiIgnore;
+                }
+            } else if (c >= '0' && c <= '9') {
+                if (!m_firstArgDone && m_firstArg < 100000) {
+                    m_firstArg = m_firstArg * 10 + static_cast<uint32_t>(c - '0');
+                    m_hasArg = true;
+                }
+            } else if (c == ';' || c == ':') {
+                m_firstArgDone = true;
+            } else {
+                // Intermediate bytes make it another command
+                m_state = State::CsiIgnore;
+            }
+            break;
+
+        case State::String:
+            if (c == kEsc) {
+                m_state = State::StringEscape;
+            } else if (c == kBel) {
+                m_state = State::Ground;
+            }
+            break;
+
+        case State::StringEscape:
+            if (c == '\\') {
+                m_state = State::Ground;
+            } else if (c == kEsc) {
+                // Still a possible ST
+            } else if (byte >= 0x20 && byte <= 0x2F) {
+                m_state = State::EscapeIntermediate;
+            } else if (byte >= 0x30) {
+                // The string ended, and the ESC it ended with is a plain
+                // escape: ESC [ here does not start a control sequence
+                m_state = State::Ground;
+            }
+            break;
+        }
+    }
+    m_offset += length;
+}
+
+void QueryResponder::OnCsi(char final, uint64_t end) {
+    std::string_view reply;
+    if (final == 'c' && m_leader == 0 && m_firstArg == 0) {
+        reply = kPrimaryAttributes;
+    } else if (final == 'c' && m_leader == '>') {
+        reply = kSecondaryAttributes;
+    } else if (final == 'n' && (m_leader == 0 || m_leader == '?')) {
+        if (m_firstArg == 5) {
+            reply = m_leader == '?' ? kPrivateStatusOk : kStatusOk;
+        } else if (m_firstArg == 6) {
+            m_cursorQueryEnd.store(end, std::memory_order_release);
+        }
+    }
+
+    if (!reply.empty() && m_writer) {
+        m_writer(reply);
+        m_answered.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool QueryResponder::FilterReplies(std::string_view replies, std::string& kept) {
+    // Replies are a handful of bytes; most of the time there is no ESC [
+    // that could start one of ours
+    bool removed = false;
+    size_t copied = 0;
+    for (size_t pos = replies.find(kEsc); pos != std::string_view::npos; pos = replies.find(kEsc, pos)) {
+        const std::string_view rest = replies.substr(pos);
+        size_t match = 0;
+        for (std::string_view reply : kReplies) {
+            if (rest.starts_with(reply)) {
+                match = reply.size();
+                break;
+            }
+        }
+        if (match == 0) {
+            ++pos;
+            continue;
+        }
+
+        if (!removed) {
+            kept.clear();
+            removed = true;
+        }
+        kept.append(replies.substr(copied, pos - copied));
+        pos += match;
+        copied = pos;
+    }
+
+    if (removed) {
+        kept.append(replies.substr(copied));
+    }
+    return removed;
+}
+
+} // namespace Console3::Core
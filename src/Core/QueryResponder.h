@@ -0,0 +1,90 @@
+#pragma once
+// Console3 - QueryResponder.h
+// Answers terminal queries as output arrives, ahead of the parse backlog
+//
+// PSReadLine, vim and friends ask for the device attributes (DA) or status
+// (DSR) and wait for the answer. The emulator answers when it parses the
+// query, which under an output flood is only after everything queued ahead
+// of it: the prompt waits seconds for a reply the terminal could give at
+// once. The responder sees every read on the transport thread, before it
+// enters the output ring, and answers the queries whose reply never depends
+// on the screen (DA1, DA2, DSR 5) straight into the input writer's priority
+// lane. The emulator still parses them; FilterReplies() drops its copies.
+//
+// A cursor position report (DSR 6) does depend on everything before it, so
+// it is still answered by the emulator. The responder notes where in the
+// stream the last one ends, and a time-sliced parse keeps going until it has
+// got that far (see Session::ParseOutput).
+//
+// The scanner follows the emulator's escape syntax closely enough to find
+// the same queries: a query inside an OSC or DCS string, or with
+// intermediate bytes, is not one.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace Console3::Core {
+
+/// Sends a reply to the shell (the session's input writer)
+using QueryReplyWriter = std::function<void(std::string_view reply)>;
+
+/// Finds and answers screen-independent queries in the output stream
+class QueryResponder {
+public:
+    explicit QueryResponder(QueryReplyWriter writer) : m_writer(std::move(writer)) {}
+
+    // Non-copyable (scanner state belongs to one stream)
+    QueryResponder(const QueryResponder&) = delete;
+    QueryResponder& operator=(const QueryResponder&) = delete;
+
+    /// Scan output about to enter the ring, answering what it can (transport thread)
+    void Scan(const char* data, size_t length);
+
+    /// Get the stream offset just past the last cursor position query seen
+    /// (0 if none); any thread
+    [[nodiscard]] uint64_t GetCursorQueryEnd() const noexcept {
+        return m_cursorQueryEnd.load(std::memory_order_acquire);
+    }
+
+    /// Get the number of queries answered early
+    [[nodiscard]] uint64_t GetAnswered() const noexcept {
+        return m_answered.load(std::memory_order_relaxed);
+    }
+
+    /// Remove the replies the responder gives from the emulator's output
+    /// @param replies Bytes the emulator sends to the host
+    /// @param[out] kept Everything else
+    /// @return true if anything was removed (kept is only set then)
+    static bool FilterReplies(std::string_view replies, std::string& kept);
+
+private:
+    enum class State : uint8_t {
+        Ground,
+        Escape,         ///< After ESC
+        EscapeIntermediate, ///< After ESC and an intermediate byte
+        Csi,            ///< In a control sequence
+        CsiIgnore,      ///< In a control sequence that isn't a query
+        String,         ///< In an OSC/DCS/SOS/PM/APC string
+        StringEscape    ///< ESC inside a string (ST if '\' follows)
+    };
+
+    /// A control sequence ended with a final byte
+    /// @param end Stream offset just past the final byte
+    void OnCsi(char final, uint64_t end);
+
+    QueryReplyWriter m_writer;
+    State m_state = State::Ground;
+    char m_leader = 0;              ///< Private marker of the sequence ('?', '>', ...)
+    uint32_t m_firstArg = 0;        ///< First parameter
+    bool m_firstArgDone = false;    ///< A separator followed the first parameter
+    bool m_hasArg = false;          ///< The first parameter has digits
+    uint64_t m_offset = 0;          ///< Bytes scanned so far
+    std::atomic<uint64_t> m_cursorQueryEnd{0};
+    std::atomic<uint64_t> m_answered{0};
+};
+
+} // namespace Console3::Core
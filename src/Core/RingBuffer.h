@@ -10,21 +10,64 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <functional>
+#include <span>
 #include <vector>
 
+#include "Core/RingSignals.h"
+
 namespace Console3::Core {
 
+/// Readable region of a ring buffer, split in two where the data wraps
+template <typename T> struct RingReadSpans {
+  std::span<const T> first;  ///< Oldest data, up to the end of storage
+  std::span<const T> second; ///< Remainder from the start of storage
+
+  /// Total number of readable elements across both spans
+  [[nodiscard]] size_t Size() const noexcept {
+    return first.size() + second.size();
+  }
+
+  /// Check if there is nothing to read
+  [[nodiscard]] bool IsEmpty() const noexcept { return first.empty(); }
+};
+
 /// Thread-safe SPSC (Single Producer, Single Consumer) ring buffer
-/// Producer: IoThread writes PTY output data
+/// Producer: PTY reader thread writes output data
 /// Consumer: UI/Emulation reads data for processing
-template <typename T = char> class RingBuffer {
+///
+/// Besides the copying Write()/Read() API, both sides can work in place:
+/// the producer fills BeginWrite() spans (e.g. as a ReadFile target) and
+/// publishes them with CommitWrite(), and the consumer parses PeekSpans()
+/// directly and frees the space with Release().
+///
+/// Optional flow control lets a producer block instead of dropping data:
+/// once the fill level reaches the high watermark, WaitForSpace() sleeps
+/// until the consumer has drained the buffer down to the low watermark.
+///
+/// The consumer side is event driven as well: the data-available callback and
+/// WaitForData() fire only on the empty -> non-empty transition, so a burst
+/// of writes produces a single wakeup instead of one per chunk.
+///
+/// Each side keeps a copy of the other's index and loads the real one only
+/// when its copy runs out: the producer when the space it sees is less than
+/// it wants to write, the consumer when it sees nothing to read. Small
+/// writes at a high rate then leave the consumer's cache line alone, and the
+/// consumer's reads the producer's, until one side catches up with the
+/// other. A read may therefore see less than has been written; it gets the
+/// rest on the next read. Size(), Available() and the waits read both
+/// indices as before. Stage() and Publish() batch several writes into one
+/// publish (one store and one signal check). CachedIndices = false keeps
+/// the protocol that loads the other index on every call, for the
+/// contention benchmarks to compare with.
+template <typename T = char, bool CachedIndices = true> class RingBuffer {
 public:
   /// Create a ring buffer with the specified capacity
   /// @param capacity Buffer capacity in elements (will be rounded up to power
   /// of 2)
   explicit RingBuffer(size_t capacity = 65536)
       : m_capacity(NextPowerOfTwo(capacity)), m_mask(m_capacity - 1),
-        m_buffer(m_capacity), m_head(0), m_tail(0) {}
+        m_buffer(m_capacity), m_head(0), m_tail(0), m_signals(m_capacity - 1) {}
 
   ~RingBuffer() = default;
 
@@ -40,11 +83,17 @@ public:
   /// @return Number of elements actually written (may be less if buffer is
   /// full)
   size_t Write(const T *data, size_t length) noexcept {
-    const size_t head = m_head.load(std::memory_order_relaxed);
-    const size_t tail = m_tail.load(std::memory_order_acquire);
+    const size_t written = Stage(data, length);
+    Publish();
+    return written;
+  }
 
-    const size_t available = AvailableToWrite(head, tail);
-    const size_t toWrite = std::min(length, available);
+  /// Write data without making it visible to the consumer yet (producer
+  /// side); Publish() releases everything staged at once
+  /// @return Number of elements staged (may be less if buffer is full)
+  size_t Stage(const T *data, size_t length) noexcept {
+    const size_t head = m_writeHead;
+    const size_t toWrite = std::min(length, SpaceToWrite(head, length));
 
     if (toWrite == 0) {
       return 0;
@@ -61,18 +110,26 @@ public:
       std::memcpy(&m_buffer[0], data + firstChunk, secondChunk * sizeof(T));
     }
 
-    // Publish the new head position
-    m_head.store(head + toWrite, std::memory_order_release);
+    m_writeHead = head + toWrite;
     return toWrite;
   }
 
+  /// Make staged data visible to the consumer (producer side)
+  void Publish() noexcept {
+    if (m_writeHead == m_head.load(std::memory_order_relaxed)) {
+      return;
+    }
+    m_head.store(m_writeHead, std::memory_order_release);
+    m_signals.OnDataPublished();
+  }
+
   /// Read data from the buffer (consumer side)
   /// @param data Pointer to buffer to read into
   /// @param maxLength Maximum number of elements to read
   /// @return Number of elements actually read
   size_t Read(T *data, size_t maxLength) noexcept {
     const size_t tail = m_tail.load(std::memory_order_relaxed);
-    const size_t head = m_head.load(std::memory_order_acquire);
+    const size_t head = ReadableHead(tail);
 
     const size_t available = AvailableToRead(head, tail);
     const size_t toRead = std::min(maxLength, available);
@@ -94,6 +151,7 @@ public:
 
     // Publish the new tail position
     m_tail.store(tail + toRead, std::memory_order_release);
+    OnConsumed(head, tail + toRead);
     return toRead;
   }
 
@@ -103,7 +161,7 @@ public:
   /// @return Number of elements actually peeked
   size_t Peek(T *data, size_t maxLength) const noexcept {
     const size_t tail = m_tail.load(std::memory_order_relaxed);
-    const size_t head = m_head.load(std::memory_order_acquire);
+    const size_t head = ReadableHead(tail);
 
     const size_t available = AvailableToRead(head, tail);
     const size_t toPeek = std::min(maxLength, available);
@@ -129,17 +187,118 @@ public:
   /// @return Number of elements actually skipped
   size_t Skip(size_t count) noexcept {
     const size_t tail = m_tail.load(std::memory_order_relaxed);
-    const size_t head = m_head.load(std::memory_order_acquire);
+    const size_t head = ReadableHead(tail);
 
     const size_t available = AvailableToRead(head, tail);
     const size_t toSkip = std::min(count, available);
 
     if (toSkip > 0) {
       m_tail.store(tail + toSkip, std::memory_order_release);
+      OnConsumed(head, tail + toSkip);
     }
     return toSkip;
   }
 
+  /// Reserve a contiguous writable region in ring storage (producer side)
+  /// @param maxLength Maximum number of elements wanted
+  /// @return Writable span; shorter than maxLength when the free space wraps
+  /// around the end of storage, empty when the buffer is full. Nothing is
+  /// visible to the consumer until CommitWrite() is called.
+  [[nodiscard]] std::span<T> BeginWrite(size_t maxLength) noexcept {
+    const size_t head = m_writeHead;
+    const size_t headIndex = head & m_mask;
+    const size_t contiguous =
+        std::min({maxLength, SpaceToWrite(head, std::min(maxLength, m_capacity - headIndex)),
+                  m_capacity - headIndex});
+
+    return {m_buffer.data() + headIndex, contiguous};
+  }
+
+  /// Publish elements written into the span returned by BeginWrite()
+  /// (and anything staged before them)
+  /// @param count Number of elements filled (must not exceed the span size)
+  void CommitWrite(size_t count) noexcept {
+    m_writeHead += count;
+    Publish();
+  }
+
+  /// Get the readable data in place without copying (consumer side)
+  /// @return Up to two spans in FIFO order; valid until Release() or Read()
+  [[nodiscard]] RingReadSpans<T> PeekSpans() const noexcept {
+    const size_t tail = m_tail.load(std::memory_order_relaxed);
+    const size_t head = ReadableHead(tail);
+
+    const size_t available = AvailableToRead(head, tail);
+    const size_t tailIndex = tail & m_mask;
+    const size_t firstChunk = std::min(available, m_capacity - tailIndex);
+
+    RingReadSpans<T> spans;
+    spans.first = {m_buffer.data() + tailIndex, firstChunk};
+    spans.second = {m_buffer.data(), available - firstChunk};
+    return spans;
+  }
+
+  /// Free elements consumed through PeekSpans() (consumer side)
+  /// @param count Number of elements to release
+  /// @return Number of elements actually released
+  size_t Release(size_t count) noexcept { return Skip(count); }
+
+  // ==========================================================================
+  // Flow Control / Data Notification (see RingSignals)
+  // ==========================================================================
+
+  /// Set the fill levels at which the producer blocks and resumes
+  /// @param highWatermark Fill level at which the producer blocks (0 = full)
+  /// @param lowWatermark Fill level the consumer must drain down to before
+  /// the producer resumes
+  void SetWatermarks(size_t highWatermark, size_t lowWatermark) noexcept {
+    m_signals.SetWatermarks(highWatermark, lowWatermark);
+  }
+
+  /// Get the fill level at which producers block
+  [[nodiscard]] size_t GetHighWatermark() const noexcept {
+    return m_signals.GetHighWatermark();
+  }
+
+  /// Get the fill level at which blocked producers resume
+  [[nodiscard]] size_t GetLowWatermark() const noexcept {
+    return m_signals.GetLowWatermark();
+  }
+
+  /// Block until the fill level is below the high watermark (producer side)
+  /// @return true when space is available, false if CancelWaits() was called
+  bool WaitForSpace() noexcept {
+    return m_signals.WaitForSpace([this] { return Size(); });
+  }
+
+  /// Write all data, blocking while the buffer is above the high watermark
+  /// @return Number of elements written (less than length only if cancelled)
+  size_t WriteAll(const T *data, size_t length) noexcept {
+    size_t written = 0;
+    while (written < length) {
+      if (!WaitForSpace()) {
+        break;
+      }
+      written += Write(data + written, length - written);
+    }
+    return written;
+  }
+
+  /// Set a callback fired when data arrives in an empty buffer
+  void SetDataAvailableCallback(std::function<void()> callback) {
+    m_signals.SetDataAvailableCallback(std::move(callback));
+  }
+
+  /// Block until the buffer is non-empty (consumer side)
+  /// @return true when data is available, false if CancelWaits() was called
+  bool WaitForData() noexcept {
+    return m_signals.WaitForData([this] { return Size(); });
+  }
+
+  /// Wake any blocked producer or consumer and make further waits fail
+  /// immediately (e.g. during shutdown). Cleared by Clear().
+  void CancelWaits() noexcept { m_signals.CancelWaits(); }
+
   /// Get the number of elements available to read
   [[nodiscard]] size_t Size() const noexcept {
     const size_t head = m_head.load(std::memory_order_acquire);
@@ -171,6 +330,10 @@ public:
   void Clear() noexcept {
     m_head.store(0, std::memory_order_relaxed);
     m_tail.store(0, std::memory_order_relaxed);
+    m_writeHead = 0;
+    m_cachedTail = 0;
+    m_cachedHead = 0;
+    m_signals.Reset();
   }
 
 private:
@@ -200,14 +363,66 @@ private:
     return (m_capacity - 1) - (head - tail);
   }
 
+  /// Get the space the producer may write, loading the tail only if the
+  /// copy of it shows less than wanted (producer side)
+  [[nodiscard]] size_t SpaceToWrite(size_t head, size_t wanted) noexcept {
+    if constexpr (CachedIndices) {
+      if (AvailableToWrite(head, m_cachedTail) < wanted) {
+        m_cachedTail = m_tail.load(std::memory_order_acquire);
+      }
+      return AvailableToWrite(head, m_cachedTail);
+    } else {
+      return AvailableToWrite(head, m_tail.load(std::memory_order_acquire));
+    }
+  }
+
+  /// Get the head as far as the consumer may read, loading it only if the
+  /// copy of it shows nothing to read (consumer side)
+  [[nodiscard]] size_t ReadableHead(size_t tail) const noexcept {
+    if constexpr (CachedIndices) {
+      if (m_cachedHead == tail) {
+        m_cachedHead = m_head.load(std::memory_order_acquire);
+      }
+      return m_cachedHead;
+    } else {
+      return m_head.load(std::memory_order_acquire);
+    }
+  }
+
+  /// Signal the producer and re-arm the data notification as needed
+  /// (consumer side, after moving the tail)
+  void OnConsumed(size_t head, size_t tail) noexcept {
+    if constexpr (CachedIndices) {
+      // The copy of the head underestimates the fill level: a held producer
+      // gets the real one, and the buffer only counts as drained if the
+      // real head agrees
+      m_signals.OnSpaceFreedWith([this] { return Size(); });
+      if (head == tail && ReadableHead(tail) == tail) {
+        m_signals.OnDrained([this] { return Size(); });
+      }
+    } else {
+      // head may be stale, which only overestimates the fill level
+      m_signals.OnSpaceFreed(AvailableToRead(head, tail));
+      if (head == tail) {
+        m_signals.OnDrained([this] { return Size(); });
+      }
+    }
+  }
+
 private:
   const size_t m_capacity; ///< Buffer capacity (power of 2)
   const size_t m_mask;     ///< Bitmask for fast modulo (capacity - 1)
   std::vector<T> m_buffer; ///< Underlying storage
 
-  // Cache-line padding to prevent false sharing between producer and consumer
+  // Cache-line padding to prevent false sharing between producer and consumer;
+  // each side's copy of the other's index is on its own line
   alignas(64) std::atomic<size_t> m_head; ///< Write position (producer)
+  size_t m_writeHead = 0;  ///< Producer: end of staged data
+  size_t m_cachedTail = 0; ///< Producer: tail as last loaded
   alignas(64) std::atomic<size_t> m_tail; ///< Read position (consumer)
+  mutable size_t m_cachedHead = 0; ///< Consumer: head as last loaded
+
+  RingSignals m_signals; ///< Watermarks and producer/consumer wakeups
 };
 
 /// Convenience alias for byte buffer (PTY I/O)
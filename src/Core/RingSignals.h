@@ -0,0 +1,261 @@
+#pragma once
+// Console3 - RingSignals.h
+// Flow control and wakeup signaling shared by the SPSC output buffers
+//
+// Both RingBuffer and SegmentedRingBuffer use the same scheme. The producer
+// blocks between a high and a low watermark instead of dropping data, and the
+// consumer is signaled only on the empty -> non-empty transition. Waiting is
+// built on C++20 std::atomic wait/notify (WaitOnAddress on Windows).
+//
+// A paused buffer holds the producer as if it were full, whatever its fill
+// level, so a user can stop a flood at its source (SetPaused()).
+//
+// The buffer owns the fill level. It calls the On*() hooks after moving its
+// read or write position, and passes a callable that returns the current
+// fill level to the waits.
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace Console3::Core {
+
+/// Watermark flow control and data-available notification for one buffer
+class RingSignals {
+public:
+    /// @param capacity Buffer capacity; the high watermark defaults to full
+    /// and the low watermark to half
+    explicit RingSignals(size_t capacity) noexcept
+        : m_capacity(capacity), m_highWatermark(capacity), m_lowWatermark(capacity / 2) {}
+
+    // Non-copyable, non-movable (atomic members)
+    RingSignals(const RingSignals&) = delete;
+    RingSignals& operator=(const RingSignals&) = delete;
+
+    // ========================================================================
+    // Flow Control (producer side)
+    // ========================================================================
+
+    /// Set the fill levels at which the producer blocks and resumes
+    /// @param highWatermark Fill level at which the producer blocks (0 = full)
+    /// @param lowWatermark Fill level the consumer must drain down to before
+    /// the producer resumes
+    void SetWatermarks(size_t highWatermark, size_t lowWatermark) noexcept {
+        m_highWatermark = (highWatermark == 0 || highWatermark > m_capacity)
+                              ? m_capacity
+                              : highWatermark;
+        m_lowWatermark = std::min(lowWatermark, m_highWatermark - 1);
+    }
+
+    [[nodiscard]] size_t GetHighWatermark() const noexcept { return m_highWatermark; }
+    [[nodiscard]] size_t GetLowWatermark() const noexcept { return m_lowWatermark; }
+
+    /// Block until the fill level is below the high watermark
+    /// Once blocked, the producer stays asleep until the consumer has drained
+    /// down to the low watermark, so wakeups happen once per drain rather
+    /// than once per read.
+    /// @param size Callable returning the current fill level
+    /// @return true when space is available, false if CancelWaits() was called
+    template <typename SizeFn>
+    bool WaitForSpace(SizeFn&& size) noexcept {
+        for (;;) {
+            if (m_cancelled.load(std::memory_order_acquire)) {
+                return false;
+            }
+            if (size() < m_highWatermark && !m_paused.load(std::memory_order_acquire)) {
+                return true;
+            }
+
+            const uint32_t epoch = m_spaceEpoch.load(std::memory_order_acquire);
+            m_producerWaiting.store(true, std::memory_order_seq_cst);
+
+            // Re-check after publishing the waiting flag: the consumer may
+            // have drained (or the buffer resumed) between the first check
+            // and the store above
+            if (m_cancelled.load(std::memory_order_seq_cst) || CanResume(size())) {
+                m_producerWaiting.store(false, std::memory_order_relaxed);
+                continue;
+            }
+
+            m_spaceEpoch.wait(epoch, std::memory_order_acquire);
+        }
+    }
+
+    /// Set a callback fired when a producer armed with ArmSpaceNotify() may
+    /// continue. Used by producers that cannot block, such as completion port
+    /// threads. Invoked from the consumer thread, or the thread resuming a
+    /// paused buffer. Must be set before the producer starts.
+    void SetSpaceAvailableCallback(std::function<void()> callback) {
+        m_spaceCallback = std::move(callback);
+    }
+
+    /// Ask for the space-available callback instead of blocking
+    /// @param size Callable returning the current fill level
+    /// @return true if the callback will fire once the consumer drains to the
+    /// low watermark; false if there is already room (retry immediately)
+    template <typename SizeFn>
+    bool ArmSpaceNotify(SizeFn&& size) noexcept {
+        m_producerWaiting.store(true, std::memory_order_seq_cst);
+        if (m_cancelled.load(std::memory_order_seq_cst) || CanResume(size())) {
+            // Take the flag back unless the consumer already claimed it, in
+            // which case the callback is coming anyway
+            return !m_producerWaiting.exchange(false, std::memory_order_acq_rel);
+        }
+        return true;
+    }
+
+    /// Hold the producer as if the buffer were full (any thread)
+    /// Resuming wakes a held producer as a drain to the low watermark would.
+    void SetPaused(bool paused) noexcept {
+        m_paused.store(paused, std::memory_order_seq_cst);
+        if (!paused) {
+            OnSpaceFreed(0);
+        }
+    }
+
+    [[nodiscard]] bool IsPaused() const noexcept { return m_paused.load(std::memory_order_relaxed); }
+
+    /// Signal the consumer if it is waiting for data (after moving the head)
+    void OnDataPublished() noexcept {
+        // Pairs with the seq_cst store of m_consumerWaiting in OnDrained()
+        // and WaitForData()
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!m_consumerWaiting.load(std::memory_order_relaxed) ||
+            !m_consumerWaiting.exchange(false, std::memory_order_acq_rel)) {
+            return;
+        }
+
+        m_dataEpoch.fetch_add(1, std::memory_order_release);
+        m_dataEpoch.notify_all();
+        if (m_dataCallback) {
+            m_dataCallback();
+        }
+    }
+
+    // ========================================================================
+    // Data Notification (consumer side)
+    // ========================================================================
+
+    /// Set a callback fired when data arrives in an empty buffer
+    /// Typically signals a Win32 event the UI thread waits on. Invoked from
+    /// the producer thread (or, rarely, from the consumer thread when a write
+    /// races with the buffer being drained). Must be set before the producer
+    /// starts.
+    void SetDataAvailableCallback(std::function<void()> callback) {
+        m_dataCallback = std::move(callback);
+    }
+
+    /// Block until the buffer is non-empty
+    /// @param size Callable returning the current fill level
+    /// @return true when data is available, false if CancelWaits() was called
+    template <typename SizeFn>
+    bool WaitForData(SizeFn&& size) noexcept {
+        for (;;) {
+            if (m_cancelled.load(std::memory_order_acquire)) {
+                return false;
+            }
+            if (size() > 0) {
+                return true;
+            }
+
+            const uint32_t epoch = m_dataEpoch.load(std::memory_order_acquire);
+            m_consumerWaiting.store(true, std::memory_order_seq_cst);
+
+            // Re-check after arming: a write may have landed in between
+            if (m_cancelled.load(std::memory_order_seq_cst) || size() > 0) {
+                continue;
+            }
+
+            m_dataEpoch.wait(epoch, std::memory_order_acquire);
+        }
+    }
+
+    /// Wake a blocked producer once the fill level is at the low watermark
+    /// (after moving the tail, or on resuming)
+    /// @param fillLevel Fill level seen by the consumer; may overestimate
+    void OnSpaceFreed(size_t fillLevel) noexcept {
+        OnSpaceFreedWith([fillLevel] { return fillLevel; });
+    }
+
+    /// As above, with the fill level read only if a producer is held (for
+    /// a consumer whose own view of it may underestimate)
+    /// @param size Callable returning the current fill level
+    template <typename SizeFn>
+    void OnSpaceFreedWith(SizeFn&& size) noexcept {
+        // Pairs with the seq_cst store of m_producerWaiting in WaitForSpace()
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!m_producerWaiting.load(std::memory_order_relaxed) || !CanResume(size())) {
+            return;
+        }
+
+        if (!m_producerWaiting.exchange(false, std::memory_order_acq_rel)) {
+            return;
+        }
+
+        m_spaceEpoch.fetch_add(1, std::memory_order_release);
+        m_spaceEpoch.notify_one();
+        if (m_spaceCallback) {
+            m_spaceCallback();
+        }
+    }
+
+    /// Re-arm the data notification after the consumer emptied the buffer
+    /// @param size Callable returning the current fill level
+    template <typename SizeFn>
+    void OnDrained(SizeFn&& size) noexcept {
+        m_consumerWaiting.store(true, std::memory_order_seq_cst);
+
+        // A write published before the flag was set did not see it; take
+        // over the notification so that data is never left unsignaled
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (size() > 0) {
+            OnDataPublished();
+        }
+    }
+
+    // ========================================================================
+    // Lifetime
+    // ========================================================================
+
+    /// Wake any blocked producer or consumer and make further waits fail
+    /// immediately (e.g. during shutdown). Cleared by Reset().
+    void CancelWaits() noexcept {
+        m_cancelled.store(true, std::memory_order_seq_cst);
+        m_spaceEpoch.fetch_add(1, std::memory_order_release);
+        m_spaceEpoch.notify_all();
+        m_dataEpoch.fetch_add(1, std::memory_order_release);
+        m_dataEpoch.notify_all();
+    }
+
+    /// Return to the initial state (not thread-safe - buffer must be idle)
+    void Reset() noexcept {
+        m_cancelled.store(false, std::memory_order_relaxed);
+        m_paused.store(false, std::memory_order_relaxed);
+        m_producerWaiting.store(false, std::memory_order_relaxed);
+        m_consumerWaiting.store(true, std::memory_order_relaxed);
+    }
+
+private:
+    /// Check if a held producer may continue at a fill level
+    [[nodiscard]] bool CanResume(size_t fillLevel) const noexcept {
+        return fillLevel <= m_lowWatermark && !m_paused.load(std::memory_order_seq_cst);
+    }
+
+    const size_t m_capacity;
+    size_t m_highWatermark;                            ///< Block at this fill level
+    size_t m_lowWatermark;                             ///< Resume at this fill level
+
+    alignas(64) std::atomic<uint32_t> m_spaceEpoch{0}; ///< Producer wait word
+    std::atomic<bool> m_producerWaiting{false};        ///< Producer is asleep
+    std::atomic<bool> m_cancelled{false};              ///< CancelWaits() was called
+    std::atomic<bool> m_paused{false};                 ///< SetPaused(): hold the producer
+    std::function<void()> m_spaceCallback;             ///< Space-available hook
+
+    alignas(64) std::atomic<uint32_t> m_dataEpoch{0};  ///< Consumer wait word
+    std::atomic<bool> m_consumerWaiting{true};         ///< Next write must signal
+    std::function<void()> m_dataCallback;              ///< Data-available hook
+};
+
+} // namespace Console3::Core
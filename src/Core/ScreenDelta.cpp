@@ -0,0 +1,596 @@
+// Console3 - ScreenDelta.cpp
+// Compact frames of a screen's changes, for viewers of a detached session
+
+#include "Core/ScreenDelta.h"
+#include "Core/Sgr.h"
+#include "Core/TerminalBuffer.h"
+#include "Core/Utf.h"
+#include "Core/Varint.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+namespace Console3::Core {
+
+namespace {
+
+// Frame flags
+constexpr uint8_t kCursorVisible = 0x01;
+constexpr uint8_t kApplicationCursor = 0x02;
+constexpr uint8_t kApplicationKeypad = 0x04;
+constexpr uint8_t kAltScreen = 0x08;
+constexpr uint8_t kTitle = 0x10;
+
+// Run style flags: which parts differ from the previous run's (the first
+// run's from a default cell), and how the text is spelled
+constexpr uint8_t kRunFg = 0x01;
+constexpr uint8_t kRunBg = 0x02;
+constexpr uint8_t kRunAttrs = 0x04;
+constexpr uint8_t kRunComplex = 0x08;
+
+// Largest screen a frame may describe (a corrupt frame allocates no more)
+constexpr uint64_t kMaxDimension = 4096;
+
+static_assert(sizeof(Cell) == 12, "rows are hashed as 32-bit words");
+
+void PutColor(std::string& out, CellColor color) {
+    out += static_cast<char>(color.r);
+    out += static_cast<char>(color.g);
+    out += static_cast<char>(color.b);
+    out += static_cast<char>(color.flags);
+}
+
+void PushUtf8(std::string& out, uint32_t cp) {
+    char units[4];
+    out.append(units, PutUtf8(cp, units));
+}
+
+/// Sequential reader of a frame; every Get fails past the end
+class FrameReader {
+public:
+    explicit FrameReader(std::string_view data) : m_data(data) {}
+
+    bool GetByte(uint8_t& value) {
+        if (m_pos >= m_data.size()) {
+            return false;
+        }
+        value = static_cast<uint8_t>(m_data[m_pos++]);
+        return true;
+    }
+
+    bool GetVarint(uint64_t& value) { return Core::GetVarint(m_data, m_pos, value); }
+
+    bool GetBytes(size_t length, std::string_view& bytes) {
+        if (length > m_data.size() - m_pos) {
+            return false;
+        }
+        bytes = m_data.substr(m_pos, length);
+        m_pos += length;
+        return true;
+    }
+
+    bool GetColor(CellColor& color) {
+        std::string_view bytes;
+        if (!GetBytes(4, bytes)) {
+            return false;
+        }
+        color.r = static_cast<uint8_t>(bytes[0]);
+        color.g = static_cast<uint8_t>(bytes[1]);
+        color.b = static_cast<uint8_t>(bytes[2]);
+        color.flags = static_cast<uint8_t>(bytes[3]);
+        return true;
+    }
+
+    [[nodiscard]] bool AtEnd() const noexcept { return m_pos == m_data.size(); }
+
+private:
+    std::string_view m_data;
+    size_t m_pos = 0;
+};
+
+/// Decode one UTF-8 character; malformed bytes come out as U+FFFD
+uint32_t NextUtf8(std::string_view text, size_t& pos) {
+    const auto lead = static_cast<uint8_t>(text[pos++]);
+    int extra = lead < 0x80 ? 0 : lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : -1;
+    if (extra < 0) {
+        return 0xFFFD;
+    }
+    uint32_t cp = extra == 0 ? lead : lead & (0x3F >> extra);
+    for (; extra > 0; --extra) {
+        if (pos >= text.size() || (static_cast<uint8_t>(text[pos]) & 0xC0) != 0x80) {
+            return 0xFFFD;
+        }
+        cp = (cp << 6) | (static_cast<uint8_t>(text[pos++]) & 0x3F);
+    }
+    return cp;
+}
+
+[[nodiscard]] uint64_t HashRow(std::span<const Cell> cells) noexcept {
+    uint64_t hash = 0xCBF29CE484222325ull ^ cells.size();
+    for (const Cell& cell : cells) {
+        uint32_t words[3];
+        std::memcpy(words, &cell, sizeof(words));
+        for (const uint32_t word : words) {
+            hash = (hash ^ word) * 0x100000001B3ull;
+        }
+    }
+    return hash;
+}
+
+/// Cells up to the last one that isn't a default blank
+[[nodiscard]] size_t TrimmedLength(std::span<const Cell> cells) noexcept {
+    const Cell blank;
+    size_t length = cells.size();
+    while (length > 0 && cells[length - 1] == blank) {
+        --length;
+    }
+    return length;
+}
+
+/// Encode a row from its style runs (TerminalBuffer::GetStyleRuns), which
+/// already split it where the style changes
+void EncodeRow(std::span<const Cell> cells, std::span<const StyleRun> styleRuns, std::string& out) {
+    const size_t length = TrimmedLength(cells);
+
+    // The runs within the trimmed length: the count goes before them
+    struct Run {
+        size_t start;
+        size_t end;
+    };
+    size_t runCount = 0;
+    while (runCount < styleRuns.size() && styleRuns[runCount].start < length) {
+        ++runCount;
+    }
+
+    PutVarint(out, runCount);
+    Cell style;
+    for (const StyleRun& styleRun : styleRuns.first(runCount)) {
+        const Run run{styleRun.start, std::min<size_t>(styleRun.End(), length)};
+        const Cell& first = cells[run.start];
+        bool complex = false;
+        for (size_t col = run.start; col < run.end && !complex; ++col) {
+            complex = cells[col].width != 1 || cells[col].grapheme;
+        }
+
+        uint8_t flags = complex ? kRunComplex : 0;
+        flags |= first.fg != style.fg ? kRunFg : 0;
+        flags |= first.bg != style.bg ? kRunBg : 0;
+        flags |= first.attrBits != style.attrBits ? kRunAttrs : 0;
+        out += static_cast<char>(flags);
+        if (flags & kRunFg) {
+            PutColor(out, first.fg);
+        }
+        if (flags & kRunBg) {
+            PutColor(out, first.bg);
+        }
+        if (flags & kRunAttrs) {
+            out += static_cast<char>(first.attrBits);
+        }
+        style = first;
+
+        if (!complex) {
+            PutVarint(out, run.end - run.start);
+            thread_local std::string text;
+            text.clear();
+            for (size_t col = run.start; col < run.end; ++col) {
+                PushUtf8(text, cells[col].code);
+            }
+            PutVarint(out, text.size());
+            out += text;
+            continue;
+        }
+
+        // A wide cell's continuation is implied, not sent
+        size_t count = 0;
+        for (size_t col = run.start; col < run.end; ++col) {
+            ++count;
+            if (cells[col].width == 2 && col + 1 < run.end && cells[col + 1].width == 0) {
+                ++col;
+            }
+        }
+        PutVarint(out, count);
+        for (size_t col = run.start; col < run.end; ++col) {
+            const Cell& cell = cells[col];
+            const std::span<const uint32_t> combining = cell.Combining();
+            const uint64_t wide = cell.width == 2 ? 1 : 0;
+            const uint64_t marks = combining.empty() ? 0 : 2;
+            const uint32_t cp = cell.width == 0 ? Cell::kContinuation : cell.Codepoint();
+            PutVarint(out, (static_cast<uint64_t>(cp) << 2) | wide | marks);
+            if (marks) {
+                PutVarint(out, combining.size());
+                for (const uint32_t mark : combining) {
+                    PutVarint(out, mark);
+                }
+            }
+            if (wide && col + 1 < run.end && cells[col + 1].width == 0) {
+                ++col;
+            }
+        }
+    }
+}
+
+bool DecodeRow(FrameReader& reader, Row& row) {
+    const Cell blank;
+    std::fill(row.begin(), row.end(), blank);
+
+    uint64_t runCount = 0;
+    if (!reader.GetVarint(runCount)) {
+        return false;
+    }
+    Cell style;
+    size_t col = 0;
+    for (uint64_t run = 0; run < runCount; ++run) {
+        uint8_t flags = 0;
+        if (!reader.GetByte(flags) || ((flags & kRunFg) && !reader.GetColor(style.fg)) ||
+            ((flags & kRunBg) && !reader.GetColor(style.bg))) {
+            return false;
+        }
+        if (flags & kRunAttrs) {
+            uint8_t attrs = 0;
+            if (!reader.GetByte(attrs)) {
+                return false;
+            }
+            style.attrBits = attrs;
+        }
+
+        uint64_t count = 0;
+        if (!reader.GetVarint(count) || count > row.size() - col) {
+            return false;
+        }
+
+        if (!(flags & kRunComplex)) {
+            uint64_t byteLength = 0;
+            std::string_view text;
+            if (!reader.GetVarint(byteLength) || !reader.GetBytes(static_cast<size_t>(byteLength), text)) {
+                return false;
+            }
+            size_t pos = 0;
+            for (uint64_t i = 0; i < count; ++i) {
+                if (pos >= text.size()) {
+                    return false;
+                }
+                Cell& cell = row[col++];
+                cell = style;
+                cell.SetCodepoint(NextUtf8(text, pos) & 0x1FFFFF);
+                cell.width = 1;
+            }
+            continue;
+        }
+
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t value = 0;
+            if (!reader.GetVarint(value) || col >= row.size()) {
+                return false;
+            }
+            const auto cp = static_cast<uint32_t>((value >> 2) & 0x1FFFFF);
+            uint32_t combining[GraphemeTable::kMaxCombining] = {};
+            if (value & 2) {
+                uint64_t marks = 0;
+                if (!reader.GetVarint(marks)) {
+                    return false;
+                }
+                for (uint64_t m = 0; m < marks; ++m) {
+                    uint64_t mark = 0;
+                    if (!reader.GetVarint(mark)) {
+                        return false;
+                    }
+                    if (m < GraphemeTable::kMaxCombining) {
+                        combining[m] = static_cast<uint32_t>(mark & 0x1FFFFF);
+                    }
+                }
+            }
+
+            Cell& cell = row[col++];
+            cell = style;
+            cell.SetChars(cp, combining);
+            cell.width = cp == Cell::kContinuation ? 0 : (value & 1) ? 2 : 1;
+            if ((value & 1) && col < row.size()) {
+                Cell& continuation = row[col++];
+                continuation = style;
+                continuation.SetCodepoint(Cell::kContinuation);
+                continuation.width = 0;
+            }
+        }
+    }
+    return true;
+}
+
+void AppendCursorTo(std::string& out, int row, int col) {
+    char text[32];
+    snprintf(text, sizeof(text), "\x1b[%d;%dH", row + 1, col + 1);
+    out += text;
+}
+
+void AppendMode(std::string& out, int mode, bool set) {
+    char text[16];
+    snprintf(text, sizeof(text), "\x1b[?%d%c", mode, set ? 'h' : 'l');
+    out += text;
+}
+
+/// Paint a row's first cols cells from column 0, erasing past its last
+/// non-blank cell
+void AppendRow(std::string& out, const Row& row, int index, int cols) {
+    const size_t length = std::min(TrimmedLength(row), static_cast<size_t>(cols));
+    AppendCursorTo(out, index, 0);
+    bool styled = false;
+    Cell style;
+    for (size_t col = 0; col < length; ++col) {
+        const Cell& cell = row[col];
+        if (cell.width == 0) {
+            continue;       // Drawn by the wide cell before it
+        }
+        if (cell.width == 2 && col + 1 >= static_cast<size_t>(cols)) {
+            break;          // Half of it would not fit
+        }
+        if (!styled || !SameStyle(cell, style)) {
+            AppendSgr(out, cell);
+            style = cell;
+            styled = true;
+        }
+        PushUtf8(out, cell.Codepoint() == 0 ? U' ' : cell.Codepoint());
+        for (const uint32_t mark : cell.Combining()) {
+            PushUtf8(out, mark);
+        }
+    }
+    out += "\x1b[0m";
+    if (length < static_cast<size_t>(cols)) {
+        out += "\x1b[K";
+    }
+}
+
+} // namespace
+
+// ============================================================================
+// ScreenDeltaEncoder
+// ============================================================================
+
+void ScreenDeltaEncoder::Reset() noexcept {
+    m_hashes.clear();
+    m_cols = 0;
+    m_stateSent = false;
+}
+
+bool ScreenDeltaEncoder::Encode(const TerminalBuffer& buffer, const ScreenState& state, std::string& out) {
+    const int rows = buffer.GetRows();
+    const int cols = buffer.GetCols();
+    if (rows != static_cast<int>(m_hashes.size()) || cols != m_cols) {
+        // A new size: the viewer starts over with blank rows
+        m_hashes.assign(static_cast<size_t>(rows), HashRow(Row(static_cast<size_t>(cols))));
+        m_cols = cols;
+        m_stateSent = false;
+    }
+
+    m_next.resize(static_cast<size_t>(rows));
+    bool changed = false;
+    for (int row = 0; row < rows; ++row) {
+        m_next[row] = HashRow(buffer.GetRow(row));
+        changed |= m_next[row] != m_hashes[row];
+    }
+    const bool titleChanged = !m_stateSent || state.title != m_state.title;
+    if (!changed && m_stateSent && state == m_state) {
+        return false;
+    }
+
+    // Rows the viewer has, by content, for rows that moved. The first
+    // match is tried at the offset the last copy came from, so a scrolled
+    // screen is sent as one run of copies at one distance.
+    std::unordered_map<uint64_t, int> have;
+    if (changed) {
+        have.reserve(static_cast<size_t>(rows));
+        for (int row = rows - 1; row >= 0; --row) {
+            have[m_hashes[row]] = row;
+        }
+    }
+
+    m_ops.clear();
+    uint64_t opCount = 0;
+    int offset = 0;
+    for (int row = 0; row < rows; ++row) {
+        const uint64_t hash = m_next[row];
+        if (hash == m_hashes[row]) {
+            continue;
+        }
+        ++opCount;
+        int source = -1;
+        if (offset != 0 && row + offset >= 0 && row + offset < rows && m_hashes[row + offset] == hash) {
+            source = row + offset;
+        } else if (const auto found = have.find(hash); found != have.end()) {
+            source = found->second;
+            offset = source - row;
+        }
+        if (source >= 0) {
+            PutVarint(m_ops, static_cast<uint64_t>(row) << 1);
+            PutVarint(m_ops, static_cast<uint64_t>(source));
+            ++m_rowsCopied;
+        } else {
+            PutVarint(m_ops, (static_cast<uint64_t>(row) << 1) | 1);
+            EncodeRow(buffer.GetRow(row), buffer.GetStyleRuns(row), m_ops);
+            ++m_rowsSent;
+        }
+    }
+
+    uint8_t flags = 0;
+    flags |= state.cursorVisible ? kCursorVisible : 0;
+    flags |= state.applicationCursor ? kApplicationCursor : 0;
+    flags |= state.applicationKeypad ? kApplicationKeypad : 0;
+    flags |= state.altScreen ? kAltScreen : 0;
+    flags |= titleChanged ? kTitle : 0;
+
+    PutVarint(out, static_cast<uint64_t>(rows));
+    PutVarint(out, static_cast<uint64_t>(cols));
+    out += static_cast<char>(flags);
+    PutVarint(out, static_cast<uint64_t>(std::max(state.cursorRow, 0)));
+    PutVarint(out, static_cast<uint64_t>(std::max(state.cursorCol, 0)));
+    PutVarint(out, static_cast<uint64_t>(std::max(state.mouseMode, 0)));
+    if (titleChanged) {
+        PutVarint(out, state.title.size());
+        out += state.title;
+    }
+    PutVarint(out, opCount);
+    out += m_ops;
+
+    m_hashes.swap(m_next);
+    m_state = state;
+    m_stateSent = true;
+    return true;
+}
+
+// ============================================================================
+// ScreenDeltaDecoder
+// ============================================================================
+
+bool ScreenDeltaDecoder::Apply(std::string_view frame) {
+    FrameReader reader(frame);
+    uint64_t rows = 0;
+    uint64_t cols = 0;
+    uint8_t flags = 0;
+    uint64_t cursorRow = 0;
+    uint64_t cursorCol = 0;
+    uint64_t mouseMode = 0;
+    if (!reader.GetVarint(rows) || !reader.GetVarint(cols) || !reader.GetByte(flags) ||
+        !reader.GetVarint(cursorRow) || !reader.GetVarint(cursorCol) || !reader.GetVarint(mouseMode) ||
+        rows == 0 || cols == 0 || rows > kMaxDimension || cols > kMaxDimension) {
+        return false;
+    }
+
+    ScreenState state = m_state;
+    state.cursorRow = static_cast<int>(std::min(cursorRow, rows - 1));
+    state.cursorCol = static_cast<int>(std::min(cursorCol, cols - 1));
+    state.cursorVisible = (flags & kCursorVisible) != 0;
+    state.applicationCursor = (flags & kApplicationCursor) != 0;
+    state.applicationKeypad = (flags & kApplicationKeypad) != 0;
+    state.altScreen = (flags & kAltScreen) != 0;
+    state.mouseMode = static_cast<int>(std::min<uint64_t>(mouseMode, 3));
+    if (flags & kTitle) {
+        uint64_t length = 0;
+        std::string_view title;
+        if (!reader.GetVarint(length) || !reader.GetBytes(static_cast<size_t>(length), title)) {
+            return false;
+        }
+        state.title.assign(title);
+    }
+
+    // Copies read the rows as they were before this frame
+    const bool resized = rows != m_rows.size() || static_cast<int>(cols) != m_cols;
+    std::vector<Row> next = m_rows;
+    if (resized) {
+        next.assign(static_cast<size_t>(rows), Row(static_cast<size_t>(cols)));
+    }
+    std::vector<uint8_t> changed(static_cast<size_t>(rows), resized ? 1 : 0);
+
+    // The distance most copies came from: the frame's scroll
+    std::unordered_map<int, uint64_t> distances;
+    uint64_t opCount = 0;
+    if (!reader.GetVarint(opCount) || opCount > rows) {
+        return false;
+    }
+    for (uint64_t op = 0; op < opCount; ++op) {
+        uint64_t value = 0;
+        if (!reader.GetVarint(value) || (value >> 1) >= rows) {
+            return false;
+        }
+        const auto row = static_cast<size_t>(value >> 1);
+        changed[row] = 1;
+        if (value & 1) {
+            if (!DecodeRow(reader, next[row])) {
+                return false;
+            }
+            continue;
+        }
+        uint64_t source = 0;
+        if (!reader.GetVarint(source) || resized || source >= rows) {
+            return false;
+        }
+        next[row] = m_rows[static_cast<size_t>(source)];
+        ++distances[static_cast<int>(source) - static_cast<int>(row)];
+    }
+    if (!reader.AtEnd()) {
+        return false;
+    }
+
+    int scroll = 0;
+    uint64_t most = 0;
+    for (const auto& [distance, count] : distances) {
+        if (distance > 0 && count > most) {
+            scroll = distance;
+            most = count;
+        }
+    }
+
+    m_previous = std::move(m_rows);
+    m_rows = std::move(next);
+    m_changed = std::move(changed);
+    m_cols = static_cast<int>(cols);
+    m_scroll = scroll;
+    m_resized = resized || state.altScreen != m_state.altScreen;
+    m_previousState = m_state;
+    m_stateKnown = !m_previous.empty();
+    m_state = std::move(state);
+    return true;
+}
+
+void ScreenDeltaDecoder::RenderVt(std::string& out, int rows, int cols) const {
+    if (m_rows.empty()) {
+        return;
+    }
+    const ScreenState& state = m_state;
+    const ScreenState& before = m_previousState;
+    const bool known = m_stateKnown;
+
+    out += "\x1b[?25l";
+    if (!known || state.altScreen != before.altScreen) {
+        AppendMode(out, 1049, state.altScreen);
+    }
+    if (!known || state.applicationCursor != before.applicationCursor) {
+        AppendMode(out, 1, state.applicationCursor);
+    }
+    if (!known || state.applicationKeypad != before.applicationKeypad) {
+        out += state.applicationKeypad ? "\x1b=" : "\x1b>";
+    }
+    if (!known || state.mouseMode != before.mouseMode) {
+        // 1 = clicks, 2 = drags, 3 = all motion; the host encodes the
+        // reports, so the local protocol is only what turns them on
+        AppendMode(out, 1000, state.mouseMode == 1);
+        AppendMode(out, 1002, state.mouseMode == 2);
+        AppendMode(out, 1003, state.mouseMode == 3);
+    }
+    if (!known || state.title != before.title) {
+        out += "\x1b]2;";
+        out += state.title;
+        out += "\x1b\\";
+    }
+
+    const int shown = std::min(rows, GetRows());
+    const bool sameSize = rows == GetRows() && cols == m_cols;
+    const bool repaintAll = m_resized || !known;
+
+    // A scroll is replayed as line feeds at the bottom, which carries the
+    // top rows into the terminal's scrollback; then only the rows that
+    // differ from the moved ones are painted
+    const int scroll = sameSize && !repaintAll && m_previous.size() == m_rows.size() ? m_scroll : 0;
+    if (scroll > 0) {
+        out += "\x1b[0m\x1b[r";
+        AppendCursorTo(out, rows - 1, 0);
+        out.append(static_cast<size_t>(scroll), '\n');
+    }
+
+    const Row blank(static_cast<size_t>(m_cols));
+    for (int row = 0; row < shown; ++row) {
+        bool paint = repaintAll || m_changed[static_cast<size_t>(row)];
+        if (scroll > 0) {
+            const Row& moved = row + scroll < GetRows() ? m_previous[static_cast<size_t>(row + scroll)] : blank;
+            paint = m_rows[static_cast<size_t>(row)] != moved;
+        }
+        if (paint) {
+            AppendRow(out, m_rows[static_cast<size_t>(row)], row, cols);
+        }
+    }
+
+    AppendCursorTo(out, std::min(state.cursorRow, rows - 1), std::min(state.cursorCol, cols - 1));
+    if (state.cursorVisible) {
+        out += "\x1b[?25h";
+    }
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,114 @@
+#pragma once
+// Console3 - ScreenDelta.h
+// Compact frames of a screen's changes, for viewers of a detached session
+//
+// A session host (see SessionHost) sends each viewer the screen as a series
+// of frames. A frame holds only the rows that differ from what that viewer
+// was last sent: the encoder keeps a hash per row of the viewer's copy, so
+// a viewer that falls behind is simply sent the difference from wherever it
+// is, and the bytes sent follow what changed rather than how much output
+// produced it. A row the viewer already has elsewhere (the screen scrolled,
+// lines were inserted) is sent as a copy from that row; any other row as
+// runs of cells sharing a style, each run's characters as UTF-8, with the
+// row's trailing blanks left off.
+//
+// Frame layout (integers are LEB128 varints, colors 4 bytes as CellColor):
+//
+//   rows cols flags cursorRow cursorCol mouseMode [titleLength title] opCount
+//   op = (row << 1) | 0, sourceRow                  copy of the viewer's row
+//      | (row << 1) | 1, runCount, run...           cells
+//   run = styleFlags [fg] [bg] [attrs] cellCount text
+//   text = byteLength UTF-8 (one column per character), or with
+//          kRunComplex, per cell (codepoint << 2 | wide | combining << 1)
+//          [combiningCount codepoint...]
+//
+// Row hashes are 64-bit; two different rows hashing the same would leave a
+// viewer's row stale until it next changes.
+//
+// The decoder keeps the viewer's copy of the screen and turns each frame
+// into VT sequences for a local emulator (see HostClient): only the rows
+// that changed are repainted, and a frame that scrolled the screen is
+// replayed as line feeds, so lines pass through the viewer's scrollback.
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Core/Cell.h"
+
+namespace Console3::Core {
+
+class TerminalBuffer;
+
+/// Screen state sent with every frame besides the rows
+struct ScreenState {
+    int cursorRow = 0;
+    int cursorCol = 0;
+    bool cursorVisible = true;
+    bool applicationCursor = false;     ///< DECCKM
+    bool applicationKeypad = false;     ///< DECKPAM
+    bool altScreen = false;
+    int mouseMode = 0;                  ///< Emulation::TermProps::mouseMode
+    std::string title;                  ///< UTF-8
+
+    bool operator==(const ScreenState&) const = default;
+};
+
+/// Turns a buffer's screen into frames for one viewer
+class ScreenDeltaEncoder {
+public:
+    /// Forget what the viewer has; the next frame sends every row
+    void Reset() noexcept;
+
+    /// Append a frame of what changed since the last one
+    /// @return false if nothing changed (nothing appended)
+    bool Encode(const TerminalBuffer& buffer, const ScreenState& state, std::string& out);
+
+    /// Get rows sent as cells and as copies, for telemetry
+    [[nodiscard]] uint64_t GetRowsSent() const noexcept { return m_rowsSent; }
+    [[nodiscard]] uint64_t GetRowsCopied() const noexcept { return m_rowsCopied; }
+
+private:
+    std::vector<uint64_t> m_hashes;     ///< The viewer's rows
+    int m_cols = 0;
+    ScreenState m_state;
+    bool m_stateSent = false;
+    uint64_t m_rowsSent = 0;
+    uint64_t m_rowsCopied = 0;
+
+    // Scratch
+    std::vector<uint64_t> m_next;
+    std::string m_ops;
+};
+
+/// Applies frames to a copy of the screen and renders them as VT
+class ScreenDeltaDecoder {
+public:
+    /// Apply a frame
+    /// @return false if it is malformed (the copy is left as it was)
+    bool Apply(std::string_view frame);
+
+    /// Append VT that brings a terminal showing the previous frame to this
+    /// one, clipped to the terminal's size (a size other than the frame's
+    /// repaints every changed row instead of scrolling)
+    void RenderVt(std::string& out, int rows, int cols) const;
+
+    [[nodiscard]] int GetRows() const noexcept { return static_cast<int>(m_rows.size()); }
+    [[nodiscard]] int GetCols() const noexcept { return m_cols; }
+    [[nodiscard]] const Row& GetRow(int row) const { return m_rows[static_cast<size_t>(row)]; }
+    [[nodiscard]] const ScreenState& GetState() const noexcept { return m_state; }
+
+private:
+    std::vector<Row> m_rows;
+    std::vector<Row> m_previous;        ///< Before the last frame
+    std::vector<uint8_t> m_changed;     ///< Rows the last frame sent
+    int m_cols = 0;
+    int m_scroll = 0;                   ///< Rows the last frame scrolled up by (0 = none)
+    bool m_resized = true;              ///< The last frame changed the size (repaint all)
+    ScreenState m_state;
+    ScreenState m_previousState;
+    bool m_stateKnown = false;          ///< m_previousState was rendered
+};
+
+} // namespace Console3::Core
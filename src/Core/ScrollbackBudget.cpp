@@ -0,0 +1,95 @@
+// Console3 - ScrollbackBudget.cpp
+// Memory limit shared by the scrollback of every session
+
+#include "Core/ScrollbackBudget.h"
+#include "Core/ScrollbackStore.h"
+#include <algorithm>
+
+namespace Console3::Core {
+
+ScrollbackBudget& ScrollbackBudget::Shared() {
+    static ScrollbackBudget s_budget;
+    return s_budget;
+}
+
+void ScrollbackBudget::SetLimit(size_t bytes) {
+    m_limit.store(bytes, std::memory_order_relaxed);
+    if (IsOverLimit()) {
+        Enforce();
+    }
+}
+
+ScrollbackBudgetStats ScrollbackBudget::GetStats() const {
+    std::lock_guard lock(m_lock);
+    ScrollbackBudgetStats stats;
+    stats.limit = GetLimit();
+    stats.usage = GetUsage();
+    stats.stores = m_stores.size();
+    stats.evictions = m_evictions;
+    return stats;
+}
+
+void ScrollbackBudget::Add(ScrollbackStore* store) {
+    std::lock_guard lock(m_lock);
+    m_stores.push_back(store);
+}
+
+void ScrollbackBudget::Remove(ScrollbackStore* store) {
+    std::lock_guard lock(m_lock);
+    std::erase(m_stores, store);
+}
+
+void ScrollbackBudget::Replace(ScrollbackStore* from, ScrollbackStore* to) {
+    std::lock_guard lock(m_lock);
+    std::replace(m_stores.begin(), m_stores.end(), from, to);
+}
+
+void ScrollbackBudget::Charge(size_t previous, size_t current) noexcept {
+    if (current > previous) {
+        m_usage.fetch_add(current - previous, std::memory_order_relaxed);
+    } else {
+        m_usage.fetch_sub(previous - current, std::memory_order_relaxed);
+    }
+}
+
+void ScrollbackBudget::Enforce() {
+    std::lock_guard lock(m_lock);
+    const size_t limit = GetLimit();
+    if (limit == 0 || GetUsage() <= limit) {
+        return;
+    }
+
+    // Free an eighth more than needed, so a store being written to does not
+    // come back here on every line
+    const size_t target = limit - limit / 8;
+
+    std::vector<ScrollbackStore*> order = m_stores;
+    std::sort(order.begin(), order.end(), [](const ScrollbackStore* a, const ScrollbackStore* b) {
+        return a->m_lastUse < b->m_lastUse;
+    });
+
+    ++m_evictions;
+    const auto excess = [&] {
+        const size_t usage = GetUsage();
+        return usage > target ? usage - target : 0;
+    };
+
+    // A store gives up everything it can keep without losing lines before
+    // the next one is touched; lines are only dropped once that runs out
+    for (ScrollbackStore* store : order) {
+        for (auto step : {ScrollbackStore::Relief::Compress, ScrollbackStore::Relief::Spill}) {
+            if (excess() == 0) {
+                return;
+            }
+            store->Shed(step, excess());
+        }
+    }
+    for (ScrollbackStore* store : order) {
+        if (excess() == 0) {
+            return;
+        }
+        store->Shed(ScrollbackStore::Relief::Drop, excess());
+    }
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,87 @@
+#pragma once
+// Console3 - ScrollbackBudget.h
+// Memory limit shared by the scrollback of every session
+//
+// Each ScrollbackStore bounds its own line count, but with many tabs open the
+// total is what matters. Stores report the bytes they hold in memory here;
+// when the sum goes over the limit, memory is taken back from the store read
+// least recently first (the tab on screen touches its store every frame, so
+// background tabs go first): its hot rows are compressed, then its compressed
+// blocks are spilled to a temporary file. Only if that is not enough are the
+// oldest lines dropped, again least recently used first.
+//
+// Eviction works on other stores than the one that went over the limit, so
+// all stores sharing a budget must be used from one thread. In Console3 that
+// is the UI thread: the emulation thread's buffer keeps no scrollback.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace Console3::Core {
+
+class ScrollbackStore;
+
+/// Budget usage snapshot
+struct ScrollbackBudgetStats {
+    size_t limit = 0;            ///< Bytes allowed (0 = no limit)
+    size_t usage = 0;            ///< Bytes held in memory by all stores
+    size_t stores = 0;           ///< Stores holding scrollback
+    uint64_t evictions = 0;      ///< Times usage was brought back under the limit
+};
+
+/// Process-wide scrollback memory budget with least-recently-used eviction
+class ScrollbackBudget {
+public:
+    ScrollbackBudget() = default;
+
+    // Non-copyable, non-movable
+    ScrollbackBudget(const ScrollbackBudget&) = delete;
+    ScrollbackBudget& operator=(const ScrollbackBudget&) = delete;
+
+    /// Get the budget used by every scrollback store
+    static ScrollbackBudget& Shared();
+
+    /// Set the bytes all scrollback may hold in memory, evicting at once if
+    /// already over it
+    /// @param bytes Limit, or 0 for none
+    void SetLimit(size_t bytes);
+
+    [[nodiscard]] size_t GetLimit() const noexcept { return m_limit.load(std::memory_order_relaxed); }
+    [[nodiscard]] size_t GetUsage() const noexcept { return m_usage.load(std::memory_order_relaxed); }
+
+    [[nodiscard]] bool IsOverLimit() const noexcept {
+        const size_t limit = GetLimit();
+        return limit != 0 && GetUsage() > limit;
+    }
+
+    [[nodiscard]] ScrollbackBudgetStats GetStats() const;
+
+private:
+    friend class ScrollbackStore;
+
+    /// Start, stop or move the tracking of a store
+    void Add(ScrollbackStore* store);
+    void Remove(ScrollbackStore* store);
+    void Replace(ScrollbackStore* from, ScrollbackStore* to);
+
+    /// Record a store's change in memory use
+    void Charge(size_t previous, size_t current) noexcept;
+
+    /// Next value of the use clock that orders stores for eviction
+    [[nodiscard]] uint64_t NextUse() noexcept { return m_clock.fetch_add(1, std::memory_order_relaxed) + 1; }
+
+    /// Evict until usage is back below the low-water mark
+    void Enforce();
+
+    mutable std::mutex m_lock;
+    std::vector<ScrollbackStore*> m_stores;
+    std::atomic<size_t> m_limit{0};
+    std::atomic<size_t> m_usage{0};
+    std::atomic<uint64_t> m_clock{0};
+    uint64_t m_evictions = 0;
+};
+
+} // namespace Console3::Core
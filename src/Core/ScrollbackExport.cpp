@@ -0,0 +1,481 @@
+// Console3 - ScrollbackExport.cpp
+// Saves a session's whole history (scrollback plus screen) to a file
+
+#include "Core/ScrollbackExport.h"
+#include "Core/Sgr.h"
+#include "Core/TerminalBuffer.h"
+#include "Core/Utf.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace Console3::Core {
+
+namespace {
+
+/// Channel levels of the xterm 6x6x6 color cube
+constexpr uint8_t kCubeLevels[6] = {0, 95, 135, 175, 215, 255};
+
+void PushUtf8(std::string& out, uint32_t cp) {
+    char units[4];
+    out.append(units, PutUtf8(cp, units));
+}
+
+/// Check if a cell shows nothing (a blank in the default style)
+[[nodiscard]] bool IsPlainBlank(const Cell& cell, bool styled) noexcept {
+    const uint32_t cp = cell.Codepoint();
+    return cell.width == 1 && (cp == U' ' || cp == 0) && !cell.HasCombining() &&
+           (!styled || (cell.bg.IsDefault() && cell.attrBits == 0));
+}
+
+} // namespace
+
+// ============================================================================
+// Slice
+// ============================================================================
+
+void ScrollbackExport::Slice::Add(std::span<const Cell> line, bool continues, std::span<const StyleRun> lineRuns) {
+    cells.insert(cells.end(), line.begin(), line.end());
+    lineEnds.push_back(static_cast<uint32_t>(cells.size()));
+    continuation.push_back(continues ? 1 : 0);
+    if (!lineRuns.empty()) {
+        runs.insert(runs.end(), lineRuns.begin(), lineRuns.end());
+        runEnds.push_back(static_cast<uint32_t>(runs.size()));
+    }
+}
+
+// ============================================================================
+// ScrollbackExport (UI thread)
+// ============================================================================
+
+ScrollbackExport::~ScrollbackExport() {
+    Cancel();
+}
+
+bool ScrollbackExport::Start(const TerminalBuffer& buffer, const std::wstring& path, ExportFormat format,
+                             const ColorScheme& colors) {
+    if (m_active) {
+        SetLastError(ERROR_BUSY);
+        return false;
+    }
+    if (m_writer.joinable()) {
+        m_writer.join();
+    }
+
+    m_file.reset(CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                             FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, nullptr));
+    if (!m_file) {
+        return false;
+    }
+    for (Write& write : m_writes) {
+        if (!write.done && !write.done.try_create(wil::EventOptions::ManualReset, nullptr)) {
+            const DWORD error = GetLastError();
+            m_file.reset();
+            DeleteFileW(path.c_str());
+            SetLastError(error);
+            return false;
+        }
+        write.pending = false;
+        write.data.reserve(kWriteBytes);
+    }
+
+    m_format = format;
+    m_colors = colors;
+    m_nextWrite = 0;
+    m_fileOffset = 0;
+    m_firstLine = true;
+    m_pendingBlanks = 0;
+    m_styled = false;
+
+    // Scrollback as it stands, and the screen as it is now
+    const ScrollbackStore& store = buffer.GetScrollbackStore();
+    m_nextId = store.GetFirstId();
+    m_endId = store.GetEndId();
+    m_screen = Slice{};
+    for (int row = 0; row < buffer.GetRows(); ++row) {
+        m_screen.Add(buffer.GetRow(row), buffer.IsContinuation(row), buffer.GetStyleRuns(row));
+    }
+    m_screen.last = true;
+    m_screenQueued = false;
+    m_path = path;
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_slices.clear();
+        m_stop = false;
+        m_done = false;
+        m_progress = ExportProgress{};
+        m_progress.linesTotal = (m_endId - m_nextId) + static_cast<uint64_t>(buffer.GetRows());
+    }
+    m_active = true;
+    m_writer = std::thread(&ScrollbackExport::WriterProc, this);
+    return true;
+}
+
+bool ScrollbackExport::Update(const TerminalBuffer& buffer, size_t lines) {
+    if (!m_active) {
+        return false;
+    }
+    bool done = false;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        done = m_done;
+        if (!done && (m_slices.size() >= kMaxQueuedSlices || m_screenQueued)) {
+            return true;
+        }
+    }
+    if (done) {
+        Finish();
+        return false;
+    }
+
+    // Lines popped back to the screen are no longer history; trimmed ones
+    // are gone
+    const ScrollbackStore& store = buffer.GetScrollbackStore();
+    m_endId = std::min(m_endId, store.GetEndId());
+    uint64_t skipped = 0;
+    if (m_nextId < store.GetFirstId()) {
+        const uint64_t first = std::min(store.GetFirstId(), m_endId);
+        skipped += first > m_nextId ? first - m_nextId : 0;
+        m_nextId = std::max(m_nextId, first);
+    }
+
+    // Oldest first, so each compressed block is decoded once; sealed lines
+    // are decoded by the writer. Store line i has id GetEndId() - 1 - i.
+    Slice slice;
+    const uint64_t end = std::min<uint64_t>(m_endId, m_nextId + lines);
+    slice.view = store.ShareLines(m_nextId, end);
+    if (!slice.view.Empty()) {
+        m_nextId += slice.view.Size();
+    } else {
+        for (uint64_t id = m_nextId; id < end; ++id) {
+            const auto index = static_cast<size_t>(store.GetEndId() - 1 - id);
+            if (const Row* row = store.Get(index)) {
+                slice.Add(*row, store.IsContinuation(index));
+            } else {
+                ++skipped;
+            }
+        }
+        m_nextId = std::max(m_nextId, end);
+    }
+
+    const bool screen = m_nextId >= m_endId;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_progress.linesCopied += slice.view.Size() + slice.lineEnds.size();
+        m_progress.linesSkipped += skipped;
+        if (!slice.view.Empty() || !slice.lineEnds.empty()) {
+            m_slices.push_back(std::move(slice));
+        }
+        if (screen) {
+            m_progress.linesCopied += m_screen.lineEnds.size();
+            m_slices.push_back(std::move(m_screen));
+            m_screenQueued = true;
+        }
+    }
+    m_wake.notify_one();
+    return true;
+}
+
+void ScrollbackExport::Cancel() {
+    if (!m_active) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stop = true;
+    }
+    m_wake.notify_one();
+    Finish();
+
+    // The writer may have completed the file before it saw the stop
+    if (!GetProgress().finished) {
+        DeleteFileW(m_path.c_str());
+    }
+}
+
+ExportProgress ScrollbackExport::GetProgress() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_progress;
+}
+
+void ScrollbackExport::Finish() {
+    if (m_writer.joinable()) {
+        m_writer.join();
+    }
+    m_file.reset();
+    m_screen = Slice{};
+    m_active = false;
+}
+
+// ============================================================================
+// Writer thread
+// ============================================================================
+
+void ScrollbackExport::WriterProc() {
+    std::string out;
+    out.reserve(kWriteBytes);
+    AppendPrologue(out);
+
+    bool ok = true;
+    bool stopped = false;
+    while (ok) {
+        Slice slice;
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_wake.wait(lock, [this] { return m_stop || !m_slices.empty(); });
+            if (m_stop) {
+                stopped = true;
+                break;
+            }
+            slice = std::move(m_slices.front());
+            m_slices.pop_front();
+        }
+
+        for (size_t line = 0; line < slice.view.Size() && ok; ++line) {
+            bool continues = false;
+            if (slice.view.Get(line, m_viewLine, &continues)) {
+                FormatLine(m_viewLine, {}, continues, out);
+            }
+            if (out.size() >= kWriteBytes) {
+                ok = Submit(out);
+            }
+        }
+
+        uint32_t start = 0;
+        uint32_t runStart = 0;
+        for (size_t line = 0; line < slice.lineEnds.size() && ok; ++line) {
+            const uint32_t end = slice.lineEnds[line];
+            std::span<const StyleRun> runs;
+            if (!slice.runEnds.empty()) {
+                runs = std::span<const StyleRun>(slice.runs).subspan(runStart, slice.runEnds[line] - runStart);
+                runStart = slice.runEnds[line];
+            }
+            FormatLine(std::span<const Cell>(slice.cells).subspan(start, end - start), runs,
+                       slice.continuation[line] != 0, out);
+            start = end;
+            if (out.size() >= kWriteBytes) {
+                ok = Submit(out);
+            }
+        }
+        if (ok && slice.last) {
+            AppendEpilogue(out);
+            ok = Submit(out);
+            break;
+        }
+    }
+
+    // Wait for the writes in flight; a cancelled export abandons them
+    if (stopped) {
+        CancelIoEx(m_file.get(), nullptr);
+    }
+    for (Write& write : m_writes) {
+        if (write.pending) {
+            ok = Complete(write) && ok;
+        }
+    }
+    m_file.reset();
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_progress.finished = ok && !stopped;
+    m_progress.failed = !ok && !stopped;
+    m_done = true;
+}
+
+bool ScrollbackExport::Submit(std::string& out) {
+    if (out.empty()) {
+        return true;
+    }
+
+    // The slot's buffer comes back to be filled next
+    Write& write = m_writes[m_nextWrite];
+    m_nextWrite = (m_nextWrite + 1) % kWritesInFlight;
+    if (write.pending && !Complete(write)) {
+        return false;
+    }
+    write.data.swap(out);
+    out.clear();
+
+    write.overlapped = OVERLAPPED{};
+    write.overlapped.Offset = static_cast<DWORD>(m_fileOffset);
+    write.overlapped.OffsetHigh = static_cast<DWORD>(m_fileOffset >> 32);
+    write.overlapped.hEvent = write.done.get();
+    write.done.ResetEvent();
+    m_fileOffset += write.data.size();
+
+    if (!WriteFile(m_file.get(), write.data.data(), static_cast<DWORD>(write.data.size()), nullptr,
+                   &write.overlapped) &&
+        GetLastError() != ERROR_IO_PENDING) {
+        return false;
+    }
+    write.pending = true;
+    return true;
+}
+
+bool ScrollbackExport::Complete(Write& write) {
+    DWORD bytes = 0;
+    const BOOL ok = GetOverlappedResult(m_file.get(), &write.overlapped, &bytes, TRUE);
+    write.pending = false;
+    if (!ok || bytes != write.data.size()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_progress.bytesWritten += bytes;
+    return true;
+}
+
+// ============================================================================
+// Formatting (writer thread)
+// ============================================================================
+
+void ScrollbackExport::FormatLine(std::span<const Cell> line, std::span<const StyleRun> runs, bool continues,
+                                  std::string& out) {
+    // A soft-wrapped line carries on where the one before stopped, blanks
+    // included; otherwise the held-back blanks were trailing ones
+    if (!m_firstLine) {
+        if (continues) {
+            if (m_pendingBlanks > 0) {
+                CloseStyle(out);
+                out.append(m_pendingBlanks, ' ');
+            }
+        } else {
+            CloseStyle(out);
+            out += '\n';
+        }
+    }
+    m_firstLine = false;
+
+    const bool styled = m_format != ExportFormat::Text;
+    size_t end = line.size();
+    while (end > 0 && IsPlainBlank(line[end - 1], styled)) {
+        --end;
+    }
+    m_pendingBlanks = line.size() - end;
+
+    // The style changes only between runs: screen rows come with theirs,
+    // scrollback lines are split here, and plain text is one run
+    const StyleRun whole{0, static_cast<uint16_t>(end)};
+    if (!styled) {
+        runs = {&whole, 1};
+    } else if (runs.empty()) {
+        m_runScratch.clear();
+        AppendStyleRuns(line, 0, end, m_runScratch);
+        runs = m_runScratch;
+    }
+
+    for (const StyleRun& run : runs) {
+        if (run.start >= end) {
+            break;
+        }
+        if (styled) {
+            AppendStyle(line[run.start], out);
+        }
+        const size_t runEnd = std::min<size_t>(run.End(), end);
+        for (size_t col = run.start; col < runEnd; ++col) {
+            const Cell& cell = line[col];
+            if (cell.width == 0) continue;  // Skip continuation cells
+
+            const uint32_t cp = cell.Codepoint();
+            if (m_format == ExportFormat::Html && (cp == U'&' || cp == U'<' || cp == U'>')) {
+                out += cp == U'&' ? "&amp;" : cp == U'<' ? "&lt;" : "&gt;";
+            } else {
+                PushUtf8(out, cp == 0 ? U' ' : cp);
+            }
+            for (const uint32_t combining : cell.Combining()) {
+                PushUtf8(out, combining);
+            }
+        }
+    }
+}
+
+void ScrollbackExport::AppendStyle(const Cell& cell, std::string& out) {
+    const bool plain = cell.fg.IsDefault() && cell.bg.IsDefault() && cell.attrBits == 0;
+    if (m_styled && SameStyle(cell, m_style)) {
+        return;
+    }
+    if (plain) {
+        CloseStyle(out);
+        return;
+    }
+
+    const CellAttributes attrs = cell.Attributes();
+    if (m_format == ExportFormat::Ansi) {
+        // Each style is set in full, so nothing needs closing first
+        AppendSgr(out, cell);
+    } else {
+        CloseStyle(out);
+        uint32_t fg = Resolve(cell.fg, true);
+        uint32_t bg = Resolve(cell.bg, false);
+        if (attrs.reverse) {
+            std::swap(fg, bg);
+        }
+        if (attrs.conceal) {
+            fg = bg;
+        }
+        char text[64];
+        snprintf(text, sizeof(text), "<span style=\"color:#%06X;background:#%06X", fg, bg);
+        out += text;
+        if (attrs.bold) out += ";font-weight:bold";
+        if (attrs.italic) out += ";font-style:italic";
+        if (attrs.underline != 0 || attrs.strikethrough) {
+            out += ";text-decoration:";
+            out += attrs.underline != 0 ? (attrs.strikethrough ? "underline line-through" : "underline")
+                                        : "line-through";
+        }
+        out += "\">";
+    }
+    m_style = cell;
+    m_styled = true;
+}
+
+void ScrollbackExport::CloseStyle(std::string& out) {
+    if (!m_styled) {
+        return;
+    }
+    out += m_format == ExportFormat::Ansi ? "\x1b[0m" : "</span>";
+    m_styled = false;
+}
+
+void ScrollbackExport::AppendPrologue(std::string& out) const {
+    if (m_format != ExportFormat::Html) {
+        return;
+    }
+    char text[512];
+    snprintf(text, sizeof(text),
+             "<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n<title>Console3 scrollback</title>\n"
+             "</head>\n<body style=\"margin:0;background:#%06X;color:#%06X\">\n"
+             "<pre style=\"margin:0;padding:8px;font-family:'Cascadia Mono',Consolas,monospace\">",
+             m_colors.background & 0xFFFFFF, m_colors.foreground & 0xFFFFFF);
+    out += text;
+}
+
+void ScrollbackExport::AppendEpilogue(std::string& out) {
+    CloseStyle(out);
+    out += '\n';
+    if (m_format == ExportFormat::Html) {
+        out += "</pre>\n</body>\n</html>\n";
+    }
+}
+
+uint32_t ScrollbackExport::Resolve(CellColor color, bool foreground) const noexcept {
+    if (color.IsDefault()) {
+        return (foreground ? m_colors.foreground : m_colors.background) & 0xFFFFFF;
+    }
+    if (!color.IsIndexed()) {
+        return (static_cast<uint32_t>(color.r) << 16) | (static_cast<uint32_t>(color.g) << 8) | color.b;
+    }
+
+    // 0-15 from the scheme, then the xterm cube and gray ramp
+    const size_t index = color.r;
+    if (index < 16) {
+        return m_colors.palette[index] & 0xFFFFFF;
+    }
+    if (index < 232) {
+        const size_t cube = index - 16;
+        return (static_cast<uint32_t>(kCubeLevels[cube / 36]) << 16) |
+               (static_cast<uint32_t>(kCubeLevels[cube / 6 % 6]) << 8) | kCubeLevels[cube % 6];
+    }
+    const auto level = static_cast<uint32_t>(8 + (index - 232) * 10);
+    return (level << 16) | (level << 8) | level;
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,165 @@
+#pragma once
+// Console3 - ScrollbackExport.h
+// Saves a session's whole history (scrollback plus screen) to a file
+//
+// A long history runs to hundreds of megabytes as text, so the export never
+// holds it all: lines are taken from the buffer a slice per Update() on the
+// UI thread (the only thread that may read it), oldest first. Lines in
+// sealed blocks in memory are handed over as a ScrollbackView and decoded
+// by the writer, each block once; the others (spilled, or in the hot window
+// or staging) are copied out on the UI thread. A writer thread
+// formats the slices as plain text, text with ANSI SGR sequences, or HTML,
+// into kWriteBytes buffers written with overlapped I/O, kWritesInFlight at
+// a time. At most kMaxQueuedSlices slices wait for the writer; past that
+// Update() copies nothing, so a slow disk bounds memory instead of the UI.
+//
+// The history is the one at Start(): the screen is captured then, and only
+// scrollback lines stored before it are written. Lines the store trims or
+// pops back to the screen before they are reached are left out (counted in
+// ExportProgress::linesSkipped). Soft-wrapped lines are joined, so the file
+// does not depend on the window width.
+
+#include <Windows.h>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <wil/resource.h>
+
+#include "Core/Cell.h"
+#include "Core/ScrollbackStore.h"
+#include "Core/Settings.h"
+
+namespace Console3::Core {
+
+class TerminalBuffer;
+
+/// How lines are written
+enum class ExportFormat {
+    Text,       ///< UTF-8, styles dropped
+    Ansi,       ///< UTF-8 with SGR sequences for colors and attributes
+    Html        ///< A <pre> of styled spans, colors resolved with a scheme
+};
+
+/// How far an export has got
+struct ExportProgress {
+    uint64_t linesTotal = 0;        ///< Scrollback at Start() plus the screen
+    uint64_t linesCopied = 0;       ///< Handed to the writer
+    uint64_t linesSkipped = 0;      ///< Trimmed or popped before they were reached
+    uint64_t bytesWritten = 0;
+    bool finished = false;          ///< The file is complete and closed
+    bool failed = false;            ///< A write failed; the file is incomplete
+};
+
+/// Background export of one buffer's history (see file comment)
+class ScrollbackExport {
+public:
+    static constexpr size_t kWriteBytes = 1024 * 1024;    ///< Bytes per write
+    static constexpr size_t kWritesInFlight = 4;
+    static constexpr size_t kMaxQueuedSlices = 4;
+
+    ScrollbackExport() = default;
+    ~ScrollbackExport();
+
+    // Non-copyable, non-movable
+    ScrollbackExport(const ScrollbackExport&) = delete;
+    ScrollbackExport& operator=(const ScrollbackExport&) = delete;
+    ScrollbackExport(ScrollbackExport&&) = delete;
+    ScrollbackExport& operator=(ScrollbackExport&&) = delete;
+
+    /// Create the file and start the writer (UI thread)
+    /// @param colors Resolves default and palette colors for HTML
+    /// @return false if an export is running or the file can't be created
+    /// (GetLastError() has the reason)
+    [[nodiscard]] bool Start(const TerminalBuffer& buffer, const std::wstring& path, ExportFormat format,
+                             const ColorScheme& colors = {});
+
+    /// Hand more lines to the writer (UI thread, while IsActive())
+    /// @param lines Lines to copy at most
+    /// @return true while the export is running
+    bool Update(const TerminalBuffer& buffer, size_t lines);
+
+    /// Stop and delete the partial file (UI thread)
+    void Cancel();
+
+    /// Check if an export is running (finished ones are reaped by Update())
+    [[nodiscard]] bool IsActive() const noexcept { return m_active; }
+
+    /// Get the progress of the running or last export
+    [[nodiscard]] ExportProgress GetProgress() const;
+
+private:
+    /// Lines taken from the buffer, oldest first: shared sealed lines, or
+    /// lines copied out
+    struct Slice {
+        ScrollbackView view;
+        std::vector<Cell> cells;
+        std::vector<uint32_t> lineEnds;     ///< Cell index past each line
+        std::vector<uint8_t> continuation;  ///< Per line: continues the one before
+        std::vector<StyleRun> runs;         ///< Screen lines' style runs, as the buffer kept them
+        std::vector<uint32_t> runEnds;      ///< Run index past each line's (empty for scrollback)
+        bool last = false;                  ///< Nothing follows
+
+        void Add(std::span<const Cell> line, bool continues, std::span<const StyleRun> lineRuns = {});
+    };
+
+    /// One overlapped write and its buffer
+    struct Write {
+        std::string data;
+        OVERLAPPED overlapped{};
+        wil::unique_event_nothrow done;
+        bool pending = false;
+    };
+
+    void WriterProc();
+    void FormatLine(std::span<const Cell> line, std::span<const StyleRun> runs, bool continues, std::string& out);
+    void AppendStyle(const Cell& cell, std::string& out);
+    void CloseStyle(std::string& out);
+    void AppendPrologue(std::string& out) const;
+    void AppendEpilogue(std::string& out);
+    [[nodiscard]] uint32_t Resolve(CellColor color, bool foreground) const noexcept;
+
+    /// Start writing out; waits for the write the slot last issued
+    [[nodiscard]] bool Submit(std::string& out);
+    [[nodiscard]] bool Complete(Write& write);
+
+    void Finish();
+
+    // UI thread
+    bool m_active = false;
+    uint64_t m_nextId = 0;                  ///< Next stored line to copy
+    uint64_t m_endId = 0;                   ///< Store end id at Start()
+    Slice m_screen;                         ///< Captured at Start()
+    bool m_screenQueued = false;
+    std::wstring m_path;
+
+    // Writer thread
+    ExportFormat m_format = ExportFormat::Text;
+    ColorScheme m_colors;
+    wil::unique_hfile m_file;
+    Write m_writes[kWritesInFlight];
+    size_t m_nextWrite = 0;
+    uint64_t m_fileOffset = 0;
+    bool m_firstLine = true;
+    size_t m_pendingBlanks = 0;             ///< Trailing blanks held back in case the next line continues
+    bool m_styled = false;                  ///< A non-default style is open
+    Cell m_style;                           ///< Its colors and attributes
+    std::vector<StyleRun> m_runScratch;     ///< A scrollback line's runs
+    Row m_viewLine;                         ///< A line decoded from a view
+
+    // Shared
+    mutable std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::deque<Slice> m_slices;
+    bool m_stop = false;
+    bool m_done = false;                    ///< Writer has exited
+    ExportProgress m_progress;
+    std::thread m_writer;
+};
+
+} // namespace Console3::Core
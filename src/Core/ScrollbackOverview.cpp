@@ -0,0 +1,127 @@
+// Console3 - ScrollbackOverview.cpp
+// Per-block summaries of the scrollback for the overview strip
+
+#include "Core/ScrollbackOverview.h"
+
+#include <algorithm>
+
+namespace Console3::Core {
+
+namespace {
+
+/// Base color bits of an RGB color (its channels thresholded at half)
+[[nodiscard]] size_t RgbClass(uint8_t r, uint8_t g, uint8_t b) noexcept {
+    return 1 + (r >= 128 ? 1 : 0) + (g >= 128 ? 2 : 0) + (b >= 128 ? 4 : 0);
+}
+
+/// Summarize one line
+[[nodiscard]] OverviewBlock SummarizeLine(std::span<const Cell> cells) noexcept {
+    OverviewBlock line;
+    line.lines = 1;
+    line.cells = static_cast<uint32_t>(cells.size());
+    for (const Cell& cell : cells) {
+        const bool reverse = cell.Attributes().reverse;
+        const CellColor fg = reverse ? cell.bg : cell.fg;
+        const CellColor bg = reverse ? cell.fg : cell.bg;
+        if (cell.code != U' ' && cell.code != 0 && cell.code != Cell::kContinuation) {
+            ++line.ink[GetOverviewColor(fg)];
+        }
+        if (!bg.IsDefault() || reverse) {
+            ++line.ink[bg.IsDefault() ? 0 : GetOverviewColor(bg)];
+        }
+    }
+    return line;
+}
+
+} // namespace
+
+size_t GetOverviewColor(CellColor color) noexcept {
+    if (color.IsDefault()) {
+        return 0;
+    }
+    if (!color.IsIndexed()) {
+        return RgbClass(color.r, color.g, color.b);
+    }
+
+    const uint8_t index = color.r;
+    if (index < 16) {
+        return 1 + (index & 7);
+    }
+    if (index < 232) {
+        // xterm 6x6x6 cube
+        const int cube = index - 16;
+        return 1 + (cube / 36 >= 3 ? 1 : 0) + ((cube / 6) % 6 >= 3 ? 2 : 0) + (cube % 6 >= 3 ? 4 : 0);
+    }
+    return index - 232 >= 12 ? 1 + 7 : 1;
+}
+
+void ScrollbackOverview::Add(uint64_t line, std::span<const Cell> cells, uint64_t firstLine) {
+    const uint64_t block = line / kBlockLines;
+    if (m_blocks.empty()) {
+        m_firstBlock = block;
+    }
+
+    // A line below the blocks held (pushed after a clear) starts over
+    if (block < m_firstBlock) {
+        m_blocks.clear();
+        m_firstBlock = block;
+    }
+    if (block - m_firstBlock >= m_blocks.size()) {
+        m_blocks.resize(static_cast<size_t>(block - m_firstBlock + 1));
+    }
+
+    const OverviewBlock summary = SummarizeLine(cells);
+    OverviewBlock& target = m_blocks[static_cast<size_t>(block - m_firstBlock)];
+    for (size_t color = 0; color < kOverviewColors; ++color) {
+        target.ink[color] += summary.ink[color];
+    }
+    target.cells += summary.cells;
+    target.lines += summary.lines;
+
+    // Blocks wholly trimmed away
+    const uint64_t firstBlock = firstLine / kBlockLines;
+    while (m_firstBlock < firstBlock && m_blocks.size() > 1) {
+        m_blocks.pop_front();
+        ++m_firstBlock;
+    }
+    ++m_version;
+}
+
+void ScrollbackOverview::Remove(uint64_t line, std::span<const Cell> cells) {
+    const uint64_t block = line / kBlockLines;
+    if (block < m_firstBlock || block - m_firstBlock >= m_blocks.size()) {
+        return;
+    }
+
+    // The line comes back at the width it is popped into, which may keep
+    // less of it than was summarized: never go below zero
+    const OverviewBlock summary = SummarizeLine(cells);
+    OverviewBlock& target = m_blocks[static_cast<size_t>(block - m_firstBlock)];
+    for (size_t color = 0; color < kOverviewColors; ++color) {
+        target.ink[color] -= std::min(target.ink[color], summary.ink[color]);
+    }
+    target.cells -= std::min(target.cells, summary.cells);
+    target.lines -= std::min(target.lines, summary.lines);
+
+    // The newest blocks empty out as lines go back to the screen
+    while (!m_blocks.empty() && m_blocks.back().lines == 0) {
+        m_blocks.pop_back();
+    }
+    ++m_version;
+}
+
+void ScrollbackOverview::Clear() {
+    m_blocks.clear();
+    m_firstBlock = 0;
+    ++m_version;
+}
+
+const OverviewBlock* ScrollbackOverview::GetBlock(uint64_t block) const noexcept {
+    if (block < m_firstBlock || block - m_firstBlock >= m_blocks.size()) {
+        return nullptr;
+    }
+    const OverviewBlock& entry = m_blocks[static_cast<size_t>(block - m_firstBlock)];
+    return entry.lines != 0 ? &entry : nullptr;
+}
+
+} // namespace Console3::Core
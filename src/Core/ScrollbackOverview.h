@@ -0,0 +1,76 @@
+#pragma once
+// Console3 - ScrollbackOverview.h
+// Per-block summaries of the scrollback for the overview strip
+//
+// The overview strip (TerminalView) shows the whole history at a glance:
+// where the dense output is, its colors, prompts and lines the output rules
+// matched. Reading 100,000 stored lines to draw it, most of them compressed,
+// would cost far more than the frame it is drawn in. Each line is instead
+// summarized once, as it is pushed into the scrollback, into the block of
+// kBlockLines lines it falls in: how many of its cells are ink, by color
+// class. Drawing the strip then reads a few thousand block summaries at
+// most, and prompts and highlights, already indexed by line, are joined in
+// per block there.
+//
+// Blocks are kept by absolute line (TerminalBuffer::GetScreenLine), so they
+// stay put as lines are pushed; blocks wholly below the oldest line held are
+// dropped as the scrollback is trimmed.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <span>
+
+#include "Core/Cell.h"
+
+namespace Console3::Core {
+
+/// Color classes of overview ink: the default foreground, then the eight
+/// base colors in ANSI order (bit 0 red, bit 1 green, bit 2 blue); other
+/// palette and RGB colors go to the nearest of those
+inline constexpr size_t kOverviewColors = 9;
+
+/// Get a color's overview class
+[[nodiscard]] size_t GetOverviewColor(CellColor color) noexcept;
+
+/// Summary of kBlockLines consecutive lines
+struct OverviewBlock {
+    std::array<uint32_t, kOverviewColors> ink{};    ///< Cells by color class: text by foreground, fills by background
+    uint32_t cells = 0;             ///< Cells summarized
+    uint32_t lines = 0;             ///< Lines summarized
+};
+
+/// Block summaries of one buffer's scrollback (see file comment)
+class ScrollbackOverview {
+public:
+    static constexpr uint64_t kBlockLines = 64;
+
+    /// Summarize a line pushed into the scrollback
+    /// @param firstLine Oldest line still held (blocks below it are dropped)
+    void Add(uint64_t line, std::span<const Cell> cells, uint64_t firstLine);
+
+    /// Take back the summary of a line popped from the scrollback
+    void Remove(uint64_t line, std::span<const Cell> cells);
+
+    /// Forget every line
+    void Clear();
+
+    /// Note a change the summaries don't hold (a prompt mark), so an
+    /// overview drawn earlier is drawn again
+    void Touch() noexcept { ++m_version; }
+
+    /// Get the summary of a block (line / kBlockLines)
+    /// @return The block, or nullptr if no line in it was summarized
+    [[nodiscard]] const OverviewBlock* GetBlock(uint64_t block) const noexcept;
+
+    /// Get a count that changes whenever the summaries do
+    [[nodiscard]] uint64_t GetVersion() const noexcept { return m_version; }
+
+private:
+    std::deque<OverviewBlock> m_blocks;
+    uint64_t m_firstBlock = 0;      ///< Block of m_blocks.front()
+    uint64_t m_version = 0;
+};
+
+} // namespace Console3::Core
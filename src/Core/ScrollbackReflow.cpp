@@ -0,0 +1,172 @@
+// Console3 - ScrollbackReflow.cpp
+// Scrollback re-wrapped to the screen width, built lazily
+
+#include "Core/ScrollbackReflow.h"
+#include "Core/ScrollbackStore.h"
+#include <algorithm>
+
+namespace Console3::Core {
+
+void ScrollbackReflow::Reset(int cols) noexcept {
+    m_cols = std::max(cols, 0);
+    m_rows.clear();
+    m_low = 0;
+    m_high = 0;
+    m_joinedLines = 0;
+}
+
+size_t ScrollbackReflow::Size(const ScrollbackStore& store) {
+    Sync(store);
+    return m_rows.size() + static_cast<size_t>(m_low - store.GetFirstId());
+}
+
+const Row* ScrollbackReflow::Get(const ScrollbackStore& store, size_t index) {
+    Sync(store);
+    while (index >= m_rows.size() && ExtendBack(store) > 0) {
+    }
+    if (index >= m_rows.size()) {
+        return nullptr;
+    }
+
+    const Entry entry = m_rows[index];
+    Join(store, entry.head, entry.lines);
+    m_row.assign(m_joined.begin() + entry.start, m_joined.begin() + entry.end);
+    m_row.resize(static_cast<size_t>(m_cols));
+    return &m_row;
+}
+
+bool ScrollbackReflow::Step(const ScrollbackStore& store, size_t lines) {
+    Sync(store);
+    for (size_t done = 0; done < lines;) {
+        const size_t taken = ExtendBack(store);
+        if (taken == 0) {
+            break;
+        }
+        done += taken;
+    }
+    return m_low > store.GetFirstId();
+}
+
+// ============================================================================
+// Mapping
+// ============================================================================
+
+void ScrollbackReflow::Sync(const ScrollbackStore& store) {
+    const uint64_t first = store.GetFirstId();
+    const uint64_t end = store.GetEndId();
+
+    if (!m_rows.empty() && m_high != end) {
+        // The newest logical line may have gained or lost lines: redo it,
+        // and any lines popped since
+        do {
+            const uint64_t head = m_rows.front().head;
+            while (!m_rows.empty() && m_rows.front().head == head) {
+                m_rows.pop_front();
+            }
+            m_high = head;
+        } while (!m_rows.empty() && m_high > end);
+        m_joinedLines = 0;
+
+        while (!m_rows.empty() && m_high < end && ExtendFront(store)) {
+        }
+    }
+
+    // A logical line whose first line was trimmed goes with it
+    if (!m_rows.empty() && m_rows.back().head < first) {
+        while (!m_rows.empty() && m_rows.back().head < first) {
+            m_rows.pop_back();
+        }
+        m_joinedLines = 0;
+    }
+
+    if (m_rows.empty()) {
+        m_low = end;
+        m_high = end;
+    } else {
+        m_low = m_rows.back().head;
+    }
+}
+
+size_t ScrollbackReflow::ExtendBack(const ScrollbackStore& store) {
+    const uint64_t first = store.GetFirstId();
+    const uint64_t end = store.GetEndId();
+    if (m_low <= first) {
+        return 0;
+    }
+
+    // Walk back to the line that starts the logical line (or the oldest held)
+    uint64_t head = m_low - 1;
+    while (head > first && store.IsContinuation(static_cast<size_t>(end - 1 - head))) {
+        --head;
+    }
+    const auto lines = static_cast<uint32_t>(m_low - head);
+
+    // Rows come out oldest first; the back of the deque is the oldest
+    Join(store, head, lines);
+    const size_t before = m_rows.size();
+    Wrap(head, lines, [this](const Entry& entry) { m_rows.push_back(entry); });
+    std::reverse(m_rows.begin() + static_cast<ptrdiff_t>(before), m_rows.end());
+    m_low = head;
+    return lines;
+}
+
+bool ScrollbackReflow::ExtendFront(const ScrollbackStore& store) {
+    const uint64_t end = store.GetEndId();
+    if (m_high >= end) {
+        return false;
+    }
+
+    const uint64_t head = m_high;
+    uint32_t lines = 1;
+    while (head + lines < end && store.IsContinuation(static_cast<size_t>(end - 1 - (head + lines)))) {
+        ++lines;
+    }
+
+    Join(store, head, lines);
+    Wrap(head, lines, [this](const Entry& entry) { m_rows.push_front(entry); });
+    m_high = head + lines;
+    return true;
+}
+
+void ScrollbackReflow::Join(const ScrollbackStore& store, uint64_t head, uint32_t lines) {
+    if (m_joinedLines == lines && m_joinedHead == head) {
+        return;
+    }
+
+    // Wrapped lines are full by definition; only the last one has trailing
+    // blanks to drop
+    static const Cell blank{};
+    const uint64_t end = store.GetEndId();
+    m_joined.clear();
+    size_t lastStart = 0;
+    for (uint32_t line = 0; line < lines; ++line) {
+        lastStart = m_joined.size();
+        if (const Row* row = store.Get(static_cast<size_t>(end - 1 - (head + line)))) {
+            m_joined.insert(m_joined.end(), row->begin(), row->end());
+        }
+    }
+    while (m_joined.size() > lastStart && m_joined.back() == blank) {
+        m_joined.pop_back();
+    }
+
+    m_joinedHead = head;
+    m_joinedLines = lines;
+}
+
+template <typename Emit>
+void ScrollbackReflow::Wrap(uint64_t head, uint32_t lines, Emit&& emit) const {
+    const auto length = static_cast<uint32_t>(m_joined.size());
+    const auto cols = static_cast<uint32_t>(m_cols);
+    if (length == 0) {
+        emit(Entry{head, lines, 0, 0});
+        return;
+    }
+
+    for (uint32_t start = 0; start < length;) {
+        const auto end = static_cast<uint32_t>(WrapEnd(m_joined, start, cols));
+        emit(Entry{head, lines, start, end});
+        start = end;
+    }
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,96 @@
+#pragma once
+// Console3 - ScrollbackReflow.h
+// Scrollback re-wrapped to the screen width, built lazily
+//
+// Stored lines keep the width they had when they scrolled off, plus a flag
+// for lines that continue the one before (a soft wrap). After a width change
+// the reflow maps rows at the new width onto logical lines (a line and its
+// continuations) without rewriting the store. The map is built from the
+// newest line backwards: on demand when a row is read, and a slice at a time
+// from Step() when the UI is idle. A resize therefore costs nothing up front
+// however long the history is; lines not reached yet show as stored.
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <span>
+
+#include "Core/Cell.h"
+
+namespace Console3::Core {
+
+class ScrollbackStore;
+
+/// Find where a row of a logical line being wrapped ends
+/// A wide character that would straddle the edge moves to the next row.
+/// @return End of the row that starts at start (past start unless the line ends there)
+[[nodiscard]] inline size_t WrapEnd(std::span<const Cell> line, size_t start, size_t cols) noexcept {
+    size_t end = std::min(start + cols, line.size());
+    if (end < line.size() && end > start + 1 && line[end].width == 0) {
+        --end;
+    }
+    return end;
+}
+
+/// Row view of a ScrollbackStore at another width
+class ScrollbackReflow {
+public:
+    /// Start over at a width
+    /// @param cols Width to wrap at, or 0 to stop reflowing
+    void Reset(int cols) noexcept;
+
+    [[nodiscard]] bool IsActive() const noexcept { return m_cols > 0; }
+    [[nodiscard]] int GetCols() const noexcept { return m_cols; }
+
+    /// Get the number of rows (lines not reached yet count one row each)
+    [[nodiscard]] size_t Size(const ScrollbackStore& store);
+
+    /// Get a row (0 = most recent), reflowing as far back as needed
+    /// @return The row, padded to the width and valid until the next call,
+    /// or nullptr if out of range
+    [[nodiscard]] const Row* Get(const ScrollbackStore& store, size_t index);
+
+    /// Reflow up to a number of older stored lines
+    /// @return true while stored lines remain to be reflowed
+    bool Step(const ScrollbackStore& store, size_t lines);
+
+    /// Catch up with lines pushed, popped or trimmed since the last call
+    /// Popped ids are reused by the next push, so call this after popping.
+    void Sync(const ScrollbackStore& store);
+
+private:
+    /// A row of a logical line: cells [start, end) of its joined lines
+    struct Entry {
+        uint64_t head = 0;      ///< Id of the logical line's first stored line
+        uint32_t lines = 0;     ///< Stored lines in the logical line
+        uint32_t start = 0;
+        uint32_t end = 0;
+    };
+
+    /// Reflow the logical line just older than the covered range
+    /// @return Stored lines it took, or 0 if none are left
+    size_t ExtendBack(const ScrollbackStore& store);
+
+    /// Reflow the logical line starting at m_high into the newest rows
+    /// @return false if no line starts there
+    bool ExtendFront(const ScrollbackStore& store);
+
+    /// Join a logical line's stored lines into m_joined (cached)
+    void Join(const ScrollbackStore& store, uint64_t head, uint32_t lines);
+
+    /// Split m_joined into rows at the width, oldest first
+    template <typename Emit>
+    void Wrap(uint64_t head, uint32_t lines, Emit&& emit) const;
+
+    int m_cols = 0;
+    std::deque<Entry> m_rows;       ///< Front = newest
+    uint64_t m_low = 0;             ///< Covered stored ids [m_low, m_high)
+    uint64_t m_high = 0;
+
+    Row m_joined;
+    uint64_t m_joinedHead = 0;
+    uint32_t m_joinedLines = 0;     ///< 0 = m_joined not valid
+    Row m_row;
+};
+
+} // namespace Console3::Core
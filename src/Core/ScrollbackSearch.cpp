@@ -0,0 +1,439 @@
+// Console3 - ScrollbackSearch.cpp
+// Find-in-terminal engine over a plain-text shadow of the scrollback
+
+#include "Core/ScrollbackSearch.h"
+#include "Core/TerminalBuffer.h"
+#include "Core/Utf.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define CONSOLE3_SEARCH_SSE2 1
+#endif
+
+namespace Console3::Core {
+
+namespace {
+
+[[nodiscard]] constexpr char FoldAscii(char c) noexcept {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c | 0x20) : c;
+}
+
+[[nodiscard]] constexpr size_t Utf8Length(uint32_t cp) noexcept {
+    return cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4;
+}
+
+void PushUtf8(std::string& out, uint32_t cp) {
+    char units[4];
+    out.append(units, PutUtf8(cp, units));
+}
+
+/// A cell's base character as the shadow holds it (never NUL)
+[[nodiscard]] uint32_t BaseOf(const Cell& cell) noexcept {
+    const uint32_t cp = cell.Codepoint();
+    return cp == 0 ? U' ' : cp;
+}
+
+} // namespace
+
+// ============================================================================
+// TextMatcher
+// ============================================================================
+
+TextMatcher::TextMatcher(const SearchQuery& query) : m_matchCase(query.matchCase) {
+    if (query.text.empty()) {
+        return;
+    }
+
+    if (query.regex) {
+        auto flags = std::regex::ECMAScript | std::regex::optimize;
+        if (!query.matchCase) {
+            flags |= std::regex::icase;
+        }
+        try {
+            m_regex.emplace(query.text, flags);
+        } catch (const std::regex_error&) {
+            return;
+        }
+    } else {
+        m_pattern = query.text;
+        if (!m_matchCase) {
+            std::transform(m_pattern.begin(), m_pattern.end(), m_pattern.begin(), FoldAscii);
+        }
+    }
+    m_valid = true;
+}
+
+size_t TextMatcher::Find(std::string_view text, size_t from, size_t& length) const {
+    length = 0;
+    if (!m_valid || from > text.size()) {
+        return std::string_view::npos;
+    }
+
+    if (m_regex) {
+        std::cmatch match;
+        const auto flags = from > 0 ? std::regex_constants::match_prev_avail : std::regex_constants::match_default;
+        if (!std::regex_search(text.data() + from, text.data() + text.size(), match, *m_regex, flags)) {
+            return std::string_view::npos;
+        }
+        length = static_cast<size_t>(match.length(0));
+        return from + static_cast<size_t>(match.position(0));
+    }
+
+    const size_t found = FindText(text, from);
+    if (found != std::string_view::npos) {
+        length = m_pattern.size();
+    }
+    return found;
+}
+
+size_t TextMatcher::FindText(std::string_view text, size_t from) const noexcept {
+    const size_t size = m_pattern.size();
+    if (text.size() < size || from > text.size() - size) {
+        return std::string_view::npos;
+    }
+
+    const char* data = text.data();
+    const char* pattern = m_pattern.data();
+    const auto matches = [&](size_t pos) {
+        if (m_matchCase) {
+            return std::memcmp(data + pos, pattern, size) == 0;
+        }
+        for (size_t index = 0; index < size; ++index) {
+            if (FoldAscii(data[pos + index]) != pattern[index]) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    const size_t last = text.size() - size;     // Last offset a match can start at
+    size_t pos = from;
+
+#ifdef CONSOLE3_SEARCH_SSE2
+    // Sixteen candidate offsets at a time: keep those whose first and last
+    // bytes match the pattern's, and compare only those. Folding sets 0x20
+    // on the text byte when the pattern byte is a lower-case letter, which
+    // maps exactly the two cases of that letter onto it.
+    const char first = pattern[0];
+    const char final = pattern[size - 1];
+    const auto foldMask = [this](char c) {
+        return _mm_set1_epi8(!m_matchCase && c >= 'a' && c <= 'z' ? 0x20 : 0);
+    };
+    const __m128i firstBytes = _mm_set1_epi8(first);
+    const __m128i finalBytes = _mm_set1_epi8(final);
+    const __m128i firstFold = foldMask(first);
+    const __m128i finalFold = foldMask(final);
+    for (; pos + 15 <= last; pos += 16) {
+        const __m128i head = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos)), firstFold);
+        const __m128i tail = _mm_or_si128(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos + size - 1)), finalFold);
+        auto mask = static_cast<uint32_t>(
+            _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(head, firstBytes), _mm_cmpeq_epi8(tail, finalBytes))));
+        while (mask != 0) {
+            const size_t candidate = pos + static_cast<size_t>(std::countr_zero(mask));
+            if (matches(candidate)) {
+                return candidate;
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; pos <= last; ++pos) {
+        if (matches(pos)) {
+            return pos;
+        }
+    }
+    return std::string_view::npos;
+}
+
+// ============================================================================
+// ScrollbackSearch
+// ============================================================================
+
+ScrollbackSearch::~ScrollbackSearch() {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+}
+
+bool ScrollbackSearch::Start(const SearchQuery& query, HitsCallback onHits) {
+    auto matcher = std::make_shared<const TextMatcher>(query);
+    if (!matcher->IsValid()) {
+        return false;
+    }
+
+    StartWorker();
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_matcher = std::move(matcher);
+        m_onHits = std::move(onHits);
+        ++m_generation;
+        m_scannedId = 0;
+        m_hits.clear();
+        m_hitCount = 0;
+        m_invalidated = true;
+    }
+    m_active = true;
+    m_wake.notify_all();
+    return true;
+}
+
+void ScrollbackSearch::Stop() {
+    m_active = false;
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_matcher.reset();
+    m_onHits = nullptr;
+    ++m_generation;
+    m_hits.clear();
+}
+
+bool ScrollbackSearch::Update(const TerminalBuffer& buffer, size_t lines) {
+    if (!m_active) {
+        return false;
+    }
+
+    // Popped lines hand their ids out again, so the shadow starts over
+    const ScrollbackStore& store = buffer.GetScrollbackStore();
+    if (buffer.GetScrollbackEpoch() != m_epoch || store.GetEndId() < m_nextId) {
+        if (m_nextId != 0) {
+            Reset();
+        }
+        m_epoch = buffer.GetScrollbackEpoch();
+    }
+
+    const uint64_t firstId = store.GetFirstId();
+    const uint64_t endId = store.GetEndId();
+    m_nextId = std::max(m_nextId, firstId);
+    const uint64_t end = std::min<uint64_t>(endId, m_nextId + lines);
+
+    // Chunks whose lines were all trimmed go. Only this thread changes the
+    // chunk list; the worker takes copies of it.
+    std::shared_ptr<Chunk> chunk;
+    bool extend = false;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        const auto trimmed = std::find_if(m_chunks.begin(), m_chunks.end(),
+                                          [firstId](const auto& held) { return held->EndId() > firstId; });
+        for (auto it = m_chunks.begin(); it != trimmed; ++it) {
+            m_shadowBytes -= (*it)->text.size();
+        }
+        m_chunks.erase(m_chunks.begin(), trimmed);
+
+        // Extend the newest chunk while it is small (a copy: the worker may
+        // be reading it), else start one
+        if (end > m_nextId && !m_chunks.empty() && m_chunks.back()->EndId() == m_nextId &&
+            m_chunks.back()->text.size() < kChunkBytes) {
+            chunk = std::make_shared<Chunk>(*m_chunks.back());
+            extend = true;
+        }
+    }
+    if (end > m_nextId && !chunk) {
+        chunk = std::make_shared<Chunk>();
+        chunk->firstId = m_nextId;
+    }
+
+    // Store line i has id GetEndId() - 1 - i
+    const size_t before = chunk ? chunk->text.size() : 0;
+    for (uint64_t id = m_nextId; id < end; ++id) {
+        if (const Row* row = store.Get(static_cast<size_t>(endId - 1 - id))) {
+            AppendLineText(chunk->text, *row);
+        }
+        chunk->text += '\n';
+        chunk->lineEnds.push_back(static_cast<uint32_t>(chunk->text.size()));
+    }
+    m_nextId = std::max(m_nextId, end);
+
+    if (chunk) {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_shadowBytes += chunk->text.size() - before;
+        if (extend) {
+            m_chunks.back() = std::move(chunk);
+        } else {
+            m_chunks.push_back(std::move(chunk));
+        }
+    }
+    m_wake.notify_all();
+    return m_nextId < endId;
+}
+
+bool ScrollbackSearch::TakeHits(std::vector<SearchHit>& hits) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    const bool invalidated = m_invalidated;
+    m_invalidated = false;
+    hits.insert(hits.end(), m_hits.begin(), m_hits.end());
+    m_hits.clear();
+    return invalidated;
+}
+
+bool ScrollbackSearch::IsIdle() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return !m_scanning && (!m_matcher || m_chunks.empty() || m_scannedId >= m_chunks.back()->EndId());
+}
+
+int ScrollbackSearch::ColumnOf(std::span<const Cell> line, size_t offset) noexcept {
+    size_t bytes = 0;
+    for (size_t column = 0; column < line.size(); ++column) {
+        const Cell& cell = line[column];
+        if (cell.width == 0) {
+            continue;
+        }
+        bytes += Utf8Length(BaseOf(cell));
+        for (const uint32_t comb : cell.Combining()) {
+            bytes += Utf8Length(comb);
+        }
+        if (offset < bytes) {
+            return static_cast<int>(column);
+        }
+    }
+    return static_cast<int>(line.size());
+}
+
+void ScrollbackSearch::AppendLineText(std::string& out, std::span<const Cell> line) {
+    const size_t start = out.size();
+    for (const Cell& cell : line) {
+        if (cell.width == 0) {
+            continue;
+        }
+        PushUtf8(out, BaseOf(cell));
+        for (const uint32_t comb : cell.Combining()) {
+            PushUtf8(out, comb);
+        }
+    }
+    while (out.size() > start && out.back() == ' ') {
+        out.pop_back();
+    }
+}
+
+void ScrollbackSearch::ReleaseShadow() {
+    if (!m_active) {
+        Reset();
+    }
+}
+
+void ScrollbackSearch::Reset() {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_chunks.clear();
+    ++m_generation;
+    m_scannedId = 0;
+    m_hits.clear();
+    m_hitCount = 0;
+    m_invalidated = true;
+    m_nextId = 0;
+    m_shadowBytes = 0;
+}
+
+void ScrollbackSearch::StartWorker() {
+    if (!m_worker.joinable()) {
+        m_worker = std::thread(&ScrollbackSearch::WorkerProc, this);
+    }
+}
+
+void ScrollbackSearch::WorkerProc() {
+    std::unique_lock<std::mutex> lock(m_lock);
+    for (;;) {
+        m_wake.wait(lock, [this] {
+            return m_stop || (m_matcher && !m_chunks.empty() && m_scannedId < m_chunks.back()->EndId());
+        });
+        if (m_stop) {
+            return;
+        }
+
+        // Scan without the lock, over references to the chunks as they are
+        const std::vector<std::shared_ptr<const Chunk>> chunks = m_chunks;
+        const std::shared_ptr<const TextMatcher> matcher = m_matcher;
+        const uint64_t generation = m_generation;
+        uint64_t from = m_scannedId;
+        m_scanning = true;
+        lock.unlock();
+
+        std::vector<SearchHit> found;
+        for (const auto& chunk : chunks) {
+            if (chunk->EndId() <= from) {
+                continue;
+            }
+            found.clear();
+            ScanChunk(*chunk, std::max(from, chunk->firstId), *matcher, found);
+            from = chunk->EndId();
+
+            // Hand the chunk's hits over, unless the search changed meanwhile
+            HitsCallback notify;
+            {
+                std::lock_guard<std::mutex> guard(m_lock);
+                if (generation != m_generation) {
+                    break;
+                }
+                m_scannedId = from;
+                const size_t room = kMaxHits - std::min(m_hitCount, kMaxHits);
+                const size_t taken = std::min(room, found.size());
+                m_hits.insert(m_hits.end(), found.begin(), found.begin() + static_cast<std::ptrdiff_t>(taken));
+                m_hitCount += taken;
+                if (taken > 0) {
+                    notify = m_onHits;
+                }
+            }
+            if (notify) {
+                notify();
+            }
+        }
+
+        lock.lock();
+        m_scanning = false;
+    }
+}
+
+void ScrollbackSearch::ScanChunk(const Chunk& chunk, uint64_t from, const TextMatcher& matcher,
+                                 std::vector<SearchHit>& hits) {
+    const std::string_view text = chunk.text;
+    const auto lineStart = [&chunk](size_t line) -> size_t { return line > 0 ? chunk.lineEnds[line - 1] : 0; };
+    const auto hit = [&](size_t line, size_t offset, size_t length) {
+        hits.push_back({chunk.firstId + line, static_cast<uint32_t>(offset - lineStart(line)),
+                        static_cast<uint32_t>(length)});
+    };
+
+    const auto firstLine = static_cast<size_t>(from - chunk.firstId);
+    size_t length = 0;
+
+    if (matcher.IsLineBased()) {
+        for (size_t line = firstLine; line < chunk.lineEnds.size(); ++line) {
+            const size_t start = lineStart(line);
+            const std::string_view lineText = text.substr(start, chunk.lineEnds[line] - 1 - start);
+            for (size_t pos = 0; pos <= lineText.size();) {
+                const size_t found = matcher.Find(lineText, pos, length);
+                if (found == std::string_view::npos) {
+                    break;
+                }
+                if (length > 0) {
+                    hit(line, start + found, length);
+                }
+                pos = found + std::max<size_t>(length, 1);
+            }
+        }
+        return;
+    }
+
+    // Plain text: one scan over the whole chunk, placing each match on its
+    // line (matches running into the next line are not hits)
+    for (size_t pos = lineStart(firstLine); pos < text.size();) {
+        const size_t found = matcher.Find(text, pos, length);
+        if (found == std::string_view::npos) {
+            break;
+        }
+        const auto end = std::upper_bound(chunk.lineEnds.begin(), chunk.lineEnds.end(), found);
+        const auto line = static_cast<size_t>(end - chunk.lineEnds.begin());
+        if (end != chunk.lineEnds.end() && found + length < *end) {
+            hit(line, found, length);
+        }
+        pos = found + std::max<size_t>(length, 1);
+    }
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,185 @@
+#pragma once
+// Console3 - ScrollbackSearch.h
+// Find-in-terminal engine over a plain-text shadow of the scrollback
+//
+// Reading the scrollback for a search means decompressing every block and
+// rebuilding each line's UTF-8, far too slow to repeat per keystroke over a
+// 100k-line history. The engine keeps a shadow instead: the stored lines as
+// UTF-8, one '\n'-terminated line after another, in immutable chunks with
+// their line offsets. The shadow is built lazily, from the first Update()
+// after a search starts, a slice of lines per call so the UI thread never
+// stalls; after that only newly stored lines are appended (Session calls
+// Update() as output is processed). Lines the store
+// trims are dropped with their chunks.
+//
+// Searches run on a worker thread over shared references to the chunks, so
+// they never touch the buffer. Plain text is matched with an SSE2 scan for
+// the pattern's first and last bytes, checking only the candidates; regular
+// expressions use std::regex a line at a time. Hits are streamed as chunks
+// are scanned, and lines appended while a search is open are scanned as
+// they arrive, so results stay current with the output.
+//
+// Lines are the ones stored in the ScrollbackStore, as they scrolled off
+// (not re-wrapped after a resize), identified by their store id. The
+// visible screen changes every frame; callers search it with TextMatcher
+// directly.
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <regex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "Core/Cell.h"
+
+namespace Console3::Core {
+
+class TerminalBuffer;
+
+/// What to search for
+struct SearchQuery {
+    std::string text;               ///< UTF-8
+    bool matchCase = false;         ///< Case-insensitive compares ASCII letters only
+    bool regex = false;             ///< ECMAScript regular expression
+    uint64_t fromMs = 0;            ///< GlobalSearch: only lines completed from then (Unix ms)
+    uint64_t toMs = UINT64_MAX;     ///< GlobalSearch: and up to then (empty text: every such line)
+};
+
+/// Matches a query against UTF-8 text
+class TextMatcher {
+public:
+    explicit TextMatcher(const SearchQuery& query);
+
+    /// Check if the query can match (not empty, and a valid expression)
+    [[nodiscard]] bool IsValid() const noexcept { return m_valid; }
+
+    /// Find the first match at or after an offset
+    /// @param length Receives the match's length
+    /// @return The match's offset, or std::string_view::npos
+    [[nodiscard]] size_t Find(std::string_view text, size_t from, size_t& length) const;
+
+    /// Check if the matcher works a line at a time (regular expressions);
+    /// plain text is scanned across a whole chunk
+    [[nodiscard]] bool IsLineBased() const noexcept { return m_regex.has_value(); }
+
+private:
+    [[nodiscard]] size_t FindText(std::string_view text, size_t from) const noexcept;
+
+    std::string m_pattern;          ///< Folded to lower case unless matching case
+    bool m_matchCase = false;
+    bool m_valid = false;
+    std::optional<std::regex> m_regex;
+};
+
+/// A match in a stored scrollback line
+struct SearchHit {
+    uint64_t lineId = 0;            ///< ScrollbackStore id of the line
+    uint32_t offset = 0;            ///< Byte offset in the line's text
+    uint32_t length = 0;            ///< Bytes matched
+};
+
+/// Incremental search over one buffer's scrollback (see file comment)
+class ScrollbackSearch {
+public:
+    static constexpr size_t kChunkBytes = 256 * 1024;     ///< Chunks grow to this before a new one starts
+    static constexpr size_t kMaxHits = 100000;            ///< Hits past this are not reported
+
+    /// Called on the worker thread when hits are ready to take
+    using HitsCallback = std::function<void()>;
+
+    ScrollbackSearch() = default;
+    ~ScrollbackSearch();
+
+    // Non-copyable, non-movable
+    ScrollbackSearch(const ScrollbackSearch&) = delete;
+    ScrollbackSearch& operator=(const ScrollbackSearch&) = delete;
+    ScrollbackSearch(ScrollbackSearch&&) = delete;
+    ScrollbackSearch& operator=(ScrollbackSearch&&) = delete;
+
+    /// Start a search, replacing the one before (UI thread)
+    /// Hits come from the shadow built so far and from each Update() after.
+    /// @return false if the query can't match (see TextMatcher::IsValid)
+    [[nodiscard]] bool Start(const SearchQuery& query, HitsCallback onHits = {});
+
+    /// End the search; the shadow is kept for the next one (UI thread)
+    void Stop();
+
+    /// Check if a search is open
+    [[nodiscard]] bool IsActive() const noexcept { return m_active; }
+
+    /// Drop the shadow while no search is open (UI thread); the next
+    /// search builds it again from the scrollback
+    void ReleaseShadow();
+
+    /// Bring the shadow up to date with the buffer's scrollback (UI thread,
+    /// while a search is open)
+    /// @param lines Stored lines to convert at most
+    /// @return true while lines remain to be converted
+    bool Update(const TerminalBuffer& buffer, size_t lines);
+
+    /// Take the hits found since the last call, oldest lines first
+    /// @return true if hits taken before no longer apply (the shadow was
+    /// rebuilt after lines were popped or the scrollback cleared); drop them
+    bool TakeHits(std::vector<SearchHit>& hits);
+
+    /// Check if the worker has scanned everything in the shadow
+    [[nodiscard]] bool IsIdle() const;
+
+    /// Get the size of the shadow (UI thread)
+    [[nodiscard]] size_t GetShadowBytes() const noexcept { return m_shadowBytes; }
+
+    /// Map a hit's byte offset to the cell column it falls in
+    [[nodiscard]] static int ColumnOf(std::span<const Cell> line, size_t offset) noexcept;
+
+    /// Append a line's text as the shadow holds it: each character once
+    /// (not the continuations of wide ones), trailing blanks trimmed
+    static void AppendLineText(std::string& out, std::span<const Cell> line);
+
+private:
+    /// Consecutive lines of text, each ending in '\n'
+    struct Chunk {
+        uint64_t firstId = 0;
+        std::string text;
+        std::vector<uint32_t> lineEnds;     ///< Offset past each line's '\n'
+
+        [[nodiscard]] uint64_t EndId() const noexcept { return firstId + lineEnds.size(); }
+    };
+
+    void Reset();
+    void StartWorker();
+    void WorkerProc();
+
+    /// Scan lines [from, chunk end) of a chunk
+    static void ScanChunk(const Chunk& chunk, uint64_t from, const TextMatcher& matcher,
+                          std::vector<SearchHit>& hits);
+
+    // UI thread
+    bool m_active = false;
+    uint64_t m_epoch = 0;               ///< TerminalBuffer::GetScrollbackEpoch() of the shadow
+    uint64_t m_nextId = 0;              ///< First stored line not in the shadow
+    size_t m_shadowBytes = 0;
+
+    // Shared with the worker
+    mutable std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::vector<std::shared_ptr<const Chunk>> m_chunks;
+    std::shared_ptr<const TextMatcher> m_matcher;
+    HitsCallback m_onHits;
+    uint64_t m_generation = 0;          ///< Changes with each search and shadow reset
+    uint64_t m_scannedId = 0;           ///< Lines before this are scanned for the search
+    std::vector<SearchHit> m_hits;      ///< Found, not yet taken
+    size_t m_hitCount = 0;              ///< Reported for the search so far
+    bool m_invalidated = false;         ///< Shadow rebuilt since the last TakeHits
+    bool m_scanning = false;
+    bool m_stop = false;
+    std::thread m_worker;
+};
+
+} // namespace Console3::Core
@@ -0,0 +1,112 @@
+// Console3 - ScrollbackSpillFile.cpp
+// Append-only temporary file holding scrollback blocks evicted from memory
+
+#include "Core/ScrollbackSpillFile.h"
+#include <algorithm>
+
+namespace Console3::Core {
+
+bool ScrollbackSpillFile::Open() {
+    wchar_t dir[MAX_PATH + 1];
+    wchar_t path[MAX_PATH + 1];
+    const DWORD length = GetTempPathW(MAX_PATH + 1, dir);
+    if (length == 0 || length > MAX_PATH || GetTempFileNameW(dir, L"c3s", 0, path) == 0) {
+        return false;
+    }
+
+    // GetTempFileNameW created the file; reopen it so it goes away with us
+    m_file.reset(CreateFileW(path, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                             FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr));
+    if (!m_file) {
+        DeleteFileW(path);
+        return false;
+    }
+
+    m_size = 0;
+    return true;
+}
+
+std::optional<uint64_t> ScrollbackSpillFile::Append(std::span<const char> first, std::span<const char> second) {
+    if (!m_file) {
+        return std::nullopt;
+    }
+
+    const uint64_t start = m_size;
+    uint64_t offset = start;
+    for (std::span<const char> part : {first, second}) {
+        while (!part.empty()) {
+            OVERLAPPED position{};
+            position.Offset = static_cast<DWORD>(offset);
+            position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+            DWORD written = 0;
+            const DWORD chunk = static_cast<DWORD>(std::min<size_t>(part.size(), 1u << 30));
+            if (!WriteFile(m_file.get(), part.data(), chunk, &written, &position) || written == 0) {
+                return std::nullopt;
+            }
+            offset += written;
+            part = part.subspan(written);
+        }
+    }
+
+    m_size = offset;
+    return start;
+}
+
+const char* ScrollbackSpillFile::Map(uint64_t offset, size_t size) {
+    if (!m_file || offset + size > m_size) {
+        return nullptr;
+    }
+
+    // The view only covers the file as it was when it was mapped
+    if (offset + size > m_mappedSize) {
+        Unmap();
+        m_mapping.reset(CreateFileMappingW(m_file.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+        if (!m_mapping) {
+            return nullptr;
+        }
+        m_mappedSize = m_size;
+    }
+
+    if (!m_view || offset < m_viewOffset || offset + size > m_viewOffset + m_viewSize) {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        const uint64_t granularity = info.dwAllocationGranularity;
+
+        m_view.reset();
+        m_viewOffset = offset - offset % granularity;
+        m_viewSize = static_cast<size_t>(std::min<uint64_t>(
+            std::max<uint64_t>(offset + size - m_viewOffset, kViewSize), m_mappedSize - m_viewOffset));
+        m_view.reset(static_cast<char*>(MapViewOfFile(m_mapping.get(), FILE_MAP_READ,
+            static_cast<DWORD>(m_viewOffset >> 32), static_cast<DWORD>(m_viewOffset), m_viewSize)));
+        if (!m_view) {
+            m_viewSize = 0;
+            return nullptr;
+        }
+    }
+
+    return m_view.get() + (offset - m_viewOffset);
+}
+
+void ScrollbackSpillFile::Truncate() {
+    if (!m_file) {
+        return;
+    }
+
+    // A mapped file cannot shrink
+    Unmap();
+    LARGE_INTEGER zero{};
+    if (SetFilePointerEx(m_file.get(), zero, nullptr, FILE_BEGIN)) {
+        SetEndOfFile(m_file.get());
+    }
+    m_size = 0;
+}
+
+void ScrollbackSpillFile::Unmap() noexcept {
+    m_view.reset();
+    m_viewSize = 0;
+    m_mapping.reset();
+    m_mappedSize = 0;
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,65 @@
+#pragma once
+// Console3 - ScrollbackSpillFile.h
+// Append-only temporary file holding scrollback blocks evicted from memory
+//
+// The file is created in the user's temp directory with delete-on-close, so
+// nothing is left behind if the process exits abruptly. Blocks are appended
+// with ordinary writes and read back through a memory-mapped view that is
+// remapped when a read falls outside it; the OS pages the bytes in on demand
+// and can drop them again under memory pressure.
+
+#include <Windows.h>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+#include <wil/resource.h>
+
+namespace Console3::Core {
+
+/// Temporary file of spilled scrollback blocks
+class ScrollbackSpillFile {
+public:
+    static constexpr size_t kViewSize = 1024 * 1024;  ///< Minimum bytes mapped per view
+
+    ScrollbackSpillFile() = default;
+    ~ScrollbackSpillFile() = default;
+
+    // Non-copyable, non-movable
+    ScrollbackSpillFile(const ScrollbackSpillFile&) = delete;
+    ScrollbackSpillFile& operator=(const ScrollbackSpillFile&) = delete;
+
+    /// Create the temporary file
+    /// @return false if no temp file could be created
+    [[nodiscard]] bool Open();
+
+    [[nodiscard]] bool IsOpen() const noexcept { return static_cast<bool>(m_file); }
+
+    /// Append bytes to the end of the file
+    /// @return Offset of the first byte, or nullopt on a write error
+    [[nodiscard]] std::optional<uint64_t> Append(std::span<const char> first, std::span<const char> second = {});
+
+    /// Map a written range for reading
+    /// @return The bytes (valid until the next Map, Append or Truncate), or nullptr
+    [[nodiscard]] const char* Map(uint64_t offset, size_t size);
+
+    /// Discard everything written
+    void Truncate();
+
+    /// Get the bytes written (file size)
+    [[nodiscard]] uint64_t GetSize() const noexcept { return m_size; }
+
+private:
+    /// Close the view and mapping (before the file changes size)
+    void Unmap() noexcept;
+
+    wil::unique_hfile m_file;
+    wil::unique_handle m_mapping;
+    wil::unique_mapview_ptr<char> m_view;
+    uint64_t m_size = 0;
+    uint64_t m_mappedSize = 0;   ///< File size when m_mapping was created
+    uint64_t m_viewOffset = 0;
+    size_t m_viewSize = 0;
+};
+
+} // namespace Console3::Core
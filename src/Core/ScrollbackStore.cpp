@@ -0,0 +1,904 @@
+// Console3 - ScrollbackStore.cpp
+// Tiered scrollback history: recent rows as cells, older rows compressed
+
+#include "Core/ScrollbackStore.h"
+#include "Core/ScrollbackBudget.h"
+#include "Core/ScrollbackSpillFile.h"
+#include "Core/Varint.h"
+#include <algorithm>
+#include <cstring>
+#include <lz4.h>
+#include <utility>
+
+namespace Console3::Core {
+
+namespace {
+
+// ============================================================================
+// Line Encoding
+// ============================================================================
+//
+//   varint cols << 3 | filled << 1 | continuation, varint cells (before the
+//   trailing fill), varint spans
+//   filled: fill fg rgba, bg rgba, attrBits, varint code (default blanks
+//   otherwise)
+//   spans: varint length, fg rgba, bg rgba, attrBits, width | grapheme << 2
+//   cells: varint code each
+//
+// A line shared through the LineInterner is only its reference:
+//   varint id << 3 | 4 | continuation
+
+/// Every field of a line fits 32 bits
+uint32_t GetVarint32(const char*& p) noexcept {
+    return static_cast<uint32_t>(GetVarint(p));
+}
+
+void PutColor(std::vector<char>& out, const CellColor& color) {
+    out.push_back(static_cast<char>(color.r));
+    out.push_back(static_cast<char>(color.g));
+    out.push_back(static_cast<char>(color.b));
+    out.push_back(static_cast<char>(color.flags));
+}
+
+CellColor GetColor(const char*& p) {
+    CellColor color;
+    color.r = static_cast<uint8_t>(p[0]);
+    color.g = static_cast<uint8_t>(p[1]);
+    color.b = static_cast<uint8_t>(p[2]);
+    color.flags = static_cast<uint8_t>(p[3]);
+    p += 4;
+    return color;
+}
+
+constexpr uint32_t kInternedBit = 4;
+
+/// Get the interned line an encoded line refers to
+/// @return Its id, or 0 if the line is stored in place
+uint32_t InternedId(const char* p) {
+    const uint32_t header = GetVarint32(p);
+    return (header & kInternedBit) ? header >> 3 : 0;
+}
+
+/// Check if two cells share colors, attributes and layout
+bool SameRunStyle(const Cell& a, const Cell& b) noexcept {
+    return a.fg == b.fg && a.bg == b.bg && a.attrBits == b.attrBits &&
+           a.width == b.width && a.grapheme == b.grapheme;
+}
+
+/// Encode a line of a width, given its cells before its trailing fill
+void EncodeLine(std::span<const Cell> cells, const Cell& fill, size_t width, bool continuation,
+                std::vector<char>& out) {
+    const size_t used = cells.size();
+    size_t spans = 0;
+    for (size_t i = 0; i < used; ++i) {
+        if (i == 0 || !SameRunStyle(cells[i], cells[i - 1])) {
+            ++spans;
+        }
+    }
+
+    const bool filled = fill != Cell{};
+    PutVarint(out, static_cast<uint32_t>(width << 3) | (filled ? 2 : 0) | (continuation ? 1 : 0));
+    PutVarint(out, static_cast<uint32_t>(used));
+    PutVarint(out, static_cast<uint32_t>(spans));
+    if (filled) {
+        PutColor(out, fill.fg);
+        PutColor(out, fill.bg);
+        out.push_back(static_cast<char>(fill.attrBits));
+        PutVarint(out, fill.code);
+    }
+
+    for (size_t start = 0; start < used;) {
+        size_t end = start + 1;
+        while (end < used && SameRunStyle(cells[end], cells[start])) {
+            ++end;
+        }
+        const Cell& cell = cells[start];
+        PutVarint(out, static_cast<uint32_t>(end - start));
+        PutColor(out, cell.fg);
+        PutColor(out, cell.bg);
+        out.push_back(static_cast<char>(cell.attrBits));
+        out.push_back(static_cast<char>(cell.width | (cell.grapheme << 2)));
+        start = end;
+    }
+
+    for (size_t i = 0; i < used; ++i) {
+        PutVarint(out, cells[i].code);
+    }
+}
+
+/// Check if an encoded line continues the one before it
+bool IsContinuationLine(const char* p) {
+    return (GetVarint32(p) & 1) != 0;
+}
+
+void DecodeLine(const char* p, Row& out) {
+    const uint32_t header = GetVarint32(p);
+    const uint32_t cols = header >> 3;
+    const uint32_t used = GetVarint32(p);
+    const uint32_t spans = GetVarint32(p);
+
+    Cell fill;
+    if (header & 2) {
+        fill.fg = GetColor(p);
+        fill.bg = GetColor(p);
+        fill.attrBits = static_cast<uint8_t>(*p++);
+        fill.code = GetVarint32(p);
+    }
+    out.assign(cols, fill);
+
+    uint32_t col = 0;
+    for (uint32_t span = 0; span < spans; ++span) {
+        const uint32_t length = GetVarint32(p);
+        Cell style;
+        style.fg = GetColor(p);
+        style.bg = GetColor(p);
+        style.attrBits = static_cast<uint8_t>(p[0]);
+        style.width = static_cast<uint8_t>(p[1]) & 0x3;
+        style.grapheme = (static_cast<uint8_t>(p[1]) >> 2) & 0x1;
+        p += 2;
+        std::fill_n(out.begin() + col, length, style);
+        col += length;
+    }
+
+    for (uint32_t i = 0; i < used; ++i) {
+        out[i].code = GetVarint32(p);
+    }
+}
+
+} // namespace
+
+ScrollbackStore::ScrollbackStore(size_t maxLines, size_t hotLines, bool spillToDisk, bool internLines)
+    : m_maxLines(maxLines)
+    , m_limitLines(maxLines)
+    , m_hotLines(std::max<size_t>(hotLines, 1))
+    , m_spillToDisk(spillToDisk)
+    , m_internLines(internLines) {
+}
+
+ScrollbackStore::~ScrollbackStore() {
+    if (m_budgeted) {
+        ScrollbackBudget& budget = ScrollbackBudget::Shared();
+        budget.Charge(m_charged, 0);
+        budget.Remove(this);
+    }
+}
+
+ScrollbackStore::ScrollbackStore(ScrollbackStore&& other) noexcept
+    : ScrollbackStore(0) {
+    *this = std::move(other);
+}
+
+ScrollbackStore& ScrollbackStore::operator=(ScrollbackStore&& other) noexcept {
+    if (this == &other) {
+        return *this;
+    }
+
+    // The budget tracks stores by address, so the registration moves too
+    ScrollbackBudget& budget = ScrollbackBudget::Shared();
+    if (m_budgeted) {
+        budget.Charge(m_charged, 0);
+        budget.Remove(this);
+    }
+
+    m_maxLines = other.m_maxLines;
+    m_limitLines = other.m_limitLines;
+    m_hotLines = other.m_hotLines;
+    m_spillToDisk = other.m_spillToDisk;
+    m_internLines = other.m_internLines;
+    m_hot = std::move(other.m_hot);
+    m_staging = std::move(other.m_staging);
+    m_stagingOffsets = std::move(other.m_stagingOffsets);
+    m_blocks = std::move(other.m_blocks);
+    m_blockLines = other.m_blockLines;
+    m_nextBlockId = other.m_nextBlockId;
+    m_spill = std::move(other.m_spill);
+    m_spilledBlocks = other.m_spilledBlocks;
+    m_spilledLines = other.m_spilledLines;
+    m_spillFailed = other.m_spillFailed;
+    m_interner = std::move(other.m_interner);
+    m_spare = std::move(other.m_spare);
+    m_scratch = std::move(other.m_scratch);
+    m_lineScratch = std::move(other.m_lineScratch);
+    m_cachedBlock = other.m_cachedBlock;
+    m_cachedRaw = std::move(other.m_cachedRaw);
+    m_cachedOffsets = std::move(other.m_cachedOffsets);
+    m_decoded = std::move(other.m_decoded);
+    m_blockBytes = other.m_blockBytes;
+    m_charged = std::exchange(other.m_charged, 0);
+    m_budgeted = std::exchange(other.m_budgeted, false);
+    m_lastUse = other.m_lastUse;
+    m_firstId = other.m_firstId;
+    m_endId = other.m_endId;
+    if (m_budgeted) {
+        budget.Replace(&other, this);
+    }
+
+    other.Clear();
+    return *this;
+}
+
+size_t ScrollbackStore::Size() const noexcept {
+    return m_hot.Size() + m_stagingOffsets.size() + m_blockLines;
+}
+
+// ============================================================================
+// Access
+// ============================================================================
+
+const Row* ScrollbackStore::Get(size_t index) const {
+    Touch();
+    if (index < m_hot.Size()) {
+        m_hot.Expand(index, m_decoded);
+        return &m_decoded;
+    }
+    index -= m_hot.Size();
+
+    if (index < m_stagingOffsets.size()) {
+        DecodeLine(Resolve(m_staging.data() + m_stagingOffsets[m_stagingOffsets.size() - 1 - index]), m_decoded);
+        return &m_decoded;
+    }
+    index -= m_stagingOffsets.size();
+
+    if (index >= m_blockLines) {
+        return nullptr;
+    }
+
+    // Every block but the oldest is full, and the oldest only loses lines
+    // from its old end
+    const Block& block = m_blocks[index / kBlockLines];
+    const char* bytes = LineBytes(block, kBlockLines - 1 - index % kBlockLines);
+    if (!bytes) {
+        return nullptr;
+    }
+    DecodeLine(Resolve(bytes), m_decoded);
+    return &m_decoded;
+}
+
+bool ScrollbackStore::IsContinuation(size_t index) const {
+    if (index < m_hot.Size()) {
+        return m_hot.IsContinuation(index);
+    }
+    index -= m_hot.Size();
+
+    if (index < m_stagingOffsets.size()) {
+        return IsContinuationLine(m_staging.data() + m_stagingOffsets[m_stagingOffsets.size() - 1 - index]);
+    }
+    index -= m_stagingOffsets.size();
+
+    if (index >= m_blockLines) {
+        return false;
+    }
+    const Block& block = m_blocks[index / kBlockLines];
+    const char* bytes = LineBytes(block, kBlockLines - 1 - index % kBlockLines);
+    return bytes && IsContinuationLine(bytes);
+}
+
+ScrollbackView ScrollbackStore::ShareLines(uint64_t firstId, uint64_t endId, bool spilled) const {
+    ScrollbackView view;
+    const size_t newer = m_hot.Size() + m_stagingOffsets.size();
+    uint64_t id = std::max(firstId, m_firstId);
+    endId = std::min(endId, m_endId);
+    while (id < endId) {
+        // Store index of the line, then its place among the block lines
+        const auto cold = static_cast<size_t>(m_endId - 1 - id);
+        if (cold < newer || cold - newer >= m_blockLines) {
+            break;
+        }
+        const size_t index = cold - newer;
+        const Block& block = m_blocks[index / kBlockLines];
+        std::shared_ptr<const ScrollbackBlockData> data = block.sealed;
+        if (!data && block.spilled && spilled) {
+            data = ReadSpilled(block);
+        }
+        if (!data) {
+            break;
+        }
+
+        // Later lines of a block are newer: the rest of it, or up to endId
+        const auto line = static_cast<uint32_t>(kBlockLines - 1 - index % kBlockLines);
+        const auto count = static_cast<uint32_t>(std::min<uint64_t>(block.lines - line, endId - id));
+        view.m_parts.push_back({std::move(data), line, count});
+        view.m_size += count;
+        id += count;
+    }
+    return view;
+}
+
+const char* ScrollbackStore::Resolve(const char* bytes) const {
+    const uint32_t id = InternedId(bytes);
+    return id != 0 ? m_interner.Get(id).data() : bytes;
+}
+
+void ScrollbackStore::ReleaseLine(const char* bytes) {
+    if (const uint32_t id = InternedId(bytes)) {
+        m_interner.Release(id);
+    }
+}
+
+const char* ScrollbackStore::LineBytes(const Block& block, size_t line) const {
+    if (!block.compressed && !block.spilled) {
+        return block.sealed->data.data() + block.sealed->offsets[line];
+    }
+    if (m_cachedBlock != block.id && !Load(block)) {
+        return nullptr;
+    }
+    return m_cachedRaw.data() + m_cachedOffsets[line];
+}
+
+bool ScrollbackStore::Load(const Block& block) const {
+    m_cachedBlock = 0;
+
+    const char* data = block.spilled ? nullptr : block.sealed->data.data();
+    if (block.spilled) {
+        const size_t offsetBytes = block.lines * sizeof(uint32_t);
+        const char* view = m_spill ? m_spill->Map(block.fileOffset, offsetBytes + block.storedSize) : nullptr;
+        if (!view) {
+            return false;
+        }
+        m_cachedOffsets.resize(block.lines);
+        std::memcpy(m_cachedOffsets.data(), view, offsetBytes);
+        data = view + offsetBytes;
+    } else {
+        m_cachedOffsets = block.sealed->offsets;
+    }
+
+    m_cachedRaw.resize(block.rawSize);
+    if (block.compressed) {
+        const int size = LZ4_decompress_safe(data, m_cachedRaw.data(), static_cast<int>(block.storedSize),
+                                             static_cast<int>(block.rawSize));
+        if (size != static_cast<int>(block.rawSize)) {
+            return false;
+        }
+    } else {
+        std::memcpy(m_cachedRaw.data(), data, block.rawSize);
+    }
+
+    m_cachedBlock = block.id;
+    return true;
+}
+
+std::shared_ptr<const ScrollbackBlockData> ScrollbackStore::ReadSpilled(const Block& block) const {
+    const size_t offsetBytes = block.lines * sizeof(uint32_t);
+    const char* view = m_spill ? m_spill->Map(block.fileOffset, offsetBytes + block.storedSize) : nullptr;
+    if (!view) {
+        return nullptr;
+    }
+    auto data = std::make_shared<ScrollbackBlockData>();
+    data->offsets.resize(block.lines);
+    std::memcpy(data->offsets.data(), view, offsetBytes);
+    data->data.assign(view + offsetBytes, view + offsetBytes + block.storedSize);
+    data->rawSize = block.rawSize;
+    data->compressed = block.compressed;
+
+    // The view holds the interned lines its lines refer to, as a sealed block does
+    for (const uint32_t id : block.interned) {
+        data->interned.emplace_back(id, nullptr);
+    }
+    std::ranges::sort(data->interned);
+    data->interned.erase(std::unique(data->interned.begin(), data->interned.end()), data->interned.end());
+    for (auto& [id, bytes] : data->interned) {
+        bytes = m_interner.Share(id);
+    }
+    return data;
+}
+
+// ============================================================================
+// Modification
+// ============================================================================
+
+void ScrollbackStore::Push(std::span<const Cell> cells, bool continuation) {
+    if (m_maxLines == 0) {
+        return;
+    }
+
+    // The line takes the cells of lines that left the hot window (or fell
+    // off the end), so steady-state scrolling does not allocate
+    MakeHotRoom();
+    m_hot.PushFront(cells, continuation);
+    ++m_endId;
+    Trim();
+    Account();
+}
+
+bool ScrollbackStore::PopNewest(std::span<Cell> out, bool* continuation) {
+    const Row* line = nullptr;
+    if (!m_hot.Empty()) {
+        m_hot.CopyTo(0, out);
+    } else {
+        if (m_stagingOffsets.empty()) {
+            if (m_blocks.empty()) {
+                return false;
+            }
+            UnsealNewest();
+        }
+        line = Get(0);
+    }
+
+    if (line) {
+        std::copy_n(line->begin(), std::min(line->size(), out.size()), out.begin());
+    }
+    if (continuation) {
+        *continuation = IsContinuation(0);
+    }
+
+    --m_endId;
+    if (!m_hot.Empty()) {
+        m_hot.PopFront();
+    } else {
+        ReleaseLine(m_staging.data() + m_stagingOffsets.back());
+        m_staging.resize(m_stagingOffsets.back());
+        m_stagingOffsets.pop_back();
+    }
+    Charge();
+    return true;
+}
+
+void ScrollbackStore::Clear() {
+    m_firstId = m_endId;
+    m_hot.Clear();
+    m_staging.clear();
+    m_stagingOffsets.clear();
+    m_blocks.clear();
+    m_blockLines = 0;
+    m_cachedBlock = 0;
+    m_interner.Clear();
+
+    if (m_spill) {
+        m_spill->Truncate();
+    }
+    m_spilledBlocks = 0;
+    m_spilledLines = 0;
+    m_spillFailed = false;
+
+    m_blockBytes = 0;
+    Charge();
+}
+
+void ScrollbackStore::ShareFrom(const ScrollbackStore& source) {
+    if (this == &source) {
+        return;
+    }
+    Clear();
+
+    // The interned copies are shared and their counts taken over: every
+    // reference the source holds, this store now holds too
+    m_hot = source.m_hot;
+    m_staging = source.m_staging;
+    m_stagingOffsets = source.m_stagingOffsets;
+    m_interner = source.m_interner;
+    const auto inMemory = static_cast<std::ptrdiff_t>(source.m_blocks.size() - source.m_spilledBlocks);
+    m_blocks.assign(source.m_blocks.begin(), source.m_blocks.begin() + inMemory);
+    for (auto block = source.m_blocks.begin() + inMemory; block != source.m_blocks.end(); ++block) {
+        for (const uint32_t id : block->interned) {
+            m_interner.Release(id);
+        }
+    }
+    m_blockLines = source.m_blockLines - source.m_spilledLines;
+    m_nextBlockId = source.m_nextBlockId;
+    m_blockBytes = source.m_blockBytes;
+    m_endId = source.m_endId;
+    m_firstId = m_endId - Size();
+
+    Trim();
+    Account();
+}
+
+void ScrollbackStore::SetMaxLines(size_t lines) {
+    m_maxLines = lines;
+    m_limitLines = lines;
+    Trim();
+    Charge();
+}
+
+void ScrollbackStore::SetMaxLinesDeferred(size_t lines) {
+    m_limitLines = lines;
+    if (lines >= m_maxLines || lines >= Size()) {
+        SetMaxLines(lines);
+        return;
+    }
+
+    // Keep what is there for now; TrimSlice() lowers the limit from here
+    m_maxLines = std::max(Size(), lines);
+}
+
+bool ScrollbackStore::TrimSlice(size_t lines) {
+    if (m_maxLines <= m_limitLines) {
+        return false;
+    }
+
+    // Pushes may have trimmed some already: start from what is held
+    m_maxLines = std::min(m_maxLines, std::max(Size(), m_limitLines));
+    m_maxLines -= std::min(lines, m_maxLines - m_limitLines);
+    Trim();
+    Charge();
+    return m_maxLines > m_limitLines;
+}
+
+void ScrollbackStore::DemoteOldestHot() {
+    const size_t oldest = m_hot.Size() - 1;
+    const bool continuation = m_hot.IsContinuation(oldest);
+    m_stagingOffsets.push_back(static_cast<uint32_t>(m_staging.size()));
+    if (!m_internLines) {
+        EncodeLine(m_hot.Cells(oldest), m_hot.Fill(oldest), m_hot.Width(oldest), continuation, m_staging);
+    } else {
+        m_lineScratch.clear();
+        EncodeLine(m_hot.Cells(oldest), m_hot.Fill(oldest), m_hot.Width(oldest), continuation, m_lineScratch);
+        if (const uint32_t id = m_interner.Intern(m_lineScratch)) {
+            PutVarint(m_staging, id << 3 | kInternedBit | (continuation ? 1 : 0));
+        } else {
+            m_staging.insert(m_staging.end(), m_lineScratch.begin(), m_lineScratch.end());
+        }
+    }
+    m_hot.PopBack();
+
+    if (m_stagingOffsets.size() == kBlockLines) {
+        SealStaging();
+    }
+}
+
+void ScrollbackStore::MakeHotRoom() {
+    if (m_hot.Size() < std::min(m_hotLines, m_maxLines)) {
+        return;
+    }
+    if (m_hotLines < m_maxLines || m_spillToDisk) {
+        DemoteOldestHot();
+    } else {
+        // Everything fits in the hot window: the oldest line falls off
+        m_hot.PopBack();
+        ++m_firstId;
+    }
+}
+
+void ScrollbackStore::SealStaging() {
+    std::shared_ptr<ScrollbackBlockData> sealed = std::move(m_spare);
+    if (!sealed) {
+        sealed = std::make_shared<ScrollbackBlockData>();
+    }
+    Block block;
+    block.id = m_nextBlockId++;
+    sealed->offsets.assign(m_stagingOffsets.begin(), m_stagingOffsets.end());
+    block.rawSize = static_cast<uint32_t>(m_staging.size());
+    block.lines = static_cast<uint32_t>(m_stagingOffsets.size());
+
+    // Views outlive the interned lines' references, so hold the lines too
+    sealed->interned.clear();
+    if (m_interner.GetReferenceCount() != 0) {
+        for (const uint32_t offset : m_stagingOffsets) {
+            if (const uint32_t id = InternedId(m_staging.data() + offset)) {
+                block.interned.push_back(id);
+                sealed->interned.emplace_back(id, nullptr);
+            }
+        }
+        std::ranges::sort(sealed->interned);
+        sealed->interned.erase(std::unique(sealed->interned.begin(), sealed->interned.end()),
+                               sealed->interned.end());
+        for (auto& [id, bytes] : sealed->interned) {
+            bytes = m_interner.Share(id);
+        }
+    }
+
+    const int rawSize = static_cast<int>(m_staging.size());
+    m_scratch.resize(static_cast<size_t>(LZ4_compressBound(rawSize)));
+    const int packed = LZ4_compress_default(m_staging.data(), m_scratch.data(), rawSize,
+                                            static_cast<int>(m_scratch.size()));
+    if (packed > 0 && packed < rawSize) {
+        sealed->data.assign(m_scratch.begin(), m_scratch.begin() + packed);
+        block.compressed = true;
+    } else {
+        sealed->data.assign(m_staging.begin(), m_staging.end());
+    }
+    sealed->rawSize = block.rawSize;
+    sealed->compressed = block.compressed;
+    block.storedSize = static_cast<uint32_t>(sealed->data.size());
+    block.sealed = std::move(sealed);
+
+    m_blockBytes += BlockBytes(block);
+    m_blocks.push_front(std::move(block));
+    m_blockLines += kBlockLines;
+    m_staging.clear();
+    m_stagingOffsets.clear();
+}
+
+void ScrollbackStore::UnsealNewest() {
+    const Block& block = m_blocks.front();
+    const size_t live = block.lines - block.dropped;
+
+    // Trimmed lines of the oldest block are not brought back
+    m_staging.clear();
+    m_stagingOffsets.clear();
+    if (const char* first = LineBytes(block, block.dropped)) {
+        const bool cached = block.compressed || block.spilled;
+        const char* base = cached ? m_cachedRaw.data() : block.sealed->data.data();
+        const std::vector<uint32_t>& offsets = cached ? m_cachedOffsets : block.sealed->offsets;
+        m_staging.assign(first, base + block.rawSize);
+        for (size_t line = block.dropped; line < block.lines; ++line) {
+            m_stagingOffsets.push_back(offsets[line] - offsets[block.dropped]);
+        }
+    }
+
+    // Staging holds its own references; the block's go with it
+    for (const uint32_t offset : m_stagingOffsets) {
+        if (const uint32_t id = InternedId(m_staging.data() + offset)) {
+            m_interner.Retain(id);
+        }
+    }
+    for (const uint32_t id : block.interned) {
+        m_interner.Release(id);
+    }
+
+    m_blockLines -= live;
+    if (block.spilled) {
+        --m_spilledBlocks;
+        m_spilledLines -= live;
+    } else {
+        m_blockBytes -= BlockBytes(block);
+    }
+    if (m_cachedBlock == block.id) {
+        m_cachedBlock = 0;
+    }
+    m_blocks.pop_front();
+}
+
+void ScrollbackStore::Trim() {
+    if (m_spillToDisk && !m_spillFailed) {
+        // Evict rather than delete: the oldest blocks in memory go to disk
+        while (Size() - m_spilledLines > m_maxLines && m_blocks.size() > m_spilledBlocks) {
+            if (!SpillOldestInMemory()) {
+                m_spillFailed = true;
+                break;
+            }
+        }
+        if (!m_spillFailed && m_maxLines > 0) {
+            return;
+        }
+    }
+
+    while (Size() > m_maxLines) {
+        DropOldest();
+    }
+}
+
+bool ScrollbackStore::SpillOldestInMemory() {
+    if (!m_spill) {
+        m_spill = std::make_unique<ScrollbackSpillFile>();
+    }
+    if (!m_spill->IsOpen() && !m_spill->Open()) {
+        return false;
+    }
+
+    Block& block = m_blocks[m_blocks.size() - m_spilledBlocks - 1];
+    const ScrollbackBlockData& sealed = *block.sealed;
+    const auto offset = m_spill->Append(
+        {reinterpret_cast<const char*>(sealed.offsets.data()), sealed.offsets.size() * sizeof(uint32_t)},
+        {sealed.data.data(), sealed.data.size()});
+    if (!offset) {
+        return false;
+    }
+
+    m_blockBytes -= BlockBytes(block);
+    block.fileOffset = *offset;
+    block.spilled = true;
+    block.sealed.reset();
+
+    ++m_spilledBlocks;
+    m_spilledLines += block.lines - block.dropped;
+    return true;
+}
+
+void ScrollbackStore::DropOldest() {
+    ++m_firstId;
+    if (m_blockLines > 0) {
+        Block& oldest = m_blocks.back();
+        ++oldest.dropped;
+        --m_blockLines;
+        if (oldest.spilled) {
+            --m_spilledLines;
+        }
+        if (oldest.dropped == oldest.lines) {
+            if (m_cachedBlock == oldest.id) {
+                m_cachedBlock = 0;
+            }
+            for (const uint32_t id : oldest.interned) {
+                m_interner.Release(id);
+            }
+            if (oldest.spilled) {
+                --m_spilledBlocks;
+            } else {
+                // The next block sealed takes over its storage, unless a
+                // view still reads it
+                m_blockBytes -= BlockBytes(oldest);
+                if (oldest.sealed.use_count() == 1) {
+                    m_spare = std::move(oldest.sealed);
+                }
+            }
+            m_blocks.pop_back();
+        }
+    } else if (!m_stagingOffsets.empty()) {
+        // Only when the limit is barely above the hot window
+        const uint32_t next = m_stagingOffsets.size() > 1
+            ? m_stagingOffsets[1] : static_cast<uint32_t>(m_staging.size());
+        ReleaseLine(m_staging.data());
+        m_staging.erase(m_staging.begin(), m_staging.begin() + next);
+        m_stagingOffsets.erase(m_stagingOffsets.begin());
+        for (uint32_t& offset : m_stagingOffsets) {
+            offset -= next;
+        }
+    } else {
+        m_hot.PopBack();
+    }
+}
+
+ScrollbackStats ScrollbackStore::GetStats() const {
+    ScrollbackStats stats;
+    stats.hotLines = m_hot.Size();
+    stats.coldLines = m_stagingOffsets.size() + m_blockLines;
+    stats.blocks = m_blocks.size();
+    stats.spilledLines = m_spilledLines;
+    stats.spilledBytes = m_spill ? m_spill->GetSize() : 0;
+    stats.hotBytes = m_hot.GetBytes();
+    stats.coldBytes = m_staging.capacity() + m_stagingOffsets.capacity() * sizeof(uint32_t) + m_interner.GetBytes();
+    for (const Block& block : m_blocks) {
+        stats.coldBytes += block.interned.capacity() * sizeof(uint32_t);
+        if (block.sealed) {
+            stats.coldBytes += block.sealed->data.capacity() + block.sealed->offsets.capacity() * sizeof(uint32_t) +
+                               block.sealed->interned.capacity() * sizeof(block.sealed->interned[0]);
+        }
+    }
+    stats.internedLines = m_interner.GetReferenceCount();
+    return stats;
+}
+
+// ============================================================================
+// Memory Budget
+// ============================================================================
+
+size_t ScrollbackStore::GetResidentBytes() const noexcept {
+    return m_hot.GetCellCount() * sizeof(Cell) + m_staging.size() + m_stagingOffsets.size() * sizeof(uint32_t) +
+           m_blockBytes + m_interner.GetBytes();
+}
+
+void ScrollbackStore::Touch() const noexcept {
+    m_lastUse = ScrollbackBudget::Shared().NextUse();
+}
+
+size_t ScrollbackStore::BlockBytes(const Block& block) noexcept {
+    const ScrollbackBlockData* sealed = block.sealed.get();
+    return sealed ? sealed->data.size() + sealed->offsets.size() * sizeof(uint32_t) +
+                        sealed->interned.size() * sizeof(sealed->interned[0])
+                  : 0;
+}
+
+void ScrollbackStore::Account() {
+    Charge();
+    ScrollbackBudget& budget = ScrollbackBudget::Shared();
+    if (budget.IsOverLimit()) {
+        budget.Enforce();
+    }
+}
+
+void ScrollbackStore::Charge() {
+    const size_t bytes = GetResidentBytes();
+    if (bytes == m_charged) {
+        return;
+    }
+
+    ScrollbackBudget& budget = ScrollbackBudget::Shared();
+    if (!m_budgeted) {
+        // Stores that never hold a line (the emulation thread's) stay out
+        budget.Add(this);
+        m_budgeted = true;
+        Touch();
+    }
+    budget.Charge(m_charged, bytes);
+    m_charged = bytes;
+}
+
+void ScrollbackStore::Hibernate() {
+    Shed(Relief::Compress, GetResidentBytes());
+    Shed(Relief::Spill, GetResidentBytes());
+
+    // Staging stays raw: sealing it early would leave a partial block
+    m_cachedBlock = 0;
+    std::vector<char>().swap(m_cachedRaw);
+    std::vector<uint32_t>().swap(m_cachedOffsets);
+    Row().swap(m_decoded);
+    std::vector<char>().swap(m_scratch);
+    std::vector<char>().swap(m_lineScratch);
+    m_spare.reset();
+}
+
+bool ScrollbackStore::HibernateSlice(size_t lines) {
+    size_t left = lines;
+    for (; left > 0 && !m_hot.Empty(); --left) {
+        DemoteOldestHot();
+    }
+    while (left > 0 && !m_spillFailed && m_blocks.size() > m_spilledBlocks) {
+        if (!SpillOldestInMemory()) {
+            m_spillFailed = true;
+        }
+        left -= std::min(left, kBlockLines);
+    }
+    if (left == 0) {
+        Charge();
+        return true;
+    }
+
+    // What is left is quick
+    Hibernate();
+    return false;
+}
+
+void ScrollbackStore::Shed(Relief step, size_t bytes) {
+    const size_t resident = GetResidentBytes();
+    const size_t floor = resident > bytes ? resident - bytes : 0;
+
+    switch (step) {
+    case Relief::Compress:
+        while (!m_hot.Empty() && GetResidentBytes() > floor) {
+            DemoteOldestHot();
+        }
+        m_hot.ReleaseSpare();
+        break;
+    case Relief::Spill:
+        // Without spillToDisk too: the file holds lines the limit would
+        // otherwise cost, and Trim() still drops past m_maxLines
+        while (!m_spillFailed && m_blocks.size() > m_spilledBlocks && GetResidentBytes() > floor) {
+            if (!SpillOldestInMemory()) {
+                m_spillFailed = true;
+            }
+        }
+        break;
+    case Relief::Drop:
+        while (Size() > 0 && GetResidentBytes() > floor) {
+            DropOldest();
+        }
+        m_hot.ReleaseSpare();
+        break;
+    }
+    Charge();
+}
+
+// ============================================================================
+// View (any thread)
+// ============================================================================
+
+bool ScrollbackView::Get(size_t index, Row& out, bool* continuation) {
+    const Part* part = m_parts.data();
+    const Part* const end = part + m_parts.size();
+    while (part != end && index >= part->count) {
+        index -= part->count;
+        ++part;
+    }
+    if (part == end) {
+        return false;
+    }
+
+    const ScrollbackBlockData& block = *part->block;
+    const char* raw = block.data.data();
+    if (block.compressed) {
+        if (m_cached != &block) {
+            m_cached = nullptr;
+            m_raw.resize(block.rawSize);
+            const int size = LZ4_decompress_safe(block.data.data(), m_raw.data(), static_cast<int>(block.data.size()),
+                                                 static_cast<int>(block.rawSize));
+            if (size != static_cast<int>(block.rawSize)) {
+                return false;
+            }
+            m_cached = &block;
+        }
+        raw = m_raw.data();
+    }
+
+    const char* bytes = raw + block.offsets[part->first + index];
+    if (continuation) {
+        *continuation = IsContinuationLine(bytes);
+    }
+    if (const uint32_t id = InternedId(bytes)) {
+        const auto found = std::ranges::lower_bound(block.interned, id, {}, [](const auto& entry) { return entry.first; });
+        bytes = found->second->data();
+    }
+    DecodeLine(bytes, out);
+    return true;
+}
+
+} // namespace Console3::Core
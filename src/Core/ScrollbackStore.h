@@ -0,0 +1,346 @@
+#pragma once
+// Console3 - ScrollbackStore.h
+// Tiered scrollback history: recent rows as cells, older rows compressed
+//
+// The newest lines stay as cells in a hot window (LineSlab), where pushes
+// and pops cost a copy; each is cut at its trailing fill, so a short line
+// on a wide window holds only the cells it uses. A line leaving the hot
+// window is run-length encoded (its characters plus spans of equal style,
+// trailing fill dropped) into a staging block; once kBlockLines lines are staged the block
+// is LZ4-compressed. Cold lines are decoded on demand when something asks
+// for them, with the block last touched kept decompressed so scrolling or
+// searching through it decodes each block once.
+//
+// With spilling enabled the line limit only bounds memory: instead of
+// dropping the oldest lines, the oldest compressed blocks are appended to a
+// temporary file (ScrollbackSpillFile) and read back through a mapped view
+// when needed, so history is limited by disk space.
+//
+// With interning enabled, a cold line repeating one seen lately (a
+// progress bar, a recurring warning) is stored once in a LineInterner and
+// referenced from each place it occurs, across blocks and in staging.
+//
+// Every store also answers to the process-wide ScrollbackBudget, which may
+// compress, spill or drop its lines when all scrollback together holds too
+// much memory.
+//
+// The store itself belongs to one thread. A sealed block never changes,
+// though, so its bytes are reference counted and ShareLines() hands them
+// out as a ScrollbackView that any thread may decode: trimming or spilling
+// the block only drops the store's reference, and the memory goes with
+// the last reader's. Readers take no lock and never hold up the writer.
+//
+// For the same reason another store can take them over whole: ShareFrom()
+// gives a duplicated session the history of the one it copies, sharing
+// every sealed block in memory and copying only the hot rows and staging.
+// Neither store ever writes a sealed block; the one that pops lines back
+// out of its newest block unseals its own copy, and a block trimmed away
+// by one stays in memory while the other holds it.
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "Core/Cell.h"
+#include "Core/LineInterner.h"
+#include "Core/LineSlab.h"
+
+namespace Console3::Core {
+
+class ScrollbackSpillFile;
+
+/// Scrollback memory use
+struct ScrollbackStats {
+    size_t hotLines = 0;        ///< Lines held as rows
+    size_t coldLines = 0;       ///< Lines held encoded (staged or compressed)
+    size_t blocks = 0;          ///< Compressed blocks (in memory or spilled)
+    size_t spilledLines = 0;    ///< Lines whose block lives in the spill file
+    size_t hotBytes = 0;        ///< Cell storage of the hot rows
+    size_t coldBytes = 0;       ///< Encoded and compressed bytes in memory
+    size_t internedLines = 0;   ///< Cold lines stored as a reference to a shared copy
+    uint64_t spilledBytes = 0;  ///< Size of the spill file
+};
+
+/// The bytes of a sealed block, immutable once sealed (see file comment)
+struct ScrollbackBlockData {
+    std::vector<char> data;            ///< Compressed, or raw if that was smaller
+    std::vector<uint32_t> offsets;     ///< Start of each line in the raw bytes
+    uint32_t rawSize = 0;
+    bool compressed = false;
+
+    /// Interned lines its lines refer to, by id (sorted)
+    std::vector<std::pair<uint32_t, std::shared_ptr<const std::vector<char>>>> interned;
+};
+
+/// Stored lines in sealed blocks, readable on any thread (see
+/// ScrollbackStore::ShareLines)
+/// A view is read by one thread at a time: it keeps the block it last
+/// decompressed.
+class ScrollbackView {
+public:
+    [[nodiscard]] size_t Size() const noexcept { return m_size; }
+    [[nodiscard]] bool Empty() const noexcept { return m_size == 0; }
+
+    /// Decode a line (0 = oldest)
+    /// @param continuation Receives the line's soft-wrap flag (optional)
+    /// @return false if out of range or its block does not decompress
+    bool Get(size_t index, Row& out, bool* continuation = nullptr);
+
+private:
+    friend class ScrollbackStore;
+
+    /// Lines [first, first + count) of a block
+    struct Part {
+        std::shared_ptr<const ScrollbackBlockData> block;
+        uint32_t first = 0;
+        uint32_t count = 0;
+    };
+
+    std::vector<Part> m_parts;          ///< Oldest first
+    size_t m_size = 0;
+    const ScrollbackBlockData* m_cached = nullptr;
+    std::vector<char> m_raw;            ///< m_cached decompressed
+};
+
+/// Scrollback lines, most recent first, with compressed cold storage
+class ScrollbackStore {
+public:
+    static constexpr size_t kDefaultHotLines = 1000;
+    static constexpr size_t kBlockLines = 256;
+
+    /// @param maxLines Lines kept before the oldest are dropped (spilled
+    ///                 instead, with spillToDisk)
+    /// @param hotLines Most recent lines kept uncompressed
+    /// @param spillToDisk Move old blocks to a temporary file instead of dropping them
+    /// @param internLines Store repeated cold lines once (LineInterner)
+    explicit ScrollbackStore(size_t maxLines = 10000, size_t hotLines = kDefaultHotLines,
+                             bool spillToDisk = false, bool internLines = false);
+    ~ScrollbackStore();
+
+    ScrollbackStore(ScrollbackStore&&) noexcept;
+    ScrollbackStore& operator=(ScrollbackStore&&) noexcept;
+
+    [[nodiscard]] size_t Size() const noexcept;
+    [[nodiscard]] bool Empty() const noexcept { return Size() == 0; }
+
+    /// Get a line (0 = most recent) at the width it was pushed at
+    /// The line is expanded or decoded into scratch storage: the pointer
+    /// stays valid until the next Get() or change to the store.
+    /// @return The line, or nullptr if out of range or its block is unreadable
+    [[nodiscard]] const Row* Get(size_t index) const;
+
+    /// Check if a line is a soft-wrapped continuation of the line before it
+    /// (index + 1), rather than the start of a logical line
+    [[nodiscard]] bool IsContinuation(size_t index) const;
+
+    /// Identity of lines across pushes: line i has id GetEndId() - 1 - i, and
+    /// ids [GetFirstId(), GetEndId()) are held. Trimming raises the first id;
+    /// PopNewest lowers the end id, so the next push reuses it.
+    [[nodiscard]] uint64_t GetFirstId() const noexcept { return m_firstId; }
+    [[nodiscard]] uint64_t GetEndId() const noexcept { return m_endId; }
+
+    /// Number lines from an id on, leaving the ids below it to lines kept
+    /// elsewhere (a log view's file); only while the store is empty
+    void SetFirstId(uint64_t id) noexcept {
+        if (Empty()) {
+            m_firstId = id;
+            m_endId = id;
+        }
+    }
+
+    /// Add a line as the most recent
+    /// The cells up to the trailing fill are copied into the cells of lines
+    /// that left the hot window, so steady-state scrolling does not allocate.
+    /// @param continuation The line continues the previous one (soft wrap)
+    void Push(std::span<const Cell> cells, bool continuation = false);
+
+    /// Share the stored lines from firstId on that sit in sealed blocks in
+    /// memory, up to endId, for reading on another thread
+    /// @param spilled Share spilled blocks too: their bytes are read back
+    ///                from the file as stored (compressed), into copies only
+    ///                the view holds, so the store stays as small as it was
+    /// @return The lines, oldest first; empty if firstId is not in such a
+    ///         block (still in the hot window or staging, or spilled)
+    [[nodiscard]] ScrollbackView ShareLines(uint64_t firstId, uint64_t endId, bool spilled = false) const;
+
+    /// Remove the most recent line, copying it into a screen row
+    /// @param out Row to fill (cells past the line's width are left alone)
+    /// @param continuation Receives the line's soft-wrap flag (optional)
+    /// @return False if the store is empty
+    bool PopNewest(std::span<Cell> out, bool* continuation = nullptr);
+
+    void Clear();
+
+    /// Hold the lines of another store, sharing its sealed blocks in memory
+    /// and its interned lines (see file comment); blocks it spilled are
+    /// left out, so the history starts at its oldest block in memory
+    /// Line ids continue the other store's.
+    void ShareFrom(const ScrollbackStore& source);
+
+    /// Get the line limit (a lowered one may not be trimmed to yet)
+    [[nodiscard]] size_t GetMaxLines() const noexcept { return m_limitLines; }
+    void SetMaxLines(size_t lines);
+
+    /// Set the line limit, leaving lines over a lower one to TrimSlice()
+    /// Until then the store holds its size: each push trims a line.
+    void SetMaxLinesDeferred(size_t lines);
+
+    /// Trim toward a limit SetMaxLinesDeferred() lowered (idle work)
+    /// @param lines Lines to spill or drop at most
+    /// @return true while lines over the limit remain
+    bool TrimSlice(size_t lines);
+
+    [[nodiscard]] ScrollbackStats GetStats() const;
+
+    /// Bytes held in memory (hot rows, staging and in-memory blocks)
+    [[nodiscard]] size_t GetResidentBytes() const noexcept;
+
+    /// Mark the history as in use, so the budget evicts other stores first
+    /// (Get() does this too)
+    void Touch() const noexcept;
+
+    /// Give back all the memory an idle store can: compress the hot rows,
+    /// spill every compressed block and free the decode cache
+    /// Lines stay readable; the next Get() or Push() brings back what it needs.
+    void Hibernate();
+
+    /// Hibernate a slice at a time (idle work): compress hot rows, then
+    /// spill blocks, then free the caches
+    /// @param lines Lines to compress or spill at most
+    /// @return true while work remains
+    bool HibernateSlice(size_t lines);
+
+private:
+    friend class ScrollbackBudget;
+
+    /// Ways of giving memory back to the budget, cheapest first
+    enum class Relief {
+        Compress,   ///< Encode hot rows
+        Spill,      ///< Move compressed blocks to the spill file
+        Drop        ///< Remove the oldest lines
+    };
+
+    /// Encoded lines, oldest first; data is LZ4-compressed once sealed
+    /// A spilled block keeps only its location: the file holds its line
+    /// offsets followed by its data.
+    struct Block {
+        uint64_t id = 0;                   ///< Identifies the decompressed cache
+        std::shared_ptr<ScrollbackBlockData> sealed;    ///< Bytes in memory (none once spilled)
+        std::vector<uint32_t> interned;    ///< Interned lines its lines reference (kept when spilled)
+        uint64_t fileOffset = 0;           ///< Where a spilled block starts
+        uint32_t storedSize = 0;           ///< Bytes of data (in memory or on disk)
+        uint32_t rawSize = 0;
+        uint32_t lines = 0;
+        uint32_t dropped = 0;              ///< Oldest lines trimmed away
+        bool compressed = false;
+        bool spilled = false;
+    };
+
+    /// Encode the oldest hot line into staging, sealing staging when it fills
+    /// The row's storage stays in the hot window for the next push.
+    void DemoteOldestHot();
+
+    /// Make room in the hot window for a push
+    void MakeHotRoom();
+
+    /// Compress the staged lines into a new block at the front
+    void SealStaging();
+
+    /// Move the newest block's lines back into staging
+    void UnsealNewest();
+
+    /// Spill or drop the oldest lines until memory holds m_maxLines
+    void Trim();
+
+    /// Write the oldest block still in memory to the spill file
+    /// @return false if the file could not be created or written
+    bool SpillOldestInMemory();
+
+    /// Remove the oldest line for good
+    void DropOldest();
+
+    /// Drop the interned reference an encoded line holds, if it is one
+    void ReleaseLine(const char* bytes);
+
+    /// Follow an encoded line's interned reference, if it is one
+    /// @return The encoded line itself
+    const char* Resolve(const char* bytes) const;
+
+    /// Encoded bytes of one line of a block (decompressed or read on first use)
+    /// @return nullptr if a spilled block could not be read
+    const char* LineBytes(const Block& block, size_t line) const;
+
+    /// Load a block into the decode cache
+    bool Load(const Block& block) const;
+
+    /// Copy a spilled block's bytes out of the file for a view
+    /// @return The copy, or nullptr if it could not be read
+    [[nodiscard]] std::shared_ptr<const ScrollbackBlockData> ReadSpilled(const Block& block) const;
+
+    /// Block bytes held in memory
+    static size_t BlockBytes(const Block& block) noexcept;
+
+    /// Report memory use to the budget, evicting if that puts it over
+    void Account();
+
+    /// Report memory use to the budget
+    void Charge();
+
+    /// Free up to bytes of memory for the budget
+    void Shed(Relief step, size_t bytes);
+
+    size_t m_maxLines;                     ///< Lines kept (above m_limitLines while trimming)
+    size_t m_limitLines;                   ///< Configured limit
+    size_t m_hotLines;
+    bool m_spillToDisk;
+    bool m_internLines;
+
+    // Hot window (front = most recent), with each line's soft-wrap flag
+    LineSlab m_hot;
+
+    // Encoded lines not yet compressed (oldest first)
+    std::vector<char> m_staging;
+    std::vector<uint32_t> m_stagingOffsets;
+
+    // Compressed blocks (front = most recent); only the back one is ever
+    // partly trimmed, so a cold index maps straight to a block
+    std::deque<Block> m_blocks;
+    size_t m_blockLines = 0;               ///< Live lines across all blocks
+    uint64_t m_nextBlockId = 1;
+
+    // Spilled blocks are the oldest ones, at the back of m_blocks
+    std::unique_ptr<ScrollbackSpillFile> m_spill;
+    size_t m_spilledBlocks = 0;
+    size_t m_spilledLines = 0;
+    bool m_spillFailed = false;            ///< Stop trying; drop lines instead
+
+    // Shared copies of repeated cold lines (with m_internLines)
+    LineInterner m_interner;
+
+    // Storage of the last block dropped that no view held, reused by the
+    // next block sealed
+    std::shared_ptr<ScrollbackBlockData> m_spare;
+
+    // Compression and decode scratch
+    std::vector<char> m_scratch;
+    std::vector<char> m_lineScratch;       ///< A line encoded before interning
+    mutable uint64_t m_cachedBlock = 0;
+    mutable std::vector<char> m_cachedRaw;
+    mutable std::vector<uint32_t> m_cachedOffsets;
+    mutable Row m_decoded;
+
+    // Memory reported to the budget
+    size_t m_blockBytes = 0;               ///< Data and offsets of blocks in memory
+    size_t m_charged = 0;                  ///< Bytes last reported
+    bool m_budgeted = false;               ///< Tracked by the budget
+    mutable uint64_t m_lastUse = 0;        ///< Budget use clock at the last read
+
+    // Line ids (see GetFirstId)
+    uint64_t m_firstId = 0;
+    uint64_t m_endId = 0;
+};
+
+} // namespace Console3::Core
@@ -0,0 +1,138 @@
+// Console3 - ScrollbackTimes.cpp
+// When each line was printed, a few bits per line
+
+#include "Core/ScrollbackTimes.h"
+#include "Core/Varint.h"
+
+#include <algorithm>
+
+namespace Console3::Core {
+
+namespace {
+
+[[nodiscard]] uint64_t ZigZag(uint64_t to, uint64_t from) noexcept {
+    return ZigZagEncode(static_cast<int64_t>(to - from));
+}
+
+[[nodiscard]] uint64_t UnZigZag(uint64_t from, uint64_t value) noexcept {
+    return from + static_cast<uint64_t>(ZigZagDecode(value));
+}
+
+} // namespace
+
+void ScrollbackTimes::Stamp(uint64_t firstLine, uint64_t endLine, uint64_t unixMs) {
+    m_end = std::max(m_end, firstLine);
+    while (m_end < endLine) {
+        if (m_blocks.empty() || m_blocks.back().lines == kBlockLines) {
+            Block& added = m_blocks.emplace_back();
+            added.firstLine = m_end;
+            added.baseMs = unixMs;
+            added.minMs = unixMs;
+            added.maxMs = unixMs;
+            added.closedMs = unixMs;
+            added.openMs = unixMs;
+        }
+
+        // Lines of a new time close the run before
+        Block& block = m_blocks.back();
+        if (block.openLines != 0 && block.openMs != unixMs) {
+            PutVarint(block.runs, ZigZag(block.openMs, block.closedMs));
+            PutVarint(block.runs, block.openLines - 1);
+            block.closedMs = block.openMs;
+            block.openLines = 0;
+        }
+        const auto lines = static_cast<uint32_t>(std::min<uint64_t>(endLine - m_end, kBlockLines - block.lines));
+        block.openMs = unixMs;
+        block.openLines += lines;
+        block.lines += lines;
+        block.minMs = std::min(block.minMs, unixMs);
+        block.maxMs = std::max(block.maxMs, unixMs);
+        m_end += lines;
+    }
+
+    // Blocks wholly trimmed away
+    while (!m_blocks.empty() && m_blocks.front().firstLine + m_blocks.front().lines <= firstLine) {
+        m_blocks.pop_front();
+    }
+}
+
+void ScrollbackTimes::Clear(uint64_t firstLine) {
+    m_blocks.clear();
+    m_end = firstLine;
+    std::vector<uint64_t>().swap(m_scratch);
+}
+
+const ScrollbackTimes::Block* ScrollbackTimes::FindBlock(uint64_t line) const noexcept {
+    const auto it = std::upper_bound(m_blocks.begin(), m_blocks.end(), line,
+                                     [](uint64_t value, const Block& block) { return value < block.firstLine; });
+    if (it == m_blocks.begin()) {
+        return nullptr;
+    }
+    const Block& block = *std::prev(it);
+    return line - block.firstLine < block.lines ? &block : nullptr;
+}
+
+std::optional<uint64_t> ScrollbackTimes::Get(uint64_t line) const {
+    const Block* block = FindBlock(line);
+    if (!block) {
+        return std::nullopt;
+    }
+
+    // Walk the runs to the line's
+    uint64_t index = line - block->firstLine;
+    uint64_t time = block->baseMs;
+    const uint8_t* bytes = block->runs.data();
+    const uint8_t* end = bytes + block->runs.size();
+    while (bytes < end) {
+        time = UnZigZag(time, GetVarint(bytes));
+        const uint64_t lines = GetVarint(bytes) + 1;
+        if (index < lines) {
+            return time;
+        }
+        index -= lines;
+    }
+    return block->openMs;
+}
+
+void ScrollbackTimes::Decode(const Block& block) const {
+    m_scratch.clear();
+    uint64_t time = block.baseMs;
+    const uint8_t* bytes = block.runs.data();
+    const uint8_t* end = bytes + block.runs.size();
+    while (bytes < end) {
+        time = UnZigZag(time, GetVarint(bytes));
+        m_scratch.insert(m_scratch.end(), static_cast<size_t>(GetVarint(bytes) + 1), time);
+    }
+    m_scratch.insert(m_scratch.end(), block.openLines, block.openMs);
+}
+
+bool ScrollbackTimes::FindLines(uint64_t fromMs, uint64_t toMs, uint64_t& first, uint64_t& end) const {
+    if (fromMs > toMs) {
+        return false;
+    }
+
+    // The first line from fromMs on, in the first block reaching it
+    const auto start = std::find_if(m_blocks.begin(), m_blocks.end(),
+                                    [fromMs](const Block& block) { return block.maxMs >= fromMs; });
+    if (start == m_blocks.end()) {
+        return false;
+    }
+    Decode(*start);
+    const auto firstIt = std::find_if(m_scratch.begin(), m_scratch.end(),
+                                      [fromMs](uint64_t time) { return time >= fromMs; });
+    first = start->firstLine + static_cast<uint64_t>(firstIt - m_scratch.begin());
+
+    // The last line up to toMs, in the last block reaching back to it
+    const auto stop = std::find_if(m_blocks.rbegin(), m_blocks.rend(),
+                                   [toMs](const Block& block) { return block.minMs <= toMs; });
+    if (stop == m_blocks.rend()) {
+        return false;
+    }
+    Decode(*stop);
+    const auto lastIt = std::find_if(m_scratch.rbegin(), m_scratch.rend(),
+                                     [toMs](uint64_t time) { return time <= toMs; });
+    end = stop->firstLine + static_cast<uint64_t>(m_scratch.rend() - lastIt);
+    return first < end;
+}
+
+} // namespace Console3::Core
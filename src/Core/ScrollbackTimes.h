@@ -0,0 +1,88 @@
+#pragma once
+// Console3 - ScrollbackTimes.h
+// When each line was printed, a few bits per line
+//
+// Finding out what happened when ("what did the build print at 14:03?")
+// needs the time each line was completed, but a time_point per line would
+// cost as much as a short line's text. Lines are stamped instead as they
+// complete (the cursor moves below them; see TerminalBuffer::StampLines),
+// many at a time: every line completed since the last stamp gets the same
+// time. Stamps are kept per block of up to kBlockLines lines as runs of
+// lines sharing a time, each run one varint of its time's change from the
+// run before (zigzag, so a clock set back costs no more) and one of its
+// length. Output arriving in bursts stamps a screenful in one run, so a
+// busy history averages a few bits a line; an interactive line costs a
+// run of its own, three or four bytes.
+//
+// Each block also keeps its earliest and latest time, so the lines printed
+// between two times are found by reading block headers and decoding the
+// one or two blocks at the edges (FindLines), without touching the
+// scrollback's text.
+//
+// Stamps are kept by absolute line (TerminalBuffer::GetScreenLine), like the
+// overview's summaries; blocks wholly below the oldest line held are dropped
+// as the scrollback is trimmed. Times are milliseconds since the Unix epoch.
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <vector>
+
+namespace Console3::Core {
+
+/// Completion times of one buffer's lines (see file comment)
+class ScrollbackTimes {
+public:
+    static constexpr uint32_t kBlockLines = 256;
+
+    /// Stamp the lines completed since the last stamp
+    /// @param firstLine Oldest line held: nothing below it is stamped, and
+    ///                  blocks wholly below it are dropped
+    /// @param endLine Lines below it are complete
+    /// @param unixMs Their time
+    void Stamp(uint64_t firstLine, uint64_t endLine, uint64_t unixMs);
+
+    /// Forget every stamp; lines from firstLine on are stamped anew
+    void Clear(uint64_t firstLine = 0);
+
+    /// Get the line the next stamp starts at (lines below it are stamped)
+    [[nodiscard]] uint64_t GetEnd() const noexcept { return m_end; }
+
+    /// Get a line's time
+    /// @return The time, or nothing if the line was not stamped or its
+    ///         block was trimmed
+    [[nodiscard]] std::optional<uint64_t> Get(uint64_t line) const;
+
+    /// Find the lines completed from one time to another (both included)
+    /// Times run forward with the lines (a clock set back aside), so the
+    /// lines form one range.
+    /// @param first Receives the first such line
+    /// @param end Receives the line past the last
+    /// @return false if no line was completed then
+    bool FindLines(uint64_t fromMs, uint64_t toMs, uint64_t& first, uint64_t& end) const;
+
+private:
+    struct Block {
+        uint64_t firstLine = 0;
+        uint32_t lines = 0;
+        uint64_t baseMs = 0;            ///< Time of its first run
+        uint64_t minMs = 0;
+        uint64_t maxMs = 0;
+        std::vector<uint8_t> runs;      ///< Closed runs: zigzag time change, length - 1
+        uint64_t closedMs = 0;          ///< Time of the last closed run (baseMs if none)
+        uint64_t openMs = 0;            ///< Time of the open run (the newest lines)
+        uint32_t openLines = 0;         ///< Lines in the open run
+    };
+
+    /// Decode a block's times into m_scratch, oldest line first
+    void Decode(const Block& block) const;
+
+    /// Find the block holding a line
+    [[nodiscard]] const Block* FindBlock(uint64_t line) const noexcept;
+
+    std::deque<Block> m_blocks;         ///< Oldest first
+    uint64_t m_end = 0;
+    mutable std::vector<uint64_t> m_scratch;
+};
+
+} // namespace Console3::Core
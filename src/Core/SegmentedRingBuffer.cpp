@@ -0,0 +1,365 @@
+// Console3 - SegmentedRingBuffer.cpp
+// Growable SPSC byte buffer implementation
+
+#include "Core/SegmentedRingBuffer.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace Console3::Core {
+
+namespace {
+
+/// Chunks needed so that Capacity() covers maxBytes (plus the held-back one)
+size_t ChunkCountFor(size_t maxBytes, size_t chunkSize) {
+    const size_t chunks = (maxBytes + chunkSize - 1) / chunkSize;
+    return std::max<size_t>(chunks, 1) + 1;
+}
+
+} // namespace
+
+// ============================================================================
+// ChunkPool
+// ============================================================================
+
+ChunkPool::ChunkPool(size_t chunkSize, size_t maxCached)
+    : m_chunkSize(chunkSize > 0 ? chunkSize : kDefaultChunkSize)
+    , m_maxCached(maxCached) {
+}
+
+ChunkPool::~ChunkPool() = default;
+
+ChunkPool& ChunkPool::Shared() {
+    static ChunkPool s_pool;
+    return s_pool;
+}
+
+RingChunk* ChunkPool::Acquire() noexcept {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (!m_cached.empty()) {
+            RingChunk* chunk = m_cached.back().release();
+            m_cached.pop_back();
+            return chunk;
+        }
+    }
+
+    // Allocate outside the lock
+    auto chunk = std::unique_ptr<RingChunk>(new (std::nothrow) RingChunk());
+    if (!chunk) {
+        return nullptr;
+    }
+    chunk->data.reset(new (std::nothrow) char[m_chunkSize]);
+    if (!chunk->data) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    ++m_allocated;
+    m_peakAllocated = std::max(m_peakAllocated, m_allocated);
+    return chunk.release();
+}
+
+void ChunkPool::Release(RingChunk* chunk) noexcept {
+    if (!chunk) {
+        return;
+    }
+
+    std::unique_ptr<RingChunk> owned(chunk);
+    owned->written.store(0, std::memory_order_relaxed);
+    owned->next.store(nullptr, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_cached.size() < m_maxCached) {
+        try {
+            m_cached.push_back(std::move(owned));
+            return;
+        } catch (...) {
+            // Fall through and free it
+        }
+    }
+    --m_allocated;
+}
+
+void ChunkPool::Trim() noexcept {
+    std::vector<std::unique_ptr<RingChunk>> freed;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_allocated -= m_cached.size();
+        freed.swap(m_cached);
+    }
+}
+
+ChunkPoolStats ChunkPool::GetStats() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    ChunkPoolStats stats;
+    stats.chunkSize = m_chunkSize;
+    stats.allocated = m_allocated;
+    stats.cached = m_cached.size();
+    stats.peakAllocated = m_peakAllocated;
+    return stats;
+}
+
+// ============================================================================
+// SegmentedRingBuffer
+// ============================================================================
+
+SegmentedRingBuffer::SegmentedRingBuffer(size_t maxBytes, ChunkPool& pool)
+    : m_pool(pool)
+    , m_chunkSize(pool.GetChunkSize())
+    , m_maxChunks(ChunkCountFor(maxBytes, pool.GetChunkSize()))
+    , m_signals(Capacity()) {
+    m_writeChunk = m_pool.Acquire();
+    if (!m_writeChunk) {
+        throw std::bad_alloc();
+    }
+    m_readChunk = m_writeChunk;
+}
+
+SegmentedRingBuffer::~SegmentedRingBuffer() {
+    RingChunk* chunk = m_readChunk;
+    while (chunk) {
+        RingChunk* next = chunk->next.load(std::memory_order_relaxed);
+        m_pool.Release(chunk);
+        chunk = next;
+    }
+}
+
+std::span<char> SegmentedRingBuffer::BeginWrite(size_t maxLength) noexcept {
+    RingChunk* chunk = m_writeChunk;
+    size_t used = m_writeUsed;
+
+    if (used == m_chunkSize) {
+        // Grow by one chunk; the consumer returns drained chunks to the pool
+        if (m_chunksInUse.load(std::memory_order_acquire) >= m_maxChunks) {
+            return {};
+        }
+
+        RingChunk* fresh = m_pool.Acquire();
+        if (!fresh) {
+            return {};
+        }
+
+        const size_t inUse = m_chunksInUse.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (inUse > m_peakChunks.load(std::memory_order_relaxed)) {
+            m_peakChunks.store(inUse, std::memory_order_relaxed);
+        }
+
+        // The full chunk's count is published before it is left behind.
+        // Then the link: the consumer only follows it once this chunk is
+        // fully read, so the producer never touches a recycled chunk
+        Publish();
+        chunk->next.store(fresh, std::memory_order_release);
+        m_writeChunk = fresh;
+        m_writeUsed = 0;
+        chunk = fresh;
+        used = 0;
+    }
+
+    return {chunk->data.get() + used, std::min(maxLength, m_chunkSize - used)};
+}
+
+void SegmentedRingBuffer::CommitWrite(size_t count) noexcept {
+    m_writeUsed += count;
+    m_staged += count;
+    Publish();
+}
+
+size_t SegmentedRingBuffer::Write(const char* data, size_t length) noexcept {
+    const size_t written = Stage(data, length);
+    Publish();
+    return written;
+}
+
+size_t SegmentedRingBuffer::Stage(const char* data, size_t length) noexcept {
+    size_t staged = 0;
+    while (staged < length) {
+        std::span<char> target = BeginWrite(length - staged);
+        if (target.empty()) {
+            break;
+        }
+        std::memcpy(target.data(), data + staged, target.size());
+        m_writeUsed += target.size();
+        m_staged += target.size();
+        staged += target.size();
+    }
+    return staged;
+}
+
+void SegmentedRingBuffer::Publish() noexcept {
+    if (m_staged == 0) {
+        return;
+    }
+
+    // The total first: a consumer that sees the bytes sees them counted, so
+    // the fill level it computes never goes below zero
+    const size_t produced = m_produced.load(std::memory_order_relaxed) + m_staged;
+    m_staged = 0;
+    m_produced.store(produced, std::memory_order_release);
+    m_writeChunk->written.store(m_writeUsed, std::memory_order_release);
+
+    // Track the peak fill level. The copy of consumed overestimates it, so
+    // the real one is loaded only when the copy would make a new peak
+    const size_t highWater = m_highWater.load(std::memory_order_relaxed);
+    if (produced - m_cachedConsumed > highWater) {
+        m_cachedConsumed = m_consumed.load(std::memory_order_acquire);
+        const size_t fill = produced - m_cachedConsumed;
+        if (fill > highWater) {
+            m_highWater.store(fill, std::memory_order_relaxed);
+        }
+    }
+
+    m_signals.OnDataPublished();
+}
+
+RingReadSpans<char> SegmentedRingBuffer::PeekSpans() const noexcept {
+    RingChunk* chunk = m_readChunk;
+    size_t offset = m_readOffset;
+
+    // The current chunk may be drained with its successor not yet linked
+    // when Release() ran
+    if (offset == m_chunkSize) {
+        chunk = chunk->next.load(std::memory_order_acquire);
+        if (!chunk) {
+            return {};
+        }
+        offset = 0;
+    }
+
+    RingReadSpans<char> spans;
+    const size_t written = chunk == m_readChunk ? ReadableEnd() : chunk->written.load(std::memory_order_acquire);
+    spans.first = {chunk->data.get() + offset, written - offset};
+
+    if (written == m_chunkSize) {
+        if (RingChunk* next = chunk->next.load(std::memory_order_acquire)) {
+            spans.second = {next->data.get(), next->written.load(std::memory_order_acquire)};
+        }
+    }
+    return spans;
+}
+
+size_t SegmentedRingBuffer::Release(size_t count) noexcept {
+    size_t released = 0;
+
+    while (released < count) {
+        if (m_readOffset == m_chunkSize) {
+            RingChunk* next = m_readChunk->next.load(std::memory_order_acquire);
+            if (!next) {
+                break;
+            }
+            RecycleReadChunk(next);
+        }
+
+        const size_t available = ReadableEnd() - m_readOffset;
+        if (available == 0) {
+            break;
+        }
+
+        const size_t step = std::min(available, count - released);
+        m_readOffset += step;
+        released += step;
+    }
+
+    // Hand a fully drained chunk back right away so idle sessions stay small
+    if (m_readOffset == m_chunkSize) {
+        if (RingChunk* next = m_readChunk->next.load(std::memory_order_acquire)) {
+            RecycleReadChunk(next);
+        }
+    }
+
+    if (released == 0) {
+        return 0;
+    }
+
+    const size_t consumed = m_consumed.load(std::memory_order_relaxed) + released;
+    m_consumed.store(consumed, std::memory_order_release);
+
+    // The producer's total is loaded only for a held producer, and to
+    // confirm the buffer drained when the copy of the read chunk's count
+    // says everything was read
+    m_signals.OnSpaceFreedWith([this] { return Size(); });
+    if (m_readOffset == m_cachedWritten && m_produced.load(std::memory_order_acquire) == consumed) {
+        m_signals.OnDrained([this] { return Size(); });
+    }
+    return released;
+}
+
+size_t SegmentedRingBuffer::Read(char* data, size_t maxLength) noexcept {
+    size_t read = 0;
+    while (read < maxLength) {
+        RingReadSpans<char> spans = PeekSpans();
+        if (spans.IsEmpty()) {
+            break;
+        }
+
+        size_t step = std::min(spans.first.size(), maxLength - read);
+        std::memcpy(data + read, spans.first.data(), step);
+        if (step == spans.first.size() && !spans.second.empty()) {
+            const size_t extra = std::min(spans.second.size(), maxLength - read - step);
+            std::memcpy(data + read + step, spans.second.data(), extra);
+            step += extra;
+        }
+
+        read += Release(step);
+    }
+    return read;
+}
+
+SegmentedRingStats SegmentedRingBuffer::GetStats() const noexcept {
+    SegmentedRingStats stats;
+    stats.size = Size();
+    stats.highWaterMark = m_highWater.load(std::memory_order_relaxed);
+    stats.chunksInUse = m_chunksInUse.load(std::memory_order_relaxed);
+    stats.peakChunks = m_peakChunks.load(std::memory_order_relaxed);
+    stats.maxChunks = m_maxChunks;
+    stats.bytesWritten = m_produced.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void SegmentedRingBuffer::ResetHighWaterMark() noexcept {
+    m_highWater.store(Size(), std::memory_order_relaxed);
+    m_peakChunks.store(m_chunksInUse.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void SegmentedRingBuffer::Clear() noexcept {
+    // Keep the newest chunk, release everything before it
+    while (m_readChunk != m_writeChunk) {
+        RingChunk* next = m_readChunk->next.load(std::memory_order_relaxed);
+        m_pool.Release(m_readChunk);
+        m_readChunk = next;
+    }
+
+    m_readChunk->written.store(0, std::memory_order_relaxed);
+    m_readChunk->next.store(nullptr, std::memory_order_relaxed);
+    m_writeUsed = 0;
+    m_staged = 0;
+    m_cachedConsumed = 0;
+    m_readOffset = 0;
+    m_cachedWritten = 0;
+    m_produced.store(0, std::memory_order_relaxed);
+    m_consumed.store(0, std::memory_order_relaxed);
+    m_highWater.store(0, std::memory_order_relaxed);
+    m_chunksInUse.store(1, std::memory_order_relaxed);
+    m_peakChunks.store(1, std::memory_order_relaxed);
+    m_signals.Reset();
+}
+
+void SegmentedRingBuffer::RecycleReadChunk(RingChunk* next) noexcept {
+    RingChunk* drained = m_readChunk;
+    m_readChunk = next;
+    m_readOffset = 0;
+    m_cachedWritten = 0;
+
+    m_chunksInUse.fetch_sub(1, std::memory_order_release);
+    m_pool.Release(drained);
+}
+
+size_t SegmentedRingBuffer::ReadableEnd() const noexcept {
+    if (m_cachedWritten == m_readOffset) {
+        m_cachedWritten = m_readChunk->written.load(std::memory_order_acquire);
+    }
+    return m_cachedWritten;
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,277 @@
+#pragma once
+// Console3 - SegmentedRingBuffer.h
+// Growable SPSC byte buffer built from pooled fixed-size chunks
+//
+// A plain RingBuffer reserves its full capacity up front, so every tab pays
+// for a burst buffer it rarely needs. The segmented variant links chunks taken
+// from a shared pool: an idle session holds a single chunk, a busy one grows
+// up to its cap, and consumed chunks go straight back to the pool. Producer
+// and consumer use the same in-place API as RingBuffer (BeginWrite/CommitWrite,
+// PeekSpans/Release) and the same flow control and wakeups (RingSignals).
+//
+// As in RingBuffer, each side keeps a copy of what it reads of the other's
+// state: the producer the consumed total, reloaded only when the fill level
+// it implies would be a new high-water mark; the consumer the read chunk's
+// written count, reloaded only once it has read that far. The producer's
+// own count of the write chunk stays local until it is published. Stage()
+// and Publish() batch several writes into one publish (two stores and one
+// signal check); a batch that fills a chunk is published as the next chunk
+// is linked.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include "Core/RingBuffer.h"
+#include "Core/RingSignals.h"
+
+namespace Console3::Core {
+
+/// Fixed-size block of ring storage
+struct RingChunk {
+    std::unique_ptr<char[]> data;
+    std::atomic<size_t> written{0};         ///< Bytes committed by the producer
+    std::atomic<RingChunk*> next{nullptr};  ///< Following chunk, set by the producer
+};
+
+/// Chunk pool statistics
+struct ChunkPoolStats {
+    size_t chunkSize = 0;       ///< Bytes per chunk
+    size_t allocated = 0;       ///< Chunks currently allocated (in use + cached)
+    size_t cached = 0;          ///< Free chunks kept for reuse
+    size_t peakAllocated = 0;   ///< Highest allocated count seen
+};
+
+/// Thread-safe pool of ring chunks shared by all sessions
+class ChunkPool {
+public:
+    static constexpr size_t kDefaultChunkSize = 16384;
+    static constexpr size_t kDefaultMaxCached = 64;
+
+    /// @param chunkSize Bytes per chunk
+    /// @param maxCached Free chunks kept for reuse; extra chunks are freed
+    explicit ChunkPool(size_t chunkSize = kDefaultChunkSize, size_t maxCached = kDefaultMaxCached);
+    ~ChunkPool();
+
+    // Non-copyable, non-movable
+    ChunkPool(const ChunkPool&) = delete;
+    ChunkPool& operator=(const ChunkPool&) = delete;
+
+    /// Get the process-wide pool used by sessions
+    static ChunkPool& Shared();
+
+    /// Take a chunk from the cache or allocate a new one
+    /// @return Empty chunk, or nullptr on allocation failure
+    [[nodiscard]] RingChunk* Acquire() noexcept;
+
+    /// Return a chunk; it is cached or freed
+    void Release(RingChunk* chunk) noexcept;
+
+    /// Free every cached chunk
+    void Trim() noexcept;
+
+    [[nodiscard]] size_t GetChunkSize() const noexcept { return m_chunkSize; }
+    [[nodiscard]] ChunkPoolStats GetStats() const;
+
+private:
+    const size_t m_chunkSize;
+    const size_t m_maxCached;
+
+    mutable std::mutex m_lock;
+    std::vector<std::unique_ptr<RingChunk>> m_cached;
+    size_t m_allocated = 0;
+    size_t m_peakAllocated = 0;
+};
+
+/// Segmented ring statistics
+struct SegmentedRingStats {
+    size_t size = 0;            ///< Current fill level in bytes
+    size_t highWaterMark = 0;   ///< Peak fill level since creation or ResetHighWaterMark()
+    size_t chunksInUse = 0;     ///< Chunks currently linked into the buffer
+    size_t peakChunks = 0;      ///< Most chunks linked at once
+    size_t maxChunks = 0;       ///< Per-buffer chunk cap
+    uint64_t bytesWritten = 0;  ///< Total bytes committed by the producer
+};
+
+/// SPSC byte buffer that grows and shrinks in pool-sized chunks
+/// Producer: PTY reader fills BeginWrite() spans and publishes them
+/// Consumer: Session parses PeekSpans() and frees them with Release()
+class SegmentedRingBuffer {
+public:
+    static constexpr size_t kDefaultMaxBytes = 1024 * 1024;
+
+    /// Create a buffer holding one chunk
+    /// @param maxBytes Capacity cap; rounded up to whole chunks
+    /// @param pool Pool to take chunks from (must outlive the buffer)
+    /// @throws std::bad_alloc if the first chunk cannot be allocated
+    explicit SegmentedRingBuffer(size_t maxBytes = kDefaultMaxBytes,
+                                 ChunkPool& pool = ChunkPool::Shared());
+    ~SegmentedRingBuffer();
+
+    // Non-copyable, non-movable (atomic members)
+    SegmentedRingBuffer(const SegmentedRingBuffer&) = delete;
+    SegmentedRingBuffer& operator=(const SegmentedRingBuffer&) = delete;
+
+    // ========================================================================
+    // Producer
+    // ========================================================================
+
+    /// Reserve a contiguous writable region, linking a new chunk when the
+    /// current one is full
+    /// @param maxLength Maximum number of bytes wanted
+    /// @return Writable span; empty when the chunk cap is reached or the pool
+    /// is out of memory
+    [[nodiscard]] std::span<char> BeginWrite(size_t maxLength) noexcept;
+
+    /// Publish bytes written into the span returned by BeginWrite() (and
+    /// anything staged before them)
+    void CommitWrite(size_t count) noexcept;
+
+    /// Copy data in
+    /// @return Number of bytes written (may be less if the cap is reached)
+    size_t Write(const char* data, size_t length) noexcept;
+
+    /// Copy data in without making it visible to the consumer yet;
+    /// Publish() releases everything staged at once
+    /// @return Number of bytes staged (may be less if the cap is reached)
+    size_t Stage(const char* data, size_t length) noexcept;
+
+    /// Make staged data visible to the consumer
+    void Publish() noexcept;
+
+    // ========================================================================
+    // Consumer
+    // ========================================================================
+
+    /// Get the readable data in place without copying
+    /// @return Up to two spans in FIFO order; valid until Release() or Read().
+    /// Call again after Release() for data beyond the second span.
+    [[nodiscard]] RingReadSpans<char> PeekSpans() const noexcept;
+
+    /// Free bytes consumed through PeekSpans(); drained chunks return to the pool
+    /// @return Number of bytes actually released
+    size_t Release(size_t count) noexcept;
+
+    /// Copy data out
+    /// @return Number of bytes read
+    size_t Read(char* data, size_t maxLength) noexcept;
+
+    // ========================================================================
+    // Flow Control / Data Notification (see RingSignals)
+    // ========================================================================
+
+    void SetWatermarks(size_t highWatermark, size_t lowWatermark) noexcept {
+        m_signals.SetWatermarks(highWatermark, lowWatermark);
+    }
+    [[nodiscard]] size_t GetHighWatermark() const noexcept { return m_signals.GetHighWatermark(); }
+    [[nodiscard]] size_t GetLowWatermark() const noexcept { return m_signals.GetLowWatermark(); }
+
+    /// Block until the fill level is below the high watermark (producer side)
+    /// @return true when space is available, false if CancelWaits() was called
+    bool WaitForSpace() noexcept {
+        return m_signals.WaitForSpace([this] { return Size(); });
+    }
+
+    /// Set a callback fired (on the consumer thread) once an armed producer
+    /// may continue; see NotifyWhenSpace()
+    void SetSpaceAvailableCallback(std::function<void()> callback) {
+        m_signals.SetSpaceAvailableCallback(std::move(callback));
+    }
+
+    /// Non-blocking alternative to WaitForSpace() (producer side)
+    /// @return true if the space-available callback will fire after the
+    /// consumer drains to the low watermark; false if there is room now
+    bool NotifyWhenSpace() noexcept {
+        return m_signals.ArmSpaceNotify([this] { return Size(); });
+    }
+
+    /// Set a callback fired when data arrives in an empty buffer
+    void SetDataAvailableCallback(std::function<void()> callback) {
+        m_signals.SetDataAvailableCallback(std::move(callback));
+    }
+
+    /// Block until the buffer is non-empty (consumer side)
+    /// @return true when data is available, false if CancelWaits() was called
+    bool WaitForData() noexcept {
+        return m_signals.WaitForData([this] { return Size(); });
+    }
+
+    /// Hold the producer as if the buffer were full, or let it go on (any
+    /// thread; see RingSignals::SetPaused)
+    void SetPaused(bool paused) noexcept { m_signals.SetPaused(paused); }
+    [[nodiscard]] bool IsPaused() const noexcept { return m_signals.IsPaused(); }
+
+    /// Wake any blocked producer or consumer and make further waits fail
+    void CancelWaits() noexcept { m_signals.CancelWaits(); }
+
+    // ========================================================================
+    // State
+    // ========================================================================
+
+    /// Get the number of bytes available to read
+    [[nodiscard]] size_t Size() const noexcept {
+        const size_t produced = m_produced.load(std::memory_order_acquire);
+        const size_t consumed = m_consumed.load(std::memory_order_acquire);
+        return produced - consumed;
+    }
+
+    /// Check if the buffer is empty
+    [[nodiscard]] bool IsEmpty() const noexcept { return Size() == 0; }
+
+    /// Get the fill level that can always be written without blocking
+    /// One chunk is held back because the oldest chunk may be partly consumed.
+    [[nodiscard]] size_t Capacity() const noexcept { return (m_maxChunks - 1) * m_chunkSize; }
+
+    /// Get the bytes of chunk memory currently held
+    [[nodiscard]] size_t GetReservedBytes() const noexcept {
+        return m_chunksInUse.load(std::memory_order_relaxed) * m_chunkSize;
+    }
+
+    /// Get usage statistics
+    [[nodiscard]] SegmentedRingStats GetStats() const noexcept;
+
+    /// Restart high-water-mark tracking from the current fill level
+    void ResetHighWaterMark() noexcept;
+
+    /// Drop all data and return every chunk but one to the pool
+    /// (not thread-safe - use only when no concurrent access)
+    void Clear() noexcept;
+
+private:
+    /// Return the consumer's current chunk to the pool and move to the next
+    void RecycleReadChunk(RingChunk* next) noexcept;
+
+    /// Get how far the read chunk is written, loading it only once the
+    /// consumer has read up to its copy
+    size_t ReadableEnd() const noexcept;
+
+private:
+    ChunkPool& m_pool;
+    const size_t m_chunkSize;
+    const size_t m_maxChunks;
+
+    // Producer state
+    alignas(64) RingChunk* m_writeChunk = nullptr;
+    size_t m_writeUsed = 0;                  ///< Bytes in m_writeChunk, staged ones included
+    size_t m_staged = 0;                     ///< Bytes not yet published
+    size_t m_cachedConsumed = 0;             ///< m_consumed as last loaded
+    std::atomic<size_t> m_produced{0};       ///< Total bytes published
+    std::atomic<size_t> m_highWater{0};      ///< Peak fill level
+    std::atomic<size_t> m_peakChunks{1};
+
+    // Consumer state
+    alignas(64) RingChunk* m_readChunk = nullptr;
+    size_t m_readOffset = 0;                 ///< Read position in m_readChunk
+    mutable size_t m_cachedWritten = 0;      ///< m_readChunk->written as last loaded
+    std::atomic<size_t> m_consumed{0};       ///< Total bytes released
+
+    alignas(64) std::atomic<size_t> m_chunksInUse{1};
+    RingSignals m_signals;                   ///< Watermarks and wakeups
+};
+
+} // namespace Console3::Core
@@ -0,0 +1,168 @@
+// Console3 - SerialPort.cpp
+// Opening a serial (COM) port as a session's byte stream
+
+#include "Core/SerialPort.h"
+
+#include <cstdlib>
+#include <cwctype>
+
+namespace Console3::Core {
+
+namespace {
+
+/// Compare ASCII case-insensitively
+bool EqualsIgnoreCase(std::wstring_view a, std::wstring_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::towlower(a[i]) != std::towlower(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Get the device path for a port name (COM10 and up need the \\.\ form)
+std::wstring GetDevicePath(const std::wstring& port) {
+    if (port.starts_with(L"\\\\")) {
+        return port;
+    }
+    return L"\\\\.\\" + port;
+}
+
+BYTE GetDcbParity(SerialParity parity) {
+    switch (parity) {
+    case SerialParity::Odd: return ODDPARITY;
+    case SerialParity::Even: return EVENPARITY;
+    case SerialParity::Mark: return MARKPARITY;
+    case SerialParity::Space: return SPACEPARITY;
+    case SerialParity::None: break;
+    }
+    return NOPARITY;
+}
+
+} // namespace
+
+bool ParseSerialFormat(std::wstring_view format, SerialSettings& settings) {
+    if (format.size() != 3 || format[0] < L'5' || format[0] > L'8' || (format[2] != L'1' && format[2] != L'2')) {
+        return false;
+    }
+
+    SerialParity parity = SerialParity::None;
+    switch (std::towupper(format[1])) {
+    case L'N': parity = SerialParity::None; break;
+    case L'O': parity = SerialParity::Odd; break;
+    case L'E': parity = SerialParity::Even; break;
+    case L'M': parity = SerialParity::Mark; break;
+    case L'S': parity = SerialParity::Space; break;
+    default: return false;
+    }
+
+    settings.dataBits = static_cast<BYTE>(format[0] - L'0');
+    settings.parity = parity;
+    settings.stopBits = static_cast<BYTE>(format[2] - L'0');
+    return true;
+}
+
+std::optional<SerialFlowControl> ParseSerialFlowControl(std::wstring_view name) {
+    if (EqualsIgnoreCase(name, L"none")) {
+        return SerialFlowControl::None;
+    }
+    if (EqualsIgnoreCase(name, L"rtscts")) {
+        return SerialFlowControl::RtsCts;
+    }
+    if (EqualsIgnoreCase(name, L"xonxoff")) {
+        return SerialFlowControl::XonXoff;
+    }
+    return std::nullopt;
+}
+
+std::optional<SerialSettings> ParseSerialSpec(std::wstring_view spec) {
+    const size_t colon = spec.find(L':');
+    const std::wstring_view port = spec.substr(0, colon);
+    if (port.size() < 4 || !EqualsIgnoreCase(port.substr(0, 3), L"COM")) {
+        return std::nullopt;
+    }
+    for (wchar_t c : port.substr(3)) {
+        if (!std::iswdigit(c)) {
+            return std::nullopt;
+        }
+    }
+
+    SerialSettings settings;
+    settings.port = std::wstring(port);
+    if (colon != std::wstring_view::npos) {
+        const std::wstring baud(spec.substr(colon + 1));
+        wchar_t* end = nullptr;
+        const unsigned long value = std::wcstoul(baud.c_str(), &end, 10);
+        if (baud.empty() || *end != L'\0' || value == 0) {
+            return std::nullopt;
+        }
+        settings.baud = value;
+    }
+    return settings;
+}
+
+wil::unique_hfile OpenSerialPort(const SerialSettings& settings) {
+    wil::unique_hfile port(CreateFileW(GetDevicePath(settings.port).c_str(), GENERIC_READ | GENERIC_WRITE, 0,
+                                       nullptr, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, nullptr));
+    if (!port) {
+        return {};
+    }
+
+    // A request: USB adapters keep queues of their own size
+    (void)SetupComm(port.get(), kSerialInQueueBytes, kSerialOutQueueBytes);
+
+    DCB dcb{};
+    dcb.DCBlength = sizeof(dcb);
+    if (!GetCommState(port.get(), &dcb)) {
+        return {};
+    }
+    dcb.BaudRate = settings.baud;
+    dcb.ByteSize = settings.dataBits;
+    dcb.Parity = GetDcbParity(settings.parity);
+    dcb.fParity = settings.parity != SerialParity::None;
+    dcb.StopBits = settings.stopBits == 2 ? TWOSTOPBITS : ONESTOPBIT;
+    dcb.fBinary = TRUE;
+    dcb.fNull = FALSE;
+    dcb.fErrorChar = FALSE;
+    dcb.fAbortOnError = FALSE;
+    dcb.fOutxDsrFlow = FALSE;
+    dcb.fDsrSensitivity = FALSE;
+    dcb.fDtrControl = DTR_CONTROL_ENABLE;
+
+    const bool hardware = settings.flowControl == SerialFlowControl::RtsCts;
+    const bool software = settings.flowControl == SerialFlowControl::XonXoff;
+    dcb.fOutxCtsFlow = hardware;
+    dcb.fRtsControl = hardware ? RTS_CONTROL_HANDSHAKE : RTS_CONTROL_ENABLE;
+    dcb.fOutX = software;
+    dcb.fInX = software;
+    dcb.fTXContinueOnXoff = TRUE;
+    dcb.XonChar = 0x11;
+    dcb.XoffChar = 0x13;
+    dcb.XonLim = kSerialFlowLimitBytes;
+    dcb.XoffLim = kSerialFlowLimitBytes;
+    if (!SetCommState(port.get(), &dcb)) {
+        return {};
+    }
+
+    // Return at once with what is queued, else on the first byte, else
+    // empty after kSerialReadWaitMs; writes wait as long as flow control
+    // holds them (the writer cancels them)
+    COMMTIMEOUTS timeouts{};
+    timeouts.ReadIntervalTimeout = MAXDWORD;
+    timeouts.ReadTotalTimeoutMultiplier = MAXDWORD;
+    timeouts.ReadTotalTimeoutConstant = kSerialReadWaitMs;
+    if (!SetCommTimeouts(port.get(), &timeouts)) {
+        return {};
+    }
+
+    // Start clean: nothing left over from whoever had the port last
+    (void)PurgeComm(port.get(), PURGE_RXABORT | PURGE_RXCLEAR | PURGE_TXABORT | PURGE_TXCLEAR);
+    DWORD errors = 0;
+    (void)ClearCommError(port.get(), &errors, nullptr);
+    return port;
+}
+
+} // namespace Console3::Core
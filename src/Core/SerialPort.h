@@ -0,0 +1,83 @@
+#pragma once
+// Console3 - SerialPort.h
+// Opening a serial (COM) port as a session's byte stream
+//
+// A serial session has no shell and no pseudo console: the port's bytes go
+// to the emulator as they come, and keystrokes go back out on the line. The
+// port is opened once, for overlapped I/O, and shared by the Serial
+// transport's read and the input writer's writes (a synchronous handle
+// would hold every write behind the pending read).
+//
+// Nothing may be lost at high rates (921600 baud is ~90 KB/s), so:
+//
+//   Timeouts  - a read returns the moment any bytes are queued, or empty
+//               after kSerialReadWaitMs of silence; there is no interval
+//               timer to wait out, so latency is the driver's alone.
+//   Queues    - the driver is asked for a kSerialInQueueBytes receive
+//               queue, seconds of output at that rate, which covers the
+//               reader being held up while the window drains the ring.
+//   Flow      - with RTS/CTS (or XON/XOFF) the driver holds off the device
+//               once kSerialFlowLimitBytes are left free in that queue, so
+//               a consumer that stays behind stalls the device, not the
+//               data. Without flow control an overlong stall overruns the
+//               queue; that is the line's setting, not ours.
+//   Framing   - binary: no NUL stripping, no error characters, and line
+//               errors don't abort reads.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <wil/resource.h>
+
+namespace Console3::Core {
+
+constexpr DWORD kSerialInQueueBytes = 1024 * 1024;     ///< Driver receive queue asked for
+constexpr DWORD kSerialOutQueueBytes = 64 * 1024;      ///< Driver transmit queue asked for
+constexpr WORD kSerialFlowLimitBytes = 16 * 1024;      ///< Free (XOFF) and used (XON) thresholds
+constexpr DWORD kSerialReadWaitMs = 1000;              ///< Longest a read waits for a byte
+
+/// Parity bit
+enum class SerialParity { None, Odd, Even, Mark, Space };
+
+/// Flow control
+enum class SerialFlowControl {
+    None,       ///< None; the device sends at will
+    RtsCts,     ///< Hardware handshake
+    XonXoff     ///< In-band XON/XOFF characters
+};
+
+/// How a serial port is set up
+struct SerialSettings {
+    std::wstring port;                  ///< COM1, COM12, ... (empty = not a serial session)
+    DWORD baud = 115200;
+    BYTE dataBits = 8;                  ///< 5 to 8
+    SerialParity parity = SerialParity::None;
+    BYTE stopBits = 1;                  ///< 1 or 2
+    SerialFlowControl flowControl = SerialFlowControl::None;
+};
+
+/// Parse a frame format such as "8N1" (data bits, N/O/E/M/S, stop bits)
+/// @return false if it doesn't parse; settings are unchanged then
+[[nodiscard]] bool ParseSerialFormat(std::wstring_view format, SerialSettings& settings);
+
+/// Parse a flow control name: "none", "rtscts" or "xonxoff"
+[[nodiscard]] std::optional<SerialFlowControl> ParseSerialFlowControl(std::wstring_view name);
+
+/// Parse a port given on the command line: "COM3" or "COM3:921600"
+/// @return Settings with the defaults for the rest, or nullopt
+[[nodiscard]] std::optional<SerialSettings> ParseSerialSpec(std::wstring_view spec);
+
+/// Open a port for overlapped I/O and configure it (see file comment)
+/// @return The port, or an empty handle with GetLastError() set
+[[nodiscard]] wil::unique_hfile OpenSerialPort(const SerialSettings& settings);
+
+} // namespace Console3::Core
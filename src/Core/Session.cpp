@@ -2,152 +2,1398 @@
 // Terminal session implementation
 
 #include "Core/Session.h"
+#include "Core/AllocTracker.h"
+#include "Core/BandPool.h"
+#include "Core/HostClient.h"
+#include "Core/IdleScheduler.h"
+#include "Core/ImageDecoder.h"
+#include "Core/LogFile.h"
+#include "Core/PerfClock.h"
+#include "Core/ScrollbackBudget.h"
+#include "Core/SessionSnapshot.h"
+#include "Core/ThreadPolicy.h"
+#include "Core/Utf.h"
+#include "Emulation/VTermSegmentParser.h"
+#include <ShlObj.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <span>
+#include <utility>
 
 namespace Console3::Core {
 
+namespace {
+
+// Fast-forward rate is measured over windows of this length
+constexpr ULONGLONG kRateWindowMs = 250;
+
+// Scrollback lines converted for an open search per UpdateSearch()
+constexpr size_t kSearchLinesPerUpdate = 8192;
+
+// Scrollback lines handed to a running export per UpdateExport()
+constexpr size_t kExportLinesPerUpdate = 4096;
+
+// A parse with a time budget feeds the emulator this much between checks
+constexpr size_t kBudgetCheckBytes = 16 * 1024;
+
+// Output held for a slow output extension is handed over by a pass this
+// soon after the last one, if no output comes first
+constexpr DWORD kTapRetryMs = 10;
+
+// Longest an application may hold the screen with synchronized output
+// (DEC mode 2026) before what it has drawn is shown anyway
+constexpr uint64_t kSyncOutputTimeoutMicros = 200'000;
+
+// A damage rect of this many cells or more is synced in row bands across
+// the band pool (a full repaint of a 4K display's grid); smaller ones cost
+// less than waking the pool
+constexpr int64_t kParallelSyncCells = 16 * 1024;
+
+// Fewest rows a band gets
+constexpr int kMinSyncBandRows = 16;
+
+// An unthrottled replay of a recording this long is parsed in parallel up
+// to its last checkpoint first (PrefillReplay)
+constexpr size_t kParallelReplayBytes = 2 * Emulation::kCheckpointInterval;
+
+// Checkpoint files kept (the most recently written)
+constexpr size_t kMaxCheckpointFiles = 16;
+
+/// Get the file a recording's checkpoints are kept in: named for its path,
+/// size and last write time, so a changed recording gets a new one
+std::filesystem::path CheckpointPath(const std::wstring& recordingPath) {
+    WIN32_FILE_ATTRIBUTE_DATA attributes{};
+    wchar_t* localAppData = nullptr;
+    if (!GetFileAttributesExW(recordingPath.c_str(), GetFileExInfoStandard, &attributes) ||
+        FAILED(SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, nullptr, &localAppData))) {
+        return {};
+    }
+    std::filesystem::path directory = localAppData;
+    CoTaskMemFree(localAppData);
+
+    uint64_t hash = 0xCBF29CE484222325ull;
+    auto add = [&hash](const void* data, size_t size) {
+        for (size_t index = 0; index < size; ++index) {
+            hash = (hash ^ static_cast<const uint8_t*>(data)[index]) * 0x100000001B3ull;
+        }
+    };
+    std::error_code error;
+    const std::wstring full = std::filesystem::absolute(recordingPath, error).wstring();
+    add(full.data(), full.size() * sizeof(wchar_t));
+    add(&attributes.nFileSizeLow, sizeof(attributes.nFileSizeLow));
+    add(&attributes.nFileSizeHigh, sizeof(attributes.nFileSizeHigh));
+    add(&attributes.ftLastWriteTime, sizeof(attributes.ftLastWriteTime));
+    wchar_t name[32];
+    swprintf_s(name, L"%016llx.c3ck", static_cast<unsigned long long>(hash));
+    return directory / L"Console3" / L"checkpoints" / name;
+}
+
+/// Write a recording's checkpoints, keeping the newest kMaxCheckpointFiles
+void SaveCheckpoints(const std::filesystem::path& path, const Emulation::VTermCheckpoints& checkpoints) {
+    std::string content;
+    checkpoints.Serialize(content);
+    std::filesystem::path temp = path;
+    temp += L".tmp";
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        file.write(content.data(), static_cast<std::streamsize>(content.size()));
+        if (!file) {
+            return;
+        }
+    }
+    if (!MoveFileExW(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        return;
+    }
+
+    std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> files;
+    for (const auto& item : std::filesystem::directory_iterator(path.parent_path(), error)) {
+        if (item.path().extension() == L".c3ck") {
+            files.emplace_back(item.last_write_time(error), item.path());
+        }
+    }
+    if (files.size() > kMaxCheckpointFiles) {
+        std::sort(files.begin(), files.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+        for (size_t index = kMaxCheckpointFiles; index < files.size(); ++index) {
+            std::filesystem::remove(files[index].second, error);
+        }
+    }
+}
+
+} // namespace
+
 Session::Session() = default;
 
-Session::~Session() {
-    Stop();
+Session::~Session() {
+    Stop();
+}
+
+bool Session::Start(const SessionConfig& config) {
+    if (m_state == SessionState::Running) {
+        return false;
+    }
+    if (!config.hostPipe.empty()) {
+        return StartAttached(config);
+    }
+
+    // A replay is laid out at the size it was recorded at
+    SessionConfig sessionConfig = config;
+    std::shared_ptr<const PtyRecording> recording;
+    if (!config.replayPath.empty()) {
+        auto loaded = PtyRecording::Load(config.replayPath);
+        if (!loaded) {
+            return false;
+        }
+        if (loaded->rows > 0 && loaded->cols > 0) {
+            sessionConfig.rows = loaded->rows;
+            sessionConfig.cols = loaded->cols;
+        }
+        recording = std::make_shared<const PtyRecording>(std::move(*loaded));
+    }
+
+    // A log view plays the lines that fit the screen at once; the rest of
+    // the file is scrollback, read from the mapping as it is shown
+    m_log.reset();
+    if (!config.logPath.empty()) {
+        std::shared_ptr<LogFile> log = LogFile::Open(config.logPath, config.rows);
+        if (!log) {
+            return false;
+        }
+        PtyRecording tail;
+        tail.cols = config.cols;
+        tail.rows = config.rows;
+        tail.Append(0, log->GetTail());
+        recording = std::make_shared<const PtyRecording>(std::move(tail));
+        sessionConfig.replaySpeed = 0.0;
+        m_log = std::move(log);
+    }
+
+    if (!CreateComponents(sessionConfig)) {
+        return false;
+    }
+
+    // Start recording before any output can arrive. Resizes during the
+    // session are not recorded; the header has the initial size only.
+    m_recorder.reset();
+    if (!config.recordPath.empty()) {
+        auto recorder = std::make_shared<PtyRecorder>();
+        PtyRecorderConfig recorderConfig;
+        recorderConfig.path = config.recordPath;
+        recorderConfig.format = config.recordFormat;
+        recorderConfig.cols = sessionConfig.cols;
+        recorderConfig.rows = sessionConfig.rows;
+        recorderConfig.compress = config.recordCompress;
+        recorderConfig.overflow = config.recordOverflow;
+        recorderConfig.rotateBytes = config.recordRotateBytes;
+        recorderConfig.rotateSeconds = config.recordRotateSeconds;
+        if (!recorder->Start(recorderConfig)) {
+            return false;
+        }
+        m_recorder = std::move(recorder);
+    }
+
+    if (recording) {
+        // Not while recording: the new file must get every byte
+        if (sessionConfig.replaySpeed <= 0.0 && !m_log && !m_recorder &&
+            recording->data.size() >= kParallelReplayBytes) {
+            recording = PrefillReplay(sessionConfig, std::move(recording));
+        }
+        return StartReplay(sessionConfig, std::move(recording));
+    }
+
+    // Create PTY session
+    m_pty = std::make_unique<PtySession>();
+
+    // Every transport delivers into the ring and honours its watermarks
+    m_pty->SetOutputBuffer(m_outputBuffer.get());
+
+    // Set up PTY callbacks
+    m_pty->SetExitCallback([this](DWORD exitCode) {
+        OnPtyExit(exitCode);
+    });
+
+    // Configure and start PTY
+    PtyConfig ptyConfig = GetPtyConfig(config);
+    ptyConfig.recorder = m_recorder;
+    ptyConfig.latencyProbe = &m_inputLatency;
+
+    if (!m_pty->Start(ptyConfig)) {
+        if (m_recorder) {
+            m_recorder->Stop();
+            m_recorder.reset();
+        }
+        return false;
+    }
+    m_pty->SetTraceSessionId(m_traceId);
+    m_pty->SetProcessPriority(m_priority);
+    m_pty->SetReaderQos(ThreadPolicy::ForSession(m_priority));
+    m_replyPty.store(m_pty.get(), std::memory_order_release);
+
+    m_state = SessionState::Running;
+    return true;
+}
+
+bool Session::Start(const SessionConfig& config, WarmShell warm) {
+    if (!warm || !config.replayPath.empty() || !config.logPath.empty() || !config.recordPath.empty() ||
+        !config.hostPipe.empty() || !config.serial.port.empty()) {
+        return Start(config);
+    }
+    if (m_state == SessionState::Running || !CreateComponents(config, std::move(warm.output))) {
+        return false;
+    }
+
+    m_recorder.reset();
+    m_replay.reset();
+    m_pty = std::move(warm.pty);
+    m_pty->SetLatencyProbe(&m_inputLatency);
+    m_pty->SetTraceSessionId(m_traceId);
+    m_pty->SetProcessPriority(m_priority);
+    m_pty->SetReaderQos(ThreadPolicy::ForSession(m_priority));
+    m_replyPty.store(m_pty.get(), std::memory_order_release);
+
+    // The shell started at the size of the view it was warmed for
+    (void)m_pty->Resize(config.cols, config.rows);
+
+    // Running first: a shell that already exited reports it straight away
+    m_state = SessionState::Running;
+    warm.hooks->SetExitCallback([this](DWORD exitCode) {
+        OnPtyExit(exitCode);
+    });
+    warm.hooks->SetDataCallback([this]() {
+        OnOutputAvailable();
+    });
+    return true;
+}
+
+PtyConfig Session::GetPtyConfig(const SessionConfig& config) {
+    PtyConfig ptyConfig;
+    ptyConfig.shell = config.shell;
+    ptyConfig.args = config.args;
+    ptyConfig.workingDir = config.workingDir;
+    ptyConfig.cols = config.cols;
+    ptyConfig.rows = config.rows;
+    ptyConfig.transport = config.useCompletionPort ? PtyTransportEngine::CompletionPort
+                                                   : PtyTransportEngine::Thread;
+    ptyConfig.maxReadSize = config.maxReadSize;
+    ptyConfig.sideBySideConpty = config.sideBySideConpty;
+    ptyConfig.wslRelay = config.wslRelay;
+    ptyConfig.serial = config.serial;
+    return ptyConfig;
+}
+
+std::shared_ptr<const PtyRecording> Session::PrefillReplay(const SessionConfig& config,
+                                                          std::shared_ptr<const PtyRecording> recording) {
+    // The first pass is skipped for a recording seen before
+    const std::filesystem::path cachePath = CheckpointPath(config.replayPath);
+    std::optional<Emulation::VTermCheckpoints> checkpoints;
+    if (!cachePath.empty()) {
+        std::ifstream file(cachePath, std::ios::binary);
+        const std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        checkpoints = Emulation::VTermCheckpoints::Deserialize(content);
+    }
+    if (!checkpoints || checkpoints->rows != config.rows || checkpoints->size != recording->data.size()) {
+        checkpoints = Emulation::FindCheckpoints(recording->data, config.rows);
+        if (!cachePath.empty()) {
+            SaveCheckpoints(cachePath, *checkpoints);
+        }
+    }
+
+    const size_t keep = config.scrollbackToDisk ? std::numeric_limits<size_t>::max() : config.scrollbackLines;
+    Emulation::SegmentPrefill prefill = Emulation::VTermSegmentParser::Prefill(
+        recording->data, *checkpoints, config.cols, keep, m_presented ? *m_presented : *m_buffer);
+    if (prefill.offset == 0) {
+        return recording;
+    }
+    PtyRecording tail;
+    tail.cols = recording->cols;
+    tail.rows = recording->rows;
+    std::string bytes = std::move(prefill.restore);
+    bytes.append(recording->data, static_cast<size_t>(prefill.offset));
+    tail.Append(0, bytes);
+    return std::make_shared<const PtyRecording>(std::move(tail));
+}
+
+bool Session::StartReplay(const SessionConfig& config, std::shared_ptr<const PtyRecording> recording) {
+    m_pty.reset();
+    m_replay = PtyTransport::Create(PtyTransportEngine::Replay);
+
+    PtyTransportConfig transportConfig;
+    transportConfig.output = m_outputBuffer.get();
+    transportConfig.recorder = m_recorder;
+    transportConfig.replayRecording = std::move(recording);
+    transportConfig.replaySpeed = config.replaySpeed;
+    transportConfig.onClosed = [this](DWORD errorCode) {
+        // The end of the recording plays the part of the process exiting
+        if (errorCode == ERROR_BROKEN_PIPE) {
+            OnPtyExit(0);
+        }
+    };
+
+    m_replay->SetTraceSessionId(m_traceId);
+    if (!m_replay->Start(transportConfig)) {
+        m_replay.reset();
+        if (m_recorder) {
+            m_recorder->Stop();
+            m_recorder.reset();
+        }
+        return false;
+    }
+
+    m_state = SessionState::Running;
+    return true;
+}
+
+bool Session::StartAttached(const SessionConfig& config) {
+    auto host = std::make_unique<HostClient>();
+    if (!host->Connect(config.hostPipe) || !CreateComponents(config)) {
+        return false;
+    }
+
+    // The host's frames arrive as output; the emulator's replies to them
+    // have nowhere to go (the host's emulator answered already)
+    m_pty.reset();
+    m_replay.reset();
+    m_recorder.reset();
+
+    // Running first: a host that is already gone reports it straight away
+    m_state = SessionState::Running;
+    if (!host->Start(m_outputBuffer.get(), config.rows, config.cols, [this](DWORD exitCode) {
+            OnPtyExit(exitCode);
+        })) {
+        m_state = SessionState::Idle;
+        return false;
+    }
+    m_host = std::move(host);
+    return true;
+}
+
+bool Session::StartDetached(const SessionConfig& config) {
+    if (m_state == SessionState::Running || !CreateComponents(config)) {
+        return false;
+    }
+
+    m_pty.reset();
+    m_replay.reset();
+    m_recorder.reset();
+    m_state = SessionState::Running;
+    return true;
+}
+
+bool Session::CreateComponents(const SessionConfig& config,
+                               std::unique_ptr<SegmentedRingBuffer> adoptedOutput) {
+    // An earlier run's worker must not see the components being replaced
+    StopEmulationThread();
+    m_replyPty.store(nullptr, std::memory_order_release);
+    m_parsedBytes = 0;
+    m_mouseMode.store(0, std::memory_order_relaxed);
+    m_applicationCursor.store(false, std::memory_order_relaxed);
+    m_applicationKeypad.store(false, std::memory_order_relaxed);
+    m_syncOutput = false;
+    m_heldBurstStart = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mouseLock);
+        m_mouseQueue.clear();
+    }
+    m_emulationThread = config.emulationThread;
+    m_sharedEmulation = config.emulationThread && config.sharedEmulation;
+    m_priority = config.priority;
+
+    m_rows = config.rows;
+    m_cols = config.cols;
+    m_title = config.title;
+    m_profileName = config.profileName;
+
+    m_fastForwardBytesPerSec.store(config.fastForwardBytesPerSec, std::memory_order_relaxed);
+    m_fastForwardFrameMs = config.fastForwardFrameMs;
+    m_fastForward = false;
+    m_screenStale = false;
+    m_deferScreen = config.priority == SessionPriority::Background;
+    m_rateWindowStart = GetTickCount64();
+    m_lastActivity.store(m_rateWindowStart);
+    m_hibernated.store(false);
+    m_rateWindowBytes = 0;
+
+    // Create terminal buffer
+    TerminalBufferConfig bufConfig;
+    bufConfig.rows = config.rows;
+    bufConfig.cols = config.cols;
+    bufConfig.scrollbackLines = config.scrollbackLines;
+    bufConfig.scrollbackToDisk = config.scrollbackToDisk;
+    bufConfig.scrollbackInternLines = config.scrollbackInternLines;
+    bufConfig.scrollbackHotLines = config.scrollbackHotLines;
+    bufConfig.lineTimes = config.scrollbackTimestamps;
+
+    try {
+        m_buffer = std::make_unique<TerminalBuffer>(bufConfig);
+        if (m_emulationThread) {
+            // The worker's buffer only holds the screen; scrollback lines
+            // are forwarded to the presented buffer
+            TerminalBufferConfig screenConfig = bufConfig;
+            screenConfig.scrollbackLines = 0;
+            screenConfig.lineTimes = false;
+            m_presented = std::move(m_buffer);
+            m_buffer = std::make_unique<TerminalBuffer>(screenConfig);
+        } else {
+            m_presented.reset();
+        }
+
+        // An earlier run's output goes in before anything counts lines
+        if (config.restoreHistory) {
+            (void)config.restoreHistory->RestoreInto(m_presented ? *m_presented : *m_buffer);
+        }
+        if (m_log) {
+            (m_presented ? *m_presented : *m_buffer).AttachLog(m_log);
+        }
+        if (config.shareHistory) {
+            (m_presented ? *m_presented : *m_buffer).ShareScrollback(*config.shareHistory);
+        }
+        (m_presented ? *m_presented : *m_buffer).GetImageStore()->SetBudget(config.imageMemoryBytes);
+    } catch (...) {
+        return false;
+    }
+
+    // Create output buffer - starts at one pooled chunk and grows up to the
+    // configured cap only while output outpaces parsing
+    const bool adopted = adoptedOutput != nullptr;
+    try {
+        m_outputBuffer = adopted ? std::move(adoptedOutput)
+                                 : std::make_unique<SegmentedRingBuffer>(config.outputBufferSize);
+    } catch (...) {
+        return false;
+    }
+    m_outputBuffer->SetWatermarks(
+        config.outputHighWatermark,
+        config.outputLowWatermark > 0 ? config.outputLowWatermark
+                                      : m_outputBuffer->Capacity() / 2);
+
+    // Wake the UI thread once per burst rather than once per read
+    if (!m_outputEvent && !m_outputEvent.try_create(wil::EventOptions::None, nullptr)) {
+        return false;
+    }
+    if (!adopted) {
+        m_outputBuffer->SetDataAvailableCallback([this]() {
+            OnOutputAvailable();
+        });
+    }
+    m_burstStartMicros.store(0);
+    m_parseMicros.store(0);
+    m_parseCalls.store(0);
+    {
+        std::lock_guard<std::mutex> lock(m_parseTimesLock);
+        m_parseTimes.Reset();
+    }
+    m_lastLatencyMicros.store(0);
+    m_maxLatencyMicros.store(0);
+
+    // Create VTerm wrapper
+    try {
+        // The Grid backend draws on the buffer the parsing thread owns
+        m_vterm = std::make_unique<Emulation::VTermWrapper>(
+            config.rows, config.cols, config.vtermAllocator,
+            config.emulationBackend == Emulation::EmulationBackend::Grid ? m_buffer.get() : nullptr,
+            config.vtermBuffers);
+    } catch (...) {
+        return false;
+    }
+
+    // Scroll merging turns a burst of line feeds into one move rect,
+    // reported together with the screen's damage when ProcessOutput flushes
+    m_vterm->SetDamageMerge(config.damageMerge);
+    m_vterm->SetFrontParser(config.frontParser);
+
+    // Replies to the host (DA, DSR, ...) join the PTY writer's queue, one
+    // write per parsed chunk. Parsing may be on the worker, which can start
+    // before the PTY does; replies before that have nowhere to go. Those
+    // the PTY's query responder gave already, as the query arrived, are
+    // not sent twice.
+    m_vterm->SetOutputCallback([this, kept = std::string()](const char* data, size_t length) mutable {
+        PtySession* pty = m_replyPty.load(std::memory_order_acquire);
+        if (!pty) {
+            return;
+        }
+        if (pty->GetQueryResponder() && QueryResponder::FilterReplies(std::string_view(data, length), kept)) {
+            if (!kept.empty()) {
+                (void)pty->Write(kept);
+            }
+            return;
+        }
+        (void)pty->Write(data, length);
+    });
+
+    // Per-change events straight to the handlers below; the rest through
+    // callbacks
+    m_vterm->SetEventSink(*this);
+
+    m_vterm->SetTermPropCallback([this](const Emulation::TermProps& props) {
+        OnVTermPropChange(props);
+    });
+
+    m_vterm->SetHyperlinkCallback([this](uint64_t line, int startCol, int endCol, std::string_view uri) {
+        m_hyperlinks.Add(line, startCol, endCol, uri);
+    });
+
+    m_outputRules.SetRules(config.outputRules);
+    m_rulesLine = 0;
+
+    m_vterm->SetShellMarkCallback([this](Emulation::ShellMark kind, int row, int col, int exitCode) {
+        OnVTermShellMark(kind, row, col, exitCode);
+    });
+    m_vterm->SetImageCallback([this](Emulation::InlineImage&& image) {
+        OnVTermImage(std::move(image));
+    });
+
+    return !m_emulationThread || StartEmulationThread();
+}
+
+void Session::OnOutputAvailable() {
+    // Start of a burst: latency is measured from here to the buffer update
+    uint64_t idle = 0;
+    m_burstStartMicros.compare_exchange_strong(idle, PerfClock::NowMicros(),
+                                               std::memory_order_relaxed);
+    m_inputLatency.Mark(LatencyPoint::Echoed);
+    m_lastActivity.store(GetTickCount64(), std::memory_order_relaxed);
+    m_hibernated.store(false, std::memory_order_relaxed);
+    IdleScheduler::Shared().NoteActivity();
+    SetEvent(m_outputEvent.get());
+    if (m_task) {
+        SessionScheduler::Instance().Wake(m_task);
+    }
+}
+
+bool Session::StartEmulationThread() {
+    if (!m_workerWake && !m_workerWake.try_create(wil::EventOptions::None, nullptr)) {
+        return false;
+    }
+    if (!m_frameEvent && !m_frameEvent.try_create(wil::EventOptions::None, nullptr)) {
+        return false;
+    }
+
+    m_snapshots.Reset(m_presented->GetMaxScrollback());
+    m_resizeRequest.store(0);
+    m_damageMergeRequest.store(-1);
+    m_workerScrollback.clear();
+    m_workerTitle = m_title;
+    m_workerTitleChanged = false;
+    m_publishedFastForward = false;
+    m_presentedFastForward = false;
+    m_workerLinesPushed = m_presented->GetScreenLine();
+    m_workerMarks.clear();
+    m_workerImages.clear();
+    m_priorityRequest.store(-1);
+
+    if (m_sharedEmulation) {
+        m_task = SessionScheduler::Instance().Register(
+            [this](uint64_t budgetMicros) { return RunEmulationSlice(budgetMicros); }, m_priority);
+        if (!m_task) {
+            return false;
+        }
+        SessionScheduler::Instance().Wake(m_task);
+        return true;
+    }
+
+    m_workerStop.store(false);
+    m_worker = std::thread(&Session::EmulationThreadProc, this);
+    (void)ThreadPolicy::SetQos(m_worker.native_handle(), ThreadPolicy::ForSession(m_priority));
+    return true;
+}
+
+void Session::StopEmulationThread() {
+    if (m_task) {
+        SessionScheduler::Instance().Unregister(m_task);
+        m_task = nullptr;
+        return;
+    }
+    if (!m_worker.joinable()) {
+        return;
+    }
+
+    m_workerStop.store(true);
+    SetEvent(m_workerWake.get());
+    m_worker.join();
+}
+
+void Session::EmulationThreadProc() {
+    const HANDLE handles[] = {m_workerWake.get(), m_outputEvent.get()};
+
+    while (!m_workerStop.load()) {
+        ApplyWorkerRequests();
+
+        // Parse for a budget, then publish one snapshot for it; what is left
+        // goes on at once, so a flood still shows frames as it goes
+        const uint64_t burstStart = ParseOutput(m_pacer.GetBudget());
+        if (IsScreenDeferred()) {
+            TrackOutputRate(0);
+            PresentFastForwardFrame(false);
+            ScanWaits();
+        }
+        PublishFrame(burstStart);
+        if (!m_outputBuffer->PeekSpans().IsEmpty()) {
+            continue;
+        }
+
+        // While fast-forwarding, wake up for the next frame even if the
+        // flood stopped, so the final screen is shown; a synchronized
+        // update that never ends is shown at its timeout
+        DWORD timeout = m_fastForward ? m_fastForwardFrameMs : INFINITE;
+        if (const uint64_t hold = GetSyncHoldMicros()) {
+            timeout = std::min<DWORD>(timeout, static_cast<DWORD>(hold / 1000 + 1));
+        }
+        if (m_taps.HasQueued()) {
+            timeout = std::min(timeout, kTapRetryMs);
+        }
+        WaitForMultipleObjects(2, handles, FALSE, timeout);
+    }
+}
+
+SliceResult Session::RunEmulationSlice(uint64_t budgetMicros) {
+    ApplyWorkerRequests();
+
+    // Output beyond the budget waits for the next slice, after other sessions'
+    const uint64_t burstStart = ParseOutput(std::min(budgetMicros, m_pacer.GetBudget()));
+    if (IsScreenDeferred()) {
+        TrackOutputRate(0);
+        PresentFastForwardFrame(false);
+        ScanWaits();
+    }
+    PublishFrame(burstStart);
+
+    SliceResult result;
+    result.more = !m_outputBuffer->PeekSpans().IsEmpty();
+    if (m_fastForward) {
+        result.timerMs = m_fastForwardFrameMs;
+    }
+    if (const uint64_t hold = GetSyncHoldMicros()) {
+        result.timerMs = std::min<uint32_t>(result.timerMs, static_cast<uint32_t>(hold / 1000 + 1));
+    }
+    if (m_taps.HasQueued()) {
+        result.timerMs = std::min<uint32_t>(result.timerMs, kTapRetryMs);
+    }
+    return result;
+}
+
+void Session::WakeWorker() {
+    if (m_task) {
+        SessionScheduler::Instance().Wake(m_task);
+    } else {
+        SetEvent(m_workerWake.get());
+    }
+}
+
+void Session::ApplyWorkerRequests() {
+    const int merge = m_damageMergeRequest.exchange(-1);
+    if (merge >= 0) {
+        m_vterm->SetDamageMerge(static_cast<Emulation::DamageMerge>(merge));
+    }
+
+    const int priority = m_priorityRequest.exchange(-1);
+    if (priority >= 0) {
+        SetBackground(static_cast<SessionPriority>(priority) == SessionPriority::Background);
+    }
+
+    if (m_hibernateRequest.exchange(false)) {
+        m_snapshots.ReleaseSpare();
+        if (m_workerScrollback.empty()) {
+            std::vector<ScrollbackLine>().swap(m_workerScrollback);
+        }
+        m_buffer->Hibernate();
+    }
+
+    // Only the latest size matters
+    const uint64_t resize = m_resizeRequest.exchange(0);
+    if (resize != 0) {
+        const int rows = static_cast<int>(resize >> 32);
+        const int cols = static_cast<int>(resize & 0xFFFFFFFF);
+        // The Grid backend's resize re-wraps the buffer itself
+        m_vterm->Resize(rows, cols);
+        if (m_vterm->GetBackend() == Emulation::EmulationBackend::Screen) {
+            m_buffer->Resize(rows, cols, false);
+        }
+        m_buffer->MarkAllDirty();
+    }
+}
+
+void Session::PublishFrame(uint64_t burstStart) {
+    // Synchronized output: the frame goes out whole once the application
+    // ends it (or at the timeout); latency counts from the first burst in it
+    if (m_heldBurstStart == 0) {
+        m_heldBurstStart = burstStart;
+    }
+    if (GetSyncHoldMicros() != 0) {
+        return;
+    }
+    burstStart = std::exchange(m_heldBurstStart, 0);
+
+    const bool modeChanged = m_fastForward != m_publishedFastForward;
+    if (!m_buffer->HasDirty() && m_buffer->GetPendingScroll().lines == 0 &&
+        m_workerScrollback.empty() && !m_workerTitleChanged && !modeChanged) {
+        return;
+    }
+
+    // Shares the rows instead of copying them and clears the dirty state
+    m_snapshots.Publish(*m_buffer, m_workerScrollback, m_workerTitle, m_fastForward, burstStart);
+    m_publishedFastForward = m_fastForward;
+    m_workerTitleChanged = false;
+
+    SetEvent(m_frameEvent.get());
+}
+
+void Session::Stop() {
+    if (m_pty) {
+        m_pty->Stop();
+    }
+    if (m_host) {
+        m_host->Stop();
+        m_host.reset();
+    }
+    if (m_replay) {
+        m_replay->Stop();
+        m_replay.reset();
+    }
+    StopEmulationThread();
+    m_waits.CancelAll();
+    m_taps.Clear();
+
+    // After the producer: everything it delivered is written out
+    if (m_recorder) {
+        m_recorder->Stop();
+        m_recorder.reset();
+    }
+    m_state = SessionState::Idle;
+}
+
+int Session::Write(const char* data, size_t length) {
+    if ((!m_pty && !m_host) || m_state != SessionState::Running) {
+        return -1;
+    }
+    m_lastActivity.store(GetTickCount64(), std::memory_order_relaxed);
+    m_hibernated.store(false, std::memory_order_relaxed);
+    m_pacer.NoteInput();
+    if (m_host) {
+        return m_host->Write(std::string_view(data, length)) ? static_cast<int>(length) : -1;
+    }
+    return m_pty->Write(data, length);
+}
+
+bool Session::Paste(std::string_view text, bool bracketed) {
+    if (m_host && m_state == SessionState::Running) {
+        return m_host->Paste(text, bracketed);
+    }
+    if (!m_pty || m_state != SessionState::Running) {
+        return false;
+    }
+    return m_pty->Paste(text, bracketed);
+}
+
+bool Session::Paste(std::wstring text, bool bracketed) {
+    if (m_host && m_state == SessionState::Running) {
+        return m_host->Paste(ToUtf8(text), bracketed);
+    }
+    if (!m_pty || m_state != SessionState::Running) {
+        return false;
+    }
+    return m_pty->Paste(std::move(text), bracketed);
+}
+
+void Session::CancelPaste() {
+    if (m_pty) {
+        m_pty->CancelPaste();
+    }
+}
+
+void Session::SetOutputPaused(bool paused) {
+    if (m_outputBuffer && !m_host) {
+        m_outputBuffer->SetPaused(paused);
+    }
+}
+
+uint64_t Session::GetSyncHoldMicros() const {
+    if (!m_syncOutput) {
+        return 0;
+    }
+    const uint64_t elapsed = PerfClock::NowMicros() - m_syncStartMicros;
+    return elapsed < kSyncOutputTimeoutMicros ? kSyncOutputTimeoutMicros - elapsed : 0;
+}
+
+DWORD Session::GetPresentHoldMs() const {
+    if (m_emulationThread) {
+        return 0;
+    }
+    const uint64_t hold = GetSyncHoldMicros();
+    return hold ? static_cast<DWORD>(hold / 1000 + 1) : 0;
+}
+
+void Session::QueueMouseInput(const Emulation::MouseEvent& event) {
+    if (m_state != SessionState::Running || m_mouseMode.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    if (m_host) {
+        (void)m_host->SendMouse(event);     // The host's emulator encodes it
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mouseLock);
+        if (event.button == 0 && !m_mouseQueue.empty() && m_mouseQueue.back().button == 0) {
+            m_mouseQueue.back() = event;
+        } else {
+            m_mouseQueue.push_back(event);
+        }
+    }
+
+    // The parse side applies it; ProcessOutput() parses on this thread
+    if (m_emulationThread) {
+        WakeWorker();
+    } else {
+        SetEvent(m_outputEvent.get());
+    }
+}
+
+void Session::ApplyMouseInput() {
+    {
+        std::lock_guard<std::mutex> lock(m_mouseLock);
+        if (m_mouseQueue.empty()) {
+            return;
+        }
+        m_mouseApplied.swap(m_mouseQueue);
+    }
+    m_vterm->MouseInput(m_mouseApplied);
+    m_mouseApplied.clear();
+}
+
+bool Session::Resize(int cols, int rows) {
+    if (m_state != SessionState::Running) {
+        return false;
+    }
+
+    // ConPTY repaints the whole screen on every resize, even to the same size
+    if (cols == m_cols && rows == m_rows) {
+        return true;
+    }
+
+    // Resize PTY (detached sessions have none)
+    if (m_pty && !m_pty->Resize(cols, rows)) {
+        return false;
+    }
+    if (m_host) {
+        (void)m_host->Resize(cols, rows);
+    }
+
+    if (m_emulationThread) {
+        // The worker resizes the emulator and resends the whole screen;
+        // snapshots taken at the old size are ignored until then
+        m_presented->Resize(rows, cols, false);
+        m_resizeRequest.store((static_cast<uint64_t>(rows) << 32) | static_cast<uint32_t>(cols));
+        WakeWorker();
+    } else {
+        // Resize VTerm
+        if (m_vterm) {
+            m_vterm->Resize(rows, cols);
+        }
+
+        // Resize buffer (libvterm has pushed whatever no longer fits); the
+        // Grid backend's resize did that already
+        if (m_buffer && (!m_vterm || m_vterm->GetBackend() == Emulation::EmulationBackend::Screen)) {
+            m_buffer->Resize(rows, cols, false);
+        }
+    }
+
+    m_cols = cols;
+    m_rows = rows;
+
+    return true;
+}
+
+void Session::SetExitCallback(SessionExitCallback callback) {
+    m_exitCallback = std::move(callback);
+}
+
+void Session::SetTitleChangeCallback(TitleChangeCallback callback) {
+    m_titleCallback = std::move(callback);
+}
+
+void Session::SetFastForwardCallback(FastForwardCallback callback) {
+    m_fastForwardCallback = std::move(callback);
+}
+
+void Session::SetDamageMerge(Emulation::DamageMerge merge) {
+    if (m_emulationThread && (m_worker.joinable() || m_task)) {
+        m_damageMergeRequest.store(static_cast<int>(merge));
+        WakeWorker();
+    } else if (m_vterm) {
+        m_vterm->SetDamageMerge(merge);
+    }
+}
+
+void Session::SetPriority(SessionPriority priority) {
+    if (priority == m_priority) {
+        return;
+    }
+    m_priority = priority;
+    if (priority != SessionPriority::Background) {
+        // Being looked at counts as use: the idle time starts over when hidden
+        m_lastActivity.store(GetTickCount64(), std::memory_order_relaxed);
+        m_hibernated.store(false, std::memory_order_relaxed);
+    }
+    if (m_task) {
+        SessionScheduler::Instance().SetPriority(m_task, priority);
+    }
+    if (m_pty) {
+        // The shell's processes follow the tab (see ProcessJob.h), and so
+        // do the threads reading and parsing for it (ThreadPolicy.h)
+        m_pty->SetProcessPriority(priority);
+        m_pty->SetReaderQos(ThreadPolicy::ForSession(priority));
+    }
+    if (m_worker.joinable()) {
+        (void)ThreadPolicy::SetQos(m_worker.native_handle(), ThreadPolicy::ForSession(priority));
+    }
+    if (m_emulationThread && (m_worker.joinable() || m_task)) {
+        m_priorityRequest.store(static_cast<int>(priority));
+        WakeWorker();
+    } else if (!m_emulationThread) {
+        SetBackground(priority == SessionPriority::Background);
+    }
+}
+
+void Session::Reconfigure(const SessionConfig& config) {
+    // The store takes its own lock and drops images to fit a lower budget
+    if (TerminalBuffer* buffer = GetBuffer()) {
+        buffer->GetImageStore()->SetBudget(config.imageMemoryBytes);
+    }
+    m_fastForwardBytesPerSec.store(config.fastForwardBytesPerSec, std::memory_order_relaxed);
+}
+
+void Session::Hibernate() {
+    TerminalBuffer* buffer = GetBuffer();
+    if (!buffer || m_hibernated.load()) {
+        return;
+    }
+
+    buffer->Hibernate();
+    m_search.ReleaseShadow();
+    if (m_emulationThread && (m_worker.joinable() || m_task)) {
+        m_hibernateRequest.store(true);
+        WakeWorker();
+    }
+
+    // The ring keeps the chunk it is on; chunks cached for bursts go back
+    ChunkPool::Shared().Trim();
+    m_hibernated.store(true);
+}
+
+bool Session::HibernateSlice(size_t lines) {
+    TerminalBuffer* buffer = GetBuffer();
+    if (!buffer || m_hibernated.load()) {
+        return false;
+    }
+    if (buffer->HibernateSlice(lines)) {
+        return true;
+    }
+    Hibernate();
+    return false;
+}
+
+void Session::SetBackground(bool background) {
+    if (background == m_deferScreen) {
+        return;
+    }
+
+    // Hidden, the emulator keeps its state and scrollback is still pushed,
+    // but no cell reaches the buffer; becoming visible syncs the whole grid
+    // once
+    m_deferScreen = background;
+    if (!IsScreenDeferred()) {
+        PresentFastForwardFrame(true);
+    }
+}
+
+void Session::ProcessOutput() {
+    if (!m_emulationThread) {
+        RecordLatency(ParseOutput(m_pacer.GetBudget()));
+        StampLines();
+        UpdateSearch();
+
+        // The rest is for the next wakeup, after the frame and the input
+        // queued meanwhile
+        if (m_outputBuffer && m_outputEvent && !m_outputBuffer->PeekSpans().IsEmpty()) {
+            SetEvent(m_outputEvent.get());
+        }
+        return;
+    }
+
+    if (!m_presented) {
+        return;
+    }
+
+    // Adopt the latest snapshot's rows; the worker is never blocked
+    const std::shared_ptr<const TerminalSnapshot> snapshot = m_snapshots.Present(*m_presented);
+    if (!snapshot) {
+        return;
+    }
+
+    // Marks are by absolute line, so ones ahead of the lines presented
+    // still land on theirs
+    {
+        std::lock_guard<std::mutex> lock(m_markLock);
+        for (const PromptMark& mark : m_workerMarks) {
+            m_presented->AddPromptMark(mark);
+        }
+        m_workerMarks.clear();
+        for (const ImagePlacement& placement : m_workerImages) {
+            m_presented->AddImage(placement);
+        }
+        m_workerImages.clear();
+    }
+
+    if (snapshot->title != m_title && !snapshot->title.empty()) {
+        m_title = snapshot->title;
+        if (m_titleCallback) {
+            m_titleCallback(m_title);
+        }
+    }
+
+    if (snapshot->fastForward != m_presentedFastForward) {
+        m_presentedFastForward = snapshot->fastForward;
+        if (m_fastForwardCallback) {
+            m_fastForwardCallback(m_presentedFastForward);
+        }
+    }
+
+    const uint64_t burstStart = snapshot->burstStartMicros;
+    RecordLatency(burstStart);
+    StampLines();
+    UpdateSearch();
 }
 
-bool Session::Start(const SessionConfig& config) {
-    if (m_state == SessionState::Running) {
-        return false;
+std::shared_ptr<OutputWait> Session::WaitForOutput(const SearchQuery& query) {
+    std::shared_ptr<OutputWait> wait = m_waits.Add(query);
+    if (!wait) {
+        return nullptr;
     }
 
-    m_rows = config.rows;
-    m_cols = config.cols;
-    m_title = config.title;
+    // The parse side matches it against the screen as it is now
+    if (m_emulationThread) {
+        WakeWorker();
+    } else if (m_outputEvent) {
+        SetEvent(m_outputEvent.get());
+    }
+    return wait;
+}
 
-    // Create terminal buffer
-    TerminalBufferConfig bufConfig;
-    bufConfig.rows = config.rows;
-    bufConfig.cols = config.cols;
-    bufConfig.scrollbackLines = config.scrollbackLines;
+bool Session::UpdateSearch() {
+    const TerminalBuffer* buffer = GetBuffer();
+    return buffer && m_search.Update(*buffer, kSearchLinesPerUpdate);
+}
 
-    try {
-        m_buffer = std::make_unique<TerminalBuffer>(bufConfig);
-    } catch (...) {
+bool Session::UpdateExport() {
+    const TerminalBuffer* buffer = GetBuffer();
+    if (!buffer) {
+        m_export.Cancel();
         return false;
     }
+    return m_export.Update(*buffer, kExportLinesPerUpdate);
+}
 
-    // Create output ring buffer
-    m_outputBuffer = std::make_unique<ByteRingBuffer>(65536);
+uint64_t Session::ParseOutput(uint64_t budgetMicros) {
+    if (!m_outputBuffer || !m_vterm) {
+        return 0;
+    }
 
-    // Create VTerm wrapper
-    try {
-        m_vterm = std::make_unique<Emulation::VTermWrapper>(config.rows, config.cols);
-    } catch (...) {
-        return false;
+    AllocScope allocScope(AllocSubsystem::Emulation);
+    PipelineActivity batch(PipelineStage::ProcessOutput, m_traceId);
+    m_traceRows = 0;
+    ApplyMouseInput();
+    m_taps.BeginPass();
+
+    const uint64_t parseStart = PerfClock::NowMicros();
+    size_t parsed = 0;
+
+    // Parse ring buffer contents in place and feed to VTerm. Releasing
+    // space wakes a throttled transport once the low watermark is reached.
+    for (auto spans = m_outputBuffer->PeekSpans(); !spans.IsEmpty();
+         spans = m_outputBuffer->PeekSpans()) {
+        if (budgetMicros != 0) {
+            // A program waiting on a cursor position report waits for the
+            // parse to reach it; the slice runs over until it has
+            if (parsed != 0 && PerfClock::NowMicros() - parseStart >= budgetMicros &&
+                m_parsedBytes >= GetCursorQueryEnd()) {
+                break;
+            }
+            // Small enough pieces that the budget is checked often
+            if (spans.first.size() >= kBudgetCheckBytes) {
+                spans.first = spans.first.first(kBudgetCheckBytes);
+                spans.second = {};
+            } else if (spans.Size() > kBudgetCheckBytes) {
+                spans.second = spans.second.first(kBudgetCheckBytes - spans.first.size());
+            }
+        }
+        TrackOutputRate(spans.Size());
+        parsed += spans.Size();
+        if (m_taps.IsActive()) {
+            m_taps.OnBytes(spans.first);
+            m_taps.OnBytes(spans.second);
+        }
+        {
+            PipelineActivity parse(PipelineStage::Parse, m_traceId);
+            parse.SetBytes(spans.Size());
+            m_vterm->InputWrite(spans.first.data(), spans.first.size());
+            if (!spans.second.empty()) {
+                m_vterm->InputWrite(spans.second.data(), spans.second.size());
+            }
+        }
+        m_outputBuffer->Release(spans.Size());
+        m_parsedBytes += spans.Size();
     }
 
-    // Set up VTerm callbacks
-    m_vterm->SetDamageCallback([this](int sr, int er, int sc, int ec) {
-        OnVTermDamage(sr, er, sc, ec);
-    });
+    // Flush damage to trigger callbacks
+    m_vterm->FlushDamage();
 
-    m_vterm->SetTermPropCallback([this](const Emulation::TermProps& props) {
-        OnVTermPropChange(props);
-    });
+    // While fast-forwarding the buffer only catches up once per frame
+    if (IsScreenDeferred()) {
+        PresentFastForwardFrame(false);
+    }
+    // Before the early return: a wait just added matches what is there
+    ScanWaits();
 
-    // Create PTY session
-    m_pty = std::make_unique<PtySession>();
+    // The UI thread comes back for what a slow extension was not handed
+    // (a worker does on a timer)
+    if (!m_emulationThread && m_taps.HasQueued() && m_outputEvent) {
+        SetEvent(m_outputEvent.get());
+    }
 
-    // Set up PTY callbacks
-    m_pty->SetOutputCallback([this](const char* data, size_t len) {
-        OnPtyOutput(data, len);
-    });
+    m_pacer.EndPass(parsed != 0);
+    batch.SetBytes(parsed);
+    batch.SetRows(m_traceRows);
 
-    m_pty->SetExitCallback([this](DWORD exitCode) {
-        OnPtyExit(exitCode);
-    });
+    if (parsed == 0) {
+        return 0;
+    }
+    ScanCompletedRows();
 
-    // Configure and start PTY
-    PtyConfig ptyConfig;
-    ptyConfig.shell = config.shell;
-    ptyConfig.args = config.args;
-    ptyConfig.workingDir = config.workingDir;
-    ptyConfig.cols = config.cols;
-    ptyConfig.rows = config.rows;
+    const uint64_t parseTime = PerfClock::NowMicros() - parseStart;
+    m_parseMicros.fetch_add(parseTime, std::memory_order_relaxed);
+    m_parseCalls.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(m_parseTimesLock);
+        m_parseTimes.Add(parseTime);
+    }
 
-    if (!m_pty->Start(ptyConfig)) {
-        return false;
+    return m_burstStartMicros.exchange(0, std::memory_order_relaxed);
+}
+
+uint64_t Session::GetCursorQueryEnd() const {
+    const PtySession* pty = m_replyPty.load(std::memory_order_acquire);
+    const QueryResponder* responder = pty ? pty->GetQueryResponder() : nullptr;
+    return responder ? responder->GetCursorQueryEnd() : 0;
+}
+
+void Session::StampLines() {
+    TerminalBuffer* buffer = GetBuffer();
+    if (!buffer || !m_vterm || !m_buffer || m_buffer->IsAlternateScreen()) {
+        return;
     }
 
-    m_state = SessionState::Running;
-    return true;
+    // Lines above the cursor are complete. The worker's cursor may be on a
+    // screen scrolled further than the one presented, so this stamps fewer
+    // lines than are done, never more; the rest get the next stamp.
+    int cursorRow = 0;
+    int cursorCol = 0;
+    m_vterm->GetCursorPos(cursorRow, cursorCol);
+    const uint64_t end = buffer->GetScreenLine() + static_cast<uint64_t>(std::clamp(cursorRow, 0, buffer->GetRows()));
+    const auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch());
+    buffer->StampLines(end, static_cast<uint64_t>(now.count()));
 }
 
-void Session::Stop() {
-    if (m_pty) {
-        m_pty->Stop();
+void Session::RecordLatency(uint64_t burstStart) {
+    if (burstStart == 0) {
+        return;
     }
-    m_state = SessionState::Idle;
+
+    const uint64_t now = PerfClock::NowMicros();
+    if (now >= burstStart) {
+        m_lastLatencyMicros.store(now - burstStart, std::memory_order_relaxed);
+        AtomicFetchMax(m_maxLatencyMicros, now - burstStart);
+    }
+    m_inputLatency.Mark(LatencyPoint::Parsed);
 }
 
-int Session::Write(const char* data, size_t length) {
-    if (!m_pty || m_state != SessionState::Running) {
-        return -1;
+size_t Session::FeedOutput(const char* data, size_t length) {
+    if (!m_outputBuffer || !m_vterm) {
+        return 0;
     }
-    return m_pty->Write(data, length);
+
+    // Larger inputs pass through the ring in pieces, like a flood of reads
+    size_t done = 0;
+    while (done < length) {
+        const size_t written = m_outputBuffer->Write(data + done, length - done);
+        done += written;
+        ProcessOutput();
+        while (!m_emulationThread && !m_outputBuffer->PeekSpans().IsEmpty()) {
+            ProcessOutput();    // A pass stops at its budget
+        }
+        if (written == 0) {
+            if (!m_worker.joinable() && !m_task) {
+                break;  // No chunk available even with the ring drained
+            }
+            Sleep(1);   // Let the emulation thread drain the ring
+        }
+    }
+    return done;
 }
 
-bool Session::Resize(int cols, int rows) {
-    if (!m_pty || m_state != SessionState::Running) {
-        return false;
+SessionStats Session::GetStats() const noexcept {
+    SessionStats stats;
+
+    if (m_pty || m_replay) {
+        const PtyTransportStats transport = m_pty ? m_pty->GetTransportStats() : m_replay->GetStats();
+        stats.bytesIn = transport.bytesRead;
+        stats.readCount = transport.readCount;
+        stats.meanReadSize = transport.readCount > 0 ? transport.bytesRead / transport.readCount : 0;
+        stats.maxReadSize = transport.maxReadSize;
+        stats.readSize = transport.readSize;
+        stats.stallMicros = transport.stallMicros;
+        stats.bytesOut = m_pty ? m_pty->GetBytesWritten() : 0;
+        stats.console = m_pty ? m_pty->GetConsoleKind() : PseudoConsoleKind::None;
+        const QueryResponder* responder = m_pty ? m_pty->GetQueryResponder() : nullptr;
+        stats.earlyReplies = responder ? responder->GetAnswered() : 0;
+    }
+    if (m_pty) {
+        stats.shell = m_pty->GetJobAccounting();
     }
 
-    // Resize PTY
-    if (!m_pty->Resize(cols, rows)) {
-        return false;
+    if (m_outputBuffer) {
+        const SegmentedRingStats ring = m_outputBuffer->GetStats();
+        stats.bufferedBytes = ring.size;
+        stats.bufferHighWater = ring.highWaterMark;
+        stats.bufferReservedBytes = m_outputBuffer->GetReservedBytes();
     }
 
-    // Resize VTerm
-    if (m_vterm) {
-        m_vterm->Resize(rows, cols);
+    stats.parseMicros = m_parseMicros.load(std::memory_order_relaxed);
+    stats.parseCalls = m_parseCalls.load(std::memory_order_relaxed);
+    stats.lastLatencyMicros = m_lastLatencyMicros.load(std::memory_order_relaxed);
+    stats.maxLatencyMicros = m_maxLatencyMicros.load(std::memory_order_relaxed);
+    stats.fastForward = IsFastForwarding();
+
+    if (const TerminalBuffer* buffer = GetBuffer()) {
+        const ScrollbackStats scrollback = buffer->GetScrollbackStats();
+        stats.scrollbackLines = scrollback.hotLines + scrollback.coldLines;
+        stats.scrollbackBytes = scrollback.hotBytes + scrollback.coldBytes;
+        stats.scrollbackSpilled = scrollback.spilledBytes;
     }
+    const ScrollbackBudget& budget = ScrollbackBudget::Shared();
+    stats.budgetUsage = budget.GetUsage();
+    stats.budgetLimit = budget.GetLimit();
 
-    // Resize buffer
-    if (m_buffer) {
-        m_buffer->Resize(rows, cols);
+    if (m_vterm) {
+        const Emulation::VTermAllocStats vterm = m_vterm->GetAllocStats();
+        stats.vtermAllocations = vterm.allocations;
+        stats.vtermBytes = vterm.liveBytes;
+        stats.vtermPeakBytes = vterm.peakBytes;
     }
+    return stats;
+}
 
-    m_cols = cols;
-    m_rows = rows;
+LatencyHistogram Session::GetParseTimes() const {
+    std::lock_guard<std::mutex> lock(m_parseTimesLock);
+    return m_parseTimes;
+}
 
-    return true;
+SessionMemory Session::GetMemory() const noexcept {
+    SessionMemory memory;
+
+    if (const TerminalBuffer* buffer = GetBuffer()) {
+        const ScrollbackStats scrollback = buffer->GetScrollbackStats();
+        memory.screenBytes = buffer->GetScreenBytes();
+        memory.scrollbackHotBytes = scrollback.hotBytes;
+        memory.scrollbackColdBytes = scrollback.coldBytes;
+        memory.scrollbackDiskBytes = scrollback.spilledBytes;
+        memory.imageBytes = buffer->GetImageStore()->GetBytes();
+    }
+    if (m_outputBuffer) {
+        memory.ringBytes = m_outputBuffer->GetReservedBytes();
+    }
+    if (m_vterm) {
+        memory.vtermBytes = m_vterm->GetAllocStats().liveBytes;
+    }
+    return memory;
 }
 
-void Session::SetExitCallback(SessionExitCallback callback) {
-    m_exitCallback = std::move(callback);
+void Session::UpdateFastForward() {
+    if (m_emulationThread || !m_fastForward) {
+        return;
+    }
+
+    TrackOutputRate(0);
+    PresentFastForwardFrame(false);
+    ScanWaits();
 }
 
-void Session::SetTitleChangeCallback(TitleChangeCallback callback) {
-    m_titleCallback = std::move(callback);
+void Session::TrackOutputRate(size_t bytes) {
+    const size_t threshold = m_fastForwardBytesPerSec.load(std::memory_order_relaxed);
+    if (threshold == 0) {
+        return;
+    }
+
+    // Close the current window first, so a burst after an idle period is
+    // measured on its own
+    const ULONGLONG now = GetTickCount64();
+    const ULONGLONG elapsed = now - m_rateWindowStart;
+    if (elapsed >= kRateWindowMs) {
+        const uint64_t rate = static_cast<uint64_t>(m_rateWindowBytes) * 1000 / elapsed;
+        m_rateWindowStart = now;
+        m_rateWindowBytes = 0;
+
+        // Leave with hysteresis so a flood hovering at the threshold does
+        // not toggle the mode
+        if (m_fastForward && rate < threshold / 2) {
+            SetFastForward(false);
+        }
+    }
+
+    // Enter as soon as one window's worth of the threshold has arrived
+    m_rateWindowBytes += bytes;
+    if (!m_fastForward && m_rateWindowBytes >= threshold * kRateWindowMs / 1000) {
+        SetFastForward(true);
+    }
 }
 
-void Session::ProcessOutput() {
-    if (!m_outputBuffer || !m_vterm) {
+void Session::SetFastForward(bool active) {
+    if (m_fastForward == active) {
         return;
     }
 
-    // Read data from ring buffer and feed to VTerm
-    char buf[4096];
-    size_t read;
-    while ((read = m_outputBuffer->Read(buf, sizeof(buf))) > 0) {
-        m_vterm->InputWrite(buf, read);
+    m_fastForward = active;
+    if (active) {
+        m_lastFrameTick = GetTickCount64();
+    } else if (!m_deferScreen) {
+        // Present the final state of the flood
+        PresentFastForwardFrame(true);
     }
 
-    // Flush damage to trigger callbacks
-    m_vterm->FlushDamage();
+    // An emulation thread reports the change with its next frame
+    if (m_fastForwardCallback && !m_emulationThread) {
+        m_fastForwardCallback(active);
+    }
 }
 
-void Session::OnPtyOutput(const char* data, size_t length) {
-    // Write to ring buffer (called from IO thread)
-    if (m_outputBuffer) {
-        m_outputBuffer->Write(data, length);
+void Session::PresentFastForwardFrame(bool force) {
+    // A background session's screen waits until it is visible
+    if (!m_screenStale || !m_buffer || (m_deferScreen && !force)) {
+        return;
+    }
+
+    const ULONGLONG now = GetTickCount64();
+    if (!force && now - m_lastFrameTick < m_fastForwardFrameMs) {
+        return;
     }
+
+    SyncRegion(0, m_buffer->GetRows(), 0, m_buffer->GetCols());
+    m_screenStale = false;
+    m_lastFrameTick = now;
 }
 
 void Session::OnPtyExit(DWORD exitCode) {
@@ -160,44 +1406,151 @@ void Session::OnPtyExit(DWORD exitCode) {
 }
 
 void Session::OnVTermDamage(int startRow, int endRow, int startCol, int endCol) {
+    // Intermediate screen states of a flood, or of a background session,
+    // are never materialized
+    if (IsScreenDeferred()) {
+        m_screenStale = true;
+        return;
+    }
+
+    SyncRegion(startRow, endRow, startCol, endCol);
+}
+
+bool Session::OnVTermMoveRect(const Emulation::TermRect& dest, const Emulation::TermRect& src) {
+    if (!m_buffer) return false;
+
+    // The next fast-forward frame resyncs the whole screen anyway
+    if (IsScreenDeferred()) {
+        m_screenStale = true;
+        return true;
+    }
+
+    // Only full-width vertical moves are row shifts; moves within a line
+    // (character insert/delete) fall back to damage
+    const int cols = m_buffer->GetCols();
+    const int lines = src.startRow - dest.startRow;
+    if (lines == 0 || dest.startCol != 0 || src.startCol != 0 || dest.endCol < cols ||
+        src.endCol < cols || dest.endRow - dest.startRow != src.endRow - src.startRow) {
+        return false;
+    }
+
+    // Shift the rows; libvterm damages the exposed lines right after
+    AllocScope allocScope(AllocSubsystem::Buffer);
+    m_buffer->MoveRows(lines, std::min(dest.startRow, src.startRow), std::max(dest.endRow, src.endRow));
+    return true;
+}
+
+void Session::SyncRegion(int startRow, int endRow, int startCol, int endCol) {
     // Update terminal buffer from VTerm screen
     if (!m_buffer || !m_vterm) return;
 
-    for (int row = startRow; row < endRow; ++row) {
-        for (int col = startCol; col < endCol; ++col) {
-            auto vtCell = m_vterm->GetCell(row, col);
-            auto& bufCell = m_buffer->GetCell(row, col);
-
-            // Copy character
-            bufCell.charCode = vtCell.chars.empty() ? U' ' : vtCell.chars[0];
-            
-            // Copy combining characters
-            for (size_t i = 0; i < 3 && i + 1 < vtCell.chars.size(); ++i) {
-                bufCell.combining[i] = vtCell.chars[i + 1];
-            }
+    AllocScope allocScope(AllocSubsystem::Buffer);
+    startCol = std::max(startCol, 0);
+    startRow = std::max(startRow, 0);
+    endRow = std::min(endRow, m_buffer->GetRows());
 
-            // Copy colors
-            bufCell.fg = CellColor::Rgb(vtCell.fg.r, vtCell.fg.g, vtCell.fg.b);
-            if (vtCell.fg.isDefault) bufCell.fg = CellColor::Default();
-            
-            bufCell.bg = CellColor::Rgb(vtCell.bg.r, vtCell.bg.g, vtCell.bg.b);
-            if (vtCell.bg.isDefault) bufCell.bg = CellColor::Default();
+    PipelineActivity activity(PipelineStage::DamageSync, m_traceId);
+    if (startRow < endRow) {
+        const int cols = std::max(std::min(endCol, m_buffer->GetCols()) - startCol, 0);
+        m_traceRows += static_cast<uint32_t>(endRow - startRow);
+        activity.SetRows(static_cast<uint32_t>(endRow - startRow));
+        activity.SetBytes(static_cast<uint64_t>(endRow - startRow) * cols * sizeof(Cell));
+    }
 
-            // Copy attributes
-            bufCell.attrs.bold = vtCell.attrs.bold;
-            bufCell.attrs.italic = vtCell.attrs.italic;
-            bufCell.attrs.underline = vtCell.attrs.underlineStyle;
-            bufCell.attrs.blink = vtCell.attrs.blink;
-            bufCell.attrs.reverse = vtCell.attrs.reverse;
-            bufCell.attrs.strikethrough = vtCell.attrs.strikethrough;
+    // Rows are independent: a large rect is copied in bands on the pool,
+    // each band noting its changes, and only this thread then marks them
+    // dirty (rows share the dirty bitmap's words)
+    const int rows = endRow - startRow;
+    const int bands = static_cast<int64_t>(rows) * std::max(endCol - startCol, 0) >= kParallelSyncCells
+                          ? std::min(static_cast<int>(BandPool::Shared().GetConcurrency()), rows / kMinSyncBandRows)
+                          : 1;
+    if (bands > 1) {
+        if (m_syncBands.size() < static_cast<size_t>(bands)) {
+            m_syncBands.resize(static_cast<size_t>(bands));
+        }
+        auto work = [&](int band) {
+            SyncBand& scratch = m_syncBands[static_cast<size_t>(band)];
+            scratch.changes.clear();
+            const int first = startRow + rows * band / bands;
+            const int last = startRow + rows * (band + 1) / bands;
+            for (int row = first; row < last; ++row) {
+                const CellChange change = SyncRowCells(row, startCol, endCol, scratch.row);
+                if (!change.IsEmpty()) {
+                    scratch.changes.push_back({row, startCol + static_cast<int>(change.start),
+                                               startCol + static_cast<int>(change.end)});
+                }
+            }
+        };
+        BandPool::Shared().Run(bands, work);
+        for (int band = 0; band < bands; ++band) {
+            for (const SyncBand::Change& change : m_syncBands[static_cast<size_t>(band)].changes) {
+                m_buffer->MarkDirty(change.row, change.startCol, change.endCol);
+            }
+        }
+        for (int row = startRow; row < endRow; ++row) {
+            m_buffer->SetContinuation(row, m_vterm->IsContinuation(row));
+        }
+        return;
+    }
 
-            bufCell.width = static_cast<uint8_t>(vtCell.width);
+    for (int row = startRow; row < endRow; ++row) {
+        const CellChange change = SyncRowCells(row, startCol, endCol, m_syncRow);
+        if (!change.IsEmpty()) {
+            m_buffer->MarkDirty(row, startCol + static_cast<int>(change.start),
+                                startCol + static_cast<int>(change.end));
         }
-        m_buffer->MarkDirty(row);
+        m_buffer->SetContinuation(row, m_vterm->IsContinuation(row));
+    }
+}
+
+CellChange Session::SyncRowCells(int row, int startCol, int endCol, Row& scratch) {
+    // One bulk export per row; damage often covers cells that were resent
+    // unchanged, so only the cells that differ are copied
+    const std::span<Cell> cells = m_buffer->GetRow(row);
+    const int last = std::min(endCol, static_cast<int>(cells.size()));
+    if (startCol >= last) {
+        return {};
+    }
+    scratch.resize(static_cast<size_t>(last - startCol));
+    const int read = std::max(m_vterm->ReadRow(row, startCol, scratch), 0);
+    const std::span<Cell> target = cells.subspan(startCol, read);
+    const CellChange change = FindChangedCells(target, std::span<const Cell>(scratch).first(read));
+    if (!change.IsEmpty()) {
+        std::copy(scratch.begin() + change.start, scratch.begin() + change.end, target.begin() + change.start);
     }
+    return change;
 }
 
 void Session::OnVTermPropChange(const Emulation::TermProps& props) {
+    m_mouseMode.store(props.mouseMode, std::memory_order_relaxed);
+    m_applicationCursor.store(props.applicationCursor, std::memory_order_relaxed);
+    m_applicationKeypad.store(props.applicationKeypad, std::memory_order_relaxed);
+    if (props.syncOutput != m_syncOutput) {
+        m_syncOutput = props.syncOutput;
+        m_syncStartMicros = PerfClock::NowMicros();
+    }
+
+    // Full-screen programs run on the alternate screen. The buffer keeps the
+    // primary screen meanwhile (libvterm does not resend it), unless a
+    // resize cleared it
+    if (m_buffer && props.altScreen != m_buffer->IsAlternateScreen() &&
+        !m_buffer->SetAlternateScreen(props.altScreen)) {
+        if (IsScreenDeferred()) {
+            m_screenStale = true;
+        } else {
+            SyncRegion(0, m_buffer->GetRows(), 0, m_buffer->GetCols());
+        }
+    }
+
+    if (m_emulationThread) {
+        // Worker thread: the UI picks the title up with the next frame
+        if (m_workerTitle != props.title && !props.title.empty()) {
+            m_workerTitle = props.title;
+            m_workerTitleChanged = true;
+        }
+        return;
+    }
+
     if (m_title != props.title && !props.title.empty()) {
         m_title = props.title;
         if (m_titleCallback) {
@@ -206,29 +1559,141 @@ void Session::OnVTermPropChange(const Emulation::TermProps& props) {
     }
 }
 
-// ============================================================================
-// Serialization
-// ============================================================================
+void Session::OnVTermScrollbackRow(std::span<const Cell> cells, bool continuation) {
+    // Scrollback is kept complete even while fast-forwarding
+    if (!m_buffer) return;
+    AllocScope allocScope(AllocSubsystem::Buffer);
 
-namespace {
+    // The UI thread's scrollback store takes the cells as they are; the
+    // worker's buffer has no scrollback, so its lines go out with the next
+    // frame, in rows recycled from frames already presented
+    if (!m_emulationThread) {
+        FinishScrolledLine(cells, continuation);
+        return;
+    }
+    Row& row = m_workerScrollback.emplace_back(ScrollbackLine{m_snapshots.TakeSpareRow(), continuation}).cells;
+    row.assign(cells.begin(), cells.end());
+    FinishScrolledLine(row, continuation);
+}
+
+bool Session::OnVTermScrollbackPop(std::span<Cell> cells) {
+    // The worker's lines are on their way to (or already in) the UI
+    // thread's store, out of its reach: the grown rows stay blank
+    if (!m_buffer || m_emulationThread) {
+        return false;
+    }
+    AllocScope allocScope(AllocSubsystem::Buffer);
+    return m_buffer->PopScrollback(cells);
+}
+
+void Session::FinishScrolledLine(std::span<const Cell> cells, bool continuation) {
+    // A line leaving the screen is complete, if it wasn't scanned above the cursor
+    const uint64_t line = GetParsedScreenLine();
+    if (line >= m_rulesLine) {
+        m_outputRules.ScanLine(line, cells);
+        m_rulesLine = line + 1;
+    }
+    if (m_waits.IsActive()) {
+        m_waits.ScanLine(line, cells);
+    }
+    if (m_taps.IsActive()) {
+        m_taps.OnLine(line, cells, continuation);
+    }
+
+    if (!m_emulationThread) {
+        m_buffer->PushScrollback(cells, continuation);
+    } else {
+        ++m_workerLinesPushed;
+    }
+}
+
+void Session::ScanCompletedRows() {
+    // The screen is stale while fast-forwarding or in the background; its
+    // lines are scanned as they scroll off instead
+    if (m_outputRules.IsEmpty() || IsScreenDeferred() || !m_buffer || m_buffer->IsAlternateScreen()) {
+        return;
+    }
+
+    int cursorRow = 0;
+    int cursorCol = 0;
+    m_vterm->GetCursorPos(cursorRow, cursorCol);
+    const uint64_t screen = GetParsedScreenLine();
+    const uint64_t end = screen + static_cast<uint64_t>(std::clamp(cursorRow, 0, m_buffer->GetRows()));
+    for (uint64_t line = std::max(m_rulesLine, screen); line < end; ++line) {
+        m_outputRules.ScanLine(line, m_buffer->GetRow(static_cast<int>(line - screen)));
+    }
+    m_rulesLine = std::max(m_rulesLine, end);
+}
+
+void Session::ScanWaits() {
+    if (m_waits.IsActive() && !IsScreenDeferred() && m_buffer) {
+        m_waits.ScanScreen(*m_buffer, GetParsedScreenLine());
+    }
+}
+
+void Session::OnVTermShellMark(Emulation::ShellMark kind, int row, int col, int exitCode) {
+    // Programs on the alternate screen have no history to mark
+    if (!m_buffer || m_buffer->IsAlternateScreen()) {
+        return;
+    }
+
+    // Same order as Emulation::ShellMark
+    PromptMark mark;
+    mark.kind = static_cast<PromptMarkKind>(kind);
+    mark.col = static_cast<uint16_t>(std::clamp(col, 0, 0xFFFF));
+    mark.exitCode = exitCode;
+    if (!m_emulationThread) {
+        mark.line = m_buffer->GetScreenLine() + static_cast<uint64_t>(row);
+        m_buffer->AddPromptMark(mark);
+        return;
+    }
 
-std::string WideToUtf8(const std::wstring& wide) {
-    if (wide.empty()) return {};
-    int size = WideCharToMultiByte(CP_UTF8, 0, wide.c_str(), -1, nullptr, 0, nullptr, nullptr);
-    std::string utf8(size - 1, '\0');
-    WideCharToMultiByte(CP_UTF8, 0, wide.c_str(), -1, utf8.data(), size, nullptr, nullptr);
-    return utf8;
+    // The worker's buffer keeps no scrollback; hand the mark to the UI's
+    mark.line = GetParsedScreenLine() + static_cast<uint64_t>(row);
+    std::lock_guard<std::mutex> lock(m_markLock);
+    m_workerMarks.push_back(mark);
 }
 
-std::wstring Utf8ToWide(const std::string& utf8) {
-    if (utf8.empty()) return {};
-    int size = MultiByteToWideChar(CP_UTF8, 0, utf8.c_str(), -1, nullptr, 0);
-    std::wstring wide(size - 1, L'\0');
-    MultiByteToWideChar(CP_UTF8, 0, utf8.c_str(), -1, wide.data(), size);
-    return wide;
+void Session::OnVTermImage(Emulation::InlineImage&& image) {
+    // Full-screen programs redraw rather than scroll; an image there would
+    // outlive what it illustrated
+    if (!m_buffer || m_buffer->IsAlternateScreen()) {
+        return;
+    }
+    const std::shared_ptr<ImageStore>& store = (m_presented ? *m_presented : *m_buffer).GetImageStore();
+    if (store->GetBudget() == 0) {
+        return;
+    }
+
+    ImagePlacement placement;
+    placement.image = store->Reserve();
+    placement.line = GetParsedScreenLine() + static_cast<uint64_t>(image.row);
+    placement.col = static_cast<uint16_t>(std::clamp(image.col, 0, 0xFFFF));
+    placement.rows = static_cast<uint16_t>(std::clamp(image.rows, 1, 0xFFFF));
+    placement.cols = static_cast<uint16_t>(std::clamp(image.cols, 1, 0xFFFF));
+
+    // The payload moves on to the decoder; only the placement stays here
+    ImageJob job;
+    job.store = store;
+    job.id = placement.image;
+    job.payload = std::move(image.payload);
+    job.size = {image.width, image.height};
+    if (!ImageDecoder::Shared().Submit(std::move(job))) {
+        store->Release(placement.image);
+        return;
+    }
+
+    if (!m_emulationThread) {
+        m_buffer->AddImage(placement);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_markLock);
+    m_workerImages.push_back(placement);
 }
 
-} // anonymous namespace
+// ============================================================================
+// Serialization
+// ============================================================================
 
 SessionConfig Session::GetConfig() const {
     SessionConfig config;
@@ -236,132 +1701,13 @@ SessionConfig Session::GetConfig() const {
     config.args = m_pty ? m_pty->GetConfig().args : L"";
     config.workingDir = m_pty ? m_pty->GetConfig().workingDir : L"";
     config.title = m_title;
+    config.profileName = m_profileName;
     config.rows = m_rows;
     config.cols = m_cols;
-    config.scrollbackLines = m_buffer ? m_buffer->GetMaxScrollback() : 10000;
-    return config;
-}
-
-std::string Session::Serialize() const {
-    SessionConfig config = GetConfig();
-    
-    // Simple JSON serialization
-    std::string json = "{\n";
-    json += "  \"shell\": \"" + WideToUtf8(config.shell) + "\",\n";
-    json += "  \"args\": \"" + WideToUtf8(config.args) + "\",\n";
-    json += "  \"workingDir\": \"" + WideToUtf8(config.workingDir) + "\",\n";
-    json += "  \"title\": \"" + WideToUtf8(config.title) + "\",\n";
-    json += "  \"profileName\": \"" + WideToUtf8(config.profileName) + "\",\n";
-    json += "  \"rows\": " + std::to_string(config.rows) + ",\n";
-    json += "  \"cols\": " + std::to_string(config.cols) + ",\n";
-    json += "  \"scrollbackLines\": " + std::to_string(config.scrollbackLines) + ",\n";
-    json += "  \"tabIndex\": " + std::to_string(config.tabIndex) + "\n";
-    json += "}";
-    
-    return json;
-}
-
-std::optional<SessionConfig> Session::Deserialize(const std::string& json) {
-    SessionConfig config;
-    
-    // Simple JSON parsing (find key-value pairs)
-    auto findString = [&json](const std::string& key) -> std::string {
-        std::string searchKey = "\"" + key + "\": \"";
-        size_t pos = json.find(searchKey);
-        if (pos == std::string::npos) return "";
-        pos += searchKey.length();
-        size_t end = json.find("\"", pos);
-        if (end == std::string::npos) return "";
-        return json.substr(pos, end - pos);
-    };
-    
-    auto findInt = [&json](const std::string& key) -> int {
-        std::string searchKey = "\"" + key + "\": ";
-        size_t pos = json.find(searchKey);
-        if (pos == std::string::npos) return 0;
-        pos += searchKey.length();
-        return std::atoi(json.c_str() + pos);
-    };
-    
-    config.shell = Utf8ToWide(findString("shell"));
-    config.args = Utf8ToWide(findString("args"));
-    config.workingDir = Utf8ToWide(findString("workingDir"));
-    config.title = Utf8ToWide(findString("title"));
-    config.profileName = Utf8ToWide(findString("profileName"));
-    config.rows = findInt("rows");
-    config.cols = findInt("cols");
-    config.scrollbackLines = static_cast<size_t>(findInt("scrollbackLines"));
-    config.tabIndex = findInt("tabIndex");
-    
-    // Validation
-    if (config.shell.empty()) config.shell = L"cmd.exe";
-    if (config.rows <= 0) config.rows = 25;
-    if (config.cols <= 0) config.cols = 80;
-    if (config.scrollbackLines == 0) config.scrollbackLines = 10000;
-    
+    // The worker's buffer keeps no scrollback; the presented one has the limit
+    const TerminalBuffer* buffer = GetBuffer();
+    config.scrollbackLines = buffer ? buffer->GetMaxScrollback() : 10000;
     return config;
 }
 
-bool Session::SaveSessions(const std::vector<SessionConfig>& sessions, const std::wstring& path) {
-    FILE* file = nullptr;
-    if (_wfopen_s(&file, path.c_str(), L"w") != 0 || !file) {
-        return false;
-    }
-    
-    fprintf(file, "[\n");
-    for (size_t i = 0; i < sessions.size(); ++i) {
-        const auto& config = sessions[i];
-        fprintf(file, "  {\n");
-        fprintf(file, "    \"shell\": \"%s\",\n", WideToUtf8(config.shell).c_str());
-        fprintf(file, "    \"args\": \"%s\",\n", WideToUtf8(config.args).c_str());
-        fprintf(file, "    \"workingDir\": \"%s\",\n", WideToUtf8(config.workingDir).c_str());
-        fprintf(file, "    \"title\": \"%s\",\n", WideToUtf8(config.title).c_str());
-        fprintf(file, "    \"profileName\": \"%s\",\n", WideToUtf8(config.profileName).c_str());
-        fprintf(file, "    \"rows\": %d,\n", config.rows);
-        fprintf(file, "    \"cols\": %d,\n", config.cols);
-        fprintf(file, "    \"scrollbackLines\": %zu,\n", config.scrollbackLines);
-        fprintf(file, "    \"tabIndex\": %d\n", config.tabIndex);
-        fprintf(file, "  }%s\n", (i < sessions.size() - 1) ? "," : "");
-    }
-    fprintf(file, "]\n");
-    
-    fclose(file);
-    return true;
-}
-
-std::vector<SessionConfig> Session::LoadSessions(const std::wstring& path) {
-    std::vector<SessionConfig> sessions;
-    
-    FILE* file = nullptr;
-    if (_wfopen_s(&file, path.c_str(), L"r") != 0 || !file) {
-        return sessions;
-    }
-    
-    // Read entire file
-    fseek(file, 0, SEEK_END);
-    long size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    
-    std::string content(size, '\0');
-    fread(content.data(), 1, size, file);
-    fclose(file);
-    
-    // Parse array of sessions (simple parsing)
-    size_t pos = 0;
-    while ((pos = content.find("{", pos)) != std::string::npos) {
-        size_t end = content.find("}", pos);
-        if (end == std::string::npos) break;
-        
-        std::string sessionJson = content.substr(pos, end - pos + 1);
-        auto config = Deserialize(sessionJson);
-        if (config) {
-            sessions.push_back(*config);
-        }
-        pos = end + 1;
-    }
-    
-    return sessions;
-}
-
 } // namespace Console3::Core
-
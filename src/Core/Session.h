@@ -2,20 +2,46 @@
 // Console3 - Session.h
 // Terminal session model - ties together PTY, buffer, and emulation
 
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <span>
 #include <string>
+#include <string_view>
 #include <functional>
 #include <vector>
 #include <optional>
-
+#include <thread>
+
+#include "Core/InputLatency.h"
+#include "Core/KeyEncoder.h"
+#include "Core/LinkDetector.h"
+#include "Core/OutputRules.h"
+#include "Core/OutputPacer.h"
+#include "Core/OutputTaps.h"
+#include "Core/OutputWaits.h"
+#include "Core/PipelineTrace.h"
+#include "Core/PtyRecorder.h"
 #include "Core/PtySession.h"
+#include "Core/PtyTransport.h"
+#include "Core/ScrollbackExport.h"
+#include "Core/ScrollbackSearch.h"
 #include "Core/TerminalBuffer.h"
-#include "Core/RingBuffer.h"
+#include "Core/SegmentedRingBuffer.h"
+#include "Core/SerialPort.h"
+#include "Core/SessionScheduler.h"
+#include "Core/SessionMemory.h"
+#include "Core/SessionStats.h"
+#include "Core/TerminalSnapshot.h"
+#include "Core/WarmShellPool.h"
 #include "Emulation/VTermWrapper.h"
 
 
 namespace Console3::Core {
 
+class HostClient;
+class SavedHistory;
+
 /// Session state
 enum class SessionState {
     Idle,
@@ -33,7 +59,43 @@ struct SessionConfig {
     int rows = 25;
     int cols = 80;
     size_t scrollbackLines = 10000;
+    bool scrollbackToDisk = false;   ///< Keep history beyond scrollbackLines in a temp file (unbounded)
+    bool scrollbackInternLines = false; ///< Store repeated cold lines once (LineInterner)
+    bool scrollbackTimestamps = false;  ///< Keep when each line was completed (ScrollbackTimes)
+    size_t scrollbackHotLines = ScrollbackStore::kDefaultHotLines; ///< Newest lines kept uncompressed
+    size_t imageMemoryBytes = ImageStore::kDefaultBudget; ///< Decoded inline images kept (0 = show none)
     int tabIndex = 0;          ///< Tab position for restore
+    bool useCompletionPort = false;  ///< Read PTY output via the shared completion port
+    bool sideBySideConpty = true;    ///< Prefer a conpty.dll next to the executable (PseudoConsole.h)
+    bool wslRelay = true;            ///< Run plain WSL shells through console3-relay if installed (WslRelay.h)
+    size_t maxReadSize = AdaptiveReadSize::kDefaultMax; ///< Largest PTY read (Thread transport)
+    size_t outputBufferSize = SegmentedRingBuffer::kDefaultMaxBytes; ///< PTY output cap in bytes (grows on demand)
+    size_t outputHighWatermark = 0;      ///< Throttle the reader at this fill level (0 = full)
+    size_t outputLowWatermark = 0;       ///< Resume the reader at this fill level (0 = half)
+    size_t fastForwardBytesPerSec = 8 * 1024 * 1024; ///< Output rate that enables fast-forward (0 = never)
+    DWORD fastForwardFrameMs = 100;      ///< Screen refresh interval while fast-forwarding
+    Emulation::DamageMerge damageMerge = Emulation::DamageMerge::Scroll; ///< Damage granularity from the emulator
+    std::wstring recordPath;             ///< Record all PTY output to this file (empty = off)
+    RecordingFormat recordFormat = RecordingFormat::Binary; ///< Format of recordPath
+    bool recordCompress = false;         ///< Write recordPath as LZ4 frames
+    RecorderOverflow recordOverflow = RecorderOverflow::Drop; ///< When the recorder's writer falls behind
+    uint64_t recordRotateBytes = 0;      ///< Start a new recording file past this size (0 = never)
+    uint32_t recordRotateSeconds = 0;    ///< Start a new recording file past this age (0 = never)
+    std::wstring replayPath;             ///< Replay this recording instead of starting a shell
+    double replaySpeed = 1.0;            ///< Replay pace (1 = as recorded, 0 = as fast as possible)
+    std::wstring logPath;                ///< Show this file as scrollback instead of starting a shell (LogFile)
+    bool emulationThread = false;        ///< Parse on a per-session worker instead of in ProcessOutput()
+    bool sharedEmulation = false;        ///< With emulationThread: run on the SessionScheduler pool instead
+    SessionPriority priority = SessionPriority::Visible; ///< See SetPriority()
+    std::vector<OutputRule> outputRules; ///< Highlight and bell rules, scanned as lines complete
+    std::shared_ptr<const SavedHistory> restoreHistory; ///< Output of an earlier run to put in the scrollback first
+    const TerminalBuffer* shareHistory = nullptr; ///< Buffer whose history to start with, shared (read during Start only)
+    Emulation::VTermAllocator vtermAllocator = Emulation::VTermAllocator::Arena; ///< Where libvterm's memory comes from
+    Emulation::EmulationBackend emulationBackend = Emulation::EmulationBackend::Screen; ///< Grid: libvterm draws on the terminal buffer (one screen copy, no damage sync)
+    bool frontParser = false;            ///< Parse the common VT subset natively ahead of libvterm
+    Emulation::VTermBufferSizes vtermBuffers; ///< libvterm's scratch buffer and the reply batch
+    std::wstring hostPipe;               ///< Attach to the session host on this pipe instead of starting a shell (SessionHost.h)
+    SerialSettings serial;               ///< Open this serial port instead of starting a shell (when port is set)
 };
 
 /// Exit callback type
@@ -42,6 +104,9 @@ using SessionExitCallback = std::function<void(DWORD exitCode)>;
 /// Title change callback
 using TitleChangeCallback = std::function<void(const std::wstring& title)>;
 
+/// Fast-forward mode change callback
+using FastForwardCallback = std::function<void(bool active)>;
+
 /// Manages a complete terminal session
 class Session {
 public:
@@ -53,8 +118,30 @@ public:
     Session& operator=(const Session&) = delete;
 
     /// Start a new session
+    /// With config.replayPath set, the recording is played back through the
+    /// same output path instead of starting a shell (input is discarded).
+    /// With config.hostPipe set, the session shows a session host's screen
+    /// and sends it the input; the host going away is the shell exiting.
+    /// With config.logPath set, the file's last lines are played onto the
+    /// screen and the rest is scrollback read from its mapping (LogFile).
+    /// With config.serial.port set, the port's bytes are the output and the
+    /// input goes out on the line; the port going away is the shell exiting.
     [[nodiscard]] bool Start(const SessionConfig& config);
 
+    /// Start a new session on a shell taken from the WarmShellPool
+    /// The shell is resized to the session and its output so far is shown.
+    /// Without a shell, or with replayPath, logPath, recordPath or a serial
+    /// port set, this is Start(config) (a recording must see the shell's
+    /// output from its first byte) and the warm shell is stopped.
+    [[nodiscard]] bool Start(const SessionConfig& config, WarmShell warm);
+
+    /// Get the pseudo console settings Start() uses for a configuration
+    [[nodiscard]] static PtyConfig GetPtyConfig(const SessionConfig& config);
+
+    /// Start without a pseudo console (benchmarks, replay); output is
+    /// supplied with FeedOutput() and input is discarded
+    [[nodiscard]] bool StartDetached(const SessionConfig& config);
+
     /// Stop the session
     void Stop();
 
@@ -64,9 +151,57 @@ public:
     /// Check if session is running
     [[nodiscard]] bool IsRunning() const noexcept { return m_state == SessionState::Running; }
 
-    /// Write data to the PTY (keyboard input)
+    /// Write data to the PTY (keyboard input, queued - never blocks)
     int Write(const char* data, size_t length);
 
+    /// Paste text, streamed to the PTY in the background
+    /// @param bracketed Wrap in bracketed paste markers (DECSET 2004)
+    bool Paste(std::string_view text, bool bracketed);
+
+    /// Paste UTF-16 text (e.g. the clipboard's), converted as it is streamed
+    bool Paste(std::wstring text, bool bracketed);
+
+    /// Abort a paste in progress
+    void CancelPaste();
+
+    /// Check if a paste is still being streamed
+    [[nodiscard]] bool IsPasting() const { return m_pty && m_pty->IsPasting(); }
+
+    /// Stop or resume taking the program's output (any thread)
+    /// Paused, the reader stops draining the pseudo console, so the program
+    /// blocks on its next write once the pipe is full; output already read
+    /// is still shown. Resuming reads straight into the ring at full speed.
+    /// A session attached to a host is not paused: its program runs there.
+    void SetOutputPaused(bool paused);
+
+    [[nodiscard]] bool IsOutputPaused() const noexcept { return m_outputBuffer && m_outputBuffer->IsPaused(); }
+
+    /// Queue mouse input for the application (UI thread)
+    /// The emulator applies the queue before its next parse and sends the
+    /// reports as one PTY write. A move replaces a move queued before it, so
+    /// a burst of motion costs one report.
+    void QueueMouseInput(const Emulation::MouseEvent& event);
+
+    /// Get how much longer to hold presentation for synchronized output
+    /// (DEC mode 2026) when parsing on the UI thread; worker sessions hold
+    /// their snapshots themselves and return 0
+    /// @return Milliseconds, 0 to present now
+    [[nodiscard]] DWORD GetPresentHoldMs() const;
+
+    /// Get the mouse tracking the application asked for (VTERM_PROP_MOUSE_*; any thread)
+    [[nodiscard]] int GetMouseMode() const noexcept { return m_mouseMode.load(std::memory_order_relaxed); }
+
+    /// Get the cursor key and keypad modes the application set (any thread)
+    [[nodiscard]] KeyboardModes GetKeyboardModes() const noexcept {
+        return {m_applicationCursor.load(std::memory_order_relaxed),
+                m_applicationKeypad.load(std::memory_order_relaxed)};
+    }
+
+    /// Get how far the pastes in flight have got
+    [[nodiscard]] PasteProgress GetPasteProgress() const {
+        return m_pty ? m_pty->GetPasteProgress() : PasteProgress{};
+    }
+
     /// Resize the terminal
     bool Resize(int cols, int rows);
 
@@ -77,78 +212,425 @@ public:
     /// Get session title
     [[nodiscard]] const std::wstring& GetTitle() const noexcept { return m_title; }
 
-    /// Get the terminal buffer
-    [[nodiscard]] TerminalBuffer* GetBuffer() { return m_buffer.get(); }
-    [[nodiscard]] const TerminalBuffer* GetBuffer() const { return m_buffer.get(); }
+    /// Get the terminal buffer the UI renders from
+    /// With an emulation thread this is the presented copy, updated only by
+    /// ProcessOutput() on the UI thread.
+    [[nodiscard]] TerminalBuffer* GetBuffer() {
+        return m_emulationThread ? m_presented.get() : m_buffer.get();
+    }
+    [[nodiscard]] const TerminalBuffer* GetBuffer() const {
+        return m_emulationThread ? m_presented.get() : m_buffer.get();
+    }
+
+    /// Check if output is parsed on the session's emulation thread
+    [[nodiscard]] bool HasEmulationThread() const noexcept { return m_emulationThread; }
 
     /// Get the VTerm wrapper
+    /// With an emulation thread the wrapper belongs to the worker; only use
+    /// it while the session is stopped.
     [[nodiscard]] Emulation::VTermWrapper* GetVTerm() { return m_vterm.get(); }
     [[nodiscard]] const Emulation::VTermWrapper* GetVTerm() const { return m_vterm.get(); }
 
     /// Get the PTY session
     [[nodiscard]] PtySession* GetPty() { return m_pty.get(); }
 
+    /// Get output buffer usage (fill level, high-water mark, chunks held)
+    [[nodiscard]] SegmentedRingStats GetOutputStats() const noexcept {
+        return m_outputBuffer ? m_outputBuffer->GetStats() : SegmentedRingStats{};
+    }
+
+    /// Get an I/O telemetry snapshot (cheap; call from the UI thread)
+    [[nodiscard]] SessionStats GetStats() const noexcept;
+
+    /// Get the memory the session holds, by owner (UI thread; the rendering
+    /// fields are left for the view)
+    [[nodiscard]] SessionMemory GetMemory() const noexcept;
+
+    /// Get the keypress-to-photon probe (off until enabled; the view stamps
+    /// keys and presents, the session the stages in between)
+    [[nodiscard]] InputLatencyProbe& GetInputLatency() noexcept { return m_inputLatency; }
+
+    /// Get the time each parse pass that parsed output took, since the
+    /// session started (any thread; telemetry, TelemetryEndpoint.h)
+    [[nodiscard]] LatencyHistogram GetParseTimes() const;
+
+    /// Get the find-in-terminal engine over this session's scrollback
+    /// (UI thread; see ScrollbackSearch)
+    [[nodiscard]] ScrollbackSearch& GetSearch() noexcept { return m_search; }
+
+    /// Bring an open search up to date with the scrollback (UI thread)
+    /// ProcessOutput() calls this; call it from a UI timer too while it
+    /// returns true, so a long history is converted without new output.
+    /// @return true while scrollback lines remain to be converted
+    bool UpdateSearch();
+
+    /// Get the "save scrollback to file" export of this session's history
+    /// (UI thread; see ScrollbackExport)
+    [[nodiscard]] ScrollbackExport& GetExport() noexcept { return m_export; }
+
+    /// Hand the next slice of history to a running export (UI thread; call
+    /// from a UI timer while it returns true)
+    /// @return true while the export is running
+    bool UpdateExport();
+
+    /// Get the OSC 8 hyperlinks the program has printed, by absolute line
+    /// (written by the emulator, safe to read from the UI thread)
+    [[nodiscard]] const HyperlinkTable& GetHyperlinks() const noexcept { return m_hyperlinks; }
+
+    /// Get the output rules: line highlights for the view, and events to
+    /// take after ProcessOutput() (safe to read from the UI thread)
+    [[nodiscard]] OutputRules& GetOutputRules() noexcept { return m_outputRules; }
+
+    /// Wait for text on the screen or in output still to come (any thread;
+    /// see OutputWaits). The next parse matches it, so without an emulation
+    /// thread the caller keeps calling ProcessOutput() until it completes,
+    /// and cancels it to give up.
+    /// @return The wait, or nullptr if the query can't match
+    [[nodiscard]] std::shared_ptr<OutputWait> WaitForOutput(const SearchQuery& query);
+
+    /// Get the output extensions: add one to be fed the output's bytes and
+    /// finished lines on the side that parses (any thread; see OutputTaps)
+    [[nodiscard]] OutputTaps& GetOutputTaps() noexcept { return m_taps; }
+
     /// Get exit code (valid after exit)
     [[nodiscard]] DWORD GetExitCode() const noexcept { return m_exitCode; }
 
+    /// Get the ID this session's pipeline trace events carry (see PipelineTrace.h)
+    [[nodiscard]] uint32_t GetTraceId() const noexcept { return m_traceId; }
+
     /// Set exit callback
     void SetExitCallback(SessionExitCallback callback);
 
     /// Set title change callback
     void SetTitleChangeCallback(TitleChangeCallback callback);
 
-    /// Process pending output (call periodically from UI thread)
+    /// Set callback fired (on the UI thread) when fast-forward starts or ends
+    void SetFastForwardCallback(FastForwardCallback callback);
+
+    /// Check if output is being fast-forwarded
+    /// While the output rate is above SessionConfig::fastForwardBytesPerSec,
+    /// every byte is still parsed but the terminal buffer is only refreshed
+    /// every fastForwardFrameMs instead of on each damage callback.
+    /// Scrollback is always kept complete.
+    [[nodiscard]] bool IsFastForwarding() const noexcept {
+        return m_emulationThread ? m_presentedFastForward : m_fastForward;
+    }
+
+    /// Re-evaluate fast-forward mode (call from a UI timer while it is active)
+    /// Ends the mode once the flood has stopped and presents the final frame.
+    /// An emulation thread times its own frames, so this does nothing there.
+    void UpdateFastForward();
+
+    /// Change how the emulator merges damage (e.g. Cell for latency-sensitive
+    /// interactive use, Scroll for log floods)
+    void SetDamageMerge(Emulation::DamageMerge merge);
+
+    /// Set how the session competes with others for emulation time
+    /// On the scheduler this picks its queue and slice budget. A Background
+    /// session (a hidden tab) parses everything and pushes scrollback, but
+    /// its screen is not synced into the buffer at all; raising the priority
+    /// syncs the whole grid once.
+    void SetPriority(SessionPriority priority);
+
+    /// Take the tuning a running session can change (UI thread): the image
+    /// budget and the fast-forward rate. The ring, read size and scrollback
+    /// tiers stay as the session was started with.
+    void Reconfigure(const SessionConfig& config);
+
+    /// Page out an idle session (UI thread; meant for a hidden one)
+    /// The scrollback is compressed and spilled, the search shadow and
+    /// scratch storage freed and the shared ring chunk cache trimmed. Nothing
+    /// has to be undone: output or a read brings back what it needs, and the
+    /// session counts as awake again from its next output or input.
+    void Hibernate();
+
+    /// Hibernate a slice at a time (UI thread; idle work): the scrollback
+    /// first, then the rest of Hibernate()
+    /// @param lines Scrollback lines to compress or spill at most
+    /// @return true while work remains
+    bool HibernateSlice(size_t lines);
+
+    /// Check if the session was hibernated with nothing happening since
+    [[nodiscard]] bool IsHibernated() const noexcept { return m_hibernated.load(std::memory_order_relaxed); }
+
+    /// Get the tick (GetTickCount64) of the last output or input
+    [[nodiscard]] uint64_t GetLastActivity() const noexcept {
+        return m_lastActivity.load(std::memory_order_relaxed);
+    }
+
+    /// Process pending output (call from UI thread when the output event fires)
+    /// Without an emulation thread it parses for a budget (OutputPacer) and
+    /// signals the output event again if output is left. With one the
+    /// output is already parsed; this presents the latest snapshot and fires
+    /// title and fast-forward callbacks.
     void ProcessOutput();
 
+    /// Hand output to the session as if the PTY had produced it, and parse it
+    /// Goes through the output ring and ProcessOutput(), so a detached session
+    /// exercises the same parse and buffer sync path as a live one.
+    /// @return Bytes consumed (0 if the session has not been started)
+    size_t FeedOutput(const char* data, size_t length);
+
+    /// Get the auto-reset event signaled when output arrives in an empty
+    /// buffer - one wakeup per burst. Wait on it with
+    /// MsgWaitForMultipleObjectsEx and call ProcessOutput() when it fires.
+    /// With an emulation thread it is signaled when a snapshot is published.
+    [[nodiscard]] HANDLE GetOutputEvent() const noexcept {
+        return m_emulationThread ? m_frameEvent.get() : m_outputEvent.get();
+    }
+
     // ========================================================================
     // Serialization
     // ========================================================================
 
-    /// Get current session configuration (for serialization)
+    /// Get current session configuration (for SessionSnapshots)
     [[nodiscard]] SessionConfig GetConfig() const;
 
-    /// Serialize session state to JSON string
-    [[nodiscard]] std::string Serialize() const;
+    // ========================================================================
+    // Emulator Events (Emulation::VTermEventSink; on the thread that parses)
+    // ========================================================================
 
-    /// Deserialize session config from JSON string
-    [[nodiscard]] static std::optional<SessionConfig> Deserialize(const std::string& json);
+    /// Handle VTerm damage
+    void OnVTermDamage(int startRow, int endRow, int startCol, int endCol);
+    bool OnVTermMoveRect(const Emulation::TermRect& dest, const Emulation::TermRect& src);
 
-    /// Save all sessions to file
-    static bool SaveSessions(const std::vector<SessionConfig>& sessions, const std::wstring& path);
+    /// Handle a line scrolled off the emulator's screen
+    void OnVTermScrollbackRow(std::span<const Cell> cells, bool continuation);
 
-    /// Load sessions from file
-    [[nodiscard]] static std::vector<SessionConfig> LoadSessions(const std::wstring& path);
+    /// Hand the emulator the most recent scrollback line back (its screen grew)
+    /// @return False if there is none it can have
+    bool OnVTermScrollbackPop(std::span<Cell> cells);
 
 private:
-    /// Handle PTY output
-    void OnPtyOutput(const char* data, size_t length);
+    /// Create the buffer, output ring and emulator for a starting session
+    /// @param adoptedOutput A warm shell's ring to use instead of a new one;
+    /// its data callback is left to the shell's hooks
+    bool CreateComponents(const SessionConfig& config,
+                          std::unique_ptr<SegmentedRingBuffer> adoptedOutput = nullptr);
+
+    /// Output arrived in the ring (transport thread)
+    void OnOutputAvailable();
+
+    /// Start playing back config.replayPath (after CreateComponents)
+    bool StartReplay(const SessionConfig& config, std::shared_ptr<const PtyRecording> recording);
+
+    /// Parse a long recording up to its last checkpoint on every core,
+    /// into the scrollback (Emulation/VTermSegmentParser.h)
+    /// @return What is left to play: the state at that checkpoint and the
+    ///         output after it, or the recording itself
+    [[nodiscard]] std::shared_ptr<const PtyRecording> PrefillReplay(const SessionConfig& config,
+                                                                    std::shared_ptr<const PtyRecording> recording);
+
+    /// Attach to config.hostPipe's session host (Start() with hostPipe set)
+    bool StartAttached(const SessionConfig& config);
+
+    /// Parse everything in the output ring into the emulator
+    /// @param budgetMicros Stop after about this long, leaving the rest (0 = no limit)
+    /// @return Start of the burst that was parsed (0 if unknown or nothing was)
+    uint64_t ParseOutput(uint64_t budgetMicros = 0);
+
+    /// Get the output offset a cursor position query waits at (see QueryResponder)
+    [[nodiscard]] uint64_t GetCursorQueryEnd() const;
+
+    /// Record output-to-buffer latency for a burst
+    void RecordLatency(uint64_t burstStart);
+
+    /// Stamp the lines completed by the output just parsed or presented
+    /// with the time now (TerminalBuffer::StampLines)
+    void StampLines();
+
+    /// Start the emulation worker (after CreateComponents)
+    bool StartEmulationThread();
+
+    /// Stop and join the emulation worker
+    void StopEmulationThread();
+
+    /// Emulation worker procedure
+    void EmulationThreadProc();
+
+    /// Parse and publish for one scheduler time slice (pool thread)
+    SliceResult RunEmulationSlice(uint64_t budgetMicros);
+
+    /// Have the worker (thread or scheduler task) look at the requests
+    void WakeWorker();
+
+    /// Check if damage is left for a later whole-screen refresh
+    /// (fast-forward, or a background session; on the thread that parses)
+    [[nodiscard]] bool IsScreenDeferred() const noexcept { return m_fastForward || m_deferScreen; }
+
+    /// Enter or leave background mode (on the thread that parses)
+    void SetBackground(bool background);
+
+    /// Apply resize and damage-merge requests from the UI (worker thread)
+    void ApplyWorkerRequests();
+
+    /// Get how long synchronized output still holds the screen back, in
+    /// microseconds (0 = not held; on the thread that parses)
+    [[nodiscard]] uint64_t GetSyncHoldMicros() const;
+
+    /// Hand queued mouse input to the emulator (on the thread that parses)
+    void ApplyMouseInput();
+
+    /// Publish the worker buffer as a snapshot for the UI (worker thread)
+    void PublishFrame(uint64_t burstStart);
 
     /// Handle PTY exit
     void OnPtyExit(DWORD exitCode);
 
-    /// Handle VTerm damage
-    void OnVTermDamage(int startRow, int endRow, int startCol, int endCol);
-
     /// Handle VTerm property change
     void OnVTermPropChange(const Emulation::TermProps& props);
 
+    /// Scan a line that left the screen and store it (or queue it for the UI)
+    void FinishScrolledLine(std::span<const Cell> cells, bool continuation);
+
+    /// Record a shell integration mark in the buffer the UI reads
+    void OnVTermShellMark(Emulation::ShellMark kind, int row, int col, int exitCode);
+
+    /// Place a sixel image in the buffer the UI reads and queue it to decode
+    void OnVTermImage(Emulation::InlineImage&& image);
+
+    /// Get the absolute line of the emulator's top row (on the thread that parses)
+    [[nodiscard]] uint64_t GetParsedScreenLine() const noexcept {
+        return m_emulationThread ? m_workerLinesPushed : m_buffer->GetScreenLine();
+    }
+
+    /// Scan the screen rows above the cursor not scanned yet with the
+    /// output rules (after a parse, on the thread that parses)
+    void ScanCompletedRows();
+
+    /// Match the changed screen rows with the pending waits (on the thread
+    /// that parses, after a parse or a deferred screen is presented)
+    void ScanWaits();
+
+    /// Copy a VTerm region into the terminal buffer
+    void SyncRegion(int startRow, int endRow, int startCol, int endCol);
+
+    /// Copy the cells of a row's columns [startCol, endCol) that differ
+    /// from libvterm's into the buffer, marking nothing (any thread, one
+    /// row per thread)
+    /// @return The changed columns, relative to startCol
+    CellChange SyncRowCells(int row, int startCol, int endCol, Row& scratch);
+
+    /// Account parsed bytes and enter or leave fast-forward
+    void TrackOutputRate(size_t bytes);
+
+    /// Switch fast-forward mode; leaving it syncs the whole screen
+    void SetFastForward(bool active);
+
+    /// Refresh the terminal buffer from VTerm if a fast-forward frame is due
+    void PresentFastForwardFrame(bool force);
+
 private:
+    uint32_t m_traceId = PipelineTrace::NewSessionId();
+    uint32_t m_traceRows = 0;   ///< Rows synced in the current ProcessOutput batch
+    Row m_syncRow;              ///< SyncRegion's scratch: a damaged row as libvterm has it
+
+    // SyncRegion's scratch per row band, when a large rect is split
+    struct SyncBand {
+        struct Change {
+            int row = 0;
+            int startCol = 0;
+            int endCol = 0;
+        };
+        Row row;
+        std::vector<Change> changes;    ///< To mark dirty once the bands are done
+    };
+    std::vector<SyncBand> m_syncBands;
+
     // Components
     std::unique_ptr<PtySession> m_pty;
+    std::atomic<PtySession*> m_replyPty{nullptr}; ///< Where the emulator's replies go (set once m_pty runs)
+    uint64_t m_parsedBytes = 0;               ///< Output parsed from this ring (parse side)
+    std::unique_ptr<PtyTransport> m_replay;   ///< Replay engine (replay sessions only)
+    std::shared_ptr<const LogFile> m_log;     ///< File shown as scrollback (log views only; set before CreateComponents)
+    std::unique_ptr<HostClient> m_host;       ///< Session host connection (attached sessions only)
+    std::shared_ptr<PtyRecorder> m_recorder;  ///< Output recorder (recording sessions only)
     std::unique_ptr<TerminalBuffer> m_buffer;
     std::unique_ptr<Emulation::VTermWrapper> m_vterm;
-    std::unique_ptr<ByteRingBuffer> m_outputBuffer;
+    std::unique_ptr<SegmentedRingBuffer> m_outputBuffer;
+    wil::unique_event_nothrow m_outputEvent;  ///< Signaled on empty -> non-empty
+
+    // Emulation thread (see SessionConfig::emulationThread). The worker owns
+    // m_vterm and m_buffer; the UI renders m_presented and never waits for
+    // a parse.
+    bool m_emulationThread = false;
+    std::unique_ptr<TerminalBuffer> m_presented;  ///< UI thread only
+    std::thread m_worker;
+    std::atomic<bool> m_workerStop{false};
+    wil::unique_event_nothrow m_workerWake;   ///< Stop or a request is pending
+    wil::unique_event_nothrow m_frameEvent;   ///< A snapshot was published
+    SnapshotExchange m_snapshots;             ///< Worker publishes, UI presents
+    std::atomic<uint64_t> m_resizeRequest{0}; ///< (rows << 32) | cols, 0 = none
+    std::atomic<int> m_damageMergeRequest{-1}; ///< Emulation::DamageMerge, -1 = none
+    std::atomic<int> m_priorityRequest{-1};   ///< SessionPriority, -1 = none
+    std::atomic<bool> m_hibernateRequest{false}; ///< Free the worker's spare storage
+    SessionPriority m_priority = SessionPriority::Visible; ///< UI thread
+    bool m_sharedEmulation = false;           ///< Worker is a SessionScheduler task
+    SessionScheduler::Task* m_task = nullptr; ///< Set while the task is registered
+    bool m_deferScreen = false;               ///< Parse side: background, screen not synced (see SetPriority)
+    std::vector<ScrollbackLine> m_workerScrollback; ///< Worker thread: lines since the last publish
+    std::wstring m_workerTitle;               ///< Worker thread: last title seen
+    bool m_workerTitleChanged = false;        ///< Worker thread: title not yet published
+    bool m_publishedFastForward = false;      ///< Worker thread
+    bool m_presentedFastForward = false;      ///< UI thread
+    uint64_t m_workerLinesPushed = 0;         ///< Worker thread: absolute line of the screen's top row
+    std::mutex m_markLock;
+    std::vector<PromptMark> m_workerMarks;    ///< Worker marks for m_presented (m_markLock)
+    std::vector<ImagePlacement> m_workerImages; ///< Worker images for m_presented (m_markLock)
+    std::mutex m_mouseLock;
+    std::vector<Emulation::MouseEvent> m_mouseQueue;   ///< From the UI (m_mouseLock)
+    std::vector<Emulation::MouseEvent> m_mouseApplied; ///< Parse side: the queue being applied
+    std::atomic<int> m_mouseMode{0};          ///< Set by the parse side
+    std::atomic<bool> m_applicationCursor{false}; ///< Set by the parse side (DECCKM)
+    std::atomic<bool> m_applicationKeypad{false}; ///< Set by the parse side (DECKPAM)
+    bool m_syncOutput = false;                ///< Parse side: DEC mode 2026 set
+    uint64_t m_syncStartMicros = 0;           ///< Parse side: when it was set
+    uint64_t m_heldBurstStart = 0;            ///< Worker thread: burst start of frames held back
 
     // State
     SessionState m_state = SessionState::Idle;
     int m_rows = 25;
     int m_cols = 80;
     std::wstring m_title = L"Console3";
+    std::wstring m_profileName;
     DWORD m_exitCode = 0;
 
+    // Fast-forward (output rate governor, UI thread only)
+    std::atomic<size_t> m_fastForwardBytesPerSec{0}; ///< Reconfigure() sets it from the UI thread
+    DWORD m_fastForwardFrameMs = 100;
+    bool m_fastForward = false;
+    bool m_screenStale = false;         ///< Damage skipped since the last frame
+    ULONGLONG m_rateWindowStart = 0;    ///< Start of the current rate window
+    size_t m_rateWindowBytes = 0;       ///< Bytes parsed in the current window
+    ULONGLONG m_lastFrameTick = 0;
+
+    // Hibernation (see Hibernate())
+    std::atomic<uint64_t> m_lastActivity{0};  ///< GetTickCount64 of the last output or input
+    std::atomic<bool> m_hibernated{false};
+
+    // Telemetry (see SessionStats)
+    std::atomic<uint64_t> m_burstStartMicros{0};  ///< Set by the producer, cleared on parse
+    std::atomic<uint64_t> m_parseMicros{0};
+    std::atomic<uint64_t> m_parseCalls{0};
+    std::atomic<uint64_t> m_lastLatencyMicros{0};
+    std::atomic<uint64_t> m_maxLatencyMicros{0};
+    InputLatencyProbe m_inputLatency;
+    OutputPacer m_pacer;        ///< Parse pass budgets (see OutputPacer)
+    mutable std::mutex m_parseTimesLock;
+    LatencyHistogram m_parseTimes;            ///< Guarded by m_parseTimesLock
+
+    ScrollbackSearch m_search;                ///< Reads the buffer GetBuffer() returns
+    ScrollbackExport m_export;                ///< Likewise
+    HyperlinkTable m_hyperlinks;
+    OutputRules m_outputRules;
+    uint64_t m_rulesLine = 0;                 ///< Parse side: lines before this were scanned
+    OutputWaits m_waits;
+    OutputTaps m_taps;
+
     // Callbacks
     SessionExitCallback m_exitCallback;
     TitleChangeCallback m_titleCallback;
+    FastForwardCallback m_fastForwardCallback;
 };
 
 } // namespace Console3::Core
@@ -0,0 +1,348 @@
+// Console3 - SessionHost.cpp
+// A session that outlives its window: served on a named pipe to attachers
+
+#include "Core/SessionHost.h"
+#include "Core/HostProtocol.h"
+#include "Core/Utf.h"
+#include <algorithm>
+
+namespace Console3::Core {
+
+namespace {
+
+/// Time the last frame and exit code have to reach the windows
+constexpr DWORD kGoodbyeMs = 2000;
+
+} // namespace
+
+SessionHost::~SessionHost() {
+    Stop();
+    if (m_acceptThread.joinable()) {
+        m_acceptThread.join();
+    }
+    ReapClients(true);
+    m_session.Stop();
+}
+
+bool SessionHost::Start(const SessionHostConfig& config) {
+    m_config = config;
+    if (!m_stop.try_create(wil::EventOptions::ManualReset, nullptr) ||
+        !m_wake.try_create(wil::EventOptions::None, nullptr)) {
+        return false;
+    }
+
+    // Claim the name before starting a shell no one could reach; the pipe
+    // admits the current user only
+    if (!m_listener.Listen(GetHostPipePath(config.name), {}, config.allowRemote)) {
+        return false;
+    }
+
+    // Frames read the buffer parsing writes, on this thread, and are
+    // paced already, so the session neither parses on a worker nor
+    // fast-forwards
+    SessionConfig sessionConfig = config.session;
+    sessionConfig.emulationThread = false;
+    sessionConfig.fastForwardBytesPerSec = 0;
+    sessionConfig.hostPipe.clear();
+
+    m_session.SetExitCallback([this](DWORD exitCode) {
+        m_exitCode.store(exitCode);
+        m_exited.store(true);
+        SetEvent(m_wake.get());
+    });
+    if (!m_session.Start(sessionConfig)) {
+        return false;
+    }
+
+    m_acceptThread = std::thread([this]() { AcceptThreadProc(); });
+    return true;
+}
+
+DWORD SessionHost::Run() {
+    const HANDLE waits[] = {m_stop.get(), m_session.GetOutputEvent(), m_wake.get()};
+    while (WaitForMultipleObjects(ARRAYSIZE(waits), waits, FALSE, INFINITE) != WAIT_OBJECT_0) {
+        const bool exited = m_exited.load();
+        {
+            std::lock_guard<std::mutex> lock(m_screenLock);
+            if (const uint64_t resize = m_resizeRequest.exchange(0)) {
+                (void)m_session.Resize(static_cast<int>(resize & 0xFFFFFFFF), static_cast<int>(resize >> 32));
+            }
+            m_session.ProcessOutput();
+        }
+        ReapClients(false);
+
+        if (exited) {
+            m_finished.store(true);
+            NotifyClients();
+            break;
+        }
+        NotifyClients();
+    }
+
+    // The writers send the last frame and the exit code, then finish
+    if (m_finished.load()) {
+        const ULONGLONG deadline = GetTickCount64() + kGoodbyeMs;
+        for (;;) {
+            bool writing = false;
+            {
+                std::lock_guard<std::mutex> lock(m_clientsLock);
+                for (const auto& client : m_clients) {
+                    writing |= !client->done.load();
+                }
+            }
+            const ULONGLONG now = GetTickCount64();
+            if (!writing || now >= deadline) {
+                break;
+            }
+            WaitForSingleObject(m_wake.get(), static_cast<DWORD>(deadline - now));
+        }
+    }
+
+    Stop();
+    if (m_acceptThread.joinable()) {
+        m_acceptThread.join();
+    }
+    ReapClients(true);
+    return m_exitCode.load();
+}
+
+void SessionHost::Stop() {
+    if (m_stop) {
+        SetEvent(m_stop.get());
+    }
+    std::lock_guard<std::mutex> lock(m_clientsLock);
+    for (const auto& client : m_clients) {
+        SetEvent(client->cancel.get());
+    }
+}
+
+void SessionHost::AcceptThreadProc() {
+    while (wil::unique_hfile pipe = m_listener.Accept(m_stop.get())) {
+        AddClient(std::move(pipe));
+    }
+    m_listener.Close();
+}
+
+void SessionHost::AddClient(wil::unique_hfile pipe) {
+    std::lock_guard<std::mutex> lock(m_clientsLock);
+    if (m_clients.size() >= kMaxClients || WaitForSingleObject(m_stop.get(), 0) == WAIT_OBJECT_0) {
+        return;     // Closing the pipe turns the window away
+    }
+
+    auto client = std::make_unique<Client>();
+    if (!client->cancel.try_create(wil::EventOptions::ManualReset, nullptr) ||
+        !client->dirty.try_create(wil::EventOptions::None, nullptr)) {
+        return;
+    }
+    client->pipe = std::move(pipe);
+
+    // The first frame is the whole screen, sent straight away
+    SetEvent(client->dirty.get());
+    Client& added = *client;
+    m_clients.push_back(std::move(client));
+    added.reader = std::thread([this, &added]() { ReaderThreadProc(added); });
+    added.writer = std::thread([this, &added]() { WriterThreadProc(added); });
+}
+
+void SessionHost::ReaderThreadProc(Client& client) {
+    HostMessage type = HostMessage::Input;
+    std::string payload;
+    while (ReadHostMessage(client.pipe.get(), client.cancel.get(), type, payload)) {
+        switch (type) {
+        case HostMessage::Input:
+            (void)m_session.Write(payload.data(), payload.size());
+            break;
+        case HostMessage::Paste:
+            if (!payload.empty()) {
+                (void)m_session.Paste(std::string_view(payload).substr(1), payload[0] != 0);
+            }
+            break;
+        case HostMessage::Mouse: {
+            Emulation::MouseEvent event;
+            if (DecodeHostMouse(payload, event)) {
+                m_session.QueueMouseInput(event);
+            }
+            break;
+        }
+        case HostMessage::Wait: {
+            HostWaitRequest request;
+            if (!DecodeHostWait(payload, request)) {
+                break;
+            }
+            // The host's next parse matches it and wakes the writer; an
+            // invalid one is answered straight away
+            ClientWait wait{request.id, m_session.WaitForOutput(request.query),
+                            GetTickCount64() + request.timeoutMs};
+            const bool invalid = !wait.wait;
+            {
+                std::lock_guard<std::mutex> lock(client.waitsLock);
+                client.waits.push_back(std::move(wait));
+            }
+            if (invalid) {
+                SetEvent(client.dirty.get());
+            }
+            break;
+        }
+        case HostMessage::Resize: {
+            int cols = 0;
+            int rows = 0;
+            if (DecodeHostResize(payload, cols, rows)) {
+                m_resizeRequest.store((static_cast<uint64_t>(rows) << 32) | static_cast<uint32_t>(cols));
+                SetEvent(m_wake.get());
+            }
+            break;
+        }
+        default:
+            break;  // Not for the host
+        }
+    }
+    SetEvent(client.cancel.get());
+}
+
+void SessionHost::WriterThreadProc(Client& client) {
+    std::string frame;
+    ULONGLONG lastFrame = 0;
+    const HANDLE waits[] = {client.dirty.get(), client.cancel.get()};
+    for (;;) {
+        const DWORD wait = WaitForMultipleObjects(ARRAYSIZE(waits), waits, FALSE, GetWaitTimeout(client));
+        if (wait == WAIT_TIMEOUT) {
+            if (!SendWaitResults(client, false)) {
+                break;
+            }
+            continue;
+        }
+        if (wait != WAIT_OBJECT_0) {
+            break;
+        }
+
+        // Changes until the interval is up go in the same frame
+        const ULONGLONG since = GetTickCount64() - lastFrame;
+        if (since < kFrameIntervalMs &&
+            WaitForSingleObject(client.cancel.get(), static_cast<DWORD>(kFrameIntervalMs - since)) != WAIT_TIMEOUT) {
+            break;
+        }
+
+        frame.clear();
+        bool finished = false;
+        {
+            std::lock_guard<std::mutex> lock(m_screenLock);
+            finished = m_finished.load();
+            if (const TerminalBuffer* buffer = m_session.GetBuffer()) {
+                (void)client.encoder.Encode(*buffer, GetScreenState(), frame);
+            }
+        }
+        lastFrame = GetTickCount64();
+
+        if (!frame.empty() && !WriteHostMessage(client.pipe.get(), client.cancel.get(), HostMessage::Frame, frame)) {
+            break;
+        }
+        if (!SendWaitResults(client, finished)) {
+            break;
+        }
+        if (finished) {
+            (void)WriteHostMessage(client.pipe.get(), client.cancel.get(), HostMessage::Exit,
+                                   EncodeHostExit(m_exitCode.load()));
+            break;
+        }
+    }
+    SetEvent(client.cancel.get());
+    client.done.store(true);
+    SetEvent(m_wake.get());
+}
+
+DWORD SessionHost::GetWaitTimeout(Client& client) {
+    std::lock_guard<std::mutex> lock(client.waitsLock);
+    if (client.waits.empty()) {
+        return INFINITE;
+    }
+    ULONGLONG first = client.waits.front().deadline;
+    for (const ClientWait& wait : client.waits) {
+        first = std::min(first, wait.deadline);
+    }
+    const ULONGLONG now = GetTickCount64();
+    return first > now ? static_cast<DWORD>(std::min<ULONGLONG>(first - now, INFINITE - 1)) : 0;
+}
+
+bool SessionHost::SendWaitResults(Client& client, bool finished) {
+    std::vector<HostWaitResult> results;
+    {
+        std::lock_guard<std::mutex> lock(client.waitsLock);
+        const ULONGLONG now = GetTickCount64();
+        for (auto it = client.waits.begin(); it != client.waits.end();) {
+            HostWaitResult result;
+            result.id = it->id;
+            if (!it->wait) {
+                result.status = HostWaitStatus::Invalid;
+            } else if (it->wait->GetState() == OutputWait::State::Matched) {
+                result.status = HostWaitStatus::Matched;
+                result.match = it->wait->GetMatch();
+            } else if (finished || now >= it->deadline) {
+                it->wait->Cancel();
+                result.status = finished ? HostWaitStatus::Exited : HostWaitStatus::TimedOut;
+            } else {
+                ++it;
+                continue;
+            }
+            results.push_back(std::move(result));
+            it = client.waits.erase(it);
+        }
+    }
+    for (const HostWaitResult& result : results) {
+        if (!WriteHostMessage(client.pipe.get(), client.cancel.get(), HostMessage::WaitResult,
+                              EncodeHostWaitResult(result))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+ScreenState SessionHost::GetScreenState() const {
+    ScreenState state;
+    const Emulation::VTermWrapper* vterm = m_session.GetVTerm();
+    if (!vterm) {
+        return state;
+    }
+    const Emulation::TermProps& props = vterm->GetProps();
+    vterm->GetCursorPos(state.cursorRow, state.cursorCol);
+    state.cursorVisible = props.cursorVisible;
+    state.applicationCursor = props.applicationCursor;
+    state.applicationKeypad = props.applicationKeypad;
+    state.altScreen = props.altScreen;
+    state.mouseMode = props.mouseMode;
+    state.title = ToUtf8(props.title);
+    return state;
+}
+
+void SessionHost::NotifyClients() {
+    std::lock_guard<std::mutex> lock(m_clientsLock);
+    for (const auto& client : m_clients) {
+        SetEvent(client->dirty.get());
+    }
+}
+
+void SessionHost::ReapClients(bool all) {
+    std::vector<std::unique_ptr<Client>> reaped;
+    {
+        std::lock_guard<std::mutex> lock(m_clientsLock);
+        for (auto it = m_clients.begin(); it != m_clients.end();) {
+            if (all || (*it)->done.load()) {
+                SetEvent((*it)->cancel.get());
+                reaped.push_back(std::move(*it));
+                it = m_clients.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (const auto& client : reaped) {
+        client->reader.join();
+        client->writer.join();
+        for (const ClientWait& wait : client->waits) {
+            if (wait.wait) {
+                wait.wait->Cancel();
+            }
+        }
+    }
+}
+
+} // namespace Console3::Core
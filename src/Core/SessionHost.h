@@ -0,0 +1,131 @@
+#pragma once
+// Console3 - SessionHost.h
+// A session that outlives its window: served on a named pipe to attachers
+//
+// "Console3.exe --host NAME" runs a shell headless: the host owns the
+// Session (PTY, emulator and buffer) and serves it on a named pipe (see
+// HostProtocol). Windows attach with "--attach NAME", send input and
+// resizes, and are sent screen frames (ScreenDelta) of what changed since
+// the frame before. A window that closes or crashes leaves the shell
+// running, and attaching again sends it the current screen in one frame.
+//
+// The host's thread parses output and applies resizes (the latest from any
+// window wins). Each window has a reader thread, which passes its input
+// straight to the session, and a writer thread, which encodes a frame when
+// the screen changed, at most one per kFrameIntervalMs: a window on a slow
+// link is sent fewer frames, each covering more change, rather than
+// falling behind. Encoding reads the buffer under the same lock as parsing.
+// A window's waits for text are session waits (Session::WaitForOutput),
+// matched as the host parses; the writer answers them after the frame.
+//
+// The pipe admits only the user running the host. Windows on other
+// machines are turned away unless allowRemote is set.
+
+#include <Windows.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <wil/resource.h>
+
+#include "Core/PipeListener.h"
+#include "Core/ScreenDelta.h"
+#include "Core/Session.h"
+
+namespace Console3::Core {
+
+/// Session host configuration
+struct SessionHostConfig {
+    std::wstring name;              ///< Pipe name (GetHostPipePath)
+    bool allowRemote = false;       ///< Accept windows on other machines
+    SessionConfig session;
+};
+
+/// Serves a session to attached windows until its shell exits
+class SessionHost {
+public:
+    static constexpr size_t kMaxClients = 8;
+    static constexpr DWORD kFrameIntervalMs = 16;
+
+    SessionHost() = default;
+    ~SessionHost();
+
+    SessionHost(const SessionHost&) = delete;
+    SessionHost& operator=(const SessionHost&) = delete;
+
+    /// Claim the pipe name and start the shell
+    /// @return false if the name is taken or the shell did not start
+    [[nodiscard]] bool Start(const SessionHostConfig& config);
+
+    /// Serve windows until the shell exits or Stop() is called
+    /// @return The shell's exit code
+    DWORD Run();
+
+    /// Make Run() return (any thread)
+    void Stop();
+
+private:
+    /// A window's wait for text
+    struct ClientWait {
+        uint32_t id = 0;
+        std::shared_ptr<OutputWait> wait;   ///< Null if the pattern can't match
+        ULONGLONG deadline = 0;             ///< GetTickCount64()
+    };
+
+    struct Client {
+        wil::unique_hfile pipe;
+        wil::unique_event cancel;   ///< Ends both threads
+        wil::unique_event dirty;    ///< The screen changed
+        ScreenDeltaEncoder encoder;
+        std::thread reader;
+        std::thread writer;
+        std::atomic<bool> done{false};
+        std::mutex waitsLock;
+        std::vector<ClientWait> waits;      ///< Guarded by waitsLock
+    };
+
+    /// Serve a connected pipe
+    void AddClient(wil::unique_hfile pipe);
+
+    void AcceptThreadProc();
+    void ReaderThreadProc(Client& client);
+    void WriterThreadProc(Client& client);
+
+    /// Get the time to the first wait's deadline (writer thread)
+    [[nodiscard]] DWORD GetWaitTimeout(Client& client);
+
+    /// Answer the waits that completed or timed out (writer thread)
+    /// @param finished The shell exited: answer the rest too
+    /// @return false on a broken pipe
+    [[nodiscard]] bool SendWaitResults(Client& client, bool finished);
+
+    /// Screen state for frames (with m_screenLock held)
+    [[nodiscard]] ScreenState GetScreenState() const;
+
+    /// Mark the screen changed for every window
+    void NotifyClients();
+
+    /// Join and drop the clients that are done (or all of them)
+    void ReapClients(bool all);
+
+    SessionHostConfig m_config;
+    Session m_session;
+    PipeListener m_listener;
+    wil::unique_event m_stop;       ///< Manual reset
+    wil::unique_event m_wake;       ///< Resize queued, client done, shell exited
+    std::thread m_acceptThread;
+
+    std::mutex m_screenLock;        ///< Parsing vs encoding
+    std::mutex m_clientsLock;
+    std::vector<std::unique_ptr<Client>> m_clients;
+
+    std::atomic<uint64_t> m_resizeRequest{0};   ///< rows << 32 | cols (0 = none)
+    std::atomic<bool> m_exited{false};         ///< The shell exited
+    std::atomic<bool> m_finished{false};       ///< Its last output is parsed: the next frame is the last
+    std::atomic<DWORD> m_exitCode{0};
+};
+
+} // namespace Console3::Core
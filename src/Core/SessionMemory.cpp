@@ -0,0 +1,45 @@
+// Console3 - SessionMemory.cpp
+// Memory a session holds, by owner
+
+#include "Core/SessionMemory.h"
+#include <cwchar>
+
+namespace Console3::Core {
+
+std::wstring FormatBytes(uint64_t bytes) {
+    wchar_t text[32];
+    if (bytes >= 1024ull * 1024 * 1024) {
+        swprintf_s(text, L"%.2f GB", bytes / (1024.0 * 1024.0 * 1024.0));
+    } else if (bytes >= 1024ull * 1024) {
+        swprintf_s(text, L"%.2f MB", bytes / (1024.0 * 1024.0));
+    } else if (bytes >= 1024) {
+        swprintf_s(text, L"%.1f KB", bytes / 1024.0);
+    } else {
+        swprintf_s(text, L"%llu B", static_cast<unsigned long long>(bytes));
+    }
+    return text;
+}
+
+std::wstring FormatSessionMemory(const SessionMemory& memory, std::wstring_view indent) {
+    std::wstring report;
+    const auto line = [&](const wchar_t* name, uint64_t bytes, const wchar_t* note = L"") {
+        wchar_t text[96];
+        swprintf_s(text, L"%-12s %12s%s\r\n", name, FormatBytes(bytes).c_str(), note);
+        report.append(indent);
+        report.append(text);
+    };
+
+    line(L"total", memory.GetResidentBytes(), L"  (in memory)");
+    line(L"screen", memory.screenBytes);
+    line(L"scrollback", memory.scrollbackHotBytes, L"  (rows)");
+    line(L"", memory.scrollbackColdBytes, L"  (compressed)");
+    line(L"", memory.scrollbackDiskBytes, L"  (on disk, not in total)");
+    line(L"images", memory.imageBytes);
+    line(L"output ring", memory.ringBytes);
+    line(L"libvterm", memory.vtermBytes);
+    line(L"frames", memory.frameBytes, L"  (video memory)");
+    line(L"glyph atlas", memory.atlasBytes, L"  (video memory, share)");
+    return report;
+}
+
+} // namespace Console3::Core
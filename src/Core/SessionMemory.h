@@ -0,0 +1,54 @@
+#pragma once
+// Console3 - SessionMemory.h
+// Memory a session holds, by owner
+//
+// SessionStats says how busy a session is; this says what it costs to keep.
+// The session fills in what it owns - the terminal buffer's screens, the
+// scrollback in each of its tiers, decoded images, the output ring and
+// libvterm - and the view adds what rendering keeps for it: the retained
+// frames and a share of the glyph atlas, which windows with the same font
+// share.
+//
+// Sizes are of the storage reserved, not of the content: a screen costs its
+// full rows * cols whatever is on it, and the ring costs the chunks it holds
+// even when drained. The spill file is on disk and not part of the total.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace Console3::Core {
+
+/// Snapshot returned by Session::GetMemory() (see file comment)
+struct SessionMemory {
+    // Terminal buffer
+    size_t screenBytes = 0;           ///< Both screens (primary and alternate) and their row state
+    size_t scrollbackHotBytes = 0;    ///< History kept as rows
+    size_t scrollbackColdBytes = 0;   ///< History encoded and compressed in memory
+    uint64_t scrollbackDiskBytes = 0; ///< History in the spill file (not resident)
+    size_t imageBytes = 0;            ///< Decoded inline images (ImageStore)
+
+    // Output pipeline
+    size_t ringBytes = 0;             ///< Output ring chunks held
+    size_t vtermBytes = 0;            ///< libvterm's screen and state
+
+    // Rendering (filled in by the view)
+    size_t frameBytes = 0;            ///< Retained frames (video memory)
+    size_t atlasBytes = 0;            ///< Share of the glyph atlas (video memory)
+
+    /// Get the bytes held in memory (everything but the spill file)
+    [[nodiscard]] size_t GetResidentBytes() const noexcept {
+        return screenBytes + scrollbackHotBytes + scrollbackColdBytes + imageBytes + ringBytes +
+               vtermBytes + frameBytes + atlasBytes;
+    }
+};
+
+/// Format a byte count ("512 B", "1.5 KB", "12.34 MB")
+[[nodiscard]] std::wstring FormatBytes(uint64_t bytes);
+
+/// Format a snapshot as a report, one owner per line
+/// @param indent Put before each line
+[[nodiscard]] std::wstring FormatSessionMemory(const SessionMemory& memory, std::wstring_view indent = {});
+
+} // namespace Console3::Core
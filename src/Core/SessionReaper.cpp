@@ -0,0 +1,82 @@
+// Console3 - SessionReaper.cpp
+// Tears down closed sessions off the UI thread
+
+#include "Core/SessionReaper.h"
+
+#include "Core/Session.h"
+
+namespace Console3::Core {
+
+namespace {
+
+/// One teardown, owned by its thread pool callback
+struct RetiredSession {
+    SessionReaper* reaper = nullptr;
+    std::unique_ptr<Session> session;
+};
+
+} // namespace
+
+SessionReaper::~SessionReaper() {
+    Drain();
+}
+
+SessionReaper& SessionReaper::Shared() {
+    static SessionReaper s_instance;
+    return s_instance;
+}
+
+void SessionReaper::Retire(std::unique_ptr<Session> session) {
+    if (!session) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (!m_draining) {
+            auto retired = std::make_unique<RetiredSession>();
+            retired->reaper = this;
+            retired->session = std::move(session);
+            if (TrySubmitThreadpoolCallback(&SessionReaper::TearDown, retired.get(), nullptr)) {
+                (void)retired.release();
+                ++m_pending;
+                return;
+            }
+            session = std::move(retired->session);
+        }
+    }
+
+    session->Stop();
+}
+
+void SessionReaper::Drain() {
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_draining = true;
+    m_idle.wait(lock, [this]() { return m_pending == 0; });
+}
+
+size_t SessionReaper::GetPendingCount() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_pending;
+}
+
+void CALLBACK SessionReaper::TearDown(PTP_CALLBACK_INSTANCE instance, void* context) {
+    std::unique_ptr<RetiredSession> retired(static_cast<RetiredSession*>(context));
+
+    // Closing a pseudo console blocks until conhost exits; let the pool
+    // add threads rather than queue other work behind it
+    (void)CallbackMayRunLong(instance);
+
+    retired->session->Stop();
+    retired->session.reset();
+
+    // Notified under the lock: Drain() can't return (and the reaper be
+    // destroyed at exit) until this callback is done with it
+    SessionReaper* reaper = retired->reaper;
+    std::lock_guard<std::mutex> lock(reaper->m_lock);
+    if (--reaper->m_pending == 0) {
+        reaper->m_idle.notify_all();
+    }
+}
+
+} // namespace Console3::Core
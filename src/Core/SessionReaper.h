@@ -0,0 +1,70 @@
+#pragma once
+// Console3 - SessionReaper.h
+// Tears down closed sessions off the UI thread
+//
+// Stopping a session closes its pseudo console (ClosePseudoConsole waits
+// for conhost to drain and exit), terminates the shell, joins the
+// transport, input writer and emulation threads and frees the rings and
+// scrollback; with a busy shell that takes from tens of milliseconds to
+// seconds, and closing many windows at once took that many times over. A
+// window hands its session here instead and is gone at once: each session
+// is torn down on the system thread pool, in parallel with any others.
+//
+// A retired session must not call into its old owner. The owner clears
+// the callbacks that run on its own thread before retiring it; the exit
+// callback, which the transport thread may still run, must only post to a
+// window handle. Drain() waits for the teardowns still running before the
+// process exits.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+
+namespace Console3::Core {
+
+class Session;
+
+/// Stops and destroys sessions in the background
+class SessionReaper {
+public:
+    SessionReaper() = default;
+    ~SessionReaper();
+
+    // Non-copyable, non-movable (teardowns in flight point at it)
+    SessionReaper(const SessionReaper&) = delete;
+    SessionReaper& operator=(const SessionReaper&) = delete;
+
+    /// Get the process-wide reaper
+    static SessionReaper& Shared();
+
+    /// Take a session to stop and destroy
+    /// Torn down on the calling thread if the thread pool won't take it,
+    /// or once Drain() has been called.
+    void Retire(std::unique_ptr<Session> session);
+
+    /// Wait for every teardown in flight; later ones run synchronously
+    void Drain();
+
+    /// Get the number of sessions still being torn down
+    [[nodiscard]] size_t GetPendingCount() const;
+
+private:
+    /// Thread pool callback: tear down one session
+    static void CALLBACK TearDown(PTP_CALLBACK_INSTANCE instance, void* context);
+
+    mutable std::mutex m_lock;
+    std::condition_variable m_idle;
+    size_t m_pending = 0;
+    bool m_draining = false;
+};
+
+} // namespace Console3::Core
@@ -0,0 +1,311 @@
+// Console3 - SessionScheduler.cpp
+// Shared pool of emulation workers for all sessions
+
+#include "Core/SessionScheduler.h"
+#include "Core/ThreadPolicy.h"
+#include <algorithm>
+
+namespace Console3::Core {
+
+namespace {
+
+// Task states
+constexpr uint8_t kIdle = 0;
+constexpr uint8_t kQueued = 1;      ///< In a queue
+constexpr uint8_t kRunning = 2;     ///< In a slice
+constexpr uint8_t kRerun = 3;       ///< In a slice, and woken since it began
+
+// The UI thread keeps a core; the pool never grows past this
+constexpr size_t kMaxWorkers = 16;
+
+constexpr size_t kNotAWorker = static_cast<size_t>(-1);
+
+/// Index of the pool worker running on this thread
+thread_local size_t t_worker = kNotAWorker;
+
+/// QoS the worker on this thread last set (it follows the slice's session)
+thread_local ThreadQos t_qos = ThreadQos::Default;
+
+} // namespace
+
+struct SessionScheduler::Task {
+    SliceProc proc;
+    std::atomic<SessionPriority> priority{SessionPriority::Visible};
+    std::atomic<uint8_t> state{kIdle};
+    std::atomic<bool> removed{false};
+
+    /// Claim an idle task for a queue
+    bool MarkQueued() noexcept {
+        uint8_t expected = kIdle;
+        return state.compare_exchange_strong(expected, kQueued);
+    }
+};
+
+// ============================================================================
+// SessionScheduler
+// ============================================================================
+
+SessionScheduler& SessionScheduler::Instance() {
+    static SessionScheduler s_instance;
+    return s_instance;
+}
+
+SessionScheduler::SessionScheduler() {
+    const size_t cores = std::max<size_t>(std::thread::hardware_concurrency(), 2);
+    const size_t workerCount = std::min(cores - 1, kMaxWorkers);
+
+    for (size_t i = 0; i < workerCount; ++i) {
+        m_queues.push_back(std::make_unique<WorkQueue>());
+    }
+    for (size_t i = 0; i < workerCount; ++i) {
+        m_workers.emplace_back(&SessionScheduler::WorkerProc, this, i);
+    }
+}
+
+SessionScheduler::~SessionScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stop = true;
+    }
+    m_idle.notify_all();
+    for (std::thread& worker : m_workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+SessionScheduler::Task* SessionScheduler::Register(SliceProc proc, SessionPriority priority) {
+    try {
+        auto task = std::make_unique<Task>();
+        task->proc = std::move(proc);
+        task->priority.store(priority);
+        return task.release();
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void SessionScheduler::Unregister(Task* task) {
+    if (!task) {
+        return;
+    }
+
+    // A queued task is taken and dropped by the next worker to reach it
+    task->removed.store(true);
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+        std::erase_if(m_timers, [task](const auto& timer) { return timer.second == task; });
+        m_done.wait(lock, [task] { return task->state.load() == kIdle; });
+    }
+    delete task;
+}
+
+void SessionScheduler::Wake(Task* task) {
+    if (!task || task->removed.load()) {
+        return;
+    }
+
+    // Batched, an idle background task runs when its timer fires
+    const uint32_t batchMs = m_batchMs.load();
+    if (batchMs > 0 && task->priority.load() == SessionPriority::Background &&
+        task->state.load() == kIdle) {
+        Defer(task, batchMs);
+        return;
+    }
+
+    uint8_t state = task->state.load();
+    for (;;) {
+        if (state == kIdle) {
+            if (task->state.compare_exchange_weak(state, kQueued)) {
+                break;
+            }
+        } else if (state == kRunning) {
+            // The worker running it queues it again when the slice ends
+            if (task->state.compare_exchange_weak(state, kRerun)) {
+                return;
+            }
+        } else {
+            return;
+        }
+    }
+
+    Push(task);
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+    }
+    m_idle.notify_one();
+}
+
+void SessionScheduler::SetPriority(Task* task, SessionPriority priority) {
+    if (task) {
+        task->priority.store(priority);
+    }
+}
+
+void SessionScheduler::Defer(Task* task, uint32_t milliseconds) {
+    const Clock::time_point due = Clock::now() + std::chrono::milliseconds(milliseconds);
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        const auto it = std::find_if(m_timers.begin(), m_timers.end(),
+                                     [task](const auto& timer) { return timer.second == task; });
+        if (it != m_timers.end()) {
+            if (it->first <= due) {
+                return;
+            }
+            it->first = due;
+        } else {
+            m_timers.emplace_back(due, task);
+        }
+        m_timerAdded = true;
+    }
+    // An idle worker waits with no deadline; it looks at the timers again
+    m_idle.notify_one();
+}
+
+void SessionScheduler::Push(Task* task) {
+    WorkQueue* queue = &m_focused;
+    if (task->priority.load() != SessionPriority::Focused) {
+        // A worker keeps what it wakes or requeues; other threads spread
+        // tasks over the workers
+        const size_t index = t_worker != kNotAWorker ? t_worker
+                                                     : m_nextQueue.fetch_add(1) % m_queues.size();
+        queue = m_queues[index].get();
+    }
+
+    std::lock_guard<std::mutex> lock(queue->lock);
+    queue->tasks.push_back(task);
+    m_queued.fetch_add(1);
+}
+
+SessionScheduler::Task* SessionScheduler::Take(size_t worker) {
+    if (m_queued.load() == 0) {
+        return nullptr;
+    }
+
+    const auto takeFront = [this](WorkQueue& queue) -> Task* {
+        std::lock_guard<std::mutex> lock(queue.lock);
+        if (queue.tasks.empty()) {
+            return nullptr;
+        }
+        Task* task = queue.tasks.front();
+        queue.tasks.pop_front();
+        m_queued.fetch_sub(1);
+        return task;
+    };
+
+    if (Task* task = takeFront(m_focused)) {
+        return task;
+    }
+    if (Task* task = takeFront(*m_queues[worker])) {
+        return task;
+    }
+
+    // Steal the task its owner would get to last
+    for (size_t i = 1; i < m_queues.size(); ++i) {
+        WorkQueue& victim = *m_queues[(worker + i) % m_queues.size()];
+        std::lock_guard<std::mutex> lock(victim.lock);
+        if (!victim.tasks.empty()) {
+            Task* task = victim.tasks.back();
+            victim.tasks.pop_back();
+            m_queued.fetch_sub(1);
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+void SessionScheduler::Run(Task* task) {
+    task->state.store(kRunning);
+
+    SliceResult result;
+    if (!task->removed.load()) {
+        const SessionPriority priority = task->priority.load();
+        const uint64_t budget = priority == SessionPriority::Focused ? kFocusedSliceMicros
+                              : priority == SessionPriority::Visible ? kVisibleSliceMicros
+                              : m_batchMs.load() > 0                 ? kBatchedSliceMicros
+                                                                     : kBackgroundSliceMicros;
+        const ThreadQos qos = ThreadPolicy::ForSession(priority);
+        if (qos != t_qos) {
+            (void)ThreadPolicy::SetCurrentQos(qos);
+            t_qos = qos;
+        }
+        result = task->proc(budget);
+    }
+
+    if (result.timerMs != SliceResult::kNoTimer) {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (!task->removed.load()) {
+            std::erase_if(m_timers, [task](const auto& timer) { return timer.second == task; });
+            m_timers.emplace_back(Clock::now() + std::chrono::milliseconds(result.timerMs), task);
+        }
+    }
+
+    // Unfinished work waits behind the other tasks; idle workers may take it
+    if (result.more && !task->removed.load()) {
+        task->state.store(kQueued);
+        Push(task);
+        m_idle.notify_one();
+        return;
+    }
+
+    // Going idle under the lock Unregister() waits with: once it can see
+    // the task idle, the task is not touched here again
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        uint8_t expected = kRunning;
+        if (task->removed.load() || task->state.compare_exchange_strong(expected, kIdle)) {
+            task->state.store(kIdle);
+            m_done.notify_all();
+            return;
+        }
+    }
+
+    // Woken during the slice: there is new work
+    task->state.store(kQueued);
+    Push(task);
+}
+
+SessionScheduler::Clock::time_point SessionScheduler::FireTimers() {
+    const Clock::time_point now = Clock::now();
+    Clock::time_point next = Clock::time_point::max();
+    for (auto it = m_timers.begin(); it != m_timers.end();) {
+        if (it->first > now) {
+            next = std::min(next, it->first);
+            ++it;
+            continue;
+        }
+        // The caller is a worker about to look for work: no one to notify
+        if (it->second->MarkQueued()) {
+            Push(it->second);
+        }
+        it = m_timers.erase(it);
+    }
+    return next;
+}
+
+void SessionScheduler::WorkerProc(size_t worker) {
+    t_worker = worker;
+
+    for (;;) {
+        if (Task* task = Take(worker)) {
+            Run(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_lock);
+        if (m_stop) {
+            return;
+        }
+        const Clock::time_point next = FireTimers();
+        m_timerAdded = false;
+        const auto ready = [this] { return m_stop || m_queued.load() > 0 || m_timerAdded; };
+        if (next == Clock::time_point::max()) {
+            m_idle.wait(lock, ready);
+        } else {
+            m_idle.wait_until(lock, next, ready);
+        }
+    }
+}
+
+} // namespace Console3::Core
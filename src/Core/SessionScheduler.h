@@ -0,0 +1,152 @@
+#pragma once
+// Console3 - SessionScheduler.h
+// Shared pool of emulation workers for all sessions
+//
+// With an emulation thread of its own per session, tabs compete for the
+// CPU with nothing to arbitrate: one tab flooding output keeps its thread
+// busy parsing while the visible tab's echo waits for a core like any
+// other thread. Sessions in scheduler mode instead register a task with a
+// process-wide pool of about one worker per core. Output arriving (or a
+// resize) wakes the task; a worker runs it for one time slice, whose
+// budget depends on the session's priority, and a task with output left
+// over goes to the back of the queue, so every busy tab gets its turn.
+//
+// Focused sessions go to a shared queue that every worker looks at first.
+// The others go to the queue of the worker that woke them (or are spread
+// over the workers), and idle workers steal from the back of busy workers'
+// queues, so many busy tabs spread across cores. A task is never run by
+// two workers at once: waking a running task only marks it to run again.
+//
+// Background sessions also defer materializing their screen (Session's
+// part): they parse everything, but sync no cells until shown again.
+//
+// To save power (on battery), background sessions can be batched
+// (SetBackgroundBatching): output waking one sets a timer instead of
+// queueing it, and the slice it then gets is a focused one's, so a hidden
+// tab's output is parsed in a few larger runs instead of a wakeup each.
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace Console3::Core {
+
+/// Scheduling priority of a session
+enum class SessionPriority : uint8_t {
+    Background,     ///< Not shown: smallest slices, screen deferred
+    Visible,        ///< Shown but not focused
+    Focused         ///< Has the keyboard: runs first, largest slices
+};
+
+/// Outcome of one time slice
+struct SliceResult {
+    static constexpr uint32_t kNoTimer = 0xFFFFFFFF;
+
+    bool more = false;                  ///< Work is left; run again after the others
+    uint32_t timerMs = kNoTimer;        ///< Run again after this long even if not woken
+};
+
+/// Process-wide pool that runs sessions' emulation (see file comment)
+class SessionScheduler {
+public:
+    /// Runs one slice of a session's work within a budget in microseconds
+    using SliceProc = std::function<SliceResult(uint64_t budgetMicros)>;
+
+    /// A registered session (opaque)
+    struct Task;
+
+    /// Slice budgets by priority, in microseconds
+    static constexpr uint64_t kFocusedSliceMicros = 8000;
+    static constexpr uint64_t kVisibleSliceMicros = 4000;
+    static constexpr uint64_t kBackgroundSliceMicros = 1000;
+    static constexpr uint64_t kBatchedSliceMicros = 8000;  ///< Background, while batched
+
+    /// Get the shared instance (created on first use)
+    static SessionScheduler& Instance();
+
+    ~SessionScheduler();
+
+    // Non-copyable, non-movable
+    SessionScheduler(const SessionScheduler&) = delete;
+    SessionScheduler& operator=(const SessionScheduler&) = delete;
+    SessionScheduler(SessionScheduler&&) = delete;
+    SessionScheduler& operator=(SessionScheduler&&) = delete;
+
+    /// Register a session's slice procedure (not run until woken)
+    /// @return The task, or nullptr if out of memory
+    [[nodiscard]] Task* Register(SliceProc proc, SessionPriority priority);
+
+    /// Wait for a task's slice in progress to end and free it
+    /// The task must no longer be woken from other threads.
+    void Unregister(Task* task);
+
+    /// Have a task run (any thread; cheap when it is already queued or running)
+    void Wake(Task* task);
+
+    /// Change a task's priority; takes effect from its next slice
+    void SetPriority(Task* task, SessionPriority priority);
+
+    /// Run woken background tasks only after this long, in larger slices
+    /// (see file comment)
+    /// @param milliseconds Delay (0 = run them when woken)
+    void SetBackgroundBatching(uint32_t milliseconds) noexcept { m_batchMs.store(milliseconds); }
+
+    /// Get the number of worker threads
+    [[nodiscard]] size_t GetWorkerCount() const noexcept { return m_workers.size(); }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    /// One worker's queue; the owner takes from the front, thieves from the back
+    struct WorkQueue {
+        std::mutex lock;
+        std::deque<Task*> tasks;
+    };
+
+    SessionScheduler();
+
+    /// Queue a task marked queued
+    void Push(Task* task);
+
+    /// Take the next task for a worker: focused first, then its own, then stolen
+    [[nodiscard]] Task* Take(size_t worker);
+
+    /// Run a task's slice and requeue or idle it
+    void Run(Task* task);
+
+    /// Set a task's timer to run it in a batch, unless one is due sooner
+    void Defer(Task* task, uint32_t milliseconds);
+
+    /// Wake the tasks whose timers are due
+    /// @return When the next timer is due (Clock::time_point::max() if none)
+    Clock::time_point FireTimers();
+
+    /// Worker thread procedure
+    void WorkerProc(size_t worker);
+
+private:
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;  ///< One per worker
+    WorkQueue m_focused;                    ///< Focused tasks, ahead of all others
+    std::atomic<size_t> m_queued{0};        ///< Tasks in all queues
+    std::atomic<size_t> m_nextQueue{0};     ///< Round robin for wakes from outside the pool
+
+    std::mutex m_lock;                      ///< Guards idling and the timers
+    std::condition_variable m_idle;         ///< Workers wait here for work
+    std::condition_variable m_done;         ///< Unregister() waits here for a slice to end
+    std::vector<std::pair<Clock::time_point, Task*>> m_timers;
+    bool m_timerAdded = false;              ///< A timer was set from outside the pool
+    bool m_stop = false;
+    std::atomic<uint32_t> m_batchMs{0};     ///< From SetBackgroundBatching
+
+    std::vector<std::thread> m_workers;
+};
+
+} // namespace Console3::Core
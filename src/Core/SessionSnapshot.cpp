@@ -0,0 +1,787 @@
+// Console3 - SessionSnapshot.cpp
+// Keeps sessions' screens and history on disk, and maps them back at startup
+
+#include "Core/SessionSnapshot.h"
+#include "Core/TerminalBuffer.h"
+#include "Core/ThreadPolicy.h"
+#include "Core/Varint.h"
+
+#include <ShlObj.h>
+#include <lz4.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <utility>
+
+namespace Console3::Core {
+
+namespace {
+
+// File layout (little-endian, as written):
+//   manifest: "C3SM", version, session count, then per session: history
+//     file id, complete history bytes, rows, cols, scrollback limit, shell,
+//     args, working directory, title and profile (u32 length + UTF-16),
+//     screen lines, raw and stored size, screen bytes
+//   history:  "C3SH", version, then chunks of: lines, raw and stored size,
+//     bytes (LZ4, or raw if that was no larger)
+//   lines:    varint cols << 1 | continuation, varint cells used, varint
+//     spans; spans of varint length, fg rgba, bg rgba, attrBits, width;
+//     per used cell varint codepoint << 2 | combining count, then the
+//     combining characters as varints
+constexpr char kManifestMagic[4] = {'C', '3', 'S', 'M'};
+constexpr char kHistoryMagic[4] = {'C', '3', 'S', 'H'};
+constexpr wchar_t kManifestName[] = L"sessions.c3m";
+constexpr wchar_t kManifestTempName[] = L"sessions.c3m.tmp";
+constexpr wchar_t kHistoryExtension[] = L".c3h";
+constexpr size_t kHistoryHeaderBytes = sizeof(kHistoryMagic) + sizeof(uint32_t);
+
+/// Widest line accepted from a file
+constexpr uint32_t kMaxLineCells = 1u << 16;
+
+/// Largest chunk or screen accepted from a file (raw bytes)
+constexpr uint32_t kMaxRawBytes = 64u << 20;
+
+template <typename T>
+void Put(std::vector<char>& out, T value) {
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(value));
+}
+
+void PutString(std::vector<char>& out, const std::wstring& text) {
+    Put(out, static_cast<uint32_t>(text.size()));
+    const char* bytes = reinterpret_cast<const char*>(text.data());
+    out.insert(out.end(), bytes, bytes + text.size() * sizeof(wchar_t));
+}
+
+void PutColor(std::vector<char>& out, const CellColor& color) {
+    out.push_back(static_cast<char>(color.r));
+    out.push_back(static_cast<char>(color.g));
+    out.push_back(static_cast<char>(color.b));
+    out.push_back(static_cast<char>(color.flags));
+}
+
+/// Reads a byte range; any read past its end fails this and every later read
+class Reader {
+public:
+    explicit Reader(std::span<const char> bytes) noexcept
+        : m_p(bytes.data()), m_end(bytes.data() + bytes.size()) {}
+
+    [[nodiscard]] bool Ok() const noexcept { return m_ok; }
+    [[nodiscard]] bool AtEnd() const noexcept { return !m_ok || m_p == m_end; }
+
+    template <typename T>
+    T Get() noexcept {
+        T value{};
+        if (Need(sizeof(T))) {
+            std::memcpy(&value, m_p, sizeof(T));
+            m_p += sizeof(T);
+        }
+        return value;
+    }
+
+    uint32_t GetVarint() noexcept {
+        uint64_t value = 0;
+        size_t pos = 0;
+        if (!m_ok || !Core::GetVarint(std::string_view(m_p, static_cast<size_t>(m_end - m_p)), pos, value) ||
+            value > UINT32_MAX) {
+            m_ok = false;
+            return 0;
+        }
+        m_p += pos;
+        return static_cast<uint32_t>(value);
+    }
+
+    std::span<const char> GetBytes(size_t size) noexcept {
+        if (!Need(size)) {
+            return {};
+        }
+        const std::span<const char> bytes(m_p, size);
+        m_p += size;
+        return bytes;
+    }
+
+    std::wstring GetString() {
+        const auto length = Get<uint32_t>();
+        const std::span<const char> bytes = GetBytes(static_cast<size_t>(length) * sizeof(wchar_t));
+        std::wstring text(bytes.size() / sizeof(wchar_t), L'\0');
+        std::memcpy(text.data(), bytes.data(), bytes.size());
+        return text;
+    }
+
+    CellColor GetColor() noexcept {
+        const std::span<const char> bytes = GetBytes(4);
+        CellColor color;
+        if (!bytes.empty()) {
+            color.r = static_cast<uint8_t>(bytes[0]);
+            color.g = static_cast<uint8_t>(bytes[1]);
+            color.b = static_cast<uint8_t>(bytes[2]);
+            color.flags = static_cast<uint8_t>(bytes[3]);
+        }
+        return color;
+    }
+
+private:
+    bool Need(size_t size) noexcept {
+        if (m_ok && static_cast<size_t>(m_end - m_p) < size) {
+            m_ok = false;
+        }
+        return m_ok;
+    }
+
+    const char* m_p;
+    const char* m_end;
+    bool m_ok = true;
+};
+
+/// Check if two cells share colors, attributes and width
+bool SameRunStyle(const Cell& a, const Cell& b) noexcept {
+    return a.fg == b.fg && a.bg == b.bg && a.attrBits == b.attrBits && a.width == b.width;
+}
+
+void EncodeLine(std::span<const Cell> cells, bool continuation, std::vector<char>& out) {
+    static const Cell blank{};
+    size_t used = cells.size();
+    while (used > 0 && cells[used - 1] == blank) {
+        --used;
+    }
+
+    size_t spans = 0;
+    for (size_t i = 0; i < used; ++i) {
+        if (i == 0 || !SameRunStyle(cells[i], cells[i - 1])) {
+            ++spans;
+        }
+    }
+
+    PutVarint(out, static_cast<uint32_t>(cells.size() << 1) | (continuation ? 1 : 0));
+    PutVarint(out, static_cast<uint32_t>(used));
+    PutVarint(out, static_cast<uint32_t>(spans));
+
+    for (size_t start = 0; start < used;) {
+        size_t end = start + 1;
+        while (end < used && SameRunStyle(cells[end], cells[start])) {
+            ++end;
+        }
+        const Cell& cell = cells[start];
+        PutVarint(out, static_cast<uint32_t>(end - start));
+        PutColor(out, cell.fg);
+        PutColor(out, cell.bg);
+        out.push_back(static_cast<char>(cell.attrBits));
+        out.push_back(static_cast<char>(cell.width));
+        start = end;
+    }
+
+    // Combining characters are spelled out: table indices are per process
+    for (size_t i = 0; i < used; ++i) {
+        const std::span<const uint32_t> combining = cells[i].Combining();
+        PutVarint(out, (cells[i].Codepoint() << 2) | static_cast<uint32_t>(combining.size()));
+        for (const uint32_t mark : combining) {
+            PutVarint(out, mark);
+        }
+    }
+}
+
+/// Decode one line
+/// @return false if the bytes are not a valid line
+bool DecodeLine(Reader& in, Row& out, bool& continuation) {
+    const uint32_t head = in.GetVarint();
+    const uint32_t cols = head >> 1;
+    const uint32_t used = in.GetVarint();
+    const uint32_t spans = in.GetVarint();
+    continuation = (head & 1) != 0;
+    if (!in.Ok() || cols > kMaxLineCells || used > cols || spans > used) {
+        return false;
+    }
+
+    out.assign(cols, Cell{});
+
+    uint32_t col = 0;
+    for (uint32_t span = 0; span < spans; ++span) {
+        const uint32_t length = in.GetVarint();
+        Cell style;
+        style.fg = in.GetColor();
+        style.bg = in.GetColor();
+        style.attrBits = static_cast<uint8_t>(in.Get<char>());
+        style.width = static_cast<uint8_t>(in.Get<char>()) & 0x3;
+        if (!in.Ok() || length > used - col) {
+            return false;
+        }
+        std::fill_n(out.begin() + col, length, style);
+        col += length;
+    }
+    if (col != used) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < used; ++i) {
+        const uint32_t value = in.GetVarint();
+        const uint32_t base = (value >> 2) & Cell::kContinuation;
+        const uint32_t marks = value & 0x3;
+        if (marks == 0) {
+            out[i].SetCodepoint(base);
+            continue;
+        }
+        uint32_t combining[GraphemeTable::kMaxCombining] = {};
+        for (uint32_t mark = 0; mark < marks; ++mark) {
+            combining[mark] = in.GetVarint();
+        }
+        out[i].SetChars(base, combining);
+    }
+    return in.Ok();
+}
+
+/// FNV-1a of a line's encoding, to tell later whether it changed
+uint64_t HashBytes(std::span<const char> bytes) noexcept {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (const char byte : bytes) {
+        hash = (hash ^ static_cast<uint8_t>(byte)) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+/// Compress bytes, or keep them raw if that is no larger
+void Compress(std::span<const char> raw, std::vector<char>& out) {
+    out.resize(static_cast<size_t>(LZ4_compressBound(static_cast<int>(raw.size()))));
+    const int size = LZ4_compress_default(raw.data(), out.data(), static_cast<int>(raw.size()),
+                                          static_cast<int>(out.size()));
+    if (size <= 0 || static_cast<size_t>(size) >= raw.size()) {
+        out.assign(raw.begin(), raw.end());
+    } else {
+        out.resize(static_cast<size_t>(size));
+    }
+}
+
+/// Get stored bytes back as raw ones
+/// @return The raw bytes (stored itself if it was kept raw), or empty on error
+std::span<const char> Decompress(std::span<const char> stored, uint32_t rawSize, std::vector<char>& scratch) {
+    if (stored.size() == rawSize) {
+        return stored;
+    }
+    if (rawSize > kMaxRawBytes) {
+        return {};
+    }
+    scratch.resize(rawSize);
+    const int size = LZ4_decompress_safe(stored.data(), scratch.data(), static_cast<int>(stored.size()),
+                                         static_cast<int>(rawSize));
+    return size == static_cast<int>(rawSize) ? std::span<const char>(scratch) : std::span<const char>();
+}
+
+/// Write bytes at an offset
+bool WriteAt(HANDLE file, uint64_t offset, std::span<const char> bytes) {
+    while (!bytes.empty()) {
+        OVERLAPPED position{};
+        position.Offset = static_cast<DWORD>(offset);
+        position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+        DWORD written = 0;
+        const DWORD chunk = static_cast<DWORD>(std::min<size_t>(bytes.size(), 1u << 30));
+        if (!WriteFile(file, bytes.data(), chunk, &written, &position) || written == 0) {
+            return false;
+        }
+        offset += written;
+        bytes = bytes.subspan(written);
+    }
+    return true;
+}
+
+} // namespace
+
+// ============================================================================
+// SavedHistory
+// ============================================================================
+
+size_t SavedHistory::RestoreInto(TerminalBuffer& buffer) const {
+    // Only the newest lines the scrollback keeps are decoded; whole chunks
+    // before them are skipped by their headers
+    uint64_t total = m_screenLines;
+    for (Reader chunks(m_chunks); !chunks.AtEnd();) {
+        total += chunks.Get<uint32_t>();
+        (void)chunks.Get<uint32_t>();
+        (void)chunks.GetBytes(chunks.Get<uint32_t>());
+    }
+    const uint64_t keep = std::min<uint64_t>(total, buffer.GetMaxScrollback());
+    uint64_t skip = total - keep;
+
+    std::vector<char> scratch;
+    Row row;
+    size_t restored = 0;
+    const auto pushLines = [&](std::span<const char> raw, uint32_t lines) {
+        Reader in(raw);
+        for (uint32_t line = 0; line < lines; ++line) {
+            bool continuation = false;
+            if (!DecodeLine(in, row, continuation)) {
+                return false;
+            }
+            if (skip > 0) {
+                --skip;
+                continue;
+            }
+            buffer.PushScrollback(row, continuation);
+            ++restored;
+        }
+        return true;
+    };
+
+    for (Reader chunks(m_chunks); !chunks.AtEnd();) {
+        const auto lines = chunks.Get<uint32_t>();
+        const auto rawSize = chunks.Get<uint32_t>();
+        const std::span<const char> stored = chunks.GetBytes(chunks.Get<uint32_t>());
+        if (!chunks.Ok()) {
+            break;
+        }
+        if (skip >= lines) {
+            skip -= lines;
+            continue;
+        }
+        const std::span<const char> raw = Decompress(stored, rawSize, scratch);
+        if (raw.empty() || !pushLines(raw, lines)) {
+            break;
+        }
+    }
+
+    if (m_screenLines > 0) {
+        const std::span<const char> raw = Decompress(m_screen, m_screenRawSize, scratch);
+        if (!raw.empty()) {
+            (void)pushLines(raw, m_screenLines);
+        }
+    }
+    return restored;
+}
+
+// ============================================================================
+// SessionSnapshots
+// ============================================================================
+
+SessionSnapshots::~SessionSnapshots() {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+SessionSnapshots& SessionSnapshots::Shared() {
+    static SessionSnapshots s_instance;
+    return s_instance;
+}
+
+std::filesystem::path SessionSnapshots::GetDirectory() {
+    wchar_t* localAppData = nullptr;
+    if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, nullptr, &localAppData))) {
+        std::filesystem::path path = localAppData;
+        CoTaskMemFree(localAppData);
+        return path / L"Console3" / L"Sessions";
+    }
+    return L"Sessions";
+}
+
+std::filesystem::path SessionSnapshots::GetHistoryPath(uint64_t fileId) {
+    return GetDirectory() / (std::to_wstring(fileId) + kHistoryExtension);
+}
+
+std::vector<SavedSession> SessionSnapshots::Load() {
+    std::lock_guard<std::mutex> lock(m_lock);
+    std::vector<SavedSession> sessions;
+    std::vector<uint64_t> listed;
+
+    const std::shared_ptr<const MappedFile> manifest = MappedFile::Open(GetDirectory() / kManifestName);
+    if (manifest) {
+        Reader in(manifest->GetBytes());
+        const std::span<const char> magic = in.GetBytes(sizeof(kManifestMagic));
+        const auto version = in.Get<uint32_t>();
+        const auto count = in.Get<uint32_t>();
+        const bool valid = in.Ok() && std::equal(magic.begin(), magic.end(), kManifestMagic) &&
+                           version == kVersion;
+
+        for (uint32_t i = 0; valid && i < count; ++i) {
+            const auto fileId = in.Get<uint64_t>();
+            const auto historyBytes = in.Get<uint64_t>();
+            SessionConfig config;
+            config.rows = in.Get<int32_t>();
+            config.cols = in.Get<int32_t>();
+            config.scrollbackLines = static_cast<size_t>(in.Get<uint64_t>());
+            config.shell = in.GetString();
+            config.args = in.GetString();
+            config.workingDir = in.GetString();
+            config.title = in.GetString();
+            config.profileName = in.GetString();
+
+            auto history = std::make_shared<SavedHistory>();
+            history->m_manifest = manifest;
+            history->m_screenLines = in.Get<uint32_t>();
+            history->m_screenRawSize = in.Get<uint32_t>();
+            history->m_screen = in.GetBytes(in.Get<uint32_t>());
+            if (!in.Ok()) {
+                break;
+            }
+            listed.push_back(fileId);
+            m_nextFileId = std::max(m_nextFileId, fileId + 1);
+
+            // Chunks past the recorded size may be torn
+            history->m_history = MappedFile::Open(GetHistoryPath(fileId));
+            if (history->m_history) {
+                const std::span<const char> bytes = history->m_history->GetBytes();
+                if (historyBytes >= kHistoryHeaderBytes && historyBytes <= bytes.size() &&
+                    std::equal(kHistoryMagic, kHistoryMagic + sizeof(kHistoryMagic), bytes.begin())) {
+                    history->m_chunks = bytes.subspan(kHistoryHeaderBytes,
+                                                      static_cast<size_t>(historyBytes) - kHistoryHeaderBytes);
+                }
+            }
+
+            if (config.rows <= 0) config.rows = 25;
+            if (config.cols <= 0) config.cols = 80;
+            if (config.scrollbackLines == 0) config.scrollbackLines = 10000;
+            if (config.shell.empty()) config.shell = L"cmd.exe";
+            config.restoreHistory = std::move(history);
+            sessions.push_back(SavedSession{std::move(config)});
+        }
+    }
+
+    // The last run's files go once this run's sessions replace them; files
+    // no manifest lists were left by a crash and go as well
+    m_deleteIds.insert(m_deleteIds.end(), listed.begin(), listed.end());
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(GetDirectory(), error)) {
+        const std::filesystem::path& path = entry.path();
+        if (path.extension() != kHistoryExtension) {
+            continue;
+        }
+        const uint64_t fileId = std::wcstoull(path.stem().c_str(), nullptr, 10);
+        if (fileId != 0 && std::find(listed.begin(), listed.end(), fileId) == listed.end()) {
+            DeleteFileW(path.c_str());
+            m_nextFileId = std::max(m_nextFileId, fileId + 1);
+        }
+    }
+    return sessions;
+}
+
+bool SessionSnapshots::Capture(const void* key, const SessionConfig& config, const TerminalBuffer& buffer,
+                               size_t lines) {
+    std::shared_ptr<Tab> tab;
+    bool failed = false;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_discarded) {
+            return false;
+        }
+        const auto it = std::find_if(m_tabs.begin(), m_tabs.end(),
+                                     [key](const auto& entry) { return entry->key == key; });
+        if (it != m_tabs.end()) {
+            tab = *it;
+        } else {
+            tab = std::make_shared<Tab>();
+            tab->key = key;
+            tab->fileId = m_nextFileId++;
+            m_tabs.push_back(tab);
+        }
+        failed = std::exchange(tab->failed, false);
+        if (!m_thread.joinable()) {
+            m_thread = std::thread(&SessionSnapshots::WriterProc, this);
+        }
+    }
+
+    // Lines already written must still be there as they were. Clearing or
+    // popping lines changes the epoch, and pushing others reuses their ids,
+    // so after an epoch change the last line written is compared.
+    const ScrollbackStore& store = buffer.GetScrollbackStore();
+    const uint64_t firstId = store.GetFirstId();
+    const uint64_t endId = store.GetEndId();
+    const size_t maxLines = store.GetMaxLines();
+    const uint64_t epoch = buffer.GetScrollbackEpoch();
+    bool restart = !tab->started || failed || tab->nextLine > endId ||
+                   tab->linesInFile > 2 * std::max<size_t>(maxLines, kChunkLines);
+    std::vector<char> encoded;
+    if (!restart && tab->linesInFile > 0) {
+        if (tab->nextLine <= firstId) {
+            restart = true;
+        } else if (epoch != tab->epoch) {
+            const auto index = static_cast<size_t>(endId - tab->nextLine);
+            const Row* row = store.Get(index);
+            if (row) {
+                EncodeLine(*row, store.IsContinuation(index), encoded);
+            }
+            restart = !row || HashBytes(encoded) != tab->lastLineHash;
+            encoded.clear();
+        }
+    }
+    tab->epoch = epoch;
+    if (restart) {
+        tab->nextLine = std::max<uint64_t>(firstId, endId - std::min<uint64_t>(endId, maxLines));
+        tab->linesInFile = 0;
+        tab->lastLineHash = 0;
+        tab->started = true;
+    } else if (tab->linesInFile == 0) {
+        // Nothing written yet, so nothing to keep: lines trimmed before they
+        // were copied are simply skipped
+        tab->nextLine = std::max(tab->nextLine, firstId);
+    }
+
+    // Oldest first, so each compressed block is decoded once; store line i
+    // has id GetEndId() - 1 - i
+    std::vector<uint32_t> lineEnds;
+    const uint64_t end = std::min<uint64_t>(endId, tab->nextLine + lines);
+    for (uint64_t id = tab->nextLine; id < end; ++id) {
+        const auto index = static_cast<size_t>(endId - 1 - id);
+        const size_t start = encoded.size();
+        if (const Row* row = store.Get(index)) {
+            EncodeLine(*row, store.IsContinuation(index), encoded);
+        } else {
+            EncodeLine({}, false, encoded);
+        }
+        lineEnds.push_back(static_cast<uint32_t>(encoded.size()));
+        tab->lastLineHash = HashBytes(std::span<const char>(encoded).subspan(start));
+    }
+    tab->linesInFile += end - tab->nextLine;
+    tab->nextLine = end;
+
+    // The screen down to its last line with anything on it; an alternate
+    // screen belongs to a program that won't be running
+    std::vector<char> screen;
+    uint32_t screenLines = 0;
+    if (!buffer.IsAlternateScreen()) {
+        static const Cell blank{};
+        int rows = buffer.GetRows();
+        while (rows > 0 && std::all_of(buffer.GetRow(rows - 1).begin(), buffer.GetRow(rows - 1).end(),
+                                       [](const Cell& cell) { return cell == blank; })) {
+            --rows;
+        }
+        for (int row = 0; row < rows; ++row) {
+            EncodeLine(buffer.GetRow(row), buffer.IsContinuation(row), screen);
+        }
+        screenLines = static_cast<uint32_t>(rows);
+    }
+    std::vector<char> storedScreen;
+    Compress(screen, storedScreen);
+
+    std::vector<char> entry;
+    Put(entry, static_cast<int32_t>(config.rows));
+    Put(entry, static_cast<int32_t>(config.cols));
+    Put(entry, static_cast<uint64_t>(config.scrollbackLines));
+    PutString(entry, config.shell);
+    PutString(entry, config.args);
+    PutString(entry, config.workingDir);
+    PutString(entry, config.title);
+    PutString(entry, config.profileName);
+    Put(entry, screenLines);
+    Put(entry, static_cast<uint32_t>(screen.size()));
+    Put(entry, static_cast<uint32_t>(storedScreen.size()));
+    entry.insert(entry.end(), storedScreen.begin(), storedScreen.end());
+
+    bool changed = false;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (restart) {
+            tab->lines.clear();
+            tab->lineEnds.clear();
+            tab->restart = true;
+            changed = true;
+        }
+        if (!lineEnds.empty()) {
+            const auto base = static_cast<uint32_t>(tab->lines.size());
+            tab->lines.insert(tab->lines.end(), encoded.begin(), encoded.end());
+            for (const uint32_t lineEnd : lineEnds) {
+                tab->lineEnds.push_back(base + lineEnd);
+            }
+            changed = true;
+        }
+        if (entry != tab->entry) {
+            tab->entry = std::move(entry);
+            changed = true;
+        }
+        if (changed) {
+            ++m_changes;
+        }
+    }
+    if (changed) {
+        m_wake.notify_one();
+    }
+    return tab->nextLine < endId;
+}
+
+void SessionSnapshots::Forget(const void* key) {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        const auto it = std::find_if(m_tabs.begin(), m_tabs.end(),
+                                     [key](const auto& entry) { return entry->key == key; });
+        if (it == m_tabs.end()) {
+            return;
+        }
+        m_deleteIds.push_back((*it)->fileId);
+        m_tabs.erase(it);
+        ++m_changes;
+    }
+    m_wake.notify_one();
+}
+
+void SessionSnapshots::Flush() {
+    std::unique_lock<std::mutex> lock(m_lock);
+    if (!m_thread.joinable()) {
+        return;
+    }
+    const uint64_t changes = m_changes;
+    m_written.wait(lock, [this, changes] { return m_writtenChanges >= changes || m_stop; });
+}
+
+void SessionSnapshots::Discard() {
+    // Stop the writer first, so it can't write after the files are gone
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_discarded = true;
+        m_stop = true;
+        m_tabs.clear();
+        m_deleteIds.clear();
+    }
+    m_wake.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+
+    std::error_code error;
+    std::filesystem::remove_all(GetDirectory(), error);
+}
+
+void SessionSnapshots::WriterProc() {
+    /// A tab's history to write, taken from it under the lock
+    struct Work {
+        std::shared_ptr<Tab> tab;
+        std::vector<char> lines;
+        std::vector<uint32_t> lineEnds;
+        bool restart = false;
+    };
+
+    // Compressing history for the next start is never urgent
+    (void)ThreadPolicy::SetCurrentQos(ThreadQos::Eco);
+
+    std::error_code error;
+    std::filesystem::create_directories(GetDirectory(), error);
+
+    std::unique_lock<std::mutex> lock(m_lock);
+    for (;;) {
+        m_wake.wait(lock, [this] { return m_stop || m_writtenChanges != m_changes; });
+        if (m_discarded || m_writtenChanges == m_changes) {
+            break;
+        }
+
+        const uint64_t changes = m_changes;
+        std::vector<Work> work;
+        std::vector<std::shared_ptr<Tab>> tabs = m_tabs;
+        std::vector<std::vector<char>> entries;
+        for (const std::shared_ptr<Tab>& tab : tabs) {
+            entries.push_back(tab->entry);
+            if (tab->restart || !tab->lineEnds.empty()) {
+                work.push_back(Work{tab, std::move(tab->lines), std::move(tab->lineEnds), tab->restart});
+                tab->lines.clear();
+                tab->lineEnds.clear();
+                tab->restart = false;
+            }
+        }
+        std::vector<uint64_t> deleteIds = m_deleteIds;
+        lock.unlock();
+
+        std::vector<std::shared_ptr<Tab>> failed;
+        for (Work& item : work) {
+            if (!WriteHistory(*item.tab, item.restart, item.lines, item.lineEnds)) {
+                item.tab->file.reset();
+                item.tab->historyBytes = 0;
+                failed.push_back(item.tab);
+            }
+        }
+        work.clear();
+
+        // The manifest goes out whole; it holds each tab's entry from the
+        // capture and the history written so far
+        std::vector<char> manifest(kManifestMagic, kManifestMagic + sizeof(kManifestMagic));
+        Put(manifest, kVersion);
+        Put(manifest, static_cast<uint32_t>(tabs.size()));
+        for (size_t i = 0; i < tabs.size(); ++i) {
+            Put(manifest, tabs[i]->fileId);
+            Put(manifest, tabs[i]->historyBytes);
+            manifest.insert(manifest.end(), entries[i].begin(), entries[i].end());
+        }
+        tabs.clear();
+
+        std::vector<uint64_t> deleted;
+        if (WriteManifest(manifest)) {
+            for (const uint64_t fileId : deleteIds) {
+                // Still mapped by a restore in progress; tried again next time
+                if (DeleteFileW(GetHistoryPath(fileId).c_str()) || GetLastError() == ERROR_FILE_NOT_FOUND) {
+                    deleted.push_back(fileId);
+                }
+            }
+        }
+
+        lock.lock();
+        // A tab whose file failed starts it over with its next capture
+        for (const std::shared_ptr<Tab>& tab : failed) {
+            tab->failed = true;
+        }
+        std::erase_if(m_deleteIds, [&deleted](uint64_t fileId) {
+            return std::find(deleted.begin(), deleted.end(), fileId) != deleted.end();
+        });
+        m_writtenChanges = changes;
+        m_written.notify_all();
+    }
+
+    m_writtenChanges = m_changes;
+    m_written.notify_all();
+}
+
+bool SessionSnapshots::WriteHistory(Tab& tab, bool restart, std::span<const char> lines,
+                                    std::span<const uint32_t> lineEnds) {
+    if (restart) {
+        tab.file.reset();
+        tab.file.reset(CreateFileW(GetHistoryPath(tab.fileId).c_str(), GENERIC_WRITE,
+                                   FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, CREATE_ALWAYS,
+                                   FILE_ATTRIBUTE_NORMAL, nullptr));
+        std::vector<char> header(kHistoryMagic, kHistoryMagic + sizeof(kHistoryMagic));
+        Put(header, kVersion);
+        if (!tab.file || !WriteAt(tab.file.get(), 0, header)) {
+            return false;
+        }
+        tab.historyBytes = header.size();
+    }
+    if (!tab.file) {
+        return false;
+    }
+
+    std::vector<char> chunk;
+    std::vector<char> stored;
+    size_t lineStart = 0;
+    for (size_t first = 0; first < lineEnds.size(); first += kChunkLines) {
+        const size_t count = std::min(kChunkLines, lineEnds.size() - first);
+        const size_t lineEnd = lineEnds[first + count - 1];
+        const std::span<const char> raw = lines.subspan(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd;
+
+        Compress(raw, stored);
+        chunk.clear();
+        Put(chunk, static_cast<uint32_t>(count));
+        Put(chunk, static_cast<uint32_t>(raw.size()));
+        Put(chunk, static_cast<uint32_t>(stored.size()));
+        chunk.insert(chunk.end(), stored.begin(), stored.end());
+        if (!WriteAt(tab.file.get(), tab.historyBytes, chunk)) {
+            return false;
+        }
+        tab.historyBytes += chunk.size();
+    }
+    return true;
+}
+
+bool SessionSnapshots::WriteManifest(std::span<const char> manifest) {
+    const std::filesystem::path temp = GetDirectory() / kManifestTempName;
+    {
+        wil::unique_hfile file(CreateFileW(temp.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                                           FILE_ATTRIBUTE_NORMAL, nullptr));
+        if (!file || !WriteAt(file.get(), 0, manifest)) {
+            return false;
+        }
+    }
+    return MoveFileExW(temp.c_str(), (GetDirectory() / kManifestName).c_str(),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != FALSE;
+}
+
+} // namespace Console3::Core
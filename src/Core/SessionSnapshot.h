@@ -0,0 +1,177 @@
+#pragma once
+// Console3 - SessionSnapshot.h
+// Keeps sessions' screens and history on disk, and maps them back at startup
+//
+// Closing Console3 lost every session's output: the old JSON save kept only
+// the configuration, and nothing called it. Each session's history is now
+// written out as it grows, so the next start shows it again without
+// re-running anything.
+//
+// A session's scrollback goes to a history file of its own, appended in
+// LZ4-compressed chunks of up to kChunkLines lines, oldest first. Only lines
+// stored since the last capture are written; the file is started over only
+// when lines already written changed (the scrollback was cleared or lines
+// were popped back to the screen) or it holds more than twice the
+// scrollback limit. The configurations and screens, which are small but
+// change all the time, go to a manifest written whole to a temporary file
+// and renamed over the old one. The manifest records how many bytes of each
+// history file are complete, so a chunk torn by a crash is never read.
+//
+// Capture() runs on the UI thread, the only one that may read a buffer, and
+// copies out a bounded slice of new lines; a writer thread compresses and
+// writes them. At startup Load() maps the manifest and history files, and a
+// new session decodes its history straight from the mapping into its
+// scrollback, followed by the old screen: the new shell starts on a clear
+// screen (the pseudo console clears it anyway) with the old output above.
+//
+// Lines are stored as characters and style spans with combining characters
+// spelled out, so a file doesn't depend on the process that wrote it.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <wil/resource.h>
+
+#include "Core/MappedFile.h"
+#include "Core/Session.h"
+
+namespace Console3::Core {
+
+class TerminalBuffer;
+
+/// Output of a session saved by an earlier run, mapped from disk
+class SavedHistory {
+public:
+    /// Push the saved history, then the saved screen, into a buffer's
+    /// scrollback (keeping at most its scrollback limit)
+    /// @return Lines restored
+    size_t RestoreInto(TerminalBuffer& buffer) const;
+
+private:
+    friend class SessionSnapshots;
+
+    std::shared_ptr<const MappedFile> m_manifest;
+    std::shared_ptr<const MappedFile> m_history;
+    std::span<const char> m_chunks;     ///< Complete chunks of m_history
+    std::span<const char> m_screen;     ///< Compressed screen, in m_manifest
+    uint32_t m_screenRawSize = 0;
+    uint32_t m_screenLines = 0;
+};
+
+/// A session saved by an earlier run
+struct SavedSession {
+    SessionConfig config;               ///< With restoreHistory set
+};
+
+/// Session snapshots of the process (see file comment)
+class SessionSnapshots {
+public:
+    static constexpr uint32_t kVersion = 1;
+    static constexpr size_t kChunkLines = 256;          ///< History lines per compressed chunk
+    static constexpr size_t kCaptureLines = 4096;       ///< History lines copied per Capture()
+
+    SessionSnapshots() = default;
+    ~SessionSnapshots();
+
+    // Non-copyable, non-movable (owns the writer thread)
+    SessionSnapshots(const SessionSnapshots&) = delete;
+    SessionSnapshots& operator=(const SessionSnapshots&) = delete;
+
+    /// Get the process-wide snapshots
+    static SessionSnapshots& Shared();
+
+    /// Get the directory the manifest and history files are kept in
+    [[nodiscard]] static std::filesystem::path GetDirectory();
+
+    /// Map the sessions the last run saved (UI thread, before any Capture())
+    /// Their files are deleted once the sessions saved from here on replace
+    /// them and nothing maps them any more.
+    /// @return The sessions in the order they were first captured
+    [[nodiscard]] std::vector<SavedSession> Load();
+
+    /// Save a session's configuration and screen, and copy the history
+    /// lines stored since the last call for the writer (UI thread)
+    /// @param key Identifies the session from call to call (e.g. its window)
+    /// @param lines History lines to copy at most
+    /// @return true while history lines remain to be copied
+    bool Capture(const void* key, const SessionConfig& config, const TerminalBuffer& buffer,
+                 size_t lines = kCaptureLines);
+
+    /// Stop saving a session that was closed for good; its files are deleted
+    void Forget(const void* key);
+
+    /// Wait until everything captured is on disk (at exit)
+    void Flush();
+
+    /// Delete every snapshot and stop saving (restoring is off)
+    void Discard();
+
+private:
+    /// A captured session
+    /// The UI thread owns the capture position, the writer the file; the
+    /// rest is handed over under m_lock.
+    struct Tab {
+        const void* key = nullptr;
+        uint64_t fileId = 0;                ///< History file name
+
+        // UI thread
+        uint64_t nextLine = 0;              ///< Next store line id to copy
+        uint64_t lastLineHash = 0;          ///< Encoding of line nextLine - 1
+        uint64_t linesInFile = 0;
+        uint64_t epoch = 0;                 ///< Buffer scrollback epoch at the last capture
+        bool started = false;
+
+        // Handed to the writer (m_lock)
+        std::vector<char> entry;            ///< Manifest entry without the history size
+        std::vector<char> lines;            ///< Encoded lines not yet written
+        std::vector<uint32_t> lineEnds;
+        bool restart = false;               ///< Start the history file over
+        bool failed = false;                ///< A write failed; copy the history again
+
+        // Writer thread
+        wil::unique_hfile file;
+        uint64_t historyBytes = 0;          ///< Complete chunks in the file
+    };
+
+    /// Writer thread procedure
+    void WriterProc();
+
+    /// Append encoded lines to a tab's history file, kChunkLines a chunk
+    /// @return false on a write error
+    static bool WriteHistory(Tab& tab, bool restart, std::span<const char> lines,
+                             std::span<const uint32_t> lineEnds);
+
+    /// Replace the manifest
+    static bool WriteManifest(std::span<const char> manifest);
+
+    /// Get the path of a history file
+    [[nodiscard]] static std::filesystem::path GetHistoryPath(uint64_t fileId);
+
+    mutable std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::condition_variable m_written;
+    std::vector<std::shared_ptr<Tab>> m_tabs;
+    std::vector<uint64_t> m_deleteIds;      ///< History files to delete after the next manifest
+    uint64_t m_nextFileId = 1;
+    uint64_t m_changes = 0;                 ///< Bumped by every capture that changed something
+    uint64_t m_writtenChanges = 0;          ///< m_changes as of the last manifest written
+    bool m_stop = false;
+    bool m_discarded = false;
+    std::thread m_thread;
+};
+
+} // namespace Console3::Core
@@ -0,0 +1,61 @@
+#pragma once
+// Console3 - SessionStats.h
+// Per-session I/O telemetry snapshot
+//
+// Every counter behind this snapshot is a relaxed atomic updated by the
+// thread that owns the work (transport, input writer, UI parser), so taking
+// a snapshot never blocks the I/O path. Values are not mutually consistent
+// to the byte; they are meant for tuning and the diagnostics overlay.
+
+#include "Core/ProcessJob.h"
+#include "Core/PseudoConsole.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Console3::Core {
+
+/// Snapshot returned by Session::GetStats()
+struct SessionStats {
+    // PTY output (transport)
+    uint64_t bytesIn = 0;             ///< Bytes read from the pseudo console
+    uint64_t readCount = 0;           ///< Read syscalls completed
+    uint64_t meanReadSize = 0;        ///< bytesIn / readCount
+    size_t maxReadSize = 0;           ///< Largest single read
+    size_t readSize = 0;              ///< Read size currently requested
+    uint64_t stallMicros = 0;         ///< Reader time throttled by backpressure
+
+    // PTY input
+    uint64_t bytesOut = 0;            ///< Bytes written to the pseudo console
+    PseudoConsoleKind console = PseudoConsoleKind::None;  ///< Implementation in use
+    uint64_t earlyReplies = 0;        ///< Queries answered as they arrived (QueryResponder.h)
+
+    // Shell's process tree (its job, ProcessJob.h)
+    JobAccounting shell;
+
+    // Output buffer
+    size_t bufferedBytes = 0;         ///< Current fill level
+    size_t bufferHighWater = 0;       ///< Peak fill level
+    size_t bufferReservedBytes = 0;   ///< Chunk memory held
+
+    // Parsing and presentation
+    uint64_t parseMicros = 0;         ///< Total time in the VT parser and buffer sync
+    uint64_t parseCalls = 0;          ///< ProcessOutput() calls that parsed data
+    uint64_t lastLatencyMicros = 0;   ///< First byte of the last burst to buffer updated
+    uint64_t maxLatencyMicros = 0;    ///< Worst first-byte-to-screen latency
+    bool fastForward = false;         ///< Fast-forward mode active
+
+    // Scrollback (the buffer the UI shows)
+    size_t scrollbackLines = 0;       ///< Lines of history
+    size_t scrollbackBytes = 0;       ///< History held in memory
+    uint64_t scrollbackSpilled = 0;   ///< History in the spill file
+    size_t budgetUsage = 0;           ///< Memory held by all sessions' scrollback
+    size_t budgetLimit = 0;           ///< Shared scrollback budget (0 = no limit)
+
+    // Emulator memory (libvterm's own allocations)
+    uint64_t vtermAllocations = 0;    ///< malloc calls so far
+    size_t vtermBytes = 0;            ///< Held now
+    size_t vtermPeakBytes = 0;        ///< Most held at once
+};
+
+} // namespace Console3::Core
@@ -2,7 +2,11 @@
 // Settings persistence using JSON
 
 #include "Core/Settings.h"
+#include "Core/MappedFile.h"
+#include "Core/SettingsCache.h"
+#include "Core/Utf.h"
 #include <nlohmann/json.hpp>
+#include <algorithm>
 #include <fstream>
 #include <ShlObj.h>
 
@@ -16,20 +20,9 @@ using json = nlohmann::json;
 
 namespace {
 
-std::string WideToUtf8(const std::wstring& wide) {
-    if (wide.empty()) return {};
-    int size = WideCharToMultiByte(CP_UTF8, 0, wide.c_str(), -1, nullptr, 0, nullptr, nullptr);
-    std::string utf8(size - 1, '\0');
-    WideCharToMultiByte(CP_UTF8, 0, wide.c_str(), -1, utf8.data(), size, nullptr, nullptr);
-    return utf8;
-}
-
+/// JSON strings convert to std::string, not string_view
 std::wstring Utf8ToWide(const std::string& utf8) {
-    if (utf8.empty()) return {};
-    int size = MultiByteToWideChar(CP_UTF8, 0, utf8.c_str(), -1, nullptr, 0);
-    std::wstring wide(size - 1, L'\0');
-    MultiByteToWideChar(CP_UTF8, 0, utf8.c_str(), -1, wide.data(), size);
-    return wide;
+    return ToUtf16(utf8);
 }
 
 std::string ColorToHex(uint32_t color) {
@@ -45,6 +38,265 @@ uint32_t HexToColor(const std::string& hex) {
     return static_cast<uint32_t>(strtoul(str, nullptr, 16));
 }
 
+/// Clamp a setting into [low, high], noting the change
+void Clamp(int& value, int low, int high, const wchar_t* name, std::vector<std::wstring>& messages) {
+    const int clamped = std::clamp(value, low, high);
+    if (clamped != value) {
+        messages.push_back(std::wstring(name) + L" " + std::to_wstring(value) + L" is out of range, using " +
+                           std::to_wstring(clamped));
+        value = clamped;
+    }
+}
+
+/// Read the performance section: the preset, then the keys overriding it
+PerformanceSettings ParsePerformance(const json& perf, std::vector<std::wstring>& warnings) {
+    const std::wstring preset = perf.contains("preset") ? Utf8ToWide(perf["preset"]) : L"balanced";
+    PerformanceSettings settings;
+    if (auto values = PerformanceSettings::FromPreset(preset)) {
+        settings = std::move(*values);
+    } else if (preset != L"custom") {
+        warnings.push_back(L"Unknown performance preset \"" + preset + L"\", using balanced");
+    }
+    settings.preset = preset;
+
+    if (perf.contains("outputBufferKB")) settings.outputBufferKB = perf["outputBufferKB"];
+    if (perf.contains("readChunkKB")) settings.readChunkKB = perf["readChunkKB"];
+    if (perf.contains("highWatermarkPercent")) settings.highWatermarkPercent = perf["highWatermarkPercent"];
+    if (perf.contains("lowWatermarkPercent")) settings.lowWatermarkPercent = perf["lowWatermarkPercent"];
+    if (perf.contains("scrollbackHotLines")) settings.scrollbackHotLines = perf["scrollbackHotLines"];
+    if (perf.contains("imageMemoryMB")) settings.imageMemoryMB = perf["imageMemoryMB"];
+    if (perf.contains("renderer")) settings.renderer = Utf8ToWide(perf["renderer"]);
+    if (perf.contains("gpu")) settings.gpu = Utf8ToWide(perf["gpu"]);
+    if (perf.contains("cellGridShader")) settings.cellGridShader = perf["cellGridShader"];
+    if (perf.contains("maxFps")) settings.maxFps = perf["maxFps"];
+    if (perf.contains("throttleBackground")) settings.throttleBackground = perf["throttleBackground"];
+    if (perf.contains("fastForwardMBps")) settings.fastForwardMBps = perf["fastForwardMBps"];
+    if (perf.contains("predictiveEcho")) settings.predictiveEcho = perf["predictiveEcho"];
+    if (perf.contains("saveBatteryPower")) settings.saveBatteryPower = perf["saveBatteryPower"];
+
+    std::vector<std::wstring> corrected = settings.Validate();
+    warnings.insert(warnings.end(), corrected.begin(), corrected.end());
+    return settings;
+}
+
+/// Write the performance section: the preset and what differs from it
+json FormatPerformance(const PerformanceSettings& settings) {
+    const PerformanceSettings base = PerformanceSettings::FromPreset(settings.preset).value_or(PerformanceSettings{});
+    json perf;
+    perf["preset"] = ToUtf8(settings.preset);
+    if (settings.outputBufferKB != base.outputBufferKB) perf["outputBufferKB"] = settings.outputBufferKB;
+    if (settings.readChunkKB != base.readChunkKB) perf["readChunkKB"] = settings.readChunkKB;
+    if (settings.highWatermarkPercent != base.highWatermarkPercent) perf["highWatermarkPercent"] = settings.highWatermarkPercent;
+    if (settings.lowWatermarkPercent != base.lowWatermarkPercent) perf["lowWatermarkPercent"] = settings.lowWatermarkPercent;
+    if (settings.scrollbackHotLines != base.scrollbackHotLines) perf["scrollbackHotLines"] = settings.scrollbackHotLines;
+    if (settings.imageMemoryMB != base.imageMemoryMB) perf["imageMemoryMB"] = settings.imageMemoryMB;
+    if (settings.renderer != base.renderer) perf["renderer"] = ToUtf8(settings.renderer);
+    if (settings.gpu != base.gpu) perf["gpu"] = ToUtf8(settings.gpu);
+    if (settings.cellGridShader != base.cellGridShader) perf["cellGridShader"] = settings.cellGridShader;
+    if (settings.maxFps != base.maxFps) perf["maxFps"] = settings.maxFps;
+    if (settings.throttleBackground != base.throttleBackground) perf["throttleBackground"] = settings.throttleBackground;
+    if (settings.fastForwardMBps != base.fastForwardMBps) perf["fastForwardMBps"] = settings.fastForwardMBps;
+    if (settings.predictiveEcho != base.predictiveEcho) perf["predictiveEcho"] = settings.predictiveEcho;
+    if (settings.saveBatteryPower != base.saveBatteryPower) perf["saveBatteryPower"] = settings.saveBatteryPower;
+    return perf;
+}
+
+/// Read a settings file's JSON over the settings given
+void ParseSettings(const json& j, Settings& settings, std::vector<std::wstring>& warnings) {
+    // Parse general settings
+    if (j.contains("defaultProfile")) {
+        settings.defaultProfile = Utf8ToWide(j["defaultProfile"]);
+    }
+    if (j.contains("scrollbackLines")) {
+        settings.scrollbackLines = j["scrollbackLines"];
+    }
+    if (j.contains("scrollbackToDisk")) {
+        settings.scrollbackToDisk = j["scrollbackToDisk"];
+    }
+    if (j.contains("scrollbackInternLines")) {
+        settings.scrollbackInternLines = j["scrollbackInternLines"];
+    }
+    if (j.contains("scrollbackTimestamps")) {
+        settings.scrollbackTimestamps = j["scrollbackTimestamps"];
+    }
+    if (j.contains("scrollbackBudgetMB")) {
+        settings.scrollbackBudgetMB = j["scrollbackBudgetMB"];
+    }
+    if (j.contains("hibernateAfterMinutes")) {
+        settings.hibernateAfterMinutes = j["hibernateAfterMinutes"];
+    }
+    if (j.contains("warmShellsPerProfile")) {
+        settings.warmShellsPerProfile = j["warmShellsPerProfile"];
+    }
+    if (j.contains("warmShellMinFreeMB")) {
+        settings.warmShellMinFreeMB = j["warmShellMinFreeMB"];
+    }
+    if (j.contains("singleProcess")) {
+        settings.singleProcess = j["singleProcess"];
+    }
+    if (j.contains("telemetryEndpoint")) {
+        settings.telemetryEndpoint = j["telemetryEndpoint"];
+    }
+    if (j.contains("copyOnSelect")) {
+        settings.copyOnSelect = j["copyOnSelect"];
+    }
+    if (j.contains("wordWrap")) {
+        settings.wordWrap = j["wordWrap"];
+    }
+
+    // Parse font
+    if (j.contains("font")) {
+        auto& font = j["font"];
+        if (font.contains("family")) {
+            settings.font.family = Utf8ToWide(font["family"]);
+        }
+        if (font.contains("size")) {
+            settings.font.size = font["size"];
+        }
+        if (font.contains("bold")) {
+            settings.font.bold = font["bold"];
+        }
+        if (font.contains("italic")) {
+            settings.font.italic = font["italic"];
+        }
+        if (font.contains("ligatures")) {
+            settings.font.ligatures = font["ligatures"];
+        }
+    }
+
+    // Parse color scheme
+    if (j.contains("colorScheme")) {
+        auto& cs = j["colorScheme"];
+        if (cs.contains("name")) {
+            settings.colorScheme.name = Utf8ToWide(cs["name"]);
+        }
+        if (cs.contains("foreground")) {
+            settings.colorScheme.foreground = HexToColor(cs["foreground"]);
+        }
+        if (cs.contains("background")) {
+            settings.colorScheme.background = HexToColor(cs["background"]);
+        }
+        if (cs.contains("cursor")) {
+            settings.colorScheme.cursorColor = HexToColor(cs["cursor"]);
+        }
+        if (cs.contains("selection")) {
+            settings.colorScheme.selectionBackground = HexToColor(cs["selection"]);
+        }
+        if (cs.contains("palette") && cs["palette"].is_array()) {
+            auto& palette = cs["palette"];
+            for (size_t i = 0; i < 16 && i < palette.size(); ++i) {
+                settings.colorScheme.palette[i] = HexToColor(palette[i]);
+            }
+        }
+    }
+
+    // Parse cursor
+    if (j.contains("cursor")) {
+        auto& cur = j["cursor"];
+        if (cur.contains("style")) {
+            settings.cursor.style = Utf8ToWide(cur["style"]);
+        }
+        if (cur.contains("blink")) {
+            settings.cursor.blink = cur["blink"];
+        }
+        if (cur.contains("blinkRate")) {
+            settings.cursor.blinkRate = cur["blinkRate"];
+        }
+    }
+
+    // Parse window
+    if (j.contains("window")) {
+        auto& win = j["window"];
+        if (win.contains("width")) settings.window.width = win["width"];
+        if (win.contains("height")) settings.window.height = win["height"];
+        if (win.contains("startMaximized")) settings.window.startMaximized = win["startMaximized"];
+        if (win.contains("confirmClose")) settings.window.confirmClose = win["confirmClose"];
+        if (win.contains("opacity")) settings.window.opacity = win["opacity"];
+        if (win.contains("useAcrylic")) settings.window.useAcrylic = win["useAcrylic"];
+    }
+
+    // Parse tabs
+    if (j.contains("tabs")) {
+        auto& tabs = j["tabs"];
+        if (tabs.contains("newTabPosition")) settings.tabs.newTabPosition = Utf8ToWide(tabs["newTabPosition"]);
+        if (tabs.contains("closeLastTabAction")) settings.tabs.closeLastTabAction = Utf8ToWide(tabs["closeLastTabAction"]);
+        if (tabs.contains("tabWidthMin")) settings.tabs.tabWidthMin = tabs["tabWidthMin"];
+        if (tabs.contains("tabWidthMax")) settings.tabs.tabWidthMax = tabs["tabWidthMax"];
+        if (tabs.contains("showCloseButton")) settings.tabs.showCloseButton = tabs["showCloseButton"];
+        if (tabs.contains("confirmTabClose")) settings.tabs.confirmTabClose = tabs["confirmTabClose"];
+        if (tabs.contains("duplicateOnMiddleClick")) settings.tabs.duplicateOnMiddleClick = tabs["duplicateOnMiddleClick"];
+        if (tabs.contains("showNewTabButton")) settings.tabs.showNewTabButton = tabs["showNewTabButton"];
+        if (tabs.contains("restoreTabsOnStartup")) settings.tabs.restoreTabsOnStartup = tabs["restoreTabsOnStartup"];
+    }
+
+    // Parse performance tuning
+    if (j.contains("performance")) {
+        settings.performance = ParsePerformance(j["performance"], warnings);
+    }
+
+    // Parse profiles
+    if (j.contains("profiles") && j["profiles"].is_array()) {
+        settings.profiles.clear();
+        for (auto& p : j["profiles"]) {
+            ShellProfile profile;
+            if (p.contains("name")) profile.name = Utf8ToWide(p["name"]);
+            if (p.contains("shell")) profile.shell = Utf8ToWide(p["shell"]);
+            if (p.contains("args")) profile.args = Utf8ToWide(p["args"]);
+            if (p.contains("workingDir")) profile.workingDir = Utf8ToWide(p["workingDir"]);
+            if (p.contains("hidden")) profile.hidden = p["hidden"];
+            if (p.contains("serialPort")) profile.serialPort = Utf8ToWide(p["serialPort"]);
+            if (p.contains("baud")) profile.baud = p["baud"];
+            if (p.contains("serialFormat")) profile.serialFormat = Utf8ToWide(p["serialFormat"]);
+            if (p.contains("flowControl")) profile.flowControl = Utf8ToWide(p["flowControl"]);
+            settings.profiles.push_back(profile);
+        }
+    }
+
+    // Parse shortcuts
+    if (j.contains("shortcuts") && j["shortcuts"].is_array()) {
+        settings.shortcuts.clear();
+        for (auto& s : j["shortcuts"]) {
+            Shortcut shortcut;
+            if (s.contains("action")) shortcut.action = Utf8ToWide(s["action"]);
+            if (s.contains("keys")) shortcut.keys = Utf8ToWide(s["keys"]);
+            settings.shortcuts.push_back(shortcut);
+        }
+    }
+
+    // Parse output rules
+    if (j.contains("outputRules") && j["outputRules"].is_array()) {
+        settings.outputRules.clear();
+        for (auto& r : j["outputRules"]) {
+            OutputRule rule;
+            if (r.contains("text")) rule.text = r["text"];
+            if (r.contains("matchCase")) rule.matchCase = r["matchCase"];
+            if (r.contains("highlight")) {
+                rule.highlight = true;
+                rule.color = HexToColor(r["highlight"]);
+            }
+            if (r.contains("bell")) rule.bell = r["bell"];
+            settings.outputRules.push_back(rule);
+        }
+    }
+
+    // Parse output logs
+    if (j.contains("outputLog")) {
+        auto& log = j["outputLog"];
+        if (log.contains("directory")) settings.outputLog.directory = Utf8ToWide(log["directory"]);
+        if (log.contains("compress")) settings.outputLog.compress = log["compress"];
+        if (log.contains("rotateMB")) settings.outputLog.rotateMB = std::max(log["rotateMB"].get<int>(), 0);
+        if (log.contains("rotateMinutes")) settings.outputLog.rotateMinutes = std::max(log["rotateMinutes"].get<int>(), 0);
+        if (log.contains("whenBehind")) {
+            const std::wstring whenBehind = Utf8ToWide(log["whenBehind"]);
+            if (whenBehind == L"drop" || whenBehind == L"block" || whenBehind == L"spill") {
+                settings.outputLog.whenBehind = whenBehind;
+            } else {
+                warnings.push_back(L"Unknown outputLog.whenBehind \"" + whenBehind + L"\", using drop");
+            }
+        }
+    }
+}
+
 } // namespace
 
 // ============================================================================
@@ -83,6 +335,108 @@ Settings Settings::GetDefaults() {
     return s;
 }
 
+// ============================================================================
+// Performance Presets
+// ============================================================================
+
+std::optional<PerformanceSettings> PerformanceSettings::FromPreset(const std::wstring& name) {
+    PerformanceSettings s;
+    s.preset = name;
+    if (name == L"balanced") {
+        return s;
+    }
+    if (name == L"low-latency") {
+        // Small reads reach the parser sooner; every frame the display
+        // shows, and no frames skipped until a real flood
+        s.readChunkKB = 16;
+        s.scrollbackHotLines = 4000;
+        s.fastForwardMBps = 32;
+        return s;
+    }
+    if (name == L"throughput") {
+        // A deep ring and big reads keep the shell writing; the reader
+        // waits only near full, frames are capped and floods skip early
+        s.outputBufferKB = 8192;
+        s.readChunkKB = 1024;
+        s.highWatermarkPercent = 90;
+        s.lowWatermarkPercent = 60;
+        s.cellGridShader = true;
+        s.maxFps = 60;
+        s.fastForwardMBps = 4;
+        return s;
+    }
+    if (name == L"low-memory") {
+        s.outputBufferKB = 256;
+        s.readChunkKB = 64;
+        s.scrollbackHotLines = 200;
+        s.imageMemoryMB = 16;
+        return s;
+    }
+    if (name == L"remote") {
+        // Over RDP and VDI: GDI dirty rectangles instead of whole GPU
+        // frames, 30 frames a second, and floods skipped early; typed
+        // text shows before a slow shell's echo
+        s.renderer = L"software";
+        s.maxFps = 30;
+        s.fastForwardMBps = 2;
+        s.predictiveEcho = true;
+        return s;
+    }
+    return std::nullopt;
+}
+
+std::vector<std::wstring> PerformanceSettings::Validate() {
+    std::vector<std::wstring> messages;
+    Clamp(outputBufferKB, 64, 256 * 1024, L"outputBufferKB", messages);
+    Clamp(readChunkKB, 4, std::min(4096, outputBufferKB), L"readChunkKB", messages);
+    Clamp(highWatermarkPercent, 10, 100, L"highWatermarkPercent", messages);
+    Clamp(lowWatermarkPercent, 1, highWatermarkPercent - 1, L"lowWatermarkPercent", messages);
+    Clamp(scrollbackHotLines, 1, 100000, L"scrollbackHotLines", messages);
+    Clamp(imageMemoryMB, 0, 4096, L"imageMemoryMB", messages);
+    Clamp(maxFps, 0, 1000, L"maxFps", messages);
+    Clamp(fastForwardMBps, 0, 1024, L"fastForwardMBps", messages);
+    if (renderer != L"gpu" && renderer != L"hwnd" && renderer != L"software") {
+        messages.push_back(L"Unknown renderer \"" + renderer + L"\", using gpu");
+        renderer = L"gpu";
+    }
+    if (gpu != L"display" && gpu != L"power" && gpu != L"performance") {
+        messages.push_back(L"Unknown gpu \"" + gpu + L"\", using display");
+        gpu = L"display";
+    }
+    return messages;
+}
+
+SettingsChanges Settings::Diff(const Settings& before, const Settings& after) {
+    SettingsChanges changes;
+    changes.colors = before.colorScheme != after.colorScheme;
+    changes.font = before.font != after.font;
+    changes.cursor = before.cursor != after.cursor;
+    changes.scrollback = before.scrollbackLines != after.scrollbackLines;
+    changes.scrollbackBudget = before.scrollbackBudgetMB != after.scrollbackBudgetMB;
+    changes.warmShells = before.warmShellsPerProfile != after.warmShellsPerProfile ||
+                         before.warmShellMinFreeMB != after.warmShellMinFreeMB;
+    changes.performance = before.performance != after.performance;
+    changes.transparency = before.window.opacity != after.window.opacity ||
+                           before.window.useAcrylic != after.window.useAcrylic;
+    changes.telemetry = before.telemetryEndpoint != after.telemetryEndpoint;
+
+    // Everything else: compare with the groups above made equal
+    Settings rest = after;
+    rest.colorScheme = before.colorScheme;
+    rest.font = before.font;
+    rest.cursor = before.cursor;
+    rest.scrollbackLines = before.scrollbackLines;
+    rest.scrollbackBudgetMB = before.scrollbackBudgetMB;
+    rest.warmShellsPerProfile = before.warmShellsPerProfile;
+    rest.warmShellMinFreeMB = before.warmShellMinFreeMB;
+    rest.performance = before.performance;
+    rest.window.opacity = before.window.opacity;
+    rest.window.useAcrylic = before.window.useAcrylic;
+    rest.telemetryEndpoint = before.telemetryEndpoint;
+    changes.other = rest != before;
+    return changes;
+}
+
 // ============================================================================
 // SettingsManager Implementation
 // ============================================================================
@@ -91,6 +445,11 @@ SettingsManager::SettingsManager() {
     m_settings = Settings::GetDefaults();
 }
 
+SettingsManager& SettingsManager::Shared() {
+    static SettingsManager manager;
+    return manager;
+}
+
 std::filesystem::path SettingsManager::GetSettingsPath() const {
     wchar_t* appDataPath = nullptr;
     if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_RoamingAppData, 0, nullptr, &appDataPath))) {
@@ -107,6 +466,7 @@ bool SettingsManager::SettingsFileExists() const {
 
 bool SettingsManager::Load() {
     auto path = GetSettingsPath();
+    m_warnings.clear();
     
     if (!std::filesystem::exists(path)) {
         // Use defaults if no settings file
@@ -114,119 +474,37 @@ bool SettingsManager::Load() {
         return true;
     }
 
-    try {
-        std::ifstream file(path);
-        if (!file.is_open()) {
-            m_lastError = L"Could not open settings file";
-            return false;
-        }
-
-        json j = json::parse(file);
-
-        // Parse general settings
-        if (j.contains("defaultProfile")) {
-            m_settings.defaultProfile = Utf8ToWide(j["defaultProfile"]);
-        }
-        if (j.contains("scrollbackLines")) {
-            m_settings.scrollbackLines = j["scrollbackLines"];
-        }
-        if (j.contains("copyOnSelect")) {
-            m_settings.copyOnSelect = j["copyOnSelect"];
-        }
-
-        // Parse font
-        if (j.contains("font")) {
-            auto& font = j["font"];
-            if (font.contains("family")) {
-                m_settings.font.family = Utf8ToWide(font["family"]);
-            }
-            if (font.contains("size")) {
-                m_settings.font.size = font["size"];
-            }
-        }
-
-        // Parse color scheme
-        if (j.contains("colorScheme")) {
-            auto& cs = j["colorScheme"];
-            if (cs.contains("name")) {
-                m_settings.colorScheme.name = Utf8ToWide(cs["name"]);
-            }
-            if (cs.contains("foreground")) {
-                m_settings.colorScheme.foreground = HexToColor(cs["foreground"]);
-            }
-            if (cs.contains("background")) {
-                m_settings.colorScheme.background = HexToColor(cs["background"]);
-            }
-            if (cs.contains("cursor")) {
-                m_settings.colorScheme.cursorColor = HexToColor(cs["cursor"]);
-            }
-            if (cs.contains("selection")) {
-                m_settings.colorScheme.selectionBackground = HexToColor(cs["selection"]);
-            }
-            if (cs.contains("palette") && cs["palette"].is_array()) {
-                auto& palette = cs["palette"];
-                for (size_t i = 0; i < 16 && i < palette.size(); ++i) {
-                    m_settings.colorScheme.palette[i] = HexToColor(palette[i]);
-                }
-            }
-        }
-
-        // Parse cursor
-        if (j.contains("cursor")) {
-            auto& cur = j["cursor"];
-            if (cur.contains("style")) {
-                m_settings.cursor.style = Utf8ToWide(cur["style"]);
-            }
-            if (cur.contains("blink")) {
-                m_settings.cursor.blink = cur["blink"];
-            }
-            if (cur.contains("blinkRate")) {
-                m_settings.cursor.blinkRate = cur["blinkRate"];
-            }
-        }
-
-        // Parse window
-        if (j.contains("window")) {
-            auto& win = j["window"];
-            if (win.contains("width")) m_settings.window.width = win["width"];
-            if (win.contains("height")) m_settings.window.height = win["height"];
-            if (win.contains("startMaximized")) m_settings.window.startMaximized = win["startMaximized"];
-            if (win.contains("confirmClose")) m_settings.window.confirmClose = win["confirmClose"];
-            if (win.contains("opacity")) m_settings.window.opacity = win["opacity"];
-            if (win.contains("useAcrylic")) m_settings.window.useAcrylic = win["useAcrylic"];
-        }
-
-        // Parse profiles
-        if (j.contains("profiles") && j["profiles"].is_array()) {
-            m_settings.profiles.clear();
-            for (auto& p : j["profiles"]) {
-                ShellProfile profile;
-                if (p.contains("name")) profile.name = Utf8ToWide(p["name"]);
-                if (p.contains("shell")) profile.shell = Utf8ToWide(p["shell"]);
-                if (p.contains("args")) profile.args = Utf8ToWide(p["args"]);
-                if (p.contains("workingDir")) profile.workingDir = Utf8ToWide(p["workingDir"]);
-                if (p.contains("hidden")) profile.hidden = p["hidden"];
-                m_settings.profiles.push_back(profile);
-            }
-        }
-
-        // Parse shortcuts
-        if (j.contains("shortcuts") && j["shortcuts"].is_array()) {
-            m_settings.shortcuts.clear();
-            for (auto& s : j["shortcuts"]) {
-                Shortcut shortcut;
-                if (s.contains("action")) shortcut.action = Utf8ToWide(s["action"]);
-                if (s.contains("keys")) shortcut.keys = Utf8ToWide(s["keys"]);
-                m_settings.shortcuts.push_back(shortcut);
-            }
-        }
-
+    const std::shared_ptr<const MappedFile> file = MappedFile::Open(path);
+    if (!file) {
+        m_lastError = L"Could not open settings file";
+        return false;
+    }
+    const std::span<const char> text = file->GetBytes();
+    std::error_code error;
+    const auto writeTime = static_cast<uint64_t>(
+        std::filesystem::last_write_time(path, error).time_since_epoch().count());
+
+    // A file parsed before comes back from the cache without any JSON
+    Settings settings = Settings::GetDefaults();
+    std::vector<std::wstring> warnings;
+    if (SettingsCache::Read(text, writeTime, settings, warnings)) {
+        m_settings = std::move(settings);
+        m_warnings = std::move(warnings);
         return true;
+    }
 
+    try {
+        const json j = json::parse(text.begin(), text.end());
+        ParseSettings(j, settings, warnings);
     } catch (const std::exception& e) {
         m_lastError = Utf8ToWide(e.what());
         return false;
     }
+
+    (void)SettingsCache::Write(text, writeTime, settings, warnings);
+    m_settings = std::move(settings);
+    m_warnings = std::move(warnings);
+    return true;
 }
 
 bool SettingsManager::Save() {
@@ -239,19 +517,29 @@ bool SettingsManager::Save() {
         json j;
 
         // General
-        j["defaultProfile"] = WideToUtf8(m_settings.defaultProfile);
+        j["defaultProfile"] = ToUtf8(m_settings.defaultProfile);
         j["scrollbackLines"] = m_settings.scrollbackLines;
+        j["scrollbackToDisk"] = m_settings.scrollbackToDisk;
+        j["scrollbackInternLines"] = m_settings.scrollbackInternLines;
+        j["scrollbackTimestamps"] = m_settings.scrollbackTimestamps;
+        j["scrollbackBudgetMB"] = m_settings.scrollbackBudgetMB;
+        j["hibernateAfterMinutes"] = m_settings.hibernateAfterMinutes;
+        j["warmShellsPerProfile"] = m_settings.warmShellsPerProfile;
+        j["warmShellMinFreeMB"] = m_settings.warmShellMinFreeMB;
+        j["singleProcess"] = m_settings.singleProcess;
+        j["telemetryEndpoint"] = m_settings.telemetryEndpoint;
         j["copyOnSelect"] = m_settings.copyOnSelect;
         j["wordWrap"] = m_settings.wordWrap;
 
         // Font
-        j["font"]["family"] = WideToUtf8(m_settings.font.family);
+        j["font"]["family"] = ToUtf8(m_settings.font.family);
         j["font"]["size"] = m_settings.font.size;
         j["font"]["bold"] = m_settings.font.bold;
         j["font"]["italic"] = m_settings.font.italic;
+        j["font"]["ligatures"] = m_settings.font.ligatures;
 
         // Color scheme
-        j["colorScheme"]["name"] = WideToUtf8(m_settings.colorScheme.name);
+        j["colorScheme"]["name"] = ToUtf8(m_settings.colorScheme.name);
         j["colorScheme"]["foreground"] = ColorToHex(m_settings.colorScheme.foreground);
         j["colorScheme"]["background"] = ColorToHex(m_settings.colorScheme.background);
         j["colorScheme"]["cursor"] = ColorToHex(m_settings.colorScheme.cursorColor);
@@ -264,7 +552,7 @@ bool SettingsManager::Save() {
         j["colorScheme"]["palette"] = palette;
 
         // Cursor
-        j["cursor"]["style"] = WideToUtf8(m_settings.cursor.style);
+        j["cursor"]["style"] = ToUtf8(m_settings.cursor.style);
         j["cursor"]["blink"] = m_settings.cursor.blink;
         j["cursor"]["blinkRate"] = m_settings.cursor.blinkRate;
 
@@ -276,15 +564,35 @@ bool SettingsManager::Save() {
         j["window"]["opacity"] = m_settings.window.opacity;
         j["window"]["useAcrylic"] = m_settings.window.useAcrylic;
 
+        // Tabs
+        j["tabs"]["newTabPosition"] = ToUtf8(m_settings.tabs.newTabPosition);
+        j["tabs"]["closeLastTabAction"] = ToUtf8(m_settings.tabs.closeLastTabAction);
+        j["tabs"]["tabWidthMin"] = m_settings.tabs.tabWidthMin;
+        j["tabs"]["tabWidthMax"] = m_settings.tabs.tabWidthMax;
+        j["tabs"]["showCloseButton"] = m_settings.tabs.showCloseButton;
+        j["tabs"]["confirmTabClose"] = m_settings.tabs.confirmTabClose;
+        j["tabs"]["duplicateOnMiddleClick"] = m_settings.tabs.duplicateOnMiddleClick;
+        j["tabs"]["showNewTabButton"] = m_settings.tabs.showNewTabButton;
+        j["tabs"]["restoreTabsOnStartup"] = m_settings.tabs.restoreTabsOnStartup;
+
+        // Performance
+        j["performance"] = FormatPerformance(m_settings.performance);
+
         // Profiles
         json profiles = json::array();
         for (const auto& p : m_settings.profiles) {
             json profile;
-            profile["name"] = WideToUtf8(p.name);
-            profile["shell"] = WideToUtf8(p.shell);
-            profile["args"] = WideToUtf8(p.args);
-            profile["workingDir"] = WideToUtf8(p.workingDir);
+            profile["name"] = ToUtf8(p.name);
+            profile["shell"] = ToUtf8(p.shell);
+            profile["args"] = ToUtf8(p.args);
+            profile["workingDir"] = ToUtf8(p.workingDir);
             profile["hidden"] = p.hidden;
+            if (!p.serialPort.empty()) {
+                profile["serialPort"] = ToUtf8(p.serialPort);
+                profile["baud"] = p.baud;
+                profile["serialFormat"] = ToUtf8(p.serialFormat);
+                profile["flowControl"] = ToUtf8(p.flowControl);
+            }
             profiles.push_back(profile);
         }
         j["profiles"] = profiles;
@@ -293,12 +601,33 @@ bool SettingsManager::Save() {
         json shortcuts = json::array();
         for (const auto& s : m_settings.shortcuts) {
             json shortcut;
-            shortcut["action"] = WideToUtf8(s.action);
-            shortcut["keys"] = WideToUtf8(s.keys);
+            shortcut["action"] = ToUtf8(s.action);
+            shortcut["keys"] = ToUtf8(s.keys);
             shortcuts.push_back(shortcut);
         }
         j["shortcuts"] = shortcuts;
 
+        // Output rules
+        json outputRules = json::array();
+        for (const auto& r : m_settings.outputRules) {
+            json rule;
+            rule["text"] = r.text;
+            rule["matchCase"] = r.matchCase;
+            if (r.highlight) {
+                rule["highlight"] = ColorToHex(r.color);
+            }
+            rule["bell"] = r.bell;
+            outputRules.push_back(rule);
+        }
+        j["outputRules"] = outputRules;
+
+        // Output logs
+        j["outputLog"]["directory"] = ToUtf8(m_settings.outputLog.directory);
+        j["outputLog"]["compress"] = m_settings.outputLog.compress;
+        j["outputLog"]["rotateMB"] = m_settings.outputLog.rotateMB;
+        j["outputLog"]["rotateMinutes"] = m_settings.outputLog.rotateMinutes;
+        j["outputLog"]["whenBehind"] = ToUtf8(m_settings.outputLog.whenBehind);
+
         // Write to file
         std::ofstream file(path);
         if (!file.is_open()) {
@@ -315,6 +644,14 @@ bool SettingsManager::Save() {
     }
 }
 
+std::optional<SettingsChanges> SettingsManager::Reload() {
+    const Settings previous = m_settings;
+    if (!Load()) {
+        return std::nullopt;
+    }
+    return Settings::Diff(previous, m_settings);
+}
+
 void SettingsManager::ResetToDefaults() {
     m_settings = Settings::GetDefaults();
 }
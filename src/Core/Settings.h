@@ -15,6 +15,9 @@ struct FontSettings {
     float size = 12.0f;
     bool bold = false;
     bool italic = false;
+    bool ligatures = false;     ///< Programming ligatures (Cascadia Code, Fira Code)
+
+    bool operator==(const FontSettings&) const = default;
 };
 
 /// Color scheme (16 ANSI colors + extras)
@@ -46,6 +49,8 @@ struct ColorScheme {
         0x61D6D6, // Bright Cyan
         0xF2F2F2  // Bright White
     };
+
+    bool operator==(const ColorScheme&) const = default;
 };
 
 /// Shell profile
@@ -56,6 +61,14 @@ struct ShellProfile {
     std::wstring workingDir;
     std::wstring icon;
     bool hidden = false;
+
+    // A serial line instead of a shell (console3 --serial <name>)
+    std::wstring serialPort;              ///< COM1, COM12, ... (empty = a shell)
+    uint32_t baud = 115200;
+    std::wstring serialFormat = L"8N1";   ///< Data bits, parity (N/O/E/M/S), stop bits
+    std::wstring flowControl = L"none";   ///< none, rtscts, xonxoff
+
+    bool operator==(const ShellProfile&) const = default;
 };
 
 /// Cursor settings
@@ -63,6 +76,8 @@ struct CursorSettings {
     std::wstring style = L"block";  // block, underline, bar
     bool blink = true;
     uint32_t blinkRate = 530;  // milliseconds
+
+    bool operator==(const CursorSettings&) const = default;
 };
 
 /// Window settings
@@ -73,12 +88,16 @@ struct WindowSettings {
     bool confirmClose = true;
     float opacity = 1.0f;
     bool useAcrylic = false;
+
+    bool operator==(const WindowSettings&) const = default;
 };
 
 /// Keyboard shortcut
 struct Shortcut {
     std::wstring action;
     std::wstring keys;  // e.g., "Ctrl+Shift+C"
+
+    bool operator==(const Shortcut&) const = default;
 };
 
 /// Tab behavior settings
@@ -92,6 +111,93 @@ struct TabSettings {
     bool duplicateOnMiddleClick = false;
     bool showNewTabButton = true;
     bool restoreTabsOnStartup = true;
+
+    bool operator==(const TabSettings&) const = default;
+};
+
+/// Session output logs: each tab's output written to a file as it arrives
+/// (PtyRecorder, RecordingFormat::Raw); applies to tabs opened afterwards
+struct OutputLogSettings {
+    std::wstring directory;             ///< Where logs go (empty = off)
+    bool compress = false;              ///< Write LZ4 frames (.log.lz4)
+    int rotateMB = 0;                   ///< Start a new file past this size (0 = never)
+    int rotateMinutes = 0;              ///< Start a new file past this age (0 = never)
+    std::wstring whenBehind = L"drop";  ///< drop, block, or spill (see RecorderOverflow)
+
+    bool operator==(const OutputLogSettings&) const = default;
+};
+
+/// Performance presets, in the order the settings dialog lists them
+inline constexpr const wchar_t* kPerformancePresets[] = {
+    L"balanced", L"low-latency", L"throughput", L"low-memory", L"remote"
+};
+
+/// Performance tuning of sessions and rendering
+/// A preset fills in every field; fields the file sets next to it override
+/// the preset's values, and the settings file keeps only those. "custom" is
+/// balanced with overrides. Ring, read and scrollback fields apply to
+/// sessions started afterwards; frame rate, cell grid, throttling,
+/// predictive echo and power saving apply at once; the renderer applies to
+/// new windows.
+struct PerformanceSettings {
+    std::wstring preset = L"balanced";
+    int outputBufferKB = 1024;          ///< PTY output ring cap
+    int readChunkKB = 256;              ///< Largest single PTY read (reads grow to it during floods)
+    int highWatermarkPercent = 100;     ///< Ring fill at which the reader waits (100 = full)
+    int lowWatermarkPercent = 50;       ///< Ring fill at which it reads again
+    int scrollbackHotLines = 1000;      ///< Newest lines kept uncompressed; older ones are compressed blocks
+    int imageMemoryMB = 64;             ///< Decoded inline images kept per tab (0 = show none)
+    std::wstring renderer = L"gpu";     ///< gpu (flip-model swap chain), hwnd, or software (dirty rectangles by GDI)
+    std::wstring gpu = L"display";      ///< GPU the gpu renderer uses: display (the monitor's), power, or performance
+    bool cellGridShader = false;        ///< Draw the grid with the cell shader (whole frames on the GPU)
+    int maxFps = 0;                     ///< Frame rate cap (0 = the display's refresh rate)
+    bool throttleBackground = true;     ///< Minimized windows parse at background priority and skip frames
+    int fastForwardMBps = 8;            ///< Output rate that switches to skipping frames (0 = never)
+    bool predictiveEcho = false;        ///< Draw typed text before a slow shell echoes it (see PredictiveEcho)
+    bool saveBatteryPower = true;       ///< On battery: frames capped, slower blink, hidden tabs parsed in batches
+
+    /// Get a preset's values
+    /// @return The settings, or nothing if the name is not a preset
+    [[nodiscard]] static std::optional<PerformanceSettings> FromPreset(const std::wstring& name);
+
+    /// Bring values into range (and the renderer to a known name)
+    /// @return A message for each value changed (empty = all valid)
+    std::vector<std::wstring> Validate();
+
+    bool operator==(const PerformanceSettings&) const = default;
+};
+
+/// Output rule: text to watch for in output lines (see OutputRules)
+struct OutputRule {
+    std::string text;               ///< UTF-8, matched literally within a line
+    bool matchCase = false;
+    bool highlight = false;         ///< Highlight matching lines
+    uint32_t color = 0xC19C00;      ///< Highlight color
+    bool bell = false;              ///< Beep and flash the window on a match
+
+    bool operator==(const OutputRule&) const = default;
+};
+
+/// What differs between two settings, grouped by what applying it touches
+/// Groups not listed here (window, tabs, profiles, shortcuts, singleProcess,
+/// output rules) take effect for windows and sessions opened afterwards.
+struct SettingsChanges {
+    bool colors = false;            ///< Color scheme: views' palettes
+    bool font = false;              ///< Font: views' glyph atlases
+    bool cursor = false;            ///< Cursor style and blink
+    bool scrollback = false;        ///< scrollbackLines: trimmed or raised in place
+    bool scrollbackBudget = false;  ///< The budget all scrollback shares
+    bool warmShells = false;        ///< The warm shell pool's size
+    bool performance = false;       ///< Frame cap, cell grid, throttling (the rest: new sessions)
+    bool transparency = false;      ///< Window opacity and acrylic backdrop
+    bool telemetry = false;         ///< The telemetry endpoint on or off
+    bool other = false;             ///< Anything else
+
+    /// Check if anything differs
+    [[nodiscard]] bool Any() const noexcept {
+        return colors || font || cursor || scrollback || scrollbackBudget || warmShells || performance ||
+               transparency || telemetry || other;
+    }
 };
 
 /// Application settings
@@ -99,6 +205,15 @@ struct Settings {
     // General
     std::wstring defaultProfile;
     int scrollbackLines = 10000;
+    bool scrollbackToDisk = false;  ///< Keep older history in a temp file instead of dropping it
+    bool scrollbackInternLines = true; ///< Store repeated older lines once
+    bool scrollbackTimestamps = false; ///< Keep when each line was printed (hover, search by time)
+    int scrollbackBudgetMB = 512;   ///< Memory all tabs' scrollback may share (0 = no limit)
+    int hibernateAfterMinutes = 10; ///< Page out a hidden session idle this long (0 = never)
+    int warmShellsPerProfile = 1;   ///< Shells started ahead for new tabs, per profile (0 = off)
+    int warmShellMinFreeMB = 1024;  ///< Keep no warm shells with less physical memory free
+    bool singleProcess = true;      ///< Launches open a window in the running process
+    bool telemetryEndpoint = false; ///< Serve performance counters to monitoring agents (TelemetryEndpoint)
     bool copyOnSelect = false;
     bool wordWrap = false;
 
@@ -109,14 +224,28 @@ struct Settings {
     WindowSettings window;
     TabSettings tabs;
 
+    // Tuning
+    PerformanceSettings performance;
+
     // Profiles
     std::vector<ShellProfile> profiles;
 
     // Keyboard shortcuts
     std::vector<Shortcut> shortcuts;
 
+    // Output highlight and bell rules
+    std::vector<OutputRule> outputRules;
+
+    // Output logs
+    OutputLogSettings outputLog;
+
     /// Get default settings
     static Settings GetDefaults();
+
+    /// Compare two settings by group
+    [[nodiscard]] static SettingsChanges Diff(const Settings& before, const Settings& after);
+
+    bool operator==(const Settings&) const = default;
 };
 
 /// Settings manager - load/save settings
@@ -126,13 +255,23 @@ public:
     ~SettingsManager() = default;
 
     /// Load settings from file
-    /// @return true on success
+    /// Keys the file lacks take their defaults. The file is parsed only
+    /// when it changed since the last parse; otherwise the settings come
+    /// from the cache of that parse (SettingsCache).
+    /// @return true on success; on error the settings are left as they were
     bool Load();
 
     /// Save settings to file
     /// @return true on success
     bool Save();
 
+    /// Read the file again, replacing the settings if it parses
+    /// Keys the file no longer has go back to their defaults. A file that
+    /// does not parse (an editor halfway through saving) leaves the
+    /// settings as they were.
+    /// @return What changed, or nothing on error (see GetLastError)
+    [[nodiscard]] std::optional<SettingsChanges> Reload();
+
     /// Reset to defaults
     void ResetToDefaults();
 
@@ -149,9 +288,16 @@ public:
     /// Get the last error message
     [[nodiscard]] const std::wstring& GetLastError() const { return m_lastError; }
 
+    /// Get what the last Load() corrected: unknown names, values out of range
+    [[nodiscard]] const std::vector<std::wstring>& GetWarnings() const { return m_warnings; }
+
+    /// Get the process-wide settings (UI thread; main loads them at startup)
+    [[nodiscard]] static SettingsManager& Shared();
+
 private:
     Settings m_settings;
     std::wstring m_lastError;
+    std::vector<std::wstring> m_warnings;
 };
 
 } // namespace Console3::Core
@@ -0,0 +1,330 @@
+// Console3 - SettingsCache.cpp
+// The last parse of settings.json, kept in binary form for the next start
+
+#include "Core/SettingsCache.h"
+#include "Core/MappedFile.h"
+
+#include <ShlObj.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+#include <type_traits>
+
+namespace Console3::Core {
+
+namespace {
+
+// File layout (little-endian, as written):
+//   "C3SC", version, sizeof(Settings), source size, source write time,
+//   source hash, payload size, payload hash, then the payload: every field
+//   of Settings in declaration order (numbers as stored, strings as u32
+//   length + characters, vectors as u32 count + elements), then the warnings
+constexpr char kMagic[4] = {'C', '3', 'S', 'C'};
+constexpr uint32_t kVersion = 7;
+constexpr wchar_t kCacheName[] = L"settings.c3s";
+constexpr wchar_t kCacheTempName[] = L"settings.c3s.tmp";
+
+/// FNV-1a, to tell whether the settings file (or the cache) changed
+uint64_t HashBytes(std::span<const char> bytes) noexcept {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (const char byte : bytes) {
+        hash = (hash ^ static_cast<uint8_t>(byte)) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+// Each structure's fields are listed once, in Transfer(); the same list
+// writes and reads the cache, so the two can't disagree
+template <typename Archive> void Transfer(Archive& ar, FontSettings& font);
+template <typename Archive> void Transfer(Archive& ar, ColorScheme& scheme);
+template <typename Archive> void Transfer(Archive& ar, ShellProfile& profile);
+template <typename Archive> void Transfer(Archive& ar, CursorSettings& cursor);
+template <typename Archive> void Transfer(Archive& ar, WindowSettings& window);
+template <typename Archive> void Transfer(Archive& ar, Shortcut& shortcut);
+template <typename Archive> void Transfer(Archive& ar, TabSettings& tabs);
+template <typename Archive> void Transfer(Archive& ar, OutputLogSettings& log);
+template <typename Archive> void Transfer(Archive& ar, PerformanceSettings& performance);
+template <typename Archive> void Transfer(Archive& ar, OutputRule& rule);
+template <typename Archive> void Transfer(Archive& ar, Settings& settings);
+
+/// Appends fields to a byte vector
+class Writer {
+public:
+    template <typename... T>
+    void operator()(T&... values) {
+        (Put(values), ...);
+    }
+
+    [[nodiscard]] std::vector<char>& GetBytes() noexcept { return m_bytes; }
+
+private:
+    template <typename T>
+    void Put(T& value) {
+        if constexpr (std::is_arithmetic_v<T>) {
+            const char* bytes = reinterpret_cast<const char*>(&value);
+            m_bytes.insert(m_bytes.end(), bytes, bytes + sizeof(value));
+        } else {
+            Transfer(*this, value);
+        }
+    }
+
+    template <typename Char>
+    void Put(std::basic_string<Char>& text) {
+        auto length = static_cast<uint32_t>(text.size());
+        Put(length);
+        const char* bytes = reinterpret_cast<const char*>(text.data());
+        m_bytes.insert(m_bytes.end(), bytes, bytes + text.size() * sizeof(Char));
+    }
+
+    template <typename T>
+    void Put(std::vector<T>& items) {
+        auto count = static_cast<uint32_t>(items.size());
+        Put(count);
+        for (T& item : items) {
+            Put(item);
+        }
+    }
+
+    std::vector<char> m_bytes;
+};
+
+/// Reads fields from a byte range; any read past its end fails this and
+/// every later read
+class Reader {
+public:
+    explicit Reader(std::span<const char> bytes) noexcept
+        : m_p(bytes.data()), m_end(bytes.data() + bytes.size()) {}
+
+    template <typename... T>
+    void operator()(T&... values) {
+        (Get(values), ...);
+    }
+
+    [[nodiscard]] bool Ok() const noexcept { return m_ok; }
+    [[nodiscard]] bool AtEnd() const noexcept { return !m_ok || m_p == m_end; }
+
+private:
+    bool Need(size_t size) noexcept {
+        if (m_ok && static_cast<size_t>(m_end - m_p) < size) {
+            m_ok = false;
+        }
+        return m_ok;
+    }
+
+    template <typename T>
+    void Get(T& value) {
+        if constexpr (std::is_arithmetic_v<T>) {
+            if (Need(sizeof(T))) {
+                std::memcpy(&value, m_p, sizeof(T));
+                m_p += sizeof(T);
+            }
+        } else {
+            Transfer(*this, value);
+        }
+    }
+
+    template <typename Char>
+    void Get(std::basic_string<Char>& text) {
+        uint32_t length = 0;
+        Get(length);
+        if (!Need(static_cast<size_t>(length) * sizeof(Char))) {
+            return;
+        }
+        text.resize(length);
+        std::memcpy(text.data(), m_p, static_cast<size_t>(length) * sizeof(Char));
+        m_p += static_cast<size_t>(length) * sizeof(Char);
+    }
+
+    template <typename T>
+    void Get(std::vector<T>& items) {
+        uint32_t count = 0;
+        Get(count);
+        // Every element takes at least a byte; a larger count is damage
+        if (!Need(count)) {
+            return;
+        }
+        items.assign(count, T{});
+        for (T& item : items) {
+            Get(item);
+        }
+    }
+
+    const char* m_p;
+    const char* m_end;
+    bool m_ok = true;
+};
+
+template <typename Archive>
+void Transfer(Archive& ar, FontSettings& font) {
+    ar(font.family, font.size, font.bold, font.italic, font.ligatures);
+}
+
+template <typename Archive>
+void Transfer(Archive& ar, ColorScheme& scheme) {
+    ar(scheme.name, scheme.foreground, scheme.background, scheme.cursorColor, scheme.selectionBackground);
+    for (uint32_t& color : scheme.palette) {
+        ar(color);
+    }
+}
+
+template <typename Archive>
+void Transfer(Archive& ar, ShellProfile& profile) {
+    ar(profile.name, profile.shell, profile.args, profile.workingDir, profile.icon, profile.hidden, profile.serialPort,
+       profile.baud, profile.serialFormat, profile.flowControl);
+}
+
+template <typename Archive>
+void Transfer(Archive& ar, CursorSettings& cursor) {
+    ar(cursor.style, cursor.blink, cursor.blinkRate);
+}
+
+template <typename Archive>
+void Transfer(Archive& ar, WindowSettings& window) {
+    ar(window.width, window.height, window.startMaximized, window.confirmClose, window.opacity,
+       window.useAcrylic);
+}
+
+template <typename Archive>
+void Transfer(Archive& ar, Shortcut& shortcut) {
+    ar(shortcut.action, shortcut.keys);
+}
+
+template <typename Archive>
+void Transfer(Archive& ar, TabSettings& tabs) {
+    ar(tabs.newTabPosition, tabs.closeLastTabAction, tabs.tabWidthMin, tabs.tabWidthMax, tabs.showCloseButton,
+       tabs.confirmTabClose, tabs.duplicateOnMiddleClick, tabs.showNewTabButton, tabs.restoreTabsOnStartup);
+}
+
+template <typename Archive>
+void Transfer(Archive& ar, PerformanceSettings& performance) {
+    ar(performance.preset, performance.outputBufferKB, performance.readChunkKB, performance.highWatermarkPercent,
+       performance.lowWatermarkPercent, performance.scrollbackHotLines, performance.renderer,
+       performance.gpu, performance.cellGridShader, performance.maxFps, performance.throttleBackground,
+       performance.fastForwardMBps, performance.predictiveEcho, performance.saveBatteryPower);
+}
+
+template <typename Archive>
+void Transfer(Archive& ar, OutputLogSettings& log) {
+    ar(log.directory, log.compress, log.rotateMB, log.rotateMinutes, log.whenBehind);
+}
+
+template <typename Archive>
+void Transfer(Archive& ar, OutputRule& rule) {
+    ar(rule.text, rule.matchCase, rule.highlight, rule.color, rule.bell);
+}
+
+template <typename Archive>
+void Transfer(Archive& ar, Settings& settings) {
+    ar(settings.defaultProfile, settings.scrollbackLines, settings.scrollbackToDisk, settings.scrollbackInternLines,
+       settings.scrollbackTimestamps, settings.scrollbackBudgetMB, settings.hibernateAfterMinutes, settings.warmShellsPerProfile, settings.warmShellMinFreeMB,
+       settings.singleProcess, settings.copyOnSelect, settings.wordWrap);
+    ar(settings.font, settings.colorScheme, settings.cursor, settings.window, settings.tabs, settings.performance);
+    ar(settings.profiles, settings.shortcuts, settings.outputRules, settings.outputLog);
+}
+
+/// Bytes of the header as written (not sizeof(Header), which is padded)
+constexpr size_t kHeaderSize = 4 + 3 * sizeof(uint32_t) + 4 * sizeof(uint64_t);
+
+/// The header before the payload
+struct Header {
+    char magic[4] = {};
+    uint32_t version = 0;
+    uint32_t layout = 0;            ///< sizeof(Settings) of the process that wrote it
+    uint64_t sourceSize = 0;
+    uint64_t sourceWriteTime = 0;
+    uint64_t sourceHash = 0;
+    uint32_t payloadSize = 0;
+    uint64_t payloadHash = 0;
+};
+
+} // namespace
+
+bool SettingsCache::Read(std::span<const char> source, uint64_t writeTime, Settings& settings,
+                         std::vector<std::wstring>& warnings) {
+    const std::shared_ptr<const MappedFile> file = MappedFile::Open(GetPath());
+    if (!file) {
+        return false;
+    }
+
+    // Cheapest checks first; the source is hashed only if its size and
+    // time match
+    const std::span<const char> bytes = file->GetBytes();
+    Header header;
+    Reader in(bytes);
+    in(header.magic[0], header.magic[1], header.magic[2], header.magic[3], header.version, header.layout,
+       header.sourceSize, header.sourceWriteTime, header.sourceHash, header.payloadSize, header.payloadHash);
+    if (!in.Ok() || !std::equal(std::begin(kMagic), std::end(kMagic), header.magic) ||
+        header.version != kVersion || header.layout != sizeof(Settings) || header.sourceSize != source.size() ||
+        header.sourceWriteTime != writeTime || bytes.size() != kHeaderSize + header.payloadSize ||
+        HashBytes(source) != header.sourceHash) {
+        return false;
+    }
+
+    const std::span<const char> payload = bytes.subspan(kHeaderSize);
+    if (HashBytes(payload) != header.payloadHash) {
+        return false;
+    }
+
+    Settings cached;
+    std::vector<std::wstring> cachedWarnings;
+    Reader body(payload);
+    body(cached, cachedWarnings);
+    if (!body.Ok() || !body.AtEnd()) {
+        return false;
+    }
+    settings = std::move(cached);
+    warnings = std::move(cachedWarnings);
+    return true;
+}
+
+bool SettingsCache::Write(std::span<const char> source, uint64_t writeTime, const Settings& settings,
+                          const std::vector<std::wstring>& warnings) {
+    Settings fields = settings;
+    std::vector<std::wstring> warningFields = warnings;
+    Writer payload;
+    payload(fields, warningFields);
+    const std::vector<char>& payloadBytes = payload.GetBytes();
+
+    Header header;
+    std::copy(std::begin(kMagic), std::end(kMagic), header.magic);
+    header.version = kVersion;
+    header.layout = sizeof(Settings);
+    header.sourceSize = source.size();
+    header.sourceWriteTime = writeTime;
+    header.sourceHash = HashBytes(source);
+    header.payloadSize = static_cast<uint32_t>(payloadBytes.size());
+    header.payloadHash = HashBytes(payloadBytes);
+
+    Writer out;
+    out(header.magic[0], header.magic[1], header.magic[2], header.magic[3], header.version, header.layout,
+        header.sourceSize, header.sourceWriteTime, header.sourceHash, header.payloadSize, header.payloadHash);
+    out.GetBytes().insert(out.GetBytes().end(), payloadBytes.begin(), payloadBytes.end());
+
+    // A new cache replaces the old one whole, or not at all
+    const std::filesystem::path path = GetPath();
+    const std::filesystem::path temp = path.parent_path() / kCacheTempName;
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        file.write(out.GetBytes().data(), static_cast<std::streamsize>(out.GetBytes().size()));
+        if (!file) {
+            return false;
+        }
+    }
+    return MoveFileExW(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != FALSE;
+}
+
+std::filesystem::path SettingsCache::GetPath() {
+    wchar_t* localAppData = nullptr;
+    if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, nullptr, &localAppData))) {
+        std::filesystem::path path = localAppData;
+        CoTaskMemFree(localAppData);
+        return path / L"Console3" / kCacheName;
+    }
+    return kCacheName;
+}
+
+} // namespace Console3::Core
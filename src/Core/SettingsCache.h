@@ -0,0 +1,50 @@
+#pragma once
+// Console3 - SettingsCache.h
+// The last parse of settings.json, kept in binary form for the next start
+//
+// Parsing settings.json (profiles, color schemes through HexToColor,
+// shortcuts, output rules) runs before the first window is created, and a
+// file with many profiles or a large color scheme collection makes it a
+// measurable part of a cold start. Every parse is therefore also written to
+// %LOCALAPPDATA%\Console3\settings.c3s: the settings and the warnings the
+// parse produced, keyed by the JSON file's size, last write time and FNV-1a
+// hash. At the next start the cache is mapped and checked against the file,
+// and only a file that changed since is parsed as JSON.
+//
+// The cache holds the whole Settings structure field by field, so any
+// change to the structure must bump kVersion in SettingsCache.cpp (a cache
+// whose layout does not match is ignored and rewritten, never misread). It
+// is written to a temporary file and renamed into place, and a cache torn
+// or damaged anyway fails its own hash and is treated as missing.
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Core/Settings.h"
+
+namespace Console3::Core {
+
+/// Binary cache of the parsed settings file
+class SettingsCache {
+public:
+    /// Read the settings cached for a settings file
+    /// @param source The settings file's bytes
+    /// @param writeTime The settings file's last write time
+    /// @return true if the cache is of exactly this file; settings and
+    ///         warnings are set only then
+    [[nodiscard]] static bool Read(std::span<const char> source, uint64_t writeTime, Settings& settings,
+                                   std::vector<std::wstring>& warnings);
+
+    /// Cache the settings parsed from a settings file
+    /// @return true if the cache was written
+    static bool Write(std::span<const char> source, uint64_t writeTime, const Settings& settings,
+                      const std::vector<std::wstring>& warnings);
+
+    /// Get the cache's path
+    [[nodiscard]] static std::filesystem::path GetPath();
+};
+
+} // namespace Console3::Core
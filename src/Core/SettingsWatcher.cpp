@@ -0,0 +1,37 @@
+// Console3 - SettingsWatcher.cpp
+// Notices when the settings file changes on disk
+
+#include "Core/SettingsWatcher.h"
+
+namespace Console3::Core {
+
+bool SettingsWatcher::Start(const std::filesystem::path& path) {
+    Stop();
+
+    std::error_code error;
+    const std::filesystem::path folder = path.parent_path();
+    std::filesystem::create_directories(folder, error);
+    if (!m_changed && !m_changed.try_create(wil::EventOptions::None, nullptr)) {
+        return false;
+    }
+
+    // Names arrive relative to the folder; changes lost to an overflowing
+    // buffer may have included the file
+    m_fileName = path.filename().wstring();
+    m_reader = wil::make_folder_change_reader_nothrow(
+        folder.c_str(), false, wil::FolderChangeEvents::FileName | wil::FolderChangeEvents::LastWriteTime,
+        [this](wil::FolderChangeEvent event, PCWSTR fileName) {
+            if (event == wil::FolderChangeEvent::ChangesLost ||
+                (event != wil::FolderChangeEvent::Removed && event != wil::FolderChangeEvent::RenameOldName &&
+                 _wcsicmp(fileName, m_fileName.c_str()) == 0)) {
+                m_changed.SetEvent();
+            }
+        });
+    return static_cast<bool>(m_reader);
+}
+
+void SettingsWatcher::Stop() {
+    m_reader.reset();
+}
+
+} // namespace Console3::Core
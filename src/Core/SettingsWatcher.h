@@ -0,0 +1,55 @@
+#pragma once
+// Console3 - SettingsWatcher.h
+// Notices when the settings file changes on disk
+//
+// Watches the folder settings.json is in (the file itself can't be watched,
+// and editors often save by writing a temporary file and renaming it over
+// the old one) and signals an event whenever the file is written, created
+// or renamed into place. The owner waits on the event on the UI thread,
+// lets the writes settle and calls SettingsManager::Reload(), then applies
+// what the returned SettingsChanges says changed.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+#include <filesystem>
+#include <string>
+
+#include <wil/filesystem.h>
+#include <wil/resource.h>
+
+namespace Console3::Core {
+
+/// Signals an event when one file changes (see file comment)
+class SettingsWatcher {
+public:
+    SettingsWatcher() = default;
+    ~SettingsWatcher() { Stop(); }
+
+    SettingsWatcher(const SettingsWatcher&) = delete;
+    SettingsWatcher& operator=(const SettingsWatcher&) = delete;
+
+    /// Start watching a file
+    /// @param path File to watch (its folder is created if missing)
+    /// @return false if the folder can't be watched
+    [[nodiscard]] bool Start(const std::filesystem::path& path);
+
+    /// Stop watching (waits for a notification being delivered)
+    void Stop();
+
+    /// Get the event set after the file changes (auto-reset; several
+    /// changes in a row may set it once)
+    [[nodiscard]] HANDLE GetChangeEvent() const noexcept { return m_changed.get(); }
+
+private:
+    std::wstring m_fileName;        ///< Name within the folder (read on the pool thread)
+    wil::unique_event_nothrow m_changed;
+    wil::unique_folder_change_reader_nothrow m_reader;
+};
+
+} // namespace Console3::Core
@@ -0,0 +1,46 @@
+// Console3 - Sgr.cpp
+// SGR sequences that restate a cell's style
+
+#include "Core/Sgr.h"
+#include <cstdio>
+
+namespace Console3::Core {
+
+void AppendSgrColor(std::string& out, CellColor color, int base) {
+    char text[32];
+    if (color.IsDefault()) {
+        return;
+    }
+    if (color.IsIndexed()) {
+        const int index = color.r;
+        if (index < 8) {
+            snprintf(text, sizeof(text), ";%d", base + index);
+        } else if (index < 16) {
+            snprintf(text, sizeof(text), ";%d", base + 60 + index - 8);
+        } else {
+            snprintf(text, sizeof(text), ";%d;5;%d", base + 8, index);
+        }
+    } else {
+        snprintf(text, sizeof(text), ";%d;2;%d;%d;%d", base + 8, color.r, color.g, color.b);
+    }
+    out += text;
+}
+
+void AppendSgr(std::string& out, const Cell& cell) {
+    const CellAttributes attrs = cell.Attributes();
+    out += "\x1b[0";
+    if (attrs.bold) out += ";1";
+    if (attrs.italic) out += ";3";
+    if (attrs.underline == 1) out += ";4";
+    if (attrs.underline == 2) out += ";21";
+    if (attrs.underline == 3) out += ";4:3";
+    if (attrs.blink) out += ";5";
+    if (attrs.reverse) out += ";7";
+    if (attrs.conceal) out += ";8";
+    if (attrs.strikethrough) out += ";9";
+    AppendSgrColor(out, cell.fg, 30);
+    AppendSgrColor(out, cell.bg, 40);
+    out += 'm';
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,25 @@
+#pragma once
+// Console3 - Sgr.h
+// SGR sequences that restate a cell's style
+//
+// A detached session's screen frames and an ANSI history export both
+// write text a terminal will draw again, styled as the cells were. Each
+// styled run starts with a full SGR (reset, attributes, colors), so
+// nothing from the run before has to be undone. Colors keep their
+// palette form: the 16 base colors as 30-37/90-97 (40-47/100-107), the
+// rest of the 256 as 38;5/48;5, and true colors as 38;2/48;2.
+
+#include "Core/Cell.h"
+#include <string>
+
+namespace Console3::Core {
+
+/// Append a color's SGR parameters, each with a leading ';' (nothing for
+/// the default color)
+/// @param base 30 for foreground, 40 for background
+void AppendSgrColor(std::string& out, CellColor color, int base);
+
+/// Append an SGR that sets a cell's style in full
+void AppendSgr(std::string& out, const Cell& cell);
+
+} // namespace Console3::Core
@@ -2,55 +2,145 @@
 // Shell detection and enumeration implementation
 
 #include "Core/ShellDetector.h"
+#include "Core/Utf.h"
+#include <nlohmann/json.hpp>
 #include <algorithm>
 #include <array>
+#include <fstream>
 #include <shlwapi.h>
+#include <ShlObj.h>
 
 #pragma comment(lib, "shlwapi.lib")
 #pragma comment(lib, "version.lib")
 
 namespace Console3::Core {
 
-std::vector<ShellInfo> ShellDetector::DetectShells() {
-    if (m_cacheValid) {
-        return m_cachedShells;
+using json = nlohmann::json;
+
+namespace {
+
+// Where each shell is looked for (environment variables unexpanded)
+constexpr const wchar_t* kCmdFallbackPath = L"%SystemRoot%\\System32\\cmd.exe";
+constexpr const wchar_t* kPowerShellPath = L"%SystemRoot%\\System32\\WindowsPowerShell\\v1.0\\powershell.exe";
+constexpr const wchar_t* kWslPath = L"%SystemRoot%\\System32\\wsl.exe";
+constexpr std::array<const wchar_t*, 3> kPwshPaths = {
+    L"%ProgramFiles%\\PowerShell\\7\\pwsh.exe",
+    L"%ProgramFiles(x86)%\\PowerShell\\7\\pwsh.exe",
+    L"%LocalAppData%\\Microsoft\\WindowsApps\\pwsh.exe"     // Windows Store version
+};
+constexpr std::array<const wchar_t*, 3> kGitBashPaths = {
+    L"%ProgramFiles%\\Git\\bin\\bash.exe",
+    L"%ProgramFiles(x86)%\\Git\\bin\\bash.exe",
+    L"%LocalAppData%\\Programs\\Git\\bin\\bash.exe"
+};
+
+constexpr const wchar_t* kLxssKey = L"SOFTWARE\\Microsoft\\Windows\\CurrentVersion\\Lxss";
+
+// Bumped when the cache's layout or what detection finds changes
+constexpr int kCacheVersion = 1;
+
+/// JSON strings convert to std::string, not string_view
+std::wstring Utf8ToWide(const std::string& utf8) {
+    return ToUtf16(utf8);
+}
+
+uint64_t FileTimeValue(const FILETIME& time) noexcept {
+    return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+}
+
+} // namespace
+
+ShellDetector::~ShellDetector() {
+    if (m_thread.joinable()) {
+        m_thread.join();
     }
+}
+
+ShellDetector& ShellDetector::Shared() {
+    static ShellDetector s_instance;
+    return s_instance;
+}
+
+std::vector<ShellInfo> ShellDetector::DetectShells() {
+    std::lock_guard<std::mutex> detect(m_detectLock);
+    Refresh();
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_cachedShells;
+}
 
-    m_cachedShells.clear();
+std::vector<ShellInfo> ShellDetector::ProbeShells() {
+    std::vector<ShellInfo> shells;
 
     // Detect each known shell type
     auto cmd = DetectCmd();
     if (cmd.isAvailable) {
-        m_cachedShells.push_back(std::move(cmd));
+        shells.push_back(std::move(cmd));
     }
 
     auto powershell = DetectPowerShell();
     if (powershell.isAvailable) {
-        m_cachedShells.push_back(std::move(powershell));
+        shells.push_back(std::move(powershell));
     }
 
     auto pwsh = DetectPwsh();
     if (pwsh.isAvailable) {
-        m_cachedShells.push_back(std::move(pwsh));
+        shells.push_back(std::move(pwsh));
     }
 
     auto wsl = DetectWsl();
     if (wsl.isAvailable) {
-        m_cachedShells.push_back(std::move(wsl));
+        shells.push_back(std::move(wsl));
     }
 
     auto gitBash = DetectGitBash();
     if (gitBash.isAvailable) {
-        m_cachedShells.push_back(std::move(gitBash));
+        shells.push_back(std::move(gitBash));
     }
 
     // Mark first available shell as default
-    if (!m_cachedShells.empty()) {
-        m_cachedShells[0].isDefault = true;
+    if (!shells.empty()) {
+        shells[0].isDefault = true;
+    }
+    return shells;
+}
+
+void ShellDetector::DetectInBackground(std::function<void()> onDone) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_thread.joinable() || m_cacheValid) {
+        return;
     }
 
-    m_cacheValid = true;
-    return m_cachedShells;
+    m_thread = std::thread([this, onDone = std::move(onDone)]() {
+        {
+            std::lock_guard<std::mutex> detect(m_detectLock);
+            Refresh();
+        }
+        if (onDone) {
+            onDone();
+        }
+    });
+}
+
+bool ShellDetector::IsDetected() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_cacheValid;
+}
+
+std::vector<ShellInfo> ShellDetector::GetCachedShells() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_cacheValid ? m_cachedShells : std::vector<ShellInfo>{};
+}
+
+std::vector<std::wstring> ShellDetector::GetCachedWslDistros() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_cachedDistros;
+}
+
+std::vector<std::wstring> ShellDetector::GetWslDistros() {
+    std::lock_guard<std::mutex> detect(m_detectLock);
+    Refresh();
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_cachedDistros;
 }
 
 std::optional<ShellInfo> ShellDetector::GetDefaultShell() {
@@ -104,7 +194,7 @@ std::vector<std::wstring> ShellDetector::DetectWslDistros() {
     HKEY hKey;
     LONG result = RegOpenKeyExW(
         HKEY_CURRENT_USER,
-        L"SOFTWARE\\Microsoft\\Windows\\CurrentVersion\\Lxss",
+        kLxssKey,
         0,
         KEY_READ,
         &hKey
@@ -152,7 +242,7 @@ ShellInfo ShellDetector::CreateWslDistroShell(const std::wstring& distroName) {
     ShellInfo info;
     info.type = ShellType::Wsl;
     info.name = L"WSL: " + distroName;
-    info.path = ExpandPath(L"%SystemRoot%\\System32\\wsl.exe");
+    info.path = ExpandPath(kWslPath);
     info.args = L"-d " + distroName;
     info.isAvailable = FileExists(info.path);
     return info;
@@ -192,7 +282,7 @@ ShellInfo ShellDetector::DetectCmd() {
     
     // Fallback if COMSPEC is not set
     if (info.path.empty() || !FileExists(info.path)) {
-        info.path = ExpandPath(L"%SystemRoot%\\System32\\cmd.exe");
+        info.path = ExpandPath(kCmdFallbackPath);
     }
 
     info.isAvailable = FileExists(info.path);
@@ -207,7 +297,7 @@ ShellInfo ShellDetector::DetectPowerShell() {
     ShellInfo info;
     info.type = ShellType::PowerShell;
     info.name = L"Windows PowerShell";
-    info.path = ExpandPath(L"%SystemRoot%\\System32\\WindowsPowerShell\\v1.0\\powershell.exe");
+    info.path = ExpandPath(kPowerShellPath);
     info.args = L"-NoLogo";
     info.isAvailable = FileExists(info.path);
     
@@ -225,13 +315,8 @@ ShellInfo ShellDetector::DetectPwsh() {
     info.args = L"-NoLogo";
 
     // Check common installation paths for PowerShell Core
-    std::array<std::wstring, 3> searchPaths = {
-        ExpandPath(L"%ProgramFiles%\\PowerShell\\7\\pwsh.exe"),
-        ExpandPath(L"%ProgramFiles(x86)%\\PowerShell\\7\\pwsh.exe"),
-        ExpandPath(L"%LocalAppData%\\Microsoft\\WindowsApps\\pwsh.exe")  // Windows Store version
-    };
-
-    for (const auto& path : searchPaths) {
+    for (const wchar_t* searchPath : kPwshPaths) {
+        const std::wstring path = ExpandPath(searchPath);
         if (FileExists(path)) {
             info.path = path;
             info.isAvailable = true;
@@ -247,7 +332,7 @@ ShellInfo ShellDetector::DetectWsl() {
     ShellInfo info;
     info.type = ShellType::Wsl;
     info.name = L"WSL";
-    info.path = ExpandPath(L"%SystemRoot%\\System32\\wsl.exe");
+    info.path = ExpandPath(kWslPath);
     info.isAvailable = FileExists(info.path);
 
     return info;
@@ -260,13 +345,8 @@ ShellInfo ShellDetector::DetectGitBash() {
     info.args = L"--login -i";
 
     // Check common installation paths for Git Bash
-    std::array<std::wstring, 3> searchPaths = {
-        ExpandPath(L"%ProgramFiles%\\Git\\bin\\bash.exe"),
-        ExpandPath(L"%ProgramFiles(x86)%\\Git\\bin\\bash.exe"),
-        ExpandPath(L"%LocalAppData%\\Programs\\Git\\bin\\bash.exe")
-    };
-
-    for (const auto& path : searchPaths) {
+    for (const wchar_t* searchPath : kGitBashPaths) {
+        const std::wstring path = ExpandPath(searchPath);
         if (FileExists(path)) {
             info.path = path;
             info.isAvailable = true;
@@ -320,4 +400,181 @@ std::wstring ShellDetector::GetFileVersion(const std::wstring& path) {
            std::to_wstring(LOWORD(fileInfo->dwFileVersionLS));
 }
 
+// ============================================================================
+// Cache
+// ============================================================================
+
+std::filesystem::path ShellDetector::GetCachePath() {
+    wchar_t* localAppData = nullptr;
+    if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, nullptr, &localAppData))) {
+        std::filesystem::path path = localAppData;
+        CoTaskMemFree(localAppData);
+        return path / L"Console3" / L"shells.json";
+    }
+    return L"shells.json";
+}
+
+void ShellDetector::Refresh() {
+    if (!m_diskLoaded) {
+        m_diskLoaded = true;
+        LoadCache();
+
+        // From here on a change to the distros is seen as it happens
+        m_wslWatcher = wil::make_registry_watcher_nothrow(HKEY_CURRENT_USER, kLxssKey, true,
+            [this](wil::RegistryChangeKind) { m_distrosStale.store(true); });
+    }
+
+    bool changed = false;
+
+    // A few attribute reads tell whether a shell was installed, updated or removed
+    std::vector<FileStamp> stamps = StampFiles();
+    bool shellsCurrent = false;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        shellsCurrent = m_cacheValid && stamps == m_fileStamps;
+    }
+    if (!shellsCurrent) {
+        std::vector<ShellInfo> shells = ProbeShells();
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_cachedShells = std::move(shells);
+        m_cacheValid = true;
+        m_fileStamps = std::move(stamps);
+        changed = true;
+    }
+
+    // Without a watcher (no Lxss key yet) the stamp is checked every time
+    if (m_distrosStale.exchange(false) || !m_wslWatcher) {
+        const uint64_t stamp = StampWslDistros();
+        if (!m_distrosCached || stamp != m_wslStamp) {
+            std::vector<std::wstring> distros = DetectWslDistros();
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_cachedDistros = std::move(distros);
+            m_wslStamp = stamp;
+            m_distrosCached = true;
+            changed = true;
+        }
+    }
+
+    if (changed) {
+        SaveCache();
+    }
+}
+
+std::vector<ShellDetector::FileStamp> ShellDetector::StampFiles() {
+    std::vector<const wchar_t*> paths = {L"%ComSpec%", kCmdFallbackPath, kPowerShellPath, kWslPath};
+    paths.insert(paths.end(), kPwshPaths.begin(), kPwshPaths.end());
+    paths.insert(paths.end(), kGitBashPaths.begin(), kGitBashPaths.end());
+
+    std::vector<FileStamp> stamps;
+    stamps.reserve(paths.size());
+    for (const wchar_t* path : paths) {
+        FileStamp stamp;
+        stamp.path = ExpandPath(path);
+        WIN32_FILE_ATTRIBUTE_DATA data{};
+        if (GetFileAttributesExW(stamp.path.c_str(), GetFileExInfoStandard, &data) &&
+            !(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+            stamp.writeTime = std::max<uint64_t>(FileTimeValue(data.ftLastWriteTime), 1);
+        }
+        stamps.push_back(std::move(stamp));
+    }
+    return stamps;
+}
+
+uint64_t ShellDetector::StampWslDistros() {
+    wil::unique_hkey key;
+    if (RegOpenKeyExW(HKEY_CURRENT_USER, kLxssKey, 0, KEY_READ, key.put()) != ERROR_SUCCESS) {
+        return 0;
+    }
+
+    DWORD subKeys = 0;
+    FILETIME lastWrite{};
+    if (RegQueryInfoKeyW(key.get(), nullptr, nullptr, nullptr, &subKeys, nullptr, nullptr, nullptr,
+                         nullptr, nullptr, nullptr, &lastWrite) != ERROR_SUCCESS) {
+        return 0;
+    }
+    return FileTimeValue(lastWrite) ^ (static_cast<uint64_t>(subKeys) << 56);
+}
+
+void ShellDetector::LoadCache() {
+    try {
+        std::ifstream file(GetCachePath());
+        if (!file.is_open()) {
+            return;
+        }
+        const json j = json::parse(file);
+        if (j.value("version", 0) != kCacheVersion) {
+            return;
+        }
+
+        std::vector<FileStamp> stamps;
+        for (const auto& item : j.at("files")) {
+            stamps.push_back({Utf8ToWide(item.at("path")), item.at("writeTime").get<uint64_t>()});
+        }
+        std::vector<ShellInfo> shells;
+        for (const auto& item : j.at("shells")) {
+            ShellInfo info;
+            info.type = static_cast<ShellType>(item.at("type").get<int>());
+            info.name = Utf8ToWide(item.at("name"));
+            info.path = Utf8ToWide(item.at("path"));
+            info.args = Utf8ToWide(item.at("args"));
+            info.version = Utf8ToWide(item.at("version"));
+            info.isDefault = item.at("isDefault");
+            info.isAvailable = true;
+            shells.push_back(std::move(info));
+        }
+        std::vector<std::wstring> distros;
+        for (const auto& item : j.at("wslDistros")) {
+            distros.push_back(Utf8ToWide(item));
+        }
+
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_fileStamps = std::move(stamps);
+        m_cachedShells = std::move(shells);
+        m_cacheValid = true;
+        m_cachedDistros = std::move(distros);
+        m_wslStamp = j.at("wslStamp").get<uint64_t>();
+        m_distrosCached = true;
+    } catch (...) {
+        // A damaged cache is as good as none: everything is probed again
+    }
+}
+
+void ShellDetector::SaveCache() const {
+    try {
+        json j;
+        j["version"] = kCacheVersion;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            j["files"] = json::array();
+            for (const FileStamp& stamp : m_fileStamps) {
+                j["files"].push_back({{"path", ToUtf8(stamp.path)}, {"writeTime", stamp.writeTime}});
+            }
+            j["shells"] = json::array();
+            for (const ShellInfo& info : m_cachedShells) {
+                j["shells"].push_back({
+                    {"type", static_cast<int>(info.type)},
+                    {"name", ToUtf8(info.name)},
+                    {"path", ToUtf8(info.path)},
+                    {"args", ToUtf8(info.args)},
+                    {"version", ToUtf8(info.version)},
+                    {"isDefault", info.isDefault},
+                });
+            }
+            j["wslStamp"] = m_wslStamp;
+            j["wslDistros"] = json::array();
+            for (const std::wstring& distro : m_cachedDistros) {
+                j["wslDistros"].push_back(ToUtf8(distro));
+            }
+        }
+
+        const std::filesystem::path path = GetCachePath();
+        std::error_code error;
+        std::filesystem::create_directories(path.parent_path(), error);
+        std::ofstream file(path, std::ios::trunc);
+        file << j.dump(2);
+    } catch (...) {
+        // Not cached: the next launch probes again
+    }
+}
+
 } // namespace Console3::Core
@@ -3,6 +3,18 @@
 // Shell detection and enumeration utilities
 //
 // Detects available shells on the system and provides their paths and metadata.
+//
+// Detection probes files, version resources and the registry, which is too
+// slow for the startup path. The shared detector runs it once on a background
+// thread after the window is up (DetectInBackground); callers that cannot
+// wait read the cache, which is empty until then.
+//
+// Results are also kept on disk (GetCachePath), with the last write time of
+// every file detection looked at and a stamp of the WSL (Lxss) registry key.
+// A later launch, or a later call, only checks those stamps - a few
+// attribute reads - and probes again only if one changed. While the detector
+// lives, a registry watcher on the Lxss key marks the distros stale as soon
+// as one is added, removed or renamed.
 
 #ifndef NTDDI_VERSION
 #define NTDDI_VERSION NTDDI_WIN10_RS5
@@ -12,7 +24,14 @@
 #endif
 
 #include <Windows.h>
+#include <wil/registry.h>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 #include <optional>
 
@@ -46,12 +65,42 @@ struct ShellInfo {
 class ShellDetector {
 public:
     ShellDetector() = default;
-    ~ShellDetector() = default;
+    ~ShellDetector();
+
+    // Non-copyable, non-movable (owns the detection thread)
+    ShellDetector(const ShellDetector&) = delete;
+    ShellDetector& operator=(const ShellDetector&) = delete;
+
+    /// Get the process-wide detector, whose cache the UI shares
+    static ShellDetector& Shared();
 
     /// Detect all available shells on the system
+    /// Probes only if the on-disk cache is missing or a file it depends on
+    /// changed (waiting for a background detection in progress instead of
+    /// repeating it); otherwise returns the cache.
     /// @return Vector of detected shells
     [[nodiscard]] std::vector<ShellInfo> DetectShells();
 
+    /// Detect shells and WSL distributions on a background thread (once)
+    /// @param onDone Called on that thread when the cache is filled
+    void DetectInBackground(std::function<void()> onDone = {});
+
+    /// Check if detection has finished
+    [[nodiscard]] bool IsDetected() const;
+
+    /// Get the detected shells without waiting (empty until IsDetected())
+    [[nodiscard]] std::vector<ShellInfo> GetCachedShells() const;
+
+    /// Get the WSL distributions a background detection found
+    [[nodiscard]] std::vector<std::wstring> GetCachedWslDistros() const;
+
+    /// Get the WSL distributions, reading the registry again only if the
+    /// Lxss key changed since they were cached
+    [[nodiscard]] std::vector<std::wstring> GetWslDistros();
+
+    /// Get the file detection results are cached in between launches
+    [[nodiscard]] static std::filesystem::path GetCachePath();
+
     /// Get the default shell for the system
     /// @return ShellInfo for the default shell, or nullopt if none detected
     [[nodiscard]] std::optional<ShellInfo> GetDefaultShell();
@@ -66,7 +115,7 @@ public:
     /// @return ShellInfo if found, nullopt otherwise
     [[nodiscard]] std::optional<ShellInfo> GetShellByType(ShellType type);
 
-    /// Detect WSL distributions
+    /// Detect WSL distributions (reads the registry; see GetWslDistros)
     /// @return Vector of WSL distribution names
     [[nodiscard]] std::vector<std::wstring> DetectWslDistros();
 
@@ -84,6 +133,32 @@ public:
     [[nodiscard]] static std::wstring GetShellTypeName(ShellType type);
 
 private:
+    /// A file detection looks at, and its last write time (0 = missing)
+    struct FileStamp {
+        std::wstring path;
+        uint64_t writeTime = 0;
+
+        bool operator==(const FileStamp&) const = default;
+    };
+
+    /// Bring the cache up to date, probing only what changed (m_detectLock held)
+    void Refresh();
+
+    /// Probe every known shell (reads version resources)
+    [[nodiscard]] std::vector<ShellInfo> ProbeShells();
+
+    /// Stamp every file detection looks at
+    [[nodiscard]] static std::vector<FileStamp> StampFiles();
+
+    /// Stamp the Lxss key: its last write time and number of distros
+    [[nodiscard]] static uint64_t StampWslDistros();
+
+    /// Read the on-disk cache into the members (m_detectLock held)
+    void LoadCache();
+
+    /// Write the cache to disk (m_detectLock held)
+    void SaveCache() const;
+
     /// Detect Windows Command Prompt
     [[nodiscard]] ShellInfo DetectCmd();
 
@@ -109,8 +184,20 @@ private:
     [[nodiscard]] static std::wstring GetFileVersion(const std::wstring& path);
 
 private:
+    std::mutex m_detectLock;                    ///< Held while probing, so probes don't repeat
+    mutable std::mutex m_lock;                  ///< Guards the cache
     std::vector<ShellInfo> m_cachedShells;
+    std::vector<std::wstring> m_cachedDistros;
     bool m_cacheValid = false;
+    std::thread m_thread;                       ///< Background detection
+
+    // What the cache was built from (m_detectLock)
+    std::vector<FileStamp> m_fileStamps;
+    uint64_t m_wslStamp = 0;
+    bool m_distrosCached = false;
+    bool m_diskLoaded = false;                  ///< The on-disk cache was read
+    std::atomic<bool> m_distrosStale{true};     ///< Set by the watcher
+    wil::unique_registry_watcher_nothrow m_wslWatcher;
 };
 
 } // namespace Console3::Core
@@ -0,0 +1,203 @@
+// Console3 - SixelImage.cpp
+// Sixel graphics: measuring and decoding a DCS q payload
+
+#include "Core/SixelImage.h"
+
+#include <algorithm>
+#include <array>
+#include <new>
+
+namespace Console3::Core {
+
+namespace {
+
+constexpr size_t kRegisters = 256;
+constexpr uint32_t kBandHeight = 6;
+
+/// Read up to max numeric parameters ("1;2;3") starting at pos, leaving
+/// pos after them
+/// @return How many were given (an empty one counts, as 0)
+size_t ReadParams(std::string_view data, size_t& pos, uint32_t* params, size_t max) noexcept {
+    size_t count = 0;
+    uint32_t value = 0;
+    bool any = false;
+    for (; pos < data.size(); ++pos) {
+        const char c = data[pos];
+        if (c >= '0' && c <= '9') {
+            value = std::min<uint32_t>(value * 10 + static_cast<uint32_t>(c - '0'), 1u << 24);
+            any = true;
+        } else if (c == ';') {
+            if (count < max) {
+                params[count] = value;
+            }
+            ++count;
+            value = 0;
+            any = true;
+        } else {
+            break;
+        }
+    }
+    if (any) {
+        if (count < max) {
+            params[count] = value;
+        }
+        ++count;
+    }
+    return std::min(count, max);
+}
+
+/// Opaque BGRA from percentages
+[[nodiscard]] uint32_t FromPercent(uint32_t r, uint32_t g, uint32_t b) noexcept {
+    const auto channel = [](uint32_t percent) { return (std::min(percent, 100u) * 255 + 50) / 100; };
+    return 0xFF000000u | channel(r) << 16 | channel(g) << 8 | channel(b);
+}
+
+/// Opaque BGRA from DEC HLS: hue in degrees with blue at 0, red at 120 and
+/// green at 240; lightness and saturation in percent
+[[nodiscard]] uint32_t FromHls(uint32_t hue, uint32_t lightness, uint32_t saturation) noexcept {
+    const double l = std::min(lightness, 100u) / 100.0;
+    const double s = std::min(saturation, 100u) / 100.0;
+    const double h = ((hue + 240) % 360) / 360.0;
+    const double q = l < 0.5 ? l * (1.0 + s) : l + s - l * s;
+    const double p = 2.0 * l - q;
+    const auto channel = [p, q](double t) {
+        t = t < 0.0 ? t + 1.0 : t > 1.0 ? t - 1.0 : t;
+        const double v = t < 1.0 / 6.0   ? p + (q - p) * 6.0 * t
+                         : t < 0.5       ? q
+                         : t < 2.0 / 3.0 ? p + (q - p) * (2.0 / 3.0 - t) * 6.0
+                                         : p;
+        return static_cast<uint32_t>(v * 255.0 + 0.5);
+    };
+    return 0xFF000000u | channel(h + 1.0 / 3.0) << 16 | channel(h) << 8 | channel(h - 1.0 / 3.0);
+}
+
+/// The VT340's power-on colors, black past them
+[[nodiscard]] std::array<uint32_t, kRegisters> DefaultPalette() noexcept {
+    static constexpr uint8_t kVt340[16][3] = {
+        {0, 0, 0},    {20, 20, 80}, {80, 13, 13}, {20, 80, 20}, {80, 20, 80}, {20, 80, 80},
+        {80, 80, 20}, {53, 53, 53}, {26, 26, 26}, {33, 33, 60}, {60, 26, 26}, {33, 60, 33},
+        {60, 33, 60}, {33, 60, 60}, {60, 60, 33}, {80, 80, 80},
+    };
+    std::array<uint32_t, kRegisters> palette;
+    palette.fill(0xFF000000u);
+    for (size_t i = 0; i < 16; ++i) {
+        palette[i] = FromPercent(kVt340[i][0], kVt340[i][1], kVt340[i][2]);
+    }
+    return palette;
+}
+
+[[nodiscard]] bool IsSixel(char c) noexcept {
+    return c >= '?' && c <= '~';
+}
+
+} // namespace
+
+SixelSize MeasureSixel(std::string_view data) noexcept {
+    uint32_t x = 0;
+    uint32_t width = 0;
+    uint32_t band = 0;
+    uint32_t bands = 0;         ///< Bands holding a sixel
+    uint32_t params[4] = {};
+
+    size_t pos = 0;
+    while (pos < data.size()) {
+        const char c = data[pos++];
+        if (c == '"') {
+            // Raster attributes: Pan;Pad;Ph;Pv gives the size outright
+            if (ReadParams(data, pos, params, 4) == 4 && params[2] > 0 && params[3] > 0) {
+                return {std::min(params[2], kMaxSixelSide), std::min(params[3], kMaxSixelSide)};
+            }
+        } else if (c == '#') {
+            (void)ReadParams(data, pos, params, 4);
+        } else if (c == '!') {
+            const uint32_t count = ReadParams(data, pos, params, 1) != 0 ? std::max(params[0], 1u) : 1u;
+            if (pos < data.size() && IsSixel(data[pos])) {
+                ++pos;
+                x = std::min(x + count, kMaxSixelSide);
+                bands = band + 1;
+            }
+        } else if (c == '$') {
+            x = 0;
+        } else if (c == '-') {
+            x = 0;
+            ++band;
+        } else if (IsSixel(c)) {
+            x = std::min(x + 1, kMaxSixelSide);
+            bands = band + 1;
+        }
+        width = std::max(width, x);
+    }
+    if (width == 0 || bands == 0) {
+        return {};
+    }
+    return {width, std::min(bands * kBandHeight, kMaxSixelSide)};
+}
+
+bool DecodeSixel(std::string_view data, SixelSize size, std::vector<uint32_t>& pixels) {
+    pixels.clear();
+    if (size.width == 0 || size.height == 0) {
+        return true;
+    }
+    try {
+        pixels.assign(static_cast<size_t>(size.width) * size.height, 0);
+    } catch (const std::bad_alloc&) {
+        return false;
+    }
+
+    std::array<uint32_t, kRegisters> palette = DefaultPalette();
+    uint32_t color = palette[0];
+    uint32_t x = 0;
+    uint32_t y = 0;             ///< Top of the current band
+    uint32_t params[5] = {};
+
+    // Set the bits' pixels in count columns from x
+    const auto put = [&](char sixel, uint32_t count) {
+        const uint32_t bits = static_cast<uint32_t>(sixel - '?');
+        const uint32_t end = std::min(x + count, size.width);
+        if (bits != 0 && x < end) {
+            for (uint32_t bit = 0; bit < kBandHeight && y + bit < size.height; ++bit) {
+                if (bits & (1u << bit)) {
+                    uint32_t* row = pixels.data() + static_cast<size_t>(y + bit) * size.width;
+                    std::fill(row + x, row + end, color);
+                }
+            }
+        }
+        x = std::min(x + count, kMaxSixelSide);
+    };
+
+    size_t pos = 0;
+    while (pos < data.size() && y < size.height) {
+        const char c = data[pos++];
+        if (c == '#') {
+            // Select a register, or define it (Pc;Pu;Px;Py;Pz) and select it
+            const size_t count = ReadParams(data, pos, params, 5);
+            if (count == 0) {
+                continue;
+            }
+            const size_t index = params[0] % kRegisters;
+            if (count == 5 && params[1] == 1) {
+                palette[index] = FromHls(params[2], params[3], params[4]);
+            } else if (count == 5 && params[1] == 2) {
+                palette[index] = FromPercent(params[2], params[3], params[4]);
+            }
+            color = palette[index];
+        } else if (c == '!') {
+            const uint32_t count = ReadParams(data, pos, params, 1) != 0 ? std::max(params[0], 1u) : 1u;
+            if (pos < data.size() && IsSixel(data[pos])) {
+                put(data[pos++], count);
+            }
+        } else if (c == '"') {
+            (void)ReadParams(data, pos, params, 4);
+        } else if (c == '$') {
+            x = 0;
+        } else if (c == '-') {
+            x = 0;
+            y += kBandHeight;
+        } else if (IsSixel(c)) {
+            put(c, 1);
+        }
+    }
+    return true;
+}
+
+} // namespace Console3::Core
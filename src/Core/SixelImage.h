@@ -0,0 +1,40 @@
+#pragma once
+// Console3 - SixelImage.h
+// Sixel graphics: measuring and decoding a DCS q payload
+//
+// The emulator only measures an image (MeasureSixel), which it must do as
+// it parses to move the cursor past it: the raster attributes nearly every
+// encoder writes give the size at once, and without them a scan counting
+// columns and bands, writing no pixels, finds it. Decoding into pixels
+// (DecodeSixel) happens later on the image decoder's thread (ImageDecoder).
+//
+// Pixels no sixel sets stay transparent, whatever the background select
+// parameter asks; the aspect ratio in the raster attributes is ignored
+// (square pixels, as every modern encoder assumes). Colors start from the
+// VT340's 16 and registers past them from black.
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace Console3::Core {
+
+/// Largest image width or height decoded; anything larger is clipped
+inline constexpr uint32_t kMaxSixelSide = 4096;
+
+/// An image's size in pixels
+struct SixelSize {
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+/// Measure a sixel payload (the data after the DCS q), clipped to kMaxSixelSide
+/// @return The size, zero if the payload draws nothing
+[[nodiscard]] SixelSize MeasureSixel(std::string_view data) noexcept;
+
+/// Decode a sixel payload into premultiplied BGRA pixels, row by row
+/// @param size The payload's size (MeasureSixel); sixels beyond it are clipped
+/// @return false if the pixels could not be allocated
+bool DecodeSixel(std::string_view data, SixelSize size, std::vector<uint32_t>& pixels);
+
+} // namespace Console3::Core
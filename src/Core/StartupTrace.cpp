@@ -0,0 +1,144 @@
+// Console3 - StartupTrace.cpp
+// Timestamps of the startup pipeline, for measuring and reporting it
+
+#include "Core/StartupTrace.h"
+#include "Core/PerfClock.h"
+#include "Core/PipelineTrace.h"
+#include <ShlObj.h>
+#include <algorithm>
+#include <fstream>
+
+namespace Console3::Core {
+
+namespace {
+
+uint64_t FileTimeMicros(const FILETIME& time) noexcept {
+    ULARGE_INTEGER value{};
+    value.LowPart = time.dwLowDateTime;
+    value.HighPart = time.dwHighDateTime;
+    return value.QuadPart / 10;
+}
+
+} // namespace
+
+StartupTrace& StartupTrace::Shared() {
+    static StartupTrace s_instance;
+    return s_instance;
+}
+
+StartupTrace::StartupTrace() {
+    // Count from process creation, so loading before wWinMain is included
+    const uint64_t now = PerfClock::NowMicros();
+    m_originMicros = now;
+
+    FILETIME created{}, exited{}, kernel{}, user{};
+    FILETIME current{};
+    if (GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) {
+        GetSystemTimePreciseAsFileTime(&current);
+        const uint64_t createdMicros = FileTimeMicros(created);
+        const uint64_t currentMicros = FileTimeMicros(current);
+        if (currentMicros > createdMicros && currentMicros - createdMicros < now) {
+            m_originMicros = now - (currentMicros - createdMicros);
+        }
+    }
+}
+
+bool StartupTrace::Mark(StartupPhase phase) noexcept {
+    const auto index = static_cast<size_t>(phase);
+    if (index >= kPhases || m_marks[index].load(std::memory_order_relaxed) != 0) {
+        return false;   // Cheap for marks made on every frame
+    }
+
+    // At least 1, so a mark is never mistaken for none
+    const uint64_t elapsed = std::max<uint64_t>(PerfClock::NowMicros() - m_originMicros, 1);
+    uint64_t expected = 0;
+    if (!m_marks[index].compare_exchange_strong(expected, elapsed, std::memory_order_relaxed)) {
+        return false;
+    }
+    PipelineTrace::WriteStartupPhase(GetPhaseName(phase), elapsed);
+    return true;
+}
+
+uint64_t StartupTrace::GetMicros(StartupPhase phase) const noexcept {
+    const auto index = static_cast<size_t>(phase);
+    return index < kPhases ? m_marks[index].load(std::memory_order_relaxed) : 0;
+}
+
+bool StartupTrace::IsComplete() const noexcept {
+    return GetMicros(StartupPhase::FirstOutput) != 0 && GetMicros(StartupPhase::ShellsDetected) != 0 &&
+           GetMicros(StartupPhase::FontsEnumerated) != 0;
+}
+
+bool StartupTrace::TakeReport() noexcept {
+    return !m_reported.exchange(true, std::memory_order_relaxed);
+}
+
+bool StartupTrace::AppendLog() const {
+    const std::filesystem::path path = GetLogPath();
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+
+    SYSTEMTIME now{};
+    GetLocalTime(&now);
+    wchar_t stamp[32];
+    swprintf_s(stamp, L"%04u-%02u-%02u %02u:%02u:%02u  ", now.wYear, now.wMonth, now.wDay, now.wHour,
+               now.wMinute, now.wSecond);
+
+    // Names and digits only, so narrowing keeps the line as it is
+    const std::wstring line = stamp + Format();
+    std::ofstream file(path, std::ios::app);
+    for (const wchar_t c : line) {
+        file.put(static_cast<char>(c));
+    }
+    file.put('\n');
+    return static_cast<bool>(file);
+}
+
+std::filesystem::path StartupTrace::GetLogPath() {
+    wchar_t* localAppData = nullptr;
+    if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, nullptr, &localAppData))) {
+        std::filesystem::path path = localAppData;
+        CoTaskMemFree(localAppData);
+        return path / L"Console3" / L"startup.log";
+    }
+    return L"startup.log";
+}
+
+std::wstring StartupTrace::Format() const {
+    std::wstring text;
+    for (size_t i = 0; i < kPhases; ++i) {
+        const uint64_t micros = m_marks[i].load(std::memory_order_relaxed);
+        if (micros == 0) {
+            continue;
+        }
+        if (!text.empty()) {
+            text += L", ";
+        }
+        text += GetPhaseName(static_cast<StartupPhase>(i));
+        text += L' ';
+        text += std::to_wstring((micros + 500) / 1000);
+        text += L" ms";
+    }
+    return text;
+}
+
+const wchar_t* StartupTrace::GetPhaseName(StartupPhase phase) noexcept {
+    switch (phase) {
+    case StartupPhase::Entry:           return L"entry";
+    case StartupPhase::SettingsLoaded:  return L"settings";
+    case StartupPhase::ComInitialized:  return L"com";
+    case StartupPhase::ControlsInitialized: return L"controls";
+    case StartupPhase::WindowCreated:   return L"window";
+    case StartupPhase::Direct2DReady:   return L"d2d";
+    case StartupPhase::DirectWriteReady: return L"dwrite";
+    case StartupPhase::ShellStarted:    return L"shell";
+    case StartupPhase::WindowShown:     return L"shown";
+    case StartupPhase::FirstFrame:      return L"first frame";
+    case StartupPhase::FirstOutput:     return L"first output";
+    case StartupPhase::ShellsDetected:  return L"shells detected";
+    case StartupPhase::FontsEnumerated: return L"fonts enumerated";
+    default:                            return L"?";
+    }
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,92 @@
+#pragma once
+// Console3 - StartupTrace.h
+// Timestamps of the startup pipeline, for measuring and reporting it
+//
+// Startup runs in stages: the window is created and shown and the default
+// shell started on the UI thread; shell detection and font enumeration then
+// run on background threads, their results cached for the menus and the
+// settings dialog. Each stage marks when it finished, relative to the
+// process being created, so the time to a usable window (first shell
+// output) and to the background work being done can be reported.
+//
+// Marks are QueryPerformanceCounter times (PerfClock). Each one is also an
+// ETW event ("StartupPhase" on the Console3.Pipeline provider), and once
+// startup is complete the milestones are appended as one line to
+// %LOCALAPPDATA%\Console3\startup.log, so cold starts can be compared
+// across runs and machines without a debugger attached.
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+namespace Console3::Core {
+
+/// Milestones of startup, in the order they usually happen
+enum class StartupPhase : uint8_t {
+    Entry,              ///< wWinMain entered (process loaded)
+    SettingsLoaded,     ///< Settings read (from the cache, or parsed if the file changed)
+    ComInitialized,     ///< COM initialized
+    ControlsInitialized,///< Common controls registered
+    WindowCreated,      ///< Main window created
+    Direct2DReady,      ///< Direct2D factory created (first use)
+    DirectWriteReady,   ///< DirectWrite factory created (first use)
+    ShellStarted,       ///< Default shell launched
+    WindowShown,        ///< Main window shown and painted
+    FirstFrame,         ///< First terminal frame presented
+    FirstOutput,        ///< First output from the shell presented
+    ShellsDetected,     ///< Shell and WSL detection finished (background)
+    FontsEnumerated,    ///< Monospace font enumeration finished (background)
+    Count
+};
+
+/// Process-wide startup milestones (any thread)
+class StartupTrace {
+public:
+    /// Get the shared instance
+    static StartupTrace& Shared();
+
+    /// Record a milestone (only its first time counts)
+    /// @return true if this was the first time
+    bool Mark(StartupPhase phase) noexcept;
+
+    /// Get a milestone's time since the process was created
+    /// @return Microseconds, or 0 if it has not happened yet
+    [[nodiscard]] uint64_t GetMicros(StartupPhase phase) const noexcept;
+
+    /// Check if startup is over: the shell's first output is on screen and
+    /// the background work is done (milestones a run never reaches, such as
+    /// a frame without a view, do not hold it up)
+    [[nodiscard]] bool IsComplete() const noexcept;
+
+    /// Claim reporting the milestones
+    /// @return true for the first caller only
+    [[nodiscard]] bool TakeReport() noexcept;
+
+    /// Append the milestones reached so far to the startup log, as one
+    /// line after the local time
+    /// @return false if the log can't be written
+    bool AppendLog() const;
+
+    /// Get the startup log's path
+    [[nodiscard]] static std::filesystem::path GetLogPath();
+
+    /// Format the milestones reached so far, e.g. "window 41 ms, shell 58 ms, ..."
+    [[nodiscard]] std::wstring Format() const;
+
+    /// Get a milestone's name as Format() shows it
+    [[nodiscard]] static const wchar_t* GetPhaseName(StartupPhase phase) noexcept;
+
+private:
+    StartupTrace();
+
+    static constexpr size_t kPhases = static_cast<size_t>(StartupPhase::Count);
+
+    uint64_t m_originMicros = 0;    ///< PerfClock time the process was created
+    std::array<std::atomic<uint64_t>, kPhases> m_marks{};
+    std::atomic<bool> m_reported{false};
+};
+
+} // namespace Console3::Core
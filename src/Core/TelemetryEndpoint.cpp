@@ -0,0 +1,410 @@
+// Console3 - TelemetryEndpoint.cpp
+// Aggregate performance counters for fleet monitoring
+
+#include "Core/TelemetryEndpoint.h"
+#include "Core/PerfClock.h"
+#include "Core/PseudoConsole.h"
+#include "Core/Utf.h"
+#include <nlohmann/json.hpp>
+#include <psapi.h>
+#include <wil/Tracelogging.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+
+namespace Console3::Core {
+
+namespace {
+
+/// TraceLogging provider "Console3.Telemetry"
+class TelemetryTraceProvider final : public wil::TraceLoggingProvider {
+    // 146e9e59-8d9e-5cf5-5ef6-687aac9559f3
+    IMPLEMENT_TRACELOGGING_CLASS_WITHOUT_TELEMETRY(
+        TelemetryTraceProvider, "Console3.Telemetry",
+        (0x146e9e59, 0x8d9e, 0x5cf5, 0x5e, 0xf6, 0x68, 0x7a, 0xac, 0x95, 0x59, 0xf3));
+};
+
+/// Protected DACL entries besides the user's: SYSTEM and administrators
+/// (the monitoring agent) may read and write the pipe but not create
+/// instances of it (0x100083: read and write data, read attributes,
+/// synchronize)
+constexpr std::wstring_view kMonitorAces = L"(A;;0x100083;;;SY)(A;;0x100083;;;BA)";
+
+/// Names of the LatencyStage values, in order
+constexpr const char* kStageNames[kLatencyStageCount] = {"write", "echo", "parse", "schedule", "render", "total"};
+
+nlohmann::json HistogramJson(const LatencyHistogram& histogram) {
+    nlohmann::json buckets = nlohmann::json::array();
+    const auto& counts = histogram.GetBuckets();
+    for (size_t bucket = 0; bucket < counts.size(); ++bucket) {
+        if (counts[bucket] != 0) {
+            buckets.push_back({LatencyHistogram::GetUpperBound(bucket), counts[bucket]});
+        }
+    }
+    return {{"count", histogram.GetCount()},
+            {"p50", histogram.Percentile(0.5)},
+            {"p90", histogram.Percentile(0.9)},
+            {"p99", histogram.Percentile(0.99)},
+            {"max", histogram.GetMax()},
+            {"buckets", std::move(buckets)}};
+}
+
+/// Append one "scope,id,counter,value" row
+void AppendRow(std::string& csv, std::string_view scope, uint64_t id, std::string_view counter, double value) {
+    char row[160];
+    const int length = snprintf(row, sizeof(row), "%.*s,%llu,%.*s,%.15g\r\n", static_cast<int>(scope.size()),
+                                scope.data(), static_cast<unsigned long long>(id),
+                                static_cast<int>(counter.size()), counter.data(), value);
+    if (length > 0) {
+        csv.append(row, std::min(static_cast<size_t>(length), sizeof(row) - 1));
+    }
+}
+
+void AppendHistogramRows(std::string& csv, std::string_view scope, uint64_t id, std::string_view name,
+                         const LatencyHistogram& histogram) {
+    const std::string prefix(name);
+    AppendRow(csv, scope, id, prefix + "_count", static_cast<double>(histogram.GetCount()));
+    AppendRow(csv, scope, id, prefix + "_p50_us", static_cast<double>(histogram.Percentile(0.5)));
+    AppendRow(csv, scope, id, prefix + "_p90_us", static_cast<double>(histogram.Percentile(0.9)));
+    AppendRow(csv, scope, id, prefix + "_p99_us", static_cast<double>(histogram.Percentile(0.99)));
+    AppendRow(csv, scope, id, prefix + "_max_us", static_cast<double>(histogram.GetMax()));
+}
+
+/// Start a read or write and wait for it, the stop event or the deadline
+/// @return Bytes moved (0 if it failed, timed out or was stopped)
+DWORD Transfer(HANDLE pipe, HANDLE stop, HANDLE done, void* data, DWORD length, bool write, ULONGLONG deadline) {
+    OVERLAPPED overlapped = {};
+    overlapped.hEvent = done;
+    DWORD bytes = 0;
+    const BOOL ok = write ? WriteFile(pipe, data, length, &bytes, &overlapped)
+                          : ReadFile(pipe, data, length, &bytes, &overlapped);
+    if (ok) {
+        return bytes;
+    }
+    if (GetLastError() != ERROR_IO_PENDING) {
+        return 0;
+    }
+    const ULONGLONG now = GetTickCount64();
+    const DWORD timeout = now < deadline ? static_cast<DWORD>(deadline - now) : 0;
+    const HANDLE waits[] = {done, stop};
+    if (WaitForMultipleObjects(ARRAYSIZE(waits), waits, FALSE, timeout) != WAIT_OBJECT_0) {
+        CancelIoEx(pipe, &overlapped);
+        (void)GetOverlappedResult(pipe, &overlapped, &bytes, TRUE);
+        return 0;
+    }
+    return GetOverlappedResult(pipe, &overlapped, &bytes, FALSE) ? bytes : 0;
+}
+
+} // namespace
+
+TelemetryEndpoint& TelemetryEndpoint::Shared() {
+    static TelemetryEndpoint endpoint;
+    return endpoint;
+}
+
+TelemetryEndpoint::~TelemetryEndpoint() {
+    Stop();
+}
+
+bool TelemetryEndpoint::Start(CollectCallback collect) {
+    if (IsRunning()) {
+        return true;
+    }
+    if (!m_stop && !m_stop.try_create(wil::EventOptions::ManualReset, nullptr)) {
+        return false;
+    }
+    ResetEvent(m_stop.get());
+
+    if (!m_listener.Listen(GetPipePath(GetCurrentProcessId()), kMonitorAces)) {
+        return false;
+    }
+    m_collect = std::move(collect);
+    m_samples.clear();
+    m_thread = std::thread([this]() { ThreadProc(); });
+    return true;
+}
+
+void TelemetryEndpoint::Stop() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+    SetEvent(m_stop.get());
+    m_thread.join();
+    m_collect = nullptr;
+}
+
+std::wstring TelemetryEndpoint::GetPipePath(DWORD processId) {
+    return L"\\\\.\\pipe\\Console3-telemetry-" + std::to_wstring(processId);
+}
+
+void TelemetryEndpoint::ThreadProc() {
+    // The rundown goes on between clients
+    ULONGLONG nextRundown = GetTickCount64() + kRundownMs;
+    const auto rundown = [this, &nextRundown]() -> DWORD {
+        const ULONGLONG now = GetTickCount64();
+        if (now >= nextRundown) {
+            nextRundown = now + kRundownMs;
+            if (TelemetryTraceProvider::IsEnabled(WINEVENT_LEVEL_INFO)) {
+                WriteRundown(Collect());
+            }
+        }
+        return static_cast<DWORD>(nextRundown - now);
+    };
+
+    // Closed without disconnecting, so the client still reads the reply
+    while (wil::unique_hfile pipe = m_listener.Accept(m_stop.get(), rundown)) {
+        Serve(pipe.get());
+    }
+    m_listener.Close();
+}
+
+TelemetrySnapshot TelemetryEndpoint::Collect() {
+    TelemetrySnapshot snapshot = m_collect();
+
+    PROCESS_MEMORY_COUNTERS_EX counters{};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters),
+                             sizeof(counters))) {
+        snapshot.privateBytes = counters.PrivateUsage;
+        snapshot.workingSetBytes = counters.WorkingSetSize;
+    }
+    snapshot.allocations = AllocTracker::Snapshot();
+
+    // Throughput since the snapshot before; sessions gone are forgotten
+    const uint64_t now = PerfClock::NowMicros();
+    std::unordered_map<uint32_t, Sample> samples;
+    for (TelemetrySession& session : snapshot.sessions) {
+        const auto previous = m_samples.find(session.id);
+        if (previous != m_samples.end() && now > previous->second.micros) {
+            const double seconds = static_cast<double>(now - previous->second.micros) / 1e6;
+            session.bytesInPerSec = static_cast<double>(session.stats.bytesIn - previous->second.bytesIn) / seconds;
+            session.bytesOutPerSec = static_cast<double>(session.stats.bytesOut - previous->second.bytesOut) / seconds;
+        }
+        samples[session.id] = Sample{session.stats.bytesIn, session.stats.bytesOut, now};
+    }
+    m_samples = std::move(samples);
+    return snapshot;
+}
+
+void TelemetryEndpoint::Serve(HANDLE pipe) {
+    wil::unique_event done;
+    if (!done.try_create(wil::EventOptions::ManualReset, nullptr)) {
+        return;
+    }
+
+    // A client that writes nothing gets JSON once the wait is over
+    char request[16] = {};
+    const DWORD read = Transfer(pipe, m_stop.get(), done.get(), request, sizeof(request) - 1, false,
+                                GetTickCount64() + kRequestTimeoutMs);
+    if (WaitForSingleObject(m_stop.get(), 0) == WAIT_OBJECT_0) {
+        return;
+    }
+    const bool csv = read >= 3 && _strnicmp(request, "csv", 3) == 0;
+
+    const TelemetrySnapshot snapshot = Collect();
+    std::string reply = csv ? FormatCsv(snapshot) : FormatJson(snapshot);
+    const ULONGLONG deadline = GetTickCount64() + kReplyTimeoutMs;
+    size_t written = 0;
+    while (written < reply.size()) {
+        const DWORD chunk = static_cast<DWORD>(std::min<size_t>(reply.size() - written, PipeListener::kBufferBytes));
+        const DWORD moved = Transfer(pipe, m_stop.get(), done.get(), reply.data() + written, chunk, true, deadline);
+        if (moved == 0) {
+            return;
+        }
+        written += moved;
+    }
+}
+
+std::string TelemetryEndpoint::FormatJson(const TelemetrySnapshot& snapshot) {
+    nlohmann::json allocations = nlohmann::json::object();
+    for (size_t index = 0; index < snapshot.allocations.size(); ++index) {
+        allocations[AllocTracker::GetName(static_cast<AllocSubsystem>(index))] = {
+            {"allocations", snapshot.allocations[index].allocations},
+            {"bytes", snapshot.allocations[index].bytes}};
+    }
+
+    nlohmann::json windows = nlohmann::json::array();
+    for (size_t index = 0; index < snapshot.windows.size(); ++index) {
+        const TelemetryWindow& window = snapshot.windows[index];
+        windows.push_back({{"index", index},
+                           {"frameTimes", HistogramJson(window.frameTimes)},
+                           {"missedFrames", window.missedFrames}});
+    }
+
+    nlohmann::json sessions = nlohmann::json::array();
+    for (const TelemetrySession& session : snapshot.sessions) {
+        const SessionStats& stats = session.stats;
+        const SessionMemory& memory = session.memory;
+        nlohmann::json input = {{"dropped", session.inputDropped}};
+        for (size_t stage = 0; stage < kLatencyStageCount; ++stage) {
+            input[kStageNames[stage]] = HistogramJson(session.inputLatency[stage]);
+        }
+        sessions.push_back({
+            {"id", session.id},
+            {"window", session.window},
+            {"title", ToUtf8(session.title)},
+            {"console", ToUtf8(GetPseudoConsoleName(stats.console))},
+            {"bytesIn", stats.bytesIn},
+            {"bytesOut", stats.bytesOut},
+            {"bytesInPerSec", session.bytesInPerSec},
+            {"bytesOutPerSec", session.bytesOutPerSec},
+            {"reads", stats.readCount},
+            {"stallMicros", stats.stallMicros},
+            {"bufferedBytes", stats.bufferedBytes},
+            {"parseCalls", stats.parseCalls},
+            {"parseMicros", stats.parseMicros},
+            {"parseTimes", HistogramJson(session.parseTimes)},
+            {"lastLatencyMicros", stats.lastLatencyMicros},
+            {"maxLatencyMicros", stats.maxLatencyMicros},
+            {"fastForward", stats.fastForward},
+            {"shellCpuMicros", stats.shell.cpuMicros},
+            {"shellProcesses", stats.shell.activeProcesses},
+            {"memory",
+             {{"screen", memory.screenBytes},
+              {"scrollbackHot", memory.scrollbackHotBytes},
+              {"scrollbackCold", memory.scrollbackColdBytes},
+              {"scrollbackDisk", memory.scrollbackDiskBytes},
+              {"images", memory.imageBytes},
+              {"ring", memory.ringBytes},
+              {"vterm", memory.vtermBytes},
+              {"frames", memory.frameBytes},
+              {"atlas", memory.atlasBytes},
+              {"resident", memory.GetResidentBytes()}}},
+            {"inputLatency", std::move(input)}});
+    }
+
+    const nlohmann::json document = {
+        {"process",
+         {{"id", GetCurrentProcessId()},
+          {"privateBytes", snapshot.privateBytes},
+          {"workingSetBytes", snapshot.workingSetBytes},
+          {"allocationsTracked", AllocTracker::kEnabled},
+          {"allocations", std::move(allocations)}}},
+        {"windows", std::move(windows)},
+        {"sessions", std::move(sessions)}};
+    return document.dump();
+}
+
+std::string TelemetryEndpoint::FormatCsv(const TelemetrySnapshot& snapshot) {
+    std::string csv = "scope,id,counter,value\r\n";
+    const uint64_t process = GetCurrentProcessId();
+    AppendRow(csv, "process", process, "private_bytes", static_cast<double>(snapshot.privateBytes));
+    AppendRow(csv, "process", process, "working_set_bytes", static_cast<double>(snapshot.workingSetBytes));
+    if constexpr (AllocTracker::kEnabled) {
+        for (size_t index = 0; index < snapshot.allocations.size(); ++index) {
+            const std::string name = AllocTracker::GetName(static_cast<AllocSubsystem>(index));
+            AppendRow(csv, "process", process, "alloc_" + name + "_count",
+                      static_cast<double>(snapshot.allocations[index].allocations));
+            AppendRow(csv, "process", process, "alloc_" + name + "_bytes",
+                      static_cast<double>(snapshot.allocations[index].bytes));
+        }
+    }
+
+    for (size_t index = 0; index < snapshot.windows.size(); ++index) {
+        const TelemetryWindow& window = snapshot.windows[index];
+        AppendHistogramRows(csv, "window", index, "frame", window.frameTimes);
+        AppendRow(csv, "window", index, "missed_frames", static_cast<double>(window.missedFrames));
+    }
+
+    for (const TelemetrySession& session : snapshot.sessions) {
+        const SessionStats& stats = session.stats;
+        const SessionMemory& memory = session.memory;
+        AppendRow(csv, "session", session.id, "window", session.window);
+        AppendRow(csv, "session", session.id, "bytes_in", static_cast<double>(stats.bytesIn));
+        AppendRow(csv, "session", session.id, "bytes_out", static_cast<double>(stats.bytesOut));
+        AppendRow(csv, "session", session.id, "bytes_in_per_sec", session.bytesInPerSec);
+        AppendRow(csv, "session", session.id, "bytes_out_per_sec", session.bytesOutPerSec);
+        AppendRow(csv, "session", session.id, "stall_us", static_cast<double>(stats.stallMicros));
+        AppendRow(csv, "session", session.id, "parse_us", static_cast<double>(stats.parseMicros));
+        AppendHistogramRows(csv, "session", session.id, "parse", session.parseTimes);
+        AppendRow(csv, "session", session.id, "screen_bytes", static_cast<double>(memory.screenBytes));
+        AppendRow(csv, "session", session.id, "scrollback_bytes",
+                  static_cast<double>(memory.scrollbackHotBytes + memory.scrollbackColdBytes));
+        AppendRow(csv, "session", session.id, "scrollback_disk_bytes",
+                  static_cast<double>(memory.scrollbackDiskBytes));
+        AppendRow(csv, "session", session.id, "image_bytes", static_cast<double>(memory.imageBytes));
+        AppendRow(csv, "session", session.id, "ring_bytes", static_cast<double>(memory.ringBytes));
+        AppendRow(csv, "session", session.id, "vterm_bytes", static_cast<double>(memory.vtermBytes));
+        AppendRow(csv, "session", session.id, "render_bytes",
+                  static_cast<double>(memory.frameBytes + memory.atlasBytes));
+        AppendRow(csv, "session", session.id, "resident_bytes", static_cast<double>(memory.GetResidentBytes()));
+        for (size_t stage = 0; stage < kLatencyStageCount; ++stage) {
+            AppendHistogramRows(csv, "session", session.id, std::string("input_") + kStageNames[stage],
+                                session.inputLatency[stage]);
+        }
+        AppendRow(csv, "session", session.id, "input_dropped", static_cast<double>(session.inputDropped));
+    }
+    return csv;
+}
+
+void TelemetryEndpoint::WriteRundown(const TelemetrySnapshot& snapshot) {
+    std::array<uint64_t, static_cast<size_t>(AllocSubsystem::Count)> allocations{};
+    std::array<uint64_t, static_cast<size_t>(AllocSubsystem::Count)> allocatedBytes{};
+    for (size_t index = 0; index < snapshot.allocations.size(); ++index) {
+        allocations[index] = snapshot.allocations[index].allocations;
+        allocatedBytes[index] = snapshot.allocations[index].bytes;
+    }
+    TraceLoggingWrite(TelemetryTraceProvider::Provider(), "Process",
+                      TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+                      TraceLoggingUInt64(snapshot.privateBytes, "PrivateBytes"),
+                      TraceLoggingUInt64(snapshot.workingSetBytes, "WorkingSetBytes"),
+                      TraceLoggingUInt32(static_cast<uint32_t>(snapshot.windows.size()), "Windows"),
+                      TraceLoggingUInt32(static_cast<uint32_t>(snapshot.sessions.size()), "Sessions"),
+                      TraceLoggingUInt64Array(allocations.data(), static_cast<UINT16>(allocations.size()),
+                                              "Allocations"),
+                      TraceLoggingUInt64Array(allocatedBytes.data(), static_cast<UINT16>(allocatedBytes.size()),
+                                              "AllocatedBytes"));
+
+    for (size_t index = 0; index < snapshot.windows.size(); ++index) {
+        const TelemetryWindow& window = snapshot.windows[index];
+        const auto& buckets = window.frameTimes.GetBuckets();
+        TraceLoggingWrite(TelemetryTraceProvider::Provider(), "Window",
+                          TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+                          TraceLoggingUInt32(static_cast<uint32_t>(index), "Window"),
+                          TraceLoggingUInt64(window.frameTimes.GetCount(), "Frames"),
+                          TraceLoggingUInt64(window.missedFrames, "MissedFrames"),
+                          TraceLoggingUInt64(window.frameTimes.Percentile(0.5), "FrameP50"),
+                          TraceLoggingUInt64(window.frameTimes.Percentile(0.99), "FrameP99"),
+                          TraceLoggingUInt64(window.frameTimes.GetMax(), "FrameMax"),
+                          TraceLoggingUInt32Array(buckets.data(), static_cast<UINT16>(buckets.size()),
+                                                  "FrameBuckets"));
+    }
+
+    for (const TelemetrySession& session : snapshot.sessions) {
+        const SessionStats& stats = session.stats;
+        const SessionMemory& memory = session.memory;
+        const LatencyHistogram& total = session.inputLatency[static_cast<size_t>(LatencyStage::Total)];
+        const auto& parseBuckets = session.parseTimes.GetBuckets();
+        const auto& inputBuckets = total.GetBuckets();
+        TraceLoggingWrite(TelemetryTraceProvider::Provider(), "Session",
+                          TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+                          TraceLoggingUInt32(session.id, "SessionId"),
+                          TraceLoggingUInt32(session.window, "Window"),
+                          TraceLoggingUInt64(stats.bytesIn, "BytesIn"),
+                          TraceLoggingUInt64(stats.bytesOut, "BytesOut"),
+                          TraceLoggingFloat64(session.bytesInPerSec, "BytesInPerSec"),
+                          TraceLoggingFloat64(session.bytesOutPerSec, "BytesOutPerSec"),
+                          TraceLoggingUInt64(stats.stallMicros, "StallMicros"),
+                          TraceLoggingUInt64(stats.parseCalls, "ParseCalls"),
+                          TraceLoggingUInt64(stats.parseMicros, "ParseMicros"),
+                          TraceLoggingUInt64(session.parseTimes.Percentile(0.5), "ParseP50"),
+                          TraceLoggingUInt64(session.parseTimes.Percentile(0.99), "ParseP99"),
+                          TraceLoggingUInt32Array(parseBuckets.data(), static_cast<UINT16>(parseBuckets.size()),
+                                                  "ParseBuckets"),
+                          TraceLoggingUInt64(memory.GetResidentBytes(), "ResidentBytes"),
+                          TraceLoggingUInt64(memory.screenBytes, "ScreenBytes"),
+                          TraceLoggingUInt64(memory.scrollbackHotBytes + memory.scrollbackColdBytes,
+                                             "ScrollbackBytes"),
+                          TraceLoggingUInt64(memory.scrollbackDiskBytes, "ScrollbackDiskBytes"),
+                          TraceLoggingUInt64(memory.imageBytes, "ImageBytes"),
+                          TraceLoggingUInt64(memory.ringBytes + memory.vtermBytes, "PipelineBytes"),
+                          TraceLoggingUInt64(memory.frameBytes + memory.atlasBytes, "RenderBytes"),
+                          TraceLoggingUInt64(total.GetCount(), "InputProbes"),
+                          TraceLoggingUInt64(total.Percentile(0.5), "InputP50"),
+                          TraceLoggingUInt64(total.Percentile(0.99), "InputP99"),
+                          TraceLoggingUInt32Array(inputBuckets.data(), static_cast<UINT16>(inputBuckets.size()),
+                                                  "InputBuckets"));
+    }
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,147 @@
+#pragma once
+// Console3 - TelemetryEndpoint.h
+// Aggregate performance counters for fleet monitoring
+//
+// With the telemetryEndpoint setting on, the process serves its counters to
+// a monitoring agent on the machine, so hot spots can be found across many
+// workstations without attaching a profiler:
+//
+//   Pipe - \\.\pipe\Console3-telemetry-<process id>. A client writes
+//          "json" or "csv" (or nothing, for JSON) and reads a snapshot taken
+//          then; the pipe closes after it. The user, SYSTEM and
+//          administrators may connect, from this machine only.
+//   ETW  - while a trace session listens to the TraceLogging provider
+//          "Console3.Telemetry" (GUID 146e9e59-8d9e-5cf5-5ef6-687aac9559f3),
+//          a rundown of the same counters every kRundownMs: a "Process"
+//          event, a "Session" event per session and a "Window" event per
+//          window, histograms as arrays of bucket counts.
+//
+// A snapshot holds, per session, its I/O counters and throughput since the
+// snapshot before, the time each parse pass took, its memory by owner and
+// its keypress-to-photon stages (measured, without the overlay, while the
+// setting is on); per window, its frame times and the refreshes its frames
+// missed; for the process, its memory and, in instrumented
+// builds, its heap allocations by subsystem. Histograms are cumulative since
+// the session or window started, in LatencyHistogram's log buckets.
+//
+// The owner collects the snapshot on the endpoint's thread, under whatever
+// lock keeps the sessions and views still (see MainFrame::CollectTelemetry).
+
+#include <Windows.h>
+#include <wil/resource.h>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Core/AllocTracker.h"
+#include "Core/InputLatency.h"
+#include "Core/PipeListener.h"
+#include "Core/SessionMemory.h"
+#include "Core/SessionStats.h"
+
+namespace Console3::Core {
+
+/// One session's counters
+struct TelemetrySession {
+    uint32_t id = 0;                    ///< Session::GetTraceId()
+    uint32_t window = 0;                ///< Index of its window in the snapshot
+    std::wstring title;                 ///< Its window's title
+    SessionStats stats;
+    SessionMemory memory;
+    LatencyHistogram parseTimes;        ///< Parse passes (Session::GetParseTimes)
+    std::array<LatencyHistogram, kLatencyStageCount> inputLatency{};  ///< By LatencyStage
+    uint64_t inputDropped = 0;          ///< Probes dropped without a Present
+
+    // Filled in by the endpoint
+    double bytesInPerSec = 0.0;         ///< Since the snapshot before (0 for the first)
+    double bytesOutPerSec = 0.0;
+};
+
+/// One window's rendering
+struct TelemetryWindow {
+    LatencyHistogram frameTimes;        ///< Frames rendered (RenderProfiler::GetFrameTimes)
+    uint64_t missedFrames = 0;          ///< Refreshes a frame came too late for
+};
+
+/// Everything a snapshot reports (see file comment)
+struct TelemetrySnapshot {
+    uint64_t privateBytes = 0;          ///< Process commit
+    uint64_t workingSetBytes = 0;
+    AllocSnapshot allocations{};        ///< Cumulative (zero unless AllocTracker::kEnabled)
+    std::vector<TelemetryWindow> windows;
+    std::vector<TelemetrySession> sessions;
+};
+
+/// Serves counters on a pipe and as an ETW rundown (see file comment)
+class TelemetryEndpoint {
+public:
+    static constexpr DWORD kRundownMs = 1000;           ///< ETW rundown period
+    static constexpr DWORD kRequestTimeoutMs = 1000;    ///< A client's wait for its request
+    static constexpr DWORD kReplyTimeoutMs = 5000;      ///< A client's time to read the reply
+
+    /// Takes a snapshot (on the endpoint's thread)
+    using CollectCallback = std::function<TelemetrySnapshot()>;
+
+    /// Get the process's endpoint
+    static TelemetryEndpoint& Shared();
+
+    TelemetryEndpoint() = default;
+    ~TelemetryEndpoint();
+
+    // Non-copyable, non-movable
+    TelemetryEndpoint(const TelemetryEndpoint&) = delete;
+    TelemetryEndpoint& operator=(const TelemetryEndpoint&) = delete;
+
+    /// Start serving (nothing if running)
+    /// @return false if the pipe could not be created
+    bool Start(CollectCallback collect);
+
+    /// Stop serving, waiting for the thread; the caller must not hold what
+    /// the collect callback takes
+    void Stop();
+
+    [[nodiscard]] bool IsRunning() const noexcept { return m_thread.joinable(); }
+
+    /// Get the pipe a process serves on
+    [[nodiscard]] static std::wstring GetPipePath(DWORD processId);
+
+    /// Format a snapshot as one JSON object (UTF-8)
+    [[nodiscard]] static std::string FormatJson(const TelemetrySnapshot& snapshot);
+
+    /// Format a snapshot as CSV (UTF-8): a "scope,id,counter,value" row per
+    /// counter of the process, each window and each session, histograms as
+    /// percentiles
+    [[nodiscard]] static std::string FormatCsv(const TelemetrySnapshot& snapshot);
+
+private:
+    /// Byte counts a session's throughput is measured from
+    struct Sample {
+        uint64_t bytesIn = 0;
+        uint64_t bytesOut = 0;
+        uint64_t micros = 0;
+    };
+
+    void ThreadProc();
+
+    /// Take a snapshot and fill in its throughput (endpoint thread)
+    [[nodiscard]] TelemetrySnapshot Collect();
+
+    /// Read a client's request and write its reply (endpoint thread)
+    void Serve(HANDLE pipe);
+
+    /// Write the rundown events if a trace session listens (endpoint thread)
+    static void WriteRundown(const TelemetrySnapshot& snapshot);
+
+    CollectCallback m_collect;
+    PipeListener m_listener;
+    wil::unique_event m_stop;           ///< Manual reset
+    std::thread m_thread;
+    std::unordered_map<uint32_t, Sample> m_samples;     ///< Endpoint thread: by session id
+};
+
+} // namespace Console3::Core
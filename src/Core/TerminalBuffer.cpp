@@ -2,81 +2,266 @@
 // Terminal screen buffer implementation
 
 #include "Core/TerminalBuffer.h"
+#include "Core/LogFile.h"
+#include "Core/Utf.h"
 #include <algorithm>
 #include <stdexcept>
-#include <codecvt>
-#include <locale>
 
 namespace Console3::Core {
 
+namespace {
+
+/// Append a UTF-32 codepoint as UTF-8
+void PushUtf8(std::string& out, uint32_t cp) {
+    char units[4];
+    out.append(units, PutUtf8(cp, units));
+}
+
+/// Append a UTF-32 codepoint as UTF-16
+void PushUtf16(std::wstring& out, uint32_t cp) {
+    wchar_t units[2];
+    out.append(units, PutUtf16(cp, units));
+}
+
+/// Columns [first, last) of a line, wide characters whole and (if asked)
+/// trailing blanks dropped
+void ClampColumns(std::span<const Cell> cells, int& first, int& last, bool trimRight) {
+    const int cols = static_cast<int>(cells.size());
+    first = std::clamp(first, 0, cols);
+    last = std::clamp(last, 0, cols);
+    if (first > 0 && first < cols && cells[first].width == 0) {
+        --first;
+    }
+    if (last > 0 && last < cols && cells[last].width == 0) {
+        ++last;
+    }
+    if (trimRight) {
+        while (last > first && cells[last - 1].code == U' ' && !cells[last - 1].grapheme) {
+            --last;
+        }
+    }
+}
+
+/// Append columns [first, last): stretches of cells that are one unit each
+/// in one loop, the rest one by one
+/// @param limit Codepoints below it encode as a single unit
+template <typename String, typename Append>
+void AppendCells(String& out, std::span<const Cell> cells, int first, int last, uint32_t limit,
+                 Append&& append) {
+    using Char = typename String::value_type;
+    for (int col = first; col < last;) {
+        int end = col;
+        while (end < last && !cells[end].grapheme && cells[end].width == 1 && cells[end].code < limit) {
+            ++end;
+        }
+        if (end > col) {
+            const size_t at = out.size();
+            out.resize(at + static_cast<size_t>(end - col));
+            Char* text = out.data() + at;
+            for (; col < end; ++col) {
+                *text++ = static_cast<Char>(cells[col].code);
+            }
+        }
+        if (col == last) {
+            break;
+        }
+
+        const Cell& cell = cells[col++];
+        if (cell.width == 0) {
+            continue;   // Continuation of a wide character
+        }
+        append(out, cell.Codepoint());
+        for (const uint32_t combining : cell.Combining()) {
+            append(out, combining);
+        }
+    }
+}
+
+} // namespace
+
 // Static empty cell instance
 const Cell TerminalBuffer::s_emptyCell{};
 
 TerminalBuffer::TerminalBuffer(const TerminalBufferConfig& config)
     : m_rows(config.rows)
     , m_cols(config.cols)
-    , m_maxScrollback(config.scrollbackLines) {
+    , m_scrollback(config.scrollbackLines, config.scrollbackHotLines, config.scrollbackToDisk,
+                   config.scrollbackInternLines)
+    , m_lineTimes(config.lineTimes) {
     
     if (m_rows <= 0 || m_cols <= 0) {
         throw std::invalid_argument("Terminal dimensions must be positive");
     }
 
-    // Initialize screen buffer
-    m_screen.resize(m_rows);
-    for (auto& row : m_screen) {
-        row = CreateEmptyRow();
+    // One slab for the whole grid; ring slot i starts at cell i * cols
+    m_cells.resize(static_cast<size_t>(m_rows) * m_cols);
+    m_rowOffset.resize(m_rows);
+    for (int slot = 0; slot < m_rows; ++slot) {
+        m_rowOffset[slot] = static_cast<size_t>(slot) * m_cols;
     }
 
-    // Initialize dirty tracking
-    m_dirty.resize(m_rows, true);  // All rows dirty initially
+    m_continuation.assign(m_rows, 0);
+
+    // The alternate screen is allocated up front, so switching never allocates
+    m_hiddenCells.resize(m_cells.size());
+    m_hiddenRowOffset = m_rowOffset;
+    m_hiddenContinuation.assign(m_rows, 0);
+
+    // Initialize dirty tracking (all rows dirty initially)
+    m_dirty.Assign(m_rows, false);
+    m_dirtySpan.resize(m_rows);
+    m_rowGeneration.resize(m_rows);
+    m_styleRuns.resize(m_rows);
+    m_rowFill.resize(m_rows);
+    m_rowFilled.resize(m_rows);
+    MarkAllDirty();
+    m_scrollbackGeneration = ++m_generation;
 }
 
 // ============================================================================
 // Size Management
 // ============================================================================
 
-void TerminalBuffer::Resize(int rows, int cols) {
+void TerminalBuffer::Resize(int rows, int cols, bool pushOverflow) {
+    Reflow(rows, cols, pushOverflow, nullptr, nullptr, nullptr);
+}
+
+void TerminalBuffer::Resize(int rows, int cols, int& cursorRow, int& cursorCol,
+                            const ResizeOverflowSink& overflow) {
+    Reflow(rows, cols, false, &cursorRow, &cursorCol, &overflow);
+}
+
+void TerminalBuffer::Reflow(int rows, int cols, bool pushOverflow, int* cursorRow, int* cursorCol,
+                            const ResizeOverflowSink* overflowSink) {
     if (rows <= 0 || cols <= 0) {
         return;
     }
 
-    // Handle row changes
-    if (rows != m_rows) {
-        if (rows > m_rows) {
-            // Add new rows at the bottom
-            for (int i = m_rows; i < rows; ++i) {
-                m_screen.push_back(CreateEmptyRow());
-            }
-        } else {
-            // Push excess rows to scrollback, then remove
-            for (int i = 0; i < m_rows - rows; ++i) {
-                if (!m_screen.empty()) {
-                    m_scrollback.push_front(std::move(m_screen.front()));
-                    m_screen.erase(m_screen.begin());
-                }
-            }
-            TrimScrollback();
+    // The cursor as an offset into its logical line, and the new row it lands on
+    const bool trackCursor = cursorRow && cursorCol;
+    const int oldCursorRow = trackCursor ? std::clamp(*cursorRow, 0, m_rows - 1) : -1;
+    size_t cursorIndex = 0;
+    int newCursorCol = 0;
+
+    // Re-wrap each logical line (a row and the rows continuing it) at the
+    // new width, top to bottom, into rows of the new width
+    static const Cell blank{};
+    std::vector<Cell> wrapped;
+    std::vector<uint8_t> continuation;
+    std::vector<Cell> line;
+    for (int row = 0; row < m_rows;) {
+        int next = row + 1;
+        while (next < m_rows && m_continuation[Slot(next)]) {
+            ++next;
         }
-        m_rows = rows;
+
+        // Wrapped rows are full; only the last one has trailing blanks
+        line.clear();
+        for (int part = row; part < next; ++part) {
+            const std::span<const Cell> cells = RowCells(part);
+            line.insert(line.end(), cells.begin(), cells.end());
+        }
+        const size_t lastStart = static_cast<size_t>(next - row - 1) * m_cols;
+        while (line.size() > lastStart && line.back() == blank) {
+            line.pop_back();
+        }
+
+        const bool cursorHere = oldCursorRow >= row && oldCursorRow < next;
+        const size_t cursorOffset = cursorHere
+            ? static_cast<size_t>(oldCursorRow - row) * m_cols + static_cast<size_t>(std::clamp(*cursorCol, 0, m_cols - 1))
+            : 0;
+
+        size_t start = 0;
+        do {
+            const size_t end = WrapEnd(line, start, static_cast<size_t>(cols));
+            // Past the text (trailing blanks were dropped) it stays on the last row
+            if (cursorHere && cursorOffset >= start && (cursorOffset < end || end >= line.size())) {
+                cursorIndex = continuation.size();
+                newCursorCol = static_cast<int>(std::min(cursorOffset - start, static_cast<size_t>(cols - 1)));
+            }
+            wrapped.insert(wrapped.end(), line.begin() + start, line.begin() + end);
+            wrapped.resize(wrapped.size() + (static_cast<size_t>(cols) - (end - start)));
+            continuation.push_back(start > 0);
+            start = end;
+        } while (start < line.size());
+
+        row = next;
+    }
+
+    // Blank rows at the bottom give way before content leaves the top, but
+    // not the cursor's
+    size_t count = continuation.size();
+    while (count > static_cast<size_t>(rows) && !continuation[count - 1] &&
+           (!trackCursor || count - 1 > cursorIndex) &&
+           std::all_of(wrapped.begin() + (count - 1) * cols, wrapped.begin() + count * cols,
+                       [](const Cell& cell) { return cell == blank; })) {
+        --count;
     }
+    const size_t overflow = count > static_cast<size_t>(rows) ? count - rows : 0;
 
-    // Handle column changes
+    // Scrollback lines from here on are at the new width
     if (cols != m_cols) {
-        for (auto& row : m_screen) {
-            if (static_cast<int>(row.size()) < cols) {
-                // Expand row
-                row.resize(cols);
-            } else if (static_cast<int>(row.size()) > cols) {
-                // Shrink row
-                row.resize(cols);
-            }
+        m_reflow.Reset(cols);
+        ++m_scrollbackEpoch;
+        m_scrollbackGeneration = ++m_generation;
+    }
+    if (pushOverflow && !m_alternate) {
+        for (size_t row = 0; row < overflow; ++row) {
+            StoreScrollback(std::span<const Cell>(wrapped.data() + row * cols, static_cast<size_t>(cols)),
+                            continuation[row] != 0);
         }
-        m_cols = cols;
     }
 
+    // Rows for the sink are handed over once the buffer is whole again (it
+    // may push them into this scrollback)
+    std::vector<Cell> overflowCells;
+    std::vector<uint8_t> overflowContinuation;
+    if (overflowSink && *overflowSink && !m_alternate && overflow > 0) {
+        overflowCells.assign(wrapped.begin(), wrapped.begin() + overflow * cols);
+        overflowContinuation.assign(continuation.begin(), continuation.begin() + overflow);
+    }
+
+    // The kept rows start a fresh slab in screen order (the ring starts over)
+    const size_t kept = count - overflow;
+    wrapped.erase(wrapped.begin(), wrapped.begin() + overflow * cols);
+    wrapped.resize(static_cast<size_t>(rows) * cols);
+    m_cells.swap(wrapped);
+
+    m_rows = rows;
+    m_cols = cols;
+    m_origin = 0;
+    m_rowOffset.resize(m_rows);
+    for (int slot = 0; slot < m_rows; ++slot) {
+        m_rowOffset[slot] = static_cast<size_t>(slot) * m_cols;
+    }
+    m_continuation.assign(m_rows, 0);
+    std::copy_n(continuation.begin() + overflow, kept, m_continuation.begin());
+
+    // The hidden screen starts over blank at the new size: the emulator
+    // refills the primary screen if it was the one hidden
+    m_hiddenCells.assign(m_cells.size(), Cell{});
+    m_hiddenRowOffset = m_rowOffset;
+    m_hiddenOrigin = 0;
+    m_hiddenContinuation.assign(m_rows, 0);
+    m_hiddenStale = true;
+
     // Resize dirty tracking
-    m_dirty.resize(m_rows, true);
+    m_dirty.Assign(m_rows, false);
+    m_dirtySpan.resize(m_rows);
+    m_rowGeneration.resize(m_rows);
+    m_styleRuns.assign(m_rows, {});  // Rebuilt at the new width
+    m_rowFill.resize(m_rows);
+    m_rowFilled.resize(m_rows);
     MarkAllDirty();
+
+    if (trackCursor) {
+        *cursorRow = cursorIndex >= overflow ? static_cast<int>(cursorIndex - overflow) : 0;
+        *cursorCol = newCursorCol;
+    }
+    for (size_t row = 0; row < overflowContinuation.size(); ++row) {
+        (*overflowSink)(std::span<const Cell>(overflowCells.data() + row * cols, static_cast<size_t>(cols)),
+                        overflowContinuation[row] != 0);
+    }
 }
 
 // ============================================================================
@@ -86,50 +271,70 @@ void TerminalBuffer::Resize(int rows, int cols) {
 Cell& TerminalBuffer::GetCell(int row, int col) {
     ValidateRow(row);
     ValidateCol(col);
-    return m_screen[row][col];
+    return RowCells(row)[col];
 }
 
 const Cell& TerminalBuffer::GetCell(int row, int col) const {
     if (row < 0 || row >= m_rows || col < 0 || col >= m_cols) {
         return s_emptyCell;
     }
-    return m_screen[row][col];
+    return RowCells(row)[col];
 }
 
 void TerminalBuffer::SetCell(int row, int col, const Cell& cell) {
     if (row >= 0 && row < m_rows && col >= 0 && col < m_cols) {
-        m_screen[row][col] = cell;
-        MarkDirty(row);
+        RowCells(row)[col] = cell;
+        MarkDirty(row, col, col + std::max<int>(cell.width, 1));
     }
 }
 
 void TerminalBuffer::SetChar(int row, int col, uint32_t charCode, int width) {
     if (row >= 0 && row < m_rows && col >= 0 && col < m_cols) {
-        auto& cell = m_screen[row][col];
-        cell.charCode = charCode;
-        cell.width = static_cast<uint8_t>(width);
-        cell.combining[0] = cell.combining[1] = cell.combining[2] = 0;
-        MarkDirty(row);
+        auto& cell = RowCells(row)[col];
+        cell.SetCodepoint(charCode);
+        cell.width = static_cast<uint32_t>(width);
+        MarkDirty(row, col, col + std::max(width, 1));
     }
 }
 
 void TerminalBuffer::ClearCell(int row, int col) {
     if (row >= 0 && row < m_rows && col >= 0 && col < m_cols) {
-        m_screen[row][col].Clear();
-        MarkDirty(row);
+        RowCells(row)[col].Clear();
+        MarkDirty(row, col, col + 1);
     }
 }
 
 void TerminalBuffer::ClearRange(int row, int startCol, int endCol) {
-    if (row < 0 || row >= m_rows) return;
-    
+    FillRange(row, startCol, endCol, Cell{});
+}
+
+void TerminalBuffer::FillRange(int row, int startCol, int endCol, const Cell& fill) {
     startCol = std::max(0, startCol);
     endCol = std::min(m_cols, endCol);
-    
-    for (int col = startCol; col < endCol; ++col) {
-        m_screen[row][col].Clear();
+    if (row < 0 || row >= m_rows || startCol >= endCol) {
+        return;
+    }
+    const size_t storage = StorageRow(row);
+    if (m_rowFilled[storage] && m_rowFill[storage] == fill) {
+        return;
+    }
+
+    // Only the cells that differ are written and repainted (a clear of a
+    // screen mostly clear is little damage)
+    const std::span<Cell> cells = RowCells(row).subspan(static_cast<size_t>(startCol),
+                                                        static_cast<size_t>(endCol - startCol));
+    const auto differs = [&fill](const Cell& cell) { return cell != fill; };
+    const auto first = std::find_if(cells.begin(), cells.end(), differs);
+    if (first != cells.end()) {
+        const auto last = std::find_if(cells.rbegin(), std::make_reverse_iterator(first), differs).base();
+        FillCells({first, last}, fill);
+        MarkDirty(row, startCol + static_cast<int>(first - cells.begin()),
+                  startCol + static_cast<int>(last - cells.begin()));
+    }
+    if (startCol == 0 && endCol == m_cols) {
+        m_rowFill[storage] = fill;
+        m_rowFilled[storage] = 1;
     }
-    MarkDirty(row);
 }
 
 void TerminalBuffer::ClearRow(int row) {
@@ -142,14 +347,14 @@ void TerminalBuffer::ClearScreen() {
     }
 }
 
-Row& TerminalBuffer::GetRow(int row) {
+std::span<Cell> TerminalBuffer::GetRow(int row) {
     ValidateRow(row);
-    return m_screen[row];
+    return RowCells(row);
 }
 
-const Row& TerminalBuffer::GetRow(int row) const {
+std::span<const Cell> TerminalBuffer::GetRow(int row) const {
     ValidateRow(row);
-    return m_screen[row];
+    return RowCells(row);
 }
 
 // ============================================================================
@@ -168,44 +373,104 @@ void TerminalBuffer::Scroll(int lines, int top, int bottom) {
         return;
     }
 
+    // Scrolling a whole region or more just clears it
+    const int height = bottom - top;
+    const int count = std::min(std::abs(lines), height);
+    RecordScroll(lines > 0 ? count : -count, top, bottom);
+
     if (lines > 0) {
-        // Scroll up: move content up, blank lines appear at bottom
-        for (int i = 0; i < lines && top < bottom - 1; ++i) {
-            // Push top line to scrollback if at screen top
-            if (top == 0) {
-                m_scrollback.push_front(std::move(m_screen[top]));
-            }
-            
-            // Shift lines up within region
-            for (int row = top; row < bottom - 1; ++row) {
-                m_screen[row] = std::move(m_screen[row + 1]);
+        // Scroll up: push top lines to scrollback if at screen top
+        if (top == 0 && !m_alternate) {
+            for (int i = 0; i < count; ++i) {
+                PushScrollbackRow(i);
             }
-            
-            // Clear the bottom line
-            m_screen[bottom - 1] = CreateEmptyRow();
         }
-        TrimScrollback();
+
+        RotateRows(count, top, bottom);
+
+        // Clear the exposed bottom lines
+        for (int row = bottom - count; row < bottom; ++row) {
+            ResetRow(row);
+            MarkDirty(row);
+        }
     } else {
-        // Scroll down: move content down, blank lines appear at top
-        lines = -lines;
-        for (int i = 0; i < lines && top < bottom - 1; ++i) {
-            // Shift lines down within region
-            for (int row = bottom - 1; row > top; --row) {
-                m_screen[row] = std::move(m_screen[row - 1]);
+        RotateRows(-count, top, bottom);
+
+        // Fill the exposed top lines (restored from scrollback at screen top)
+        for (int row = top + count - 1; row >= top; --row) {
+            ResetRow(row);
+            if (top == 0 && !m_alternate) {
+                bool continuation = false;
+                PopScrollback(RowCells(row), &continuation);
+                m_continuation[Slot(row)] = continuation;
             }
-            
-            // Clear the top line (or restore from scrollback)
-            if (top == 0 && !m_scrollback.empty()) {
-                m_screen[top] = std::move(m_scrollback.front());
-                m_scrollback.pop_front();
-            } else {
-                m_screen[top] = CreateEmptyRow();
+            MarkDirty(row);
+        }
+    }
+}
+
+void TerminalBuffer::MoveRows(int lines, int top, int bottom) {
+    top = std::clamp(top, 0, m_rows);
+    bottom = std::clamp(bottom, top, m_rows);
+
+    const int height = bottom - top;
+    if (lines == 0 || height == 0) {
+        return;
+    }
+
+    const int count = std::min(std::abs(lines), height);
+    RecordScroll(lines > 0 ? count : -count, top, bottom);
+    RotateRows(lines > 0 ? count : -count, top, bottom);
+
+    // Exposed rows: vacated by the move, redrawn by the emulator's damage
+    const int first = lines > 0 ? bottom - count : top;
+    for (int row = first; row < first + count; ++row) {
+        ResetRow(row);
+        MarkDirty(row);
+    }
+}
+
+void TerminalBuffer::MoveRect(int lines, int top, int bottom, int left, int right, const Cell& fill) {
+    top = std::clamp(top, 0, m_rows);
+    bottom = std::clamp(bottom, top, m_rows);
+    left = std::clamp(left, 0, m_cols);
+    right = std::clamp(right, left, m_cols);
+
+    const int height = bottom - top;
+    if (lines == 0 || height == 0 || left == right) {
+        return;
+    }
+    const int count = std::min(std::abs(lines), height);
+    const int exposed = lines > 0 ? bottom - count : top;
+
+    if (left == 0 && right == m_cols) {
+        MoveRows(lines, top, bottom);
+        if (fill != Cell{}) {
+            for (int row = exposed; row < exposed + count; ++row) {
+                FillCells(RowCells(row), fill);
             }
         }
+        return;
     }
 
-    // Mark affected region as dirty
-    MarkDirtyRange(top, bottom);
+    // Moving up, rows are written top down; moving down, bottom up
+    const auto width = static_cast<size_t>(right - left);
+    for (int moved = 0; moved < height - count; ++moved) {
+        const int row = lines > 0 ? top + moved : bottom - 1 - moved;
+        const std::span<Cell> to = RowCells(row).subspan(static_cast<size_t>(left), width);
+        const std::span<const Cell> from =
+            RowCells(lines > 0 ? row + count : row - count).subspan(static_cast<size_t>(left), width);
+        const CellChange change = FindChangedCells(to, from);
+        if (change.IsEmpty()) {
+            continue;
+        }
+        std::copy(from.begin(), from.end(), to.begin());
+        MarkDirty(row, left + static_cast<int>(change.start), left + static_cast<int>(change.end));
+    }
+
+    for (int row = exposed; row < exposed + count; ++row) {
+        FillRange(row, left, right, fill);
+    }
 }
 
 void TerminalBuffer::ScrollUp() {
@@ -220,24 +485,345 @@ void TerminalBuffer::ScrollDown() {
 // Scrollback Buffer
 // ============================================================================
 
-size_t TerminalBuffer::GetScrollbackSize() const noexcept {
-    return m_scrollback.size();
+size_t TerminalBuffer::GetScrollbackSize() const {
+    const size_t stored = m_reflow.IsActive() ? m_reflow.Size(m_scrollback) : m_scrollback.Size();
+    return m_log ? stored + m_log->GetLineCount() : stored;
 }
 
 const Row* TerminalBuffer::GetScrollbackLine(size_t index) const {
-    if (index < m_scrollback.size()) {
-        return &m_scrollback[index];
+    const size_t stored = m_reflow.IsActive() ? m_reflow.Size(m_scrollback) : m_scrollback.Size();
+    if (index >= stored) {
+        return m_log ? m_log->Decode(index - stored, m_cols) : nullptr;
     }
-    return nullptr;
+    return m_reflow.IsActive() ? m_reflow.Get(m_scrollback, index) : m_scrollback.Get(index);
+}
+
+std::span<const Cell> TerminalBuffer::GetLine(uint64_t line) const {
+    const uint64_t screen = GetScreenLine();
+    if (line >= screen) {
+        return line - screen < static_cast<uint64_t>(m_rows) ? GetRow(static_cast<int>(line - screen))
+                                                             : std::span<const Cell>{};
+    }
+    const auto index = static_cast<size_t>(screen - 1 - line);
+    const Row* row = index < GetScrollbackSize() ? GetScrollbackLine(index) : nullptr;
+    return row ? std::span<const Cell>(*row) : std::span<const Cell>{};
+}
+
+uint64_t TerminalBuffer::GetScrollbackLineId(size_t index) const {
+    // Re-wrapped lines don't map one to one onto stored ones; a log line's
+    // id is its line number, below the stored ones (see AttachLog)
+    if (m_reflow.IsActive() || index >= GetScrollbackSize()) {
+        return 0;
+    }
+    return m_scrollback.GetEndId() - index;
+}
+
+void TerminalBuffer::PushScrollback(std::span<const Cell> cells, bool continuation) {
+    const auto cols = static_cast<size_t>(m_cols);
+    if (cells.size() != cols) {
+        m_pushScratch.assign(cells.begin(), cells.begin() + std::min(cells.size(), cols));
+        m_pushScratch.resize(cols);
+        cells = m_pushScratch;
+    }
+    StoreScrollback(cells, continuation);
+}
+
+bool TerminalBuffer::PopScrollback(std::span<Cell> out, bool* continuation) {
+    const uint64_t line = m_scrollback.GetEndId() - 1;
+    if (!m_scrollback.PopNewest(out, continuation)) {
+        return false;
+    }
+    m_overview.Remove(line, out);
+    // Popped line ids are handed out again by the next pushes
+    ++m_scrollbackEpoch;
+    m_scrollbackGeneration = ++m_generation;
+    if (m_reflow.IsActive()) {
+        m_reflow.Sync(m_scrollback);
+    }
+    return true;
+}
+
+void TerminalBuffer::PushScrollbackRow(int row) {
+    StoreScrollback(RowCells(row), m_continuation[Slot(row)] != 0);
+}
+
+void TerminalBuffer::StoreScrollback(std::span<const Cell> cells, bool continuation) {
+    const uint64_t line = m_scrollback.GetEndId();
+    m_scrollback.Push(cells, continuation);
+    m_overview.Add(line, cells, m_scrollback.GetFirstId());
+    if (!m_images.empty()) {
+        TrimImages();
+    }
+}
+
+bool TerminalBuffer::ReflowScrollback(size_t lines) {
+    return m_reflow.IsActive() && m_reflow.Step(m_scrollback, lines);
 }
 
 void TerminalBuffer::ClearScrollback() {
-    m_scrollback.clear();
+    m_scrollback.Clear();
+    m_overview.Clear();
+    m_log.reset();
+    ++m_scrollbackEpoch;
+    m_scrollbackGeneration = ++m_generation;
+    TrimPromptMarks();
+    TrimImages();
+}
+
+void TerminalBuffer::ShareScrollback(const TerminalBuffer& source) {
+    m_scrollback.ShareFrom(source.m_scrollback);
+    m_overview = source.m_overview;
+    m_times = source.m_times;
+    m_log = source.m_log;
+    if (source.m_reflow.IsActive() || source.m_cols != m_cols) {
+        m_reflow.Reset(m_cols);
+    }
+    ++m_scrollbackEpoch;
+    m_scrollbackGeneration = ++m_generation;
+
+    // The screen down to its last row in use; a full-screen application's
+    // alternate screen is not history
+    if (!source.m_alternate) {
+        int used = source.m_rows;
+        Cell fill;
+        while (used > 0 && FindTrailingFill(source.GetRow(used - 1), fill) == 0 && fill == Cell{}) {
+            --used;
+        }
+        for (int row = 0; row < used; ++row) {
+            StoreScrollback(source.GetRow(row), source.IsContinuation(row));
+        }
+    }
+
+    // Marks keep their lines, as the lines keep their numbers
+    m_promptMarks.clear();
+    for (const PromptMark& mark : source.m_promptMarks) {
+        if (mark.line < GetScreenLine()) {
+            m_promptMarks.push_back(mark);
+        }
+    }
+    TrimPromptMarks();
+}
+
+void TerminalBuffer::StampLines(uint64_t endLine, uint64_t unixMs) {
+    // Lines cleared or trimmed away are not stamped; their blocks go
+    if (m_lineTimes && !m_alternate) {
+        m_times.Stamp(m_scrollback.GetFirstId(), endLine, unixMs);
+    }
+}
+
+void TerminalBuffer::AttachLog(std::shared_ptr<const LogFile> log) {
+    // Every line the file can hold gets a number below the stored ones, so
+    // lines keep theirs as the index counts more
+    m_scrollback.SetFirstId(log->GetSize() + 2);
+    m_log = std::move(log);
+    ++m_scrollbackEpoch;
+    m_scrollbackGeneration = ++m_generation;
+}
+
+void TerminalBuffer::Hibernate() {
+    m_scrollback.Hibernate();
+    Row().swap(m_pushScratch);
+    std::vector<StyleRun>().swap(m_runScratch);
+}
+
+bool TerminalBuffer::HibernateSlice(size_t lines) {
+    if (m_scrollback.HibernateSlice(lines)) {
+        return true;
+    }
+    Row().swap(m_pushScratch);
+    std::vector<StyleRun>().swap(m_runScratch);
+    return false;
 }
 
 void TerminalBuffer::SetMaxScrollback(size_t lines) {
-    m_maxScrollback = lines;
-    TrimScrollback();
+    m_scrollback.SetMaxLines(lines);
+}
+
+void TerminalBuffer::SetMaxScrollbackDeferred(size_t lines) {
+    m_scrollback.SetMaxLinesDeferred(lines);
+    TrimPromptMarks();
+    TrimImages();
+}
+
+bool TerminalBuffer::TrimScrollback(size_t lines) {
+    const bool more = m_scrollback.TrimSlice(lines);
+    TrimPromptMarks();
+    TrimImages();
+    return more;
+}
+
+ScrollbackStats TerminalBuffer::GetScrollbackStats() const {
+    return m_scrollback.GetStats();
+}
+
+size_t TerminalBuffer::GetScreenBytes() const noexcept {
+    size_t runs = m_runScratch.capacity();
+    for (const std::vector<StyleRun>& row : m_styleRuns) {
+        runs += row.capacity();
+    }
+    return (m_cells.capacity() + m_hiddenCells.capacity()) * sizeof(Cell) +
+           (m_rowOffset.capacity() + m_hiddenRowOffset.capacity()) * sizeof(size_t) +
+           m_continuation.capacity() + m_hiddenContinuation.capacity() +
+           m_dirtySpan.capacity() * sizeof(DirtySpan) + m_rowGeneration.capacity() * sizeof(uint64_t) +
+           m_styleRuns.capacity() * sizeof(std::vector<StyleRun>) + runs * sizeof(StyleRun) +
+           m_rowFill.capacity() * sizeof(Cell) + m_rowFilled.capacity();
+}
+
+// ============================================================================
+// Prompt Marks
+// ============================================================================
+
+namespace {
+
+[[nodiscard]] bool MarkBefore(const PromptMark& a, const PromptMark& b) noexcept {
+    return a.line < b.line || (a.line == b.line && a.col < b.col);
+}
+
+[[nodiscard]] bool MarkAbove(const PromptMark& mark, uint64_t line) noexcept {
+    return mark.line < line;
+}
+
+} // namespace
+
+void TerminalBuffer::AddPromptMark(const PromptMark& mark) {
+    TrimPromptMarks();
+    while (!m_promptMarks.empty() && MarkBefore(mark, m_promptMarks.back())) {
+        m_promptMarks.pop_back();
+    }
+    m_promptMarks.push_back(mark);
+    m_overview.Touch();
+}
+
+const PromptMark* TerminalBuffer::FindPromptMark(uint64_t line, int direction, PromptMarkKind kind) const {
+    if (direction < 0) {
+        auto it = std::lower_bound(m_promptMarks.begin(), m_promptMarks.end(), line, MarkAbove);
+        while (it != m_promptMarks.begin()) {
+            --it;
+            if (it->kind == kind) {
+                return &*it;
+            }
+        }
+    } else {
+        auto it = std::lower_bound(m_promptMarks.begin(), m_promptMarks.end(), line + 1, MarkAbove);
+        for (; it != m_promptMarks.end(); ++it) {
+            if (it->kind == kind) {
+                return &*it;
+            }
+        }
+    }
+    return nullptr;
+}
+
+bool TerminalBuffer::FindCommandOutput(uint64_t line, PromptMark& start, PromptMark& end) const {
+    auto output = std::lower_bound(m_promptMarks.begin(), m_promptMarks.end(), line + 1, MarkAbove);
+    do {
+        if (output == m_promptMarks.begin()) {
+            return false;
+        }
+        --output;
+    } while (output->kind != PromptMarkKind::Output);
+    start = *output;
+
+    // The shell sends Finished before the next prompt; some send only the prompt
+    const auto next = std::find_if(output + 1, m_promptMarks.end(), [](const PromptMark& mark) {
+        return mark.kind == PromptMarkKind::Finished || mark.kind == PromptMarkKind::Prompt;
+    });
+    if (next != m_promptMarks.end()) {
+        end = *next;
+    } else {
+        end = PromptMark{GetScreenLine() + static_cast<uint64_t>(m_rows), -1, 0, PromptMarkKind::Finished};
+    }
+    return true;
+}
+
+void TerminalBuffer::TrimPromptMarks() {
+    const uint64_t first = m_scrollback.GetFirstId();
+    while (!m_promptMarks.empty() && m_promptMarks.front().line < first) {
+        m_promptMarks.pop_front();
+    }
+}
+
+// ============================================================================
+// Inline Images
+// ============================================================================
+
+void TerminalBuffer::AddImage(const ImagePlacement& placement) {
+    TrimImages();
+
+    // Output redrawn from above drops what it covered, as for marks; an
+    // image drawn again at the same cell replaces the old one
+    while (!m_images.empty() && (placement.line < m_images.back().line ||
+                                 (placement.line == m_images.back().line && placement.col <= m_images.back().col))) {
+        m_imageStore->Release(m_images.back().image);
+        m_images.pop_back();
+    }
+    m_images.push_back(placement);
+    while (m_images.size() > kMaxImages) {
+        PopImage();
+    }
+}
+
+void TerminalBuffer::FindImages(uint64_t firstLine, uint64_t endLine, std::vector<ImagePlacement>& placements) const {
+    // Few enough to scan; a tall image starting far above still covers
+    const uint64_t first = std::max(firstLine, m_scrollback.GetFirstId());
+    for (const ImagePlacement& placement : m_images) {
+        if (placement.line >= endLine) {
+            break;
+        }
+        if (placement.line + placement.rows > first) {
+            placements.push_back(placement);
+        }
+    }
+}
+
+void TerminalBuffer::TrimImages() {
+    const uint64_t first = m_scrollback.GetFirstId();
+    while (!m_images.empty() && m_images.front().line + m_images.front().rows <= first) {
+        PopImage();
+    }
+}
+
+void TerminalBuffer::PopImage() {
+    m_imageStore->Release(m_images.front().image);
+    m_images.pop_front();
+}
+
+// ============================================================================
+// Soft Wrap
+// ============================================================================
+
+void TerminalBuffer::SetContinuation(int row, bool continuation) {
+    if (row >= 0 && row < m_rows) {
+        m_continuation[Slot(row)] = continuation;
+    }
+}
+
+bool TerminalBuffer::IsContinuation(int row) const {
+    return row >= 0 && row < m_rows && m_continuation[Slot(row)] != 0;
+}
+
+// ============================================================================
+// Alternate Screen
+// ============================================================================
+
+bool TerminalBuffer::SetAlternateScreen(bool active) {
+    if (active == m_alternate) {
+        return true;
+    }
+
+    m_cells.swap(m_hiddenCells);
+    m_rowOffset.swap(m_hiddenRowOffset);
+    std::swap(m_origin, m_hiddenOrigin);
+    m_continuation.swap(m_hiddenContinuation);
+    m_alternate = active;
+
+    // A scroll not yet drawn happened on the other screen
+    m_pendingScroll = PendingScroll{};
+    MarkAllDirty();
+
+    const bool intact = !m_hiddenStale;
+    m_hiddenStale = false;
+    return intact;
 }
 
 // ============================================================================
@@ -245,8 +831,27 @@ void TerminalBuffer::SetMaxScrollback(size_t lines) {
 // ============================================================================
 
 void TerminalBuffer::MarkDirty(int row) {
-    if (row >= 0 && row < m_rows) {
-        m_dirty[row] = true;
+    MarkDirty(row, 0, m_cols);
+}
+
+void TerminalBuffer::MarkDirty(int row, int startCol, int endCol) {
+    startCol = std::max(0, startCol);
+    endCol = std::min(m_cols, endCol);
+    if (row < 0 || row >= m_rows || startCol >= endCol) {
+        return;
+    }
+
+    const size_t slot = Slot(row);
+    m_rowGeneration[StorageRow(row)] = ++m_generation;
+    m_rowFilled[StorageRow(row)] = 0;
+    UpdateStyleRuns(row, startCol, endCol);
+    DirtySpan& span = m_dirtySpan[slot];
+    if (m_dirty.Test(slot)) {
+        span.startCol = std::min(span.startCol, startCol);
+        span.endCol = std::max(span.endCol, endCol);
+    } else {
+        m_dirty.Set(slot);
+        span = DirtySpan{startCol, endCol};
     }
 }
 
@@ -254,103 +859,102 @@ void TerminalBuffer::MarkDirtyRange(int startRow, int endRow) {
     startRow = std::max(0, startRow);
     endRow = std::min(m_rows, endRow);
     for (int row = startRow; row < endRow; ++row) {
-        m_dirty[row] = true;
+        const size_t slot = Slot(row);
+        m_dirty.Set(slot);
+        m_dirtySpan[slot] = DirtySpan{0, m_cols};
+        m_rowGeneration[StorageRow(row)] = ++m_generation;
+        m_rowFilled[StorageRow(row)] = 0;
+        UpdateStyleRuns(row, 0, m_cols);
     }
 }
 
 void TerminalBuffer::MarkAllDirty() {
-    std::fill(m_dirty.begin(), m_dirty.end(), true);
+    m_dirty.SetAll();
+    std::fill(m_dirtySpan.begin(), m_dirtySpan.end(), DirtySpan{0, m_cols});
+    for (uint64_t& generation : m_rowGeneration) {
+        generation = ++m_generation;
+    }
+    std::fill(m_rowFilled.begin(), m_rowFilled.end(), 0);
+    for (int row = 0; row < m_rows; ++row) {
+        UpdateStyleRuns(row, 0, m_cols);
+    }
+
+    // Everything is repainted; nothing left worth moving
+    m_pendingScroll = PendingScroll{};
 }
 
 bool TerminalBuffer::IsDirty(int row) const {
     if (row >= 0 && row < m_rows) {
-        return m_dirty[row];
+        return m_dirty.Test(Slot(row));
     }
     return false;
 }
 
+DirtySpan TerminalBuffer::GetDirtySpan(int row) const {
+    if (!IsDirty(row)) {
+        return {};
+    }
+    return m_dirtySpan[Slot(row)];
+}
+
+int TerminalBuffer::NextDirtyRow(int row) const noexcept {
+    row = std::max(row, 0);
+    if (row >= m_rows) {
+        return -1;
+    }
+
+    // Screen rows from here on are the slots up to the end of the ring, then
+    // (if the row lies before the wrap) the slots before the origin
+    const size_t slot = Slot(row);
+    const size_t end = slot >= m_origin ? static_cast<size_t>(m_rows) : m_origin;
+    size_t found = m_dirty.FindNext(slot, end);
+    if (found == DirtyBitmap::npos && slot >= m_origin) {
+        found = m_dirty.FindNext(0, m_origin);
+    }
+    return found == DirtyBitmap::npos ? -1 : RowOfSlot(found);
+}
+
 std::vector<int> TerminalBuffer::GetDirtyRows() const {
     std::vector<int> result;
-    result.reserve(m_rows);
-    for (int row = 0; row < m_rows; ++row) {
-        if (m_dirty[row]) {
-            result.push_back(row);
-        }
+    result.reserve(m_dirty.Count());
+    for (int row = NextDirtyRow(0); row >= 0; row = NextDirtyRow(row + 1)) {
+        result.push_back(row);
     }
     return result;
 }
 
 void TerminalBuffer::ClearDirty() {
-    std::fill(m_dirty.begin(), m_dirty.end(), false);
+    m_dirty.ClearAll();
+    m_pendingScroll = PendingScroll{};
 }
 
 bool TerminalBuffer::HasDirty() const noexcept {
-    return std::any_of(m_dirty.begin(), m_dirty.end(), [](bool d) { return d; });
+    return m_dirty.Any();
 }
 
 // ============================================================================
 // Text Extraction
 // ============================================================================
 
+void TerminalBuffer::AppendColumnText(std::string& out, std::span<const Cell> cells, int startCol, int endCol,
+                                      bool trimRight) {
+    ClampColumns(cells, startCol, endCol, trimRight);
+    AppendCells(out, cells, startCol, endCol, 0x80, PushUtf8);
+}
+
+void TerminalBuffer::AppendColumnText(std::wstring& out, std::span<const Cell> cells, int startCol, int endCol,
+                                      bool trimRight) {
+    ClampColumns(cells, startCol, endCol, trimRight);
+    AppendCells(out, cells, startCol, endCol, 0x10000, PushUtf16);
+}
+
 std::string TerminalBuffer::GetRowText(int row) const {
     if (row < 0 || row >= m_rows) {
         return {};
     }
 
     std::string result;
-    result.reserve(m_cols * 4);  // UTF-8 can be up to 4 bytes per char
-
-    for (const auto& cell : m_screen[row]) {
-        // Skip continuation cells (part of wide character)
-        if (cell.width == 0) {
-            continue;
-        }
-
-        // Convert UTF-32 to UTF-8
-        uint32_t cp = cell.charCode;
-        if (cp < 0x80) {
-            result += static_cast<char>(cp);
-        } else if (cp < 0x800) {
-            result += static_cast<char>(0xC0 | (cp >> 6));
-            result += static_cast<char>(0x80 | (cp & 0x3F));
-        } else if (cp < 0x10000) {
-            result += static_cast<char>(0xE0 | (cp >> 12));
-            result += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
-            result += static_cast<char>(0x80 | (cp & 0x3F));
-        } else {
-            result += static_cast<char>(0xF0 | (cp >> 18));
-            result += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
-            result += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
-            result += static_cast<char>(0x80 | (cp & 0x3F));
-        }
-
-        // Add combining characters
-        for (uint32_t comb : cell.combining) {
-            if (comb == 0) break;
-            // Same UTF-8 encoding for combining chars
-            if (comb < 0x80) {
-                result += static_cast<char>(comb);
-            } else if (comb < 0x800) {
-                result += static_cast<char>(0xC0 | (comb >> 6));
-                result += static_cast<char>(0x80 | (comb & 0x3F));
-            } else if (comb < 0x10000) {
-                result += static_cast<char>(0xE0 | (comb >> 12));
-                result += static_cast<char>(0x80 | ((comb >> 6) & 0x3F));
-                result += static_cast<char>(0x80 | (comb & 0x3F));
-            } else {
-                result += static_cast<char>(0xF0 | (comb >> 18));
-                result += static_cast<char>(0x80 | ((comb >> 12) & 0x3F));
-                result += static_cast<char>(0x80 | ((comb >> 6) & 0x3F));
-                result += static_cast<char>(0x80 | (comb & 0x3F));
-            }
-        }
-    }
-
-    // Trim trailing spaces
-    while (!result.empty() && result.back() == ' ') {
-        result.pop_back();
-    }
-
+    AppendColumnText(result, RowCells(row), 0, m_cols);
     return result;
 }
 
@@ -362,17 +966,7 @@ std::string TerminalBuffer::GetRegionText(int startRow, int startCol,
     endRow = std::clamp(endRow, 0, m_rows - 1);
     
     for (int row = startRow; row <= endRow; ++row) {
-        std::string rowText = GetRowText(row);
-        
-        int colStart = (row == startRow) ? startCol : 0;
-        int colEnd = (row == endRow) ? endCol : m_cols;
-        
-        // Note: This is a simplified extraction; proper UTF-8 column handling
-        // would require more complex logic
-        if (!rowText.empty()) {
-            result += rowText;
-        }
-        
+        AppendColumnText(result, RowCells(row), row == startRow ? startCol : 0, row == endRow ? endCol : m_cols);
         if (row < endRow) {
             result += '\n';
         }
@@ -381,6 +975,23 @@ std::string TerminalBuffer::GetRegionText(int startRow, int startCol,
     return result;
 }
 
+std::string TerminalBuffer::GetBlockText(int startRow, int startCol,
+                                         int endRow, int endCol) const {
+    std::string result;
+
+    startRow = std::clamp(startRow, 0, m_rows - 1);
+    endRow = std::clamp(endRow, 0, m_rows - 1);
+
+    for (int row = startRow; row <= endRow; ++row) {
+        AppendColumnText(result, RowCells(row), startCol, endCol);
+        if (row < endRow) {
+            result += '\n';
+        }
+    }
+
+    return result;
+}
+
 std::string TerminalBuffer::GetAllText() const {
     return GetRegionText(0, 0, m_rows - 1, m_cols);
 }
@@ -401,18 +1012,92 @@ void TerminalBuffer::ValidateCol(int col) const {
     }
 }
 
-Row TerminalBuffer::CreateEmptyRow() const {
-    Row row(m_cols);
-    for (auto& cell : row) {
-        cell.Clear();
+void TerminalBuffer::ResetRow(int row) {
+    FillCells(RowCells(row), Cell{});
+    m_continuation[Slot(row)] = 0;
+}
+
+void TerminalBuffer::UpdateStyleRuns(int row, int startCol, int endCol) {
+    const std::span<const Cell> cells = RowCells(row);
+    std::vector<StyleRun>& runs = m_styleRuns[StorageRow(row)];
+
+    // Continuation cells just past the span go with the character before
+    while (endCol < m_cols && cells[endCol].width == 0) {
+        ++endCol;
+    }
+
+    // Runs before the span are kept (the last one cut at it), the span is
+    // rescanned, and runs after it are kept, the first one joining the
+    // span's last if the style carries on
+    m_runScratch.clear();
+    for (const StyleRun& run : runs) {
+        if (run.start >= startCol) {
+            break;
+        }
+        m_runScratch.push_back(StyleRun{run.start, static_cast<uint16_t>(std::min(run.End(), startCol) - run.start)});
+    }
+    AppendStyleRuns(cells, static_cast<size_t>(startCol), static_cast<size_t>(endCol), m_runScratch);
+    for (const StyleRun& run : runs) {
+        if (run.End() <= endCol) {
+            continue;
+        }
+        const int start = std::max<int>(run.start, endCol);
+        const auto length = static_cast<uint16_t>(run.End() - start);
+        if (start == endCol && !m_runScratch.empty() && SameStyle(cells[start], cells[m_runScratch.back().start])) {
+            m_runScratch.back().length += length;
+        } else {
+            m_runScratch.push_back(StyleRun{static_cast<uint16_t>(start), length});
+        }
+    }
+    runs.swap(m_runScratch);
+}
+
+void TerminalBuffer::RotateRows(int lines, int top, int bottom) {
+    const int height = bottom - top;
+    if (lines == 0 || height <= 0) {
+        return;
+    }
+
+    // Full screen: move the ring origin, O(1)
+    if (top == 0 && bottom == m_rows) {
+        const int shift = ((lines % m_rows) + m_rows) % m_rows;
+        m_origin = (m_origin + static_cast<size_t>(shift)) % static_cast<size_t>(m_rows);
+        return;
+    }
+
+    // Region: swap row offsets through the region (cells stay put)
+    const int count = std::min(std::abs(lines), height);
+    if (lines > 0) {
+        for (int row = top; row + count < bottom; ++row) {
+            std::swap(m_rowOffset[Slot(row)], m_rowOffset[Slot(row + count)]);
+            std::swap(m_continuation[Slot(row)], m_continuation[Slot(row + count)]);
+            m_dirty.Swap(Slot(row), Slot(row + count));
+            std::swap(m_dirtySpan[Slot(row)], m_dirtySpan[Slot(row + count)]);
+        }
+    } else {
+        for (int row = bottom - 1; row - count >= top; --row) {
+            std::swap(m_rowOffset[Slot(row)], m_rowOffset[Slot(row - count)]);
+            std::swap(m_continuation[Slot(row)], m_continuation[Slot(row - count)]);
+            m_dirty.Swap(Slot(row), Slot(row - count));
+            std::swap(m_dirtySpan[Slot(row)], m_dirtySpan[Slot(row - count)]);
+        }
     }
-    return row;
 }
 
-void TerminalBuffer::TrimScrollback() {
-    while (m_scrollback.size() > m_maxScrollback) {
-        m_scrollback.pop_back();
+void TerminalBuffer::RecordScroll(int lines, int top, int bottom) {
+    PendingScroll& pending = m_pendingScroll;
+
+    if (pending.lines != 0 && (pending.top != top || pending.bottom != bottom)) {
+        // A different region: the old one can no longer be moved as a block,
+        // so repaint it. Called before rotating, so these flags move along
+        // with the rows.
+        MarkDirtyRange(pending.top, pending.bottom);
+        pending = PendingScroll{};
     }
+
+    pending.top = top;
+    pending.bottom = bottom;
+    pending.lines = std::clamp(pending.lines + lines, -(bottom - top), bottom - top);
 }
 
 } // namespace Console3::Core
@@ -3,107 +3,110 @@
 // Terminal screen buffer with scrollback support
 //
 // Manages the terminal's cell grid, tracks dirty lines for efficient
-// rendering, and maintains a scrollback history buffer.
+// rendering, and maintains a scrollback history buffer (ScrollbackStore,
+// which compresses all but the most recent lines).
+//
+// The screen is one contiguous rows * cols cell slab. A ring of row offsets
+// maps screen rows to slab rows, so scrolling rotates offsets and clears the
+// exposed rows instead of moving or allocating cells.
+//
+// Rows that continue the row above (a soft wrap) are flagged, on screen and
+// in scrollback, so a width change can rejoin and re-wrap logical lines: the
+// screen at once, the scrollback lazily through a ScrollbackReflow.
+//
+// A second, preallocated grid backs the alternate screen used by full-screen
+// programs. Switching exchanges the two grids, so the primary screen is
+// kept as it was and comes back intact when the program exits.
+//
+// Shell integration marks (OSC 133: prompt, command line, output, finished)
+// are indexed by absolute line, oldest first, so the previous or next prompt
+// is a binary search away however long the history; nothing scans text.
+//
+// Each row keeps its style runs (stretches of one fg, bg and attributes),
+// brought up to date as its cells are marked dirty: only the changed
+// columns are rescanned and spliced in between the runs around them, so
+// the renderer, the exporters and the delta encoder get a row's styles
+// without comparing every cell again.
+//
+// Inline images (sixel) are placed the same way, at the absolute line and
+// column of their top left cell; their pixels are in the buffer's
+// ImageStore, and go when the last line they cover is trimmed.
 
 #include <cstdint>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <span>
 #include <string>
 #include <vector>
-#include <deque>
 #include <bitset>
 #include <optional>
 
-namespace Console3::Core {
+#include "Core/Cell.h"
+#include "Core/DirtyBitmap.h"
+#include "Core/ImageStore.h"
+#include "Core/ScrollbackOverview.h"
+#include "Core/ScrollbackReflow.h"
+#include "Core/ScrollbackStore.h"
+#include "Core/ScrollbackTimes.h"
 
-/// Cell attributes packed into a single byte
-struct CellAttributes {
-    uint8_t bold : 1 = 0;
-    uint8_t italic : 1 = 0;
-    uint8_t underline : 2 = 0;      ///< 0=none, 1=single, 2=double, 3=curly
-    uint8_t blink : 1 = 0;
-    uint8_t reverse : 1 = 0;
-    uint8_t strikethrough : 1 = 0;
-    uint8_t conceal : 1 = 0;
-
-    bool operator==(const CellAttributes& other) const noexcept = default;
-};
+namespace Console3::Core {
 
-/// 24-bit RGB color with type flags
-struct CellColor {
-    uint8_t r = 0;
-    uint8_t g = 0;
-    uint8_t b = 0;
-    uint8_t flags = 0;  ///< Bit 0: isDefault, Bit 1: isIndexed
-    
-    static constexpr uint8_t FLAG_DEFAULT = 0x01;
-    static constexpr uint8_t FLAG_INDEXED = 0x02;
-
-    [[nodiscard]] bool IsDefault() const noexcept { return (flags & FLAG_DEFAULT) != 0; }
-    [[nodiscard]] bool IsIndexed() const noexcept { return (flags & FLAG_INDEXED) != 0; }
-
-    /// Create a default color
-    static CellColor Default() {
-        CellColor c;
-        c.flags = FLAG_DEFAULT;
-        return c;
-    }
+class LogFile;
 
-    /// Create an RGB color
-    static CellColor Rgb(uint8_t r, uint8_t g, uint8_t b) {
-        CellColor c;
-        c.r = r;
-        c.g = g;
-        c.b = b;
-        c.flags = 0;
-        return c;
-    }
+/// Rows scrolled since the last ClearDirty(), for renderers that move the
+/// previous frame instead of repainting it
+struct PendingScroll {
+    int top = 0;        ///< Top of the scrolled region (inclusive)
+    int bottom = 0;     ///< Bottom of the scrolled region (exclusive)
+    int lines = 0;      ///< Lines moved (positive = up, 0 = no scroll)
+};
 
-    /// Create an indexed palette color (index stored in r)
-    static CellColor Indexed(uint8_t index) {
-        CellColor c;
-        c.r = index;
-        c.flags = FLAG_INDEXED;
-        return c;
-    }
+/// Columns of a dirty row changed since the last ClearDirty()
+struct DirtySpan {
+    int startCol = 0;   ///< First changed column (inclusive)
+    int endCol = 0;     ///< End of the changed columns (exclusive)
 
-    bool operator==(const CellColor& other) const noexcept = default;
+    [[nodiscard]] bool IsEmpty() const noexcept { return startCol >= endCol; }
 };
 
-/// A single terminal cell
-struct Cell {
-    uint32_t charCode = U' ';       ///< Primary UTF-32 codepoint
-    uint32_t combining[3] = {0};    ///< Up to 3 combining characters
-    CellColor fg = CellColor::Default();
-    CellColor bg = CellColor::Default();
-    CellAttributes attrs{};
-    uint8_t width = 1;              ///< Cell width (1 or 2 for wide chars)
-
-    /// Reset to default empty cell
-    void Clear() {
-        charCode = U' ';
-        combining[0] = combining[1] = combining[2] = 0;
-        fg = CellColor::Default();
-        bg = CellColor::Default();
-        attrs = CellAttributes{};
-        width = 1;
-    }
+/// Shell integration mark kinds (OSC 133 A to D)
+enum class PromptMarkKind : uint8_t {
+    Prompt,     ///< A: the prompt starts
+    Command,    ///< B: the command line starts (the prompt ended)
+    Output,     ///< C: the command's output starts
+    Finished    ///< D: the command finished
+};
 
-    /// Check if cell has combining characters
-    [[nodiscard]] bool HasCombining() const noexcept {
-        return combining[0] != 0;
-    }
+/// A shell integration mark at a cell
+struct PromptMark {
+    uint64_t line = 0;              ///< Absolute line (see TerminalBuffer::GetScreenLine)
+    int32_t exitCode = -1;          ///< Finished: the command's status (-1 if not given)
+    uint16_t col = 0;
+    PromptMarkKind kind = PromptMarkKind::Prompt;
+};
 
-    bool operator==(const Cell& other) const noexcept = default;
+/// An inline image over cells, placed at its top left cell
+struct ImagePlacement {
+    uint64_t image = 0;             ///< ImageStore id
+    uint64_t line = 0;              ///< Absolute line of its top row
+    uint16_t col = 0;
+    uint16_t rows = 0;              ///< Cells it covers
+    uint16_t cols = 0;
 };
 
-/// A row of cells
-using Row = std::vector<Cell>;
+/// Receives rows a Resize() pushes off the top, oldest first
+using ResizeOverflowSink = std::function<void(std::span<const Cell> cells, bool continuation)>;
 
 /// Configuration for the terminal buffer
 struct TerminalBufferConfig {
     int rows = 25;
     int cols = 80;
     size_t scrollbackLines = 10000;  ///< Maximum scrollback history lines
+    size_t scrollbackHotLines = ScrollbackStore::kDefaultHotLines;  ///< Recent lines kept uncompressed
+    bool scrollbackToDisk = false;   ///< Spill lines beyond scrollbackLines to a temp file instead of dropping them
+    bool scrollbackInternLines = false; ///< Store repeated cold lines once
+    bool lineTimes = false;          ///< Keep when each line was completed (StampLines)
 };
 
 /// Terminal buffer with scrollback support and dirty tracking
@@ -127,9 +130,21 @@ public:
     [[nodiscard]] int GetCols() const noexcept { return m_cols; }
 
     /// Resize the terminal buffer
+    /// Logical lines are re-wrapped at the new width. Blank rows at the
+    /// bottom go first when the result is too tall, then rows from the top.
+    /// Scrollback is re-wrapped lazily (see ReflowScrollback).
     /// @param rows New row count
     /// @param cols New column count
-    void Resize(int rows, int cols);
+    /// @param pushOverflow Push rows that no longer fit to scrollback (false
+    ///                     when an emulator pushes its own)
+    void Resize(int rows, int cols, bool pushOverflow = true);
+
+    /// Resize as above, keeping a cursor on the character it was on, for an
+    /// emulator that writes into this buffer itself
+    /// @param cursorRow, cursorCol In: the cursor before; out: after
+    /// @param overflow Receives the rows that no longer fit, instead of the
+    ///                 scrollback
+    void Resize(int rows, int cols, int& cursorRow, int& cursorCol, const ResizeOverflowSink& overflow);
 
     // ========================================================================
     // Cell Access
@@ -154,15 +169,29 @@ public:
     /// Clear a range of cells in a row
     void ClearRange(int row, int startCol, int endCol);
 
+    /// Fill a range of cells in a row with one cell (an erase in the pen's
+    /// colors), marking only the cells that change dirty
+    /// A row filled whole is remembered as such until it is next marked
+    /// dirty, so erasing it again costs nothing.
+    void FillRange(int row, int startCol, int endCol, const Cell& fill);
+
+    /// Get the cell a row is filled with throughout, if FillRange() left it
+    /// so and nothing has been written to it since
+    /// @return The fill, or nullptr if the row may hold anything
+    [[nodiscard]] const Cell* GetRowFill(int row) const noexcept {
+        const size_t storage = StorageRow(row);
+        return m_rowFilled[storage] ? &m_rowFill[storage] : nullptr;
+    }
+
     /// Clear entire row
     void ClearRow(int row);
 
     /// Clear entire screen
     void ClearScreen();
 
-    /// Get a row by index
-    [[nodiscard]] Row& GetRow(int row);
-    [[nodiscard]] const Row& GetRow(int row) const;
+    /// Get a row by index (GetCols() cells, valid until the next Resize)
+    [[nodiscard]] std::span<Cell> GetRow(int row);
+    [[nodiscard]] std::span<const Cell> GetRow(int row) const;
 
     // ========================================================================
     // Scrolling
@@ -180,25 +209,245 @@ public:
     /// Pop line from scrollback and scroll down
     void ScrollDown();
 
+    /// Move rows within a region without touching scrollback
+    /// Used for emulator moverect events: the emulator has already pushed any
+    /// scrolled-off line to scrollback. Exposed rows are cleared and marked
+    /// dirty; moved rows keep their dirty state. O(1) for full-screen moves.
+    /// @param lines Number of lines to move (positive = up, negative = down)
+    /// @param top Top of region (inclusive)
+    /// @param bottom Bottom of region (exclusive)
+    void MoveRows(int lines, int top, int bottom);
+
+    /// Move a rect of cells up or down within its columns, without touching
+    /// scrollback: a scroll inside left/right margins (DECSLRM)
+    /// A full-width rect is MoveRows(). Otherwise each row's columns move in
+    /// one copy, taken in an order that never reads a row already written,
+    /// and only cells that changed are marked dirty, so the whole move is one
+    /// pass over the region however many lines it covers.
+    /// @param lines Number of lines to move (positive = up, negative = down)
+    /// @param top Top of region (inclusive)
+    /// @param bottom Bottom of region (exclusive)
+    /// @param left Left margin (inclusive)
+    /// @param right Right margin (exclusive)
+    /// @param fill Cell the exposed cells take
+    void MoveRect(int lines, int top, int bottom, int left, int right, const Cell& fill = {});
+
+    /// Get rows scrolled since the last ClearDirty()
+    [[nodiscard]] const PendingScroll& GetPendingScroll() const noexcept { return m_pendingScroll; }
+
     // ========================================================================
     // Scrollback Buffer
     // ========================================================================
 
     /// Get number of lines in scrollback
-    [[nodiscard]] size_t GetScrollbackSize() const noexcept;
+    /// After a width change, lines not re-wrapped yet count as one line.
+    /// A log view's file lines count from below its stored lines.
+    [[nodiscard]] size_t GetScrollbackSize() const;
 
     /// Get a line from scrollback (0 = most recent)
+    /// Older lines are decompressed on demand, and re-wrapped to the current
+    /// width after a resize: the pointer is valid until the next call that
+    /// reads or changes the scrollback.
     [[nodiscard]] const Row* GetScrollbackLine(size_t index) const;
 
-    /// Clear scrollback buffer
+    /// Get a scrollback line's identity, which stays with the line as more
+    /// are pushed (for caches of rendered lines)
+    /// @return The id, or 0 while the scrollback is being re-wrapped
+    [[nodiscard]] uint64_t GetScrollbackLineId(size_t index) const;
+
+    /// Get a count that changes whenever a line id may come to stand for
+    /// other content (lines popped back to the screen, cleared, re-wrapped)
+    [[nodiscard]] uint64_t GetScrollbackEpoch() const noexcept { return m_scrollbackEpoch; }
+
+    /// Get the absolute line number of screen row 0 (for selections)
+    /// Screen row r is line GetScreenLine() + r and scrollback line i is
+    /// GetScreenLine() - 1 - i; a line keeps its number as more are pushed,
+    /// within one GetScrollbackEpoch().
+    [[nodiscard]] uint64_t GetScreenLine() const noexcept { return m_scrollback.GetEndId(); }
+
+    /// Get the absolute line number of the oldest scrollback line
+    [[nodiscard]] uint64_t GetFirstLine() const { return GetScreenLine() - GetScrollbackSize(); }
+
+    /// Get the cells of an absolute line, in the scrollback or on the screen
+    /// @return The cells (valid until the buffer is next read or changed), or
+    ///         none if the line has left the scrollback or is below the screen
+    [[nodiscard]] std::span<const Cell> GetLine(uint64_t line) const;
+
+    /// Get a number that changes whenever an absolute line may come to hold
+    /// other cells, for caches keyed by line: the row's generation on the
+    /// screen, and one for all of the scrollback that changes with its
+    /// epoch. A line scrolling off the screen changes it once.
+    [[nodiscard]] uint64_t GetLineGeneration(uint64_t line) const noexcept {
+        const uint64_t screen = GetScreenLine();
+        return line >= screen && line - screen < static_cast<uint64_t>(m_rows)
+            ? GetRowGeneration(static_cast<int>(line - screen)) : m_scrollbackGeneration;
+    }
+
+    /// Add a line that scrolled off the emulator screen (becomes index 0)
+    /// The cells are copied (padded or cut to the width) into recycled
+    /// storage, so a full scrollback does not allocate per line.
+    /// @param continuation The line continues the previous one (soft wrap)
+    void PushScrollback(std::span<const Cell> cells, bool continuation = false);
+
+    /// Take the most recent line back out of the scrollback (an emulator
+    /// refilling its screen as it grows)
+    /// @param out Cells to fill (cells past the line's width are left alone)
+    /// @param continuation Receives the line's soft-wrap flag (optional)
+    /// @return False if the scrollback is empty
+    bool PopScrollback(std::span<Cell> out, bool* continuation = nullptr);
+
+    /// Re-wrap more of the scrollback to the current width (idle work)
+    /// @param lines Stored lines to process at most
+    /// @return true while lines remain
+    bool ReflowScrollback(size_t lines);
+
+    /// Clear scrollback buffer (a log view's file lines go as well)
     void ClearScrollback();
 
+    /// Show a log file's lines as the oldest scrollback, decoded at the
+    /// current width as they are read (log views, before anything is
+    /// stored); they count as the file's index reaches them
+    void AttachLog(std::shared_ptr<const LogFile> log);
+
+    /// Start the scrollback with another buffer's history and screen (a
+    /// duplicated session, before its output arrives): the history shares
+    /// the other's sealed blocks (ScrollbackStore::ShareFrom), the screen
+    /// rows in use are pushed after it, and line numbers, prompt marks and
+    /// the overview carry over
+    void ShareScrollback(const TerminalBuffer& source);
+
+    /// Get the log file attached (nullptr if none)
+    [[nodiscard]] const std::shared_ptr<const LogFile>& GetLog() const noexcept { return m_log; }
+
     /// Get maximum scrollback size
-    [[nodiscard]] size_t GetMaxScrollback() const noexcept { return m_maxScrollback; }
+    [[nodiscard]] size_t GetMaxScrollback() const noexcept { return m_scrollback.GetMaxLines(); }
 
     /// Set maximum scrollback size
     void SetMaxScrollback(size_t lines);
 
+    /// Set maximum scrollback size, trimming down to a lower one in
+    /// TrimScrollback() slices rather than now
+    void SetMaxScrollbackDeferred(size_t lines);
+
+    /// Trim more of the scrollback toward a lowered limit (idle work)
+    /// @param lines Stored lines to trim at most
+    /// @return true while lines remain
+    bool TrimScrollback(size_t lines);
+
+    /// Get how the scrollback is stored (hot rows vs compressed lines)
+    [[nodiscard]] ScrollbackStats GetScrollbackStats() const;
+
+    /// Get the memory the screens hold (both grids, with their per-row state)
+    [[nodiscard]] size_t GetScreenBytes() const noexcept;
+
+    /// Get the stored scrollback: lines as they scrolled off, before any
+    /// re-wrapping, with ids that survive resizes (for the search shadow)
+    [[nodiscard]] const ScrollbackStore& GetScrollbackStore() const noexcept { return m_scrollback; }
+
+    /// Stamp the lines completed since the last call with a time (nothing
+    /// unless TerminalBufferConfig::lineTimes, or on the alternate screen)
+    /// @param endLine Lines below it are complete (the cursor's line)
+    /// @param unixMs Milliseconds since the Unix epoch
+    void StampLines(uint64_t endLine, uint64_t unixMs);
+
+    /// Get the time a line was completed (nothing if it was not stamped)
+    [[nodiscard]] std::optional<uint64_t> GetLineTime(uint64_t line) const { return m_times.Get(line); }
+
+    /// Get the lines' completion times (for searches by time)
+    [[nodiscard]] const ScrollbackTimes& GetLineTimes() const noexcept { return m_times; }
+
+    /// Get the scrollback's block summaries (for the overview strip)
+    [[nodiscard]] const ScrollbackOverview& GetOverview() const noexcept { return m_overview; }
+
+    /// Mark the scrollback as in use (the view showing this buffer), so the
+    /// shared ScrollbackBudget evicts other sessions' history first
+    void TouchScrollback() const noexcept { m_scrollback.Touch(); }
+
+    /// Release what an idle buffer can do without: the scrollback is
+    /// compressed and spilled (ScrollbackStore::Hibernate) and scratch
+    /// storage freed; the screen is kept as is
+    void Hibernate();
+
+    /// Hibernate a slice at a time (idle work; see ScrollbackStore::HibernateSlice)
+    /// @return true while work remains
+    bool HibernateSlice(size_t lines);
+
+    // ========================================================================
+    // Prompt Marks
+    // ========================================================================
+
+    /// Record a shell integration mark
+    /// Marks come in screen order; one before marks already recorded means
+    /// the screen was redrawn from there, and drops those. Marks on lines
+    /// trimmed from the scrollback are dropped with them.
+    void AddPromptMark(const PromptMark& mark);
+
+    /// Find the nearest mark of a kind above or below a line
+    /// @param direction -1 for the last one above line, 1 for the first below it
+    /// @return The mark (valid until marks are added or dropped), or nullptr
+    [[nodiscard]] const PromptMark* FindPromptMark(uint64_t line, int direction,
+                                                   PromptMarkKind kind = PromptMarkKind::Prompt) const;
+
+    /// Find the output of the last command whose output starts at or above a line
+    /// @param start Receives the Output mark
+    /// @param end Receives where the output ends: the next Finished or
+    ///        Prompt mark, or past the screen while the command runs
+    /// @return false if no command output is marked
+    bool FindCommandOutput(uint64_t line, PromptMark& start, PromptMark& end) const;
+
+    /// Get the number of marks recorded
+    [[nodiscard]] size_t GetPromptMarkCount() const noexcept { return m_promptMarks.size(); }
+
+    /// Get the marks recorded, by line, oldest first (some may be on lines
+    /// already trimmed)
+    [[nodiscard]] const std::deque<PromptMark>& GetPromptMarks() const noexcept { return m_promptMarks; }
+
+    // ========================================================================
+    // Inline Images
+    // ========================================================================
+
+    static constexpr size_t kMaxImages = 256;  ///< Placements kept; the oldest go past this
+
+    /// Place an image whose id the image store reserved
+    /// Placements come in screen order, like marks; one at the cell of an
+    /// earlier one replaces it.
+    void AddImage(const ImagePlacement& placement);
+
+    /// Append the placements covering any of the lines [firstLine, endLine)
+    void FindImages(uint64_t firstLine, uint64_t endLine, std::vector<ImagePlacement>& placements) const;
+
+    /// Get the number of placements
+    [[nodiscard]] size_t GetImageCount() const noexcept { return m_images.size(); }
+
+    /// Get the store holding the placed images' pixels (shared with the
+    /// image decoder, which may outlive the buffer)
+    [[nodiscard]] const std::shared_ptr<ImageStore>& GetImageStore() const noexcept { return m_imageStore; }
+
+    // ========================================================================
+    // Soft Wrap
+    // ========================================================================
+
+    /// Mark a row as continuing the row above (wrapped there, not a new line)
+    void SetContinuation(int row, bool continuation);
+
+    /// Check if a row continues the row above
+    [[nodiscard]] bool IsContinuation(int row) const;
+
+    // ========================================================================
+    // Alternate Screen
+    // ========================================================================
+
+    /// Switch between the primary and the alternate screen (O(1))
+    /// The screen switched away from keeps its contents; the whole screen is
+    /// marked dirty for the renderer. Scrolling the alternate screen does
+    /// not touch scrollback.
+    /// @return false if the screen switched to lost its contents (it was
+    ///         resized while hidden) and must be refilled by the caller
+    bool SetAlternateScreen(bool active);
+
+    /// Check if the alternate screen is shown
+    [[nodiscard]] bool IsAlternateScreen() const noexcept { return m_alternate; }
+
     // ========================================================================
     // Dirty Tracking
     // ========================================================================
@@ -206,6 +455,10 @@ public:
     /// Mark a row as dirty (needs redraw)
     void MarkDirty(int row);
 
+    /// Mark columns [startCol, endCol) of a row as dirty
+    /// The row's dirty span grows to cover them.
+    void MarkDirty(int row, int startCol, int endCol);
+
     /// Mark a range of rows as dirty
     void MarkDirtyRange(int startRow, int endRow);
 
@@ -215,10 +468,34 @@ public:
     /// Check if a row is dirty
     [[nodiscard]] bool IsDirty(int row) const;
 
+    /// Get the columns of a row that changed (empty if the row is clean)
+    [[nodiscard]] DirtySpan GetDirtySpan(int row) const;
+
+    /// Find the first dirty row at or after a row
+    /// @return The row, or -1 if none
+    [[nodiscard]] int NextDirtyRow(int row) const noexcept;
+
+    /// Get the number of dirty rows
+    [[nodiscard]] size_t GetDirtyCount() const noexcept { return m_dirty.Count(); }
+
+    /// Get a number that changes whenever a row's cells may have changed
+    /// (it is marked dirty), for caches of what rows show. Generations are
+    /// never reused, and moving a row by scrolling keeps its generation.
+    [[nodiscard]] uint64_t GetRowGeneration(int row) const noexcept {
+        return m_rowGeneration[StorageRow(row)];
+    }
+
+    /// Get a row's style runs, covering its columns in order (valid until
+    /// the row is next marked dirty). Writers must mark the cells they
+    /// change dirty, which keeps the runs current.
+    [[nodiscard]] std::span<const StyleRun> GetStyleRuns(int row) const noexcept {
+        return m_styleRuns[StorageRow(row)];
+    }
+
     /// Get list of dirty rows
     [[nodiscard]] std::vector<int> GetDirtyRows() const;
 
-    /// Clear all dirty flags
+    /// Clear all dirty flags and the pending scroll
     void ClearDirty();
 
     /// Check if any rows are dirty
@@ -228,42 +505,164 @@ public:
     // Text Extraction
     // ========================================================================
 
+    /// Append the text of columns [startCol, endCol) of a line of cells
+    /// (a screen row or a scrollback line), wide characters whole
+    ///
+    /// Works on the row storage directly: stretches of plain cells (one
+    /// codepoint that encodes to a single unit, one column), nearly all of
+    /// any line, are copied in one tight loop; only wide, combined and
+    /// multi-unit cells take the per-character path.
+    /// @param trimRight Drop trailing blanks
+    static void AppendColumnText(std::string& out, std::span<const Cell> cells, int startCol, int endCol,
+                                 bool trimRight = true);
+
+    /// Append the text of columns [startCol, endCol) of a line as UTF-16
+    static void AppendColumnText(std::wstring& out, std::span<const Cell> cells, int startCol, int endCol,
+                                 bool trimRight = true);
+
     /// Get text content of a row as UTF-8
     [[nodiscard]] std::string GetRowText(int row) const;
 
-    /// Get text content of a rectangular region
+    /// Get the text from (startRow, startCol) to (endRow, endCol), as a
+    /// stream selection runs: the first row from startCol, the last up to
+    /// endCol, full rows between
     [[nodiscard]] std::string GetRegionText(int startRow, int startCol, 
                                              int endRow, int endCol) const;
 
+    /// Get the text of a rectangle: columns [startCol, endCol) of each of
+    /// rows [startRow, endRow]
+    [[nodiscard]] std::string GetBlockText(int startRow, int startCol,
+                                           int endRow, int endCol) const;
+
     /// Get all visible text
     [[nodiscard]] std::string GetAllText() const;
 
 private:
+    /// Map a screen row to its slot in the row ring
+    [[nodiscard]] size_t Slot(int row) const noexcept {
+        return (m_origin + static_cast<size_t>(row)) % static_cast<size_t>(m_rows);
+    }
+
+    /// Map a slot in the row ring back to its screen row
+    [[nodiscard]] int RowOfSlot(size_t slot) const noexcept {
+        return static_cast<int>((slot + static_cast<size_t>(m_rows) - m_origin) % static_cast<size_t>(m_rows));
+    }
+
+    /// Map a screen row to its row of cell storage (per-row state that moves
+    /// with the cells is indexed by this)
+    [[nodiscard]] size_t StorageRow(int row) const noexcept {
+        return m_rowOffset[Slot(row)] / static_cast<size_t>(m_cols);
+    }
+
+    /// Get a screen row's cells in the slab (row must be valid)
+    [[nodiscard]] std::span<Cell> RowCells(int row) noexcept {
+        return {m_cells.data() + m_rowOffset[Slot(row)], static_cast<size_t>(m_cols)};
+    }
+    [[nodiscard]] std::span<const Cell> RowCells(int row) const noexcept {
+        return {m_cells.data() + m_rowOffset[Slot(row)], static_cast<size_t>(m_cols)};
+    }
+
+    /// Resize() with an optional cursor to keep and overflow sink
+    void Reflow(int rows, int cols, bool pushOverflow, int* cursorRow, int* cursorCol,
+                const ResizeOverflowSink* overflow);
+
+    /// Rotate a region's rows by a number of lines, dirty and wrap flags included
+    /// Exposed rows keep stale contents; callers overwrite them.
+    void RotateRows(int lines, int top, int bottom);
+
+    /// Record a scroll for GetPendingScroll() (call before rotating)
+    void RecordScroll(int lines, int top, int bottom);
+
+    /// Rescan columns [startCol, endCol) of a row into its style runs
+    void UpdateStyleRuns(int row, int startCol, int endCol);
+
     /// Ensure row index is valid
     void ValidateRow(int row) const;
 
     /// Ensure column index is valid
     void ValidateCol(int col) const;
 
-    /// Create an empty row with default cells
-    [[nodiscard]] Row CreateEmptyRow() const;
+    /// Clear a row to default cells, as the start of a logical line
+    void ResetRow(int row);
+
+    /// Copy a screen row into scrollback (becomes index 0)
+    void PushScrollbackRow(int row);
 
-    /// Trim scrollback to max size
-    void TrimScrollback();
+    /// Push a line into the store and summarize it for the overview
+    void StoreScrollback(std::span<const Cell> cells, bool continuation);
+
+    /// Drop marks on lines no longer held
+    void TrimPromptMarks();
+
+    /// Drop placements whose lines are all no longer held, and their images
+    void TrimImages();
+
+    /// Drop the oldest placement and its image
+    void PopImage();
 
 private:
     int m_rows;
     int m_cols;
-    size_t m_maxScrollback;
-
-    // Main screen buffer
-    std::vector<Row> m_screen;
-
-    // Scrollback history (front = most recent)
-    std::deque<Row> m_scrollback;
 
-    // Dirty line tracking (one bit per row)
-    std::vector<bool> m_dirty;
+    // Main screen buffer: a rows * cols slab, and a ring of row offsets into
+    // it. Row r starts at m_cells[m_rowOffset[Slot(r)]].
+    std::vector<Cell> m_cells;
+    std::vector<size_t> m_rowOffset;
+    size_t m_origin = 0;
+
+    // Soft-wrap flag per ring slot (moves with rows)
+    std::vector<uint8_t> m_continuation;
+
+    // The screen not shown (primary or alternate), exchanged with the grid
+    // above on a switch
+    std::vector<Cell> m_hiddenCells;
+    std::vector<size_t> m_hiddenRowOffset;
+    size_t m_hiddenOrigin = 0;
+    std::vector<uint8_t> m_hiddenContinuation;
+    bool m_hiddenStale = false;         ///< Hidden screen was cleared by a resize
+    bool m_alternate = false;
+
+    // Scrollback history (index 0 = most recent), and its rows at the current
+    // width once the width has changed
+    ScrollbackStore m_scrollback;
+    mutable ScrollbackReflow m_reflow;
+    Row m_pushScratch;                  ///< Lines pushed at another width, fitted
+    uint64_t m_scrollbackEpoch = 0;     ///< See GetScrollbackEpoch()
+    uint64_t m_scrollbackGeneration = 0; ///< Generation of scrollback lines (see GetLineGeneration)
+    ScrollbackOverview m_overview;
+    ScrollbackTimes m_times;            ///< When lines were completed (StampLines)
+    bool m_lineTimes = false;
+    std::shared_ptr<const LogFile> m_log; ///< Lines older than the stored ones (AttachLog)
+
+    // Shell integration marks by (line, col), oldest first
+    std::deque<PromptMark> m_promptMarks;
+
+    // Inline image placements by (line, col), oldest first, and their pixels
+    std::deque<ImagePlacement> m_images;
+    std::shared_ptr<ImageStore> m_imageStore = std::make_shared<ImageStore>();
+
+    // Dirty line tracking (one bit and column span per ring slot, so both
+    // move with rows). A span is only meaningful while its bit is set.
+    DirtyBitmap m_dirty;
+    std::vector<DirtySpan> m_dirtySpan;
+
+    // Generation per row of cell storage (so it moves with the cells), and
+    // the last one handed out
+    std::vector<uint64_t> m_rowGeneration;
+    uint64_t m_generation = 0;
+
+    // Style runs per row of cell storage, and the list a row's are rebuilt
+    // in (exchanged with the row's, so neither allocates once grown)
+    std::vector<std::vector<StyleRun>> m_styleRuns;
+    std::vector<StyleRun> m_runScratch;
+
+    // Per row of cell storage: filled whole with one cell (see GetRowFill),
+    // until next marked dirty
+    std::vector<Cell> m_rowFill;
+    std::vector<uint8_t> m_rowFilled;
+
+    // Scroll not yet picked up by the renderer
+    PendingScroll m_pendingScroll;
 
     // Static empty cell for out-of-bounds access
     static const Cell s_emptyCell;
@@ -0,0 +1,246 @@
+// Console3 - TerminalSnapshot.cpp
+// Immutable screen snapshots handed from an emulation thread to the renderer
+
+#include "Core/TerminalSnapshot.h"
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+
+namespace Console3::Core {
+
+namespace {
+
+// Spare rows kept for the writer; about one screenful scrolled per frame
+constexpr size_t kMaxSpareRows = 1024;
+
+/// Move row references along with a scroll; exposed rows become null
+void RotateLines(std::vector<std::shared_ptr<const Row>>& lines, const PendingScroll& scroll) {
+    const int size = static_cast<int>(lines.size());
+    const int top = std::clamp(scroll.top, 0, size);
+    const int bottom = std::clamp(scroll.bottom, top, size);
+    const int count = std::min(std::abs(scroll.lines), bottom - top);
+    if (count == 0) {
+        return;
+    }
+
+    const auto first = lines.begin() + top;
+    const auto last = lines.begin() + bottom;
+    if (scroll.lines > 0) {
+        std::rotate(first, first + count, last);
+        std::fill(last - count, last, nullptr);
+    } else {
+        std::rotate(first, last - count, last);
+        std::fill(first, first + count, nullptr);
+    }
+}
+
+} // namespace
+
+void SnapshotExchange::Reset(size_t maxScrollback) {
+    m_latest.store(nullptr);
+    m_presented.store(0);
+
+    m_sequence = 0;
+    m_lines.clear();
+    m_spare.reset();
+    m_chunks.clear();
+    m_retired.clear();
+    m_spareRows.clear();
+    m_spareLines.clear();
+    m_chunkLines = 0;
+    m_maxScrollback = maxScrollback;
+    m_burstStart = 0;
+
+    m_readSequence = 0;
+    m_screenSequence = 0;
+    m_presentedLines.clear();
+}
+
+// ============================================================================
+// Writer
+// ============================================================================
+
+void SnapshotExchange::Publish(TerminalBuffer& screen, std::vector<ScrollbackLine>& scrollback,
+                               const std::wstring& title, bool fastForward, uint64_t burstStartMicros) {
+    const uint64_t presented = m_presented.load(std::memory_order_acquire);
+    const uint64_t sequence = ++m_sequence;
+
+    // Scrollback the reader already has is not carried any more
+    const auto firstPending = std::find_if(m_chunks.begin(), m_chunks.end(),
+        [presented](const ScrollbackChunk& chunk) { return chunk.sequence > presented; });
+    for (auto it = m_chunks.begin(); it != firstPending; ++it) {
+        m_chunkLines -= it->lines->size();
+    }
+    m_retired.insert(m_retired.end(), std::make_move_iterator(m_chunks.begin()),
+                     std::make_move_iterator(firstPending));
+    m_chunks.erase(m_chunks.begin(), firstPending);
+
+    if (!scrollback.empty()) {
+        m_chunkLines += scrollback.size();
+        // Created mutable so ReclaimRetired() may take the rows back
+        m_chunks.push_back({sequence, std::make_shared<std::vector<ScrollbackLine>>(std::move(scrollback))});
+        scrollback.swap(m_spareLines);
+        scrollback.clear();
+
+        // A reader this far behind would trim the oldest lines anyway
+        while (m_chunks.size() > 1 && m_chunkLines - m_chunks.front().lines->size() >= m_maxScrollback) {
+            m_chunkLines -= m_chunks.front().lines->size();
+            m_retired.push_back(std::move(m_chunks.front()));
+            m_chunks.erase(m_chunks.begin());
+        }
+    }
+
+    // Everything before this publish was presented: the burst starts over
+    if (presented + 1 == sequence || m_burstStart == 0) {
+        m_burstStart = burstStartMicros;
+    }
+
+    // Reuse the snapshot replaced last time if the reader let go of it
+    std::shared_ptr<TerminalSnapshot> snapshot;
+    if (m_spare && m_spare.use_count() == 1) {
+        snapshot = std::move(m_spare);
+    } else {
+        snapshot = std::make_shared<TerminalSnapshot>();
+    }
+
+    // Rows from the last publish move with the scroll; only dirty rows are
+    // copied (a resize marks every row dirty)
+    const int rows = screen.GetRows();
+    const PendingScroll& scroll = screen.GetPendingScroll();
+    if (m_lines.size() != static_cast<size_t>(rows)) {
+        m_lines.assign(static_cast<size_t>(rows), nullptr);
+    } else {
+        RotateLines(m_lines, scroll);
+    }
+
+    snapshot->dirty.assign((static_cast<size_t>(rows) + 63) / 64, 0);
+    snapshot->continuation.assign(snapshot->dirty.size(), 0);
+    for (int row = 0; row < rows; ++row) {
+        if (screen.IsContinuation(row)) {
+            snapshot->continuation[row / 64] |= uint64_t{1} << (row % 64);
+        }
+        if (!m_lines[row] || screen.IsDirty(row)) {
+            const std::span<const Cell> cells = std::as_const(screen).GetRow(row);
+            m_lines[row] = std::make_shared<const Row>(cells.begin(), cells.end());
+            snapshot->dirty[row / 64] |= uint64_t{1} << (row % 64);
+        }
+    }
+
+    snapshot->sequence = sequence;
+    snapshot->rows = rows;
+    snapshot->cols = screen.GetCols();
+    snapshot->lines = m_lines;
+    snapshot->scroll = scroll;
+    snapshot->scrollback = m_chunks;
+    ReclaimRetired();
+    snapshot->title = title;
+    snapshot->fastForward = fastForward;
+    snapshot->burstStartMicros = m_burstStart;
+
+    screen.ClearDirty();
+
+    // Only the writer ever creates snapshots, so dropping const is safe
+    m_spare = std::const_pointer_cast<TerminalSnapshot>(
+        m_latest.exchange(std::move(snapshot), std::memory_order_acq_rel));
+}
+
+Row SnapshotExchange::TakeSpareRow() {
+    if (m_spareRows.empty()) {
+        return {};
+    }
+    Row row = std::move(m_spareRows.back());
+    m_spareRows.pop_back();
+    return row;
+}
+
+void SnapshotExchange::ReleaseSpare() {
+    std::vector<Row>().swap(m_spareRows);
+    std::vector<ScrollbackLine>().swap(m_spareLines);
+}
+
+void SnapshotExchange::ReclaimRetired() {
+    // A retired chunk is in no new snapshot, so once the writer holds the
+    // only reference nobody else can reach it (as with m_spare)
+    const auto released = std::partition(m_retired.begin(), m_retired.end(),
+        [](const ScrollbackChunk& chunk) { return chunk.lines.use_count() > 1; });
+    if (released == m_retired.end()) {
+        return;
+    }
+
+    // Pairs with the reader's release of its last reference
+    std::atomic_thread_fence(std::memory_order_acquire);
+    for (auto it = released; it != m_retired.end(); ++it) {
+        auto& lines = const_cast<std::vector<ScrollbackLine>&>(*it->lines);
+        for (ScrollbackLine& line : lines) {
+            if (m_spareRows.size() >= kMaxSpareRows) {
+                break;
+            }
+            m_spareRows.push_back(std::move(line.cells));
+        }
+        if (lines.capacity() > m_spareLines.capacity()) {
+            lines.clear();
+            m_spareLines.swap(lines);
+        }
+    }
+    m_retired.erase(released, m_retired.end());
+}
+
+// ============================================================================
+// Reader
+// ============================================================================
+
+std::shared_ptr<const TerminalSnapshot> SnapshotExchange::Present(TerminalBuffer& buffer) {
+    std::shared_ptr<const TerminalSnapshot> snapshot = m_latest.load(std::memory_order_acquire);
+    if (!snapshot || snapshot->sequence == m_readSequence) {
+        return nullptr;
+    }
+
+    for (const ScrollbackChunk& chunk : snapshot->scrollback) {
+        if (chunk.sequence > m_readSequence) {
+            for (const ScrollbackLine& line : *chunk.lines) {
+                buffer.PushScrollback(line.cells, line.continuation);
+            }
+        }
+    }
+
+    // A snapshot taken before a resize only carries scrollback; the writer
+    // resends every row once it has resized too
+    if (snapshot->rows == buffer.GetRows() && snapshot->cols == buffer.GetCols()) {
+        // The bitmap and scroll describe the step from the previous snapshot
+        // only. Otherwise a row changed if it is not the row presented last.
+        bool follows = m_screenSequence != 0 && snapshot->sequence == m_screenSequence + 1;
+        if (m_presentedLines.size() != static_cast<size_t>(snapshot->rows)) {
+            m_presentedLines.assign(static_cast<size_t>(snapshot->rows), nullptr);
+            follows = false;
+        }
+        if (follows && snapshot->scroll.lines != 0) {
+            // Moves the buffer's own dirty flags along for the renderer
+            buffer.MoveRows(snapshot->scroll.lines, snapshot->scroll.top, snapshot->scroll.bottom);
+            RotateLines(m_presentedLines, snapshot->scroll);
+        }
+
+        for (int row = 0; row < snapshot->rows; ++row) {
+            buffer.SetContinuation(row, snapshot->IsContinuation(row));
+            const std::shared_ptr<const Row>& line = snapshot->lines[row];
+            if (follows ? snapshot->IsDirty(row) : line != m_presentedLines[row]) {
+                // Only the cells that differ from what the buffer shows are
+                // marked, so the renderer repaints just that part of the line
+                const std::span<Cell> cells = buffer.GetRow(row);
+                const CellChange change = FindChangedCells(cells, *line);
+                if (!change.IsEmpty()) {
+                    std::copy(line->begin() + change.start, line->begin() + change.end,
+                              cells.begin() + change.start);
+                    buffer.MarkDirty(row, static_cast<int>(change.start), static_cast<int>(change.end));
+                }
+                m_presentedLines[row] = line;
+            }
+        }
+        m_screenSequence = snapshot->sequence;
+    }
+
+    m_readSequence = snapshot->sequence;
+    m_presented.store(m_readSequence, std::memory_order_release);
+    return snapshot;
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,128 @@
+#pragma once
+// Console3 - TerminalSnapshot.h
+// Immutable screen snapshots handed from an emulation thread to the renderer
+//
+// Snapshot rows are immutable and shared between snapshots: publishing copies
+// only the rows the writer's buffer marked dirty, moves the previous
+// snapshot's rows along with any scroll, and swaps the new snapshot in
+// atomically with a bitmap of the rows that changed. The reader picks up
+// whatever is latest and copies only rows that are not the ones it already
+// has into the buffer it renders from. Neither side takes a lock or waits
+// for the other.
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Core/TerminalBuffer.h"
+
+namespace Console3::Core {
+
+/// A line pushed to scrollback
+struct ScrollbackLine {
+    Row cells;
+    bool continuation = false;                      ///< Continues the line before (soft wrap)
+};
+
+/// Lines pushed to scrollback by one publish
+struct ScrollbackChunk {
+    uint64_t sequence = 0;                          ///< Snapshot that first carried them
+    std::shared_ptr<const std::vector<ScrollbackLine>> lines;  ///< Oldest first
+};
+
+/// Screen state at one point, never modified once published
+struct TerminalSnapshot {
+    uint64_t sequence = 0;                          ///< 1 for the first publish, then +1
+    int rows = 0;
+    int cols = 0;
+    std::vector<std::shared_ptr<const Row>> lines;  ///< Screen rows (shared between snapshots)
+    std::vector<uint64_t> dirty;                    ///< Rows changed since sequence - 1 (bitmap)
+    std::vector<uint64_t> continuation;             ///< Rows continuing the row above (bitmap)
+    PendingScroll scroll;                           ///< Scroll since sequence - 1, before the dirty rows
+    std::vector<ScrollbackChunk> scrollback;        ///< Lines the reader has not presented yet
+    std::wstring title;
+    bool fastForward = false;
+    uint64_t burstStartMicros = 0;                  ///< Oldest output not yet presented (telemetry)
+
+    /// Check if a row changed since the previous snapshot
+    [[nodiscard]] bool IsDirty(int row) const noexcept {
+        return (dirty[static_cast<size_t>(row) / 64] >> (row % 64)) & 1;
+    }
+
+    /// Check if a row continues the row above (soft wrap)
+    [[nodiscard]] bool IsContinuation(int row) const noexcept {
+        return (continuation[static_cast<size_t>(row) / 64] >> (row % 64)) & 1;
+    }
+};
+
+/// Single-writer, single-reader exchange of terminal snapshots
+class SnapshotExchange {
+public:
+    SnapshotExchange() = default;
+
+    // Non-copyable, non-movable
+    SnapshotExchange(const SnapshotExchange&) = delete;
+    SnapshotExchange& operator=(const SnapshotExchange&) = delete;
+    SnapshotExchange(SnapshotExchange&&) = delete;
+    SnapshotExchange& operator=(SnapshotExchange&&) = delete;
+
+    /// Forget all snapshots (call while neither side is running)
+    /// @param maxScrollback Lines kept for a reader that falls behind
+    void Reset(size_t maxScrollback);
+
+    // ========================================================================
+    // Writer
+    // ========================================================================
+
+    /// Publish the screen and clear its dirty state
+    /// @param screen Writer's buffer (only its dirty rows are copied)
+    /// @param scrollback Lines pushed since the last publish (moved from)
+    void Publish(TerminalBuffer& screen, std::vector<ScrollbackLine>& scrollback, const std::wstring& title,
+                 bool fastForward, uint64_t burstStartMicros);
+
+    /// Get storage for a scrollback line, recycled from lines the reader has
+    /// presented once no snapshot refers to them (empty if there are none)
+    [[nodiscard]] Row TakeSpareRow();
+
+    /// Free the recycled storage (writer thread; for a hibernating session)
+    void ReleaseSpare();
+
+    // ========================================================================
+    // Reader
+    // ========================================================================
+
+    /// Bring a buffer up to date with the latest snapshot
+    /// Only changed rows are copied. When the reader skipped snapshots they
+    /// are found by row identity instead of the dirty bitmap. A snapshot of
+    /// another size only delivers its scrollback.
+    /// @return The snapshot presented, or nullptr if nothing new was published
+    std::shared_ptr<const TerminalSnapshot> Present(TerminalBuffer& buffer);
+
+private:
+    /// Recycle the storage of retired chunks no snapshot refers to any more
+    void ReclaimRetired();
+
+    std::atomic<std::shared_ptr<const TerminalSnapshot>> m_latest;
+    std::atomic<uint64_t> m_presented{0};           ///< Latest sequence the reader took
+
+    // Writer state
+    uint64_t m_sequence = 0;
+    std::vector<std::shared_ptr<const Row>> m_lines; ///< Rows of the last publish
+    std::shared_ptr<TerminalSnapshot> m_spare;      ///< Replaced snapshot, reused once released
+    std::vector<ScrollbackChunk> m_chunks;          ///< Not yet presented, oldest first
+    std::vector<ScrollbackChunk> m_retired;         ///< Presented, storage reclaimed once released
+    std::vector<Row> m_spareRows;                   ///< Storage from reclaimed lines
+    std::vector<ScrollbackLine> m_spareLines;       ///< A reclaimed (empty) line vector
+    size_t m_chunkLines = 0;
+    size_t m_maxScrollback = 0;
+    uint64_t m_burstStart = 0;
+
+    // Reader state
+    uint64_t m_readSequence = 0;                    ///< Last snapshot presented
+    uint64_t m_screenSequence = 0;                  ///< Last snapshot whose rows were copied
+    std::vector<std::shared_ptr<const Row>> m_presentedLines; ///< Rows the buffer holds copies of
+};
+
+} // namespace Console3::Core
@@ -0,0 +1,35 @@
+// Console3 - ThreadPolicy.cpp
+// Scheduling classes for Console3's own threads
+
+#include "Core/ThreadPolicy.h"
+#include "Core/SessionScheduler.h"
+#include <avrt.h>
+
+namespace Console3::Core {
+
+bool ThreadPolicy::SetQos(HANDLE thread, ThreadQos qos) noexcept {
+    // Execution speed controlled and set is EcoQoS, controlled and clear is
+    // HighQoS, not controlled leaves it to the system
+    THREAD_POWER_THROTTLING_STATE state{};
+    state.Version = THREAD_POWER_THROTTLING_CURRENT_VERSION;
+    state.ControlMask = qos == ThreadQos::Default ? 0 : THREAD_POWER_THROTTLING_EXECUTION_SPEED;
+    state.StateMask = qos == ThreadQos::Eco ? THREAD_POWER_THROTTLING_EXECUTION_SPEED : 0;
+    return SetThreadInformation(thread, ThreadPowerThrottling, &state, sizeof(state)) != FALSE;
+}
+
+ThreadQos ThreadPolicy::ForSession(SessionPriority priority) noexcept {
+    return priority == SessionPriority::Background ? ThreadQos::Eco : ThreadQos::Default;
+}
+
+HANDLE ThreadPolicy::JoinMmcss() noexcept {
+    DWORD taskIndex = 0;
+    return AvSetMmThreadCharacteristicsW(L"Games", &taskIndex);
+}
+
+void ThreadPolicy::LeaveMmcss(HANDLE registration) noexcept {
+    if (registration) {
+        AvRevertMmThreadCharacteristics(registration);
+    }
+}
+
+} // namespace Console3::Core
@@ -0,0 +1,68 @@
+#pragma once
+// Console3 - ThreadPolicy.h
+// Scheduling classes for Console3's own threads
+//
+// Left alone, every thread runs at the system's default QoS: a hidden tab
+// parsing a build log gets the same performance core and clock as the frame
+// of the window being typed in. Threads are classed by what they are doing
+// for the user:
+//
+//   High    - the UI thread while Console3 is the foreground app, and the
+//             foreground window's render thread, which also joins MMCSS
+//             (the "Games" task) while it presents, so a frame is not
+//             queued behind background work.
+//   Default - the focused and visible sessions' reader and parser threads:
+//             the system decides, as it always did.
+//   Eco     - background (minimized) sessions' readers and parsing, and the
+//             session snapshot writer, which compresses history: power
+//             throttled (EcoQoS), so hybrid CPUs run them on efficiency
+//             cores at lower clocks.
+//
+// Shared threads follow their work: a scheduler worker takes the class of
+// the session whose slice it runs. The completion port pool serves every
+// session at once and keeps the default. Systems without the setting
+// (before Windows 10 1709) ignore it.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+#include <cstdint>
+
+namespace Console3::Core {
+
+enum class SessionPriority : uint8_t;
+
+/// How the system schedules a thread (see file comment)
+enum class ThreadQos : uint8_t {
+    Eco,        ///< Power throttled: efficiency cores, lower clocks
+    Default,    ///< The system's choice
+    High        ///< Never throttled
+};
+
+/// Thread scheduling classes (see file comment)
+class ThreadPolicy {
+public:
+    /// Set a thread's QoS (a handle with THREAD_SET_INFORMATION access)
+    /// @return false if the system does not support it
+    static bool SetQos(HANDLE thread, ThreadQos qos) noexcept;
+
+    /// Set the calling thread's QoS
+    static bool SetCurrentQos(ThreadQos qos) noexcept { return SetQos(GetCurrentThread(), qos); }
+
+    /// Get the QoS a session's reader and parser run at
+    [[nodiscard]] static ThreadQos ForSession(SessionPriority priority) noexcept;
+
+    /// Join the calling thread to MMCSS's "Games" task
+    /// @return The registration for LeaveMmcss(), or nullptr if it failed
+    [[nodiscard]] static HANDLE JoinMmcss() noexcept;
+
+    /// Take the calling thread back out of MMCSS
+    static void LeaveMmcss(HANDLE registration) noexcept;
+};
+
+} // namespace Console3::Core
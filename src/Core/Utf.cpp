@@ -0,0 +1,378 @@
+// Console3 - Utf.cpp
+// UTF-8, UTF-16 and UTF-32 conversion shared by every part of the program
+
+#include "Core/Utf.h"
+
+#include <bit>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define CONSOLE3_UTF_SSE2 1
+#endif
+
+namespace Console3::Core {
+
+namespace {
+
+/// Count the ASCII bytes text starts with
+[[nodiscard]] size_t AsciiPrefix(const char* text, size_t size) noexcept {
+    size_t at = 0;
+#ifdef CONSOLE3_UTF_SSE2
+    for (; size - at >= 16; at += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + at));
+        const auto high = static_cast<uint32_t>(_mm_movemask_epi8(bytes));
+        if (high != 0) {
+            return at + static_cast<size_t>(std::countr_zero(high));
+        }
+    }
+#endif
+    while (at < size && static_cast<unsigned char>(text[at]) < 0x80) {
+        ++at;
+    }
+    return at;
+}
+
+/// Count the units below U+0080 UTF-16 text starts with
+template <typename Unit>
+[[nodiscard]] size_t AsciiPrefix(const Unit* text, size_t size) noexcept {
+    size_t at = 0;
+#ifdef CONSOLE3_UTF_SSE2
+    if constexpr (sizeof(Unit) == 2) {
+        const __m128i high = _mm_set1_epi16(static_cast<short>(0xFF80));
+        const __m128i zero = _mm_setzero_si128();
+        for (; size - at >= 8; at += 8) {
+            const __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + at));
+            const auto ascii = static_cast<uint32_t>(
+                _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(units, high), zero)));
+            if (ascii != 0xFFFF) {
+                return at + static_cast<size_t>(std::countr_zero(~ascii)) / 2;
+            }
+        }
+    }
+#endif
+    while (at < size && static_cast<uint32_t>(text[at]) < 0x80) {
+        ++at;
+    }
+    return at;
+}
+
+/// Copy ASCII bytes to UTF-16 units
+template <typename Unit>
+void WidenAscii(const char* in, size_t count, Unit* out) noexcept {
+    size_t at = 0;
+#ifdef CONSOLE3_UTF_SSE2
+    if constexpr (sizeof(Unit) == 2) {
+        const __m128i zero = _mm_setzero_si128();
+        for (; count - at >= 16; at += 16) {
+            const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + at));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + at), _mm_unpacklo_epi8(bytes, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + at + 8), _mm_unpackhi_epi8(bytes, zero));
+        }
+    }
+#endif
+    for (; at < count; ++at) {
+        out[at] = static_cast<Unit>(in[at]);
+    }
+}
+
+/// Copy UTF-16 units below U+0080 to bytes
+template <typename Unit>
+void NarrowAscii(const Unit* in, size_t count, char* out) noexcept {
+    size_t at = 0;
+#ifdef CONSOLE3_UTF_SSE2
+    if constexpr (sizeof(Unit) == 2) {
+        // Every unit fits a byte, so the saturating pack is exact
+        for (; count - at >= 16; at += 16) {
+            const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + at));
+            const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + at + 8));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + at), _mm_packus_epi16(low, high));
+        }
+    }
+#endif
+    for (; at < count; ++at) {
+        out[at] = static_cast<char>(in[at]);
+    }
+}
+
+/// Replace what is not a Unicode scalar value
+[[nodiscard]] constexpr uint32_t Scalar(uint32_t codepoint) noexcept {
+    return codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF) ? kReplacementCharacter
+                                                                                 : codepoint;
+}
+
+/// Get the bytes a scalar value takes in UTF-8
+[[nodiscard]] constexpr size_t Utf8Units(uint32_t codepoint) noexcept {
+    return codepoint < 0x80 ? 1 : codepoint < 0x800 ? 2 : codepoint < 0x10000 ? 3 : 4;
+}
+
+/// Decode the UTF-8 sequence text starts with (Unicode table 3-7)
+/// @param length Set to the bytes it takes; for a malformed sequence, its
+/// maximal valid prefix (at least 1), which becomes one U+FFFD
+[[nodiscard]] uint32_t DecodeUtf8(const char* text, size_t size, size_t& length) noexcept {
+    const auto lead = static_cast<unsigned char>(text[0]);
+    length = 1;
+    if (lead < 0x80) {
+        return lead;
+    }
+
+    size_t trail = 0;
+    uint32_t codepoint = 0;
+    unsigned char lo = 0x80;        // Allowed range of the second byte
+    unsigned char hi = 0xBF;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        trail = 1;
+        codepoint = lead & 0x1F;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        trail = 2;
+        codepoint = lead & 0x0F;
+        if (lead == 0xE0) lo = 0xA0;        // Overlong
+        if (lead == 0xED) hi = 0x9F;        // Surrogates
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        trail = 3;
+        codepoint = lead & 0x07;
+        if (lead == 0xF0) lo = 0x90;        // Overlong
+        if (lead == 0xF4) hi = 0x8F;        // Beyond U+10FFFF
+    } else {
+        return kReplacementCharacter;
+    }
+
+    for (size_t index = 1; index <= trail; ++index) {
+        if (index >= size) {
+            return kReplacementCharacter;
+        }
+        const auto byte = static_cast<unsigned char>(text[index]);
+        if (byte < lo || byte > hi) {
+            return kReplacementCharacter;
+        }
+        lo = 0x80;
+        hi = 0xBF;
+        codepoint = (codepoint << 6) | (byte & 0x3F);
+        length = index + 1;
+    }
+    return codepoint;
+}
+
+/// Decode the codepoint UTF-16 text starts with
+/// @param length Set to the units it takes (a lone surrogate is one U+FFFD)
+template <typename Unit>
+[[nodiscard]] uint32_t DecodeUtf16(const Unit* text, size_t size, size_t& length) noexcept {
+    const auto unit = static_cast<uint32_t>(text[0]);
+    length = 1;
+    if (unit < 0xD800 || unit > 0xDFFF) {
+        return Scalar(unit);
+    }
+    if (unit <= 0xDBFF && size > 1) {
+        const auto low = static_cast<uint32_t>(text[1]);
+        if (low >= 0xDC00 && low <= 0xDFFF) {
+            length = 2;
+            return 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+        }
+    }
+    return kReplacementCharacter;
+}
+
+template <typename Unit>
+size_t PutUnits(uint32_t codepoint, Unit* out) noexcept {
+    codepoint = Scalar(codepoint);
+    if (codepoint < 0x10000) {
+        out[0] = static_cast<Unit>(codepoint);
+        return 1;
+    }
+    codepoint -= 0x10000;
+    out[0] = static_cast<Unit>(0xD800 | (codepoint >> 10));
+    out[1] = static_cast<Unit>(0xDC00 | (codepoint & 0x3FF));
+    return 2;
+}
+
+template <typename Unit>
+size_t Utf8LengthOf(const Unit* text, size_t size) noexcept {
+    size_t bytes = 0;
+    size_t at = 0;
+    while (at < size) {
+        if (static_cast<uint32_t>(text[at]) < 0x80) {
+            const size_t ascii = AsciiPrefix(text + at, size - at);
+            bytes += ascii;
+            at += ascii;
+            continue;
+        }
+        size_t length = 0;
+        bytes += Utf8Units(DecodeUtf16(text + at, size - at, length));
+        at += length;
+    }
+    return bytes;
+}
+
+template <typename Unit>
+size_t ToUtf16Units(std::string_view utf8, Unit* out) noexcept {
+    const char* text = utf8.data();
+    const size_t size = utf8.size();
+    Unit* const start = out;
+    size_t at = 0;
+    while (at < size) {
+        if (static_cast<unsigned char>(text[at]) < 0x80) {
+            const size_t ascii = AsciiPrefix(text + at, size - at);
+            WidenAscii(text + at, ascii, out);
+            out += ascii;
+            at += ascii;
+            continue;
+        }
+        size_t length = 0;
+        out += PutUnits(DecodeUtf8(text + at, size - at, length), out);
+        at += length;
+    }
+    return static_cast<size_t>(out - start);
+}
+
+template <typename Unit>
+size_t FromUtf16Units(const Unit* text, size_t size, char* out) noexcept {
+    char* const start = out;
+    size_t at = 0;
+    while (at < size) {
+        if (static_cast<uint32_t>(text[at]) < 0x80) {
+            const size_t ascii = AsciiPrefix(text + at, size - at);
+            NarrowAscii(text + at, ascii, out);
+            out += ascii;
+            at += ascii;
+            continue;
+        }
+        size_t length = 0;
+        out += PutUtf8(DecodeUtf16(text + at, size - at, length), out);
+        at += length;
+    }
+    return static_cast<size_t>(out - start);
+}
+
+} // namespace
+
+size_t PutUtf16(uint32_t codepoint, wchar_t* out) noexcept {
+    return PutUnits(codepoint, out);
+}
+
+size_t PutUtf8(uint32_t codepoint, char* out) noexcept {
+    codepoint = Scalar(codepoint);
+    if (codepoint < 0x80) {
+        out[0] = static_cast<char>(codepoint);
+        return 1;
+    }
+    if (codepoint < 0x800) {
+        out[0] = static_cast<char>(0xC0 | (codepoint >> 6));
+        out[1] = static_cast<char>(0x80 | (codepoint & 0x3F));
+        return 2;
+    }
+    if (codepoint < 0x10000) {
+        out[0] = static_cast<char>(0xE0 | (codepoint >> 12));
+        out[1] = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        out[2] = static_cast<char>(0x80 | (codepoint & 0x3F));
+        return 3;
+    }
+    out[0] = static_cast<char>(0xF0 | (codepoint >> 18));
+    out[1] = static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+    out[2] = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+    out[3] = static_cast<char>(0x80 | (codepoint & 0x3F));
+    return 4;
+}
+
+size_t Utf16Length(std::string_view utf8) noexcept {
+    const char* text = utf8.data();
+    const size_t size = utf8.size();
+    size_t units = 0;
+    size_t at = 0;
+    while (at < size) {
+        if (static_cast<unsigned char>(text[at]) < 0x80) {
+            const size_t ascii = AsciiPrefix(text + at, size - at);
+            units += ascii;
+            at += ascii;
+            continue;
+        }
+        size_t length = 0;
+        units += DecodeUtf8(text + at, size - at, length) < 0x10000 ? 1 : 2;
+        at += length;
+    }
+    return units;
+}
+
+size_t Utf16Length(std::span<const uint32_t> utf32) noexcept {
+    size_t units = utf32.size();
+    for (const uint32_t codepoint : utf32) {
+        units += Scalar(codepoint) >= 0x10000 ? 1 : 0;
+    }
+    return units;
+}
+
+size_t Utf8Length(std::wstring_view utf16) noexcept {
+    return Utf8LengthOf(utf16.data(), utf16.size());
+}
+
+size_t Utf8Length(std::span<const uint32_t> utf32) noexcept {
+    size_t bytes = 0;
+    for (const uint32_t codepoint : utf32) {
+        bytes += Utf8Units(Scalar(codepoint));
+    }
+    return bytes;
+}
+
+size_t Utf8ToUtf16(std::string_view utf8, wchar_t* out) noexcept {
+    return ToUtf16Units(utf8, out);
+}
+
+size_t Utf16ToUtf8(std::wstring_view utf16, char* out) noexcept {
+    return FromUtf16Units(utf16.data(), utf16.size(), out);
+}
+
+size_t Utf32ToUtf16(std::span<const uint32_t> utf32, wchar_t* out) noexcept {
+    wchar_t* const start = out;
+    for (const uint32_t codepoint : utf32) {
+        out += PutUnits(codepoint, out);
+    }
+    return static_cast<size_t>(out - start);
+}
+
+size_t Utf32ToUtf8(std::span<const uint32_t> utf32, char* out) noexcept {
+    char* const start = out;
+    for (const uint32_t codepoint : utf32) {
+        if (codepoint < 0x80) {
+            *out++ = static_cast<char>(codepoint);
+        } else {
+            out += PutUtf8(codepoint, out);
+        }
+    }
+    return static_cast<size_t>(out - start);
+}
+
+void AppendUtf16(std::wstring& out, std::string_view utf8) {
+    const size_t at = out.size();
+    out.resize(at + Utf16Length(utf8));
+    Utf8ToUtf16(utf8, out.data() + at);
+}
+
+void AppendUtf16(std::wstring& out, std::span<const uint32_t> utf32) {
+    const size_t at = out.size();
+    out.resize(at + Utf16Length(utf32));
+    Utf32ToUtf16(utf32, out.data() + at);
+}
+
+void AppendUtf8(std::string& out, std::wstring_view utf16) {
+    const size_t at = out.size();
+    out.resize(at + Utf8Length(utf16));
+    Utf16ToUtf8(utf16, out.data() + at);
+}
+
+void AppendUtf8(std::string& out, std::span<const uint32_t> utf32) {
+    const size_t at = out.size();
+    out.resize(at + Utf8Length(utf32));
+    Utf32ToUtf8(utf32, out.data() + at);
+}
+
+std::wstring ToUtf16(std::string_view utf8) {
+    std::wstring out;
+    AppendUtf16(out, utf8);
+    return out;
+}
+
+std::string ToUtf8(std::wstring_view utf16) {
+    std::string out;
+    AppendUtf8(out, utf16);
+    return out;
+}
+
+} // namespace Console3::Core
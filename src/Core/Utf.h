@@ -0,0 +1,68 @@
+#pragma once
+// Console3 - Utf.h
+// UTF-8, UTF-16 and UTF-32 conversion shared by every part of the program
+//
+// Text changes encoding at many seams: settings and caches are UTF-8 JSON,
+// Win32 and DirectWrite want UTF-16, the screen holds UTF-32 codepoints,
+// and the pseudoconsole reads UTF-8. Each seam used to carry its own
+// two-call WideCharToMultiByte/MultiByteToWideChar wrapper or hand-rolled
+// surrogate arithmetic. These functions replace them all.
+//
+// Most of the text is ASCII (paths, settings, shell output), so every
+// conversion first copies the ASCII stretch it starts with 16 bytes at a
+// time (SSE2) and only decodes the rest codepoint by codepoint. The
+// lengths functions give the exact output size without writing anything,
+// so callers convert straight into a buffer of their own - a string sized
+// once, a stack array, a clipboard allocation - instead of sizing and
+// converting in two passes through Win32.
+//
+// Invalid input never fails: a malformed UTF-8 sequence (its maximal
+// valid prefix, as MultiByteToWideChar does), a lone surrogate or a value
+// past U+10FFFF becomes U+FFFD, and the length functions count it the
+// same way.
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace Console3::Core {
+
+/// The replacement character invalid input becomes
+constexpr uint32_t kReplacementCharacter = 0xFFFD;
+
+/// Encode one codepoint as UTF-16
+/// @param out Room for 2 units
+/// @return Units written (1 or 2)
+size_t PutUtf16(uint32_t codepoint, wchar_t* out) noexcept;
+
+/// Encode one codepoint as UTF-8
+/// @param out Room for 4 bytes
+/// @return Bytes written (1 to 4)
+size_t PutUtf8(uint32_t codepoint, char* out) noexcept;
+
+/// Get the exact units the conversions below write
+[[nodiscard]] size_t Utf16Length(std::string_view utf8) noexcept;
+[[nodiscard]] size_t Utf16Length(std::span<const uint32_t> utf32) noexcept;
+[[nodiscard]] size_t Utf8Length(std::wstring_view utf16) noexcept;
+[[nodiscard]] size_t Utf8Length(std::span<const uint32_t> utf32) noexcept;
+
+/// Convert into a buffer with room for at least the exact length
+/// @return Units written
+size_t Utf8ToUtf16(std::string_view utf8, wchar_t* out) noexcept;
+size_t Utf16ToUtf8(std::wstring_view utf16, char* out) noexcept;
+size_t Utf32ToUtf16(std::span<const uint32_t> utf32, wchar_t* out) noexcept;
+size_t Utf32ToUtf8(std::span<const uint32_t> utf32, char* out) noexcept;
+
+/// Append to a string, growing it once
+void AppendUtf16(std::wstring& out, std::string_view utf8);
+void AppendUtf16(std::wstring& out, std::span<const uint32_t> utf32);
+void AppendUtf8(std::string& out, std::wstring_view utf16);
+void AppendUtf8(std::string& out, std::span<const uint32_t> utf32);
+
+/// Convert to a new string
+[[nodiscard]] std::wstring ToUtf16(std::string_view utf8);
+[[nodiscard]] std::string ToUtf8(std::wstring_view utf16);
+
+} // namespace Console3::Core
@@ -0,0 +1,70 @@
+#pragma once
+// Console3 - Varint.h
+// Variable-length integers for the binary formats
+//
+// LEB128: seven bits per byte, low bits first, the high bit set on every
+// byte but the last, so values below 128 take one byte. Recordings
+// (PtyRecording), screen deltas, render captures, parser checkpoints,
+// session snapshots, scrollback lines and their time blocks all write
+// their numbers this way; signed values go through ZigZag first so small
+// negative ones stay short too.
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace Console3::Core {
+
+/// Append a varint to a byte buffer (std::string, std::vector<char or uint8_t>)
+template <typename Buffer>
+void PutVarint(Buffer& out, uint64_t value) {
+    using Byte = typename Buffer::value_type;
+    while (value >= 0x80) {
+        out.push_back(static_cast<Byte>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<Byte>(value));
+}
+
+/// Read a varint
+/// @param pos Where it starts; advanced past it
+/// @return false if it runs past the end or beyond 64 bits
+[[nodiscard]] inline bool GetVarint(std::string_view in, size_t& pos, uint64_t& value) noexcept {
+    value = 0;
+    for (int shift = 0; shift < 64 && pos < in.size(); shift += 7) {
+        const auto byte = static_cast<uint8_t>(in[pos++]);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Read a varint from bytes known to hold all of it (a buffer this process
+/// wrote), advancing past it
+template <typename Byte>
+[[nodiscard]] uint64_t GetVarint(const Byte*& bytes) noexcept {
+    static_assert(sizeof(Byte) == 1);
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        const auto byte = static_cast<uint8_t>(*bytes++);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+    }
+    return value;
+}
+
+/// Map a signed value to an unsigned one, small magnitudes to small values
+[[nodiscard]] constexpr uint64_t ZigZagEncode(int64_t value) noexcept {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+/// Undo ZigZagEncode
+[[nodiscard]] constexpr int64_t ZigZagDecode(uint64_t value) noexcept {
+    return static_cast<int64_t>((value >> 1) ^ (0 - (value & 1)));
+}
+
+} // namespace Console3::Core
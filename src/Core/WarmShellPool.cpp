@@ -0,0 +1,315 @@
+// Console3 - WarmShellPool.cpp
+// Shells started ahead of time, handed to new tabs
+
+#include "Core/WarmShellPool.h"
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+namespace Console3::Core {
+
+namespace {
+
+/// How often the refill thread looks at memory and exited shells when idle
+constexpr auto kRecheckInterval = std::chrono::seconds(30);
+
+/// Identify a profile by what makes its shells interchangeable
+std::wstring ProfileKey(const PtyConfig& config) {
+    std::wstring key = config.shell;
+    key += L'\n';
+    key += config.args;
+    key += L'\n';
+    key += config.workingDir;
+    key += L'\n';
+    key += std::to_wstring(static_cast<int>(config.transport));
+    key += L'\n';
+    key += std::to_wstring(config.maxReadSize);
+    key += config.wslRelay ? L"\nrelay" : L"";
+    return key;
+}
+
+} // namespace
+
+// ============================================================================
+// WarmShellHooks
+// ============================================================================
+
+void WarmShellHooks::OnData() {
+    std::function<void()> callback;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (!m_onData) {
+            m_dataPending = true;
+            return;
+        }
+        callback = m_onData;
+    }
+    callback();
+}
+
+void WarmShellHooks::OnExit(DWORD exitCode) {
+    ExitCallback callback;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (!m_onExit) {
+            m_exited = true;
+            m_exitCode = exitCode;
+            return;
+        }
+        callback = m_onExit;
+    }
+    callback(exitCode);
+}
+
+void WarmShellHooks::SetDataCallback(std::function<void()> callback) {
+    bool pending = false;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_onData = callback;
+        pending = std::exchange(m_dataPending, false);
+    }
+    // The ring only reports the first write after it was drained, and
+    // nobody has drained it yet
+    if (pending && callback) {
+        callback();
+    }
+}
+
+void WarmShellHooks::SetExitCallback(ExitCallback callback) {
+    bool exited = false;
+    DWORD exitCode = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_onExit = callback;
+        exited = std::exchange(m_exited, false);
+        exitCode = m_exitCode;
+    }
+    if (exited && callback) {
+        callback(exitCode);
+    }
+}
+
+bool WarmShellHooks::HasExited() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_exited;
+}
+
+// ============================================================================
+// WarmShellPool
+// ============================================================================
+
+WarmShellPool::~WarmShellPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    Clear();
+}
+
+WarmShellPool& WarmShellPool::Shared() {
+    static WarmShellPool s_instance;
+    return s_instance;
+}
+
+void WarmShellPool::Configure(size_t perProfile, size_t minFreeMB) {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_perProfile = perProfile;
+        m_minFreeBytes = static_cast<uint64_t>(minFreeMB) * 1024 * 1024;
+        if (m_perProfile > 0 && !m_thread.joinable() && !m_stop) {
+            m_thread = std::thread([this]() { ThreadProc(); });
+        }
+    }
+    // The refill thread trims or tops up to the new size
+    m_wake.notify_all();
+}
+
+bool WarmShellPool::IsEnabled() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_perProfile > 0;
+}
+
+WarmShell WarmShellPool::Take(const PtyConfig& config, size_t outputBufferSize) {
+    const std::wstring key = ProfileKey(config);
+    WarmShell taken;
+    std::vector<WarmShell> retired;
+    {
+        // Uses are counted while the pool is off too, so the first shells
+        // it starts are for the profiles already in use
+        std::lock_guard<std::mutex> lock(m_lock);
+        auto it = std::find_if(m_profiles.begin(), m_profiles.end(),
+                               [&](const Profile& profile) { return profile.key == key; });
+        if (it == m_profiles.end()) {
+            Profile profile;
+            profile.key = key;
+            profile.config = config;
+            profile.config.recorder.reset();
+            profile.config.latencyProbe = nullptr;
+            profile.outputBufferSize = outputBufferSize;
+            m_profiles.push_back(std::move(profile));
+            it = std::prev(m_profiles.end());
+        }
+        ++it->uses;
+        it->config.cols = config.cols;
+        it->config.rows = config.rows;
+
+        while (!it->ready.empty()) {
+            WarmShell shell = std::move(it->ready.front());
+            it->ready.pop_front();
+            if (shell.hooks->HasExited()) {
+                retired.push_back(std::move(shell));
+                continue;
+            }
+            taken = std::move(shell);
+            break;
+        }
+    }
+    m_wake.notify_all();
+
+    // Stopping a shell waits for its transport; not with the lock held
+    retired.clear();
+    return taken;
+}
+
+void WarmShellPool::Clear() {
+    std::vector<WarmShell> retired;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        for (auto& profile : m_profiles) {
+            for (auto& shell : profile.ready) {
+                retired.push_back(std::move(shell));
+            }
+            profile.ready.clear();
+        }
+    }
+    retired.clear();
+}
+
+size_t WarmShellPool::GetReadyCount() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    size_t count = 0;
+    for (const auto& profile : m_profiles) {
+        count += profile.ready.size();
+    }
+    return count;
+}
+
+WarmShell WarmShellPool::Spawn(const PtyConfig& config, size_t outputBufferSize) {
+    WarmShell shell;
+    try {
+        shell.hooks = std::make_shared<WarmShellHooks>();
+        shell.output = std::make_unique<SegmentedRingBuffer>(outputBufferSize);
+        shell.pty = std::make_unique<PtySession>();
+    } catch (...) {
+        return {};
+    }
+
+    // Both are called on the transport thread from the start, before any
+    // session exists to take them
+    shell.output->SetDataAvailableCallback([hooks = shell.hooks]() { hooks->OnData(); });
+    shell.pty->SetOutputBuffer(shell.output.get());
+    shell.pty->SetExitCallback([hooks = shell.hooks](DWORD exitCode) { hooks->OnExit(exitCode); });
+
+    if (!shell.pty->Start(config)) {
+        return {};
+    }
+    return shell;
+}
+
+bool WarmShellPool::HasMemoryToSpare() const {
+    if (m_minFreeBytes == 0) {
+        return true;
+    }
+    MEMORYSTATUSEX status{};
+    status.dwLength = sizeof(status);
+    return !GlobalMemoryStatusEx(&status) || status.ullAvailPhys >= m_minFreeBytes;
+}
+
+WarmShellPool::Profile* WarmShellPool::NextToFill() {
+    if (m_perProfile == 0 || !HasMemoryToSpare()) {
+        return nullptr;
+    }
+
+    // The most used profile with room, among those kept warm
+    Profile* best = nullptr;
+    for (size_t i = 0; i < m_profiles.size() && i < kMaxProfiles; ++i) {
+        Profile& profile = m_profiles[i];
+        if (profile.ready.size() < m_perProfile && profile.failures < kMaxFailures &&
+            (!best || profile.uses > best->uses)) {
+            best = &profile;
+        }
+    }
+    return best;
+}
+
+void WarmShellPool::Prune(std::vector<WarmShell>& retired) {
+    // Most used first, so the first kMaxProfiles are the ones kept warm
+    std::stable_sort(m_profiles.begin(), m_profiles.end(),
+                     [](const Profile& a, const Profile& b) { return a.uses > b.uses; });
+
+    const bool spare = HasMemoryToSpare();
+    for (size_t i = 0; i < m_profiles.size(); ++i) {
+        Profile& profile = m_profiles[i];
+        const size_t wanted = (spare && i < kMaxProfiles) ? m_perProfile : 0;
+
+        for (auto it = profile.ready.begin(); it != profile.ready.end();) {
+            if (it->hooks->HasExited()) {
+                // A shell that exits on its own is likely to do it again
+                ++profile.failures;
+                retired.push_back(std::move(*it));
+                it = profile.ready.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        while (profile.ready.size() > wanted) {
+            retired.push_back(std::move(profile.ready.back()));
+            profile.ready.pop_back();
+        }
+    }
+}
+
+void WarmShellPool::ThreadProc() {
+    std::unique_lock<std::mutex> lock(m_lock);
+    while (!m_stop) {
+        std::vector<WarmShell> retired;
+        Prune(retired);
+        if (!retired.empty()) {
+            lock.unlock();
+            retired.clear();
+            lock.lock();
+            continue;
+        }
+
+        Profile* profile = NextToFill();
+        if (!profile) {
+            m_wake.wait_for(lock, kRecheckInterval);
+            continue;
+        }
+
+        const std::wstring key = profile->key;
+        const PtyConfig config = profile->config;
+        const size_t outputBufferSize = profile->outputBufferSize;
+        lock.unlock();
+        WarmShell shell = Spawn(config, outputBufferSize);
+        lock.lock();
+
+        // The profile list may have been reordered while spawning
+        auto it = std::find_if(m_profiles.begin(), m_profiles.end(),
+                               [&](const Profile& p) { return p.key == key; });
+        if (it == m_profiles.end()) {
+            continue;
+        }
+        if (shell) {
+            it->ready.push_back(std::move(shell));
+        } else {
+            ++it->failures;
+        }
+    }
+}
+
+} // namespace Console3::Core
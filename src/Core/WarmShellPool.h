@@ -0,0 +1,163 @@
+#pragma once
+// Console3 - WarmShellPool.h
+// Shells started ahead of time, handed to new tabs
+//
+// Creating a pseudo console and launching a shell takes from tens of
+// milliseconds (cmd) to well over a second (PowerShell loading its profile),
+// and a new tab shows nothing until the shell prints its prompt. The pool
+// keeps a few shells already running for the profiles opened most often, so
+// a new tab takes one that has usually printed its prompt already, resizes
+// it to the view and shows the output straight away. The pool starts a
+// replacement on its own thread.
+//
+// A warm shell's output collects in its own ring until a session adopts the
+// ring with the shell. The ring and the transport's exit notice are set up
+// before the shell starts and are called from the transport thread, so both
+// go through a small relay (WarmShellHooks) that the adopting session
+// attaches its handlers to; anything that happened before then is passed on
+// when they are attached.
+//
+// Every warm shell is a running process and a console host, so the pool only
+// keeps the kMaxProfiles most used profiles warm, starts nothing until it is
+// configured (after startup) and drops its shells while free physical memory
+// is below the configured minimum.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Core/PtySession.h"
+#include "Core/SegmentedRingBuffer.h"
+
+namespace Console3::Core {
+
+/// Relays a warm shell's output and exit notices to whoever adopts it
+class WarmShellHooks {
+public:
+    /// Output arrived in the ring (transport thread)
+    void OnData();
+
+    /// The shell exited (transport thread)
+    void OnExit(DWORD exitCode);
+
+    /// Attach the adopter's output handler; called at once if output is waiting
+    void SetDataCallback(std::function<void()> callback);
+
+    /// Attach the adopter's exit handler; called at once if the shell exited
+    void SetExitCallback(ExitCallback callback);
+
+    /// Check if the shell exited before anyone adopted it
+    [[nodiscard]] bool HasExited() const;
+
+private:
+    mutable std::mutex m_lock;
+    std::function<void()> m_onData;
+    ExitCallback m_onExit;
+    bool m_dataPending = false;
+    bool m_exited = false;
+    DWORD m_exitCode = 0;
+};
+
+/// A running shell with the ring its output collects in
+struct WarmShell {
+    std::shared_ptr<WarmShellHooks> hooks;
+    std::unique_ptr<SegmentedRingBuffer> output;  ///< Outlives pty (declared first)
+    std::unique_ptr<PtySession> pty;
+
+    explicit operator bool() const noexcept { return pty != nullptr; }
+};
+
+/// Pool of warm shells per profile (see file comment)
+class WarmShellPool {
+public:
+    static constexpr size_t kMaxProfiles = 4;      ///< Profiles kept warm, most used first
+    static constexpr size_t kMaxFailures = 3;      ///< Give up on a profile after this many failed starts
+
+    WarmShellPool() = default;
+    ~WarmShellPool();
+
+    // Non-copyable, non-movable (owns the refill thread)
+    WarmShellPool(const WarmShellPool&) = delete;
+    WarmShellPool& operator=(const WarmShellPool&) = delete;
+
+    /// Get the process-wide pool
+    static WarmShellPool& Shared();
+
+    /// Set the pool size
+    /// @param perProfile Shells kept per profile (0 = off, frees the pool)
+    /// @param minFreeMB Free physical memory below which no shells are kept
+    void Configure(size_t perProfile, size_t minFreeMB);
+
+    /// Check if the pool keeps any shells
+    [[nodiscard]] bool IsEnabled() const;
+
+    /// Take a warm shell for a profile, counting the use either way
+    /// The pool starts a replacement in the background.
+    /// @param config Shell, arguments, directory and transport to match
+    /// (the size, recorder and probe are ignored)
+    /// @param outputBufferSize Cap of the ring a new warm shell gets
+    /// @return The shell, or an empty one if none is ready
+    [[nodiscard]] WarmShell Take(const PtyConfig& config, size_t outputBufferSize);
+
+    /// Stop and drop every warm shell
+    void Clear();
+
+    /// Get the number of shells ready to be taken
+    [[nodiscard]] size_t GetReadyCount() const;
+
+private:
+    struct Profile {
+        // Move-only, so the vector moves rather than copies the shells
+        Profile() = default;
+        Profile(Profile&&) = default;
+        Profile& operator=(Profile&&) = default;
+
+        std::wstring key;
+        PtyConfig config;
+        size_t outputBufferSize = 0;
+        uint64_t uses = 0;
+        size_t failures = 0;
+        std::deque<WarmShell> ready;
+    };
+
+    /// Start one shell (no lock held)
+    [[nodiscard]] static WarmShell Spawn(const PtyConfig& config, size_t outputBufferSize);
+
+    /// Check free physical memory against the minimum
+    [[nodiscard]] bool HasMemoryToSpare() const;
+
+    /// Find the profile that needs a shell most (called with the lock held)
+    Profile* NextToFill();
+
+    /// Drop exited shells and shells beyond what is wanted (called with the
+    /// lock held); the dropped shells are moved to retired to be stopped
+    /// outside the lock
+    void Prune(std::vector<WarmShell>& retired);
+
+    /// Refill thread procedure
+    void ThreadProc();
+
+    mutable std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::vector<Profile> m_profiles;
+    size_t m_perProfile = 0;
+    uint64_t m_minFreeBytes = 0;
+    bool m_stop = false;
+    std::thread m_thread;
+};
+
+} // namespace Console3::Core
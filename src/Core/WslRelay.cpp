@@ -0,0 +1,112 @@
+// Console3 - WslRelay.cpp
+// Running a WSL shell on a Linux pty instead of a pseudo console
+
+#include "Core/WslRelay.h"
+
+#include <atomic>
+#include <cwchar>
+#include <sstream>
+#include <string_view>
+#include <vector>
+
+namespace Console3::Core {
+
+namespace {
+
+constexpr wchar_t kRelayName[] = L"console3-relay";
+
+/// Unique suffix for FIFO names within this process
+std::atomic<uint32_t> g_relaySerial{0};
+
+/// Get the executable's directory (no trailing separator)
+std::wstring GetExecutableDir() {
+    std::vector<wchar_t> path(MAX_PATH);
+    for (;;) {
+        const DWORD length = GetModuleFileNameW(nullptr, path.data(), static_cast<DWORD>(path.size()));
+        if (length == 0) {
+            return {};
+        }
+        if (length < path.size()) {
+            std::wstring dir(path.data(), length);
+            const size_t slash = dir.find_last_of(L"\\/");
+            return slash == std::wstring::npos ? std::wstring{} : dir.substr(0, slash);
+        }
+        path.resize(path.size() * 2);
+    }
+}
+
+/// Split arguments on whitespace (profile arguments are simple; quotes are
+/// not expected and disqualify the shell)
+std::vector<std::wstring> SplitArgs(const std::wstring& args) {
+    std::vector<std::wstring> words;
+    std::wistringstream stream(args);
+    for (std::wstring word; stream >> word;) {
+        words.push_back(std::move(word));
+    }
+    return words;
+}
+
+bool EqualsNoCase(std::wstring_view a, std::wstring_view b) {
+    return a.size() == b.size() && _wcsnicmp(a.data(), b.data(), a.size()) == 0;
+}
+
+} // namespace
+
+std::optional<std::wstring> GetWslRelayDistro(const std::wstring& shell, const std::wstring& args) {
+    std::wstring_view name = shell;
+    if (!name.empty() && name.front() == L'"' && name.back() == L'"' && name.size() >= 2) {
+        name = name.substr(1, name.size() - 2);
+    }
+    const size_t slash = name.find_last_of(L"\\/");
+    if (slash != std::wstring_view::npos) {
+        name = name.substr(slash + 1);
+    }
+    if (!EqualsNoCase(name, L"wsl.exe") && !EqualsNoCase(name, L"wsl")) {
+        return std::nullopt;
+    }
+
+    const std::vector<std::wstring> words = SplitArgs(args);
+    if (words.empty()) {
+        return std::wstring{};
+    }
+    if (words.size() == 2 && (words[0] == L"-d" || words[0] == L"--distribution") &&
+        words[1].find(L'"') == std::wstring::npos) {
+        return words[1];
+    }
+    return std::nullopt;
+}
+
+bool IsWslRelayInstalled() {
+    const std::wstring dir = GetExecutableDir();
+    if (dir.empty()) {
+        return false;
+    }
+    const DWORD attributes = GetFileAttributesW((dir + L"\\" + kRelayName).c_str());
+    return attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY);
+}
+
+WslRelayCommands MakeWslRelayCommands(const std::wstring& distro, int cols, int rows) {
+    // wsl.exe takes the Windows directory for --cd and translates it, so the
+    // relay runs from where it was installed without a path of its own
+    std::wstring wsl = L"wsl.exe";
+    if (!distro.empty()) {
+        wsl += L" -d " + distro;
+    }
+    wsl += L" --cd \"" + GetExecutableDir() + L"\" --exec ./";
+    wsl += kRelayName;
+
+    const std::wstring fifo = L"/tmp/console3-relay-" + std::to_wstring(GetCurrentProcessId()) + L"-" +
+                              std::to_wstring(g_relaySerial.fetch_add(1));
+
+    WslRelayCommands commands;
+    commands.relay = wsl + L" --cols " + std::to_wstring(cols) + L" --rows " + std::to_wstring(rows) +
+                     L" --control " + fifo;
+    commands.forward = wsl + L" --forward " + fifo;
+    return commands;
+}
+
+std::string MakeWslRelayResize(int cols, int rows) {
+    return "resize " + std::to_string(cols) + " " + std::to_string(rows) + "\n";
+}
+
+} // namespace Console3::Core
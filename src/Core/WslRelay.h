@@ -0,0 +1,50 @@
+#pragma once
+// Console3 - WslRelay.h
+// Running a WSL shell on a Linux pty instead of a pseudo console
+//
+// wsl.exe under a pseudo console puts conhost between the shell and us:
+// every byte is emulated, re-rendered and serialized again. When
+// console3-relay (src/WslRelay) is installed next to Console3.exe, a plain
+// WSL profile starts wsl.exe on pipes instead, running the relay, which
+// gives the shell a real Linux pty and streams its bytes unchanged. Resizes
+// travel out of band: a second wsl.exe forwards "resize <cols> <rows>"
+// lines from a control pipe into a FIFO the relay watches.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+#include <optional>
+#include <string>
+
+namespace Console3::Core {
+
+/// Command lines for one relayed session
+struct WslRelayCommands {
+    std::wstring relay;     ///< Runs the shell; its stdin/stdout are the session's pipes
+    std::wstring forward;   ///< Copies its stdin (the control pipe) into the relay's FIFO
+};
+
+/// Get the distribution a shell command runs, if it is a plain wsl.exe
+/// Only wsl.exe with no arguments or just "-d NAME" (the profiles
+/// ShellDetector makes) qualifies; anything else runs its own command.
+/// @return The distribution name (empty for the default one), or nullopt
+[[nodiscard]] std::optional<std::wstring> GetWslRelayDistro(const std::wstring& shell, const std::wstring& args);
+
+/// Check that console3-relay is installed next to the executable
+[[nodiscard]] bool IsWslRelayInstalled();
+
+/// Build the command lines for a relayed session
+/// @param distro From GetWslRelayDistro
+/// @param cols Initial column count
+/// @param rows Initial row count
+[[nodiscard]] WslRelayCommands MakeWslRelayCommands(const std::wstring& distro, int cols, int rows);
+
+/// Format a resize message for the control pipe
+[[nodiscard]] std::string MakeWslRelayResize(int cols, int rows);
+
+} // namespace Console3::Core
@@ -0,0 +1,366 @@
+// Console3 - Console3Embed.cpp
+// C API for headless terminals (Console3Embed.dll)
+
+#include "Embed/Console3Embed.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <wil/resource.h>
+
+#include "Core/Session.h"
+#include "Core/Utf.h"
+#include "Emulation/VTermWrapper.h"
+
+struct c3_terminal {
+    std::mutex lock;                            ///< One call at a time
+    std::unique_ptr<Console3::Core::Session> session;
+    wil::unique_event_nothrow exited;           ///< Set by the exit callback (manual reset)
+    std::atomic<uint32_t> exitCode{0};
+};
+
+namespace {
+
+using Console3::Core::Cell;
+using Console3::Core::CellColor;
+using Console3::Core::OutputMatch;
+using Console3::Core::OutputWait;
+using Console3::Core::SearchQuery;
+using Console3::Core::Session;
+using Console3::Core::SessionConfig;
+using Console3::Core::TerminalBuffer;
+using Console3::Core::ToUtf8;
+
+thread_local std::string t_lastError;
+
+c3_status Fail(c3_status status, std::string message) {
+    t_lastError = std::move(message);
+    return status;
+}
+
+uint32_t ToColor(const CellColor& color) {
+    if (color.IsDefault()) {
+        return C3_COLOR_DEFAULT;
+    }
+    if (color.IsIndexed()) {
+        return C3_COLOR_INDEXED | color.r;
+    }
+    return (uint32_t{color.r} << 16) | (uint32_t{color.g} << 8) | color.b;
+}
+
+void CopyCells(std::span<const Cell> cells, c3_cell* out) {
+    for (const Cell& cell : cells) {
+        const Console3::Core::CellAttributes attrs = cell.Attributes();
+        c3_cell& to = *out++;
+        to.codepoint = cell.code == Cell::kContinuation ? 0 : cell.Codepoint();
+        to.fg = ToColor(cell.fg);
+        to.bg = ToColor(cell.bg);
+        to.width = cell.code == Cell::kContinuation ? 0 : static_cast<uint8_t>(cell.width);
+        to.attrs = static_cast<uint8_t>((attrs.bold ? C3_ATTR_BOLD : 0) | (attrs.italic ? C3_ATTR_ITALIC : 0) |
+                                        (attrs.underline ? C3_ATTR_UNDERLINE : 0) |
+                                        (attrs.blink ? C3_ATTR_BLINK : 0) | (attrs.reverse ? C3_ATTR_REVERSE : 0) |
+                                        (attrs.strikethrough ? C3_ATTR_STRIKETHROUGH : 0) |
+                                        (attrs.conceal ? C3_ATTR_CONCEAL : 0));
+        to.reserved = 0;
+    }
+}
+
+c3_status CopyText(std::span<const Cell> cells, char* buffer, size_t capacity, size_t* length) {
+    std::string text;
+    TerminalBuffer::AppendColumnText(text, cells, 0, static_cast<int>(cells.size()));
+    if (length) {
+        *length = text.size();
+    }
+    if (!buffer || capacity <= text.size()) {
+        return C3_BUFFER_TOO_SMALL;
+    }
+    std::memcpy(buffer, text.data(), text.size());
+    buffer[text.size()] = '\0';
+    return C3_OK;
+}
+
+bool HasExited(const c3_terminal& terminal) {
+    return WaitForSingleObject(terminal.exited.get(), 0) == WAIT_OBJECT_0;
+}
+
+/// Wait for output or the exit, then parse what arrived (lock held)
+/// @return C3_OK if output arrived, else C3_EXITED or C3_TIMEOUT
+c3_status WaitAndParse(c3_terminal& terminal, DWORD timeoutMs) {
+    Session& session = *terminal.session;
+    const HANDLE handles[] = {session.GetOutputEvent(), terminal.exited.get()};
+    const DWORD wait = WaitForMultipleObjects(2, handles, FALSE, timeoutMs);
+
+    // Output that came just before the exit is parsed either way
+    session.ProcessOutput();
+    if (wait == WAIT_OBJECT_0) {
+        return C3_OK;
+    }
+    return HasExited(terminal) ? C3_EXITED : C3_TIMEOUT;
+}
+
+/// Parse output until a query matches (lock held)
+/// The wait is matched as output is parsed (OutputWaits), so each call
+/// looks at the new and changed lines only, however long the session ran.
+c3_status WaitForMatch(c3_terminal& terminal, const SearchQuery& query, uint32_t timeoutMs, c3_match* match) {
+    Session& session = *terminal.session;
+    const std::shared_ptr<OutputWait> wait = session.WaitForOutput(query);
+    if (!wait) {
+        return Fail(C3_INVALID_ARGUMENT, "Invalid pattern");
+    }
+
+    // The first parse matches the screen as it is
+    const ULONGLONG deadline = GetTickCount64() + timeoutMs;
+    for (;;) {
+        const ULONGLONG now = GetTickCount64();
+        const c3_status status = WaitAndParse(terminal, now < deadline ? static_cast<DWORD>(deadline - now) : 0);
+        if (wait->GetState() == OutputWait::State::Matched) {
+            break;
+        }
+        if (status == C3_EXITED || GetTickCount64() >= deadline) {
+            wait->Cancel();
+            return status == C3_EXITED ? C3_EXITED : C3_TIMEOUT;
+        }
+    }
+
+    if (match) {
+        // Where the line is now: on the screen, in the scrollback, or gone
+        const OutputMatch found = wait->GetMatch();
+        const TerminalBuffer& buffer = *session.GetBuffer();
+        const uint64_t screen = buffer.GetScreenLine();
+        const size_t lines = buffer.GetScrollbackSize();
+        match->row = found.line >= screen ? static_cast<int>(found.line - screen) : -1;
+        match->scrollback_index =
+            found.line < screen && screen - found.line <= lines ? static_cast<int64_t>(lines - (screen - found.line))
+                                                                : -1;
+        match->offset = found.offset;
+        match->length = found.length;
+    }
+    return C3_OK;
+}
+
+} // namespace
+
+extern "C" {
+
+uint32_t c3_api_version(void) {
+    return C3_API_VERSION;
+}
+
+const char* c3_last_error(void) {
+    return t_lastError.c_str();
+}
+
+c3_status c3_spawn(const c3_spawn_options* options, c3_terminal** terminal) {
+    if (!options || !terminal || options->struct_size < sizeof(c3_spawn_options) || options->cols < 0 ||
+        options->rows < 0) {
+        return Fail(C3_INVALID_ARGUMENT, "Invalid spawn options");
+    }
+    *terminal = nullptr;
+
+    // Parsed on the caller's thread, every byte applied to the screen
+    SessionConfig config;
+    if (options->shell) {
+        config.shell = options->shell;
+    }
+    if (options->args) {
+        config.args = options->args;
+    }
+    if (options->working_dir) {
+        config.workingDir = options->working_dir;
+    }
+    config.cols = options->cols > 0 ? options->cols : 80;
+    config.rows = options->rows > 0 ? options->rows : 25;
+    if (options->scrollback_lines > 0) {
+        config.scrollbackLines = options->scrollback_lines;
+    }
+    config.emulationThread = false;
+    config.fastForwardBytesPerSec = 0;
+
+    auto created = std::make_unique<c3_terminal>();
+    if (!created->exited.try_create(wil::EventOptions::ManualReset, nullptr)) {
+        return Fail(C3_ERROR, "Failed to create the exit event");
+    }
+    created->session = std::make_unique<Session>();
+    created->session->SetExitCallback([raw = created.get()](DWORD exitCode) {
+        raw->exitCode.store(exitCode);
+        raw->exited.SetEvent();
+    });
+    if (!created->session->Start(config)) {
+        Console3::Core::PtySession* pty = created->session->GetPty();
+        return Fail(C3_ERROR, "Failed to start the shell" + (pty ? ": " + ToUtf8(pty->GetLastError()) : ""));
+    }
+
+    *terminal = created.release();
+    return C3_OK;
+}
+
+void c3_close(c3_terminal* terminal) {
+    if (!terminal) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(terminal->lock);
+        terminal->session->Stop();
+    }
+    delete terminal;
+}
+
+c3_status c3_write(c3_terminal* terminal, const char* data, size_t length) {
+    if (!terminal || (!data && length > 0)) {
+        return Fail(C3_INVALID_ARGUMENT, "Invalid terminal or data");
+    }
+
+    // Not serialized: input goes out while another thread waits for output
+    if (length > 0 && terminal->session->Write(data, length) < 0) {
+        return HasExited(*terminal) ? C3_EXITED : Fail(C3_ERROR, "The input queue is full or closed");
+    }
+    return C3_OK;
+}
+
+c3_status c3_resize(c3_terminal* terminal, int cols, int rows) {
+    if (!terminal || cols <= 0 || rows <= 0) {
+        return Fail(C3_INVALID_ARGUMENT, "Invalid terminal or size");
+    }
+    std::lock_guard<std::mutex> lock(terminal->lock);
+    if (!terminal->session->Resize(cols, rows)) {
+        return Fail(C3_ERROR, "Failed to resize the terminal");
+    }
+    return C3_OK;
+}
+
+c3_status c3_wait_for_output(c3_terminal* terminal, uint32_t timeout_ms) {
+    if (!terminal) {
+        return Fail(C3_INVALID_ARGUMENT, "Invalid terminal");
+    }
+    std::lock_guard<std::mutex> lock(terminal->lock);
+    return WaitAndParse(*terminal, timeout_ms);
+}
+
+c3_status c3_wait_for_text(c3_terminal* terminal, const char* text, uint32_t timeout_ms) {
+    if (!terminal || !text) {
+        return Fail(C3_INVALID_ARGUMENT, "Invalid terminal or text");
+    }
+    std::lock_guard<std::mutex> lock(terminal->lock);
+    return WaitForMatch(*terminal, SearchQuery{text, true, false}, timeout_ms, nullptr);
+}
+
+c3_status c3_wait_for_match(c3_terminal* terminal, const char* pattern, uint32_t flags, uint32_t timeout_ms,
+                            c3_match* match) {
+    if (!terminal || !pattern) {
+        return Fail(C3_INVALID_ARGUMENT, "Invalid terminal or pattern");
+    }
+    std::lock_guard<std::mutex> lock(terminal->lock);
+    const SearchQuery query{pattern, (flags & C3_MATCH_CASE) != 0, (flags & C3_MATCH_REGEX) != 0};
+    return WaitForMatch(*terminal, query, timeout_ms, match);
+}
+
+c3_status c3_get_exit_code(c3_terminal* terminal, uint32_t* exit_code) {
+    if (!terminal || !exit_code) {
+        return Fail(C3_INVALID_ARGUMENT, "Invalid terminal or exit code");
+    }
+    if (!HasExited(*terminal)) {
+        return C3_TIMEOUT;
+    }
+    *exit_code = terminal->exitCode.load();
+    return C3_OK;
+}
+
+c3_status c3_get_size(c3_terminal* terminal, int* cols, int* rows) {
+    if (!terminal || !cols || !rows) {
+        return Fail(C3_INVALID_ARGUMENT, "Invalid terminal or size");
+    }
+    std::lock_guard<std::mutex> lock(terminal->lock);
+    const TerminalBuffer& buffer = *terminal->session->GetBuffer();
+    *cols = buffer.GetCols();
+    *rows = buffer.GetRows();
+    return C3_OK;
+}
+
+c3_status c3_get_cursor(c3_terminal* terminal, int* row, int* col) {
+    if (!terminal || !row || !col) {
+        return Fail(C3_INVALID_ARGUMENT, "Invalid terminal or position");
+    }
+    std::lock_guard<std::mutex> lock(terminal->lock);
+    terminal->session->GetVTerm()->GetCursorPos(*row, *col);
+    return C3_OK;
+}
+
+c3_status c3_snapshot(c3_terminal* terminal, c3_cell* cells, size_t capacity, int* cols, int* rows) {
+    if (!terminal || !cols || !rows) {
+        return Fail(C3_INVALID_ARGUMENT, "Invalid terminal or size");
+    }
+    std::lock_guard<std::mutex> lock(terminal->lock);
+    const TerminalBuffer& buffer = *terminal->session->GetBuffer();
+    *cols = buffer.GetCols();
+    *rows = buffer.GetRows();
+    if (!cells || capacity < static_cast<size_t>(*cols) * static_cast<size_t>(*rows)) {
+        return C3_BUFFER_TOO_SMALL;
+    }
+    for (int row = 0; row < *rows; ++row) {
+        CopyCells(buffer.GetRow(row), cells + static_cast<size_t>(row) * static_cast<size_t>(*cols));
+    }
+    return C3_OK;
+}
+
+c3_status c3_get_row_text(c3_terminal* terminal, int row, char* buffer, size_t capacity, size_t* length) {
+    if (!terminal || !length) {
+        return Fail(C3_INVALID_ARGUMENT, "Invalid terminal or length");
+    }
+    std::lock_guard<std::mutex> lock(terminal->lock);
+    const TerminalBuffer& screen = *terminal->session->GetBuffer();
+    if (row < 0 || row >= screen.GetRows()) {
+        return Fail(C3_INVALID_ARGUMENT, "Row out of range");
+    }
+    return CopyText(screen.GetRow(row), buffer, capacity, length);
+}
+
+size_t c3_scrollback_count(c3_terminal* terminal) {
+    if (!terminal) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(terminal->lock);
+    return terminal->session->GetBuffer()->GetScrollbackSize();
+}
+
+c3_status c3_scrollback_line(c3_terminal* terminal, size_t index, c3_cell* cells, size_t capacity,
+                             size_t* count) {
+    if (!terminal || !count) {
+        return Fail(C3_INVALID_ARGUMENT, "Invalid terminal or count");
+    }
+    std::lock_guard<std::mutex> lock(terminal->lock);
+    const TerminalBuffer& buffer = *terminal->session->GetBuffer();
+    const size_t lines = buffer.GetScrollbackSize();
+    const Console3::Core::Row* line = index < lines ? buffer.GetScrollbackLine(lines - 1 - index) : nullptr;
+    if (!line) {
+        return Fail(C3_INVALID_ARGUMENT, "Scrollback line out of range");
+    }
+    *count = line->size();
+    if (!cells || capacity < line->size()) {
+        return C3_BUFFER_TOO_SMALL;
+    }
+    CopyCells(*line, cells);
+    return C3_OK;
+}
+
+c3_status c3_scrollback_text(c3_terminal* terminal, size_t index, char* buffer, size_t capacity,
+                             size_t* length) {
+    if (!terminal || !length) {
+        return Fail(C3_INVALID_ARGUMENT, "Invalid terminal or length");
+    }
+    std::lock_guard<std::mutex> lock(terminal->lock);
+    const TerminalBuffer& screen = *terminal->session->GetBuffer();
+    const size_t lines = screen.GetScrollbackSize();
+    const Console3::Core::Row* line = index < lines ? screen.GetScrollbackLine(lines - 1 - index) : nullptr;
+    if (!line) {
+        return Fail(C3_INVALID_ARGUMENT, "Scrollback line out of range");
+    }
+    return CopyText(*line, buffer, capacity, length);
+}
+
+} // extern "C"
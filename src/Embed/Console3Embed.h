@@ -0,0 +1,173 @@
+#pragma once
+/* Console3 - Console3Embed.h
+ * C API for headless terminals (Console3Embed.dll)
+ *
+ * A terminal here is a Session with no window: a shell on a pseudo console,
+ * its output parsed by the same emulator into the same buffer the UI draws
+ * from. It is meant for driving command-line programs from tests and
+ * asserting on what they put on screen; hundreds can run side by side in
+ * one process.
+ *
+ * Output is parsed only inside the c3_wait_for_* functions,
+ * on the calling thread, so the screen and scrollback hold still between
+ * those calls and every read sees one consistent state. Each function may
+ * be called from any thread; calls on one terminal are serialized, except
+ * c3_write() and c3_get_exit_code(), which never wait for a wait in
+ * progress. Calls on different terminals run in parallel.
+ *
+ * Strings passed in are UTF-16 (paths, command lines) or UTF-8 (input,
+ * text to wait for); text read back is UTF-8. Buffers are the caller's:
+ * a function that fills one reports the size it needs and fails with
+ * C3_BUFFER_TOO_SMALL if it is short. Screen rows and columns count from 0
+ * at the top left; scrollback lines count from 0 at the oldest.
+ *
+ * The API is C and versioned by C3_API_VERSION: later versions only add
+ * functions, and add fields to c3_spawn_options at its end (struct_size
+ * tells which ones the caller knows).
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <wchar.h>
+
+#if defined(CONSOLE3_EMBED_EXPORTS)
+#define C3_API __declspec(dllexport)
+#else
+#define C3_API __declspec(dllimport)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define C3_API_VERSION 2
+
+/* Result of a call */
+typedef enum c3_status {
+    C3_OK = 0,
+    C3_TIMEOUT = 1,              /* Nothing (or not the text) before the timeout */
+    C3_EXITED = 2,               /* The shell exited (its output is all parsed) */
+    C3_ERROR = -1,               /* See c3_last_error() */
+    C3_INVALID_ARGUMENT = -2,
+    C3_BUFFER_TOO_SMALL = -3     /* The size needed was reported */
+} c3_status;
+
+/* Colors in c3_cell: 0x00RRGGBB, or one of these flags */
+#define C3_COLOR_DEFAULT 0x01000000u /* The terminal's default color */
+#define C3_COLOR_INDEXED 0x02000000u /* Palette index in the low byte */
+
+/* Attribute bits in c3_cell */
+#define C3_ATTR_BOLD 0x01u
+#define C3_ATTR_ITALIC 0x02u
+#define C3_ATTR_UNDERLINE 0x04u
+#define C3_ATTR_BLINK 0x08u
+#define C3_ATTR_REVERSE 0x10u
+#define C3_ATTR_STRIKETHROUGH 0x20u
+#define C3_ATTR_CONCEAL 0x40u
+
+/* One screen cell */
+typedef struct c3_cell {
+    uint32_t codepoint;     /* Base character (combining marks are in the row's text) */
+    uint32_t fg;            /* Foreground color */
+    uint32_t bg;            /* Background color */
+    uint8_t width;          /* 1, 2 for a wide character, 0 for its right half */
+    uint8_t attrs;          /* C3_ATTR_* */
+    uint16_t reserved;
+} c3_cell;
+
+/* How to start a terminal */
+typedef struct c3_spawn_options {
+    uint32_t struct_size;           /* sizeof(c3_spawn_options) */
+    const wchar_t* shell;           /* Executable (NULL = cmd.exe) */
+    const wchar_t* args;            /* Arguments (NULL = none) */
+    const wchar_t* working_dir;     /* NULL = the current directory */
+    int cols;                       /* 0 = 80 */
+    int rows;                       /* 0 = 25 */
+    size_t scrollback_lines;        /* 0 = 10000 */
+} c3_spawn_options;
+
+typedef struct c3_terminal c3_terminal;
+
+/* Get the C3_API_VERSION the library implements */
+C3_API uint32_t c3_api_version(void);
+
+/* Get the calling thread's last error message (UTF-8; never NULL) */
+C3_API const char* c3_last_error(void);
+
+/* Start a shell on a pseudo console */
+C3_API c3_status c3_spawn(const c3_spawn_options* options, c3_terminal** terminal);
+
+/* Stop the shell, if it is running, and free the terminal */
+C3_API void c3_close(c3_terminal* terminal);
+
+/* Queue input for the shell (UTF-8 text or escape sequences; never blocks) */
+C3_API c3_status c3_write(c3_terminal* terminal, const char* data, size_t length);
+
+/* Resize the screen and the pseudo console */
+C3_API c3_status c3_resize(c3_terminal* terminal, int cols, int rows);
+
+/* Parse the output that has arrived, first waiting up to timeout_ms for
+ * some if none has (0 = don't wait)
+ * Returns C3_OK if output was parsed, C3_TIMEOUT or C3_EXITED otherwise. */
+C3_API c3_status c3_wait_for_output(c3_terminal* terminal, uint32_t timeout_ms);
+
+/* Parse output until text (UTF-8, matching case) is on the screen, or in
+ * output that scrolls past, or timeout_ms passes
+ * Lines are matched as they are parsed, each within one line: text split
+ * by a wrap is not found, and neither is text already in the scrollback.
+ * Returns C3_OK once it is, C3_TIMEOUT, or C3_EXITED if the shell exited
+ * without showing it. */
+C3_API c3_status c3_wait_for_text(c3_terminal* terminal, const char* text, uint32_t timeout_ms);
+
+/* Flags for c3_wait_for_match() */
+#define C3_MATCH_CASE 0x01u     /* Match case (otherwise ASCII letters fold) */
+#define C3_MATCH_REGEX 0x02u    /* ECMAScript regular expression, within a line */
+
+/* Where c3_wait_for_match() matched, as of its return */
+typedef struct c3_match {
+    int row;                    /* Screen row, or -1 if the line scrolled off */
+    int64_t scrollback_index;   /* Scrollback line, or -1 (on the screen, or dropped) */
+    size_t offset;              /* Byte offset in the line's text */
+    size_t length;              /* Bytes matched */
+} c3_match;
+
+/* As c3_wait_for_text(), for a pattern (UTF-8) with C3_MATCH_* flags
+ * match (may be NULL) receives where it matched.
+ * Returns C3_INVALID_ARGUMENT for an invalid regular expression. */
+C3_API c3_status c3_wait_for_match(c3_terminal* terminal, const char* pattern, uint32_t flags,
+                                   uint32_t timeout_ms, c3_match* match);
+
+/* Get the shell's exit code
+ * Returns C3_OK once it exited, C3_TIMEOUT while it runs. */
+C3_API c3_status c3_get_exit_code(c3_terminal* terminal, uint32_t* exit_code);
+
+/* Get the screen size */
+C3_API c3_status c3_get_size(c3_terminal* terminal, int* cols, int* rows);
+
+/* Get the cursor position */
+C3_API c3_status c3_get_cursor(c3_terminal* terminal, int* row, int* col);
+
+/* Copy the screen's cells, row by row, into cells[cols * rows]
+ * cols and rows receive the screen size (even when capacity is short). */
+C3_API c3_status c3_snapshot(c3_terminal* terminal, c3_cell* cells, size_t capacity, int* cols, int* rows);
+
+/* Copy a screen row's text, without trailing blanks, NUL-terminated
+ * length receives the bytes without the NUL (even when capacity is short). */
+C3_API c3_status c3_get_row_text(c3_terminal* terminal, int row, char* buffer, size_t capacity,
+                                 size_t* length);
+
+/* Get the number of lines in the scrollback */
+C3_API size_t c3_scrollback_count(c3_terminal* terminal);
+
+/* Copy a scrollback line's cells
+ * count receives the line's cell count (even when capacity is short). */
+C3_API c3_status c3_scrollback_line(c3_terminal* terminal, size_t index, c3_cell* cells, size_t capacity,
+                                    size_t* count);
+
+/* Copy a scrollback line's text, as c3_get_row_text() */
+C3_API c3_status c3_scrollback_text(c3_terminal* terminal, size_t index, char* buffer, size_t capacity,
+                                    size_t* length);
+
+#ifdef __cplusplus
+}
+#endif
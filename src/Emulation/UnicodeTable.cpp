@@ -0,0 +1,188 @@
+// Console3 - UnicodeTable.cpp
+// Character widths and grapheme break properties in a two-level table
+
+#include "Emulation/UnicodeTable.h"
+#include <algorithm>
+#include <array>
+
+namespace Console3::Emulation {
+
+namespace {
+
+struct Interval {
+    uint32_t first;
+    uint32_t last;
+};
+
+// libvterm's own lists, so the table answers exactly as its searches did
+constexpr Interval kCombining[] = {
+#include "../../vendor/libvterm/src/combining.inc"
+};
+
+constexpr Interval kFullwidth[] = {
+#include "../../vendor/libvterm/src/fullwidth.inc"
+};
+
+/// East Asian wide ranges libvterm's mk_wcwidth() tests in code
+constexpr Interval kWide[] = {
+    {0x1100, 0x115F}, {0x2329, 0x232A}, {0x2E80, 0x303E}, {0x3040, 0xA4CF}, {0xAC00, 0xD7A3},
+    {0xF900, 0xFAFF}, {0xFE10, 0xFE19}, {0xFE30, 0xFE6F}, {0xFF00, 0xFF60}, {0xFFE0, 0xFFE6},
+    {0x20000, 0x2FFFD}, {0x30000, 0x3FFFD},
+};
+
+constexpr Interval kControls[] = {{0x01, 0x1F}, {0x7F, 0x9F}};
+constexpr Interval kZeroWidthJoiner[] = {{0x200D, 0x200D}};
+constexpr Interval kRegionalIndicators[] = {{0x1F1E6, 0x1F1FF}};
+
+constexpr uint32_t kPageSize = 1u << UnicodeTable::kPageShift;
+constexpr uint32_t kPages = UnicodeTable::kCodepoints >> UnicodeTable::kPageShift;
+
+template <size_t N>
+constexpr bool Contains(const Interval (&intervals)[N], uint32_t codepoint) {
+    const auto* found = std::lower_bound(std::begin(intervals), std::end(intervals), codepoint,
+                                         [](const Interval& interval, uint32_t cp) { return interval.last < cp; });
+    return found != std::end(intervals) && found->first <= codepoint;
+}
+
+/// A codepoint's properties, found the slow way (at compile time only)
+constexpr uint8_t PropertiesOf(uint32_t codepoint) {
+    uint8_t properties = 0;
+    if (Contains(kFullwidth, codepoint)) {
+        properties = 2;
+    } else if (codepoint == 0) {
+        properties = 0;
+    } else if (Contains(kControls, codepoint)) {
+        properties = UnicodeTable::kControl;
+    } else if (Contains(kCombining, codepoint)) {
+        properties = 0;
+    } else {
+        properties = Contains(kWide, codepoint) ? 2 : 1;
+    }
+    if (Contains(kCombining, codepoint)) {
+        properties |= UnicodeTable::kCombining;
+    }
+    if (Contains(kZeroWidthJoiner, codepoint)) {
+        properties |= UnicodeTable::kZeroWidthJoiner;
+    }
+    if (Contains(kRegionalIndicators, codepoint)) {
+        properties |= UnicodeTable::kRegionalIndicator;
+    }
+    return properties;
+}
+
+/// Every codepoint where a property may change, sorted
+constexpr auto kBoundaries = [] {
+    constexpr size_t count = 2 * (std::size(kCombining) + std::size(kFullwidth) + std::size(kWide) +
+                                  std::size(kControls) + std::size(kZeroWidthJoiner) +
+                                  std::size(kRegionalIndicators)) + 1;
+    std::array<uint32_t, count> boundaries{};
+    size_t next = 0;
+    const auto add = [&](const auto& intervals) {
+        for (const Interval& interval : intervals) {
+            boundaries[next++] = interval.first;
+            boundaries[next++] = interval.last + 1;
+        }
+    };
+    add(kCombining);
+    add(kFullwidth);
+    add(kWide);
+    add(kControls);
+    add(kZeroWidthJoiner);
+    add(kRegionalIndicators);
+    boundaries[next++] = 1;     // U+0000 differs from the controls after it
+    std::sort(boundaries.begin(), boundaries.end());
+    return boundaries;
+}();
+
+/// Walk the pages: one of their own for those a boundary falls inside, one
+/// shared per value for the rest
+/// @param index Receives each page's index (may be null)
+/// @param pages Receives the page contents (may be null)
+/// @return Number of pages
+constexpr size_t BuildPages(uint16_t* index, uint8_t* pages) {
+    std::array<int, 256> uniform{};
+    uniform.fill(-1);
+    size_t count = 0;
+    size_t boundary = 0;
+    uint8_t value = PropertiesOf(0);
+    for (uint32_t page = 0; page < kPages; ++page) {
+        const uint32_t start = page * kPageSize;
+        const uint32_t end = start + kPageSize;
+
+        // The value at the page's start only changes past a boundary
+        const size_t passed = boundary;
+        while (boundary < kBoundaries.size() && kBoundaries[boundary] <= start) {
+            ++boundary;
+        }
+        if (boundary != passed) {
+            value = PropertiesOf(start);
+        }
+        const bool mixed = boundary < kBoundaries.size() && kBoundaries[boundary] < end;
+
+        if (!mixed) {
+            if (uniform[value] < 0) {
+                uniform[value] = static_cast<int>(count++);
+                if (pages) {
+                    std::fill_n(pages + static_cast<size_t>(uniform[value]) * kPageSize, kPageSize, value);
+                }
+            }
+            if (index) {
+                index[page] = static_cast<uint16_t>(uniform[value]);
+            }
+            continue;
+        }
+
+        // Constant between boundaries: one slow lookup per stretch
+        if (index) {
+            index[page] = static_cast<uint16_t>(count);
+        }
+        if (pages) {
+            uint8_t* out = pages + count * kPageSize;
+            size_t next = boundary;
+            for (uint32_t cp = start; cp < end;) {
+                const uint32_t stop = next < kBoundaries.size() ? std::min(kBoundaries[next], end) : end;
+                std::fill(out + (cp - start), out + (stop - start), PropertiesOf(cp));
+                cp = stop;
+                while (next < kBoundaries.size() && kBoundaries[next] <= cp) {
+                    ++next;
+                }
+            }
+        }
+        ++count;
+    }
+    return count;
+}
+
+constexpr size_t kPageCount = BuildPages(nullptr, nullptr);
+
+struct Table {
+    std::array<uint16_t, kPages> index;
+    std::array<uint8_t, kPageCount * kPageSize> pages;
+};
+
+constexpr Table kTable = [] {
+    Table table{};
+    BuildPages(table.index.data(), table.pages.data());
+    return table;
+}();
+
+static_assert(kPageCount <= UINT16_MAX);
+static_assert(PropertiesOf(U'a') == 1 && PropertiesOf(0x4E00) == 2 && PropertiesOf(0x0301) == UnicodeTable::kCombining);
+static_assert(kTable.pages[kTable.index[0x1F6] * kPageSize + 0x00] == 2);    // U+1F600
+
+} // namespace
+
+// Constant-initialized: nothing runs at startup
+const uint16_t* const UnicodeTable::s_index = kTable.index.data();
+const uint8_t* const UnicodeTable::s_pages = kTable.pages.data();
+
+const VTermUnicodeTable& UnicodeTable::GetVTermTable() noexcept {
+    static const VTermUnicodeTable table{s_index, s_pages};
+    return table;
+}
+
+size_t UnicodeTable::GetPageCount() noexcept {
+    return kPageCount;
+}
+
+} // namespace Console3::Emulation
@@ -0,0 +1,94 @@
+#pragma once
+// Console3 - UnicodeTable.h
+// Character widths and grapheme break properties in a two-level table
+//
+// libvterm decided each character's width with binary searches over its
+// interval lists (combining.inc, fullwidth.inc), and the renderer needs the
+// same answers again per cell. Both now read one table, computed at compile
+// time from those same lists: the properties of codepoint c are
+// pages[index[c >> 8] * 256 + (c & 0xFF)], two loads whatever c is. Pages
+// that hold a single value throughout are shared, so most of the codespace
+// costs nothing beyond its index entry.
+//
+// VTermWrapper hands the table to libvterm (vterm_state_set_unicode_table),
+// so a character's width in the buffer and in the renderer cannot differ.
+// Grapheme break properties are the ones the emulator clusters by: a
+// combining character (Extend) joins the glyph before it; joiners and
+// regional indicators are marked for the renderer, which must not split or
+// reorder them within a run.
+
+#include <cstddef>
+#include <cstdint>
+
+// libvterm C header
+extern "C" {
+#include <vterm.h>
+}
+
+namespace Console3::Emulation {
+
+/// Grapheme cluster break property, as far as the emulator distinguishes
+enum class GraphemeBreak : uint8_t {
+    Other,
+    Control,            ///< C0/C1 controls
+    Extend,             ///< Combining and other zero-width characters
+    ZeroWidthJoiner,    ///< U+200D (also Extend for clustering)
+    RegionalIndicator   ///< Flag halves, U+1F1E6..U+1F1FF
+};
+
+/// Compile-time two-level codepoint property table (see file comment)
+class UnicodeTable {
+public:
+    static constexpr uint32_t kCodepoints = 0x110000;
+    static constexpr uint32_t kPageShift = 8;
+
+    // Property bits; the first three are libvterm's
+    static constexpr uint8_t kWidthMask = VTERM_UNICODE_WIDTH_MASK;     ///< Columns: 0, 1 or 2
+    static constexpr uint8_t kControl = VTERM_UNICODE_CONTROL;          ///< Width -1
+    static constexpr uint8_t kCombining = VTERM_UNICODE_COMBINING;      ///< Joins the previous glyph
+    static constexpr uint8_t kZeroWidthJoiner = 0x10;
+    static constexpr uint8_t kRegionalIndicator = 0x20;
+
+    /// Get a codepoint's property bits (beyond Unicode: a narrow character)
+    [[nodiscard]] static uint8_t GetProperties(uint32_t codepoint) noexcept {
+        if (codepoint >= kCodepoints) {
+            return 1;
+        }
+        return s_pages[static_cast<size_t>(s_index[codepoint >> kPageShift]) << kPageShift |
+                       (codepoint & 0xFF)];
+    }
+
+    /// Get a codepoint's width in cells, as libvterm counts it
+    /// @return 0, 1 or 2; -1 for a control character
+    [[nodiscard]] static int GetWidth(uint32_t codepoint) noexcept {
+        const uint8_t properties = GetProperties(codepoint);
+        return (properties & kControl) ? -1 : properties & kWidthMask;
+    }
+
+    /// Check if a codepoint joins the glyph before it
+    [[nodiscard]] static bool IsCombining(uint32_t codepoint) noexcept {
+        return (GetProperties(codepoint) & kCombining) != 0;
+    }
+
+    /// Get a codepoint's grapheme cluster break property
+    [[nodiscard]] static GraphemeBreak GetGraphemeBreak(uint32_t codepoint) noexcept {
+        const uint8_t properties = GetProperties(codepoint);
+        return (properties & kZeroWidthJoiner)    ? GraphemeBreak::ZeroWidthJoiner
+             : (properties & kCombining)          ? GraphemeBreak::Extend
+             : (properties & kControl)            ? GraphemeBreak::Control
+             : (properties & kRegionalIndicator)  ? GraphemeBreak::RegionalIndicator
+                                                  : GraphemeBreak::Other;
+    }
+
+    /// Get the table in the form libvterm reads
+    [[nodiscard]] static const VTermUnicodeTable& GetVTermTable() noexcept;
+
+    /// Get the number of 256-entry pages stored
+    [[nodiscard]] static size_t GetPageCount() noexcept;
+
+private:
+    static const uint16_t* const s_index;   ///< kCodepoints >> kPageShift page numbers
+    static const uint8_t* const s_pages;    ///< GetPageCount() pages of 256 entries
+};
+
+} // namespace Console3::Emulation
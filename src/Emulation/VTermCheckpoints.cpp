@@ -0,0 +1,636 @@
+// Console3 - VTermCheckpoints.cpp
+// Points in a long output stream where parsing can start over, with the state to start from
+
+#include "Emulation/VTermCheckpoints.h"
+#include "Core/Varint.h"
+
+#include <algorithm>
+#include <array>
+
+namespace Console3::Emulation {
+
+namespace {
+
+constexpr std::string_view kMagic = "C3CK";
+constexpr uint64_t kVersion = 1;
+
+constexpr size_t kMaxParams = 32;
+constexpr uint32_t kMaxParam = 65535;
+
+using Core::GetVarint;
+using Core::PutVarint;
+
+/// Append a color's SGR parameters
+/// @param base 30 for the foreground, 40 for the background
+void AppendColor(std::string& out, const VTermCheckpointColor& color, int base) {
+    if (color.kind == 1 && color.value < 8) {
+        out += ';' + std::to_string(base + static_cast<int>(color.value));
+    } else if (color.kind == 1 && color.value < 16) {
+        out += ';' + std::to_string(base + 60 + static_cast<int>(color.value) - 8);
+    } else if (color.kind == 1) {
+        out += ';' + std::to_string(base + 8) + ";5;" + std::to_string(color.value);
+    } else if (color.kind == 2) {
+        out += ';' + std::to_string(base + 8) + ";2;" + std::to_string((color.value >> 16) & 0xFF) + ';' +
+               std::to_string((color.value >> 8) & 0xFF) + ';' + std::to_string(color.value & 0xFF);
+    }
+}
+
+/// The first pass (see file comment): an escape sequence recognizer that
+/// keeps only the state a line inherits
+class Scanner {
+public:
+    Scanner(int rows, uint64_t interval)
+        : m_rows(std::max(rows, 1)), m_interval(std::max<uint64_t>(interval, 1)), m_next(m_interval) {
+        m_result.rows = m_rows;
+    }
+
+    VTermCheckpoints Run(std::string_view data) {
+        for (m_offset = 0; m_offset < data.size(); ++m_offset) {
+            Byte(static_cast<uint8_t>(data[m_offset]));
+        }
+        // A candidate still waiting for its quiet lines is dropped: the
+        // output after it may not have pushed the screen above it away
+        m_result.size = data.size();
+        m_result.lines = m_lines;
+        return std::move(m_result);
+    }
+
+private:
+    enum class State { Ground, Escape, EscapeIntermediate, Csi, String, StringEscape };
+
+    void Byte(uint8_t c) {
+        switch (m_state) {
+        case State::Ground:
+            if (c == 0x1B) {
+                m_state = State::Escape;
+            } else if (c < 0x20) {
+                Control(c);
+            } else {
+                m_lineStart = false;
+            }
+            return;
+        case State::Escape:
+            Escape(c);
+            return;
+        case State::EscapeIntermediate:
+            EscapeIntermediate(c);
+            return;
+        case State::Csi:
+            CsiByte(c);
+            return;
+        case State::String:
+            if (c == 0x07 || c == 0x18 || c == 0x1A) {
+                m_state = State::Ground;
+            } else if (c == 0x1B) {
+                m_state = State::StringEscape;
+            }
+            return;
+        case State::StringEscape:
+            // ESC \ ends the string; any other ESC starts a new sequence
+            m_state = State::Ground;
+            if (c != '\\') {
+                Escape(c);
+            }
+            return;
+        }
+    }
+
+    /// C0 control, in any state but strings
+    void Control(uint8_t c) {
+        switch (c) {
+        case '\r':
+            m_lineStart = true;
+            break;
+        case '\n':
+        case 0x0B:
+        case 0x0C:
+            LineFeed();
+            break;
+        case 0x0E:
+            m_current.shift = 1;
+            break;
+        case 0x0F:
+            m_current.shift = 0;
+            break;
+        case 0x18:
+        case 0x1A:
+            m_state = State::Ground;
+            break;
+        case 0x07:
+        case 0x08:
+            break;
+        default:
+            m_lineStart = false;
+            break;
+        }
+    }
+
+    void Escape(uint8_t c) {
+        m_state = State::Ground;
+        if (c < 0x20) {
+            // Controls take effect inside a sequence; ESC starts it over
+            m_state = State::Escape;
+            if (c != 0x1B) {
+                Control(c);
+            }
+            return;
+        }
+        switch (c) {
+        case '[':
+            m_state = State::Csi;
+            m_params.clear();
+            m_subParams.clear();
+            m_param = 0;
+            m_hasParam = false;
+            m_sub = false;
+            m_leader = 0;
+            m_intermediate = 0;
+            return;
+        case ']':
+        case 'X':
+        case '^':
+        case '_':
+            m_state = State::String;
+            return;
+        case 'P':
+            // DCS: sixel images and the like anchor to rows
+            m_state = State::String;
+            Address();
+            return;
+        case 'D':
+            LineFeed();
+            return;
+        case 'E':
+            m_lineStart = true;
+            LineFeed();
+            return;
+        case 'n':
+            m_current.shift = 2;
+            return;
+        case 'o':
+            m_current.shift = 3;
+            return;
+        case 'c':
+            m_current = VTermCheckpoint{};
+            m_regionFull = true;
+            m_alternate = false;
+            Address();
+            return;
+        case '=':
+        case '>':
+        case '\\':
+        case 'N':
+        case 'O':
+        case '~':
+        case '}':
+        case '|':
+            return;
+        default:
+            break;
+        }
+        if (c <= 0x2F) {
+            m_state = State::EscapeIntermediate;
+            m_intermediate = c;
+            m_extra = false;
+            return;
+        }
+        // RI, DECSC/DECRC, HTS and anything else not modelled
+        Address();
+    }
+
+    void EscapeIntermediate(uint8_t c) {
+        if (c < 0x20) {
+            Control(c);
+            return;
+        }
+        if (c <= 0x2F) {
+            m_extra = true;
+            return;
+        }
+        m_state = State::Ground;
+        constexpr std::string_view kDesignators = "()*+-./";
+        const size_t slot = kDesignators.find(static_cast<char>(m_intermediate));
+        if (slot < 4 && !m_extra) {
+            m_current.charsets[slot] = static_cast<char>(c);
+        } else if (slot != std::string_view::npos || (m_intermediate == '#' && c == '8')) {
+            // 96-character and multi-byte designations, DECALN
+            Address();
+        }
+    }
+
+    void CsiByte(uint8_t c) {
+        if (c >= '0' && c <= '9') {
+            m_param = std::min<uint32_t>(m_param * 10 + (c - '0'), kMaxParam);
+            m_hasParam = true;
+        } else if (c == ';' || c == ':') {
+            PushParam();
+            m_sub = c == ':';
+        } else if (c >= 0x3C && c <= 0x3F) {
+            m_leader = c;
+        } else if (c >= 0x20 && c <= 0x2F) {
+            m_intermediate = c;
+        } else if (c >= 0x40 && c <= 0x7E) {
+            PushParam();
+            m_state = State::Ground;
+            Csi(c);
+        } else if (c == 0x1B) {
+            m_state = State::Escape;
+        } else if (c < 0x20) {
+            Control(c);
+        }
+    }
+
+    void PushParam() {
+        if (m_params.size() < kMaxParams) {
+            m_params.push_back(m_hasParam ? m_param : kMaxParam + 1);
+            m_subParams.push_back(m_sub);
+        }
+        m_param = 0;
+        m_hasParam = false;
+        m_sub = false;
+    }
+
+    /// Get a parameter, with the default for a missing one
+    [[nodiscard]] uint32_t Param(size_t index, uint32_t fallback) const noexcept {
+        return index < m_params.size() && m_params[index] <= kMaxParam ? m_params[index] : fallback;
+    }
+
+    void Csi(uint8_t final) {
+        if (m_intermediate != 0) {
+            // DECSCUSR and DECRQM are harmless; soft reset, DECSCA and the
+            // rectangle operations are not modelled
+            if (!((m_intermediate == ' ' && final == 'q') || (m_intermediate == '$' && final == 'p'))) {
+                Address();
+            }
+            return;
+        }
+        if (m_leader == '?') {
+            if (final == 'h' || final == 'l') {
+                for (size_t index = 0; index < m_params.size(); ++index) {
+                    PrivateMode(Param(index, 0), final == 'h');
+                }
+            } else if (final == 'J' || final == 'K') {
+                Address();
+            }
+            return;
+        }
+        if (m_leader != 0) {
+            return;
+        }
+
+        switch (final) {
+        case 'm':
+            Sgr();
+            return;
+        case 'h':
+        case 'l':
+            for (size_t index = 0; index < m_params.size(); ++index) {
+                const uint32_t mode = Param(index, 0);
+                SetMode(mode == 4 ? VTermCheckpoint::kInsert : mode == 20 ? VTermCheckpoint::kNewline : 0,
+                        final == 'h');
+            }
+            return;
+        case 'r':
+            m_current.scrollTop = std::max(static_cast<int>(Param(0, 1)) - 1, 0);
+            m_current.scrollBottom = static_cast<int>(Param(1, 0));
+            if (m_current.scrollBottom >= m_rows) {
+                m_current.scrollBottom = 0;
+            }
+            m_regionFull = m_current.scrollTop == 0 && m_current.scrollBottom == 0;
+            Address();
+            return;
+        // Within the cursor's row: erase, insert, delete, repeat, moves
+        // along the row, reports
+        case 'K':
+        case 'X':
+        case '@':
+        case 'P':
+        case 'b':
+        case 'G':
+        case '`':
+        case 'C':
+        case 'D':
+        case 'a':
+        case 'I':
+        case 'Z':
+        case 'n':
+        case 'c':
+        case 's':
+        case 'i':
+        case 'x':
+            m_lineStart = m_lineStart && std::string_view("KX@Pncsix").find(static_cast<char>(final)) !=
+                                             std::string_view::npos;
+            return;
+        default:
+            // CUP, CUU, CUD, VPA, ED, IL, DL, SU, SD, TBC, restore cursor,
+            // window operations, ...
+            Address();
+            return;
+        }
+    }
+
+    void PrivateMode(uint32_t mode, bool set) {
+        switch (mode) {
+        case 7:
+            SetMode(VTermCheckpoint::kAutowrap, set);
+            return;
+        case 6:
+            // Also homes the cursor
+            SetMode(VTermCheckpoint::kOrigin, set);
+            Address();
+            return;
+        case 47:
+        case 1047:
+        case 1049:
+            m_alternate = set;
+            Address();
+            return;
+        case 3:
+        case 69:
+            // DECCOLM resizes; DECLRMM turns CSI s into margins
+            Address();
+            return;
+        default:
+            return;
+        }
+    }
+
+    void SetMode(uint32_t bit, bool set) noexcept {
+        m_current.modes = set ? m_current.modes | bit : m_current.modes & ~bit;
+    }
+
+    void Sgr() {
+        if (m_params.empty()) {
+            ResetPen();
+            return;
+        }
+        for (size_t index = 0; index < m_params.size(); ++index) {
+            const uint32_t code = Param(index, 0);
+            // Sub-parameters that follow this one
+            size_t subs = 0;
+            while (index + 1 + subs < m_params.size() && m_subParams[index + 1 + subs]) {
+                ++subs;
+            }
+            switch (code) {
+            case 0: ResetPen(); break;
+            case 1: m_current.attrs |= VTermCheckpoint::kBold; break;
+            case 22: m_current.attrs &= ~VTermCheckpoint::kBold; break;
+            case 3: m_current.attrs |= VTermCheckpoint::kItalic; break;
+            case 23: m_current.attrs &= ~VTermCheckpoint::kItalic; break;
+            case 4:
+                m_current.underline = subs > 0 ? static_cast<uint8_t>(std::min<uint32_t>(Param(index + 1, 1), 3)) : 1;
+                break;
+            case 21: m_current.underline = 2; break;
+            case 24: m_current.underline = 0; break;
+            case 5:
+            case 6: m_current.attrs |= VTermCheckpoint::kBlink; break;
+            case 25: m_current.attrs &= ~VTermCheckpoint::kBlink; break;
+            case 7: m_current.attrs |= VTermCheckpoint::kReverse; break;
+            case 27: m_current.attrs &= ~VTermCheckpoint::kReverse; break;
+            case 8: m_current.attrs |= VTermCheckpoint::kConceal; break;
+            case 28: m_current.attrs &= ~VTermCheckpoint::kConceal; break;
+            case 9: m_current.attrs |= VTermCheckpoint::kStrike; break;
+            case 29: m_current.attrs &= ~VTermCheckpoint::kStrike; break;
+            case 39: m_current.fg = {}; break;
+            case 49: m_current.bg = {}; break;
+            case 38:
+            case 48:
+            case 58: {
+                // 58 (underline color) is not kept in cells; its arguments
+                // are skipped all the same
+                VTermCheckpointColor color;
+                index += ExtendedColor(index, subs, color);
+                if (code == 38) {
+                    m_current.fg = color;
+                } else if (code == 48) {
+                    m_current.bg = color;
+                }
+                continue;
+            }
+            default:
+                if (code >= 30 && code <= 37) {
+                    m_current.fg = {1, code - 30};
+                } else if (code >= 40 && code <= 47) {
+                    m_current.bg = {1, code - 40};
+                } else if (code >= 90 && code <= 97) {
+                    m_current.fg = {1, code - 90 + 8};
+                } else if (code >= 100 && code <= 107) {
+                    m_current.bg = {1, code - 100 + 8};
+                }
+                break;
+            }
+            index += subs;
+        }
+    }
+
+    /// Read 38/48/58's arguments, in the ':' or the ';' form
+    /// @return Parameters consumed after the code
+    size_t ExtendedColor(size_t index, size_t subs, VTermCheckpointColor& color) const {
+        const bool colon = subs > 0;
+        const size_t available = colon ? subs : m_params.size() - index - 1;
+        const uint32_t kind = Param(index + 1, 0);
+        if (kind == 5 && available >= 2) {
+            color = {1, std::min<uint32_t>(Param(index + 2, 0), 255)};
+            return colon ? subs : 2;
+        }
+        if (kind == 2 && available >= 4) {
+            // 38:2:<colorspace>:r:g:b carries one more
+            const size_t first = colon && available >= 5 ? index + 3 : index + 2;
+            color = {2, (std::min<uint32_t>(Param(first, 0), 255) << 16) |
+                            (std::min<uint32_t>(Param(first + 1, 0), 255) << 8) |
+                            std::min<uint32_t>(Param(first + 2, 0), 255)};
+            return colon ? subs : 4;
+        }
+        color = {};
+        return colon ? subs : std::min<size_t>(available, 1);
+    }
+
+    void ResetPen() noexcept {
+        m_current.attrs = 0;
+        m_current.underline = 0;
+        m_current.fg = {};
+        m_current.bg = {};
+    }
+
+    /// A sequence put the cursor on a row of its choosing
+    void Address() noexcept {
+        m_lastAddress = m_lines;
+        m_addressed = true;
+        m_pending.reset();
+        m_lineStart = false;
+    }
+
+    void LineFeed() {
+        ++m_lines;
+        if (m_current.modes & VTermCheckpoint::kNewline) {
+            m_lineStart = true;
+        }
+
+        const auto rows = static_cast<uint64_t>(m_rows);
+        if (m_pending) {
+            if (m_lines - m_pending->lines >= rows) {
+                m_result.points.push_back(*m_pending);
+                m_next = m_pending->offset + m_interval;
+                m_pending.reset();
+            }
+            return;
+        }
+        const uint64_t offset = m_offset + 1;
+        if (offset < m_next || !m_lineStart || m_alternate || !m_regionFull || m_lines < rows ||
+            (m_addressed && m_lines - m_lastAddress < rows)) {
+            return;
+        }
+        m_pending = m_current;
+        m_pending->offset = offset;
+        m_pending->lines = m_lines;
+    }
+
+    const int m_rows;
+    const uint64_t m_interval;
+    VTermCheckpoints m_result;
+
+    uint64_t m_offset = 0;
+    uint64_t m_lines = 0;
+    uint64_t m_next;                    ///< Offset the next checkpoint may be at
+    uint64_t m_lastAddress = 0;         ///< Line feeds before the last cursor placement
+    bool m_addressed = false;
+    std::optional<VTermCheckpoint> m_pending;   ///< Waiting for its quiet lines after
+
+    VTermCheckpoint m_current;          ///< What a line started now would inherit
+    bool m_lineStart = true;            ///< The cursor is in column 0
+    bool m_alternate = false;
+    bool m_regionFull = true;
+
+    State m_state = State::Ground;
+    std::vector<uint32_t> m_params;     ///< kMaxParam + 1 for a missing one
+    std::vector<bool> m_subParams;      ///< Introduced by ':'
+    uint32_t m_param = 0;
+    bool m_hasParam = false;
+    bool m_sub = false;
+    uint8_t m_leader = 0;
+    uint8_t m_intermediate = 0;
+    bool m_extra = false;               ///< More than one escape intermediate
+};
+
+} // namespace
+
+void VTermCheckpoint::AppendRestore(std::string& out) const {
+    out += "\x1b[0";
+    if (attrs & kBold) out += ";1";
+    if (attrs & kItalic) out += ";3";
+    if (underline == 1) out += ";4";
+    if (underline == 2) out += ";21";
+    if (underline == 3) out += ";4:3";
+    if (attrs & kBlink) out += ";5";
+    if (attrs & kReverse) out += ";7";
+    if (attrs & kConceal) out += ";8";
+    if (attrs & kStrike) out += ";9";
+    AppendColor(out, fg, 30);
+    AppendColor(out, bg, 40);
+    out += 'm';
+
+    if (!(modes & kAutowrap)) out += "\x1b[?7l";
+    if (modes & kInsert) out += "\x1b[4h";
+    if (modes & kNewline) out += "\x1b[20h";
+    for (size_t slot = 0; slot < 4; ++slot) {
+        if (charsets[slot] != 0) {
+            out += '\x1b';
+            out += "()*+"[slot];
+            out += charsets[slot];
+        }
+    }
+    if (shift == 1) out += '\x0E';
+    if (shift == 2) out += "\x1bn";
+    if (shift == 3) out += "\x1bo";
+    if (scrollTop != 0 || scrollBottom != 0) {
+        out += "\x1b[" + std::to_string(scrollTop + 1) + ';' +
+               (scrollBottom != 0 ? std::to_string(scrollBottom) : std::string()) + 'r';
+    }
+    // Last: setting it homes the cursor within the region
+    if (modes & kOrigin) out += "\x1b[?6h";
+}
+
+void VTermCheckpoints::Serialize(std::string& out) const {
+    out += kMagic;
+    PutVarint(out, kVersion);
+    PutVarint(out, static_cast<uint64_t>(rows));
+    PutVarint(out, size);
+    PutVarint(out, lines);
+    PutVarint(out, points.size());
+    uint64_t offset = 0;
+    uint64_t lineCount = 0;
+    for (const VTermCheckpoint& point : points) {
+        PutVarint(out, point.offset - offset);
+        PutVarint(out, point.lines - lineCount);
+        offset = point.offset;
+        lineCount = point.lines;
+        PutVarint(out, point.attrs);
+        PutVarint(out, point.underline);
+        PutVarint(out, point.fg.kind);
+        PutVarint(out, point.fg.value);
+        PutVarint(out, point.bg.kind);
+        PutVarint(out, point.bg.value);
+        PutVarint(out, point.modes);
+        for (const char charset : point.charsets) {
+            PutVarint(out, static_cast<uint8_t>(charset));
+        }
+        PutVarint(out, point.shift);
+        PutVarint(out, static_cast<uint64_t>(point.scrollTop));
+        PutVarint(out, static_cast<uint64_t>(point.scrollBottom));
+    }
+}
+
+std::optional<VTermCheckpoints> VTermCheckpoints::Deserialize(std::string_view in) {
+    if (!in.starts_with(kMagic)) {
+        return std::nullopt;
+    }
+    size_t pos = kMagic.size();
+    uint64_t version = 0, rows = 0, count = 0;
+    VTermCheckpoints result;
+    if (!GetVarint(in, pos, version) || version != kVersion || !GetVarint(in, pos, rows) || rows == 0 ||
+        rows > kMaxParam || !GetVarint(in, pos, result.size) || !GetVarint(in, pos, result.lines) ||
+        !GetVarint(in, pos, count) || count > in.size()) {
+        return std::nullopt;
+    }
+    result.rows = static_cast<int>(rows);
+    result.points.resize(static_cast<size_t>(count));
+
+    // offset, lines, attrs, underline, fg kind/value, bg kind/value, modes,
+    // G0-G3, shift, scroll top/bottom
+    uint64_t offset = 0;
+    uint64_t lineCount = 0;
+    for (VTermCheckpoint& point : result.points) {
+        std::array<uint64_t, 16> fields{};
+        for (uint64_t& field : fields) {
+            if (!GetVarint(in, pos, field)) {
+                return std::nullopt;
+            }
+        }
+        offset += fields[0];
+        lineCount += fields[1];
+        if (offset > result.size || lineCount > result.lines || fields[4] > 2 || fields[6] > 2 ||
+            fields[13] > 3 || fields[14] > rows || fields[15] > rows) {
+            return std::nullopt;
+        }
+        point.offset = offset;
+        point.lines = lineCount;
+        point.attrs = static_cast<uint32_t>(fields[2]);
+        point.underline = static_cast<uint8_t>(std::min<uint64_t>(fields[3], 3));
+        point.fg = {static_cast<uint8_t>(fields[4]), static_cast<uint32_t>(fields[5] & 0xFFFFFF)};
+        point.bg = {static_cast<uint8_t>(fields[6]), static_cast<uint32_t>(fields[7] & 0xFFFFFF)};
+        point.modes = static_cast<uint32_t>(fields[8]);
+        for (size_t slot = 0; slot < 4; ++slot) {
+            point.charsets[slot] = static_cast<char>(fields[9 + slot] & 0x7F);
+        }
+        point.shift = static_cast<uint8_t>(fields[13]);
+        point.scrollTop = static_cast<int>(fields[14]);
+        point.scrollBottom = static_cast<int>(fields[15]);
+    }
+    return result;
+}
+
+VTermCheckpoints FindCheckpoints(std::string_view data, int rows, uint64_t interval) {
+    return Scanner(rows, interval).Run(data);
+}
+
+} // namespace Console3::Emulation
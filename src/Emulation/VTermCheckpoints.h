@@ -0,0 +1,103 @@
+#pragma once
+// Console3 - VTermCheckpoints.h
+// Points in a long output stream where parsing can start over, with the state to start from
+//
+// libvterm parses one byte after another, so replaying a recording of
+// several hundred megabytes keeps one core busy for as long as that takes.
+// FindCheckpoints makes a quick first pass that draws nothing: it follows
+// the escape sequences only as far as the state a new line inherits - the
+// pen (SGR), the insert, newline, autowrap and origin modes, the designated
+// character sets and the scroll region - and counts line feeds.
+//
+// About every interval bytes it records a checkpoint at a line start that
+// is quiet: main screen, whole-screen scroll region, and no sequence that
+// puts the cursor on a row of its choosing (CUP, CUU, VPA, ED, RI, DECSTBM,
+// an alternate screen switch, ...) within `rows` line feeds before or
+// after it. Before such a point the cursor has been on the bottom row for
+// a screenful of lines, and after it nothing reaches back up: the lines
+// that output produces are the same whether it is parsed after what came
+// before, or on a blank screen set up by the checkpoint's RestoreSequence.
+// Anything the pass does not model (tab stops, DCS strings, soft reset,
+// ...) counts as cursor placement, which only makes checkpoints sparser.
+// VTermSegmentParser.h parses the stretches between checkpoints in
+// parallel.
+//
+// Checkpoints serialize to a few bytes each (LEB128 varints), so a
+// recording opened again can skip the first pass (Session keeps them next
+// to the other caches in %LOCALAPPDATA%\Console3).
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Console3::Emulation {
+
+/// A pen color as the stream last set it
+struct VTermCheckpointColor {
+    uint8_t kind = 0;                   ///< 0 default, 1 palette index, 2 RGB
+    uint32_t value = 0;                 ///< Index, or 0xRRGGBB
+
+    bool operator==(const VTermCheckpointColor& other) const noexcept = default;
+};
+
+/// Emulator state a line inherits, at one point of the stream
+struct VTermCheckpoint {
+    // Pen attribute bits (attrs)
+    static constexpr uint32_t kBold = 1;
+    static constexpr uint32_t kItalic = 2;
+    static constexpr uint32_t kBlink = 4;
+    static constexpr uint32_t kReverse = 8;
+    static constexpr uint32_t kConceal = 16;
+    static constexpr uint32_t kStrike = 32;
+
+    // Mode bits (modes); kAutowrap is set by default
+    static constexpr uint32_t kAutowrap = 1;
+    static constexpr uint32_t kOrigin = 2;
+    static constexpr uint32_t kInsert = 4;
+    static constexpr uint32_t kNewline = 8;
+
+    uint64_t offset = 0;                ///< Byte the checkpoint is before (a line start)
+    uint64_t lines = 0;                 ///< Line feeds before it
+
+    uint32_t attrs = 0;
+    uint8_t underline = 0;              ///< 0 none, 1 single, 2 double, 3 curly
+    VTermCheckpointColor fg;
+    VTermCheckpointColor bg;
+    uint32_t modes = kAutowrap;
+    char charsets[4] = {};              ///< Final byte designating G0-G3, or 0 if never designated
+    uint8_t shift = 0;                  ///< Gn invoked into GL (SI/SO/LS2/LS3)
+    int scrollTop = 0;                  ///< Scroll region, 0-based; bottom 0 = last row
+    int scrollBottom = 0;
+
+    /// Append the VT sequences that set this state up on a freshly created
+    /// emulator (cursor home)
+    void AppendRestore(std::string& out) const;
+};
+
+/// Checkpoints of one stream (see file comment)
+struct VTermCheckpoints {
+    int rows = 0;                       ///< Screen height quietness was judged for
+    uint64_t size = 0;                  ///< Stream bytes scanned
+    uint64_t lines = 0;                 ///< Line feeds in the whole stream
+    std::vector<VTermCheckpoint> points;///< In stream order
+
+    /// Append the serialized form
+    void Serialize(std::string& out) const;
+
+    /// Read a serialized form
+    /// @return The checkpoints, or nullopt if the data is damaged
+    [[nodiscard]] static std::optional<VTermCheckpoints> Deserialize(std::string_view in);
+};
+
+/// Default bytes between checkpoints
+constexpr uint64_t kCheckpointInterval = 16ull << 20;
+
+/// Find the checkpoints of a stream (single pass, see file comment)
+/// @param rows Screen height the stream is parsed at
+/// @param interval Bytes after one checkpoint before the next is looked for
+[[nodiscard]] VTermCheckpoints FindCheckpoints(std::string_view data, int rows,
+                                               uint64_t interval = kCheckpointInterval);
+
+} // namespace Console3::Emulation
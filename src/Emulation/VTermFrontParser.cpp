@@ -0,0 +1,222 @@
+// Console3 - VTermFrontParser.cpp
+// Native fast path in front of libvterm's parser for the common VT subset
+
+#include "Emulation/VTermFrontParser.h"
+
+namespace Console3::Emulation {
+
+namespace {
+
+constexpr unsigned char kEsc = 0x1B;
+constexpr unsigned char kCsi8 = 0x9B;       ///< 8-bit CSI
+constexpr unsigned char kSt8 = 0x9C;        ///< 8-bit string terminator
+constexpr int kMaxArgs = 16;                ///< libvterm's CSI_ARGS_MAX
+constexpr long kMaxArgValue = 0xFFFF;       ///< Larger arguments are left to libvterm
+
+/// Bytes libvterm's parser passes to the text callback in ground state
+template <bool Utf8>
+constexpr bool IsText(unsigned char c) noexcept {
+    if (c < 0x20 || c == 0x7F) {
+        return false;
+    }
+    if constexpr (!Utf8) {
+        if (c >= 0x80 && c < 0xA0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// C0 controls the parser passes straight to the control callback
+/// (NUL, CAN, SUB and ESC change or depend on parser state)
+constexpr bool IsPlainControl(unsigned char c) noexcept {
+    return c < 0x20 && c != 0x00 && c != 0x18 && c != 0x1A && c != kEsc;
+}
+
+/// CUU CUD CUF CUB CUP ED EL SGR
+constexpr bool IsFastCommand(unsigned char c) noexcept {
+    switch (c) {
+        case 'A': case 'B': case 'C': case 'D': case 'H': case 'J': case 'K': case 'm':
+            return true;
+        default:
+            return false;
+    }
+}
+
+/// One past a CSI's final byte, or where it is interrupted or cut off
+const char* CsiEnd(const char* p, const char* end) noexcept {
+    while (p < end && static_cast<unsigned char>(*p) >= 0x20 && static_cast<unsigned char>(*p) <= 0x3F) {
+        ++p;
+    }
+    if (p < end && static_cast<unsigned char>(*p) >= 0x40 && static_cast<unsigned char>(*p) <= 0x7E) {
+        ++p;
+    }
+    return p;
+}
+
+/// How much to hand libvterm for the element at p, which the fast path
+/// does not take: the whole sequence when it is complete, else what there is
+template <bool Utf8>
+const char* FallbackEnd(const char* p, const char* end) noexcept {
+    const auto c = static_cast<unsigned char>(*p);
+    if constexpr (!Utf8) {
+        if (c == kCsi8) {
+            return CsiEnd(p + 1, end);
+        }
+    }
+    if (c != kEsc) {
+        return p + 1;
+    }
+
+    const char* q = p + 1;
+    if (q < end && *q == '[') {
+        return CsiEnd(q + 1, end);
+    }
+    while (q < end && static_cast<unsigned char>(*q) >= 0x20 && static_cast<unsigned char>(*q) <= 0x2F) {
+        ++q;
+    }
+    if (q < end && static_cast<unsigned char>(*q) >= 0x30 && static_cast<unsigned char>(*q) <= 0x7E) {
+        ++q;
+    }
+    return q;
+}
+
+/// One past the next byte that can end (or abort) a string
+template <bool Utf8>
+const char* StringEnd(const char* p, const char* end) noexcept {
+    for (; p < end; ++p) {
+        const auto c = static_cast<unsigned char>(*p);
+        if (c == 0x07 || c == 0x18 || c == 0x1A || c == kEsc) {
+            return p + 1;
+        }
+        if constexpr (!Utf8) {
+            if (c == kSt8) {
+                return p + 1;
+            }
+        }
+    }
+    return end;
+}
+
+} // namespace
+
+void VTermFrontParser::Write(const char* data, size_t length) {
+    if (vterm_get_utf8(m_vterm)) {
+        WriteAs<true>(data, data + length);
+    } else {
+        WriteAs<false>(data, data + length);
+    }
+}
+
+template <bool Utf8>
+void VTermFrontParser::WriteAs(const char* p, const char* end) {
+    while (p < end) {
+        switch (vterm_input_get_state(m_vterm)) {
+            case VTERM_INPUT_GROUND:
+                p = Ground<Utf8>(p, end);
+                break;
+            case VTERM_INPUT_SEQUENCE:
+                // Mid-sequence after a cut-off write: sequences are short,
+                // so feed a byte at a time until libvterm finishes it
+                Fallback(p, p + 1);
+                ++p;
+                break;
+            case VTERM_INPUT_STRING: {
+                const char* stop = StringEnd<Utf8>(p, end);
+                Fallback(p, stop);
+                p = stop;
+                break;
+            }
+        }
+    }
+}
+
+template <bool Utf8>
+const char* VTermFrontParser::Ground(const char* p, const char* end) {
+    while (p < end) {
+        const auto c = static_cast<unsigned char>(*p);
+
+        if (IsText<Utf8>(c)) {
+            const char* run = p + 1;
+            while (run < end && IsText<Utf8>(static_cast<unsigned char>(*run))) {
+                ++run;
+            }
+            m_stats.fastBytes += static_cast<uint64_t>(run - p);
+            // The state may stop early (e.g. ASCII before a combining mark)
+            while (p < run) {
+                p += vterm_input_text(m_vterm, p, static_cast<size_t>(run - p));
+            }
+            continue;
+        }
+
+        if (IsPlainControl(c)) {
+            vterm_input_control(m_vterm, c);
+            ++m_stats.fastBytes;
+            ++p;
+            continue;
+        }
+
+        const char* args = nullptr;
+        if (c == kEsc && p + 1 < end && p[1] == '[') {
+            args = p + 2;
+        } else if constexpr (!Utf8) {
+            if (c == kCsi8) {
+                args = p + 1;
+            }
+        }
+        if (args) {
+            if (const char* next = FastCsi(args, end)) {
+                m_stats.fastBytes += static_cast<uint64_t>(next - p);
+                p = next;
+                continue;
+            }
+        }
+
+        const char* stop = FallbackEnd<Utf8>(p, end);
+        Fallback(p, stop);
+        return stop;
+    }
+    return p;
+}
+
+const char* VTermFrontParser::FastCsi(const char* p, const char* end) {
+    // Arguments as libvterm's parser builds them: missing until a digit,
+    // ':' marks a subparameter and otherwise separates like ';'
+    long args[kMaxArgs];
+    int argi = 0;
+    args[0] = CSI_ARG_MISSING;
+
+    for (; p < end; ++p) {
+        const auto c = static_cast<unsigned char>(*p);
+        if (c >= '0' && c <= '9') {
+            if (args[argi] == CSI_ARG_MISSING) {
+                args[argi] = 0;
+            }
+            args[argi] = args[argi] * 10 + (c - '0');
+            if (args[argi] > kMaxArgValue) {
+                return nullptr;
+            }
+        } else if (c == ';' || c == ':') {
+            if (c == ':') {
+                args[argi] |= CSI_ARG_FLAG_MORE;
+            }
+            if (++argi == kMaxArgs) {
+                return nullptr;
+            }
+            args[argi] = CSI_ARG_MISSING;
+        } else if (IsFastCommand(c)) {
+            vterm_input_csi(m_vterm, args, argi + 1, static_cast<char>(c));
+            return p + 1;
+        } else {
+            return nullptr;
+        }
+    }
+    return nullptr;  // Cut off: libvterm keeps the partial sequence
+}
+
+void VTermFrontParser::Fallback(const char* p, const char* end) {
+    m_stats.fallbackBytes += static_cast<uint64_t>(end - p);
+    (void)vterm_input_write(m_vterm, p, static_cast<size_t>(end - p));
+}
+
+} // namespace Console3::Emulation
@@ -0,0 +1,70 @@
+#pragma once
+// Console3 - VTermFrontParser.h
+// Native fast path in front of libvterm's parser for the common VT subset
+//
+// libvterm's parser walks every byte through its state machine before the
+// state layer sees a text run, a control or a sequence. Most output uses a
+// small subset: printable runs, C0 controls (CR, LF, BS, TAB), cursor moves
+// (CUU/CUD/CUF/CUB/CUP), erases (ED/EL) and SGR, including 256-color and
+// truecolor forms. In ground state the front parser recognises those itself
+// and hands each to the state layer through vterm_input_text/control/csi -
+// the callbacks the parser would call, with the arguments it would pass, so
+// the screen ends up identical by construction.
+//
+// Everything else goes through vterm_input_write() whole: other escapes,
+// CSIs with leader or intermediate bytes, strings (OSC, DCS, ...), C1
+// controls, NUL/DEL/CAN/SUB, and sequences cut off at the end of a write.
+// Whenever libvterm is left inside a sequence or string, input keeps going
+// to it until it is back in ground state.
+//
+// The scanner is compiled once per encoding: in UTF-8 mode bytes 0x80-0x9F
+// are continuation bytes inside text runs, in 8-bit mode they are C1
+// controls and 0x9B introduces a CSI.
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+#include <vterm.h>
+}
+
+namespace Console3::Emulation {
+
+/// Bytes by path taken (owner thread)
+struct FrontParserStats {
+    uint64_t fastBytes = 0;     ///< Handled by the front parser
+    uint64_t fallbackBytes = 0; ///< Passed to vterm_input_write()
+};
+
+/// Fast path for the common VT subset (see file comment)
+class VTermFrontParser {
+public:
+    explicit VTermFrontParser(VTerm* vterm) noexcept : m_vterm(vterm) {}
+
+    /// Parse output bytes; all of them are consumed
+    void Write(const char* data, size_t length);
+
+    [[nodiscard]] const FrontParserStats& GetStats() const noexcept { return m_stats; }
+
+private:
+    template <bool Utf8>
+    void WriteAs(const char* data, const char* end);
+
+    /// Handle input in ground state until something goes to libvterm
+    /// @return Where to continue
+    template <bool Utf8>
+    const char* Ground(const char* p, const char* end);
+
+    /// Apply a CSI if it is one of the fast commands with plain arguments
+    /// @param p First byte after the introducer
+    /// @return One past its final byte, or nullptr to leave it to libvterm
+    const char* FastCsi(const char* p, const char* end);
+
+    /// Pass bytes through libvterm's own parser
+    void Fallback(const char* p, const char* end);
+
+    VTerm* m_vterm;
+    FrontParserStats m_stats;
+};
+
+} // namespace Console3::Emulation
@@ -0,0 +1,386 @@
+// Console3 - VTermGrid.cpp
+// libvterm state layer writing straight into a terminal buffer
+
+#include "Emulation/VTermGrid.h"
+#include "Core/TerminalBuffer.h"
+#include "Emulation/VTermHeap.h"
+#include "Emulation/VTermWrapper.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+
+namespace Console3::Emulation {
+
+namespace {
+
+/// Translate a libvterm pen color for the terminal buffer
+Core::CellColor ToCellColor(const VTermColor& color) {
+    if (VTERM_COLOR_IS_DEFAULT_FG(&color) || VTERM_COLOR_IS_DEFAULT_BG(&color)) {
+        return Core::CellColor::Default();
+    }
+    if (VTERM_COLOR_IS_INDEXED(&color)) {
+        return Core::CellColor::Indexed(color.indexed.idx);
+    }
+    return Core::CellColor::Rgb(color.rgb.red, color.rgb.green, color.rgb.blue);
+}
+
+} // namespace
+
+VTermGrid::VTermGrid(VTermWrapper& owner, VTermHeap& heap, Core::TerminalBuffer& buffer)
+    : m_owner(owner)
+    , m_heap(heap)
+    , m_buffer(buffer) {
+}
+
+void VTermGrid::Attach(VTerm* vterm) {
+    static const VTermStateCallbacks callbacks = [] {
+        VTermStateCallbacks result{};
+        result.putglyph = &VTermGrid::OnPutGlyph;
+        result.putglyphs = &VTermGrid::OnPutGlyphs;
+        result.movecursor = &VTermGrid::OnMoveCursor;
+        result.premove = &VTermGrid::OnPreMove;
+        result.scrollrect = &VTermGrid::OnScrollRect;
+        result.moverect = &VTermGrid::OnMoveRect;
+        result.erase = &VTermGrid::OnErase;
+        result.initpen = &VTermGrid::OnInitPen;
+        result.setpenattr = &VTermGrid::OnSetPenAttr;
+        result.settermprop = &VTermGrid::OnSetTermProp;
+        result.bell = &VTermGrid::OnBell;
+        result.resize = &VTermGrid::OnResize;
+        return result;
+    }();
+
+    int rows = 0;
+    int cols = 0;
+    vterm_get_size(vterm, &rows, &cols);
+    if (m_buffer.GetRows() != rows || m_buffer.GetCols() != cols) {
+        m_buffer.Resize(rows, cols, false);
+    }
+
+    m_state = vterm_obtain_state(vterm);
+    vterm_state_set_callbacks(m_state, &callbacks, this);
+    vterm_state_callbacks_has_premove(m_state);
+    vterm_state_callbacks_has_putglyphs(m_state);
+    vterm_state_reset(m_state, 1);
+}
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+std::span<Core::Cell> VTermGrid::Row(int row) const {
+    if (row < 0 || row >= m_buffer.GetRows()) {
+        return {};
+    }
+    return m_buffer.GetRow(row);
+}
+
+void VTermGrid::SplitWide(std::span<Core::Cell> cells, int col) const {
+    if (col > 0 && col < static_cast<int>(cells.size()) && cells[col - 1].width > 1) {
+        cells[col - 1].width = 1;
+    }
+}
+
+void VTermGrid::SyncContinuation(int row) const {
+    const VTermLineInfo* info = vterm_state_get_lineinfo(m_state, row);
+    m_buffer.SetContinuation(row, info && info->continuation);
+}
+
+VTermLineInfo* VTermGrid::ReplaceLineInfo(VTermLineInfo* old, int rows, bool wrap) const {
+    const VTermAllocatorFunctions* allocator = VTermHeap::GetFunctions();
+    if (old) {
+        allocator->free(old, &m_heap);
+    }
+
+    // Zeroed by the allocator: no double width, no wrap
+    auto* info = static_cast<VTermLineInfo*>(allocator->malloc(sizeof(VTermLineInfo) * rows, &m_heap));
+    if (info && wrap) {
+        for (int row = 0; row < rows; ++row) {
+            info[row].continuation = m_buffer.IsContinuation(row) ? 1 : 0;
+        }
+    }
+    return info;
+}
+
+// ============================================================================
+// State Callbacks
+// ============================================================================
+
+int VTermGrid::OnPutGlyph(VTermGlyphInfo* info, VTermPos pos, void* user) {
+    auto* self = static_cast<VTermGrid*>(user);
+    const std::span<Core::Cell> cells = self->Row(pos.row);
+    if (pos.col < 0 || pos.col >= static_cast<int>(cells.size())) {
+        return 0;
+    }
+
+    // The base character and up to kMaxCombining combining characters
+    uint32_t combining[Core::GraphemeTable::kMaxCombining] = {};
+    for (size_t i = 0; info->chars[0] != 0 && i < Core::GraphemeTable::kMaxCombining &&
+                       i + 1 < VTERM_MAX_CHARS_PER_CELL && info->chars[i + 1] != 0;
+         ++i) {
+        combining[i] = info->chars[i + 1];
+    }
+
+    self->SplitWide(cells, pos.col);
+    const int end = std::min(pos.col + std::max(info->width, 1), static_cast<int>(cells.size()));
+    Core::Cell glyph = self->m_pen;
+    glyph.SetChars(info->chars[0] != 0 ? info->chars[0] : U' ', combining);
+    glyph.width = static_cast<uint32_t>(end - pos.col);
+
+    // The right half of a wide character, as libvterm marks it
+    Core::Cell rightHalf = self->m_pen;
+    rightHalf.SetCodepoint(Core::Cell::kContinuation);
+
+    // A glyph redrawn as it was is not damage
+    bool changed = cells[pos.col] != glyph;
+    cells[pos.col] = glyph;
+    for (int col = pos.col + 1; col < end; ++col) {
+        changed |= cells[col] != rightHalf;
+        cells[col] = rightHalf;
+    }
+
+    if (pos.col == 0) {
+        self->SyncContinuation(pos.row);
+    }
+    if (changed) {
+        self->m_buffer.MarkDirty(pos.row, pos.col, end);
+    }
+    return 1;
+}
+
+int VTermGrid::OnPutGlyphs(const uint32_t chars[], int count, const VTermGlyphInfo* info, VTermPos pos,
+                           void* user) {
+    (void)info;
+    auto* self = static_cast<VTermGrid*>(user);
+    const std::span<Core::Cell> cells = self->Row(pos.row);
+    if (count <= 0 || pos.col < 0 || pos.col + count > static_cast<int>(cells.size())) {
+        return 0;
+    }
+
+    // A run of plain glyphs in one pen: a fill and one codepoint per cell.
+    // Redrawn lines (a TUI's full repaint, ConPTY resending a row) mostly
+    // write what is there; only the cells that change are damage.
+    self->SplitWide(cells, pos.col);
+    Core::Cell* cell = cells.data() + pos.col;
+    int first = count;
+    int last = 0;
+    for (int i = 0; i < count; ++i, ++cell) {
+        Core::Cell next = self->m_pen;
+        next.SetCodepoint(chars[i]);
+        if (*cell != next) {
+            *cell = next;
+            first = std::min(first, i);
+            last = i + 1;
+        }
+    }
+
+    if (pos.col == 0) {
+        self->SyncContinuation(pos.row);
+    }
+    if (first < last) {
+        self->m_buffer.MarkDirty(pos.row, pos.col + first, pos.col + last);
+    }
+    return 1;
+}
+
+int VTermGrid::OnMoveCursor(VTermPos pos, VTermPos oldpos, int visible, void* user) {
+    return VTermWrapper::OnMoveCursor(pos, oldpos, visible, &static_cast<VTermGrid*>(user)->m_owner);
+}
+
+int VTermGrid::OnPreMove(VTermRect rect, void* user) {
+    // Rows about to scroll off the top of the primary screen go to the
+    // scrollback first, as the screen layer pushes them
+    auto* self = static_cast<VTermGrid*>(user);
+    if (rect.start_row != 0 || rect.start_col != 0 || rect.end_col != self->m_buffer.GetCols() ||
+        self->m_buffer.IsAlternateScreen()) {
+        return 1;
+    }
+
+    const int end = std::min(rect.end_row, self->m_buffer.GetRows());
+    for (int row = 0; row < end; ++row) {
+        const VTermLineInfo* info = vterm_state_get_lineinfo(self->m_state, row);
+        self->m_owner.PushScrollbackRow(self->m_buffer.GetRow(row), info && info->continuation);
+    }
+    return 1;
+}
+
+int VTermGrid::OnScrollRect(VTermRect rect, int downward, int rightward, void* user) {
+    auto* self = static_cast<VTermGrid*>(user);
+    const int height = rect.end_row - rect.start_row;
+
+    // Whole rows: rotate them (the state has moved its line infos alike)
+    if (rightward == 0 && rect.start_col == 0 && rect.end_col == self->m_buffer.GetCols() &&
+        std::abs(downward) < height) {
+        self->m_buffer.MoveRows(downward, rect.start_row, rect.end_row);
+
+        // The exposed rows take the pen's colors
+        VTermRect exposed = rect;
+        if (downward > 0) {
+            exposed.start_row = rect.end_row - downward;
+        } else {
+            exposed.end_row = rect.start_row - downward;
+        }
+        if (!self->m_erase.bg.IsDefault() || !self->m_erase.fg.IsDefault()) {
+            OnErase(exposed, 0, user);
+        }
+        return 1;
+    }
+
+    // Inside left/right margins: each row's columns in one copy, the exposed
+    // cells taking the pen's colors, all in one pass
+    if (rightward == 0) {
+        self->m_buffer.MoveRect(downward, rect.start_row, rect.end_row, rect.start_col, rect.end_col,
+                                self->m_erase);
+        const int count = std::min(std::abs(downward), height);
+        const int exposed = downward > 0 ? rect.end_row - count : rect.start_row;
+        for (int row = exposed; row < exposed + count; ++row) {
+            if (const std::span<Core::Cell> cells = self->Row(row); !cells.empty()) {
+                self->SplitWide(cells, rect.start_col);
+            }
+        }
+        if (rect.end_col == self->m_buffer.GetCols()) {
+            for (int row = exposed + 1; row < std::min(exposed + count + 1, self->m_buffer.GetRows()); ++row) {
+                self->SyncContinuation(row);
+            }
+        }
+        return 1;
+    }
+
+    vterm_scroll_rect(rect, downward, rightward, &VTermGrid::OnMoveRect, &VTermGrid::OnErase, user);
+    return 1;
+}
+
+int VTermGrid::OnMoveRect(VTermRect dest, VTermRect src, void* user) {
+    auto* self = static_cast<VTermGrid*>(user);
+    const int cols = std::min(src.end_col - src.start_col, dest.end_col - dest.start_col);
+    const int downward = src.start_row - dest.start_row;
+    if (cols <= 0) {
+        return 1;
+    }
+
+    // Copy rows in the order that never reads one already overwritten (and
+    // within a row as memmove does)
+    const int first = downward < 0 ? dest.end_row - 1 : dest.start_row;
+    const int last = downward < 0 ? dest.start_row - 1 : dest.end_row;
+    const int step = downward < 0 ? -1 : 1;
+    for (int row = first; row != last; row += step) {
+        const std::span<Core::Cell> to = self->Row(row);
+        const std::span<Core::Cell> from = self->Row(row + downward);
+        if (to.empty() || from.empty()) {
+            continue;
+        }
+        const Core::CellChange change = Core::FindChangedCells(to.subspan(dest.start_col, cols),
+                                                               from.subspan(src.start_col, cols));
+        if (change.IsEmpty()) {
+            continue;
+        }
+        std::memmove(to.data() + dest.start_col, from.data() + src.start_col, sizeof(Core::Cell) * cols);
+        self->m_buffer.MarkDirty(row, dest.start_col + static_cast<int>(change.start),
+                                 dest.start_col + static_cast<int>(change.end));
+    }
+    return 1;
+}
+
+int VTermGrid::OnErase(VTermRect rect, int selective, void* user) {
+    (void)selective;
+    auto* self = static_cast<VTermGrid*>(user);
+    const int rows = self->m_buffer.GetRows();
+    const int cols = self->m_buffer.GetCols();
+    const int startCol = std::clamp(rect.start_col, 0, cols);
+    const int endCol = std::clamp(rect.end_col, startCol, cols);
+
+    // Only changed cells are damage; a row already erased whole costs nothing
+    for (int row = std::max(rect.start_row, 0); row < std::min(rect.end_row, rows); ++row) {
+        self->SplitWide(self->m_buffer.GetRow(row), startCol);
+        self->m_buffer.FillRange(row, startCol, endCol, self->m_erase);
+    }
+
+    // Erasing the end of a line ends the wrap into the next
+    if (endCol == cols) {
+        for (int row = std::max(rect.start_row + 1, 0); row < std::min(rect.end_row + 1, rows); ++row) {
+            self->SyncContinuation(row);
+        }
+    }
+    return 1;
+}
+
+int VTermGrid::OnInitPen(void* user) {
+    auto* self = static_cast<VTermGrid*>(user);
+    self->m_pen = Core::Cell{};
+    self->m_erase = Core::Cell{};
+    return 1;
+}
+
+int VTermGrid::OnSetPenAttr(VTermAttr attr, VTermValue* val, void* user) {
+    auto* self = static_cast<VTermGrid*>(user);
+    Core::CellAttributes attrs = self->m_pen.Attributes();
+
+    switch (attr) {
+        case VTERM_ATTR_BOLD:      attrs.bold = val->boolean ? 1 : 0; break;
+        case VTERM_ATTR_UNDERLINE: attrs.underline = static_cast<uint8_t>(std::clamp(val->number, 0, 3)); break;
+        case VTERM_ATTR_ITALIC:    attrs.italic = val->boolean ? 1 : 0; break;
+        case VTERM_ATTR_BLINK:     attrs.blink = val->boolean ? 1 : 0; break;
+        case VTERM_ATTR_REVERSE:   attrs.reverse = val->boolean ? 1 : 0; break;
+        case VTERM_ATTR_CONCEAL:   attrs.conceal = val->boolean ? 1 : 0; break;
+        case VTERM_ATTR_STRIKE:    attrs.strikethrough = val->boolean ? 1 : 0; break;
+        case VTERM_ATTR_FOREGROUND:
+            self->m_pen.fg = ToCellColor(val->color);
+            self->m_erase.fg = self->m_pen.fg;
+            return 1;
+        case VTERM_ATTR_BACKGROUND:
+            self->m_pen.bg = ToCellColor(val->color);
+            self->m_erase.bg = self->m_pen.bg;
+            return 1;
+        default:
+            // Fonts, small and baseline: the buffer has no room for them
+            return 1;
+    }
+
+    self->m_pen.SetAttributes(attrs);
+    return 1;
+}
+
+int VTermGrid::OnSetTermProp(VTermProp prop, VTermValue* val, void* user) {
+    auto* self = static_cast<VTermGrid*>(user);
+
+    // The buffer keeps the other screen; the state erases the alternate one
+    // when it is entered
+    if (prop == VTERM_PROP_ALTSCREEN && (val->boolean != 0) != self->m_buffer.IsAlternateScreen()) {
+        (void)self->m_buffer.SetAlternateScreen(val->boolean != 0);
+    }
+
+    (void)VTermWrapper::OnSetTermProp(prop, val, &self->m_owner);
+    return 1;
+}
+
+int VTermGrid::OnBell(void* user) {
+    return VTermWrapper::OnBell(&static_cast<VTermGrid*>(user)->m_owner);
+}
+
+int VTermGrid::OnResize(int rows, int cols, VTermStateFields* fields, void* user) {
+    auto* self = static_cast<VTermGrid*>(user);
+    const bool alternate = self->m_buffer.IsAlternateScreen();
+
+    // The buffer's re-wrap follows the state's soft wraps; rows pushed off
+    // the top go to the scrollback as the screen layer's resize pushes them
+    for (int row = 0; row < self->m_buffer.GetRows(); ++row) {
+        self->SyncContinuation(row);
+    }
+    int cursorRow = fields->pos.row;
+    int cursorCol = fields->pos.col;
+    self->m_buffer.Resize(rows, cols, cursorRow, cursorCol,
+                          [self](std::span<const Core::Cell> cells, bool continuation) {
+                              self->m_owner.PushScrollbackRow(cells, continuation);
+                          });
+    fields->pos.row = cursorRow;
+    fields->pos.col = cursorCol;
+
+    // Line infos at the new height; the hidden screen starts over blank
+    fields->lineinfos[0] = self->ReplaceLineInfo(fields->lineinfos[0], rows, !alternate);
+    fields->lineinfos[1] = self->ReplaceLineInfo(fields->lineinfos[1], rows, alternate);
+
+    return VTermWrapper::OnResize(rows, cols, &self->m_owner);
+}
+
+} // namespace Console3::Emulation
@@ -0,0 +1,94 @@
+#pragma once
+// Console3 - VTermGrid.h
+// libvterm state layer writing straight into a terminal buffer
+//
+// With libvterm's screen layer every session holds the screen twice: the
+// screen layer's own cell buffer, and the TerminalBuffer the renderer reads,
+// kept in step by reading each damaged rectangle back cell by cell. The grid
+// takes the screen layer's place instead. It implements the state layer's
+// callbacks (glyphs, erases, scrolls, pen changes, resizes) directly on the
+// buffer's packed cells, so the screen exists once, the screen layer is
+// never created, and there is no damage to sync: writes mark the buffer's
+// rows dirty as they happen.
+//
+// Lines scrolled off the top are handed to the owner before they are
+// overwritten, as the screen layer pushes them. Scrolls of whole rows are
+// the buffer's O(1) row rotation. A resize re-wraps the screen with the
+// buffer's own reflow, which keeps the cursor on its character, and gives
+// the state the line infos of the result.
+//
+// Not carried over from the screen layer: DECSCA protection (selective
+// erases erase everything) and DECSCNM screen-wide reverse video.
+
+#include <span>
+
+extern "C" {
+#include <vterm.h>
+}
+
+#include "Core/Cell.h"
+
+namespace Console3::Core {
+class TerminalBuffer;
+}
+
+namespace Console3::Emulation {
+
+class VTermHeap;
+class VTermWrapper;
+
+/// State layer callbacks on a terminal buffer (see file comment)
+class VTermGrid {
+public:
+    /// @param owner Receives cursor moves, properties, bells and scrollback lines
+    /// @param heap The allocator the VTerm was built with (line infos are
+    ///             reallocated on resize)
+    /// @param buffer Screen storage; must outlive the grid
+    VTermGrid(VTermWrapper& owner, VTermHeap& heap, Core::TerminalBuffer& buffer);
+
+    // Non-copyable, non-movable (the state keeps a pointer to it)
+    VTermGrid(const VTermGrid&) = delete;
+    VTermGrid& operator=(const VTermGrid&) = delete;
+
+    /// Install on a VTerm's state layer and reset it
+    void Attach(VTerm* vterm);
+
+    [[nodiscard]] Core::TerminalBuffer& GetBuffer() const noexcept { return m_buffer; }
+
+private:
+    static int OnPutGlyph(VTermGlyphInfo* info, VTermPos pos, void* user);
+    static int OnPutGlyphs(const uint32_t chars[], int count, const VTermGlyphInfo* info, VTermPos pos,
+                           void* user);
+    static int OnMoveCursor(VTermPos pos, VTermPos oldpos, int visible, void* user);
+    static int OnPreMove(VTermRect rect, void* user);
+    static int OnScrollRect(VTermRect rect, int downward, int rightward, void* user);
+    static int OnMoveRect(VTermRect dest, VTermRect src, void* user);
+    static int OnErase(VTermRect rect, int selective, void* user);
+    static int OnInitPen(void* user);
+    static int OnSetPenAttr(VTermAttr attr, VTermValue* val, void* user);
+    static int OnSetTermProp(VTermProp prop, VTermValue* val, void* user);
+    static int OnBell(void* user);
+    static int OnResize(int rows, int cols, VTermStateFields* fields, void* user);
+
+    /// Get a row's cells if it is on screen
+    [[nodiscard]] std::span<Core::Cell> Row(int row) const;
+
+    /// A wide character whose right half is overwritten becomes narrow
+    void SplitWide(std::span<Core::Cell> cells, int col) const;
+
+    /// Copy the state's soft-wrap flag of a row to the buffer
+    void SyncContinuation(int row) const;
+
+    /// Replace a line info array with one for a new row count
+    /// @param wrap Take the soft-wrap flags from the buffer's rows (else none)
+    VTermLineInfo* ReplaceLineInfo(VTermLineInfo* old, int rows, bool wrap) const;
+
+    VTermWrapper& m_owner;
+    VTermHeap& m_heap;
+    Core::TerminalBuffer& m_buffer;
+    VTermState* m_state = nullptr;
+    Core::Cell m_pen;                   ///< A blank cell in the current pen
+    Core::Cell m_erase;                 ///< m_pen's colors only, as erases leave cells
+};
+
+} // namespace Console3::Emulation
@@ -0,0 +1,82 @@
+// Console3 - VTermHeap.cpp
+// Memory libvterm allocates from, with allocation counts
+
+#include "Emulation/VTermHeap.h"
+#include "Core/AllocTracker.h"
+#include <malloc.h>
+#include <cstdlib>
+
+namespace Console3::Emulation {
+
+VTermHeap::VTermHeap(VTermAllocator kind) {
+    if (kind == VTermAllocator::Arena) {
+        // Serialized and growable, like the process heap
+        m_heap = HeapCreate(0, 0, 0);
+    }
+}
+
+VTermHeap::~VTermHeap() {
+    if (m_heap) {
+        HeapDestroy(m_heap);
+    }
+}
+
+const VTermAllocatorFunctions* VTermHeap::GetFunctions() noexcept {
+    static const VTermAllocatorFunctions functions = {&Malloc, &Free};
+    return &functions;
+}
+
+VTermAllocStats VTermHeap::GetStats() const noexcept {
+    VTermAllocStats stats;
+    stats.allocations = m_allocations.load(std::memory_order_relaxed);
+    stats.frees = m_frees.load(std::memory_order_relaxed);
+    stats.liveBytes = m_liveBytes.load(std::memory_order_relaxed);
+    stats.peakBytes = m_peakBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void* VTermHeap::Malloc(size_t size, void* allocdata) {
+    auto* self = static_cast<VTermHeap*>(allocdata);
+
+    // libvterm expects zeroed memory, as its default allocator gives
+    void* ptr = self->m_heap ? HeapAlloc(self->m_heap, HEAP_ZERO_MEMORY, size) : std::calloc(1, size);
+    if (!ptr) {
+        return nullptr;
+    }
+
+    const size_t bytes = self->BlockSize(ptr);
+    if constexpr (Core::AllocTracker::kEnabled) {
+        Core::AllocTracker::Record(Core::AllocSubsystem::Emulation, bytes);
+    }
+    self->m_allocations.fetch_add(1, std::memory_order_relaxed);
+    const size_t live = self->m_liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    if (live > self->m_peakBytes.load(std::memory_order_relaxed)) {
+        self->m_peakBytes.store(live, std::memory_order_relaxed);
+    }
+    return ptr;
+}
+
+void VTermHeap::Free(void* ptr, void* allocdata) {
+    if (!ptr) {
+        return;
+    }
+
+    auto* self = static_cast<VTermHeap*>(allocdata);
+    self->m_frees.fetch_add(1, std::memory_order_relaxed);
+    self->m_liveBytes.fetch_sub(self->BlockSize(ptr), std::memory_order_relaxed);
+    if (self->m_heap) {
+        HeapFree(self->m_heap, 0, ptr);
+    } else {
+        std::free(ptr);
+    }
+}
+
+size_t VTermHeap::BlockSize(void* ptr) const noexcept {
+    if (m_heap) {
+        const SIZE_T size = HeapSize(m_heap, 0, ptr);
+        return size == static_cast<SIZE_T>(-1) ? 0 : size;
+    }
+    return _msize(ptr);
+}
+
+} // namespace Console3::Emulation
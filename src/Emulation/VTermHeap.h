@@ -0,0 +1,85 @@
+#pragma once
+// Console3 - VTermHeap.h
+// Memory libvterm allocates from, with allocation counts
+//
+// libvterm allocates its screen buffers, line infos, tab stops and combining
+// character scratch through the allocator given to vterm_build(), and
+// reallocates most of them on every resize. On the process heap a resize
+// storm (a window dragged for a few seconds) or a churn of sessions leaves
+// holes between the long-lived blocks of other sessions. With Arena each
+// emulator gets a private Win32 heap instead: its blocks only mix with each
+// other, and the whole heap is returned at once when the emulator goes.
+//
+// Either way calls and bytes are counted, for the diagnostics overlay and the
+// benchmark. An emulator is only used by one thread at a time, so the
+// counters are relaxed atomics read from elsewhere without a lock.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+#include <vterm.h>
+}
+
+namespace Console3::Emulation {
+
+/// Where an emulator's memory comes from
+enum class VTermAllocator {
+    Process,    ///< The CRT heap, as libvterm's default allocator
+    Arena       ///< A private heap per emulator, released whole with it
+};
+
+/// libvterm allocation counts of one emulator
+struct VTermAllocStats {
+    uint64_t allocations = 0;   ///< malloc calls
+    uint64_t frees = 0;         ///< free calls
+    size_t liveBytes = 0;       ///< Held now
+    size_t peakBytes = 0;       ///< Most held at once
+};
+
+/// Allocator handed to vterm_build() (see file comment)
+class VTermHeap {
+public:
+    /// @param kind Process heap, or a private heap (falls back to the
+    ///             process heap if one can't be created)
+    explicit VTermHeap(VTermAllocator kind);
+
+    /// Destroys a private heap; free the VTerm first
+    ~VTermHeap();
+
+    // Non-copyable, non-movable (libvterm keeps a pointer to it)
+    VTermHeap(const VTermHeap&) = delete;
+    VTermHeap& operator=(const VTermHeap&) = delete;
+
+    /// Get the functions to put in VTermBuilder::allocator, with this as allocdata
+    [[nodiscard]] static const VTermAllocatorFunctions* GetFunctions() noexcept;
+
+    /// Check if a private heap is in use
+    [[nodiscard]] bool IsArena() const noexcept { return m_heap != nullptr; }
+
+    [[nodiscard]] VTermAllocStats GetStats() const noexcept;
+
+private:
+    static void* Malloc(size_t size, void* allocdata);
+    static void Free(void* ptr, void* allocdata);
+
+    /// Size of a block as the heap it came from reports it
+    [[nodiscard]] size_t BlockSize(void* ptr) const noexcept;
+
+    HANDLE m_heap = nullptr;
+    std::atomic<uint64_t> m_allocations{0};
+    std::atomic<uint64_t> m_frees{0};
+    std::atomic<size_t> m_liveBytes{0};
+    std::atomic<size_t> m_peakBytes{0};
+};
+
+} // namespace Console3::Emulation
@@ -0,0 +1,174 @@
+// Console3 - VTermSegmentParser.cpp
+// Parses a long output stream on several threads, between its checkpoints
+
+#include "Emulation/VTermSegmentParser.h"
+#include "Core/TerminalBuffer.h"
+#include "Emulation/VTermWrapper.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <limits>
+#include <thread>
+#include <vector>
+
+namespace Console3::Emulation {
+
+namespace {
+
+/// Bytes handed to the emulator per InputWrite
+constexpr size_t kFeedBytes = 1 << 20;
+
+struct ParsedLine {
+    std::vector<Core::Cell> cells;      ///< Without trailing blank cells
+    bool continuation = false;
+};
+
+/// Keeps the newest lines one stretch produces (event sink)
+class LineCollector {
+public:
+    explicit LineCollector(size_t capacity) noexcept : m_capacity(capacity) {}
+
+    void OnVTermDamage(int, int, int, int) noexcept {}
+
+    void OnVTermScrollbackRow(std::span<const Core::Cell> cells, bool continuation) { Add(cells, continuation); }
+
+    void Add(std::span<const Core::Cell> cells, bool continuation) {
+        if (m_capacity == 0) {
+            return;
+        }
+        size_t used = cells.size();
+        while (used > 0 && cells[used - 1] == Core::Cell{}) {
+            --used;
+        }
+        // A full collector reuses its oldest line's storage
+        ParsedLine line;
+        if (m_lines.size() == m_capacity) {
+            line = std::move(m_lines.front());
+            m_lines.pop_front();
+        }
+        line.cells.assign(cells.begin(), cells.begin() + static_cast<ptrdiff_t>(used));
+        line.continuation = continuation;
+        m_lines.push_back(std::move(line));
+    }
+
+    [[nodiscard]] size_t GetCapacity() const noexcept { return m_capacity; }
+    [[nodiscard]] std::deque<ParsedLine>& GetLines() noexcept { return m_lines; }
+
+private:
+    size_t m_capacity;
+    std::deque<ParsedLine> m_lines;
+};
+
+void Feed(VTermWrapper& vterm, std::string_view bytes) {
+    while (!bytes.empty()) {
+        const size_t consumed = vterm.InputWrite(bytes.data(), std::min(bytes.size(), kFeedBytes));
+        if (consumed == 0) {
+            return;
+        }
+        bytes.remove_prefix(consumed);
+    }
+}
+
+/// Parse one stretch on a blank screen
+void ParseSegment(std::string_view bytes, std::string_view restore, int rows, int cols, LineCollector& lines) {
+    Core::TerminalBufferConfig config;
+    config.rows = rows;
+    config.cols = cols;
+    config.scrollbackLines = 0;
+    Core::TerminalBuffer screen(config);
+    VTermWrapper vterm(rows, cols, VTermAllocator::Arena, &screen);
+    vterm.SetEventSink(lines);
+    Feed(vterm, restore);
+    Feed(vterm, bytes);
+
+    // The stretch ends at a line start: the rows above the cursor are its
+    // last lines, not yet scrolled off
+    int cursorRow = 0;
+    int cursorCol = 0;
+    vterm.GetCursorPos(cursorRow, cursorCol);
+    for (int row = 0; row < std::min(cursorRow, rows); ++row) {
+        lines.Add(screen.GetRow(row), vterm.IsContinuation(row));
+    }
+}
+
+} // namespace
+
+SegmentPrefill VTermSegmentParser::Prefill(std::string_view data, const VTermCheckpoints& checkpoints, int cols,
+                                           size_t keep, Core::TerminalBuffer& target, unsigned threads) {
+    const std::vector<VTermCheckpoint>& points = checkpoints.points;
+    const int rows = checkpoints.rows;
+    if (points.empty() || rows <= 0 || cols <= 0 || checkpoints.size != data.size() ||
+        points.back().offset > data.size()) {
+        return {};
+    }
+
+    // Stretch i runs up to points[i], from points[i - 1] (or the start).
+    // Later output pushes at least (line feeds after it - rows) lines past
+    // it into the scrollback; what is older than keep lines then is dropped.
+    std::vector<LineCollector> collectors;
+    collectors.reserve(points.size());
+    for (const VTermCheckpoint& point : points) {
+        const uint64_t after = checkpoints.lines - point.lines;
+        size_t capacity = std::numeric_limits<size_t>::max();
+        if (keep != std::numeric_limits<size_t>::max()) {
+            const uint64_t reach = static_cast<uint64_t>(keep) + static_cast<uint64_t>(rows);
+            capacity = after < reach ? static_cast<size_t>(reach - after) : 0;
+        }
+        collectors.emplace_back(capacity);
+    }
+
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+    auto work = [&] {
+        std::string restore;
+        for (size_t index = next++; index < points.size() && !failed; index = next++) {
+            if (collectors[index].GetCapacity() == 0) {
+                continue;
+            }
+            const uint64_t begin = index > 0 ? points[index - 1].offset : 0;
+            restore.clear();
+            if (index > 0) {
+                points[index - 1].AppendRestore(restore);
+            }
+            try {
+                ParseSegment(data.substr(begin, points[index].offset - begin), restore, rows, cols,
+                             collectors[index]);
+            } catch (...) {
+                failed = true;
+            }
+        }
+    };
+
+    if (threads == 0) {
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    threads = static_cast<unsigned>(std::min<size_t>(threads, points.size()));
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (unsigned index = 1; index < threads; ++index) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    if (failed) {
+        // The caller parses everything itself
+        return {};
+    }
+
+    SegmentPrefill result;
+    for (LineCollector& collector : collectors) {
+        for (const ParsedLine& line : collector.GetLines()) {
+            target.PushScrollback(line.cells, line.continuation);
+        }
+        result.lines += collector.GetLines().size();
+        collector.GetLines().clear();
+    }
+    result.offset = points.back().offset;
+    points.back().AppendRestore(result.restore);
+    return result;
+}
+
+} // namespace Console3::Emulation
@@ -0,0 +1,53 @@
+#pragma once
+// Console3 - VTermSegmentParser.h
+// Parses a long output stream on several threads, between its checkpoints
+//
+// With the stream cut at its checkpoints (VTermCheckpoints.h), each
+// stretch but the last is parsed by a worker on an emulator of its own: a
+// blank screen of the session's size, set up with the state the stretch
+// starts in, then fed the stretch. The lines it scrolls off, followed by
+// the screen rows above the cursor at the end, are exactly the lines the
+// stretch adds to a sequential parse's scrollback; Prefill appends them to
+// the target buffer in stream order. The last stretch is left to the
+// caller's own emulator, which then ends up with the same screen, modes
+// and scrollback as if it had parsed everything.
+//
+// Lines that the scrollback would drop again are not kept: a stretch whose
+// output is followed by more line feeds than the scrollback holds is not
+// parsed at all, and the others keep only their newest lines. Rows are
+// stored without their trailing blank cells meanwhile.
+
+#include "Emulation/VTermCheckpoints.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace Console3::Core {
+class TerminalBuffer;
+}
+
+namespace Console3::Emulation {
+
+/// Where a prefilled stream continues
+struct SegmentPrefill {
+    uint64_t offset = 0;                ///< First byte not parsed (0: nothing was)
+    std::string restore;                ///< State to set up before parsing on from offset
+    size_t lines = 0;                   ///< Lines added to the scrollback
+};
+
+/// Parallel parse of a stream's checkpointed prefix (see file comment)
+class VTermSegmentParser {
+public:
+    /// Parse the stream up to its last checkpoint and append the lines to
+    /// the target's scrollback
+    /// @param checkpoints The stream's checkpoints, for target's height
+    /// @param cols Screen width the stream is parsed at
+    /// @param keep Scrollback lines the target keeps (SIZE_MAX: all)
+    /// @param threads Workers to use (0: one per hardware thread)
+    [[nodiscard]] static SegmentPrefill Prefill(std::string_view data, const VTermCheckpoints& checkpoints, int cols,
+                                                size_t keep, Core::TerminalBuffer& target, unsigned threads = 0);
+};
+
+} // namespace Console3::Emulation
@@ -0,0 +1,39 @@
+// Console3 - VTermString.cpp
+// Assembly of OSC/DCS strings libvterm delivers in fragments
+
+#include "Emulation/VTermString.h"
+
+namespace Console3::Emulation {
+
+std::optional<std::string_view> VTermStringAccumulator::Add(const VTermStringFragment& frag) {
+    const std::string_view text = frag.str ? std::string_view(frag.str, frag.len) : std::string_view();
+
+    if (frag.initial) {
+        m_buffer.clear();
+        m_overflow = false;
+
+        // Whole in one write: no copy
+        if (frag.final) {
+            if (text.size() > m_maxLength) {
+                return std::nullopt;
+            }
+            return text;
+        }
+    }
+
+    if (!m_overflow) {
+        if (m_buffer.size() + text.size() <= m_maxLength) {
+            m_buffer.append(text);
+        } else {
+            m_overflow = true;
+            m_buffer.clear();
+        }
+    }
+
+    if (!frag.final || m_overflow) {
+        return std::nullopt;
+    }
+    return std::string_view(m_buffer);
+}
+
+} // namespace Console3::Emulation
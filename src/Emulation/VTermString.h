@@ -0,0 +1,43 @@
+#pragma once
+// Console3 - VTermString.h
+// Assembly of OSC/DCS strings libvterm delivers in fragments
+//
+// libvterm's parser hands string contents to the callbacks as fragments
+// pointing into the input being written: one per write the string spans,
+// the first marked initial and the last final. Nearly every string (a title,
+// a hyperlink, a shell mark) arrives in a single write, so it comes as one
+// fragment that is both - the accumulator returns a view of it in place and
+// copies nothing. Only a string cut across writes is copied, fragment by
+// fragment, and only up to a limit: past it the string is dropped, so a
+// multi-megabyte clipboard or image payload is never buffered for a
+// consumer that would discard it.
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+extern "C" {
+#include <vterm.h>
+}
+
+namespace Console3::Emulation {
+
+/// Fragment assembler for one kind of string (see file comment)
+class VTermStringAccumulator {
+public:
+    /// @param maxLength Longest string kept, in bytes
+    explicit VTermStringAccumulator(size_t maxLength) noexcept : m_maxLength(maxLength) {}
+
+    /// Add a fragment
+    /// @return The whole string with the final fragment, valid until the
+    ///         next call; nullopt before that, and for a string over the limit
+    [[nodiscard]] std::optional<std::string_view> Add(const VTermStringFragment& frag);
+
+private:
+    std::string m_buffer;       ///< Fragments so far of a string cut across writes
+    size_t m_maxLength;
+    bool m_overflow = false;    ///< The current string is over the limit
+};
+
+} // namespace Console3::Emulation
@@ -2,11 +2,188 @@
 // libvterm C++ wrapper implementation
 
 #include "Emulation/VTermWrapper.h"
+#include "Core/SixelImage.h"
+#include "Core/TerminalBuffer.h"
+#include "Core/Utf.h"
+#include "Emulation/UnicodeTable.h"
+#include "Emulation/VTermGrid.h"
 #include <algorithm>
+#include <charconv>
 #include <cstring>
 
 namespace Console3::Emulation {
 
+namespace {
+
+/// Longest OSC 8 or 133 sequence kept
+constexpr size_t kMaxOscLength = 8192;
+
+/// Largest sixel payload kept; a larger image is dropped
+constexpr size_t kMaxImagePayload = 16u << 20;
+
+/// Smallest scratch buffer: libvterm formats replies and DECRQSS into it
+constexpr size_t kMinScratchSize = 4096;
+
+/// Longest title or icon name kept, in UTF-8 bytes
+constexpr size_t kMaxTitleLength = 4096;
+
+/// Take a title fragment; once the title is complete and differs from the
+/// last one, decode it into the property
+/// @return Whether the property changed
+bool UpdateTitle(VTermStringAccumulator& text, std::string& lastUtf8, std::wstring& title,
+                 const VTermStringFragment& frag) {
+    const std::optional<std::string_view> utf8 = text.Add(frag);
+    if (!utf8 || utf8->empty() || *utf8 == lastUtf8) {
+        return false;
+    }
+
+    title = Core::ToUtf16(*utf8);
+    lastUtf8.assign(*utf8);
+    return true;
+}
+
+/// Split libvterm's 0-terminated codepoints into base + 3 combining characters
+/// The right half of a wide character ((uint32_t)-1) never has combining
+/// characters; libvterm leaves stale ones behind in it.
+void CopyChars(const VTermScreenCell& src, uint32_t& charCode, uint32_t (&combining)[3]) {
+    charCode = src.chars[0] != 0 ? src.chars[0] : U' ';
+
+    bool more = src.chars[0] != 0 && src.chars[0] != static_cast<uint32_t>(-1);
+    for (int i = 0; i < 3; ++i) {
+        more = more && i + 1 < VTERM_MAX_CHARS_PER_CELL && src.chars[i + 1] != 0;
+        combining[i] = more ? src.chars[i + 1] : 0;
+    }
+}
+
+/// Translate a libvterm color for the terminal buffer
+/// Palette colors stay indexed; the view resolves them with its palette.
+Core::CellColor ToCellColor(VTermColor color) {
+    if (VTERM_COLOR_IS_DEFAULT_FG(&color) || VTERM_COLOR_IS_DEFAULT_BG(&color)) {
+        return Core::CellColor::Default();
+    }
+    if (VTERM_COLOR_IS_INDEXED(&color)) {
+        return Core::CellColor::Indexed(color.indexed.idx);
+    }
+    return Core::CellColor::Rgb(color.rgb.red, color.rgb.green, color.rgb.blue);
+}
+
+/// Translate a libvterm screen cell into a terminal buffer cell
+void ToCell(const VTermScreenCell& src, Core::Cell& dst) {
+    uint32_t charCode;
+    uint32_t combining[3];
+    CopyChars(src, charCode, combining);
+    dst.SetChars(charCode, combining);
+
+    dst.fg = ToCellColor(src.fg);
+    dst.bg = ToCellColor(src.bg);
+
+    Core::CellAttributes attrs;
+    attrs.bold = src.attrs.bold;
+    attrs.italic = src.attrs.italic;
+    attrs.underline = src.attrs.underline;
+    attrs.blink = src.attrs.blink;
+    attrs.reverse = src.attrs.reverse;
+    attrs.strikethrough = src.attrs.strike;
+    attrs.conceal = src.attrs.conceal;
+    dst.SetAttributes(attrs);
+
+    dst.width = static_cast<uint32_t>(src.width > 0 ? src.width : 1);
+}
+
+/// Translate a terminal buffer color into a libvterm color
+VTermColor ToVTermColor(const Core::CellColor& color, bool foreground) {
+    VTermColor result;
+    if (color.IsDefault()) {
+        vterm_color_rgb(&result, 0, 0, 0);
+        result.type |= foreground ? VTERM_COLOR_DEFAULT_FG : VTERM_COLOR_DEFAULT_BG;
+    } else if (color.IsIndexed()) {
+        vterm_color_indexed(&result, color.r);
+    } else {
+        vterm_color_rgb(&result, color.r, color.g, color.b);
+    }
+    return result;
+}
+
+/// Translate a terminal buffer cell into a libvterm screen cell (a line
+/// popped back from the scrollback); blanks become erased cells
+void FromCell(const Core::Cell& src, VTermScreenCell& dst) {
+    std::memset(&dst, 0, sizeof(dst));
+    const std::span<const uint32_t> combining = src.Combining();
+    if (src.code == Core::Cell::kContinuation && combining.empty()) {
+        dst.chars[0] = static_cast<uint32_t>(-1);
+    } else if (src.Codepoint() != U' ' || !combining.empty()) {
+        dst.chars[0] = src.Codepoint();
+        for (size_t i = 0; i < combining.size() && i + 1 < VTERM_MAX_CHARS_PER_CELL; ++i) {
+            dst.chars[i + 1] = combining[i];
+        }
+    }
+    dst.width = static_cast<char>(src.width > 0 ? src.width : 1);
+
+    const Core::CellAttributes attrs = src.Attributes();
+    dst.attrs.bold = attrs.bold;
+    dst.attrs.italic = attrs.italic;
+    dst.attrs.underline = attrs.underline;
+    dst.attrs.blink = attrs.blink;
+    dst.attrs.reverse = attrs.reverse;
+    dst.attrs.strike = attrs.strikethrough;
+    dst.attrs.conceal = attrs.conceal;
+
+    dst.fg = ToVTermColor(src.fg, true);
+    dst.bg = ToVTermColor(src.bg, false);
+}
+
+/// Translate a libvterm screen cell into a wrapper cell
+void ToTermCell(const VTermScreenCell& src, TermCell& dst) {
+    CopyChars(src, dst.charCode, dst.combining);
+
+    dst.width = src.width > 0 ? src.width : 1;
+    dst.attrs = CellAttrs::FromVTerm(src.attrs);
+    dst.fg = TermColor::FromVTerm(src.fg);
+    dst.bg = TermColor::FromVTerm(src.bg);
+}
+
+/// Translate a terminal buffer color into a wrapper color
+TermColor ToTermColor(const Core::CellColor& color) {
+    TermColor result;
+    result.isDefault = color.IsDefault();
+    result.isIndexed = color.IsIndexed();
+    if (result.isIndexed) {
+        result.paletteIndex = color.r;
+    } else if (!result.isDefault) {
+        result.r = color.r;
+        result.g = color.g;
+        result.b = color.b;
+    }
+    return result;
+}
+
+/// Translate a terminal buffer cell into a wrapper cell (Grid backend)
+void ToTermCell(const Core::Cell& src, TermCell& dst) {
+    dst.charCode = src.code == Core::Cell::kContinuation && !src.HasCombining() ? static_cast<uint32_t>(-1)
+                                                                               : src.Codepoint();
+    const std::span<const uint32_t> combining = src.Combining();
+    for (size_t i = 0; i < 3; ++i) {
+        dst.combining[i] = i < combining.size() ? combining[i] : 0;
+    }
+
+    const Core::CellAttributes attrs = src.Attributes();
+    dst.attrs = CellAttrs{};
+    dst.attrs.bold = attrs.bold != 0;
+    dst.attrs.italic = attrs.italic != 0;
+    dst.attrs.underline = attrs.underline != 0;
+    dst.attrs.underlineStyle = attrs.underline;
+    dst.attrs.blink = attrs.blink != 0;
+    dst.attrs.reverse = attrs.reverse != 0;
+    dst.attrs.strikethrough = attrs.strikethrough != 0;
+    dst.attrs.conceal = attrs.conceal != 0;
+
+    dst.width = static_cast<int>(src.width);
+    dst.fg = ToTermColor(src.fg);
+    dst.bg = ToTermColor(src.bg);
+}
+
+} // namespace
+
 // ============================================================================
 // Helper Conversion Functions
 // ============================================================================
@@ -48,12 +225,29 @@ CellAttrs CellAttrs::FromVTerm(const VTermScreenCellAttrs& attrs) {
 // VTermWrapper Implementation
 // ============================================================================
 
-VTermWrapper::VTermWrapper(int rows, int cols) {
+VTermWrapper::VTermWrapper(int rows, int cols, VTermAllocator allocator, Core::TerminalBuffer* grid,
+                           const VTermBufferSizes& buffers)
+    : m_heap(allocator)
+    , m_replyBatch(buffers.replyBatch)
+    , m_titleText(kMaxTitleLength)
+    , m_iconNameText(kMaxTitleLength)
+    , m_oscText(kMaxOscLength) {
     // Verify version compatibility
     VTERM_CHECK_VERSION;
+
+    if (grid) {
+        m_grid = std::make_unique<VTermGrid>(*this, m_heap, *grid);
+    }
     
-    // Create the vterm instance
-    m_vterm = vterm_new(rows, cols);
+    // Create the vterm instance on our allocator
+    VTermBuilder builder{};
+    builder.ver = 0;
+    builder.rows = rows;
+    builder.cols = cols;
+    builder.allocator = VTermHeap::GetFunctions();
+    builder.allocdata = &m_heap;
+    builder.tmpbuffer_len = buffers.scratch ? std::max(buffers.scratch, kMinScratchSize) : 0;
+    m_vterm = vterm_build(&builder);
     if (!m_vterm) {
         throw std::runtime_error("Failed to create VTerm instance");
     }
@@ -61,9 +255,24 @@ VTermWrapper::VTermWrapper(int rows, int cols) {
     // Enable UTF-8 mode
     vterm_set_utf8(m_vterm, 1);
 
+    // Character widths from the table the renderer reads as well
+    vterm_state_set_unicode_table(vterm_obtain_state(m_vterm), &UnicodeTable::GetVTermTable());
+
     // Set up output callback
     vterm_output_set_callback(m_vterm, &VTermWrapper::OnOutput, this);
 
+    // OSC and DCS sequences libvterm doesn't handle itself (OSC 8
+    // hyperlinks, sixel images)
+    m_fallbacks.osc = &VTermWrapper::OnOsc;
+    m_fallbacks.dcs = &VTermWrapper::OnDcs;
+
+    // Grid backend: the state layer draws on the buffer; no screen layer is made
+    if (m_grid) {
+        m_grid->Attach(m_vterm);
+        vterm_state_set_unrecognised_fallbacks(vterm_obtain_state(m_vterm), &m_fallbacks, this);
+        return;
+    }
+
     // Get the screen layer
     m_screen = vterm_obtain_screen(m_vterm);
     
@@ -75,13 +284,22 @@ VTermWrapper::VTermWrapper(int rows, int cols) {
     m_screenCallbacks.settermprop = &VTermWrapper::OnSetTermProp;
     m_screenCallbacks.bell = &VTermWrapper::OnBell;
     m_screenCallbacks.resize = &VTermWrapper::OnResize;
-    m_screenCallbacks.sb_pushline = &VTermWrapper::OnScrollbackPush;
+    m_screenCallbacks.sb_pushline4 = &VTermWrapper::OnScrollbackPush;
     m_screenCallbacks.sb_popline = &VTermWrapper::OnScrollbackPop;
 
     vterm_screen_set_callbacks(m_screen, &m_screenCallbacks, this);
+    vterm_screen_callbacks_has_pushline4(m_screen);
+
+    vterm_screen_set_unrecognised_fallbacks(m_screen, &m_fallbacks, this);
     
-    // Enable alternate screen buffer support
+    // Enable alternate screen buffer support; the terminal buffer keeps the
+    // primary screen while it is hidden, so leaving the alternate screen
+    // does not resend it
     vterm_screen_enable_altscreen(m_screen, 1);
+    vterm_screen_enable_altscreen_restore(m_screen, true);
+
+    // Re-wrap soft-wrapped lines on resize instead of truncating them
+    vterm_screen_enable_reflow(m_screen, true);
     
     // Reset to initialize state
     vterm_screen_reset(m_screen, 1);
@@ -98,7 +316,35 @@ size_t VTermWrapper::InputWrite(const char* data, size_t length) {
     if (!m_vterm || !data || length == 0) {
         return 0;
     }
-    return vterm_input_write(m_vterm, data, length);
+
+    // Replies go out as one write per call instead of one per query
+    m_batchReplies = true;
+    size_t consumed = length;
+    if (m_frontParser) {
+        m_frontParser->Write(data, length);
+    } else {
+        consumed = vterm_input_write(m_vterm, data, length);
+    }
+    m_batchReplies = false;
+    FlushReplies();
+    return consumed;
+}
+
+void VTermWrapper::FlushReplies() {
+    if (!m_replies.empty()) {
+        if (m_outputCallback) {
+            m_outputCallback(m_replies.data(), m_replies.size());
+        }
+        m_replies.clear();
+    }
+}
+
+void VTermWrapper::SetFrontParser(bool enable) {
+    if (!enable) {
+        m_frontParser.reset();
+    } else if (!m_frontParser && m_vterm) {
+        m_frontParser = std::make_unique<VTermFrontParser>(m_vterm);
+    }
 }
 
 void VTermWrapper::KeyboardUnichar(uint32_t codepoint, int modifiers) {
@@ -113,6 +359,25 @@ void VTermWrapper::KeyboardKey(int key, int modifiers) {
     }
 }
 
+void VTermWrapper::MouseInput(std::span<const MouseEvent> events) {
+    if (!m_vterm || events.empty()) {
+        return;
+    }
+
+    // libvterm skips moves within the cell it last saw and motion the mode
+    // does not track
+    m_batchReplies = true;
+    for (const MouseEvent& event : events) {
+        const auto modifiers = static_cast<VTermModifier>(event.modifiers);
+        vterm_mouse_move(m_vterm, event.row, event.col, modifiers);
+        if (event.button != 0) {
+            vterm_mouse_button(m_vterm, event.button, event.pressed, modifiers);
+        }
+    }
+    m_batchReplies = false;
+    FlushReplies();
+}
+
 void VTermWrapper::Resize(int rows, int cols) {
     if (m_vterm && rows > 0 && cols > 0) {
         vterm_set_size(m_vterm, rows, cols);
@@ -129,6 +394,14 @@ void VTermWrapper::GetSize(int& rows, int& cols) const {
 
 TermCell VTermWrapper::GetCell(int row, int col) const {
     TermCell result;
+
+    if (m_grid) {
+        const Core::TerminalBuffer& buffer = m_grid->GetBuffer();
+        if (row >= 0 && row < buffer.GetRows() && col >= 0 && col < buffer.GetCols()) {
+            ToTermCell(buffer.GetCell(row, col), result);
+        }
+        return result;
+    }
     
     if (!m_screen) {
         return result;
@@ -138,36 +411,67 @@ TermCell VTermWrapper::GetCell(int row, int col) const {
     VTermScreenCell cell{};
     
     if (vterm_screen_get_cell(m_screen, pos, &cell)) {
-        // Copy characters
-        for (int i = 0; i < VTERM_MAX_CHARS_PER_CELL && cell.chars[i] != 0; ++i) {
-            result.chars.push_back(cell.chars[i]);
-        }
-        
-        // Ensure at least a space if empty
-        if (result.chars.empty()) {
-            result.chars.push_back(U' ');
-        }
-        
-        result.width = cell.width > 0 ? cell.width : 1;
-        result.attrs = CellAttrs::FromVTerm(cell.attrs);
-        result.fg = TermColor::FromVTerm(cell.fg);
-        result.bg = TermColor::FromVTerm(cell.bg);
+        ToTermCell(cell, result);
     }
     
     return result;
 }
 
+int VTermWrapper::ReadRow(int row, int startCol, std::span<Core::Cell> out) const {
+    if (m_grid && startCol >= 0) {
+        const Core::TerminalBuffer& buffer = m_grid->GetBuffer();
+        if (row < 0 || row >= buffer.GetRows() || startCol >= buffer.GetCols()) {
+            return 0;
+        }
+        const std::span<const Core::Cell> cells = buffer.GetRow(row).subspan(startCol);
+        const size_t count = std::min(out.size(), cells.size());
+        std::copy_n(cells.begin(), count, out.begin());
+        return static_cast<int>(count);
+    }
+    if (!m_screen || startCol < 0) {
+        return 0;
+    }
+
+    int rows = 0;
+    int cols = 0;
+    vterm_get_size(m_vterm, &rows, &cols);
+    if (row < 0 || row >= rows || startCol >= cols) {
+        return 0;
+    }
+
+    const int count = std::min(static_cast<int>(out.size()), cols - startCol);
+    VTermScreenCell cell{};
+    for (int i = 0; i < count; ++i) {
+        if (vterm_screen_get_cell(m_screen, VTermPos{row, startCol + i}, &cell)) {
+            ToCell(cell, out[i]);
+        } else {
+            out[i].Clear();
+        }
+    }
+    return count;
+}
+
 void VTermWrapper::GetCursorPos(int& row, int& col) const {
     row = m_cursorRow;
     col = m_cursorCol;
 }
 
+bool VTermWrapper::IsContinuation(int row) const {
+    if (!m_vterm) {
+        return false;
+    }
+    const VTermLineInfo* info = vterm_state_get_lineinfo(vterm_obtain_state(m_vterm), row);
+    return info && info->continuation;
+}
+
 const TermProps& VTermWrapper::GetProps() const noexcept {
     return m_props;
 }
 
 void VTermWrapper::Reset() {
-    if (m_screen) {
+    if (m_grid) {
+        vterm_state_reset(vterm_obtain_state(m_vterm), 1);
+    } else if (m_screen) {
         vterm_screen_reset(m_screen, 1);
     }
 }
@@ -178,6 +482,27 @@ void VTermWrapper::FlushDamage() {
     }
 }
 
+void VTermWrapper::SetDamageMerge(DamageMerge merge) {
+    if (!m_screen) {
+        // The Grid backend reports no damage to merge
+        m_damageMerge = merge;
+        return;
+    }
+
+    VTermDamageSize size = VTERM_DAMAGE_CELL;
+    switch (merge) {
+        case DamageMerge::Cell:   size = VTERM_DAMAGE_CELL; break;
+        case DamageMerge::Row:    size = VTERM_DAMAGE_ROW; break;
+        case DamageMerge::Screen: size = VTERM_DAMAGE_SCREEN; break;
+        case DamageMerge::Scroll: size = VTERM_DAMAGE_SCROLL; break;
+    }
+
+    // Report what was merged under the old mode first
+    vterm_screen_flush_damage(m_screen);
+    vterm_screen_set_damage_merge(m_screen, size);
+    m_damageMerge = merge;
+}
+
 size_t VTermWrapper::OutputRead(char* buffer, size_t maxLen) {
     if (!m_vterm || !buffer || maxLen == 0) {
         return 0;
@@ -185,14 +510,6 @@ size_t VTermWrapper::OutputRead(char* buffer, size_t maxLen) {
     return vterm_output_read(m_vterm, buffer, maxLen);
 }
 
-void VTermWrapper::SetDamageCallback(DamageCallback callback) {
-    m_damageCallback = std::move(callback);
-}
-
-void VTermWrapper::SetMoveCursorCallback(MoveCursorCallback callback) {
-    m_moveCursorCallback = std::move(callback);
-}
-
 void VTermWrapper::SetTermPropCallback(SetTermPropCallback callback) {
     m_termPropCallback = std::move(callback);
 }
@@ -209,14 +526,21 @@ void VTermWrapper::SetOutputCallback(OutputCallback callback) {
     m_outputCallback = std::move(callback);
 }
 
-void VTermWrapper::SetScrollbackPushCallback(ScrollbackPushCallback callback) {
-    m_scrollbackPushCallback = std::move(callback);
+void VTermWrapper::SetHyperlinkCallback(HyperlinkCallback callback) {
+    m_hyperlinkCallback = std::move(callback);
 }
 
-void VTermWrapper::ConvertColorToRgb(VTermColor& color) const {
-    if (m_screen) {
-        vterm_screen_convert_color_to_rgb(m_screen, &color);
-    }
+void VTermWrapper::SetShellMarkCallback(ShellMarkCallback callback) {
+    m_shellMarkCallback = std::move(callback);
+}
+
+void VTermWrapper::SetImageCallback(ImageCallback callback) {
+    m_imageCallback = std::move(callback);
+}
+
+void VTermWrapper::SetCellPixelSize(int width, int height) noexcept {
+    m_cellPixelWidth.store(std::max(width, 1), std::memory_order_relaxed);
+    m_cellPixelHeight.store(std::max(height, 1), std::memory_order_relaxed);
 }
 
 // ============================================================================
@@ -225,21 +549,23 @@ void VTermWrapper::ConvertColorToRgb(VTermColor& color) const {
 
 int VTermWrapper::OnDamage(VTermRect rect, void* user) {
     auto* self = static_cast<VTermWrapper*>(user);
-    if (self && self->m_damageCallback) {
-        self->m_damageCallback(rect.start_row, rect.end_row, rect.start_col, rect.end_col);
+    if (self && self->m_sink.damage) {
+        self->m_sink.damage(self->m_sink.sink, rect.start_row, rect.end_row, rect.start_col, rect.end_col);
     }
     return 1;
 }
 
 int VTermWrapper::OnMoveRect(VTermRect dest, VTermRect src, void* user) {
-    // Convert moverect to damage for simplicity
+    // Pass moves through so the buffer can shift rows instead of re-copying
+    // them. Returning 0 makes libvterm damage dest instead; the vacated part
+    // of src is damaged by libvterm's own erase either way.
     auto* self = static_cast<VTermWrapper*>(user);
-    if (self && self->m_damageCallback) {
-        // Damage both source and destination regions
-        self->m_damageCallback(src.start_row, src.end_row, src.start_col, src.end_col);
-        self->m_damageCallback(dest.start_row, dest.end_row, dest.start_col, dest.end_col);
+    if (self && self->m_sink.moveRect) {
+        const TermRect to{dest.start_row, dest.end_row, dest.start_col, dest.end_col};
+        const TermRect from{src.start_row, src.end_row, src.start_col, src.end_col};
+        return self->m_sink.moveRect(self->m_sink.sink, to, from) ? 1 : 0;
     }
-    return 1;
+    return 0;
 }
 
 int VTermWrapper::OnMoveCursor(VTermPos pos, VTermPos oldpos, int visible, void* user) {
@@ -248,8 +574,8 @@ int VTermWrapper::OnMoveCursor(VTermPos pos, VTermPos oldpos, int visible, void*
         self->m_cursorRow = pos.row;
         self->m_cursorCol = pos.col;
         
-        if (self->m_moveCursorCallback) {
-            self->m_moveCursorCallback(pos.row, pos.col, visible != 0);
+        if (self->m_sink.moveCursor) {
+            self->m_sink.moveCursor(self->m_sink.sink, pos.row, pos.col, visible != 0);
         }
     }
     return 1;
@@ -278,34 +604,13 @@ int VTermWrapper::OnSetTermProp(VTermProp prop, VTermValue* val, void* user) {
             break;
             
         case VTERM_PROP_TITLE:
-            if (val->string.str && val->string.len > 0) {
-                // Convert UTF-8 to wide string
-                int wideLen = MultiByteToWideChar(CP_UTF8, 0, 
-                    val->string.str, static_cast<int>(val->string.len), 
-                    nullptr, 0);
-                if (wideLen > 0) {
-                    self->m_props.title.resize(wideLen);
-                    MultiByteToWideChar(CP_UTF8, 0, 
-                        val->string.str, static_cast<int>(val->string.len),
-                        self->m_props.title.data(), wideLen);
-                    propsChanged = true;
-                }
-            }
+            propsChanged = UpdateTitle(self->m_titleText, self->m_titleUtf8, self->m_props.title,
+                                       val->string);
             break;
             
         case VTERM_PROP_ICONNAME:
-            if (val->string.str && val->string.len > 0) {
-                int wideLen = MultiByteToWideChar(CP_UTF8, 0,
-                    val->string.str, static_cast<int>(val->string.len),
-                    nullptr, 0);
-                if (wideLen > 0) {
-                    self->m_props.iconName.resize(wideLen);
-                    MultiByteToWideChar(CP_UTF8, 0,
-                        val->string.str, static_cast<int>(val->string.len),
-                        self->m_props.iconName.data(), wideLen);
-                    propsChanged = true;
-                }
-            }
+            propsChanged = UpdateTitle(self->m_iconNameText, self->m_iconNameUtf8,
+                                       self->m_props.iconName, val->string);
             break;
             
         case VTERM_PROP_CURSORSHAPE:
@@ -327,6 +632,21 @@ int VTermWrapper::OnSetTermProp(VTermProp prop, VTermValue* val, void* user) {
             self->m_props.mouseMode = val->number;
             propsChanged = true;
             break;
+
+        case VTERM_PROP_SYNCOUTPUT:
+            self->m_props.syncOutput = val->boolean != 0;
+            propsChanged = true;
+            break;
+
+        case VTERM_PROP_CURSORKEYS:
+            self->m_props.applicationCursor = val->boolean != 0;
+            propsChanged = true;
+            break;
+
+        case VTERM_PROP_KEYPAD:
+            self->m_props.applicationKeypad = val->boolean != 0;
+            propsChanged = true;
+            break;
             
         default:
             break;
@@ -355,45 +675,226 @@ int VTermWrapper::OnResize(int rows, int cols, void* user) {
     return 1;
 }
 
-int VTermWrapper::OnScrollbackPush(int cols, const VTermScreenCell* cells, void* user) {
+int VTermWrapper::OnScrollbackPush(int cols, const VTermScreenCell* cells, bool continuation, void* user) {
     auto* self = static_cast<VTermWrapper*>(user);
-    if (self && self->m_scrollbackPushCallback && cells) {
-        std::vector<TermCell> row;
-        row.reserve(cols);
-        
-        for (int i = 0; i < cols; ++i) {
-            TermCell cell;
-            for (int j = 0; j < VTERM_MAX_CHARS_PER_CELL && cells[i].chars[j] != 0; ++j) {
-                cell.chars.push_back(cells[i].chars[j]);
-            }
-            if (cell.chars.empty()) {
-                cell.chars.push_back(U' ');
-            }
-            cell.width = cells[i].width > 0 ? cells[i].width : 1;
-            cell.attrs = CellAttrs::FromVTerm(cells[i].attrs);
-            cell.fg = TermColor::FromVTerm(cells[i].fg);
-            cell.bg = TermColor::FromVTerm(cells[i].bg);
-            row.push_back(std::move(cell));
-        }
-        
-        self->m_scrollbackPushCallback(row);
+    if (!self) {
+        return 1;
     }
+    if (!self->m_sink.scrollbackRow || !cells || cols <= 0) {
+        ++self->m_linesPushed;
+        return 1;
+    }
+
+    // Converted once, straight into buffer cells, in a scratch row that
+    // only grows, so steady-state pushes don't allocate
+    std::vector<Core::Cell>& row = self->m_scrollbackRow;
+    row.resize(static_cast<size_t>(cols));
+    for (int i = 0; i < cols; ++i) {
+        ToCell(cells[i], row[i]);
+    }
+    self->PushScrollbackRow(row, continuation);
     return 1;
 }
 
+void VTermWrapper::PushScrollbackRow(std::span<const Core::Cell> cells, bool continuation) {
+    ++m_linesPushed;
+    if (m_sink.scrollbackRow) {
+        m_sink.scrollbackRow(m_sink.sink, cells, continuation);
+    }
+}
+
 int VTermWrapper::OnScrollbackPop(int cols, VTermScreenCell* cells, void* user) {
-    // Scrollback pop is used when scrolling down - we'd need to maintain
-    // a scrollback buffer to support this. For now, just clear the cells.
-    if (cells) {
-        std::memset(cells, 0, cols * sizeof(VTermScreenCell));
+    // libvterm refills the top of a growing screen from the scrollback; the
+    // line comes out of the same store the pushes went into
+    auto* self = static_cast<VTermWrapper*>(user);
+    if (!self || !self->m_sink.scrollbackPop || !cells || cols <= 0) {
+        return 0;
+    }
+
+    std::vector<Core::Cell>& row = self->m_scrollbackRow;
+    row.assign(static_cast<size_t>(cols), Core::Cell{});
+    if (!self->m_sink.scrollbackPop(self->m_sink.sink, row)) {
+        return 0;
+    }
+
+    // libvterm steps over wide characters by width: every cell needs one
+    for (int i = 0; i < cols; ++i) {
+        FromCell(row[i], cells[i]);
     }
-    return 0;  // Return 0 to indicate no scrollback available
+    --self->m_linesPushed;
+    return 1;
+}
+
+int VTermWrapper::OnOsc(int command, VTermStringFragment frag, void* user) {
+    auto* self = static_cast<VTermWrapper*>(user);
+    if (!self || (command != 8 && command != 133)) {
+        return 0;
+    }
+
+    // The sequence may arrive in fragments across writes; one past the
+    // limit is dropped rather than buffered without bound
+    if (const std::optional<std::string_view> text = self->m_oscText.Add(frag)) {
+        if (command == 8) {
+            self->OnHyperlink(*text);
+        } else {
+            self->OnShellMark(*text);
+        }
+    }
+    return 1;
+}
+
+int VTermWrapper::OnDcs(const char* command, size_t commandlen, VTermStringFragment frag, void* user) {
+    auto* self = static_cast<VTermWrapper*>(user);
+    // Sixel: DCS P1;P2;P3 q, the parameters being digits and semicolons
+    // (DECRQSS, "$q", never gets here)
+    const auto isParameter = [](char c) { return (c >= '0' && c <= '9') || c == ';'; };
+    if (!self || !self->m_imageCallback || commandlen == 0 || command[commandlen - 1] != 'q' ||
+        !std::all_of(command, command + commandlen - 1, isParameter)) {
+        return 0;
+    }
+
+    // The payload is copied once, out of the input as it is parsed; an
+    // image past the limit is dropped rather than buffered without bound
+    if (frag.initial) {
+        self->m_imagePayload.clear();
+        self->m_imageOverflow = false;
+    }
+    if (!self->m_imageOverflow) {
+        if (self->m_imagePayload.size() + frag.len > kMaxImagePayload) {
+            self->m_imageOverflow = true;
+            std::vector<char>().swap(self->m_imagePayload);
+        } else {
+            self->m_imagePayload.insert(self->m_imagePayload.end(), frag.str, frag.str + frag.len);
+        }
+    }
+    if (frag.final && !self->m_imageOverflow) {
+        self->OnSixel();
+    }
+    return 1;
+}
+
+void VTermWrapper::OnSixel() {
+    InlineImage image;
+    image.payload = std::move(m_imagePayload);
+    m_imagePayload.clear();
+
+    const Core::SixelSize size = Core::MeasureSixel(std::string_view(image.payload.data(), image.payload.size()));
+    if (size.width == 0 || size.height == 0) {
+        return;
+    }
+
+    int rows = 0;
+    int cols = 0;
+    vterm_get_size(m_vterm, &rows, &cols);
+    VTermPos cursor{};
+    vterm_state_get_cursorpos(vterm_obtain_state(m_vterm), &cursor);
+    const int cellWidth = m_cellPixelWidth.load(std::memory_order_relaxed);
+    const int cellHeight = m_cellPixelHeight.load(std::memory_order_relaxed);
+
+    image.width = size.width;
+    image.height = size.height;
+    image.row = cursor.row;
+    image.col = cursor.col;
+    image.cols = std::min(static_cast<int>((size.width + cellWidth - 1) / cellWidth), cols - cursor.col);
+    image.rows = static_cast<int>((size.height + cellHeight - 1) / cellHeight);
+    if (image.cols <= 0) {
+        return;
+    }
+    const int imageRows = image.rows;
+    m_imageCallback(std::move(image));
+
+    // As xterm with sixel scrolling: the cursor ends on the image's last
+    // row, in the column it started in, the screen scrolling as needed
+    for (int row = 1; row < imageRows; ++row) {
+        vterm_input_control(m_vterm, '\n');
+    }
+}
+
+void VTermWrapper::OnShellMark(std::string_view text) {
+    // "A", "B", "C" or "D[;exit code]", optionally followed by ";key=value"
+    // options, which are ignored
+    if (text.empty() || !m_shellMarkCallback) {
+        return;
+    }
+    ShellMark kind;
+    switch (text[0]) {
+        case 'A': kind = ShellMark::PromptStart; break;
+        case 'B': kind = ShellMark::CommandStart; break;
+        case 'C': kind = ShellMark::OutputStart; break;
+        case 'D': kind = ShellMark::CommandFinished; break;
+        default: return;
+    }
+
+    int exitCode = -1;
+    if (kind == ShellMark::CommandFinished && text.size() > 2 && text[1] == ';') {
+        const std::string_view status = text.substr(2, text.find(';', 2) - 2);
+        int value = 0;
+        const auto [end, error] = std::from_chars(status.data(), status.data() + status.size(), value);
+        if (error == std::errc{} && end == status.data() + status.size()) {
+            exitCode = value;
+        }
+    }
+
+    VTermPos cursor{};
+    vterm_state_get_cursorpos(vterm_obtain_state(m_vterm), &cursor);
+    m_shellMarkCallback(kind, cursor.row, cursor.col, exitCode);
+}
+
+void VTermWrapper::OnHyperlink(std::string_view text) {
+    // A link opening while another is open closes that one first
+    CloseHyperlink();
+
+    const size_t separator = text.find(';');
+    if (separator == std::string_view::npos || separator + 1 == text.size()) {
+        return;
+    }
+
+    VTermPos cursor{};
+    vterm_state_get_cursorpos(vterm_obtain_state(m_vterm), &cursor);
+    m_linkUri.assign(text.substr(separator + 1));
+    m_linkLine = m_linesPushed + static_cast<uint64_t>(cursor.row);
+    m_linkCol = cursor.col;
+}
+
+void VTermWrapper::CloseHyperlink() {
+    if (m_linkUri.empty()) {
+        return;
+    }
+
+    VTermPos cursor{};
+    vterm_state_get_cursorpos(vterm_obtain_state(m_vterm), &cursor);
+    int rows = 0;
+    int cols = 0;
+    vterm_get_size(m_vterm, &rows, &cols);
+
+    // The link ran from where it opened to the cursor, wrapping across rows
+    const uint64_t endLine = m_linesPushed + static_cast<uint64_t>(cursor.row);
+    if (m_hyperlinkCallback && endLine >= m_linkLine) {
+        for (uint64_t line = m_linkLine; line <= endLine; ++line) {
+            const int startCol = line == m_linkLine ? m_linkCol : 0;
+            const int endCol = line == endLine ? cursor.col : cols;
+            if (startCol < endCol) {
+                m_hyperlinkCallback(line, startCol, endCol, m_linkUri);
+            }
+        }
+    }
+    m_linkUri.clear();
 }
 
 void VTermWrapper::OnOutput(const char* s, size_t len, void* user) {
     auto* self = static_cast<VTermWrapper*>(user);
-    if (self && self->m_outputCallback && s && len > 0) {
+    if (!self || !self->m_outputCallback || !s || len == 0) {
+        return;
+    }
+
+    // Keyboard and mouse input are sent straight away
+    if (!self->m_batchReplies) {
         self->m_outputCallback(s, len);
+        return;
+    }
+    self->m_replies.append(s, len);
+    if (self->m_replies.size() >= self->m_replyBatch) {
+        self->FlushReplies();
     }
 }
 
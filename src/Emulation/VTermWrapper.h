@@ -3,7 +3,20 @@
 // C++ wrapper for libvterm terminal emulation library
 //
 // Provides a modern C++ interface to libvterm's screen layer for
-// parsing VT sequences and managing terminal state.
+// parsing VT sequences and managing terminal state. With the Grid backend
+// the screen layer is left out and the state layer draws on a terminal
+// buffer instead (VTermGrid).
+//
+// The events that come once per change - damage, moved rects, cursor
+// moves, scrollback lines - go to an event sink bound at compile time
+// (SetEventSink): libvterm calls the wrapper, the wrapper calls a thunk
+// with the sink's handler inlined into it, and nothing is type-erased on
+// the way. Rarer events (title, bell, resize, replies, links, marks,
+// images) keep std::function callbacks.
+//
+// Sixel images (DCS q) are not decoded here: the payload is collected as
+// it arrives, measured to move the cursor past the image, and moved out
+// whole to the image callback, which hands it to a decoder thread.
 
 #ifndef NTDDI_VERSION
 #define NTDDI_VERSION NTDDI_WIN10_RS5
@@ -13,10 +26,14 @@
 #endif
 
 #include <Windows.h>
+#include <atomic>
+#include <concepts>
 #include <cstdint>
 #include <functional>
 #include <memory>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 // libvterm C header
@@ -24,9 +41,19 @@ extern "C" {
 #include <vterm.h>
 }
 
+#include "Emulation/VTermFrontParser.h"
+#include "Emulation/VTermHeap.h"
+#include "Emulation/VTermString.h"
+
+namespace Console3::Core {
+struct Cell;
+class TerminalBuffer;
+}
+
 namespace Console3::Emulation {
 
 // Forward declarations
+class VTermGrid;
 class VTermWrapper;
 
 /// Color representation (24-bit RGB + type info)
@@ -58,14 +85,56 @@ struct CellAttrs {
 };
 
 /// A single terminal cell
+/// Fixed-size and allocation-free; Core::Cell packs the same characters via SetChars().
 struct TermCell {
-    std::vector<uint32_t> chars;  ///< UTF-32 codepoints (may include combining chars)
+    uint32_t charCode = U' ';     ///< Primary UTF-32 codepoint
+    uint32_t combining[3] = {0};  ///< Up to 3 combining characters (0 = unused)
     int width = 1;                ///< Cell width (1 or 2 for wide chars)
     CellAttrs attrs;              ///< Visual attributes
     TermColor fg;                 ///< Foreground color
     TermColor bg;                 ///< Background color
 };
 
+/// Screen rectangle (end row/column exclusive)
+struct TermRect {
+    int startRow = 0;
+    int endRow = 0;
+    int startCol = 0;
+    int endCol = 0;
+};
+
+/// How libvterm merges damage before reporting it (vterm_screen_set_damage_merge)
+enum class DamageMerge {
+    Cell,    ///< Report every write immediately; an ASCII run is one rect per row (libvterm default)
+    Row,     ///< Merge changes within a row, report when output leaves it
+    Screen,  ///< Merge everything into one rect until FlushDamage()
+    Scroll   ///< As Screen, and also merge scrolls into one move at flush
+};
+
+/// What holds the screen libvterm's state layer draws on
+enum class EmulationBackend {
+    Screen,  ///< libvterm's screen layer; damaged cells are copied to the terminal buffer
+    Grid     ///< The terminal buffer itself (VTermGrid); no copy, no damage callbacks
+};
+
+/// Sizes of libvterm's working buffers and of the reply batch
+struct VTermBufferSizes {
+    size_t scratch = 0;         ///< Decoded text runs and formatted replies (0 = libvterm's 4 KB; at least 4 KB)
+    size_t replyBatch = 4096;   ///< Replies held during one InputWrite() before they are sent early
+};
+
+/// Mouse input for the application
+/// libvterm reports it only as far as the tracking mode asks (see
+/// TermProps::mouseMode), in the protocol the application chose (X10, UTF-8,
+/// SGR or urxvt)
+struct MouseEvent {
+    int row = 0;
+    int col = 0;
+    int button = 0;             ///< 0: motion only; 1-3: buttons; 4/5: wheel up/down
+    bool pressed = false;
+    int modifiers = 0;          ///< VTermModifier bits
+};
+
 /// Cursor shape enumeration
 enum class CursorShape {
     Block,
@@ -80,18 +149,65 @@ struct TermProps {
     bool cursorVisible = true;    ///< Is cursor visible?
     bool cursorBlink = true;      ///< Should cursor blink?
     CursorShape cursorShape = CursorShape::Block;
-    bool altScreen = false;       ///< Is alternate screen buffer active?
+    bool altScreen = false;       ///< Is alternate screen buffer active? (leaving it sends
+                                  ///< no damage: the embedder restores its own primary screen)
     int mouseMode = 0;            ///< Mouse reporting mode
+    bool syncOutput = false;      ///< Synchronized output (DEC mode 2026): the application is drawing a frame
+    bool applicationCursor = false; ///< Cursor keys send SS3 sequences (DECCKM)
+    bool applicationKeypad = false; ///< Keypad keys send SS3 sequences (DECKPAM)
+};
+
+/// Receiver of the per-change events (see SetEventSink). Damage is
+/// required; the other handlers are used if the sink has them:
+///   void OnVTermDamage(int startRow, int endRow, int startCol, int endCol);
+///   bool OnVTermMoveRect(const TermRect& dest, const TermRect& src);
+///       Screen contents moved from src to dest (scrolls, line/char insert
+///       and delete); false falls back to damaging dest
+///   void OnVTermMoveCursor(int row, int col, bool visible);
+///   void OnVTermScrollbackRow(std::span<const Core::Cell> cells, bool continuation);
+///       A line scrolled off the top, in terminal buffer cells (Grid
+///       backend: the row as stored); continuation = it continues the line
+///       pushed before it (soft wrap)
+///   bool OnVTermScrollbackPop(std::span<Core::Cell> cells);
+///       The screen grew: fill cells with the most recent scrollback line
+///       and drop it from the scrollback, or return false to leave the new
+///       rows blank
+template <class Sink>
+concept VTermEventSink = requires(Sink& sink, int value) {
+    sink.OnVTermDamage(value, value, value, value);
 };
 
-/// Callback types for terminal events
-using DamageCallback = std::function<void(int startRow, int endRow, int startCol, int endCol)>;
-using MoveCursorCallback = std::function<void(int row, int col, bool visible)>;
+/// Callback types for the rarer terminal events
 using SetTermPropCallback = std::function<void(const TermProps& props)>;
 using BellCallback = std::function<void()>;
 using ResizeCallback = std::function<void(int rows, int cols)>;
 using OutputCallback = std::function<void(const char* data, size_t len)>;
-using ScrollbackPushCallback = std::function<void(const std::vector<TermCell>& cells)>;
+/// An OSC 8 hyperlink closed: the cells it covered on one line, columns [startCol, endCol).
+/// line counts from the first line ever shown: lines pushed to the scrollback so far plus the row.
+using HyperlinkCallback = std::function<void(uint64_t line, int startCol, int endCol, std::string_view uri)>;
+
+/// Shell integration marks (OSC 133, FinalTerm)
+enum class ShellMark {
+    PromptStart,        ///< A
+    CommandStart,       ///< B
+    OutputStart,        ///< C
+    CommandFinished     ///< D; may carry the exit code
+};
+/// A shell integration mark at the cursor; exitCode is -1 unless CommandFinished gives one
+using ShellMarkCallback = std::function<void(ShellMark kind, int row, int col, int exitCode)>;
+
+/// A sixel image (DCS q) received at the cursor
+struct InlineImage {
+    std::vector<char> payload;  ///< The data after the q, as received (Core::DecodeSixel)
+    uint32_t width = 0;         ///< Pixels (Core::MeasureSixel)
+    uint32_t height = 0;
+    int row = 0;                ///< Top left cell
+    int col = 0;
+    int rows = 0;               ///< Cells covered, at the cell size set (SetCellPixelSize)
+    int cols = 0;
+};
+/// A sixel image ended; the cursor moves below it once the callback returns
+using ImageCallback = std::function<void(InlineImage&& image)>;
 
 /// C++ wrapper for libvterm
 class VTermWrapper {
@@ -99,7 +215,13 @@ public:
     /// Create a new terminal emulator
     /// @param rows Initial row count
     /// @param cols Initial column count
-    explicit VTermWrapper(int rows = 25, int cols = 80);
+    /// @param allocator Where libvterm's memory comes from
+    /// @param grid Buffer for libvterm to draw on directly (the Grid
+    ///             backend; it must outlive the wrapper), or nullptr for
+    ///             libvterm's own screen
+    /// @param buffers Working buffer sizes
+    explicit VTermWrapper(int rows = 25, int cols = 80, VTermAllocator allocator = VTermAllocator::Process,
+                          Core::TerminalBuffer* grid = nullptr, const VTermBufferSizes& buffers = {});
     ~VTermWrapper();
 
     // Non-copyable, non-movable (VTerm* is unique)
@@ -109,6 +231,8 @@ public:
     VTermWrapper& operator=(VTermWrapper&&) = delete;
 
     /// Input data from PTY (VT sequences to parse)
+    /// Replies the data asks for (DA, DSR, ...) reach the output callback
+    /// together, once the data is parsed
     /// @param data Raw bytes from PTY
     /// @param length Number of bytes
     /// @return Number of bytes consumed
@@ -124,6 +248,10 @@ public:
     /// @param modifiers Modifier keys
     void KeyboardKey(int key, int modifiers = 0);
 
+    /// Input mouse events; the reports they make reach the output callback
+    /// together
+    void MouseInput(std::span<const MouseEvent> events);
+
     /// Resize the terminal
     /// @param rows New row count
     /// @param cols New column count
@@ -132,15 +260,44 @@ public:
     /// Get current terminal size
     void GetSize(int& rows, int& cols) const;
 
+    /// Parse the common VT subset natively ahead of libvterm's parser
+    /// (VTermFrontParser); the result is the same either way
+    void SetFrontParser(bool enable);
+
+    /// Check whether the native front parser is in use
+    [[nodiscard]] bool IsFrontParserEnabled() const noexcept { return m_frontParser != nullptr; }
+
+    /// Get how much input took the front parser's fast path (zero when off)
+    [[nodiscard]] FrontParserStats GetFrontParserStats() const noexcept {
+        return m_frontParser ? m_frontParser->GetStats() : FrontParserStats{};
+    }
+
+    /// Get which backend holds the screen
+    [[nodiscard]] EmulationBackend GetBackend() const noexcept {
+        return m_grid ? EmulationBackend::Grid : EmulationBackend::Screen;
+    }
+
     /// Get a cell at the specified position
     /// @param row Row (0-indexed)
     /// @param col Column (0-indexed)
     /// @return Cell data
     [[nodiscard]] TermCell GetCell(int row, int col) const;
 
+    /// Export part of a screen row straight into terminal buffer cells
+    /// One call per damaged row, no allocation; palette colors stay indexed
+    /// and default colors stay default.
+    /// @param row Row (0-indexed)
+    /// @param startCol First column to export
+    /// @param out Destination, one cell per column starting at startCol
+    /// @return Number of cells written (clipped to the screen width)
+    int ReadRow(int row, int startCol, std::span<Core::Cell> out) const;
+
     /// Get the current cursor position
     void GetCursorPos(int& row, int& col) const;
 
+    /// Check if a row continues the row above (the text wrapped there)
+    [[nodiscard]] bool IsContinuation(int row) const;
+
     /// Get current terminal properties
     [[nodiscard]] const TermProps& GetProps() const noexcept;
 
@@ -150,28 +307,81 @@ public:
     /// Flush pending damage notifications
     void FlushDamage();
 
+    /// Set the damage merge granularity
+    /// Anything coarser than Cell defers callbacks until FlushDamage(); Scroll
+    /// additionally reports a burst of scrolls as one move rect.
+    void SetDamageMerge(DamageMerge merge);
+
+    /// Get the damage merge granularity
+    [[nodiscard]] DamageMerge GetDamageMerge() const noexcept { return m_damageMerge; }
+
     /// Read output data (responses to terminal queries)
     /// @param buffer Buffer to read into
     /// @param maxLen Maximum bytes to read
     /// @return Number of bytes read
     size_t OutputRead(char* buffer, size_t maxLen);
 
+    /// Send the per-change events to sink (see VTermEventSink), which must
+    /// outlive the wrapper or be replaced first. Without ScrollbackPop
+    /// (Screen backend), libvterm can't pull lines back when the screen grows.
+    template <VTermEventSink Sink>
+    void SetEventSink(Sink& sink) noexcept {
+        m_sink = {};
+        m_sink.sink = &sink;
+        m_sink.damage = [](void* self, int startRow, int endRow, int startCol, int endCol) {
+            static_cast<Sink*>(self)->OnVTermDamage(startRow, endRow, startCol, endCol);
+        };
+        if constexpr (requires(Sink& s, const TermRect& rect) {
+                          { s.OnVTermMoveRect(rect, rect) } -> std::convertible_to<bool>;
+                      }) {
+            m_sink.moveRect = [](void* self, const TermRect& dest, const TermRect& src) -> bool {
+                return static_cast<Sink*>(self)->OnVTermMoveRect(dest, src);
+            };
+        }
+        if constexpr (requires(Sink& s) { s.OnVTermMoveCursor(0, 0, true); }) {
+            m_sink.moveCursor = [](void* self, int row, int col, bool visible) {
+                static_cast<Sink*>(self)->OnVTermMoveCursor(row, col, visible);
+            };
+        }
+        if constexpr (requires(Sink& s, std::span<const Core::Cell> cells) { s.OnVTermScrollbackRow(cells, true); }) {
+            m_sink.scrollbackRow = [](void* self, std::span<const Core::Cell> cells, bool continuation) {
+                static_cast<Sink*>(self)->OnVTermScrollbackRow(cells, continuation);
+            };
+        }
+        if constexpr (requires(Sink& s, std::span<Core::Cell> cells) {
+                          { s.OnVTermScrollbackPop(cells) } -> std::convertible_to<bool>;
+                      }) {
+            m_sink.scrollbackPop = [](void* self, std::span<Core::Cell> cells) -> bool {
+                return static_cast<Sink*>(self)->OnVTermScrollbackPop(cells);
+            };
+        }
+    }
+
+    /// Stop sending the per-change events
+    void ClearEventSink() noexcept { m_sink = {}; }
+
     // Callback setters
-    void SetDamageCallback(DamageCallback callback);
-    void SetMoveCursorCallback(MoveCursorCallback callback);
     void SetTermPropCallback(SetTermPropCallback callback);
     void SetBellCallback(BellCallback callback);
     void SetResizeCallback(ResizeCallback callback);
     void SetOutputCallback(OutputCallback callback);
-    void SetScrollbackPushCallback(ScrollbackPushCallback callback);
+    void SetHyperlinkCallback(HyperlinkCallback callback);
+    void SetShellMarkCallback(ShellMarkCallback callback);
+    /// Without one, sixel images are ignored and the cursor stays put
+    void SetImageCallback(ImageCallback callback);
 
-    /// Convert a VTermColor to RGB using the current palette
-    void ConvertColorToRgb(VTermColor& color) const;
+    /// Set a cell's size in device pixels, to size images in cells (any thread)
+    void SetCellPixelSize(int width, int height) noexcept;
 
     /// Get the underlying VTerm pointer (for advanced use)
     [[nodiscard]] VTerm* GetVTerm() const noexcept { return m_vterm; }
 
+    /// Get libvterm's allocation counts (any thread)
+    [[nodiscard]] VTermAllocStats GetAllocStats() const noexcept { return m_heap.GetStats(); }
+
 private:
+    friend class VTermGrid;
+
     // libvterm callback handlers (static for C callback interface)
     static int OnDamage(VTermRect rect, void* user);
     static int OnMoveRect(VTermRect dest, VTermRect src, void* user);
@@ -179,32 +389,93 @@ private:
     static int OnSetTermProp(VTermProp prop, VTermValue* val, void* user);
     static int OnBell(void* user);
     static int OnResize(int rows, int cols, void* user);
-    static int OnScrollbackPush(int cols, const VTermScreenCell* cells, void* user);
+    static int OnScrollbackPush(int cols, const VTermScreenCell* cells, bool continuation, void* user);
     static int OnScrollbackPop(int cols, VTermScreenCell* cells, void* user);
+    static int OnOsc(int command, VTermStringFragment frag, void* user);
+    static int OnDcs(const char* command, size_t commandlen, VTermStringFragment frag, void* user);
+
+    /// Handle a complete OSC 8: "params;URI" opens a link, an empty URI closes it
+    void OnHyperlink(std::string_view text);
+    /// Report the open link's cells up to the cursor
+    void CloseHyperlink();
+    /// Handle a complete OSC 133 (shell integration mark)
+    void OnShellMark(std::string_view text);
+    /// Handle a complete sixel image held in m_imagePayload
+    void OnSixel();
 
     // Output callback
     static void OnOutput(const char* s, size_t len, void* user);
 
+    /// Send the batched replies to the output callback
+    void FlushReplies();
+
+    /// Hand a line scrolled off the screen to the callback
+    void PushScrollbackRow(std::span<const Core::Cell> cells, bool continuation);
+
 private:
+    VTermHeap m_heap;                   ///< Outlives m_vterm
     VTerm* m_vterm = nullptr;
-    VTermScreen* m_screen = nullptr;
+    VTermScreen* m_screen = nullptr;    ///< Screen backend only
+    std::unique_ptr<VTermGrid> m_grid;  ///< Grid backend only
+    std::unique_ptr<VTermFrontParser> m_frontParser; ///< Null: libvterm parses everything
     
     // Current state
     TermProps m_props;
     int m_cursorRow = 0;
     int m_cursorCol = 0;
+    DamageMerge m_damageMerge = DamageMerge::Cell;
+
+    // Per-change events: the sink and a thunk per handler it has (see
+    // SetEventSink); a null thunk drops the event
+    struct EventSink {
+        void* sink = nullptr;
+        void (*damage)(void* self, int startRow, int endRow, int startCol, int endCol) = nullptr;
+        bool (*moveRect)(void* self, const TermRect& dest, const TermRect& src) = nullptr;
+        void (*moveCursor)(void* self, int row, int col, bool visible) = nullptr;
+        void (*scrollbackRow)(void* self, std::span<const Core::Cell> cells, bool continuation) = nullptr;
+        bool (*scrollbackPop)(void* self, std::span<Core::Cell> cells) = nullptr;
+    };
+    EventSink m_sink;
 
     // Callbacks
-    DamageCallback m_damageCallback;
-    MoveCursorCallback m_moveCursorCallback;
     SetTermPropCallback m_termPropCallback;
     BellCallback m_bellCallback;
     ResizeCallback m_resizeCallback;
     OutputCallback m_outputCallback;
-    ScrollbackPushCallback m_scrollbackPushCallback;
+    HyperlinkCallback m_hyperlinkCallback;
+    ShellMarkCallback m_shellMarkCallback;
+    ImageCallback m_imageCallback;
+
+    // Replies to the host held while InputWrite() parses
+    std::string m_replies;
+    size_t m_replyBatch = 0;
+    bool m_batchReplies = false;
+
+    // Title and icon name as received, to skip repeats without decoding
+    VTermStringAccumulator m_titleText;
+    VTermStringAccumulator m_iconNameText;
+    std::string m_titleUtf8;
+    std::string m_iconNameUtf8;
+
+    // OSC 8 and 133: the sequence being received; OSC 8: the link open since
+    VTermStringAccumulator m_oscText;
+    std::string m_linkUri;
+    uint64_t m_linkLine = 0;
+    int m_linkCol = 0;
+    uint64_t m_linesPushed = 0;
+
+    // Sixel: the image being received, dropped once past kMaxImagePayload
+    std::vector<char> m_imagePayload;
+    bool m_imageOverflow = false;
+    std::atomic<int> m_cellPixelWidth{10};
+    std::atomic<int> m_cellPixelHeight{20};
+
+    // Scrollback line being pushed or popped, reused for every line
+    std::vector<Core::Cell> m_scrollbackRow;
 
     // Screen callbacks structure (must persist for lifetime)
     VTermScreenCallbacks m_screenCallbacks{};
+    VTermStateFallbacks m_fallbacks{};
 };
 
 } // namespace Console3::Emulation
@@ -0,0 +1,362 @@
+// Console3 - BoxDrawing.cpp
+// Box-drawing and block-element glyphs drawn from cell geometry
+
+#include "UI/BoxDrawing.h"
+#include <wrl/client.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+using Microsoft::WRL::ComPtr;
+
+namespace Console3::UI {
+
+namespace {
+
+// Stroke of an arm running from the cell center to an edge
+constexpr uint8_t kNone = 0;
+constexpr uint8_t kLight = 1;
+constexpr uint8_t kHeavy = 2;
+constexpr uint8_t kDouble = 3;
+
+constexpr uint8_t Arms(uint8_t up, uint8_t right, uint8_t down, uint8_t left) noexcept {
+    return static_cast<uint8_t>(up | right << 2 | down << 4 | left << 6);
+}
+
+constexpr uint8_t L = kLight;
+constexpr uint8_t H = kHeavy;
+constexpr uint8_t D = kDouble;
+
+/// Arms of U+2500-257F (up, right, down, left); 0 for dashes, arcs and
+/// diagonals, which are drawn on their own
+constexpr std::array<uint8_t, 0x80> kBoxArms = {
+    // U+2500
+    Arms(0, L, 0, L), Arms(0, H, 0, H), Arms(L, 0, L, 0), Arms(H, 0, H, 0),
+    0, 0, 0, 0, 0, 0, 0, 0,
+    Arms(0, L, L, 0), Arms(0, H, L, 0), Arms(0, L, H, 0), Arms(0, H, H, 0),
+    // U+2510
+    Arms(0, 0, L, L), Arms(0, 0, L, H), Arms(0, 0, H, L), Arms(0, 0, H, H),
+    Arms(L, L, 0, 0), Arms(L, H, 0, 0), Arms(H, L, 0, 0), Arms(H, H, 0, 0),
+    Arms(L, 0, 0, L), Arms(L, 0, 0, H), Arms(H, 0, 0, L), Arms(H, 0, 0, H),
+    Arms(L, L, L, 0), Arms(L, H, L, 0), Arms(H, L, L, 0), Arms(L, L, H, 0),
+    // U+2520
+    Arms(H, L, H, 0), Arms(H, H, L, 0), Arms(L, H, H, 0), Arms(H, H, H, 0),
+    Arms(L, 0, L, L), Arms(L, 0, L, H), Arms(H, 0, L, L), Arms(L, 0, H, L),
+    Arms(H, 0, H, L), Arms(H, 0, L, H), Arms(L, 0, H, H), Arms(H, 0, H, H),
+    Arms(0, L, L, L), Arms(0, L, L, H), Arms(0, H, L, L), Arms(0, H, L, H),
+    // U+2530
+    Arms(0, L, H, L), Arms(0, L, H, H), Arms(0, H, H, L), Arms(0, H, H, H),
+    Arms(L, L, 0, L), Arms(L, L, 0, H), Arms(L, H, 0, L), Arms(L, H, 0, H),
+    Arms(H, L, 0, L), Arms(H, L, 0, H), Arms(H, H, 0, L), Arms(H, H, 0, H),
+    Arms(L, L, L, L), Arms(L, L, L, H), Arms(L, H, L, L), Arms(L, H, L, H),
+    // U+2540
+    Arms(H, L, L, L), Arms(L, L, H, L), Arms(H, L, H, L), Arms(H, L, L, H),
+    Arms(H, H, L, L), Arms(L, L, H, H), Arms(L, H, H, L), Arms(H, H, L, H),
+    Arms(L, H, H, H), Arms(H, L, H, H), Arms(H, H, H, L), Arms(H, H, H, H),
+    0, 0, 0, 0,
+    // U+2550
+    Arms(0, D, 0, D), Arms(D, 0, D, 0), Arms(0, D, L, 0), Arms(0, L, D, 0),
+    Arms(0, D, D, 0), Arms(0, 0, L, D), Arms(0, 0, D, L), Arms(0, 0, D, D),
+    Arms(L, D, 0, 0), Arms(D, L, 0, 0), Arms(D, D, 0, 0), Arms(L, 0, 0, D),
+    Arms(D, 0, 0, L), Arms(D, 0, 0, D), Arms(L, D, L, 0), Arms(D, L, D, 0),
+    // U+2560
+    Arms(D, D, D, 0), Arms(L, 0, L, D), Arms(D, 0, D, L), Arms(D, 0, D, D),
+    Arms(0, D, L, D), Arms(0, L, D, L), Arms(0, D, D, D), Arms(L, D, 0, D),
+    Arms(D, L, 0, L), Arms(D, D, 0, D), Arms(L, D, L, D), Arms(D, L, D, L),
+    Arms(D, D, D, D), 0, 0, 0,
+    // U+2570
+    0, 0, 0, 0,
+    Arms(0, 0, 0, L), Arms(L, 0, 0, 0), Arms(0, L, 0, 0), Arms(0, 0, L, 0),
+    Arms(0, 0, 0, H), Arms(H, 0, 0, 0), Arms(0, H, 0, 0), Arms(0, 0, H, 0),
+    Arms(0, H, 0, L), Arms(L, 0, H, 0), Arms(0, L, 0, H), Arms(H, 0, L, 0),
+};
+
+/// Quadrants of U+2596-259F: upper left 1, upper right 2, lower left 4,
+/// lower right 8
+constexpr std::array<uint8_t, 10> kQuadrants = {4, 8, 1, 13, 9, 7, 11, 2, 6, 14};
+
+/// A cell slot addressed in whole device pixels
+class Canvas {
+public:
+    Canvas(ID2D1RenderTarget* target, ID2D1SolidColorBrush* brush, const D2D1_RECT_F& slot, float scaleX,
+           float scaleY)
+        : m_target(target), m_brush(brush), m_left(slot.left), m_top(slot.top), m_scaleX(scaleX),
+          m_scaleY(scaleY),
+          width(std::max(static_cast<int>(std::lround((slot.right - slot.left) * scaleX)), 1)),
+          height(std::max(static_cast<int>(std::lround((slot.bottom - slot.top) * scaleY)), 1)),
+          light(std::max(static_cast<int>(std::lround(static_cast<float>(width) / 8.0f)), 1)) {}
+
+    /// Fill pixels [x0, x1) x [y0, y1)
+    void Fill(int x0, int y0, int x1, int y1, float opacity = 1.0f) const {
+        if (x1 <= x0 || y1 <= y0) {
+            return;
+        }
+        m_brush->SetOpacity(opacity);
+        m_target->FillRectangle(D2D1::RectF(m_left + static_cast<float>(x0) / m_scaleX,
+                                            m_top + static_cast<float>(y0) / m_scaleY,
+                                            m_left + static_cast<float>(x1) / m_scaleX,
+                                            m_top + static_cast<float>(y1) / m_scaleY),
+                                m_brush);
+        m_brush->SetOpacity(1.0f);
+    }
+
+    [[nodiscard]] D2D1_POINT_2F Point(float x, float y) const noexcept {
+        return D2D1::Point2F(m_left + x / m_scaleX, m_top + y / m_scaleY);
+    }
+
+    /// Stroke width of a light line (DIPs)
+    [[nodiscard]] float Stroke() const noexcept { return static_cast<float>(light) / m_scaleY; }
+
+    [[nodiscard]] ID2D1RenderTarget* Target() const noexcept { return m_target; }
+    [[nodiscard]] ID2D1SolidColorBrush* Brush() const noexcept { return m_brush; }
+
+private:
+    ID2D1RenderTarget* m_target;
+    ID2D1SolidColorBrush* m_brush;
+    float m_left;
+    float m_top;
+    float m_scaleX;
+    float m_scaleY;
+
+public:
+    const int width;        ///< Pixels
+    const int height;
+    const int light;        ///< Light line thickness; heavy is twice, double is two lights a light apart
+};
+
+/// Offset of a centered stroke
+[[nodiscard]] constexpr int Centered(int size, int thickness) noexcept {
+    return (size - thickness) / 2;
+}
+
+/// Draw one arm of a box-drawing character
+/// @param vertical Up or down arm (else left or right)
+/// @param far Right or down arm (toward the far edge)
+/// @param opposite The arm on the other side of the center
+/// @param perpFirst Perpendicular arm on the left (vertical arms) or top
+/// @param perpSecond Perpendicular arm on the right or bottom
+void DrawArm(const Canvas& canvas, bool vertical, bool far, uint8_t weight, uint8_t opposite, uint8_t perpFirst,
+             uint8_t perpSecond) {
+    const int along = vertical ? canvas.height : canvas.width;
+    const int across = vertical ? canvas.width : canvas.height;
+    const int light = canvas.light;
+    const auto thickness = [light](uint8_t stroke) { return stroke == kHeavy ? 2 * light : light; };
+
+    // Where the arm stops short of the center: the end of a near-side arm
+    // and the start of a far-side one
+    const int doubleAt = Centered(along, 3 * light);
+    const auto center = [&]() { return along / 2; };
+    const auto nearDouble = [&]() { return far ? doubleAt + 2 * light : doubleAt + light; };
+    const auto farDouble = [&]() { return far ? doubleAt : doubleAt + 3 * light; };
+    const auto cover = [&](int stroke) {
+        const int start = Centered(along, stroke);
+        return far ? start : start + stroke;
+    };
+
+    const auto fill = [&](int inner, int from, int to) {
+        const int a0 = far ? inner : 0;
+        const int a1 = far ? along : inner;
+        if (vertical) {
+            canvas.Fill(from, a0, to, a1);
+        } else {
+            canvas.Fill(a0, from, a1, to);
+        }
+    };
+
+    if (weight != kDouble) {
+        // Across a perpendicular double line: through to the center if the
+        // line continues on the other side, to the near line at a T, to the
+        // far line at a corner. Across single lines: over the widest one.
+        int inner = 0;
+        if (perpFirst == kDouble || perpSecond == kDouble) {
+            inner = opposite != kNone                                ? center()
+                  : perpFirst == kDouble && perpSecond == kDouble   ? nearDouble()
+                                                                    : farDouble();
+        } else if (perpFirst != kNone || perpSecond != kNone) {
+            inner = cover(std::max(perpFirst != kNone ? thickness(perpFirst) : 0,
+                                   perpSecond != kNone ? thickness(perpSecond) : 0));
+        } else {
+            inner = cover(thickness(weight));
+        }
+        const int stroke = thickness(weight);
+        const int from = Centered(across, stroke);
+        fill(inner, from, from + stroke);
+        return;
+    }
+
+    // Double: each line meets the perpendicular arm on its own side, or
+    // turns the corner to the other side's
+    for (int line = 0; line < 2; ++line) {
+        const uint8_t perp = line == 0 ? perpFirst : perpSecond;
+        const uint8_t other = line == 0 ? perpSecond : perpFirst;
+        const int inner = perp == kDouble    ? nearDouble()
+                        : perp != kNone      ? cover(thickness(perp))
+                        : other == kDouble   ? farDouble()
+                        : other != kNone     ? cover(thickness(other))
+                                             : center();
+        const int from = Centered(across, 3 * light) + 2 * light * line;
+        fill(inner, from, from + light);
+    }
+}
+
+void DrawLines(const Canvas& canvas, uint8_t arms) {
+    const uint8_t up = arms & 3;
+    const uint8_t right = arms >> 2 & 3;
+    const uint8_t down = arms >> 4 & 3;
+    const uint8_t left = arms >> 6 & 3;
+
+    if (up != kNone) DrawArm(canvas, true, false, up, down, left, right);
+    if (down != kNone) DrawArm(canvas, true, true, down, up, left, right);
+    if (left != kNone) DrawArm(canvas, false, false, left, right, up, down);
+    if (right != kNone) DrawArm(canvas, false, true, right, left, up, down);
+}
+
+void DrawDashes(const Canvas& canvas, bool vertical, bool heavy, int dashes) {
+    const int along = vertical ? canvas.height : canvas.width;
+    const int across = vertical ? canvas.width : canvas.height;
+    const int stroke = heavy ? 2 * canvas.light : canvas.light;
+    const int from = Centered(across, stroke);
+
+    // Evenly spaced, each centered in its share of the cell
+    for (int dash = 0; dash < dashes; ++dash) {
+        const int start = along * dash / dashes;
+        const int end = along * (dash + 1) / dashes;
+        const int gap = std::max((end - start) / 3, 1);
+        const int a0 = start + gap / 2;
+        const int a1 = end - (gap - gap / 2);
+        if (vertical) {
+            canvas.Fill(from, a0, from + stroke, a1);
+        } else {
+            canvas.Fill(a0, from, a1, from + stroke);
+        }
+    }
+}
+
+/// Rounded corner (U+256D-2570) joining two light arms
+void DrawArc(const Canvas& canvas, bool toRight, bool toBottom) {
+    ComPtr<ID2D1Factory> factory;
+    canvas.Target()->GetFactory(factory.GetAddressOf());
+    ComPtr<ID2D1PathGeometry> path;
+    ComPtr<ID2D1GeometrySink> sink;
+    if (!factory || FAILED(factory->CreatePathGeometry(path.GetAddressOf())) ||
+        FAILED(path->Open(sink.GetAddressOf()))) {
+        return;
+    }
+
+    // Along the light lines' centers, turning with the largest radius that
+    // fits the cell
+    const auto width = static_cast<float>(canvas.width);
+    const auto height = static_cast<float>(canvas.height);
+    const float x = static_cast<float>(Centered(canvas.width, canvas.light)) + canvas.light * 0.5f;
+    const float y = static_cast<float>(Centered(canvas.height, canvas.light)) + canvas.light * 0.5f;
+    const float radius = std::min({x, width - x, y, height - y});
+    const float dx = toRight ? 1.0f : -1.0f;
+    const float dy = toBottom ? 1.0f : -1.0f;
+
+    sink->BeginFigure(canvas.Point(toRight ? width : 0.0f, y), D2D1_FIGURE_BEGIN_HOLLOW);
+    sink->AddLine(canvas.Point(x + dx * radius, y));
+    const D2D1_POINT_2F corner = canvas.Point(x, y + dy * radius);
+    const D2D1_POINT_2F origin = canvas.Point(0.0f, 0.0f);
+    const D2D1_POINT_2F extent = canvas.Point(radius, radius);
+    sink->AddArc(D2D1::ArcSegment(corner, D2D1::SizeF(extent.x - origin.x, extent.y - origin.y), 0.0f,
+                                  toRight == toBottom ? D2D1_SWEEP_DIRECTION_COUNTER_CLOCKWISE
+                                                      : D2D1_SWEEP_DIRECTION_CLOCKWISE,
+                                  D2D1_ARC_SIZE_SMALL));
+    sink->AddLine(canvas.Point(x, toBottom ? height : 0.0f));
+    sink->EndFigure(D2D1_FIGURE_END_OPEN);
+    if (SUCCEEDED(sink->Close())) {
+        canvas.Target()->DrawGeometry(path.Get(), canvas.Brush(), canvas.Stroke());
+    }
+}
+
+/// Diagonals (U+2571-2573), corner to corner and a little past, so they
+/// continue into diagonal neighbours
+void DrawDiagonals(const Canvas& canvas, bool rising, bool falling) {
+    const auto width = static_cast<float>(canvas.width);
+    const auto height = static_cast<float>(canvas.height);
+    const float overshootX = width * 0.1f;
+    const float overshootY = height * 0.1f;
+    if (rising) {
+        canvas.Target()->DrawLine(canvas.Point(-overshootX, height + overshootY),
+                                  canvas.Point(width + overshootX, -overshootY), canvas.Brush(), canvas.Stroke());
+    }
+    if (falling) {
+        canvas.Target()->DrawLine(canvas.Point(-overshootX, -overshootY),
+                                  canvas.Point(width + overshootX, height + overshootY), canvas.Brush(),
+                                  canvas.Stroke());
+    }
+}
+
+void DrawBlock(const Canvas& canvas, uint32_t codepoint) {
+    const int width = canvas.width;
+    const int height = canvas.height;
+    const auto eighthX = [width](int eighths) { return (width * eighths + 4) / 8; };
+    const auto eighthY = [height](int eighths) { return (height * eighths + 4) / 8; };
+
+    if (codepoint == 0x2580) {                                  // Upper half
+        canvas.Fill(0, 0, width, eighthY(4));
+    } else if (codepoint <= 0x2588) {                           // Lower eighths, full block
+        canvas.Fill(0, eighthY(8 - static_cast<int>(codepoint - 0x2580)), width, height);
+    } else if (codepoint <= 0x258F) {                           // Left eighths
+        canvas.Fill(0, 0, eighthX(static_cast<int>(0x2590 - codepoint)), height);
+    } else if (codepoint == 0x2590) {                           // Right half
+        canvas.Fill(eighthX(4), 0, width, height);
+    } else if (codepoint <= 0x2593) {                           // Shades, as flat coverage
+        canvas.Fill(0, 0, width, height, static_cast<float>(codepoint - 0x2590) * 0.25f);
+    } else if (codepoint == 0x2594) {                           // Upper eighth
+        canvas.Fill(0, 0, width, eighthY(1));
+    } else if (codepoint == 0x2595) {                           // Right eighth
+        canvas.Fill(eighthX(7), 0, width, height);
+    } else {                                                    // Quadrants
+        const uint8_t quadrants = kQuadrants[codepoint - 0x2596];
+        const int midX = eighthX(4);
+        const int midY = eighthY(4);
+        if (quadrants & 1) canvas.Fill(0, 0, midX, midY);
+        if (quadrants & 2) canvas.Fill(midX, 0, width, midY);
+        if (quadrants & 4) canvas.Fill(0, midY, midX, height);
+        if (quadrants & 8) canvas.Fill(midX, midY, width, height);
+    }
+}
+
+} // namespace
+
+bool DrawBoxGlyph(uint32_t codepoint, ID2D1RenderTarget* target, ID2D1SolidColorBrush* brush,
+                  const D2D1_RECT_F& slot, float scaleX, float scaleY) {
+    if (!IsBoxDrawing(codepoint) || !target || !brush) {
+        return false;
+    }
+
+    const Canvas canvas(target, brush, slot, scaleX, scaleY);
+
+    // Rectangles sit on whole pixels; only curves and diagonals blend
+    const D2D1_ANTIALIAS_MODE mode = target->GetAntialiasMode();
+    target->SetAntialiasMode(D2D1_ANTIALIAS_MODE_ALIASED);
+
+    if (codepoint >= 0x2580) {
+        DrawBlock(canvas, codepoint);
+    } else if (codepoint >= 0x2504 && codepoint <= 0x250B) {
+        const uint32_t index = codepoint - 0x2504;
+        DrawDashes(canvas, (index & 2) != 0, (index & 1) != 0, index < 4 ? 3 : 4);
+    } else if (codepoint >= 0x254C && codepoint <= 0x254F) {
+        const uint32_t index = codepoint - 0x254C;
+        DrawDashes(canvas, (index & 2) != 0, (index & 1) != 0, 2);
+    } else if (codepoint >= 0x256D && codepoint <= 0x2573) {
+        target->SetAntialiasMode(D2D1_ANTIALIAS_MODE_PER_PRIMITIVE);
+        switch (codepoint) {
+        case 0x256D: DrawArc(canvas, true, true); break;
+        case 0x256E: DrawArc(canvas, false, true); break;
+        case 0x256F: DrawArc(canvas, false, false); break;
+        case 0x2570: DrawArc(canvas, true, false); break;
+        case 0x2571: DrawDiagonals(canvas, true, false); break;
+        case 0x2572: DrawDiagonals(canvas, false, true); break;
+        default:     DrawDiagonals(canvas, true, true); break;
+        }
+    } else {
+        DrawLines(canvas, kBoxArms[codepoint - 0x2500]);
+    }
+
+    target->SetAntialiasMode(mode);
+    return true;
+}
+
+} // namespace Console3::UI
@@ -0,0 +1,41 @@
+#pragma once
+// Console3 - BoxDrawing.h
+// Box-drawing and block-element glyphs drawn from cell geometry
+//
+// TUI borders, tree views and progress bars are made of U+2500-259F. Drawn
+// from a font, their lines are placed by the font's design grid rather than
+// the cell's, so adjacent cells show seams or overlaps, and a font lacking
+// them sends every one through font fallback. Instead the glyph atlas draws
+// them here into its slot: lines and blocks as rectangles on whole device
+// pixels, positioned only from the cell size so neighbouring cells meet
+// exactly, and rounded corners and diagonals as antialiased geometry.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+#include <d2d1_1.h>
+
+#include <cstdint>
+
+namespace Console3::UI {
+
+/// Check if a character is drawn from cell geometry (U+2500-259F)
+[[nodiscard]] constexpr bool IsBoxDrawing(uint32_t codepoint) noexcept {
+    return codepoint >= 0x2500 && codepoint <= 0x259F;
+}
+
+/// Draw a box-drawing or block-element character as a coverage mask
+/// (between BeginDraw and EndDraw, the slot cleared)
+/// @param slot Cell rectangle in the target (DIPs, on whole device pixels)
+/// @param scaleX Device pixels per DIP
+/// @param scaleY Device pixels per DIP
+/// @return false if the character is not one (see IsBoxDrawing)
+bool DrawBoxGlyph(uint32_t codepoint, ID2D1RenderTarget* target, ID2D1SolidColorBrush* brush,
+                  const D2D1_RECT_F& slot, float scaleX, float scaleY);
+
+} // namespace Console3::UI
@@ -0,0 +1,367 @@
+// Console3 - CellGridRenderer.cpp
+// Draws the terminal grid with one instanced Direct3D draw
+
+#include "UI/CellGridRenderer.h"
+#include <d3dcompiler.h>
+#include <algorithm>
+#include <cmath>
+
+#pragma comment(lib, "d3dcompiler.lib")
+
+namespace Console3::UI {
+
+namespace {
+
+// Glyph packing: slot origin in the page (pixels), page, color and valid bits
+constexpr uint32_t kGlyphCoordMask = 0x7FF;
+constexpr uint32_t kGlyphPageShift = 22;
+constexpr uint32_t kGlyphColor = 1u << 30;
+constexpr uint32_t kGlyphValid = 1u << 31;
+
+/// One quad per cell: the vertex shader places it from the instance index,
+/// the pixel shader composes the cell from the layers front to back
+constexpr char kShaderSource[] = R"hlsl(
+struct GridCell {
+    uint glyph;
+    uint flags;
+    uint fg;
+    uint bg;
+};
+
+cbuffer Grid : register(b0) {
+    float2 viewSize;
+    float2 cellSize;
+    uint cols;
+    uint rows;
+    uint cursorIndex;
+    uint cursorShape;
+    uint selectionStart;
+    uint selectionEnd;
+    uint cursorColor;
+    uint selectionColor;
+    float baseline;
+    float lineWidth;
+    uint selectionBlock;
+};
+
+StructuredBuffer<GridCell> cells : register(t0);
+Texture2DArray<float4> atlas : register(t1);
+
+struct Fragment {
+    float4 position : SV_Position;
+    float2 local : TEXCOORD0;
+    nointerpolation uint index : CELL;
+};
+
+Fragment VSMain(uint vertex : SV_VertexID, uint instance : SV_InstanceID) {
+    const float2 corner = float2(vertex & 1, vertex >> 1);
+    const float2 pixel = (float2(instance % cols, instance / cols) + corner) * cellSize;
+
+    Fragment output;
+    output.position = float4(pixel / viewSize * float2(2.0, -2.0) + float2(-1.0, 1.0), 0.0, 1.0);
+    output.local = corner * cellSize;
+    output.index = instance;
+    return output;
+}
+
+float3 Unpack(uint color) {
+    return float3(color & 0xFF, (color >> 8) & 0xFF, (color >> 16) & 0xFF) / 255.0;
+}
+
+float4 PSMain(Fragment input) : SV_Target {
+    const GridCell cell = cells[input.index];
+    const float3 fg = Unpack(cell.fg);
+    const float y = input.local.y;
+
+    float3 color = Unpack(cell.bg);
+    bool selected = input.index >= selectionStart && input.index < selectionEnd;
+    if (selectionBlock != 0) {
+        // Only the corners' columns, on every row between
+        const uint col = input.index % cols;
+        selected = selected && col >= selectionStart % cols && col <= (selectionEnd - 1) % cols;
+    }
+    if (selected) {
+        color = Unpack(selectionColor);
+    }
+
+    if (cell.glyph & 0x80000000) {
+        const int2 slot = int2(cell.glyph & 0x7FF, (cell.glyph >> 11) & 0x7FF);
+        const float4 ink = atlas.Load(int4(slot + int2(input.local), (cell.glyph >> 22) & 0x7, 0));
+        // Color glyphs are premultiplied; the rest are coverage masks
+        color = (cell.glyph & 0x40000000) ? ink.rgb + color * (1.0 - ink.a) : lerp(color, fg, ink.a);
+    }
+
+    const uint underline = cell.flags & 0x3;
+    const float under = baseline + lineWidth;
+    if ((underline == 1 || underline == 2) && y >= under && y < under + lineWidth) {
+        color = fg;
+    }
+    if (underline == 2 && y >= under + 2.0 * lineWidth && y < under + 3.0 * lineWidth) {
+        color = fg;
+    }
+    if (underline == 3) {
+        // One sine period per cell, continuous across the run
+        const float wave = under + lineWidth * (1.0 - sin(input.local.x / cellSize.x * 6.2831853));
+        if (abs(y + 0.5 - wave) < lineWidth * 0.75) {
+            color = fg;
+        }
+    }
+    const float strike = cellSize.y * 0.5;
+    if ((cell.flags & 0x4) && y >= strike - 0.5 * lineWidth && y < strike + 0.5 * lineWidth) {
+        color = fg;
+    }
+
+    if (input.index == cursorIndex &&
+        (cursorShape == 1 ||
+         (cursorShape == 2 && y >= cellSize.y - 2.0 * lineWidth) ||
+         (cursorShape == 3 && input.local.x < 2.0 * lineWidth))) {
+        color = Unpack(cursorColor);
+    }
+    return float4(color, 1.0);
+}
+)hlsl";
+
+/// Compile an entry point of kShaderSource
+ComPtr<ID3DBlob> CompileShader(const char* entryPoint, const char* target) {
+    ComPtr<ID3DBlob> code;
+    ComPtr<ID3DBlob> errors;
+    if (FAILED(D3DCompile(kShaderSource, sizeof(kShaderSource) - 1, "CellGrid", nullptr, nullptr,
+                          entryPoint, target, D3DCOMPILE_OPTIMIZATION_LEVEL3, 0,
+                          code.GetAddressOf(), errors.GetAddressOf()))) {
+        if (errors) {
+            OutputDebugStringA(static_cast<const char*>(errors->GetBufferPointer()));
+        }
+        return nullptr;
+    }
+    return code;
+}
+
+} // namespace
+
+bool CellGridRenderer::Initialize(ID3D11Device* device) {
+    Shutdown();
+    if (!device) {
+        return false;
+    }
+
+    // Structured buffers in pixel shaders need shader model 5
+    if (device->GetFeatureLevel() < D3D_FEATURE_LEVEL_11_0) {
+        return false;
+    }
+
+    const ComPtr<ID3DBlob> vertexCode = CompileShader("VSMain", "vs_5_0");
+    const ComPtr<ID3DBlob> pixelCode = CompileShader("PSMain", "ps_5_0");
+    if (!vertexCode || !pixelCode) {
+        return false;
+    }
+
+    D3D11_BUFFER_DESC desc{};
+    desc.ByteWidth = sizeof(Constants);
+    desc.Usage = D3D11_USAGE_DYNAMIC;
+    desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    ComPtr<ID3D11VertexShader> vertexShader;
+    ComPtr<ID3D11PixelShader> pixelShader;
+    if (FAILED(device->CreateVertexShader(vertexCode->GetBufferPointer(), vertexCode->GetBufferSize(),
+                                          nullptr, vertexShader.GetAddressOf())) ||
+        FAILED(device->CreatePixelShader(pixelCode->GetBufferPointer(), pixelCode->GetBufferSize(),
+                                         nullptr, pixelShader.GetAddressOf())) ||
+        FAILED(device->CreateBuffer(&desc, nullptr, m_constants.GetAddressOf()))) {
+        Shutdown();
+        return false;
+    }
+
+    m_device = device;
+    device->GetImmediateContext(m_context.GetAddressOf());
+    m_vertexShader = vertexShader;
+    m_pixelShader = pixelShader;
+    return true;
+}
+
+void CellGridRenderer::Shutdown() {
+    m_cellView.Reset();
+    m_cellBuffer.Reset();
+    m_cellBufferSize = 0;
+    m_constants.Reset();
+    m_pixelShader.Reset();
+    m_vertexShader.Reset();
+    m_context.Reset();
+    m_device.Reset();
+
+    // A new buffer starts empty
+    m_dirtyFirst = 0;
+    m_dirtyLast = m_rows - 1;
+}
+
+void CellGridRenderer::SetMetrics(float cellWidth, float cellHeight, float baseline,
+                                  float scaleX, float scaleY) {
+    m_cellWidth = cellWidth * scaleX;
+    m_cellHeight = cellHeight * scaleY;
+    m_baseline = baseline * scaleY;
+    m_scaleX = scaleX;
+    m_scaleY = scaleY;
+}
+
+void CellGridRenderer::Resize(int cols, int rows) {
+    m_cols = std::max(cols, 0);
+    m_rows = std::max(rows, 0);
+    m_cells.assign(static_cast<size_t>(m_cols) * m_rows, GridCell{});
+    m_dirtyFirst = 0;
+    m_dirtyLast = m_rows - 1;
+}
+
+void CellGridRenderer::MarkRowDirty(int row) noexcept {
+    if (m_dirtyLast < m_dirtyFirst) {
+        m_dirtyFirst = row;
+        m_dirtyLast = row;
+    } else {
+        m_dirtyFirst = std::min(m_dirtyFirst, row);
+        m_dirtyLast = std::max(m_dirtyLast, row);
+    }
+}
+
+void CellGridRenderer::SetCursor(GridCursor shape, int row, int col, uint32_t color) noexcept {
+    m_cursorShape = shape;
+    m_cursorIndex = static_cast<uint32_t>(row * m_cols + col);
+    m_cursorColor = color;
+}
+
+void CellGridRenderer::SetSelection(int startRow, int startCol, int endRow, int endCol,
+                                    uint32_t color, bool block) noexcept {
+    m_selectionStart = static_cast<uint32_t>(std::max(startRow * m_cols + startCol, 0));
+    m_selectionEnd = static_cast<uint32_t>(std::max(endRow * m_cols + endCol, 0));
+    m_selectionColor = color;
+    m_selectionBlock = block;
+}
+
+uint32_t CellGridRenderer::PackGlyph(const AtlasGlyph* glyph, int half) const noexcept {
+    if (!glyph) {
+        return 0;
+    }
+
+    // Slots start on whole pixels
+    auto x = static_cast<uint32_t>(std::lround(glyph->source.left * m_scaleX));
+    const auto y = static_cast<uint32_t>(std::lround(glyph->source.top * m_scaleY));
+    if (half != 0) {
+        x += static_cast<uint32_t>(std::lround(m_cellWidth));
+    }
+    return kGlyphValid | (glyph->color ? kGlyphColor : 0) |
+           (static_cast<uint32_t>(glyph->pageIndex) << kGlyphPageShift) |
+           ((y & kGlyphCoordMask) << 11) | (x & kGlyphCoordMask);
+}
+
+uint32_t CellGridRenderer::PackColor(const Color& color) noexcept {
+    const auto channel = [](float value) {
+        return static_cast<uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+    };
+    return PackColor(channel(color.r), channel(color.g), channel(color.b), channel(color.a));
+}
+
+bool CellGridRenderer::Draw(ID3D11RenderTargetView* target, ID3D11ShaderResourceView* atlas,
+                            UINT width, UINT height, const Color& clearColor, float scale) {
+    if (!IsInitialized() || !target) {
+        return false;
+    }
+
+    const float clear[4] = {clearColor.r, clearColor.g, clearColor.b, 1.0f};
+    m_context->ClearRenderTargetView(target, clear);
+
+    const size_t count = m_cells.size();
+    if (count == 0 || width == 0 || height == 0) {
+        return true;
+    }
+    if (m_cellBufferSize != count && !CreateCellBuffer()) {
+        return false;
+    }
+
+    // Only the rows changed since the last draw
+    if (m_dirtyFirst <= m_dirtyLast) {
+        const UINT stride = sizeof(GridCell) * static_cast<UINT>(m_cols);
+        const D3D11_BOX box{static_cast<UINT>(m_dirtyFirst) * stride, 0, 0,
+                            static_cast<UINT>(m_dirtyLast + 1) * stride, 1, 1};
+        m_context->UpdateSubresource(m_cellBuffer.Get(), 0, &box, GetRow(m_dirtyFirst), 0, 0);
+        m_dirtyFirst = 0;
+        m_dirtyLast = -1;
+    }
+
+    D3D11_MAPPED_SUBRESOURCE mapped{};
+    if (FAILED(m_context->Map(m_constants.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) {
+        return false;
+    }
+    // Scaled, cells keep their size in the atlas and cover more of the view
+    Constants constants{};
+    constants.viewSize[0] = static_cast<float>(width) / scale;
+    constants.viewSize[1] = static_cast<float>(height) / scale;
+    constants.cellSize[0] = m_cellWidth;
+    constants.cellSize[1] = m_cellHeight;
+    constants.cols = static_cast<uint32_t>(m_cols);
+    constants.rows = static_cast<uint32_t>(m_rows);
+    constants.cursorIndex = m_cursorIndex;
+    constants.cursorShape = static_cast<uint32_t>(m_cursorShape);
+    constants.selectionStart = m_selectionStart;
+    constants.selectionEnd = m_selectionEnd;
+    constants.cursorColor = m_cursorColor;
+    constants.selectionColor = m_selectionColor;
+    constants.baseline = m_baseline;
+    constants.lineWidth = std::max(std::round(m_scaleY), 1.0f);
+    constants.selectionBlock = m_selectionBlock ? 1 : 0;
+    *static_cast<Constants*>(mapped.pData) = constants;
+    m_context->Unmap(m_constants.Get(), 0);
+
+    const D3D11_VIEWPORT viewport{0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height),
+                                  0.0f, 1.0f};
+    ID3D11ShaderResourceView* views[2] = {m_cellView.Get(), atlas};
+    ID3D11Buffer* constantBuffer = m_constants.Get();
+
+    m_context->OMSetRenderTargets(1, &target, nullptr);
+    m_context->OMSetBlendState(nullptr, nullptr, 0xFFFFFFFF);
+    m_context->RSSetState(nullptr);
+    m_context->RSSetViewports(1, &viewport);
+    m_context->IASetInputLayout(nullptr);
+    m_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+    m_context->VSSetShader(m_vertexShader.Get(), nullptr, 0);
+    m_context->VSSetConstantBuffers(0, 1, &constantBuffer);
+    m_context->PSSetShader(m_pixelShader.Get(), nullptr, 0);
+    m_context->PSSetConstantBuffers(0, 1, &constantBuffer);
+    m_context->PSSetShaderResources(0, 2, views);
+
+    m_context->DrawInstanced(4, static_cast<UINT>(count), 0, 0);
+
+    // Let go of the back buffer and atlas, which Direct2D draws into next
+    ID3D11ShaderResourceView* noViews[2] = {};
+    ID3D11RenderTargetView* noTarget = nullptr;
+    m_context->PSSetShaderResources(0, 2, noViews);
+    m_context->OMSetRenderTargets(1, &noTarget, nullptr);
+    return true;
+}
+
+bool CellGridRenderer::CreateCellBuffer() {
+    m_cellView.Reset();
+    m_cellBuffer.Reset();
+    m_cellBufferSize = 0;
+
+    D3D11_BUFFER_DESC desc{};
+    desc.ByteWidth = static_cast<UINT>(sizeof(GridCell) * m_cells.size());
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+    desc.StructureByteStride = sizeof(GridCell);
+
+    const D3D11_SUBRESOURCE_DATA data{m_cells.data(), 0, 0};
+    if (FAILED(m_device->CreateBuffer(&desc, &data, m_cellBuffer.GetAddressOf())) ||
+        FAILED(m_device->CreateShaderResourceView(m_cellBuffer.Get(), nullptr,
+                                                  m_cellView.GetAddressOf()))) {
+        m_cellBuffer.Reset();
+        m_cellView.Reset();
+        return false;
+    }
+
+    // Created with the whole grid
+    m_cellBufferSize = m_cells.size();
+    m_dirtyFirst = 0;
+    m_dirtyLast = -1;
+    return true;
+}
+
+} // namespace Console3::UI
@@ -0,0 +1,178 @@
+#pragma once
+// Console3 - CellGridRenderer.h
+// Draws the terminal grid with one instanced Direct3D draw
+//
+// The Direct2D path issues fills and glyph copies per run of cells. This
+// renderer instead keeps the grid on the GPU as a structured buffer of
+// cells (atlas glyph, foreground, background, underline/strikethrough) and
+// draws it as one instanced quad per cell: the pixel shader picks the
+// background or selection color, blends the glyph from the atlas texture
+// array, and adds the lines and cursor. Per frame the CPU uploads only the
+// rows that changed and a small constant buffer.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+#include <d3d11.h>
+#include <wrl/client.h>
+
+#include "UI/D2DRenderer.h"
+#include "UI/GlyphAtlas.h"
+
+#include <cstdint>
+#include <vector>
+
+using Microsoft::WRL::ComPtr;
+
+namespace Console3::UI {
+
+/// A cell as the shader reads it (16 bytes)
+struct GridCell {
+    uint32_t glyph = 0;     ///< CellGridRenderer::PackGlyph(), 0 = no glyph
+    uint32_t flags = 0;     ///< Underline (0-3) | kFlagStrikethrough
+    uint32_t fg = 0;        ///< CellGridRenderer::PackColor()
+    uint32_t bg = 0;
+};
+
+/// Cursor shape drawn by the shader
+enum class GridCursor : uint32_t {
+    None = 0,
+    Block = 1,
+    Underline = 2,
+    Bar = 3,
+};
+
+/// Cell grid drawn by a single instanced draw call
+class CellGridRenderer {
+public:
+    static constexpr uint32_t kFlagUnderlineMask = 0x3;
+    static constexpr uint32_t kFlagStrikethrough = 0x4;
+
+    CellGridRenderer() = default;
+    ~CellGridRenderer() = default;
+
+    CellGridRenderer(const CellGridRenderer&) = delete;
+    CellGridRenderer& operator=(const CellGridRenderer&) = delete;
+
+    /// Compile the shaders and create the device resources
+    /// @return false if the device can't run them
+    [[nodiscard]] bool Initialize(ID3D11Device* device);
+
+    /// Release the device resources (the cells are kept)
+    void Shutdown();
+
+    [[nodiscard]] bool IsInitialized() const noexcept { return m_pixelShader != nullptr; }
+
+    /// Set the cell metrics
+    /// @param cellWidth Cell width (DIPs)
+    /// @param cellHeight Cell height (DIPs)
+    /// @param baseline Baseline from the cell top (DIPs)
+    /// @param scaleX Pixels per DIP
+    /// @param scaleY Pixels per DIP
+    void SetMetrics(float cellWidth, float cellHeight, float baseline, float scaleX, float scaleY);
+
+    /// Size the grid; every cell becomes blank and is uploaded
+    void Resize(int cols, int rows);
+
+    [[nodiscard]] int GetCols() const noexcept { return m_cols; }
+    [[nodiscard]] int GetRows() const noexcept { return m_rows; }
+
+    /// Get a row's cells to fill in (call MarkRowDirty after)
+    [[nodiscard]] GridCell* GetRow(int row) noexcept { return m_cells.data() + static_cast<size_t>(row) * m_cols; }
+
+    /// Upload a row with the next draw
+    void MarkRowDirty(int row) noexcept;
+
+    /// Set the cursor (GridCursor::None to hide it)
+    void SetCursor(GridCursor shape, int row, int col, uint32_t color) noexcept;
+
+    /// Set the selection as a range of cells in reading order, end excluded,
+    /// or with block set the rectangle of columns [startCol, endCol) on rows
+    /// [startRow, endRow]
+    void SetSelection(int startRow, int startCol, int endRow, int endCol, uint32_t color,
+                      bool block = false) noexcept;
+
+    /// Pack an atlas glyph for GridCell::glyph
+    /// @param glyph Glyph from the texture-mode atlas (nullptr = none)
+    /// @param half 0, or 1 for the right cell of a wide glyph
+    [[nodiscard]] uint32_t PackGlyph(const AtlasGlyph* glyph, int half) const noexcept;
+
+    /// Pack a color for GridCell::fg/bg
+    [[nodiscard]] static uint32_t PackColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) noexcept {
+        return r | (static_cast<uint32_t>(g) << 8) | (static_cast<uint32_t>(b) << 16) |
+               (static_cast<uint32_t>(a) << 24);
+    }
+    [[nodiscard]] static uint32_t PackColor(const Color& color) noexcept;
+
+    /// Upload the dirty rows and draw the grid
+    /// @param target Render target (the window's back buffer)
+    /// @param atlas Glyph atlas texture array (may be null: no glyphs yet)
+    /// @param width Target width in pixels
+    /// @param height Target height in pixels
+    /// @param clearColor Fill for the part of the target outside the grid
+    /// @param scale Stretch of the grid from the top left (a zoom preview)
+    /// @return false if the cell buffer could not be created
+    bool Draw(ID3D11RenderTargetView* target, ID3D11ShaderResourceView* atlas,
+              UINT width, UINT height, const Color& clearColor, float scale = 1.0f);
+
+private:
+    /// Constant buffer layout (16-byte rows, as HLSL packs it)
+    struct Constants {
+        float viewSize[2];
+        float cellSize[2];
+        uint32_t cols;
+        uint32_t rows;
+        uint32_t cursorIndex;
+        uint32_t cursorShape;
+        uint32_t selectionStart;
+        uint32_t selectionEnd;
+        uint32_t cursorColor;
+        uint32_t selectionColor;
+        float baseline;
+        float lineWidth;
+        uint32_t selectionBlock;
+        float padding;
+    };
+
+    /// Create the cell buffer for the current grid size
+    bool CreateCellBuffer();
+
+    ComPtr<ID3D11Device> m_device;
+    ComPtr<ID3D11DeviceContext> m_context;
+    ComPtr<ID3D11VertexShader> m_vertexShader;
+    ComPtr<ID3D11PixelShader> m_pixelShader;
+    ComPtr<ID3D11Buffer> m_constants;
+    ComPtr<ID3D11Buffer> m_cellBuffer;
+    ComPtr<ID3D11ShaderResourceView> m_cellView;
+    size_t m_cellBufferSize = 0;        ///< Cells the buffer holds
+
+    // CPU copy of the grid and the rows not uploaded yet
+    std::vector<GridCell> m_cells;
+    int m_cols = 0;
+    int m_rows = 0;
+    int m_dirtyFirst = 0;
+    int m_dirtyLast = -1;
+
+    // Metrics (pixels)
+    float m_cellWidth = 0.0f;
+    float m_cellHeight = 0.0f;
+    float m_baseline = 0.0f;
+    float m_scaleX = 1.0f;
+    float m_scaleY = 1.0f;
+
+    // Overlays
+    GridCursor m_cursorShape = GridCursor::None;
+    uint32_t m_cursorIndex = 0;
+    uint32_t m_cursorColor = 0;
+    uint32_t m_selectionStart = 0;
+    uint32_t m_selectionEnd = 0;
+    uint32_t m_selectionColor = 0;
+    bool m_selectionBlock = false;
+};
+
+} // namespace Console3::UI
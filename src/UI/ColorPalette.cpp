@@ -0,0 +1,139 @@
+// Console3 - ColorPalette.cpp
+// Resolves cell colors to renderer colors
+
+#include "UI/ColorPalette.h"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace Console3::UI {
+
+namespace {
+
+/// Channel levels of the xterm 6x6x6 color cube
+constexpr uint8_t kCubeLevels[6] = {0, 95, 135, 175, 215, 255};
+
+/// The colors a compiled palette is made from (the name doesn't matter)
+using SchemeKey = std::array<uint32_t, 20>;
+
+SchemeKey KeyOf(const Core::ColorScheme& scheme) noexcept {
+    SchemeKey key{scheme.foreground, scheme.background, scheme.cursorColor, scheme.selectionBackground};
+    std::copy(std::begin(scheme.palette), std::end(scheme.palette), key.begin() + 4);
+    return key;
+}
+
+/// Palettes compiled and still in use somewhere, so views showing the same
+/// scheme share one table
+struct CompiledEntry {
+    SchemeKey key;
+    std::weak_ptr<const CompiledPalette> palette;
+};
+std::mutex g_compiledLock;
+std::vector<CompiledEntry> g_compiled;
+
+} // namespace
+
+std::shared_ptr<const CompiledPalette> CompiledPalette::Compile(const Core::ColorScheme& scheme) {
+    const SchemeKey key = KeyOf(scheme);
+    std::lock_guard lock(g_compiledLock);
+    std::erase_if(g_compiled, [](const CompiledEntry& entry) { return entry.palette.expired(); });
+    for (const CompiledEntry& entry : g_compiled) {
+        if (entry.key == key) {
+            if (auto palette = entry.palette.lock()) {
+                return palette;
+            }
+        }
+    }
+
+    auto palette = std::make_shared<CompiledPalette>();
+    for (size_t index = 0; index < 16; ++index) {
+        palette->indexed[index] = ColorPalette::FromRgb(scheme.palette[index]);
+    }
+    for (size_t index = 16; index < 232; ++index) {
+        const size_t cube = index - 16;
+        palette->indexed[index] = ColorPalette::FromRgb((static_cast<uint32_t>(kCubeLevels[cube / 36]) << 16) |
+                                                        (static_cast<uint32_t>(kCubeLevels[cube / 6 % 6]) << 8) |
+                                                        kCubeLevels[cube % 6]);
+    }
+    for (size_t index = 232; index < 256; ++index) {
+        const auto level = static_cast<uint32_t>(8 + (index - 232) * 10);
+        palette->indexed[index] = ColorPalette::FromRgb((level << 16) | (level << 8) | level);
+    }
+    palette->defaultFg = ColorPalette::FromRgb(scheme.foreground);
+    palette->defaultBg = ColorPalette::FromRgb(scheme.background);
+    palette->cursor = ColorPalette::FromRgb(scheme.cursorColor);
+    palette->selection = ColorPalette::FromRgb(scheme.selectionBackground);
+
+    g_compiled.push_back(CompiledEntry{key, palette});
+    return palette;
+}
+
+ColorPalette::ColorPalette() {
+    Load(Core::ColorScheme{});
+}
+
+void ColorPalette::Use(std::shared_ptr<const CompiledPalette> palette) noexcept {
+    m_compiled = std::move(palette);
+    m_own.reset();
+    m_table = m_compiled.get();
+}
+
+CompiledPalette& ColorPalette::MakeUnique() {
+    // Compiled tables may be shared at any time and are never changed; the
+    // first change makes a private copy
+    if (!m_own) {
+        m_own = std::make_shared<CompiledPalette>(*m_compiled);
+        m_compiled = m_own;
+        m_table = m_own.get();
+    }
+    return *m_own;
+}
+
+void ColorPalette::SetEntry(uint8_t index, uint8_t r, uint8_t g, uint8_t b) {
+    MakeUnique().indexed[index] =
+        FromRgb((static_cast<uint32_t>(r) << 16) | (static_cast<uint32_t>(g) << 8) | b);
+}
+
+void ColorPalette::SetDefaults(uint32_t foreground, uint32_t background) {
+    CompiledPalette& table = MakeUnique();
+    table.defaultFg = FromRgb(foreground);
+    table.defaultBg = FromRgb(background);
+}
+
+ResolvedColor ColorPalette::FromRgb(uint32_t rgb) noexcept {
+    const auto r = static_cast<uint8_t>(rgb >> 16);
+    const auto g = static_cast<uint8_t>(rgb >> 8);
+    const auto b = static_cast<uint8_t>(rgb);
+    return ResolvedColor{Color::FromRgb(r, g, b),
+                         r | (static_cast<uint32_t>(g) << 8) | (static_cast<uint32_t>(b) << 16) | 0xFF000000u};
+}
+
+const ResolvedColor& ColorPalette::ResolveRgb(Core::CellColor color) noexcept {
+    const uint32_t key = Key(color);
+
+    // Linear probing from a multiplicative hash
+    size_t slot = (key * 0x9E3779B1u) >> 24 & (kCacheSlots - 1);
+    while (m_cache[slot].key != kEmptyKey) {
+        if (m_cache[slot].key == key) {
+            return m_cache[slot].value;
+        }
+        slot = (slot + 1) & (kCacheSlots - 1);
+    }
+
+    // Past three quarters full, probes get long; start over rather than
+    // track which colors are still in use
+    if (m_cacheUsed >= kCacheSlots * 3 / 4) {
+        m_cache.fill(CacheSlot{});
+        m_cacheUsed = 0;
+        slot = (key * 0x9E3779B1u) >> 24 & (kCacheSlots - 1);
+    }
+
+    m_cache[slot].key = key;
+    m_cache[slot].value = FromRgb((static_cast<uint32_t>(color.r) << 16) |
+                                  (static_cast<uint32_t>(color.g) << 8) | color.b);
+    ++m_cacheUsed;
+    return m_cache[slot].value;
+}
+
+} // namespace Console3::UI
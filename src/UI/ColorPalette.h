@@ -0,0 +1,119 @@
+#pragma once
+// Console3 - ColorPalette.h
+// Resolves cell colors to renderer colors
+//
+// Cells store colors packed (CellColor): default, an index into the 256
+// color palette, or 24-bit RGB. A color scheme is compiled once into an
+// immutable table (CompiledPalette): the full xterm 256-color palette, the
+// defaults, cursor and selection, each in both the float form Direct2D
+// takes and the packed form the cell grid shader takes. Compiled tables are
+// shared by every view showing the same scheme. Cells keep their indexes, so
+// switching schemes swaps one table pointer and repaints; nothing in the
+// buffers is touched.
+//
+// An indexed or default color costs an array lookup; RGB colors go through
+// a small open-addressing cache keyed on the packed CellColor, so each
+// distinct color is converted once rather than once per cell per frame. The
+// cache does not depend on the scheme and survives a switch.
+
+#include "UI/D2DRenderer.h"
+#include "Core/Cell.h"
+#include "Core/Settings.h"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+
+namespace Console3::UI {
+
+/// A cell color resolved for drawing
+struct ResolvedColor {
+    Color color;
+    uint32_t rgba = 0;      ///< r | g << 8 | b << 16 | a << 24 (CellGridRenderer::PackColor)
+
+    bool operator==(const ResolvedColor& other) const noexcept { return rgba == other.rgba; }
+};
+
+/// A color scheme resolved for drawing (immutable once compiled)
+struct CompiledPalette {
+    std::array<ResolvedColor, 256> indexed;
+    ResolvedColor defaultFg;
+    ResolvedColor defaultBg;
+    ResolvedColor cursor;
+    ResolvedColor selection;
+
+    /// Compile a color scheme: the defaults and the 16 ANSI colors; entries
+    /// 16-255 are the xterm 6x6x6 cube and gray ramp
+    /// A scheme with the same colors as one compiled earlier and still in
+    /// use gets the same table.
+    [[nodiscard]] static std::shared_ptr<const CompiledPalette> Compile(const Core::ColorScheme& scheme);
+};
+
+/// The compiled palette in use and an RGB conversion cache
+class ColorPalette {
+public:
+    static constexpr size_t kCacheSlots = 256;     ///< RGB cache size (power of two)
+
+    /// Start with the default color scheme
+    ColorPalette();
+
+    /// Load a color scheme (compiled, or the shared table for it)
+    void Load(const Core::ColorScheme& scheme) { Use(CompiledPalette::Compile(scheme)); }
+
+    /// Switch to a compiled palette
+    void Use(std::shared_ptr<const CompiledPalette> palette) noexcept;
+
+    /// Set one palette entry (the table is copied first if it is shared)
+    void SetEntry(uint8_t index, uint8_t r, uint8_t g, uint8_t b);
+
+    /// Set the default foreground and background (copied first if shared)
+    void SetDefaults(uint32_t foreground, uint32_t background);
+
+    /// Resolve a cell color
+    /// @param foreground Resolve a default color as the foreground
+    [[nodiscard]] const ResolvedColor& Resolve(Core::CellColor color, bool foreground) noexcept {
+        if (color.IsDefault()) {
+            return foreground ? m_table->defaultFg : m_table->defaultBg;
+        }
+        if (color.IsIndexed()) {
+            return m_table->indexed[color.r];
+        }
+        return ResolveRgb(color);
+    }
+
+    [[nodiscard]] const CompiledPalette& GetCompiled() const noexcept { return *m_table; }
+    [[nodiscard]] const ResolvedColor& GetDefaultFg() const noexcept { return m_table->defaultFg; }
+    [[nodiscard]] const ResolvedColor& GetDefaultBg() const noexcept { return m_table->defaultBg; }
+
+    /// Make a resolved color from 0xRRGGBB
+    [[nodiscard]] static ResolvedColor FromRgb(uint32_t rgb) noexcept;
+
+private:
+    /// No packed RGB CellColor has flag bits set
+    static constexpr uint32_t kEmptyKey = 0xFFFFFFFF;
+
+    struct CacheSlot {
+        uint32_t key = kEmptyKey;
+        ResolvedColor value;
+    };
+
+    [[nodiscard]] static uint32_t Key(Core::CellColor color) noexcept {
+        return color.r | (static_cast<uint32_t>(color.g) << 8) | (static_cast<uint32_t>(color.b) << 16) |
+               (static_cast<uint32_t>(color.flags) << 24);
+    }
+
+    /// Resolve an RGB color through the cache
+    [[nodiscard]] const ResolvedColor& ResolveRgb(Core::CellColor color) noexcept;
+
+    /// Get the table to change, copied from the compiled one the first time
+    CompiledPalette& MakeUnique();
+
+    std::shared_ptr<const CompiledPalette> m_compiled;
+    std::shared_ptr<CompiledPalette> m_own;        ///< m_compiled once changed (never shared)
+    const CompiledPalette* m_table = nullptr;      ///< m_compiled, without the shared_ptr on the hot path
+
+    std::array<CacheSlot, kCacheSlots> m_cache;
+    size_t m_cacheUsed = 0;
+};
+
+} // namespace Console3::UI
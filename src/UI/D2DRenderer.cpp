@@ -2,13 +2,83 @@
 // Direct2D rendering wrapper implementation
 
 #include "UI/D2DRenderer.h"
+#include "UI/BoxDrawing.h"
+#include "UI/CellGridRenderer.h"
+#include "Core/Utf.h"
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 
 #pragma comment(lib, "d2d1.lib")
+#pragma comment(lib, "d3d11.lib")
+#pragma comment(lib, "dcomp.lib")
+#pragma comment(lib, "dxgi.lib")
 #pragma comment(lib, "dwrite.lib")
 
 namespace Console3::UI {
 
+namespace {
+
+/// Find the face a font family resolves to for a weight and style
+/// (simulated bold or oblique if the family has no such face)
+ComPtr<IDWriteFontFace> FindFontFace(IDWriteFontCollection* fontCollection, const std::wstring& family,
+                                     DWRITE_FONT_WEIGHT weight, DWRITE_FONT_STYLE style) {
+    UINT32 index = 0;
+    BOOL exists = FALSE;
+    if (FAILED(fontCollection->FindFamilyName(family.c_str(), &index, &exists)) || !exists) {
+        return nullptr;
+    }
+
+    ComPtr<IDWriteFontFamily> fontFamily;
+    ComPtr<IDWriteFont> font;
+    ComPtr<IDWriteFontFace> face;
+    if (FAILED(fontCollection->GetFontFamily(index, fontFamily.GetAddressOf())) ||
+        FAILED(fontFamily->GetFirstMatchingFont(weight, DWRITE_FONT_STRETCH_NORMAL, style,
+                                                font.GetAddressOf())) ||
+        FAILED(font->CreateFontFace(face.GetAddressOf()))) {
+        return nullptr;
+    }
+    return face;
+}
+
+/// Longest BeginDraw() waits for the swap chain to take a frame (ms)
+constexpr DWORD kFrameLatencyTimeoutMs = 100;
+
+/// Characters whose glyph indices are tabled per font face: Latin through
+/// Cyrillic, general punctuation, arrows, box drawing and block elements
+constexpr UINT32 kGlyphIndexTableSize = 0x3000;
+
+/// Atlases kept for fonts and DPIs not in use (a window moved between two
+/// or three monitors finds its glyphs again)
+constexpr size_t kParkedAtlases = 2;
+
+/// Brushes cached before those not used this frame are dropped (truecolor
+/// output would otherwise leave one per color ever drawn)
+constexpr size_t kMaxBrushes = 1024;
+
+/// Image textures kept (see DrawImage); each is as large as its decoded
+/// pixels, which the image store bounds as well
+constexpr size_t kImageTextureBytes = 64u << 20;
+
+/// Cache key of a font family at a size
+std::wstring FontKey(const std::wstring& family, float size) {
+    return family + L'|' + std::to_wstring(size);
+}
+
+/// Cache key of cell metrics and atlases: the font, the DPI and snapping
+std::wstring MetricsKey(const std::wstring& family, float size, float scaleX, float scaleY, bool snap) {
+    return FontKey(family, size) + L'|' + std::to_wstring(scaleX) + L',' + std::to_wstring(scaleY) +
+           (snap ? L"|snap" : L"");
+}
+
+} // namespace
+
+RenderBackend ParseRenderBackend(const std::wstring& name) noexcept {
+    if (name == L"hwnd") return RenderBackend::HwndTarget;
+    if (name == L"software") return RenderBackend::Software;
+    return RenderBackend::SwapChain;
+}
+
 D2DRenderer::D2DRenderer() = default;
 
 D2DRenderer::~D2DRenderer() {
@@ -16,7 +86,9 @@ D2DRenderer::~D2DRenderer() {
 }
 
 bool D2DRenderer::Initialize(const RendererConfig& config) {
-    if (!config.hwnd || !config.d2dFactory || !config.dwriteFactory) {
+    // Only the offscreen backend can do without a window, given a size
+    const bool windowless = config.backend == RenderBackend::Offscreen && config.width && config.height;
+    if ((!config.hwnd && !windowless) || !config.d2dFactory || !config.dwriteFactory) {
         return false;
     }
 
@@ -26,6 +98,12 @@ bool D2DRenderer::Initialize(const RendererConfig& config) {
     m_backgroundColor = config.backgroundColor;
     m_dpiScaleX = config.dpiScaleX;
     m_dpiScaleY = config.dpiScaleY;
+    m_backend = config.backend;
+    m_allowTearing = config.allowTearing;
+    m_gpuPreference = config.gpuPreference;
+    m_snapCells = config.snapCellsToPixels;
+    m_opacity = std::clamp(config.opacity, 0.0f, 1.0f);
+    m_offscreenSize = D2D1::SizeU(config.width, config.height);
 
     // Create device resources
     if (!CreateDeviceResources()) {
@@ -47,23 +125,56 @@ void D2DRenderer::Shutdown() {
     m_hwnd = nullptr;
 }
 
-bool D2DRenderer::Resize(UINT width, UINT height) {
+bool D2DRenderer::Resize(UINT width, UINT height, bool keepFrame) {
     if (!m_renderTarget) {
         return false;
     }
 
+    if (!keepFrame) {
+        ReleaseFrame();
+    }
+    ++m_tileGeneration;
+
+    if (m_swapChain) {
+        // Flip-model buffers resize only with nothing referencing them
+        m_deviceContext->SetTarget(nullptr);
+        m_backBuffer.Reset();
+        m_backBufferView.Reset();
+        m_presentAll = true;
+
+        if (FAILED(m_swapChain->ResizeBuffers(0, std::max(width, 1u), std::max(height, 1u),
+                                              DXGI_FORMAT_UNKNOWN, m_swapChainFlags))) {
+            return RecoverDevice();
+        }
+        return CreateBackBufferTarget();
+    }
+
+    if (m_offscreenTexture) {
+        m_presentAll = true;
+        return CreateOffscreenTarget(D2D1::SizeU(width, height)) || RecoverDevice();
+    }
+
+    if (m_dcTarget) {
+        m_presentAll = true;
+        return CreateSoftwareBuffer(D2D1::SizeU(width, height)) || RecoverDevice();
+    }
+
     D2D1_SIZE_U size = D2D1::SizeU(width, height);
-    HRESULT hr = m_renderTarget->Resize(size);
+    HRESULT hr = m_hwndTarget->Resize(size);
     return SUCCEEDED(hr);
 }
 
 void D2DRenderer::SetDpi(float dpiX, float dpiY) {
+    if (dpiX / 96.0f == m_dpiScaleX && dpiY / 96.0f == m_dpiScaleY) {
+        return;
+    }
     m_dpiScaleX = dpiX / 96.0f;
     m_dpiScaleY = dpiY / 96.0f;
 
     if (m_renderTarget) {
         m_renderTarget->SetDpi(dpiX, dpiY);
     }
+    ReleaseFrame();
 
     // Recalculate font metrics with new DPI
     UpdateCellMetrics();
@@ -78,8 +189,26 @@ bool D2DRenderer::BeginDraw() {
         return false;
     }
 
+    // Another window lost the device this one shares; move to the new one
+    if (m_d3dDevice && m_sharedDeviceGeneration != SharedRenderResources::Shared().GetDeviceGeneration() &&
+        !RecoverDevice()) {
+        return false;
+    }
+
+    // Render only once the swap chain can take the frame, so it shows the
+    // latest state instead of queueing behind frames not yet on screen
+    if (m_frameLatencyWaitable) {
+        WaitForSingleObjectEx(m_frameLatencyWaitable, kFrameLatencyTimeoutMs, TRUE);
+    }
+
     m_renderTarget->BeginDraw();
+    m_renderTarget->SetTransform(D2D1::Matrix3x2F::Scale(m_previewScale, m_previewScale));
+    if (m_previewScale != 1.0f) {
+        m_presentAll = true;
+    }
     m_isDrawing = true;
+    m_atlas->NextFrame();
+    ++m_brushFrame;
     return true;
 }
 
@@ -90,299 +219,1765 @@ bool D2DRenderer::EndDraw() {
 
     m_isDrawing = false;
     HRESULT hr = m_renderTarget->EndDraw();
+    if (SUCCEEDED(hr) && m_swapChain) {
+        hr = Present();
+    } else if (SUCCEEDED(hr) && m_dcTarget) {
+        hr = PresentSoftware();
+    }
 
-    if (hr == D2DERR_RECREATE_TARGET) {
-        // Device lost - need to recreate resources
-        DiscardDeviceResources();
-        return CreateDeviceResources();
+    if (hr == D2DERR_RECREATE_TARGET || hr == DXGI_ERROR_DEVICE_REMOVED || hr == DXGI_ERROR_DEVICE_RESET) {
+        // The frame went with the device; the caller draws it again
+        (void)RecoverDevice();
+        return false;
     }
 
     return SUCCEEDED(hr);
 }
 
-void D2DRenderer::Clear() {
-    Clear(m_backgroundColor);
-}
-
-void D2DRenderer::Clear(const Color& color) {
-    if (m_renderTarget && m_isDrawing) {
-        m_renderTarget->Clear(color.ToD2D());
+bool D2DRenderer::RestoreDeviceCaches(size_t budget) {
+    if (!m_d2dFactory || m_isDrawing) {
+        return false;
     }
-}
 
-void D2DRenderer::FillRect(float x, float y, float width, float height, const Color& color) {
-    if (!m_renderTarget || !m_isDrawing) return;
+    // A device may not be available for a while (a driver being installed)
+    if (!m_renderTarget && !CreateDeviceResources()) {
+        return true;
+    }
 
-    ID2D1SolidColorBrush* brush = GetBrush(color);
-    if (brush) {
-        D2D1_RECT_F rect = D2D1::RectF(x, y, x + width, y + height);
-        m_renderTarget->FillRectangle(rect, brush);
+    for (const auto& [hash, color] : m_lostBrushes) {
+        ComPtr<ID2D1SolidColorBrush> brush;
+        if (!m_brushCache.contains(hash) &&
+            SUCCEEDED(m_renderTarget->CreateSolidColorBrush(color, brush.GetAddressOf()))) {
+            m_brushCache.emplace(hash, CachedBrush{std::move(brush), m_brushFrame});
+        }
     }
+    m_lostBrushes.clear();
+
+    return m_atlas->Refill(m_renderTarget.Get(), budget);
 }
 
-void D2DRenderer::DrawRect(float x, float y, float width, float height, 
-                           const Color& color, float strokeWidth) {
-    if (!m_renderTarget || !m_isDrawing) return;
+bool D2DRenderer::WaitForGpu() {
+    if (!m_d3dDevice) {
+        return false;
+    }
 
-    ID2D1SolidColorBrush* brush = GetBrush(color);
-    if (brush) {
-        D2D1_RECT_F rect = D2D1::RectF(x, y, x + width, y + height);
-        m_renderTarget->DrawRectangle(rect, brush, strokeWidth);
+    // An event query signals once the commands issued before it are done
+    ComPtr<ID3D11DeviceContext> context;
+    ComPtr<ID3D11Query> query;
+    const D3D11_QUERY_DESC desc{D3D11_QUERY_EVENT, 0};
+    m_d3dDevice->GetImmediateContext(context.GetAddressOf());
+    if (FAILED(m_d3dDevice->CreateQuery(&desc, query.GetAddressOf()))) {
+        return false;
+    }
+    context->End(query.Get());
+
+    BOOL done = FALSE;
+    HRESULT hr;
+    while ((hr = context->GetData(query.Get(), &done, sizeof(done), 0)) == S_FALSE) {
+        YieldProcessor();
     }
+    return SUCCEEDED(hr) && done;
 }
 
-void D2DRenderer::DrawLine(float x1, float y1, float x2, float y2, 
-                           const Color& color, float strokeWidth) {
-    if (!m_renderTarget || !m_isDrawing) return;
+bool D2DRenderer::ReadPixels(std::vector<uint32_t>& pixels, UINT& width, UINT& height) {
+    if (!m_offscreenTexture || m_isDrawing) {
+        return false;
+    }
 
-    ID2D1SolidColorBrush* brush = GetBrush(color);
-    if (brush) {
-        m_renderTarget->DrawLine(D2D1::Point2F(x1, y1), D2D1::Point2F(x2, y2), 
-                                  brush, strokeWidth);
+    // Copy to a texture the CPU can map; rows may be padded
+    D3D11_TEXTURE2D_DESC desc{};
+    m_offscreenTexture->GetDesc(&desc);
+    desc.Usage = D3D11_USAGE_STAGING;
+    desc.BindFlags = 0;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    desc.MiscFlags = 0;
+
+    ComPtr<ID3D11Texture2D> staging;
+    ComPtr<ID3D11DeviceContext> context;
+    if (FAILED(m_d3dDevice->CreateTexture2D(&desc, nullptr, staging.GetAddressOf()))) {
+        return false;
     }
-}
+    m_d3dDevice->GetImmediateContext(context.GetAddressOf());
+    context->CopyResource(staging.Get(), m_offscreenTexture.Get());
 
-void D2DRenderer::DrawText(const std::wstring& text, float x, float y, 
-                           const Color& color, const std::wstring& /*fontName*/) {
-    if (!m_renderTarget || !m_isDrawing || !m_textFormat || text.empty()) return;
+    D3D11_MAPPED_SUBRESOURCE mapped{};
+    if (FAILED(context->Map(staging.Get(), 0, D3D11_MAP_READ, 0, &mapped))) {
+        return false;
+    }
+    width = desc.Width;
+    height = desc.Height;
+    pixels.resize(static_cast<size_t>(width) * height);
+    for (UINT row = 0; row < height; ++row) {
+        std::memcpy(pixels.data() + static_cast<size_t>(row) * width,
+                    static_cast<const uint8_t*>(mapped.pData) + static_cast<size_t>(row) * mapped.RowPitch,
+                    width * sizeof(uint32_t));
+    }
+    context->Unmap(staging.Get(), 0);
+    return true;
+}
 
-    ID2D1SolidColorBrush* brush = GetBrush(color);
-    if (!brush) return;
+RenderCounters D2DRenderer::TakeCounters() noexcept {
+    m_atlas->TakeLookupCounts(m_counters.atlasHits, m_counters.atlasMisses);
+    return std::exchange(m_counters, RenderCounters{});
+}
 
-    D2D1_SIZE_F size = m_renderTarget->GetSize();
-    D2D1_RECT_F layoutRect = D2D1::RectF(x, y, size.width, size.height);
+void D2DRenderer::AddDirtyRect(float x, float y, float width, float height) {
+    const bool partial = m_swapChain ? m_backBuffer != nullptr : m_dcTarget != nullptr;
+    if (!partial || !m_isDrawing || m_presentAll) {
+        return;
+    }
 
-    m_renderTarget->DrawTextW(
-        text.c_str(),
-        static_cast<UINT32>(text.length()),
-        m_textFormat.Get(),
-        layoutRect,
-        brush,
-        D2D1_DRAW_TEXT_OPTIONS_ENABLE_COLOR_FONT
-    );
+    // Present1 rejects rectangles outside the buffer
+    const D2D1_SIZE_U size = m_renderTarget->GetPixelSize();
+    RECT rect = ToPixelRect(x, y, x + width, y + height);
+    rect.left = std::max(rect.left, 0L);
+    rect.top = std::max(rect.top, 0L);
+    rect.right = std::min(rect.right, static_cast<LONG>(size.width));
+    rect.bottom = std::min(rect.bottom, static_cast<LONG>(size.height));
+    if (rect.left < rect.right && rect.top < rect.bottom) {
+        m_dirtyRects.push_back(rect);
+    }
 }
 
-void D2DRenderer::DrawChar(uint32_t codepoint, float x, float y, const Color& color) {
-    if (!m_renderTarget || !m_isDrawing) return;
+// ============================================================================
+// Retained Frame
+// ============================================================================
 
-    // Convert UTF-32 to UTF-16
-    wchar_t buffer[3] = {0};
-    if (codepoint <= 0xFFFF) {
-        buffer[0] = static_cast<wchar_t>(codepoint);
-    } else {
-        // Surrogate pair
-        codepoint -= 0x10000;
-        buffer[0] = static_cast<wchar_t>(0xD800 | (codepoint >> 10));
-        buffer[1] = static_cast<wchar_t>(0xDC00 | (codepoint & 0x3FF));
+bool D2DRenderer::BeginFrame() {
+    if (!m_renderTarget || m_isDrawing) {
+        return false;
     }
 
-    DrawText(buffer, x, y, color);
-}
+    if (!m_frameTarget) {
+        m_frameRetained = false;
 
-void D2DRenderer::DrawTextLayout(IDWriteTextLayout* layout, float x, float y, 
-                                  const Color& color) {
-    if (!m_renderTarget || !m_isDrawing || !layout) return;
+        if (FAILED(m_renderTarget->CreateCompatibleRenderTarget(m_frameTarget.GetAddressOf())) ||
+            FAILED(m_frameTarget->GetBitmap(m_frameBitmap.GetAddressOf()))) {
+            ReleaseFrame();
+            return false;
+        }
+        if (IsTranslucent()) {
+            m_frameTarget->SetTextAntialiasMode(D2D1_TEXT_ANTIALIAS_MODE_GRAYSCALE);
+        }
 
-    ID2D1SolidColorBrush* brush = GetBrush(color);
-    if (brush) {
-        m_renderTarget->DrawTextLayout(D2D1::Point2F(x, y), layout, brush,
-                                        D2D1_DRAW_TEXT_OPTIONS_ENABLE_COLOR_FONT);
+        float dpiX = 96.0f;
+        float dpiY = 96.0f;
+        m_frameBitmap->GetDpi(&dpiX, &dpiY);
+        const D2D1_BITMAP_PROPERTIES props =
+            D2D1::BitmapProperties(m_frameBitmap->GetPixelFormat(), dpiX, dpiY);
+        if (FAILED(m_frameTarget->CreateBitmap(m_frameBitmap->GetPixelSize(), props,
+                                               m_scrollBitmap.GetAddressOf()))) {
+            ReleaseFrame();
+            return false;
+        }
     }
+
+    m_frameTarget->BeginDraw();
+    m_isDrawing = true;
+    m_inFrame = true;
+    m_atlas->NextFrame();
+    ++m_brushFrame;
+    return true;
 }
 
-// ============================================================================
-// Font Management
-// ============================================================================
+bool D2DRenderer::EndFrame() {
+    if (!m_frameTarget || !m_inFrame) {
+        return false;
+    }
 
-bool D2DRenderer::SetFont(const std::wstring& fontName, float fontSize) {
-    if (!m_dwriteFactory) {
+    m_isDrawing = false;
+    m_inFrame = false;
+
+    if (FAILED(m_frameTarget->EndDraw())) {
+        ReleaseFrame();
         return false;
     }
 
-    m_fontName = fontName;
-    m_fontSize = fontSize;
+    m_frameRetained = true;
+    return true;
+}
 
-    // Create text format
-    HRESULT hr = m_dwriteFactory->CreateTextFormat(
-        fontName.c_str(),
-        nullptr,  // Font collection (nullptr = system fonts)
-        DWRITE_FONT_WEIGHT_NORMAL,
-        DWRITE_FONT_STYLE_NORMAL,
-        DWRITE_FONT_STRETCH_NORMAL,
-        fontSize * m_dpiScaleY,  // Scale font size by DPI
-        L"en-us",
-        m_textFormat.ReleaseAndGetAddressOf()
-    );
+bool D2DRenderer::ScrollFrame(float left, float top, float width, float height, float dy) {
+    if (!m_frameRetained || m_isDrawing || !m_scrollBitmap) {
+        return false;
+    }
 
-    if (FAILED(hr)) {
+    // Work in device pixels; a move that isn't a whole number of pixels
+    // would smear, so let the caller repaint instead
+    float dpiX = 96.0f;
+    float dpiY = 96.0f;
+    m_frameBitmap->GetDpi(&dpiX, &dpiY);
+    const float scale = dpiY / 96.0f;
+
+    const float pixelDy = dy * scale;
+    if (std::fabs(pixelDy - std::round(pixelDy)) > 0.01f) {
         return false;
     }
 
-    // Set text alignment
-    m_textFormat->SetTextAlignment(DWRITE_TEXT_ALIGNMENT_LEADING);
-    m_textFormat->SetParagraphAlignment(DWRITE_PARAGRAPH_ALIGNMENT_NEAR);
+    const D2D1_SIZE_U size = m_frameBitmap->GetPixelSize();
+    const auto bandLeft = static_cast<UINT32>(std::clamp<long>(std::lround(left * scale), 0, size.width));
+    const auto bandRight = static_cast<UINT32>(std::clamp<long>(std::lround((left + width) * scale), bandLeft,
+                                                                 size.width));
+    const auto bandTop = static_cast<int>(std::lround(top * scale));
+    const auto bandBottom = std::min(static_cast<int>(std::lround((top + height) * scale)),
+                                     static_cast<int>(size.height));
+    const auto shift = static_cast<int>(std::lround(pixelDy));
+    if (shift == 0 || bandTop < 0 || bandRight == bandLeft || bandBottom - bandTop <= std::abs(shift)) {
+        // Nothing survives the move; the whole band is repainted
+        return true;
+    }
 
-    // Update cell metrics
-    UpdateCellMetrics();
+    // Rows that stay visible, before and after the move
+    const int srcTop = shift < 0 ? bandTop - shift : bandTop;
+    const int srcBottom = shift < 0 ? bandBottom : bandBottom - shift;
+    const int dstTop = srcTop + shift;
 
+    // Bounce through the scratch bitmap: the ranges overlap
+    const D2D1_RECT_U srcRect = D2D1::RectU(bandLeft, srcTop, bandRight, srcBottom);
+    const D2D1_POINT_2U srcPoint = D2D1::Point2U(bandLeft, srcTop);
+    const D2D1_POINT_2U dstPoint = D2D1::Point2U(bandLeft, dstTop);
+
+    if (FAILED(m_scrollBitmap->CopyFromBitmap(&srcPoint, m_frameBitmap.Get(), &srcRect)) ||
+        FAILED(m_frameBitmap->CopyFromBitmap(&dstPoint, m_scrollBitmap.Get(), &srcRect))) {
+        m_frameRetained = false;
+        return false;
+    }
+
+    // The window shows the frame 1:1, so this is a scroll of the window
+    // too; Present1 takes one scroll per frame
+    if (m_swapChain || m_dcTarget) {
+        m_presentAll = m_presentAll || m_hasScroll;
+        m_scrollRect = RECT{static_cast<LONG>(bandLeft), srcTop, static_cast<LONG>(bandRight), srcBottom};
+        m_scrollOffset = POINT{0, shift};
+        m_hasScroll = true;
+    }
     return true;
 }
 
-ComPtr<IDWriteTextLayout> D2DRenderer::CreateTextLayout(
-    const std::wstring& text, float maxWidth, float maxHeight) {
-    
-    if (!m_dwriteFactory || !m_textFormat) {
-        return nullptr;
-    }
+void D2DRenderer::DrawFrame(float y) {
+    if (!m_renderTarget || !m_isDrawing || m_inFrame || m_tile || !m_frameBitmap) return;
 
-    ComPtr<IDWriteTextLayout> layout;
-    HRESULT hr = m_dwriteFactory->CreateTextLayout(
-        text.c_str(),
-        static_cast<UINT32>(text.length()),
-        m_textFormat.Get(),
-        maxWidth,
-        maxHeight,
-        layout.GetAddressOf()
-    );
+    const D2D1_SIZE_F size = m_frameBitmap->GetSize();
+    const float top = std::round(y * m_dpiScaleY) / m_dpiScaleY;
+    DrawWindowBitmap(m_frameBitmap.Get(), D2D1::RectF(0.0f, top, size.width, top + size.height));
+}
 
-    return SUCCEEDED(hr) ? layout : nullptr;
+void D2DRenderer::DrawWindowBitmap(ID2D1Bitmap* bitmap, const D2D1_RECT_F& dest) {
+    // Blended, a translucent background would show the last frame
+    // through (flip-sequential buffers keep it)
+    if (IsTranslucent()) {
+        m_deviceContext->SetPrimitiveBlend(D2D1_PRIMITIVE_BLEND_COPY);
+    }
+    m_renderTarget->DrawBitmap(bitmap, dest, 1.0f,
+                               m_previewScale != 1.0f ? D2D1_BITMAP_INTERPOLATION_MODE_LINEAR
+                                                      : D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR);
+    if (IsTranslucent()) {
+        m_deviceContext->SetPrimitiveBlend(D2D1_PRIMITIVE_BLEND_SOURCE_OVER);
+    }
+    ++m_counters.drawCalls;
 }
 
-// ============================================================================
-// Brush Management
-// ============================================================================
+SavedFrame D2DRenderer::TakeFrame() {
+    SavedFrame frame;
+    if (m_frameRetained && !m_isDrawing) {
+        frame.target = std::move(m_frameTarget);
+        frame.bitmap = std::move(m_frameBitmap);
+        frame.scrollBitmap = std::move(m_scrollBitmap);
+        frame.device = m_deviceGeneration;
+    }
+    ReleaseFrame();
+    return frame;
+}
 
-ID2D1SolidColorBrush* D2DRenderer::GetBrush(const Color& color) {
-    if (!m_renderTarget) {
-        return nullptr;
+bool D2DRenderer::RestoreFrame(SavedFrame frame) {
+    if (!frame || !frame.scrollBitmap || frame.device != m_deviceGeneration || !m_renderTarget ||
+        m_isDrawing) {
+        return false;
     }
 
-    uint32_t hash = ColorHash(color);
-    
-    auto it = m_brushCache.find(hash);
-    if (it != m_brushCache.end()) {
-        return it->second.Get();
+    // It must be the frame BeginFrame() would create now
+    const D2D1_SIZE_U size = frame.bitmap->GetPixelSize();
+    const D2D1_SIZE_U targetSize = m_renderTarget->GetPixelSize();
+    float dpiX = 0.0f;
+    float dpiY = 0.0f;
+    float targetDpiX = 0.0f;
+    float targetDpiY = 0.0f;
+    frame.bitmap->GetDpi(&dpiX, &dpiY);
+    m_renderTarget->GetDpi(&targetDpiX, &targetDpiY);
+    if (size.width != targetSize.width || size.height != targetSize.height ||
+        dpiX != targetDpiX || dpiY != targetDpiY) {
+        return false;
     }
 
-    // Create new brush
-    ComPtr<ID2D1SolidColorBrush> brush;
-    HRESULT hr = m_renderTarget->CreateSolidColorBrush(color.ToD2D(), brush.GetAddressOf());
-    
-    if (FAILED(hr)) {
-        return nullptr;
+    m_frameTarget = std::move(frame.target);
+    m_frameBitmap = std::move(frame.bitmap);
+    m_scrollBitmap = std::move(frame.scrollBitmap);
+    m_frameRetained = true;
+    return true;
+}
+
+size_t D2DRenderer::GetFrameBytes() const noexcept {
+    if (!m_frameBitmap) {
+        return 0;
     }
+    const D2D1_SIZE_U size = m_frameBitmap->GetPixelSize();
+    return static_cast<size_t>(size.width) * size.height * 4 * (m_scrollBitmap ? 2 : 1);
+}
 
-    m_brushCache[hash] = brush;
-    return brush.Get();
+size_t D2DRenderer::GetAtlasShareBytes() const noexcept {
+    const auto share = [](const std::shared_ptr<GlyphAtlas>& atlas) -> size_t {
+        const long holders = atlas.use_count();
+        return holders > 0 ? atlas->GetBytes() / static_cast<size_t>(holders) : 0;
+    };
+
+    size_t bytes = m_atlas ? share(m_atlas) : 0;
+    for (const ParkedAtlas& parked : m_parkedAtlases) {
+        bytes += share(parked.atlas);
+    }
+    return bytes;
 }
 
 // ============================================================================
-// Private Implementation
+// Row Tiles
 // ============================================================================
 
-bool D2DRenderer::CreateDeviceResources() {
-    if (!m_d2dFactory || !m_hwnd) {
+bool D2DRenderer::BeginTile(RowTile& tile, float width, float height) {
+    if (!m_renderTarget || m_isDrawing) {
         return false;
     }
 
-    // Get window size
-    RECT rc;
-    GetClientRect(m_hwnd, &rc);
+    // Compatible with the window target, so atlas pages draw into it and
+    // it draws back without conversion
+    if (!tile.target) {
+        if (FAILED(m_renderTarget->CreateCompatibleRenderTarget(D2D1::SizeF(width, height),
+                                                                 tile.target.GetAddressOf())) ||
+            FAILED(tile.target->GetBitmap(tile.bitmap.GetAddressOf()))) {
+            tile = RowTile{};
+            return false;
+        }
+        if (IsTranslucent()) {
+            tile.target->SetTextAntialiasMode(D2D1_TEXT_ANTIALIAS_MODE_GRAYSCALE);
+        }
+    }
+
+    tile.target->BeginDraw();
+    m_tile = &tile;
+    m_isDrawing = true;
+    m_atlas->NextFrame();
+    ++m_brushFrame;
+    return true;
+}
 
-    D2D1_SIZE_U size = D2D1::SizeU(rc.right - rc.left, rc.bottom - rc.top);
+bool D2DRenderer::EndTile() {
+    if (!m_tile) {
+        return false;
+    }
 
-    // Create render target
-    D2D1_RENDER_TARGET_PROPERTIES rtProps = D2D1::RenderTargetProperties(
-        D2D1_RENDER_TARGET_TYPE_DEFAULT,
-        D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED)
-    );
+    RowTile& tile = *m_tile;
+    m_tile = nullptr;
+    m_isDrawing = false;
 
-    D2D1_HWND_RENDER_TARGET_PROPERTIES hwndProps = D2D1::HwndRenderTargetProperties(
-        m_hwnd,
-        size,
-        D2D1_PRESENT_OPTIONS_NONE
-    );
+    if (FAILED(tile.target->EndDraw())) {
+        tile = RowTile{};
+        return false;
+    }
+    return true;
+}
 
-    HRESULT hr = m_d2dFactory->CreateHwndRenderTarget(
-        rtProps,
-        hwndProps,
-        m_renderTarget.ReleaseAndGetAddressOf()
-    );
+void D2DRenderer::DrawTile(const RowTile& tile, float x, float y) {
+    if (!m_renderTarget || !m_isDrawing || m_inFrame || m_tile || !tile.bitmap) return;
 
-    if (FAILED(hr)) {
+    const D2D1_SIZE_F size = tile.bitmap->GetSize();
+    const float left = std::round(x * m_dpiScaleX) / m_dpiScaleX;
+    const float top = std::round(y * m_dpiScaleY) / m_dpiScaleY;
+    DrawWindowBitmap(tile.bitmap.Get(), D2D1::RectF(left, top, left + size.width, top + size.height));
+}
+
+bool D2DRenderer::SetOverview(std::span<const uint32_t> pixels, UINT32 width, UINT32 height) {
+    if (!m_renderTarget || width == 0 || height == 0 || pixels.size() < static_cast<size_t>(width) * height) {
         return false;
     }
 
-    // Set DPI
-    m_renderTarget->SetDpi(96.0f * m_dpiScaleX, 96.0f * m_dpiScaleY);
+    // Same size: the texture is rewritten in place
+    const UINT32 pitch = width * 4;
+    if (m_overview) {
+        const D2D1_SIZE_U size = m_overview->GetPixelSize();
+        if (size.width == width && size.height == height) {
+            if (SUCCEEDED(m_overview->CopyFromMemory(nullptr, pixels.data(), pitch))) {
+                return true;
+            }
+        }
+        m_overview.Reset();
+    }
 
-    return true;
+    const D2D1_BITMAP_PROPERTIES props =
+        D2D1::BitmapProperties(D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED));
+    return SUCCEEDED(m_renderTarget->CreateBitmap(D2D1::SizeU(width, height), pixels.data(), pitch, props,
+                                                  &m_overview));
 }
 
-void D2DRenderer::DiscardDeviceResources() {
-    m_brushCache.clear();
-    m_renderTarget.Reset();
+void D2DRenderer::DrawOverview(float x, float y, float width, float height) {
+    if (!m_renderTarget || !m_isDrawing || m_inFrame || m_tile || !m_overview) return;
+
+    m_renderTarget->DrawBitmap(m_overview.Get(), D2D1::RectF(x, y, x + width, y + height), 1.0f,
+                               D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR);
+    ++m_counters.drawCalls;
 }
 
-void D2DRenderer::UpdateCellMetrics() {
-    if (!m_dwriteFactory || !m_textFormat) {
+void D2DRenderer::DrawImage(const std::shared_ptr<const void>& owner, std::span<const uint32_t> pixels,
+                            UINT32 width, UINT32 height, float x, float y, float drawWidth, float drawHeight) {
+    if (!m_renderTarget || !m_isDrawing || m_inFrame || m_tile || !owner || width == 0 || height == 0 ||
+        pixels.size() < static_cast<size_t>(width) * height) {
         return;
     }
 
-    // Create a text layout for measuring
-    ComPtr<IDWriteTextLayout> layout;
-    HRESULT hr = m_dwriteFactory->CreateTextLayout(
-        L"M",  // Use 'M' for em-width measurement
-        1,
-        m_textFormat.Get(),
-        1000.0f,
-        1000.0f,
-        layout.GetAddressOf()
-    );
-
-    if (FAILED(hr)) {
-        return;
+    auto it = m_imageTextures.find(owner.get());
+    if (it != m_imageTextures.end() && it->second.owner.lock() != owner) {
+        m_imageTextureBytes -= it->second.bytes;
+        m_imageTextures.erase(it);
+        it = m_imageTextures.end();
     }
+    if (it == m_imageTextures.end()) {
+        const size_t bytes = pixels.size_bytes();
+        if (bytes > kImageTextureBytes) {
+            return;
+        }
 
-    // Get metrics
-    DWRITE_TEXT_METRICS metrics{};
-    layout->GetMetrics(&metrics);
-
-    m_cellWidth = metrics.width;
-    m_cellHeight = metrics.height;
-
-    // Get font metrics for baseline
-    ComPtr<IDWriteFontCollection> fontCollection;
-    m_dwriteFactory->GetSystemFontCollection(fontCollection.GetAddressOf());
-
-    if (fontCollection) {
-        UINT32 index;
-        BOOL exists;
-        fontCollection->FindFamilyName(m_fontName.c_str(), &index, &exists);
-        
-        if (exists) {
-            ComPtr<IDWriteFontFamily> fontFamily;
-            fontCollection->GetFontFamily(index, fontFamily.GetAddressOf());
-            
-            if (fontFamily) {
-                ComPtr<IDWriteFont> font;
-                fontFamily->GetFirstMatchingFont(
-                    DWRITE_FONT_WEIGHT_NORMAL,
-                    DWRITE_FONT_STRETCH_NORMAL,
-                    DWRITE_FONT_STYLE_NORMAL,
-                    font.GetAddressOf()
-                );
-
-                if (font) {
-                    DWRITE_FONT_METRICS fontMetrics;
-                    font->GetMetrics(&fontMetrics);
-                    
-                    float designUnitsPerEm = static_cast<float>(fontMetrics.designUnitsPerEm);
-                    float scaledFontSize = m_fontSize * m_dpiScaleY;
-                    m_baseline = (fontMetrics.ascent / designUnitsPerEm) * scaledFontSize;
-                }
+        // Textures of images gone go first, then those drawn least recently
+        std::erase_if(m_imageTextures, [this](const auto& entry) {
+            if (!entry.second.owner.expired()) {
+                return false;
             }
+            m_imageTextureBytes -= entry.second.bytes;
+            return true;
+        });
+        while (m_imageTextureBytes + bytes > kImageTextureBytes && !m_imageTextures.empty()) {
+            const auto oldest = std::min_element(m_imageTextures.begin(), m_imageTextures.end(),
+                                                 [](const auto& a, const auto& b) {
+                                                     return a.second.lastUsed < b.second.lastUsed;
+                                                 });
+            m_imageTextureBytes -= oldest->second.bytes;
+            m_imageTextures.erase(oldest);
+        }
+
+        ImageTexture texture;
+        texture.owner = owner;
+        texture.bytes = bytes;
+        const D2D1_BITMAP_PROPERTIES props =
+            D2D1::BitmapProperties(D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED));
+        if (FAILED(m_renderTarget->CreateBitmap(D2D1::SizeU(width, height), pixels.data(), width * 4, props,
+                                                &texture.bitmap))) {
+            return;
         }
+        m_imageTextureBytes += bytes;
+        it = m_imageTextures.emplace(owner.get(), std::move(texture)).first;
+    }
+    it->second.lastUsed = ++m_imageClock;
+
+    m_renderTarget->DrawBitmap(it->second.bitmap.Get(), D2D1::RectF(x, y, x + drawWidth, y + drawHeight), 1.0f,
+                               D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR);
+    ++m_counters.drawCalls;
+}
+
+void D2DRenderer::Clear() {
+    Clear(GetBackgroundFill());
+}
+
+void D2DRenderer::ClearRect(float x, float y, float width, float height) {
+    if (!m_renderTarget || !m_isDrawing) return;
+
+    if (!IsTranslucent()) {
+        FillRect(x, y, width, height, m_backgroundColor);
+        return;
+    }
+
+    // A translucent fill would blend with what it covers; Clear replaces it
+    ID2D1RenderTarget* target = GetDrawTarget();
+    target->PushAxisAlignedClip(D2D1::RectF(x, y, x + width, y + height), D2D1_ANTIALIAS_MODE_ALIASED);
+    target->Clear(GetBackgroundFill().ToD2D());
+    target->PopAxisAlignedClip();
+    ++m_counters.drawCalls;
+}
+
+bool D2DRenderer::SetOpacity(float opacity) {
+    if (m_isDrawing) {
+        return false;
+    }
+
+    opacity = std::clamp(opacity, 0.0f, 1.0f);
+    if (opacity == m_opacity) {
+        return opacity == 1.0f || IsTranslucent();
+    }
+    const bool translucent = opacity < 1.0f;
+    m_opacity = opacity;
+
+    // Pixels drawn at the old opacity
+    ReleaseFrame();
+    ++m_tileGeneration;
+    m_presentAll = true;
+
+    // Opaque and translucent swap chains differ in alpha mode and in how
+    // they reach the window
+    if (m_swapChain && translucent != IsTranslucent()) {
+        (void)RecoverDevice();
+    }
+    return !translucent || IsTranslucent();
+}
+
+bool D2DRenderer::UpdateAdapter() {
+    // Only the swap chain and offscreen backends are on a Direct3D device
+    if (!m_d3dDevice || m_isDrawing) {
+        return false;
+    }
+    const LUID adapter = PickAdapter();
+    if (adapter.LowPart == m_adapter.LowPart && adapter.HighPart == m_adapter.HighPart) {
+        return false;
+    }
+
+    // As after a device loss, onto the other adapter's shared device
+    (void)RecoverDevice();
+    return true;
+}
+
+LUID D2DRenderer::PickAdapter() const {
+    const HMONITOR monitor = m_hwnd ? MonitorFromWindow(m_hwnd, MONITOR_DEFAULTTONEAREST) : nullptr;
+    return SharedRenderResources::FindAdapter(m_gpuPreference, monitor);
+}
+
+void D2DRenderer::Clear(const Color& color) {
+    if (m_renderTarget && m_isDrawing) {
+        GetDrawTarget()->Clear(color.ToD2D());
+        ++m_counters.drawCalls;
+    }
+}
+
+void D2DRenderer::FillRect(float x, float y, float width, float height, const Color& color) {
+    if (!m_renderTarget || !m_isDrawing) return;
+
+    ID2D1SolidColorBrush* brush = GetBrush(color);
+    if (brush) {
+        D2D1_RECT_F rect = D2D1::RectF(x, y, x + width, y + height);
+        GetDrawTarget()->FillRectangle(rect, brush);
+        ++m_counters.drawCalls;
+    }
+}
+
+void D2DRenderer::PushClip(float x, float y, float width, float height) {
+    if (!m_renderTarget || !m_isDrawing) return;
+    GetDrawTarget()->PushAxisAlignedClip(D2D1::RectF(x, y, x + width, y + height), D2D1_ANTIALIAS_MODE_ALIASED);
+}
+
+void D2DRenderer::PopClip() {
+    if (!m_renderTarget || !m_isDrawing) return;
+    GetDrawTarget()->PopAxisAlignedClip();
+}
+
+void D2DRenderer::DrawRect(float x, float y, float width, float height, 
+                           const Color& color, float strokeWidth) {
+    if (!m_renderTarget || !m_isDrawing) return;
+
+    ID2D1SolidColorBrush* brush = GetBrush(color);
+    if (brush) {
+        D2D1_RECT_F rect = D2D1::RectF(x, y, x + width, y + height);
+        GetDrawTarget()->DrawRectangle(rect, brush, strokeWidth);
+        ++m_counters.drawCalls;
+    }
+}
+
+void D2DRenderer::DrawLine(float x1, float y1, float x2, float y2, 
+                           const Color& color, float strokeWidth) {
+    if (!m_renderTarget || !m_isDrawing) return;
+
+    ID2D1SolidColorBrush* brush = GetBrush(color);
+    if (brush) {
+        GetDrawTarget()->DrawLine(D2D1::Point2F(x1, y1), D2D1::Point2F(x2, y2),
+                                  brush, strokeWidth);
+        ++m_counters.drawCalls;
+    }
+}
+
+void D2DRenderer::DrawText(const std::wstring& text, float x, float y, 
+                           const Color& color, const std::wstring& /*fontName*/) {
+    if (!m_renderTarget || !m_isDrawing || !m_textFormat || text.empty()) return;
+
+    ID2D1SolidColorBrush* brush = GetBrush(color);
+    if (!brush) return;
+
+    D2D1_SIZE_F size = GetDrawTarget()->GetSize();
+    D2D1_RECT_F layoutRect = D2D1::RectF(x, y, size.width, size.height);
+
+    GetDrawTarget()->DrawTextW(
+        text.c_str(),
+        static_cast<UINT32>(text.length()),
+        m_textFormat.Get(),
+        layoutRect,
+        brush,
+        D2D1_DRAW_TEXT_OPTIONS_ENABLE_COLOR_FONT
+    );
+    ++m_counters.drawCalls;
+}
+
+void D2DRenderer::DrawAtlasGlyph(const AtlasGlyph& glyph, float x, float y, const Color& color) {
+    // Blank until the worker threads finish it
+    if (glyph.pending) {
+        m_awaitingGlyphs = true;
+        return;
+    }
+
+    // Slots start on whole pixels; so must the copy, to stay exact
+    const float left = std::round(x * m_dpiScaleX) / m_dpiScaleX;
+    const float top = std::round(y * m_dpiScaleY) / m_dpiScaleY;
+    const D2D1_RECT_F dest = D2D1::RectF(left, top,
+                                         left + (glyph.source.right - glyph.source.left),
+                                         top + (glyph.source.bottom - glyph.source.top));
+
+    ID2D1RenderTarget* target = GetDrawTarget();
+    if (glyph.color) {
+        target->DrawBitmap(glyph.page, dest, 1.0f, D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR,
+                           &glyph.source);
+    } else if (ID2D1SolidColorBrush* brush = GetBrush(color)) {
+        // FillOpacityMask only works with aliased geometry
+        target->SetAntialiasMode(D2D1_ANTIALIAS_MODE_ALIASED);
+        target->FillOpacityMask(glyph.page, brush, D2D1_OPACITY_MASK_CONTENT_TEXT_NATURAL,
+                                &dest, &glyph.source);
+        target->SetAntialiasMode(D2D1_ANTIALIAS_MODE_PER_PRIMITIVE);
+    }
+    ++m_counters.drawCalls;
+}
+
+void D2DRenderer::DrawChar(uint32_t codepoint, float x, float y, const Color& color,
+                           int width, FontVariant variant) {
+    if (!m_renderTarget || !m_isDrawing) return;
+
+    if (const AtlasGlyph* glyph = m_atlas->Find(m_renderTarget.Get(), codepoint, width, variant)) {
+        DrawAtlasGlyph(*glyph, x, y, color);
+        return;
+    }
+
+    // Not cached (device trouble, or every slot in use this frame)
+
+    wchar_t units[2];
+    DrawText(std::wstring(units, Core::PutUtf16(codepoint, units)), x, y, color);
+}
+
+void D2DRenderer::DrawGrapheme(uint32_t sequence, std::span<const uint32_t> chars, float x, float y,
+                               const Color& color, int width, FontVariant variant) {
+    if (!m_renderTarget || !m_isDrawing || chars.empty()) return;
+
+    if (const AtlasGlyph* glyph = m_atlas->FindSequence(m_renderTarget.Get(), sequence, chars, width, variant)) {
+        DrawAtlasGlyph(*glyph, x, y, color);
+        return;
+    }
+
+    // Not cached: lay the sequence out directly
+    std::wstring text;
+    Core::AppendUtf16(text, chars);
+    DrawText(text, x, y, color);
+}
+
+void D2DRenderer::DrawTextRun(std::span<const uint32_t> codepoints, float x, float y,
+                              const Color& color, FontVariant variant) {
+    if (!m_renderTarget || !m_isDrawing || codepoints.empty()) return;
+
+    const auto count = static_cast<UINT32>(codepoints.size());
+    const size_t face = static_cast<size_t>(variant);
+    ID2D1SolidColorBrush* brush = GetBrush(color);
+    m_runGlyphs.resize(count);
+
+    // Glyph indices from the table; the font only for runs with characters
+    // beyond it
+    const std::vector<UINT16>& table = m_glyphIndices[face];
+    bool indexed = !table.empty();
+    for (UINT32 index = 0; index < count && indexed; ++index) {
+        if (codepoints[index] < table.size()) {
+            m_runGlyphs[index] = table[codepoints[index]];
+        } else {
+            indexed = false;
+        }
+    }
+    if (!m_fontFaces[face] || !brush ||
+        (!indexed &&
+         FAILED(m_fontFaces[face]->GetGlyphIndices(codepoints.data(), count, m_runGlyphs.data())))) {
+        for (UINT32 index = 0; index < count; ++index) {
+            DrawChar(codepoints[index], x + static_cast<float>(index) * m_cellWidth, y, color, 1, variant);
+        }
+        return;
+    }
+
+    DWRITE_GLYPH_RUN run{};
+    run.fontFace = m_fontFaces[face].Get();
+    run.fontEmSize = m_variantFormats[face]->GetFontSize();
+
+    ID2D1RenderTarget* target = GetDrawTarget();
+    const float baseline = y + m_baseline;
+
+    // Ligatures: a run the font covers whole is shaped, once, then drawn
+    // from the cache as one glyph run
+    if (m_ligatures && std::find(m_runGlyphs.begin(), m_runGlyphs.end(), UINT16{0}) == m_runGlyphs.end() &&
+        std::none_of(codepoints.begin(), codepoints.end(), IsBoxDrawing)) {
+        if (const ShapedRun* shaped = m_shapedRuns->Shape(codepoints, variant, run.fontFace, run.fontEmSize)) {
+            shaped->GetAdvances(m_cellWidth, m_runAdvances);
+            run.glyphCount = static_cast<UINT32>(shaped->glyphs.size());
+            run.glyphIndices = shaped->glyphs.data();
+            run.glyphAdvances = m_runAdvances.data();
+            run.glyphOffsets = shaped->offsets.data();
+            target->DrawGlyphRun(D2D1::Point2F(x, baseline), &run, brush);
+            ++m_counters.drawCalls;
+            ++m_counters.glyphRuns;
+            return;
+        }
+    }
+
+    // Every glyph advances exactly one cell, whatever the font says
+    m_runAdvances.assign(count, m_cellWidth);
+    UINT32 start = 0;
+    const auto drawRun = [&](UINT32 end) {
+        if (end > start) {
+            run.glyphCount = end - start;
+            run.glyphIndices = m_runGlyphs.data() + start;
+            run.glyphAdvances = m_runAdvances.data() + start;
+            target->DrawGlyphRun(D2D1::Point2F(x + static_cast<float>(start) * m_cellWidth, baseline),
+                                 &run, brush);
+            ++m_counters.drawCalls;
+            ++m_counters.glyphRuns;
+        }
+    };
+
+    for (UINT32 index = 0; index < count; ++index) {
+        // Glyph 0: the font lacks the character; it needs font fallback,
+        // which DrawChar gets through DirectWrite layout. Box drawing comes
+        // from the atlas, drawn to the cell rather than the font's grid.
+        if (m_runGlyphs[index] == 0 || IsBoxDrawing(codepoints[index])) {
+            drawRun(index);
+            start = index + 1;
+            DrawChar(codepoints[index], x + static_cast<float>(index) * m_cellWidth, y, color, 1, variant);
+        }
+    }
+    drawRun(count);
+}
+
+void D2DRenderer::DrawTextLayout(IDWriteTextLayout* layout, float x, float y, 
+                                  const Color& color) {
+    if (!m_renderTarget || !m_isDrawing || !layout) return;
+
+    ID2D1SolidColorBrush* brush = GetBrush(color);
+    if (brush) {
+        GetDrawTarget()->DrawTextLayout(D2D1::Point2F(x, y), layout, brush,
+                                         D2D1_DRAW_TEXT_OPTIONS_ENABLE_COLOR_FONT);
+        ++m_counters.drawCalls;
+    }
+}
+
+void D2DRenderer::DrawDecoration(TextDecoration decoration, float x, float y, int cells, const Color& color) {
+    if (!m_renderTarget || !m_isDrawing || cells <= 0) return;
+
+    ID2D1SolidColorBrush* brush = GetBrush(color);
+    if (!brush) return;
+
+    ID2D1RenderTarget* target = GetDrawTarget();
+    const float line = std::max(std::round(m_dpiScaleY), 1.0f) / m_dpiScaleY;
+    const float width = m_cellWidth * static_cast<float>(cells);
+
+    // Underlines stay inside the cell; a partial repaint only clears cells
+    const float depth = decoration == TextDecoration::DoubleUnderline ? 3.0f
+                      : decoration == TextDecoration::CurlyUnderline  ? 2.0f
+                      : 1.0f;
+    const float under = std::min(y + m_baseline + line, y + m_cellHeight - depth * line);
+
+    switch (decoration) {
+    case TextDecoration::DoubleUnderline:
+        target->FillRectangle(D2D1::RectF(x, under + 2.0f * line, x + width, under + 3.0f * line), brush);
+        ++m_counters.drawCalls;
+        [[fallthrough]];
+    case TextDecoration::Underline:
+        target->FillRectangle(D2D1::RectF(x, under, x + width, under + line), brush);
+        ++m_counters.drawCalls;
+        break;
+
+    case TextDecoration::Strikethrough: {
+        const float strike = y + m_cellHeight * 0.5f;
+        target->FillRectangle(D2D1::RectF(x, strike - 0.5f * line, x + width, strike + 0.5f * line), brush);
+        ++m_counters.drawCalls;
+        break;
+    }
+
+    case TextDecoration::CurlyUnderline: {
+        if (!m_undercurl || m_undercurlWidth != m_cellWidth || m_undercurlLine != line) {
+            // One sine period per cell, approximated by two quadratic arcs
+            ComPtr<ID2D1PathGeometry> geometry;
+            ComPtr<ID2D1GeometrySink> sink;
+            if (FAILED(m_d2dFactory->CreatePathGeometry(&geometry)) || FAILED(geometry->Open(&sink))) {
+                return;
+            }
+            const float half = m_cellWidth * 0.5f;
+            sink->BeginFigure(D2D1::Point2F(0.0f, 0.0f), D2D1_FIGURE_BEGIN_HOLLOW);
+            sink->AddQuadraticBezier(D2D1::QuadraticBezierSegment(D2D1::Point2F(half * 0.5f, -2.0f * line),
+                                                                  D2D1::Point2F(half, 0.0f)));
+            sink->AddQuadraticBezier(D2D1::QuadraticBezierSegment(D2D1::Point2F(half * 1.5f, 2.0f * line),
+                                                                  D2D1::Point2F(m_cellWidth, 0.0f)));
+            sink->EndFigure(D2D1_FIGURE_END_OPEN);
+            if (FAILED(sink->Close())) {
+                return;
+            }
+            m_undercurl = std::move(geometry);
+            m_undercurlWidth = m_cellWidth;
+            m_undercurlLine = line;
+        }
+
+        D2D1_MATRIX_3X2_F transform;
+        target->GetTransform(&transform);
+        for (int cell = 0; cell < cells; ++cell) {
+            const float left = x + m_cellWidth * static_cast<float>(cell);
+            target->SetTransform(D2D1::Matrix3x2F::Translation(left, under + line) * transform);
+            target->DrawGeometry(m_undercurl.Get(), brush, line);
+            ++m_counters.drawCalls;
+        }
+        target->SetTransform(transform);
+        break;
+    }
+
+    case TextDecoration::None:
+        break;
+    }
+}
+
+// ============================================================================
+// Cell Grid Shader
+// ============================================================================
+
+bool D2DRenderer::EnableCellGrid(bool enable) {
+    if (!enable) {
+        m_cellGridEnabled = false;
+        ReleaseCellGrid();
+        return true;
+    }
+    if (m_cellGridEnabled) {
+        return GetCellGrid() != nullptr;
+    }
+
+    m_cellGridEnabled = true;
+    if (m_isDrawing || !CreateCellGridResources()) {
+        m_cellGridEnabled = false;
+        ReleaseCellGrid();
+        return false;
+    }
+    return true;
+}
+
+CellGridRenderer* D2DRenderer::GetCellGrid() const noexcept {
+    if (!m_cellGridEnabled || !m_cellGrid || !m_cellGrid->IsInitialized() || !m_backBufferView) {
+        return nullptr;
+    }
+    return m_cellGrid.get();
+}
+
+bool D2DRenderer::DrawCellGrid() {
+    CellGridRenderer* grid = GetCellGrid();
+    if (!grid || !m_isDrawing || m_inFrame || m_tile || !m_backBuffer) {
+        return false;
+    }
+
+    // Direct3D can't draw into the back buffer while Direct2D has it; a
+    // failure here comes back from EndDraw() again
+    m_deviceContext->EndDraw();
+    const D2D1_SIZE_U size = m_backBuffer->GetPixelSize();
+    const bool drawn = grid->Draw(m_backBufferView.Get(), m_atlas->GetTextureView(), size.width,
+                                  size.height, m_backgroundColor, m_previewScale);
+    m_deviceContext->BeginDraw();
+    ++m_counters.drawCalls;
+    return drawn;
+}
+
+const AtlasGlyph* D2DRenderer::FindGlyph(uint32_t codepoint, int width, FontVariant variant) {
+    const AtlasGlyph* glyph = m_atlas->Find(m_renderTarget.Get(), codepoint, width, variant);
+    if (glyph && glyph->pending) {
+        m_awaitingGlyphs = true;
+        return nullptr;
+    }
+    return glyph;
+}
+
+const AtlasGlyph* D2DRenderer::FindSequenceGlyph(uint32_t sequence, std::span<const uint32_t> chars, int width,
+                                                 FontVariant variant) {
+    return m_atlas->FindSequence(m_renderTarget.Get(), sequence, chars, width, variant);
+}
+
+bool D2DRenderer::LandGlyphs() {
+    if (!m_renderTarget || m_isDrawing) {
+        return false;
+    }
+
+    // Another window sharing the atlas may have landed them already
+    m_atlas->Land();
+    const uint64_t landed = m_atlas->GetLandedCount();
+    const bool repaint = m_awaitingGlyphs && landed != m_landedSeen;
+    m_landedSeen = landed;
+    if (repaint) {
+        m_awaitingGlyphs = false;
+    }
+    return repaint;
+}
+
+// ============================================================================
+// Font Management
+// ============================================================================
+
+bool D2DRenderer::SetFont(const std::wstring& fontName, float fontSize) {
+    if (!m_dwriteFactory) {
+        return false;
+    }
+
+    // A text format per variant (Regular, Bold, Italic, BoldItalic). Sizes
+    // are in DIPs, which the target scales, so formats serve every DPI.
+    // Resolved against the family's own fonts where they can be found, so
+    // the system collection is not built just to find them
+    IDWriteFontCollection* familyCollection =
+        SharedRenderResources::Shared().GetFamilyCollection(fontName, m_dwriteFactory);
+    const std::wstring formatKey = FontKey(fontName, fontSize);
+    auto cachedFormats = m_fonts.formats.find(formatKey);
+    if (cachedFormats == m_fonts.formats.end()) {
+        std::array<ComPtr<IDWriteTextFormat>, 4> formats;
+        for (size_t index = 0; index < formats.size(); ++index) {
+            const bool bold = (index & 1) != 0;
+            const bool italic = (index & 2) != 0;
+
+            HRESULT hr = m_dwriteFactory->CreateTextFormat(
+                fontName.c_str(),
+                familyCollection,  // nullptr = system fonts
+                bold ? DWRITE_FONT_WEIGHT_BOLD : DWRITE_FONT_WEIGHT_NORMAL,
+                italic ? DWRITE_FONT_STYLE_ITALIC : DWRITE_FONT_STYLE_NORMAL,
+                DWRITE_FONT_STRETCH_NORMAL,
+                fontSize,
+                L"en-us",
+                formats[index].GetAddressOf()
+            );
+
+            if (FAILED(hr)) {
+                return false;
+            }
+
+            // Set text alignment
+            formats[index]->SetTextAlignment(DWRITE_TEXT_ALIGNMENT_LEADING);
+            formats[index]->SetParagraphAlignment(DWRITE_PARAGRAPH_ALIGNMENT_NEAR);
+        }
+        cachedFormats = m_fonts.formats.emplace(formatKey, std::move(formats)).first;
+    }
+
+    // Shaped runs hold the old font's glyphs; other windows with the new
+    // font may have shaped some already
+    if (fontName != m_fontName || fontSize != m_fontSize || !m_textFormat || !m_shapedRuns) {
+        m_shapedRuns = SharedRenderResources::Shared().GetShapedRuns(formatKey, m_dwriteFactory);
+    }
+
+    m_fontName = fontName;
+    m_fontSize = fontSize;
+    m_variantFormats = cachedFormats->second;
+    m_textFormat = m_variantFormats[0];
+
+    // Faces for glyph runs; without one a variant is drawn a cell at a time.
+    // Glyph indices of the common characters are looked up once per face.
+    if (!familyCollection && !m_fonts.collection) {
+        (void)m_dwriteFactory->GetSystemFontCollection(m_fonts.collection.GetAddressOf());
+    }
+    IDWriteFontCollection* collection = familyCollection ? familyCollection : m_fonts.collection.Get();
+    for (size_t index = 0; index < m_fontFaces.size(); ++index) {
+        const DWRITE_FONT_WEIGHT weight = m_variantFormats[index]->GetFontWeight();
+        const DWRITE_FONT_STYLE style = m_variantFormats[index]->GetFontStyle();
+        const std::wstring faceKey = fontName + L'|' + std::to_wstring(weight) + L'|' + std::to_wstring(style);
+
+        auto cachedFace = m_fonts.faces.find(faceKey);
+        if (cachedFace == m_fonts.faces.end()) {
+            SharedRenderResources::CachedFace face;
+            if (collection) {
+                face.face = FindFontFace(collection, fontName, weight, style);
+            }
+            if (face.face) {
+                std::vector<uint32_t> codepoints(kGlyphIndexTableSize);
+                for (uint32_t codepoint = 0; codepoint < kGlyphIndexTableSize; ++codepoint) {
+                    codepoints[codepoint] = codepoint;
+                }
+                face.glyphIndices.resize(kGlyphIndexTableSize);
+                if (FAILED(face.face->GetGlyphIndices(codepoints.data(), kGlyphIndexTableSize,
+                                                      face.glyphIndices.data()))) {
+                    face.glyphIndices.clear();
+                }
+            }
+            cachedFace = m_fonts.faces.emplace(faceKey, std::move(face)).first;
+        }
+        m_fontFaces[index] = cachedFace->second.face;
+        m_glyphIndices[index] = cachedFace->second.glyphIndices;
+    }
+
+    // Update cell metrics
+    UpdateCellMetrics();
+
+    return true;
+}
+
+ComPtr<IDWriteTextLayout> D2DRenderer::CreateTextLayout(
+    const std::wstring& text, float maxWidth, float maxHeight) {
+    
+    if (!m_dwriteFactory || !m_textFormat) {
+        return nullptr;
+    }
+
+    ComPtr<IDWriteTextLayout> layout;
+    HRESULT hr = m_dwriteFactory->CreateTextLayout(
+        text.c_str(),
+        static_cast<UINT32>(text.length()),
+        m_textFormat.Get(),
+        maxWidth,
+        maxHeight,
+        layout.GetAddressOf()
+    );
+
+    return SUCCEEDED(hr) ? layout : nullptr;
+}
+
+// ============================================================================
+// Brush Management
+// ============================================================================
+
+ID2D1SolidColorBrush* D2DRenderer::GetBrush(const Color& color) {
+    if (!m_renderTarget) {
+        return nullptr;
+    }
+
+    uint32_t hash = ColorHash(color);
+    
+    auto it = m_brushCache.find(hash);
+    if (it != m_brushCache.end()) {
+        ++m_counters.brushHits;
+        it->second.frame = m_brushFrame;
+        return it->second.brush.Get();
+    }
+    ++m_counters.brushMisses;
+
+    // Full: drop what this frame has not used (once a frame, so a frame
+    // with more colors than that grows the cache instead of rescanning it)
+    if (m_brushCache.size() >= kMaxBrushes && m_brushSweepFrame != m_brushFrame) {
+        m_brushSweepFrame = m_brushFrame;
+        std::erase_if(m_brushCache, [this](const auto& entry) { return entry.second.frame != m_brushFrame; });
+    }
+
+    // Create new brush
+    ComPtr<ID2D1SolidColorBrush> brush;
+    HRESULT hr = m_renderTarget->CreateSolidColorBrush(color.ToD2D(), brush.GetAddressOf());
+    
+    if (FAILED(hr)) {
+        return nullptr;
+    }
+
+    m_brushCache[hash] = CachedBrush{brush, m_brushFrame};
+    return brush.Get();
+}
+
+// ============================================================================
+// Private Implementation
+// ============================================================================
+
+bool D2DRenderer::CreateDeviceResources() {
+    if (!m_d2dFactory || (!m_hwnd && m_backend != RenderBackend::Offscreen)) {
+        return false;
+    }
+
+    // Get window size (a windowless offscreen target keeps its own)
+    D2D1_SIZE_U size = m_offscreenSize;
+    if (m_hwnd) {
+        RECT rc;
+        GetClientRect(m_hwnd, &rc);
+        size = D2D1::SizeU(rc.right - rc.left, rc.bottom - rc.top);
+    }
+
+    // Without DirectComposition a translucent window is drawn opaque
+    bool created = false;
+    if (m_backend == RenderBackend::SwapChain) {
+        const bool translucent = m_opacity < 1.0f && m_hwnd;
+        created = (translucent && CreateSwapChainResources(size, true)) || CreateSwapChainResources(size, false);
+    } else if (m_backend == RenderBackend::Software) {
+        created = CreateSoftwareResources(size);
+    } else if (m_backend == RenderBackend::Offscreen) {
+        created = CreateOffscreenResources(size);
+    }
+    if (!created && (!m_hwnd || !CreateHwndTargetResources(size))) {
+        return false;
+    }
+
+    // Set DPI
+    m_renderTarget->SetDpi(96.0f * m_dpiScaleX, 96.0f * m_dpiScaleY);
+    m_presentAll = true;
+
+    // Without the shader the grid is drawn with Direct2D
+    if (m_cellGridEnabled && !CreateCellGridResources()) {
+        ReleaseCellGrid();
+    }
+
+    // A shared atlas is only for the device it was made on
+    SwitchAtlas(m_metricsKey);
+
+    return true;
+}
+
+bool D2DRenderer::CreateSwapChainResources(D2D1_SIZE_U size, bool translucent) {
+    // Every window draws with the same devices, through its own device
+    // context and swap chain, so they can share device resources
+    SharedRenderResources& shared = SharedRenderResources::Shared();
+    ComPtr<ID3D11Device> d3dDevice;
+    ComPtr<ID2D1Device> d2dDevice;
+    const LUID adapter = PickAdapter();
+    if (!shared.GetDevice(m_d2dFactory, adapter, d3dDevice, d2dDevice)) {
+        return false;
+    }
+
+    ComPtr<IDXGIDevice1> dxgiDevice;
+    ComPtr<IDXGIAdapter> adapter;
+    ComPtr<IDXGIFactory2> dxgiFactory;
+    ComPtr<ID2D1DeviceContext> deviceContext;
+    if (FAILED(d3dDevice.As(&dxgiDevice)) ||
+        FAILED(dxgiDevice->GetAdapter(adapter.GetAddressOf())) ||
+        FAILED(adapter->GetParent(IID_PPV_ARGS(dxgiFactory.GetAddressOf()))) ||
+        FAILED(d2dDevice->CreateDeviceContext(D2D1_DEVICE_CONTEXT_OPTIONS_NONE,
+                                              deviceContext.GetAddressOf()))) {
+        return false;
+    }
+
+    BOOL tearing = FALSE;
+    ComPtr<IDXGIFactory5> dxgiFactory5;
+    if (m_allowTearing && SUCCEEDED(dxgiFactory.As(&dxgiFactory5)) &&
+        FAILED(dxgiFactory5->CheckFeatureSupport(DXGI_FEATURE_PRESENT_ALLOW_TEARING,
+                                                 &tearing, sizeof(tearing)))) {
+        tearing = FALSE;
+    }
+
+    // Flip-sequential keeps the last frame in the buffers, which is what
+    // makes presenting only dirty and scrolled regions possible; a
+    // composition swap chain does the same, and takes alpha
+    DXGI_SWAP_CHAIN_DESC1 desc{};
+    desc.Width = std::max(size.width, 1u);
+    desc.Height = std::max(size.height, 1u);
+    desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+    desc.SampleDesc.Count = 1;
+    desc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+    desc.BufferCount = 2;
+    desc.Scaling = translucent ? DXGI_SCALING_STRETCH : DXGI_SCALING_NONE;
+    desc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL;
+    desc.AlphaMode = translucent ? DXGI_ALPHA_MODE_PREMULTIPLIED : DXGI_ALPHA_MODE_IGNORE;
+    desc.Flags = DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
+    if (tearing) {
+        desc.Flags |= DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING;
+    }
+
+    ComPtr<IDXGISwapChain1> swapChain1;
+    ComPtr<IDXGISwapChain2> swapChain;
+    const HRESULT hr = translucent
+        ? dxgiFactory->CreateSwapChainForComposition(d3dDevice.Get(), &desc, nullptr, swapChain1.GetAddressOf())
+        : dxgiFactory->CreateSwapChainForHwnd(d3dDevice.Get(), m_hwnd, &desc, nullptr, nullptr,
+                                              swapChain1.GetAddressOf());
+    if (FAILED(hr) || FAILED(swapChain1.As(&swapChain))) {
+        return false;
+    }
+
+    // The visual tree is built once: the swap chain is the content of the
+    // window's one visual, so presenting needs no commit
+    ComPtr<IDCompositionDevice> dcompDevice;
+    ComPtr<IDCompositionTarget> dcompTarget;
+    ComPtr<IDCompositionVisual> dcompVisual;
+    if (translucent &&
+        (FAILED(DCompositionCreateDevice(dxgiDevice.Get(), IID_PPV_ARGS(dcompDevice.GetAddressOf()))) ||
+         FAILED(dcompDevice->CreateTargetForHwnd(m_hwnd, TRUE, dcompTarget.GetAddressOf())) ||
+         FAILED(dcompDevice->CreateVisual(dcompVisual.GetAddressOf())) ||
+         FAILED(dcompVisual->SetContent(swapChain.Get())) ||
+         FAILED(dcompTarget->SetRoot(dcompVisual.Get())) ||
+         FAILED(dcompDevice->Commit()))) {
+        return false;
+    }
+    dxgiFactory->MakeWindowAssociation(m_hwnd, DXGI_MWA_NO_ALT_ENTER);
+    swapChain->SetMaximumFrameLatency(1);
+
+    m_d3dDevice = d3dDevice;
+    m_d2dDevice = d2dDevice;
+    m_adapter = adapter;
+    m_sharedDeviceGeneration = shared.GetDeviceGeneration();
+    m_deviceContext = deviceContext;
+    m_swapChain = swapChain;
+    m_swapChainFlags = desc.Flags;
+    m_tearingSupported = tearing != FALSE;
+    m_frameLatencyWaitable = m_swapChain->GetFrameLatencyWaitableObject();
+    m_dcompDevice = dcompDevice;
+    m_dcompTarget = dcompTarget;
+    m_dcompVisual = dcompVisual;
+
+    if (!CreateBackBufferTarget()) {
+        DiscardDeviceResources();
+        return false;
+    }
+
+    // ClearType needs an opaque background
+    if (translucent) {
+        m_deviceContext->SetTextAntialiasMode(D2D1_TEXT_ANTIALIAS_MODE_GRAYSCALE);
+    }
+    m_renderTarget = m_deviceContext;
+    return true;
+}
+
+bool D2DRenderer::CreateOffscreenResources(D2D1_SIZE_U size) {
+    // The same shared device as the swap chain backend, so the cell grid
+    // shader and texture atlases run as they would on screen
+    SharedRenderResources& shared = SharedRenderResources::Shared();
+    ComPtr<ID3D11Device> d3dDevice;
+    ComPtr<ID2D1Device> d2dDevice;
+    ComPtr<ID2D1DeviceContext> deviceContext;
+    const LUID adapter = PickAdapter();
+    if (!shared.GetDevice(m_d2dFactory, adapter, d3dDevice, d2dDevice) ||
+        FAILED(d2dDevice->CreateDeviceContext(D2D1_DEVICE_CONTEXT_OPTIONS_NONE,
+                                              deviceContext.GetAddressOf()))) {
+        return false;
+    }
+
+    m_d3dDevice = d3dDevice;
+    m_d2dDevice = d2dDevice;
+    m_adapter = adapter;
+    m_sharedDeviceGeneration = shared.GetDeviceGeneration();
+    m_deviceContext = deviceContext;
+
+    if (!CreateOffscreenTarget(size)) {
+        DiscardDeviceResources();
+        return false;
+    }
+
+    m_renderTarget = m_deviceContext;
+    return true;
+}
+
+bool D2DRenderer::CreateOffscreenTarget(D2D1_SIZE_U size) {
+    m_deviceContext->SetTarget(nullptr);
+    m_backBuffer.Reset();
+    m_backBufferView.Reset();
+    m_offscreenTexture.Reset();
+
+    // The swap chain's buffer format, and a render target the cell grid
+    // shader can draw into
+    D3D11_TEXTURE2D_DESC desc{};
+    desc.Width = std::max(size.width, 1u);
+    desc.Height = std::max(size.height, 1u);
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+
+    ComPtr<IDXGISurface> surface;
+    if (FAILED(m_d3dDevice->CreateTexture2D(&desc, nullptr, m_offscreenTexture.GetAddressOf())) ||
+        FAILED(m_offscreenTexture.As(&surface))) {
+        m_offscreenTexture.Reset();
+        return false;
+    }
+
+    const D2D1_BITMAP_PROPERTIES1 props = D2D1::BitmapProperties1(
+        D2D1_BITMAP_OPTIONS_TARGET | D2D1_BITMAP_OPTIONS_CANNOT_DRAW,
+        D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_IGNORE),
+        96.0f * m_dpiScaleX, 96.0f * m_dpiScaleY);
+    if (FAILED(m_deviceContext->CreateBitmapFromDxgiSurface(surface.Get(), &props,
+                                                            m_backBuffer.GetAddressOf()))) {
+        return false;
+    }
+
+    m_offscreenSize = D2D1::SizeU(desc.Width, desc.Height);
+    m_deviceContext->SetTarget(m_backBuffer.Get());
+    return !m_cellGrid || !m_cellGrid->IsInitialized() || CreateBackBufferView();
+}
+
+bool D2DRenderer::CreateHwndTargetResources(D2D1_SIZE_U size) {
+    // Create render target
+    D2D1_RENDER_TARGET_PROPERTIES rtProps = D2D1::RenderTargetProperties(
+        D2D1_RENDER_TARGET_TYPE_DEFAULT,
+        D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED)
+    );
+
+    D2D1_HWND_RENDER_TARGET_PROPERTIES hwndProps = D2D1::HwndRenderTargetProperties(
+        m_hwnd,
+        size,
+        D2D1_PRESENT_OPTIONS_NONE
+    );
+
+    HRESULT hr = m_d2dFactory->CreateHwndRenderTarget(
+        rtProps,
+        hwndProps,
+        m_hwndTarget.ReleaseAndGetAddressOf()
+    );
+
+    if (FAILED(hr)) {
+        return false;
+    }
+
+    m_renderTarget = m_hwndTarget;
+    return true;
+}
+
+bool D2DRenderer::CreateSoftwareResources(D2D1_SIZE_U size) {
+    // Alpha is ignored, so text keeps ClearType where the session allows it
+    const D2D1_RENDER_TARGET_PROPERTIES props = D2D1::RenderTargetProperties(
+        D2D1_RENDER_TARGET_TYPE_SOFTWARE,
+        D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_IGNORE));
+    if (FAILED(m_d2dFactory->CreateDCRenderTarget(&props, m_dcTarget.ReleaseAndGetAddressOf()))) {
+        return false;
+    }
+
+    if (!CreateSoftwareBuffer(size)) {
+        ReleaseSoftwareBuffer();
+        m_dcTarget.Reset();
+        return false;
+    }
+
+    m_renderTarget = m_dcTarget;
+    return true;
+}
+
+bool D2DRenderer::CreateSoftwareBuffer(D2D1_SIZE_U size) {
+    ReleaseSoftwareBuffer();
+
+    HDC windowDC = GetDC(m_hwnd);
+    m_memoryDC = CreateCompatibleDC(windowDC);
+    ReleaseDC(m_hwnd, windowDC);
+    if (!m_memoryDC) {
+        return false;
+    }
+
+    // Top-down 32-bit BGRA, the layout the DC render target draws in
+    BITMAPINFO info{};
+    info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    info.bmiHeader.biWidth = static_cast<LONG>(std::max(size.width, 1u));
+    info.bmiHeader.biHeight = -static_cast<LONG>(std::max(size.height, 1u));
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+    void* bits = nullptr;
+    m_dib = CreateDIBSection(m_memoryDC, &info, DIB_RGB_COLORS, &bits, nullptr, 0);
+    if (!m_dib) {
+        ReleaseSoftwareBuffer();
+        return false;
+    }
+    m_oldBitmap = SelectObject(m_memoryDC, m_dib);
+    m_dibSize = SIZE{info.bmiHeader.biWidth, -info.bmiHeader.biHeight};
+
+    const RECT rect{0, 0, m_dibSize.cx, m_dibSize.cy};
+    return SUCCEEDED(m_dcTarget->BindDC(m_memoryDC, &rect));
+}
+
+void D2DRenderer::ReleaseSoftwareBuffer() {
+    if (m_memoryDC) {
+        if (m_oldBitmap) {
+            SelectObject(m_memoryDC, m_oldBitmap);
+        }
+        DeleteDC(m_memoryDC);
+    }
+    if (m_dib) {
+        DeleteObject(m_dib);
+    }
+    m_memoryDC = nullptr;
+    m_dib = nullptr;
+    m_oldBitmap = nullptr;
+    m_dibSize = SIZE{};
+}
+
+bool D2DRenderer::CreateBackBufferTarget() {
+    ComPtr<IDXGISurface> surface;
+    if (FAILED(m_swapChain->GetBuffer(0, IID_PPV_ARGS(surface.GetAddressOf())))) {
+        return false;
+    }
+
+    const D2D1_BITMAP_PROPERTIES1 props = D2D1::BitmapProperties1(
+        D2D1_BITMAP_OPTIONS_TARGET | D2D1_BITMAP_OPTIONS_CANNOT_DRAW,
+        D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM,
+                          IsTranslucent() ? D2D1_ALPHA_MODE_PREMULTIPLIED : D2D1_ALPHA_MODE_IGNORE),
+        96.0f * m_dpiScaleX, 96.0f * m_dpiScaleY);
+    if (FAILED(m_deviceContext->CreateBitmapFromDxgiSurface(surface.Get(), &props,
+                                                            m_backBuffer.GetAddressOf()))) {
+        return false;
+    }
+
+    m_deviceContext->SetTarget(m_backBuffer.Get());
+    return !m_cellGrid || !m_cellGrid->IsInitialized() || CreateBackBufferView();
+}
+
+bool D2DRenderer::CreateCellGridResources() {
+    // The shader writes opaque pixels, background included
+    if ((!m_swapChain && !m_offscreenTexture) || IsTranslucent()) {
+        return false;
+    }
+
+    if (!m_cellGrid) {
+        m_cellGrid = std::make_unique<CellGridRenderer>();
+    }
+    if (!m_cellGrid->Initialize(m_d3dDevice.Get())) {
+        return false;
+    }
+
+    // The shader reads glyphs from an atlas kept as a texture array
+    SwitchAtlas(m_metricsKey);
+    m_cellGrid->SetMetrics(m_cellWidth, m_cellHeight, m_baseline, m_dpiScaleX, m_dpiScaleY);
+    return CreateBackBufferView();
+}
+
+bool D2DRenderer::CreateBackBufferView() {
+    m_backBufferView.Reset();
+
+    ComPtr<ID3D11Texture2D> buffer = m_offscreenTexture;
+    return (buffer || SUCCEEDED(m_swapChain->GetBuffer(0, IID_PPV_ARGS(buffer.GetAddressOf())))) &&
+           SUCCEEDED(m_d3dDevice->CreateRenderTargetView(buffer.Get(), nullptr,
+                                                         m_backBufferView.GetAddressOf()));
+}
+
+void D2DRenderer::ReleaseCellGrid() {
+    m_backBufferView.Reset();
+    m_cellGrid.reset();
+    SwitchAtlas(m_metricsKey);
+}
+
+HRESULT D2DRenderer::Present() {
+    DXGI_PRESENT_PARAMETERS params{};
+
+    // Partial only when the frame said what changed, and the scroll (if
+    // any) stays inside the buffer
+    const D2D1_SIZE_U size = m_backBuffer ? m_backBuffer->GetPixelSize() : D2D1::SizeU(0, 0);
+    const bool scrollFits = !m_hasScroll ||
+        (m_scrollRect.bottom <= static_cast<LONG>(size.height) &&
+         m_scrollRect.right <= static_cast<LONG>(size.width) &&
+         m_scrollRect.top + m_scrollOffset.y >= 0 &&
+         m_scrollRect.bottom + m_scrollOffset.y <= static_cast<LONG>(size.height));
+    if (!m_presentAll && !m_dirtyRects.empty() && scrollFits) {
+        params.DirtyRectsCount = static_cast<UINT>(m_dirtyRects.size());
+        params.pDirtyRects = m_dirtyRects.data();
+        if (m_hasScroll) {
+            params.pScrollRect = &m_scrollRect;
+            params.pScrollOffset = &m_scrollOffset;
+        }
+    }
+
+    // Tearing requires a sync interval of 0
+    const UINT syncInterval = m_tearingSupported ? 0 : 1;
+    const UINT flags = m_tearingSupported ? DXGI_PRESENT_ALLOW_TEARING : 0;
+    const HRESULT hr = m_swapChain->Present1(syncInterval, flags, &params);
+
+    m_dirtyRects.clear();
+    m_hasScroll = false;
+    m_presentAll = false;
+    m_occluded = hr == DXGI_STATUS_OCCLUDED;
+    return hr;
+}
+
+bool D2DRenderer::TestOcclusion() {
+    if (!m_swapChain) {
+        m_occluded = false;
+        return false;
+    }
+    DXGI_PRESENT_PARAMETERS params{};
+    m_occluded = m_swapChain->Present1(0, DXGI_PRESENT_TEST, &params) == DXGI_STATUS_OCCLUDED;
+    return m_occluded;
+}
+
+RECT D2DRenderer::ToPixelRect(float left, float top, float right, float bottom) const {
+    return RECT{
+        static_cast<LONG>(std::floor(left * m_dpiScaleX)),
+        static_cast<LONG>(std::floor(top * m_dpiScaleY)),
+        static_cast<LONG>(std::ceil(right * m_dpiScaleX)),
+        static_cast<LONG>(std::ceil(bottom * m_dpiScaleY)),
+    };
+}
+
+bool D2DRenderer::RecoverDevice() {
+    // Keep what can be made again without the old device: the brushes'
+    // colors and the atlas's glyph list (its resolved fonts stay as well)
+    m_atlas->RememberGlyphs();
+    for (const auto& [hash, cached] : m_brushCache) {
+        m_lostBrushes.emplace_back(hash, cached.brush->GetColor());
+    }
+
+    // Other windows on the device find out before their next frame
+    if (m_d3dDevice && FAILED(m_d3dDevice->GetDeviceRemovedReason())) {
+        SharedRenderResources::Shared().ReportDeviceLost(m_d3dDevice.Get());
+    }
+
+    DiscardDeviceResources();
+    return CreateDeviceResources();
+}
+
+HRESULT D2DRenderer::PresentSoftware() {
+    HDC windowDC = GetDC(m_hwnd);
+    if (!windowDC) {
+        return E_FAIL;
+    }
+
+    if (!m_presentAll && !m_dirtyRects.empty()) {
+        // The window still shows the last frame: move its scrolled part
+        // within the window, then copy only what changed
+        if (m_hasScroll) {
+            BitBlt(windowDC, m_scrollRect.left, m_scrollRect.top + m_scrollOffset.y,
+                   m_scrollRect.right - m_scrollRect.left, m_scrollRect.bottom - m_scrollRect.top,
+                   windowDC, m_scrollRect.left, m_scrollRect.top, SRCCOPY);
+        }
+        for (const RECT& rect : m_dirtyRects) {
+            BitBlt(windowDC, rect.left, rect.top, rect.right - rect.left, rect.bottom - rect.top,
+                   m_memoryDC, rect.left, rect.top, SRCCOPY);
+        }
+    } else {
+        BitBlt(windowDC, 0, 0, m_dibSize.cx, m_dibSize.cy, m_memoryDC, 0, 0, SRCCOPY);
+    }
+    ReleaseDC(m_hwnd, windowDC);
+
+    m_dirtyRects.clear();
+    m_hasScroll = false;
+    m_presentAll = false;
+    return S_OK;
+}
+
+void D2DRenderer::DiscardDeviceResources() {
+    ReleaseFrame();
+    m_backBufferView.Reset();
+    if (m_cellGrid) {
+        m_cellGrid->Shutdown();
+    }
+    if (m_atlasShared) {
+        // Other windows may still draw with it; this one takes an atlas
+        // again once it has a device
+        m_lostAtlas = std::exchange(m_atlas, std::make_shared<GlyphAtlas>());
+        m_atlasKey.clear();
+        m_atlasShared = false;
+    } else {
+        m_atlas->SetTextureDevices(nullptr, nullptr);
+    }
+    m_parkedAtlases.clear();
+    m_brushCache.clear();
+    m_overview.Reset();
+    m_imageTextures.clear();
+    m_imageTextureBytes = 0;
+    m_renderTarget.Reset();
+    m_hwndTarget.Reset();
+    m_dcTarget.Reset();
+    ReleaseSoftwareBuffer();
+
+    if (m_deviceContext) {
+        m_deviceContext->SetTarget(nullptr);
+    }
+    m_backBuffer.Reset();
+    m_deviceContext.Reset();
+    m_d2dDevice.Reset();
+    m_dcompVisual.Reset();
+    m_dcompTarget.Reset();
+    m_dcompDevice.Reset();
+    if (m_frameLatencyWaitable) {
+        CloseHandle(m_frameLatencyWaitable);
+        m_frameLatencyWaitable = nullptr;
+    }
+    m_swapChain.Reset();
+    m_offscreenTexture.Reset();
+    m_d3dDevice.Reset();
+
+    m_dirtyRects.clear();
+    m_hasScroll = false;
+    m_presentAll = true;
+    ++m_deviceGeneration;
+    ++m_tileGeneration;
+}
+
+void D2DRenderer::ReleaseCaches() {
+    ReleaseFrame();
+
+    // What other windows draw with stays
+    m_parkedAtlases.clear();
+    m_lostAtlas.reset();
+    if (m_atlas.use_count() == 1) {
+        m_atlas->Clear();
+    }
+    if (m_shapedRuns && m_shapedRuns.use_count() == 1) {
+        m_shapedRuns->Clear();
+    }
+    m_brushCache.clear();
+    m_overview.Reset();
+    m_imageTextures.clear();
+    m_imageTextureBytes = 0;
+}
+
+void D2DRenderer::ReleaseFrame() {
+    m_scrollBitmap.Reset();
+    m_frameBitmap.Reset();
+    m_frameTarget.Reset();
+    m_frameRetained = false;
+}
+
+ID2D1RenderTarget* D2DRenderer::GetDrawTarget() const {
+    if (m_tile) {
+        return m_tile->target.Get();
+    }
+    if (m_inFrame) {
+        return m_frameTarget.Get();
+    }
+    return m_renderTarget.Get();
+}
+
+Color D2DRenderer::GetBackgroundFill() const noexcept {
+    Color fill = m_backgroundColor;
+    if (IsTranslucent()) {
+        fill.a = m_opacity;
+    }
+    return fill;
+}
+
+void D2DRenderer::UpdateCellMetrics() {
+    if (!m_dwriteFactory || !m_textFormat) {
+        return;
+    }
+
+    // Glyph positions change; nothing in the frame can be reused
+    m_frameRetained = false;
+    ++m_tileGeneration;
+
+    // Each font, DPI and snapping combination is measured once
+    const std::wstring key = MetricsKey(m_fontName, m_fontSize, m_dpiScaleX, m_dpiScaleY, m_snapCells);
+    if (const auto cached = m_fonts.metrics.find(key); cached != m_fonts.metrics.end()) {
+        m_cellWidth = cached->second.cellWidth;
+        m_cellHeight = cached->second.cellHeight;
+        m_baseline = cached->second.baseline;
+    } else if (!m_snapCells || !UpdateSnappedCellMetrics()) {
+        // Create a text layout for measuring
+        ComPtr<IDWriteTextLayout> layout;
+        HRESULT hr = m_dwriteFactory->CreateTextLayout(
+            L"M",  // Use 'M' for em-width measurement
+            1,
+            m_textFormat.Get(),
+            1000.0f,
+            1000.0f,
+            layout.GetAddressOf()
+        );
+
+        if (FAILED(hr)) {
+            m_atlas->Clear();
+            return;
+        }
+
+        // Get metrics
+        DWRITE_TEXT_METRICS metrics{};
+        layout->GetMetrics(&metrics);
+
+        m_cellWidth = metrics.width;
+        m_cellHeight = metrics.height;
+
+        // Baseline where DrawText puts it, so glyph runs line up with it
+        DWRITE_LINE_METRICS lineMetrics{};
+        UINT32 lineCount = 0;
+        if (SUCCEEDED(layout->GetLineMetrics(&lineMetrics, 1, &lineCount)) && lineCount > 0) {
+            m_baseline = lineMetrics.baseline;
+        }
+    }
+    m_fonts.metrics.try_emplace(key, SharedRenderResources::CachedMetrics{m_cellWidth, m_cellHeight, m_baseline});
+
+    SwitchAtlas(key);
+
+    if (m_cellGrid) {
+        m_cellGrid->SetMetrics(m_cellWidth, m_cellHeight, m_baseline, m_dpiScaleX, m_dpiScaleY);
+    }
+}
+
+bool D2DRenderer::UpdateSnappedCellMetrics() {
+    IDWriteFontFace* face = m_fontFaces[0].Get();
+    if (!face) {
+        return false;
+    }
+
+    DWRITE_FONT_METRICS fontMetrics{};
+    face->GetMetrics(&fontMetrics);
+    const UINT32 codepoint = U'M';
+    UINT16 glyph = 0;
+    DWRITE_GLYPH_METRICS glyphMetrics{};
+    if (fontMetrics.designUnitsPerEm == 0 || FAILED(face->GetGlyphIndices(&codepoint, 1, &glyph)) ||
+        FAILED(face->GetDesignGlyphMetrics(&glyph, 1, &glyphMetrics))) {
+        return false;
+    }
+
+    // Design units to device pixels; ascent and descent round up so no
+    // glyph is clipped, and the line gap is split around them
+    const float unitsX = m_textFormat->GetFontSize() / fontMetrics.designUnitsPerEm * m_dpiScaleX;
+    const float unitsY = m_textFormat->GetFontSize() / fontMetrics.designUnitsPerEm * m_dpiScaleY;
+    const float width = std::max(std::round(glyphMetrics.advanceWidth * unitsX), 1.0f);
+    const float ascent = std::ceil(fontMetrics.ascent * unitsY);
+    const float descent = std::ceil(fontMetrics.descent * unitsY);
+    const float lineGap = std::round(fontMetrics.lineGap * unitsY);
+
+    m_cellWidth = width / m_dpiScaleX;
+    m_cellHeight = (ascent + descent + lineGap) / m_dpiScaleY;
+    m_baseline = (ascent + std::floor(lineGap / 2.0f)) / m_dpiScaleY;
+    return true;
+}
+
+void D2DRenderer::SwitchAtlas(const std::wstring& metricsKey) {
+    m_metricsKey = metricsKey;
+    if (metricsKey.empty()) {
+        return;
+    }
+
+    // The cell grid shader reads a texture array atlas. Atlases on the
+    // shared device are shared with other windows, until it is replaced.
+    const bool texture = m_cellGrid && m_cellGrid->IsInitialized();
+    const bool shareable = m_d3dDevice != nullptr;
+    std::wstring key = metricsKey + (texture ? L"|texture" : L"");
+    if (shareable) {
+        key += L"|device" + std::to_wstring(m_sharedDeviceGeneration) + L'.' +
+               std::to_wstring(m_adapter.HighPart) + L'.' + std::to_wstring(m_adapter.LowPart);
+    }
+    if (key == m_atlasKey) {
+        return;
+    }
+
+    // Set the current atlas aside; switching back to its font and DPI
+    // takes it up again with its glyphs
+    if (!m_atlasKey.empty()) {
+        m_parkedAtlases.push_back(ParkedAtlas{m_atlasKey, std::move(m_atlas)});
+        if (m_parkedAtlases.size() > kParkedAtlases) {
+            m_parkedAtlases.erase(m_parkedAtlases.begin());
+        }
+    }
+    m_atlasKey = key;
+
+    const auto parked = std::find_if(m_parkedAtlases.begin(), m_parkedAtlases.end(),
+                                     [&key](const ParkedAtlas& atlas) { return atlas.key == key; });
+    m_atlasShared = shareable;
+    if (parked != m_parkedAtlases.end()) {
+        m_atlas = std::move(parked->atlas);
+        m_parkedAtlases.erase(parked);
+        return;
+    }
+
+    SharedRenderResources& shared = SharedRenderResources::Shared();
+    if (shareable) {
+        if (auto atlas = shared.FindAtlas(key)) {
+            m_atlas = std::move(atlas);
+            m_lostAtlas.reset();
+            return;
+        }
+    }
+
+    m_atlas = std::make_shared<GlyphAtlas>();
+    if (texture) {
+        m_atlas->SetTextureDevices(m_d3dDevice.Get(), m_d2dDevice.Get());
+    }
+    m_atlas->Reset(m_dwriteFactory,
+                   {m_variantFormats[0].Get(), m_variantFormats[1].Get(),
+                    m_variantFormats[2].Get(), m_variantFormats[3].Get()},
+                   m_cellWidth, m_cellHeight, m_baseline);
+    if (m_lostAtlas) {
+        m_atlas->AdoptRefill(*m_lostAtlas);
+        m_lostAtlas.reset();
+    }
+    if (shareable) {
+        shared.AddAtlas(key, m_atlas);
+    }
+}
+
+void D2DRenderer::SetSnapCellsToPixels(bool snap) {
+    if (snap != m_snapCells) {
+        m_snapCells = snap;
+        UpdateCellMetrics();
     }
 }
 
@@ -4,6 +4,42 @@
 //
 // Manages Direct2D render targets, brushes, and provides
 // drawing primitives for terminal rendering.
+//
+// Two backends present to the window. The swap chain backend draws with an
+// ID2D1DeviceContext into a DXGI flip-model swap chain: the window composes
+// without a copy, a frame-latency waitable object keeps at most one frame
+// queued, partial frames present only their dirty and scrolled regions,
+// and tearing can be allowed for variable refresh rate displays. The
+// HWND render target backend is the fallback where no D3D11 device can be
+// created.
+//
+// The offscreen backend presents nothing: the device context draws into a
+// texture of the shared device, which can be read back. It renders without
+// a visible window, for benchmarks and golden-image comparisons.
+//
+// The software backend is for remote sessions and machines without a GPU:
+// Direct2D's CPU rasterizer draws into a DIB section through a DC render
+// target, and only the dirty regions are copied to the window with BitBlt
+// (a scroll is a screen-to-screen BitBlt). Over RDP, what is sent then
+// scales with the changed cells rather than with the window.
+//
+// A translucent window (opacity below 1) keeps the same per-frame cost as
+// an opaque one. Its swap chain has premultiplied alpha and is the content
+// of a DirectComposition visual on the window, instead of being presented
+// to the window directly; what shows through is DWM's backdrop (the desktop,
+// or acrylic), which is composed by DWM and never drawn here. Present1 still
+// takes dirty and scrolled regions, the retained frame and row tiles are
+// copied over the window rather than blended, and only the background is
+// translucent: ClearRect and Clear fill with the background color at the
+// window's opacity, while text and other colors stay opaque. Text is
+// grayscale antialiased (ClearType needs an opaque background), and the
+// cell grid shader, which writes opaque pixels, is not used.
+//
+// On the swap chain backend the terminal grid can optionally be drawn by
+// CellGridRenderer, a Direct3D shader, with Direct2D drawing only overlays.
+//
+// The renderers of all windows share the device, glyph atlases, shaped runs
+// and font objects (see SharedRenderResources.h).
 
 #ifndef NTDDI_VERSION
 #define NTDDI_VERSION NTDDI_WIN10_RS5
@@ -14,18 +50,31 @@
 
 #include <Windows.h>
 #include <d2d1_1.h>
+#include <d3d11.h>
+#include <dcomp.h>
+#include <dxgi1_5.h>
 #include <dwrite_1.h>
 #include <wrl/client.h>
 
+#include "UI/GlyphAtlas.h"
+#include "UI/ShapedRunCache.h"
+#include "UI/SharedRenderResources.h"
+
+#include <array>
 #include <cstdint>
+#include <span>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <memory>
+#include <vector>
 
 using Microsoft::WRL::ComPtr;
 
 namespace Console3::UI {
 
+class CellGridRenderer;
+
 /// RGBA color structure
 struct Color {
     float r = 0.0f;
@@ -43,12 +92,72 @@ struct Color {
         };
     }
 
+    bool operator==(const Color& other) const noexcept = default;
+
     /// Convert to D2D1_COLOR_F
     [[nodiscard]] D2D1_COLOR_F ToD2D() const {
         return D2D1::ColorF(r, g, b, a);
     }
 };
 
+/// How frames reach the window
+enum class RenderBackend {
+    SwapChain,      ///< ID2D1DeviceContext on a DXGI flip-model swap chain
+    HwndTarget,     ///< ID2D1HwndRenderTarget
+    Software,       ///< ID2D1DCRenderTarget (software) on a DIB section, BitBlt to the window
+    Offscreen,      ///< ID2D1DeviceContext on a texture, never presented (benchmarks, golden images)
+};
+
+/// Get the backend a performance setting names ("gpu", "hwnd", "software")
+/// @return The backend (SwapChain for any other name)
+[[nodiscard]] RenderBackend ParseRenderBackend(const std::wstring& name) noexcept;
+
+/// A retained frame taken out of the renderer (e.g. while its tab is hidden)
+struct SavedFrame {
+    ComPtr<ID2D1BitmapRenderTarget> target;
+    ComPtr<ID2D1Bitmap> bitmap;
+    ComPtr<ID2D1Bitmap> scrollBitmap;
+    uint64_t device = 0;            ///< Device it was drawn on (see D2DRenderer::RestoreFrame)
+
+    [[nodiscard]] explicit operator bool() const noexcept { return bitmap != nullptr; }
+
+    /// Get the video memory it holds (frame and scroll scratch)
+    [[nodiscard]] size_t GetBytes() const noexcept {
+        if (!bitmap) {
+            return 0;
+        }
+        const D2D1_SIZE_U size = bitmap->GetPixelSize();
+        return static_cast<size_t>(size.width) * size.height * 4 * 2;
+    }
+};
+
+/// A row of terminal content rendered once and composited many times
+/// (see D2DRenderer::BeginTile)
+struct RowTile {
+    ComPtr<ID2D1BitmapRenderTarget> target;
+    ComPtr<ID2D1Bitmap> bitmap;
+};
+
+/// Lines drawn under or through a run of cells (CellAttributes::underline
+/// values 1-3, then strikethrough)
+enum class TextDecoration : uint8_t {
+    None = 0,
+    Underline = 1,
+    DoubleUnderline = 2,
+    CurlyUnderline = 3,
+    Strikethrough = 4,
+};
+
+/// Work counted since the last D2DRenderer::TakeCounters (for profiling)
+struct RenderCounters {
+    uint32_t drawCalls = 0;     ///< Fills, lines, bitmap and glyph copies, text, shader draws
+    uint32_t glyphRuns = 0;     ///< Glyph runs drawn (one per run of cells)
+    uint32_t atlasHits = 0;     ///< Glyphs found in the atlas
+    uint32_t atlasMisses = 0;   ///< Glyphs rasterized into it (or not cacheable)
+    uint32_t brushHits = 0;     ///< Brushes found in the cache
+    uint32_t brushMisses = 0;   ///< Brushes created
+};
+
 /// Configuration for the renderer
 struct RendererConfig {
     HWND hwnd = nullptr;
@@ -57,6 +166,13 @@ struct RendererConfig {
     Color backgroundColor = Color::FromRgb(12, 12, 12);  // Dark background
     float dpiScaleX = 1.0f;
     float dpiScaleY = 1.0f;
+    RenderBackend backend = RenderBackend::SwapChain;  ///< Falls back to HwndTarget
+    bool allowTearing = false;      ///< Present without vsync where supported (VRR displays)
+    bool snapCellsToPixels = true;  ///< Whole-pixel cell metrics (see SetSnapCellsToPixels)
+    float opacity = 1.0f;           ///< Background opacity (see SetOpacity)
+    GpuPreference gpuPreference = GpuPreference::Display;  ///< Adapter for the Direct3D backends
+    UINT width = 0;                 ///< Offscreen without a window: target size in pixels
+    UINT height = 0;
 };
 
 /// Direct2D renderer for terminal display
@@ -80,13 +196,28 @@ public:
     /// Check if the renderer is initialized
     [[nodiscard]] bool IsInitialized() const noexcept { return m_renderTarget != nullptr; }
 
+    /// Get the backend in use (HwndTarget after a fallback)
+    [[nodiscard]] RenderBackend GetBackend() const noexcept {
+        return m_swapChain ? RenderBackend::SwapChain
+             : m_dcTarget ? RenderBackend::Software
+             : m_offscreenTexture ? RenderBackend::Offscreen
+             : RenderBackend::HwndTarget;
+    }
+
     /// Handle window resize
     /// @param width New width in pixels
     /// @param height New height in pixels
+    /// @param keepFrame Keep the retained frame at its old size (a preview
+    /// during a live resize; DrawFrame then draws it unscaled at the top left)
     /// @return true on success
-    [[nodiscard]] bool Resize(UINT width, UINT height);
-
-    /// Handle DPI change
+    [[nodiscard]] bool Resize(UINT width, UINT height, bool keepFrame = false);
+
+    /// Handle DPI change (e.g. the window moved to another monitor)
+    ///
+    /// Text formats and font faces don't depend on the DPI and are kept;
+    /// cell metrics are cached per font and DPI, and the glyph atlas of the
+    /// previous DPI is parked, so moving back and forth between monitors
+    /// measures and rasterizes nothing again.
     /// @param dpiX New horizontal DPI
     /// @param dpiY New vertical DPI
     void SetDpi(float dpiX, float dpiY);
@@ -95,17 +226,189 @@ public:
     [[nodiscard]] float GetDpiScaleX() const noexcept { return m_dpiScaleX; }
     [[nodiscard]] float GetDpiScaleY() const noexcept { return m_dpiScaleY; }
 
+    /// Scale what is drawn into the window from its top left corner (a
+    /// zoom preview: the frame and glyphs already made, stretched on the
+    /// GPU instead of laid out and rasterized again). Frames are presented
+    /// whole while it is not 1.
+    void SetPreviewScale(float scale) noexcept { m_previewScale = scale; }
+    [[nodiscard]] float GetPreviewScale() const noexcept { return m_previewScale; }
+
     // ========================================================================
     // Rendering Commands
     // ========================================================================
 
     /// Begin a frame (must be called before any drawing)
+    /// With the swap chain backend this first waits (briefly) until the
+    /// swap chain can take another frame.
     /// @return true if rendering can proceed
     [[nodiscard]] bool BeginDraw();
 
     /// End the frame and present
-    /// @return true on success, false if render target needs recreation
-    [[nodiscard]] bool EndDraw();
+    ///
+    /// If the device was lost, the frame is dropped and a new device is
+    /// created at once (GetDeviceGeneration changes). Fonts, cell metrics
+    /// and resolved glyphs are kept; the glyphs the atlas held and the
+    /// brushes are remembered for RestoreDeviceCaches.
+    /// @return true on success, false if the frame did not reach the window
+    bool EndDraw();
+
+    /// Recreate, a few at a time, what the last lost device took: the
+    /// device itself if that failed, then the brushes and atlas glyphs
+    /// (also the glyphs a new atlas is seeded with, see GlyphAtlas)
+    /// @param budget Most glyphs to rasterize
+    /// @return true if work remains (call again later)
+    bool RestoreDeviceCaches(size_t budget);
+
+    /// Check if the atlas has glyphs for RestoreDeviceCaches to rasterize
+    [[nodiscard]] bool HasGlyphsToRefill() const noexcept { return m_atlas->HasRefill(); }
+
+    /// Copy glyphs rasterized on the worker threads into the atlas (before
+    /// the frame, outside BeginDraw/EndDraw)
+    /// @return true if cells drawn blank while their glyph was pending can
+    /// now be drawn: repaint the whole frame
+    bool LandGlyphs();
+
+    /// Check if cells were drawn blank waiting for their glyph (see
+    /// GlyphRasterizer)
+    [[nodiscard]] bool IsAwaitingGlyphs() const noexcept { return m_awaitingGlyphs; }
+
+    /// Free what is rebuilt on demand: the retained frame, atlas glyphs and
+    /// parked atlases, shaped runs and brushes (for a view that is hidden
+    /// and idle). The device, fonts and cell metrics are kept.
+    void ReleaseCaches();
+
+    /// Get a count that changes whenever the device is lost or recreated
+    [[nodiscard]] uint64_t GetDeviceGeneration() const noexcept { return m_deviceGeneration; }
+
+    /// Wait until the GPU has finished everything drawn so far (frame times
+    /// of the offscreen backend, where nothing waits for a present)
+    /// @return false if there is no Direct3D device to wait for
+    bool WaitForGpu();
+
+    /// Copy the offscreen target's pixels (BGRA, top row first)
+    /// @return false on other backends, or if the copy failed
+    [[nodiscard]] bool ReadPixels(std::vector<uint32_t>& pixels, UINT& width, UINT& height);
+
+    /// Get and reset the work counted since the last call
+    [[nodiscard]] RenderCounters TakeCounters() noexcept;
+
+    /// Report a region of the window that changes in this frame
+    /// Call while drawing, into the window or the retained frame (which
+    /// maps 1:1 onto the window). With the swap chain backend a frame with
+    /// regions reported presents only those (and any move from
+    /// ScrollFrame); a frame with none presents the whole window. The whole
+    /// window must still be drawn either way.
+    void AddDirtyRect(float x, float y, float width, float height);
+
+    /// Present the whole window this frame, whatever was reported
+    void PresentWholeWindow() noexcept { m_presentAll = true; }
+
+    /// Check if the last present found the window fully covered, on a
+    /// locked screen or on a disconnected session (swap chain backend only)
+    [[nodiscard]] bool IsOccluded() const noexcept { return m_occluded; }
+
+    /// Ask the swap chain whether the window is still occluded, presenting
+    /// nothing
+    /// @return true if it is
+    bool TestOcclusion();
+
+    // ========================================================================
+    // Retained Frame
+    // ========================================================================
+    //
+    // Terminal content can be drawn into an offscreen frame that keeps its
+    // pixels between paints, so only changed rows need repainting and
+    // scrolls become pixel moves. Each paint then draws the frame into the
+    // window (DrawFrame) with transient overlays such as the cursor on top.
+
+    /// Begin drawing into the retained frame instead of the window
+    /// Drawing commands target the frame until EndFrame().
+    /// @return true if drawing can proceed
+    [[nodiscard]] bool BeginFrame();
+
+    /// End drawing into the retained frame
+    /// @return true on success; on failure the frame is dropped
+    bool EndFrame();
+
+    /// Check if the frame still holds the last frame's pixels
+    /// False after creation, resize, DPI or font changes and device loss;
+    /// the caller must then repaint everything.
+    [[nodiscard]] bool IsFrameRetained() const noexcept { return m_frameRetained; }
+
+    /// Move a band of the retained frame vertically
+    /// Call outside BeginFrame()/EndFrame(). The part of the band the
+    /// content moved away from keeps stale pixels and must be repainted.
+    /// Pixels left and right of the band (other panes) stay put.
+    /// @param left Left edge of the band
+    /// @param top Top of the band
+    /// @param width Width of the band (reaching the right edge = to the edge)
+    /// @param height Height of the band
+    /// @param dy Distance to move (negative = up)
+    /// @return false if the move is not pixel exact (repaint instead)
+    [[nodiscard]] bool ScrollFrame(float left, float top, float width, float height, float dy);
+
+    /// Draw the retained frame into the window (between BeginDraw/EndDraw)
+    /// @param y Top of the frame in the window (rounded to a whole pixel)
+    void DrawFrame(float y = 0.0f);
+
+    /// Take the retained frame out of the renderer, which then has none
+    /// @return The frame, or an empty one if none was retained
+    [[nodiscard]] SavedFrame TakeFrame();
+
+    /// Make a frame taken earlier the retained frame again
+    /// @return false if it no longer fits (device lost, or the window size
+    /// or DPI changed since); the caller must then repaint everything
+    bool RestoreFrame(SavedFrame frame);
+
+    // ========================================================================
+    // Row Tiles
+    // ========================================================================
+    //
+    // Rows that don't change (scrollback) can be rendered once into tiles
+    // and composited at any offset, so scrolling through them costs bitmap
+    // copies rather than text layout.
+
+    /// Begin drawing into a row tile (outside BeginDraw/EndDraw)
+    /// The tile is created on first use; drawing commands target it until
+    /// EndTile().
+    /// @param width Tile width (DIPs)
+    /// @param height Tile height (DIPs)
+    /// @return true if drawing can proceed
+    [[nodiscard]] bool BeginTile(RowTile& tile, float width, float height);
+
+    /// End drawing into the row tile
+    /// @return true on success; on failure the tile is released
+    bool EndTile();
+
+    /// Draw a row tile into the window (between BeginDraw/EndDraw)
+    /// @param y Top of the tile (rounded to a whole pixel)
+    void DrawTile(const RowTile& tile, float x, float y);
+
+    /// Set the image of the scrollback overview strip (see
+    /// Core::ScrollbackOverview), uploaded once and stretched by DrawOverview
+    /// @param pixels Premultiplied BGRA, width * height
+    /// @return false if the bitmap could not be created
+    bool SetOverview(std::span<const uint32_t> pixels, UINT32 width, UINT32 height);
+
+    /// Check if an overview image is held (a device loss drops it)
+    [[nodiscard]] bool HasOverview() const noexcept { return m_overview != nullptr; }
+
+    /// Draw the overview image stretched over a rect, one bitmap quad
+    /// (between BeginDraw/EndDraw)
+    void DrawOverview(float x, float y, float width, float height);
+
+    /// Draw an inline image stretched over a rect (between BeginDraw/EndDraw).
+    /// Its texture is uploaded on first use and kept while owner lives,
+    /// those drawn least recently dropped past a budget.
+    /// @param owner Holds the pixels; identifies the image
+    /// @param pixels Premultiplied BGRA, width * height
+    void DrawImage(const std::shared_ptr<const void>& owner, std::span<const uint32_t> pixels, UINT32 width,
+                   UINT32 height, float x, float y, float drawWidth, float drawHeight);
+
+    /// Get a count that changes whenever row tiles drawn earlier stop
+    /// matching what they would be drawn as now (device loss, resize, DPI
+    /// or font change); tiles from before must then be redrawn
+    [[nodiscard]] uint64_t GetTileGeneration() const noexcept { return m_tileGeneration; }
 
     /// Clear the render target with the background color
     void Clear();
@@ -113,9 +416,42 @@ public:
     /// Clear with a specific color
     void Clear(const Color& color);
 
+    /// Set the color Clear() and the window outside the grid are filled with
+    void SetBackgroundColor(const Color& color) noexcept { m_backgroundColor = color; }
+
+    /// Fill a region with the background color, replacing what was drawn
+    /// there (at the window's opacity when translucent)
+    void ClearRect(float x, float y, float width, float height);
+
+    /// Set the opacity of the background (outside SetBackgroundColor's
+    /// color, everything stays opaque)
+    /// Going from opaque to translucent or back creates a new swap chain; a
+    /// change within translucent takes effect with the next frame. The
+    /// caller must then repaint everything.
+    /// @return false if the backend can't be translucent (HWND target,
+    /// software, offscreen); it then draws opaque
+    bool SetOpacity(float opacity);
+
+    /// Set the GPU the swap chain and offscreen backends draw on, from the
+    /// next UpdateAdapter() or new device
+    void SetGpuPreference(GpuPreference preference) noexcept { m_gpuPreference = preference; }
+
+    /// Pick the adapter again, after the window moved to another monitor or
+    /// the displays changed, and move to it if it is another one (the
+    /// caller must then repaint everything)
+    /// @return true if the renderer moved to another device
+    bool UpdateAdapter();
+
+    /// Check if the window is drawn translucent (through DirectComposition)
+    [[nodiscard]] bool IsTranslucent() const noexcept { return m_dcompTarget != nullptr; }
+
     /// Draw a filled rectangle
     void FillRect(float x, float y, float width, float height, const Color& color);
 
+    /// Limit drawing to a rectangle until PopClip() (a pane of a split view)
+    void PushClip(float x, float y, float width, float height);
+    void PopClip();
+
     /// Draw a rectangle outline
     void DrawRect(float x, float y, float width, float height, const Color& color, float strokeWidth = 1.0f);
 
@@ -132,15 +468,81 @@ public:
                   const std::wstring& fontName = L"");
 
     /// Draw a single character (optimized for terminal cells)
+    /// Drawn from the glyph atlas at the nearest whole pixel.
     /// @param codepoint UTF-32 codepoint
     /// @param x X position
     /// @param y Y position
     /// @param color Text color
-    void DrawChar(uint32_t codepoint, float x, float y, const Color& color);
+    /// @param width Cells the character covers (1 or 2)
+    /// @param variant Font face (bold, italic)
+    void DrawChar(uint32_t codepoint, float x, float y, const Color& color,
+                  int width = 1, FontVariant variant = FontVariant::Regular);
+
+    /// Draw a base character with combining characters, shaped together
+    /// @param sequence Identifies the sequence (its GraphemeTable index)
+    /// @param chars Base character, then the combining characters
+    void DrawGrapheme(uint32_t sequence, std::span<const uint32_t> chars, float x, float y,
+                      const Color& color, int width = 1, FontVariant variant = FontVariant::Regular);
+
+    /// Draw a run of single-width characters, one per cell
+    /// Drawn as glyph runs with fixed cell advances; characters the font
+    /// lacks go through DrawChar for font fallback. With ligatures on, a
+    /// run the font covers is shaped instead (see ShapedRunCache).
+    /// @param codepoints UTF-32 codepoints, one per cell
+    /// @param x X position of the first cell
+    /// @param y Y position
+    /// @param color Text color
+    /// @param variant Font face (bold, italic)
+    void DrawTextRun(std::span<const uint32_t> codepoints, float x, float y, const Color& color,
+                     FontVariant variant = FontVariant::Regular);
 
     /// Draw text using a text layout
     void DrawTextLayout(IDWriteTextLayout* layout, float x, float y, const Color& color);
 
+    /// Draw a decoration line across a run of cells, one device pixel thick
+    /// and at the same offsets as the cell grid shader draws them. Straight
+    /// lines are one rectangle per run; a curly underline is one wave period
+    /// per cell, from a geometry built once per cell size.
+    /// @param x X position of the first cell
+    /// @param y Y position of the cell row's top
+    /// @param cells Cells the run covers
+    void DrawDecoration(TextDecoration decoration, float x, float y, int cells, const Color& color);
+
+    // ========================================================================
+    // Cell Grid Shader
+    // ========================================================================
+
+    /// Draw the terminal grid with CellGridRenderer (off by default)
+    /// @return false if it can't be used (HWND target backend, or the
+    /// device can't run the shader); drawing then stays with Direct2D
+    bool EnableCellGrid(bool enable);
+
+    /// Get the cell grid renderer, or nullptr if not enabled and working
+    [[nodiscard]] CellGridRenderer* GetCellGrid() const noexcept;
+
+    /// Draw the cell grid over the whole window (between BeginDraw/EndDraw,
+    /// before anything drawn on top of it)
+    bool DrawCellGrid();
+
+    /// Find a glyph in the atlas, rasterizing it on first use
+    /// @return The glyph (valid until the next call), or nullptr (also
+    /// while it is pending: leave the cell blank)
+    [[nodiscard]] const AtlasGlyph* FindGlyph(uint32_t codepoint, int width, FontVariant variant);
+
+    /// Find a combining sequence in the atlas (see DrawGrapheme)
+    [[nodiscard]] const AtlasGlyph* FindSequenceGlyph(uint32_t sequence, std::span<const uint32_t> chars,
+                                                      int width, FontVariant variant);
+
+    /// Get the atlas generation (see GlyphAtlas::GetGeneration)
+    [[nodiscard]] uint64_t GetAtlasGeneration() const noexcept { return m_atlas->GetGeneration(); }
+
+    /// Get this renderer's share of the atlas memory: each atlas it holds
+    /// (the current one and those parked) split evenly between its holders
+    [[nodiscard]] size_t GetAtlasShareBytes() const noexcept;
+
+    /// Get the video memory the retained frame holds (frame and scroll scratch)
+    [[nodiscard]] size_t GetFrameBytes() const noexcept;
+
     // ========================================================================
     // Font Management
     // ========================================================================
@@ -151,6 +553,21 @@ public:
     /// @return true on success
     [[nodiscard]] bool SetFont(const std::wstring& fontName, float fontSize);
 
+    /// Derive cell metrics from the font's design metrics, rounded to whole
+    /// device pixels: the advance of "M", and ascent + descent + line gap
+    /// with the baseline on a pixel boundary. Every cell and glyph origin
+    /// then falls on whole pixels, so a glyph rasterizes the same in every
+    /// cell. Off, cells are as wide and tall as DirectWrite lays out "M".
+    void SetSnapCellsToPixels(bool snap);
+
+    [[nodiscard]] bool GetSnapCellsToPixels() const noexcept { return m_snapCells; }
+
+    /// Shape text runs with the font's ligatures (off by default). Shaped
+    /// runs are cached by text across frames until the font changes.
+    void SetLigatures(bool enable) noexcept { m_ligatures = enable; }
+
+    [[nodiscard]] bool GetLigatures() const noexcept { return m_ligatures; }
+
     /// Get the current cell dimensions based on font metrics
     [[nodiscard]] float GetCellWidth() const noexcept { return m_cellWidth; }
     [[nodiscard]] float GetCellHeight() const noexcept { return m_cellHeight; }
@@ -167,10 +584,14 @@ public:
     // ========================================================================
 
     /// Get or create a solid color brush for the given color
+    /// @return The brush (valid until the next frame), or nullptr
     [[nodiscard]] ID2D1SolidColorBrush* GetBrush(const Color& color);
 
+    /// Get the number of brushes cached
+    [[nodiscard]] size_t GetBrushCount() const noexcept { return m_brushCache.size(); }
+
     /// Get the render target (for advanced use)
-    [[nodiscard]] ID2D1HwndRenderTarget* GetRenderTarget() const { return m_renderTarget.Get(); }
+    [[nodiscard]] ID2D1RenderTarget* GetRenderTarget() const { return m_renderTarget.Get(); }
 
     /// Get the DirectWrite factory
     [[nodiscard]] IDWriteFactory1* GetDWriteFactory() const { return m_dwriteFactory; }
@@ -179,12 +600,89 @@ private:
     /// Create device-dependent resources
     [[nodiscard]] bool CreateDeviceResources();
 
+    /// Find the adapter the GPU preference picks for the window's monitor
+    [[nodiscard]] LUID PickAdapter() const;
+
+    /// Create the D3D11 device, D2D device context and swap chain
+    /// @param translucent Premultiplied alpha, composed through DirectComposition
+    [[nodiscard]] bool CreateSwapChainResources(D2D1_SIZE_U size, bool translucent);
+
+    /// Create the HWND render target
+    [[nodiscard]] bool CreateHwndTargetResources(D2D1_SIZE_U size);
+
+    /// Create the software DC render target and its DIB section
+    [[nodiscard]] bool CreateSoftwareResources(D2D1_SIZE_U size);
+
+    /// (Re)create the DIB section and bind the DC render target to it
+    [[nodiscard]] bool CreateSoftwareBuffer(D2D1_SIZE_U size);
+
+    /// Release the DIB section and its memory DC
+    void ReleaseSoftwareBuffer();
+
+    /// Create the D2D device context and the texture it draws into
+    [[nodiscard]] bool CreateOffscreenResources(D2D1_SIZE_U size);
+
+    /// (Re)create the offscreen texture and point the device context at it
+    [[nodiscard]] bool CreateOffscreenTarget(D2D1_SIZE_U size);
+
+    /// Point the device context at the swap chain's back buffer
+    [[nodiscard]] bool CreateBackBufferTarget();
+
+    /// Set up the cell grid renderer and texture atlas on the device
+    [[nodiscard]] bool CreateCellGridResources();
+
+    /// Create the Direct3D view of the back buffer the cell grid draws into
+    [[nodiscard]] bool CreateBackBufferView();
+
+    /// Drop the cell grid renderer (the atlas goes back to bitmap pages)
+    void ReleaseCellGrid();
+
+    /// Present the swap chain, partially if the frame reported its changes
+    [[nodiscard]] HRESULT Present();
+
+    /// Copy the DIB section to the window, only the changes if the frame
+    /// reported them
+    [[nodiscard]] HRESULT PresentSoftware();
+
+    /// Convert a DIP rectangle to whole back buffer pixels, rounding outward
+    [[nodiscard]] RECT ToPixelRect(float left, float top, float right, float bottom) const;
+
+    /// Replace a lost device, remembering its cached glyphs and brushes
+    /// @return false if no device could be created (retried by RestoreDeviceCaches)
+    bool RecoverDevice();
+
     /// Release device-dependent resources
     void DiscardDeviceResources();
 
+    /// Release the retained frame (recreated by the next BeginFrame)
+    void ReleaseFrame();
+
+    /// Get the target drawing commands go to
+    [[nodiscard]] ID2D1RenderTarget* GetDrawTarget() const;
+
+    /// Get the background color at the window's opacity
+    [[nodiscard]] Color GetBackgroundFill() const noexcept;
+
+    /// Draw a bitmap of window content (the retained frame, a row tile)
+    /// into the window, replacing what is there when translucent
+    void DrawWindowBitmap(ID2D1Bitmap* bitmap, const D2D1_RECT_F& dest);
+
+    /// Copy a glyph from the atlas, tinted unless it is a color glyph
+    void DrawAtlasGlyph(const AtlasGlyph& glyph, float x, float y, const Color& color);
+
     /// Update cell metrics based on current font
     void UpdateCellMetrics();
 
+    /// Set whole-pixel cell metrics from the regular face's design metrics
+    /// @return false if the face can't be measured (lay out "M" instead)
+    [[nodiscard]] bool UpdateSnappedCellMetrics();
+
+    /// Make the atlas for a font and DPI current, parking the current one;
+    /// on the shared device it may be another window's
+    /// @param metricsKey Font, size, DPI and snapping (as the metrics cache
+    /// key); the atlas mode and device are added to it
+    void SwitchAtlas(const std::wstring& metricsKey);
+
     /// Generate a hash key for a color (for brush caching)
     [[nodiscard]] static uint32_t ColorHash(const Color& color);
 
@@ -196,14 +694,140 @@ private:
     // Window handle
     HWND m_hwnd = nullptr;
 
-    // Render target
-    ComPtr<ID2D1HwndRenderTarget> m_renderTarget;
-
-    // Text format (default font)
+    // Render target (the device context or the HWND render target)
+    ComPtr<ID2D1RenderTarget> m_renderTarget;
+    RenderBackend m_backend = RenderBackend::SwapChain;
+    ComPtr<ID2D1HwndRenderTarget> m_hwndTarget;
+
+    // Swap chain backend
+    ComPtr<ID3D11Device> m_d3dDevice;
+    ComPtr<ID2D1Device> m_d2dDevice;
+    ComPtr<ID2D1DeviceContext> m_deviceContext;
+    ComPtr<IDXGISwapChain2> m_swapChain;
+    ComPtr<ID2D1Bitmap1> m_backBuffer;
+    HANDLE m_frameLatencyWaitable = nullptr;
+    UINT m_swapChainFlags = 0;
+    bool m_allowTearing = false;
+    bool m_tearingSupported = false;
+    GpuPreference m_gpuPreference = GpuPreference::Display;
+    LUID m_adapter{};                   ///< Adapter m_d3dDevice was asked for
+
+    // Translucent windows: the swap chain is the content of a visual
+    ComPtr<IDCompositionDevice> m_dcompDevice;
+    ComPtr<IDCompositionTarget> m_dcompTarget;
+    ComPtr<IDCompositionVisual> m_dcompVisual;
+    float m_opacity = 1.0f;
+
+    // Offscreen backend: the device context's target texture (m_backBuffer
+    // wraps it), and its size without a window
+    ComPtr<ID3D11Texture2D> m_offscreenTexture;
+    D2D1_SIZE_U m_offscreenSize{};
+
+    // Software backend
+    ComPtr<ID2D1DCRenderTarget> m_dcTarget;
+    HDC m_memoryDC = nullptr;
+    HBITMAP m_dib = nullptr;
+    HGDIOBJ m_oldBitmap = nullptr;      ///< Selected into m_memoryDC before m_dib
+    SIZE m_dibSize{};
+
+    // Cell grid shader (swap chain and offscreen backends only)
+    std::unique_ptr<CellGridRenderer> m_cellGrid;
+    ComPtr<ID3D11RenderTargetView> m_backBufferView;
+    bool m_cellGridEnabled = false;
+
+    // Changes reported for the next Present or PresentSoftware (window pixels)
+    std::vector<RECT> m_dirtyRects;
+    RECT m_scrollRect{};
+    POINT m_scrollOffset{};
+    bool m_hasScroll = false;
+    bool m_presentAll = true;       ///< Present everything (new buffers, or changes not describable)
+    bool m_occluded = false;        ///< The last Present returned DXGI_STATUS_OCCLUDED
+
+    // Retained frame and the scratch bitmap used to move its pixels
+    ComPtr<ID2D1BitmapRenderTarget> m_frameTarget;
+    ComPtr<ID2D1Bitmap> m_frameBitmap;
+    ComPtr<ID2D1Bitmap> m_scrollBitmap;
+    bool m_frameRetained = false;
+    uint64_t m_deviceGeneration = 0;    ///< Counts device losses (stale SavedFrames)
+    uint64_t m_sharedDeviceGeneration = 0;  ///< SharedRenderResources generation of m_d3dDevice
+
+    // Scrollback overview strip's image (see SetOverview)
+    ComPtr<ID2D1Bitmap> m_overview;
+
+    // Inline images' textures by owner (see DrawImage)
+    struct ImageTexture {
+        std::weak_ptr<const void> owner;    ///< Expired: the address may be another image's now
+        ComPtr<ID2D1Bitmap> bitmap;
+        size_t bytes = 0;
+        uint64_t lastUsed = 0;
+    };
+    std::unordered_map<const void*, ImageTexture> m_imageTextures;
+    size_t m_imageTextureBytes = 0;
+    uint64_t m_imageClock = 0;
+
+    // Row tile being drawn (see BeginTile)
+    RowTile* m_tile = nullptr;
+    uint64_t m_tileGeneration = 0;
+
+    // Text format (default font) and one per FontVariant (m_textFormat first)
     ComPtr<IDWriteTextFormat> m_textFormat;
-
-    // Brush cache (color hash -> brush)
-    std::unordered_map<uint32_t, ComPtr<ID2D1SolidColorBrush>> m_brushCache;
+    std::array<ComPtr<IDWriteTextFormat>, 4> m_variantFormats;
+
+    // Font face per FontVariant for glyph runs (null if not resolved), and
+    // its glyph indices of the first kGlyphIndexTableSize characters
+    std::array<ComPtr<IDWriteFontFace>, 4> m_fontFaces;
+    std::array<std::vector<UINT16>, 4> m_glyphIndices;
+
+    /// A glyph atlas set aside for a font and DPI no longer in use
+    struct ParkedAtlas {
+        std::wstring key;
+        std::shared_ptr<GlyphAtlas> atlas;
+    };
+
+    // Font objects kept across font and DPI changes, shared by the
+    // renderers of every window
+    SharedRenderResources::FontObjects& m_fonts = SharedRenderResources::Shared().GetFonts();
+
+    // One wave period of the curly underline (device independent), and the
+    // cell width and line width it was built for
+    ComPtr<ID2D1PathGeometry> m_undercurl;
+    float m_undercurlWidth = 0.0f;
+    float m_undercurlLine = 0.0f;
+
+    // Glyph run scratch (reused between runs)
+    std::vector<UINT16> m_runGlyphs;
+    std::vector<FLOAT> m_runAdvances;
+
+    // Runs shaped with ligatures, for the current font (shared with other
+    // windows showing it)
+    std::shared_ptr<ShapedRunCache> m_shapedRuns;
+    bool m_ligatures = false;
+
+    // Rasterized glyphs for DrawChar, the font and DPI they are for, and
+    // the atlases of recent other DPIs (oldest first). On the shared device
+    // the atlas is shared with other windows showing the same font and DPI;
+    // after a device loss the old one is kept until its glyph list has been
+    // handed to the atlas on the new device.
+    std::shared_ptr<GlyphAtlas> m_atlas = std::make_shared<GlyphAtlas>();
+    std::wstring m_atlasKey;
+    std::wstring m_metricsKey;
+    bool m_atlasShared = false;
+    bool m_awaitingGlyphs = false;      ///< Drew a pending glyph blank
+    uint64_t m_landedSeen = 0;          ///< Atlas landed count at the last LandGlyphs
+    std::shared_ptr<GlyphAtlas> m_lostAtlas;
+    std::vector<ParkedAtlas> m_parkedAtlases;
+
+    // Brush cache (color hash -> brush and the frame it was last used in,
+    // trimmed past kMaxBrushes), and the colors of brushes a lost device
+    // took, to create again
+    struct CachedBrush {
+        ComPtr<ID2D1SolidColorBrush> brush;
+        uint64_t frame = 0;
+    };
+    std::unordered_map<uint32_t, CachedBrush> m_brushCache;
+    uint64_t m_brushFrame = 0;          ///< Draws begun (frames and tiles)
+    uint64_t m_brushSweepFrame = 0;     ///< m_brushFrame the cache was last trimmed in
+    std::vector<std::pair<uint32_t, D2D1_COLOR_F>> m_lostBrushes;
 
     // Font metrics
     std::wstring m_fontName = L"Consolas";
@@ -211,16 +835,22 @@ private:
     float m_cellWidth = 8.0f;
     float m_cellHeight = 16.0f;
     float m_baseline = 12.0f;
+    bool m_snapCells = true;
 
     // DPI scaling
     float m_dpiScaleX = 1.0f;
     float m_dpiScaleY = 1.0f;
+    float m_previewScale = 1.0f;    ///< See SetPreviewScale
 
     // Background color
     Color m_backgroundColor;
 
+    // Work since the last TakeCounters (atlas lookups are counted there)
+    RenderCounters m_counters;
+
     // State
     bool m_isDrawing = false;
+    bool m_inFrame = false;         ///< Drawing into the retained frame
 };
 
 } // namespace Console3::UI
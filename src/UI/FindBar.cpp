@@ -0,0 +1,400 @@
+// Console3 - FindBar.cpp
+// Find in the tab: a bar above the terminal view (Ctrl+F)
+
+#include "UI/FindBar.h"
+#include "Core/Session.h"
+#include "Core/Utf.h"
+#include "UI/TerminalView.h"
+#include <atlstr.h>
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <utility>
+
+namespace Console3::UI {
+
+namespace {
+
+// Builds the shadow a slice per tick until it has caught up
+constexpr UINT_PTR kUpdateTimerId = 1;
+constexpr UINT kUpdateTimerMs = 15;
+
+// Layout, in pixels at 96 DPI
+constexpr int kMargin = 4;
+constexpr int kRowHeight = 24;
+constexpr int kButtonWidth = 72;
+constexpr int kCheckWidth = 96;
+constexpr int kStatusWidth = 160;
+constexpr int kMinQueryWidth = 120;
+
+/// Line order: by line, then offset in it
+bool LineBefore(const Core::SearchHit& a, const Core::SearchHit& b) noexcept {
+    if (a.lineId != b.lineId) {
+        return a.lineId < b.lineId;
+    }
+    return a.offset < b.offset;
+}
+
+/// Count the hits of a sorted list before a match (or at it too)
+size_t CountBefore(const std::vector<Core::SearchHit>& hits, const Core::SearchHit& match, bool inclusive) {
+    const auto end = inclusive ? std::upper_bound(hits.begin(), hits.end(), match, LineBefore)
+                               : std::lower_bound(hits.begin(), hits.end(), match, LineBefore);
+    return static_cast<size_t>(end - hits.begin());
+}
+
+} // namespace
+
+FindBar::~FindBar() {
+    if (IsWindow()) {
+        DestroyWindow();
+    }
+}
+
+bool FindBar::Create(HWND parent, TerminalView* view, CloseCallback onClose) {
+    m_view = view;
+    m_onClose = std::move(onClose);
+    return CWindowImpl<FindBar>::Create(parent, rcDefault, nullptr, WS_CHILD | WS_CLIPCHILDREN | WS_CLIPSIBLINGS,
+                                        WS_EX_CONTROLPARENT) != nullptr;
+}
+
+int FindBar::GetHeight() const {
+    const int dpi = IsWindow() ? static_cast<int>(GetDpiForWindow(m_hWnd)) : 96;
+    return MulDiv(kRowHeight + 2 * kMargin, dpi, 96);
+}
+
+void FindBar::Open() {
+    if (!IsWindow()) {
+        return;
+    }
+    m_open = true;
+    ShowWindow(SW_SHOW);
+    m_queryEdit.SetFocus();
+    m_queryEdit.SetSelAll();
+    if (!m_matcher) {
+        StartSearch();
+    }
+}
+
+void FindBar::Close() {
+    if (!m_open) {
+        return;
+    }
+    StopSearch();
+    m_open = false;
+    ShowWindow(SW_HIDE);
+    if (m_onClose) {
+        m_onClose();
+    }
+}
+
+void FindBar::SetSession(Core::Session* session) {
+    if (session == m_session) {
+        return;
+    }
+    StopSearch();
+    m_session = session;
+    if (m_open) {
+        StartSearch();
+    }
+}
+
+void FindBar::ForgetSession(const Core::Session& session) {
+    if (&session != m_session) {
+        return;
+    }
+    StopSearch();
+    m_session = nullptr;
+    if (m_status.IsWindow()) {
+        m_status.SetWindowTextW(L"");
+    }
+}
+
+BOOL FindBar::PreTranslateMessage(MSG* pMsg) {
+    if (!m_open || (pMsg->hwnd != m_hWnd && !IsChild(pMsg->hwnd))) {
+        return FALSE;
+    }
+
+    // Enter steps to the previous match, Shift+Enter to the next; Escape
+    // closes the bar
+    if (pMsg->message == WM_KEYDOWN && pMsg->wParam == VK_RETURN) {
+        Step(GetKeyState(VK_SHIFT) >= 0);
+        return TRUE;
+    }
+    if (pMsg->message == WM_KEYDOWN && pMsg->wParam == VK_ESCAPE) {
+        Close();
+        return TRUE;
+    }
+    return ::IsDialogMessageW(m_hWnd, pMsg);
+}
+
+// ============================================================================
+// Message Handlers
+// ============================================================================
+
+int FindBar::OnCreate(LPCREATESTRUCT /*lpCreateStruct*/) {
+    const int dpi = static_cast<int>(GetDpiForWindow(m_hWnd));
+    m_font.CreateFont(-MulDiv(9, dpi, 72), 0, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE, DEFAULT_CHARSET,
+                      OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, CLEARTYPE_QUALITY, DEFAULT_PITCH | FF_DONTCARE,
+                      L"Segoe UI");
+
+    m_queryEdit.Create(m_hWnd, rcDefault, nullptr, WS_CHILD | WS_VISIBLE | WS_TABSTOP | ES_AUTOHSCROLL,
+                       WS_EX_CLIENTEDGE, IDC_QUERY);
+    m_matchCaseCheck.Create(m_hWnd, rcDefault, L"Match case", WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_AUTOCHECKBOX,
+                            0, IDC_MATCH_CASE);
+    m_regexCheck.Create(m_hWnd, rcDefault, L"Regex", WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_AUTOCHECKBOX, 0,
+                        IDC_REGEX);
+    m_status.Create(m_hWnd, rcDefault, L"", WS_CHILD | WS_VISIBLE | SS_LEFTNOWORDWRAP | SS_CENTERIMAGE, 0,
+                    IDC_STATUS);
+    m_previousButton.Create(m_hWnd, rcDefault, L"Previous", WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_PUSHBUTTON, 0,
+                            IDC_PREVIOUS);
+    m_nextButton.Create(m_hWnd, rcDefault, L"Next", WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_PUSHBUTTON, 0,
+                        IDC_NEXT);
+    m_closeButton.Create(m_hWnd, rcDefault, L"Close", WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_PUSHBUTTON, 0,
+                         IDC_CLOSE);
+
+    for (HWND control : {m_queryEdit.m_hWnd, m_matchCaseCheck.m_hWnd, m_regexCheck.m_hWnd, m_status.m_hWnd,
+                         m_previousButton.m_hWnd, m_nextButton.m_hWnd, m_closeButton.m_hWnd}) {
+        ::SendMessageW(control, WM_SETFONT, reinterpret_cast<WPARAM>(m_font.m_hFont), FALSE);
+    }
+    return 0;
+}
+
+void FindBar::OnDestroy() {
+    StopSearch();
+    m_session = nullptr;
+    m_open = false;
+    m_font.DeleteObject();
+}
+
+void FindBar::OnSize(UINT /*nType*/, CSize size) {
+    if (!m_closeButton.IsWindow()) {
+        return;
+    }
+    const int dpi = static_cast<int>(GetDpiForWindow(m_hWnd));
+    const int margin = MulDiv(kMargin, dpi, 96);
+    const int row = MulDiv(kRowHeight, dpi, 96);
+    const int button = MulDiv(kButtonWidth, dpi, 96);
+    const int check = MulDiv(kCheckWidth, dpi, 96);
+    const int status = MulDiv(kStatusWidth, dpi, 96);
+
+    // The query takes what the fixed controls leave, right to left
+    int x = size.cx - margin - button;
+    m_closeButton.MoveWindow(x, margin, button, row);
+    x -= margin + button;
+    m_nextButton.MoveWindow(x, margin, button, row);
+    x -= margin / 2 + button;
+    m_previousButton.MoveWindow(x, margin, button, row);
+    x -= margin + status;
+    m_status.MoveWindow(x, margin, status, row);
+    x -= margin + button;
+    m_regexCheck.MoveWindow(x, margin, button, row);
+    x -= check;
+    m_matchCaseCheck.MoveWindow(x, margin, check, row);
+    m_queryEdit.MoveWindow(margin, margin, std::max(x - 2 * margin, MulDiv(kMinQueryWidth, dpi, 96)), row);
+}
+
+void FindBar::OnSetFocus(CWindow /*wndOld*/) {
+    m_queryEdit.SetFocus();
+}
+
+void FindBar::OnTimer(UINT_PTR nIDEvent) {
+    if (nIDEvent != kUpdateTimerId) {
+        SetMsgHandled(FALSE);
+        return;
+    }
+    // Once the shadow has caught up, output keeps it current
+    if (!m_session || !m_session->UpdateSearch()) {
+        KillTimer(kUpdateTimerId);
+        m_building = false;
+    }
+    TakeHits();
+    UpdateStatus();
+}
+
+LRESULT FindBar::OnHitsMessage(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/) {
+    m_hitsPosted->store(false);
+    TakeHits();
+    UpdateStatus();
+    return 0;
+}
+
+void FindBar::OnQueryChange(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/) {
+    if (m_open) {
+        StartSearch();
+    }
+}
+
+void FindBar::OnOptionClick(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/) {
+    StartSearch();
+}
+
+void FindBar::OnPrevious(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/) {
+    Step(true);
+}
+
+void FindBar::OnNext(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/) {
+    Step(false);
+}
+
+void FindBar::OnClose(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/) {
+    Close();
+}
+
+// ============================================================================
+// Searching
+// ============================================================================
+
+void FindBar::StartSearch() {
+    StopSearch();
+    CString edit;
+    m_queryEdit.GetWindowTextW(edit);
+    Core::SearchQuery query;
+    query.text = Core::ToUtf8(std::wstring_view(edit.GetString(), static_cast<size_t>(edit.GetLength())));
+    query.matchCase = m_matchCaseCheck.GetCheck() == BST_CHECKED;
+    query.regex = m_regexCheck.GetCheck() == BST_CHECKED;
+    if (!m_session || query.text.empty()) {
+        m_status.SetWindowTextW(L"");
+        return;
+    }
+
+    // The worker only posts; the flag is shared so it may outlive the window
+    const HWND hwnd = m_hWnd;
+    const std::shared_ptr<std::atomic<bool>> posted = m_hitsPosted;
+    if (!m_session->GetSearch().Start(query, [hwnd, posted] {
+            if (!posted->exchange(true)) {
+                ::PostMessageW(hwnd, kHitsMessage, 0, 0);
+            }
+        })) {
+        m_status.SetWindowTextW(L"Invalid regular expression");
+        return;
+    }
+    m_matcher = std::make_shared<const Core::TextMatcher>(query);
+
+    m_building = m_session->UpdateSearch();
+    if (m_building) {
+        SetTimer(kUpdateTimerId, kUpdateTimerMs);
+    }
+    TakeHits();
+    UpdateStatus();
+}
+
+void FindBar::StopSearch() {
+    if (IsWindow()) {
+        KillTimer(kUpdateTimerId);
+    }
+    m_building = false;
+    if (m_session) {
+        m_session->GetSearch().Stop();
+    }
+    m_matcher.reset();
+    m_hits.clear();
+    m_screenHits.clear();
+    m_hasCurrent = false;
+}
+
+void FindBar::TakeHits() {
+    if (!m_session || !m_matcher) {
+        return;
+    }
+    m_taken.clear();
+    if (m_session->GetSearch().TakeHits(m_taken)) {
+        // The shadow was rebuilt; its lines may be numbered anew
+        m_hits.clear();
+        m_hasCurrent = false;
+    }
+
+    // Each batch is sorted, then merged into the list in place
+    std::sort(m_taken.begin(), m_taken.end(), LineBefore);
+    const auto middle = static_cast<std::ptrdiff_t>(m_hits.size());
+    m_hits.insert(m_hits.end(), m_taken.begin(), m_taken.end());
+    std::inplace_merge(m_hits.begin(), m_hits.begin() + middle, m_hits.end(), LineBefore);
+
+    // Lines trimmed off the top of the history can't be shown any more
+    if (const Core::TerminalBuffer* buffer = m_session->GetBuffer()) {
+        const uint64_t first = buffer->GetFirstLine();
+        const auto kept = std::partition_point(m_hits.begin(), m_hits.end(),
+                                               [first](const Core::SearchHit& hit) { return hit.lineId < first; });
+        m_hits.erase(m_hits.begin(), kept);
+    }
+}
+
+void FindBar::MatchScreen() {
+    m_screenHits.clear();
+    const Core::TerminalBuffer* buffer = m_session ? m_session->GetBuffer() : nullptr;
+    if (!buffer || !m_matcher) {
+        return;
+    }
+    std::string text;
+    const uint64_t screenLine = buffer->GetScreenLine();
+    for (int row = 0; row < buffer->GetRows(); ++row) {
+        text.clear();
+        Core::ScrollbackSearch::AppendLineText(text, buffer->GetRow(row));
+        size_t length = 0;
+        for (size_t at = m_matcher->Find(text, 0, length); at != std::string_view::npos;
+             at = m_matcher->Find(text, at + std::max<size_t>(length, 1), length)) {
+            if (length != 0) {
+                m_screenHits.push_back(Core::SearchHit{screenLine + static_cast<uint64_t>(row),
+                                                       static_cast<uint32_t>(at), static_cast<uint32_t>(length)});
+            }
+        }
+    }
+}
+
+void FindBar::Step(bool older) {
+    if (!m_matcher) {
+        StartSearch();
+    }
+    MatchScreen();
+    const size_t total = m_hits.size() + m_screenHits.size();
+    if (total == 0 || !m_view) {
+        UpdateStatus();
+        return;
+    }
+
+    // Every stored line comes before the screen's, so the two lists read
+    // as one in line order
+    size_t target = older ? total - 1 : 0;
+    if (m_hasCurrent) {
+        const size_t before = CountBefore(m_hits, m_current, !older) + CountBefore(m_screenHits, m_current, !older);
+        if (older) {
+            target = before == 0 ? total - 1 : before - 1;
+        } else {
+            target = before == total ? 0 : before;
+        }
+    }
+    m_current = target < m_hits.size() ? m_hits[target] : m_screenHits[target - m_hits.size()];
+    m_hasCurrent = true;
+    (void)m_view->RevealMatch(m_current.lineId, m_current.offset, m_current.length);
+    UpdateStatus();
+}
+
+void FindBar::UpdateStatus() {
+    if (!m_matcher) {
+        return;
+    }
+    MatchScreen();
+    const size_t total = m_hits.size() + m_screenHits.size();
+    std::wstring status;
+    if (total == 0) {
+        status = m_building ? L"Searching..." : L"No matches";
+    } else {
+        // The match stepped to, if it is still there
+        const size_t before = m_hasCurrent ? CountBefore(m_hits, m_current, false) +
+                                                 CountBefore(m_screenHits, m_current, false)
+                                           : total;
+        const bool found = before < total &&
+                           !LineBefore(m_current, before < m_hits.size() ? m_hits[before]
+                                                                         : m_screenHits[before - m_hits.size()]);
+        status = found ? std::to_wstring(before + 1) + L" of " : std::wstring();
+        status += std::to_wstring(total) + (total == 1 ? L" match" : L" matches");
+        if (m_hits.size() >= Core::ScrollbackSearch::kMaxHits) {
+            status += L" (more not shown)";
+        } else if (m_building) {
+            status += L", searching";
+        }
+    }
+    m_status.SetWindowTextW(status.c_str());
+}
+
+} // namespace Console3::UI
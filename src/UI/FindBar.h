@@ -0,0 +1,185 @@
+#pragma once
+// Console3 - FindBar.h
+// Find in the tab: a bar above the terminal view (Ctrl+F)
+//
+// Searches the focused session's screen and scrollback as the query is
+// typed. The scrollback goes to the session's ScrollbackSearch, whose
+// worker streams hits back while the shadow is built a slice per timer
+// tick and as output arrives; the screen changes every frame, so it is
+// matched with TextMatcher whenever the matches are counted or stepped
+// through. Enter steps to the previous (older) match and Shift+Enter to
+// the next; each is scrolled into view and selected. Escape closes the
+// bar and stops the search.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#define STRICT
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+
+#include <Windows.h>
+
+// ATL/WTL headers
+#include <atlbase.h>
+#include <atlapp.h>
+
+extern CAppModule _Module;
+
+#include <atlwin.h>
+#include <atlctrls.h>
+#include <atlcrack.h>
+
+#include "Core/ScrollbackSearch.h"
+#include "UI/RenderLock.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace Console3::Core {
+class Session;
+}
+
+namespace Console3::UI {
+
+class TerminalView;
+
+/// Find in the tab bar (see file comment)
+class FindBar : public CWindowImpl<FindBar> {
+public:
+    DECLARE_WND_CLASS_EX(L"Console3FindBar", 0, COLOR_BTNFACE)
+
+    /// Called when Escape or the close button hides the bar
+    using CloseCallback = std::function<void()>;
+
+    FindBar() = default;
+    ~FindBar();
+
+    // Non-copyable, non-movable
+    FindBar(const FindBar&) = delete;
+    FindBar& operator=(const FindBar&) = delete;
+
+    /// Create the bar, hidden
+    bool Create(HWND parent, TerminalView* view, CloseCallback onClose);
+
+    /// Get the bar's height at its DPI
+    [[nodiscard]] int GetHeight() const;
+
+    /// Check if the bar is shown
+    [[nodiscard]] bool IsOpen() const noexcept { return m_open; }
+
+    /// Show the bar and focus the query, searching what it holds
+    void Open();
+
+    /// Hide the bar and stop the search
+    void Close();
+
+    /// Search a session from now on: the focused one (nullptr: none);
+    /// an open search moves to it
+    void SetSession(Core::Session* session);
+
+    /// Stop searching a session that is going away
+    void ForgetSession(const Core::Session& session);
+
+    /// Handle the bar's keys (MainFrame::PreTranslateMessage, under the
+    /// render lock)
+    BOOL PreTranslateMessage(MSG* pMsg);
+
+    // The window's messages are handled under the render lock
+    WNDPROC GetWindowProc() override { return RenderLockedWindowProc<FindBar>; }
+
+    BEGIN_MSG_MAP(FindBar)
+        MSG_WM_CREATE(OnCreate)
+        MSG_WM_DESTROY(OnDestroy)
+        MSG_WM_SIZE(OnSize)
+        MSG_WM_SETFOCUS(OnSetFocus)
+        MSG_WM_TIMER(OnTimer)
+        MESSAGE_HANDLER(kHitsMessage, OnHitsMessage)
+        COMMAND_HANDLER_EX(IDC_QUERY, EN_CHANGE, OnQueryChange)
+        COMMAND_ID_HANDLER_EX(IDC_MATCH_CASE, OnOptionClick)
+        COMMAND_ID_HANDLER_EX(IDC_REGEX, OnOptionClick)
+        COMMAND_ID_HANDLER_EX(IDC_PREVIOUS, OnPrevious)
+        COMMAND_ID_HANDLER_EX(IDC_NEXT, OnNext)
+        COMMAND_ID_HANDLER_EX(IDC_CLOSE, OnClose)
+    END_MSG_MAP()
+
+    // Posted by the search's worker when hits are ready; coalesced until
+    // handled
+    static constexpr UINT kHitsMessage = WM_APP + 1;
+
+    enum {
+        IDC_QUERY = 1001,
+        IDC_MATCH_CASE,
+        IDC_REGEX,
+        IDC_STATUS,
+        IDC_PREVIOUS,
+        IDC_NEXT,
+        IDC_CLOSE
+    };
+
+private:
+    int OnCreate(LPCREATESTRUCT lpCreateStruct);
+    void OnDestroy();
+    void OnSize(UINT nType, CSize size);
+    void OnSetFocus(CWindow wndOld);
+    void OnTimer(UINT_PTR nIDEvent);
+    LRESULT OnHitsMessage(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
+    void OnQueryChange(UINT uNotifyCode, int nID, CWindow wndCtl);
+    void OnOptionClick(UINT uNotifyCode, int nID, CWindow wndCtl);
+    void OnPrevious(UINT uNotifyCode, int nID, CWindow wndCtl);
+    void OnNext(UINT uNotifyCode, int nID, CWindow wndCtl);
+    void OnClose(UINT uNotifyCode, int nID, CWindow wndCtl);
+
+    /// Start searching the session for the query typed
+    void StartSearch();
+
+    /// Stop the session's search and drop its matches
+    void StopSearch();
+
+    /// Merge the hits found since the last call, in line order
+    void TakeHits();
+
+    /// Match the query against the screen, into m_screenHits
+    void MatchScreen();
+
+    /// Step to the match before (older) or after the current one,
+    /// wrapping around, and reveal it
+    void Step(bool older);
+
+    /// Show the match count and which one is selected
+    void UpdateStatus();
+
+    TerminalView* m_view = nullptr;
+    Core::Session* m_session = nullptr;
+    CloseCallback m_onClose;
+    bool m_open = false;
+    bool m_building = false;                    ///< The shadow is still being built (timer running)
+
+    std::shared_ptr<const Core::TextMatcher> m_matcher;     ///< For the screen; null while not searching
+    std::vector<Core::SearchHit> m_hits;        ///< Scrollback matches, in line order
+    std::vector<Core::SearchHit> m_taken;       ///< Scratch for TakeHits()
+    std::vector<Core::SearchHit> m_screenHits;  ///< Screen matches, by absolute line
+    bool m_hasCurrent = false;                  ///< A match was stepped to
+    Core::SearchHit m_current;                  ///< The match stepped to last
+    /// kHitsMessage is in the queue (shared with the worker, which may
+    /// outlive the window)
+    std::shared_ptr<std::atomic<bool>> m_hitsPosted = std::make_shared<std::atomic<bool>>(false);
+
+    CEdit m_queryEdit;
+    CButton m_matchCaseCheck;
+    CButton m_regexCheck;
+    CStatic m_status;
+    CButton m_previousButton;
+    CButton m_nextButton;
+    CButton m_closeButton;
+    CFont m_font;
+};
+
+} // namespace Console3::UI
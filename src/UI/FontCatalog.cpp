@@ -0,0 +1,268 @@
+// Console3 - FontCatalog.cpp
+// Monospace font families installed on the system, enumerated off the UI thread
+
+#include "UI/FontCatalog.h"
+#include "UI/RenderFactories.h"
+#include "Core/Utf.h"
+#include <ShlObj.h>
+#include <wil/resource.h>
+#include <wrl/client.h>
+#include <algorithm>
+#include <fstream>
+#include <string_view>
+
+using Microsoft::WRL::ComPtr;
+
+namespace Console3::UI {
+
+namespace {
+
+constexpr const wchar_t* kFontsKey = L"SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion\\Fonts";
+
+// First line of the disk cache, followed by its version and stamp; bumped
+// when what counts as monospaced changes
+constexpr std::string_view kCacheHeader = "Console3 fonts";
+constexpr int kCacheVersion = 1;
+
+/// Get a key's last write time (0 if it can't be opened)
+uint64_t KeyWriteTime(HKEY root, const wchar_t* path) {
+    wil::unique_hkey key;
+    FILETIME lastWrite{};
+    if (RegOpenKeyExW(root, path, 0, KEY_READ, key.put()) != ERROR_SUCCESS ||
+        RegQueryInfoKeyW(key.get(), nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+                         nullptr, nullptr, &lastWrite) != ERROR_SUCCESS) {
+        return 0;
+    }
+    return (static_cast<uint64_t>(lastWrite.dwHighDateTime) << 32) | lastWrite.dwLowDateTime;
+}
+
+/// Sort names and drop repeats
+void SortUnique(std::vector<std::wstring>& names) {
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+}
+
+/// Get a family's name, in US English if it has one
+std::wstring FamilyName(IDWriteFontFamily* family) {
+    ComPtr<IDWriteLocalizedStrings> names;
+    if (FAILED(family->GetFamilyNames(names.GetAddressOf()))) {
+        return {};
+    }
+
+    UINT32 index = 0;
+    BOOL exists = FALSE;
+    if (FAILED(names->FindLocaleName(L"en-us", &index, &exists)) || !exists) {
+        index = 0;
+    }
+    UINT32 length = 0;
+    if (FAILED(names->GetStringLength(index, &length))) {
+        return {};
+    }
+    std::wstring name(length + 1, L'\0');
+    if (FAILED(names->GetString(index, name.data(), length + 1))) {
+        return {};
+    }
+    name.resize(length);
+    return name;
+}
+
+/// Check if a family's regular face has every glyph the same width
+bool IsMonospaced(IDWriteFontFamily* family) {
+    ComPtr<IDWriteFont> font;
+    ComPtr<IDWriteFontFace> face;
+    ComPtr<IDWriteFontFace1> face1;
+    return SUCCEEDED(family->GetFirstMatchingFont(DWRITE_FONT_WEIGHT_NORMAL, DWRITE_FONT_STRETCH_NORMAL,
+                                                  DWRITE_FONT_STYLE_NORMAL, font.GetAddressOf())) &&
+           font->GetSimulations() == DWRITE_FONT_SIMULATIONS_NONE &&
+           SUCCEEDED(font->CreateFontFace(face.GetAddressOf())) &&
+           SUCCEEDED(face.As(&face1)) && face1->IsMonospacedFont();
+}
+
+} // namespace
+
+FontCatalog::~FontCatalog() {
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+FontCatalog& FontCatalog::Shared() {
+    static FontCatalog s_instance;
+    return s_instance;
+}
+
+void FontCatalog::EnumerateInBackground(std::function<void()> onDone) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_started) {
+        return;
+    }
+    m_started = true;
+    m_onDone = std::move(onDone);
+    StartThread(true);
+}
+
+void FontCatalog::Invalidate() {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (!m_started) {
+        return;                         // The first enumeration will see the change
+    }
+    if (m_running) {
+        m_rescan = true;
+        return;
+    }
+    StartThread(false);
+}
+
+void FontCatalog::StartThread(bool useCache) {
+    // A finished thread has nothing left to do but return
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    m_running = true;
+    m_thread = std::thread([this, useCache]() { Run(useCache); });
+}
+
+void FontCatalog::Run(bool useCache) {
+    // Taken before enumerating, so a font installed meanwhile leaves the
+    // cache stale rather than missing it
+    uint64_t stamp = StampFonts();
+    std::vector<std::wstring> families;
+    bool fresh = !useCache;
+    if (!useCache || !LoadCache(stamp, families)) {
+        for (;;) {
+            families = Enumerate(fresh, [this](const std::vector<std::wstring>& found) {
+                std::lock_guard<std::mutex> lock(m_lock);
+                if (m_ready) {
+                    return;             // A rescan: the whole old list stays up meanwhile
+                }
+                m_families = found;
+                SortUnique(m_families);
+                ++m_generation;
+            });
+            {
+                std::lock_guard<std::mutex> lock(m_lock);
+                if (!m_rescan) {
+                    break;
+                }
+                m_rescan = false;
+            }
+            stamp = StampFonts();
+            fresh = true;
+        }
+        SaveCache(stamp, families);
+    }
+
+    std::function<void()> onDone;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_families = std::move(families);
+        m_ready = true;
+        ++m_generation;
+        m_running = false;
+        onDone = std::move(m_onDone);
+        m_onDone = nullptr;
+    }
+    if (onDone) {
+        onDone();
+    }
+}
+
+bool FontCatalog::IsReady() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_ready;
+}
+
+uint32_t FontCatalog::GetGeneration() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_generation;
+}
+
+std::vector<std::wstring> FontCatalog::GetMonospaceFamilies() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_families;
+}
+
+std::vector<std::wstring> FontCatalog::Enumerate(
+    bool fresh, const std::function<void(const std::vector<std::wstring>&)>& onBatch) {
+    std::vector<std::wstring> families;
+
+    // Creating the shared factory here also loads the system font
+    // collection off the UI thread, before the first renderer wants it
+    IDWriteFactory1* factory = RenderFactories::GetDWriteFactory();
+    ComPtr<IDWriteFontCollection> collection;
+    if (!factory || FAILED(factory->GetSystemFontCollection(collection.GetAddressOf(), fresh ? TRUE : FALSE))) {
+        return families;
+    }
+
+    const UINT32 count = collection->GetFontFamilyCount();
+    for (UINT32 i = 0; i < count; ++i) {
+        if (i % kBatch == kBatch - 1 && !families.empty()) {
+            onBatch(families);
+        }
+        ComPtr<IDWriteFontFamily> family;
+        if (FAILED(collection->GetFontFamily(i, family.GetAddressOf())) || !IsMonospaced(family.Get())) {
+            continue;
+        }
+        std::wstring name = FamilyName(family.Get());
+        if (!name.empty()) {
+            families.push_back(std::move(name));
+        }
+    }
+
+    SortUnique(families);
+    return families;
+}
+
+uint64_t FontCatalog::StampFonts() {
+    // Per-user fonts (Windows 10 1809) are listed under the user's own key
+    const uint64_t machine = KeyWriteTime(HKEY_LOCAL_MACHINE, kFontsKey);
+    const uint64_t user = KeyWriteTime(HKEY_CURRENT_USER, kFontsKey);
+    return machine ^ ((user << 1) | (user >> 63));
+}
+
+std::filesystem::path FontCatalog::GetCachePath() {
+    wchar_t* localAppData = nullptr;
+    if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, nullptr, &localAppData))) {
+        std::filesystem::path path = localAppData;
+        CoTaskMemFree(localAppData);
+        return path / L"Console3" / L"fonts.cache";
+    }
+    return L"fonts.cache";
+}
+
+bool FontCatalog::LoadCache(uint64_t stamp, std::vector<std::wstring>& families) {
+    // "Console3 fonts <version> <stamp>", then a family per line (UTF-8)
+    std::ifstream file(GetCachePath(), std::ios::binary);
+    std::string line;
+    if (!file.is_open() || !std::getline(file, line) ||
+        line != std::string(kCacheHeader) + " " + std::to_string(kCacheVersion) + " " + std::to_string(stamp)) {
+        return false;
+    }
+
+    families.clear();
+    while (std::getline(file, line)) {
+        if (!line.empty()) {
+            families.push_back(Core::ToUtf16(line));
+        }
+    }
+    SortUnique(families);
+    return !families.empty();
+}
+
+void FontCatalog::SaveCache(uint64_t stamp, const std::vector<std::wstring>& families) {
+    // Nothing found is likelier a DirectWrite failure than the truth
+    if (families.empty()) {
+        return;
+    }
+
+    const std::filesystem::path path = GetCachePath();
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << kCacheHeader << ' ' << kCacheVersion << ' ' << stamp << '\n';
+    for (const std::wstring& family : families) {
+        file << Core::ToUtf8(family) << '\n';
+    }
+}
+
+} // namespace Console3::UI
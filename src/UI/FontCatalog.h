@@ -0,0 +1,118 @@
+#pragma once
+// Console3 - FontCatalog.h
+// Monospace font families installed on the system, enumerated off the UI thread
+//
+// Finding which of the installed families are monospaced means creating a
+// font face for each, which takes a noticeable fraction of a second on a
+// machine with many fonts. The shared catalog does that on a background
+// thread started after the window is up, and keeps the sorted list for the
+// settings dialog. The list grows as the enumeration goes (each batch of
+// families bumps GetGeneration), so a dialog opened meanwhile fills its
+// combo as they arrive; until the first batch it offers a few well-known
+// families instead.
+//
+// The result is kept on disk (GetCachePath) with the last write times of
+// the machine's and the user's Fonts registry keys, which installing or
+// removing a font changes: while they match, the next launch takes the list
+// from the file and doesn't enumerate at all. A font installed while
+// Console3 runs broadcasts WM_FONTCHANGE, on which the window calls
+// Invalidate; the list is enumerated again against a fresh system
+// collection, the old one staying up until the new one is whole.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Console3::UI {
+
+/// Cached list of monospace font families (see file comment)
+class FontCatalog {
+public:
+    FontCatalog() = default;
+    ~FontCatalog();
+
+    // Non-copyable, non-movable (owns the enumeration thread)
+    FontCatalog(const FontCatalog&) = delete;
+    FontCatalog& operator=(const FontCatalog&) = delete;
+
+    /// Get the process-wide catalog
+    static FontCatalog& Shared();
+
+    /// Fill the list on a background thread, from the disk cache if it is
+    /// current and else by enumerating the system's font families (once)
+    /// @param onDone Called on that thread when the list is ready
+    void EnumerateInBackground(std::function<void()> onDone = {});
+
+    /// Enumerate again: the installed fonts changed (WM_FONTCHANGE)
+    /// Coalesces with an enumeration already running, which starts over.
+    void Invalidate();
+
+    /// Check if the list is whole
+    [[nodiscard]] bool IsReady() const;
+
+    /// Get a count bumped each time the list changes, to poll for updates
+    [[nodiscard]] uint32_t GetGeneration() const;
+
+    /// Get the monospace family names, sorted (those found so far until
+    /// IsReady())
+    [[nodiscard]] std::vector<std::wstring> GetMonospaceFamilies() const;
+
+    /// Get the file the list is cached in between launches
+    [[nodiscard]] static std::filesystem::path GetCachePath();
+
+    /// Get the last write times of the Fonts registry keys, combined: it
+    /// changes when a font is installed or removed
+    [[nodiscard]] static uint64_t StampFonts();
+
+private:
+    /// Families enumerated between partial publishes
+    static constexpr uint32_t kBatch = 32;
+
+    /// Start the enumeration thread (m_lock held)
+    void StartThread(bool useCache);
+
+    /// Take the list from the disk cache if useCache and it is current,
+    /// else enumerate until no Invalidate came in meanwhile (enumeration
+    /// thread)
+    void Run(bool useCache);
+
+    /// Enumerate the system font collection
+    /// @param fresh Ask DirectWrite for a collection with fonts installed
+    ///              since the process started
+    /// @param onBatch Called with the families found so far, unsorted,
+    ///                every kBatch families
+    [[nodiscard]] static std::vector<std::wstring> Enumerate(
+        bool fresh, const std::function<void(const std::vector<std::wstring>&)>& onBatch);
+
+    /// Read the disk cache
+    /// @return false if it is missing, damaged or for another stamp
+    [[nodiscard]] static bool LoadCache(uint64_t stamp, std::vector<std::wstring>& families);
+
+    /// Write the disk cache
+    static void SaveCache(uint64_t stamp, const std::vector<std::wstring>& families);
+
+    mutable std::mutex m_lock;
+    std::vector<std::wstring> m_families;
+    bool m_ready = false;
+    uint32_t m_generation = 0;
+    bool m_started = false;
+    bool m_running = false;             ///< The thread is enumerating
+    bool m_rescan = false;              ///< Invalidated while running: start over
+    std::function<void()> m_onDone;     ///< Cleared once called
+    std::thread m_thread;
+};
+
+} // namespace Console3::UI
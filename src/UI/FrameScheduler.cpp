@@ -0,0 +1,143 @@
+// Console3 - FrameScheduler.cpp
+// Paces terminal repaints to the display refresh
+
+#include "UI/FrameScheduler.h"
+#include "UI/MessageLoop.h"
+#include "Core/PerfClock.h"
+#include <dwmapi.h>
+#include <algorithm>
+
+#pragma comment(lib, "dwmapi.lib")
+
+namespace Console3::UI {
+
+namespace {
+
+/// Re-read the refresh period this often (monitor or mode changes)
+constexpr uint64_t kPeriodCheckMicros = 1'000'000;
+
+} // namespace
+
+FrameScheduler::~FrameScheduler() {
+    Detach();
+}
+
+bool FrameScheduler::Attach(WaitHandleHost* loop, RenderCallback render) {
+    Detach();
+    if (!loop || !render) {
+        return false;
+    }
+
+    // High resolution: a default timer rounds up to the 15.6 ms tick
+    m_timer.reset(CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+                                         TIMER_ALL_ACCESS));
+    if (!m_timer) {
+        m_timer.reset(CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS));
+    }
+    if (!m_timer || !loop->AddWaitHandle(m_timer.get(), [this]() { OnTimer(); })) {
+        m_timer.reset();
+        return false;
+    }
+
+    m_loop = loop;
+    m_render = std::move(render);
+    return true;
+}
+
+void FrameScheduler::Detach() {
+    if (m_loop) {
+        m_loop->RemoveWaitHandle(m_timer.get());
+        m_loop = nullptr;
+    }
+    if (m_timer) {
+        CancelWaitableTimer(m_timer.get());
+        m_timer.reset();
+    }
+    m_render = nullptr;
+    m_pending = false;
+    m_armed = false;
+}
+
+void FrameScheduler::RequestFrame() {
+    if (!m_loop) {
+        return;
+    }
+
+    m_pending = true;
+    const uint64_t now = Core::PerfClock::NowMicros();
+
+    // The echo of a keystroke goes out at once; anything else waits for the
+    // refresh period since the last frame
+    uint64_t due = m_lastFrame + RefreshPeriodMicros(now);
+    if (m_echoDue && now - m_lastInput <= kEchoWindowMicros) {
+        m_echoDue = false;
+        due = now;
+    }
+
+    if (!m_armed || due < m_armedDue) {
+        Arm(std::max(due, now), now);
+    }
+}
+
+void FrameScheduler::NoteInput() noexcept {
+    m_lastInput = Core::PerfClock::NowMicros();
+    m_echoDue = true;
+}
+
+void FrameScheduler::NoteFrameRendered() noexcept {
+    m_pending = false;
+    m_lastFrame = Core::PerfClock::NowMicros();
+}
+
+void FrameScheduler::OnTimer() {
+    m_armed = false;
+    if (!m_pending || !m_render) {
+        return;
+    }
+
+    m_pending = false;
+    m_lastFrame = Core::PerfClock::NowMicros();
+
+    // A timer fired a period or more late (a long frame, a busy thread)
+    // means the refreshes in between showed nothing new
+    const uint64_t period = std::max(m_periodMicros, m_minPeriodMicros);
+    if (m_lastFrame > m_armedDue + period) {
+        m_missedFrames.fetch_add((m_lastFrame - m_armedDue) / period, std::memory_order_relaxed);
+    }
+    m_render();
+}
+
+void FrameScheduler::Arm(uint64_t due, uint64_t now) {
+    // Negative = relative, in 100 ns units; 0 fires at once
+    LARGE_INTEGER dueTime{};
+    dueTime.QuadPart = -static_cast<LONGLONG>((due - now) * 10);
+    if (SetWaitableTimer(m_timer.get(), &dueTime, 0, nullptr, nullptr, FALSE)) {
+        m_armed = true;
+        m_armedDue = due;
+    } else if (m_render) {
+        // No timer: render now rather than never
+        m_armed = false;
+        OnTimer();
+    }
+}
+
+void FrameScheduler::SetMaxFrameRate(unsigned fps) noexcept {
+    m_minPeriodMicros = fps > 0 ? 1'000'000ull / fps : 0;
+}
+
+uint64_t FrameScheduler::RefreshPeriodMicros(uint64_t now) {
+    if (now - m_periodCheckedAt >= kPeriodCheckMicros || m_periodCheckedAt == 0) {
+        m_periodCheckedAt = now;
+
+        DWM_TIMING_INFO timing{};
+        timing.cbSize = sizeof(timing);
+        if (SUCCEEDED(DwmGetCompositionTimingInfo(nullptr, &timing)) &&
+            timing.rateRefresh.uiNumerator > 0 && timing.rateRefresh.uiDenominator > 0) {
+            m_periodMicros = 1'000'000ull * timing.rateRefresh.uiDenominator /
+                             timing.rateRefresh.uiNumerator;
+        }
+    }
+    return std::max(m_periodMicros, m_minPeriodMicros);
+}
+
+} // namespace Console3::UI
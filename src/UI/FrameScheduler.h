@@ -0,0 +1,109 @@
+#pragma once
+// Console3 - FrameScheduler.h
+// Paces terminal repaints to the display refresh
+//
+// Output arrives in bursts at any rate. Painting from InvalidateRect either
+// repaints more often than the display can show, or, because WM_PAINT only
+// comes once the queue is empty, not at all while messages keep arriving.
+// The scheduler collects frame requests and renders from a high-resolution
+// waitable timer the message loop waits on: at most one frame per refresh
+// period (read from the DWM composition clock), none while nothing asks for
+// one, and the first frame after a keystroke at once, so its echo shows with
+// the least delay. A window's scheduler waits on its render thread
+// (RenderThread.h); one without waits on the UI thread's message loop.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+#include <wil/resource.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+namespace Console3::UI {
+
+class WaitHandleHost;
+
+/// Coalesces frame requests into at most one frame per display refresh
+class FrameScheduler {
+public:
+    /// Renders a frame (on the thread of the host attached to)
+    using RenderCallback = std::function<void()>;
+
+    /// How long after a keystroke a frame request counts as its echo
+    static constexpr uint64_t kEchoWindowMicros = 100'000;
+
+    FrameScheduler() = default;
+    ~FrameScheduler();
+
+    FrameScheduler(const FrameScheduler&) = delete;
+    FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+    /// Start scheduling frames through a message loop or render thread
+    /// @param loop Host to wait on the frame timer (must outlive Detach())
+    /// @param render Called for each scheduled frame
+    /// @return false if the timer could not be created or registered
+    bool Attach(WaitHandleHost* loop, RenderCallback render);
+
+    /// Stop scheduling frames (pending requests are dropped)
+    void Detach();
+
+    [[nodiscard]] bool IsAttached() const noexcept { return m_loop != nullptr; }
+
+    /// Ask for a frame; requests made before it renders share it
+    void RequestFrame();
+
+    /// Note a keystroke: the next frame requested is rendered without
+    /// waiting for the refresh period
+    void NoteInput() noexcept;
+
+    /// Note a frame rendered outside the scheduler (WM_PAINT); it satisfies
+    /// the pending request
+    void NoteFrameRendered() noexcept;
+
+    /// Render at most this many frames a second, below the display's rate
+    /// (remote sessions); a keystroke's echo still goes out at once
+    /// @param fps Frames a second (0 = the display's refresh rate)
+    void SetMaxFrameRate(unsigned fps) noexcept;
+
+    /// Get the refresh periods frames were due in but rendered after, since
+    /// the scheduler was created (any thread)
+    [[nodiscard]] uint64_t GetMissedFrames() const noexcept {
+        return m_missedFrames.load(std::memory_order_relaxed);
+    }
+
+private:
+    /// Timer handler: render if a frame is still wanted
+    void OnTimer();
+
+    /// Set the timer to fire at a time (PerfClock microseconds)
+    void Arm(uint64_t due, uint64_t now);
+
+    /// Get the display refresh period, re-read from DWM once a second
+    /// (or the frame rate cap's period, if longer)
+    [[nodiscard]] uint64_t RefreshPeriodMicros(uint64_t now);
+
+    WaitHandleHost* m_loop = nullptr;
+    RenderCallback m_render;
+    wil::unique_handle m_timer;
+
+    bool m_pending = false;         ///< A frame was requested and not rendered yet
+    bool m_armed = false;           ///< The timer is set, for m_armedDue
+    uint64_t m_armedDue = 0;
+    uint64_t m_lastFrame = 0;
+    uint64_t m_lastInput = 0;
+    bool m_echoDue = false;         ///< A keystroke has not been answered by a frame yet
+
+    uint64_t m_periodMicros = 16'667;
+    uint64_t m_periodCheckedAt = 0;
+    uint64_t m_minPeriodMicros = 0;     ///< From SetMaxFrameRate (0 = no cap)
+    std::atomic<uint64_t> m_missedFrames{0};
+};
+
+} // namespace Console3::UI
@@ -0,0 +1,870 @@
+// Console3 - GlyphAtlas.cpp
+// Cache of rasterized glyphs in Direct2D texture pages
+
+#include "UI/GlyphAtlas.h"
+#include "UI/BoxDrawing.h"
+#include "UI/GlyphDiskCache.h"
+#include "UI/GlyphRasterizer.h"
+#include "Core/Utf.h"
+#include <dxgi1_2.h>
+#include <wrl/implements.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <string>
+
+namespace Console3::UI {
+
+namespace {
+
+/// What a glyph run's color glyphs are made of
+enum class ColorGlyphs : uint8_t {
+    None,       ///< No color glyph: a mask, tinted when drawn
+    Layers,     ///< COLR layers: outlines, each in a color of its own
+    Images,     ///< Bitmaps (CBDT, sbix) or SVG, which only Direct2D draws
+};
+
+/// Find what a glyph run's color glyphs are made of
+/// @param factory4 Sees bitmap and SVG glyphs (Windows 10 1607+); may be null
+ColorGlyphs ClassifyColor(IDWriteFactory2* factory, IDWriteFactory4* factory4, const DWRITE_GLYPH_RUN& run,
+                          DWRITE_MEASURING_MODE measuringMode) {
+    // Each fails with DWRITE_E_NOCOLOR unless a glyph has color
+    if (factory4) {
+        const DWRITE_GLYPH_IMAGE_FORMATS images =
+            DWRITE_GLYPH_IMAGE_FORMATS_SVG | DWRITE_GLYPH_IMAGE_FORMATS_PNG | DWRITE_GLYPH_IMAGE_FORMATS_JPEG |
+            DWRITE_GLYPH_IMAGE_FORMATS_TIFF | DWRITE_GLYPH_IMAGE_FORMATS_PREMULTIPLIED_B8G8R8A8;
+        const DWRITE_GLYPH_IMAGE_FORMATS wanted = DWRITE_GLYPH_IMAGE_FORMATS_TRUETYPE |
+                                                  DWRITE_GLYPH_IMAGE_FORMATS_CFF |
+                                                  DWRITE_GLYPH_IMAGE_FORMATS_COLR | images;
+        ComPtr<IDWriteColorGlyphRunEnumerator1> runs;
+        if (FAILED(factory4->TranslateColorGlyphRun(D2D1::Point2F(), &run, nullptr, wanted, measuringMode,
+                                                    nullptr, 0, runs.GetAddressOf()))) {
+            return ColorGlyphs::None;
+        }
+        BOOL more = FALSE;
+        while (SUCCEEDED(runs->MoveNext(&more)) && more) {
+            const DWRITE_COLOR_GLYPH_RUN1* layer = nullptr;
+            if (SUCCEEDED(runs->GetCurrentRun(&layer)) && (layer->glyphImageFormat & images) != 0) {
+                return ColorGlyphs::Images;
+            }
+        }
+        return ColorGlyphs::Layers;
+    }
+
+    ComPtr<IDWriteColorGlyphRunEnumerator> layers;
+    return factory && SUCCEEDED(factory->TranslateColorGlyphRun(0.0f, 0.0f, &run, nullptr, measuringMode, nullptr,
+                                                                0, layers.GetAddressOf()))
+               ? ColorGlyphs::Layers
+               : ColorGlyphs::None;
+}
+
+/// Text renderer that draws nothing and records whether a layout has color
+/// glyphs (DirectWrite resolves font fallback before calling it)
+class ColorProbe : public Microsoft::WRL::RuntimeClass<
+                       Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>,
+                       IDWriteTextRenderer> {
+public:
+    ColorProbe(IDWriteFactory2* factory, IDWriteFactory4* factory4) : m_factory(factory), m_factory4(factory4) {}
+
+    [[nodiscard]] bool IsColor() const noexcept { return m_color; }
+
+    STDMETHOD(IsPixelSnappingDisabled)(void*, BOOL* isDisabled) override {
+        *isDisabled = FALSE;
+        return S_OK;
+    }
+
+    STDMETHOD(GetCurrentTransform)(void*, DWRITE_MATRIX* transform) override {
+        *transform = DWRITE_MATRIX{1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f};
+        return S_OK;
+    }
+
+    STDMETHOD(GetPixelsPerDip)(void*, FLOAT* pixelsPerDip) override {
+        *pixelsPerDip = 1.0f;
+        return S_OK;
+    }
+
+    STDMETHOD(DrawGlyphRun)(void*, FLOAT, FLOAT, DWRITE_MEASURING_MODE measuringMode,
+                            const DWRITE_GLYPH_RUN* glyphRun, const DWRITE_GLYPH_RUN_DESCRIPTION*,
+                            IUnknown*) override {
+        if (ClassifyColor(m_factory, m_factory4, *glyphRun, measuringMode) != ColorGlyphs::None) {
+            m_color = true;
+        }
+        return S_OK;
+    }
+
+    STDMETHOD(DrawUnderline)(void*, FLOAT, FLOAT, const DWRITE_UNDERLINE*, IUnknown*) override { return S_OK; }
+    STDMETHOD(DrawStrikethrough)(void*, FLOAT, FLOAT, const DWRITE_STRIKETHROUGH*, IUnknown*) override { return S_OK; }
+    STDMETHOD(DrawInlineObject)(void*, FLOAT, FLOAT, IDWriteInlineObject*, BOOL, BOOL, IUnknown*) override { return S_OK; }
+
+private:
+    IDWriteFactory2* m_factory;
+    IDWriteFactory4* m_factory4;
+    bool m_color = false;
+};
+
+/// A short run of text for IDWriteFontFallback::MapCharacters
+class TextSource : public Microsoft::WRL::RuntimeClass<
+                       Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>,
+                       IDWriteTextAnalysisSource> {
+public:
+    TextSource(const wchar_t* text, UINT32 length, const wchar_t* locale)
+        : m_text(text), m_length(length), m_locale(locale) {}
+
+    STDMETHOD(GetTextAtPosition)(UINT32 position, const WCHAR** text, UINT32* length) override {
+        *text = position < m_length ? m_text + position : nullptr;
+        *length = position < m_length ? m_length - position : 0;
+        return S_OK;
+    }
+
+    STDMETHOD(GetTextBeforePosition)(UINT32 position, const WCHAR** text, UINT32* length) override {
+        *text = position > 0 && position <= m_length ? m_text : nullptr;
+        *length = position <= m_length ? position : 0;
+        return S_OK;
+    }
+
+    STDMETHOD_(DWRITE_READING_DIRECTION, GetParagraphReadingDirection)() override {
+        return DWRITE_READING_DIRECTION_LEFT_TO_RIGHT;
+    }
+
+    STDMETHOD(GetLocaleName)(UINT32 position, UINT32* length, const WCHAR** locale) override {
+        *length = m_length - std::min(position, m_length);
+        *locale = m_locale;
+        return S_OK;
+    }
+
+    STDMETHOD(GetNumberSubstitution)(UINT32 position, UINT32* length,
+                                     IDWriteNumberSubstitution** substitution) override {
+        *length = m_length - std::min(position, m_length);
+        *substitution = nullptr;
+        return S_OK;
+    }
+
+private:
+    const wchar_t* m_text;
+    UINT32 m_length;
+    const wchar_t* m_locale;
+};
+
+} // namespace
+
+void GlyphAtlas::Reset(IDWriteFactory1* dwriteFactory, const std::array<IDWriteTextFormat*, 4>& formats,
+                       float cellWidth, float cellHeight, float baseline) {
+    Clear();
+
+    m_dwriteFactory = dwriteFactory;
+    m_dwriteFactory2.Reset();
+    m_dwriteFactory4.Reset();
+    m_fontFallback.Reset();
+    m_resolved.clear();
+    m_refill.clear();
+    if (dwriteFactory &&
+        SUCCEEDED(dwriteFactory->QueryInterface(IID_PPV_ARGS(m_dwriteFactory2.GetAddressOf())))) {
+        m_dwriteFactory2->GetSystemFontFallback(m_fontFallback.GetAddressOf());
+        (void)m_dwriteFactory2.As(&m_dwriteFactory4);
+    }
+    for (size_t index = 0; index < formats.size(); ++index) {
+        m_formats[index] = formats[index];
+    }
+    m_cellWidth = cellWidth;
+    m_cellHeight = cellHeight;
+    m_baseline = baseline;
+    m_diskSaved = false;
+    QueuePrewarm();
+}
+
+void GlyphAtlas::Clear() {
+    m_entries.clear();
+    m_lru.clear();
+    m_pages.clear();
+    m_white.Reset();
+    m_textureView.Reset();
+    m_texture.Reset();
+    m_generation = NextGeneration();
+    m_diskChecked = false;
+
+    // Glyphs still on the worker threads were for the pages just dropped
+    m_epoch = m_generation;
+}
+
+void GlyphAtlas::QueuePrewarm() {
+    // Popped from the back: ASCII first, then the box-drawing range
+    for (uint32_t codepoint = 0x259F; codepoint >= 0x2500; --codepoint) {
+        m_refill.push_back(Key(codepoint, 1, FontVariant::Regular));
+    }
+    for (uint32_t codepoint = U'~'; codepoint > U' '; --codepoint) {
+        m_refill.push_back(Key(codepoint, 1, FontVariant::Regular));
+    }
+}
+
+void GlyphAtlas::Land() {
+    if (!m_inbox) {
+        return;
+    }
+
+    // One pass a frame, however many finished since the last
+    bool landed = false;
+    for (const RasterizedGlyph& raster : m_inbox->Take()) {
+        // Skip glyphs dropped, evicted or landed since they were queued
+        const auto found = m_entries.find(raster.key);
+        if (raster.epoch != m_epoch || found == m_entries.end() || !found->second.glyph.pending) {
+            continue;
+        }
+
+        Entry& entry = found->second;
+        const Page& page = m_pages[entry.page];
+        const D2D1_RECT_U dest = SlotPixels(page, entry.slot);
+        if (dest.right - dest.left == raster.width && dest.bottom - dest.top == raster.height) {
+            (void)page.bitmap->CopyFromMemory(&dest, raster.pixels.data(), raster.width * 4);
+        }
+        entry.glyph.pending = false;
+        landed = true;
+    }
+
+    // Whoever kept the blank glyph finds it again
+    if (landed) {
+        ++m_landed;
+        m_generation = NextGeneration();
+        SaveToDisk();
+    }
+}
+
+uint64_t GlyphAtlas::NextGeneration() noexcept {
+    static std::atomic<uint64_t> generation{0};
+    return ++generation;
+}
+
+void GlyphAtlas::SetTextureDevices(ID3D11Device* d3dDevice, ID2D1Device* d2dDevice) {
+    Clear();
+    m_d3dDevice.Reset();
+    m_rasterContext.Reset();
+
+    if (d3dDevice && d2dDevice &&
+        SUCCEEDED(d2dDevice->CreateDeviceContext(D2D1_DEVICE_CONTEXT_OPTIONS_NONE,
+                                                 m_rasterContext.GetAddressOf()))) {
+        m_d3dDevice = d3dDevice;
+    }
+}
+
+const AtlasGlyph* GlyphAtlas::Find(ID2D1RenderTarget* device, uint32_t codepoint,
+                                   int width, FontVariant variant) {
+    width = std::clamp(width, 1, 2);
+    if (IsBoxDrawing(codepoint)) {
+        variant = FontVariant::Regular;     // Drawn from the cell, not a font
+    }
+    return Lookup(device, Key(codepoint, width, variant), {&codepoint, 1}, width, variant);
+}
+
+void GlyphAtlas::RememberGlyphs() {
+    m_refill.clear();
+    for (auto it = m_lru.rbegin(); it != m_lru.rend(); ++it) {
+        if ((*it & kSequenceKey) == 0) {
+            m_refill.push_back(*it);
+        }
+    }
+}
+
+bool GlyphAtlas::Refill(ID2D1RenderTarget* device, size_t budget) {
+    for (; budget > 0 && !m_refill.empty(); --budget) {
+        const uint32_t key = m_refill.back();
+        m_refill.pop_back();
+        if (m_entries.contains(key)) {
+            continue;
+        }
+
+        // The key holds all Find() took
+        const uint32_t codepoint = key & ((1u << 21) - 1);
+        const int width = static_cast<int>(key >> 21 & 1) + 1;
+        const auto variant = static_cast<FontVariant>(key >> 22 & 3);
+        (void)Lookup(device, key, {&codepoint, 1}, width, variant);
+    }
+    if (m_refill.empty()) {
+        SaveToDisk();
+    }
+    return !m_refill.empty();
+}
+
+const AtlasGlyph* GlyphAtlas::FindSequence(ID2D1RenderTarget* device, uint32_t sequence,
+                                           std::span<const uint32_t> chars, int width,
+                                           FontVariant variant) {
+    width = std::clamp(width, 1, 2);
+    return Lookup(device, Key(sequence, width, variant) | kSequenceKey, chars, width, variant);
+}
+
+const AtlasGlyph* GlyphAtlas::Lookup(ID2D1RenderTarget* device, uint32_t key, std::span<const uint32_t> chars,
+                                     int width, FontVariant variant) {
+    if (!m_diskChecked && device && m_dwriteFactory) {
+        LoadFromDisk(device);
+    }
+    if (const auto found = m_entries.find(key); found != m_entries.end()) {
+        ++m_hits;
+        Entry& entry = found->second;
+        entry.frame = m_frame;
+        m_lru.splice(m_lru.begin(), m_lru, entry.lru);
+        return &entry.glyph;
+    }
+
+    ++m_misses;
+    if (!device || !m_dwriteFactory) {
+        return nullptr;
+    }
+
+    Entry entry;
+    if (!AllocateSlot(device, width, entry.page, entry.slot)) {
+        return nullptr;
+    }
+    if (!Rasterize(key, chars, variant, entry)) {
+        m_pages[entry.page].freeSlots.push_back(entry.slot);
+        return nullptr;
+    }
+
+    entry.frame = m_frame;
+    m_lru.push_front(key);
+    entry.lru = m_lru.begin();
+    return &m_entries.emplace(key, entry).first->second.glyph;
+}
+
+// ============================================================================
+// Slots
+// ============================================================================
+
+bool GlyphAtlas::AllocateSlot(ID2D1RenderTarget* device, int width, uint16_t& page, uint16_t& slot) {
+    const auto take = [&](size_t index) {
+        page = static_cast<uint16_t>(index);
+        slot = m_pages[index].freeSlots.back();
+        m_pages[index].freeSlots.pop_back();
+        return true;
+    };
+
+    for (size_t index = 0; index < m_pages.size(); ++index) {
+        if (m_pages[index].width == width && !m_pages[index].freeSlots.empty()) {
+            return take(index);
+        }
+    }
+    if (AddPage(device, width)) {
+        return take(m_pages.size() - 1);
+    }
+
+    // Evict the least recently used glyph of the class. Glyphs found this
+    // frame are at the front and may still be waiting in the draw batch.
+    for (auto it = m_lru.rbegin(); it != m_lru.rend(); ++it) {
+        const auto victim = m_entries.find(*it);
+        if (victim->second.frame == m_frame) {
+            break;
+        }
+        if (m_pages[victim->second.page].width != width) {
+            continue;
+        }
+
+        page = victim->second.page;
+        slot = victim->second.slot;
+        m_lru.erase(std::next(it).base());
+        m_entries.erase(victim);
+        m_generation = NextGeneration();
+        return true;
+    }
+    return false;
+}
+
+bool GlyphAtlas::AddPage(ID2D1RenderTarget* device, int width) {
+    if (m_pages.size() >= kMaxPages || m_cellWidth <= 0.0f || m_cellHeight <= 0.0f) {
+        return false;
+    }
+
+    if (!m_white && FAILED(device->CreateSolidColorBrush(D2D1::ColorF(D2D1::ColorF::White),
+                                                         m_white.GetAddressOf()))) {
+        return false;
+    }
+
+    Page page;
+    page.width = width;
+
+    if (m_d3dDevice) {
+        if (!CreateTexturePage(device, page)) {
+            return false;
+        }
+    } else {
+        const D2D1_SIZE_U pixels = D2D1::SizeU(kPagePixels, kPagePixels);
+        const D2D1_PIXEL_FORMAT format =
+            D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED);
+        ComPtr<ID2D1BitmapRenderTarget> target;
+        if (FAILED(device->CreateCompatibleRenderTarget(nullptr, &pixels, &format,
+                                                        D2D1_COMPATIBLE_RENDER_TARGET_OPTIONS_NONE,
+                                                        target.GetAddressOf())) ||
+            FAILED(target->GetBitmap(page.bitmap.GetAddressOf()))) {
+            return false;
+        }
+        page.target = target;
+    }
+
+    // ClearType needs an opaque background; pages are transparent
+    page.target->SetTextAntialiasMode(D2D1_TEXT_ANTIALIAS_MODE_GRAYSCALE);
+
+    // Whole-pixel slots with a pixel between them, so a slot copied to a
+    // whole-pixel position is exact and never picks up its neighbours
+    float dpiX = 96.0f;
+    float dpiY = 96.0f;
+    page.bitmap->GetDpi(&dpiX, &dpiY);
+    const float scaleX = dpiX / 96.0f;
+    const float scaleY = dpiY / 96.0f;
+    page.pitchX = (std::ceil(m_cellWidth * static_cast<float>(width) * scaleX) + 1.0f) / scaleX;
+    page.pitchY = (std::ceil(m_cellHeight * scaleY) + 1.0f) / scaleY;
+
+    const D2D1_SIZE_F size = page.bitmap->GetSize();
+    page.columns = static_cast<int>(size.width / page.pitchX);
+    const int rows = static_cast<int>(size.height / page.pitchY);
+    if (page.columns <= 0 || rows <= 0) {
+        return false;
+    }
+
+    // Handed out from the back: slot 0 first
+    const int slots = std::min(page.columns * rows, 0xFFFF);
+    page.freeSlots.reserve(static_cast<size_t>(slots));
+    for (int index = slots - 1; index >= 0; --index) {
+        page.freeSlots.push_back(static_cast<uint16_t>(index));
+    }
+
+    // A new target's contents are undefined
+    BeginPageDraw(page);
+    page.target->Clear(D2D1::ColorF(0.0f, 0.0f, 0.0f, 0.0f));
+    if (FAILED(page.target->EndDraw())) {
+        return false;
+    }
+
+    m_pages.push_back(std::move(page));
+    return true;
+}
+
+// ============================================================================
+// Disk cache
+// ============================================================================
+
+void GlyphAtlas::LoadFromDisk(ID2D1RenderTarget* device) {
+    m_diskChecked = true;
+    float dpiX = 96.0f;
+    float dpiY = 96.0f;
+    device->GetDpi(&dpiX, &dpiY);
+    m_diskKey = GlyphDiskCache::MakeKey({m_formats[0].Get(), m_formats[1].Get(), m_formats[2].Get(),
+                                         m_formats[3].Get()},
+                                        m_cellWidth, m_cellHeight, m_baseline, dpiX, dpiY);
+    if (!m_pages.empty()) {
+        return;
+    }
+    const std::unique_ptr<GlyphDiskCache> cache = GlyphDiskCache::Load(m_diskKey);
+    if (!cache) {
+        return;
+    }
+
+    // Pages laid out as they were, each copied from the mapping in one go
+    for (const DiskAtlasPage& saved : cache->GetPages()) {
+        if (!AddPage(device, saved.width) || m_pages.back().columns != saved.columns) {
+            m_pages.clear();
+            return;
+        }
+        const D2D1_RECT_U rows = D2D1::RectU(0, 0, kPagePixels, saved.rows);
+        if (saved.rows > 0 &&
+            FAILED(m_pages.back().bitmap->CopyFromMemory(&rows, saved.pixels.data(), kPagePixels * 4))) {
+            m_pages.clear();
+            return;
+        }
+    }
+
+    // The saved glyphs take their slots back, most recently used first
+    std::vector<std::vector<bool>> used(m_pages.size());
+    for (size_t index = 0; index < m_pages.size(); ++index) {
+        used[index].resize(m_pages[index].freeSlots.size());
+    }
+    for (const DiskAtlasGlyph& saved : cache->GetGlyphs()) {
+        const Page& page = m_pages[saved.page];
+        if (saved.slot >= used[saved.page].size() || used[saved.page][saved.slot] ||
+            (saved.key & kSequenceKey) != 0 || m_entries.contains(saved.key) ||
+            SlotPixels(page, saved.slot).bottom > cache->GetPages()[saved.page].rows) {
+            continue;
+        }
+        used[saved.page][saved.slot] = true;
+
+        Entry entry;
+        entry.page = saved.page;
+        entry.slot = saved.slot;
+        entry.glyph.page = page.bitmap.Get();
+        entry.glyph.source = SlotRect(page, saved.slot);
+        entry.glyph.pageIndex = saved.page;
+        entry.glyph.color = saved.color;
+        entry.frame = m_frame;
+        m_lru.push_back(saved.key);
+        entry.lru = std::prev(m_lru.end());
+        m_entries.emplace(saved.key, entry);
+    }
+    for (size_t index = 0; index < m_pages.size(); ++index) {
+        std::vector<uint16_t>& freeSlots = m_pages[index].freeSlots;
+        freeSlots.clear();
+        for (size_t slot = used[index].size(); slot-- > 0;) {
+            if (!used[index][slot]) {
+                freeSlots.push_back(static_cast<uint16_t>(slot));
+            }
+        }
+    }
+    m_diskSaved = true;
+}
+
+void GlyphAtlas::SaveToDisk() {
+    if (m_diskSaved || !m_diskChecked || !m_refill.empty() || m_pages.empty()) {
+        return;
+    }
+    if (std::any_of(m_entries.begin(), m_entries.end(),
+                    [](const auto& item) { return item.second.glyph.pending; })) {
+        return;                         // Saved once the last of them lands
+    }
+    m_diskSaved = true;
+
+    // Sequences are this process's GraphemeTable indices
+    std::vector<DiskAtlasGlyph> glyphs;
+    std::vector<UINT32> rows(m_pages.size(), 0);
+    for (const uint32_t key : m_lru) {
+        const Entry& entry = m_entries.at(key);
+        if ((key & kSequenceKey) == 0) {
+            glyphs.push_back({key, entry.page, entry.slot, entry.glyph.color});
+            rows[entry.page] = std::max(rows[entry.page], SlotPixels(m_pages[entry.page], entry.slot).bottom);
+        }
+    }
+    if (glyphs.empty()) {
+        return;
+    }
+
+    // Read the used rows of each page back through a CPU-readable bitmap
+    std::vector<std::vector<uint8_t>> pixels(m_pages.size());
+    std::vector<DiskAtlasPage> pages(m_pages.size());
+    for (size_t index = 0; index < m_pages.size(); ++index) {
+        const Page& page = m_pages[index];
+        pages[index].width = page.width;
+        pages[index].columns = page.columns;
+        pages[index].rows = std::min<UINT32>(rows[index], kPagePixels);
+        if (pages[index].rows == 0) {
+            continue;
+        }
+
+        ComPtr<ID2D1DeviceContext> context = page.slice ? m_rasterContext : nullptr;
+        if (!context && FAILED(page.target.As(&context))) {
+            return;
+        }
+        const D2D1_BITMAP_PROPERTIES1 props = D2D1::BitmapProperties1(
+            D2D1_BITMAP_OPTIONS_CPU_READ | D2D1_BITMAP_OPTIONS_CANNOT_DRAW,
+            D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED));
+        const D2D1_RECT_U source = D2D1::RectU(0, 0, kPagePixels, pages[index].rows);
+        ComPtr<ID2D1Bitmap1> readback;
+        D2D1_MAPPED_RECT mapped{};
+        if (FAILED(context->CreateBitmap(D2D1::SizeU(kPagePixels, pages[index].rows), nullptr, 0, &props,
+                                         readback.GetAddressOf())) ||
+            FAILED(readback->CopyFromBitmap(nullptr, page.bitmap.Get(), &source)) ||
+            FAILED(readback->Map(D2D1_MAP_OPTIONS_READ, &mapped))) {
+            return;
+        }
+        const size_t rowBytes = size_t{kPagePixels} * 4;
+        pixels[index].resize(rowBytes * pages[index].rows);
+        for (UINT32 row = 0; row < pages[index].rows; ++row) {
+            std::memcpy(pixels[index].data() + row * rowBytes, mapped.bits + size_t{row} * mapped.pitch, rowBytes);
+        }
+        (void)readback->Unmap();
+        pages[index].pixels = pixels[index];
+    }
+    (void)GlyphDiskCache::Save(m_diskKey, pages, glyphs);
+}
+
+// ============================================================================
+// Rasterizing
+// ============================================================================
+
+const GlyphAtlas::ResolvedGlyph* GlyphAtlas::Resolve(uint32_t codepoint, FontVariant variant) {
+    const uint32_t key = Key(codepoint, 1, variant);
+    if (const auto found = m_resolved.find(key); found != m_resolved.end()) {
+        return &found->second;
+    }
+
+    IDWriteTextFormat* format = m_formats[static_cast<size_t>(variant)].Get();
+    if (!format) {
+        format = m_formats[0].Get();
+    }
+    if (!m_fontFallback || !format) {
+        return nullptr;
+    }
+
+    std::wstring family(format->GetFontFamilyNameLength() + 1, L'\0');
+    std::wstring locale(format->GetLocaleNameLength() + 1, L'\0');
+    if (FAILED(format->GetFontFamilyName(family.data(), static_cast<UINT32>(family.size()))) ||
+        FAILED(format->GetLocaleName(locale.data(), static_cast<UINT32>(locale.size())))) {
+        return nullptr;
+    }
+
+    // The format's own font if it has the character, else the system's
+    // choice for the character's script
+    wchar_t text[2] = {};
+    const auto length = static_cast<UINT32>(Core::PutUtf16(codepoint, text));
+    const auto source = Microsoft::WRL::Make<TextSource>(text, length, locale.c_str());
+    ResolvedGlyph resolved;
+    UINT32 mappedLength = 0;
+    ComPtr<IDWriteFont> font;
+    if (!source || FAILED(m_fontFallback->MapCharacters(source.Get(), 0, length, nullptr, family.c_str(),
+                                                        format->GetFontWeight(), format->GetFontStyle(),
+                                                        format->GetFontStretch(), &mappedLength,
+                                                        font.GetAddressOf(), &resolved.scale))) {
+        return nullptr;
+    }
+
+    if (font && SUCCEEDED(font->CreateFontFace(resolved.face.GetAddressOf())) &&
+        SUCCEEDED(resolved.face->GetGlyphIndices(&codepoint, 1, &resolved.index))) {
+        DWRITE_GLYPH_RUN run{};
+        run.fontFace = resolved.face.Get();
+        run.fontEmSize = format->GetFontSize() * resolved.scale;
+        run.glyphCount = 1;
+        run.glyphIndices = &resolved.index;
+        const ColorGlyphs color = ClassifyColor(m_dwriteFactory2.Get(), m_dwriteFactory4.Get(), run,
+                                                DWRITE_MEASURING_MODE_NATURAL);
+        resolved.color = color != ColorGlyphs::None;
+        resolved.layered = color == ColorGlyphs::Layers;
+    } else {
+        resolved.face.Reset();
+    }
+    // Past the cap start over rather than keep a font face per character
+    // ever drawn; the glyphs cached in pages are not affected
+    if (m_resolved.size() >= kMaxResolved) {
+        m_resolved.clear();
+    }
+    return &m_resolved.emplace(key, std::move(resolved)).first->second;
+}
+
+bool GlyphAtlas::Rasterize(uint32_t key, std::span<const uint32_t> chars, FontVariant variant, Entry& entry) {
+    const Page& page = m_pages[entry.page];
+    IDWriteTextFormat* format = m_formats[static_cast<size_t>(variant)].Get();
+    if (!format) {
+        format = m_formats[0].Get();
+    }
+    if (!format || chars.empty()) {
+        return false;
+    }
+
+    const D2D1_RECT_F rect = SlotRect(page, entry.slot);
+
+    // Box drawing and block elements come from the cell geometry
+    if (chars.size() == 1 && IsBoxDrawing(chars[0])) {
+        float dpiX = 96.0f;
+        float dpiY = 96.0f;
+        page.bitmap->GetDpi(&dpiX, &dpiY);
+
+        ID2D1RenderTarget* target = page.target.Get();
+        BeginPageDraw(page);
+        target->SetTransform(D2D1::Matrix3x2F::Identity());
+        target->PushAxisAlignedClip(rect, D2D1_ANTIALIAS_MODE_ALIASED);
+        target->Clear(D2D1::ColorF(0.0f, 0.0f, 0.0f, 0.0f));
+        DrawBoxGlyph(chars[0], target, m_white.Get(), rect, dpiX / 96.0f, dpiY / 96.0f);
+        target->PopAxisAlignedClip();
+        if (FAILED(target->EndDraw())) {
+            return false;
+        }
+
+        entry.glyph.page = page.bitmap.Get();
+        entry.glyph.source = rect;
+        entry.glyph.pageIndex = entry.page;
+        entry.glyph.color = false;
+        return true;
+    }
+
+    // A lone character in a resolved font is one glyph on the baseline
+    // (COLR color glyphs too, composited from their layers)
+    const ResolvedGlyph* resolved = chars.size() == 1 ? Resolve(chars[0], variant) : nullptr;
+    if (resolved && resolved->face && (!resolved->color || resolved->layered) &&
+        Submit(key, *resolved, format->GetFontSize() * resolved->scale, entry)) {
+        return true;
+    }
+
+    if (resolved && resolved->face && !resolved->color) {
+        DWRITE_GLYPH_RUN run{};
+        run.fontFace = resolved->face.Get();
+        run.fontEmSize = format->GetFontSize() * resolved->scale;
+        run.glyphCount = 1;
+        run.glyphIndices = &resolved->index;
+
+        ID2D1RenderTarget* target = page.target.Get();
+        BeginPageDraw(page);
+        target->SetTransform(D2D1::Matrix3x2F::Identity());
+        target->PushAxisAlignedClip(rect, D2D1_ANTIALIAS_MODE_ALIASED);
+        target->Clear(D2D1::ColorF(0.0f, 0.0f, 0.0f, 0.0f));
+        target->DrawGlyphRun(D2D1::Point2F(rect.left, rect.top + m_baseline), &run, m_white.Get());
+        target->PopAxisAlignedClip();
+        if (FAILED(target->EndDraw())) {
+            return false;
+        }
+
+        entry.glyph.page = page.bitmap.Get();
+        entry.glyph.source = rect;
+        entry.glyph.pageIndex = entry.page;
+        entry.glyph.color = false;
+        return true;
+    }
+
+    // Sequences, color glyphs and characters no font has: DirectWrite
+    // shapes them and finds their fonts
+    wchar_t text[2 * 4] = {};
+    const auto length =
+        static_cast<UINT32>(Core::Utf32ToUtf16(chars.first(std::min<size_t>(chars.size(), 4)), text));
+
+    ComPtr<IDWriteTextLayout> layout;
+    if (FAILED(m_dwriteFactory->CreateTextLayout(text, length, format, rect.right - rect.left,
+                                                 rect.bottom - rect.top, layout.GetAddressOf()))) {
+        return false;
+    }
+
+    // Glyphs with color layers keep their colors; the rest become a mask
+    // tinted with the cell's color when drawn
+    bool color = false;
+    if (m_dwriteFactory2) {
+        const auto probe = Microsoft::WRL::Make<ColorProbe>(m_dwriteFactory2.Get(), m_dwriteFactory4.Get());
+        if (probe && SUCCEEDED(layout->Draw(nullptr, probe.Get(), 0.0f, 0.0f))) {
+            color = probe->IsColor();
+        }
+    }
+
+    // On the cell baseline, wherever the layout puts its own
+    float shift = 0.0f;
+    DWRITE_LINE_METRICS line{};
+    UINT32 lines = 0;
+    if (SUCCEEDED(layout->GetLineMetrics(&line, 1, &lines)) && lines == 1) {
+        shift = m_baseline - line.baseline;
+    }
+
+    ID2D1RenderTarget* target = page.target.Get();
+    BeginPageDraw(page);
+    target->SetTransform(D2D1::Matrix3x2F::Identity());
+    target->PushAxisAlignedClip(rect, D2D1_ANTIALIAS_MODE_ALIASED);
+    target->Clear(D2D1::ColorF(0.0f, 0.0f, 0.0f, 0.0f));
+    target->DrawTextLayout(D2D1::Point2F(rect.left, rect.top + shift), layout.Get(), m_white.Get(),
+                           color ? D2D1_DRAW_TEXT_OPTIONS_ENABLE_COLOR_FONT : D2D1_DRAW_TEXT_OPTIONS_NONE);
+    target->PopAxisAlignedClip();
+    if (FAILED(target->EndDraw())) {
+        return false;
+    }
+
+    entry.glyph.page = page.bitmap.Get();
+    entry.glyph.source = rect;
+    entry.glyph.pageIndex = entry.page;
+    entry.glyph.color = color;
+    return true;
+}
+
+bool GlyphAtlas::Submit(uint32_t key, const ResolvedGlyph& resolved, float emSize, Entry& entry) {
+    if (!m_dwriteFactory2) {
+        return false;
+    }
+    if (!m_inbox) {
+        m_inbox = std::make_shared<GlyphInbox>();
+    }
+
+    const Page& page = m_pages[entry.page];
+    float dpiX = 96.0f;
+    float dpiY = 96.0f;
+    page.bitmap->GetDpi(&dpiX, &dpiY);
+    const D2D1_RECT_U pixels = SlotPixels(page, entry.slot);
+
+    GlyphJob job;
+    job.inbox = m_inbox;
+    job.epoch = m_epoch;
+    job.key = key;
+    job.factory = m_dwriteFactory2;
+    job.face = resolved.face;
+    job.index = resolved.index;
+    job.emSize = emSize;
+    job.scaleX = dpiX / 96.0f;
+    job.scaleY = dpiY / 96.0f;
+    job.baseline = m_baseline;
+    job.width = pixels.right - pixels.left;
+    job.height = pixels.bottom - pixels.top;
+    job.color = resolved.color;
+    if (!GlyphRasterizer::Shared().Submit(std::move(job))) {
+        return false;
+    }
+
+    entry.glyph.page = page.bitmap.Get();
+    entry.glyph.source = SlotRect(page, entry.slot);
+    entry.glyph.pageIndex = entry.page;
+    entry.glyph.color = resolved.color;
+    entry.glyph.pending = true;
+    return true;
+}
+
+bool GlyphAtlas::CreateTexturePage(ID2D1RenderTarget* device, Page& page) {
+    if (!m_texture) {
+        D3D11_TEXTURE2D_DESC desc{};
+        desc.Width = kPagePixels;
+        desc.Height = kPagePixels;
+        desc.MipLevels = 1;
+        desc.ArraySize = static_cast<UINT>(kMaxPages);
+        desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+        desc.SampleDesc.Count = 1;
+        desc.Usage = D3D11_USAGE_DEFAULT;
+        desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+        if (FAILED(m_d3dDevice->CreateTexture2D(&desc, nullptr, m_texture.GetAddressOf())) ||
+            FAILED(m_d3dDevice->CreateShaderResourceView(m_texture.Get(), nullptr,
+                                                         m_textureView.GetAddressOf()))) {
+            m_texture.Reset();
+            m_textureView.Reset();
+            return false;
+        }
+    }
+
+    // Page n is slice n
+    ComPtr<IDXGIResource1> resource;
+    ComPtr<IDXGISurface2> surface;
+    if (FAILED(m_texture.As(&resource)) ||
+        FAILED(resource->CreateSubresourceSurface(static_cast<UINT>(m_pages.size()),
+                                                  surface.GetAddressOf()))) {
+        return false;
+    }
+
+    float dpiX = 96.0f;
+    float dpiY = 96.0f;
+    device->GetDpi(&dpiX, &dpiY);
+    const D2D1_BITMAP_PROPERTIES1 props = D2D1::BitmapProperties1(
+        D2D1_BITMAP_OPTIONS_TARGET,
+        D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED), dpiX, dpiY);
+    if (FAILED(m_rasterContext->CreateBitmapFromDxgiSurface(surface.Get(), &props,
+                                                            page.slice.GetAddressOf()))) {
+        return false;
+    }
+
+    // Slots are laid out in the device's DIPs
+    m_rasterContext->SetDpi(dpiX, dpiY);
+    page.bitmap = page.slice;
+    page.target = m_rasterContext;
+    return true;
+}
+
+void GlyphAtlas::BeginPageDraw(const Page& page) {
+    // Texture pages share one device context
+    if (page.slice) {
+        m_rasterContext->SetTarget(page.slice.Get());
+    }
+    page.target->BeginDraw();
+}
+
+D2D1_RECT_F GlyphAtlas::SlotRect(const Page& page, uint16_t slot) const noexcept {
+    const float left = static_cast<float>(slot % page.columns) * page.pitchX;
+    const float top = static_cast<float>(slot / page.columns) * page.pitchY;
+    return D2D1::RectF(left, top, left + m_cellWidth * static_cast<float>(page.width), top + m_cellHeight);
+}
+
+D2D1_RECT_U GlyphAtlas::SlotPixels(const Page& page, uint16_t slot) const noexcept {
+    float dpiX = 96.0f;
+    float dpiY = 96.0f;
+    page.bitmap->GetDpi(&dpiX, &dpiY);
+    const float scaleX = dpiX / 96.0f;
+    const float scaleY = dpiY / 96.0f;
+
+    // Slots start on whole pixels (see AddPage)
+    const D2D1_RECT_F rect = SlotRect(page, slot);
+    const auto left = static_cast<UINT32>(std::lround(rect.left * scaleX));
+    const auto top = static_cast<UINT32>(std::lround(rect.top * scaleY));
+    return D2D1::RectU(left, top, left + static_cast<UINT32>(std::ceil((rect.right - rect.left) * scaleX)),
+                       top + static_cast<UINT32>(std::ceil((rect.bottom - rect.top) * scaleY)));
+}
+
+} // namespace Console3::UI
@@ -0,0 +1,286 @@
+#pragma once
+// Console3 - GlyphAtlas.h
+// Cache of rasterized glyphs in Direct2D texture pages
+//
+// Laying out and rasterizing a character through DrawTextW costs far more
+// than the quad it ends up as. The atlas rasterizes each (character, width,
+// font variant) once into a slot of a bitmap page and hands back the slot,
+// so a cell is drawn as one textured quad: tinted through FillOpacityMask
+// for ordinary glyphs, copied as is for color (emoji) glyphs. Pages hold
+// slots of one width class each; when they are full the least recently
+// used glyph gives up its slot, never one drawn in the current frame.
+//
+// For the cell grid shader the pages can instead be the slices of one
+// Direct3D texture array, rasterized through a Direct2D device context of
+// their own, so the shader samples the same slots the Direct2D path draws.
+//
+// Which font draws a character is resolved once per (character, font
+// variant) with the system font fallback and kept with its glyph index,
+// across evictions and device loss, so rasterizing it again is a single
+// glyph run. Combining sequences (emoji ZWJ and modifier sequences among
+// them) and bitmap or SVG color glyphs (CBDT, sbix, SVG fonts) are laid out
+// by DirectWrite, which shapes them, and drawn with their colors into the
+// page once; COLR color glyphs go to the worker threads like the rest.
+// Either way a color glyph is a BGRA slot drawn as one quad afterwards,
+// never translated into color layers again while it stays cached. Box-drawing and block characters never
+// reach a font: they are drawn from the cell size (see BoxDrawing.h), once
+// for all variants.
+//
+// Lone glyphs of a resolved font are rasterized on worker threads
+// (GlyphRasterizer.h): Find() hands back the glyph marked pending, its slot
+// reserved, and Land() copies the coverage in once it is ready. A new
+// atlas is seeded with printable ASCII and the box-drawing range to refill,
+// so the first screen finds most of its glyphs already there.
+//
+// Once those are in, the pages are saved to disk (GlyphDiskCache.h); an
+// atlas of the same font, size and DPI in a later launch, or after device
+// loss, copies them back before its first lookup instead of rasterizing.
+
+#include <Windows.h>
+#include <d2d1_1.h>
+#include <d3d11.h>
+#include <dwrite_3.h>
+#include <wrl/client.h>
+
+#include <array>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using Microsoft::WRL::ComPtr;
+
+namespace Console3::UI {
+
+/// Font face a cell is drawn in (index into the renderer's text formats)
+enum class FontVariant : uint8_t {
+    Regular = 0,
+    Bold = 1,
+    Italic = 2,
+    BoldItalic = 3,
+};
+
+/// A rasterized glyph: the page it lives in and its slot there
+struct AtlasGlyph {
+    ID2D1Bitmap* page = nullptr;
+    D2D1_RECT_F source{};       ///< Slot in the page (DIPs)
+    uint16_t pageIndex = 0;     ///< Page (texture array slice in texture mode)
+    bool color = false;         ///< Color glyph: draw as is, not tinted
+    bool pending = false;       ///< Still rasterizing: draw the cell blank for now
+};
+
+class GlyphInbox;
+
+/// Glyph cache in texture pages with LRU eviction
+class GlyphAtlas {
+public:
+    static constexpr UINT kPagePixels = 1024;   ///< Page edge in pixels
+    static constexpr size_t kMaxPages = 8;
+    static constexpr size_t kMaxResolved = 16384;  ///< Characters' fonts kept (see Resolve)
+
+    /// Start over with a font (drops every glyph, page and resolved font)
+    /// @param formats Text format for each FontVariant
+    /// @param cellWidth Cell width (DIPs)
+    /// @param cellHeight Cell height (DIPs)
+    /// @param baseline Baseline from the cell top (DIPs)
+    void Reset(IDWriteFactory1* dwriteFactory, const std::array<IDWriteTextFormat*, 4>& formats,
+               float cellWidth, float cellHeight, float baseline);
+
+    /// Drop every glyph and page (device lost)
+    void Clear();
+
+    /// Keep pages in one texture array (slice = page index) shaders can
+    /// sample, rasterized through a device context of d2dDevice; null
+    /// devices go back to bitmap render targets. Drops every glyph.
+    void SetTextureDevices(ID3D11Device* d3dDevice, ID2D1Device* d2dDevice);
+
+    /// Get the page texture array (texture mode, once a page exists)
+    [[nodiscard]] ID3D11ShaderResourceView* GetTextureView() const noexcept { return m_textureView.Get(); }
+
+    /// Get a count that changes whenever glyphs already handed out move or
+    /// go away; whoever keeps slots across frames must find them again.
+    /// Values are unique across atlases, so swapping in another atlas
+    /// changes it too.
+    [[nodiscard]] uint64_t GetGeneration() const noexcept { return m_generation; }
+
+    /// Get the video memory the pages hold (in texture mode, the whole
+    /// array, allocated with the first page)
+    [[nodiscard]] size_t GetBytes() const noexcept {
+        constexpr size_t kPageBytes = size_t{kPagePixels} * kPagePixels * 4;
+        return (m_texture ? kMaxPages : m_pages.size()) * kPageBytes;
+    }
+
+    /// Mark the start of a frame; glyphs found from here on are not evicted
+    /// until the next call
+    void NextFrame() noexcept { ++m_frame; }
+
+    /// Copy the glyphs the worker threads finished into their slots (not
+    /// while drawing into the pages). Landing any changes the generation.
+    void Land();
+
+    /// Get a count that changes whenever pending glyphs land
+    [[nodiscard]] uint64_t GetLandedCount() const noexcept { return m_landed; }
+
+    /// Find a glyph, rasterizing it on first use
+    /// @param device Target the pages are made compatible with
+    /// @param codepoint UTF-32 codepoint
+    /// @param width Cells the glyph covers (1 or 2)
+    /// @return The glyph, valid until the next Find(), or nullptr if it
+    /// could not be cached (draw it directly instead); it may be pending
+    [[nodiscard]] const AtlasGlyph* Find(ID2D1RenderTarget* device, uint32_t codepoint,
+                                         int width, FontVariant variant);
+
+    /// Remember the glyphs cached now, most recently used first, so Refill()
+    /// can rasterize them again after Clear() (device lost). Combining
+    /// sequences are not remembered; their characters live in the buffer.
+    void RememberGlyphs();
+
+    /// Rasterize remembered glyphs again (kept until Reset)
+    /// @param budget Most glyphs to rasterize
+    /// @return true if remembered glyphs remain
+    bool Refill(ID2D1RenderTarget* device, size_t budget);
+
+    [[nodiscard]] bool HasRefill() const noexcept { return !m_refill.empty(); }
+
+    /// Take the glyphs another atlas of the same font remembered, to refill
+    /// this one with (an atlas replacing a shared one after device loss)
+    void AdoptRefill(const GlyphAtlas& other) { m_refill = other.m_refill; }
+
+    /// Get and reset the lookups that found a cached glyph and those that
+    /// had to rasterize one (or could not cache it)
+    void TakeLookupCounts(uint32_t& hits, uint32_t& misses) noexcept {
+        hits = std::exchange(m_hits, 0);
+        misses = std::exchange(m_misses, 0);
+    }
+
+    /// Find a base character with combining characters, as Find()
+    /// @param sequence Identifies the sequence (its GraphemeTable index)
+    /// @param chars Base character, then the combining characters
+    [[nodiscard]] const AtlasGlyph* FindSequence(ID2D1RenderTarget* device, uint32_t sequence,
+                                                 std::span<const uint32_t> chars, int width,
+                                                 FontVariant variant);
+
+private:
+    struct Page {
+        ComPtr<ID2D1RenderTarget> target;
+        ComPtr<ID2D1Bitmap> bitmap;
+        ComPtr<ID2D1Bitmap1> slice;     ///< Texture mode: target bitmap on the slice
+        int width = 1;                  ///< Cells per slot
+        int columns = 0;
+        float pitchX = 0.0f;            ///< Slot pitch (DIPs)
+        float pitchY = 0.0f;
+        std::vector<uint16_t> freeSlots;
+    };
+
+    struct Entry {
+        AtlasGlyph glyph;
+        uint16_t page = 0;
+        uint16_t slot = 0;
+        uint64_t frame = 0;             ///< Last frame it was found in
+        std::list<uint32_t>::iterator lru;
+    };
+
+    /// Font and glyph a character resolved to
+    struct ResolvedGlyph {
+        ComPtr<IDWriteFontFace> face;   ///< Null if no font has it (drawn by layout)
+        float scale = 1.0f;             ///< Fallback font size relative to the format's
+        UINT16 index = 0;
+        bool color = false;             ///< Color glyph (drawn by layout unless layered)
+        bool layered = false;           ///< Color from COLR layers alone (see GlyphRasterizer)
+    };
+
+    /// Keys of combining sequences (key bits 0-20 hold the sequence)
+    static constexpr uint32_t kSequenceKey = 1u << 24;
+
+    [[nodiscard]] static uint32_t Key(uint32_t codepoint, int width, FontVariant variant) noexcept {
+        return codepoint | (static_cast<uint32_t>(width - 1) << 21) |
+               (static_cast<uint32_t>(variant) << 22);
+    }
+
+    /// Find or add the glyph for a key
+    const AtlasGlyph* Lookup(ID2D1RenderTarget* device, uint32_t key, std::span<const uint32_t> chars,
+                             int width, FontVariant variant);
+
+    /// Resolve the font and glyph for a character (cached)
+    /// @return nullptr if there is no fallback to consult
+    const ResolvedGlyph* Resolve(uint32_t codepoint, FontVariant variant);
+
+    /// Get a free slot for a width class, adding a page or evicting a glyph
+    /// @return false if every slot of the class is in use this frame
+    bool AllocateSlot(ID2D1RenderTarget* device, int width, uint16_t& page, uint16_t& slot);
+
+    /// Add a page of slots for a width class
+    bool AddPage(ID2D1RenderTarget* device, int width);
+
+    /// Create a page's target on the next texture array slice
+    bool CreateTexturePage(ID2D1RenderTarget* device, Page& page);
+
+    /// Begin drawing into a page
+    void BeginPageDraw(const Page& page);
+
+    /// Rasterize a glyph into its slot, or queue it on the worker threads
+    bool Rasterize(uint32_t key, std::span<const uint32_t> chars, FontVariant variant, Entry& entry);
+
+    /// Queue a resolved glyph on the worker threads (see GlyphRasterizer)
+    /// @return false if it has to be rasterized here
+    bool Submit(uint32_t key, const ResolvedGlyph& resolved, float emSize, Entry& entry);
+
+    /// Seed the refill list with the glyphs nearly every screen shows
+    void QueuePrewarm();
+
+    /// Take the pages saved for this atlas's key, if any (no pages yet)
+    void LoadFromDisk(ID2D1RenderTarget* device);
+
+    /// Save the pages once the prewarm glyphs are all in (once per Reset)
+    void SaveToDisk();
+
+    [[nodiscard]] D2D1_RECT_F SlotRect(const Page& page, uint16_t slot) const noexcept;
+
+    /// Get a slot in device pixels
+    [[nodiscard]] D2D1_RECT_U SlotPixels(const Page& page, uint16_t slot) const noexcept;
+
+    /// Take a generation no atlas has had
+    [[nodiscard]] static uint64_t NextGeneration() noexcept;
+
+    IDWriteFactory1* m_dwriteFactory = nullptr;
+    ComPtr<IDWriteFactory2> m_dwriteFactory2;   ///< Color glyph detection (Windows 8.1+)
+    ComPtr<IDWriteFactory4> m_dwriteFactory4;   ///< Bitmap and SVG color glyphs (Windows 10 1607+)
+    std::array<ComPtr<IDWriteTextFormat>, 4> m_formats;
+    float m_cellWidth = 0.0f;
+    float m_cellHeight = 0.0f;
+    float m_baseline = 0.0f;
+
+    // Font fallback results by Key(codepoint, 1, variant); kept until Reset
+    // or kMaxResolved
+    ComPtr<IDWriteFontFallback> m_fontFallback;
+    std::unordered_map<uint32_t, ResolvedGlyph> m_resolved;
+
+    std::vector<Page> m_pages;
+    ComPtr<ID2D1SolidColorBrush> m_white;
+    std::unordered_map<uint32_t, Entry> m_entries;
+    std::list<uint32_t> m_lru;                  ///< Keys, most recently used first
+    std::vector<uint32_t> m_refill;             ///< Keys to rasterize again, next last
+    uint64_t m_frame = 0;
+    uint64_t m_generation = 0;
+    uint64_t m_epoch = 0;                       ///< Generation of the last Clear
+    uint64_t m_landed = 0;
+    std::shared_ptr<GlyphInbox> m_inbox;        ///< Glyphs rasterized on the worker threads
+    uint32_t m_hits = 0;
+    uint32_t m_misses = 0;
+
+    // Disk cache (see GlyphDiskCache)
+    uint64_t m_diskKey = 0;                     ///< Set by LoadFromDisk
+    bool m_diskChecked = false;                 ///< LoadFromDisk ran since the last Clear
+    bool m_diskSaved = false;                   ///< Saved (or loaded) since the last Reset
+
+    // Texture mode
+    ComPtr<ID3D11Device> m_d3dDevice;
+    ComPtr<ID2D1DeviceContext> m_rasterContext;
+    ComPtr<ID3D11Texture2D> m_texture;
+    ComPtr<ID3D11ShaderResourceView> m_textureView;
+};
+
+} // namespace Console3::UI
@@ -0,0 +1,283 @@
+// Console3 - GlyphDiskCache.cpp
+// Glyph atlas pages kept on disk between launches
+
+#include "UI/GlyphDiskCache.h"
+#include "Core/MappedFile.h"
+#include "UI/FontCatalog.h"
+#include "UI/GlyphAtlas.h"
+#include <ShlObj.h>
+#include <wrl/client.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+using Microsoft::WRL::ComPtr;
+
+namespace Console3::UI {
+
+namespace {
+
+constexpr char kMagic[4] = {'C', '3', 'G', 'A'};
+constexpr uint32_t kVersion = 1;
+constexpr wchar_t kExtension[] = L".c3ga";
+
+// Pages are drawn with grayscale antialiasing (see GlyphAtlas::AddPage)
+constexpr uint32_t kAntialiasMode = D2D1_TEXT_ANTIALIAS_MODE_GRAYSCALE;
+
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t pageCount;
+    uint32_t glyphCount;
+};
+
+struct PageRecord {
+    uint32_t width;
+    uint32_t columns;
+    uint32_t rows;
+    uint32_t reserved;
+    uint64_t pixelOffset;
+};
+
+struct GlyphRecord {
+    uint32_t key;
+    uint16_t page;
+    uint16_t slot;
+    uint32_t flags;                     ///< 1: color
+};
+
+constexpr size_t kRowBytes = size_t{GlyphAtlas::kPagePixels} * 4;
+
+/// FNV-1a, continued over more bytes
+void Hash(uint64_t& hash, const void* data, size_t size) noexcept {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    for (size_t index = 0; index < size; ++index) {
+        hash = (hash ^ bytes[index]) * 0x100000001B3ull;
+    }
+}
+
+template <typename T> void HashValue(uint64_t& hash, const T& value) noexcept {
+    Hash(hash, &value, sizeof(value));
+}
+
+/// Hash what identifies a format's font: its files' paths and last write
+/// times, and the size and style it is drawn at
+void HashFont(uint64_t& hash, IDWriteTextFormat* format) {
+    if (!format) {
+        HashValue(hash, uint32_t{0});
+        return;
+    }
+    HashValue(hash, format->GetFontSize());
+    HashValue(hash, format->GetFontWeight());
+    HashValue(hash, format->GetFontStyle());
+    HashValue(hash, format->GetFontStretch());
+
+    std::wstring family(format->GetFontFamilyNameLength() + 1, L'\0');
+    ComPtr<IDWriteFontCollection> collection;
+    ComPtr<IDWriteFontFamily> fontFamily;
+    ComPtr<IDWriteFont> font;
+    ComPtr<IDWriteFontFace> face;
+    UINT32 index = 0;
+    BOOL exists = FALSE;
+    UINT32 fileCount = 0;
+    if (FAILED(format->GetFontFamilyName(family.data(), static_cast<UINT32>(family.size()))) ||
+        FAILED(format->GetFontCollection(collection.GetAddressOf())) || !collection ||
+        FAILED(collection->FindFamilyName(family.c_str(), &index, &exists)) || !exists ||
+        FAILED(collection->GetFontFamily(index, fontFamily.GetAddressOf())) ||
+        FAILED(fontFamily->GetFirstMatchingFont(format->GetFontWeight(), format->GetFontStretch(),
+                                                format->GetFontStyle(), font.GetAddressOf())) ||
+        FAILED(font->CreateFontFace(face.GetAddressOf())) || FAILED(face->GetFiles(&fileCount, nullptr))) {
+        Hash(hash, family.data(), family.size() * sizeof(wchar_t));
+        return;
+    }
+    HashValue(hash, face->GetIndex());
+    HashValue(hash, face->GetSimulations());
+
+    std::vector<IDWriteFontFile*> raw(fileCount, nullptr);
+    if (FAILED(face->GetFiles(&fileCount, raw.data()))) {
+        return;
+    }
+    std::vector<ComPtr<IDWriteFontFile>> files(raw.size());
+    for (size_t i = 0; i < raw.size(); ++i) {
+        files[i].Attach(raw[i]);
+    }
+    for (const ComPtr<IDWriteFontFile>& file : files) {
+        if (!file) {
+            continue;
+        }
+        const void* referenceKey = nullptr;
+        UINT32 keySize = 0;
+        ComPtr<IDWriteFontFileLoader> loader;
+        ComPtr<IDWriteLocalFontFileLoader> local;
+        if (FAILED(file->GetReferenceKey(&referenceKey, &keySize)) ||
+            FAILED(file->GetLoader(loader.GetAddressOf())) || FAILED(loader.As(&local))) {
+            continue;
+        }
+        UINT32 pathLength = 0;
+        FILETIME writeTime{};
+        if (SUCCEEDED(local->GetFilePathLengthFromKey(referenceKey, keySize, &pathLength))) {
+            std::wstring path(pathLength + 1, L'\0');
+            if (SUCCEEDED(local->GetFilePathFromKey(referenceKey, keySize, path.data(), pathLength + 1))) {
+                Hash(hash, path.data(), pathLength * sizeof(wchar_t));
+            }
+        }
+        if (SUCCEEDED(local->GetLastWriteTimeFromKey(referenceKey, keySize, &writeTime))) {
+            HashValue(hash, writeTime);
+        }
+    }
+}
+
+/// Get a key's file
+std::filesystem::path FilePath(uint64_t key) {
+    wchar_t name[32];
+    swprintf_s(name, L"%016llx%s", static_cast<unsigned long long>(key), kExtension);
+    return GlyphDiskCache::GetDirectory() / name;
+}
+
+/// Delete all but the newest kMaxFiles files
+void Prune(const std::filesystem::path& directory) {
+    std::error_code error;
+    std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> files;
+    for (const auto& item : std::filesystem::directory_iterator(directory, error)) {
+        if (item.path().extension() == kExtension) {
+            files.emplace_back(item.last_write_time(error), item.path());
+        }
+    }
+    if (files.size() <= GlyphDiskCache::kMaxFiles) {
+        return;
+    }
+    std::sort(files.begin(), files.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+    for (size_t index = GlyphDiskCache::kMaxFiles; index < files.size(); ++index) {
+        std::filesystem::remove(files[index].second, error);
+    }
+}
+
+} // namespace
+
+uint64_t GlyphDiskCache::MakeKey(const std::array<IDWriteTextFormat*, 4>& formats, float cellWidth,
+                                 float cellHeight, float baseline, float dpiX, float dpiY) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    HashValue(hash, kVersion);
+    HashValue(hash, FontCatalog::StampFonts());
+    for (IDWriteTextFormat* format : formats) {
+        HashFont(hash, format);
+    }
+    HashValue(hash, cellWidth);
+    HashValue(hash, cellHeight);
+    HashValue(hash, baseline);
+    HashValue(hash, dpiX);
+    HashValue(hash, dpiY);
+    HashValue(hash, kAntialiasMode);
+    return hash;
+}
+
+std::unique_ptr<GlyphDiskCache> GlyphDiskCache::Load(uint64_t key) {
+    auto cache = std::make_unique<GlyphDiskCache>();
+    cache->m_file = Core::MappedFile::Open(FilePath(key));
+    if (!cache->m_file) {
+        return nullptr;
+    }
+
+    const std::span<const char> bytes = cache->m_file->GetBytes();
+    FileHeader header{};
+    if (bytes.size() < sizeof(header)) {
+        return nullptr;
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    const size_t recordsEnd = sizeof(header) + size_t{header.pageCount} * sizeof(PageRecord) +
+                              size_t{header.glyphCount} * sizeof(GlyphRecord);
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion ||
+        header.key != key || header.pageCount > GlyphAtlas::kMaxPages || recordsEnd > bytes.size()) {
+        return nullptr;
+    }
+
+    const char* cursor = bytes.data() + sizeof(header);
+    for (uint32_t index = 0; index < header.pageCount; ++index, cursor += sizeof(PageRecord)) {
+        PageRecord record{};
+        std::memcpy(&record, cursor, sizeof(record));
+        const size_t size = size_t{record.rows} * kRowBytes;
+        if (record.rows > GlyphAtlas::kPagePixels || record.pixelOffset < recordsEnd ||
+            record.pixelOffset > bytes.size() || size > bytes.size() - record.pixelOffset) {
+            return nullptr;
+        }
+        DiskAtlasPage page;
+        page.width = static_cast<int>(record.width);
+        page.columns = static_cast<int>(record.columns);
+        page.rows = record.rows;
+        page.pixels = {reinterpret_cast<const uint8_t*>(bytes.data() + record.pixelOffset), size};
+        cache->m_pages.push_back(page);
+    }
+    cache->m_glyphs.reserve(header.glyphCount);
+    for (uint32_t index = 0; index < header.glyphCount; ++index, cursor += sizeof(GlyphRecord)) {
+        GlyphRecord record{};
+        std::memcpy(&record, cursor, sizeof(record));
+        if (record.page >= header.pageCount) {
+            return nullptr;
+        }
+        cache->m_glyphs.push_back({record.key, record.page, record.slot, (record.flags & 1) != 0});
+    }
+    return cache;
+}
+
+bool GlyphDiskCache::Save(uint64_t key, std::span<const DiskAtlasPage> pages,
+                          std::span<const DiskAtlasGlyph> glyphs) {
+    FileHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.key = key;
+    header.pageCount = static_cast<uint32_t>(pages.size());
+    header.glyphCount = static_cast<uint32_t>(glyphs.size());
+
+    // Pixels start 16-byte aligned, after the records
+    uint64_t offset = sizeof(header) + pages.size() * sizeof(PageRecord) + glyphs.size() * sizeof(GlyphRecord);
+    const uint64_t padding = (16 - offset % 16) % 16;
+    offset += padding;
+
+    const std::filesystem::path path = FilePath(key);
+    std::filesystem::path temp = path;
+    temp += L".tmp";
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const DiskAtlasPage& page : pages) {
+            const PageRecord record{static_cast<uint32_t>(page.width), static_cast<uint32_t>(page.columns),
+                                    page.rows, 0, offset};
+            file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+            offset += page.pixels.size();
+        }
+        for (const DiskAtlasGlyph& glyph : glyphs) {
+            const GlyphRecord record{glyph.key, glyph.page, glyph.slot, glyph.color ? 1u : 0u};
+            file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        }
+        const char zeros[16] = {};
+        file.write(zeros, static_cast<std::streamsize>(padding));
+        for (const DiskAtlasPage& page : pages) {
+            file.write(reinterpret_cast<const char*>(page.pixels.data()),
+                       static_cast<std::streamsize>(page.pixels.size()));
+        }
+        if (!file) {
+            return false;
+        }
+    }
+    if (!MoveFileExW(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        return false;
+    }
+    Prune(path.parent_path());
+    return true;
+}
+
+std::filesystem::path GlyphDiskCache::GetDirectory() {
+    wchar_t* localAppData = nullptr;
+    if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, nullptr, &localAppData))) {
+        std::filesystem::path path = localAppData;
+        CoTaskMemFree(localAppData);
+        return path / L"Console3" / L"glyphs";
+    }
+    return L"glyphs";
+}
+
+} // namespace Console3::UI
@@ -0,0 +1,104 @@
+#pragma once
+// Console3 - GlyphDiskCache.h
+// Glyph atlas pages kept on disk between launches
+//
+// Each launch used to rasterize the same glyphs for the same font again:
+// printable ASCII, the box-drawing range and whatever the prompt draws
+// (Powerline symbols), first through the worker threads, the first frame
+// drawing those cells blank until they landed. Once an atlas has its
+// prewarm glyphs (GlyphAtlas::Land, nothing pending), the used part of each
+// page is read back and written to %LOCALAPPDATA%\Console3\glyphs, with the
+// index of which key sits in which slot. The next atlas for the same key
+// maps the file and copies each page straight from the mapping into a page
+// of the same layout (GlyphAtlas::LoadFromDisk), before its first glyph is
+// looked up: the first frame draws every cached glyph without rasterizing.
+//
+// The key (MakeKey) covers what the pixels depend on: the files, size and
+// style of each variant's font, the cell size and baseline, the DPI and
+// the antialias mode, and the last write times of the Fonts registry keys
+// (FontCatalog::StampFonts), since glyphs from fallback fonts are cached
+// too. Font files are identified by path and last write time rather than
+// hashed whole, which for a CJK font would cost more than rasterizing.
+// Combining sequences are not cached: their keys are indices into this
+// process's GraphemeTable. kVersion in GlyphDiskCache.cpp is bumped when
+// rasterizing changes (BoxDrawing.cpp included).
+//
+// File layout (little-endian, fixed width so the pixels can be used in
+// place):
+//
+//   FileHeader, PageRecord[pageCount], GlyphRecord[glyphCount], pixels
+//
+// Each page's pixels are rows * GlyphAtlas::kPagePixels premultiplied BGRA
+// pixels at its pixelOffset. Files are written to a temporary name and
+// renamed into place; only the kMaxFiles most recently written are kept.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+#include <dwrite_2.h>
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace Console3::Core {
+class MappedFile;
+}
+
+namespace Console3::UI {
+
+/// A page as saved: its width class and the pixel rows its slots use
+struct DiskAtlasPage {
+    int width = 1;                      ///< Cells per slot
+    int columns = 0;                    ///< Slots per row, to check the layout matches
+    UINT32 rows = 0;                    ///< Pixel rows stored
+    std::span<const uint8_t> pixels;    ///< rows * kPagePixels BGRA pixels
+};
+
+/// A glyph as saved: its atlas key and slot
+struct DiskAtlasGlyph {
+    uint32_t key = 0;
+    uint16_t page = 0;
+    uint16_t slot = 0;
+    bool color = false;
+};
+
+/// A cache file, mapped (see file comment)
+class GlyphDiskCache {
+public:
+    static constexpr size_t kMaxFiles = 16;
+
+    /// Get the key of an atlas's contents (see file comment)
+    /// @param formats Text format for each FontVariant
+    [[nodiscard]] static uint64_t MakeKey(const std::array<IDWriteTextFormat*, 4>& formats, float cellWidth,
+                                          float cellHeight, float baseline, float dpiX, float dpiY);
+
+    /// Map the file saved for a key
+    /// @return The file, or nullptr if there is none or it is damaged
+    [[nodiscard]] static std::unique_ptr<GlyphDiskCache> Load(uint64_t key);
+
+    /// Write the file for a key, replacing any
+    /// @return true if it was written
+    static bool Save(uint64_t key, std::span<const DiskAtlasPage> pages, std::span<const DiskAtlasGlyph> glyphs);
+
+    /// Get the directory the files are kept in
+    [[nodiscard]] static std::filesystem::path GetDirectory();
+
+    [[nodiscard]] const std::vector<DiskAtlasPage>& GetPages() const noexcept { return m_pages; }
+    [[nodiscard]] const std::vector<DiskAtlasGlyph>& GetGlyphs() const noexcept { return m_glyphs; }
+
+private:
+    std::shared_ptr<const Core::MappedFile> m_file;
+    std::vector<DiskAtlasPage> m_pages;     ///< Pixels point into m_file
+    std::vector<DiskAtlasGlyph> m_glyphs;
+};
+
+} // namespace Console3::UI
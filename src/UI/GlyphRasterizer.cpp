@@ -0,0 +1,203 @@
+// Console3 - GlyphRasterizer.cpp
+// Worker threads rasterizing glyphs for the glyph atlases
+
+#include "UI/GlyphRasterizer.h"
+#include <algorithm>
+#include <cmath>
+#include <system_error>
+
+namespace Console3::UI {
+
+namespace {
+
+/// Grayscale coverage of a glyph run in device pixels
+class Coverage {
+public:
+    /// Rasterize a run (its baseline origin in DIPs)
+    /// @return false if it covers nothing
+    bool Rasterize(IDWriteFactory2* factory, const DWRITE_GLYPH_RUN& run, const DWRITE_MATRIX& transform,
+                   float originX, float originY) {
+        ComPtr<IDWriteGlyphRunAnalysis> analysis;
+        if (FAILED(factory->CreateGlyphRunAnalysis(&run, &transform, DWRITE_RENDERING_MODE_NATURAL_SYMMETRIC,
+                                                   DWRITE_MEASURING_MODE_NATURAL, DWRITE_GRID_FIT_MODE_DEFAULT,
+                                                   DWRITE_TEXT_ANTIALIAS_MODE_GRAYSCALE, originX, originY,
+                                                   analysis.GetAddressOf())) ||
+            FAILED(analysis->GetAlphaTextureBounds(DWRITE_TEXTURE_ALIASED_1x1, &m_bounds)) ||
+            m_bounds.right <= m_bounds.left || m_bounds.bottom <= m_bounds.top) {
+            return false;
+        }
+        m_alpha.resize(size_t(m_bounds.right - m_bounds.left) * size_t(m_bounds.bottom - m_bounds.top));
+        return SUCCEEDED(analysis->CreateAlphaTexture(DWRITE_TEXTURE_ALIASED_1x1, &m_bounds, m_alpha.data(),
+                                                      static_cast<UINT32>(m_alpha.size())));
+    }
+
+    /// Draw the coverage in a color over a glyph's premultiplied BGRA
+    /// pixels, clipped to the slot as Direct2D clips it
+    void Composite(RasterizedGlyph& glyph, const DWRITE_COLOR_F& color) const {
+        const auto boundsWidth = static_cast<size_t>(m_bounds.right - m_bounds.left);
+        const float channels[4] = {color.b * color.a, color.g * color.a, color.r * color.a, color.a};
+        const LONG left = std::max(m_bounds.left, 0L);
+        const LONG top = std::max(m_bounds.top, 0L);
+        const LONG right = std::min(m_bounds.right, static_cast<LONG>(glyph.width));
+        const LONG bottom = std::min(m_bounds.bottom, static_cast<LONG>(glyph.height));
+        for (LONG y = top; y < bottom; ++y) {
+            const BYTE* source = m_alpha.data() + size_t(y - m_bounds.top) * boundsWidth;
+            uint8_t* dest = glyph.pixels.data() + (size_t(y) * glyph.width) * 4;
+            for (LONG x = left; x < right; ++x) {
+                const float cover = static_cast<float>(source[x - m_bounds.left]) / 255.0f;
+                uint8_t* pixel = dest + size_t(x) * 4;
+                const float keep = 1.0f - cover * color.a;
+                for (int channel = 0; channel < 4; ++channel) {
+                    pixel[channel] = static_cast<uint8_t>(
+                        std::lround(channels[channel] * cover * 255.0f + static_cast<float>(pixel[channel]) * keep));
+                }
+            }
+        }
+    }
+
+private:
+    RECT m_bounds{};
+    std::vector<BYTE> m_alpha;
+};
+
+} // namespace
+
+void GlyphInbox::Put(RasterizedGlyph&& glyph) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_glyphs.push_back(std::move(glyph));
+}
+
+std::vector<RasterizedGlyph> GlyphInbox::Take() {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return std::exchange(m_glyphs, {});
+}
+
+GlyphRasterizer& GlyphRasterizer::Shared() {
+    static GlyphRasterizer s_rasterizer;
+    return s_rasterizer;
+}
+
+GlyphRasterizer::~GlyphRasterizer() {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stopping = true;
+        m_jobs.clear();
+    }
+    m_wake.notify_all();
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+}
+
+bool GlyphRasterizer::Submit(GlyphJob job) {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_stopping || (m_threads.empty() && !StartThreads())) {
+            return false;
+        }
+        m_jobs.push_back(std::move(job));
+    }
+    m_wake.notify_one();
+    return true;
+}
+
+void GlyphRasterizer::AddListener(HWND hwnd, UINT message) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_listeners.emplace_back(hwnd, message);
+}
+
+void GlyphRasterizer::RemoveListener(HWND hwnd) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    std::erase_if(m_listeners, [hwnd](const auto& listener) { return listener.first == hwnd; });
+}
+
+bool GlyphRasterizer::StartThreads() {
+    // Half the cores: the render and emulation threads need the rest
+    const unsigned count = std::clamp(std::thread::hardware_concurrency() / 2, 1u, kMaxThreads);
+    try {
+        for (unsigned index = 0; index < count; ++index) {
+            m_threads.emplace_back(&GlyphRasterizer::WorkerProc, this);
+        }
+    } catch (const std::system_error&) {
+        // Whatever started serves
+    }
+    return !m_threads.empty();
+}
+
+void GlyphRasterizer::WorkerProc() {
+    std::unique_lock<std::mutex> lock(m_lock);
+    while (true) {
+        m_wake.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+        if (m_stopping) {
+            return;
+        }
+        GlyphJob job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+
+        lock.unlock();
+        job.inbox->Put(Rasterize(job));
+        job = {};
+        lock.lock();
+
+        // Once the queue runs dry, and now and then during a long batch
+        if (++m_sinceNotify >= kNotifyBatch || m_jobs.empty()) {
+            m_sinceNotify = 0;
+            Notify();
+        }
+    }
+}
+
+RasterizedGlyph GlyphRasterizer::Rasterize(const GlyphJob& job) {
+    RasterizedGlyph glyph;
+    glyph.epoch = job.epoch;
+    glyph.key = job.key;
+    glyph.width = job.width;
+    glyph.height = job.height;
+    glyph.pixels.assign(size_t{job.width} * job.height * 4, 0);
+
+    DWRITE_GLYPH_RUN run{};
+    run.fontFace = job.face.Get();
+    run.fontEmSize = job.emSize;
+    run.glyphCount = 1;
+    run.glyphIndices = &job.index;
+
+    // The glyph origin on the slot's baseline
+    const DWRITE_MATRIX transform{job.scaleX, 0.0f, 0.0f, job.scaleY, 0.0f, 0.0f};
+    Coverage coverage;
+    if (!job.color) {
+        // Coverage becomes white premultiplied by itself
+        if (coverage.Rasterize(job.factory.Get(), run, transform, 0.0f, job.baseline)) {
+            coverage.Composite(glyph, {1.0f, 1.0f, 1.0f, 1.0f});
+        }
+        return glyph;
+    }
+
+    // Color layers bottom to top, each an outline in its own color; those
+    // in the text color are white, as a color glyph drawn by Direct2D
+    // with the atlas's white brush
+    ComPtr<IDWriteColorGlyphRunEnumerator> layers;
+    if (FAILED(job.factory->TranslateColorGlyphRun(0.0f, job.baseline, &run, nullptr, DWRITE_MEASURING_MODE_NATURAL,
+                                                   &transform, 0, layers.GetAddressOf()))) {
+        return glyph;
+    }
+    BOOL more = FALSE;
+    while (SUCCEEDED(layers->MoveNext(&more)) && more) {
+        const DWRITE_COLOR_GLYPH_RUN* layer = nullptr;
+        if (FAILED(layers->GetCurrentRun(&layer)) ||
+            !coverage.Rasterize(job.factory.Get(), layer->glyphRun, transform, layer->baselineOriginX,
+                                layer->baselineOriginY)) {
+            continue;
+        }
+        coverage.Composite(glyph, layer->paletteIndex == 0xFFFF ? DWRITE_COLOR_F{1.0f, 1.0f, 1.0f, 1.0f}
+                                                                : layer->runColor);
+    }
+    return glyph;
+}
+
+void GlyphRasterizer::Notify() {
+    for (const auto& [hwnd, message] : m_listeners) {
+        PostMessageW(hwnd, message, 0, 0);
+    }
+}
+
+} // namespace Console3::UI
@@ -0,0 +1,128 @@
+#pragma once
+// Console3 - GlyphRasterizer.h
+// Worker threads rasterizing glyphs for the glyph atlases
+//
+// A frame full of characters not yet in the atlas (the first screen of a
+// new font, a listing in a script not seen before) used to rasterize each
+// one through Direct2D on the thread drawing the frame, one glyph run at a
+// time, and the frame waited for all of them. The lone glyphs of a resolved
+// font, nearly all a terminal shows, are now rasterized by a small pool of
+// worker threads through IDWriteGlyphRunAnalysis, which needs no device:
+// the atlas reserves the glyph's slot, hands the glyph run here and draws
+// the cell blank until the coverage comes back. Finished glyphs wait in
+// their atlas's inbox; the next frame copies them all into the pages
+// (GlyphAtlas::Land) and repaints what was drawn blank. Windows that asked
+// to be told get a message once a batch is ready.
+//
+// Color glyphs made of COLR layers (Segoe UI Emoji's) are rasterized here
+// too, one coverage mask per layer composited in the layer's color, into
+// the same premultiplied BGRA the atlas pages hold. Box drawing, combining
+// sequences and bitmap or SVG color glyphs still go through Direct2D on
+// the calling thread.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+#include <dwrite_2.h>
+#include <wrl/client.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using Microsoft::WRL::ComPtr;
+
+namespace Console3::UI {
+
+/// A glyph's coverage, ready to be copied into its slot
+struct RasterizedGlyph {
+    uint64_t epoch = 0;             ///< Atlas contents it was asked for (see GlyphAtlas)
+    uint32_t key = 0;               ///< Atlas key
+    UINT32 width = 0;               ///< Slot size (pixels)
+    UINT32 height = 0;
+    std::vector<uint8_t> pixels;    ///< Premultiplied BGRA (white for masks), width * height
+};
+
+/// Glyphs rasterized for one atlas, waiting for its next frame (any thread)
+class GlyphInbox {
+public:
+    void Put(RasterizedGlyph&& glyph);
+
+    /// Take every glyph waiting
+    [[nodiscard]] std::vector<RasterizedGlyph> Take();
+
+private:
+    std::mutex m_lock;
+    std::vector<RasterizedGlyph> m_glyphs;
+};
+
+/// A lone glyph to rasterize into a slot
+struct GlyphJob {
+    std::shared_ptr<GlyphInbox> inbox;
+    uint64_t epoch = 0;
+    uint32_t key = 0;
+    ComPtr<IDWriteFactory2> factory;
+    ComPtr<IDWriteFontFace> face;
+    UINT16 index = 0;
+    float emSize = 0.0f;            ///< DIPs
+    float scaleX = 1.0f;            ///< Device pixels per DIP
+    float scaleY = 1.0f;
+    float baseline = 0.0f;          ///< From the slot top (DIPs)
+    UINT32 width = 0;               ///< Slot size (pixels)
+    UINT32 height = 0;
+    bool color = false;             ///< COLR glyph: composite its color layers
+};
+
+/// Process-wide pool rasterizing glyphs (see file comment)
+class GlyphRasterizer {
+public:
+    static constexpr unsigned kMaxThreads = 4;
+    static constexpr size_t kNotifyBatch = 32;  ///< Glyphs finished between notifications
+
+    /// Get the process's pool
+    static GlyphRasterizer& Shared();
+
+    GlyphRasterizer() = default;
+    ~GlyphRasterizer();
+
+    GlyphRasterizer(const GlyphRasterizer&) = delete;
+    GlyphRasterizer& operator=(const GlyphRasterizer&) = delete;
+
+    /// Queue a glyph, starting the threads on first use
+    /// @return false if no thread could be started (rasterize it directly)
+    [[nodiscard]] bool Submit(GlyphJob job);
+
+    /// Post a message to a window whenever a batch of glyphs is ready
+    void AddListener(HWND hwnd, UINT message);
+    void RemoveListener(HWND hwnd);
+
+private:
+    bool StartThreads();
+    void WorkerProc();
+
+    /// Rasterize a job's glyph (blank if it could not be)
+    [[nodiscard]] static RasterizedGlyph Rasterize(const GlyphJob& job);
+
+    /// Post to the listeners
+    void Notify();
+
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::deque<GlyphJob> m_jobs;
+    std::vector<std::thread> m_threads;
+    bool m_stopping = false;
+    size_t m_sinceNotify = 0;       ///< Glyphs finished since the last notification
+    std::vector<std::pair<HWND, UINT>> m_listeners;
+};
+
+} // namespace Console3::UI
@@ -0,0 +1,136 @@
+// Console3 - InstanceChannel.cpp
+// Hands a launch over to the Console3 process already running
+
+#include "UI/InstanceChannel.h"
+#include <memory>
+
+namespace Console3::UI {
+
+namespace {
+
+constexpr wchar_t kWindowClass[] = L"Console3InstanceChannel";
+
+/// WM_COPYDATA tag of a request to open a window ('C3NW')
+constexpr ULONG_PTR kOpenWindowTag = 0x4333'4E57;
+
+/// WM_COPYDATA tag of a request to write the diagnostics report ('C3DG')
+constexpr ULONG_PTR kDiagnosticsTag = 0x4333'4447;
+
+/// Posted to the channel window to open a window, with the directory
+constexpr UINT kOpenWindowMessage = WM_APP + 1;
+
+/// Longest working directory or path taken from another process (characters)
+constexpr size_t kMaxWorkingDir = 32767;
+
+} // namespace
+
+InstanceChannel::~InstanceChannel() {
+    Close();
+}
+
+bool InstanceChannel::HandOff(const std::wstring& workingDir) {
+    return Send(kOpenWindowTag, workingDir);
+}
+
+bool InstanceChannel::RequestDiagnostics(const std::wstring& path) {
+    return Send(kDiagnosticsTag, path);
+}
+
+bool InstanceChannel::Send(ULONG_PTR tag, const std::wstring& text) {
+    const HWND target = FindWindowExW(HWND_MESSAGE, nullptr, kWindowClass, nullptr);
+    if (!target) {
+        return false;
+    }
+
+    // The running process may bring its new window to the front
+    DWORD processId = 0;
+    if (GetWindowThreadProcessId(target, &processId) && processId != 0) {
+        AllowSetForegroundWindow(processId);
+    }
+
+    COPYDATASTRUCT data{};
+    data.dwData = tag;
+    data.cbData = static_cast<DWORD>(text.size() * sizeof(wchar_t));
+    data.lpData = const_cast<wchar_t*>(text.data());
+
+    DWORD_PTR result = 0;
+    return SendMessageTimeoutW(target, WM_COPYDATA, 0, reinterpret_cast<LPARAM>(&data),
+                               SMTO_ABORTIFHUNG | SMTO_BLOCK, kHandOffTimeoutMs, &result) != 0 &&
+           result == TRUE;
+}
+
+bool InstanceChannel::Listen(OpenWindowHandler handler, DiagnosticsHandler diagnostics) {
+    if (m_hwnd) {
+        return true;
+    }
+
+    const HINSTANCE instance = GetModuleHandleW(nullptr);
+    WNDCLASSEXW wc{};
+    wc.cbSize = sizeof(wc);
+    wc.lpfnWndProc = WindowProc;
+    wc.hInstance = instance;
+    wc.lpszClassName = kWindowClass;
+    if (!RegisterClassExW(&wc) && GetLastError() != ERROR_CLASS_ALREADY_EXISTS) {
+        return false;
+    }
+
+    m_handler = std::move(handler);
+    m_diagnostics = std::move(diagnostics);
+    m_hwnd = CreateWindowExW(0, kWindowClass, nullptr, 0, 0, 0, 0, 0, HWND_MESSAGE, nullptr, instance, this);
+    return m_hwnd != nullptr;
+}
+
+void InstanceChannel::Close() {
+    if (m_hwnd) {
+        DestroyWindow(m_hwnd);
+        m_hwnd = nullptr;
+    }
+    m_handler = nullptr;
+    m_diagnostics = nullptr;
+}
+
+LRESULT CALLBACK InstanceChannel::WindowProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam) {
+    if (message == WM_NCCREATE) {
+        const auto* create = reinterpret_cast<const CREATESTRUCTW*>(lParam);
+        SetWindowLongPtrW(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(create->lpCreateParams));
+    }
+
+    auto* self = reinterpret_cast<InstanceChannel*>(GetWindowLongPtrW(hwnd, GWLP_USERDATA));
+    if (message == WM_COPYDATA) {
+        const auto* data = reinterpret_cast<const COPYDATASTRUCT*>(lParam);
+        if (!self || !data || data->cbData % sizeof(wchar_t) != 0 ||
+            data->cbData / sizeof(wchar_t) > kMaxWorkingDir) {
+            return FALSE;
+        }
+
+        // The sender waits for the report, so it is written right here
+        if (data->dwData == kDiagnosticsTag) {
+            const std::wstring path(static_cast<const wchar_t*>(data->lpData), data->cbData / sizeof(wchar_t));
+            return self->m_diagnostics && !path.empty() && self->m_diagnostics(path) ? TRUE : FALSE;
+        }
+        if (data->dwData != kOpenWindowTag || !self->m_handler) {
+            return FALSE;
+        }
+
+        // The data is only valid during the message, and the sender waits
+        // for the answer; the window opens once it has it
+        auto workingDir = std::make_unique<std::wstring>(static_cast<const wchar_t*>(data->lpData),
+                                                         data->cbData / sizeof(wchar_t));
+        if (!PostMessageW(hwnd, kOpenWindowMessage, 0, reinterpret_cast<LPARAM>(workingDir.get()))) {
+            return FALSE;
+        }
+        workingDir.release();
+        return TRUE;
+    }
+    if (message == kOpenWindowMessage) {
+        const std::unique_ptr<std::wstring> workingDir(reinterpret_cast<std::wstring*>(lParam));
+        if (self && self->m_handler) {
+            self->m_handler(*workingDir);
+        }
+        return 0;
+    }
+
+    return DefWindowProcW(hwnd, message, wParam, lParam);
+}
+
+} // namespace Console3::UI
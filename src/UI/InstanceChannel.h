@@ -0,0 +1,87 @@
+#pragma once
+// Console3 - InstanceChannel.h
+// Hands a launch over to the Console3 process already running
+//
+// Windows share a process so they can share the rendering device, glyph
+// atlases, font objects, warm shells and the session scheduler. The first
+// process listens on a message-only window; a later launch finds it, sends
+// it its working directory with WM_COPYDATA and exits, and the running
+// process opens a window there. Nothing else is needed from the launch, so
+// the message is a fixed tag and the directory.
+//
+// If nobody answers (no process running, one hung, or one at a different
+// integrity level, which the system keeps from receiving the message), the
+// launch carries on as a process of its own.
+//
+// The same window answers "Console3.exe --diagnostics <file>": the running
+// process writes its memory report to the file before replying, so the
+// file is complete once the request returns. A process that does not take
+// launches (singleProcess off) still answers these.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+
+#include <functional>
+#include <string>
+
+namespace Console3::UI {
+
+/// Called on the UI thread to open a window for a handed-off launch
+using OpenWindowHandler = std::function<void(const std::wstring& workingDir)>;
+
+/// Called on the UI thread to write the diagnostics report to a file
+/// @return false if it could not be written
+using DiagnosticsHandler = std::function<bool(const std::wstring& path)>;
+
+/// Launch hand-off between processes (see file comment)
+class InstanceChannel {
+public:
+    /// Longest a launch waits for the running process to take it (ms)
+    static constexpr UINT kHandOffTimeoutMs = 5000;
+
+    InstanceChannel() = default;
+    ~InstanceChannel();
+
+    // Non-copyable, non-movable (the window points back here)
+    InstanceChannel(const InstanceChannel&) = delete;
+    InstanceChannel& operator=(const InstanceChannel&) = delete;
+
+    /// Pass this launch to a running process
+    /// @param workingDir Directory the new window's shell starts in
+    /// @return true if a running process opened a window for it
+    [[nodiscard]] static bool HandOff(const std::wstring& workingDir);
+
+    /// Ask a running process to write its diagnostics report
+    /// @param path File to write (a full path; the process has its own
+    ///             current directory)
+    /// @return true if a running process wrote it
+    [[nodiscard]] static bool RequestDiagnostics(const std::wstring& path);
+
+    /// Take launches handed off by later processes, and diagnostics
+    /// requests (UI thread)
+    /// @param handler Opens windows (nullptr to leave launches to themselves)
+    /// @param diagnostics Writes the diagnostics report (nullptr = none)
+    /// @return false if the listening window can't be created
+    bool Listen(OpenWindowHandler handler, DiagnosticsHandler diagnostics = nullptr);
+
+    /// Stop taking launches
+    void Close();
+
+private:
+    static LRESULT CALLBACK WindowProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam);
+
+    /// Send a tagged string to the running process's channel window
+    static bool Send(ULONG_PTR tag, const std::wstring& text);
+
+    HWND m_hwnd = nullptr;
+    OpenWindowHandler m_handler;
+    DiagnosticsHandler m_diagnostics;
+};
+
+} // namespace Console3::UI
@@ -2,9 +2,37 @@
 // Main application window implementation
 
 #include "UI/MainFrame.h"
-#include "Core/PtySession.h"
-#include "Core/TerminalBuffer.h"
-#include "Emulation/VTermWrapper.h"
+#include "UI/MessageLoop.h"
+#include "UI/TerminalView.h"
+#include "Core/IdleScheduler.h"
+#include "Core/Session.h"
+#include "Core/ScrollbackBudget.h"
+#include "Core/SessionReaper.h"
+#include "Core/SessionScheduler.h"
+#include "Core/SessionSnapshot.h"
+#include "Core/Settings.h"
+#include "Core/ShellDetector.h"
+#include "Core/StartupTrace.h"
+#include "Core/TelemetryEndpoint.h"
+#include "Core/ThreadPolicy.h"
+#include "Core/WarmShellPool.h"
+#include "UI/FontCatalog.h"
+#include "UI/RenderFactories.h"
+#include "UI/RenderThread.h"
+#include "UI/SearchPanel.h"
+#include "UI/SettingsDialog.h"
+#include <commdlg.h>
+#include <dwmapi.h>
+#include <psapi.h>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#pragma comment(lib, "comdlg32.lib")
+#pragma comment(lib, "dwmapi.lib")
 
 namespace Console3::UI {
 
@@ -14,22 +42,412 @@ constexpr int kDefaultHeight = 600;
 
 // Status bar parts
 constexpr int kStatusBarParts = 3;
+constexpr int kStatusPartMode = 1;
+constexpr int kStatusPartMemory = 2;
+
+// Shown while the output is paused
+constexpr const wchar_t* kPausedStatus = L"Paused (Scroll Lock)";
+constexpr std::wstring_view kPausedCaption = L"[Paused] ";
+
+// Re-evaluates fast-forward mode while it is active
+constexpr UINT_PTR kFastForwardTimerId = 1;
+constexpr UINT kFastForwardTimerMs = 100;
+
+// Feeds a running scrollback export (the writer thread waits on it)
+constexpr UINT_PTR kExportTimerId = 2;
+constexpr UINT kExportTimerMs = 15;
+
+// Shows the progress of a streamed paste
+constexpr UINT_PTR kPasteTimerId = 3;
+constexpr UINT kPasteTimerMs = 100;
+
+// Looks for a hidden session idle long enough to hibernate
+constexpr UINT_PTR kHibernateTimerId = 4;
+constexpr UINT kHibernateTimerMs = 60 * 1000;
+
+// Saves the session for the next start; sooner while history is left to copy
+constexpr UINT_PTR kSnapshotTimerId = 5;
+constexpr UINT kSnapshotTimerMs = 5 * 1000;
+constexpr UINT kSnapshotBacklogMs = 50;
+
+// Presents a synchronized update (DEC mode 2026) the application never ended
+constexpr UINT_PTR kSyncOutputTimerId = 6;
+
+// Refreshes the memory summary in the status bar
+constexpr UINT_PTR kMemoryTimerId = 7;
+constexpr UINT kMemoryTimerMs = 2 * 1000;
+
+// Waits for writes to the settings file to settle before reloading it
+constexpr UINT_PTR kSettingsTimerId = 8;
+constexpr UINT kSettingsTimerMs = 250;
+
+// DWM's system backdrop attribute and its values (Windows 11 SDK names,
+// DWMWA_SYSTEMBACKDROP_TYPE, DWMSBT_NONE and DWMSBT_TRANSIENTWINDOW; older
+// systems ignore the attribute)
+constexpr DWORD kDwmSystemBackdropType = 38;
+constexpr DWORD kBackdropNone = 1;
+constexpr DWORD kBackdropAcrylic = 3;
+
+// Saving power, woken background sessions wait this long to run in a batch
+constexpr uint32_t kPowerSavingBatchMs = 250;
+
+// Scrollback lines re-wrapped per idle call after a width change
+constexpr size_t kReflowLinesPerIdle = 2048;
+
+// Scrollback lines trimmed per idle call after the limit was lowered
+constexpr size_t kTrimLinesPerIdle = 8192;
+
+// Scrollback lines compressed or spilled per piece of a hibernation slice
+constexpr size_t kHibernateLinesPerPiece = 256;
+
+namespace {
+
+/// Main windows created and not yet destroyed, oldest first (UI thread)
+std::vector<MainFrame*> g_openWindows;
+
+/// Find in All Tabs, shared by the windows once opened (UI thread)
+std::unique_ptr<SearchPanel> g_searchPanel;
+
+/// Quit once the first shell output is on screen (--exit-after-first-frame)
+bool g_exitAfterFirstFrame = false;
+
+/// The machine runs on battery, and battery saver is on (from
+/// WM_POWERBROADCAST; UI thread)
+bool g_onBattery = false;
+bool g_batterySaver = false;
+
+/// Report the startup milestones once: to the debugger and the startup log
+/// (any thread)
+void ReportStartupTimes() {
+    Core::StartupTrace& trace = Core::StartupTrace::Shared();
+    if (!trace.TakeReport()) {
+        return;
+    }
+    OutputDebugStringW((L"Console3 startup: " + trace.Format() + L"\n").c_str());
+    (void)trace.AppendLog();
+}
+
+/// Get the process-wide settings
+const Core::Settings& GetSettings() {
+    return Core::SettingsManager::Shared().GetSettings();
+}
+
+/// Size the session's ring, reads, watermarks, scrollback tiers and image
+/// budget by the performance settings
+void ConfigurePerformance(Core::SessionConfig& config, const Core::PerformanceSettings& performance) {
+    config.outputBufferSize = static_cast<size_t>(performance.outputBufferKB) << 10;
+    config.maxReadSize = static_cast<size_t>(performance.readChunkKB) << 10;
+    config.outputHighWatermark = config.outputBufferSize / 100 * performance.highWatermarkPercent;
+    config.outputLowWatermark = config.outputBufferSize / 100 * performance.lowWatermarkPercent;
+    config.scrollbackHotLines = static_cast<size_t>(performance.scrollbackHotLines);
+    config.imageMemoryBytes = static_cast<size_t>(performance.imageMemoryMB) << 20;
+    config.fastForwardBytesPerSec = static_cast<size_t>(performance.fastForwardMBps) << 20;
+}
+
+/// Log the session's output by the output log settings: a file of its own
+/// in the log directory, named for the time and process (UI thread)
+void ConfigureOutputLog(Core::SessionConfig& config, const Core::OutputLogSettings& log) {
+    if (log.directory.empty()) {
+        return;
+    }
+    std::error_code error;
+    std::filesystem::create_directories(log.directory, error);
+
+    static unsigned sessions = 0;
+    SYSTEMTIME now{};
+    GetLocalTime(&now);
+    wchar_t name[96];
+    swprintf_s(name, L"console3-%04u%02u%02u-%02u%02u%02u-%lu-%u.log%s", now.wYear, now.wMonth, now.wDay,
+               now.wHour, now.wMinute, now.wSecond, GetCurrentProcessId(), ++sessions,
+               log.compress ? L".lz4" : L"");
+
+    config.recordPath = (std::filesystem::path(log.directory) / name).wstring();
+    config.recordFormat = Core::RecordingFormat::Raw;
+    config.recordCompress = log.compress;
+    config.recordOverflow = log.whenBehind == L"block" ? Core::RecorderOverflow::Block
+                          : log.whenBehind == L"spill" ? Core::RecorderOverflow::Spill
+                                                       : Core::RecorderOverflow::Drop;
+    config.recordRotateBytes = static_cast<uint64_t>(log.rotateMB) << 20;
+    config.recordRotateSeconds = static_cast<uint32_t>(log.rotateMinutes) * 60;
+}
+
+/// Bind a split pane straight to its session: its input and size go there
+PaneBinding MakePaneBinding(Core::Session& session) {
+    Core::Session* raw = &session;
+    PaneBinding binding;
+    binding.buffer = raw->GetBuffer();
+    binding.vterm = raw->GetVTerm();
+    binding.keyboard = [raw](const char* data, size_t length) { (void)raw->Write(data, length); };
+    binding.mouse = [raw](const Emulation::MouseEvent& event) { raw->QueueMouseInput(event); };
+    binding.paste = [raw](std::wstring text, bool bracketed) { (void)raw->Paste(std::move(text), bracketed); };
+    binding.resize = [raw](int cols, int rows) {
+        if (raw->IsRunning()) {
+            raw->Resize(cols, rows);
+        }
+    };
+    return binding;
+}
+
+/// Map a cursor style name from the settings
+CursorStyle ParseCursorStyle(const std::wstring& style) {
+    if (style == L"underline") return CursorStyle::Underline;
+    if (style == L"bar") return CursorStyle::Bar;
+    return CursorStyle::Block;
+}
+
+} // namespace
 
 MainFrame::MainFrame() = default;
 
+MainFrame* MainFrame::Open(int showCmd, const std::wstring& workingDir, const Core::SavedSession* saved) {
+    auto frame = std::make_unique<MainFrame>();
+    frame->m_workingDir = workingDir;
+    frame->m_saved = saved;
+    const HWND created = frame->CreateEx();
+    frame->m_saved = nullptr;
+    if (created == nullptr) {
+        return nullptr;
+    }
+
+    // Destroyed windows delete themselves from here on
+    MainFrame* window = frame.release();
+    window->m_ownsSelf = true;
+    window->ShowWindow(showCmd);
+    window->UpdateWindow();
+    return window;
+}
+
+MainFrame* MainFrame::OpenAttached(int showCmd, const std::wstring& hostPipe) {
+    auto frame = std::make_unique<MainFrame>();
+    frame->m_hostPipe = hostPipe;
+    if (frame->CreateEx() == nullptr) {
+        return nullptr;
+    }
+
+    MainFrame* window = frame.release();
+    window->m_ownsSelf = true;
+    window->ShowWindow(showCmd);
+    window->UpdateWindow();
+    return window;
+}
+
+MainFrame* MainFrame::OpenDuplicate(int showCmd, const std::wstring& workingDir,
+                                    const Core::TerminalBuffer& history) {
+    auto frame = std::make_unique<MainFrame>();
+    frame->m_workingDir = workingDir;
+    frame->m_history = &history;
+    const HWND created = frame->CreateEx();
+    frame->m_history = nullptr;
+    if (created == nullptr) {
+        return nullptr;
+    }
+
+    MainFrame* window = frame.release();
+    window->m_ownsSelf = true;
+    window->ShowWindow(showCmd);
+    window->UpdateWindow();
+    return window;
+}
+
+MainFrame* MainFrame::OpenLogView(int showCmd, const std::wstring& path) {
+    auto frame = std::make_unique<MainFrame>();
+    frame->m_logPath = path;
+    if (frame->CreateEx() == nullptr) {
+        return nullptr;
+    }
+
+    MainFrame* window = frame.release();
+    window->m_ownsSelf = true;
+    window->ShowWindow(showCmd);
+    window->UpdateWindow();
+    return window;
+}
+
+MainFrame* MainFrame::OpenSerial(int showCmd, const Core::SerialSettings& serial) {
+    auto frame = std::make_unique<MainFrame>();
+    frame->m_serial = serial;
+    if (frame->CreateEx() == nullptr) {
+        return nullptr;
+    }
+
+    MainFrame* window = frame.release();
+    window->m_ownsSelf = true;
+    window->ShowWindow(showCmd);
+    window->UpdateWindow();
+    return window;
+}
+
+void MainFrame::SetExitAfterFirstFrame(bool exit) noexcept {
+    g_exitAfterFirstFrame = exit;
+}
+
+size_t MainFrame::GetOpenCount() noexcept {
+    return g_openWindows.size();
+}
+
+std::wstring MainFrame::FormatMemoryReport() {
+    // Asked for from another process, outside the windows' handlers
+    RenderLock::Scope lock(RenderLock::Shared());
+    std::wstring report = L"Console3 memory report\r\n";
+    wchar_t line[160];
+
+    swprintf_s(line, L"process %lu, %zu window(s)\r\n", GetCurrentProcessId(), g_openWindows.size());
+    report += line;
+
+    PROCESS_MEMORY_COUNTERS_EX counters{};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters),
+                             sizeof(counters))) {
+        swprintf_s(line, L"private %s, working set %s\r\n",
+                   Core::FormatBytes(counters.PrivateUsage).c_str(),
+                   Core::FormatBytes(counters.WorkingSetSize).c_str());
+        report += line;
+    }
+
+    const Core::ScrollbackBudget& budget = Core::ScrollbackBudget::Shared();
+    swprintf_s(line, L"scrollback budget %s of %s\r\n", Core::FormatBytes(budget.GetUsage()).c_str(),
+               budget.GetLimit() != 0 ? Core::FormatBytes(budget.GetLimit()).c_str() : L"unlimited");
+    report += line;
+    if (const size_t closing = Core::SessionReaper::Shared().GetPendingCount()) {
+        swprintf_s(line, L"sessions closing %zu\r\n", closing);
+        report += line;
+    }
+
+    for (size_t i = 0; i < g_openWindows.size(); ++i) {
+        const MainFrame* frame = g_openWindows[i];
+        wchar_t title[128] = L"";
+        ::GetWindowTextW(frame->m_hWnd, title, static_cast<int>(std::size(title)));
+        swprintf_s(line, L"\r\nwindow %zu: %s%s\r\n", i + 1, title,
+                   frame->m_session ? L"" : L" (no session)");
+        report += line;
+        if (frame->m_session) {
+            report += Core::FormatSessionMemory(frame->GetMemory(), L"  ");
+            const Core::JobAccounting shell = frame->m_session->GetStats().shell;
+            swprintf_s(line, L"  shell: %u process(es), cpu %.1f s, peak commit %s\r\n", shell.activeProcesses,
+                       shell.cpuMicros / 1000000.0, Core::FormatBytes(shell.peakMemory).c_str());
+            report += line;
+        }
+        for (const BackgroundTab& tab : frame->m_backgroundTabs) {
+            swprintf_s(line, L"  tab %d (behind):\r\n", tab.tabId);
+            report += line;
+            report += Core::FormatSessionMemory(tab.session->GetMemory(), L"    ");
+        }
+    }
+    return report;
+}
+
+Core::TelemetrySnapshot MainFrame::CollectTelemetry() {
+    // Asked for on the endpoint's thread, outside the windows' handlers
+    RenderLock::Scope lock(RenderLock::Shared());
+    Core::TelemetrySnapshot snapshot;
+    const auto addSession = [&snapshot](Core::Session& session, const std::wstring& title,
+                                        const Core::SessionMemory& memory) {
+        Core::TelemetrySession& entry = snapshot.sessions.emplace_back();
+        entry.id = session.GetTraceId();
+        entry.window = static_cast<uint32_t>(snapshot.windows.size() - 1);
+        entry.title = title;
+        entry.stats = session.GetStats();
+        entry.memory = memory;
+        entry.parseTimes = session.GetParseTimes();
+        const Core::InputLatencyProbe& probe = session.GetInputLatency();
+        for (size_t stage = 0; stage < Core::kLatencyStageCount; ++stage) {
+            entry.inputLatency[stage] = probe.GetHistogram(static_cast<Core::LatencyStage>(stage));
+        }
+        entry.inputDropped = probe.GetDropped();
+    };
+
+    for (const MainFrame* frame : g_openWindows) {
+        Core::TelemetryWindow& window = snapshot.windows.emplace_back();
+        if (frame->m_terminalView) {
+            window.frameTimes = frame->m_terminalView->GetFrameTimes();
+            window.missedFrames = frame->m_terminalView->GetMissedFrames();
+        }
+        wchar_t title[128] = L"";
+        ::GetWindowTextW(frame->m_hWnd, title, static_cast<int>(std::size(title)));
+        if (frame->m_session) {
+            addSession(*frame->m_session, title, frame->GetMemory());
+        }
+        for (const PaneSession& entry : frame->m_paneSessions) {
+            addSession(*entry.session, std::wstring(title) + L" (pane " + std::to_wstring(entry.pane) + L")",
+                       entry.session->GetMemory());
+        }
+        for (const BackgroundTab& tab : frame->m_backgroundTabs) {
+            addSession(*tab.session, std::wstring(title) + L" (tab " + std::to_wstring(tab.tabId) + L")",
+                       tab.session->GetMemory());
+        }
+    }
+    return snapshot;
+}
+
+void MainFrame::OnFinalMessage(HWND /*hwnd*/) {
+    if (m_ownsSelf) {
+        delete this;
+    }
+}
+
 MainFrame::~MainFrame() {
+    // No output handler may run while the sessions go
+    m_renderThread.Stop();
+
     // Stop PTY session before destroying
-    if (m_ptySession) {
-        m_ptySession->Stop();
-    }
+    StopSession();
+    CloseBackgroundTabs();
 }
 
 BOOL MainFrame::PreTranslateMessage(MSG* pMsg) {
+    // Every window's filter sees every message of the thread
+    if (pMsg->hwnd != m_hWnd && !IsChild(pMsg->hwnd)) {
+        return FALSE;
+    }
+    RenderLock::Scope lock(RenderLock::Shared());
+
+    // The find bar's keys are its own while it has the focus
+    if (m_findBar.PreTranslateMessage(pMsg)) {
+        return TRUE;
+    }
+
+    // Ctrl+F finds in the tab, Ctrl+Shift+F in every tab
+    if (pMsg->message == WM_KEYDOWN && pMsg->wParam == 'F' && GetKeyState(VK_CONTROL) < 0 &&
+        GetKeyState(VK_MENU) >= 0) {
+        if (GetKeyState(VK_SHIFT) < 0) {
+            OnEditFind(0, ID_EDIT_FIND, nullptr);
+        } else {
+            OnEditFindInTab(0, ID_EDIT_FIND_IN_TAB, nullptr);
+        }
+        return TRUE;
+    }
+
+    // Escape cancels a paste still being streamed instead of reaching the shell
+    if (pMsg->message == WM_KEYDOWN && pMsg->wParam == VK_ESCAPE && m_session && m_session->IsPasting()) {
+        m_session->CancelPaste();
+        UpdatePaste();
+        return TRUE;
+    }
+
+    // Scroll Lock freezes the output at its source, as on a hardware terminal
+    if (pMsg->message == WM_KEYDOWN && pMsg->wParam == VK_SCROLL && m_session) {
+        if (!(pMsg->lParam & (1 << 30))) {
+            SetOutputPaused(!m_outputPaused);
+        }
+        return TRUE;
+    }
     return CFrameWindowImpl<MainFrame>::PreTranslateMessage(pMsg);
 }
 
 BOOL MainFrame::OnIdle() {
+    // Runs from the message loop, outside the window procedure
+    RenderLock::Scope lock(RenderLock::Shared());
     UIUpdateToolBar();
+
+    // Re-wrap scrollback after a width change, and trim it after the limit
+    // was lowered, a slice at a time while the queue is empty; TRUE asks to
+    // be called again
+    if (m_session) {
+        if (Core::TerminalBuffer* buffer = m_session->GetBuffer()) {
+            const bool reflow = buffer->ReflowScrollback(kReflowLinesPerIdle);
+            const bool trim = buffer->TrimScrollback(kTrimLinesPerIdle);
+            return reflow || trim ? TRUE : FALSE;
+        }
+    }
     return FALSE;
 }
 
@@ -43,6 +461,7 @@ int MainFrame::OnCreate(LPCREATESTRUCT /*lpCreateStruct*/) {
     ATLASSERT(pLoop != nullptr);
     pLoop->AddMessageFilter(this);
     pLoop->AddIdleHandler(this);
+    g_openWindows.push_back(this);
 
     // Create UI components
     if (!CreateMenuBar()) {
@@ -52,6 +471,11 @@ int MainFrame::OnCreate(LPCREATESTRUCT /*lpCreateStruct*/) {
     if (!CreateStatusBar()) {
         return -1;
     }
+    if (!CreateTabBar()) {
+        return -1;
+    }
+    ApplyTransparency();
+    SetTimer(kMemoryTimerId, kMemoryTimerMs);
 
     // Set initial window size
     SetWindowPos(nullptr, 0, 0, kDefaultWidth, kDefaultHeight, 
@@ -60,24 +484,206 @@ int MainFrame::OnCreate(LPCREATESTRUCT /*lpCreateStruct*/) {
     // Center window on screen
     CenterWindow();
 
+    // All tabs' scrollback shares one memory budget
+    Core::ScrollbackBudget::Shared().SetLimit(static_cast<size_t>(std::max(GetSettings().scrollbackBudgetMB, 0))
+                                              << 20);
+    ApplyTelemetry();
+
+    Core::StartupTrace::Shared().Mark(Core::StartupPhase::WindowCreated);
+
+    // Each registration is answered at once with the current state
+    m_powerSourceNotify = RegisterPowerSettingNotification(m_hWnd, &GUID_ACDC_POWER_SOURCE,
+                                                           DEVICE_NOTIFY_WINDOW_HANDLE);
+    m_powerSavingNotify = RegisterPowerSettingNotification(m_hWnd, &GUID_POWER_SAVING_STATUS,
+                                                           DEVICE_NOTIFY_WINDOW_HANDLE);
+
+    // Output is applied and frames rendered there, off the UI thread
+    if (!m_renderThread.Start()) {
+        return -1;
+    }
+    if (!CreateTerminalView()) {
+        return -1;
+    }
+
+    // Hidden until Ctrl+F; closing it gives the view the room and the focus
+    if (!m_findBar.Create(m_hWnd, m_terminalView.get(), [this] {
+            UpdateChildLayout();
+            m_terminalView->SetFocus();
+        })) {
+        return -1;
+    }
+
     // Start with a new terminal session
-    if (!StartNewSession()) {
+    if (!OpenTab()) {
         // Non-fatal: show window anyway, user can open new tab
         m_statusBar.SetText(0, L"Failed to start terminal session");
+    } else {
+        Core::StartupTrace::Shared().Mark(Core::StartupPhase::ShellStarted);
     }
 
     // Update status bar
     m_statusBar.SetText(0, L"Ready");
 
+    // Everything else waits until the window is on screen
+    PostMessage(kStartupTasksMessage);
+
+    return 0;
+}
+
+LRESULT MainFrame::OnSessionExited(UINT /*uMsg*/, WPARAM wParam, LPARAM lParam, BOOL& /*bHandled*/) {
+    if (static_cast<uint32_t>(lParam) == m_sessionSerial && m_session && m_statusBar.IsWindow()) {
+        const std::wstring msg = !m_serial.port.empty()
+                                     ? m_serial.port + L" closed (error " + std::to_wstring(static_cast<DWORD>(wParam)) + L")"
+                                     : L"Process exited with code: " + std::to_wstring(static_cast<DWORD>(wParam));
+        m_statusBar.SetText(0, msg.c_str());
+    }
+    return 0;
+}
+
+LRESULT MainFrame::OnPaneExited(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM lParam, BOOL& /*bHandled*/) {
+    // A pane closed meanwhile (or its tab closed) has no entry
+    const uint32_t traceId = static_cast<uint32_t>(lParam);
+    for (const PaneSession& entry : m_paneSessions) {
+        if (entry.session->GetTraceId() == traceId) {
+            ClosePane(entry.pane);
+            return 0;
+        }
+    }
+
+    // A tab behind the one in front has no panes on the view to close
+    for (BackgroundTab& tab : m_backgroundTabs) {
+        const auto found = std::find_if(tab.panes.begin(), tab.panes.end(), [traceId](const PaneSession& entry) {
+            return entry.session->GetTraceId() == traceId;
+        });
+        if (found != tab.panes.end()) {
+            std::unique_ptr<Core::Session> session = std::move(found->session);
+            tab.panes.erase(found);
+            RetireSession(std::move(session));
+            break;
+        }
+    }
+    return 0;
+}
+
+LRESULT MainFrame::OnOutputMessage(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/) {
+    // The render thread applied the output and asked for the frame; modes,
+    // the synchronized update's timer, bells and the startup report are
+    // the UI thread's
+    m_outputPosted.store(false);
+    if (!m_session) {
+        return 0;
+    }
+    if (m_terminalView && m_terminalView->IsWindow()) {
+        UpdateViewModes();
+        if (const DWORD hold = m_session->GetPresentHoldMs()) {
+            SetTimer(kSyncOutputTimerId, hold);
+        } else {
+            // The update may have ended since the render thread looked
+            KillTimer(kSyncOutputTimerId);
+            m_terminalView->Invalidate();
+        }
+    }
+    OnOutputRuleEvents();
+    ReportStartup();
+    return 0;
+}
+
+LRESULT MainFrame::OnFastForwardMessage(UINT /*uMsg*/, WPARAM wParam, LPARAM /*lParam*/, BOOL& /*bHandled*/) {
+    // A replaced session's notice can arrive after StopSession cleared it
+    const bool active = wParam != 0 && m_session;
+    if (active) {
+        SetTimer(kFastForwardTimerId, kFastForwardTimerMs);
+    } else {
+        KillTimer(kFastForwardTimerId);
+    }
+    if (m_statusBar.IsWindow()) {
+        m_statusBar.SetText(kStatusPartMode, m_outputPaused ? kPausedStatus : active ? L"Fast-forward" : L"");
+    }
+    return 0;
+}
+
+LRESULT MainFrame::OnStartupTasks(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/) {
+    // Probing shells and fonts takes long enough to show; their results
+    // are cached for the menus and the settings dialog
+    const auto logWhenComplete = [] {
+        if (Core::StartupTrace::Shared().IsComplete()) {
+            ReportStartupTimes();
+        }
+    };
+    Core::ShellDetector::Shared().DetectInBackground([logWhenComplete] {
+        Core::StartupTrace::Shared().Mark(Core::StartupPhase::ShellsDetected);
+        logWhenComplete();
+    });
+    FontCatalog::Shared().EnumerateInBackground([logWhenComplete] {
+        Core::StartupTrace::Shared().Mark(Core::StartupPhase::FontsEnumerated);
+        logWhenComplete();
+    });
+
+    // Warm shells for new tabs, started only now so they don't compete
+    // with the first one
+    const Core::Settings& settings = GetSettings();
+    Core::WarmShellPool::Shared().Configure(static_cast<size_t>(std::max(settings.warmShellsPerProfile, 0)),
+                                            static_cast<size_t>(std::max(settings.warmShellMinFreeMB, 0)));
+
+    // Keep the session on disk for the next start
+    if (settings.tabs.restoreTabsOnStartup) {
+        SetTimer(kSnapshotTimerId, kSnapshotTimerMs);
+    }
     return 0;
 }
 
+void MainFrame::ReportStartup() {
+    Core::StartupTrace& trace = Core::StartupTrace::Shared();
+    if (!trace.Mark(Core::StartupPhase::FirstOutput)) {
+        return;
+    }
+
+    const uint64_t micros = trace.GetMicros(Core::StartupPhase::FirstOutput);
+    if (m_statusBar.IsWindow()) {
+        const std::wstring text = L"Started in " + std::to_wstring((micros + 500) / 1000) + L" ms";
+        m_statusBar.SetText(0, text.c_str());
+    }
+
+    // A cold-start benchmark measures this far and no further; background
+    // work still running is reported as far as it got
+    if (g_exitAfterFirstFrame) {
+        ReportStartupTimes();
+        PostQuitMessage(0);
+    } else if (trace.IsComplete()) {
+        ReportStartupTimes();
+    }
+}
+
 void MainFrame::OnDestroy() {
-    // Stop PTY session
-    if (m_ptySession) {
-        m_ptySession->Stop();
+    // The last window's session is saved for the next start; a window closed
+    // while others stay open is gone for good
+    if (GetSettings().tabs.restoreTabsOnStartup) {
+        KillTimer(kSnapshotTimerId);
+        Core::SessionSnapshots& snapshots = Core::SessionSnapshots::Shared();
+        const Core::TerminalBuffer* buffer = m_session ? m_session->GetBuffer() : nullptr;
+        if (g_openWindows.size() == 1 && buffer) {
+            (void)snapshots.Capture(this, m_session->GetConfig(), *buffer, SIZE_MAX);
+            snapshots.Flush();
+        } else {
+            snapshots.Forget(this);
+        }
+    }
+
+    if (m_powerSourceNotify) {
+        UnregisterPowerSettingNotification(m_powerSourceNotify);
+        m_powerSourceNotify = nullptr;
+    }
+    if (m_powerSavingNotify) {
+        UnregisterPowerSettingNotification(m_powerSavingNotify);
+        m_powerSavingNotify = nullptr;
     }
 
+    // Stop PTY sessions, once no output handler can run
+    KillTimer(kMemoryTimerId);
+    m_renderThread.Stop();
+    StopSession();
+    CloseBackgroundTabs();
+
     // Remove from message loop
     CMessageLoop* pLoop = _Module.GetMessageLoop();
     if (pLoop) {
@@ -85,11 +691,16 @@ void MainFrame::OnDestroy() {
         pLoop->RemoveIdleHandler(this);
     }
 
-    // Quit the application
-    PostQuitMessage(0);
+    // Quit the application with its last window
+    if (std::erase(g_openWindows, this) != 0 && g_openWindows.empty()) {
+        g_searchPanel.reset();
+        ApplyTelemetry();
+        PostQuitMessage(0);
+    }
 }
 
 void MainFrame::OnSize(UINT nType, CSize size) {
+    UpdateSessionPriority(GetForegroundWindow() == m_hWnd);
     if (nType == SIZE_MINIMIZED) {
         return;
     }
@@ -99,44 +710,158 @@ void MainFrame::OnSize(UINT nType, CSize size) {
         m_statusBar.SendMessage(WM_SIZE);
     }
 
-    // Calculate client area excluding status bar
-    CRect clientRect;
-    GetClientRect(&clientRect);
-    
-    CRect statusRect;
-    if (m_statusBar.IsWindow()) {
-        m_statusBar.GetWindowRect(&statusRect);
-        clientRect.bottom -= statusRect.Height();
+    // The tab bar spans the top, the find bar (when open) is under it; the
+    // view takes the rest
+    const CRect clientRect = GetViewRect();
+    if (m_tabBar.IsWindow()) {
+        m_tabBar.SetWindowPos(nullptr, 0, 0, size.cx, m_tabBar.GetHeight(), SWP_NOZORDER | SWP_NOACTIVATE);
+    }
+    if (m_findBar.IsWindow() && m_findBar.IsOpen()) {
+        const int height = m_findBar.GetHeight();
+        m_findBar.SetWindowPos(nullptr, 0, clientRect.top - height, size.cx, height, SWP_NOZORDER | SWP_NOACTIVATE);
+    }
+
+    if (GetSettings().window.opacity < 1.0f) {
+        UpdateBackdropMargins();
+    }
+
+    // Resize terminal view; it passes the new grid size on to the session
+    // (coalesced while the window is dragged, see SetResizeCallback)
+    if (m_terminalView && m_terminalView->IsWindow()) {
+        m_terminalView->SetWindowPos(nullptr, clientRect, SWP_NOZORDER | SWP_NOACTIVATE);
+    }
+}
+
+void MainFrame::OnEnterSizeMove() {
+    if (m_terminalView) {
+        m_terminalView->BeginLiveResize();
     }
+    BeginModal();
+}
 
-    // Resize terminal view
+void MainFrame::OnExitSizeMove() {
+    EndModal();
     if (m_terminalView) {
-        // TODO: Resize terminal view window
+        m_terminalView->EndLiveResize();
+    }
+}
+
+void MainFrame::OnMove(CPoint /*ptPos*/) {
+    // On another monitor the GPU driving it may be another one
+    const HMONITOR monitor = MonitorFromWindow(m_hWnd, MONITOR_DEFAULTTONEAREST);
+    if (monitor != m_monitor) {
+        m_monitor = monitor;
+        if (m_terminalView && m_terminalView->IsWindow()) {
+            m_terminalView->UpdateAdapter();
+        }
+    }
+}
+
+void MainFrame::OnDisplayChange(UINT /*uBitsPerPixel*/, CSize /*sizeScreen*/) {
+    // Monitors may have moved between adapters, or an adapter come or gone
+    if (m_terminalView && m_terminalView->IsWindow()) {
+        m_terminalView->UpdateAdapter();
+    }
+}
+
+void MainFrame::OnFontChange() {
+    // A font was installed or removed: the settings dialog's list is stale
+    FontCatalog::Shared().Invalidate();
+}
+
+LRESULT MainFrame::OnEnterMenuLoop(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& bHandled) {
+    BeginModal();
+    bHandled = FALSE;
+    return 0;
+}
+
+LRESULT MainFrame::OnExitMenuLoop(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& bHandled) {
+    EndModal();
+    bHandled = FALSE;
+    return 0;
+}
+
+void MainFrame::BeginModal() {
+    // Every level but the one of the handler that starts the loop, which
+    // ends with its message (an Unlock that finds the lock gone is a no-op)
+    const unsigned depth = RenderLock::Shared().Release();
+    m_modalDepth = depth > 0 ? depth - 1 : 0;
+}
+
+void MainFrame::EndModal() {
+    RenderLock::Shared().Reacquire(m_modalDepth);
+    m_modalDepth = 0;
+}
+
+int MainFrame::ShowMessage(const wchar_t* text, const wchar_t* caption, UINT type) {
+    RenderLock::Unlocked unlocked(RenderLock::Shared());
+    return MessageBoxW(text, caption, type);
+}
+
+LRESULT MainFrame::OnDpiChanged(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM lParam, BOOL& /*bHandled*/) {
+    // Take the size Windows suggests for the new monitor; the terminal view
+    // picks up the DPI in WM_DPICHANGED_AFTERPARENT
+    const auto* suggested = reinterpret_cast<const RECT*>(lParam);
+    SetWindowPos(nullptr, suggested->left, suggested->top, suggested->right - suggested->left,
+                 suggested->bottom - suggested->top, SWP_NOZORDER | SWP_NOACTIVATE);
+    return 0;
+}
+
+LRESULT MainFrame::OnPowerBroadcast(UINT /*uMsg*/, WPARAM wParam, LPARAM lParam, BOOL& bHandled) {
+    const auto* setting = reinterpret_cast<const POWERBROADCAST_SETTING*>(lParam);
+    if (wParam != PBT_POWERSETTINGCHANGE || !setting || setting->DataLength < sizeof(DWORD)) {
+        bHandled = FALSE;
+        return 0;
+    }
+
+    DWORD value = 0;
+    std::memcpy(&value, setting->Data, sizeof(value));
+    if (setting->PowerSetting == GUID_ACDC_POWER_SOURCE) {
+        g_onBattery = value != PoAc;
+    } else if (setting->PowerSetting == GUID_POWER_SAVING_STATUS) {
+        g_batterySaver = value != 0;
     }
+    ApplyPowerPolicy();
+    return TRUE;
+}
 
-    // Resize PTY to match new dimensions
-    if (m_ptySession && m_ptySession->IsRunning()) {
-        // TODO: Calculate rows/cols from pixel dimensions and font metrics
-        // m_ptySession->Resize(cols, rows);
+LRESULT MainFrame::OnCompositionChanged(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/) {
+    // Only top-level windows are told
+    if (m_terminalView && m_terminalView->IsWindow()) {
+        m_terminalView->OnCompositionChanged();
     }
+    return 0;
 }
 
 void MainFrame::OnSetFocus(CWindow /*wndOld*/) {
     // Forward focus to terminal view
-    if (m_terminalView) {
-        // TODO: Set focus to terminal view
+    if (m_terminalView && m_terminalView->IsWindow()) {
+        m_terminalView->SetFocus();
     }
 }
 
+void MainFrame::OnActivate(UINT nState, BOOL /*bMinimized*/, CWindow /*wndOther*/) {
+    // The UI thread runs at high QoS while one of its windows is in front;
+    // switching between them, the one activated comes last
+    (void)Core::ThreadPolicy::SetCurrentQos(nState != WA_INACTIVE ? Core::ThreadQos::High
+                                                                  : Core::ThreadQos::Default);
+    UpdateSessionPriority(nState != WA_INACTIVE);
+    SetMsgHandled(FALSE);
+}
+
 void MainFrame::OnClose() {
     if (m_isClosing) {
         return;
     }
     m_isClosing = true;
 
-    // Check if session is running
-    if (m_ptySession && m_ptySession->IsRunning()) {
-        int result = MessageBoxW(
+    // Check if a session is running, in any tab
+    const bool running = (m_session && m_session->IsRunning()) ||
+                         std::any_of(m_backgroundTabs.begin(), m_backgroundTabs.end(), [](const BackgroundTab& tab) {
+                             return tab.session->IsRunning();
+                         });
+    if (running) {
+        int result = ShowMessage(
             L"A terminal session is still running.\nClose anyway?",
             L"Console3",
             MB_YESNO | MB_ICONQUESTION
@@ -150,22 +875,120 @@ void MainFrame::OnClose() {
     DestroyWindow();
 }
 
+void MainFrame::OnTimer(UINT_PTR nIDEvent) {
+    if (nIDEvent == kExportTimerId) {
+        UpdateExport();
+        return;
+    }
+    if (nIDEvent == kPasteTimerId) {
+        UpdatePaste();
+        return;
+    }
+    if (nIDEvent == kHibernateTimerId) {
+        UpdateHibernation();
+        return;
+    }
+    if (nIDEvent == kSnapshotTimerId) {
+        SaveSnapshot();
+        return;
+    }
+    if (nIDEvent == kMemoryTimerId) {
+        UpdateMemory();
+        return;
+    }
+    if (nIDEvent == kSettingsTimerId) {
+        KillTimer(kSettingsTimerId);
+        ReloadSettings();
+        return;
+    }
+    if (nIDEvent == kSyncOutputTimerId) {
+        KillTimer(kSyncOutputTimerId);
+        if (m_terminalView && m_terminalView->IsWindow()) {
+            m_terminalView->Invalidate();
+        }
+        return;
+    }
+    if (nIDEvent != kFastForwardTimerId) {
+        SetMsgHandled(FALSE);
+        return;
+    }
+
+    // Ends fast-forward once the flood stops (no output event to drive it)
+    if (m_session) {
+        m_session->UpdateFastForward();
+    }
+}
+
 // ============================================================================
 // Command Handlers
 // ============================================================================
 
 void MainFrame::OnFileNewTab(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/) {
-    // TODO: Implement multi-tab support
-    StartNewSession();
+    if (!OpenTab()) {
+        m_statusBar.SetText(0, L"Failed to open a new tab");
+    }
+}
+
+void MainFrame::OnFileNewWindow(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/) {
+    // Another window in this process, sharing its renderer resources
+    if (!Open(SW_SHOWNORMAL, m_workingDir)) {
+        m_statusBar.SetText(0, L"Failed to open a new window");
+    }
+}
+
+void MainFrame::OnFileDuplicateTab(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/) {
+    // A new shell below this one's history, which it shares rather than
+    // copies; the render lock held here keeps this buffer still meanwhile
+    const Core::TerminalBuffer* buffer = m_session ? m_session->GetBuffer() : nullptr;
+    if (!buffer || !OpenDuplicate(SW_SHOWNORMAL, m_workingDir, *buffer)) {
+        m_statusBar.SetText(0, L"Failed to duplicate the tab");
+    }
 }
 
 void MainFrame::OnFileCloseTab(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/) {
-    // TODO: Implement multi-tab support
-    if (m_ptySession) {
-        m_ptySession->Stop();
+    if (m_activeTab != 0) {
+        CloseTab(m_activeTab);
     }
 }
 
+void MainFrame::OnFileSaveScrollback(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/) {
+    if (!m_session || !m_session->GetBuffer() || m_session->GetExport().IsActive()) {
+        return;
+    }
+
+    wchar_t path[MAX_PATH] = L"scrollback.txt";
+    OPENFILENAMEW dialog{};
+    dialog.lStructSize = sizeof(dialog);
+    dialog.hwndOwner = m_hWnd;
+    dialog.lpstrFilter = L"Text (*.txt)\0*.txt\0ANSI text (*.ans)\0*.ans\0HTML (*.html)\0*.html\0";
+    dialog.lpstrFile = path;
+    dialog.nMaxFile = MAX_PATH;
+    dialog.lpstrDefExt = L"txt";
+    dialog.Flags = OFN_OVERWRITEPROMPT | OFN_PATHMUSTEXIST | OFN_NOCHANGEDIR;
+    {
+        // The dialog's loop runs with the render thread free to paint
+        RenderLock::Unlocked unlocked(RenderLock::Shared());
+        if (!GetSaveFileNameW(&dialog)) {
+            return;
+        }
+    }
+    // The dialog's messages may have replaced the session meanwhile
+    if (!m_session || !m_session->GetBuffer() || m_session->GetExport().IsActive()) {
+        return;
+    }
+
+    const Core::ExportFormat format = dialog.nFilterIndex == 2 ? Core::ExportFormat::Ansi
+                                    : dialog.nFilterIndex == 3 ? Core::ExportFormat::Html
+                                    : Core::ExportFormat::Text;
+    if (!m_session->GetExport().Start(*m_session->GetBuffer(), path, format)) {
+        std::wstring error = L"Could not create " + std::wstring(path);
+        ShowMessage(error.c_str(), L"Console3", MB_ICONERROR);
+        return;
+    }
+    SetTimer(kExportTimerId, kExportTimerMs);
+    UpdateExport();
+}
+
 void MainFrame::OnFileExit(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/) {
     PostMessage(WM_CLOSE);
 }
@@ -175,35 +998,82 @@ void MainFrame::OnEditCopy(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/
 }
 
 void MainFrame::OnEditPaste(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/) {
-    // TODO: Paste from clipboard
-    if (IsClipboardFormatAvailable(CF_UNICODETEXT)) {
-        if (OpenClipboard()) {
-            HANDLE hData = GetClipboardData(CF_UNICODETEXT);
-            if (hData) {
-                const wchar_t* text = static_cast<const wchar_t*>(GlobalLock(hData));
-                if (text && m_ptySession) {
-                    // Convert to UTF-8 and send to PTY
-                    int utf8Len = WideCharToMultiByte(CP_UTF8, 0, text, -1, nullptr, 0, nullptr, nullptr);
-                    if (utf8Len > 0) {
-                        std::string utf8(utf8Len, '\0');
-                        WideCharToMultiByte(CP_UTF8, 0, text, -1, utf8.data(), utf8Len, nullptr, nullptr);
-                        m_ptySession->Write(utf8.c_str(), utf8.length() - 1);  // Exclude null terminator
-                    }
-                }
-                GlobalUnlock(hData);
-            }
-            CloseClipboard();
-        }
+    // The view knows the bracketed paste mode and hands the text to the session
+    if (m_terminalView && m_terminalView->IsWindow()) {
+        m_terminalView->PasteFromClipboard();
+    }
+}
+
+void MainFrame::OnEditFindInTab(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/) {
+    if (!m_findBar.IsWindow()) {
+        return;
+    }
+    const bool wasOpen = m_findBar.IsOpen();
+    m_findBar.Open();
+    if (!wasOpen) {
+        UpdateChildLayout();
+    }
+}
+
+void MainFrame::OnEditFind(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/) {
+    if (!g_searchPanel) {
+        g_searchPanel = std::make_unique<SearchPanel>(
+            [](SearchPanel& panel) {
+                for (const MainFrame* frame : g_openWindows) {
+                    frame->AddSearchSources(panel);
+                }
+            },
+            &MainFrame::OpenSearchHit);
+    }
+    if (!g_searchPanel->Show() && m_statusBar.IsWindow()) {
+        m_statusBar.SetText(0, L"Failed to open Find in All Tabs");
     }
 }
 
 void MainFrame::OnViewSettings(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/) {
-    // TODO: Show settings dialog
-    MessageBoxW(L"Settings dialog not yet implemented.", L"Console3", MB_ICONINFORMATION);
+    // The dialog edits a copy; OK saves it and applies what changed the way
+    // a reload of the file does (the reload the save sets off finds nothing new)
+    Core::SettingsManager& manager = Core::SettingsManager::Shared();
+    Core::Settings edited = manager.GetSettings();
+    SettingsDialog dialog(edited);
+    if (dialog.DoModal(m_hWnd) != IDOK) {
+        return;
+    }
+
+    const Core::SettingsChanges changes = Core::Settings::Diff(manager.GetSettings(), edited);
+    manager.GetSettings() = std::move(edited);
+    const bool saved = manager.Save();
+    const std::wstring status = saved ? L"Settings applied"
+                                      : L"Settings applied, not saved: " + manager.GetLastError();
+    if (changes.Any()) {
+        ApplyChangedSettings(changes, status);
+    } else if (!saved && m_statusBar.IsWindow()) {
+        m_statusBar.SetText(0, status.c_str());
+    }
+}
+
+void MainFrame::OnViewSplit(UINT /*uNotifyCode*/, int nID, CWindow /*wndCtl*/) {
+    if (!SplitPane(nID == ID_VIEW_SPLIT_DOWN ? SplitDirection::Down : SplitDirection::Right) &&
+        m_statusBar.IsWindow()) {
+        m_statusBar.SetText(0, L"Failed to split the pane");
+    }
+}
+
+void MainFrame::OnViewClosePane(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/) {
+    // The first pane holds the window's session, which closes with the tab
+    if (m_terminalView) {
+        ClosePane(m_terminalView->GetFocusedPane());
+    }
+}
+
+void MainFrame::OnViewPauseOutput(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/) {
+    if (m_session) {
+        SetOutputPaused(!m_outputPaused);
+    }
 }
 
 void MainFrame::OnHelpAbout(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/) {
-    MessageBoxW(
+    ShowMessage(
         L"Console3 Terminal Emulator\n"
         L"Version 0.1.0\n\n"
         L"A modern Windows terminal emulator built with\n"
@@ -227,8 +1097,12 @@ bool MainFrame::CreateMenuBar() {
     CMenuHandle fileMenu;
     fileMenu.CreatePopupMenu();
     fileMenu.AppendMenuW(MF_STRING, ID_FILE_NEW_TAB, L"New &Tab\tCtrl+T");
+    fileMenu.AppendMenuW(MF_STRING, ID_FILE_NEW_WINDOW, L"New &Window\tCtrl+Shift+N");
+    fileMenu.AppendMenuW(MF_STRING, ID_FILE_DUPLICATE_TAB, L"&Duplicate Tab");
     fileMenu.AppendMenuW(MF_STRING, ID_FILE_CLOSE_TAB, L"&Close Tab\tCtrl+W");
     fileMenu.AppendMenuW(MF_SEPARATOR, 0, nullptr);
+    fileMenu.AppendMenuW(MF_STRING, ID_FILE_SAVE_SCROLLBACK, L"&Save Scrollback...");
+    fileMenu.AppendMenuW(MF_SEPARATOR, 0, nullptr);
     fileMenu.AppendMenuW(MF_STRING, ID_FILE_EXIT, L"E&xit\tAlt+F4");
     mainMenu.AppendMenuW(MF_POPUP, reinterpret_cast<UINT_PTR>(fileMenu.m_hMenu), L"&File");
 
@@ -238,12 +1112,18 @@ bool MainFrame::CreateMenuBar() {
     editMenu.AppendMenuW(MF_STRING, ID_EDIT_COPY, L"&Copy\tCtrl+Shift+C");
     editMenu.AppendMenuW(MF_STRING, ID_EDIT_PASTE, L"&Paste\tCtrl+Shift+V");
     editMenu.AppendMenuW(MF_SEPARATOR, 0, nullptr);
-    editMenu.AppendMenuW(MF_STRING, ID_EDIT_FIND, L"&Find...\tCtrl+Shift+F");
+    editMenu.AppendMenuW(MF_STRING, ID_EDIT_FIND_IN_TAB, L"&Find...\tCtrl+F");
+    editMenu.AppendMenuW(MF_STRING, ID_EDIT_FIND, L"Find in &All Tabs...\tCtrl+Shift+F");
     mainMenu.AppendMenuW(MF_POPUP, reinterpret_cast<UINT_PTR>(editMenu.m_hMenu), L"&Edit");
 
     // View menu
     CMenuHandle viewMenu;
     viewMenu.CreatePopupMenu();
+    viewMenu.AppendMenuW(MF_STRING, ID_VIEW_SPLIT_RIGHT, L"Split &Right");
+    viewMenu.AppendMenuW(MF_STRING, ID_VIEW_SPLIT_DOWN, L"Split &Down");
+    viewMenu.AppendMenuW(MF_STRING, ID_VIEW_CLOSE_PANE, L"&Close Pane");
+    viewMenu.AppendMenuW(MF_STRING, ID_VIEW_PAUSE_OUTPUT, L"&Pause Output\tScroll Lock");
+    viewMenu.AppendMenuW(MF_SEPARATOR, 0, nullptr);
     viewMenu.AppendMenuW(MF_STRING, ID_VIEW_SETTINGS, L"&Settings...");
     mainMenu.AppendMenuW(MF_POPUP, reinterpret_cast<UINT_PTR>(viewMenu.m_hMenu), L"&View");
 
@@ -280,69 +1160,990 @@ bool MainFrame::CreateStatusBar() {
     return true;
 }
 
+bool MainFrame::CreateTabBar() {
+    CRect rect;
+    GetClientRect(&rect);
+    rect.bottom = rect.top + m_tabBar.GetHeight();
+    if (!m_tabBar.Create(m_hWnd, rect, nullptr, WS_CHILD | WS_VISIBLE | WS_CLIPSIBLINGS)) {
+        return false;
+    }
+
+    // Narrower than the settings' minimum, the strip scrolls
+    const Core::TabSettings& tabs = GetSettings().tabs;
+    m_tabBar.SetTabWidthRange(tabs.tabWidthMin, tabs.tabWidthMax);
+    m_tabBar.SetEventCallback([this](TabEvent event, int tabId) { OnTabEvent(event, tabId); });
+    return true;
+}
+
+CRect MainFrame::GetViewRect() const {
+    CRect rect;
+    GetClientRect(&rect);
+    if (m_tabBar.IsWindow()) {
+        rect.top += m_tabBar.GetHeight();
+    }
+    if (m_findBar.IsWindow() && m_findBar.IsOpen()) {
+        rect.top += m_findBar.GetHeight();
+    }
+    if (m_statusBar.IsWindow()) {
+        CRect statusRect;
+        m_statusBar.GetWindowRect(&statusRect);
+        rect.bottom -= statusRect.Height();
+    }
+    rect.bottom = std::max(rect.bottom, rect.top);
+    return rect;
+}
+
+void MainFrame::UpdateChildLayout() {
+    CRect client;
+    GetClientRect(&client);
+    OnSize(SIZE_RESTORED, client.Size());
+}
+
 bool MainFrame::CreateTerminalView() {
-    // TODO: Create the terminal view window
-    // m_terminalView = std::make_unique<TerminalView>();
-    // return m_terminalView->Create(...);
+    // The view is the first user of the rendering factories; they are
+    // created here rather than before the window is shown
+    if (!RenderFactories::GetD2DFactory() || !RenderFactories::GetDWriteFactory()) {
+        ShowMessage(L"Failed to initialize Direct2D or DirectWrite.", L"Console3", MB_ICONERROR);
+        return false;
+    }
+
+    // Between the tab and status bars (OnSize keeps it there), on the
+    // backend the performance settings name, rendering on the window's
+    // render thread; sessions attach their buffers as their tabs come to
+    // the front
+    const CRect rect = GetViewRect();
+    const Core::Settings& settings = GetSettings();
+    m_terminalView = std::make_unique<TerminalView>();
+    m_terminalView->SetRenderThread(&m_renderThread);
+    if (!m_terminalView->Create(m_hWnd, rect, nullptr, WS_CHILD | WS_VISIBLE | WS_CLIPSIBLINGS) ||
+        !m_terminalView->Initialize(RenderFactories::GetD2DFactory(), RenderFactories::GetDWriteFactory(), nullptr,
+                                    ParseRenderBackend(settings.performance.renderer), settings.window.opacity)) {
+        if (m_terminalView->IsWindow()) {
+            m_terminalView->DestroyWindow();
+        }
+        m_terminalView.reset();
+        ShowMessage(L"Failed to create the terminal view.", L"Console3", MB_ICONERROR);
+        return false;
+    }
+
+    m_terminalView->SetColorScheme(settings.colorScheme);
+    m_terminalView->SetCursorStyle(ParseCursorStyle(settings.cursor.style));
+    m_terminalView->SetCursorBlinkRate(settings.cursor.blink ? settings.cursor.blinkRate : 0);
+    ApplyFont();
+    ApplyViewPerformance();
     return true;
 }
 
+Core::SessionConfig MainFrame::MakeSessionConfig() const {
+    // Configure the session (PTY, output buffer, VTerm and terminal buffer)
+    Core::SessionConfig sessionConfig;
+    sessionConfig.shell = L"cmd.exe";  // Default to cmd.exe
+    sessionConfig.workingDir = m_workingDir;
+    sessionConfig.rows = 25;
+    sessionConfig.cols = 80;
+    sessionConfig.scrollbackLines = static_cast<size_t>(std::max(GetSettings().scrollbackLines, 0));
+    sessionConfig.scrollbackToDisk = GetSettings().scrollbackToDisk;
+    sessionConfig.scrollbackInternLines = GetSettings().scrollbackInternLines;
+    sessionConfig.scrollbackTimestamps = GetSettings().scrollbackTimestamps;
+    sessionConfig.emulationThread = true;  // Keep parsing off the UI thread
+    sessionConfig.sharedEmulation = true;  // On the scheduler's pool, shared with other sessions
+    sessionConfig.emulationBackend = Emulation::EmulationBackend::Grid;  // One copy of the screen
+    sessionConfig.frontParser = true;      // Common sequences skip libvterm's byte-at-a-time parser
+    sessionConfig.priority = Core::SessionPriority::Focused;
+    sessionConfig.outputRules = GetSettings().outputRules;
+    ConfigurePerformance(sessionConfig, GetSettings().performance);
+    ConfigureOutputLog(sessionConfig, GetSettings().outputLog);
+    return sessionConfig;
+}
+
 bool MainFrame::StartNewSession() {
-    // Create terminal buffer
-    Core::TerminalBufferConfig bufferConfig;
-    bufferConfig.rows = 25;
-    bufferConfig.cols = 80;
-    bufferConfig.scrollbackLines = 10000;
-    
-    try {
-        m_terminalBuffer = std::make_unique<Core::TerminalBuffer>(bufferConfig);
-    } catch (const std::exception& e) {
-        // Handle error
+    Core::SessionConfig sessionConfig = MakeSessionConfig();
+    sessionConfig.hostPipe = m_hostPipe;
+    sessionConfig.logPath = m_logPath;
+    sessionConfig.serial = m_serial;
+    if (!m_serial.port.empty()) {
+        sessionConfig.title = m_serial.port;
+    }
+    sessionConfig.shareHistory = m_history;
+    if (!m_hostPipe.empty() || !m_logPath.empty()) {
+        sessionConfig.recordPath.clear();  // Logged by the host, or a log already
+    }
+
+    // Sized to the view's grid, so the shell's first output fits it
+    if (m_terminalView) {
+        sessionConfig.rows = m_terminalView->GetTerminalRows();
+        sessionConfig.cols = m_terminalView->GetTerminalCols();
+    }
+
+    // The last run's session comes back where it was, its output in the
+    // scrollback
+    if (m_saved) {
+        const Core::SessionConfig& saved = m_saved->config;
+        sessionConfig.shell = saved.shell;
+        sessionConfig.args = saved.args;
+        sessionConfig.workingDir = saved.workingDir;
+        sessionConfig.title = saved.title;
+        sessionConfig.profileName = saved.profileName;
+        sessionConfig.rows = saved.rows;
+        sessionConfig.cols = saved.cols;
+        sessionConfig.scrollbackLines = saved.scrollbackLines;
+        sessionConfig.restoreHistory = saved.restoreHistory;
+    }
+
+    m_session = std::make_unique<Core::Session>();
+
+    // Report the exit on the UI thread. Runs on the transport thread, and
+    // may run after the session is retired (and the window gone), so it
+    // only posts; the serial tells a replaced session's exit apart.
+    m_session->SetExitCallback([hWnd = m_hWnd, serial = (m_sessionSerial = ++m_lastSerial)](DWORD exitCode) {
+        ::PostMessageW(hWnd, kSessionExitedMessage, exitCode, serial);
+    });
+
+    // Start the session, on a shell the pool started ahead if one is ready
+    // (an attached window, a log view or a serial port runs no shell; a
+    // warm shell's output began before a log could take it)
+    Core::WarmShell warm;
+    if (m_hostPipe.empty() && m_logPath.empty() && m_serial.port.empty() && sessionConfig.recordPath.empty()) {
+        warm = Core::WarmShellPool::Shared().Take(Core::Session::GetPtyConfig(sessionConfig),
+                                                  sessionConfig.outputBufferSize);
+    }
+    if (!m_session->Start(sessionConfig, std::move(warm))) {
+        std::wstring error = !m_hostPipe.empty() ? L"Failed to attach to " + m_hostPipe
+                           : !m_logPath.empty() ? L"Failed to open " + m_logPath
+                           : !m_serial.port.empty() ? std::wstring(L"Failed to open the serial port")
+                                                : std::wstring(L"Failed to start PTY");
+        if (auto* pty = m_session->GetPty()) {
+            error += L": " + pty->GetLastError();
+        }
+        ShowMessage(error.c_str(), L"Console3", MB_ICONERROR);
+        m_session.reset();
         return false;
     }
 
-    // Create VTerm wrapper
-    try {
-        m_vtermWrapper = std::make_unique<Emulation::VTermWrapper>(
-            bufferConfig.rows, bufferConfig.cols);
-    } catch (const std::exception& e) {
+    // Present parsed frames on the render thread, at most once per wakeup
+    Core::Session* raw = m_session.get();
+    m_renderThread.AddWaitHandle(raw->GetOutputEvent(), [this, raw]() { OnSessionOutput(*raw); });
+
+    return true;
+}
+
+void MainFrame::AttachSession() {
+    if (!m_session) {
+        return;
+    }
+
+    // Show fast-forward in the status bar; the timer ends it after the flood.
+    // Runs where output is applied (the render thread), so it only posts.
+    m_session->SetFastForwardCallback([hWnd = m_hWnd](bool active) {
+        ::PostMessageW(hWnd, kFastForwardMessage, active ? 1 : 0, 0);
+    });
+
+    // The view shows the session's buffer and encodes input by its
+    // emulator's modes; a restored session, or one whose tab was behind
+    // while the window was resized, takes the view's size
+    if (m_terminalView) {
+        m_terminalView->SetBuffer(m_session->GetBuffer());
+        m_terminalView->SetVTerm(m_session->GetVTerm());
+        const int rows = m_terminalView->GetTerminalRows();
+        const int cols = m_terminalView->GetTerminalCols();
+        if (rows > 0 && cols > 0 && (rows != m_session->GetRows() || cols != m_session->GetCols()) &&
+            m_session->IsRunning()) {
+            m_session->Resize(cols, rows);
+        }
+
+        // Telemetry for the hidden diagnostics overlay (Ctrl+Shift+F12); grid
+        // size changes resize the PTY, emulator and buffer together
+        m_terminalView->SetResizeCallback([this](int cols, int rows) {
+            if (m_session && m_session->IsRunning()) {
+                m_session->Resize(cols, rows);
+            }
+        });
+        m_terminalView->SetDiagnosticsSource([this]() {
+            const Core::Session* session = GetFocusedSession();
+            return session ? session->GetStats() : Core::SessionStats{};
+        });
+        m_terminalView->SetPasteCallback([this](std::wstring text, bool bracketed) {
+            if (m_session && m_session->Paste(std::move(text), bracketed)) {
+                SetTimer(kPasteTimerId, kPasteTimerMs);
+                UpdatePaste();
+            }
+        });
+        m_terminalView->SetMouseInputCallback([this](const Emulation::MouseEvent& event) {
+            if (m_session) {
+                m_session->QueueMouseInput(event);
+            }
+        });
+        // Keys come batched, a burst of them in one write to the input writer
+        m_terminalView->SetKeyboardInputCallback([this](const char* data, size_t length) {
+            if (m_session) {
+                (void)m_session->Write(data, length);
+            }
+        });
+
+        // Its panes are split off again in the order they were opened (the
+        // view kept no layout for a tab behind); the first pane has the focus
+        for (PaneSession& entry : m_paneSessions) {
+            entry.pane = m_terminalView->SplitPane(entry.direction, MakePaneBinding(*entry.session));
+        }
+        if (!m_paneSessions.empty()) {
+            m_terminalView->SetPaneFocusCallback([this](uint32_t /*pane*/) { BindFocusedSession(); });
+            m_terminalView->FocusPane(PaneLayout::kFirstPane);
+        }
+        BindFocusedSession();
+    }
+    UpdateSessionPriority(GetForegroundWindow() == m_hWnd);
+
+    // An export or paste left running behind goes on
+    if (m_session->GetExport().IsActive()) {
+        SetTimer(kExportTimerId, kExportTimerMs);
+    }
+    if (m_session->IsPasting()) {
+        SetTimer(kPasteTimerId, kPasteTimerMs);
+    }
+}
+
+void MainFrame::OnSessionOutput(Core::Session& session) {
+    session.ProcessOutput();
+
+    // Mid synchronized update: paint once the application ends it, or at
+    // the timeout (kOutputMessage sets the timer)
+    if (m_terminalView && m_terminalView->IsWindow() && session.GetPresentHoldMs() == 0) {
+        m_terminalView->Invalidate();
+    }
+    if (!m_outputPosted.exchange(true)) {
+        ::PostMessageW(m_hWnd, kOutputMessage, 0, 0);
+    }
+}
+
+void MainFrame::StopSession() {
+    if (!m_session) {
+        return;
+    }
+    if (m_outputPaused) {
+        SetOutputPaused(false);
+    }
+    ClosePanes();
+    DetachSession();
+
+    // Closing the pseudo console and joining the session's threads can take
+    // seconds with a busy shell; the window doesn't wait for it
+    RetireSession(std::move(m_session));
+}
+
+void MainFrame::DetachSession() {
+    if (!m_session) {
+        return;
+    }
+    if (m_outputPaused) {
+        SetOutputPaused(false);
+    }
+
+    // The view may keep a frame of the buffer, keyed by its address; a tab
+    // going behind keeps its panes' sessions, not their places on the view
+    if (m_terminalView) {
+        for (const PaneSession& entry : m_paneSessions) {
+            m_terminalView->ClosePane(entry.pane);
+        }
+        m_terminalView->SetBuffer(nullptr);
+        m_terminalView->SetVTerm(nullptr);
+        m_terminalView->ForgetBuffer(m_session->GetBuffer());
+        m_terminalView->SetInputLatencyProbe(nullptr);
+        m_terminalView->SetTraceSessionId(0);
+        m_terminalView->SetHyperlinks(nullptr);
+        m_terminalView->SetOutputRules(nullptr);
+        m_terminalView->SetPasteCallback(nullptr);
+        m_terminalView->SetMouseInputCallback(nullptr);
+        m_terminalView->SetKeyboardInputCallback(nullptr);
+        m_terminalView->SetMouseMode(MouseMode::None);
+        m_terminalView->SetKeyboardModes({});
+    }
+    m_session->SetFastForwardCallback(nullptr);
+
+    if (IsWindow()) {
+        KillTimer(kFastForwardTimerId);
+        KillTimer(kExportTimerId);
+        KillTimer(kPasteTimerId);
+        KillTimer(kHibernateTimerId);
+        KillTimer(kSyncOutputTimerId);
+    }
+    Core::IdleScheduler::Shared().Cancel(m_hibernateTask);
+    m_hibernateTask = 0;
+    if (m_statusBar.IsWindow()) {
+        m_statusBar.SetText(kStatusPartMode, L"");
+        m_statusBar.SetText(kStatusPartMemory, L"");
+    }
+}
+
+void MainFrame::SendSessionToBack() {
+    if (!m_session) {
+        return;
+    }
+    DetachSession();
+
+    // Behind, its sessions parse like a minimized window's
+    const Core::SessionPriority priority = GetSettings().performance.throttleBackground
+                                               ? Core::SessionPriority::Background
+                                               : Core::SessionPriority::Visible;
+    m_session->SetPriority(priority);
+    for (PaneSession& entry : m_paneSessions) {
+        entry.session->SetPriority(priority);
+    }
+
+    m_backgroundTabs.push_back(BackgroundTab{m_activeTab, std::move(m_session), std::move(m_paneSessions),
+                                             m_sessionSerial});
+    m_paneSessions.clear();
+    m_activeTab = 0;
+}
+
+void MainFrame::CloseBackgroundTabs() {
+    std::vector<BackgroundTab> tabs = std::move(m_backgroundTabs);
+    m_backgroundTabs.clear();
+    for (BackgroundTab& tab : tabs) {
+        for (PaneSession& entry : tab.panes) {
+            RetireSession(std::move(entry.session));
+        }
+        RetireSession(std::move(tab.session));
+    }
+}
+
+void MainFrame::RetireSession(std::unique_ptr<Core::Session> session) {
+    m_renderThread.RemoveWaitHandle(session->GetOutputEvent());
+    m_findBar.ForgetSession(*session);
+    if (g_searchPanel) {
+        g_searchPanel->RemoveSource(session->GetTraceId());
+    }
+    Core::SessionReaper::Shared().Retire(std::move(session));
+}
+
+// ============================================================================
+// Tabs
+// ============================================================================
+
+bool MainFrame::OpenTab() {
+    // The tab in front keeps running behind the new one, and comes back if
+    // the new one can't start
+    const int previous = m_activeTab;
+    SendSessionToBack();
+    if (!StartNewSession()) {
+        if (previous != 0) {
+            ActivateTab(previous);
+        }
         return false;
     }
 
-    // Create PTY session
-    m_ptySession = std::make_unique<Core::PtySession>();
+    // Selecting it finds nothing behind to bring forward (see ActivateTab)
+    const Core::SessionConfig config = m_session->GetConfig();
+    std::wstring title = !config.title.empty() ? config.title : std::filesystem::path(config.shell).stem().wstring();
+    if (title.empty()) {
+        title = L"Tab";
+    }
+    m_activeTab = m_tabBar.AddTab(title, m_session.get());
+    m_tabBar.SelectTabById(m_activeTab);
+    AttachSession();
+    return true;
+}
+
+void MainFrame::CloseTab(int tabId) {
+    const auto findTab = [this, tabId] {
+        return std::find_if(m_backgroundTabs.begin(), m_backgroundTabs.end(),
+                            [tabId](const BackgroundTab& tab) { return tab.tabId == tabId; });
+    };
+    if (tabId != m_activeTab && findTab() == m_backgroundTabs.end()) {
+        return;
+    }
+
+    if (GetSettings().tabs.confirmTabClose) {
+        const Core::Session* session = tabId == m_activeTab ? m_session.get() : findTab()->session.get();
+        if (session && session->IsRunning() &&
+            ShowMessage(L"The tab's session is still running.\nClose it anyway?", L"Console3",
+                        MB_YESNO | MB_ICONQUESTION) != IDYES) {
+            return;
+        }
+    }
+
+    // The message box's loop may have closed it meanwhile
+    if (tabId == m_activeTab) {
+        StopSession();
+        m_activeTab = 0;
+    } else if (const auto found = findTab(); found != m_backgroundTabs.end()) {
+        BackgroundTab tab = std::move(*found);
+        m_backgroundTabs.erase(found);
+        for (PaneSession& entry : tab.panes) {
+            RetireSession(std::move(entry.session));
+        }
+        RetireSession(std::move(tab.session));
+    } else {
+        return;
+    }
+
+    // Closing the tab in front, the strip selects a neighbour (ActivateTab)
+    m_tabBar.RemoveTab(tabId);
+    if (m_tabBar.GetTabCount() == 0) {
+        if (GetSettings().tabs.closeLastTabAction == L"newTab" && OpenTab()) {
+            return;
+        }
+        PostMessage(WM_CLOSE);
+    }
+}
+
+void MainFrame::ActivateTab(int tabId) {
+    // A tab just opened has nothing behind; OpenTab brings its session in
+    const auto found = std::find_if(m_backgroundTabs.begin(), m_backgroundTabs.end(),
+                                    [tabId](const BackgroundTab& tab) { return tab.tabId == tabId; });
+    if (tabId == m_activeTab || found == m_backgroundTabs.end()) {
+        return;
+    }
+    BackgroundTab tab = std::move(*found);
+    m_backgroundTabs.erase(found);
 
-    // Configure and start PTY
-    Core::PtyConfig ptyConfig;
-    ptyConfig.shell = L"cmd.exe";  // Default to cmd.exe
-    ptyConfig.cols = bufferConfig.cols;
-    ptyConfig.rows = bufferConfig.rows;
+    SendSessionToBack();
+    m_session = std::move(tab.session);
+    m_paneSessions = std::move(tab.panes);
+    m_sessionSerial = tab.serial;
+    m_activeTab = tabId;
+    AttachSession();
+}
 
-    // Set up output callback to feed VTerm
-    m_ptySession->SetOutputCallback([this](const char* data, size_t len) {
-        if (m_vtermWrapper) {
-            m_vtermWrapper->InputWrite(data, len);
-            // TODO: Update terminal view
+void MainFrame::OnTabEvent(TabEvent event, int tabId) {
+    switch (event) {
+    case TabEvent::Selected:
+        ActivateTab(tabId);
+        break;
+    case TabEvent::Closed:
+        CloseTab(tabId);
+        break;
+    case TabEvent::NewTab:
+        if (!OpenTab() && m_statusBar.IsWindow()) {
+            m_statusBar.SetText(0, L"Failed to open a new tab");
         }
+        break;
+    case TabEvent::Reordered:
+    case TabEvent::ContextMenu:
+        break;
+    }
+}
+
+bool MainFrame::SplitPane(SplitDirection direction) {
+    if (!m_session || !m_terminalView || !m_terminalView->IsWindow()) {
+        return false;
+    }
+
+    // A shell of its own, on a warm one if the pool has it; split from an
+    // attached window, the new pane still runs locally
+    const Core::SessionConfig sessionConfig = MakeSessionConfig();
+    auto session = std::make_unique<Core::Session>();
+    Core::WarmShell warm;
+    if (sessionConfig.recordPath.empty()) {
+        warm = Core::WarmShellPool::Shared().Take(Core::Session::GetPtyConfig(sessionConfig),
+                                                  sessionConfig.outputBufferSize);
+    }
+    if (!session->Start(sessionConfig, std::move(warm))) {
+        return false;
+    }
+
+    // The entry outlives the view's pane, which ClosePane() closes first
+    Core::Session* raw = session.get();
+    const uint32_t pane = m_terminalView->SplitPane(direction, MakePaneBinding(*raw));
+    if (pane == 0) {
+        Core::SessionReaper::Shared().Retire(std::move(session));
+        return false;
+    }
+
+    raw->SetExitCallback([hWnd = m_hWnd, traceId = raw->GetTraceId()](DWORD exitCode) {
+        ::PostMessageW(hWnd, kPaneExitedMessage, exitCode, traceId);
     });
+    m_renderThread.AddWaitHandle(raw->GetOutputEvent(), [this, raw]() { OnSessionOutput(*raw); });
+    raw->SetOutputPaused(m_outputPaused);
+    m_paneSessions.push_back(PaneSession{pane, direction, std::move(session)});
+
+    // The new pane has the focus; the view tells of later moves
+    m_terminalView->SetPaneFocusCallback([this](uint32_t /*pane*/) { BindFocusedSession(); });
+    BindFocusedSession();
+    return true;
+}
 
-    // Set up exit callback
-    m_ptySession->SetExitCallback([this](DWORD exitCode) {
-        // Update status bar
+void MainFrame::ClosePane(uint32_t pane) {
+    const auto found = std::find_if(m_paneSessions.begin(), m_paneSessions.end(),
+                                    [pane](const PaneSession& entry) { return entry.pane == pane; });
+    if (found == m_paneSessions.end()) {
+        return;
+    }
+    std::unique_ptr<Core::Session> session = std::move(found->session);
+    m_paneSessions.erase(found);
+
+    if (m_terminalView) {
+        m_terminalView->ClosePane(pane);
+        BindFocusedSession();
+    }
+    RetireSession(std::move(session));
+}
+
+void MainFrame::ClosePanes() {
+    while (!m_paneSessions.empty()) {
+        ClosePane(m_paneSessions.back().pane);
+    }
+}
+
+Core::Session* MainFrame::GetFocusedSession() const {
+    if (m_terminalView) {
+        const uint32_t pane = m_terminalView->GetFocusedPane();
+        for (const PaneSession& entry : m_paneSessions) {
+            if (entry.pane == pane) {
+                return entry.session.get();
+            }
+        }
+    }
+    return m_session.get();
+}
+
+void MainFrame::AddSearchSources(SearchPanel& panel) const {
+    wchar_t title[128] = L"";
+    ::GetWindowTextW(m_hWnd, title, static_cast<int>(std::size(title)));
+    if (m_session) {
+        if (const Core::TerminalBuffer* buffer = m_session->GetBuffer()) {
+            panel.AddSource(m_session->GetTraceId(), title, *buffer);
+        }
+    }
+    for (const PaneSession& entry : m_paneSessions) {
+        if (const Core::TerminalBuffer* buffer = entry.session->GetBuffer()) {
+            panel.AddSource(entry.session->GetTraceId(),
+                            std::wstring(title) + L" (pane " + std::to_wstring(entry.pane) + L")", *buffer);
+        }
+    }
+}
+
+void MainFrame::ApplyTelemetry() {
+    Core::TelemetryEndpoint& endpoint = Core::TelemetryEndpoint::Shared();
+    if (GetSettings().telemetryEndpoint && !g_openWindows.empty()) {
+        // The pipe is named after the process, so only failing to make it
+        // keeps it from starting; the agent sees no pipe either way
+        (void)endpoint.Start([] { return CollectTelemetry(); });
+        return;
+    }
+    if (endpoint.IsRunning()) {
+        // Its thread may be waiting for the render lock to collect
+        RenderLock::Unlocked unlocked(RenderLock::Shared());
+        endpoint.Stop();
+    }
+}
+
+void MainFrame::OpenSearchHit(const Core::GlobalSearchHit& hit) {
+    for (MainFrame* frame : g_openWindows) {
+        // The hit's session: the window's, or one of its panes'
+        uint32_t pane = 0;
+        Core::Session* session = nullptr;
+        if (frame->m_session && frame->m_session->GetTraceId() == hit.source) {
+            pane = PaneLayout::kFirstPane;
+            session = frame->m_session.get();
+        }
+        for (const PaneSession& entry : frame->m_paneSessions) {
+            if (entry.session->GetTraceId() == hit.source) {
+                pane = entry.pane;
+                session = entry.session.get();
+            }
+        }
+        if (!session) {
+            continue;
+        }
+
+        // A cleared or re-wrapped history numbers its lines anew
+        const Core::TerminalBuffer* buffer = session->GetBuffer();
+        const bool found = buffer && buffer->GetScrollbackEpoch() == hit.epoch;
+        if (frame->IsIconic()) {
+            frame->ShowWindow(SW_RESTORE);
+        }
+        ::SetForegroundWindow(frame->m_hWnd);
+        if (frame->m_terminalView && frame->m_terminalView->IsWindow()) {
+            if (frame->m_terminalView->GetFocusedPane() != pane) {
+                frame->m_terminalView->FocusPane(pane);
+            }
+            if (found && frame->m_terminalView->RevealMatch(hit.line, hit.offset, hit.length)) {
+                return;
+            }
+        }
+        if (frame->m_statusBar.IsWindow()) {
+            frame->m_statusBar.SetText(0, L"The line found is no longer in the history");
+        }
+        return;
+    }
+}
+
+void MainFrame::BindFocusedSession() {
+    Core::Session* session = GetFocusedSession();
+    m_findBar.SetSession(session);
+    if (!m_terminalView || !session) {
+        return;
+    }
+    m_terminalView->SetInputLatencyProbe(&session->GetInputLatency());
+    m_terminalView->SetTraceSessionId(session->GetTraceId());
+    m_terminalView->SetHyperlinks(&session->GetHyperlinks());
+    m_terminalView->SetOutputRules(&session->GetOutputRules());
+    UpdateViewModes();
+}
+
+void MainFrame::UpdateViewModes() {
+    if (const Core::Session* session = GetFocusedSession()) {
+        m_terminalView->SetMouseMode(static_cast<MouseMode>(session->GetMouseMode()));
+        m_terminalView->SetKeyboardModes(session->GetKeyboardModes());
+    }
+}
+
+Core::SessionMemory MainFrame::GetMemory() const {
+    Core::SessionMemory memory = m_session->GetMemory();
+    if (m_terminalView && m_terminalView->IsWindow()) {
+        m_terminalView->GetRenderMemory(memory);
+    }
+    return memory;
+}
+
+void MainFrame::UpdateMemory() {
+    if (!m_session || !m_statusBar.IsWindow()) {
+        return;
+    }
+
+    // Every tab's scrollback counts against the shared budget, when there is one
+    const Core::SessionMemory memory = GetMemory();
+    std::wstring text = L"Memory " + Core::FormatBytes(memory.GetResidentBytes()) + L"  (scrollback " +
+                        Core::FormatBytes(memory.scrollbackHotBytes + memory.scrollbackColdBytes) + L", render " +
+                        Core::FormatBytes(memory.frameBytes + memory.atlasBytes) + L")";
+    const Core::ScrollbackBudget& budget = Core::ScrollbackBudget::Shared();
+    if (budget.GetLimit() != 0) {
+        text += L"  All tabs' scrollback " + Core::FormatBytes(budget.GetUsage()) + L" of " +
+                Core::FormatBytes(budget.GetLimit());
+    }
+    m_statusBar.SetText(kStatusPartMemory, text.c_str());
+}
+
+void MainFrame::OnSettingsFileChanged() {
+    // An editor's save is often several writes: the oldest window's timer
+    // restarts on each, and reloads once they stop
+    if (!g_openWindows.empty()) {
+        g_openWindows.front()->SetTimer(kSettingsTimerId, kSettingsTimerMs);
+    }
+}
+
+void MainFrame::ReloadSettings() {
+    Core::SettingsManager& manager = Core::SettingsManager::Shared();
+    const std::optional<Core::SettingsChanges> changes = manager.Reload();
+    if (!changes) {
+        const std::wstring text = L"Settings not applied: " + manager.GetLastError();
+        for (MainFrame* frame : g_openWindows) {
+            if (frame->m_statusBar.IsWindow()) {
+                frame->m_statusBar.SetText(0, text.c_str());
+            }
+        }
+        return;
+    }
+    if (!changes->Any()) {
+        return;
+    }
+
+    // Values the file had out of range are applied corrected; a window's
+    // own problem (a missing font) replaces the message
+    ApplyChangedSettings(*changes, manager.GetWarnings().empty()
+                                       ? L"Settings applied"
+                                       : L"Settings applied: " + manager.GetWarnings().front());
+}
+
+void MainFrame::ApplyChangedSettings(const Core::SettingsChanges& changes, const std::wstring& status) {
+    // Process-wide first; the budget evicts at once if it was lowered
+    const Core::Settings& settings = GetSettings();
+    if (changes.scrollbackBudget) {
+        Core::ScrollbackBudget::Shared().SetLimit(static_cast<size_t>(std::max(settings.scrollbackBudgetMB, 0))
+                                                  << 20);
+    }
+    if (changes.warmShells) {
+        Core::WarmShellPool::Shared().Configure(static_cast<size_t>(std::max(settings.warmShellsPerProfile, 0)),
+                                                static_cast<size_t>(std::max(settings.warmShellMinFreeMB, 0)));
+    }
+    if (changes.telemetry) {
+        ApplyTelemetry();
+    }
+
+    for (MainFrame* frame : g_openWindows) {
+        if (frame->m_statusBar.IsWindow()) {
+            frame->m_statusBar.SetText(0, status.c_str());
+        }
+        frame->ApplySettings(settings, changes);
+    }
+}
+
+void MainFrame::ApplySettings(const Core::Settings& settings, const Core::SettingsChanges& changes) {
+    if (m_terminalView && m_terminalView->IsWindow()) {
+        if (changes.colors) {
+            m_terminalView->SetColorScheme(settings.colorScheme);
+        }
+        if (changes.cursor) {
+            m_terminalView->SetCursorStyle(ParseCursorStyle(settings.cursor.style));
+            m_terminalView->SetCursorBlinkRate(settings.cursor.blink ? settings.cursor.blinkRate : 0);
+        }
+        if (changes.font) {
+            m_fontPending = true;
+            if (!m_terminalView->IsHidden()) {
+                ApplyFont();
+            }
+        }
+    }
+
+    if (changes.transparency) {
+        ApplyTransparency();
+    }
+
+    if (changes.telemetry && m_terminalView && m_terminalView->IsWindow()) {
+        m_terminalView->MeasureInputLatency(settings.telemetryEndpoint);
+    }
+
+    if (changes.performance) {
+        if (m_terminalView && m_terminalView->IsWindow()) {
+            ApplyViewPerformance();
+        } else {
+            ApplyPowerPolicy();
+        }
+        ReconfigureSessions();
+        UpdateSessionPriority(GetForegroundWindow() == m_hWnd);
+    }
+
+    if (changes.other && m_tabBar.IsWindow()) {
+        m_tabBar.SetTabWidthRange(settings.tabs.tabWidthMin, settings.tabs.tabWidthMax);
+    }
+
+    // Raised at once; lowered, the lines over it go at idle (OnIdle)
+    if (changes.scrollback && m_session) {
+        if (Core::TerminalBuffer* buffer = m_session->GetBuffer()) {
+            buffer->SetMaxScrollbackDeferred(static_cast<size_t>(std::max(settings.scrollbackLines, 0)));
+        }
+    }
+
+}
+
+void MainFrame::ReconfigureSessions() {
+    Core::SessionConfig config;
+    ConfigurePerformance(config, GetSettings().performance);
+    const auto reconfigure = [&config](std::vector<PaneSession>& panes) {
+        for (PaneSession& entry : panes) {
+            entry.session->Reconfigure(config);
+        }
+    };
+    if (m_session) {
+        m_session->Reconfigure(config);
+    }
+    reconfigure(m_paneSessions);
+    for (BackgroundTab& tab : m_backgroundTabs) {
+        tab.session->Reconfigure(config);
+        reconfigure(tab.panes);
+    }
+}
+
+void MainFrame::ApplyViewPerformance() {
+    const Core::PerformanceSettings& performance = GetSettings().performance;
+    m_terminalView->SetMaxFrameRate(static_cast<unsigned>(performance.maxFps));
+    (void)m_terminalView->SetCellGridShader(performance.cellGridShader);
+    m_terminalView->SetGpuPreference(ParseGpuPreference(performance.gpu));
+    m_terminalView->SetPredictiveEcho(performance.predictiveEcho);
+    m_terminalView->MeasureInputLatency(GetSettings().telemetryEndpoint);
+    ApplyPowerPolicy();
+}
+
+void MainFrame::ApplyPowerPolicy() {
+    // Every window gets the notices, and sets the same state
+    const bool saving = GetSettings().performance.saveBatteryPower && (g_onBattery || g_batterySaver);
+    Core::SessionScheduler::Instance().SetBackgroundBatching(saving ? kPowerSavingBatchMs : 0);
+    if (m_terminalView && m_terminalView->IsWindow()) {
+        m_terminalView->SetPowerSaving(saving);
+    }
+}
+
+void MainFrame::ApplyTransparency() {
+    const Core::WindowSettings& window = GetSettings().window;
+    const DWORD backdrop = window.useAcrylic ? kBackdropAcrylic : kBackdropNone;
+    (void)DwmSetWindowAttribute(m_hWnd, kDwmSystemBackdropType, &backdrop, sizeof(backdrop));
+    UpdateBackdropMargins();
+
+    if (m_terminalView && m_terminalView->IsWindow() && !m_terminalView->SetOpacity(window.opacity) &&
+        m_statusBar.IsWindow()) {
+        m_statusBar.SetText(0, L"Transparency needs the GPU renderer");
+    }
+}
+
+void MainFrame::UpdateBackdropMargins() {
+    // Down to the status bar, which stays opaque; the menu bar is outside
+    // the client area
+    MARGINS margins{};
+    if (GetSettings().window.opacity < 1.0f) {
+        CRect client;
+        GetClientRect(&client);
+        CRect status;
         if (m_statusBar.IsWindow()) {
-            std::wstring msg = L"Process exited with code: " + std::to_wstring(exitCode);
-            m_statusBar.SetText(0, msg.c_str());
+            m_statusBar.GetWindowRect(&status);
         }
-    });
+        margins.cyTopHeight = std::max(static_cast<int>(client.Height() - status.Height()), 0);
+    }
+    (void)DwmExtendFrameIntoClientArea(m_hWnd, &margins);
+}
+
+void MainFrame::ApplyFont() {
+    m_fontPending = false;
+    const Core::FontSettings& font = GetSettings().font;
+    m_terminalView->SetLigatures(font.ligatures);
+    if (!m_terminalView->SetFont(font.family, font.size) && m_statusBar.IsWindow()) {
+        m_statusBar.SetText(0, (L"Font not available: " + font.family).c_str());
+    }
+}
+
+void MainFrame::UpdatePaste() {
+    if (!m_session || !m_session->IsPasting()) {
+        KillTimer(kPasteTimerId);
+        if (m_statusBar.IsWindow()) {
+            m_statusBar.SetText(0, L"");
+        }
+        return;
+    }
+    if (!m_statusBar.IsWindow()) {
+        return;
+    }
+
+    const Core::PasteProgress progress = m_session->GetPasteProgress();
+    const uint64_t percent = progress.unitsTotal ? progress.unitsSent * 100 / progress.unitsTotal : 0;
+    wchar_t text[128];
+    swprintf_s(text, L"Pasting: %llu%% (Esc to cancel)", static_cast<unsigned long long>(percent));
+    m_statusBar.SetText(0, text);
+}
+
+void MainFrame::OnOutputRuleEvents() {
+    std::vector<Core::RuleEvent> events;
+    if (!m_session || !m_session->GetOutputRules().TakeEvents(events)) {
+        return;
+    }
+
+    // One bell for however many lines matched since the last wakeup
+    MessageBeep(MB_ICONASTERISK);
+    if (GetForegroundWindow() != m_hWnd) {
+        FLASHWINFO flash{sizeof(flash), m_hWnd, FLASHW_TRAY | FLASHW_TIMERNOFG, 0, 0};
+        FlashWindowEx(&flash);
+    }
+}
+
+void MainFrame::UpdateSessionPriority(bool active) {
+    // A minimized window neither syncs its screen nor renders; restoring it
+    // does both once
+    const bool hidden = IsIconic() != FALSE;
+    m_renderThread.SetForeground(active && !hidden);
+    if (m_terminalView && m_terminalView->IsWindow()) {
+        m_terminalView->SetHidden(hidden);
+        if (!hidden && m_fontPending) {
+            ApplyFont();
+        }
+    }
+    // Unthrottled, a minimized session keeps parsing like a visible one
+    if (m_session) {
+        const bool background = hidden && GetSettings().performance.throttleBackground;
+        m_session->SetPriority(background ? Core::SessionPriority::Background
+                               : active   ? Core::SessionPriority::Focused
+                                          : Core::SessionPriority::Visible);
+    }
+
+    // Only a hidden session hibernates; showing it needs nothing undone
+    if (hidden && m_session && GetSettings().hibernateAfterMinutes > 0) {
+        SetTimer(kHibernateTimerId, kHibernateTimerMs);
+    } else {
+        KillTimer(kHibernateTimerId);
+    }
+}
+
+void MainFrame::SetOutputPaused(bool paused) {
+    m_outputPaused = paused;
+    if (m_session) {
+        m_session->SetOutputPaused(paused);
+    }
+    for (PaneSession& pane : m_paneSessions) {
+        pane.session->SetOutputPaused(paused);
+    }
+
+    UISetCheck(ID_VIEW_PAUSE_OUTPUT, paused);
+    if (m_statusBar.IsWindow()) {
+        m_statusBar.SetText(kStatusPartMode, paused ? kPausedStatus : L"");
+    }
+
+    // The title (and so the taskbar button) says so too
+    std::wstring caption(static_cast<size_t>(GetWindowTextLengthW()) + 1, L'\0');
+    caption.resize(static_cast<size_t>(GetWindowTextW(caption.data(), static_cast<int>(caption.size()))));
+    if (caption.starts_with(kPausedCaption)) {
+        caption.erase(0, kPausedCaption.size());
+    }
+    if (paused) {
+        caption.insert(0, kPausedCaption);
+    }
+    SetWindowTextW(caption.c_str());
+}
+
+void MainFrame::UpdateHibernation() {
+    if (!m_session || !m_terminalView || !m_terminalView->IsHidden() || GetSettings().hibernateAfterMinutes <= 0) {
+        KillTimer(kHibernateTimerId);
+        return;
+    }
+    if (m_hibernateTask == 0 && IsHibernationDue()) {
+        m_hibernateTask = Core::IdleScheduler::Shared().Add(
+            Core::IdleVenue::UiThread, [this](const Core::IdleBudget& budget) { return HibernateSlice(budget); });
+    }
+}
 
-    // Start the session
-    if (!m_ptySession->Start(ptyConfig)) {
-        std::wstring error = L"Failed to start PTY: " + m_ptySession->GetLastError();
-        MessageBoxW(error.c_str(), L"Console3", MB_ICONERROR);
+bool MainFrame::IsHibernationDue() const {
+    const int minutes = GetSettings().hibernateAfterMinutes;
+    if (!m_session || !m_terminalView || !m_terminalView->IsHidden() || minutes <= 0 ||
+        m_session->IsHibernated() || m_session->GetExport().IsActive()) {
         return false;
     }
+    const uint64_t idle = GetTickCount64() - m_session->GetLastActivity();
+    return idle >= static_cast<uint64_t>(minutes) * 60 * 1000;
+}
 
+bool MainFrame::HibernateSlice(const Core::IdleBudget& budget) {
+    // Shown again or woken by output meanwhile: the timer starts over
+    RenderLock::Scope lock(RenderLock::Shared());
+    if (!IsHibernationDue()) {
+        m_hibernateTask = 0;
+        return false;
+    }
+    do {
+        if (!m_session->HibernateSlice(kHibernateLinesPerPiece)) {
+            m_terminalView->ReleaseCaches();
+            m_hibernateTask = 0;
+            return false;
+        }
+    } while (!budget.ShouldYield());
     return true;
 }
 
+void MainFrame::SaveSnapshot() {
+    // An attached session lives on in its host, not in the next run; a log
+    // view's file is where it was; a serial line has no shell to restart
+    const Core::TerminalBuffer* buffer = m_session ? m_session->GetBuffer() : nullptr;
+    if (!buffer || !m_hostPipe.empty() || !m_logPath.empty() || !m_serial.port.empty()) {
+        return;
+    }
+    const bool backlog = Core::SessionSnapshots::Shared().Capture(this, m_session->GetConfig(), *buffer);
+    SetTimer(kSnapshotTimerId, backlog ? kSnapshotBacklogMs : kSnapshotTimerMs);
+}
+
+void MainFrame::UpdateExport() {
+    if (!m_session || !m_session->UpdateExport()) {
+        KillTimer(kExportTimerId);
+    }
+    if (!m_statusBar.IsWindow() || !m_session) {
+        return;
+    }
+
+    const Core::ExportProgress progress = m_session->GetExport().GetProgress();
+    wchar_t text[128];
+    if (m_session->GetExport().IsActive()) {
+        const uint64_t percent = progress.linesTotal ? progress.linesCopied * 100 / progress.linesTotal : 0;
+        swprintf_s(text, L"Saving scrollback: %llu%%", static_cast<unsigned long long>(percent));
+    } else if (progress.finished) {
+        swprintf_s(text, L"Scrollback saved (%.1f MB)", progress.bytesWritten / (1024.0 * 1024.0));
+    } else {
+        swprintf_s(text, L"Saving scrollback failed");
+    }
+    m_statusBar.SetText(0, text);
+}
+
 } // namespace Console3::UI
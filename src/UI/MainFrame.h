@@ -27,29 +27,47 @@ extern CAppModule _Module;
 #include <atlctrls.h>
 #include <atlcrack.h>
 
-// Direct2D
-#include <d2d1_1.h>
-#include <dwrite_1.h>
+#include "Core/SerialPort.h"
+#include "Core/SessionMemory.h"
+#include "UI/FindBar.h"
+#include "UI/PaneLayout.h"
+#include "UI/RenderLock.h"
+#include "UI/RenderThread.h"
+#include "UI/TabControl.h"
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 // Forward declarations
 namespace Console3::Core {
-    class PtySession;
-    class TerminalBuffer;
-}
-
-namespace Console3::Emulation {
-    class VTermWrapper;
+    class IdleBudget;
+    class Session;
+    struct GlobalSearchHit;
+    struct TelemetrySnapshot;
+    struct SessionConfig;
+    struct SavedSession;
+    struct Settings;
+    struct SettingsChanges;
 }
 
 namespace Console3::UI {
 
 // Forward declarations
+class SearchPanel;
 class TerminalView;
 
 /// Main application window
+/// A process can have several; each has its own tabs and view, and they
+/// share rendering resources (SharedRenderResources). The last one closed
+/// ends the message loop.
+///
+/// Each tab is a session (with its split panes); the one in front is
+/// m_session, on the view. The others keep running behind it, their output
+/// applied to their buffers but nothing rendered, and come back onto the
+/// view when their tab is selected.
 class MainFrame : 
     public CFrameWindowImpl<MainFrame>,
     public CUpdateUI<MainFrame>,
@@ -62,9 +80,50 @@ public:
     MainFrame();
     ~MainFrame();
 
-    // Factory setters (must be called before CreateEx)
-    void SetD2DFactory(ID2D1Factory1* factory) { m_d2dFactory = factory; }
-    void SetDWriteFactory(IDWriteFactory1* factory) { m_dwriteFactory = factory; }
+    /// Create and show a window that deletes itself once destroyed
+    /// @param showCmd ShowWindow() command
+    /// @param workingDir Directory its shell starts in (empty = current)
+    /// @param saved Session of the last run to restore (only read while opening)
+    /// @return The window, or nullptr if it can't be created
+    static MainFrame* Open(int showCmd, const std::wstring& workingDir = {},
+                           const Core::SavedSession* saved = nullptr);
+
+    /// Create and show a window attached to a session host (SessionHost.h)
+    /// @param hostPipe The host's pipe (Core::GetHostPipePath)
+    static MainFrame* OpenAttached(int showCmd, const std::wstring& hostPipe);
+
+    /// Create and show a window whose shell starts below another session's
+    /// history (Duplicate Tab); the history's blocks are shared, not copied
+    /// @param history Buffer to take the history of (only read while opening)
+    static MainFrame* OpenDuplicate(int showCmd, const std::wstring& workingDir,
+                                    const Core::TerminalBuffer& history);
+
+    /// Create and show a window viewing a log file (Core::LogFile)
+    /// @param path The file
+    static MainFrame* OpenLogView(int showCmd, const std::wstring& path);
+
+    /// Create and show a window on a serial port instead of a shell
+    /// @param serial The port and its line settings (Core::SerialSettings)
+    static MainFrame* OpenSerial(int showCmd, const Core::SerialSettings& serial);
+
+    /// Quit the process once the first shell output is on screen, after
+    /// reporting the startup times (cold-start benchmarks)
+    static void SetExitAfterFirstFrame(bool exit) noexcept;
+
+    /// Get the number of main windows open in the process
+    [[nodiscard]] static size_t GetOpenCount() noexcept;
+
+    /// Report the memory each window's session holds, by owner, with the
+    /// process totals (Console3.exe --diagnostics)
+    [[nodiscard]] static std::wstring FormatMemoryReport();
+
+    /// Take every window's and session's counters for the telemetry
+    /// endpoint (on its thread; see Core/TelemetryEndpoint.h)
+    [[nodiscard]] static Core::TelemetrySnapshot CollectTelemetry();
+
+    /// Reload the settings file once writes to it settle, and apply what
+    /// changed to every window (the settings watcher's handler)
+    static void OnSettingsFileChanged();
 
     // CMessageFilter
     BOOL PreTranslateMessage(MSG* pMsg) override;
@@ -72,19 +131,51 @@ public:
     // CIdleHandler
     BOOL OnIdle() override;
 
+    // Windows made by Open() delete themselves
+    void OnFinalMessage(HWND hwnd) override;
+
+    // The window's messages are handled under the render lock
+    WNDPROC GetWindowProc() override { return RenderLockedWindowProc<MainFrame>; }
+
     // Message map
     BEGIN_MSG_MAP(MainFrame)
         MSG_WM_CREATE(OnCreate)
         MSG_WM_DESTROY(OnDestroy)
         MSG_WM_SIZE(OnSize)
+        MSG_WM_ENTERSIZEMOVE(OnEnterSizeMove)
+        MSG_WM_EXITSIZEMOVE(OnExitSizeMove)
+        MSG_WM_MOVE(OnMove)
+        MSG_WM_DISPLAYCHANGE(OnDisplayChange)
+        MSG_WM_FONTCHANGE(OnFontChange)
         MSG_WM_SETFOCUS(OnSetFocus)
+        MSG_WM_ACTIVATE(OnActivate)
         MSG_WM_CLOSE(OnClose)
+        MSG_WM_TIMER(OnTimer)
+        MESSAGE_HANDLER(WM_DPICHANGED, OnDpiChanged)
+        MESSAGE_HANDLER(WM_DWMCOMPOSITIONCHANGED, OnCompositionChanged)
+        MESSAGE_HANDLER(WM_POWERBROADCAST, OnPowerBroadcast)
+        MESSAGE_HANDLER(kStartupTasksMessage, OnStartupTasks)
+        MESSAGE_HANDLER(kSessionExitedMessage, OnSessionExited)
+        MESSAGE_HANDLER(kPaneExitedMessage, OnPaneExited)
+        MESSAGE_HANDLER(kOutputMessage, OnOutputMessage)
+        MESSAGE_HANDLER(kFastForwardMessage, OnFastForwardMessage)
+        MESSAGE_HANDLER(WM_ENTERMENULOOP, OnEnterMenuLoop)
+        MESSAGE_HANDLER(WM_EXITMENULOOP, OnExitMenuLoop)
         COMMAND_ID_HANDLER_EX(ID_FILE_NEW_TAB, OnFileNewTab)
+        COMMAND_ID_HANDLER_EX(ID_FILE_NEW_WINDOW, OnFileNewWindow)
+        COMMAND_ID_HANDLER_EX(ID_FILE_DUPLICATE_TAB, OnFileDuplicateTab)
         COMMAND_ID_HANDLER_EX(ID_FILE_CLOSE_TAB, OnFileCloseTab)
+        COMMAND_ID_HANDLER_EX(ID_FILE_SAVE_SCROLLBACK, OnFileSaveScrollback)
         COMMAND_ID_HANDLER_EX(ID_FILE_EXIT, OnFileExit)
         COMMAND_ID_HANDLER_EX(ID_EDIT_COPY, OnEditCopy)
         COMMAND_ID_HANDLER_EX(ID_EDIT_PASTE, OnEditPaste)
+        COMMAND_ID_HANDLER_EX(ID_EDIT_FIND_IN_TAB, OnEditFindInTab)
+        COMMAND_ID_HANDLER_EX(ID_EDIT_FIND, OnEditFind)
         COMMAND_ID_HANDLER_EX(ID_VIEW_SETTINGS, OnViewSettings)
+        COMMAND_ID_HANDLER_EX(ID_VIEW_SPLIT_RIGHT, OnViewSplit)
+        COMMAND_ID_HANDLER_EX(ID_VIEW_SPLIT_DOWN, OnViewSplit)
+        COMMAND_ID_HANDLER_EX(ID_VIEW_CLOSE_PANE, OnViewClosePane)
+        COMMAND_ID_HANDLER_EX(ID_VIEW_PAUSE_OUTPUT, OnViewPauseOutput)
         COMMAND_ID_HANDLER_EX(ID_HELP_ABOUT, OnHelpAbout)
         CHAIN_MSG_MAP(CUpdateUI<MainFrame>)
         CHAIN_MSG_MAP(CFrameWindowImpl<MainFrame>)
@@ -95,17 +186,46 @@ public:
         UPDATE_ELEMENT(ID_FILE_CLOSE_TAB, UPDUI_MENUPOPUP)
         UPDATE_ELEMENT(ID_EDIT_COPY, UPDUI_MENUPOPUP)
         UPDATE_ELEMENT(ID_EDIT_PASTE, UPDUI_MENUPOPUP)
+        UPDATE_ELEMENT(ID_VIEW_PAUSE_OUTPUT, UPDUI_MENUPOPUP)
     END_UPDATE_UI_MAP()
 
+    // Posted by OnCreate: runs once the window has been shown
+    static constexpr UINT kStartupTasksMessage = WM_APP + 1;
+
+    // Posted by the session's exit callback: wParam is the exit code,
+    // lParam the m_sessionSerial of the session that exited
+    static constexpr UINT kSessionExitedMessage = WM_APP + 2;
+
+    // Posted by a split pane's session's exit callback: wParam is the exit
+    // code, lParam the session's trace ID (its pane changes as its tab
+    // leaves the view and comes back)
+    static constexpr UINT kPaneExitedMessage = WM_APP + 3;
+
+    // Posted by the render thread once it applied sessions' output, for
+    // the UI thread's share (modes, timers, bells); coalesced until handled
+    static constexpr UINT kOutputMessage = WM_APP + 4;
+
+    // Posted by the session's fast-forward callback: wParam is whether it
+    // is active
+    static constexpr UINT kFastForwardMessage = WM_APP + 5;
+
     // Command IDs
     enum {
         ID_FILE_NEW_TAB = 100,
+        ID_FILE_NEW_WINDOW,
+        ID_FILE_DUPLICATE_TAB,
         ID_FILE_CLOSE_TAB,
+        ID_FILE_SAVE_SCROLLBACK,
         ID_FILE_EXIT,
         ID_EDIT_COPY,
         ID_EDIT_PASTE,
+        ID_EDIT_FIND_IN_TAB,
         ID_EDIT_FIND,
         ID_VIEW_SETTINGS,
+        ID_VIEW_SPLIT_RIGHT,
+        ID_VIEW_SPLIT_DOWN,
+        ID_VIEW_CLOSE_PANE,
+        ID_VIEW_PAUSE_OUTPUT,
         ID_HELP_ABOUT,
     };
 
@@ -114,43 +234,255 @@ private:
     int OnCreate(LPCREATESTRUCT lpCreateStruct);
     void OnDestroy();
     void OnSize(UINT nType, CSize size);
+    void OnEnterSizeMove();
+    void OnExitSizeMove();
+    void OnMove(CPoint ptPos);
+    void OnDisplayChange(UINT uBitsPerPixel, CSize sizeScreen);
+    void OnFontChange();
     void OnSetFocus(CWindow wndOld);
+    void OnActivate(UINT nState, BOOL bMinimized, CWindow wndOther);
     void OnClose();
+    void OnTimer(UINT_PTR nIDEvent);
+    LRESULT OnDpiChanged(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
+    LRESULT OnCompositionChanged(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
+    LRESULT OnPowerBroadcast(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
+    LRESULT OnStartupTasks(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
+    LRESULT OnSessionExited(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
+    LRESULT OnPaneExited(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
+    LRESULT OnOutputMessage(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
+    LRESULT OnFastForwardMessage(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
+    LRESULT OnEnterMenuLoop(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
+    LRESULT OnExitMenuLoop(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
 
     // Command handlers
     void OnFileNewTab(UINT uNotifyCode, int nID, CWindow wndCtl);
+    void OnFileNewWindow(UINT uNotifyCode, int nID, CWindow wndCtl);
+    void OnFileDuplicateTab(UINT uNotifyCode, int nID, CWindow wndCtl);
     void OnFileCloseTab(UINT uNotifyCode, int nID, CWindow wndCtl);
+    void OnFileSaveScrollback(UINT uNotifyCode, int nID, CWindow wndCtl);
     void OnFileExit(UINT uNotifyCode, int nID, CWindow wndCtl);
     void OnEditCopy(UINT uNotifyCode, int nID, CWindow wndCtl);
     void OnEditPaste(UINT uNotifyCode, int nID, CWindow wndCtl);
+    void OnEditFindInTab(UINT uNotifyCode, int nID, CWindow wndCtl);
+    void OnEditFind(UINT uNotifyCode, int nID, CWindow wndCtl);
     void OnViewSettings(UINT uNotifyCode, int nID, CWindow wndCtl);
+    void OnViewSplit(UINT uNotifyCode, int nID, CWindow wndCtl);
+    void OnViewClosePane(UINT uNotifyCode, int nID, CWindow wndCtl);
+    void OnViewPauseOutput(UINT uNotifyCode, int nID, CWindow wndCtl);
     void OnHelpAbout(UINT uNotifyCode, int nID, CWindow wndCtl);
 
     // Initialization
     bool CreateMenuBar();
     bool CreateStatusBar();
+    bool CreateTabBar();
     bool CreateTerminalView();
 
-    // Start a new terminal session
+    // Get the view's place: the client area between the tab bar (and the
+    // find bar, while it is open) and the status bar
+    [[nodiscard]] CRect GetViewRect() const;
+
+    // Lay the bars and the view out again, after the find bar opened or closed
+    void UpdateChildLayout();
+
+    // Open a tab on a new session, in front of the others
+    bool OpenTab();
+
+    // Close a tab and hand its sessions to the SessionReaper; closing the
+    // last one closes the window (or opens a new tab, as the settings say)
+    void CloseTab(int tabId);
+
+    // Bring a tab's session onto the view, the one in front going behind
+    void ActivateTab(int tabId);
+
+    // Handle the tab bar's clicks
+    void OnTabEvent(TabEvent event, int tabId);
+
+    // Start a new terminal session as m_session (which must be empty)
     bool StartNewSession();
 
-private:
-    // Direct2D/DirectWrite factories (not owned)
-    ID2D1Factory1* m_d2dFactory = nullptr;
-    IDWriteFactory1* m_dwriteFactory = nullptr;
+    // Detach the session from the window and hand it to the SessionReaper
+    // to stop in the background (m_session is empty after)
+    void StopSession();
+
+    // Put m_session and its panes on the view
+    void AttachSession();
+
+    // Take m_session and its panes off the view and the window's timers;
+    // they keep running
+    void DetachSession();
+
+    // Move m_session and its panes behind the tab in front (m_session is
+    // empty after)
+    void SendSessionToBack();
+
+    // Hand every tab behind the one in front to the SessionReaper
+    void CloseBackgroundTabs();
+
+    // Stop applying a session's output and hand it to the SessionReaper
+    void RetireSession(std::unique_ptr<Core::Session> session);
+
+    // Settings every session of the window starts with
+    [[nodiscard]] Core::SessionConfig MakeSessionConfig() const;
+
+    // Split the focused pane, starting a shell of its own in the new one
+    bool SplitPane(SplitDirection direction);
+
+    // Close a split pane and hand its session to the SessionReaper
+    void ClosePane(uint32_t pane);
+
+    // Close every split pane (before the window's session goes)
+    void ClosePanes();
 
+    // Get the session of the focused pane (m_session unless split)
+    [[nodiscard]] Core::Session* GetFocusedSession() const;
+
+    // Add the window's session and its panes' to a global search
+    void AddSearchSources(SearchPanel& panel) const;
+
+    // Bring a global search hit's window forward and select the match
+    static void OpenSearchHit(const Core::GlobalSearchHit& hit);
+
+    // Start or stop the telemetry endpoint as the settings say (stopped
+    // with the last window)
+    static void ApplyTelemetry();
+
+    // Point the view's per-session state (links, output rules, latency
+    // probe, trace ID, modes) and the find bar at the focused pane's session
+    void BindFocusedSession();
+
+    // Give the view the focused session's mouse and keyboard modes
+    void UpdateViewModes();
+
+    // Pump a running scrollback export and show its progress
+    void UpdateExport();
+
+    // Show a streamed paste's progress until it is done
+    void UpdatePaste();
+
+    // Apply a session's new output to its buffer and ask for a frame, then
+    // post the rest to the UI thread (render thread)
+    void OnSessionOutput(Core::Session& session);
+
+    // Let the render thread paint through a modal loop the handler starts
+    void BeginModal();
+    void EndModal();
+
+    // Show a message box, the render lock released meanwhile
+    int ShowMessage(const wchar_t* text, const wchar_t* caption, UINT type);
+
+    // Ring the bell for output rules that fired since the last wakeup
+    void OnOutputRuleEvents();
+
+    // Tell the session whether it is focused, visible or minimized
+    void UpdateSessionPriority(bool active);
+
+    // Stop or resume taking the output of the tab's sessions (Scroll Lock),
+    // shown in the title and status bars
+    void SetOutputPaused(bool paused);
+
+    // Hibernate the session once it has been hidden and idle long enough,
+    // a slice at a time as an idle task (Core/IdleScheduler.h)
+    void UpdateHibernation();
+    [[nodiscard]] bool IsHibernationDue() const;
+    bool HibernateSlice(const Core::IdleBudget& budget);
+
+    // Report startup times once the shell's first output is on screen
+    void ReportStartup();
+
+    // Save the session's screen and new history for the next start
+    void SaveSnapshot();
+
+    // Get the memory the session holds, rendering included (needs a session)
+    [[nodiscard]] Core::SessionMemory GetMemory() const;
+
+    // Show the session's memory in the status bar
+    void UpdateMemory();
+
+    // Reload the settings file and apply it to every window
+    static void ReloadSettings();
+
+    // Apply the shared settings' changes: process-wide parts, then every
+    // window, each showing the status given
+    static void ApplyChangedSettings(const Core::SettingsChanges& changes, const std::wstring& status);
+
+    // Apply changed settings to this window's view and sessions; running
+    // shells are left alone
+    void ApplySettings(const Core::Settings& settings, const Core::SettingsChanges& changes);
+
+    // Give every session of the window, tabs behind included, the
+    // performance settings a running session can take (Session::Reconfigure)
+    void ReconfigureSessions();
+
+    // Give the view the settings' font (a minimized window waits until shown)
+    void ApplyFont();
+
+    // Give the view the performance settings' frame cap and cell grid
+    // choice, and keep input latency measured for the telemetry endpoint
+    void ApplyViewPerformance();
+
+    // Save power on battery (performance settings' saveBatteryPower): cap
+    // the view's frames, slow its blink, and batch background sessions
+    void ApplyPowerPolicy();
+
+    // Apply the window settings' opacity and acrylic backdrop
+    void ApplyTransparency();
+
+    // Extend DWM's frame over the view, so its backdrop shows through the
+    // view where it is translucent
+    void UpdateBackdropMargins();
+
+private:
     // UI components
     CMenuHandle m_menu;
     CStatusBarCtrl m_statusBar;
+    TabControl m_tabBar;
+    FindBar m_findBar;
     std::unique_ptr<TerminalView> m_terminalView;
 
     // Core components
-    std::unique_ptr<Core::PtySession> m_ptySession;
-    std::unique_ptr<Core::TerminalBuffer> m_terminalBuffer;
-    std::unique_ptr<Emulation::VTermWrapper> m_vtermWrapper;
+    std::unique_ptr<Core::Session> m_session;
+    uint32_t m_sessionSerial = 0;  ///< Numbers m_session's exit notices (kSessionExitedMessage)
+    uint32_t m_lastSerial = 0;     ///< Last serial given a session, in any tab
+
+    // Sessions of the view's split panes; m_session is in the first pane
+    struct PaneSession {
+        uint32_t pane = 0;
+        SplitDirection direction = SplitDirection::Right;  ///< How it was split off (re-split the same way)
+        std::unique_ptr<Core::Session> session;
+    };
+    std::vector<PaneSession> m_paneSessions;
+
+    // Tabs behind the one in front, still running
+    struct BackgroundTab {
+        int tabId = 0;
+        std::unique_ptr<Core::Session> session;
+        std::vector<PaneSession> panes;
+        uint32_t serial = 0;        ///< m_sessionSerial while it was in front
+    };
+    std::vector<BackgroundTab> m_backgroundTabs;
+    int m_activeTab = 0;            ///< Tab bar ID of m_session's tab (0 = none)
+
+    // Applies the sessions' output and renders the view; declared after
+    // them, it stops before they go
+    RenderThread m_renderThread;
+    std::atomic<bool> m_outputPosted{false};  ///< kOutputMessage is in the queue
+    unsigned m_modalDepth = 0;                ///< Render lock levels a modal loop released
+    uint32_t m_hibernateTask = 0;             ///< Idle task hibernating m_session, if any
 
     // Window state
     bool m_isClosing = false;
+    bool m_ownsSelf = false;       ///< Made by Open(), deleted on WM_NCDESTROY
+    bool m_fontPending = false;    ///< The font changed while minimized
+    bool m_outputPaused = false;   ///< Output paused (SetOutputPaused)
+    HPOWERNOTIFY m_powerSourceNotify = nullptr;  ///< GUID_ACDC_POWER_SOURCE changes
+    HPOWERNOTIFY m_powerSavingNotify = nullptr;  ///< GUID_POWER_SAVING_STATUS (battery saver) changes
+    HMONITOR m_monitor = nullptr;  ///< Monitor the window was last on (see OnMove)
+    std::wstring m_workingDir;     ///< Where new sessions start (empty = current directory)
+    const Core::SavedSession* m_saved = nullptr;  ///< Restored by the first session (Open() only)
+    const Core::TerminalBuffer* m_history = nullptr;  ///< Shared by the first session (OpenDuplicate() only)
+    std::wstring m_hostPipe;       ///< Session host shown instead of a shell of its own (OpenAttached())
+    std::wstring m_logPath;        ///< File shown instead of a shell (OpenLogView())
+    Core::SerialSettings m_serial; ///< Port used instead of a shell when set (OpenSerial())
 };
 
 } // namespace Console3::UI
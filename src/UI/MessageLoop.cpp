@@ -0,0 +1,165 @@
+// Console3 - MessageLoop.cpp
+// Message loop that also waits on kernel objects
+
+#include "UI/MessageLoop.h"
+#include "Core/IdleScheduler.h"
+#include "Core/PerfClock.h"
+#include <algorithm>
+
+namespace Console3::UI {
+
+bool WaitableMessageLoop::AddWaitHandle(HANDLE handle, WaitHandler handler) {
+    if (!handle || handle == INVALID_HANDLE_VALUE || !handler) {
+        return false;
+    }
+
+    if (m_handles.size() >= kMaxWaitHandles ||
+        std::find(m_handles.begin(), m_handles.end(), handle) != m_handles.end()) {
+        return false;
+    }
+
+    m_handles.push_back(handle);
+    m_handlers.push_back(std::move(handler));
+    return true;
+}
+
+bool WaitableMessageLoop::RemoveWaitHandle(HANDLE handle) {
+    auto it = std::find(m_handles.begin(), m_handles.end(), handle);
+    if (it == m_handles.end()) {
+        return false;
+    }
+
+    const auto index = std::distance(m_handles.begin(), it);
+    m_handles.erase(it);
+    m_handlers.erase(m_handlers.begin() + index);
+    return true;
+}
+
+BOOL WaitableMessageLoop::OnIdle(int /*idleCount*/) {
+    BOOL more = FALSE;
+    for (int i = 0; i < m_aIdleHandler.GetSize(); ++i) {
+        if (CIdleHandler* handler = m_aIdleHandler[i]; handler != nullptr && handler->OnIdle()) {
+            more = TRUE;
+        }
+    }
+
+    // Maintenance only once the handlers are done
+    if (!more && Core::IdleScheduler::Shared().RunUiSlice()) {
+        more = TRUE;
+    }
+    return more;
+}
+
+int WaitableMessageLoop::Run() {
+    BOOL doIdle = TRUE;
+    int idleCount = 0;
+
+    // Idle tasks wait for a quiet machine on this timer; any handler
+    // signaled runs the idle processing again
+    (void)AddWaitHandle(Core::IdleScheduler::Shared().GetUiWakeEvent(), []() {});
+
+    for (;;) {
+        // Idle processing while the queue is empty (same as CMessageLoop)
+        while (doIdle && !PeekMessageW(&m_msg, nullptr, 0, 0, PM_NOREMOVE)) {
+            if (!OnIdle(idleCount++)) {
+                doIdle = FALSE;
+            }
+        }
+
+        // Sleep until a message arrives or a registered handle is signaled
+        const DWORD count = static_cast<DWORD>(m_handles.size());
+        const DWORD result = MsgWaitForMultipleObjectsEx(
+            count, m_handles.data(), INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+
+        if (result == WAIT_FAILED) {
+            ATLTRACE2(atlTraceUI, 0, _T("MsgWaitForMultipleObjectsEx failed\n"));
+            return -1;
+        }
+
+        // Keys and clicks before anything queued ahead of them
+        bool idle = DeliverInput();
+        if (result < WAIT_OBJECT_0 + count) {
+            DispatchSignaled(result - WAIT_OBJECT_0);
+            idle = true;
+        }
+
+        // Then the rest of the queue for a budget; what is left waits for
+        // the next pass, after the handles signaled meanwhile
+        const uint64_t start = Core::PerfClock::NowMicros();
+        while (PeekMessageW(&m_msg, nullptr, 0, 0, PM_REMOVE)) {
+            if (m_msg.message == WM_QUIT) {
+                return static_cast<int>(m_msg.wParam);
+            }
+            idle |= Deliver();
+            if (HasInput()) {
+                idle |= DeliverInput();
+            }
+            if (Core::PerfClock::NowMicros() - start >= kDispatchBudgetMicros) {
+                break;
+            }
+        }
+
+        if (idle) {
+            doIdle = TRUE;
+            idleCount = 0;
+        }
+    }
+}
+
+bool WaitableMessageLoop::DeliverInput() {
+    bool idle = false;
+    while (PeekMessageW(&m_msg, nullptr, 0, 0, PM_REMOVE | PM_QS_INPUT)) {
+        Core::IdleScheduler::Shared().NoteActivity();
+        const MSG key = m_msg;
+        idle |= Deliver();
+
+        // TranslateMessage posts the characters, which would otherwise
+        // queue behind the posts already there
+        if (key.message == WM_KEYDOWN || key.message == WM_SYSKEYDOWN) {
+            while (PeekMessageW(&m_msg, key.hwnd, WM_CHAR, WM_SYSDEADCHAR, PM_REMOVE)) {
+                idle |= Deliver();
+            }
+        }
+    }
+    return idle;
+}
+
+bool WaitableMessageLoop::Deliver() {
+    if (!PreTranslateMessage(&m_msg)) {
+        TranslateMessage(&m_msg);
+        DispatchMessageW(&m_msg);
+    }
+    return IsIdleMessage(&m_msg) != FALSE;
+}
+
+bool WaitableMessageLoop::HasInput() noexcept {
+    return (HIWORD(GetQueueStatus(QS_INPUT)) & QS_INPUT) != 0;
+}
+
+void WaitableMessageLoop::DispatchSignaled(size_t firstIndex) {
+    // Handlers may add or remove handles, so work from a snapshot
+    const std::vector<HANDLE> handles = m_handles;
+
+    for (size_t i = firstIndex; i < handles.size(); ++i) {
+        if (i != firstIndex && HasInput()) {
+            (void)DeliverInput();
+        }
+
+        // The wait already consumed the first signal; poll the rest so a
+        // busy low-index session cannot starve the others
+        if (i != firstIndex && WaitForSingleObject(handles[i], 0) != WAIT_OBJECT_0) {
+            continue;
+        }
+
+        auto it = std::find(m_handles.begin(), m_handles.end(), handles[i]);
+        if (it == m_handles.end()) {
+            continue;
+        }
+
+        // Copy so the handler survives its own RemoveWaitHandle() call
+        WaitHandler handler = m_handlers[std::distance(m_handles.begin(), it)];
+        handler();
+    }
+}
+
+} // namespace Console3::UI
@@ -0,0 +1,109 @@
+#pragma once
+// Console3 - MessageLoop.h
+// Message loop that also waits on kernel objects
+//
+// The stock CMessageLoop only wakes for window messages, so background
+// producers would have to PostMessage for every chunk of output. This loop
+// sleeps in MsgWaitForMultipleObjectsEx instead: sessions register their
+// output event and the UI thread wakes exactly once per burst of output.
+//
+// Input goes first. Windows hands out posted messages (the render threads'
+// output notifications) before keyboard and mouse input, so under load a
+// keystroke waited behind every notification queued ahead of it. Each pass
+// now delivers the waiting input before anything else, each key followed at
+// once by the characters it translates to; between any two other messages
+// and handlers it checks for input again. The rest of the queue is drained
+// for at most kDispatchBudgetMicros a pass, so a flood of posts can't hold
+// off a frame scheduler's timer (FrameScheduler.h) either: frames still
+// render once per tick.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#define STRICT
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+
+#include <Windows.h>
+
+// ATL/WTL headers
+#include <atlbase.h>
+#include <atlapp.h>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace Console3::UI {
+
+/// Callback invoked when a registered handle is signaled
+using WaitHandler = std::function<void()>;
+
+/// Something that waits on handles for their handlers: the UI thread's
+/// message loop, or a window's render thread (RenderThread.h)
+class WaitHandleHost {
+public:
+    /// Register a handle to wait on
+    /// Use auto-reset events: the handler runs once per signal.
+    /// @param handle Waitable handle (e.g. Session::GetOutputEvent())
+    /// @param handler Called on the host's thread each time the handle is signaled
+    /// @return true on success, false if the handle is invalid or the limit is reached
+    virtual bool AddWaitHandle(HANDLE handle, WaitHandler handler) = 0;
+
+    /// Unregister a handle (safe to call from within a handler)
+    /// @return true if the handle was registered
+    virtual bool RemoveWaitHandle(HANDLE handle) = 0;
+
+protected:
+    ~WaitHandleHost() = default;
+};
+
+/// CMessageLoop that dispatches signaled wait handles alongside messages
+class WaitableMessageLoop : public CMessageLoop, public WaitHandleHost {
+public:
+    /// Maximum number of handles (MsgWaitForMultipleObjectsEx reserves one)
+    static constexpr size_t kMaxWaitHandles = MAXIMUM_WAIT_OBJECTS - 1;
+
+    /// Time a pass spends on messages other than input before it waits
+    /// again (and takes signaled handles)
+    static constexpr uint64_t kDispatchBudgetMicros = 4000;
+
+    bool AddWaitHandle(HANDLE handle, WaitHandler handler) override;
+    bool RemoveWaitHandle(HANDLE handle) override;
+
+    /// Run the loop until WM_QUIT
+    /// @return Exit code from WM_QUIT
+    int Run();
+
+    /// Run the idle handlers, then a slice of the idle tasks
+    /// (Core/IdleScheduler.h) if none has more work
+    /// @return TRUE if any handler or task has more work, to be called again
+    /// while the queue stays empty (CMessageLoop always stops after one call)
+    BOOL OnIdle(int idleCount) override;
+
+private:
+    /// Run handlers for every signaled handle, starting at the first one;
+    /// input arriving meanwhile is delivered between them
+    void DispatchSignaled(size_t firstIndex);
+
+    /// Deliver the keyboard, mouse and pointer input waiting
+    /// @return true if idle handlers should run again
+    bool DeliverInput();
+
+    /// Translate and dispatch m_msg
+    /// @return true if idle handlers should run again (IsIdleMessage)
+    bool Deliver();
+
+    /// Check if input is waiting in the thread's queue
+    [[nodiscard]] static bool HasInput() noexcept;
+
+private:
+    std::vector<HANDLE> m_handles;        ///< Parallel to m_handlers
+    std::vector<WaitHandler> m_handlers;
+};
+
+} // namespace Console3::UI
@@ -0,0 +1,130 @@
+// Console3 - PaneLayout.cpp
+// Where the panes of a split view go
+
+#include "UI/PaneLayout.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Console3::UI {
+
+namespace {
+
+/// Length of a split's first half: half of what the divider leaves, in
+/// whole cells, so only the last pane along a line has a partial cell
+float FirstExtent(float extent, float cell) {
+    const float available = std::max(extent - PaneLayout::kDividerWidth, 0.0f);
+    if (cell <= 0.0f) {
+        return std::floor(available / 2.0f);
+    }
+    const float cells = std::max(std::floor(available / 2.0f / cell), 1.0f);
+    return std::min(cells * cell, available);
+}
+
+} // namespace
+
+PaneLayout::PaneLayout() : m_root(std::make_unique<Node>()) {
+    m_root->pane = kFirstPane;
+}
+
+uint32_t PaneLayout::Split(uint32_t pane, SplitDirection direction) {
+    Node* leaf = Find(m_root.get(), pane);
+    if (!leaf) {
+        return 0;
+    }
+
+    // The leaf becomes the split: its pane moves to the first half
+    leaf->first = std::make_unique<Node>();
+    leaf->first->pane = pane;
+    leaf->second = std::make_unique<Node>();
+    leaf->second->pane = m_nextPane++;
+    leaf->direction = direction;
+    leaf->pane = 0;
+    ++m_count;
+    return leaf->second->pane;
+}
+
+bool PaneLayout::Remove(uint32_t pane) {
+    if (m_count <= 1 || !Remove(m_root, pane)) {
+        return false;
+    }
+    --m_count;
+    return true;
+}
+
+bool PaneLayout::Contains(uint32_t pane) const noexcept {
+    return Find(m_root.get(), pane) != nullptr;
+}
+
+uint32_t PaneLayout::GetFirst() const noexcept {
+    const Node* node = m_root.get();
+    while (node->first) {
+        node = node->first.get();
+    }
+    return node->pane;
+}
+
+void PaneLayout::Arrange(float width, float height, float cellWidth, float cellHeight,
+                         std::vector<PaneRect>& panes, std::vector<PaneRect>& dividers) const {
+    panes.clear();
+    dividers.clear();
+    const PaneRect area{0, 0.0f, 0.0f, std::max(width, 0.0f), std::max(height, 0.0f)};
+    Arrange(*m_root, area, cellWidth, cellHeight, panes, dividers);
+}
+
+PaneLayout::Node* PaneLayout::Find(Node* node, uint32_t pane) noexcept {
+    if (!node || pane == 0) {
+        return nullptr;
+    }
+    if (!node->first) {
+        return node->pane == pane ? node : nullptr;
+    }
+    Node* found = Find(node->first.get(), pane);
+    return found ? found : Find(node->second.get(), pane);
+}
+
+bool PaneLayout::Remove(std::unique_ptr<Node>& node, uint32_t pane) {
+    if (!node->first) {
+        return false;
+    }
+
+    // A split with the pane as a leaf is replaced by the other half
+    for (const bool first : {true, false}) {
+        std::unique_ptr<Node>& child = first ? node->first : node->second;
+        if (!child->first && child->pane == pane) {
+            std::unique_ptr<Node> sibling = std::move(first ? node->second : node->first);
+            node = std::move(sibling);
+            return true;
+        }
+    }
+    return Remove(node->first, pane) || Remove(node->second, pane);
+}
+
+void PaneLayout::Arrange(const Node& node, const PaneRect& area, float cellWidth, float cellHeight,
+                         std::vector<PaneRect>& panes, std::vector<PaneRect>& dividers) {
+    if (!node.first) {
+        PaneRect rect = area;
+        rect.pane = node.pane;
+        panes.push_back(rect);
+        return;
+    }
+
+    PaneRect first = area;
+    PaneRect divider = area;
+    PaneRect second = area;
+    if (node.direction == SplitDirection::Right) {
+        first.right = area.left + FirstExtent(area.right - area.left, cellWidth);
+        divider.left = first.right;
+        divider.right = std::min(divider.left + kDividerWidth, area.right);
+        second.left = divider.right;
+    } else {
+        first.bottom = area.top + FirstExtent(area.bottom - area.top, cellHeight);
+        divider.top = first.bottom;
+        divider.bottom = std::min(divider.top + kDividerWidth, area.bottom);
+        second.top = divider.bottom;
+    }
+    dividers.push_back(divider);
+    Arrange(*node.first, first, cellWidth, cellHeight, panes, dividers);
+    Arrange(*node.second, second, cellWidth, cellHeight, panes, dividers);
+}
+
+} // namespace Console3::UI
@@ -0,0 +1,88 @@
+#pragma once
+// Console3 - PaneLayout.h
+// Where the panes of a split view go
+//
+// A view split into panes is one window with one renderer: each pane is a
+// region of its surface (TerminalView draws them all into one retained
+// frame and presents the regions that changed together). This is the
+// layout: a binary tree whose leaves are panes and whose inner nodes split
+// their area in two, side by side or stacked. Arrange() turns it into
+// rectangles, each pane a whole number of cells where the area allows,
+// with a divider between the halves of every split.
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Console3::UI {
+
+/// Where a split puts the new pane
+enum class SplitDirection : uint8_t {
+    Right,      ///< Side by side
+    Down,       ///< Stacked
+};
+
+/// A pane's (or divider's) rectangle in DIPs
+struct PaneRect {
+    uint32_t pane = 0;      ///< 0 for dividers
+    float left = 0.0f;
+    float top = 0.0f;
+    float right = 0.0f;
+    float bottom = 0.0f;
+
+    [[nodiscard]] bool Contains(float x, float y) const noexcept {
+        return x >= left && x < right && y >= top && y < bottom;
+    }
+};
+
+/// Tree of panes (see file comment)
+class PaneLayout {
+public:
+    /// The pane a layout starts with
+    static constexpr uint32_t kFirstPane = 1;
+
+    /// Width of the line between split panes (DIPs)
+    static constexpr float kDividerWidth = 1.0f;
+
+    PaneLayout();
+
+    /// Split a pane in two, giving it the first half
+    /// @return The new pane (second half), or 0 if there is no such pane
+    uint32_t Split(uint32_t pane, SplitDirection direction);
+
+    /// Remove a pane; its sibling takes the area the split had
+    /// @return false if there is no such pane, or it is the last one
+    bool Remove(uint32_t pane);
+
+    [[nodiscard]] bool Contains(uint32_t pane) const noexcept;
+    [[nodiscard]] size_t GetCount() const noexcept { return m_count; }
+
+    /// Get the pane that comes first (top left)
+    [[nodiscard]] uint32_t GetFirst() const noexcept;
+
+    /// Lay the panes out over an area
+    /// @param panes Filled with one rectangle per pane
+    /// @param dividers Filled with the lines between them
+    void Arrange(float width, float height, float cellWidth, float cellHeight,
+                 std::vector<PaneRect>& panes, std::vector<PaneRect>& dividers) const;
+
+private:
+    struct Node {
+        uint32_t pane = 0;          ///< Leaves only
+        SplitDirection direction = SplitDirection::Right;
+        std::unique_ptr<Node> first;
+        std::unique_ptr<Node> second;
+    };
+
+    [[nodiscard]] static Node* Find(Node* node, uint32_t pane) noexcept;
+    static bool Remove(std::unique_ptr<Node>& node, uint32_t pane);
+    static void Arrange(const Node& node, const PaneRect& area, float cellWidth, float cellHeight,
+                        std::vector<PaneRect>& panes, std::vector<PaneRect>& dividers);
+
+    std::unique_ptr<Node> m_root;
+    uint32_t m_nextPane = kFirstPane + 1;
+    size_t m_count = 1;
+};
+
+} // namespace Console3::UI
@@ -0,0 +1,175 @@
+// Console3 - RenderCapture.cpp
+// Frames of renderer input, recorded to replay in the render benchmark
+
+#include "UI/RenderCapture.h"
+#include "Core/TerminalBuffer.h"
+#include "Core/Utf.h"
+#include "Core/Varint.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+#include <string_view>
+
+namespace Console3::UI {
+
+namespace {
+
+constexpr std::string_view kMagic = "C3RCAP";
+constexpr uint64_t kVersion = 1;
+
+// Setup flags
+constexpr uint64_t kSetupCellGrid = 1;
+constexpr uint64_t kSetupLigatures = 2;
+
+// Frame flags
+constexpr uint64_t kFrameCursor = 1;
+constexpr uint64_t kFrameSelection = 2;
+constexpr uint64_t kFrameBlock = 4;
+
+using Core::GetVarint;
+using Core::PutVarint;
+
+void PutSigned(int64_t value, std::string& out) {
+    PutVarint(out, Core::ZigZagEncode(value));
+}
+
+bool GetSigned(std::string_view in, size_t& pos, int64_t& value) {
+    uint64_t raw = 0;
+    if (!GetVarint(in, pos, raw)) {
+        return false;
+    }
+    value = Core::ZigZagDecode(raw);
+    return true;
+}
+
+/// Read one frame record
+bool GetFrame(std::string_view in, size_t& pos, RenderCaptureFrame& frame) {
+    uint64_t length = 0;
+    uint64_t flags = 0;
+    uint64_t startCol = 0;
+    uint64_t endCol = 0;
+    if (!GetVarint(in, pos, length) || length > in.size() - pos) {
+        return false;
+    }
+    frame.delta.assign(in.substr(pos, static_cast<size_t>(length)));
+    pos += static_cast<size_t>(length);
+    if (!GetVarint(in, pos, flags) || !GetSigned(in, pos, frame.selectionStartLine) ||
+        !GetVarint(in, pos, startCol) || !GetSigned(in, pos, frame.selectionEndLine) ||
+        !GetVarint(in, pos, endCol)) {
+        return false;
+    }
+    frame.cursorShown = (flags & kFrameCursor) != 0;
+    frame.selectionActive = (flags & kFrameSelection) != 0;
+    frame.selectionBlock = (flags & kFrameBlock) != 0;
+    frame.selectionStartCol = static_cast<int>(startCol);
+    frame.selectionEndCol = static_cast<int>(endCol);
+    return true;
+}
+
+} // namespace
+
+std::optional<RenderCapture> RenderCapture::Load(const std::wstring& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return std::nullopt;
+    }
+    const std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    const std::string_view in = content;
+    if (!in.starts_with(kMagic)) {
+        return std::nullopt;
+    }
+
+    size_t pos = kMagic.size();
+    uint64_t version = 0, fontLength = 0, centiPoints = 0, dpi = 0, rows = 0, cols = 0, backend = 0, flags = 0;
+    if (!GetVarint(in, pos, version) || version != kVersion || !GetVarint(in, pos, fontLength) ||
+        fontLength > in.size() - pos) {
+        return std::nullopt;
+    }
+    RenderCapture capture;
+    capture.setup.font = Core::ToUtf16(in.substr(pos, static_cast<size_t>(fontLength)));
+    pos += static_cast<size_t>(fontLength);
+    if (!GetVarint(in, pos, centiPoints) || !GetVarint(in, pos, dpi) || !GetVarint(in, pos, rows) ||
+        !GetVarint(in, pos, cols) || !GetVarint(in, pos, backend) || !GetVarint(in, pos, flags) ||
+        backend > static_cast<uint64_t>(RenderBackend::Offscreen) || dpi == 0 || rows == 0 || cols == 0) {
+        return std::nullopt;
+    }
+    capture.setup.fontSize = static_cast<float>(centiPoints) / 100.0f;
+    capture.setup.dpi = static_cast<unsigned>(dpi);
+    capture.setup.rows = static_cast<int>(rows);
+    capture.setup.cols = static_cast<int>(cols);
+    capture.setup.backend = static_cast<RenderBackend>(backend);
+    capture.setup.cellGrid = (flags & kSetupCellGrid) != 0;
+    capture.setup.ligatures = (flags & kSetupLigatures) != 0;
+
+    // A truncated tail (the app closed mid-capture) keeps the whole frames
+    RenderCaptureFrame frame;
+    while (pos < in.size() && GetFrame(in, pos, frame)) {
+        capture.frames.push_back(std::move(frame));
+    }
+    return capture;
+}
+
+bool RenderCaptureWriter::Open(const RenderCaptureSetup& setup) {
+    wchar_t dir[MAX_PATH + 1];
+    const DWORD length = GetTempPathW(MAX_PATH + 1, dir);
+    if (length == 0 || length > MAX_PATH) {
+        return false;
+    }
+    SYSTEMTIME now{};
+    GetLocalTime(&now);
+    wchar_t name[64];
+    swprintf_s(name, L"Console3-render-%04u%02u%02u-%02u%02u%02u.c3rcap", now.wYear, now.wMonth, now.wDay,
+               now.wHour, now.wMinute, now.wSecond);
+    m_path = std::wstring(dir) + name;
+    m_file.open(m_path, std::ios::binary | std::ios::trunc);
+    if (!m_file) {
+        return false;
+    }
+
+    const std::string font = Core::ToUtf8(setup.font);
+    m_record.assign(kMagic);
+    PutVarint(m_record, kVersion);
+    PutVarint(m_record, font.size());
+    m_record += font;
+    PutVarint(m_record, static_cast<uint64_t>(std::lround(std::max(setup.fontSize, 0.0f) * 100.0f)));
+    PutVarint(m_record, setup.dpi);
+    PutVarint(m_record, static_cast<uint64_t>(setup.rows));
+    PutVarint(m_record, static_cast<uint64_t>(setup.cols));
+    PutVarint(m_record, static_cast<uint64_t>(setup.backend));
+    PutVarint(m_record, (setup.cellGrid ? kSetupCellGrid : 0) | (setup.ligatures ? kSetupLigatures : 0));
+    m_file.write(m_record.data(), static_cast<std::streamsize>(m_record.size()));
+
+    m_encoder.Reset();
+    m_frames = 0;
+    return static_cast<bool>(m_file);
+}
+
+bool RenderCaptureWriter::Add(const Core::TerminalBuffer& buffer, const Core::ScreenState& state,
+                              RenderCaptureFrame frame) {
+    if (!m_file.is_open()) {
+        return false;
+    }
+
+    frame.delta.clear();
+    (void)m_encoder.Encode(buffer, state, frame.delta);
+    m_record.clear();
+    PutVarint(m_record, frame.delta.size());
+    m_record += frame.delta;
+    PutVarint(m_record, (frame.cursorShown ? kFrameCursor : 0) | (frame.selectionActive ? kFrameSelection : 0) |
+                            (frame.selectionBlock ? kFrameBlock : 0));
+    PutSigned(frame.selectionStartLine, m_record);
+    PutVarint(m_record, static_cast<uint64_t>(std::max(frame.selectionStartCol, 0)));
+    PutSigned(frame.selectionEndLine, m_record);
+    PutVarint(m_record, static_cast<uint64_t>(std::max(frame.selectionEndCol, 0)));
+    m_file.write(m_record.data(), static_cast<std::streamsize>(m_record.size()));
+
+    if (!m_file || ++m_frames >= kFrames) {
+        m_file.close();
+        return false;
+    }
+    return true;
+}
+
+} // namespace Console3::UI
@@ -0,0 +1,108 @@
+#pragma once
+// Console3 - RenderCapture.h
+// Frames of renderer input, recorded to replay in the render benchmark
+//
+// "Rendering is slow with my setup" can't be looked into without the setup:
+// the font, the DPI and what was on the screen. Ctrl+Shift+F9 in a view
+// records the next kFrames frames it paints as what the renderer was given:
+// the screen as a ScreenDelta frame of the rows changed since the frame
+// before (with the cursor's position and visibility), the selection, and
+// whether the cursor was drawn; the font, DPI, grid size and renderer
+// configuration are written once, up front. The file goes to the temp
+// directory, named for the time it was started. Console3RenderBench
+// --replay paints it offscreen with the real render path, each frame's
+// delta fed to the view's emulator as VT (ScreenDeltaDecoder::RenderVt), so
+// it can be profiled against exactly what the user saw.
+//
+// Only frames of the screen are recorded: frames painted while scrolled
+// back draw the history, which the file does not hold.
+//
+// File layout (integers are LEB128 varints; the selection's lines are
+// zigzag, relative to screen row 0):
+//
+//   "C3RCAP" version fontLength font(UTF-8) centiPoints dpi rows cols
+//   backend(RenderBackend) setupFlags
+//   frame = deltaLength delta flags startLine startCol endLine endCol
+//
+// An empty delta is a frame the screen did not change for (a blink, a
+// selection drag). A file cut short keeps its whole frames.
+
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Core/ScreenDelta.h"
+#include "UI/D2DRenderer.h"
+
+namespace Console3::Core {
+class TerminalBuffer;
+}
+
+namespace Console3::UI {
+
+/// What a capture was painted with
+struct RenderCaptureSetup {
+    std::wstring font;
+    float fontSize = 0.0f;              ///< Points, zoom included
+    unsigned dpi = 96;
+    int rows = 0;
+    int cols = 0;
+    RenderBackend backend = RenderBackend::SwapChain;
+    bool cellGrid = false;              ///< Drawn with the cell grid shader
+    bool ligatures = false;
+};
+
+/// One painted frame's input
+struct RenderCaptureFrame {
+    std::string delta;                  ///< ScreenDelta frame (empty: screen unchanged)
+    bool cursorShown = false;           ///< Drawn (focused, in the blink's on phase)
+    bool selectionActive = false;
+    bool selectionBlock = false;
+    int64_t selectionStartLine = 0;     ///< Relative to screen row 0
+    int selectionStartCol = 0;
+    int64_t selectionEndLine = 0;
+    int selectionEndCol = 0;
+};
+
+/// A capture read back (see file comment)
+struct RenderCapture {
+    RenderCaptureSetup setup;
+    std::vector<RenderCaptureFrame> frames;
+
+    /// Read a capture file
+    /// @return The capture, or nullopt if the file can't be read or is not one
+    [[nodiscard]] static std::optional<RenderCapture> Load(const std::wstring& path);
+};
+
+/// Records a view's frames to a file (see file comment)
+class RenderCaptureWriter {
+public:
+    static constexpr int kFrames = 600;
+
+    /// Create the file in the temp directory and write the setup
+    /// @return false if it can't be created
+    bool Open(const RenderCaptureSetup& setup);
+
+    /// Record a painted frame
+    /// @param frame Its selection and cursor; the delta is encoded here
+    /// @return true while more frames are wanted (false once kFrames are
+    ///         written, or a write failed)
+    bool Add(const Core::TerminalBuffer& buffer, const Core::ScreenState& state, RenderCaptureFrame frame);
+
+    /// Get the file's path
+    [[nodiscard]] const std::wstring& GetPath() const noexcept { return m_path; }
+
+    /// Get the frames written so far
+    [[nodiscard]] int GetFrames() const noexcept { return m_frames; }
+
+private:
+    std::ofstream m_file;
+    std::wstring m_path;
+    Core::ScreenDeltaEncoder m_encoder;
+    std::string m_record;               ///< Scratch
+    int m_frames = 0;
+};
+
+} // namespace Console3::UI
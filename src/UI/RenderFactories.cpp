@@ -0,0 +1,48 @@
+// Console3 - RenderFactories.cpp
+// Process-wide Direct2D and DirectWrite factories, created on first use
+
+#include "UI/RenderFactories.h"
+#include "Core/StartupTrace.h"
+#include <wrl/client.h>
+
+#pragma comment(lib, "d2d1.lib")
+#pragma comment(lib, "dwrite.lib")
+
+using Microsoft::WRL::ComPtr;
+
+namespace Console3::UI {
+
+ID2D1Factory1* RenderFactories::GetD2DFactory() {
+    // Static initialization runs once, even with threads racing for it
+    static const ComPtr<ID2D1Factory1> s_factory = [] {
+        D2D1_FACTORY_OPTIONS options{};
+#ifdef _DEBUG
+        options.debugLevel = D2D1_DEBUG_LEVEL_INFORMATION;
+#else
+        options.debugLevel = D2D1_DEBUG_LEVEL_NONE;
+#endif
+        ComPtr<ID2D1Factory1> factory;
+        if (FAILED(D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED, __uuidof(ID2D1Factory1), &options,
+                                     reinterpret_cast<void**>(factory.GetAddressOf())))) {
+            return ComPtr<ID2D1Factory1>();
+        }
+        Core::StartupTrace::Shared().Mark(Core::StartupPhase::Direct2DReady);
+        return factory;
+    }();
+    return s_factory.Get();
+}
+
+IDWriteFactory1* RenderFactories::GetDWriteFactory() {
+    static const ComPtr<IDWriteFactory1> s_factory = [] {
+        ComPtr<IDWriteFactory1> factory;
+        if (FAILED(DWriteCreateFactory(DWRITE_FACTORY_TYPE_SHARED, __uuidof(IDWriteFactory1),
+                                       reinterpret_cast<IUnknown**>(factory.GetAddressOf())))) {
+            return ComPtr<IDWriteFactory1>();
+        }
+        Core::StartupTrace::Shared().Mark(Core::StartupPhase::DirectWriteReady);
+        return factory;
+    }();
+    return s_factory.Get();
+}
+
+} // namespace Console3::UI
@@ -0,0 +1,38 @@
+#pragma once
+// Console3 - RenderFactories.h
+// Process-wide Direct2D and DirectWrite factories, created on first use
+//
+// Creating the DirectWrite factory loads the system font collection, which
+// can take tens of milliseconds on a machine with many fonts. Nothing needs
+// either factory to show the main window and start the shell, so they are
+// no longer created before the window: the first renderer (or the font
+// enumeration running in the background after startup) creates them, and
+// everyone after shares them. The DirectWrite factory may be used from any
+// thread; the Direct2D one, as before, from the UI thread only.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+#include <d2d1_1.h>
+#include <dwrite_1.h>
+
+namespace Console3::UI {
+
+/// Shared rendering factories (see file comment)
+class RenderFactories {
+public:
+    /// Get the Direct2D factory, creating it on first use (UI thread)
+    /// @return The factory (owned here), or nullptr if it can't be created
+    [[nodiscard]] static ID2D1Factory1* GetD2DFactory();
+
+    /// Get the DirectWrite factory, creating it on first use
+    /// @return The factory (owned here), or nullptr if it can't be created
+    [[nodiscard]] static IDWriteFactory1* GetDWriteFactory();
+};
+
+} // namespace Console3::UI
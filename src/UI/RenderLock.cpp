@@ -0,0 +1,56 @@
+// Console3 - RenderLock.cpp
+// The lock that stands in for "on the UI thread"
+
+#include "UI/RenderLock.h"
+
+namespace Console3::UI {
+
+RenderLock& RenderLock::Shared() {
+    static RenderLock s_lock;
+    return s_lock;
+}
+
+void RenderLock::Lock() {
+    Reacquire(1);
+}
+
+void RenderLock::Unlock() noexcept {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (m_owner != std::this_thread::get_id() || m_depth == 0) {
+        return;
+    }
+    if (--m_depth == 0) {
+        m_owner = {};
+        m_released.notify_one();
+    }
+}
+
+unsigned RenderLock::Release() noexcept {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (m_owner != std::this_thread::get_id()) {
+        return 0;
+    }
+    const unsigned depth = m_depth;
+    m_depth = 0;
+    m_owner = {};
+    m_released.notify_one();
+    return depth;
+}
+
+void RenderLock::Reacquire(unsigned depth) {
+    if (depth == 0) {
+        return;
+    }
+    const std::thread::id self = std::this_thread::get_id();
+    std::unique_lock<std::mutex> guard(m_mutex);
+    m_released.wait(guard, [this, self]() { return m_depth == 0 || m_owner == self; });
+    m_owner = self;
+    m_depth += depth;
+}
+
+bool RenderLock::IsHeld() const {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_owner == std::this_thread::get_id();
+}
+
+} // namespace Console3::UI
@@ -0,0 +1,112 @@
+#pragma once
+// Console3 - RenderLock.h
+// The lock that stands in for "on the UI thread" now that windows render
+// on threads of their own
+//
+// Each window paints on its render thread (RenderThread.h), which applies
+// its sessions' output to their buffers and draws them, while the UI thread
+// keeps the window's messages. Views, renderers and sessions' presented
+// buffers were written for one thread, and all windows share one Direct3D
+// device and their glyph atlases (SharedRenderResources), so they are not
+// made thread-safe piece by piece: whatever touches them holds this one
+// process-wide lock instead. The UI thread holds it while a window's
+// handlers run (RenderLockedWindowProc), a render thread while it runs a
+// frame; either runs as the UI thread alone used to.
+//
+// The lock is recursive on a thread, as window procedures nest. A modal
+// loop (sizing, moving, a menu, a dialog) runs inside a handler and would
+// hold it throughout, so the handler that starts one releases every level
+// (Release) and the one that ends it takes them back (Reacquire); the
+// messages the loop dispatches take the lock one at a time, and the render
+// thread paints in between. Unlocking a lock the thread no longer holds is
+// allowed, for the handler whose level a Release took.
+//
+// Nothing may wait for the UI thread while holding the lock: a render
+// thread never sends the windows a message, it posts.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace Console3::UI {
+
+/// Recursive lock serializing the UI thread and the render threads (see
+/// file comment)
+class RenderLock {
+public:
+    /// Get the process's lock
+    static RenderLock& Shared();
+
+    RenderLock() = default;
+
+    RenderLock(const RenderLock&) = delete;
+    RenderLock& operator=(const RenderLock&) = delete;
+
+    /// Take a level, waiting for another thread to release the lock
+    void Lock();
+
+    /// Give back a level (nothing if the thread does not hold the lock)
+    void Unlock() noexcept;
+
+    /// Release every level the thread holds
+    /// @return How many there were (0 if it held none)
+    unsigned Release() noexcept;
+
+    /// Take back levels given up by Release()
+    void Reacquire(unsigned depth);
+
+    /// Check if the calling thread holds the lock
+    [[nodiscard]] bool IsHeld() const;
+
+    /// Holds a level for its lifetime
+    class Scope {
+    public:
+        explicit Scope(RenderLock& lock) : m_lock(lock) { m_lock.Lock(); }
+        ~Scope() { m_lock.Unlock(); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        RenderLock& m_lock;
+    };
+
+    /// Releases the thread's levels for its lifetime (a modal dialog)
+    class Unlocked {
+    public:
+        explicit Unlocked(RenderLock& lock) : m_lock(lock), m_depth(lock.Release()) {}
+        ~Unlocked() { m_lock.Reacquire(m_depth); }
+
+        Unlocked(const Unlocked&) = delete;
+        Unlocked& operator=(const Unlocked&) = delete;
+
+    private:
+        RenderLock& m_lock;
+        unsigned m_depth;
+    };
+
+private:
+    mutable std::mutex m_mutex;
+    std::condition_variable m_released;
+    std::thread::id m_owner;        ///< Default-constructed while free
+    unsigned m_depth = 0;
+};
+
+/// Window procedure running a window's own under the render lock
+/// Returned from a window class's GetWindowProc() override.
+template <class TWindow>
+LRESULT CALLBACK RenderLockedWindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam) {
+    RenderLock::Scope lock(RenderLock::Shared());
+    return TWindow::WindowProc(hWnd, message, wParam, lParam);
+}
+
+} // namespace Console3::UI
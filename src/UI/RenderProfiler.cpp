@@ -0,0 +1,140 @@
+// Console3 - RenderProfiler.cpp
+// Frame timing and renderer counters for the profile overlay and ETW
+
+#include "UI/RenderProfiler.h"
+#include "Core/PerfClock.h"
+#include <wil/Tracelogging.h>
+#include <algorithm>
+#include <vector>
+
+namespace Console3::UI {
+
+namespace {
+
+/// TraceLogging provider "Console3.Render"
+class RenderTraceProvider final : public wil::TraceLoggingProvider {
+    // 56e48ef5-a818-5cb9-a316-6c76fc74c3bd
+    IMPLEMENT_TRACELOGGING_CLASS_WITHOUT_TELEMETRY(
+        RenderTraceProvider, "Console3.Render",
+        (0x56e48ef5, 0xa818, 0x5cb9, 0xa3, 0x16, 0x6c, 0x76, 0xfc, 0x74, 0xc3, 0xbd));
+
+public:
+    DEFINE_EVENT_METHOD(Frame)(const FrameProfile& frame) noexcept {
+        TraceLoggingWrite(Provider(), "Frame",
+                          TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE),
+                          TraceLoggingUInt64(frame.TotalMicros(), "TotalMicros"),
+                          TraceLoggingUInt64(frame.phaseMicros[0], "SyncMicros"),
+                          TraceLoggingUInt64(frame.phaseMicros[1], "BuildMicros"),
+                          TraceLoggingUInt64(frame.phaseMicros[2], "DrawMicros"),
+                          TraceLoggingUInt64(frame.phaseMicros[3], "PresentMicros"),
+                          TraceLoggingUInt32(frame.dirtyRows, "DirtyRows"),
+                          TraceLoggingUInt32(frame.counters.drawCalls, "DrawCalls"),
+                          TraceLoggingUInt32(frame.counters.glyphRuns, "GlyphRuns"),
+                          TraceLoggingUInt32(frame.counters.atlasHits, "AtlasHits"),
+                          TraceLoggingUInt32(frame.counters.atlasMisses, "AtlasMisses"),
+                          TraceLoggingUInt32(frame.counters.brushHits, "BrushHits"),
+                          TraceLoggingUInt32(frame.counters.brushMisses, "BrushMisses"));
+    }
+};
+
+double HitRate(uint64_t hits, uint64_t misses) noexcept {
+    return hits + misses > 0 ? static_cast<double>(hits) / static_cast<double>(hits + misses) : 1.0;
+}
+
+} // namespace
+
+void RenderProfiler::BeginFrame() noexcept {
+    m_current = FrameProfile{};
+    m_markMicros = Core::PerfClock::NowMicros();
+    m_inFrame = true;
+}
+
+void RenderProfiler::Mark(RenderPhase phase) noexcept {
+    if (!m_inFrame) {
+        return;
+    }
+    const uint64_t now = Core::PerfClock::NowMicros();
+    m_current.phaseMicros[static_cast<size_t>(phase)] += now - m_markMicros;
+    m_markMicros = now;
+}
+
+void RenderProfiler::EndFrame(const RenderCounters& counters) noexcept {
+    if (!m_inFrame) {
+        return;
+    }
+    m_inFrame = false;
+    m_current.counters = counters;
+
+    m_frames[m_next] = m_current;
+    m_next = (m_next + 1) % kHistory;
+    m_count = std::min(m_count + 1, kHistory);
+    m_frameTimes.Add(m_current.TotalMicros());
+
+    RenderTraceProvider::Frame(m_current);
+}
+
+uint64_t RenderProfiler::Percentile(double fraction) const {
+    if (m_count == 0) {
+        return 0;
+    }
+
+    std::vector<uint64_t> totals;
+    totals.reserve(m_count);
+    for (size_t index = 0; index < m_count; ++index) {
+        totals.push_back(m_frames[index].TotalMicros());
+    }
+    const auto rank = static_cast<size_t>(std::clamp(fraction, 0.0, 1.0) * static_cast<double>(m_count - 1));
+    std::nth_element(totals.begin(), totals.begin() + static_cast<std::ptrdiff_t>(rank), totals.end());
+    return totals[rank];
+}
+
+FrameProfile RenderProfiler::Mean() const noexcept {
+    FrameProfile mean;
+    if (m_count == 0) {
+        return mean;
+    }
+
+    // Sum wide, then divide
+    std::array<uint64_t, 4> phases{};
+    uint64_t dirtyRows = 0;
+    uint64_t drawCalls = 0;
+    uint64_t glyphRuns = 0;
+    for (size_t index = 0; index < m_count; ++index) {
+        const FrameProfile& frame = m_frames[index];
+        for (size_t phase = 0; phase < phases.size(); ++phase) {
+            phases[phase] += frame.phaseMicros[phase];
+        }
+        dirtyRows += frame.dirtyRows;
+        drawCalls += frame.counters.drawCalls;
+        glyphRuns += frame.counters.glyphRuns;
+    }
+    for (size_t phase = 0; phase < phases.size(); ++phase) {
+        mean.phaseMicros[phase] = phases[phase] / m_count;
+    }
+    mean.dirtyRows = static_cast<uint32_t>(dirtyRows / m_count);
+    mean.counters.drawCalls = static_cast<uint32_t>(drawCalls / m_count);
+    mean.counters.glyphRuns = static_cast<uint32_t>(glyphRuns / m_count);
+    return mean;
+}
+
+double RenderProfiler::AtlasHitRate() const noexcept {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    for (size_t index = 0; index < m_count; ++index) {
+        hits += m_frames[index].counters.atlasHits;
+        misses += m_frames[index].counters.atlasMisses;
+    }
+    return HitRate(hits, misses);
+}
+
+double RenderProfiler::BrushHitRate() const noexcept {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    for (size_t index = 0; index < m_count; ++index) {
+        hits += m_frames[index].counters.brushHits;
+        misses += m_frames[index].counters.brushMisses;
+    }
+    return HitRate(hits, misses);
+}
+
+} // namespace Console3::UI
@@ -0,0 +1,96 @@
+#pragma once
+// Console3 - RenderProfiler.h
+// Frame timing and renderer counters for the profile overlay and ETW
+//
+// TerminalView marks the phases of each frame as it renders: damage sync
+// (dirty rows found, scrolled pixels moved), row build (changed rows drawn
+// into the retained frame, grid rows or scrollback tiles filled), draw
+// (the frame and overlays drawn into the window) and present (waiting for
+// the swap chain, EndDraw and the present itself). The last kHistory frames
+// are kept for percentiles and means. Every frame is also written as a
+// "Frame" event of the Console3.Render TraceLogging provider, so the same
+// numbers can be captured in the field with WPR.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include "Core/InputLatency.h"
+#include "UI/D2DRenderer.h"
+
+#include <array>
+#include <cstdint>
+
+namespace Console3::UI {
+
+/// Phases a frame's time is split into
+enum class RenderPhase : uint8_t {
+    Sync = 0,       ///< Damage sync
+    Build = 1,      ///< Row build
+    Draw = 2,       ///< Drawing into the window
+    Present = 3,    ///< Swap chain wait, EndDraw and present
+};
+
+/// Costs of one rendered frame
+struct FrameProfile {
+    std::array<uint64_t, 4> phaseMicros{};  ///< By RenderPhase
+    uint32_t dirtyRows = 0;                 ///< Rows (or scrollback tiles) drawn again
+    RenderCounters counters;
+
+    [[nodiscard]] uint64_t TotalMicros() const noexcept {
+        return phaseMicros[0] + phaseMicros[1] + phaseMicros[2] + phaseMicros[3];
+    }
+};
+
+/// Records the last frames' profiles
+class RenderProfiler {
+public:
+    static constexpr size_t kHistory = 240;     ///< Frames kept (a few seconds of rendering)
+
+    /// Start timing a frame
+    void BeginFrame() noexcept;
+
+    /// Charge the time since the last mark (or BeginFrame) to a phase
+    void Mark(RenderPhase phase) noexcept;
+
+    /// Count rows drawn again this frame
+    void AddDirtyRows(uint32_t rows) noexcept { m_current.dirtyRows += rows; }
+
+    /// Get the rows drawn in the current (or just ended) frame
+    [[nodiscard]] uint32_t GetDirtyRows() const noexcept { return m_current.dirtyRows; }
+
+    /// Finish the frame: keep its profile and write its ETW event
+    void EndFrame(const RenderCounters& counters) noexcept;
+
+    /// Get the frame time (microseconds) a fraction of the kept frames are
+    /// at or under (0.5 = median)
+    [[nodiscard]] uint64_t Percentile(double fraction) const;
+
+    /// Get the mean of the kept frames (counters summed then divided)
+    [[nodiscard]] FrameProfile Mean() const noexcept;
+
+    /// Get the cache hit rates over the kept frames (0-1; 1 without lookups)
+    [[nodiscard]] double AtlasHitRate() const noexcept;
+    [[nodiscard]] double BrushHitRate() const noexcept;
+
+    [[nodiscard]] size_t GetFrameCount() const noexcept { return m_count; }
+
+    /// Get the frame times of every frame since the view was created
+    /// (telemetry, TelemetryEndpoint.h)
+    [[nodiscard]] const Core::LatencyHistogram& GetFrameTimes() const noexcept { return m_frameTimes; }
+
+private:
+    std::array<FrameProfile, kHistory> m_frames{};
+    size_t m_next = 0;              ///< Slot the next frame goes in
+    size_t m_count = 0;             ///< Frames kept (up to kHistory)
+    Core::LatencyHistogram m_frameTimes;
+
+    FrameProfile m_current;
+    uint64_t m_markMicros = 0;      ///< Time of the last mark
+    bool m_inFrame = false;
+};
+
+} // namespace Console3::UI
@@ -0,0 +1,151 @@
+// Console3 - RenderThread.cpp
+// A window's render thread: its frames and its sessions' output
+
+#include "UI/RenderThread.h"
+#include "UI/RenderLock.h"
+#include "Core/ThreadPolicy.h"
+#include <algorithm>
+
+namespace Console3::UI {
+
+RenderThread::~RenderThread() {
+    Stop();
+}
+
+bool RenderThread::Start() {
+    if (m_thread.joinable()) {
+        return true;
+    }
+    if (!m_wake && !m_wake.try_create(wil::EventOptions::None, nullptr)) {
+        return false;
+    }
+    m_stopping.store(false);
+    m_thread = std::thread([this]() { ThreadProc(); });
+    return true;
+}
+
+void RenderThread::Stop() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+    m_stopping.store(true);
+    SetEvent(m_wake.get());
+
+    // A handler waiting for the lock gets it, sees the stop and returns
+    RenderLock::Unlocked unlocked(RenderLock::Shared());
+    m_thread.join();
+}
+
+bool RenderThread::AddWaitHandle(HANDLE handle, WaitHandler handler) {
+    if (!handle || handle == INVALID_HANDLE_VALUE || !handler) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_handlesLock);
+        if (m_handles.size() >= kMaxWaitHandles ||
+            std::find(m_handles.begin(), m_handles.end(), handle) != m_handles.end()) {
+            return false;
+        }
+        m_handles.push_back(handle);
+        m_handlers.push_back(std::move(handler));
+    }
+    if (m_wake) {
+        SetEvent(m_wake.get());
+    }
+    return true;
+}
+
+bool RenderThread::RemoveWaitHandle(HANDLE handle) {
+    {
+        std::lock_guard<std::mutex> lock(m_handlesLock);
+        const auto it = std::find(m_handles.begin(), m_handles.end(), handle);
+        if (it == m_handles.end()) {
+            return false;
+        }
+        const auto index = std::distance(m_handles.begin(), it);
+        m_handles.erase(it);
+        m_handlers.erase(m_handlers.begin() + index);
+    }
+    if (m_wake) {
+        SetEvent(m_wake.get());
+    }
+    return true;
+}
+
+void RenderThread::SetForeground(bool foreground) {
+    if (m_foreground.exchange(foreground) != foreground && m_wake) {
+        SetEvent(m_wake.get());
+    }
+}
+
+void RenderThread::ApplyForeground() {
+    const bool foreground = m_foreground.load() && !m_stopping.load();
+    if (foreground == m_appliedForeground) {
+        return;
+    }
+    m_appliedForeground = foreground;
+    (void)Core::ThreadPolicy::SetCurrentQos(foreground ? Core::ThreadQos::High : Core::ThreadQos::Default);
+    if (foreground) {
+        m_mmcss = Core::ThreadPolicy::JoinMmcss();
+    } else {
+        Core::ThreadPolicy::LeaveMmcss(m_mmcss);
+        m_mmcss = nullptr;
+    }
+}
+
+void RenderThread::ThreadProc() {
+    std::vector<HANDLE> waits;
+    while (!m_stopping.load()) {
+        ApplyForeground();
+
+        // The wake event first, then the handles as registered
+        waits.assign(1, m_wake.get());
+        {
+            std::lock_guard<std::mutex> lock(m_handlesLock);
+            waits.insert(waits.end(), m_handles.begin(), m_handles.end());
+        }
+
+        const DWORD result = WaitForMultipleObjects(static_cast<DWORD>(waits.size()), waits.data(), FALSE,
+                                                    INFINITE);
+        if (result == WAIT_OBJECT_0 || m_stopping.load()) {
+            continue;
+        }
+        if (result == WAIT_FAILED) {
+            // A handle closed before it was removed: wait again once the
+            // owner has caught up
+            Sleep(1);
+            continue;
+        }
+        if (result < WAIT_OBJECT_0 + waits.size()) {
+            RenderLock::Scope lock(RenderLock::Shared());
+            if (!m_stopping.load()) {
+                DispatchSignaled(waits, result - WAIT_OBJECT_0);
+            }
+        }
+    }
+    ApplyForeground();
+}
+
+void RenderThread::DispatchSignaled(const std::vector<HANDLE>& handles, size_t firstIndex) {
+    for (size_t i = firstIndex; i < handles.size(); ++i) {
+        // Removed while we waited for the lock: the handle may be gone
+        const WaitHandler handler = FindHandler(handles[i]);
+        if (!handler) {
+            continue;
+        }
+        // The wait consumed the first signal; poll the rest so a busy
+        // session does not starve the ones registered after it
+        if (i == firstIndex || WaitForSingleObject(handles[i], 0) == WAIT_OBJECT_0) {
+            handler();
+        }
+    }
+}
+
+WaitHandler RenderThread::FindHandler(HANDLE handle) const {
+    std::lock_guard<std::mutex> lock(m_handlesLock);
+    const auto it = std::find(m_handles.begin(), m_handles.end(), handle);
+    return it != m_handles.end() ? m_handlers[static_cast<size_t>(std::distance(m_handles.begin(), it))]
+                                 : WaitHandler{};
+}
+
+} // namespace Console3::UI
@@ -0,0 +1,99 @@
+#pragma once
+// Console3 - RenderThread.h
+// A window's render thread: its frames and its sessions' output
+//
+// Painting on the UI thread meant a window stopped updating whenever that
+// thread was busy elsewhere: in the modal loop of a drag or resize, in a
+// dialog, or in another window's slow frame, and a slow frame in turn held
+// up the keys typed meanwhile. Each window now has a thread that waits on
+// its sessions' output events and its frame scheduler's timer
+// (FrameScheduler.h), applies the output to the buffers and draws and
+// presents the frame, on its own cadence. The UI thread is left with input
+// and window messages; a view's WM_PAINT only asks the render thread for a
+// frame.
+//
+// Handlers run under the render lock (RenderLock.h), which the UI thread
+// also holds while it handles the window's messages, so they see the view
+// and sessions as UI-thread code always did. What must happen on the UI
+// thread (timers, the status bar, window modes) is posted to it.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#define STRICT
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+
+#include <Windows.h>
+#include <wil/resource.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "UI/MessageLoop.h"
+
+namespace Console3::UI {
+
+/// Thread running a window's frames (see file comment)
+class RenderThread : public WaitHandleHost {
+public:
+    /// Maximum number of handles (one wait slot wakes the thread)
+    static constexpr size_t kMaxWaitHandles = MAXIMUM_WAIT_OBJECTS - 1;
+
+    RenderThread() = default;
+    ~RenderThread();
+
+    RenderThread(const RenderThread&) = delete;
+    RenderThread& operator=(const RenderThread&) = delete;
+
+    /// Start the thread
+    /// @return false if it could not be started
+    [[nodiscard]] bool Start();
+
+    /// Stop the thread; a handler running finishes first (any thread,
+    /// render lock held or not)
+    void Stop();
+
+    [[nodiscard]] bool IsRunning() const noexcept { return m_thread.joinable(); }
+
+    /// Handlers run on the render thread, under the render lock; the handle
+    /// is waited on from the next wait (any thread)
+    bool AddWaitHandle(HANDLE handle, WaitHandler handler) override;
+    bool RemoveWaitHandle(HANDLE handle) override;
+
+    /// Tell the thread whether its window is the foreground one: it then
+    /// runs at high QoS and in MMCSS (see Core/ThreadPolicy.h; any thread)
+    void SetForeground(bool foreground);
+
+private:
+    void ThreadProc();
+
+    /// Take the class the window's state asks for (render thread)
+    void ApplyForeground();
+
+    /// Run the handler of a signaled handle, and of any other signaled
+    /// since, in registration order (render lock held)
+    void DispatchSignaled(const std::vector<HANDLE>& handles, size_t firstIndex);
+
+    /// Find a handle's handler (empty once it was removed)
+    [[nodiscard]] WaitHandler FindHandler(HANDLE handle) const;
+
+    std::thread m_thread;
+    wil::unique_event m_wake;           ///< Auto reset: stop, or the handles changed
+    std::atomic<bool> m_stopping{false};
+    std::atomic<bool> m_foreground{false};
+    bool m_appliedForeground = false;   ///< Render thread
+    HANDLE m_mmcss = nullptr;           ///< Render thread: MMCSS registration while foreground
+
+    mutable std::mutex m_handlesLock;
+    std::vector<HANDLE> m_handles;      ///< Parallel to m_handlers
+    std::vector<WaitHandler> m_handlers;
+};
+
+} // namespace Console3::UI
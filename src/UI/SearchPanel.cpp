@@ -0,0 +1,383 @@
+// Console3 - SearchPanel.cpp
+// Find in All Tabs: a global search and its results
+
+#include "UI/SearchPanel.h"
+#include "Core/Utf.h"
+#include <atlstr.h>
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace Console3::UI {
+
+namespace {
+
+// Hands the sources' lines to the pool while a search reads them
+constexpr UINT_PTR kUpdateTimerId = 1;
+constexpr UINT kUpdateTimerMs = 15;
+
+// Layout, in pixels at 96 DPI
+constexpr int kMargin = 8;
+constexpr int kRowHeight = 24;
+constexpr int kButtonWidth = 80;
+constexpr int kCheckWidth = 110;
+
+[[nodiscard]] bool IsDigit(wchar_t c) noexcept {
+    return c >= L'0' && c <= L'9';
+}
+
+/// Read a "H:MM" or "HH:MM" time of day
+/// @return Minutes since midnight, or -1 if there is none at pos
+int ReadClock(std::wstring_view text, size_t& pos) {
+    int hours = 0;
+    size_t at = pos;
+    for (; at < text.size() && at - pos < 2 && IsDigit(text[at]); ++at) {
+        hours = hours * 10 + (text[at] - L'0');
+    }
+    if (at == pos || at + 3 > text.size() || text[at] != L':' || !IsDigit(text[at + 1]) ||
+        !IsDigit(text[at + 2])) {
+        return -1;
+    }
+    const int minutes = (text[at + 1] - L'0') * 10 + (text[at + 2] - L'0');
+    if (hours > 23 || minutes > 59) {
+        return -1;
+    }
+    pos = at + 3;
+    return hours * 60 + minutes;
+}
+
+/// Convert a local time of day on a date to Unix milliseconds
+uint64_t LocalToUnixMs(SYSTEMTIME date, int minutes) {
+    date.wHour = static_cast<WORD>(minutes / 60);
+    date.wMinute = static_cast<WORD>(minutes % 60);
+    date.wSecond = 0;
+    date.wMilliseconds = 0;
+    SYSTEMTIME utc{};
+    FILETIME file{};
+    if (!TzSpecificLocalTimeToSystemTime(nullptr, &date, &utc) || !SystemTimeToFileTime(&utc, &file)) {
+        return 0;
+    }
+    const uint64_t ticks = (static_cast<uint64_t>(file.dwHighDateTime) << 32) | file.dwLowDateTime;
+    return ticks / 10000 - 11644473600000ull;
+}
+
+/// Take a leading time range off a query: "14:02 " for a minute, or
+/// "14:02-14:05 " (both minutes included), local time at its last
+/// occurrence; the rest is the text to match
+/// @return false if the query does not start with one
+bool TakeTimeRange(std::wstring& text, uint64_t& fromMs, uint64_t& toMs) {
+    size_t pos = 0;
+    const int from = ReadClock(text, pos);
+    if (from < 0) {
+        return false;
+    }
+    int to = from;
+    if (pos < text.size() && text[pos] == L'-') {
+        ++pos;
+        to = ReadClock(text, pos);
+        if (to < 0) {
+            return false;
+        }
+    }
+    if (pos < text.size() && text[pos] != L' ') {
+        return false;
+    }
+
+    // A start still ahead today was yesterday; an end before the start is
+    // the next day
+    constexpr uint64_t kDayMs = 24ull * 60 * 60 * 1000;
+    SYSTEMTIME today{};
+    GetLocalTime(&today);
+    fromMs = LocalToUnixMs(today, from);
+    toMs = LocalToUnixMs(today, to) + 60 * 1000 - 1;
+    if (from > today.wHour * 60 + today.wMinute) {
+        fromMs -= kDayMs;
+        toMs -= kDayMs;
+    }
+    if (to < from) {
+        toMs += kDayMs;
+    }
+    text.erase(0, std::min(pos + 1, text.size()));
+    return true;
+}
+
+/// Rank order: most recent first, then by session and line
+bool RanksBefore(const Core::GlobalSearchHit& a, const Core::GlobalSearchHit& b) noexcept {
+    if (a.age != b.age) {
+        return a.age < b.age;
+    }
+    if (a.source != b.source) {
+        return a.source < b.source;
+    }
+    return a.line < b.line;
+}
+
+} // namespace
+
+SearchPanel::SearchPanel(SourcesCallback sources, JumpCallback jump)
+    : m_sourcesCallback(std::move(sources))
+    , m_jumpCallback(std::move(jump)) {
+}
+
+SearchPanel::~SearchPanel() {
+    if (IsWindow()) {
+        DestroyWindow();
+    }
+}
+
+bool SearchPanel::Show() {
+    if (!IsWindow()) {
+        const HWND active = ::GetActiveWindow();
+        if (!Create(nullptr, CRect(0, 0, 720, 480), L"Find in All Tabs", WS_OVERLAPPEDWINDOW | WS_CLIPCHILDREN,
+                    WS_EX_TOOLWINDOW | WS_EX_CONTROLPARENT)) {
+            return false;
+        }
+        CenterWindow(active);
+    }
+    ShowWindow(IsIconic() ? SW_RESTORE : SW_SHOW);
+    SetForegroundWindow(m_hWnd);
+    m_queryEdit.SetFocus();
+    m_queryEdit.SetSelAll();
+    return true;
+}
+
+void SearchPanel::AddSource(uint32_t source, const std::wstring& name, const Core::TerminalBuffer& buffer) {
+    m_names[source] = name;
+    m_search.AddSource(source, buffer);
+}
+
+void SearchPanel::RemoveSource(uint32_t source) {
+    m_search.RemoveSource(source);
+}
+
+BOOL SearchPanel::PreTranslateMessage(MSG* pMsg) {
+    // Every filter sees every message of the thread
+    if (!IsWindow() || (pMsg->hwnd != m_hWnd && !IsChild(pMsg->hwnd))) {
+        return FALSE;
+    }
+    RenderLock::Scope lock(RenderLock::Shared());
+
+    // Enter in the query searches, Escape hides the window
+    if (pMsg->message == WM_KEYDOWN && pMsg->wParam == VK_RETURN && pMsg->hwnd == m_queryEdit.m_hWnd) {
+        StartSearch();
+        return TRUE;
+    }
+    if (pMsg->message == WM_KEYDOWN && pMsg->wParam == VK_ESCAPE) {
+        ShowWindow(SW_HIDE);
+        return TRUE;
+    }
+    return ::IsDialogMessageW(m_hWnd, pMsg);
+}
+
+// ============================================================================
+// Message Handlers
+// ============================================================================
+
+int SearchPanel::OnCreate(LPCREATESTRUCT /*lpCreateStruct*/) {
+    CMessageLoop* pLoop = _Module.GetMessageLoop();
+    ATLASSERT(pLoop != nullptr);
+    pLoop->AddMessageFilter(this);
+
+    const int dpi = static_cast<int>(GetDpiForWindow(m_hWnd));
+    m_font.CreateFont(-MulDiv(9, dpi, 72), 0, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE, DEFAULT_CHARSET,
+                      OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, CLEARTYPE_QUALITY, DEFAULT_PITCH | FF_DONTCARE,
+                      L"Segoe UI");
+
+    m_queryEdit.Create(m_hWnd, rcDefault, nullptr, WS_CHILD | WS_VISIBLE | WS_TABSTOP | ES_AUTOHSCROLL,
+                       WS_EX_CLIENTEDGE, IDC_QUERY);
+    m_findButton.Create(m_hWnd, rcDefault, L"Find", WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_DEFPUSHBUTTON, 0,
+                        IDC_FIND);
+    m_matchCaseCheck.Create(m_hWnd, rcDefault, L"Match case", WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_AUTOCHECKBOX,
+                            0, IDC_MATCH_CASE);
+    m_regexCheck.Create(m_hWnd, rcDefault, L"Regular expression",
+                        WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_AUTOCHECKBOX, 0, IDC_REGEX);
+
+    // Owner data: rows are read from m_hits as they are painted
+    m_results.Create(m_hWnd, rcDefault, nullptr,
+                     WS_CHILD | WS_VISIBLE | WS_TABSTOP | LVS_REPORT | LVS_OWNERDATA | LVS_SINGLESEL |
+                         LVS_SHOWSELALWAYS, WS_EX_CLIENTEDGE, IDC_RESULTS);
+    m_results.SetExtendedListViewStyle(LVS_EX_FULLROWSELECT | LVS_EX_DOUBLEBUFFER);
+    m_results.InsertColumn(0, L"Tab", LVCFMT_LEFT, MulDiv(140, dpi, 96));
+    m_results.InsertColumn(1, L"Lines Up", LVCFMT_RIGHT, MulDiv(70, dpi, 96));
+    m_results.InsertColumn(2, L"Text", LVCFMT_LEFT, MulDiv(480, dpi, 96));
+
+    m_status.Create(m_hWnd, rcDefault, L"", WS_CHILD | WS_VISIBLE | SS_LEFTNOWORDWRAP, 0, IDC_STATUS);
+
+    for (HWND control : {m_queryEdit.m_hWnd, m_findButton.m_hWnd, m_matchCaseCheck.m_hWnd, m_regexCheck.m_hWnd,
+                         m_results.m_hWnd, m_status.m_hWnd}) {
+        ::SendMessageW(control, WM_SETFONT, reinterpret_cast<WPARAM>(m_font.m_hFont), FALSE);
+    }
+    return 0;
+}
+
+void SearchPanel::OnDestroy() {
+    KillTimer(kUpdateTimerId);
+    m_search.Stop();
+    m_hits.clear();
+    m_names.clear();
+    if (CMessageLoop* pLoop = _Module.GetMessageLoop()) {
+        pLoop->RemoveMessageFilter(this);
+    }
+    m_font.DeleteObject();
+}
+
+void SearchPanel::OnSize(UINT nType, CSize size) {
+    if (nType == SIZE_MINIMIZED || !m_results.IsWindow()) {
+        return;
+    }
+    const int dpi = static_cast<int>(GetDpiForWindow(m_hWnd));
+    const int margin = MulDiv(kMargin, dpi, 96);
+    const int row = MulDiv(kRowHeight, dpi, 96);
+    const int button = MulDiv(kButtonWidth, dpi, 96);
+    const int check = MulDiv(kCheckWidth, dpi, 96);
+
+    int y = margin;
+    m_queryEdit.MoveWindow(margin, y, std::max(size.cx - 3 * margin - button, 0), row);
+    m_findButton.MoveWindow(size.cx - margin - button, y, button, row);
+    y += row + margin / 2;
+    m_matchCaseCheck.MoveWindow(margin, y, check, row);
+    m_regexCheck.MoveWindow(margin + check, y, 2 * check, row);
+    y += row + margin / 2;
+    const int statusTop = size.cy - margin - row;
+    m_results.MoveWindow(margin, y, std::max(size.cx - 2 * margin, 0), std::max(statusTop - margin / 2 - y, 0));
+    m_status.MoveWindow(margin, statusTop + row / 4, std::max(size.cx - 2 * margin, 0), row);
+}
+
+void SearchPanel::OnSetFocus(CWindow /*wndOld*/) {
+    m_queryEdit.SetFocus();
+}
+
+void SearchPanel::OnTimer(UINT_PTR nIDEvent) {
+    if (nIDEvent != kUpdateTimerId) {
+        SetMsgHandled(FALSE);
+        return;
+    }
+    // Once every line is handed over, the last slice's hits message ends it
+    if (!m_search.Update(kLinesPerTick)) {
+        KillTimer(kUpdateTimerId);
+    }
+    TakeHits();
+    UpdateStatus();
+}
+
+LRESULT SearchPanel::OnHitsMessage(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/) {
+    m_hitsPosted->store(false);
+    TakeHits();
+    UpdateStatus();
+    return 0;
+}
+
+void SearchPanel::OnFind(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/) {
+    StartSearch();
+}
+
+LRESULT SearchPanel::OnGetDispInfo(LPNMHDR pnmh) {
+    auto* info = reinterpret_cast<NMLVDISPINFOW*>(pnmh);
+    LVITEMW& item = info->item;
+    if (!(item.mask & LVIF_TEXT) || item.iItem < 0 || static_cast<size_t>(item.iItem) >= m_hits.size()) {
+        return 0;
+    }
+    const Core::GlobalSearchHit& hit = m_hits[static_cast<size_t>(item.iItem)];
+    switch (item.iSubItem) {
+    case 0: {
+        const auto name = m_names.find(hit.source);
+        m_cell = name != m_names.end() ? name->second : std::wstring();
+        break;
+    }
+    case 1:
+        m_cell = std::to_wstring(hit.age);
+        break;
+    default:
+        m_cell = Core::ToUtf16(hit.context);
+        std::replace(m_cell.begin(), m_cell.end(), L'\t', L' ');
+        break;
+    }
+    item.pszText = m_cell.data();
+    return 0;
+}
+
+LRESULT SearchPanel::OnOpenHit(LPNMHDR /*pnmh*/) {
+    const int selected = m_results.GetSelectedIndex();
+    if (selected >= 0 && static_cast<size_t>(selected) < m_hits.size() && m_jumpCallback) {
+        m_jumpCallback(m_hits[static_cast<size_t>(selected)]);
+    }
+    return 0;
+}
+
+// ============================================================================
+// Searching
+// ============================================================================
+
+void SearchPanel::StartSearch() {
+    CString edit;
+    m_queryEdit.GetWindowTextW(edit);
+    std::wstring text(edit.GetString(), static_cast<size_t>(edit.GetLength()));
+    Core::SearchQuery query;
+    const bool timed = TakeTimeRange(text, query.fromMs, query.toMs);
+    query.text = Core::ToUtf8(text);
+    query.matchCase = m_matchCaseCheck.GetCheck() == BST_CHECKED;
+    query.regex = m_regexCheck.GetCheck() == BST_CHECKED;
+
+    KillTimer(kUpdateTimerId);
+    m_hits.clear();
+    m_names.clear();
+    m_results.SetItemCountEx(0, 0);
+
+    // Pool threads only post; the flag is shared so one may outlive the window
+    const HWND hwnd = m_hWnd;
+    const std::shared_ptr<std::atomic<bool>> posted = m_hitsPosted;
+    const bool started = (timed || !query.text.empty()) && m_search.Start(query, [hwnd, posted] {
+        if (!posted->exchange(true)) {
+            ::PostMessageW(hwnd, kHitsMessage, 0, 0);
+        }
+    });
+    if (!started) {
+        m_search.Stop();
+        m_status.SetWindowTextW(query.text.empty() && !timed ? L"" : L"Invalid regular expression");
+        return;
+    }
+
+    if (m_sourcesCallback) {
+        m_sourcesCallback(*this);
+    }
+    (void)m_search.Update(kLinesPerTick);
+    SetTimer(kUpdateTimerId, kUpdateTimerMs);
+    UpdateStatus();
+}
+
+void SearchPanel::TakeHits() {
+    m_taken.clear();
+    if (!m_search.TakeHits(m_taken)) {
+        return;
+    }
+
+    // Each batch is sorted, then merged into the list in place
+    std::sort(m_taken.begin(), m_taken.end(), RanksBefore);
+    const auto middle = static_cast<std::ptrdiff_t>(m_hits.size());
+    m_hits.insert(m_hits.end(), std::make_move_iterator(m_taken.begin()), std::make_move_iterator(m_taken.end()));
+    std::inplace_merge(m_hits.begin(), m_hits.begin() + middle, m_hits.end(), RanksBefore);
+
+    m_results.SetItemCountEx(static_cast<int>(m_hits.size()), LVSICF_NOSCROLL);
+}
+
+void SearchPanel::UpdateStatus() {
+    const Core::GlobalSearchProgress progress = m_search.GetProgress();
+    std::wstring status;
+    if (!progress.finished) {
+        status = L"Searching: " + std::to_wstring(progress.linesSearched) + L" of " +
+                 std::to_wstring(progress.linesTotal) + L" lines, ";
+    } else {
+        status = L"Searched " + std::to_wstring(progress.linesSearched) + L" lines, ";
+    }
+    status += std::to_wstring(m_hits.size()) + (m_hits.size() == 1 ? L" hit" : L" hits");
+    if (progress.hits >= Core::GlobalSearch::kMaxHits) {
+        status += L" (more not shown)";
+    }
+    if (progress.linesSkipped != 0) {
+        status += L"; " + std::to_wstring(progress.linesSkipped) + L" lines left the history before they were read";
+    }
+    m_status.SetWindowTextW(status.c_str());
+}
+
+} // namespace Console3::UI
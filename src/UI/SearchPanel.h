@@ -0,0 +1,157 @@
+#pragma once
+// Console3 - SearchPanel.h
+// Find in All Tabs: a global search and its results
+//
+// A tool window shared by every main window. Searching asks the owner for
+// the sessions to search (every tab and split pane), then hands their lines
+// to Core::GlobalSearch a slice per timer tick, so typing and painting go
+// on while a long history is searched. Hits show up as the pool finds them,
+// most recent first; opening one brings its window forward and selects the
+// match, even in a hibernated session or one whose history was spilled to
+// disk, decoding only the block it is in.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#define STRICT
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+
+#include <Windows.h>
+
+// ATL/WTL headers
+#include <atlbase.h>
+#include <atlapp.h>
+
+extern CAppModule _Module;
+
+#include <atlwin.h>
+#include <atlctrls.h>
+#include <atlcrack.h>
+
+#include "Core/GlobalSearch.h"
+#include "UI/RenderLock.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Console3::UI {
+
+/// Find in All Tabs window (see file comment)
+class SearchPanel :
+    public CWindowImpl<SearchPanel, CWindow, CFrameWinTraits>,
+    public CMessageFilter
+{
+public:
+    DECLARE_WND_CLASS(L"Console3SearchPanel")
+
+    /// Lines handed to the pool per timer tick at most
+    static constexpr size_t kLinesPerTick = 64 * 1024;
+
+    /// Called when a search starts, to add every session with AddSource()
+    using SourcesCallback = std::function<void(SearchPanel& panel)>;
+
+    /// Called when a hit is opened
+    using JumpCallback = std::function<void(const Core::GlobalSearchHit& hit)>;
+
+    SearchPanel(SourcesCallback sources, JumpCallback jump);
+    ~SearchPanel();
+
+    // Non-copyable, non-movable
+    SearchPanel(const SearchPanel&) = delete;
+    SearchPanel& operator=(const SearchPanel&) = delete;
+
+    /// Create the window if needed, show it and focus the query
+    bool Show();
+
+    /// Add a session to the search being started (SourcesCallback only)
+    /// @param source Id its hits carry (unique among the sessions)
+    /// @param name Shown in the results
+    void AddSource(uint32_t source, const std::wstring& name, const Core::TerminalBuffer& buffer);
+
+    /// Stop searching a session, whose buffer is going away; its hits stay
+    void RemoveSource(uint32_t source);
+
+    // CMessageFilter
+    BOOL PreTranslateMessage(MSG* pMsg) override;
+
+    // The window's messages are handled under the render lock
+    WNDPROC GetWindowProc() override { return RenderLockedWindowProc<SearchPanel>; }
+
+    BEGIN_MSG_MAP(SearchPanel)
+        MSG_WM_CREATE(OnCreate)
+        MSG_WM_DESTROY(OnDestroy)
+        MSG_WM_SIZE(OnSize)
+        MSG_WM_SETFOCUS(OnSetFocus)
+        MSG_WM_TIMER(OnTimer)
+        MESSAGE_HANDLER(kHitsMessage, OnHitsMessage)
+        COMMAND_ID_HANDLER_EX(IDC_FIND, OnFind)
+        NOTIFY_HANDLER_EX(IDC_RESULTS, LVN_GETDISPINFO, OnGetDispInfo)
+        NOTIFY_HANDLER_EX(IDC_RESULTS, NM_DBLCLK, OnOpenHit)
+        NOTIFY_HANDLER_EX(IDC_RESULTS, NM_RETURN, OnOpenHit)
+    END_MSG_MAP()
+
+    // Posted by the search's pool threads when hits are ready; coalesced
+    // until handled
+    static constexpr UINT kHitsMessage = WM_APP + 1;
+
+    enum {
+        IDC_QUERY = 1001,
+        IDC_MATCH_CASE,
+        IDC_REGEX,
+        IDC_FIND,
+        IDC_RESULTS,
+        IDC_STATUS
+    };
+
+private:
+    int OnCreate(LPCREATESTRUCT lpCreateStruct);
+    void OnDestroy();
+    void OnSize(UINT nType, CSize size);
+    void OnSetFocus(CWindow wndOld);
+    void OnTimer(UINT_PTR nIDEvent);
+    LRESULT OnHitsMessage(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
+    void OnFind(UINT uNotifyCode, int nID, CWindow wndCtl);
+    LRESULT OnGetDispInfo(LPNMHDR pnmh);
+    LRESULT OnOpenHit(LPNMHDR pnmh);
+
+    /// Start a search for the query typed
+    void StartSearch();
+
+    /// Merge the hits found since the last call, in rank order
+    void TakeHits();
+
+    /// Show the search's progress
+    void UpdateStatus();
+
+    SourcesCallback m_sourcesCallback;
+    JumpCallback m_jumpCallback;
+
+    Core::GlobalSearch m_search;
+    std::vector<Core::GlobalSearchHit> m_hits;      ///< Most recent first
+    std::vector<Core::GlobalSearchHit> m_taken;     ///< Scratch for TakeHits()
+    std::unordered_map<uint32_t, std::wstring> m_names;  ///< Source names of the search
+    std::wstring m_cell;                            ///< Text handed out by OnGetDispInfo()
+    /// kHitsMessage is in the queue (shared with the pool threads, which may
+    /// outlive the window)
+    std::shared_ptr<std::atomic<bool>> m_hitsPosted = std::make_shared<std::atomic<bool>>(false);
+
+    CEdit m_queryEdit;
+    CButton m_matchCaseCheck;
+    CButton m_regexCheck;
+    CButton m_findButton;
+    CListViewCtrl m_results;
+    CStatic m_status;
+    CFont m_font;
+};
+
+} // namespace Console3::UI
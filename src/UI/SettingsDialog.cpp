@@ -2,16 +2,42 @@
 // Settings dialog implementation
 
 #include "UI/SettingsDialog.h"
-#include <atlstr.h>
+#include "Core/ScrollbackBudget.h"
+#include "UI/FontCatalog.h"
+
+#include <algorithm>
+#include <iterator>
+#include <string>
 
 namespace Console3::UI {
 
+namespace {
+
+/// A dialog template with no controls; the pages create theirs in code
+struct BlankTemplate {
+    DLGTEMPLATE dialog;
+    WORD menu;
+    WORD windowClass;
+    WORD title;
+};
+
+/// Give a page the blank template, sized for the tallest page (dialog units)
+void UseBlankTemplate(PROPSHEETPAGE& page) {
+    alignas(DWORD) static const BlankTemplate kTemplate = {
+        {WS_CHILD | WS_DISABLED | WS_CAPTION | DS_3DLOOK | DS_CONTROL, 0, 0, 0, 0, 260, 300}, 0, 0, 0};
+    page.dwFlags |= PSP_DLGINDIRECT;
+    page.pResource = &kTemplate.dialog;
+}
+
+} // namespace
+
 // ============================================================================
 // GeneralPage
 // ============================================================================
 
 GeneralPage::GeneralPage(Core::Settings& settings)
     : m_settings(settings) {
+    UseBlankTemplate(m_psp);
     SetTitle(L"General");
 }
 
@@ -27,7 +53,7 @@ BOOL GeneralPage::OnInitDialog(CWindow /*wndFocus*/, LPARAM /*lInitParam*/) {
     int spacing = 35;
     
     // Default Profile label and combo
-    CStatic::Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
+    CStatic().Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
         L"Default Profile:", WS_CHILD | WS_VISIBLE);
     m_profileCombo.Create(m_hWnd, CRect(20 + labelWidth, y, 20 + labelWidth + controlWidth, y + height * 5),
         nullptr, WS_CHILD | WS_VISIBLE | WS_TABSTOP | CBS_DROPDOWNLIST, 0, IDC_DEFAULT_PROFILE);
@@ -41,7 +67,7 @@ BOOL GeneralPage::OnInitDialog(CWindow /*wndFocus*/, LPARAM /*lInitParam*/) {
     y += spacing;
     
     // Scrollback lines
-    CStatic::Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
+    CStatic().Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
         L"Scrollback Lines:", WS_CHILD | WS_VISIBLE);
     m_scrollbackEdit.Create(m_hWnd, CRect(20 + labelWidth, y, 20 + labelWidth + 100, y + height),
         nullptr, WS_CHILD | WS_VISIBLE | WS_TABSTOP | WS_BORDER | ES_NUMBER, 0, IDC_SCROLLBACK);
@@ -49,6 +75,21 @@ BOOL GeneralPage::OnInitDialog(CWindow /*wndFocus*/, LPARAM /*lInitParam*/) {
     
     y += spacing;
     
+    // Scrollback memory shared by all tabs, with what it holds now
+    CStatic().Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
+        L"Scrollback Memory:", WS_CHILD | WS_VISIBLE);
+    m_scrollbackBudgetEdit.Create(m_hWnd, CRect(20 + labelWidth, y, 20 + labelWidth + 100, y + height),
+        nullptr, WS_CHILD | WS_VISIBLE | WS_TABSTOP | WS_BORDER | ES_NUMBER, 0, IDC_SCROLLBACK_BUDGET);
+    m_scrollbackBudgetEdit.SetWindowTextW(std::to_wstring(m_settings.scrollbackBudgetMB).c_str());
+    
+    const Core::ScrollbackBudgetStats budget = Core::ScrollbackBudget::Shared().GetStats();
+    const std::wstring usage = L"MB, 0 = no limit (" + std::to_wstring(budget.usage >> 20) + L" MB in use by " +
+        std::to_wstring(budget.stores) + L" tabs)";
+    CStatic().Create(m_hWnd, CRect(20 + labelWidth + 110, y + 3, clientRect.right - 20, y + height),
+        usage.c_str(), WS_CHILD | WS_VISIBLE);
+    
+    y += spacing;
+    
     // Copy on select checkbox
     m_copyOnSelectCheck.Create(m_hWnd, CRect(20, y, 20 + 200, y + height),
         L"Copy text on selection", WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_AUTOCHECKBOX, 0, IDC_COPY_ON_SELECT);
@@ -88,6 +129,8 @@ int GeneralPage::OnApply() {
     // Save scrollback
     m_scrollbackEdit.GetWindowTextW(text);
     m_settings.scrollbackLines = _wtoi(text);
+    m_scrollbackBudgetEdit.GetWindowTextW(text);
+    m_settings.scrollbackBudgetMB = _wtoi(text);
     
     // Save checkboxes
     m_settings.copyOnSelect = (m_copyOnSelectCheck.GetCheck() == BST_CHECKED);
@@ -102,6 +145,7 @@ int GeneralPage::OnApply() {
 
 AppearancePage::AppearancePage(Core::Settings& settings)
     : m_settings(settings) {
+    UseBlankTemplate(m_psp);
     SetTitle(L"Appearance");
 }
 
@@ -113,23 +157,22 @@ BOOL AppearancePage::OnInitDialog(CWindow /*wndFocus*/, LPARAM /*lInitParam*/) {
     int spacing = 35;
     
     // Font family
-    CStatic::Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
+    CStatic().Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
         L"Font Family:", WS_CHILD | WS_VISIBLE);
     m_fontFamilyCombo.Create(m_hWnd, CRect(20 + labelWidth, y, 20 + labelWidth + controlWidth, y + height * 8),
-        nullptr, WS_CHILD | WS_VISIBLE | WS_TABSTOP | CBS_DROPDOWN, 0, IDC_FONT_FAMILY);
+        nullptr, WS_CHILD | WS_VISIBLE | WS_TABSTOP | CBS_DROPDOWN | CBS_SORT, 0, IDC_FONT_FAMILY);
     
-    // Add common monospace fonts
-    const wchar_t* fonts[] = { L"Consolas", L"Cascadia Code", L"Cascadia Mono", 
-        L"Fira Code", L"JetBrains Mono", L"Source Code Pro", L"Courier New" };
-    for (const auto* font : fonts) {
-        m_fontFamilyCombo.AddString(font);
-    }
+    // The installed monospace fonts as far as the catalog has them (it
+    // enumerates in the background from startup, and again when fonts
+    // change); the timer adds the rest as they are found
     m_fontFamilyCombo.SetWindowTextW(m_settings.font.family.c_str());
+    FillFontFamilies();
+    SetTimer(TIMER_FONT_CATALOG, kFontCatalogPollMs);
     
     y += spacing;
     
     // Font size
-    CStatic::Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
+    CStatic().Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
         L"Font Size:", WS_CHILD | WS_VISIBLE);
     m_fontSizeEdit.Create(m_hWnd, CRect(20 + labelWidth, y, 20 + labelWidth + 60, y + height),
         nullptr, WS_CHILD | WS_VISIBLE | WS_TABSTOP | WS_BORDER, 0, IDC_FONT_SIZE);
@@ -145,7 +188,7 @@ BOOL AppearancePage::OnInitDialog(CWindow /*wndFocus*/, LPARAM /*lInitParam*/) {
     y += spacing;
     
     // Color scheme
-    CStatic::Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
+    CStatic().Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
         L"Color Scheme:", WS_CHILD | WS_VISIBLE);
     m_colorSchemeCombo.Create(m_hWnd, CRect(20 + labelWidth, y, 20 + labelWidth + controlWidth, y + height * 6),
         nullptr, WS_CHILD | WS_VISIBLE | WS_TABSTOP | CBS_DROPDOWNLIST, 0, IDC_COLOR_SCHEME);
@@ -158,7 +201,7 @@ BOOL AppearancePage::OnInitDialog(CWindow /*wndFocus*/, LPARAM /*lInitParam*/) {
     y += spacing;
     
     // Opacity
-    CStatic::Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
+    CStatic().Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
         L"Opacity:", WS_CHILD | WS_VISIBLE);
     m_opacitySlider.Create(m_hWnd, CRect(20 + labelWidth, y, 20 + labelWidth + controlWidth, y + height),
         nullptr, WS_CHILD | WS_VISIBLE | WS_TABSTOP | TBS_HORZ, 0, IDC_OPACITY_SLIDER);
@@ -175,6 +218,57 @@ BOOL AppearancePage::OnInitDialog(CWindow /*wndFocus*/, LPARAM /*lInitParam*/) {
     return TRUE;
 }
 
+void AppearancePage::OnTimer(UINT_PTR nIDEvent) {
+    if (nIDEvent != TIMER_FONT_CATALOG) {
+        SetMsgHandled(FALSE);
+        return;
+    }
+    if (FontCatalog::Shared().GetGeneration() != m_fontGeneration) {
+        FillFontFamilies();
+    }
+}
+
+void AppearancePage::FillFontFamilies() {
+    FontCatalog& catalog = FontCatalog::Shared();
+    m_fontGeneration = catalog.GetGeneration();
+    const std::vector<std::wstring> families = catalog.GetMonospaceFamilies();
+
+    // Until the first families are found, common ones
+    if (families.empty()) {
+        if (!m_fontFallback && m_fontFamilyCombo.GetCount() == 0) {
+            const wchar_t* fonts[] = { L"Consolas", L"Cascadia Code", L"Cascadia Mono",
+                L"Fira Code", L"JetBrains Mono", L"Source Code Pro", L"Courier New" };
+            for (const auto* font : fonts) {
+                m_fontFamilyCombo.AddString(font);
+            }
+            m_fontFallback = true;
+        }
+        return;
+    }
+
+    // The list only grows while it is enumerated, so the combo just gets
+    // the new names; it starts over after the fallback or a rescan that
+    // lost some (resetting the list clears the edit text, put back after)
+    bool grows = !m_fontFallback;
+    CString item;
+    for (int i = 0; grows && i < m_fontFamilyCombo.GetCount(); ++i) {
+        m_fontFamilyCombo.GetLBText(i, item);
+        grows = std::binary_search(families.begin(), families.end(), std::wstring(item.GetString()));
+    }
+    if (!grows) {
+        CString text;
+        m_fontFamilyCombo.GetWindowTextW(text);
+        m_fontFamilyCombo.ResetContent();
+        m_fontFamilyCombo.SetWindowTextW(text);
+        m_fontFallback = false;
+    }
+    for (const std::wstring& family : families) {
+        if (m_fontFamilyCombo.FindStringExact(-1, family.c_str()) == CB_ERR) {
+            m_fontFamilyCombo.AddString(family.c_str());
+        }
+    }
+}
+
 void AppearancePage::OnFontChanged(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/) {
     SetModified(TRUE);
 }
@@ -219,6 +313,7 @@ int AppearancePage::OnApply() {
 
 CursorPage::CursorPage(Core::Settings& settings)
     : m_settings(settings) {
+    UseBlankTemplate(m_psp);
     SetTitle(L"Cursor");
 }
 
@@ -230,7 +325,7 @@ BOOL CursorPage::OnInitDialog(CWindow /*wndFocus*/, LPARAM /*lInitParam*/) {
     int spacing = 35;
     
     // Cursor style
-    CStatic::Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
+    CStatic().Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
         L"Cursor Style:", WS_CHILD | WS_VISIBLE);
     m_cursorStyleCombo.Create(m_hWnd, CRect(20 + labelWidth, y, 20 + labelWidth + controlWidth, y + height * 4),
         nullptr, WS_CHILD | WS_VISIBLE | WS_TABSTOP | CBS_DROPDOWNLIST, 0, IDC_CURSOR_STYLE);
@@ -257,7 +352,7 @@ BOOL CursorPage::OnInitDialog(CWindow /*wndFocus*/, LPARAM /*lInitParam*/) {
     y += spacing;
     
     // Blink rate
-    CStatic::Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
+    CStatic().Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
         L"Blink Rate (ms):", WS_CHILD | WS_VISIBLE);
     m_blinkRateEdit.Create(m_hWnd, CRect(20 + labelWidth, y, 20 + labelWidth + 80, y + height),
         nullptr, WS_CHILD | WS_VISIBLE | WS_TABSTOP | WS_BORDER | ES_NUMBER, 0, IDC_BLINK_RATE);
@@ -300,6 +395,7 @@ int CursorPage::OnApply() {
 
 TabsPage::TabsPage(Core::Settings& settings)
     : m_settings(settings) {
+    UseBlankTemplate(m_psp);
     SetTitle(L"Tabs");
 }
 
@@ -311,7 +407,7 @@ BOOL TabsPage::OnInitDialog(CWindow /*wndFocus*/, LPARAM /*lInitParam*/) {
     int spacing = 35;
     
     // New tab position
-    CStatic::Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
+    CStatic().Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
         L"New Tab Position:", WS_CHILD | WS_VISIBLE);
     m_newTabPosCombo.Create(m_hWnd, CRect(20 + labelWidth, y, 20 + labelWidth + controlWidth, y + height * 3),
         nullptr, WS_CHILD | WS_VISIBLE | WS_TABSTOP | CBS_DROPDOWNLIST, 0, IDC_NEW_TAB_POS);
@@ -322,7 +418,7 @@ BOOL TabsPage::OnInitDialog(CWindow /*wndFocus*/, LPARAM /*lInitParam*/) {
     y += spacing;
     
     // Close last tab action
-    CStatic::Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
+    CStatic().Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
         L"When Last Tab Closes:", WS_CHILD | WS_VISIBLE);
     m_closeLastActionCombo.Create(m_hWnd, CRect(20 + labelWidth, y, 20 + labelWidth + controlWidth, y + height * 3),
         nullptr, WS_CHILD | WS_VISIBLE | WS_TABSTOP | CBS_DROPDOWNLIST, 0, IDC_CLOSE_LAST_ACTION);
@@ -369,6 +465,203 @@ int TabsPage::OnApply() {
     return PSNRET_NOERROR;
 }
 
+// ============================================================================
+// PerformancePage
+// ============================================================================
+
+namespace {
+
+/// Preset names shown, in kPerformancePresets order, then custom
+constexpr const wchar_t* kPresetLabels[] = {
+    L"Balanced", L"Low latency", L"Throughput", L"Low memory", L"Remote (RDP, VDI)", L"Custom"
+};
+static_assert(std::size(kPresetLabels) == std::size(Core::kPerformancePresets) + 1);
+
+/// Renderer names in the settings, in the order the combo lists them
+constexpr const wchar_t* kRenderers[] = {L"gpu", L"hwnd", L"software"};
+
+int GetEditInt(const CEdit& edit) {
+    CString text;
+    edit.GetWindowTextW(text);
+    return _wtoi(text);
+}
+
+} // namespace
+
+PerformancePage::PerformancePage(Core::Settings& settings)
+    : m_settings(settings)
+    , m_working(settings.performance) {
+    UseBlankTemplate(m_psp);
+    SetTitle(L"Performance");
+}
+
+BOOL PerformancePage::OnInitDialog(CWindow /*wndFocus*/, LPARAM /*lInitParam*/) {
+    CRect clientRect;
+    GetClientRect(&clientRect);
+
+    int y = 20;
+    int labelWidth = 150;
+    int controlWidth = 170;
+    int height = 24;
+    int spacing = 35;
+
+    // Preset
+    CStatic().Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
+        L"Preset:", WS_CHILD | WS_VISIBLE);
+    m_presetCombo.Create(m_hWnd, CRect(20 + labelWidth, y, 20 + labelWidth + controlWidth, y + height * 7),
+        nullptr, WS_CHILD | WS_VISIBLE | WS_TABSTOP | CBS_DROPDOWNLIST, 0, IDC_PRESET);
+    for (const wchar_t* label : kPresetLabels) {
+        m_presetCombo.AddString(label);
+    }
+
+    y += spacing;
+
+    // Renderer (new windows)
+    CStatic().Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
+        L"Renderer:", WS_CHILD | WS_VISIBLE);
+    m_rendererCombo.Create(m_hWnd, CRect(20 + labelWidth, y, 20 + labelWidth + controlWidth, y + height * 4),
+        nullptr, WS_CHILD | WS_VISIBLE | WS_TABSTOP | CBS_DROPDOWNLIST, 0, IDC_RENDERER);
+    m_rendererCombo.AddString(L"GPU (swap chain)");
+    m_rendererCombo.AddString(L"GPU (window target)");
+    m_rendererCombo.AddString(L"Software (dirty rectangles)");
+
+    y += spacing;
+
+    // Frame rate cap
+    CStatic().Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
+        L"Frame Rate Cap:", WS_CHILD | WS_VISIBLE);
+    m_maxFpsEdit.Create(m_hWnd, CRect(20 + labelWidth, y, 20 + labelWidth + 80, y + height),
+        nullptr, WS_CHILD | WS_VISIBLE | WS_TABSTOP | WS_BORDER | ES_NUMBER, 0, IDC_MAX_FPS);
+    CStatic().Create(m_hWnd, CRect(20 + labelWidth + 90, y + 3, clientRect.right - 20, y + height),
+        L"fps, 0 = display refresh", WS_CHILD | WS_VISIBLE);
+
+    y += spacing;
+
+    // Output ring and reads (new sessions)
+    CStatic().Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
+        L"Output Buffer (KB):", WS_CHILD | WS_VISIBLE);
+    m_outputBufferEdit.Create(m_hWnd, CRect(20 + labelWidth, y, 20 + labelWidth + 80, y + height),
+        nullptr, WS_CHILD | WS_VISIBLE | WS_TABSTOP | WS_BORDER | ES_NUMBER, 0, IDC_OUTPUT_BUFFER);
+
+    y += spacing;
+
+    CStatic().Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
+        L"Largest Read (KB):", WS_CHILD | WS_VISIBLE);
+    m_readChunkEdit.Create(m_hWnd, CRect(20 + labelWidth, y, 20 + labelWidth + 80, y + height),
+        nullptr, WS_CHILD | WS_VISIBLE | WS_TABSTOP | WS_BORDER | ES_NUMBER, 0, IDC_READ_CHUNK);
+
+    y += spacing;
+
+    CStatic().Create(m_hWnd, CRect(20, y + 3, 20 + labelWidth, y + height),
+        L"Uncompressed Lines:", WS_CHILD | WS_VISIBLE);
+    m_hotLinesEdit.Create(m_hWnd, CRect(20 + labelWidth, y, 20 + labelWidth + 80, y + height),
+        nullptr, WS_CHILD | WS_VISIBLE | WS_TABSTOP | WS_BORDER | ES_NUMBER, 0, IDC_HOT_LINES);
+
+    y += spacing;
+
+    m_cellGridCheck.Create(m_hWnd, CRect(20, y, 20 + 300, y + height),
+        L"Draw the grid with the GPU cell shader", WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_AUTOCHECKBOX, 0,
+        IDC_CELL_GRID);
+
+    y += spacing;
+
+    m_throttleCheck.Create(m_hWnd, CRect(20, y, 20 + 300, y + height),
+        L"Throttle minimized windows", WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_AUTOCHECKBOX, 0, IDC_THROTTLE);
+
+    y += spacing;
+
+    m_predictiveEchoCheck.Create(m_hWnd, CRect(20, y, 20 + 300, y + height),
+        L"Show typed text before a slow shell echoes it", WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_AUTOCHECKBOX, 0,
+        IDC_PREDICTIVE_ECHO);
+
+    y += spacing;
+
+    m_savePowerCheck.Create(m_hWnd, CRect(20, y, 20 + 300, y + height),
+        L"Save power on battery", WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_AUTOCHECKBOX, 0, IDC_SAVE_POWER);
+
+    y += spacing;
+
+    CStatic().Create(m_hWnd, CRect(20, y, clientRect.right - 20, y + height * 2),
+        L"Buffer, read and line settings apply to new tabs; the renderer to new windows.",
+        WS_CHILD | WS_VISIBLE);
+
+    ShowValues();
+    return TRUE;
+}
+
+void PerformancePage::ShowValues() {
+    m_showing = true;
+
+    int preset = static_cast<int>(std::size(Core::kPerformancePresets));
+    for (size_t i = 0; i < std::size(Core::kPerformancePresets); ++i) {
+        if (m_working.preset == Core::kPerformancePresets[i]) {
+            preset = static_cast<int>(i);
+        }
+    }
+    m_presetCombo.SetCurSel(preset);
+
+    int renderer = 0;
+    for (size_t i = 0; i < std::size(kRenderers); ++i) {
+        if (m_working.renderer == kRenderers[i]) {
+            renderer = static_cast<int>(i);
+        }
+    }
+    m_rendererCombo.SetCurSel(renderer);
+
+    m_maxFpsEdit.SetWindowTextW(std::to_wstring(m_working.maxFps).c_str());
+    m_outputBufferEdit.SetWindowTextW(std::to_wstring(m_working.outputBufferKB).c_str());
+    m_readChunkEdit.SetWindowTextW(std::to_wstring(m_working.readChunkKB).c_str());
+    m_hotLinesEdit.SetWindowTextW(std::to_wstring(m_working.scrollbackHotLines).c_str());
+    m_cellGridCheck.SetCheck(m_working.cellGridShader ? BST_CHECKED : BST_UNCHECKED);
+    m_throttleCheck.SetCheck(m_working.throttleBackground ? BST_CHECKED : BST_UNCHECKED);
+    m_predictiveEchoCheck.SetCheck(m_working.predictiveEcho ? BST_CHECKED : BST_UNCHECKED);
+    m_savePowerCheck.SetCheck(m_working.saveBatteryPower ? BST_CHECKED : BST_UNCHECKED);
+
+    m_showing = false;
+}
+
+void PerformancePage::OnPresetChanged(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/) {
+    // A preset replaces every value; custom keeps what is shown
+    const int sel = m_presetCombo.GetCurSel();
+    if (sel >= 0 && sel < static_cast<int>(std::size(Core::kPerformancePresets))) {
+        m_working = *Core::PerformanceSettings::FromPreset(Core::kPerformancePresets[sel]);
+        ShowValues();
+    } else {
+        m_working.preset = L"custom";
+    }
+    SetModified(TRUE);
+}
+
+void PerformancePage::OnValueChanged(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/) {
+    if (!m_showing) {
+        SetModified(TRUE);
+    }
+}
+
+int PerformancePage::OnApply() {
+    // The preset's values with the page's on top; those that differ are
+    // saved as overrides of the preset
+    Core::PerformanceSettings performance = m_working;
+    const int renderer = m_rendererCombo.GetCurSel();
+    performance.renderer = kRenderers[renderer >= 0 ? renderer : 0];
+    performance.maxFps = GetEditInt(m_maxFpsEdit);
+    performance.outputBufferKB = GetEditInt(m_outputBufferEdit);
+    performance.readChunkKB = GetEditInt(m_readChunkEdit);
+    performance.scrollbackHotLines = GetEditInt(m_hotLinesEdit);
+    performance.cellGridShader = (m_cellGridCheck.GetCheck() == BST_CHECKED);
+    performance.throttleBackground = (m_throttleCheck.GetCheck() == BST_CHECKED);
+    performance.predictiveEcho = (m_predictiveEchoCheck.GetCheck() == BST_CHECKED);
+    performance.saveBatteryPower = (m_savePowerCheck.GetCheck() == BST_CHECKED);
+
+    // Out-of-range values are brought into range and shown that way
+    if (!performance.Validate().empty()) {
+        m_working = performance;
+        ShowValues();
+    }
+    m_settings.performance = std::move(performance);
+    return PSNRET_NOERROR;
+}
+
 // ============================================================================
 // SettingsDialog
 // ============================================================================
@@ -384,12 +677,14 @@ SettingsDialog::SettingsDialog(Core::Settings& settings)
     m_appearancePage = std::make_unique<AppearancePage>(m_settings);
     m_cursorPage = std::make_unique<CursorPage>(m_settings);
     m_tabsPage = std::make_unique<TabsPage>(m_settings);
+    m_performancePage = std::make_unique<PerformancePage>(m_settings);
     
     // Add pages
     AddPage(*m_generalPage);
     AddPage(*m_appearancePage);
     AddPage(*m_cursorPage);
     AddPage(*m_tabsPage);
+    AddPage(*m_performancePage);
 }
 
 SettingsDialog::~SettingsDialog() = default;
@@ -17,6 +17,7 @@
 
 // ATL/WTL headers
 #include <atlbase.h>
+#include <atlstr.h>     // Before WTL, which adds CString overloads when it is there
 #include <atlapp.h>
 
 extern CAppModule _Module;
@@ -44,14 +45,15 @@ using SettingsChangedCallback = std::function<void(const Core::Settings&)>;
 /// General settings page
 class GeneralPage : public CPropertyPageImpl<GeneralPage> {
 public:
-    enum { IDD = 0 };  // We'll create controls programmatically
+    enum { IDD = 0 };  // Controls are created in code on a blank template
 
     GeneralPage(Core::Settings& settings);
 
-    BEGIN_MSG_MAP(GeneralPage)
+    BEGIN_MSG_MAP_EX(GeneralPage)
         MSG_WM_INITDIALOG(OnInitDialog)
         COMMAND_HANDLER_EX(IDC_DEFAULT_PROFILE, CBN_SELCHANGE, OnProfileChanged)
         COMMAND_HANDLER_EX(IDC_SCROLLBACK, EN_CHANGE, OnScrollbackChanged)
+        COMMAND_HANDLER_EX(IDC_SCROLLBACK_BUDGET, EN_CHANGE, OnScrollbackChanged)
         COMMAND_HANDLER_EX(IDC_COPY_ON_SELECT, BN_CLICKED, OnCopyOnSelectChanged)
         CHAIN_MSG_MAP(CPropertyPageImpl<GeneralPage>)
     END_MSG_MAP()
@@ -66,6 +68,7 @@ public:
     enum {
         IDC_DEFAULT_PROFILE = 1001,
         IDC_SCROLLBACK,
+        IDC_SCROLLBACK_BUDGET,
         IDC_COPY_ON_SELECT,
         IDC_WORD_WRAP
     };
@@ -74,6 +77,7 @@ private:
     Core::Settings& m_settings;
     CComboBox m_profileCombo;
     CEdit m_scrollbackEdit;
+    CEdit m_scrollbackBudgetEdit;
     CButton m_copyOnSelectCheck;
     CButton m_wordWrapCheck;
 };
@@ -85,15 +89,18 @@ public:
 
     AppearancePage(Core::Settings& settings);
 
-    BEGIN_MSG_MAP(AppearancePage)
+    BEGIN_MSG_MAP_EX(AppearancePage)
         MSG_WM_INITDIALOG(OnInitDialog)
+        MSG_WM_TIMER(OnTimer)
         COMMAND_HANDLER_EX(IDC_FONT_FAMILY, CBN_SELCHANGE, OnFontChanged)
+        COMMAND_HANDLER_EX(IDC_FONT_FAMILY, CBN_EDITCHANGE, OnFontChanged)
         COMMAND_HANDLER_EX(IDC_FONT_SIZE, EN_CHANGE, OnFontChanged)
         COMMAND_HANDLER_EX(IDC_COLOR_SCHEME, CBN_SELCHANGE, OnColorSchemeChanged)
         CHAIN_MSG_MAP(CPropertyPageImpl<AppearancePage>)
     END_MSG_MAP()
 
     BOOL OnInitDialog(CWindow wndFocus, LPARAM lInitParam);
+    void OnTimer(UINT_PTR nIDEvent);
     void OnFontChanged(UINT uNotifyCode, int nID, CWindow wndCtl);
     void OnColorSchemeChanged(UINT uNotifyCode, int nID, CWindow wndCtl);
     int OnApply();
@@ -108,8 +115,17 @@ public:
     };
 
 private:
+    /// Polls the font catalog for families found since the combo was filled
+    static constexpr UINT_PTR TIMER_FONT_CATALOG = 1;
+    static constexpr UINT kFontCatalogPollMs = 100;
+
+    /// Bring the font combo up to the catalog, keeping what is typed in it
+    void FillFontFamilies();
+
     Core::Settings& m_settings;
     CComboBox m_fontFamilyCombo;
+    uint32_t m_fontGeneration = 0;      ///< Catalog generation the combo shows
+    bool m_fontFallback = false;        ///< Shows the well-known families, not the catalog's
     CEdit m_fontSizeEdit;
     CButton m_fontBoldCheck;
     CComboBox m_colorSchemeCombo;
@@ -124,7 +140,7 @@ public:
 
     CursorPage(Core::Settings& settings);
 
-    BEGIN_MSG_MAP(CursorPage)
+    BEGIN_MSG_MAP_EX(CursorPage)
         MSG_WM_INITDIALOG(OnInitDialog)
         COMMAND_HANDLER_EX(IDC_CURSOR_STYLE, CBN_SELCHANGE, OnCursorStyleChanged)
         COMMAND_HANDLER_EX(IDC_CURSOR_BLINK, BN_CLICKED, OnCursorBlinkChanged)
@@ -156,7 +172,7 @@ public:
 
     TabsPage(Core::Settings& settings);
 
-    BEGIN_MSG_MAP(TabsPage)
+    BEGIN_MSG_MAP_EX(TabsPage)
         MSG_WM_INITDIALOG(OnInitDialog)
         CHAIN_MSG_MAP(CPropertyPageImpl<TabsPage>)
     END_MSG_MAP()
@@ -181,6 +197,65 @@ private:
     CButton m_restoreTabs;
 };
 
+/// Performance settings page: a preset, and the values it fills in
+class PerformancePage : public CPropertyPageImpl<PerformancePage> {
+public:
+    enum { IDD = 0 };
+
+    PerformancePage(Core::Settings& settings);
+
+    BEGIN_MSG_MAP_EX(PerformancePage)
+        MSG_WM_INITDIALOG(OnInitDialog)
+        COMMAND_HANDLER_EX(IDC_PRESET, CBN_SELCHANGE, OnPresetChanged)
+        COMMAND_HANDLER_EX(IDC_RENDERER, CBN_SELCHANGE, OnValueChanged)
+        COMMAND_HANDLER_EX(IDC_MAX_FPS, EN_CHANGE, OnValueChanged)
+        COMMAND_HANDLER_EX(IDC_OUTPUT_BUFFER, EN_CHANGE, OnValueChanged)
+        COMMAND_HANDLER_EX(IDC_READ_CHUNK, EN_CHANGE, OnValueChanged)
+        COMMAND_HANDLER_EX(IDC_HOT_LINES, EN_CHANGE, OnValueChanged)
+        COMMAND_HANDLER_EX(IDC_CELL_GRID, BN_CLICKED, OnValueChanged)
+        COMMAND_HANDLER_EX(IDC_THROTTLE, BN_CLICKED, OnValueChanged)
+        COMMAND_HANDLER_EX(IDC_PREDICTIVE_ECHO, BN_CLICKED, OnValueChanged)
+        COMMAND_HANDLER_EX(IDC_SAVE_POWER, BN_CLICKED, OnValueChanged)
+        CHAIN_MSG_MAP(CPropertyPageImpl<PerformancePage>)
+    END_MSG_MAP()
+
+    BOOL OnInitDialog(CWindow wndFocus, LPARAM lInitParam);
+    void OnPresetChanged(UINT uNotifyCode, int nID, CWindow wndCtl);
+    void OnValueChanged(UINT uNotifyCode, int nID, CWindow wndCtl);
+    int OnApply();
+
+    enum {
+        IDC_PRESET = 5001,
+        IDC_RENDERER,
+        IDC_MAX_FPS,
+        IDC_OUTPUT_BUFFER,
+        IDC_READ_CHUNK,
+        IDC_HOT_LINES,
+        IDC_CELL_GRID,
+        IDC_THROTTLE,
+        IDC_PREDICTIVE_ECHO,
+        IDC_SAVE_POWER
+    };
+
+private:
+    /// Show the working values in the controls
+    void ShowValues();
+
+    Core::Settings& m_settings;
+    Core::PerformanceSettings m_working;   ///< The preset picked, with the fields this page lacks
+    bool m_showing = false;                ///< ShowValues() is filling in the controls
+    CComboBox m_presetCombo;
+    CComboBox m_rendererCombo;
+    CEdit m_maxFpsEdit;
+    CEdit m_outputBufferEdit;
+    CEdit m_readChunkEdit;
+    CEdit m_hotLinesEdit;
+    CButton m_cellGridCheck;
+    CButton m_throttleCheck;
+    CButton m_predictiveEchoCheck;
+    CButton m_savePowerCheck;
+};
+
 // ============================================================================
 // Main Settings Dialog
 // ============================================================================
@@ -212,6 +287,7 @@ private:
     std::unique_ptr<AppearancePage> m_appearancePage;
     std::unique_ptr<CursorPage> m_cursorPage;
     std::unique_ptr<TabsPage> m_tabsPage;
+    std::unique_ptr<PerformancePage> m_performancePage;
 };
 
 } // namespace Console3::UI
@@ -0,0 +1,244 @@
+// Console3 - ShapedRunCache.cpp
+// Shaped glyph runs for programming-font ligatures, cached by run text
+
+#include "UI/ShapedRunCache.h"
+#include <wrl/implements.h>
+#include <algorithm>
+
+namespace Console3::UI {
+
+namespace {
+
+/// Characters below this are laid out left to right, one per cell, so a
+/// shaped run still maps onto the cells; runs with others stay unshaped
+constexpr uint32_t kShapeableLimit = 0x0590;
+
+/// A run of text and the script segments AnalyzeScript finds in it
+class ScriptAnalysis : public Microsoft::WRL::RuntimeClass<
+                           Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>,
+                           IDWriteTextAnalysisSource, IDWriteTextAnalysisSink> {
+public:
+    struct Segment {
+        UINT32 position = 0;
+        UINT32 length = 0;
+        DWRITE_SCRIPT_ANALYSIS script{};
+    };
+
+    ScriptAnalysis(const wchar_t* text, UINT32 length) : m_text(text), m_length(length) {}
+
+    [[nodiscard]] const std::vector<Segment>& GetSegments() const noexcept { return m_segments; }
+
+    // IDWriteTextAnalysisSource
+    STDMETHOD(GetTextAtPosition)(UINT32 position, const WCHAR** text, UINT32* length) override {
+        *text = position < m_length ? m_text + position : nullptr;
+        *length = position < m_length ? m_length - position : 0;
+        return S_OK;
+    }
+
+    STDMETHOD(GetTextBeforePosition)(UINT32 position, const WCHAR** text, UINT32* length) override {
+        *text = position > 0 && position <= m_length ? m_text : nullptr;
+        *length = position <= m_length ? position : 0;
+        return S_OK;
+    }
+
+    STDMETHOD_(DWRITE_READING_DIRECTION, GetParagraphReadingDirection)() override {
+        return DWRITE_READING_DIRECTION_LEFT_TO_RIGHT;
+    }
+
+    STDMETHOD(GetLocaleName)(UINT32 position, UINT32* length, const WCHAR** locale) override {
+        *length = m_length - std::min(position, m_length);
+        *locale = L"en-us";
+        return S_OK;
+    }
+
+    STDMETHOD(GetNumberSubstitution)(UINT32 position, UINT32* length,
+                                     IDWriteNumberSubstitution** substitution) override {
+        *length = m_length - std::min(position, m_length);
+        *substitution = nullptr;
+        return S_OK;
+    }
+
+    // IDWriteTextAnalysisSink
+    STDMETHOD(SetScriptAnalysis)(UINT32 position, UINT32 length,
+                                 const DWRITE_SCRIPT_ANALYSIS* script) override {
+        m_segments.push_back({position, length, *script});
+        return S_OK;
+    }
+
+    STDMETHOD(SetLineBreakpoints)(UINT32, UINT32, const DWRITE_LINE_BREAKPOINT*) override { return S_OK; }
+    STDMETHOD(SetBidiLevel)(UINT32, UINT32, UINT8, UINT8) override { return S_OK; }
+    STDMETHOD(SetNumberSubstitution)(UINT32, UINT32, IDWriteNumberSubstitution*) override { return S_OK; }
+
+private:
+    const wchar_t* m_text;
+    UINT32 m_length;
+    std::vector<Segment> m_segments;
+};
+
+} // namespace
+
+// ============================================================================
+// ShapedRun
+// ============================================================================
+
+void ShapedRun::GetAdvances(float cellWidth, std::vector<FLOAT>& advances) const {
+    // Each glyph ends where the next one starts; clusters start on their cells
+    const size_t count = glyphs.size();
+    advances.resize(count);
+    for (size_t index = 0; index < count; ++index) {
+        const float start = static_cast<float>(cells[index]) * cellWidth + positions[index];
+        const float end = index + 1 < count
+                              ? static_cast<float>(cells[index + 1]) * cellWidth + positions[index + 1]
+                              : static_cast<float>(cellCount) * cellWidth;
+        advances[index] = end - start;
+    }
+}
+
+// ============================================================================
+// ShapedRunCache
+// ============================================================================
+
+void ShapedRunCache::Reset(IDWriteFactory1* dwriteFactory) {
+    Clear();
+    m_analyzer.Reset();
+    if (dwriteFactory) {
+        (void)dwriteFactory->CreateTextAnalyzer(m_analyzer.GetAddressOf());
+    }
+}
+
+void ShapedRunCache::Clear() noexcept {
+    m_index.clear();
+    m_entries.clear();
+}
+
+uint64_t ShapedRunCache::Hash(std::span<const uint32_t> codepoints, FontVariant variant) noexcept {
+    // FNV-1a over the text, then the variant and cell count
+    uint64_t hash = 14695981039346656037ull;
+    const auto mix = [&hash](uint64_t value) {
+        hash ^= value;
+        hash *= 1099511628211ull;
+    };
+    for (const uint32_t codepoint : codepoints) {
+        mix(codepoint);
+    }
+    mix(static_cast<uint64_t>(variant));
+    mix(codepoints.size());
+    return hash;
+}
+
+const ShapedRun* ShapedRunCache::Shape(std::span<const uint32_t> codepoints, FontVariant variant,
+                                       IDWriteFontFace* face, float emSize) {
+    if (!m_analyzer || !face || codepoints.empty()) {
+        return nullptr;
+    }
+
+    const uint64_t hash = Hash(codepoints, variant);
+    if (const auto found = m_index.find(hash); found != m_index.end()) {
+        Entry& entry = *found->second;
+        if (entry.variant == variant && std::equal(codepoints.begin(), codepoints.end(), entry.text.begin(),
+                                                   entry.text.end())) {
+            m_entries.splice(m_entries.begin(), m_entries, found->second);
+            return entry.shaped ? &entry.run : nullptr;
+        }
+
+        // A different run with the same hash gives way
+        m_entries.erase(found->second);
+        m_index.erase(found);
+    }
+
+    if (m_entries.size() >= kMaxRuns) {
+        m_index.erase(Hash(m_entries.back().text, m_entries.back().variant));
+        m_entries.pop_back();
+    }
+
+    // Runs that can't be shaped are remembered too, so they aren't tried
+    // again every frame
+    Entry& entry = m_entries.emplace_front();
+    entry.text.assign(codepoints.begin(), codepoints.end());
+    entry.variant = variant;
+    entry.shaped = ShapeRun(codepoints, face, emSize, entry.run);
+    m_index[hash] = m_entries.begin();
+    return entry.shaped ? &entry.run : nullptr;
+}
+
+bool ShapedRunCache::ShapeRun(std::span<const uint32_t> codepoints, IDWriteFontFace* face, float emSize,
+                              ShapedRun& run) {
+    // One UTF-16 unit per cell
+    m_text.clear();
+    for (const uint32_t codepoint : codepoints) {
+        if (codepoint >= kShapeableLimit) {
+            return false;
+        }
+        m_text += static_cast<wchar_t>(codepoint);
+    }
+    const auto length = static_cast<UINT32>(m_text.size());
+
+    const auto analysis = Microsoft::WRL::Make<ScriptAnalysis>(m_text.c_str(), length);
+    if (!analysis || FAILED(m_analyzer->AnalyzeScript(analysis.Get(), 0, length, analysis.Get()))) {
+        return false;
+    }
+    std::vector<ScriptAnalysis::Segment> segments = analysis->GetSegments();
+    std::sort(segments.begin(), segments.end(),
+              [](const auto& a, const auto& b) { return a.position < b.position; });
+
+    run.glyphs.clear();
+    run.offsets.clear();
+    run.cells.clear();
+    run.positions.clear();
+    run.cellCount = static_cast<uint32_t>(codepoints.size());
+
+    for (const ScriptAnalysis::Segment& segment : segments) {
+        const wchar_t* text = m_text.c_str() + segment.position;
+        UINT32 glyphCount = 0;
+        UINT32 maxGlyphs = segment.length * 3 / 2 + 16;
+        m_clusterMap.resize(segment.length);
+        m_textProps.resize(segment.length);
+        HRESULT hr = E_NOT_SUFFICIENT_BUFFER;
+        std::vector<UINT16> glyphs;
+        while (hr == E_NOT_SUFFICIENT_BUFFER) {
+            glyphs.resize(maxGlyphs);
+            m_glyphProps.resize(maxGlyphs);
+            hr = m_analyzer->GetGlyphs(text, segment.length, face, FALSE, FALSE, &segment.script, L"en-us",
+                                       nullptr, nullptr, nullptr, 0, maxGlyphs, m_clusterMap.data(),
+                                       m_textProps.data(), glyphs.data(), m_glyphProps.data(), &glyphCount);
+            maxGlyphs *= 2;
+        }
+        if (FAILED(hr)) {
+            return false;
+        }
+
+        m_advances.resize(glyphCount);
+        std::vector<DWRITE_GLYPH_OFFSET> offsets(glyphCount);
+        if (FAILED(m_analyzer->GetGlyphPlacements(text, m_clusterMap.data(), m_textProps.data(), segment.length,
+                                                  glyphs.data(), m_glyphProps.data(), glyphCount, face, emSize,
+                                                  FALSE, FALSE, &segment.script, L"en-us", nullptr, nullptr, 0,
+                                                  m_advances.data(), offsets.data()))) {
+            return false;
+        }
+
+        // A cluster's glyphs keep their spacing from its first cell; the
+        // next cluster starts on its own cell whatever the font's advances
+        for (UINT32 unit = 0; unit < segment.length; ++unit) {
+            const UINT16 first = m_clusterMap[unit];
+            if (unit > 0 && first == m_clusterMap[unit - 1]) {
+                continue;
+            }
+            UINT32 next = unit + 1;
+            while (next < segment.length && m_clusterMap[next] == first) {
+                ++next;
+            }
+            const UINT32 last = next < segment.length ? m_clusterMap[next] : glyphCount;
+            float position = 0.0f;
+            for (UINT32 glyph = first; glyph < last; ++glyph) {
+                run.glyphs.push_back(glyphs[glyph]);
+                run.offsets.push_back(offsets[glyph]);
+                run.cells.push_back(segment.position + unit);
+                run.positions.push_back(position);
+                position += m_advances[glyph];
+            }
+        }
+    }
+    return !run.glyphs.empty();
+}
+
+} // namespace Console3::UI
@@ -0,0 +1,97 @@
+#pragma once
+// Console3 - ShapedRunCache.h
+// Shaped glyph runs for programming-font ligatures, cached by run text
+//
+// Ligatures (Cascadia Code's and Fira Code's "calt" and "liga" features)
+// need the run shaped by IDWriteTextAnalyzer, which costs far more than
+// the glyph index table lookups unshaped runs use. A terminal redraws the
+// same runs frame after frame, so a run is shaped once and kept under a
+// hash of (text, font variant, cell count): the glyphs, their offsets, and
+// where each glyph sits relative to the cells of its cluster. Advances are
+// derived from that at draw time, so cell metrics can change (DPI, pixel
+// snapping) without shaping again. Runs are kept until the font changes,
+// the least recently used giving way past kMaxRuns.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+#include <dwrite_1.h>
+#include <wrl/client.h>
+
+#include "UI/GlyphAtlas.h"
+
+#include <cstdint>
+#include <list>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using Microsoft::WRL::ComPtr;
+
+namespace Console3::UI {
+
+/// A run shaped with the font's ligatures
+struct ShapedRun {
+    std::vector<UINT16> glyphs;
+    std::vector<DWRITE_GLYPH_OFFSET> offsets;
+    std::vector<uint32_t> cells;        ///< Per glyph: first cell of its cluster
+    std::vector<float> positions;       ///< Per glyph: x within its cluster (DIPs)
+    uint32_t cellCount = 0;
+
+    /// Fill advances that put each cluster on its cells
+    void GetAdvances(float cellWidth, std::vector<FLOAT>& advances) const;
+};
+
+/// Cache of shaped runs (see file comment)
+class ShapedRunCache {
+public:
+    static constexpr size_t kMaxRuns = 4096;
+
+    /// Start over with a DirectWrite factory (on font change)
+    void Reset(IDWriteFactory1* dwriteFactory);
+
+    /// Drop the shaped runs, keeping the analyzer
+    void Clear() noexcept;
+
+    /// Get a run shaped, from the cache or shaped now
+    /// @param codepoints UTF-32 codepoints, one per cell
+    /// @param face The variant's font face
+    /// @param emSize Font size (DIPs)
+    /// @return The run (valid until the next call), or nullptr if it can't
+    /// be shaped as one script; draw it unshaped then
+    [[nodiscard]] const ShapedRun* Shape(std::span<const uint32_t> codepoints, FontVariant variant,
+                                         IDWriteFontFace* face, float emSize);
+
+private:
+    struct Entry {
+        std::vector<uint32_t> text;
+        FontVariant variant = FontVariant::Regular;
+        bool shaped = false;            ///< false: remembered as unshapeable
+        ShapedRun run;
+    };
+
+    [[nodiscard]] static uint64_t Hash(std::span<const uint32_t> codepoints, FontVariant variant) noexcept;
+    [[nodiscard]] bool ShapeRun(std::span<const uint32_t> codepoints, IDWriteFontFace* face, float emSize,
+                                ShapedRun& run);
+
+    ComPtr<IDWriteTextAnalyzer> m_analyzer;
+
+    // Most recently used first; the map holds their positions
+    std::list<Entry> m_entries;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> m_index;
+
+    // Shaping scratch (reused between runs)
+    std::wstring m_text;
+    std::vector<UINT16> m_clusterMap;
+    std::vector<DWRITE_SHAPING_TEXT_PROPERTIES> m_textProps;
+    std::vector<DWRITE_SHAPING_GLYPH_PROPERTIES> m_glyphProps;
+    std::vector<FLOAT> m_advances;
+};
+
+} // namespace Console3::UI
@@ -0,0 +1,264 @@
+// Console3 - SharedRenderResources.cpp
+// Rendering resources shared by every window of the process
+
+#include "UI/SharedRenderResources.h"
+#include <dwrite_3.h>
+#include <dxgi1_6.h>
+#include <algorithm>
+#include <string_view>
+
+namespace Console3::UI {
+
+namespace {
+
+[[nodiscard]] bool SameAdapter(const LUID& a, const LUID& b) noexcept {
+    return a.LowPart == b.LowPart && a.HighPart == b.HighPart;
+}
+
+/// Find the hardware adapter with an output on a monitor
+ComPtr<IDXGIAdapter1> FindDisplayAdapter(IDXGIFactory1* factory, HMONITOR monitor) {
+    ComPtr<IDXGIAdapter1> adapter;
+    for (UINT index = 0; SUCCEEDED(factory->EnumAdapters1(index, adapter.ReleaseAndGetAddressOf())); ++index) {
+        ComPtr<IDXGIOutput> output;
+        for (UINT outputIndex = 0;
+             SUCCEEDED(adapter->EnumOutputs(outputIndex, output.ReleaseAndGetAddressOf())); ++outputIndex) {
+            DXGI_OUTPUT_DESC desc{};
+            if (SUCCEEDED(output->GetDesc(&desc)) && desc.Monitor == monitor) {
+                return adapter;
+            }
+        }
+    }
+    return nullptr;
+}
+
+/// Check if a registry font name ("Cascadia Mono SemiBold (TrueType)",
+/// "MS Gothic & MS PGothic (TrueType)") names a font of a family
+[[nodiscard]] bool NamesFamily(std::wstring_view name, const std::wstring& family) {
+    name = name.substr(0, name.find(L" ("));
+    while (!name.empty()) {
+        const size_t amp = name.find(L" & ");
+        const std::wstring_view part = name.substr(0, amp);
+        if (part.size() >= family.size() && _wcsnicmp(part.data(), family.c_str(), family.size()) == 0 &&
+            (part.size() == family.size() || part[family.size()] == L' ')) {
+            return true;
+        }
+        name = amp == std::wstring_view::npos ? std::wstring_view() : name.substr(amp + 3);
+    }
+    return false;
+}
+
+/// Add the files a registry font list holds for a family
+void FindFamilyFiles(HKEY root, const std::wstring& family, std::vector<std::wstring>& files) {
+    HKEY key = nullptr;
+    if (RegOpenKeyExW(root, L"SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion\\Fonts", 0, KEY_READ, &key) !=
+        ERROR_SUCCESS) {
+        return;
+    }
+
+    // Machine-wide fonts are named relative to the Fonts directory
+    wchar_t windows[MAX_PATH];
+    const UINT windowsLength = GetWindowsDirectoryW(windows, MAX_PATH);
+    const std::wstring fontsDir =
+        (windowsLength > 0 && windowsLength < MAX_PATH ? std::wstring(windows, windowsLength) : L"C:\\Windows") +
+        L"\\Fonts\\";
+
+    std::vector<wchar_t> name(16384);
+    std::vector<wchar_t> data(MAX_PATH + 1);
+    for (DWORD index = 0;; ++index) {
+        DWORD nameLength = static_cast<DWORD>(name.size());
+        DWORD dataBytes = static_cast<DWORD>(data.size() * sizeof(wchar_t));
+        DWORD type = 0;
+        const LSTATUS status = RegEnumValueW(key, index, name.data(), &nameLength, nullptr, &type,
+                                             reinterpret_cast<BYTE*>(data.data()), &dataBytes);
+        if (status == ERROR_NO_MORE_ITEMS) {
+            break;
+        }
+        if (status != ERROR_SUCCESS || type != REG_SZ || !NamesFamily({name.data(), nameLength}, family)) {
+            continue;
+        }
+        std::wstring file(data.data(), wcsnlen(data.data(), dataBytes / sizeof(wchar_t)));
+        if (file.find(L'\\') == std::wstring::npos) {
+            file = fontsDir + file;
+        }
+        files.push_back(std::move(file));
+    }
+    RegCloseKey(key);
+}
+
+} // namespace
+
+GpuPreference ParseGpuPreference(const std::wstring& name) noexcept {
+    if (name == L"power") return GpuPreference::MinimumPower;
+    if (name == L"performance") return GpuPreference::HighPerformance;
+    return GpuPreference::Display;
+}
+
+SharedRenderResources& SharedRenderResources::Shared() {
+    static SharedRenderResources s_instance;
+    return s_instance;
+}
+
+LUID SharedRenderResources::FindAdapter(GpuPreference preference, HMONITOR monitor) {
+    ComPtr<IDXGIFactory1> factory;
+    if (FAILED(CreateDXGIFactory1(IID_PPV_ARGS(factory.GetAddressOf())))) {
+        return LUID{};
+    }
+
+    // A preference needs Windows 10 1803's factory; without it the system
+    // default serves
+    ComPtr<IDXGIAdapter1> adapter;
+    ComPtr<IDXGIFactory6> factory6;
+    if (preference == GpuPreference::Display) {
+        adapter = monitor ? FindDisplayAdapter(factory.Get(), monitor) : nullptr;
+    } else if (SUCCEEDED(factory.As(&factory6))) {
+        const DXGI_GPU_PREFERENCE gpu = preference == GpuPreference::MinimumPower
+                                            ? DXGI_GPU_PREFERENCE_MINIMUM_POWER
+                                            : DXGI_GPU_PREFERENCE_HIGH_PERFORMANCE;
+        (void)factory6->EnumAdapterByGpuPreference(0, gpu, IID_PPV_ARGS(adapter.GetAddressOf()));
+    }
+
+    DXGI_ADAPTER_DESC1 desc{};
+    if (!adapter || FAILED(adapter->GetDesc1(&desc)) || (desc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE)) {
+        return LUID{};
+    }
+    return desc.AdapterLuid;
+}
+
+bool SharedRenderResources::GetDevice(ID2D1Factory1* d2dFactory, LUID adapter, ComPtr<ID3D11Device>& d3dDevice,
+                                      ComPtr<ID2D1Device>& d2dDevice) {
+    const auto found = std::find_if(m_devices.begin(), m_devices.end(), [&adapter](const AdapterDevices& devices) {
+        return SameAdapter(devices.adapter, adapter);
+    });
+    if (found != m_devices.end()) {
+        d3dDevice = found->d3dDevice;
+        d2dDevice = found->d2dDevice;
+        return true;
+    }
+    if (!d2dFactory) {
+        return false;
+    }
+
+    // The adapter asked for, else the default one (it may have gone since
+    // it was found)
+    ComPtr<IDXGIAdapter> dxgiAdapter;
+    ComPtr<IDXGIFactory4> factory;
+    if ((adapter.LowPart != 0 || adapter.HighPart != 0) &&
+        SUCCEEDED(CreateDXGIFactory1(IID_PPV_ARGS(factory.GetAddressOf())))) {
+        (void)factory->EnumAdapterByLuid(adapter, IID_PPV_ARGS(dxgiAdapter.GetAddressOf()));
+    }
+
+    // BGRA support is what lets Direct2D draw on the device
+    const UINT deviceFlags = D3D11_CREATE_DEVICE_BGRA_SUPPORT;
+    ComPtr<ID3D11Device> newD3dDevice;
+    HRESULT hr = E_FAIL;
+    if (dxgiAdapter) {
+        hr = D3D11CreateDevice(dxgiAdapter.Get(), D3D_DRIVER_TYPE_UNKNOWN, nullptr, deviceFlags, nullptr, 0,
+                               D3D11_SDK_VERSION, newD3dDevice.GetAddressOf(), nullptr, nullptr);
+    }
+    if (FAILED(hr)) {
+        hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, deviceFlags, nullptr, 0,
+                               D3D11_SDK_VERSION, newD3dDevice.ReleaseAndGetAddressOf(), nullptr, nullptr);
+    }
+    if (FAILED(hr)) {
+        hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_WARP, nullptr, deviceFlags, nullptr, 0,
+                               D3D11_SDK_VERSION, newD3dDevice.GetAddressOf(), nullptr, nullptr);
+    }
+    if (FAILED(hr)) {
+        return false;
+    }
+
+    ComPtr<IDXGIDevice> dxgiDevice;
+    ComPtr<ID2D1Device> newD2dDevice;
+    if (FAILED(newD3dDevice.As(&dxgiDevice)) ||
+        FAILED(d2dFactory->CreateDevice(dxgiDevice.Get(), newD2dDevice.GetAddressOf()))) {
+        return false;
+    }
+
+    m_devices.push_back(AdapterDevices{adapter, newD3dDevice, newD2dDevice});
+    d3dDevice = std::move(newD3dDevice);
+    d2dDevice = std::move(newD2dDevice);
+    return true;
+}
+
+void SharedRenderResources::ReportDeviceLost(ID3D11Device* d3dDevice) {
+    // The other renderers on the device find out from the generation
+    const auto lost = std::find_if(m_devices.begin(), m_devices.end(), [d3dDevice](const AdapterDevices& devices) {
+        return d3dDevice && devices.d3dDevice.Get() == d3dDevice;
+    });
+    if (lost == m_devices.end()) {
+        return;
+    }
+    m_devices.erase(lost);
+    ++m_deviceGeneration;
+    PruneExpired();
+}
+
+std::shared_ptr<GlyphAtlas> SharedRenderResources::FindAtlas(const std::wstring& key) {
+    const auto it = m_atlases.find(key);
+    return it != m_atlases.end() ? it->second.lock() : nullptr;
+}
+
+void SharedRenderResources::AddAtlas(const std::wstring& key, const std::shared_ptr<GlyphAtlas>& atlas) {
+    PruneExpired();
+    m_atlases[key] = atlas;
+}
+
+std::shared_ptr<ShapedRunCache> SharedRenderResources::GetShapedRuns(const std::wstring& fontKey,
+                                                                     IDWriteFactory1* dwriteFactory) {
+    if (const auto it = m_shapedRuns.find(fontKey); it != m_shapedRuns.end()) {
+        if (auto runs = it->second.lock()) {
+            return runs;
+        }
+    }
+
+    PruneExpired();
+    auto runs = std::make_shared<ShapedRunCache>();
+    runs->Reset(dwriteFactory);
+    m_shapedRuns[fontKey] = runs;
+    return runs;
+}
+
+IDWriteFontCollection* SharedRenderResources::GetFamilyCollection(const std::wstring& family,
+                                                                 IDWriteFactory1* dwriteFactory) {
+    if (const auto it = m_fonts.families.find(family); it != m_fonts.families.end()) {
+        return it->second.Get();
+    }
+    ComPtr<IDWriteFontCollection>& cached = m_fonts.families[family];
+
+    std::vector<std::wstring> files;
+    FindFamilyFiles(HKEY_LOCAL_MACHINE, family, files);
+    FindFamilyFiles(HKEY_CURRENT_USER, family, files);
+    ComPtr<IDWriteFactory5> factory;
+    ComPtr<IDWriteFontSetBuilder1> builder;
+    if (files.empty() || !dwriteFactory ||
+        FAILED(dwriteFactory->QueryInterface(IID_PPV_ARGS(factory.GetAddressOf()))) ||
+        FAILED(factory->CreateFontSetBuilder(builder.GetAddressOf()))) {
+        return nullptr;
+    }
+    for (const std::wstring& file : files) {
+        ComPtr<IDWriteFontFile> fontFile;
+        if (SUCCEEDED(factory->CreateFontFileReference(file.c_str(), nullptr, fontFile.GetAddressOf()))) {
+            (void)builder->AddFontFile(fontFile.Get());
+        }
+    }
+
+    // The family has to be in it under the name asked for, or the system's serves
+    ComPtr<IDWriteFontSet> fontSet;
+    ComPtr<IDWriteFontCollection1> collection;
+    UINT32 index = 0;
+    BOOL exists = FALSE;
+    if (FAILED(builder->CreateFontSet(fontSet.GetAddressOf())) ||
+        FAILED(factory->CreateFontCollectionFromFontSet(fontSet.Get(), collection.GetAddressOf())) ||
+        FAILED(collection->FindFamilyName(family.c_str(), &index, &exists)) || !exists) {
+        return nullptr;
+    }
+    cached = collection;
+    return cached.Get();
+}
+
+void SharedRenderResources::PruneExpired() {
+    std::erase_if(m_atlases, [](const auto& entry) { return entry.second.expired(); });
+    std::erase_if(m_shapedRuns, [](const auto& entry) { return entry.second.expired(); });
+}
+
+} // namespace Console3::UI
@@ -0,0 +1,173 @@
+#pragma once
+// Console3 - SharedRenderResources.h
+// Rendering resources shared by every window of the process
+//
+// Several windows tiled side by side usually show the same font at the same
+// DPI. Each renderer used to create its own Direct3D device, rasterize its
+// own glyph atlas, resolve font fallback and shape ligature runs on its own,
+// and keep its own text formats and faces - the same work and memory once
+// per window. The renderers of a process now share one Direct3D and Direct2D
+// device (each window keeps its device context and swap chain), one glyph
+// atlas per font, DPI and atlas mode (with the font fallback results the
+// atlas keeps), one shaped run cache per font, and the DirectWrite font
+// objects. The session scheduler is process-wide already.
+//
+// On machines with more than one GPU (an integrated and a discrete one) the
+// device is made on the adapter the renderer's GPU preference picks: by
+// default the one driving the window's monitor, so frames are not copied
+// between GPUs and a discrete GPU is not woken for a terminal. There is one
+// shared device per adapter in use; renderers pick again when their window
+// moves to another monitor.
+//
+// Atlases and shaped run caches are shared while some renderer holds them:
+// the registry only keeps weak references. Atlases are only shared between
+// renderers on the shared device, and their key carries the device
+// generation, so after a device loss every renderer moves to atlases made
+// on the new device.
+//
+// Everything here is used on the UI thread, like the single-threaded
+// Direct2D factory the renderers share.
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+#include <d2d1_1.h>
+#include <d3d11.h>
+#include <dwrite_1.h>
+#include <wrl/client.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "UI/GlyphAtlas.h"
+#include "UI/ShapedRunCache.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace Console3::UI {
+
+/// GPU a renderer draws on (PerformanceSettings::gpu)
+enum class GpuPreference : uint8_t {
+    Display,            ///< The adapter driving the window's monitor
+    MinimumPower,       ///< The integrated GPU (DXGI_GPU_PREFERENCE_MINIMUM_POWER)
+    HighPerformance,    ///< The discrete GPU (DXGI_GPU_PREFERENCE_HIGH_PERFORMANCE)
+};
+
+/// Get the preference a performance setting names ("display", "power",
+/// "performance")
+/// @return The preference (Display for any other name)
+[[nodiscard]] GpuPreference ParseGpuPreference(const std::wstring& name) noexcept;
+
+/// Process-wide rendering resources (see file comment)
+class SharedRenderResources {
+public:
+    /// A font face and its glyph index table
+    struct CachedFace {
+        ComPtr<IDWriteFontFace> face;
+        std::vector<UINT16> glyphIndices;
+    };
+
+    /// Cell metrics of a font at a DPI
+    struct CachedMetrics {
+        float cellWidth = 0.0f;
+        float cellHeight = 0.0f;
+        float baseline = 0.0f;
+    };
+
+    /// Font objects kept across font and DPI changes: the system collection,
+    /// collections of one family (GetFamilyCollection), text formats by
+    /// family and size, faces by family, weight and style, and cell metrics
+    /// by family, size, DPI and snapping
+    struct FontObjects {
+        ComPtr<IDWriteFontCollection> collection;
+        std::unordered_map<std::wstring, ComPtr<IDWriteFontCollection>> families;   ///< Null: not found
+
+        std::unordered_map<std::wstring, std::array<ComPtr<IDWriteTextFormat>, 4>> formats;
+        std::unordered_map<std::wstring, CachedFace> faces;
+        std::unordered_map<std::wstring, CachedMetrics> metrics;
+    };
+
+    SharedRenderResources() = default;
+
+    // Non-copyable, non-movable
+    SharedRenderResources(const SharedRenderResources&) = delete;
+    SharedRenderResources& operator=(const SharedRenderResources&) = delete;
+
+    /// Get the process-wide resources (UI thread)
+    static SharedRenderResources& Shared();
+
+    /// Find the adapter a preference picks for a monitor
+    /// @return Its LUID (zero if DXGI has no say: the system default)
+    [[nodiscard]] static LUID FindAdapter(GpuPreference preference, HMONITOR monitor);
+
+    /// Get the shared devices on an adapter, creating them on first use or
+    /// after a loss (on the default adapter, or WARP, if the adapter fails)
+    /// @param d2dFactory Factory to create the Direct2D device with
+    /// @param adapter LUID from FindAdapter()
+    /// @return false if no device can be created
+    bool GetDevice(ID2D1Factory1* d2dFactory, LUID adapter, ComPtr<ID3D11Device>& d3dDevice,
+                   ComPtr<ID2D1Device>& d2dDevice);
+
+    /// Report that a device was lost; if it is a shared one, the next
+    /// GetDevice() for its adapter creates another and the generation
+    /// changes
+    void ReportDeviceLost(ID3D11Device* d3dDevice);
+
+    /// Get a count that changes whenever a shared device is replaced
+    [[nodiscard]] uint64_t GetDeviceGeneration() const noexcept { return m_deviceGeneration; }
+
+    /// Find an atlas another renderer holds
+    /// @return The atlas, or nullptr if none is held under the key
+    [[nodiscard]] std::shared_ptr<GlyphAtlas> FindAtlas(const std::wstring& key);
+
+    /// Offer an atlas to renderers asking for the same key
+    void AddAtlas(const std::wstring& key, const std::shared_ptr<GlyphAtlas>& atlas);
+
+    /// Get the shaped run cache of a font, creating it if nobody holds one
+    [[nodiscard]] std::shared_ptr<ShapedRunCache> GetShapedRuns(const std::wstring& fontKey,
+                                                                IDWriteFactory1* dwriteFactory);
+
+    /// Get the shared font objects
+    [[nodiscard]] FontObjects& GetFonts() noexcept { return m_fonts; }
+
+    /// Get a collection of only a family's fonts
+    /// The system collection indexes every installed font, which on a
+    /// machine with thousands of them costs hundreds of milliseconds the
+    /// first time. The family's files are found by name in the registry's
+    /// font list instead and built into a font set of their own (Windows 10
+    /// 1703's IDWriteFontSetBuilder1). Characters the family lacks still
+    /// fall back through the system's fonts. Kept per family.
+    /// @return The collection, or nullptr if the family's files can't be
+    ///         found that way (use the system collection)
+    [[nodiscard]] IDWriteFontCollection* GetFamilyCollection(const std::wstring& family,
+                                                             IDWriteFactory1* dwriteFactory);
+
+private:
+    /// The shared devices on one adapter
+    struct AdapterDevices {
+        LUID adapter{};             ///< As asked for (the device may be on another)
+        ComPtr<ID3D11Device> d3dDevice;
+        ComPtr<ID2D1Device> d2dDevice;
+    };
+
+    /// Drop registry entries nobody holds any more
+    void PruneExpired();
+
+    std::vector<AdapterDevices> m_devices;
+    uint64_t m_deviceGeneration = 0;
+
+    std::unordered_map<std::wstring, std::weak_ptr<GlyphAtlas>> m_atlases;
+    std::unordered_map<std::wstring, std::weak_ptr<ShapedRunCache>> m_shapedRuns;
+    FontObjects m_fonts;
+};
+
+} // namespace Console3::UI
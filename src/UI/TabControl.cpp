@@ -6,6 +6,189 @@
 
 namespace Console3::UI {
 
+namespace {
+
+/// Lowercase text in place, for matching titles without regard to case
+void Fold(std::wstring& text) {
+    if (!text.empty()) {
+        CharLowerBuffW(text.data(), static_cast<DWORD>(text.size()));
+    }
+}
+
+} // namespace
+
+// ============================================================================
+// Tab Search
+// ============================================================================
+
+bool TabSearchPopup::Show(const CRect& anchor) {
+    if (!IsWindow()) {
+        // Right-aligned below the anchor, kept on the anchor's monitor
+        const int dpi = static_cast<int>(GetDpiForWindow(m_owner));
+        const int width = MulDiv(kWidth, dpi, 96);
+        const int height = MulDiv(kHeight, dpi, 96);
+        MONITORINFO monitor{};
+        monitor.cbSize = sizeof(monitor);
+        GetMonitorInfoW(MonitorFromRect(&anchor, MONITOR_DEFAULTTONEAREST), &monitor);
+        const CRect work = monitor.rcWork;
+        const int left = std::clamp(static_cast<int>(anchor.right) - width, static_cast<int>(work.left),
+                                    std::max(static_cast<int>(work.right) - width, static_cast<int>(work.left)));
+        CRect rect(left, anchor.bottom, left + width, anchor.bottom + height);
+        if (!Create(m_owner.GetTopLevelParent(), rect)) {
+            return false;
+        }
+    }
+
+    m_queryEdit.SetWindowText(L"");
+    Filter();
+    ShowWindow(SW_SHOW);
+    m_queryEdit.SetFocus();
+    return true;
+}
+
+void TabSearchPopup::Close() {
+    if (IsWindow()) {
+        DestroyWindow();
+    }
+}
+
+BOOL TabSearchPopup::PreTranslateMessage(MSG* pMsg) {
+    // Every filter sees every message of the thread
+    if (!IsWindow() || (pMsg->hwnd != m_hWnd && !IsChild(pMsg->hwnd)) || pMsg->message != WM_KEYDOWN) {
+        return FALSE;
+    }
+
+    // The query keeps the focus; the keys that move through a list move
+    // through the matches
+    switch (pMsg->wParam) {
+    case VK_ESCAPE:
+        Close();
+        return TRUE;
+    case VK_RETURN:
+        Choose(m_list.GetSelectedIndex());
+        return TRUE;
+    case VK_UP:
+    case VK_DOWN:
+    case VK_PRIOR:
+    case VK_NEXT:
+        if (pMsg->hwnd == m_queryEdit.m_hWnd) {
+            m_list.SendMessage(WM_KEYDOWN, pMsg->wParam, pMsg->lParam);
+            return TRUE;
+        }
+        return FALSE;
+    default:
+        return FALSE;
+    }
+}
+
+int TabSearchPopup::OnCreate(LPCREATESTRUCT /*lpCreateStruct*/) {
+    CMessageLoop* pLoop = _Module.GetMessageLoop();
+    ATLASSERT(pLoop != nullptr);
+    pLoop->AddMessageFilter(this);
+
+    const int dpi = static_cast<int>(GetDpiForWindow(m_hWnd));
+    m_font.CreateFont(-MulDiv(9, dpi, 72), 0, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE, DEFAULT_CHARSET,
+                      OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, CLEARTYPE_QUALITY, DEFAULT_PITCH | FF_DONTCARE,
+                      L"Segoe UI");
+
+    CRect client;
+    GetClientRect(&client);
+    const int query = MulDiv(kQueryHeight, dpi, 96);
+    m_queryEdit.Create(m_hWnd, CRect(0, 0, client.right, query), nullptr,
+                       WS_CHILD | WS_VISIBLE | ES_AUTOHSCROLL, WS_EX_CLIENTEDGE, IDC_QUERY);
+
+    // Owner data: rows are read from the tabs as they are painted
+    m_list.Create(m_hWnd, CRect(0, query, client.right, client.bottom), nullptr,
+                  WS_CHILD | WS_VISIBLE | LVS_REPORT | LVS_OWNERDATA | LVS_SINGLESEL | LVS_SHOWSELALWAYS |
+                      LVS_NOCOLUMNHEADER, 0, IDC_TABS);
+    m_list.SetExtendedListViewStyle(LVS_EX_FULLROWSELECT | LVS_EX_DOUBLEBUFFER);
+    m_list.InsertColumn(0, L"Tab", LVCFMT_LEFT, client.right - GetSystemMetricsForDpi(SM_CXVSCROLL, dpi));
+
+    for (HWND control : {m_queryEdit.m_hWnd, m_list.m_hWnd}) {
+        ::SendMessageW(control, WM_SETFONT, reinterpret_cast<WPARAM>(m_font.m_hFont), FALSE);
+    }
+    return 0;
+}
+
+void TabSearchPopup::OnDestroy() {
+    if (CMessageLoop* pLoop = _Module.GetMessageLoop()) {
+        pLoop->RemoveMessageFilter(this);
+    }
+    m_matches.clear();
+    m_font.DeleteObject();
+}
+
+void TabSearchPopup::OnActivate(UINT nState, BOOL /*bMinimized*/, CWindow /*wndOther*/) {
+    // A click anywhere else closes the list, as a menu would
+    if (nState == WA_INACTIVE) {
+        PostMessage(WM_CLOSE);
+    }
+}
+
+void TabSearchPopup::OnQueryChange(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/) {
+    Filter();
+}
+
+LRESULT TabSearchPopup::OnGetDispInfo(LPNMHDR pnmh) {
+    auto* info = reinterpret_cast<NMLVDISPINFOW*>(pnmh);
+    LVITEMW& item = info->item;
+    if (!(item.mask & LVIF_TEXT) || item.iItem < 0 || static_cast<size_t>(item.iItem) >= m_matches.size()) {
+        return 0;
+    }
+    const TabItem* tab = m_owner.GetTab(m_matches[static_cast<size_t>(item.iItem)]);
+    m_cell = tab ? (tab->isDirty ? L"● " + tab->title : tab->title) : std::wstring();
+    item.pszText = m_cell.data();
+    return 0;
+}
+
+LRESULT TabSearchPopup::OnChoose(LPNMHDR pnmh) {
+    Choose(reinterpret_cast<NMITEMACTIVATE*>(pnmh)->iItem);
+    return 0;
+}
+
+void TabSearchPopup::Filter() {
+    const int length = m_queryEdit.GetWindowTextLength();
+    m_needle.assign(static_cast<size_t>(length) + 1, L'\0');
+    m_queryEdit.GetWindowText(m_needle.data(), length + 1);
+    m_needle.resize(static_cast<size_t>(length));
+    Fold(m_needle);
+
+    // Tab order; the active tab selected if it matches, else the first
+    m_matches.clear();
+    int selected = 0;
+    for (int index = 0; index < m_owner.GetTabCount(); ++index) {
+        m_folded = m_owner.GetTab(index)->title;
+        Fold(m_folded);
+        if (m_folded.find(m_needle) != std::wstring::npos) {
+            if (index == m_owner.GetActiveTabIndex()) {
+                selected = static_cast<int>(m_matches.size());
+            }
+            m_matches.push_back(index);
+        }
+    }
+
+    m_list.SetItemCountEx(static_cast<int>(m_matches.size()), 0);
+    if (!m_matches.empty()) {
+        m_list.SetItemState(selected, LVIS_SELECTED | LVIS_FOCUSED, LVIS_SELECTED | LVIS_FOCUSED);
+        m_list.EnsureVisible(selected, FALSE);
+    }
+    m_list.Invalidate(FALSE);
+}
+
+void TabSearchPopup::Choose(int row) {
+    if (row < 0 || static_cast<size_t>(row) >= m_matches.size()) {
+        return;
+    }
+    // Closed first: selecting the tab moves the focus on
+    const int index = m_matches[static_cast<size_t>(row)];
+    Close();
+    m_owner.SelectTab(index);
+}
+
+// ============================================================================
+// Tab Control
+// ============================================================================
+
 TabControl::TabControl() = default;
 
 TabControl::~TabControl() = default;
@@ -25,6 +208,7 @@ int TabControl::AddTab(const std::wstring& title, void* userData) {
     tab.userData = userData;
     
     m_tabs.push_back(tab);
+    m_indexById[tab.id] = static_cast<int>(m_tabs.size()) - 1;
     RecalculateLayout();
     
     // Auto-select if first tab
@@ -40,15 +224,26 @@ bool TabControl::RemoveTab(int tabId) {
     int index = FindTabIndex(tabId);
     if (index < 0) return false;
     
+    // The list's rows are tab indices
+    m_searchPopup.Close();
+    
     m_tabs.erase(m_tabs.begin() + index);
+    m_indexById.erase(tabId);
+    Reindex(index);
+    m_hoverIndex = -1;
     
-    // Adjust active index
+    // Adjust active index: a tab closed before it moves it back one, and
+    // closing it selects the next one (or the new last)
+    const bool wasActive = index == m_activeIndex;
+    if (index < m_activeIndex) {
+        --m_activeIndex;
+    }
     if (m_activeIndex >= static_cast<int>(m_tabs.size())) {
         m_activeIndex = static_cast<int>(m_tabs.size()) - 1;
     }
     
     // Update active state
-    if (m_activeIndex >= 0 && m_activeIndex < static_cast<int>(m_tabs.size())) {
+    if (wasActive && m_activeIndex >= 0) {
         m_tabs[m_activeIndex].isActive = true;
         if (m_eventCallback) {
             m_eventCallback(TabEvent::Selected, m_tabs[m_activeIndex].id);
@@ -84,12 +279,8 @@ TabItem* TabControl::GetTabById(int tabId) {
 }
 
 int TabControl::FindTabIndex(int tabId) const {
-    for (size_t i = 0; i < m_tabs.size(); ++i) {
-        if (m_tabs[i].id == tabId) {
-            return static_cast<int>(i);
-        }
-    }
-    return -1;
+    const auto found = m_indexById.find(tabId);
+    return found != m_indexById.end() ? found->second : -1;
 }
 
 void TabControl::SelectTab(int index) {
@@ -110,6 +301,7 @@ void TabControl::SelectTab(int index) {
         m_eventCallback(TabEvent::Selected, m_tabs[index].id);
     }
     
+    EnsureTabVisible(index);
     Invalidate();
 }
 
@@ -130,25 +322,55 @@ int TabControl::GetActiveTabId() const {
 }
 
 void TabControl::SetTabTitle(int tabId, const std::wstring& title) {
-    if (auto* tab = GetTabById(tabId)) {
-        tab->title = title;
-        Invalidate();
+    const int index = FindTabIndex(tabId);
+    if (index >= 0) {
+        m_tabs[index].title = title;
+        InvalidateTab(index);
     }
 }
 
 void TabControl::SetTabDirty(int tabId, bool dirty) {
-    if (auto* tab = GetTabById(tabId)) {
-        tab->isDirty = dirty;
-        Invalidate();
+    const int index = FindTabIndex(tabId);
+    if (index >= 0 && m_tabs[index].isDirty != dirty) {
+        m_tabs[index].isDirty = dirty;
+        InvalidateTab(index);
+    }
+}
+
+void TabControl::EnsureTabVisible(int index) {
+    if (index < 0 || index >= GetTabCount() || m_layoutTabWidth <= 0) {
+        return;
+    }
+    const int left = index * m_layoutTabWidth;
+    if (left < m_scrollOffset) {
+        ScrollTo(left);
+    } else if (left + m_layoutTabWidth > m_scrollOffset + m_stripRect.Width()) {
+        ScrollTo(left + m_layoutTabWidth - m_stripRect.Width());
     }
 }
 
+void TabControl::ShowTabSearch() {
+    if (!IsWindow() || m_tabs.empty()) {
+        return;
+    }
+    CRect anchor = m_searchRect.IsRectEmpty() ? m_stripRect : m_searchRect;
+    ClientToScreen(&anchor);
+    m_searchPopup.Show(anchor);
+}
+
 void TabControl::SetHeight(int height) {
     m_height = height;
     RecalculateLayout();
     Invalidate();
 }
 
+void TabControl::SetTabWidthRange(int minWidth, int maxWidth) {
+    m_minTabWidth = std::max(minWidth, 1);
+    m_tabWidth = std::max(maxWidth, m_minTabWidth);
+    RecalculateLayout();
+    Invalidate();
+}
+
 // ============================================================================
 // Message Handlers
 // ============================================================================
@@ -167,6 +389,7 @@ int TabControl::OnCreate(LPCREATESTRUCT /*lpCreateStruct*/) {
 }
 
 void TabControl::OnDestroy() {
+    m_searchPopup.Close();
     m_font.DeleteObject();
 }
 
@@ -198,12 +421,28 @@ void TabControl::OnPaint(CDCHandle /*dc*/) {
     HFONT oldFont = memDC.SelectFont(m_font);
     memDC.SetBkMode(TRANSPARENT);
     
-    for (size_t i = 0; i < m_tabs.size(); ++i) {
-        PaintTab(memDC.m_hDC, static_cast<int>(i), m_tabRects[i]);
+    // Only the tabs in view and in the update region, clipped to the strip
+    int first = 0;
+    int last = 0;
+    GetVisibleTabs(first, last);
+    const int savedDC = memDC.SaveDC();
+    memDC.IntersectClipRect(&m_stripRect);
+    for (int i = first; i < last; ++i) {
+        const CRect rect = GetTabRect(i);
+        CRect update;
+        if (update.IntersectRect(rect, &paintDc.m_ps.rcPaint)) {
+            PaintTab(memDC.m_hDC, i, rect);
+        }
     }
+    memDC.RestoreDC(savedDC);
     
-    // Draw new tab button
+    // Draw new tab button, and the scroll and search buttons if the strip scrolls
     PaintNewTabButton(memDC.m_hDC, m_newTabRect);
+    if (!m_searchRect.IsRectEmpty()) {
+        PaintStripButton(memDC.m_hDC, StripButton::ScrollLeft, L"‹");
+        PaintStripButton(memDC.m_hDC, StripButton::ScrollRight, L"›");
+        PaintStripButton(memDC.m_hDC, StripButton::Search, L"▾");
+    }
     
     memDC.SelectFont(oldFont);
     
@@ -220,23 +459,21 @@ LRESULT TabControl::OnEraseBkgnd(CDCHandle /*dc*/) {
 void TabControl::OnLButtonDown(UINT /*nFlags*/, CPoint point) {
     SetCapture();
     
-    // Check new tab button
-    if (HitTestNewTabButton(point)) {
-        m_pressedIndex = -2;  // Special value for new tab
+    // Check strip buttons (acted on when released)
+    m_pressedButton = HitTestButton(point);
+    if (m_pressedButton != StripButton::None) {
         return;
     }
     
-    // Check close buttons
-    for (size_t i = 0; i < m_tabs.size(); ++i) {
-        if (HitTestCloseButton(static_cast<int>(i), point)) {
-            m_pressedIndex = static_cast<int>(i);
-            m_hoverCloseButton = true;
-            return;
-        }
+    // Check the close button of the tab under the cursor
+    int tabIndex = HitTestTab(point);
+    if (HitTestCloseButton(tabIndex, point)) {
+        m_pressedIndex = tabIndex;
+        m_hoverCloseButton = true;
+        return;
     }
     
     // Check tab selection
-    int tabIndex = HitTestTab(point);
     if (tabIndex >= 0) {
         m_pressedIndex = tabIndex;
         m_dragStart = point;
@@ -247,10 +484,26 @@ void TabControl::OnLButtonDown(UINT /*nFlags*/, CPoint point) {
 void TabControl::OnLButtonUp(UINT /*nFlags*/, CPoint point) {
     ReleaseCapture();
     
-    // New tab button
-    if (m_pressedIndex == -2 && HitTestNewTabButton(point)) {
-        if (m_eventCallback) {
-            m_eventCallback(TabEvent::NewTab, -1);
+    // Strip buttons; the arrows scroll by a strip's width less a tab
+    if (m_pressedButton != StripButton::None && HitTestButton(point) == m_pressedButton) {
+        const int page = std::max(m_stripRect.Width() - m_layoutTabWidth, m_layoutTabWidth);
+        switch (m_pressedButton) {
+        case StripButton::NewTab:
+            if (m_eventCallback) {
+                m_eventCallback(TabEvent::NewTab, -1);
+            }
+            break;
+        case StripButton::ScrollLeft:
+            ScrollTo(m_scrollOffset - page);
+            break;
+        case StripButton::ScrollRight:
+            ScrollTo(m_scrollOffset + page);
+            break;
+        case StripButton::Search:
+            ShowTabSearch();
+            break;
+        case StripButton::None:
+            break;
         }
     }
     // Close button
@@ -269,13 +522,14 @@ void TabControl::OnLButtonUp(UINT /*nFlags*/, CPoint point) {
     }
     
     m_pressedIndex = -1;
+    m_pressedButton = StripButton::None;
     m_hoverCloseButton = false;
     Invalidate();
 }
 
 void TabControl::OnLButtonDblClk(UINT nFlags, CPoint point) {
     // Double click on empty area = new tab
-    if (HitTestTab(point) < 0 && !HitTestNewTabButton(point)) {
+    if (HitTestTab(point) < 0 && HitTestButton(point) == StripButton::None) {
         if (m_eventCallback) {
             m_eventCallback(TabEvent::NewTab, -1);
         }
@@ -314,19 +568,23 @@ void TabControl::OnMouseMove(UINT nFlags, CPoint point) {
         }
         
         if (m_isDragging) {
-            // Find new position
-            int newIndex = -1;
-            for (size_t i = 0; i < m_tabRects.size(); ++i) {
-                if (m_tabRects[i].PtInRect(point)) {
-                    newIndex = static_cast<int>(i);
-                    break;
-                }
+            // Past either end of the strip it scrolls along
+            if (point.x < m_stripRect.left) {
+                ScrollTo(m_scrollOffset - m_layoutTabWidth / 4);
+            } else if (point.x >= m_stripRect.right) {
+                ScrollTo(m_scrollOffset + m_layoutTabWidth / 4);
             }
             
+            // Find new position
+            CPoint inStrip(std::clamp(point.x, m_stripRect.left, std::max(m_stripRect.right - 1, m_stripRect.left)),
+                           m_stripRect.top);
+            int newIndex = HitTestTab(inStrip);
+            
             if (newIndex >= 0 && newIndex != m_dragIndex) {
                 // Swap tabs
                 std::swap(m_tabs[m_dragIndex], m_tabs[newIndex]);
-                std::swap(m_tabRects[m_dragIndex], m_tabRects[newIndex]);
+                m_indexById[m_tabs[m_dragIndex].id] = m_dragIndex;
+                m_indexById[m_tabs[newIndex].id] = newIndex;
                 m_dragIndex = newIndex;
                 m_activeIndex = newIndex;
                 Invalidate();
@@ -337,21 +595,22 @@ void TabControl::OnMouseMove(UINT nFlags, CPoint point) {
     
     // Update hover state
     int oldHover = m_hoverIndex;
-    m_hoverIndex = HitTestTab(point);
-    m_hoverNewTabButton = HitTestNewTabButton(point);
-    
+    StripButton oldButton = m_hoverButton;
     bool wasHoverClose = m_hoverCloseButton;
-    m_hoverCloseButton = false;
-    for (size_t i = 0; i < m_tabs.size(); ++i) {
-        if (HitTestCloseButton(static_cast<int>(i), point)) {
-            m_hoverCloseButton = true;
-            m_hoverIndex = static_cast<int>(i);
-            break;
-        }
-    }
+    m_hoverIndex = HitTestTab(point);
+    m_hoverButton = HitTestButton(point);
+    m_hoverCloseButton = HitTestCloseButton(m_hoverIndex, point);
     
+    // Repaint only what the hover left and entered
     if (oldHover != m_hoverIndex || wasHoverClose != m_hoverCloseButton) {
-        Invalidate();
+        InvalidateTab(oldHover);
+        InvalidateTab(m_hoverIndex);
+    }
+    if (oldButton != m_hoverButton) {
+        CRect rect = GetButtonRect(oldButton);
+        InvalidateRect(&rect, FALSE);
+        rect = GetButtonRect(m_hoverButton);
+        InvalidateRect(&rect, FALSE);
     }
 }
 
@@ -359,10 +618,16 @@ void TabControl::OnMouseLeave() {
     m_trackingMouse = false;
     m_hoverIndex = -1;
     m_hoverCloseButton = false;
-    m_hoverNewTabButton = false;
+    m_hoverButton = StripButton::None;
     Invalidate();
 }
 
+BOOL TabControl::OnMouseWheel(UINT /*nFlags*/, short zDelta, CPoint /*point*/) {
+    // A notch scrolls a tab's width
+    ScrollTo(m_scrollOffset - zDelta * m_layoutTabWidth / WHEEL_DELTA);
+    return TRUE;
+}
+
 // ============================================================================
 // Painting
 // ============================================================================
@@ -402,7 +667,7 @@ void TabControl::PaintTab(CDCHandle dc, int index, const CRect& rect) {
 
 void TabControl::PaintNewTabButton(CDCHandle dc, const CRect& rect) {
     // Background on hover
-    if (m_hoverNewTabButton) {
+    if (m_hoverButton == StripButton::NewTab) {
         dc.FillSolidRect(&rect, m_hoverTabColor);
     }
     
@@ -424,29 +689,45 @@ void TabControl::PaintCloseButton(CDCHandle dc, const CRect& rect, bool hover) {
     dc.DrawText(L"×", 1, const_cast<CRect*>(&rect), DT_CENTER | DT_VCENTER | DT_SINGLELINE);
 }
 
+void TabControl::PaintStripButton(CDCHandle dc, StripButton button, const wchar_t* glyph) {
+    CRect rect = GetButtonRect(button);
+    if (m_hoverButton == button) {
+        dc.FillSolidRect(&rect, m_hoverTabColor);
+    }
+    
+    dc.SetTextColor(m_textColor);
+    dc.DrawText(glyph, -1, &rect, DT_CENTER | DT_VCENTER | DT_SINGLELINE);
+}
+
 // ============================================================================
 // Hit Testing
 // ============================================================================
 
 int TabControl::HitTestTab(CPoint point) const {
-    for (size_t i = 0; i < m_tabRects.size(); ++i) {
-        if (m_tabRects[i].PtInRect(point)) {
-            return static_cast<int>(i);
-        }
+    // Tabs share one width: the column is the tab
+    if (m_layoutTabWidth <= 0 || !m_stripRect.PtInRect(point)) {
+        return -1;
     }
-    return -1;
+    const int index = (point.x - m_stripRect.left + m_scrollOffset) / m_layoutTabWidth;
+    return index < GetTabCount() ? index : -1;
 }
 
 bool TabControl::HitTestCloseButton(int tabIndex, CPoint point) const {
-    if (tabIndex < 0 || tabIndex >= static_cast<int>(m_tabs.size())) {
+    if (tabIndex < 0 || tabIndex >= static_cast<int>(m_tabs.size()) || !m_stripRect.PtInRect(point)) {
         return false;
     }
     CRect closeRect = GetCloseButtonRect(tabIndex);
     return closeRect.PtInRect(point) != FALSE;
 }
 
-bool TabControl::HitTestNewTabButton(CPoint point) const {
-    return m_newTabRect.PtInRect(point) != FALSE;
+TabControl::StripButton TabControl::HitTestButton(CPoint point) const {
+    for (StripButton button : {StripButton::NewTab, StripButton::ScrollLeft, StripButton::ScrollRight,
+                               StripButton::Search}) {
+        if (GetButtonRect(button).PtInRect(point)) {
+            return button;
+        }
+    }
+    return StripButton::None;
 }
 
 // ============================================================================
@@ -457,43 +738,68 @@ void TabControl::RecalculateLayout() {
     CRect clientRect;
     GetClientRect(&clientRect);
     
-    m_tabRects.clear();
-    m_tabRects.resize(m_tabs.size());
-    
-    // Calculate tab width
+    // Calculate tab width: the tabs share the room the new tab button
+    // leaves, within the width range
     int totalTabsWidth = clientRect.Width() - m_newTabButtonWidth;
     int tabCount = static_cast<int>(m_tabs.size());
     int tabWidth = tabCount > 0 ? std::min(m_tabWidth, totalTabsWidth / tabCount) : m_tabWidth;
     tabWidth = std::max(tabWidth, m_minTabWidth);
-    
-    // Position tabs
-    int x = 0;
-    for (size_t i = 0; i < m_tabs.size(); ++i) {
-        m_tabRects[i] = CRect(x, 0, x + tabWidth, m_height);
-        x += tabWidth;
+    m_layoutTabWidth = tabWidth;
+    
+    if (tabCount * tabWidth <= totalTabsWidth) {
+        // Everything fits: the new tab button follows the last tab
+        int x = tabCount * tabWidth;
+        m_stripRect = CRect(0, 0, x, m_height);
+        m_newTabRect = CRect(x, 0, x + m_newTabButtonWidth, m_height);
+        m_scrollLeftRect.SetRectEmpty();
+        m_scrollRightRect.SetRectEmpty();
+        m_searchRect.SetRectEmpty();
+    } else {
+        // The strip scrolls between arrows, with search and new tab at the right
+        int x = clientRect.right - m_newTabButtonWidth;
+        m_newTabRect = CRect(x, 0, clientRect.right, m_height);
+        m_searchRect = CRect(x - m_scrollButtonWidth, 0, x, m_height);
+        x -= m_scrollButtonWidth;
+        m_scrollRightRect = CRect(x - m_scrollButtonWidth, 0, x, m_height);
+        x -= m_scrollButtonWidth;
+        m_scrollLeftRect = CRect(0, 0, m_scrollButtonWidth, m_height);
+        m_stripRect = CRect(m_scrollButtonWidth, 0, std::max(x, m_scrollButtonWidth), m_height);
     }
     
-    // Position new tab button
-    m_newTabRect = CRect(x, 0, x + m_newTabButtonWidth, m_height);
+    // Keep the scroll offset in range for the new size
+    m_scrollOffset = std::clamp(m_scrollOffset, 0, std::max(tabCount * tabWidth - m_stripRect.Width(), 0));
 }
 
 CRect TabControl::GetTabRect(int index) const {
-    if (index >= 0 && index < static_cast<int>(m_tabRects.size())) {
-        return m_tabRects[index];
+    if (index < 0 || index >= static_cast<int>(m_tabs.size())) {
+        return CRect();
     }
-    return CRect();
+    int left = m_stripRect.left + index * m_layoutTabWidth - m_scrollOffset;
+    return CRect(left, 0, left + m_layoutTabWidth, m_height);
 }
 
-CRect TabControl::GetNewTabButtonRect() const {
-    return m_newTabRect;
+CRect TabControl::GetButtonRect(StripButton button) const {
+    switch (button) {
+    case StripButton::NewTab:
+        return m_newTabRect;
+    case StripButton::ScrollLeft:
+        return m_scrollLeftRect;
+    case StripButton::ScrollRight:
+        return m_scrollRightRect;
+    case StripButton::Search:
+        return m_searchRect;
+    case StripButton::None:
+        break;
+    }
+    return CRect();
 }
 
 CRect TabControl::GetCloseButtonRect(int tabIndex) const {
-    if (tabIndex < 0 || tabIndex >= static_cast<int>(m_tabRects.size())) {
+    if (tabIndex < 0 || tabIndex >= static_cast<int>(m_tabs.size())) {
         return CRect();
     }
     
-    CRect tabRect = m_tabRects[tabIndex];
+    CRect tabRect = GetTabRect(tabIndex);
     int padding = (m_height - m_closeButtonSize) / 2;
     return CRect(
         tabRect.right - m_closeButtonSize - 8,
@@ -503,4 +809,45 @@ CRect TabControl::GetCloseButtonRect(int tabIndex) const {
     );
 }
 
+void TabControl::GetVisibleTabs(int& first, int& last) const {
+    first = 0;
+    last = 0;
+    if (m_layoutTabWidth <= 0) {
+        return;
+    }
+    const int tabCount = static_cast<int>(m_tabs.size());
+    first = std::min(m_scrollOffset / m_layoutTabWidth, tabCount);
+    last = std::min((m_scrollOffset + m_stripRect.Width() + m_layoutTabWidth - 1) / m_layoutTabWidth, tabCount);
+}
+
+void TabControl::ScrollTo(int offset) {
+    const int tabCount = static_cast<int>(m_tabs.size());
+    offset = std::clamp(offset, 0, std::max(tabCount * m_layoutTabWidth - m_stripRect.Width(), 0));
+    if (offset == m_scrollOffset) {
+        return;
+    }
+    m_scrollOffset = offset;
+    
+    // The cursor is over another tab now; the next move finds which
+    m_hoverIndex = -1;
+    m_hoverCloseButton = false;
+    if (IsWindow()) {
+        InvalidateRect(&m_stripRect, FALSE);
+    }
+}
+
+void TabControl::InvalidateTab(int index) {
+    // Tabs out of view are data only
+    CRect rect;
+    if (IsWindow() && rect.IntersectRect(GetTabRect(index), m_stripRect)) {
+        InvalidateRect(&rect, FALSE);
+    }
+}
+
+void TabControl::Reindex(int from) {
+    for (int index = std::max(from, 0); index < static_cast<int>(m_tabs.size()); ++index) {
+        m_indexById[m_tabs[index].id] = index;
+    }
+}
+
 } // namespace Console3::UI
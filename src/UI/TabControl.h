@@ -4,6 +4,15 @@
 //
 // Custom-drawn tab bar with support for drag-and-drop reordering,
 // close buttons, and context menus.
+//
+// Tabs share one width, so a tab's place in the strip is arithmetic:
+// layout, hit testing and painting cost the same for three tabs or three
+// hundred, and touch only the tabs in view. Below the minimum width the
+// strip scrolls (wheel, the arrow buttons, or selecting a tab brings it
+// into view) rather than overflow. A tab out of view is data only: a new
+// title or dirty mark repaints nothing until it is scrolled in. With the
+// strip scrolling, a search button drops down a list of the tabs filtered
+// by title as you type (TabSearchPopup), to jump to any of them.
 
 #ifndef NTDDI_VERSION
 #define NTDDI_VERSION NTDDI_WIN10_RS5
@@ -25,12 +34,14 @@
 extern CAppModule _Module;
 
 #include <atlwin.h>
+#include <atlctrls.h>
 #include <atlcrack.h>
 #include <atlgdi.h>
 
 #include <functional>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace Console3::UI {
@@ -57,6 +68,74 @@ enum class TabEvent {
 /// Tab event callback
 using TabEventCallback = std::function<void(TabEvent event, int tabId)>;
 
+class TabControl;
+
+/// Drop-down list of a tab bar's tabs, filtered by title (see file comment)
+class TabSearchPopup :
+    public CWindowImpl<TabSearchPopup, CWindow, CWinTraits<WS_POPUP | WS_BORDER | WS_CLIPCHILDREN, WS_EX_TOOLWINDOW>>,
+    public CMessageFilter
+{
+public:
+    DECLARE_WND_CLASS(L"Console3TabSearchPopup")
+
+    explicit TabSearchPopup(TabControl& owner) : m_owner(owner) {}
+
+    TabSearchPopup(const TabSearchPopup&) = delete;
+    TabSearchPopup& operator=(const TabSearchPopup&) = delete;
+
+    /// List size (DIPs)
+    static constexpr int kWidth = 320;
+    static constexpr int kHeight = 360;
+    static constexpr int kQueryHeight = 24;
+
+    /// Drop the list down below a rect of the tab bar (screen coordinates)
+    /// and focus the query
+    bool Show(const CRect& anchor);
+
+    /// Close without choosing a tab
+    void Close();
+
+    // CMessageFilter
+    BOOL PreTranslateMessage(MSG* pMsg) override;
+
+    BEGIN_MSG_MAP(TabSearchPopup)
+        MSG_WM_CREATE(OnCreate)
+        MSG_WM_DESTROY(OnDestroy)
+        MSG_WM_ACTIVATE(OnActivate)
+        COMMAND_HANDLER_EX(IDC_QUERY, EN_CHANGE, OnQueryChange)
+        NOTIFY_HANDLER_EX(IDC_TABS, LVN_GETDISPINFO, OnGetDispInfo)
+        NOTIFY_HANDLER_EX(IDC_TABS, NM_CLICK, OnChoose)
+    END_MSG_MAP()
+
+    enum {
+        IDC_QUERY = 1001,
+        IDC_TABS
+    };
+
+private:
+    int OnCreate(LPCREATESTRUCT lpCreateStruct);
+    void OnDestroy();
+    void OnActivate(UINT nState, BOOL bMinimized, CWindow wndOther);
+    void OnQueryChange(UINT uNotifyCode, int nID, CWindow wndCtl);
+    LRESULT OnGetDispInfo(LPNMHDR pnmh);
+    LRESULT OnChoose(LPNMHDR pnmh);
+
+    /// List the tabs whose titles contain the query, the active one selected
+    void Filter();
+
+    /// Select the tab of a list row and close
+    void Choose(int row);
+
+    TabControl& m_owner;
+    std::vector<int> m_matches;     ///< Tab indices of the list rows
+    std::wstring m_needle;          ///< Query, lowercased
+    std::wstring m_folded;          ///< Scratch for Filter()
+    std::wstring m_cell;            ///< Text handed out by OnGetDispInfo()
+    CEdit m_queryEdit;
+    CListViewCtrl m_list;
+    CFont m_font;
+};
+
 /// Custom-drawn tab bar control
 class TabControl : public CWindowImpl<TabControl> {
 public:
@@ -113,6 +192,12 @@ public:
     /// Set tab dirty state
     void SetTabDirty(int tabId, bool dirty);
 
+    /// Scroll the strip so a tab is in full view
+    void EnsureTabVisible(int index);
+
+    /// Drop down the tab search list (see TabSearchPopup)
+    void ShowTabSearch();
+
     // ========================================================================
     // Appearance
     // ========================================================================
@@ -120,6 +205,10 @@ public:
     /// Set tab bar height
     void SetHeight(int height);
 
+    /// Set the range tab widths are kept in (TabSettings::tabWidthMin/Max);
+    /// tabs that would be narrower scroll instead
+    void SetTabWidthRange(int minWidth, int maxWidth);
+
     /// Get tab bar height
     [[nodiscard]] int GetHeight() const { return m_height; }
 
@@ -142,9 +231,19 @@ public:
         MSG_WM_RBUTTONDOWN(OnRButtonDown)
         MSG_WM_MOUSEMOVE(OnMouseMove)
         MSG_WM_MOUSELEAVE(OnMouseLeave)
+        MSG_WM_MOUSEWHEEL(OnMouseWheel)
     END_MSG_MAP()
 
 private:
+    /// Buttons of the strip besides the tabs
+    enum class StripButton {
+        None,
+        NewTab,
+        ScrollLeft,             ///< Only while the strip scrolls
+        ScrollRight,
+        Search,
+    };
+
     // Message handlers
     int OnCreate(LPCREATESTRUCT lpCreateStruct);
     void OnDestroy();
@@ -157,26 +256,41 @@ private:
     void OnRButtonDown(UINT nFlags, CPoint point);
     void OnMouseMove(UINT nFlags, CPoint point);
     void OnMouseLeave();
+    BOOL OnMouseWheel(UINT nFlags, short zDelta, CPoint point);
 
     // Painting
     void PaintTab(CDCHandle dc, int index, const CRect& rect);
     void PaintNewTabButton(CDCHandle dc, const CRect& rect);
     void PaintCloseButton(CDCHandle dc, const CRect& rect, bool hover);
+    void PaintStripButton(CDCHandle dc, StripButton button, const wchar_t* glyph);
 
     // Hit testing
     int HitTestTab(CPoint point) const;
     bool HitTestCloseButton(int tabIndex, CPoint point) const;
-    bool HitTestNewTabButton(CPoint point) const;
+    StripButton HitTestButton(CPoint point) const;
 
     // Layout
     void RecalculateLayout();
     CRect GetTabRect(int index) const;
-    CRect GetNewTabButtonRect() const;
+    CRect GetButtonRect(StripButton button) const;
     CRect GetCloseButtonRect(int tabIndex) const;
 
+    /// Get the tabs at least partly in view [first, last)
+    void GetVisibleTabs(int& first, int& last) const;
+
+    /// Scroll the strip to an offset (clamped)
+    void ScrollTo(int offset);
+
+    /// Repaint a tab if it is in view
+    void InvalidateTab(int index);
+
+    /// Bring m_indexById up to date for the tabs from an index on
+    void Reindex(int from);
+
 private:
     // Tab data
     std::vector<TabItem> m_tabs;
+    std::unordered_map<int, int> m_indexById;   ///< Tab ID to index in m_tabs
     int m_nextTabId = 1;
     int m_activeIndex = -1;
 
@@ -188,15 +302,22 @@ private:
     int m_tabWidth = 200;
     int m_minTabWidth = 100;
     int m_newTabButtonWidth = 32;
+    int m_scrollButtonWidth = 20;
     int m_closeButtonSize = 16;
-    std::vector<CRect> m_tabRects;
+    int m_layoutTabWidth = 0;       ///< Width every tab has now
+    CRect m_stripRect;              ///< Where tabs are drawn
     CRect m_newTabRect;
+    CRect m_scrollLeftRect;         ///< Empty unless the strip scrolls
+    CRect m_scrollRightRect;
+    CRect m_searchRect;
+    int m_scrollOffset = 0;         ///< Strip pixels scrolled out on the left
 
     // Interaction state
     int m_hoverIndex = -1;
     int m_pressedIndex = -1;
+    StripButton m_pressedButton = StripButton::None;
+    StripButton m_hoverButton = StripButton::None;
     bool m_hoverCloseButton = false;
-    bool m_hoverNewTabButton = false;
     bool m_isDragging = false;
     int m_dragIndex = -1;
     CPoint m_dragStart;
@@ -213,6 +334,8 @@ private:
 
     // Font
     CFont m_font;
+
+    TabSearchPopup m_searchPopup{*this};
 };
 
 } // namespace Console3::UI
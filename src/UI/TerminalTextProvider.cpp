@@ -0,0 +1,871 @@
+// Console3 - TerminalTextProvider.cpp
+// UI Automation text pattern for a terminal view
+
+#include "UI/TerminalTextProvider.h"
+#include "UI/TerminalView.h"
+#include <algorithm>
+#include <cmath>
+
+using Microsoft::WRL::ComPtr;
+using Microsoft::WRL::Make;
+using Microsoft::WRL::RuntimeClass;
+using Microsoft::WRL::RuntimeClassFlags;
+using Microsoft::WRL::ClassicCom;
+
+namespace Console3::UI {
+
+namespace {
+
+/// Fold the units the document has no notion of into the nearest it has:
+/// attribute runs into words, paragraphs into lines, pages into the screen
+[[nodiscard]] TextUnit NormalizeUnit(TextUnit unit) noexcept {
+    switch (unit) {
+    case TextUnit_Format:
+        return TextUnit_Word;
+    case TextUnit_Paragraph:
+        return TextUnit_Line;
+    case TextUnit_Page:
+        return TextUnit_Document;
+    default:
+        return unit;
+    }
+}
+
+/// A range of the document: two points, good as long as their lines are
+/// (see file comment)
+class TextRange : public RuntimeClass<RuntimeClassFlags<ClassicCom>, ITextRangeProvider> {
+public:
+    TextRange(ComPtr<TerminalTextProvider> provider, TextPoint start, TextPoint end)
+        : m_provider(std::move(provider)), m_start(start), m_end(end) {}
+
+    STDMETHOD(Clone)(ITextRangeProvider** clone) override;
+    STDMETHOD(Compare)(ITextRangeProvider* range, BOOL* equal) override;
+    STDMETHOD(CompareEndpoints)(TextPatternRangeEndpoint endpoint, ITextRangeProvider* target,
+                                TextPatternRangeEndpoint targetEndpoint, int* result) override;
+    STDMETHOD(ExpandToEnclosingUnit)(TextUnit unit) override;
+    STDMETHOD(FindAttribute)(TEXTATTRIBUTEID attributeId, VARIANT value, BOOL backward,
+                             ITextRangeProvider** found) override;
+    STDMETHOD(FindText)(BSTR text, BOOL backward, BOOL ignoreCase, ITextRangeProvider** found) override;
+    STDMETHOD(GetAttributeValue)(TEXTATTRIBUTEID attributeId, VARIANT* value) override;
+    STDMETHOD(GetBoundingRectangles)(SAFEARRAY** rectangles) override;
+    STDMETHOD(GetEnclosingElement)(IRawElementProviderSimple** element) override;
+    STDMETHOD(GetText)(int maxLength, BSTR* text) override;
+    STDMETHOD(Move)(TextUnit unit, int count, int* moved) override;
+    STDMETHOD(MoveEndpointByUnit)(TextPatternRangeEndpoint endpoint, TextUnit unit, int count,
+                                  int* moved) override;
+    STDMETHOD(MoveEndpointByRange)(TextPatternRangeEndpoint endpoint, ITextRangeProvider* target,
+                                   TextPatternRangeEndpoint targetEndpoint) override;
+    STDMETHOD(Select)() override;
+    STDMETHOD(AddToSelection)() override;
+    STDMETHOD(RemoveFromSelection)() override;
+    STDMETHOD(ScrollIntoView)(BOOL alignToTop) override;
+    STDMETHOD(GetChildren)(SAFEARRAY** children) override;
+
+private:
+    /// Get one of a range's endpoints (nullptr if it is not one of ours)
+    [[nodiscard]] static const TextPoint* GetEndpoint(ITextRangeProvider* range,
+                                                      TextPatternRangeEndpoint endpoint) noexcept {
+        const auto* other = dynamic_cast<TextRange*>(range);
+        if (!other) {
+            return nullptr;
+        }
+        return endpoint == TextPatternRangeEndpoint_Start ? &other->m_start : &other->m_end;
+    }
+
+    /// Bring both endpoints into the document
+    void ClampEndpoints() {
+        m_start = m_provider->Clamp(m_start);
+        m_end = std::max(m_start, m_provider->Clamp(m_end));
+    }
+
+    ComPtr<TerminalTextProvider> m_provider;
+    TextPoint m_start;
+    TextPoint m_end;
+};
+
+STDMETHODIMP TextRange::Clone(ITextRangeProvider** clone) {
+    if (!clone) {
+        return E_POINTER;
+    }
+    *clone = nullptr;
+    RenderLock::Scope lock(RenderLock::Shared());
+    if (!m_provider->IsConnected()) {
+        return UIA_E_ELEMENTNOTAVAILABLE;
+    }
+    return m_provider->MakeRange(m_start, m_end, clone);
+}
+
+STDMETHODIMP TextRange::Compare(ITextRangeProvider* range, BOOL* equal) {
+    if (!equal) {
+        return E_POINTER;
+    }
+    const TextPoint* start = GetEndpoint(range, TextPatternRangeEndpoint_Start);
+    const TextPoint* end = GetEndpoint(range, TextPatternRangeEndpoint_End);
+    if (!start || !end) {
+        return E_INVALIDARG;
+    }
+    RenderLock::Scope lock(RenderLock::Shared());
+    *equal = *start == m_start && *end == m_end;
+    return S_OK;
+}
+
+STDMETHODIMP TextRange::CompareEndpoints(TextPatternRangeEndpoint endpoint, ITextRangeProvider* target,
+                                         TextPatternRangeEndpoint targetEndpoint, int* result) {
+    if (!result) {
+        return E_POINTER;
+    }
+    const TextPoint* other = GetEndpoint(target, targetEndpoint);
+    if (!other) {
+        return E_INVALIDARG;
+    }
+    RenderLock::Scope lock(RenderLock::Shared());
+    const TextPoint point = endpoint == TextPatternRangeEndpoint_Start ? m_start : m_end;
+    *result = point < *other ? -1 : point > *other ? 1 : 0;
+    return S_OK;
+}
+
+STDMETHODIMP TextRange::ExpandToEnclosingUnit(TextUnit unit) {
+    RenderLock::Scope lock(RenderLock::Shared());
+    if (!m_provider->IsConnected()) {
+        return UIA_E_ELEMENTNOTAVAILABLE;
+    }
+    ClampEndpoints();
+    m_start = m_provider->UnitStart(m_start, unit);
+    m_end = m_provider->NextUnitStart(m_start, unit);
+    return S_OK;
+}
+
+STDMETHODIMP TextRange::FindAttribute(TEXTATTRIBUTEID /*attributeId*/, VARIANT /*value*/, BOOL /*backward*/,
+                                      ITextRangeProvider** found) {
+    // Only IsReadOnly is reported, and it holds for all the text
+    if (!found) {
+        return E_POINTER;
+    }
+    *found = nullptr;
+    return S_OK;
+}
+
+STDMETHODIMP TextRange::FindText(BSTR text, BOOL backward, BOOL ignoreCase, ITextRangeProvider** found) {
+    if (!found) {
+        return E_POINTER;
+    }
+    *found = nullptr;
+    const UINT length = SysStringLen(text);
+    if (length == 0) {
+        return E_INVALIDARG;
+    }
+    RenderLock::Scope lock(RenderLock::Shared());
+    if (!m_provider->IsConnected()) {
+        return UIA_E_ELEMENTNOTAVAILABLE;
+    }
+
+    ClampEndpoints();
+    std::wstring haystack;
+    std::vector<TextPoint> points;
+    m_provider->AppendText(m_start, m_end, haystack, &points);
+    std::wstring needle(text, length);
+    if (ignoreCase) {
+        CharLowerBuffW(haystack.data(), static_cast<DWORD>(haystack.size()));
+        CharLowerBuffW(needle.data(), static_cast<DWORD>(needle.size()));
+    }
+
+    const size_t at = backward ? haystack.rfind(needle) : haystack.find(needle);
+    if (at == std::wstring::npos) {
+        return S_OK;
+    }
+    const size_t after = at + needle.size();
+    return m_provider->MakeRange(points[at], after < points.size() ? points[after] : m_end, found);
+}
+
+STDMETHODIMP TextRange::GetAttributeValue(TEXTATTRIBUTEID attributeId, VARIANT* value) {
+    if (!value) {
+        return E_POINTER;
+    }
+    VariantInit(value);
+    if (attributeId == UIA_IsReadOnlyAttributeId) {
+        value->vt = VT_BOOL;
+        value->boolVal = VARIANT_TRUE;
+        return S_OK;
+    }
+    value->vt = VT_UNKNOWN;
+    return UiaGetReservedNotSupportedValue(&value->punkVal);
+}
+
+STDMETHODIMP TextRange::GetBoundingRectangles(SAFEARRAY** rectangles) {
+    if (!rectangles) {
+        return E_POINTER;
+    }
+    *rectangles = nullptr;
+    RenderLock::Scope lock(RenderLock::Shared());
+    if (!m_provider->IsConnected()) {
+        return UIA_E_ELEMENTNOTAVAILABLE;
+    }
+
+    // Left, top, width, height per line on screen; a degenerate range is
+    // the caret, one zero-width rectangle
+    ClampEndpoints();
+    std::vector<double> bounds;
+    const int cols = m_provider->GetEnd().col;
+    for (int64_t line = m_start.line; line <= m_end.line; ++line) {
+        const int startCol = line == m_start.line ? m_start.col : 0;
+        const int endCol = line == m_end.line ? m_end.col : cols;
+        RECT rect{};
+        if ((startCol < endCol || m_start == m_end) && m_provider->GetLineBounds(line, startCol, endCol, rect)) {
+            bounds.insert(bounds.end(), {static_cast<double>(rect.left), static_cast<double>(rect.top),
+                                         static_cast<double>(rect.right - rect.left),
+                                         static_cast<double>(rect.bottom - rect.top)});
+        }
+    }
+
+    SAFEARRAY* array = SafeArrayCreateVector(VT_R8, 0, static_cast<ULONG>(bounds.size()));
+    if (!array) {
+        return E_OUTOFMEMORY;
+    }
+    if (!bounds.empty()) {
+        void* data = nullptr;
+        if (FAILED(SafeArrayAccessData(array, &data))) {
+            SafeArrayDestroy(array);
+            return E_FAIL;
+        }
+        std::copy(bounds.begin(), bounds.end(), static_cast<double*>(data));
+        SafeArrayUnaccessData(array);
+    }
+    *rectangles = array;
+    return S_OK;
+}
+
+STDMETHODIMP TextRange::GetEnclosingElement(IRawElementProviderSimple** element) {
+    if (!element) {
+        return E_POINTER;
+    }
+    return m_provider.CopyTo(element);
+}
+
+STDMETHODIMP TextRange::GetText(int maxLength, BSTR* text) {
+    if (!text) {
+        return E_POINTER;
+    }
+    *text = nullptr;
+    RenderLock::Scope lock(RenderLock::Shared());
+    if (!m_provider->IsConnected()) {
+        return UIA_E_ELEMENTNOTAVAILABLE;
+    }
+
+    ClampEndpoints();
+    std::wstring content;
+    m_provider->AppendText(m_start, m_end, content, nullptr);
+    if (maxLength >= 0 && content.size() > static_cast<size_t>(maxLength)) {
+        content.resize(static_cast<size_t>(maxLength));
+    }
+    *text = SysAllocStringLen(content.data(), static_cast<UINT>(content.size()));
+    return *text ? S_OK : E_OUTOFMEMORY;
+}
+
+STDMETHODIMP TextRange::Move(TextUnit unit, int count, int* moved) {
+    if (!moved) {
+        return E_POINTER;
+    }
+    *moved = 0;
+    RenderLock::Scope lock(RenderLock::Shared());
+    if (!m_provider->IsConnected()) {
+        return UIA_E_ELEMENTNOTAVAILABLE;
+    }
+    if (count == 0) {
+        return S_OK;
+    }
+
+    // A degenerate range moves as a point; any other moves from the start
+    // of its first unit and then covers the unit it lands on
+    ClampEndpoints();
+    const bool degenerate = m_start == m_end;
+    TextPoint point = degenerate ? m_start : m_provider->UnitStart(m_start, unit);
+    *moved = m_provider->MoveByUnits(point, unit, count);
+    m_start = point;
+    m_end = degenerate ? point : m_provider->NextUnitStart(point, unit);
+    return S_OK;
+}
+
+STDMETHODIMP TextRange::MoveEndpointByUnit(TextPatternRangeEndpoint endpoint, TextUnit unit, int count,
+                                           int* moved) {
+    if (!moved) {
+        return E_POINTER;
+    }
+    *moved = 0;
+    RenderLock::Scope lock(RenderLock::Shared());
+    if (!m_provider->IsConnected()) {
+        return UIA_E_ELEMENTNOTAVAILABLE;
+    }
+
+    // An endpoint moved past the other drags it along
+    ClampEndpoints();
+    if (endpoint == TextPatternRangeEndpoint_Start) {
+        *moved = m_provider->MoveByUnits(m_start, unit, count);
+        m_end = std::max(m_end, m_start);
+    } else {
+        *moved = m_provider->MoveByUnits(m_end, unit, count);
+        m_start = std::min(m_start, m_end);
+    }
+    return S_OK;
+}
+
+STDMETHODIMP TextRange::MoveEndpointByRange(TextPatternRangeEndpoint endpoint, ITextRangeProvider* target,
+                                            TextPatternRangeEndpoint targetEndpoint) {
+    const TextPoint* other = GetEndpoint(target, targetEndpoint);
+    if (!other) {
+        return E_INVALIDARG;
+    }
+    RenderLock::Scope lock(RenderLock::Shared());
+    if (endpoint == TextPatternRangeEndpoint_Start) {
+        m_start = *other;
+        m_end = std::max(m_end, m_start);
+    } else {
+        m_end = *other;
+        m_start = std::min(m_start, m_end);
+    }
+    return S_OK;
+}
+
+STDMETHODIMP TextRange::Select() {
+    RenderLock::Scope lock(RenderLock::Shared());
+    if (!m_provider->IsConnected()) {
+        return UIA_E_ELEMENTNOTAVAILABLE;
+    }
+    ClampEndpoints();
+    m_provider->Select(m_start, m_end);
+    return S_OK;
+}
+
+STDMETHODIMP TextRange::AddToSelection() {
+    // One selection at a time (SupportedTextSelection_Single)
+    return UIA_E_INVALIDOPERATION;
+}
+
+STDMETHODIMP TextRange::RemoveFromSelection() {
+    return UIA_E_INVALIDOPERATION;
+}
+
+STDMETHODIMP TextRange::ScrollIntoView(BOOL /*alignToTop*/) {
+    RenderLock::Scope lock(RenderLock::Shared());
+    if (!m_provider->IsConnected()) {
+        return UIA_E_ELEMENTNOTAVAILABLE;
+    }
+    m_provider->ScrollIntoView();
+    return S_OK;
+}
+
+STDMETHODIMP TextRange::GetChildren(SAFEARRAY** children) {
+    if (!children) {
+        return E_POINTER;
+    }
+    *children = SafeArrayCreateVector(VT_UNKNOWN, 0, 0);
+    return *children ? S_OK : E_OUTOFMEMORY;
+}
+
+} // namespace
+
+// ============================================================================
+// Provider
+// ============================================================================
+
+TerminalTextProvider::TerminalTextProvider(TerminalView* view)
+    : m_view(view), m_hwnd(view->m_hWnd) {}
+
+void TerminalTextProvider::Disconnect() noexcept {
+    m_view = nullptr;
+    m_rows.clear();
+    m_rowsBuffer = nullptr;
+}
+
+STDMETHODIMP TerminalTextProvider::get_ProviderOptions(ProviderOptions* options) {
+    if (!options) {
+        return E_POINTER;
+    }
+    // Not ProviderOptions_UseComThreading: calls stay on UI Automation's
+    // threads and take the render lock, rather than queue for the window's
+    *options = ProviderOptions_ServerSideProvider;
+    return S_OK;
+}
+
+STDMETHODIMP TerminalTextProvider::GetPatternProvider(PATTERNID patternId, IUnknown** pattern) {
+    if (!pattern) {
+        return E_POINTER;
+    }
+    *pattern = nullptr;
+    if (patternId == UIA_TextPatternId) {
+        *pattern = static_cast<ITextProvider*>(this);
+        AddRef();
+    }
+    return S_OK;
+}
+
+STDMETHODIMP TerminalTextProvider::GetPropertyValue(PROPERTYID propertyId, VARIANT* value) {
+    if (!value) {
+        return E_POINTER;
+    }
+    VariantInit(value);
+    RenderLock::Scope lock(RenderLock::Shared());
+    if (!IsConnected()) {
+        return UIA_E_ELEMENTNOTAVAILABLE;
+    }
+
+    // Anything not set here comes from the host window's provider
+    switch (propertyId) {
+    case UIA_ControlTypePropertyId:
+        value->vt = VT_I4;
+        value->lVal = UIA_DocumentControlTypeId;
+        break;
+    case UIA_NamePropertyId:
+        value->vt = VT_BSTR;
+        value->bstrVal = SysAllocString(L"Terminal");
+        break;
+    case UIA_AutomationIdPropertyId:
+        value->vt = VT_BSTR;
+        value->bstrVal = SysAllocString(L"Console3Terminal");
+        break;
+    case UIA_IsKeyboardFocusablePropertyId:
+    case UIA_IsTextPatternAvailablePropertyId:
+        value->vt = VT_BOOL;
+        value->boolVal = VARIANT_TRUE;
+        break;
+    case UIA_HasKeyboardFocusPropertyId:
+        value->vt = VT_BOOL;
+        value->boolVal = m_view->m_hasFocus ? VARIANT_TRUE : VARIANT_FALSE;
+        break;
+    default:
+        break;
+    }
+    return S_OK;
+}
+
+STDMETHODIMP TerminalTextProvider::get_HostRawElementProvider(IRawElementProviderSimple** provider) {
+    if (!provider) {
+        return E_POINTER;
+    }
+    return UiaHostProviderFromHwnd(m_hwnd, provider);
+}
+
+STDMETHODIMP TerminalTextProvider::GetSelection(SAFEARRAY** ranges) {
+    if (!ranges) {
+        return E_POINTER;
+    }
+    *ranges = nullptr;
+    RenderLock::Scope lock(RenderLock::Shared());
+    if (!IsConnected()) {
+        return UIA_E_ELEMENTNOTAVAILABLE;
+    }
+
+    // The view's selection, or the caret: a degenerate range at the cursor
+    const Selection& selection = m_view->m_selection;
+    if (m_view->m_buffer && selection.active && !selection.block &&
+        selection.epoch == m_view->m_buffer->GetScrollbackEpoch()) {
+        Selection normal = selection;
+        normal.Normalize();
+        return MakeRangeArray(Clamp({normal.startLine, normal.startCol}), Clamp({normal.endLine, normal.endCol}),
+                              ranges);
+    }
+    TextPoint caret = GetStart();
+    if (m_view->m_buffer && m_view->m_vterm) {
+        int row = 0;
+        int col = 0;
+        m_view->GetShownCursor(row, col);
+        caret = Clamp({static_cast<int64_t>(m_view->m_buffer->GetScreenLine()) + row, col});
+    }
+    return MakeRangeArray(caret, caret, ranges);
+}
+
+STDMETHODIMP TerminalTextProvider::GetVisibleRanges(SAFEARRAY** ranges) {
+    if (!ranges) {
+        return E_POINTER;
+    }
+    *ranges = nullptr;
+    RenderLock::Scope lock(RenderLock::Shared());
+    if (!IsConnected()) {
+        return UIA_E_ELEMENTNOTAVAILABLE;
+    }
+
+    // The screen's lines still in view; none while scrolled past them all
+    TextPoint start = GetStart();
+    const TextPoint end = GetEnd();
+    if (m_view->m_buffer && m_view->m_renderer && m_view->m_scrollPixels > 0.0f) {
+        const D2D1_RECT_F area = m_view->GetPaneRect();
+        start = Clamp({m_view->PixelToLine(static_cast<int>(area.top)), 0});
+        if (m_view->PixelToLine(std::max(static_cast<int>(area.bottom) - 1, 0)) < start.line) {
+            start = end;
+        }
+    }
+    return MakeRangeArray(start, end, ranges);
+}
+
+STDMETHODIMP TerminalTextProvider::RangeFromChild(IRawElementProviderSimple* /*child*/,
+                                                  ITextRangeProvider** range) {
+    // The document has no embedded objects
+    if (!range) {
+        return E_POINTER;
+    }
+    *range = nullptr;
+    return E_INVALIDARG;
+}
+
+STDMETHODIMP TerminalTextProvider::RangeFromPoint(UiaPoint point, ITextRangeProvider** range) {
+    if (!range) {
+        return E_POINTER;
+    }
+    *range = nullptr;
+    RenderLock::Scope lock(RenderLock::Shared());
+    if (!IsConnected()) {
+        return UIA_E_ELEMENTNOTAVAILABLE;
+    }
+
+    TextPoint at = GetStart();
+    if (m_view->m_buffer && m_view->m_renderer) {
+        POINT client{static_cast<LONG>(std::lround(point.x)), static_cast<LONG>(std::lround(point.y))};
+        ScreenToClient(m_hwnd, &client);
+        at = Clamp({m_view->PixelToLine(client.y), m_view->PixelToCol(client.x)});
+    }
+    return MakeRange(at, at, range);
+}
+
+STDMETHODIMP TerminalTextProvider::get_DocumentRange(ITextRangeProvider** range) {
+    if (!range) {
+        return E_POINTER;
+    }
+    *range = nullptr;
+    RenderLock::Scope lock(RenderLock::Shared());
+    if (!IsConnected()) {
+        return UIA_E_ELEMENTNOTAVAILABLE;
+    }
+    return MakeRange(GetStart(), GetEnd(), range);
+}
+
+STDMETHODIMP TerminalTextProvider::get_SupportedTextSelection(SupportedTextSelection* selection) {
+    if (!selection) {
+        return E_POINTER;
+    }
+    *selection = SupportedTextSelection_Single;
+    return S_OK;
+}
+
+// ============================================================================
+// Document
+// ============================================================================
+
+TextPoint TerminalTextProvider::GetStart() const {
+    const Core::TerminalBuffer* buffer = m_view ? m_view->m_buffer : nullptr;
+    if (!buffer) {
+        return {};
+    }
+    return {static_cast<int64_t>(buffer->GetScreenLine()), 0};
+}
+
+TextPoint TerminalTextProvider::GetEnd() const {
+    const Core::TerminalBuffer* buffer = m_view ? m_view->m_buffer : nullptr;
+    if (!buffer) {
+        return {};
+    }
+    return {static_cast<int64_t>(buffer->GetScreenLine()) + buffer->GetRows() - 1, buffer->GetCols()};
+}
+
+TextPoint TerminalTextProvider::Clamp(TextPoint point) const {
+    const TextPoint start = GetStart();
+    const TextPoint end = GetEnd();
+    if (point < start) {
+        return start;
+    }
+    if (point > end) {
+        return end;
+    }
+    point.col = std::clamp(point.col, 0, end.col);
+    return point;
+}
+
+const Core::Cell* TerminalTextProvider::CellAt(TextPoint point) const {
+    const Core::TerminalBuffer* buffer = m_view ? m_view->m_buffer : nullptr;
+    if (!buffer) {
+        return nullptr;
+    }
+    const int64_t row = point.line - static_cast<int64_t>(buffer->GetScreenLine());
+    if (row < 0 || row >= buffer->GetRows() || point.col < 0 || point.col >= buffer->GetCols()) {
+        return nullptr;
+    }
+    return &buffer->GetRow(static_cast<int>(row))[static_cast<size_t>(point.col)];
+}
+
+TextPoint TerminalTextProvider::NextChar(TextPoint point) const {
+    const TextPoint end = GetEnd();
+    point = Clamp(point);
+    if (point >= end) {
+        return end;
+    }
+    if (point.col >= end.col) {
+        return {point.line + 1, 0};
+    }
+    ++point.col;
+    while (point.col < end.col && CellAt(point)->width == 0) {
+        ++point.col;
+    }
+    return point;
+}
+
+TextPoint TerminalTextProvider::PrevChar(TextPoint point) const {
+    const TextPoint start = GetStart();
+    point = Clamp(point);
+    if (point <= start) {
+        return start;
+    }
+    if (point.col == 0) {
+        return {point.line - 1, GetEnd().col};
+    }
+    --point.col;
+    while (point.col > 0 && CellAt(point)->width == 0) {
+        --point.col;
+    }
+    return point;
+}
+
+bool TerminalTextProvider::IsBlank(TextPoint point) const {
+    const Core::Cell* cell = CellAt(point);
+    return !cell || (!cell->grapheme && (cell->code == U' ' || cell->code == 0));
+}
+
+bool TerminalTextProvider::IsWordStart(TextPoint point) const {
+    if (point.col == 0) {
+        return true;
+    }
+    return !IsBlank(point) && IsBlank(PrevChar(point));
+}
+
+TextPoint TerminalTextProvider::UnitStart(TextPoint point, TextUnit unit) const {
+    point = Clamp(point);
+    switch (NormalizeUnit(unit)) {
+    case TextUnit_Character:
+        // Onto the wide character a continuation cell belongs to
+        if (const Core::Cell* cell = CellAt(point); cell && cell->width == 0) {
+            return PrevChar(point);
+        }
+        return point;
+    case TextUnit_Word:
+        while (!IsWordStart(point)) {
+            point = PrevChar(point);
+        }
+        return point;
+    case TextUnit_Line:
+        return {point.line, 0};
+    default:
+        return GetStart();
+    }
+}
+
+TextPoint TerminalTextProvider::NextUnitStart(TextPoint point, TextUnit unit) const {
+    const TextPoint end = GetEnd();
+    point = Clamp(point);
+    switch (NormalizeUnit(unit)) {
+    case TextUnit_Character:
+        return NextChar(point);
+    case TextUnit_Word:
+        do {
+            point = NextChar(point);
+        } while (point < end && !IsWordStart(point));
+        return point;
+    case TextUnit_Line:
+        return point.line < end.line ? TextPoint{point.line + 1, 0} : end;
+    default:
+        return end;
+    }
+}
+
+int TerminalTextProvider::MoveByUnits(TextPoint& point, TextUnit unit, int count) const {
+    // Forward to the start of the next unit, backward to the start of this
+    // one (or the one before, from its start)
+    int moved = 0;
+    point = Clamp(point);
+    for (; moved < count; ++moved) {
+        const TextPoint next = NextUnitStart(point, unit);
+        if (next == point) {
+            break;
+        }
+        point = next;
+    }
+    for (; moved > count; --moved) {
+        const TextPoint start = GetStart();
+        if (point == start) {
+            break;
+        }
+        const TextPoint here = UnitStart(point, unit);
+        point = here < point ? here : UnitStart(PrevChar(point), unit);
+    }
+    return moved;
+}
+
+const TerminalTextProvider::RowText* TerminalTextProvider::GetRowText(int64_t line) {
+    const Core::TerminalBuffer* buffer = m_view ? m_view->m_buffer : nullptr;
+    if (!buffer) {
+        return nullptr;
+    }
+    const int64_t row = line - static_cast<int64_t>(buffer->GetScreenLine());
+    if (row < 0 || row >= buffer->GetRows()) {
+        return nullptr;
+    }
+
+    // Generations are per buffer; a cache grown to two screens was mostly
+    // text scrolled away, and starts over
+    if (m_rowsBuffer != buffer) {
+        m_rows.clear();
+        m_rowsBuffer = buffer;
+    }
+    const uint64_t generation = buffer->GetRowGeneration(static_cast<int>(row));
+    if (const auto it = m_rows.find(generation); it != m_rows.end()) {
+        return &it->second;
+    }
+    if (m_rows.size() > static_cast<size_t>(buffer->GetRows()) * 2 + 8) {
+        m_rows.clear();
+    }
+
+    RowText& text = m_rows[generation];
+    const std::span<const Core::Cell> cells = buffer->GetRow(static_cast<int>(row));
+    const int cols = static_cast<int>(cells.size());
+    text.offsets.reserve(static_cast<size_t>(cols) + 1);
+    for (int col = 0; col < cols; ++col) {
+        text.offsets.push_back(static_cast<uint32_t>(text.text.size()));
+        if (cells[static_cast<size_t>(col)].width != 0) {
+            Core::TerminalBuffer::AppendColumnText(text.text, cells, col, col + 1, false);
+        }
+    }
+    text.offsets.push_back(static_cast<uint32_t>(text.text.size()));
+    return &text;
+}
+
+void TerminalTextProvider::AppendText(TextPoint start, TextPoint end, std::wstring& text,
+                                      std::vector<TextPoint>* points) {
+    start = Clamp(start);
+    end = Clamp(end);
+    const int cols = GetEnd().col;
+    for (int64_t line = start.line; line <= end.line; ++line) {
+        const RowText* row = GetRowText(line);
+        if (!row) {
+            break;
+        }
+        const int startCol = line == start.line ? start.col : 0;
+        const int endCol = line == end.line ? end.col : cols;
+        if (startCol < endCol) {
+            // Blanks running to the line's end are not text
+            const uint32_t first = row->offsets[static_cast<size_t>(startCol)];
+            uint32_t last = row->offsets[static_cast<size_t>(endCol)];
+            if (endCol == cols) {
+                while (last > first && row->text[last - 1] == L' ') {
+                    --last;
+                }
+            }
+            text.append(row->text, first, last - first);
+            if (points) {
+                for (int col = startCol; col < endCol; ++col) {
+                    const uint32_t from = row->offsets[static_cast<size_t>(col)];
+                    const uint32_t to = std::min(row->offsets[static_cast<size_t>(col) + 1], last);
+                    for (uint32_t unit = from; unit < to; ++unit) {
+                        points->push_back({line, col});
+                    }
+                }
+            }
+        }
+        if (line < end.line) {
+            text.push_back(L'\n');
+            if (points) {
+                points->push_back({line, cols});
+            }
+        }
+    }
+}
+
+bool TerminalTextProvider::GetLineBounds(int64_t line, int startCol, int endCol, RECT& bounds) const {
+    const Core::TerminalBuffer* buffer = m_view ? m_view->m_buffer : nullptr;
+    if (!buffer || !m_view->m_renderer) {
+        return false;
+    }
+    const int64_t row = line - static_cast<int64_t>(buffer->GetScreenLine());
+    if (row < 0 || row >= buffer->GetRows()) {
+        return false;
+    }
+
+    // Scrolled back, the screen is drawn below the history in view
+    float top = m_view->RowToPixel(static_cast<int>(row));
+    if (m_view->m_scrollPixels > 0.0f) {
+        top += m_view->GetScrollOffset();
+    }
+    const float bottom = top + m_view->m_renderer->GetCellHeight();
+    const D2D1_RECT_F area = m_view->GetPaneRect();
+    if (bottom <= area.top || top >= area.bottom) {
+        return false;
+    }
+
+    POINT topLeft{static_cast<LONG>(std::lround(m_view->ColToPixel(startCol))), static_cast<LONG>(std::lround(top))};
+    POINT bottomRight{static_cast<LONG>(std::lround(m_view->ColToPixel(endCol))),
+                      static_cast<LONG>(std::lround(bottom))};
+    ClientToScreen(m_hwnd, &topLeft);
+    ClientToScreen(m_hwnd, &bottomRight);
+    bounds = {topLeft.x, topLeft.y, bottomRight.x, bottomRight.y};
+    return true;
+}
+
+void TerminalTextProvider::Select(TextPoint start, TextPoint end) {
+    Core::TerminalBuffer* buffer = m_view ? m_view->m_buffer : nullptr;
+    if (!buffer) {
+        return;
+    }
+
+    // A range ending at the start of a line ends with the line before, as
+    // the view's own selections do
+    if (end.col == 0 && end.line > start.line) {
+        --end.line;
+        end.col = buffer->GetCols();
+    }
+    Selection& selection = m_view->m_selection;
+    selection.startLine = start.line;
+    selection.startCol = start.col;
+    selection.endLine = end.line;
+    selection.endCol = end.col;
+    selection.epoch = buffer->GetScrollbackEpoch();
+    selection.block = false;
+    selection.active = end > start;
+    m_view->m_selectionChanged = true;
+    m_view->Invalidate();
+}
+
+void TerminalTextProvider::ScrollIntoView() {
+    if (m_view && m_view->m_scrollTarget > 0.0f) {
+        m_view->ScrollBy(-m_view->m_scrollTarget);
+    }
+}
+
+HRESULT TerminalTextProvider::MakeRange(TextPoint start, TextPoint end, ITextRangeProvider** range) {
+    if (!range) {
+        return E_POINTER;
+    }
+    *range = nullptr;
+    ComPtr<TextRange> made = Make<TextRange>(ComPtr<TerminalTextProvider>(this), start, end);
+    if (!made) {
+        return E_OUTOFMEMORY;
+    }
+    *range = made.Detach();
+    return S_OK;
+}
+
+HRESULT TerminalTextProvider::MakeRangeArray(TextPoint start, TextPoint end, SAFEARRAY** ranges) {
+    ComPtr<ITextRangeProvider> range;
+    HRESULT hr = MakeRange(start, end, &range);
+    if (FAILED(hr)) {
+        return hr;
+    }
+    SAFEARRAY* array = SafeArrayCreateVector(VT_UNKNOWN, 0, 1);
+    if (!array) {
+        return E_OUTOFMEMORY;
+    }
+    LONG index = 0;
+    hr = SafeArrayPutElement(array, &index, range.Get());
+    if (FAILED(hr)) {
+        SafeArrayDestroy(array);
+        return hr;
+    }
+    *ranges = array;
+    return S_OK;
+}
+
+} // namespace Console3::UI
@@ -0,0 +1,159 @@
+#pragma once
+// Console3 - TerminalTextProvider.h
+// UI Automation text pattern for a terminal view (screen readers, UIA tools)
+//
+// A text provider that answers each query from the whole buffer's text
+// (one GetAllText behind every call) makes screen readers slow a terminal
+// down to their pace: they query after every change, and a flood of output
+// is a flood of changes. This one serves the screen row by row instead.
+// The document is the screen's lines; a range is a pair of points on them
+// in absolute lines (TerminalBuffer::GetScreenLine), so it stays on its
+// text as output scrolls. A row's text is extracted once per row
+// generation (TerminalBuffer::GetRowGeneration), with the offset of each
+// column in it, and ranges cut what they need out of that; rows output
+// didn't touch are never read again.
+//
+// Text changes are not raised as they happen: the view notes rows the
+// dirty bitmap reports when it renders a frame, and raises one TextChanged
+// event per kTextChangedMs at most (TerminalView::TIMER_TEXT_CHANGED),
+// only while a client listens.
+//
+// UI Automation calls in on its own threads. Every call takes the render
+// lock (RenderLock.h), as the view's own handlers do, and fails with
+// UIA_E_ELEMENTNOTAVAILABLE once the view is gone (Disconnect).
+
+#ifndef NTDDI_VERSION
+#define NTDDI_VERSION NTDDI_WIN10_RS5
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT _WIN32_WINNT_WIN10
+#endif
+
+#include <Windows.h>
+#include <UIAutomation.h>
+#include <wrl/client.h>
+#include <wrl/implements.h>
+
+#include <compare>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Console3::Core {
+struct Cell;
+class TerminalBuffer;
+}
+
+namespace Console3::UI {
+
+class TerminalView;
+
+/// A place in the text: an absolute line and a column (0 to the width; at
+/// the width it is the line's end, before its line break)
+struct TextPoint {
+    int64_t line = 0;
+    int col = 0;
+
+    auto operator<=>(const TextPoint&) const = default;
+};
+
+/// The root UI Automation element of a terminal view, with the text
+/// pattern (see file comment)
+class TerminalTextProvider : public Microsoft::WRL::RuntimeClass<
+                                 Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>,
+                                 IRawElementProviderSimple, ITextProvider> {
+public:
+    explicit TerminalTextProvider(TerminalView* view);
+
+    /// The view is going away: every call fails from now on (render lock held)
+    void Disconnect() noexcept;
+
+    // IRawElementProviderSimple
+    STDMETHOD(get_ProviderOptions)(ProviderOptions* options) override;
+    STDMETHOD(GetPatternProvider)(PATTERNID patternId, IUnknown** pattern) override;
+    STDMETHOD(GetPropertyValue)(PROPERTYID propertyId, VARIANT* value) override;
+    STDMETHOD(get_HostRawElementProvider)(IRawElementProviderSimple** provider) override;
+
+    // ITextProvider
+    STDMETHOD(GetSelection)(SAFEARRAY** ranges) override;
+    STDMETHOD(GetVisibleRanges)(SAFEARRAY** ranges) override;
+    STDMETHOD(RangeFromChild)(IRawElementProviderSimple* child, ITextRangeProvider** range) override;
+    STDMETHOD(RangeFromPoint)(UiaPoint point, ITextRangeProvider** range) override;
+    STDMETHOD(get_DocumentRange)(ITextRangeProvider** range) override;
+    STDMETHOD(get_SupportedTextSelection)(SupportedTextSelection* selection) override;
+
+    // The document, for ranges (render lock held)
+
+    /// Check if the view is still there
+    [[nodiscard]] bool IsConnected() const noexcept { return m_view != nullptr; }
+
+    /// Get the start and end of the document (the screen)
+    [[nodiscard]] TextPoint GetStart() const;
+    [[nodiscard]] TextPoint GetEnd() const;
+
+    /// Move a point into the document
+    [[nodiscard]] TextPoint Clamp(TextPoint point) const;
+
+    /// Step one character (the line break counts as one), wide characters whole
+    [[nodiscard]] TextPoint NextChar(TextPoint point) const;
+    [[nodiscard]] TextPoint PrevChar(TextPoint point) const;
+
+    /// Get the start of the unit a point is in, and the start of the next
+    /// (the document's end after the last)
+    [[nodiscard]] TextPoint UnitStart(TextPoint point, TextUnit unit) const;
+    [[nodiscard]] TextPoint NextUnitStart(TextPoint point, TextUnit unit) const;
+
+    /// Move a point by whole units
+    /// @return The units moved (negative backward)
+    int MoveByUnits(TextPoint& point, TextUnit unit, int count) const;
+
+    /// Append the text between two points, lines joined by '\n' and
+    /// trailing blanks dropped
+    /// @param points Receives the point of each character appended (optional)
+    void AppendText(TextPoint start, TextPoint end, std::wstring& text, std::vector<TextPoint>* points);
+
+    /// Get a line's rectangle in screen coordinates, columns [startCol, endCol)
+    /// @return false if the line is not on screen
+    bool GetLineBounds(int64_t line, int startCol, int endCol, RECT& bounds) const;
+
+    /// Select the text between two points in the view
+    void Select(TextPoint start, TextPoint end);
+
+    /// Bring the screen into view (from the scrollback)
+    void ScrollIntoView();
+
+    /// Make a range
+    HRESULT MakeRange(TextPoint start, TextPoint end, ITextRangeProvider** range);
+
+private:
+    /// A row's text and where each column starts in it
+    struct RowText {
+        std::wstring text;              ///< Blanks kept
+        std::vector<uint32_t> offsets;  ///< Per column, and one past the last
+    };
+
+    /// Get a screen row's text, extracted once per row generation
+    const RowText* GetRowText(int64_t line);
+
+    /// Get the cell at a point (nullptr at a line's end or off the screen)
+    [[nodiscard]] const Core::Cell* CellAt(TextPoint point) const;
+
+    /// Check if a character is blank (a space, nothing or a line break)
+    [[nodiscard]] bool IsBlank(TextPoint point) const;
+
+    /// Check if a point starts a word (or a line)
+    [[nodiscard]] bool IsWordStart(TextPoint point) const;
+
+    /// Wrap one range in a SAFEARRAY
+    HRESULT MakeRangeArray(TextPoint start, TextPoint end, SAFEARRAY** ranges);
+
+    TerminalView* m_view;
+    HWND m_hwnd;
+
+    // Row texts by row generation, for the buffer they were read from
+    std::unordered_map<uint64_t, RowText> m_rows;
+    const Core::TerminalBuffer* m_rowsBuffer = nullptr;
+};
+
+} // namespace Console3::UI
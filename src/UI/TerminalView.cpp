@@ -2,81 +2,263 @@
 // Terminal rendering window implementation
 
 #include "UI/TerminalView.h"
+#include "UI/CellGridRenderer.h"
+#include "UI/GlyphRasterizer.h"
+#include "UI/MessageLoop.h"
+#include "UI/RenderThread.h"
+#include "UI/TerminalTextProvider.h"
+#include "Core/AllocTracker.h"
+#include "Core/ImageDecoder.h"
+#include "Core/PerfClock.h"
+#include "Core/PipelineTrace.h"
+#include "Core/ScrollbackSearch.h"
+#include "Core/StartupTrace.h"
+#include "Core/Utf.h"
+#include "Emulation/UnicodeTable.h"
 #include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <cwchar>
 #include <imm.h>
+#include <optional>
+#include <shellapi.h>
+#include <span>
+#include <type_traits>
+#include <wtsapi32.h>
+#include <utility>
+#include <vector>
 
 #pragma comment(lib, "imm32.lib")
+#pragma comment(lib, "shell32.lib")
 
 namespace Console3::UI {
 
+namespace {
+
+// Diagnostics overlay refresh interval
+constexpr UINT kDiagnosticsRefreshMs = 500;
+
+// How long the render capture's outcome stays up
+constexpr uint64_t kCaptureNoticeMs = 5000;
+
+// A drag that pauses this long commits its grid size without waiting for
+// the button to be released
+constexpr UINT kResizeSettleMs = 150;
+
+// Ctrl+wheel zoom: points per notch, the sizes it keeps to, and how long
+// the wheel rests before the size is committed
+constexpr float kZoomStepPoints = 1.0f;
+constexpr float kMinZoomedSize = 6.0f;
+constexpr float kMaxZoomedSize = 72.0f;
+constexpr UINT kZoomSettleMs = 250;
+
+// Video memory the frames of hidden buffers may hold together
+constexpr size_t kHiddenFrameBytes = 64ull * 1024 * 1024;
+
+// Fraction of the remaining distance a scroll animation covers per frame
+constexpr float kScrollEase = 0.35f;
+
+// Scrollback tiles rendered ahead of the view per frame; the ones in view
+// are always rendered
+constexpr size_t kTilesAheadPerFrame = 8;
+
+// Video memory scrollback tiles may hold (at least two screenfuls are kept)
+constexpr size_t kRowTileBytes = 48ull * 1024 * 1024;
+
+// Marks a tile key as a line index rather than a line id
+constexpr uint64_t kUncachedTile = 1ull << 63;
+
+// Scrollback overview strip: its width (DIPs), its image's texels across,
+// and the most texel rows it is built with (one per device pixel below)
+constexpr float kOverviewWidth = 10.0f;
+constexpr UINT32 kOverviewTexels = 4;
+constexpr UINT32 kMaxOverviewRows = 4096;
+
+// Overview opacity where the history is blank, and at least where it isn't
+constexpr float kOverviewTrackAlpha = 0.12f;
+constexpr float kOverviewInkAlpha = 0.3f;
+
+// After a device loss, glyphs rasterized again per timer tick, and the tick
+constexpr size_t kRestoreGlyphsPerTick = 64;
+constexpr UINT kDeviceRestoreMs = 16;
+
+// How often an occluded window tests whether it shows again
+constexpr UINT kOcclusionPollMs = 250;
+
+// Saving power: the frame rate cap, and how much longer the blink period is
+constexpr unsigned kPowerSavingFps = 30;
+constexpr UINT kPowerSavingBlinkFactor = 2;
+
+// While typed text awaits its echo, how often predictions are judged
+// without new output (one that never echoes times out)
+constexpr UINT kPredictionCheckMs = 100;
+
+// Screen readers are told the text changed at most this often, however
+// fast output arrives
+constexpr UINT kTextChangedMs = 100;
+
+// Selections longer than this are promised to the clipboard and written
+// when pasted
+constexpr size_t kDelayedCopyLines = 5000;
+
+/// Premultiply a packed color (ResolvedColor::rgba order) into BGRA
+uint32_t ToOverviewPixel(uint32_t rgba, float alpha) {
+    const auto channel = [alpha](uint32_t value) { return static_cast<uint32_t>((value & 0xFF) * alpha + 0.5f); };
+    return channel(rgba >> 16) | channel(rgba >> 8) << 8 | channel(rgba) << 16 |
+           static_cast<uint32_t>(alpha * 255.0f + 0.5f) << 24;
+}
+
+/// Blend a summary's ink into one overview pixel: the mix of its colors, as
+/// opaque as the ink is dense
+uint32_t BlendOverviewInk(const Core::OverviewBlock& block,
+                          const std::array<uint32_t, Core::kOverviewColors>& colors) {
+    uint64_t ink = 0;
+    uint64_t r = 0;
+    uint64_t g = 0;
+    uint64_t b = 0;
+    for (size_t color = 0; color < Core::kOverviewColors; ++color) {
+        const uint64_t count = block.ink[color];
+        ink += count;
+        r += count * (colors[color] & 0xFF);
+        g += count * ((colors[color] >> 8) & 0xFF);
+        b += count * ((colors[color] >> 16) & 0xFF);
+    }
+    if (ink == 0 || block.cells == 0) {
+        return ToOverviewPixel(colors[0], kOverviewTrackAlpha);
+    }
+    const auto mixed = static_cast<uint32_t>(r / ink | (g / ink) << 8 | (b / ink) << 16);
+    const float coverage = std::min(1.0f, static_cast<float>(ink) / static_cast<float>(block.cells));
+    return ToOverviewPixel(mixed, kOverviewInkAlpha + (1.0f - kOverviewInkAlpha) * std::sqrt(coverage));
+}
+
+using Core::FormatBytes;
+
+/// Check that cells are all narrow ASCII characters without combining marks
+/// (no continuation cells): the cheap text kernel of RenderCells draws them.
+/// One pass that ORs the bits that would disqualify a cell, no branches.
+bool IsNarrowAscii(std::span<const Core::Cell> cells) noexcept {
+    uint32_t mixed = 0;
+    for (const Core::Cell& cell : cells) {
+        mixed |= (cell.code >> 7) | cell.grapheme | (cell.width ^ 1u);
+    }
+    return mixed == 0;
+}
+
+} // namespace
+
 // ============================================================================
 // Selection Implementation
 // ============================================================================
 
-bool Selection::Contains(int row, int col) const {
+bool Selection::Contains(int64_t line, int col) const {
     if (!active) return false;
-    
-    int sRow = startRow, sCol = startCol;
-    int eRow = endRow, eCol = endCol;
-    
-    // Normalize
-    if (sRow > eRow || (sRow == eRow && sCol > eCol)) {
-        std::swap(sRow, eRow);
-        std::swap(sCol, eCol);
-    }
-    
-    if (row < sRow || row > eRow) return false;
-    if (row == sRow && row == eRow) return col >= sCol && col < eCol;
-    if (row == sRow) return col >= sCol;
-    if (row == eRow) return col < eCol;
+
+    Selection normal = *this;
+    normal.Normalize();
+
+    if (line < normal.startLine || line > normal.endLine) return false;
+    if (normal.block) return col >= normal.startCol && col < normal.endCol;
+    if (line == normal.startLine && line == normal.endLine) return col >= normal.startCol && col < normal.endCol;
+    if (line == normal.startLine) return col >= normal.startCol;
+    if (line == normal.endLine) return col < normal.endCol;
     return true;
 }
 
 void Selection::Normalize() {
-    if (startRow > endRow || (startRow == endRow && startCol > endCol)) {
-        std::swap(startRow, endRow);
+    if (block) {
+        if (startLine > endLine) std::swap(startLine, endLine);
+        if (startCol > endCol) std::swap(startCol, endCol);
+        return;
+    }
+    if (startLine > endLine || (startLine == endLine && startCol > endCol)) {
+        std::swap(startLine, endLine);
         std::swap(startCol, endCol);
     }
 }
 
-std::wstring Selection::GetText(const Core::TerminalBuffer& buffer) const {
-    if (!active) return L"";
-    
-    std::wstring result;
-    int sRow = startRow, sCol = startCol;
-    int eRow = endRow, eCol = endCol;
-    
-    // Normalize
-    if (sRow > eRow || (sRow == eRow && sCol > eCol)) {
-        std::swap(sRow, eRow);
-        std::swap(sCol, eCol);
+bool Selection::GetColumns(int64_t line, std::span<const Core::Cell> cells, int& first, int& last) const {
+    if (line < startLine || line > endLine) {
+        return false;
     }
-    
-    for (int row = sRow; row <= eRow; ++row) {
-        int colStart = (row == sRow) ? sCol : 0;
-        int colEnd = (row == eRow) ? eCol : buffer.GetCols();
-        
-        for (int col = colStart; col < colEnd; ++col) {
-            const auto& cell = buffer.GetCell(row, col);
-            if (cell.width == 0) continue;  // Skip continuation cells
-            
-            uint32_t cp = cell.charCode;
-            if (cp <= 0xFFFF) {
-                result += static_cast<wchar_t>(cp);
-            } else {
-                // Surrogate pair
-                cp -= 0x10000;
-                result += static_cast<wchar_t>(0xD800 | (cp >> 10));
-                result += static_cast<wchar_t>(0xDC00 | (cp & 0x3FF));
+    const int cols = static_cast<int>(cells.size());
+    first = block || line == startLine ? std::clamp(startCol, 0, cols) : 0;
+    last = block || line == endLine ? std::clamp(endCol, 0, cols) : cols;
+
+    // Wide characters are selected whole
+    if (first > 0 && first < cols && cells[first].width == 0) {
+        --first;
+    }
+    if (last > 0 && last < cols && cells[last].width == 0) {
+        ++last;
+    }
+    return first < last;
+}
+
+HGLOBAL Selection::Export(const Core::TerminalBuffer& buffer) const {
+    Selection normal = *this;
+    normal.Normalize();
+    if (!active || epoch != buffer.GetScrollbackEpoch()) {
+        return nullptr;
+    }
+
+    // Room for a character per cell to start with; lines with surrogate
+    // pairs or combining characters grow it
+    const auto lines = static_cast<size_t>(normal.endLine - normal.startLine + 1);
+    size_t capacity = lines * (static_cast<size_t>(buffer.GetCols()) + 1) + 1;
+    HGLOBAL global = GlobalAlloc(GMEM_MOVEABLE, capacity * sizeof(wchar_t));
+    auto* text = global ? static_cast<wchar_t*>(GlobalLock(global)) : nullptr;
+    if (!text) {
+        if (global) GlobalFree(global);
+        return nullptr;
+    }
+    size_t length = 0;
+
+    // Each line is extracted from the row storage into one reused buffer
+    // and copied over whole
+    std::wstring lineText;
+    for (int64_t line = normal.startLine; line <= normal.endLine; ++line) {
+        // Lines trimmed from the scrollback since the selection was made
+        // are left out
+        const std::span<const Core::Cell> cells = buffer.GetLine(static_cast<uint64_t>(line));
+        lineText.clear();
+        int first = 0;
+        int last = 0;
+        if (normal.GetColumns(line, cells, first, last)) {
+            Core::TerminalBuffer::AppendColumnText(lineText, cells, first, last);
+        }
+        if (line < normal.endLine) {
+            lineText += L'\n';
+        }
+
+        if (length + lineText.size() + 1 > capacity) {
+            capacity = std::max(capacity * 2, length + lineText.size() + 1);
+            GlobalUnlock(global);
+            HGLOBAL grown = GlobalReAlloc(global, capacity * sizeof(wchar_t), GMEM_MOVEABLE);
+            if (!grown) {
+                GlobalFree(global);
+                return nullptr;
+            }
+            global = grown;
+            text = static_cast<wchar_t*>(GlobalLock(global));
+            if (!text) {
+                GlobalFree(global);
+                return nullptr;
             }
         }
-        
-        if (row < eRow) {
-            result += L'\n';
+        std::memcpy(text + length, lineText.data(), lineText.size() * sizeof(wchar_t));
+        length += lineText.size();
+    }
+    text[length++] = L'\0';
+    GlobalUnlock(global);
+
+    // Give back what the estimate over-reserved
+    if (length < capacity) {
+        if (HGLOBAL shrunk = GlobalReAlloc(global, length * sizeof(wchar_t), GMEM_MOVEABLE)) {
+            global = shrunk;
         }
     }
-    
-    return result;
+    return global;
 }
 
 // ============================================================================
@@ -90,7 +272,9 @@ TerminalView::~TerminalView() = default;
 bool TerminalView::Initialize(
     ID2D1Factory1* d2dFactory,
     IDWriteFactory1* dwriteFactory,
-    Core::TerminalBuffer* buffer
+    Core::TerminalBuffer* buffer,
+    RenderBackend backend,
+    float opacity
 ) {
     if (!m_hWnd || !d2dFactory || !dwriteFactory) {
         return false;
@@ -105,41 +289,212 @@ bool TerminalView::Initialize(
     config.hwnd = m_hWnd;
     config.d2dFactory = d2dFactory;
     config.dwriteFactory = dwriteFactory;
-    config.backgroundColor = m_defaultBg;
+    config.backgroundColor = m_palette.GetDefaultBg().color;
+    config.dpiScaleX = config.dpiScaleY = static_cast<float>(GetViewDpi()) / 96.0f;
+    config.backend = backend;
+    config.opacity = opacity;
+
+    // Over RDP a swap chain sends the whole window each present; the
+    // software backend sends only the regions that changed
+    if (backend == RenderBackend::SwapChain && GetSystemMetrics(SM_REMOTESESSION)) {
+        config.backend = RenderBackend::Software;
+    }
     
     if (!m_renderer->Initialize(config)) {
         return false;
     }
+    m_deviceGeneration = m_renderer->GetDeviceGeneration();
 
     // Set default font
     if (!m_renderer->SetFont(L"Consolas", 12.0f)) {
         return false;
     }
+    PrewarmGlyphs();
+
+    // Paint on the scheduler's clock; if it can't attach, Invalidate()
+    // falls back to WM_PAINT
+    SetRenderThread(m_renderThread);
 
     return true;
 }
 
+void TerminalView::SetRenderThread(RenderThread* thread) {
+    m_renderThread = thread;
+    if (!m_renderer) {
+        return;     // Attached by Initialize()
+    }
+    WaitHandleHost* host = thread;
+    if (!host) {
+        host = static_cast<WaitableMessageLoop*>(_Module.GetMessageLoop());
+    }
+    if (!m_scheduler.Attach(host, [this]() {
+            FlushMouseMotion();
+            Render();
+            ValidateRect(nullptr);
+        })) {
+        m_renderThread = nullptr;
+    }
+    Invalidate();
+}
+
+void TerminalView::StartTimer(UINT_PTR id, UINT milliseconds) {
+    if (GetWindowThreadProcessId(m_hWnd, nullptr) == GetCurrentThreadId()) {
+        SetTimer(id, milliseconds);
+    } else {
+        PostMessage(kSetTimerMessage, id, milliseconds);
+    }
+}
+
 void TerminalView::SetBuffer(Core::TerminalBuffer* buffer) {
+    if (buffer == m_buffer) {
+        InvalidateFrame();
+        return;
+    }
+
+    // A promised copy reads the buffer it was made in; write it while the
+    // buffer is known to be alive
+    RenderPendingCopy();
+    m_echo.OnOtherInput();
+
+    // Keep the outgoing frame if it shows exactly the buffer, painted since
+    // its last change
+    if (m_buffer && m_renderer && !m_frameStale && !m_renderer->GetCellGrid() && m_panes.empty()) {
+        if (SavedFrame frame = m_renderer->TakeFrame()) {
+            ForgetBuffer(m_buffer);
+            m_hiddenFrames.push_back(HiddenFrame{m_buffer, std::move(frame), m_frameRows, m_frameCols});
+            TrimHiddenFrames();
+        }
+    }
+
     m_buffer = buffer;
-    Invalidate();
+    m_selection.active = false;
+    m_hoverLink.reset();
+    m_links.Clear();                    // Row generations are per buffer
+    m_windowStale = true;
+    m_scrollPixels = 0.0f;
+    m_scrollTarget = 0.0f;
+    m_tiles.clear();
+
+    // The buffer kept its damage while hidden; on its old frame only that
+    // needs painting
+    const auto hidden = std::find_if(m_hiddenFrames.begin(), m_hiddenFrames.end(),
+                                     [buffer](const HiddenFrame& frame) { return frame.buffer == buffer; });
+    bool restored = false;
+    if (hidden != m_hiddenFrames.end()) {
+        restored = buffer && m_renderer && hidden->rows == buffer->GetRows() &&
+                   hidden->cols == buffer->GetCols() && m_renderer->RestoreFrame(std::move(hidden->frame));
+        if (restored) {
+            m_frameRows = hidden->rows;
+            m_frameCols = hidden->cols;
+        }
+        m_hiddenFrames.erase(hidden);
+    }
+
+    if (restored) {
+        m_frameStale = false;
+        Invalidate();
+    } else {
+        InvalidateFrame();
+    }
+}
+
+void TerminalView::ForgetBuffer(Core::TerminalBuffer* buffer) {
+    if (m_pendingCopy && m_pendingCopy->buffer == buffer) {
+        RenderPendingCopy();
+    }
+    std::erase_if(m_hiddenFrames, [buffer](const HiddenFrame& frame) { return frame.buffer == buffer; });
+}
+
+void TerminalView::TrimHiddenFrames() {
+    size_t bytes = 0;
+    for (const HiddenFrame& frame : m_hiddenFrames) {
+        bytes += frame.frame.GetBytes();
+    }
+
+    // The longest hidden go first
+    while (bytes > kHiddenFrameBytes && !m_hiddenFrames.empty()) {
+        bytes -= m_hiddenFrames.front().frame.GetBytes();
+        m_hiddenFrames.erase(m_hiddenFrames.begin());
+    }
 }
 
 void TerminalView::SetVTerm(Emulation::VTermWrapper* vterm) {
     m_vterm = vterm;
+    UpdateCellPixelSize();
 }
 
 void TerminalView::SetKeyboardInputCallback(KeyboardInputCallback callback) {
     m_keyboardCallback = std::move(callback);
 }
 
+void TerminalView::SetMouseInputCallback(MouseInputCallback callback) {
+    m_mouseCallback = std::move(callback);
+    m_pendingMotion.reset();
+}
+
+void TerminalView::SetPasteCallback(PasteCallback callback) {
+    m_pasteCallback = std::move(callback);
+}
+
 bool TerminalView::SetFont(const std::wstring& fontName, float fontSize) {
     if (!m_renderer) return false;
-    
-    bool result = m_renderer->SetFont(fontName, fontSize);
-    if (result) {
-        Invalidate();
+
+    // A font that can't be made leaves the one in use
+    std::wstring oldName = std::move(m_fontName);
+    const float oldSize = m_fontSize;
+    m_fontName = fontName;
+    m_fontSize = fontSize;
+    if (CommitZoom()) {
+        return true;
+    }
+    m_fontName = std::move(oldName);
+    m_fontSize = oldSize;
+    return false;
+}
+
+float TerminalView::GetZoomedSize(float zoom) const noexcept {
+    // A size set outside the range is not pulled into it
+    return std::clamp(m_fontSize + zoom, std::min(m_fontSize, kMinZoomedSize), std::max(m_fontSize, kMaxZoomedSize));
+}
+
+void TerminalView::ZoomBy(float points) {
+    if (!m_renderer || !m_renderer->IsInitialized() || m_fontName.empty()) {
+        return;
+    }
+    m_zoomTarget = GetZoomedSize(m_zoomTarget + points) - m_fontSize;
+
+    // The cells at the committed size, stretched to the new one
+    m_renderer->SetPreviewScale(GetZoomedSize(m_zoomTarget) / GetZoomedSize(m_zoom));
+    SetTimer(TIMER_ZOOM, kZoomSettleMs);
+    m_windowStale = true;
+    Invalidate();
+}
+
+bool TerminalView::CommitZoom() {
+    KillTimer(TIMER_ZOOM);
+    if (!m_renderer) {
+        return false;
     }
-    return result;
+    m_renderer->SetPreviewScale(1.0f);
+
+    // Touchpads turn the wheel in fractions of a notch; sizes go by whole steps
+    const float size = GetZoomedSize(std::round(m_zoomTarget / kZoomStepPoints) * kZoomStepPoints);
+    if (!m_renderer->SetFont(m_fontName, size)) {
+        // The size that failed is not kept; the old one stays in use
+        m_zoomTarget = m_zoom;
+        InvalidateFrame();
+        return false;
+    }
+    m_zoom = size - m_fontSize;
+    m_zoomTarget = m_zoom;
+
+    // Glyphs at the new size are rasterized on the worker threads as cells
+    // ask for them; an atlas of a size shown before is taken up again
+    UpdateCellPixelSize();
+    PrewarmGlyphs();
+    LayoutPanes();
+    InvalidateFrame();
+    return true;
 }
 
 void TerminalView::SetCursorStyle(CursorStyle style) {
@@ -153,84 +508,198 @@ void TerminalView::SetCursorBlinkRate(UINT milliseconds) {
     if (m_hWnd && m_hasFocus) {
         KillTimer(TIMER_CURSOR_BLINK);
         if (milliseconds > 0) {
-            SetTimer(TIMER_CURSOR_BLINK, milliseconds);
+            SetTimer(TIMER_CURSOR_BLINK, GetBlinkPeriod());
         }
     }
 }
 
+UINT TerminalView::GetBlinkPeriod() const noexcept {
+    return m_powerSaving ? m_cursorBlinkRate * kPowerSavingBlinkFactor : m_cursorBlinkRate;
+}
+
+void TerminalView::SetMaxFrameRate(unsigned fps) noexcept {
+    m_maxFrameRate = fps;
+    const bool capped = fps > 0 && fps < kPowerSavingFps;
+    m_scheduler.SetMaxFrameRate(m_powerSaving && !capped ? kPowerSavingFps : fps);
+}
+
+void TerminalView::SetPowerSaving(bool saving) {
+    if (saving == m_powerSaving) {
+        return;
+    }
+    m_powerSaving = saving;
+    SetMaxFrameRate(m_maxFrameRate);
+    SetCursorBlinkRate(m_cursorBlinkRate);
+}
+
 void TerminalView::SetCursorVisible(bool visible) {
     m_cursorVisible = visible;
     Invalidate();
 }
 
+void TerminalView::SetColorScheme(const Core::ColorScheme& scheme) {
+    // A table swap: cells keep their indexes, so nothing in the buffers changes
+    m_palette.Load(scheme);
+    m_cursorColor = m_palette.GetCompiled().cursor;
+    m_selectionColor = m_palette.GetCompiled().selection;
+    if (m_renderer) {
+        m_renderer->SetBackgroundColor(m_palette.GetDefaultBg().color);
+    }
+
+    // Every cell with a default or indexed color may look different
+    m_tiles.clear();
+    m_overviewSource = {};
+    InvalidateFrame();
+}
+
 int TerminalView::GetTerminalRows() const {
     if (!m_renderer) return 25;
     
-    CRect rect;
-    GetClientRect(&rect);
+    const D2D1_RECT_F rect = GetPaneRect();
     float cellHeight = m_renderer->GetCellHeight();
-    return cellHeight > 0 ? static_cast<int>(rect.Height() / cellHeight) : 25;
+    return cellHeight > 0 ? static_cast<int>((rect.bottom - rect.top) / cellHeight) : 25;
 }
 
 int TerminalView::GetTerminalCols() const {
     if (!m_renderer) return 80;
     
-    CRect rect;
-    GetClientRect(&rect);
+    const D2D1_RECT_F rect = GetPaneRect();
     float cellWidth = m_renderer->GetCellWidth();
-    return cellWidth > 0 ? static_cast<int>(rect.Width() / cellWidth) : 80;
+    return cellWidth > 0 ? static_cast<int>((rect.right - rect.left) / cellWidth) : 80;
 }
 
 void TerminalView::Invalidate() {
-    if (m_hWnd) {
+    if (IsSuspended()) {
+        return;
+    }
+    if (m_scheduler.IsAttached()) {
+        m_scheduler.RequestFrame();
+    } else if (m_hWnd) {
         ::InvalidateRect(m_hWnd, nullptr, FALSE);
     }
 }
 
+void TerminalView::InvalidateFrame() {
+    m_frameStale = true;
+    Invalidate();
+}
+
+void TerminalView::SetHidden(bool hidden) {
+    SetSuspended(m_hidden, hidden);
+}
+
+void TerminalView::SetSuspended(bool& reason, bool suspended) {
+    if (reason == suspended) {
+        return;
+    }
+    const bool wasSuspended = IsSuspended();
+    reason = suspended;
+    if (!wasSuspended || IsSuspended()) {
+        return;     // The timers stop themselves at their next tick
+    }
+
+    // Whatever changed meanwhile was never drawn
+    m_windowStale = true;
+    InvalidateFrame();
+    if (IsWindow()) {
+        if (m_hasFocus && m_cursorBlinkRate > 0) {
+            m_cursorBlinkState = true;
+            StartTimer(TIMER_CURSOR_BLINK, GetBlinkPeriod());
+        }
+        UpdateOverlayTimer();
+    }
+}
+
+void TerminalView::OnCompositionChanged() {
+    if (m_occluded) {
+        if (!m_renderer || !m_renderer->TestOcclusion()) {
+            KillTimer(TIMER_OCCLUSION);
+            SetSuspended(m_occluded, false);
+        }
+        return;
+    }
+    m_windowStale = true;
+    InvalidateFrame();
+}
+
+void TerminalView::ReleaseCaches() {
+    std::vector<HiddenFrame>().swap(m_hiddenFrames);
+    std::vector<uint32_t>().swap(m_runText);
+    if (m_renderer) {
+        m_renderer->ReleaseCaches();
+    }
+    m_frameStale = true;
+    m_windowStale = true;
+}
+
 void TerminalView::CopyToClipboard() {
     if (!m_selection.active || !m_buffer) return;
-    
-    std::wstring text = m_selection.GetText(*m_buffer);
-    if (text.empty()) return;
-    
+
+    Selection selection = m_selection;
+    selection.Normalize();
+    const auto lines = static_cast<size_t>(selection.endLine - selection.startLine + 1);
+
     if (OpenClipboard()) {
+        // Emptying the clipboard drops a copy still promised (WM_DESTROYCLIPBOARD)
         EmptyClipboard();
-        
-        size_t size = (text.length() + 1) * sizeof(wchar_t);
-        HGLOBAL hGlobal = GlobalAlloc(GMEM_MOVEABLE, size);
-        if (hGlobal) {
-            wchar_t* dest = static_cast<wchar_t*>(GlobalLock(hGlobal));
-            if (dest) {
-                wcscpy_s(dest, text.length() + 1, text.c_str());
-                GlobalUnlock(hGlobal);
-                SetClipboardData(CF_UNICODETEXT, hGlobal);
+
+        if (lines > kDelayedCopyLines) {
+            // Promise the text; WM_RENDERFORMAT writes it if it is pasted
+            SetClipboardData(CF_UNICODETEXT, nullptr);
+            m_pendingCopy = PendingCopy{m_buffer, selection};
+        } else if (HGLOBAL global = selection.Export(*m_buffer)) {
+            if (!SetClipboardData(CF_UNICODETEXT, global)) {
+                GlobalFree(global);
             }
         }
         CloseClipboard();
     }
 }
 
+void TerminalView::RenderPendingCopy() {
+    if (!m_pendingCopy) {
+        return;
+    }
+
+    // The clipboard is ours while a copy is promised; write it in place
+    if (OpenClipboard()) {
+        if (::GetClipboardOwner() == m_hWnd) {
+            OnRenderFormat(CF_UNICODETEXT);
+        }
+        CloseClipboard();
+    }
+    m_pendingCopy.reset();
+}
+
 void TerminalView::PasteFromClipboard() {
-    if (!m_keyboardCallback) return;
+    if (!m_keyboardCallback && !m_pasteCallback) return;
+    m_echo.OnOtherInput();
     
     if (IsClipboardFormatAvailable(CF_UNICODETEXT) && OpenClipboard()) {
         HANDLE hData = GetClipboardData(CF_UNICODETEXT);
         if (hData) {
             const wchar_t* text = static_cast<const wchar_t*>(GlobalLock(hData));
-            if (text) {
+            if (text && m_pasteCallback) {
+                // Copied as is and handed over once the clipboard is closed;
+                // the paste is converted to UTF-8 a chunk at a time as it is written
+                std::wstring paste(text, wcsnlen(text, GlobalSize(hData) / sizeof(wchar_t)));
+                GlobalUnlock(hData);
+                CloseClipboard();
+                m_pasteCallback(std::move(paste), m_bracketedPasteMode);
+                return;
+            } else if (text) {
+                FlushInput();
                 // Convert to UTF-8
-                int utf8Len = WideCharToMultiByte(CP_UTF8, 0, text, -1, nullptr, 0, nullptr, nullptr);
-                if (utf8Len > 0) {
-                    std::string utf8(utf8Len, '\0');
-                    WideCharToMultiByte(CP_UTF8, 0, text, -1, utf8.data(), utf8Len, nullptr, nullptr);
-                    
-                    // Bracketed paste mode
+                const std::string utf8 =
+                    Core::ToUtf8(std::wstring_view(text, wcsnlen(text, GlobalSize(hData) / sizeof(wchar_t))));
+                if (!utf8.empty()) {
                     if (m_bracketedPasteMode) {
+                        // Bracketed paste mode
                         m_keyboardCallback("\x1b[200~", 6);  // Start bracket
-                        m_keyboardCallback(utf8.c_str(), utf8.length() - 1);
+                        m_keyboardCallback(utf8.data(), utf8.size());
                         m_keyboardCallback("\x1b[201~", 6);  // End bracket
                     } else {
-                        m_keyboardCallback(utf8.c_str(), utf8.length() - 1);  // Exclude null
+                        m_keyboardCallback(utf8.data(), utf8.size());
                     }
                 }
                 GlobalUnlock(hData);
@@ -240,8 +709,37 @@ void TerminalView::PasteFromClipboard() {
     }
 }
 
+void TerminalView::OnRenderFormat(UINT uFormat) {
+    // The clipboard is already open for us
+    if (uFormat != CF_UNICODETEXT || !m_pendingCopy) {
+        return;
+    }
+    const PendingCopy pending = *std::exchange(m_pendingCopy, std::nullopt);
+    if (HGLOBAL global = pending.selection.Export(*pending.buffer)) {
+        if (!SetClipboardData(CF_UNICODETEXT, global)) {
+            GlobalFree(global);
+        }
+    }
+}
+
+void TerminalView::OnRenderAllFormats() {
+    // Closing down: leave the text on the clipboard for after
+    if (m_pendingCopy && OpenClipboard()) {
+        if (::GetClipboardOwner() == m_hWnd) {
+            OnRenderFormat(CF_UNICODETEXT);
+        }
+        CloseClipboard();
+    }
+    m_pendingCopy.reset();
+}
+
+void TerminalView::OnDestroyClipboard() {
+    m_pendingCopy.reset();
+}
+
 void TerminalView::ClearSelection() {
     m_selection.active = false;
+    m_selectionChanged = true;
     Invalidate();
 }
 
@@ -250,26 +748,166 @@ void TerminalView::ClearSelection() {
 // ============================================================================
 
 int TerminalView::OnCreate(LPCREATESTRUCT /*lpCreateStruct*/) {
+    // Lock, unlock and remote disconnects suspend rendering (not having
+    // them only costs frames nobody sees)
+    m_sessionNotify = WTSRegisterSessionNotification(m_hWnd, NOTIFY_FOR_THIS_SESSION) != FALSE;
+    GlyphRasterizer::Shared().AddListener(m_hWnd, kGlyphsReadyMessage);
+    Core::ImageDecoder::Shared().AddListener(m_hWnd, kImagesReadyMessage);
     return 0;
 }
 
 void TerminalView::OnDestroy() {
+    if (m_sessionNotify) {
+        WTSUnRegisterSessionNotification(m_hWnd);
+        m_sessionNotify = false;
+    }
+    GlyphRasterizer::Shared().RemoveListener(m_hWnd);
+    Core::ImageDecoder::Shared().RemoveListener(m_hWnd);
+    KillTimer(TIMER_OCCLUSION);
     KillTimer(TIMER_CURSOR_BLINK);
+    KillTimer(TIMER_DIAGNOSTICS);
+    KillTimer(TIMER_RESIZE);
+    KillTimer(TIMER_ZOOM);
+    KillTimer(TIMER_DEVICE_RESTORE);
+    KillTimer(TIMER_PREDICTION);
+    KillTimer(TIMER_TEXT_CHANGED);
+    if (m_textProvider) {
+        // Clients holding the provider get UIA_E_ELEMENTNOTAVAILABLE from now on
+        m_textProvider->Disconnect();
+        UiaReturnRawElementProvider(m_hWnd, 0, 0, nullptr);
+        (void)UiaDisconnectProvider(m_textProvider.Get());
+        m_textProvider.Reset();
+        m_textChangePending = false;
+    }
+    RenderPendingCopy();
+    m_scheduler.Detach();
+    m_hiddenFrames.clear();
+    m_tiles.clear();
     m_renderer.reset();
 }
 
 void TerminalView::OnSize(UINT nType, CSize size) {
     if (nType == SIZE_MINIMIZED) return;
     
-    if (m_renderer && m_renderer->IsInitialized()) {
-        m_renderer->Resize(size.cx, size.cy);
+    if (!m_renderer || !m_renderer->IsInitialized()) return;
+
+    // Resizing the emulator, buffer and pseudoconsole is expensive (and
+    // ConPTY redraws the whole screen each time), so while the window is
+    // dragged only the render target follows; the old frame is shown as is
+    // until the size settles
+    if (m_liveResize) {
+        (void)m_renderer->Resize(size.cx, size.cy, true);
+        m_resizePending = true;
+        SetTimer(TIMER_RESIZE, kResizeSettleMs);
+        Invalidate();
+    } else {
+        CommitResize();
+    }
+}
+
+LRESULT TerminalView::OnDpiChangedAfterParent(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/,
+                                              BOOL& /*bHandled*/) {
+    if (!m_renderer || !m_renderer->IsInitialized()) return 0;
+
+    // Only this view is laid out again now; the renderer keeps fonts and
+    // the atlas of the old DPI, and the frames of hidden buffers no longer
+    // fit, so each is repainted when its buffer is shown
+    const auto dpi = static_cast<float>(GetViewDpi());
+    m_renderer->SetDpi(dpi, dpi);
+    UpdateCellPixelSize();
+    PrewarmGlyphs();
+    CommitResize();
+    return 0;
+}
+
+LRESULT TerminalView::OnSessionChange(UINT /*uMsg*/, WPARAM wParam, LPARAM /*lParam*/, BOOL& /*bHandled*/) {
+    switch (wParam) {
+    case WTS_SESSION_LOCK:
+    case WTS_REMOTE_DISCONNECT:
+    case WTS_CONSOLE_DISCONNECT:
+        SetSuspended(m_sessionLocked, true);
+        break;
+    case WTS_SESSION_UNLOCK:
+    case WTS_REMOTE_CONNECT:
+    case WTS_CONSOLE_CONNECT:
+        SetSuspended(m_sessionLocked, false);
+        break;
+    default:
+        break;
+    }
+    return 0;
+}
+
+LRESULT TerminalView::OnSetTimerMessage(UINT /*uMsg*/, WPARAM wParam, LPARAM lParam, BOOL& /*bHandled*/) {
+    SetTimer(static_cast<UINT_PTR>(wParam), static_cast<UINT>(lParam));
+    return 0;
+}
+
+LRESULT TerminalView::OnGetObject(UINT /*uMsg*/, WPARAM wParam, LPARAM lParam, BOOL& bHandled) {
+    if (static_cast<long>(lParam) != static_cast<long>(UiaRootObjectId)) {
+        bHandled = FALSE;
+        return 0;
+    }
+    if (!m_textProvider) {
+        m_textProvider = Microsoft::WRL::Make<TerminalTextProvider>(this);
+        if (!m_textProvider) {
+            bHandled = FALSE;
+            return 0;
+        }
+    }
+
+    // UI Automation calls the provider back on its own threads, which take
+    // the render lock
+    ComPtr<TerminalTextProvider> provider = m_textProvider;
+    RenderLock::Unlocked unlocked(RenderLock::Shared());
+    return UiaReturnRawElementProvider(m_hWnd, wParam, lParam, provider.Get());
+}
+
+LRESULT TerminalView::OnGlyphsReady(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/) {
+    // The frame lands them (see RenderFrame); only views showing blank
+    // cells need one
+    if (m_renderer && m_renderer->IsAwaitingGlyphs()) {
+        Invalidate();
+    }
+    return 0;
+}
+
+LRESULT TerminalView::OnImagesReady(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/) {
+    // Placements drew nothing until their pixels came; only views with
+    // some need a frame
+    if (m_buffer && m_buffer->GetImageCount() != 0) {
+        m_windowStale = true;
         Invalidate();
     }
+    return 0;
+}
+
+void TerminalView::PrewarmGlyphs() {
+    if (m_renderer && m_renderer->HasGlyphsToRefill()) {
+        StartTimer(TIMER_DEVICE_RESTORE, kDeviceRestoreMs);
+    }
 }
 
 void TerminalView::OnPaint(CDCHandle /*dc*/) {
+    // Keys held back while more were queued go out before the frame
+    FlushInput();
+
+    // The render thread paints: ask it for a whole-window frame
+    if (m_renderThread) {
+        m_windowStale = true;
+        ValidateRect(nullptr);
+        m_scheduler.RequestFrame();
+        return;
+    }
+
+    // The software backend copies only changes to the window, which may
+    // have lost more (e.g. uncovered without composition)
+    if (m_renderer && m_renderer->GetBackend() == RenderBackend::Software) {
+        m_renderer->PresentWholeWindow();
+    }
     Render();
     ValidateRect(nullptr);
+    m_scheduler.NoteFrameRendered();
 }
 
 LRESULT TerminalView::OnEraseBkgnd(CDCHandle /*dc*/) {
@@ -277,9 +915,51 @@ LRESULT TerminalView::OnEraseBkgnd(CDCHandle /*dc*/) {
 }
 
 void TerminalView::OnTimer(UINT_PTR nIDEvent) {
-    if (nIDEvent == TIMER_CURSOR_BLINK) {
+    // Nothing to blink or refresh while suspended; resuming restarts them
+    if ((nIDEvent == TIMER_CURSOR_BLINK || nIDEvent == TIMER_DIAGNOSTICS) && IsSuspended()) {
+        KillTimer(nIDEvent);
+        return;
+    }
+
+    if (nIDEvent == TIMER_OCCLUSION) {
+        if (!m_renderer || !m_renderer->TestOcclusion()) {
+            KillTimer(TIMER_OCCLUSION);
+            SetSuspended(m_occluded, false);
+        }
+    } else if (nIDEvent == TIMER_CURSOR_BLINK) {
         m_cursorBlinkState = !m_cursorBlinkState;
         Invalidate();
+    } else if (nIDEvent == TIMER_DIAGNOSTICS) {
+        Invalidate();
+    } else if (nIDEvent == TIMER_RESIZE) {
+        CommitResize();
+    } else if (nIDEvent == TIMER_ZOOM) {
+        (void)CommitZoom();
+    } else if (nIDEvent == TIMER_PREDICTION) {
+        // Between outputs, only a prediction timing out changes anything
+        if (!m_echo.HasPending()) {
+            KillTimer(TIMER_PREDICTION);
+        } else if (ReconcilePredictions()) {
+            Invalidate();
+        }
+    } else if (nIDEvent == TIMER_TEXT_CHANGED) {
+        // One event for all the output since the first change noted
+        KillTimer(TIMER_TEXT_CHANGED);
+        m_textChangePending = false;
+        if (ComPtr<TerminalTextProvider> provider = m_textProvider) {
+            RenderLock::Unlocked unlocked(RenderLock::Shared());
+            (void)UiaRaiseAutomationEvent(provider.Get(), UIA_Text_TextChangedEventId);
+        }
+    } else if (nIDEvent == TIMER_DEVICE_RESTORE) {
+        const bool hadDevice = m_renderer && m_renderer->IsInitialized();
+        if (!m_renderer || !m_renderer->RestoreDeviceCaches(kRestoreGlyphsPerTick)) {
+            KillTimer(TIMER_DEVICE_RESTORE);
+        }
+        if (!hadDevice && m_renderer && m_renderer->IsInitialized()) {
+            m_deviceGeneration = m_renderer->GetDeviceGeneration();
+            m_frameStale = true;
+            Invalidate();
+        }
     }
 }
 
@@ -288,7 +968,7 @@ void TerminalView::OnSetFocus(CWindow /*wndOld*/) {
     m_cursorBlinkState = true;
     
     if (m_cursorBlinkRate > 0) {
-        SetTimer(TIMER_CURSOR_BLINK, m_cursorBlinkRate);
+        SetTimer(TIMER_CURSOR_BLINK, GetBlinkPeriod());
     }
     
     Invalidate();
@@ -302,14 +982,83 @@ void TerminalView::OnKillFocus(CWindow /*wndNew*/) {
 
 void TerminalView::OnKeyDown(UINT nChar, UINT nRepCnt, UINT nFlags) {
     (void)nRepCnt;
-    SendKeyToTerminal(nChar, nFlags & 0xFF, true);
+
+    // Ctrl+Shift+F12 toggles the hidden diagnostics overlay
+    if (nChar == VK_F12 && (GetKeyState(VK_CONTROL) & 0x8000) && (GetKeyState(VK_SHIFT) & 0x8000)) {
+        ShowDiagnostics(!m_showDiagnostics);
+        return;
+    }
+
+    // Ctrl+Shift+F11 toggles the render profile overlay
+    if (nChar == VK_F11 && (GetKeyState(VK_CONTROL) & 0x8000) && (GetKeyState(VK_SHIFT) & 0x8000)) {
+        ShowRenderProfile(!m_showRenderProfile);
+        return;
+    }
+
+    // Ctrl+Shift+F9 records frames for the render benchmark
+    if (nChar == VK_F9 && (GetKeyState(VK_CONTROL) & 0x8000) && (GetKeyState(VK_SHIFT) & 0x8000)) {
+        StartRenderCapture();
+        return;
+    }
+
+    // Ctrl+Shift+F10 toggles keypress-to-photon measurement
+    if (nChar == VK_F10 && (GetKeyState(VK_CONTROL) & 0x8000) && (GetKeyState(VK_SHIFT) & 0x8000)) {
+        ShowInputLatency(!m_showInputLatency);
+        return;
+    }
+
+    // Ctrl+Shift+Up/Down jump between prompts, Ctrl+Shift+O selects the
+    // last command's output (shell integration marks)
+    if ((nChar == VK_UP || nChar == VK_DOWN || nChar == 'O') && (GetKeyState(VK_CONTROL) & 0x8000) &&
+        (GetKeyState(VK_SHIFT) & 0x8000)) {
+        if (nChar == 'O') {
+            SelectCommandOutput();
+        } else {
+            JumpToPrompt(nChar == VK_UP ? -1 : 1);
+        }
+        return;
+    }
+
+    // Ctrl shows the link under a resting mouse
+    if (nChar == VK_CONTROL && !(nFlags & KF_REPEAT)) {
+        CPoint point;
+        if (::GetCursorPos(&point) && ScreenToClient(&point)) {
+            UpdateHoverLink(point, true);
+        }
+    }
+
+    m_scheduler.NoteInput();
+    if (nChar != VK_SHIFT && nChar != VK_CONTROL && nChar != VK_MENU) {
+        if (m_inputLatency) {
+            m_inputLatency->BeginKey();
+        }
+        ScrollToBottom();
+    }
+    if (SendKeyToTerminal(nChar, nFlags, WM_CHAR)) {
+        FlushInputIfIdle();
+    }
+}
+
+void TerminalView::OnSysKeyDown(UINT nChar, UINT /*nRepCnt*/, UINT nFlags) {
+    // Alt+letter, Alt+cursor keys and F10 go to the application; Alt+F4,
+    // Alt+Space and the like to the system
+    if (nChar == VK_MENU || nChar == VK_F4 || !SendKeyToTerminal(nChar, nFlags, WM_SYSCHAR)) {
+        SetMsgHandled(FALSE);
+        return;
+    }
+    m_scheduler.NoteInput();
+    ScrollToBottom();
+    FlushInputIfIdle();
 }
 
 void TerminalView::OnKeyUp(UINT nChar, UINT nRepCnt, UINT nFlags) {
     (void)nRepCnt;
-    (void)nChar;
     (void)nFlags;
     // Most terminals don't need key up events
+    if (nChar == VK_CONTROL) {
+        UpdateHoverLink(CPoint(), false);
+    }
+    FlushInputIfIdle();
 }
 
 void TerminalView::OnChar(UINT nChar, UINT nRepCnt, UINT nFlags) {
@@ -317,30 +1066,91 @@ void TerminalView::OnChar(UINT nChar, UINT nRepCnt, UINT nFlags) {
     (void)nFlags;
     
     // Skip control characters handled by OnKeyDown
-    if (nChar < 32 && nChar != '\r' && nChar != '\t') {
+    if ((nChar < 32 && nChar != '\r' && nChar != '\t') || nChar == 0x7F) {
         return;
     }
     
+    m_scheduler.NoteInput();
+    if (m_inputLatency) {
+        m_inputLatency->BeginKey();
+    }
     SendCharToTerminal(static_cast<wchar_t>(nChar));
+    FlushInputIfIdle();
 }
 
 void TerminalView::OnLButtonDown(UINT nFlags, CPoint point) {
+    // A click on another pane only focuses it
+    if (!m_panes.empty()) {
+        const uint32_t pane = HitTestPane(point);
+        if (pane != m_focusedPane) {
+            if (pane != 0) {
+                FocusPane(pane);
+            }
+            SetFocus();
+            return;
+        }
+    }
+
+    // The new output indicator goes back to the screen
+    if (m_scrollPixels > 0.0f && m_newOutput && point.x >= m_newOutputRect.left &&
+        point.x < m_newOutputRect.right && point.y >= m_newOutputRect.top && point.y < m_newOutputRect.bottom) {
+        ScrollBy(-m_scrollTarget);
+        SetFocus();
+        return;
+    }
+
+    // The overview strip scrolls the view to where it is pressed and dragged
+    if (HitTestOverview(point)) {
+        SetCapture();
+        m_overviewDrag = true;
+        ScrollToOverview(point.y);
+        SetFocus();
+        return;
+    }
+
+    // Ctrl+click opens a link instead of selecting
+    if ((nFlags & MK_CONTROL) && m_buffer && m_scrollPixels <= 0.0f) {
+        if (const Core::Link* link = m_links.HitTest(*m_buffer, PixelToRow(point.y), PixelToCol(point.x))) {
+            const Core::Link target = *link;
+            OpenLink(target);
+            return;
+        }
+    }
+
     SetCapture();
+    if (IsMouseReported(nFlags)) {
+        m_mousePressReported = true;
+        SendMouseButton(1, true, point, nFlags);
+        SetFocus();
+        return;
+    }
     
-    m_selection.startRow = PixelToRow(point.y);
+    m_selection.startLine = PixelToLine(point.y);
     m_selection.startCol = PixelToCol(point.x);
-    m_selection.endRow = m_selection.startRow;
+    m_selection.endLine = m_selection.startLine;
     m_selection.endCol = m_selection.startCol;
+    m_selection.epoch = m_buffer ? m_buffer->GetScrollbackEpoch() : 0;
     m_selection.active = false;
+    m_selection.block = GetKeyState(VK_MENU) < 0;
     m_isSelecting = true;
+    m_selectionChanged = true;
+    Invalidate();
     
     SetFocus();
 }
 
 void TerminalView::OnLButtonUp(UINT nFlags, CPoint point) {
-    (void)nFlags;
-    
     ReleaseCapture();
+    if (m_overviewDrag) {
+        m_overviewDrag = false;
+        return;
+    }
+    if (m_mousePressReported) {
+        m_mousePressReported = false;
+        SendMouseButton(1, false, point, nFlags);
+        return;
+    }
+
     m_isSelecting = false;
     
     if (m_selection.active) {
@@ -348,285 +1158,2231 @@ void TerminalView::OnLButtonUp(UINT nFlags, CPoint point) {
     }
 }
 
-void TerminalView::OnMouseMove(UINT nFlags, CPoint point) {
-    if (m_isSelecting && (nFlags & MK_LBUTTON)) {
-        m_selection.endRow = PixelToRow(point.y);
-        m_selection.endCol = PixelToCol(point.x);
-        m_selection.active = true;
+void TerminalView::OnMouseMove(UINT nFlags, CPoint point) {
+    if (m_overviewDrag) {
+        if (nFlags & MK_LBUTTON) {
+            ScrollToOverview(point.y);
+        }
+        return;
+    }
+    UpdateHoverLink(point, (nFlags & MK_CONTROL) != 0);
+    const bool buttonHeld = (nFlags & (MK_LBUTTON | MK_MBUTTON | MK_RBUTTON)) != 0;
+    UpdateLineTime(point, buttonHeld);
+
+    // Motion the application tracks is held until the next frame; a flood
+    // of WM_MOUSEMOVE costs one report per cell reached
+    if (IsMouseReported(nFlags) && !m_isSelecting &&
+        (m_mouseMode == MouseMode::Move || (m_mouseMode == MouseMode::Drag && buttonHeld))) {
+        const Emulation::MouseEvent event = MakeMouseEvent(point, nFlags);
+        if (event.row != m_mouseRow || event.col != m_mouseCol) {
+            m_pendingMotion = event;
+            if (m_scheduler.IsAttached()) {
+                m_scheduler.RequestFrame();
+            } else {
+                FlushMouseMotion();
+            }
+        }
+        return;
+    }
+
+    if (m_isSelecting && (nFlags & MK_LBUTTON)) {
+        m_selection.endLine = PixelToLine(point.y);
+        m_selection.endCol = PixelToCol(point.x);
+        m_selection.active = true;
+        m_selectionChanged = true;
+
+        // Dragging past the top edge scrolls into history, past the bottom
+        // back toward the screen
+        const D2D1_RECT_F area = GetPaneRect();
+        if (m_renderer && point.y < area.top) {
+            ScrollBy(m_renderer->GetCellHeight());
+        } else if (m_renderer && point.y >= area.bottom && m_scrollTarget > 0.0f) {
+            ScrollBy(-m_renderer->GetCellHeight());
+        }
+        Invalidate();
+    }
+}
+
+BOOL TerminalView::OnMouseWheel(UINT nFlags, short zDelta, CPoint pt) {
+    // Ctrl+wheel zooms, whoever gets the wheel otherwise
+    if ((nFlags & MK_CONTROL) != 0) {
+        ZoomBy(kZoomStepPoints * zDelta / WHEEL_DELTA);
+        return TRUE;
+    }
+
+    // Wheel reports as buttons 4 (up) and 5 (down); pt is in screen coordinates
+    if (IsMouseReported(nFlags)) {
+        ScreenToClient(&pt);
+        SendMouseButton(zDelta > 0 ? 4 : 5, true, pt, nFlags);
+        return TRUE;
+    }
+    
+    if (!m_buffer || !m_renderer) {
+        return TRUE;
+    }
+
+    // Scroll 3 lines per notch (precision touchpads send fractions of one);
+    // the view eases there over the next frames
+    ScrollBy(3.0f * m_renderer->GetCellHeight() * zDelta / WHEEL_DELTA);
+    m_hoverLink.reset();
+    return TRUE;
+}
+
+BOOL TerminalView::OnSetCursor(CWindow wnd, UINT nHitTest, UINT message) {
+    (void)wnd;
+    (void)message;
+    if (m_hoverLink && nHitTest == HTCLIENT) {
+        ::SetCursor(::LoadCursor(nullptr, IDC_HAND));
+        return TRUE;
+    }
+    if (nHitTest == HTCLIENT) {
+        const DWORD position = GetMessagePos();
+        CPoint point(static_cast<short>(LOWORD(position)), static_cast<short>(HIWORD(position)));
+        ScreenToClient(&point);
+        if (HitTestOverview(point)) {
+            ::SetCursor(::LoadCursor(nullptr, IDC_ARROW));
+            return TRUE;
+        }
+    }
+    SetMsgHandled(FALSE);
+    return FALSE;
+}
+
+// ============================================================================
+// Rendering
+// ============================================================================
+
+void TerminalView::Render() {
+    if (!m_renderer || !m_renderer->IsInitialized() || !m_buffer || IsSuspended()) {
+        return;
+    }
+    Core::PipelineActivity activity(Core::PipelineStage::Render, m_traceSessionId);
+    RenderFrame();
+    activity.SetRows(m_profiler.GetDirtyRows());
+}
+
+void TerminalView::RenderFrame() {
+    Core::AllocScope allocScope(Core::AllocSubsystem::Render);
+    m_profiler.BeginFrame();
+
+    // Glyphs finished on the worker threads replace the cells drawn blank
+    if (m_renderer->LandGlyphs()) {
+        m_frameStale = true;
+    }
+    if (m_inputLatency) {
+        m_inputLatency->Mark(Core::LatencyPoint::Rendered);
+    }
+
+    // The selection's line numbers no longer name its text
+    if (m_selection.active && m_selection.epoch != m_buffer->GetScrollbackEpoch()) {
+        m_selection.active = false;
+        m_selectionChanged = true;
+    }
+
+    (void)ReconcilePredictions();
+
+    // Rows the frame is about to clear are text changed; the event is
+    // raised once kTextChangedMs later, for whatever changed meanwhile
+    if (m_textProvider && !m_textChangePending &&
+        (m_buffer->HasDirty() || m_buffer->GetPendingScroll().lines != 0) && UiaClientsAreListening()) {
+        m_textChangePending = true;
+        StartTimer(TIMER_TEXT_CHANGED, kTextChangedMs);
+    }
+
+    if (m_scrollPixels > 0.0f || m_scrollTarget > 0.0f) {
+        StepScroll();
+        if (m_scrollPixels > 0.0f) {
+            RenderHistory();
+            return;
+        }
+    }
+    if (m_capture) {
+        CaptureFrame();
+    }
+
+    // The shader draws one grid over the whole window: not split panes
+    CellGridRenderer* grid = m_renderer->GetCellGrid();
+    if (grid && m_panes.empty()) {
+        RenderGrid(*grid);
+        return;
+    }
+
+    float scrolled = 0.0f;
+    const bool reported = UpdateFrame(scrolled);
+    m_buffer->TouchScrollback();
+
+    if (!m_renderer->BeginDraw()) {
+        return;
+    }
+    m_profiler.Mark(RenderPhase::Present);
+
+    // A resize or zoom preview leaves part of the window outside the frame
+    if (m_resizePending || m_renderer->GetPreviewScale() != 1.0f) {
+        m_renderer->Clear();
+    }
+    m_renderer->DrawFrame();
+
+    // Overlays: drawn over the frame every paint, never into it
+    const bool imagesShown = RenderImages();
+    const bool highlightsShown = RenderRuleHighlights();
+    const D2D1_RECT_F selectionBand = RenderSelection();
+    const bool linkShown = RenderHoverLink();
+    const bool timeShown = RenderLineTime();
+    const bool echoShown = RenderPredictions();
+
+    const bool cursorShown = IsCursorShown();
+    if (cursorShown) {
+        RenderCursor();
+    }
+
+    const bool imeShown = RenderImeComposition();
+
+    // Render diagnostics overlays on top
+    RenderOverlays();
+
+    // Besides the rows UpdateFrame reported, the cursor's old cell (and
+    // where a scroll carried its image) and its new cell change
+    D2D1_RECT_F cursorCell{};
+    if (cursorShown && m_vterm) {
+        int cursorRow = 0;
+        int cursorCol = 0;
+        GetShownCursor(cursorRow, cursorCol);
+        const float x = ColToPixel(cursorCol);
+        const float y = RowToPixel(cursorRow);
+        cursorCell = D2D1::RectF(x, y, x + m_renderer->GetCellWidth(), y + m_renderer->GetCellHeight());
+    }
+
+    if (!reported || m_resizePending || m_showDiagnostics || m_showRenderProfile || m_showInputLatency ||
+        m_capture || !m_captureNotice.empty() || m_windowStale || imeShown || m_imeDrawn || linkShown ||
+        m_hoverDrawn || timeShown || m_timeDrawn || highlightsShown || m_highlightsDrawn || imagesShown ||
+        m_imagesDrawn || echoShown || m_echoDrawn) {
+        m_renderer->PresentWholeWindow();
+    } else {
+        const auto report = [this](const D2D1_RECT_F& rect, float dy) {
+            if (rect.bottom > rect.top) {
+                m_renderer->AddDirtyRect(rect.left, rect.top + dy, rect.right - rect.left,
+                                         rect.bottom - rect.top);
+            }
+        };
+        if (m_cursorDrawn) {
+            report(m_cursorCell, 0.0f);
+            if (scrolled != 0.0f) {
+                report(m_cursorCell, scrolled);
+            }
+        }
+        if (cursorShown && m_vterm) {
+            report(cursorCell, 0.0f);
+        }
+
+        // The selection likewise, when it changed or the frame moved under it
+        if (m_selectionChanged || scrolled != 0.0f) {
+            report(m_selectionBand, 0.0f);
+            if (scrolled != 0.0f) {
+                report(m_selectionBand, scrolled);
+            }
+            report(selectionBand, 0.0f);
+        }
+    }
+    m_cursorCell = cursorCell;
+    m_cursorDrawn = cursorShown && m_vterm;
+    m_selectionBand = selectionBand;
+    m_selectionChanged = false;
+    m_imeDrawn = imeShown;
+    m_hoverDrawn = linkShown;
+    m_timeDrawn = timeShown;
+    m_highlightsDrawn = highlightsShown;
+    m_imagesDrawn = imagesShown;
+    m_echoDrawn = echoShown;
+    m_windowStale = false;
+
+    EndDraw();
+}
+
+bool TerminalView::UpdateFrame(float& scrolled) {
+    // Losing the frame loses every pane's region
+    const bool frameLost = m_frameStale || !m_renderer->IsFrameRetained();
+    bool repaintAll = frameLost || m_buffer->GetRows() != m_frameRows || m_buffer->GetCols() != m_frameCols;
+    const D2D1_RECT_F area = GetPaneRect();
+
+    // Move pixels of scrolled rows instead of repainting them
+    scrolled = 0.0f;
+    const Core::PendingScroll& scroll = m_buffer->GetPendingScroll();
+    if (!repaintAll && scroll.lines != 0) {
+        const float top = RowToPixel(scroll.top);
+        const float height = RowToPixel(scroll.bottom) - top;
+        scrolled = -static_cast<float>(scroll.lines) * m_renderer->GetCellHeight();
+        repaintAll = !m_renderer->ScrollFrame(area.left, top, area.right - area.left, height, scrolled);
+    }
+    for (Pane& pane : m_panes) {
+        pane.stale = pane.stale || frameLost || !ScrollPane(pane);
+    }
+    m_profiler.Mark(RenderPhase::Sync);
+
+    if (!m_renderer->BeginFrame()) {
+        return false;
+    }
+
+    const int rows = m_buffer->GetRows();
+    if (repaintAll) {
+        if (frameLost) {
+            m_renderer->Clear();
+            RenderDividers();
+        } else {
+            m_renderer->ClearRect(area.left, area.top, area.right - area.left, area.bottom - area.top);
+            m_renderer->AddDirtyRect(area.left, area.top, area.right - area.left, area.bottom - area.top);
+        }
+        for (int row = 0; row < rows; ++row) {
+            RenderRow(row);
+        }
+        m_profiler.AddDirtyRows(static_cast<uint32_t>(rows));
+    } else {
+        // Only the changed columns of rows changed since the last frame
+        // (including rows exposed by the scroll above)
+        RenderDamage(*m_buffer, area.right);
+    }
+    for (Pane& pane : m_panes) {
+        RenderPane(pane);
+    }
+
+    const bool ended = m_renderer->EndFrame();
+    m_profiler.Mark(RenderPhase::Build);
+    if (!ended) {
+        return false;
+    }
+
+    m_buffer->ClearDirty();
+    m_frameStale = false;
+    m_frameRows = rows;
+    m_frameCols = m_buffer->GetCols();
+    return !frameLost;
+}
+
+void TerminalView::RenderDamage(Core::TerminalBuffer& buffer, float right) {
+    const float cellHeight = m_renderer->GetCellHeight();
+    const int cols = buffer.GetCols();
+
+    for (int row = buffer.NextDirtyRow(0); row >= 0; row = buffer.NextDirtyRow(row + 1)) {
+        Core::DirtySpan span = buffer.GetDirtySpan(row);
+
+        // Widen to whole wide characters on both edges
+        if (span.startCol > 0 && buffer.GetCell(row, span.startCol).width == 0) {
+            --span.startCol;
+        }
+        if (span.endCol < cols && buffer.GetCell(row, span.endCol).width == 0) {
+            ++span.endCol;
+        }
+
+        // A span ending at the last column runs to the pane's edge
+        const float left = ColToPixel(span.startCol);
+        const float spanRight = span.endCol >= cols ? right : ColToPixel(span.endCol);
+        m_renderer->ClearRect(left, RowToPixel(row), spanRight - left, cellHeight);
+        m_renderer->AddDirtyRect(left, RowToPixel(row), spanRight - left, cellHeight);
+        RenderCells(buffer.GetRow(row), buffer.GetStyleRuns(row), RowToPixel(row), span.startCol, span.endCol);
+        m_profiler.AddDirtyRows(1);
+    }
+}
+
+void TerminalView::RenderRow(int row, int startCol, int endCol) {
+    if (!m_buffer || !m_renderer) return;
+
+    RenderCells(m_buffer->GetRow(row), m_buffer->GetStyleRuns(row), RowToPixel(row), startCol, endCol);
+}
+
+void TerminalView::RenderCells(std::span<const Core::Cell> cells, std::span<const Core::StyleRun> runs, float y,
+                               int startCol, int endCol, bool backgrounds) {
+    float cellWidth = m_renderer->GetCellWidth();
+    float cellHeight = m_renderer->GetCellHeight();
+
+    const int width = static_cast<int>(cells.size());
+    const int first = std::max(startCol, 0);
+    const int cols = endCol < 0 ? width : std::min(endCol, width);
+    if (first >= cols) {
+        return;
+    }
+
+    // Screen rows come with their style runs; other lines are split here.
+    // Colors, faces and decorations are resolved once per run.
+    if (runs.empty()) {
+        m_styleRuns.clear();
+        Core::AppendStyleRuns(cells, static_cast<size_t>(first), static_cast<size_t>(cols), m_styleRuns);
+        runs = m_styleRuns;
+    }
+
+    // Calls visit(cell whose style the run has, start, end) for the part of
+    // each run within [first, cols)
+    const auto forEachRun = [&](auto&& visit) {
+        for (const Core::StyleRun& run : runs) {
+            if (run.start >= cols) {
+                break;
+            }
+            const int start = std::max<int>(run.start, first);
+            const int end = std::min(run.End(), cols);
+            if (start < end) {
+                visit(cells[run.start], start, end);
+            }
+        }
+    };
+
+    // Reverse video swaps a cell's colors; a default background becomes
+    // the default foreground
+    const auto foregroundOf = [this](const Core::Cell& cell, Core::CellAttributes attrs) -> const ResolvedColor& {
+        return attrs.reverse ? m_palette.Resolve(cell.bg, false) : m_palette.Resolve(cell.fg, true);
+    };
+
+    // Backgrounds: one rectangle per stretch of runs with the same fill.
+    // Continuation cells are in the run of the wide cell they belong to.
+    if (backgrounds) {
+        std::optional<ResolvedColor> runFill;
+        int fillStart = first;
+        int fillEnd = first;
+        const auto flushFill = [&]() {
+            if (runFill && fillEnd > fillStart) {
+                m_renderer->FillRect(ColToPixel(fillStart), y, cellWidth * (fillEnd - fillStart), cellHeight,
+                                     runFill->color);
+            }
+        };
+        forEachRun([&](const Core::Cell& style, int start, int end) {
+            std::optional<ResolvedColor> fill;
+            if (style.Attributes().reverse) {
+                fill = m_palette.Resolve(style.fg, true);
+            } else if (!style.bg.IsDefault()) {
+                fill = m_palette.Resolve(style.bg, false);
+            }
+            if (fill != runFill) {
+                flushFill();
+                runFill = fill;
+                fillStart = start;
+            }
+            fillEnd = end;
+        });
+        flushFill();
+    }
+
+    // Text: one glyph run per stretch of narrow cells with the same color and
+    // face. Blanks join any run; wide characters are drawn on their own.
+    ResolvedColor runFg;
+    FontVariant runVariant = FontVariant::Regular;
+    int runStart = first;
+    bool runInk = false;
+    bool decorated = false;
+    const auto flushRun = [&]() {
+        while (!m_runText.empty() && m_runText.back() == U' ') {
+            m_runText.pop_back();
+        }
+        if (runInk) {
+            m_renderer->DrawTextRun(m_runText, ColToPixel(runStart), y, runFg.color, runVariant);
+        }
+        m_runText.clear();
+        runInk = false;
+    };
+
+    // Two kernels, picked once per row: in a row of narrow ASCII characters
+    // (most rows) each run's codes are copied straight into the text run,
+    // its color and face compared once per run; any other row tests each
+    // cell for continuations, combining marks and unusual widths
+    const auto drawText = [&]<bool Mixed>(std::bool_constant<Mixed>) {
+        forEachRun([&](const Core::Cell& style, int start, int end) {
+            const Core::CellAttributes attrs = style.Attributes();
+            const ResolvedColor fgColor = foregroundOf(style, attrs);
+            const auto variant = static_cast<FontVariant>((attrs.bold ? 1 : 0) | (attrs.italic ? 2 : 0));
+            decorated |= attrs.underline != 0 || attrs.strikethrough;
+
+            if constexpr (!Mixed) {
+                // A change of color or face ends the text run at the run's
+                // first ink; the blanks before it would be trimmed anyway
+                int ink = start;
+                while (ink < end && cells[ink].code == U' ') {
+                    ++ink;
+                }
+                int from = start;
+                if (ink < end) {
+                    if (runInk && (fgColor != runFg || variant != runVariant)) {
+                        flushRun();
+                        from = ink;
+                    }
+                    if (!runInk) {
+                        runFg = fgColor;
+                        runVariant = variant;
+                        runInk = true;
+                    }
+                }
+                if (m_runText.empty()) {
+                    runStart = from;
+                }
+                const size_t at = m_runText.size();
+                m_runText.resize(at + static_cast<size_t>(end - from));
+                uint32_t* out = m_runText.data() + at;
+                for (int col = from; col < end; ++col) {
+                    *out++ = cells[col].code;
+                }
+                return;
+            }
+
+            for (int col = start; col < end; ++col) {
+                const auto& cell = cells[col];
+
+                // Skip continuation cells
+                if (cell.width == 0) continue;
+
+                const uint32_t cp = cell.Codepoint();
+
+                // Combining characters are shaped with their base, on their own
+                if (cell.HasCombining()) {
+                    flushRun();
+                    const std::span<const uint32_t> combining = cell.Combining();
+                    uint32_t chars[1 + Core::GraphemeTable::kMaxCombining] = {cp};
+                    std::copy(combining.begin(), combining.end(), chars + 1);
+                    m_renderer->DrawGrapheme(cell.GraphemeIndex(), {chars, 1 + combining.size()}, ColToPixel(col),
+                                             y, fgColor.color, cell.width, variant);
+                    continue;
+                }
+
+                // Runs advance one cell per codepoint; a character the
+                // emulator's table does not count as one column (a zero-width
+                // character left without a base, a control) is drawn on its own
+                if (cell.width != 1 || (cp > 0x7F && Emulation::UnicodeTable::GetWidth(cp) != 1)) {
+                    flushRun();
+                    if (cp != U' ') {
+                        m_renderer->DrawChar(cp, ColToPixel(col), y, fgColor.color, cell.width, variant);
+                    }
+                    continue;
+                }
+
+                if (cp != U' ') {
+                    if (runInk && (fgColor != runFg || variant != runVariant)) {
+                        flushRun();
+                    }
+                    if (!runInk) {
+                        runFg = fgColor;
+                        runVariant = variant;
+                        runInk = true;
+                    }
+                }
+                if (m_runText.empty()) {
+                    runStart = col;
+                }
+                m_runText.push_back(cp);
+            }
+        });
+    };
+
+    if (IsNarrowAscii(cells.subspan(static_cast<size_t>(first), static_cast<size_t>(cols - first)))) {
+        drawText(std::false_type{});
+    } else {
+        drawText(std::true_type{});
+    }
+    flushRun();
+
+    // Decorations: one line per stretch of runs with the same style and
+    // color, underlines first, then strikethrough over the text
+    for (int layer = 0; layer < 2 && decorated; ++layer) {
+        TextDecoration runDecoration = TextDecoration::None;
+        ResolvedColor runColor;
+        int decorationStart = first;
+        int decorationEnd = first;
+        const auto flushDecoration = [&]() {
+            if (runDecoration != TextDecoration::None) {
+                m_renderer->DrawDecoration(runDecoration, ColToPixel(decorationStart), y,
+                                           decorationEnd - decorationStart, runColor.color);
+            }
+        };
+        forEachRun([&](const Core::Cell& style, int start, int end) {
+            const Core::CellAttributes attrs = style.Attributes();
+            const TextDecoration decoration = layer == 0 ? static_cast<TextDecoration>(attrs.underline)
+                                            : attrs.strikethrough ? TextDecoration::Strikethrough
+                                            : TextDecoration::None;
+            ResolvedColor color;
+            if (decoration != TextDecoration::None) {
+                color = foregroundOf(style, attrs);
+            }
+            if (decoration != runDecoration || color != runColor) {
+                flushDecoration();
+                runDecoration = decoration;
+                runColor = color;
+                decorationStart = start;
+            }
+            decorationEnd = end;
+        });
+        flushDecoration();
+    }
+}
+
+void TerminalView::RenderGrid(CellGridRenderer& grid) {
+    const int rows = m_buffer->GetRows();
+    const int cols = m_buffer->GetCols();
+    m_buffer->TouchScrollback();
+    m_profiler.Mark(RenderPhase::Sync);
+
+    // Glyphs are found after BeginDraw so the atlas keeps them this frame
+    if (!m_renderer->BeginDraw()) {
+        return;
+    }
+    m_profiler.Mark(RenderPhase::Present);
+
+    // Every row after a layout change or scroll, or once glyphs the grid
+    // holds may have moved in the atlas; otherwise only the changed rows
+    const bool resized = grid.GetRows() != rows || grid.GetCols() != cols;
+    if (resized) {
+        grid.Resize(cols, rows);
+    }
+    const uint64_t generation = m_renderer->GetAtlasGeneration();
+    const bool all = m_frameStale || resized || m_buffer->GetPendingScroll().lines != 0 ||
+                     generation != m_gridGeneration;
+    if (all) {
+        for (int row = 0; row < rows; ++row) {
+            BuildGridRow(grid, row);
+        }
+        m_profiler.AddDirtyRows(static_cast<uint32_t>(rows));
+    } else {
+        for (int row = m_buffer->NextDirtyRow(0); row >= 0; row = m_buffer->NextDirtyRow(row + 1)) {
+            BuildGridRow(grid, row);
+            m_profiler.AddDirtyRows(1);
+        }
+
+        // Finding glyphs for those rows may have evicted ones other rows use
+        if (m_renderer->GetAtlasGeneration() != generation) {
+            for (int row = 0; row < rows; ++row) {
+                BuildGridRow(grid, row);
+            }
+            m_profiler.AddDirtyRows(static_cast<uint32_t>(rows));
+        }
+    }
+    m_gridGeneration = m_renderer->GetAtlasGeneration();
+    m_profiler.Mark(RenderPhase::Build);
+
+    const bool cursorShown = IsCursorShown();
+    int cursorRow = 0;
+    int cursorCol = 0;
+    GridCursor cursor = GridCursor::None;
+    if (cursorShown && m_vterm) {
+        GetShownCursor(cursorRow, cursorCol);
+        cursor = m_cursorStyle == CursorStyle::Block ? GridCursor::Block
+               : m_cursorStyle == CursorStyle::Underline ? GridCursor::Underline
+               : GridCursor::Bar;
+    }
+    grid.SetCursor(cursor, cursorRow, cursorCol, m_cursorColor.rgba);
+
+    // The shader sees the part of the selection on the screen
+    Selection selection = m_selection;
+    selection.Normalize();
+    const auto screen = static_cast<int64_t>(m_buffer->GetScreenLine());
+    int startRow = 0;
+    int startCol = 0;
+    int endRow = 0;
+    int endCol = 0;
+    if (selection.active && selection.endLine >= screen && selection.startLine < screen + rows) {
+        startRow = selection.startLine < screen ? 0 : static_cast<int>(selection.startLine - screen);
+        startCol = selection.startLine < screen ? 0 : selection.startCol;
+        endRow = selection.endLine >= screen + rows ? rows - 1 : static_cast<int>(selection.endLine - screen);
+        endCol = selection.endLine >= screen + rows ? cols : selection.endCol;
+        if (selection.block) {
+            // Clipped to the screen's rows, never its columns
+            startCol = std::clamp(selection.startCol, 0, cols);
+            endCol = std::clamp(selection.endCol, startCol, cols);
+        }
+    }
+    grid.SetSelection(startRow, startCol, endRow, endCol, m_selectionColor.rgba, selection.block);
+
+    m_renderer->DrawCellGrid();
+    (void)RenderImages();
+    (void)RenderRuleHighlights();
+    (void)RenderHoverLink();
+    (void)RenderPredictions();
+    (void)RenderImeComposition();
+    RenderOverlays();
+
+    // The shader redraws the whole window
+    m_renderer->PresentWholeWindow();
+    m_cursorDrawn = false;
+    EndDraw();
+
+    m_buffer->ClearDirty();
+    m_frameStale = false;
+}
+
+void TerminalView::EndDraw() {
+    m_profiler.Mark(RenderPhase::Draw);
+    {
+        Core::PipelineActivity activity(Core::PipelineStage::Present, m_traceSessionId);
+        activity.SetRows(m_profiler.GetDirtyRows());
+        m_renderer->EndDraw();
+    }
+    m_profiler.Mark(RenderPhase::Present);
+    m_profiler.EndFrame(m_renderer->TakeCounters());
+    Core::StartupTrace::Shared().Mark(Core::StartupPhase::FirstFrame);
+    if (m_inputLatency) {
+        m_inputLatency->Present();
+    }
+
+    // Covered: render nothing more until a test present finds the window
+    // showing again (TIMER_OCCLUSION)
+    if (m_renderer->IsOccluded() && !m_occluded) {
+        m_occluded = true;
+        StartTimer(TIMER_OCCLUSION, kOcclusionPollMs);
+    }
+    if (m_renderer->GetDeviceGeneration() == m_deviceGeneration) {
+        return;
+    }
+    m_deviceGeneration = m_renderer->GetDeviceGeneration();
+
+    // The device was lost: this frame never reached the window, and the
+    // retained frame and hidden buffers' frames went with it. Paint a whole
+    // frame on the new device right away instead of leaving the window
+    // blank until the next output; glyphs and brushes return in between.
+    m_hiddenFrames.clear();
+    m_frameStale = true;
+    m_windowStale = true;
+    StartTimer(TIMER_DEVICE_RESTORE, kDeviceRestoreMs);
+    Invalidate();
+}
+
+void TerminalView::BuildGridRow(CellGridRenderer& grid, int row) {
+    GridCell* cells = grid.GetRow(row);
+    const int cols = std::min(grid.GetCols(), m_buffer->GetCols());
+
+    const AtlasGlyph* glyph = nullptr;
+    for (int col = 0; col < cols; ++col) {
+        const auto& cell = m_buffer->GetCell(row, col);
+        GridCell& out = cells[col];
+
+        // A continuation cell shows the right half of the wide glyph
+        if (cell.width == 0) {
+            if (col > 0) {
+                out = cells[col - 1];
+                out.glyph = grid.PackGlyph(glyph, 1);
+            }
+            continue;
+        }
+
+        const Core::CellAttributes attrs = cell.Attributes();
+        out.fg = m_palette.Resolve(cell.fg, true).rgba;
+        out.bg = m_palette.Resolve(cell.bg, false).rgba;
+        if (attrs.reverse) {
+            std::swap(out.fg, out.bg);
+        }
+        out.flags = (attrs.underline & CellGridRenderer::kFlagUnderlineMask) |
+                    (attrs.strikethrough ? CellGridRenderer::kFlagStrikethrough : 0);
+
+        const uint32_t cp = cell.Codepoint();
+        const auto variant = static_cast<FontVariant>((attrs.bold ? 1 : 0) | (attrs.italic ? 2 : 0));
+        if (cell.HasCombining()) {
+            const std::span<const uint32_t> combining = cell.Combining();
+            uint32_t chars[1 + Core::GraphemeTable::kMaxCombining] = {cp};
+            std::copy(combining.begin(), combining.end(), chars + 1);
+            glyph = m_renderer->FindSequenceGlyph(cell.GraphemeIndex(), {chars, 1 + combining.size()},
+                                                  cell.width, variant);
+        } else {
+            glyph = cp != U' ' ? m_renderer->FindGlyph(cp, cell.width, variant) : nullptr;
+        }
+        out.glyph = grid.PackGlyph(glyph, 0);
+    }
+    grid.MarkRowDirty(row);
+}
+
+void TerminalView::RenderCursor() {
+    if (!m_buffer || !m_renderer || !m_vterm) return;
+    
+    int cursorRow, cursorCol;
+    GetShownCursor(cursorRow, cursorCol);
+    
+    float x = ColToPixel(cursorCol);
+    float y = RowToPixel(cursorRow);
+    float cellWidth = m_renderer->GetCellWidth();
+    float cellHeight = m_renderer->GetCellHeight();
+    
+    switch (m_cursorStyle) {
+        case CursorStyle::Block:
+            m_renderer->FillRect(x, y, cellWidth, cellHeight, m_cursorColor.color);
+            break;
+        case CursorStyle::Underline:
+            m_renderer->FillRect(x, y + cellHeight - 2, cellWidth, 2, m_cursorColor.color);
+            break;
+        case CursorStyle::Bar:
+            m_renderer->FillRect(x, y, 2, cellHeight, m_cursorColor.color);
+            break;
+    }
+}
+
+bool TerminalView::RenderRuleHighlights(float offset) {
+    if (!m_outputRules || m_outputRules->IsEmpty()) {
+        return false;
+    }
+
+    // Lines in view, as for the selection
+    const D2D1_RECT_F area = GetPaneRect();
+    const float cellHeight = m_renderer->GetCellHeight();
+    const auto screen = static_cast<int64_t>(m_buffer->GetScreenLine());
+    const int64_t top = std::max<int64_t>(0, screen + static_cast<int64_t>(std::floor(-offset / cellHeight)));
+    const int64_t bottom = screen + std::min<int64_t>(m_buffer->GetRows() - 1,
+                                                      static_cast<int64_t>((area.bottom - area.top - offset) / cellHeight));
+    if (top > bottom) {
+        return false;
+    }
+    m_highlights.clear();
+    m_outputRules->FindHighlights(static_cast<uint64_t>(top), static_cast<uint64_t>(bottom), m_highlights);
+
+    // A wash over the line, leaving its text readable
+    const float width = ColToPixel(m_buffer->GetCols()) - ColToPixel(0);
+    for (const Core::LineHighlight& highlight : m_highlights) {
+        Color color = ColorPalette::FromRgb(highlight.color).color;
+        color.a = 0.35f;
+        const float y = RowToPixel(0) + offset +
+                        static_cast<float>(static_cast<int64_t>(highlight.line) - screen) * cellHeight;
+        m_renderer->FillRect(ColToPixel(0), y, width, cellHeight, color);
+    }
+    return !m_highlights.empty();
+}
+
+bool TerminalView::RenderImages(float offset) {
+    // The primary screen's images stay under a full-screen program
+    if (m_buffer->GetImageCount() == 0 || m_buffer->IsAlternateScreen()) {
+        return false;
+    }
+
+    // Lines in view, as for the selection
+    const D2D1_RECT_F area = GetPaneRect();
+    const float cellHeight = m_renderer->GetCellHeight();
+    const auto screen = static_cast<int64_t>(m_buffer->GetScreenLine());
+    const int64_t top = std::max<int64_t>(0, screen + static_cast<int64_t>(std::floor(-offset / cellHeight)));
+    const int64_t bottom = screen + std::min<int64_t>(m_buffer->GetRows() - 1,
+                                                      static_cast<int64_t>((area.bottom - area.top - offset) / cellHeight));
+    if (top > bottom) {
+        return false;
+    }
+    m_imagePlacements.clear();
+    m_buffer->FindImages(static_cast<uint64_t>(top), static_cast<uint64_t>(bottom) + 1, m_imagePlacements);
+
+    // One device pixel per image pixel, clipped to the pane; an image not
+    // decoded yet, or dropped, draws nothing
+    const std::shared_ptr<Core::ImageStore>& store = m_buffer->GetImageStore();
+    bool drawn = false;
+    m_renderer->PushClip(area.left, area.top, area.right - area.left, area.bottom - area.top);
+    for (const Core::ImagePlacement& placement : m_imagePlacements) {
+        const std::shared_ptr<const Core::DecodedImage> image = store->Get(placement.image);
+        if (!image) {
+            continue;
+        }
+        const float y = RowToPixel(0) + offset +
+                        static_cast<float>(static_cast<int64_t>(placement.line) - screen) * cellHeight;
+        m_renderer->DrawImage(image, image->pixels, image->width, image->height, ColToPixel(placement.col), y,
+                              static_cast<float>(image->width) / m_renderer->GetDpiScaleX(),
+                              static_cast<float>(image->height) / m_renderer->GetDpiScaleY());
+        drawn = true;
+    }
+    m_renderer->PopClip();
+    return drawn;
+}
+
+void TerminalView::UpdateCellPixelSize() {
+    if (!m_renderer) {
+        return;
+    }
+    const int width = static_cast<int>(std::lround(m_renderer->GetCellWidth() * m_renderer->GetDpiScaleX()));
+    const int height = static_cast<int>(std::lround(m_renderer->GetCellHeight() * m_renderer->GetDpiScaleY()));
+    if (m_vterm) {
+        m_vterm->SetCellPixelSize(width, height);
+    }
+    for (Pane& pane : m_panes) {
+        if (pane.binding.vterm) {
+            pane.binding.vterm->SetCellPixelSize(width, height);
+        }
+    }
+}
+
+D2D1_RECT_F TerminalView::RenderSelection(float offset) {
+    Selection selection = m_selection;
+    selection.Normalize();
+    if (!selection.active) {
+        return D2D1_RECT_F{};
+    }
+
+    // Lines in view: the screen's rows at offset, scrollback lines above
+    const D2D1_RECT_F area = GetPaneRect();
+    const float cellHeight = m_renderer->GetCellHeight();
+    const auto screen = static_cast<int64_t>(m_buffer->GetScreenLine());
+    const auto top = screen + static_cast<int64_t>(std::floor(-offset / cellHeight));
+    const auto bottom = screen + std::min<int64_t>(m_buffer->GetRows() - 1,
+                                                   static_cast<int64_t>((area.bottom - area.top - offset) / cellHeight));
+    const int64_t firstLine = std::max(selection.startLine, top);
+    const int64_t lastLine = std::min(selection.endLine, bottom);
+    if (firstLine > lastLine) {
+        return D2D1_RECT_F{};
+    }
+    const auto lineY = [&](int64_t line) {
+        return RowToPixel(0) + offset + static_cast<float>(line - screen) * cellHeight;
+    };
+
+    // One span of columns per line: highlight it, then draw its text again
+    // over the highlight
+    for (int64_t line = firstLine; line <= lastLine; ++line) {
+        const std::span<const Core::Cell> cells = m_buffer->GetLine(static_cast<uint64_t>(line));
+        int startCol = 0;
+        int endCol = 0;
+        if (!selection.GetColumns(line, cells, startCol, endCol)) {
+            continue;
+        }
+
+        const float y = lineY(line);
+        m_renderer->FillRect(ColToPixel(startCol), y, ColToPixel(endCol) - ColToPixel(startCol), cellHeight,
+                             m_selectionColor.color);
+        RenderCells(cells, {}, y, startCol, endCol, false);
+    }
+
+    return D2D1::RectF(area.left, lineY(firstLine), area.right, lineY(lastLine + 1));
+}
+
+bool TerminalView::RenderImeComposition() {
+    if (m_imeComposition.empty() || !m_vterm) {
+        return false;
+    }
+
+    // Inline at the cursor, over whatever the cells there show
+    int cursorRow = 0;
+    int cursorCol = 0;
+    GetShownCursor(cursorRow, cursorCol);
+    const float x = ColToPixel(cursorCol);
+    const float y = RowToPixel(cursorRow);
+    const float cellHeight = m_renderer->GetCellHeight();
+
+    ComPtr<IDWriteTextLayout> layout = m_renderer->CreateTextLayout(m_imeComposition, 10000.0f, cellHeight);
+    if (!layout) {
+        return false;
+    }
+    DWRITE_TEXT_METRICS metrics{};
+    layout->GetMetrics(&metrics);
+
+    const Color& foreground = m_palette.GetDefaultFg().color;
+    m_renderer->FillRect(x, y, metrics.widthIncludingTrailingWhitespace, cellHeight,
+                         m_palette.GetDefaultBg().color);
+    m_renderer->DrawTextLayout(layout.Get(), x, y, foreground);
+    m_renderer->FillRect(x, y + cellHeight - 1.0f, metrics.widthIncludingTrailingWhitespace, 1.0f, foreground);
+    return true;
+}
+
+bool TerminalView::RenderPredictions() {
+    if (!m_echo.IsShown() || m_scrollPixels > 0.0f) {
+        return false;
+    }
+
+    // The predictions are on the cursor's row: draw the columns they span
+    // from a copy of it with the predicted characters in, underlined
+    const std::vector<Core::PredictedCell>& pending = m_echo.GetPending();
+    const int row = pending.front().row;
+    const std::span<const Core::Cell> cells = m_buffer->GetRow(row);
+    m_echoRow.assign(cells.begin(), cells.end());
+    int first = static_cast<int>(m_echoRow.size());
+    int last = -1;
+    for (const Core::PredictedCell& predicted : pending) {
+        if (predicted.row != row || predicted.col >= static_cast<int>(m_echoRow.size())) {
+            continue;
+        }
+        Core::Cell& cell = m_echoRow[predicted.col];
+        cell.Clear();
+        cell.SetCodepoint(predicted.codepoint);
+        Core::CellAttributes attrs;
+        attrs.underline = predicted.codepoint != U' ' ? 1 : 0;
+        cell.SetAttributes(attrs);
+        first = std::min(first, predicted.col);
+        last = std::max(last, predicted.col);
+    }
+    if (last < first) {
+        return false;
+    }
+
+    const float y = RowToPixel(row);
+    m_renderer->FillRect(ColToPixel(first), y, ColToPixel(last + 1) - ColToPixel(first), m_renderer->GetCellHeight(),
+                         m_palette.GetDefaultBg().color);
+    RenderCells(m_echoRow, {}, y, first, last + 1);
+    return true;
+}
+
+void TerminalView::GetShownCursor(int& row, int& col) const {
+    if (const auto predicted = m_echo.GetCursor()) {
+        row = predicted->first;
+        col = predicted->second;
+        return;
+    }
+    m_vterm->GetCursorPos(row, col);
+}
+
+bool TerminalView::ReconcilePredictions() {
+    if (!m_echo.HasPending() || !m_vterm || !m_buffer) {
+        return false;
+    }
+    int cursorRow = 0;
+    int cursorCol = 0;
+    m_vterm->GetCursorPos(cursorRow, cursorCol);
+    return m_echo.Reconcile(*m_buffer, cursorRow, cursorCol, Core::PerfClock::NowMicros());
+}
+
+void TerminalView::GetRenderMemory(Core::SessionMemory& memory) const noexcept {
+    if (!m_renderer) {
+        return;
+    }
+
+    size_t frameBytes = m_renderer->GetFrameBytes();
+    for (const HiddenFrame& hidden : m_hiddenFrames) {
+        frameBytes += hidden.frame.GetBytes();
+    }
+    for (const auto& [id, cached] : m_tiles) {
+        if (cached.tile.bitmap) {
+            const D2D1_SIZE_U size = cached.tile.bitmap->GetPixelSize();
+            frameBytes += static_cast<size_t>(size.width) * size.height * 4;
+        }
+    }
+    memory.frameBytes = frameBytes;
+    memory.atlasBytes = m_renderer->GetAtlasShareBytes();
+}
+
+void TerminalView::RenderDiagnostics() {
+    if (!m_diagnosticsSource) return;
+
+    const Core::SessionStats stats = m_diagnosticsSource();
+
+    std::vector<std::wstring> lines;
+    wchar_t line[128];
+
+    swprintf_s(line, L"in %s  out %s  conpty %s  early replies %llu", FormatBytes(stats.bytesIn).c_str(),
+               FormatBytes(stats.bytesOut).c_str(), Core::GetPseudoConsoleName(stats.console),
+               static_cast<unsigned long long>(stats.earlyReplies));
+    lines.emplace_back(line);
+
+    swprintf_s(line, L"shell cpu %.1f s  procs %u/%u  peak %s  io %s / %s",
+               stats.shell.cpuMicros / 1000000.0, stats.shell.activeProcesses, stats.shell.totalProcesses,
+               FormatBytes(stats.shell.peakMemory).c_str(), FormatBytes(stats.shell.readBytes).c_str(),
+               FormatBytes(stats.shell.writeBytes).c_str());
+    lines.emplace_back(line);
+
+    swprintf_s(line, L"reads %llu  mean %s  max %s  now %s",
+               static_cast<unsigned long long>(stats.readCount),
+               FormatBytes(stats.meanReadSize).c_str(), FormatBytes(stats.maxReadSize).c_str(),
+               FormatBytes(stats.readSize).c_str());
+    lines.emplace_back(line);
+
+    swprintf_s(line, L"buffer %s  peak %s  held %s", FormatBytes(stats.bufferedBytes).c_str(),
+               FormatBytes(stats.bufferHighWater).c_str(),
+               FormatBytes(stats.bufferReservedBytes).c_str());
+    lines.emplace_back(line);
+
+    swprintf_s(line, L"stall %.1f ms  parse %.1f ms / %llu", stats.stallMicros / 1000.0,
+               stats.parseMicros / 1000.0, static_cast<unsigned long long>(stats.parseCalls));
+    lines.emplace_back(line);
+
+    swprintf_s(line, L"latency %.2f ms  max %.2f ms%s", stats.lastLatencyMicros / 1000.0,
+               stats.maxLatencyMicros / 1000.0, stats.fastForward ? L"  [fast-forward]" : L"");
+    lines.emplace_back(line);
+
+    swprintf_s(line, L"scrollback %zu lines  mem %s  disk %s", stats.scrollbackLines,
+               FormatBytes(stats.scrollbackBytes).c_str(), FormatBytes(stats.scrollbackSpilled).c_str());
+    lines.emplace_back(line);
+
+    swprintf_s(line, L"budget %s / %s", FormatBytes(stats.budgetUsage).c_str(),
+               stats.budgetLimit != 0 ? FormatBytes(stats.budgetLimit).c_str() : L"unlimited");
+    lines.emplace_back(line);
+
+    swprintf_s(line, L"vterm %llu allocs  live %s  peak %s",
+               static_cast<unsigned long long>(stats.vtermAllocations),
+               FormatBytes(stats.vtermBytes).c_str(), FormatBytes(stats.vtermPeakBytes).c_str());
+    lines.emplace_back(line);
+
+    // Instrumented builds: the whole process's heap use by subsystem
+    if constexpr (Core::AllocTracker::kEnabled) {
+        const Core::AllocSnapshot allocs = Core::AllocTracker::Snapshot();
+        for (size_t i = 0; i < allocs.size(); ++i) {
+            swprintf_s(line, L"heap %-9hs %llu allocs  %s",
+                       Core::AllocTracker::GetName(static_cast<Core::AllocSubsystem>(i)),
+                       static_cast<unsigned long long>(allocs[i].allocations),
+                       FormatBytes(allocs[i].bytes).c_str());
+            lines.emplace_back(line);
+        }
+    }
+
+    RenderPanel(lines, PanelCorner::TopRight);
+}
+
+void TerminalView::RenderProfile() {
+    std::vector<std::wstring> lines;
+    wchar_t line[128];
+
+    swprintf_s(line, L"frame p50 %.2f  p95 %.2f  p99 %.2f  max %.2f ms",
+               m_profiler.Percentile(0.50) / 1000.0, m_profiler.Percentile(0.95) / 1000.0,
+               m_profiler.Percentile(0.99) / 1000.0, m_profiler.Percentile(1.0) / 1000.0);
+    lines.emplace_back(line);
+
+    const FrameProfile mean = m_profiler.Mean();
+    swprintf_s(line, L"sync %.2f  build %.2f  draw %.2f  present %.2f ms",
+               mean.phaseMicros[static_cast<size_t>(RenderPhase::Sync)] / 1000.0,
+               mean.phaseMicros[static_cast<size_t>(RenderPhase::Build)] / 1000.0,
+               mean.phaseMicros[static_cast<size_t>(RenderPhase::Draw)] / 1000.0,
+               mean.phaseMicros[static_cast<size_t>(RenderPhase::Present)] / 1000.0);
+    lines.emplace_back(line);
+
+    swprintf_s(line, L"draws %u  runs %u  dirty rows %u  (%zu frames)", mean.counters.drawCalls,
+               mean.counters.glyphRuns, mean.dirtyRows, m_profiler.GetFrameCount());
+    lines.emplace_back(line);
+
+    swprintf_s(line, L"atlas hits %.1f%%  brush hits %.1f%%", m_profiler.AtlasHitRate() * 100.0,
+               m_profiler.BrushHitRate() * 100.0);
+    lines.emplace_back(line);
+
+    RenderPanel(lines, PanelCorner::BottomRight);
+}
+
+void TerminalView::RenderInputLatency() {
+    if (!m_inputLatency) return;
+
+    std::vector<std::wstring> lines;
+    wchar_t line[128];
+
+    static constexpr std::pair<Core::LatencyStage, const wchar_t*> kStages[] = {
+        {Core::LatencyStage::Write, L"write"},     {Core::LatencyStage::Echo, L"echo"},
+        {Core::LatencyStage::Parse, L"parse"},     {Core::LatencyStage::Schedule, L"schedule"},
+        {Core::LatencyStage::Render, L"render"},   {Core::LatencyStage::Total, L"key-to-photon"},
+    };
+
+    swprintf_s(line, L"keys %llu  dropped %llu",
+               static_cast<unsigned long long>(m_inputLatency->GetHistogram(Core::LatencyStage::Total).GetCount()),
+               static_cast<unsigned long long>(m_inputLatency->GetDropped()));
+    lines.emplace_back(line);
+    if (m_echo.IsEnabled()) {
+        swprintf_s(line, L"predicted echo %6.2f ms  confirmed %llu  refuted %llu", m_echo.GetEchoMicros() / 1000.0,
+                   static_cast<unsigned long long>(m_echo.GetConfirmed()),
+                   static_cast<unsigned long long>(m_echo.GetRefuted()));
+        lines.emplace_back(line);
+    }
+
+    for (const auto& [stage, name] : kStages) {
+        const Core::LatencyHistogram& histogram = m_inputLatency->GetHistogram(stage);
+        swprintf_s(line, L"%-13s p50 %6.2f  p95 %6.2f  p99 %6.2f  max %6.2f ms", name,
+                   histogram.Percentile(0.50) / 1000.0, histogram.Percentile(0.95) / 1000.0,
+                   histogram.Percentile(0.99) / 1000.0, histogram.GetMax() / 1000.0);
+        lines.emplace_back(line);
+    }
+
+    RenderPanel(lines, PanelCorner::BottomLeft);
+}
+
+void TerminalView::RenderOverlays() {
+    if (m_showDiagnostics) {
+        RenderDiagnostics();
+    }
+    if (m_showRenderProfile) {
+        RenderProfile();
+    }
+    if (m_showInputLatency) {
+        RenderInputLatency();
+    }
+    if (m_capture) {
+        wchar_t line[64];
+        swprintf_s(line, L"Capturing frames: %d of %d", m_capture->GetFrames(), RenderCaptureWriter::kFrames);
+        RenderPanel({line, m_capture->GetPath()}, PanelCorner::TopRight);
+    } else if (!m_captureNotice.empty()) {
+        if (GetTickCount64() < m_captureNoticeEnd) {
+            RenderPanel({m_captureNotice}, PanelCorner::TopRight);
+        } else {
+            m_captureNotice.clear();
+            UpdateOverlayTimer();
+        }
+    }
+}
+
+void TerminalView::StartRenderCapture() {
+    if (m_capture || !m_renderer || !m_buffer) {
+        return;
+    }
+    RenderCaptureSetup setup;
+    setup.font = m_fontName;
+    setup.fontSize = GetZoomedSize(m_zoom);
+    setup.dpi = GetViewDpi();
+    setup.rows = m_buffer->GetRows();
+    setup.cols = m_buffer->GetCols();
+    setup.backend = m_renderer->GetBackend();
+    setup.cellGrid = m_renderer->GetCellGrid() != nullptr && m_panes.empty();
+    setup.ligatures = m_renderer->GetLigatures();
+
+    auto capture = std::make_unique<RenderCaptureWriter>();
+    if (!capture->Open(setup)) {
+        m_captureNotice = L"Render capture: cannot create " + capture->GetPath();
+        m_captureNoticeEnd = GetTickCount64() + kCaptureNoticeMs;
+    } else {
+        m_capture = std::move(capture);
+    }
+    UpdateOverlayTimer();
+}
+
+void TerminalView::CaptureFrame() {
+    Core::ScreenState state;
+    if (m_vterm) {
+        GetShownCursor(state.cursorRow, state.cursorCol);
+    }
+    state.cursorVisible = m_cursorVisible;
+    state.altScreen = m_buffer->IsAlternateScreen();
+
+    // The selection by screen row, as the buffer's lines are renumbered on
+    // replay
+    RenderCaptureFrame frame;
+    const auto screen = static_cast<int64_t>(m_buffer->GetScreenLine());
+    frame.cursorShown = IsCursorShown();
+    frame.selectionActive = m_selection.active;
+    frame.selectionBlock = m_selection.block;
+    frame.selectionStartLine = m_selection.startLine - screen;
+    frame.selectionStartCol = m_selection.startCol;
+    frame.selectionEndLine = m_selection.endLine - screen;
+    frame.selectionEndCol = m_selection.endCol;
+    if (m_capture->Add(*m_buffer, state, std::move(frame))) {
+        return;
+    }
+
+    wchar_t line[64];
+    swprintf_s(line, L"Render capture: %d frames written to ", m_capture->GetFrames());
+    m_captureNotice = line + m_capture->GetPath();
+    m_captureNoticeEnd = GetTickCount64() + kCaptureNoticeMs;
+    m_capture.reset();
+    UpdateOverlayTimer();
+}
+
+bool TerminalView::IsCursorShown() const {
+    if (m_replayCursor) {
+        return m_cursorVisible && *m_replayCursor;
+    }
+    return m_cursorVisible && m_hasFocus && (m_cursorBlinkState || m_cursorBlinkRate == 0);
+}
+
+unsigned TerminalView::GetViewDpi() const {
+    return m_dpiOverride != 0 ? m_dpiOverride : GetDpiForWindow(m_hWnd);
+}
+
+void TerminalView::SetDpi(unsigned dpi) {
+    m_dpiOverride = dpi;
+    BOOL handled = TRUE;
+    (void)OnDpiChangedAfterParent(WM_DPICHANGED_AFTERPARENT, 0, 0, handled);
+}
+
+void TerminalView::ApplyCapturedFrame(const RenderCaptureFrame& frame) {
+    if (!m_buffer) {
+        return;
+    }
+    const auto screen = static_cast<int64_t>(m_buffer->GetScreenLine());
+    m_selection.active = frame.selectionActive;
+    m_selection.block = frame.selectionBlock;
+    m_selection.startLine = screen + frame.selectionStartLine;
+    m_selection.startCol = frame.selectionStartCol;
+    m_selection.endLine = screen + frame.selectionEndLine;
+    m_selection.endCol = frame.selectionEndCol;
+    m_selection.epoch = m_buffer->GetScrollbackEpoch();
+    m_selectionChanged = true;
+    m_replayCursor = frame.cursorShown;
+}
+
+void TerminalView::RenderPanel(const std::vector<std::wstring>& lines, PanelCorner corner) {
+    // Panel in a corner of the window, sized in cells
+    const float cellWidth = m_renderer->GetCellWidth();
+    const float cellHeight = m_renderer->GetCellHeight();
+
+    size_t maxChars = 0;
+    for (const auto& text : lines) {
+        maxChars = std::max(maxChars, text.size());
+    }
+
+    CRect client;
+    GetClientRect(&client);
+
+    const float width = (maxChars + 2) * cellWidth;
+    const float height = (lines.size() + 1) * cellHeight;
+    const float x = corner == PanelCorner::BottomLeft ? 0.0f
+                                                      : std::max(0.0f, static_cast<float>(client.Width()) - width);
+    const float top = corner == PanelCorner::TopRight ? 0.0f
+                                                      : std::max(0.0f, static_cast<float>(client.Height()) - height);
+
+    m_renderer->FillRect(x, top, width, height, Color::FromRgb(0, 0, 0, 200));
+    m_renderer->DrawRect(x, top, width, height, Color::FromRgb(128, 128, 128));
+
+    float y = top + cellHeight * 0.5f;
+    for (const auto& text : lines) {
+        m_renderer->DrawText(text, x + cellWidth, y, Color::FromRgb(160, 255, 160));
+        y += cellHeight;
+    }
+}
+
+// ============================================================================
+// Scrollback View
+// ============================================================================
+
+void TerminalView::StepScroll() {
+    const float cellHeight = m_renderer->GetCellHeight();
+
+    // Lines pushed since the last frame would carry the view along; move it
+    // up by as many so what's on screen stays put. The screen's absolute
+    // line counts them whether or not the scrollback is being re-wrapped,
+    // and trimming the oldest lines doesn't change it; a view whose lines
+    // were trimmed stops at the oldest left (the limit below).
+    const uint64_t epoch = m_buffer->GetScrollbackEpoch();
+    const uint64_t screen = m_buffer->GetScreenLine();
+    if (epoch == m_anchorEpoch && screen > m_anchorLine) {
+        const float pushed = static_cast<float>(screen - m_anchorLine) * cellHeight;
+        m_scrollPixels += pushed;
+        m_scrollTarget += pushed;
+        m_newLines += screen - m_anchorLine;
+        m_newOutput = true;
+    }
+    m_anchorLine = screen;
+    m_anchorEpoch = epoch;
+
+    const float limit = static_cast<float>(m_buffer->GetScrollbackSize()) * cellHeight;
+    m_scrollTarget = std::clamp(m_scrollTarget, 0.0f, limit);
+    m_scrollPixels = std::clamp(m_scrollPixels, 0.0f, limit);
+
+    // Ease toward the target; the last pixel snaps
+    const float remaining = m_scrollTarget - m_scrollPixels;
+    if (std::fabs(remaining) * m_renderer->GetDpiScaleY() < 1.0f) {
+        m_scrollPixels = m_scrollTarget;
+    } else {
+        m_scrollPixels += remaining * kScrollEase;
+    }
+
+    if (m_scrollPixels <= 0.0f) {
+        ScrollToBottom();
+    }
+}
+
+void TerminalView::RenderHistory() {
+    // The screen keeps its retained frame up to date underneath
+    if (m_buffer->NextDirtyRow(0) >= 0) {
+        m_newOutput = true;
+    }
+    bool repaint = m_frameStale || m_windowStale || m_selectionChanged || m_showDiagnostics ||
+                   m_showRenderProfile || m_showInputLatency || !m_captureNotice.empty();
+    float scrolled = 0.0f;
+    (void)UpdateFrame(scrolled);
+    m_buffer->TouchScrollback();
+
+    // Tiles drawn before a layout change, or showing lines whose ids have
+    // since been reused, are no good
+    if (m_tileGeneration != m_renderer->GetTileGeneration() ||
+        m_tileEpoch != m_buffer->GetScrollbackEpoch()) {
+        repaint = true;
+        m_tiles.clear();
+        m_tileGeneration = m_renderer->GetTileGeneration();
+        m_tileEpoch = m_buffer->GetScrollbackEpoch();
+    }
+    std::erase_if(m_tiles, [](const auto& entry) { return (entry.first & kUncachedTile) != 0; });
+
+    const D2D1_RECT_F area = GetPaneRect();
+    const D2D1_SIZE_F size = D2D1::SizeF(area.right - area.left, area.bottom - area.top);
+    const float cellHeight = m_renderer->GetCellHeight();
+    const float offset = GetScrollOffset();
+    const size_t lines = m_buffer->GetScrollbackSize();
+    const auto rows = static_cast<size_t>(std::max(m_buffer->GetRows(), 1));
+
+    // Scrollback line i is drawn at offset - (i + 1) * cellHeight
+    const size_t first = offset > size.height ? static_cast<size_t>((offset - size.height) / cellHeight) : 0;
+    const size_t last = std::min(lines, static_cast<size_t>(std::ceil(offset / cellHeight)));
+
+    // StepScroll kept the view on its lines as output was pushed: with them
+    // where they were presented and the screen out of view, what changed is
+    // the overview strip and the new output indicator at most
+    const double top = static_cast<double>(m_buffer->GetScreenLine()) * cellHeight - offset;
+    const int64_t topPixel = std::llround(top * m_renderer->GetDpiScaleY());
+    const bool still = !repaint && m_historyTop == topPixel && offset >= size.height &&
+                       m_scrollPixels == m_scrollTarget;
+    m_historyTop = topPixel;
+    const OverviewSource overviewBefore = m_overviewSource;
+    const bool overviewShown = UpdateOverview();
+    const bool indicatorChanged = m_newLines != m_newLinesDrawn || m_newOutput != m_newOutputDrawn;
+    if (still && m_overviewSource == overviewBefore && !indicatorChanged) {
+        return;
+    }
+
+    // Lines in view are rendered now; those a screenful ahead in the scroll
+    // direction a few per frame, so they are ready when they come into view
+    ++m_tileFrame;
+    for (size_t index = first; index < last; ++index) {
+        (void)PrepareTile(index, size.width);
+    }
+    size_t budget = kTilesAheadPerFrame;
+    if (m_scrollDirection > 0) {
+        for (size_t index = last; index < std::min(lines, last + rows) && budget > 0; ++index) {
+            budget -= PrepareTile(index, size.width) ? 1 : 0;
+        }
+    } else {
+        for (size_t index = first; index > first - std::min(first, rows) && budget > 0; --index) {
+            budget -= PrepareTile(index - 1, size.width) ? 1 : 0;
+        }
+    }
+    TrimTiles(rows * 2 + 2);
+    m_profiler.Mark(RenderPhase::Build);
+
+    if (!m_renderer->BeginDraw()) {
+        return;
+    }
+    m_profiler.Mark(RenderPhase::Present);
+
+    // Split, the other panes show the frame as it is and only this pane's
+    // region moves
+    const bool split = !m_panes.empty();
+    if (split) {
+        m_renderer->DrawFrame();
+        m_renderer->PushClip(area.left, area.top, size.width, size.height);
+    }
+    m_renderer->Clear();
+    if (offset < size.height) {
+        m_renderer->DrawFrame(offset);
+    }
+    for (size_t index = first; index < last; ++index) {
+        if (const RowTile* tile = FindTile(index)) {
+            m_renderer->DrawTile(*tile, area.left, area.top + offset - static_cast<float>(index + 1) * cellHeight);
+        }
+    }
+    (void)RenderImages(offset);
+    (void)RenderRuleHighlights(offset);
+    (void)RenderSelection(offset);
+    m_timeDrawn = RenderLineTime();
+    if (overviewShown) {
+        RenderOverview();
+    }
+    const D2D1_RECT_F indicator = RenderNewOutput();
+    if (split) {
+        m_renderer->PopClip();
+    }
+
+    RenderOverlays();
+
+    if (still) {
+        const auto report = [this](const D2D1_RECT_F& rect) {
+            if (rect.bottom > rect.top) {
+                m_renderer->AddDirtyRect(rect.left, rect.top, rect.right - rect.left, rect.bottom - rect.top);
+            }
+        };
+        report(GetOverviewRect());
+        report(m_newOutputRect);
+        report(indicator);
+    } else {
+        // Every pixel moved
+        m_renderer->PresentWholeWindow();
+    }
+    m_newOutputRect = indicator;
+    m_newLinesDrawn = m_newLines;
+    m_newOutputDrawn = m_newOutput;
+    m_cursorDrawn = false;
+    m_windowStale = false;
+    m_selectionChanged = false;
+    EndDraw();
+
+    if (m_scrollPixels != m_scrollTarget) {
+        Invalidate();
+    }
+}
+
+bool TerminalView::PrepareTile(size_t index, float width) {
+    const Core::Row* line = m_buffer->GetScrollbackLine(index);
+    if (!line) {
+        return false;
+    }
+
+    // Lines being re-wrapped have no stable id; render them for this frame
+    const uint64_t id = m_buffer->GetScrollbackLineId(index);
+    CachedTile& cached = m_tiles[id != 0 ? id : (kUncachedTile | index)];
+    const bool rendered = cached.tile.bitmap != nullptr;
+    cached.lastUsed = m_tileFrame;
+    if (rendered) {
+        return false;
+    }
+
+    if (!m_renderer->BeginTile(cached.tile, width, m_renderer->GetCellHeight())) {
+        return false;
+    }
+    // Tiles are drawn from their own left edge, whichever pane shows them
+    const D2D1_POINT_2F origin = std::exchange(m_origin, D2D1_POINT_2F{});
+    m_renderer->Clear();
+    RenderCells(*line, {}, 0.0f);
+    m_renderer->EndTile();
+    m_origin = origin;
+    return true;
+}
+
+const RowTile* TerminalView::FindTile(size_t index) const {
+    const uint64_t id = m_buffer->GetScrollbackLineId(index);
+    const auto found = m_tiles.find(id != 0 ? id : (kUncachedTile | index));
+    return found != m_tiles.end() && found->second.tile.bitmap ? &found->second.tile : nullptr;
+}
+
+void TerminalView::TrimTiles(size_t keep) {
+    if (m_tiles.empty()) {
+        return;
+    }
+
+    // As many as fit the memory budget, but never fewer than the caller needs
+    const D2D1_SIZE_F size = m_renderer->GetRenderTarget()->GetSize();
+    const size_t tileBytes = std::max<size_t>(
+        static_cast<size_t>(size.width * m_renderer->GetDpiScaleX()) *
+            static_cast<size_t>(m_renderer->GetCellHeight() * m_renderer->GetDpiScaleY()) * 4,
+        1);
+    const size_t cap = std::max(keep, kRowTileBytes / tileBytes);
+    if (m_tiles.size() <= cap) {
+        return;
+    }
+
+    std::vector<std::pair<uint64_t, uint64_t>> ages;     // (last used, key)
+    ages.reserve(m_tiles.size());
+    for (const auto& [key, cached] : m_tiles) {
+        ages.emplace_back(cached.lastUsed, key);
+    }
+    const auto excess = static_cast<std::ptrdiff_t>(m_tiles.size() - cap);
+    std::nth_element(ages.begin(), ages.begin() + excess, ages.end());
+    for (auto it = ages.begin(); it != ages.begin() + excess; ++it) {
+        m_tiles.erase(it->second);
+    }
+}
+
+void TerminalView::ScrollBy(float distance) {
+    if (!m_buffer || !m_renderer || distance == 0.0f) {
+        return;
+    }
+
+    // Leaving the screen: the view follows the lines in it from here on
+    if (m_scrollPixels == 0.0f && m_scrollTarget == 0.0f) {
+        m_anchorLine = m_buffer->GetScreenLine();
+        m_anchorEpoch = m_buffer->GetScrollbackEpoch();
+        m_newLines = 0;
+        m_newOutput = false;
+        m_historyTop.reset();
+    }
+
+    m_scrollDirection = distance > 0.0f ? 1 : -1;
+    m_scrollTarget = std::clamp(m_scrollTarget + distance, 0.0f,
+                                static_cast<float>(m_buffer->GetScrollbackSize()) * m_renderer->GetCellHeight());
+    Invalidate();
+}
+
+void TerminalView::ScrollToLine(uint64_t line) {
+    if (!m_buffer || !m_renderer) {
+        return;
+    }
+    const uint64_t screen = m_buffer->GetScreenLine();
+    const float target = line < screen ? static_cast<float>(screen - line) * m_renderer->GetCellHeight() : 0.0f;
+    ScrollBy(target - m_scrollTarget);
+}
+
+void TerminalView::JumpToPrompt(int direction) {
+    if (!m_buffer || !m_renderer) {
+        return;
+    }
+
+    // From the line the view is heading to, so repeated presses keep going
+    // while the animation runs
+    const auto screen = static_cast<int64_t>(m_buffer->GetScreenLine());
+    const int64_t top = screen - static_cast<int64_t>(std::lround(m_scrollTarget / m_renderer->GetCellHeight()));
+    if (const Core::PromptMark* mark = m_buffer->FindPromptMark(static_cast<uint64_t>(std::max<int64_t>(top, 0)),
+                                                                  direction)) {
+        ScrollToLine(mark->line);
+    } else if (direction > 0) {
+        ScrollBy(-m_scrollTarget);
+    }
+}
+
+bool TerminalView::RevealMatch(uint64_t line, size_t offset, size_t length) {
+    if (!m_buffer || !m_renderer) {
+        return false;
+    }
+    // Only the block holding a scrollback line is decoded
+    const std::span<const Core::Cell> cells = m_buffer->GetLine(line);
+    if (cells.empty()) {
+        return false;
+    }
+
+    // A few lines of what led up to it above the match
+    constexpr uint64_t kLinesAbove = 3;
+    if (line < m_buffer->GetScreenLine()) {
+        ScrollToLine(line > kLinesAbove ? line - kLinesAbove : 0);
+    } else {
+        ScrollBy(-m_scrollTarget);
+    }
+
+    m_selection.startLine = static_cast<int64_t>(line);
+    m_selection.startCol = Core::ScrollbackSearch::ColumnOf(cells, offset);
+    m_selection.endLine = m_selection.startLine;
+    m_selection.endCol = Core::ScrollbackSearch::ColumnOf(cells, offset + length);
+    m_selection.epoch = m_buffer->GetScrollbackEpoch();
+    m_selection.block = false;
+    m_selection.active = m_selection.endCol > m_selection.startCol;
+    m_selectionChanged = true;
+    Invalidate();
+    return true;
+}
+
+void TerminalView::SelectCommandOutput() {
+    if (!m_buffer || !m_renderer) {
+        return;
+    }
+
+    const D2D1_RECT_F area = GetPaneRect();
+    const int64_t bottom = PixelToLine(std::max(static_cast<int>(area.bottom) - 1, 0));
+    Core::PromptMark start;
+    Core::PromptMark end;
+    if (!m_buffer->FindCommandOutput(static_cast<uint64_t>(std::max<int64_t>(bottom, 0)), start, end)) {
+        return;
+    }
+
+    // Output ending at the start of a line ends with the line before; a
+    // command still running has output to the end of the screen
+    const auto last = static_cast<int64_t>(m_buffer->GetScreenLine()) + m_buffer->GetRows() - 1;
+    m_selection.startLine = static_cast<int64_t>(start.line);
+    m_selection.startCol = start.col;
+    m_selection.endLine = static_cast<int64_t>(end.line);
+    m_selection.endCol = end.col;
+    if (m_selection.endLine > last) {
+        m_selection.endLine = last;
+        m_selection.endCol = m_buffer->GetCols();
+    } else if (m_selection.endCol == 0 && m_selection.endLine > m_selection.startLine) {
+        --m_selection.endLine;
+        m_selection.endCol = m_buffer->GetCols();
+    }
+    m_selection.epoch = m_buffer->GetScrollbackEpoch();
+    m_selection.block = false;
+    m_selection.active = m_selection.endLine > m_selection.startLine || m_selection.endCol > m_selection.startCol;
+    m_selectionChanged = true;
+    Invalidate();
+}
+
+float TerminalView::GetScrollOffset() const {
+    const float scale = m_renderer->GetDpiScaleY();
+    return std::round(m_scrollPixels * scale) / scale;
+}
+
+void TerminalView::ScrollToBottom() {
+    if (m_scrollPixels == 0.0f && m_scrollTarget == 0.0f) {
+        return;
+    }
+
+    m_scrollPixels = 0.0f;
+    m_scrollTarget = 0.0f;
+    m_historyTop.reset();
+    m_newLines = 0;
+    m_newOutput = false;
+
+    // The window showed history; the cell grid didn't see the rows that
+    // changed meanwhile
+    m_windowStale = true;
+    if (m_renderer && m_renderer->GetCellGrid()) {
+        m_frameStale = true;
+    }
+    Invalidate();
+}
+
+// ============================================================================
+// Scrollback Overview
+// ============================================================================
+
+void TerminalView::RenderOverview() {
+    const D2D1_RECT_F strip = GetOverviewRect();
+    const float height = strip.bottom - strip.top;
+    m_renderer->DrawOverview(strip.left, strip.top, strip.right - strip.left, height);
+
+    // The lines in view, at least a pixel or two however long the history
+    const auto first = static_cast<float>(m_overviewSource.firstLine);
+    const float total = static_cast<float>(m_overviewSource.endLine) - first;
+    const float top = static_cast<float>(m_overviewSource.endLine) - GetScrollOffset() / m_renderer->GetCellHeight();
+    const float y = strip.top + height * (top - first) / total;
+    const float extent = std::max(height * static_cast<float>(m_buffer->GetRows()) / total,
+                                  2.0f / m_renderer->GetDpiScaleY());
+    Color thumb = m_selectionColor.color;
+    thumb.a = 0.6f;
+    m_renderer->FillRect(strip.left, y, strip.right - strip.left, std::min(extent, strip.bottom - y), thumb);
+}
+
+bool TerminalView::UpdateOverview() {
+    const D2D1_RECT_F strip = GetOverviewRect();
+    const float height = strip.bottom - strip.top;
+    OverviewSource source;
+    source.buffer = m_buffer;
+    source.rules = m_outputRules;
+    source.version = m_buffer->GetOverview().GetVersion();
+    source.highlights = m_outputRules ? m_outputRules->GetHighlightGeneration() : 0;
+    source.firstLine = m_buffer->GetScrollbackStore().GetFirstId();
+    source.endLine = m_buffer->GetScreenLine();
+    source.rows = std::clamp(static_cast<UINT32>(std::max(height * m_renderer->GetDpiScaleY(), 1.0f)), 1u,
+                             kMaxOverviewRows);
+    if (source.endLine <= source.firstLine || height <= 0.0f) {
+        return false;
+    }
+    if (source == m_overviewSource && m_renderer->HasOverview()) {
+        return true;
+    }
+
+    // Each texel row sums the blocks its lines fall in: a few thousand
+    // summaries at most, never the lines themselves
+    const Core::ScrollbackOverview& overview = m_buffer->GetOverview();
+    const CompiledPalette& palette = m_palette.GetCompiled();
+    std::array<uint32_t, Core::kOverviewColors> colors{};
+    colors[0] = palette.defaultFg.rgba;
+    for (size_t color = 1; color < Core::kOverviewColors; ++color) {
+        colors[color] = palette.indexed[color - 1].rgba;
+    }
+
+    const uint64_t total = source.endLine - source.firstLine;
+    const UINT32 rows = source.rows;
+    const auto rowOf = [&](uint64_t line) {
+        return static_cast<size_t>((line - source.firstLine) * rows / total);
+    };
+    m_overviewPixels.resize(static_cast<size_t>(rows) * kOverviewTexels);
+    for (UINT32 row = 0; row < rows; ++row) {
+        const uint64_t start = source.firstLine + total * row / rows;
+        const uint64_t end = std::max(start + 1, source.firstLine + total * (row + 1) / rows);
+        Core::OverviewBlock sum;
+        for (uint64_t block = start / Core::ScrollbackOverview::kBlockLines;
+             block <= (end - 1) / Core::ScrollbackOverview::kBlockLines; ++block) {
+            if (const Core::OverviewBlock* summary = overview.GetBlock(block)) {
+                for (size_t color = 0; color < Core::kOverviewColors; ++color) {
+                    sum.ink[color] += summary->ink[color];
+                }
+                sum.cells += summary->cells;
+            }
+        }
+        std::fill_n(m_overviewPixels.begin() + static_cast<ptrdiff_t>(row) * kOverviewTexels, kOverviewTexels,
+                    BlendOverviewInk(sum, colors));
+    }
+
+    // Prompts down the left edge, lines output rules matched down the right
+    const std::deque<Core::PromptMark>& marks = m_buffer->GetPromptMarks();
+    const auto mark = std::lower_bound(marks.begin(), marks.end(), source.firstLine,
+                                       [](const Core::PromptMark& m, uint64_t line) { return m.line < line; });
+    for (auto it = mark; it != marks.end() && it->line < source.endLine; ++it) {
+        if (it->kind == Core::PromptMarkKind::Prompt) {
+            m_overviewPixels[rowOf(it->line) * kOverviewTexels] = ToOverviewPixel(m_cursorColor.rgba, 1.0f);
+        }
+    }
+    if (m_outputRules) {
+        m_overviewHits.clear();
+        m_outputRules->FindHighlights(source.firstLine, source.endLine - 1, m_overviewHits);
+        for (const Core::LineHighlight& hit : m_overviewHits) {
+            m_overviewPixels[rowOf(hit.line) * kOverviewTexels + kOverviewTexels - 1] = 0xFF000000 | hit.color;
+        }
+    }
+
+    if (!m_renderer->SetOverview(m_overviewPixels, kOverviewTexels, rows)) {
+        return false;
+    }
+    m_overviewSource = source;
+    return true;
+}
+
+D2D1_RECT_F TerminalView::RenderNewOutput() {
+    if (!m_newOutput) {
+        return {};
+    }
+
+    wchar_t text[64];
+    if (m_newLines > 0) {
+        swprintf_s(text, L"\x2193 %llu new line%s", static_cast<unsigned long long>(m_newLines),
+                   m_newLines == 1 ? L"" : L"s");
+    } else {
+        swprintf_s(text, L"\x2193 New output");
+    }
+
+    // Bottom right of the pane, left of the overview strip
+    const float cellWidth = m_renderer->GetCellWidth();
+    const float cellHeight = m_renderer->GetCellHeight();
+    const D2D1_RECT_F area = GetPaneRect();
+    const float width = static_cast<float>(wcslen(text) + 2) * cellWidth;
+    const float height = cellHeight * 1.5f;
+    const float x = std::max(area.left, GetOverviewRect().left - cellWidth * 0.5f - width);
+    const float y = std::max(area.top, area.bottom - cellHeight * 0.5f - height);
+
+    m_renderer->FillRect(x, y, width, height, Color::FromRgb(0, 0, 0, 200));
+    m_renderer->DrawRect(x, y, width, height, Color::FromRgb(128, 128, 128));
+    m_renderer->DrawText(text, x + cellWidth, y + cellHeight * 0.25f, m_palette.GetDefaultFg().color);
+    return D2D1::RectF(x - 1.0f, y - 1.0f, x + width + 1.0f, y + height + 1.0f);
+}
+
+D2D1_RECT_F TerminalView::GetOverviewRect() const {
+    const D2D1_RECT_F area = GetPaneRect();
+    return D2D1::RectF(std::max(area.left, area.right - kOverviewWidth), area.top, area.right, area.bottom);
+}
+
+bool TerminalView::HitTestOverview(CPoint point) const {
+    if (!m_buffer || !m_renderer || m_scrollPixels <= 0.0f ||
+        m_buffer->GetScreenLine() <= m_buffer->GetScrollbackStore().GetFirstId()) {
+        return false;
+    }
+    const D2D1_RECT_F strip = GetOverviewRect();
+    return point.x >= strip.left && point.x < strip.right && point.y >= strip.top && point.y < strip.bottom;
+}
+
+void TerminalView::ScrollToOverview(int y) {
+    const D2D1_RECT_F strip = GetOverviewRect();
+    const uint64_t first = m_buffer->GetScrollbackStore().GetFirstId();
+    const uint64_t end = m_buffer->GetScreenLine();
+    if (end <= first || strip.bottom <= strip.top) {
+        return;
+    }
+    const float fraction = std::clamp((static_cast<float>(y) - strip.top) / (strip.bottom - strip.top), 0.0f, 1.0f);
+    const uint64_t line = first + static_cast<uint64_t>(fraction * static_cast<float>(end - first));
+    const auto half = static_cast<uint64_t>(m_buffer->GetRows() / 2);
+    ScrollToLine(line > first + half ? line - half : first);
+}
+
+// ============================================================================
+// Input Handling
+// ============================================================================
+
+bool TerminalView::SendKeyToTerminal(UINT vkey, UINT nFlags, UINT charMessage) {
+    if (!m_keyboardCallback) {
+        return false;
+    }
+
+    unsigned modifiers = 0;
+    if (GetKeyState(VK_SHIFT) & 0x8000) modifiers |= Core::kKeyShift;
+    if (GetKeyState(VK_MENU) & 0x8000) modifiers |= Core::kKeyAlt;
+    if (GetKeyState(VK_CONTROL) & 0x8000) modifiers |= Core::kKeyCtrl;
+
+    const Core::KeySequence sequence =
+        Core::EncodeKey(vkey, modifiers, (nFlags & KF_EXTENDED) != 0, m_keyboardModes);
+    if (sequence.IsEmpty()) {
+        return false;  // Text, sent by OnChar
+    }
+
+    // TranslateMessage has already posted the key's character (Backspace's
+    // DEL, Shift+Tab's tab, Ctrl+M's CR), which comes before any other
+    // input; the sequence replaces it
+    MSG msg;
+    (void)PeekMessageW(&msg, m_hWnd, charMessage, charMessage, PM_REMOVE | PM_NOYIELD);
+
+    QueueInput(sequence.View());
+    if (m_echo.IsEnabled()) {
+        if (vkey == VK_BACK && modifiers == 0 && m_vterm) {
+            int cursorRow = 0;
+            int cursorCol = 0;
+            m_vterm->GetCursorPos(cursorRow, cursorCol);
+            m_echo.OnBackspace(cursorRow, cursorCol, Core::PerfClock::NowMicros());
+            SetTimer(TIMER_PREDICTION, kPredictionCheckMs);
+            Invalidate();
+        } else {
+            m_echo.OnOtherInput();
+        }
+    }
+    return true;
+}
+
+void TerminalView::SendCharToTerminal(wchar_t ch) {
+    if (!m_keyboardCallback) return;
+
+    char utf8[8];
+    const size_t length = Core::EncodeUtf16(ch, m_pendingSurrogate, utf8);
+    QueueInput(std::string_view(utf8, length));
+
+    if (m_echo.IsEnabled()) {
+        // Enter, Tab and characters outside the BMP are the shell's to draw
+        if (ch >= L' ' && (ch < 0xD800 || ch > 0xDFFF) && m_vterm && m_buffer) {
+            int cursorRow = 0;
+            int cursorCol = 0;
+            m_vterm->GetCursorPos(cursorRow, cursorCol);
+            m_echo.OnTyped(ch, cursorRow, cursorCol, m_buffer->GetCols(), Core::PerfClock::NowMicros());
+            SetTimer(TIMER_PREDICTION, kPredictionCheckMs);
+            Invalidate();
+        } else {
+            m_echo.OnOtherInput();
+        }
+    }
+}
+
+void TerminalView::QueueInput(std::string_view bytes) {
+    m_inputBatch.append(bytes);
+}
+
+void TerminalView::FlushInput() {
+    if (m_inputBatch.empty()) {
+        return;
+    }
+    if (m_keyboardCallback) {
+        m_keyboardCallback(m_inputBatch.data(), m_inputBatch.size());
+    }
+    m_inputBatch.clear();
+}
+
+void TerminalView::FlushInputIfIdle() {
+    MSG msg;
+    if (!PeekMessageW(&msg, m_hWnd, WM_KEYFIRST, WM_KEYLAST, PM_NOREMOVE | PM_NOYIELD)) {
+        FlushInput();
+    } else if (!m_inputBatch.empty()) {
+        // WM_PAINT comes once the queue is empty
         Invalidate();
     }
 }
 
-BOOL TerminalView::OnMouseWheel(UINT nFlags, short zDelta, CPoint pt) {
-    (void)nFlags;
-    (void)pt;
-    
-    // Mouse wheel reporting in SGR mode
-    if (m_mouseMode == MouseMode::SGR || m_mouseMode == MouseMode::Normal) {
-        int row = PixelToRow(pt.y);
-        int col = PixelToCol(pt.x);
-        int button = (zDelta > 0) ? 64 : 65;  // 64 = scroll up, 65 = scroll down
-        SendMouseReport(button, row, col, true);
-        return TRUE;
-    }
-    
-    // Scroll 3 lines per notch
-    int lines = (zDelta > 0) ? 3 : -3;
-    m_scrollOffset = std::clamp(
-        m_scrollOffset + lines, 
-        0, 
-        static_cast<int>(m_buffer ? m_buffer->GetScrollbackSize() : 0)
-    );
-    
-    Invalidate();
-    return TRUE;
-}
-
 // ============================================================================
-// Rendering
+// Links
 // ============================================================================
 
-void TerminalView::Render() {
-    if (!m_renderer || !m_renderer->IsInitialized() || !m_buffer) {
-        return;
+void TerminalView::UpdateHoverLink(CPoint point, bool ctrl) {
+    std::optional<HoverLink> hover;
+    if (ctrl && m_buffer && m_renderer && m_scrollPixels <= 0.0f && !m_isSelecting &&
+        (m_panes.empty() || HitTestPane(point) == m_focusedPane)) {
+        const int row = PixelToRow(point.y);
+        if (const Core::Link* link = m_links.HitTest(*m_buffer, row, PixelToCol(point.x))) {
+            hover = HoverLink{row, m_buffer->GetRowGeneration(row), *link};
+        }
     }
 
-    if (!m_renderer->BeginDraw()) {
+    const bool same = hover.has_value() == m_hoverLink.has_value() &&
+                      (!hover || (hover->row == m_hoverLink->row && hover->generation == m_hoverLink->generation &&
+                                  hover->link.startCol == m_hoverLink->link.startCol));
+    if (same) {
         return;
     }
+    m_hoverLink = std::move(hover);
+    Invalidate();
+}
 
-    m_renderer->Clear();
-
-    // Render each row
-    int rows = m_buffer->GetRows();
-    for (int row = 0; row < rows; ++row) {
-        RenderRow(row);
+bool TerminalView::RenderHoverLink() {
+    if (!m_hoverLink) {
+        return false;
     }
 
-    // Render selection
-    if (m_selection.active) {
-        RenderSelection();
+    // The row was rewritten under the mouse
+    const int row = m_hoverLink->row;
+    if (row >= m_buffer->GetRows() || m_buffer->GetRowGeneration(row) != m_hoverLink->generation) {
+        m_hoverLink.reset();
+        return false;
     }
 
-    // Render cursor
-    if (m_cursorVisible && m_hasFocus && (m_cursorBlinkState || m_cursorBlinkRate == 0)) {
-        RenderCursor();
+    const float cellHeight = m_renderer->GetCellHeight();
+    const float thickness = std::max(1.0f, std::round(cellHeight / 16.0f));
+    const float left = ColToPixel(m_hoverLink->link.startCol);
+    m_renderer->FillRect(left, RowToPixel(row) + cellHeight - thickness,
+                         ColToPixel(m_hoverLink->link.endCol) - left, thickness, m_palette.GetDefaultFg().color);
+    return true;
+}
+
+void TerminalView::UpdateLineTime(CPoint point, bool buttonHeld) {
+    std::optional<uint64_t> line;
+    if (!buttonHeld && m_buffer && m_renderer && m_buffer->GetLineTimes().GetEnd() != 0 && !HitTestOverview(point) &&
+        (m_panes.empty() || HitTestPane(point) == m_focusedPane)) {
+        if (const int64_t hovered = PixelToLine(point.y); hovered >= 0) {
+            line = static_cast<uint64_t>(hovered);
+        }
     }
 
-    m_renderer->EndDraw();
+    // Leaving the window hides it
+    if (line && !m_leaveTracked) {
+        TRACKMOUSEEVENT track{sizeof(track), TME_LEAVE, m_hWnd, 0};
+        m_leaveTracked = TrackMouseEvent(&track) != FALSE;
+    }
+    if (line == m_timeLine) {
+        return;
+    }
+    m_timeLine = line;
+    m_windowStale = true;
+    Invalidate();
 }
 
-void TerminalView::RenderRow(int row) {
-    if (!m_buffer || !m_renderer) return;
-    
-    float cellWidth = m_renderer->GetCellWidth();
-    float cellHeight = m_renderer->GetCellHeight();
-    float y = RowToPixel(row);
-    
-    int cols = m_buffer->GetCols();
-    for (int col = 0; col < cols; ++col) {
-        const auto& cell = m_buffer->GetCell(row, col);
-        
-        // Skip continuation cells
-        if (cell.width == 0) continue;
-        
-        float x = ColToPixel(col);
-        
-        // Draw background
-        Color bgColor = m_defaultBg;
-        if (!cell.bg.IsDefault()) {
-            bgColor = Color::FromRgb(cell.bg.r, cell.bg.g, cell.bg.b);
-        }
-        
-        // Check if in selection
-        if (m_selection.Contains(row, col)) {
-            bgColor = m_selectionColor;
-        }
-        
-        if (!cell.bg.IsDefault() || m_selection.Contains(row, col)) {
-            m_renderer->FillRect(x, y, cellWidth * cell.width, cellHeight, bgColor);
-        }
-        
-        // Draw character
-        if (cell.charCode != U' ') {
-            Color fgColor = m_defaultFg;
-            if (!cell.fg.IsDefault()) {
-                fgColor = Color::FromRgb(cell.fg.r, cell.fg.g, cell.fg.b);
-            }
-            
-            m_renderer->DrawChar(cell.charCode, x, y, fgColor);
-        }
+LRESULT TerminalView::OnMouseLeave(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/) {
+    m_leaveTracked = false;
+    if (m_timeLine) {
+        m_timeLine.reset();
+        m_windowStale = true;
+        Invalidate();
     }
+    return 0;
 }
 
-void TerminalView::RenderCursor() {
-    if (!m_buffer || !m_renderer || !m_vterm) return;
-    
-    int cursorRow, cursorCol;
-    m_vterm->GetCursorPos(cursorRow, cursorCol);
-    
-    float x = ColToPixel(cursorCol);
-    float y = RowToPixel(cursorRow);
-    float cellWidth = m_renderer->GetCellWidth();
-    float cellHeight = m_renderer->GetCellHeight();
-    
-    switch (m_cursorStyle) {
-        case CursorStyle::Block:
-            m_renderer->FillRect(x, y, cellWidth, cellHeight, m_cursorColor);
-            break;
-        case CursorStyle::Underline:
-            m_renderer->FillRect(x, y + cellHeight - 2, cellWidth, 2, m_cursorColor);
-            break;
-        case CursorStyle::Bar:
-            m_renderer->FillRect(x, y, 2, cellHeight, m_cursorColor);
-            break;
+bool TerminalView::RenderLineTime() {
+    if (!m_timeLine) {
+        return false;
+    }
+    const std::optional<uint64_t> time = m_buffer->GetLineTime(*m_timeLine);
+    if (!time) {
+        return false;
+    }
+
+    // Unix milliseconds to local time
+    const uint64_t ticks = (*time + 11644473600000ull) * 10000;
+    const FILETIME file{static_cast<DWORD>(ticks), static_cast<DWORD>(ticks >> 32)};
+    SYSTEMTIME utc{};
+    SYSTEMTIME local{};
+    if (!FileTimeToSystemTime(&file, &utc) || !SystemTimeToTzSpecificLocalTime(nullptr, &utc, &local)) {
+        return false;
     }
+    wchar_t text[32];
+    swprintf_s(text, L"%02u:%02u:%02u.%03u", local.wHour, local.wMinute, local.wSecond, local.wMilliseconds);
+
+    // On the line, at the right of the pane left of the overview strip
+    const float cellWidth = m_renderer->GetCellWidth();
+    const float cellHeight = m_renderer->GetCellHeight();
+    const float offset = m_scrollPixels > 0.0f ? GetScrollOffset() : 0.0f;
+    const auto row = static_cast<int64_t>(*m_timeLine) - static_cast<int64_t>(m_buffer->GetScreenLine());
+    const float y = m_origin.y + offset + static_cast<float>(row) * cellHeight;
+    const float width = static_cast<float>(wcslen(text) + 2) * cellWidth;
+    const float x = std::max(GetPaneRect().left, GetOverviewRect().left - cellWidth * 0.5f - width);
+    m_renderer->FillRect(x, y, width, cellHeight, Color::FromRgb(0, 0, 0, 200));
+    m_renderer->DrawText(text, x + cellWidth, y, m_palette.GetDefaultFg().color);
+    return true;
 }
 
-void TerminalView::RenderSelection() {
-    // Selection is rendered per-cell in RenderRow
+void TerminalView::OpenLink(const Core::Link& link) {
+    if (m_linkCallback) {
+        m_linkCallback(link);
+        return;
+    }
+
+    const std::wstring target = Core::ToUtf16(link.target);
+    if (target.empty()) {
+        return;
+    }
+
+    // Files open for editing, never run; of URLs, only ones a browser or
+    // mail client handles (a program's output decides what they say)
+    if (link.kind == Core::LinkKind::FileLocation) {
+        ShellExecuteW(m_hWnd, L"edit", target.c_str(), nullptr, nullptr, SW_SHOWNORMAL);
+        return;
+    }
+    constexpr const wchar_t* kSchemes[] = {L"http://", L"https://", L"ftp://", L"mailto:"};
+    for (const wchar_t* scheme : kSchemes) {
+        if (_wcsnicmp(target.c_str(), scheme, wcslen(scheme)) == 0) {
+            ShellExecuteW(m_hWnd, L"open", target.c_str(), nullptr, nullptr, SW_SHOWNORMAL);
+            return;
+        }
+    }
 }
 
 // ============================================================================
-// Input Handling
+// Split Panes
 // ============================================================================
 
-void TerminalView::SendKeyToTerminal(UINT vkey, UINT /*scanCode*/, bool keyDown) {
-    if (!keyDown || !m_keyboardCallback) return;
-    
-    // Get modifier state
-    bool ctrl = (GetKeyState(VK_CONTROL) & 0x8000) != 0;
-    bool alt = (GetKeyState(VK_MENU) & 0x8000) != 0;
-    bool shift = (GetKeyState(VK_SHIFT) & 0x8000) != 0;
-    
-    // Handle Ctrl+Key combinations (send control characters)
-    if (ctrl && !alt) {
-        // Ctrl+C = 0x03, Ctrl+D = 0x04, etc.
-        if (vkey >= 'A' && vkey <= 'Z') {
-            char ctrlChar = static_cast<char>(vkey - 'A' + 1);
-            m_keyboardCallback(&ctrlChar, 1);
-            return;
-        }
-        // Ctrl+[ = ESC (0x1B), Ctrl+\ = 0x1C, Ctrl+] = 0x1D
-        if (vkey == VK_OEM_4) { // [
-            char esc = 0x1B;
-            m_keyboardCallback(&esc, 1);
-            return;
-        }
+uint32_t TerminalView::SplitPane(SplitDirection direction, PaneBinding binding) {
+    const uint32_t id = m_layout.Split(m_focusedPane, direction);
+    if (id == 0) {
+        return 0;
     }
-    
-    // Alt+Key combinations (send ESC + key)
-    if (alt && !ctrl) {
-        if (vkey >= 'A' && vkey <= 'Z') {
-            char seq[2] = { 0x1B, static_cast<char>(shift ? vkey : (vkey + 32)) };
-            m_keyboardCallback(seq, 2);
+
+    // The new pane's binding becomes the view's, the old focused pane's
+    // goes into the list
+    Pane pane;
+    pane.id = id;
+    pane.binding = std::move(binding);
+    m_panes.push_back(std::move(pane));
+    SwapFocusedPane(m_panes.back());
+    UpdateCellPixelSize();
+    LayoutPanes();
+    InvalidateFrame();
+    return id;
+}
+
+void TerminalView::ClosePane(uint32_t pane) {
+    if (!m_layout.Remove(pane)) {
+        return;
+    }
+
+    // A focused pane first swaps places with the one taking the focus
+    auto closing = std::find_if(m_panes.begin(), m_panes.end(),
+                                [pane](const Pane& other) { return other.id == pane; });
+    if (pane == m_focusedPane) {
+        const uint32_t next = m_layout.GetFirst();
+        closing = std::find_if(m_panes.begin(), m_panes.end(),
+                               [next](const Pane& other) { return other.id == next; });
+        if (closing == m_panes.end()) {
             return;
         }
+        SwapFocusedPane(*closing);
     }
-    
-    // Map virtual keys to escape sequences
-    const char* seq = nullptr;
-    char modSeq[16];
-    
-    // Calculate modifier parameter for CSI sequences
-    // 1 = none, 2 = shift, 3 = alt, 4 = shift+alt, 5 = ctrl, 6 = shift+ctrl, 7 = alt+ctrl, 8 = shift+alt+ctrl
-    int modParam = 1;
-    if (shift) modParam += 1;
-    if (alt) modParam += 2;
-    if (ctrl) modParam += 4;
-    
-    bool hasModifier = (modParam > 1);
-    
-    switch (vkey) {
-        case VK_UP:
-            if (hasModifier) {
-                snprintf(modSeq, sizeof(modSeq), "\x1b[1;%dA", modParam);
-                seq = modSeq;
-            } else {
-                seq = "\x1b[A";
-            }
-            break;
-        case VK_DOWN:
-            if (hasModifier) {
-                snprintf(modSeq, sizeof(modSeq), "\x1b[1;%dB", modParam);
-                seq = modSeq;
-            } else {
-                seq = "\x1b[B";
-            }
-            break;
-        case VK_RIGHT:
-            if (hasModifier) {
-                snprintf(modSeq, sizeof(modSeq), "\x1b[1;%dC", modParam);
-                seq = modSeq;
-            } else {
-                seq = "\x1b[C";
+    if (closing == m_panes.end()) {
+        return;
+    }
+    ForgetBuffer(closing->binding.buffer);
+    m_panes.erase(closing);
+    LayoutPanes();
+    InvalidateFrame();
+}
+
+void TerminalView::FocusPane(uint32_t pane) {
+    const auto found = std::find_if(m_panes.begin(), m_panes.end(),
+                                    [pane](const Pane& other) { return other.id == pane; });
+    if (found == m_panes.end()) {
+        return;
+    }
+    SwapFocusedPane(*found);
+    Invalidate();
+    if (m_paneFocusCallback) {
+        m_paneFocusCallback(m_focusedPane);
+    }
+}
+
+void TerminalView::SetPaneFocusCallback(PaneFocusCallback callback) {
+    m_paneFocusCallback = std::move(callback);
+}
+
+void TerminalView::SwapFocusedPane(Pane& pane) {
+    // Input so far goes to the pane it was typed in
+    FlushInput();
+    FlushMouseMotion();
+    m_echo.OnOtherInput();
+
+    std::swap(m_focusedPane, pane.id);
+    std::swap(m_buffer, pane.binding.buffer);
+    std::swap(m_vterm, pane.binding.vterm);
+    std::swap(m_keyboardCallback, pane.binding.keyboard);
+    std::swap(m_mouseCallback, pane.binding.mouse);
+    std::swap(m_pasteCallback, pane.binding.paste);
+    std::swap(m_resizeCallback, pane.binding.resize);
+    std::swap(m_paneRect, pane.rect);
+    std::swap(m_frameRows, pane.frameRows);
+    std::swap(m_frameCols, pane.frameCols);
+    std::swap(m_gridRows, pane.gridRows);
+    std::swap(m_gridCols, pane.gridCols);
+    m_origin = D2D1::Point2F(m_paneRect.left, m_paneRect.top);
+
+    // Both regions of the frame stay as painted; a stale one repaints all
+    const bool stale = pane.stale;
+    pane.stale = m_frameStale;
+    m_frameStale = m_frameStale || stale;
+
+    // The selection, history view, link and mouse state were the old pane's
+    m_selection.active = false;
+    m_selectionChanged = true;
+    m_isSelecting = false;
+    m_hoverLink.reset();
+    m_links.Clear();
+    m_scrollPixels = 0.0f;
+    m_scrollTarget = 0.0f;
+    m_tiles.clear();
+    m_pendingMotion.reset();
+    m_mouseRow = -1;
+    m_mouseCol = -1;
+    m_mousePressReported = false;
+    m_imeComposition.clear();
+    m_windowStale = true;
+}
+
+void TerminalView::LayoutPanes() {
+    if (!m_renderer || !m_renderer->IsInitialized()) return;
+
+    if (m_panes.empty()) {
+        m_origin = D2D1_POINT_2F{};
+        m_dividers.clear();
+    } else {
+        CRect client;
+        GetClientRect(&client);
+        std::vector<PaneRect> rects;
+        m_layout.Arrange(static_cast<float>(client.Width()), static_cast<float>(client.Height()),
+                         m_renderer->GetCellWidth(), m_renderer->GetCellHeight(), rects, m_dividers);
+
+        // Each pane's grid follows its area
+        for (const PaneRect& rect : rects) {
+            const D2D1_RECT_F area = D2D1::RectF(rect.left, rect.top, rect.right, rect.bottom);
+            if (rect.pane == m_focusedPane) {
+                m_paneRect = area;
+                m_origin = D2D1::Point2F(area.left, area.top);
+                continue;
             }
-            break;
-        case VK_LEFT:
-            if (hasModifier) {
-                snprintf(modSeq, sizeof(modSeq), "\x1b[1;%dD", modParam);
-                seq = modSeq;
-            } else {
-                seq = "\x1b[D";
+            const auto pane = std::find_if(m_panes.begin(), m_panes.end(),
+                                           [&rect](const Pane& other) { return other.id == rect.pane; });
+            if (pane == m_panes.end()) {
+                continue;
             }
-            break;
-        case VK_HOME:   seq = hasModifier ? (snprintf(modSeq, sizeof(modSeq), "\x1b[1;%dH", modParam), modSeq) : "\x1b[H"; break;
-        case VK_END:    seq = hasModifier ? (snprintf(modSeq, sizeof(modSeq), "\x1b[1;%dF", modParam), modSeq) : "\x1b[F"; break;
-        case VK_INSERT: seq = "\x1b[2~"; break;
-        case VK_DELETE: seq = "\x1b[3~"; break;
-        case VK_PRIOR:  seq = "\x1b[5~"; break;  // Page Up
-        case VK_NEXT:   seq = "\x1b[6~"; break;  // Page Down
-        case VK_F1:     seq = "\x1bOP"; break;
-        case VK_F2:     seq = "\x1bOQ"; break;
-        case VK_F3:     seq = "\x1bOR"; break;
-        case VK_F4:     seq = "\x1bOS"; break;
-        case VK_F5:     seq = "\x1b[15~"; break;
-        case VK_F6:     seq = "\x1b[17~"; break;
-        case VK_F7:     seq = "\x1b[18~"; break;
-        case VK_F8:     seq = "\x1b[19~"; break;
-        case VK_F9:     seq = "\x1b[20~"; break;
-        case VK_F10:    seq = "\x1b[21~"; break;
-        case VK_F11:    seq = "\x1b[23~"; break;
-        case VK_F12:    seq = "\x1b[24~"; break;
-        case VK_ESCAPE: seq = "\x1b"; break;
-        case VK_TAB:
-            if (shift) {
-                seq = "\x1b[Z";  // Shift+Tab = reverse tab
+            pane->rect = area;
+            pane->stale = true;
+            const int rows = std::max(static_cast<int>((area.bottom - area.top) / m_renderer->GetCellHeight()), 1);
+            const int cols = std::max(static_cast<int>((area.right - area.left) / m_renderer->GetCellWidth()), 1);
+            if (rows != pane->gridRows || cols != pane->gridCols) {
+                pane->gridRows = rows;
+                pane->gridCols = cols;
+                if (pane->binding.resize) {
+                    pane->binding.resize(cols, rows);
+                }
             }
-            break;
-        default: return;  // Handled by OnChar for regular keys
+        }
     }
-    
-    if (seq) {
-        m_keyboardCallback(seq, strlen(seq));
+
+    const int rows = std::max(GetTerminalRows(), 1);
+    const int cols = std::max(GetTerminalCols(), 1);
+    if (rows == m_gridRows && cols == m_gridCols) return;
+
+    m_gridRows = rows;
+    m_gridCols = cols;
+    if (m_resizeCallback) {
+        m_resizeCallback(cols, rows);
     }
 }
 
-void TerminalView::SendCharToTerminal(wchar_t ch) {
-    if (!m_keyboardCallback) return;
-    
-    // Convert to UTF-8
-    char utf8[4];
-    int len = 0;
-    
-    if (ch == '\r') {
-        utf8[0] = '\r';
-        len = 1;
-    } else if (ch < 0x80) {
-        utf8[0] = static_cast<char>(ch);
-        len = 1;
-    } else if (ch < 0x800) {
-        utf8[0] = static_cast<char>(0xC0 | (ch >> 6));
-        utf8[1] = static_cast<char>(0x80 | (ch & 0x3F));
-        len = 2;
+D2D1_RECT_F TerminalView::GetPaneRect() const {
+    if (!m_panes.empty()) {
+        return m_paneRect;
+    }
+    CRect client;
+    GetClientRect(&client);
+    return D2D1::RectF(0.0f, 0.0f, static_cast<float>(client.Width()), static_cast<float>(client.Height()));
+}
+
+uint32_t TerminalView::HitTestPane(CPoint point) const {
+    const auto x = static_cast<float>(point.x);
+    const auto y = static_cast<float>(point.y);
+    const auto contains = [x, y](const D2D1_RECT_F& rect) {
+        return x >= rect.left && x < rect.right && y >= rect.top && y < rect.bottom;
+    };
+    if (contains(GetPaneRect())) {
+        return m_focusedPane;
+    }
+    for (const Pane& pane : m_panes) {
+        if (contains(pane.rect)) {
+            return pane.id;
+        }
+    }
+    return 0;
+}
+
+bool TerminalView::ScrollPane(Pane& pane) {
+    const Core::TerminalBuffer* buffer = pane.binding.buffer;
+    if (!buffer || buffer->GetPendingScroll().lines == 0) {
+        return true;
+    }
+    const Core::PendingScroll& scroll = buffer->GetPendingScroll();
+    const float cellHeight = m_renderer->GetCellHeight();
+    return m_renderer->ScrollFrame(pane.rect.left, pane.rect.top + static_cast<float>(scroll.top) * cellHeight,
+                                   pane.rect.right - pane.rect.left,
+                                   static_cast<float>(scroll.bottom - scroll.top) * cellHeight,
+                                   -static_cast<float>(scroll.lines) * cellHeight);
+}
+
+void TerminalView::RenderPane(Pane& pane) {
+    Core::TerminalBuffer* buffer = pane.binding.buffer;
+    if (!buffer) {
+        return;
+    }
+    const int rows = buffer->GetRows();
+    const int cols = buffer->GetCols();
+    const bool all = pane.stale || rows != pane.frameRows || cols != pane.frameCols;
+    if (!all && buffer->NextDirtyRow(0) < 0) {
+        return;
+    }
+
+    // Its rows are drawn at its own origin
+    const D2D1_POINT_2F origin = std::exchange(m_origin, D2D1::Point2F(pane.rect.left, pane.rect.top));
+    if (all) {
+        const float width = pane.rect.right - pane.rect.left;
+        const float height = pane.rect.bottom - pane.rect.top;
+        m_renderer->ClearRect(pane.rect.left, pane.rect.top, width, height);
+        m_renderer->AddDirtyRect(pane.rect.left, pane.rect.top, width, height);
+        for (int row = 0; row < rows; ++row) {
+            RenderCells(buffer->GetRow(row), buffer->GetStyleRuns(row), RowToPixel(row));
+        }
+        m_profiler.AddDirtyRows(static_cast<uint32_t>(rows));
     } else {
-        utf8[0] = static_cast<char>(0xE0 | (ch >> 12));
-        utf8[1] = static_cast<char>(0x80 | ((ch >> 6) & 0x3F));
-        utf8[2] = static_cast<char>(0x80 | (ch & 0x3F));
-        len = 3;
+        RenderDamage(*buffer, pane.rect.right);
+    }
+    m_origin = origin;
+
+    buffer->ClearDirty();
+    pane.stale = false;
+    pane.frameRows = rows;
+    pane.frameCols = cols;
+}
+
+void TerminalView::RenderDividers() {
+    Color color = m_palette.GetDefaultFg().color;
+    color.a = 0.3f;
+    for (const PaneRect& divider : m_dividers) {
+        m_renderer->FillRect(divider.left, divider.top, divider.right - divider.left, divider.bottom - divider.top,
+                             color);
     }
-    
-    m_keyboardCallback(utf8, len);
 }
 
 // ============================================================================
@@ -636,71 +3392,80 @@ void TerminalView::SendCharToTerminal(wchar_t ch) {
 int TerminalView::PixelToRow(int y) const {
     if (!m_renderer) return 0;
     float cellHeight = m_renderer->GetCellHeight();
-    return cellHeight > 0 ? static_cast<int>(y / cellHeight) : 0;
+    return cellHeight > 0 ? static_cast<int>(std::floor((y - m_origin.y) / cellHeight)) : 0;
+}
+
+int64_t TerminalView::PixelToLine(int y) const {
+    if (!m_renderer || !m_buffer) return 0;
+    const float cellHeight = m_renderer->GetCellHeight();
+    const float offset = m_origin.y + (m_scrollPixels > 0.0f ? GetScrollOffset() : 0.0f);
+    const auto row = cellHeight > 0 ? static_cast<int64_t>(std::floor((y - offset) / cellHeight)) : 0;
+    return static_cast<int64_t>(m_buffer->GetScreenLine()) + row;
 }
 
 int TerminalView::PixelToCol(int x) const {
     if (!m_renderer) return 0;
     float cellWidth = m_renderer->GetCellWidth();
-    return cellWidth > 0 ? static_cast<int>(x / cellWidth) : 0;
+    return cellWidth > 0 ? static_cast<int>(std::floor((x - m_origin.x) / cellWidth)) : 0;
 }
 
 float TerminalView::RowToPixel(int row) const {
     if (!m_renderer) return 0;
-    return row * m_renderer->GetCellHeight();
+    return m_origin.y + row * m_renderer->GetCellHeight();
 }
 
 float TerminalView::ColToPixel(int col) const {
     if (!m_renderer) return 0;
-    return col * m_renderer->GetCellWidth();
+    return m_origin.x + col * m_renderer->GetCellWidth();
 }
 
 // ============================================================================
 // Mouse Reporting
 // ============================================================================
 
-void TerminalView::SendMouseReport(int button, int row, int col, bool pressed) {
-    if (!m_keyboardCallback) return;
-    
-    char buf[32];
-    
-    switch (m_mouseMode) {
-        case MouseMode::X10:
-            // X10: Only button press, no modifiers
-            if (pressed) {
-                snprintf(buf, sizeof(buf), "\x1b[M%c%c%c",
-                    static_cast<char>(32 + button),
-                    static_cast<char>(32 + col + 1),
-                    static_cast<char>(32 + row + 1));
-                m_keyboardCallback(buf, strlen(buf));
-            }
-            break;
-            
-        case MouseMode::Normal:
-            // Normal: Button press and release
-            snprintf(buf, sizeof(buf), "\x1b[M%c%c%c",
-                static_cast<char>(32 + (pressed ? button : 3)),  // 3 = release
-                static_cast<char>(32 + col + 1),
-                static_cast<char>(32 + row + 1));
-            m_keyboardCallback(buf, strlen(buf));
-            break;
-            
-        case MouseMode::SGR:
-            // SGR: Extended format, supports large coordinates
-            snprintf(buf, sizeof(buf), "\x1b[<%d;%d;%d%c",
-                button,
-                col + 1,
-                row + 1,
-                pressed ? 'M' : 'm');
-            m_keyboardCallback(buf, strlen(buf));
-            break;
-            
-        default:
-            break;
+bool TerminalView::IsMouseReported(UINT nFlags) const {
+    return m_mouseMode != MouseMode::None && m_mouseCallback && !(nFlags & MK_SHIFT);
+}
+
+Emulation::MouseEvent TerminalView::MakeMouseEvent(CPoint point, UINT nFlags) const {
+    Emulation::MouseEvent event;
+    event.row = std::clamp(PixelToRow(point.y), 0, std::max(GetTerminalRows() - 1, 0));
+    event.col = std::clamp(PixelToCol(point.x), 0, std::max(GetTerminalCols() - 1, 0));
+    event.modifiers = ((nFlags & MK_CONTROL) ? VTERM_MOD_CTRL : 0) |
+                      (GetKeyState(VK_MENU) < 0 ? VTERM_MOD_ALT : 0);
+    return event;
+}
+
+void TerminalView::SendMouseButton(int button, bool pressed, CPoint point, UINT nFlags) {
+    if (!m_mouseCallback) return;
+    m_echo.OnOtherInput();      // A click may move the line editor's cursor
+
+    // The press lands where the pointer is now; motion before it is sent first
+    FlushMouseMotion();
+    Emulation::MouseEvent event = MakeMouseEvent(point, nFlags);
+    event.button = button;
+    event.pressed = pressed;
+    m_mouseRow = event.row;
+    m_mouseCol = event.col;
+    m_mouseCallback(event);
+}
+
+void TerminalView::FlushMouseMotion() {
+    if (!m_pendingMotion) return;
+
+    const Emulation::MouseEvent event = *m_pendingMotion;
+    m_pendingMotion.reset();
+    if (m_mouseCallback && (event.row != m_mouseRow || event.col != m_mouseCol)) {
+        m_mouseRow = event.row;
+        m_mouseCol = event.col;
+        m_mouseCallback(event);
     }
 }
 
 void TerminalView::SetMouseMode(MouseMode mode) {
+    if (mode == MouseMode::None) {
+        m_pendingMotion.reset();
+    }
     m_mouseMode = mode;
 }
 
@@ -708,10 +3473,161 @@ void TerminalView::SetBracketedPasteMode(bool enabled) {
     m_bracketedPasteMode = enabled;
 }
 
+void TerminalView::SetResizeCallback(ResizeCallback callback) {
+    m_resizeCallback = std::move(callback);
+}
+
+void TerminalView::SetHyperlinks(const Core::HyperlinkTable* table) {
+    m_links.SetHyperlinks(table);
+    m_hoverLink.reset();
+}
+
+void TerminalView::SetOutputRules(const Core::OutputRules* rules) {
+    m_outputRules = rules;
+    Invalidate();
+}
+
+void TerminalView::SetLinkCallback(LinkCallback callback) {
+    m_linkCallback = std::move(callback);
+}
+
+void TerminalView::BeginLiveResize() {
+    m_liveResize = true;
+}
+
+void TerminalView::EndLiveResize() {
+    m_liveResize = false;
+    if (m_resizePending) {
+        CommitResize();
+    }
+}
+
+void TerminalView::CommitResize() {
+    KillTimer(TIMER_RESIZE);
+    m_resizePending = false;
+    if (!m_renderer || !m_renderer->IsInitialized()) return;
+
+    // Drop the preview frame and repaint at the final size
+    CRect client;
+    GetClientRect(&client);
+    (void)m_renderer->Resize(client.Width(), client.Height());
+    InvalidateFrame();
+    LayoutPanes();
+}
+
+void TerminalView::SetDiagnosticsSource(DiagnosticsSource source) {
+    m_diagnosticsSource = std::move(source);
+}
+
+bool TerminalView::SetCellGridShader(bool enable) {
+    const bool done = m_renderer && m_renderer->EnableCellGrid(enable);
+    InvalidateFrame();
+    return done;
+}
+
+bool TerminalView::SetOpacity(float opacity) {
+    if (!m_renderer) {
+        return false;
+    }
+
+    // Kept frames hold the background at the old opacity
+    const bool done = m_renderer->SetOpacity(opacity);
+    m_hiddenFrames.clear();
+    m_tiles.clear();
+    InvalidateFrame();
+    return done;
+}
+
+void TerminalView::SetGpuPreference(GpuPreference preference) {
+    if (m_renderer) {
+        m_renderer->SetGpuPreference(preference);
+        UpdateAdapter();
+    }
+}
+
+void TerminalView::UpdateAdapter() {
+    // Kept frames are on the old device
+    if (m_renderer && m_renderer->UpdateAdapter()) {
+        m_hiddenFrames.clear();
+        m_tiles.clear();
+        InvalidateFrame();
+    }
+}
+
+void TerminalView::SetLigatures(bool enable) {
+    if (m_renderer && m_renderer->GetLigatures() != enable) {
+        m_renderer->SetLigatures(enable);
+        InvalidateFrame();
+    }
+}
+
+void TerminalView::SetPredictiveEcho(bool enable) {
+    if (m_echo.IsEnabled() != enable) {
+        m_echo.SetEnabled(enable);
+        Invalidate();
+    }
+}
+
+void TerminalView::ShowDiagnostics(bool show) {
+    m_showDiagnostics = show && m_diagnosticsSource;
+    UpdateOverlayTimer();
+}
+
+void TerminalView::ShowRenderProfile(bool show) {
+    m_showRenderProfile = show;
+    UpdateOverlayTimer();
+}
+
+void TerminalView::SetInputLatencyProbe(Core::InputLatencyProbe* probe) {
+    // Measured, a session left keeps its histograms; it gets no keys
+    if (m_inputLatency && m_inputLatency != probe && !m_measureInputLatency) {
+        m_inputLatency->SetEnabled(false);
+    }
+    m_inputLatency = probe;
+    UpdateInputLatencyProbe();
+}
+
+void TerminalView::ShowInputLatency(bool show) {
+    m_showInputLatency = show;
+    UpdateInputLatencyProbe();
+    UpdateOverlayTimer();
+}
+
+void TerminalView::MeasureInputLatency(bool measure) {
+    m_measureInputLatency = measure;
+    UpdateInputLatencyProbe();
+}
+
+void TerminalView::UpdateInputLatencyProbe() {
+    // Turning a probe on clears it, so one already on is left alone
+    const bool enable = m_showInputLatency || m_measureInputLatency;
+    if (m_inputLatency && m_inputLatency->IsEnabled() != enable) {
+        m_inputLatency->SetEnabled(enable);
+    }
+}
+
+void TerminalView::UpdateOverlayTimer() {
+    if (IsWindow()) {
+        if (m_showDiagnostics || m_showRenderProfile || m_showInputLatency || m_capture ||
+            !m_captureNotice.empty()) {
+            SetTimer(TIMER_DIAGNOSTICS, kDiagnosticsRefreshMs);
+        } else {
+            KillTimer(TIMER_DIAGNOSTICS);
+        }
+        Invalidate();
+    }
+}
+
 // ============================================================================
 // IME Support for CJK Input
 // ============================================================================
 
+LRESULT TerminalView::OnImeSetContext(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& /*bHandled*/) {
+    // The composition string is drawn inline by the view (overlay pass);
+    // the IME keeps its candidate window
+    return DefWindowProc(uMsg, wParam, lParam & ~ISC_SHOWUICOMPOSITIONWINDOW);
+}
+
 LRESULT TerminalView::OnImeStartComposition(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& bHandled) {
     // Position the IME composition window near the cursor
     if (!m_renderer || !m_vterm) {
@@ -747,6 +3663,20 @@ LRESULT TerminalView::OnImeStartComposition(UINT /*uMsg*/, WPARAM /*wParam*/, LP
 }
 
 LRESULT TerminalView::OnImeComposition(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM lParam, BOOL& bHandled) {
+    // Track the string being composed for the overlay
+    if (lParam & GCS_COMPSTR) {
+        m_imeComposition.clear();
+        if (HIMC hImc = ImmGetContext(m_hWnd)) {
+            const LONG len = ImmGetCompositionStringW(hImc, GCS_COMPSTR, nullptr, 0);
+            if (len > 0) {
+                m_imeComposition.resize(len / sizeof(wchar_t));
+                ImmGetCompositionStringW(hImc, GCS_COMPSTR, m_imeComposition.data(), len);
+            }
+            ImmReleaseContext(m_hWnd, hImc);
+        }
+        Invalidate();
+    }
+
     // Handle IME composition result
     if (lParam & GCS_RESULTSTR) {
         HIMC hImc = ImmGetContext(m_hWnd);
@@ -757,10 +3687,11 @@ LRESULT TerminalView::OnImeComposition(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM
                 std::wstring result(len / sizeof(wchar_t), L'\0');
                 ImmGetCompositionStringW(hImc, GCS_RESULTSTR, result.data(), len);
                 
-                // Send each character to the terminal
+                // Send the characters to the terminal as one write
                 for (wchar_t ch : result) {
                     SendCharToTerminal(ch);
                 }
+                FlushInput();
             }
             ImmReleaseContext(m_hWnd, hImc);
         }
@@ -773,7 +3704,8 @@ LRESULT TerminalView::OnImeComposition(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM
 }
 
 LRESULT TerminalView::OnImeEndComposition(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& bHandled) {
-    // Composition ended, redraw to clear any inline preview
+    // Composition ended, redraw to clear the inline preview
+    m_imeComposition.clear();
     Invalidate();
     bHandled = FALSE;
     return 0;
@@ -784,6 +3716,7 @@ LRESULT TerminalView::OnImeChar(UINT /*uMsg*/, WPARAM wParam, LPARAM /*lParam*/,
     wchar_t ch = static_cast<wchar_t>(wParam);
     if (ch >= 32) {
         SendCharToTerminal(ch);
+        FlushInputIfIdle();
     }
     bHandled = TRUE;
     return 0;
@@ -4,6 +4,76 @@
 //
 // Child window that renders the terminal content, handles keyboard/mouse
 // input, and manages cursor blinking.
+//
+// Cells are painted into the renderer's retained frame; the cursor, the
+// selection highlight and the IME composition string are overlays drawn
+// over it on every paint, so moving them repaints no cells.
+//
+// Scrolling back through history is animated in whole pixels. Scrollback
+// lines are rendered once into row tiles keyed by line id and composited
+// above the screen's retained frame, so a scroll frame is a handful of
+// bitmap copies; tiles a screenful ahead in the scroll direction are
+// rendered a few per frame before they come into view. Meanwhile an
+// overview strip at the right edge maps the whole history, one bitmap
+// built from the buffer's block summaries (Core::ScrollbackOverview) and
+// rebuilt only when they change; pressing or dragging on it scrolls there.
+// Output arriving meanwhile doesn't move the view, which is anchored to
+// the screen's absolute line; while the lines in view stay where they
+// were, a frame presents only the strip and a new output indicator.
+//
+// UI Automation clients get the screen's text from a TerminalTextProvider,
+// made on the first WM_GETOBJECT; frames note output for it, and it raises
+// one TextChanged event per TIMER_TEXT_CHANGED.
+//
+// Selections are held in absolute line numbers (see
+// TerminalBuffer::GetScreenLine), so one can start in the scrollback and
+// end on the screen, and it stays on its text as output scrolls it away.
+// Copying writes the text straight into the clipboard's global memory in
+// one pass; past kDelayedCopyLines lines the clipboard is only promised the
+// text, which is written when a paste asks for it (WM_RENDERFORMAT).
+//
+// Links (see Core::LinkDetector) are looked for only in the row under the
+// mouse while Ctrl is held; the one found is underlined as an overlay and
+// opens on Ctrl+click.
+//
+// Shell integration marks (see TerminalBuffer::AddPromptMark) let
+// Ctrl+Shift+Up/Down jump between prompts and Ctrl+Shift+O select the last
+// command's output, by line number alone.
+//
+// With predictive echo on (see Core::PredictiveEcho), typed text a slow
+// shell hasn't echoed yet is drawn underlined at the cursor, another
+// overlay, and the cursor is drawn after it.
+//
+// Inline images (see TerminalBuffer::AddImage) are overlays too, drawn at
+// their cells from textures the renderer keeps; a frame showing one is
+// presented whole. The image decoder posts kImagesReadyMessage when more
+// arrive.
+//
+// A view can be split into panes (SplitPane), each showing its own session
+// in a region of the one window: one renderer, so one device context, one
+// glyph atlas and one retained frame, with every pane's changed rows
+// reported as dirty rects of the same Present. The focused pane has the
+// view's cursor, selection, scrollback view and input; the others are
+// drawn from their buffers' damage alone, and a click focuses one.
+//
+// Ctrl+wheel zooms in two steps. While the wheel turns, the renderer only
+// scales what it already has (SetPreviewScale): no text format, metrics,
+// grid or pseudoconsole changes, and no glyph rasterized. Once the wheel
+// rests for kZoomSettleMs the size is committed once, like SetFont, and
+// the grids and pseudoconsoles resize to it.
+//
+// Frames are rendered on the window's render thread when it has one
+// (SetRenderThread): the scheduler's timer is waited on there, WM_PAINT
+// only asks for a frame, and the view's messages are handled under the
+// render lock (RenderLock.h), so the two threads take turns with its state.
+//
+// Rendering is suspended while nobody can see it: the owner hides the view
+// (SetHidden), the swap chain reports the window occluded (fully covered,
+// or its monitor off), or the session is locked or disconnected
+// (WM_WTSSESSION_CHANGE). Frame requests and the blink and overlay timers
+// stop meanwhile; output is still applied to the buffers, and one whole
+// frame catches the window up when it shows again. An occluded window is
+// polled with test presents until it is uncovered.
 
 #ifndef NTDDI_VERSION
 #define NTDDI_VERSION NTDDI_WIN10_RS5
@@ -27,16 +97,38 @@ extern CAppModule _Module;
 #include <atlwin.h>
 #include <atlcrack.h>
 
+#include "UI/ColorPalette.h"
 #include "UI/D2DRenderer.h"
+#include "UI/FrameScheduler.h"
+#include "UI/PaneLayout.h"
+#include "UI/RenderCapture.h"
+#include "UI/RenderLock.h"
+#include "UI/RenderProfiler.h"
+#include "Core/InputLatency.h"
+#include "Core/KeyEncoder.h"
+#include "Core/LinkDetector.h"
+#include "Core/OutputRules.h"
+#include "Core/PredictiveEcho.h"
+#include "Core/SessionMemory.h"
+#include "Core/SessionStats.h"
 #include "Core/TerminalBuffer.h"
 #include "Emulation/VTermWrapper.h"
 
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 namespace Console3::UI {
 
+class RenderThread;
+class TerminalTextProvider;
+
 /// Cursor style
 enum class CursorStyle {
     Block,
@@ -44,37 +136,84 @@ enum class CursorStyle {
     Bar
 };
 
-/// Mouse reporting mode
+/// Mouse tracking the application asked for, in VTERM_PROP_MOUSE_* order
+/// (Session::GetMouseMode); the emulator encodes the reports
 enum class MouseMode {
-    None,       ///< No mouse reporting
-    X10,        ///< X10 basic mouse (button press only)
-    Normal,     ///< Normal tracking (button press and release)
-    SGR         ///< SGR extended (supports large coordinates)
+    None,       ///< No reporting: the mouse selects
+    Click,      ///< Button presses and releases, and the wheel
+    Drag,       ///< Also motion while a button is held
+    Move        ///< Also motion with no button held
 };
 
 /// Selection state
+/// Lines are absolute line numbers (TerminalBuffer::GetScreenLine), good
+/// within one scrollback epoch. A stream selection runs from the start to
+/// the end like text; a block selection (Alt+drag) is the rectangle of
+/// columns [startCol, endCol) on every line between.
 struct Selection {
-    int startRow = 0;
+    int64_t startLine = 0;
     int startCol = 0;
-    int endRow = 0;
+    int64_t endLine = 0;
     int endCol = 0;
+    uint64_t epoch = 0;             ///< TerminalBuffer::GetScrollbackEpoch() of the lines
     bool active = false;
+    bool block = false;             ///< Rectangular
 
     /// Check if a cell is within the selection
-    [[nodiscard]] bool Contains(int row, int col) const;
+    [[nodiscard]] bool Contains(int64_t line, int col) const;
 
-    /// Normalize selection (ensure start <= end)
+    /// Normalize selection (ensure start <= end; for a block, lines and
+    /// columns each)
     void Normalize();
 
-    /// Get selected text from buffer
-    [[nodiscard]] std::wstring GetText(const Core::TerminalBuffer& buffer) const;
+    /// Get the columns [startCol, endCol) selected on a line of a
+    /// normalized selection, wide characters whole
+    /// @return false if none are
+    [[nodiscard]] bool GetColumns(int64_t line, std::span<const Core::Cell> cells, int& startCol,
+                                  int& endCol) const;
+
+    /// Write the selected text into a new CF_UNICODETEXT global, trailing
+    /// blanks trimmed from each line
+    /// @return The global, or nullptr if out of memory
+    [[nodiscard]] HGLOBAL Export(const Core::TerminalBuffer& buffer) const;
 };
 
 /// Callback for keyboard input
 using KeyboardInputCallback = std::function<void(const char* data, size_t len)>;
 
+/// Callback for mouse input to report (e.g. Session::QueueMouseInput)
+using MouseInputCallback = std::function<void(const Emulation::MouseEvent& event)>;
+
+/// Callback for pasted text, as the clipboard holds it (UTF-16); bracketed is
+/// true in bracketed paste mode
+using PasteCallback = std::function<void(std::wstring text, bool bracketed)>;
+
+/// Supplies the telemetry shown by the diagnostics overlay
+using DiagnosticsSource = std::function<Core::SessionStats()>;
+
+/// Callback for a new grid size (e.g. Session::Resize)
+using ResizeCallback = std::function<void(int cols, int rows)>;
+
+/// Callback for a Ctrl+clicked link
+using LinkCallback = std::function<void(const Core::Link& link)>;
+
+/// Callback for the focus moving to another pane
+using PaneFocusCallback = std::function<void(uint32_t pane)>;
+
+/// What a pane shows and where its input and size go
+struct PaneBinding {
+    Core::TerminalBuffer* buffer = nullptr;
+    Emulation::VTermWrapper* vterm = nullptr;
+    KeyboardInputCallback keyboard;
+    MouseInputCallback mouse;
+    PasteCallback paste;
+    ResizeCallback resize;
+};
+
 /// Terminal rendering view
 class TerminalView : public CWindowImpl<TerminalView> {
+    friend class TerminalTextProvider;
+
 public:
     DECLARE_WND_CLASS(L"Console3TerminalView")
 
@@ -85,25 +224,41 @@ public:
     /// @param d2dFactory Direct2D factory
     /// @param dwriteFactory DirectWrite factory
     /// @param buffer Terminal buffer to display
+    /// @param backend Renderer backend (a swap chain falls back to software
+    ///        in remote sessions)
+    /// @param opacity Background opacity (see SetOpacity)
     /// @return true on success
     [[nodiscard]] bool Initialize(
         ID2D1Factory1* d2dFactory,
         IDWriteFactory1* dwriteFactory,
-        Core::TerminalBuffer* buffer
+        Core::TerminalBuffer* buffer,
+        RenderBackend backend = RenderBackend::SwapChain,
+        float opacity = 1.0f
     );
 
     /// Set the terminal buffer to display
+    /// The outgoing buffer's frame is kept while it is hidden (within a
+    /// memory cap), so showing it again repaints only the rows it changed
+    /// meanwhile. Hidden buffers are never rendered.
     void SetBuffer(Core::TerminalBuffer* buffer);
 
+    /// Drop the frame kept for a hidden buffer (call before destroying it)
+    void ForgetBuffer(Core::TerminalBuffer* buffer);
+
     /// Set the VTerm wrapper for input handling
     void SetVTerm(Emulation::VTermWrapper* vterm);
 
     /// Set callback for keyboard input
     void SetKeyboardInputCallback(KeyboardInputCallback callback);
 
+    /// Set callback for pastes (e.g. Session::Paste, which streams them in
+    /// the background); without one, pastes go through the keyboard callback
+    void SetPasteCallback(PasteCallback callback);
+
     /// Set the font
     /// @param fontName Font family name
-    /// @param fontSize Font size in points
+    /// @param fontSize Font size in points, before the zoom (Ctrl+wheel),
+    ///                 which is kept
     /// @return true on success
     [[nodiscard]] bool SetFont(const std::wstring& fontName, float fontSize);
 
@@ -116,13 +271,39 @@ public:
     /// Set whether cursor is visible
     void SetCursorVisible(bool visible);
 
+    /// Set the colors: defaults, palette, cursor and selection
+    void SetColorScheme(const Core::ColorScheme& scheme);
+
     /// Get current terminal dimensions in cells
     [[nodiscard]] int GetTerminalRows() const;
     [[nodiscard]] int GetTerminalCols() const;
 
     /// Request a redraw
+    /// Requests are coalesced and paced to the display refresh.
     void Invalidate();
 
+    /// Request a redraw that repaints every row (not just changed ones)
+    void InvalidateFrame();
+
+    /// Render nothing while hidden (a minimized window, a background tab);
+    /// requests meanwhile are dropped, and showing repaints everything once
+    void SetHidden(bool hidden);
+
+    /// Check if the owner hid the view
+    [[nodiscard]] bool IsHidden() const noexcept { return m_hidden; }
+
+    /// Check if rendering is suspended, for any reason (see file comment)
+    [[nodiscard]] bool IsSuspended() const noexcept { return m_hidden || m_occluded || m_sessionLocked; }
+
+    /// The desktop's composition changed (forwarded from the top-level
+    /// window, which alone gets WM_DWMCOMPOSITIONCHANGED): look again
+    /// whether the window is occluded, and repaint all of it if not
+    void OnCompositionChanged();
+
+    /// Free the retained frames and the renderer's glyph and brush caches
+    /// (a view hidden and idle for long); the next frame rebuilds them
+    void ReleaseCaches();
+
     /// Copy selection to clipboard
     void CopyToClipboard();
 
@@ -132,12 +313,172 @@ public:
     /// Clear selection
     void ClearSelection();
 
+    /// Scroll the previous (-1) or next (1) prompt to the top of the view
+    void JumpToPrompt(int direction);
+
+    /// Select the output of the last command above the bottom of the view
+    void SelectCommandOutput();
+
+    /// Scroll a match into view and select it (a global search hit)
+    /// @param line Absolute line (see Core::TerminalBuffer::GetScreenLine)
+    /// @param offset Byte offset of the match in the line's UTF-8 text
+    /// @param length Bytes matched
+    /// @return false if the line is no longer in the buffer
+    bool RevealMatch(uint64_t line, size_t offset, size_t length);
+
     /// Set mouse reporting mode
+    /// While the application tracks the mouse, Shift+mouse still selects
     void SetMouseMode(MouseMode mode);
 
+    /// Set callback for mouse reports; motion is sent at most once per
+    /// frame, and only when it reaches another cell
+    void SetMouseInputCallback(MouseInputCallback callback);
+
+    /// Set the application's cursor key and keypad modes, which keys are
+    /// encoded with
+    void SetKeyboardModes(Core::KeyboardModes modes) noexcept { m_keyboardModes = modes; }
+
     /// Enable/disable bracketed paste mode
     void SetBracketedPasteMode(bool enabled);
 
+    /// Set callback for grid size changes
+    /// Resizes are coalesced: while the window is being dragged the view
+    /// shows the old grid letterboxed, and the callback gets one final size
+    /// when the drag ends or the size has settled.
+    void SetResizeCallback(ResizeCallback callback);
+
+    /// Split the focused pane, the new pane taking half its area and the
+    /// focus; the setters above then bind the new pane
+    /// @return The new pane's ID
+    uint32_t SplitPane(SplitDirection direction, PaneBinding binding);
+
+    /// Close a pane (not the last); call before destroying its buffer
+    /// A focused pane hands the focus to the first pane left.
+    void ClosePane(uint32_t pane);
+
+    /// Give a pane the cursor and input
+    void FocusPane(uint32_t pane);
+
+    /// Get the focused pane (PaneLayout::kFirstPane until split)
+    [[nodiscard]] uint32_t GetFocusedPane() const noexcept { return m_focusedPane; }
+
+    /// Get the number of panes
+    [[nodiscard]] size_t GetPaneCount() const noexcept { return m_layout.GetCount(); }
+
+    /// Set callback for the focus moving to another pane (not during
+    /// SplitPane or ClosePane, whose caller knows)
+    void SetPaneFocusCallback(PaneFocusCallback callback);
+
+    /// Set the explicit (OSC 8) hyperlinks of the session shown (nullptr for none)
+    void SetHyperlinks(const Core::HyperlinkTable* table);
+
+    /// Set the output rules whose line highlights are drawn (nullptr for none)
+    void SetOutputRules(const Core::OutputRules* rules);
+
+    /// Set callback for Ctrl+clicked links; without one, web and mail links
+    /// open in their default handler and file locations in the file's editor
+    void SetLinkCallback(LinkCallback callback);
+
+    /// Notify the view that its top-level window entered or left the modal
+    /// size/move loop (WM_ENTERSIZEMOVE/WM_EXITSIZEMOVE go to that window)
+    void BeginLiveResize();
+    void EndLiveResize();
+
+    /// Set the telemetry source for the diagnostics overlay
+    /// The overlay is hidden until toggled with Ctrl+Shift+F12.
+    void SetDiagnosticsSource(DiagnosticsSource source);
+
+    /// Show or hide the diagnostics overlay
+    void ShowDiagnostics(bool show);
+
+    /// Show or hide the render profile overlay (frame time percentiles,
+    /// time by phase, draw calls and cache hit rates); Ctrl+Shift+F11
+    void ShowRenderProfile(bool show);
+
+    /// Record the next frames painted to a file the render benchmark can
+    /// replay (RenderCapture); Ctrl+Shift+F9
+    void StartRenderCapture();
+
+    /// Lay out for a DPI other than the window's (render benchmark replays)
+    void SetDpi(unsigned dpi);
+
+    /// Paint the next frames with a captured frame's selection, and its
+    /// cursor drawn or not whatever the focus and blink (render benchmark
+    /// replays; the screen comes through the emulator)
+    void ApplyCapturedFrame(const RenderCaptureFrame& frame);
+
+    /// Set the session's keypress-to-photon probe (nullptr to detach)
+    void SetInputLatencyProbe(Core::InputLatencyProbe* probe);
+
+    /// Set the session ID render and present trace events carry (0 when
+    /// detached, see Core/PipelineTrace.h)
+    void SetTraceSessionId(uint32_t sessionId) noexcept { m_traceSessionId = sessionId; }
+
+    /// Turn keypress-to-photon measurement on or off and show its overlay
+    /// (per-stage percentiles); Ctrl+Shift+F10
+    void ShowInputLatency(bool show);
+
+    /// Keep keypress-to-photon measurement on without the overlay, for every
+    /// session the view shows (the telemetry endpoint)
+    void MeasureInputLatency(bool measure);
+
+    /// Draw typed text ahead of the shell's echo when the echo is slow
+    /// (PerformanceSettings::predictiveEcho)
+    void SetPredictiveEcho(bool enable);
+
+    /// Draw the grid with the GPU cell grid shader instead of Direct2D
+    /// @return false if the renderer can't use it (Direct2D keeps drawing)
+    bool SetCellGridShader(bool enable);
+
+    /// Set the opacity of the default background (WindowSettings::opacity)
+    /// Below 1 the window behind shows through it; text and other colors
+    /// stay opaque, and frames cost what they do opaque.
+    /// @return false if the renderer's backend can't be translucent
+    bool SetOpacity(float opacity);
+
+    /// Set the GPU to draw on (PerformanceSettings::gpu)
+    void SetGpuPreference(GpuPreference preference);
+
+    /// Pick the GPU again: the window moved to another monitor, or the
+    /// displays changed (see D2DRenderer::UpdateAdapter)
+    void UpdateAdapter();
+
+    /// Draw text with the font's programming ligatures (shaped once per run
+    /// and cached)
+    void SetLigatures(bool enable);
+
+    /// Cap the frame rate below the display's (see FrameScheduler)
+    /// @param fps Frames a second (0 = the display's refresh rate)
+    void SetMaxFrameRate(unsigned fps) noexcept;
+
+    /// Save power (on battery): frames capped at 30 a second, below any
+    /// lower cap, and the cursor blinking at half the rate
+    void SetPowerSaving(bool saving);
+
+    /// Render a frame now instead of on the scheduler's clock (benchmarks
+    /// drive the offscreen backend this way)
+    void RenderNow() { Render(); }
+
+    /// Render on a thread instead of the UI thread's message loop
+    /// @param thread The window's render thread (nullptr = the message loop);
+    ///        must outlive the view or the next call
+    void SetRenderThread(RenderThread* thread);
+
+    /// Handle the view's messages under the render lock
+    WNDPROC GetWindowProc() override { return RenderLockedWindowProc<TerminalView>; }
+
+    /// Fill in what rendering holds for the session shown: the retained
+    /// frames (on screen and hidden), cached row tiles and the atlas share
+    void GetRenderMemory(Core::SessionMemory& memory) const noexcept;
+
+    /// Get the time every frame took and the refreshes frames missed, since
+    /// the view was created (telemetry)
+    [[nodiscard]] const Core::LatencyHistogram& GetFrameTimes() const noexcept { return m_profiler.GetFrameTimes(); }
+    [[nodiscard]] uint64_t GetMissedFrames() const noexcept { return m_scheduler.GetMissedFrames(); }
+
+    /// Get the renderer (nullptr before Initialize)
+    [[nodiscard]] D2DRenderer* GetRenderer() const noexcept { return m_renderer.get(); }
+
     // Message map
     BEGIN_MSG_MAP(TerminalView)
         MSG_WM_CREATE(OnCreate)
@@ -149,13 +490,26 @@ public:
         MSG_WM_SETFOCUS(OnSetFocus)
         MSG_WM_KILLFOCUS(OnKillFocus)
         MSG_WM_KEYDOWN(OnKeyDown)
+        MSG_WM_SYSKEYDOWN(OnSysKeyDown)
         MSG_WM_KEYUP(OnKeyUp)
         MSG_WM_CHAR(OnChar)
         MSG_WM_LBUTTONDOWN(OnLButtonDown)
         MSG_WM_LBUTTONUP(OnLButtonUp)
         MSG_WM_MOUSEMOVE(OnMouseMove)
+        MESSAGE_HANDLER(WM_MOUSELEAVE, OnMouseLeave)
         MSG_WM_MOUSEWHEEL(OnMouseWheel)
+        MSG_WM_SETCURSOR(OnSetCursor)
+        MSG_WM_RENDERFORMAT(OnRenderFormat)
+        MSG_WM_RENDERALLFORMATS(OnRenderAllFormats)
+        MSG_WM_DESTROYCLIPBOARD(OnDestroyClipboard)
+        MESSAGE_HANDLER(kSetTimerMessage, OnSetTimerMessage)
+        MESSAGE_HANDLER(kGlyphsReadyMessage, OnGlyphsReady)
+        MESSAGE_HANDLER(kImagesReadyMessage, OnImagesReady)
+        MESSAGE_HANDLER(WM_WTSSESSION_CHANGE, OnSessionChange)
+        MESSAGE_HANDLER(WM_GETOBJECT, OnGetObject)
+        MESSAGE_HANDLER(WM_DPICHANGED_AFTERPARENT, OnDpiChangedAfterParent)
         // IME messages for CJK input
+        MESSAGE_HANDLER(WM_IME_SETCONTEXT, OnImeSetContext)
         MESSAGE_HANDLER(WM_IME_STARTCOMPOSITION, OnImeStartComposition)
         MESSAGE_HANDLER(WM_IME_COMPOSITION, OnImeComposition)
         MESSAGE_HANDLER(WM_IME_ENDCOMPOSITION, OnImeEndComposition)
@@ -173,14 +527,27 @@ private:
     void OnSetFocus(CWindow wndOld);
     void OnKillFocus(CWindow wndNew);
     void OnKeyDown(UINT nChar, UINT nRepCnt, UINT nFlags);
+    void OnSysKeyDown(UINT nChar, UINT nRepCnt, UINT nFlags);
     void OnKeyUp(UINT nChar, UINT nRepCnt, UINT nFlags);
     void OnChar(UINT nChar, UINT nRepCnt, UINT nFlags);
     void OnLButtonDown(UINT nFlags, CPoint point);
     void OnLButtonUp(UINT nFlags, CPoint point);
     void OnMouseMove(UINT nFlags, CPoint point);
+    LRESULT OnMouseLeave(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
     BOOL OnMouseWheel(UINT nFlags, short zDelta, CPoint pt);
+    BOOL OnSetCursor(CWindow wnd, UINT nHitTest, UINT message);
+    void OnRenderFormat(UINT uFormat);
+    void OnRenderAllFormats();
+    void OnDestroyClipboard();
+    LRESULT OnDpiChangedAfterParent(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
+    LRESULT OnSetTimerMessage(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
+    LRESULT OnGlyphsReady(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
+    LRESULT OnImagesReady(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
+    LRESULT OnSessionChange(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
+    LRESULT OnGetObject(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
 
     // IME handlers for CJK input
+    LRESULT OnImeSetContext(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
     LRESULT OnImeStartComposition(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
     LRESULT OnImeComposition(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
     LRESULT OnImeEndComposition(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
@@ -188,27 +555,157 @@ private:
 
     // Rendering
     void Render();
-    void RenderRow(int row);
+    void RenderFrame();                 ///< Render() inside its trace activity
+    bool UpdateFrame(float& scrolled);  ///< false = repainted whole window; scrolled = distance moved
+    void RenderDamage(Core::TerminalBuffer& buffer, float right);  ///< Changed columns of dirty rows; right = edge of the last column's span
+    void RenderRow(int row, int startCol = 0, int endCol = -1);  ///< Columns [startCol, endCol), -1 = to the end
+    void RenderCells(std::span<const Core::Cell> cells, std::span<const Core::StyleRun> runs, float y,
+                     int startCol = 0, int endCol = -1, bool backgrounds = true);  ///< runs empty = split here
     void RenderCursor();
-    void RenderSelection();
+    D2D1_RECT_F RenderSelection(float offset = 0.0f);  ///< Returns the rows it covers (empty if none); offset = screen's y
+    bool RenderRuleHighlights(float offset = 0.0f);     ///< Wash lines output rules matched; returns true if any
+    bool RenderImages(float offset = 0.0f);             ///< Inline images in view; returns true if any drawn
+    void UpdateCellPixelSize();         ///< Tell the emulators the cell size in device pixels (sizes images)
+    bool RenderImeComposition();        ///< false = nothing being composed
+    bool RenderPredictions();           ///< false = no predicted echo shown
+    void GetShownCursor(int& row, int& col) const;  ///< The shell's cursor, or after the predictions
+    bool ReconcilePredictions();        ///< Judge the predictions; true = repaint
+    void RenderDiagnostics();
+    void RenderProfile();
+    void RenderInputLatency();
+    enum class PanelCorner { TopRight, BottomRight, BottomLeft };
+    void RenderPanel(const std::vector<std::wstring>& lines, PanelCorner corner);
+    void RenderOverlays();              ///< Diagnostics, render profile and input latency, when shown
+    void CaptureFrame();                ///< Record the frame being painted (StartRenderCapture)
+    bool IsCursorShown() const;         ///< Visible, focused and in the blink's on phase (or as replayed)
+    unsigned GetViewDpi() const;        ///< The window's DPI, or SetDpi()'s
+    void UpdateOverlayTimer();
+    void UpdateInputLatencyProbe();     ///< On while shown or measured
+    void RenderGrid(CellGridRenderer& grid);          ///< Render() through the cell grid shader
+    void EndDraw();                     ///< Present; after a device loss, repaint and restore caches
+    void BuildGridRow(CellGridRenderer& grid, int row);
+
+    // Scrollback view
+    void StepScroll();                  ///< Follow pushed lines and animate toward the target
+    void RenderHistory();               ///< Render() while scrolled back
+    bool PrepareTile(size_t index, float width);  ///< false = already rendered or no such line
+    const RowTile* FindTile(size_t index) const;
+    void TrimTiles(size_t keep);        ///< Drop least recently used tiles over the cap
+    void ScrollToBottom();              ///< Back to the screen at once
+    void ScrollBy(float distance);      ///< Move the scroll target (DIPs, positive = into history)
+    void ScrollToLine(uint64_t line);   ///< Move the scroll target to put an absolute line at the top
+    float GetScrollOffset() const;      ///< Where the screen is drawn (m_scrollPixels in whole pixels)
+
+    // Scrollback overview strip
+    void RenderOverview();              ///< The strip and the lines in view on it
+    bool UpdateOverview();              ///< Rebuild its image if what it shows changed; false = nothing to show
+    D2D1_RECT_F GetOverviewRect() const;
+    bool HitTestOverview(CPoint point) const;   ///< On the strip, and it is shown
+    void ScrollToOverview(int y);       ///< Center the view on the history at a y on the strip
+    D2D1_RECT_F RenderNewOutput();      ///< The new output indicator; returns where (empty if none)
+
+    // Selection and clipboard
+    void RenderPendingCopy();           ///< Write a promised copy before its buffer changes
+
+    // Links
+    void UpdateHoverLink(CPoint point, bool ctrl);      ///< Find the link under the mouse
+    bool RenderHoverLink();             ///< Underline it; returns true if drawn
+    void OpenLink(const Core::Link& link);
+
+    // Line times (scrollbackTimestamps)
+    void UpdateLineTime(CPoint point, bool buttonHeld);  ///< Note the line under the mouse
+    bool RenderLineTime();              ///< Its time at the pane's right; returns true if drawn
+
+    // Resizing
+    void CommitResize();
+
+    // Zoom (see file comment)
+    void ZoomBy(float points);          ///< Move the zoom and preview it
+    bool CommitZoom();                  ///< Set the font at the zoomed size
+    [[nodiscard]] float GetZoomedSize(float zoom) const noexcept;
+
+    // Split panes
+    struct Pane;
+    void LayoutPanes();                 ///< Place the panes over the window and resize their grids
+    void SwapFocusedPane(Pane& pane);   ///< Exchange the focused pane's binding and place with pane's
+    [[nodiscard]] D2D1_RECT_F GetPaneRect() const;      ///< The focused pane's area (the window unsplit)
+    [[nodiscard]] uint32_t HitTestPane(CPoint point) const;  ///< 0 = none (a divider)
+    bool ScrollPane(Pane& pane);        ///< Move a pane's scrolled rows in the frame; false = repaint it
+    void RenderPane(Pane& pane);        ///< Paint an unfocused pane's damage into the frame
+    void RenderDividers();
+
+    // Frames of hidden buffers
+    void TrimHiddenFrames();
 
     // Input handling
-    void SendKeyToTerminal(UINT vkey, UINT scanCode, bool keyDown);
+    /// Send a key that is not text (see Core::EncodeKey)
+    /// @param charMessage The character message the key posted (WM_CHAR or
+    ///        WM_SYSCHAR), dropped if the key was sent
+    /// @return true if the key was sent
+    bool SendKeyToTerminal(UINT vkey, UINT nFlags, UINT charMessage);
     void SendCharToTerminal(wchar_t ch);
-    void SendMouseReport(int button, int row, int col, bool pressed);
+    /// Add bytes to the input going out with the next flush
+    void QueueInput(std::string_view bytes);
+    /// Hand the queued input to the keyboard callback as one write
+    void FlushInput();
+    /// Flush, unless more keys are waiting in the message queue (a repeat
+    /// burst the UI thread fell behind on); those are flushed together
+    /// once it is drained, by the next paint at the latest
+    void FlushInputIfIdle();
+    /// Check if a mouse message goes to the application rather than the view
+    bool IsMouseReported(UINT nFlags) const;
+    /// Report a button or wheel event (after any motion still pending)
+    void SendMouseButton(int button, bool pressed, CPoint point, UINT nFlags);
+    /// Report the motion held back for this frame
+    void FlushMouseMotion();
+    Emulation::MouseEvent MakeMouseEvent(CPoint point, UINT nFlags) const;
 
     // Coordinate conversion
     int PixelToRow(int y) const;
+    int64_t PixelToLine(int y) const;   ///< Absolute line at a y, scrolled back or not
     int PixelToCol(int x) const;
     float RowToPixel(int row) const;
     float ColToPixel(int col) const;
 
     // Timer IDs
     static constexpr UINT_PTR TIMER_CURSOR_BLINK = 1;
+    static constexpr UINT_PTR TIMER_DIAGNOSTICS = 2;
+    static constexpr UINT_PTR TIMER_RESIZE = 3;
+    static constexpr UINT_PTR TIMER_DEVICE_RESTORE = 4;
+    static constexpr UINT_PTR TIMER_PREDICTION = 5;
+    static constexpr UINT_PTR TIMER_OCCLUSION = 6;
+    static constexpr UINT_PTR TIMER_TEXT_CHANGED = 7;
+    static constexpr UINT_PTR TIMER_ZOOM = 8;
+
+    // Posted by the render thread to start a timer, which only the window's
+    // thread can: wParam is the timer, lParam the interval
+    static constexpr UINT kSetTimerMessage = WM_APP + 1;
+
+    // Posted by the glyph rasterizer when glyphs drawn blank may be ready
+    static constexpr UINT kGlyphsReadyMessage = WM_APP + 2;
+
+    // Posted by the image decoder when decoded images were stored
+    static constexpr UINT kImagesReadyMessage = WM_APP + 3;
+
+    /// Start a timer from either thread
+    void StartTimer(UINT_PTR id, UINT milliseconds);
+
+    /// Rasterize the glyphs a new atlas was seeded with, a few per tick
+    /// (TIMER_DEVICE_RESTORE)
+    void PrewarmGlyphs();
+
+    /// Set one reason for suspending rendering; the last one cleared
+    /// renders a whole frame and restarts the timers
+    void SetSuspended(bool& reason, bool suspended);
+
+    /// Get the blink timer's period (the rate, stretched to save power)
+    [[nodiscard]] UINT GetBlinkPeriod() const noexcept;
 
 private:
     // Renderer
     std::unique_ptr<D2DRenderer> m_renderer;
+    FrameScheduler m_scheduler;
+    RenderThread* m_renderThread = nullptr;     ///< Frames render there (the scheduler waits on it)
 
     // Terminal state (not owned)
     Core::TerminalBuffer* m_buffer = nullptr;
@@ -216,30 +713,219 @@ private:
 
     // Callbacks
     KeyboardInputCallback m_keyboardCallback;
+    PasteCallback m_pasteCallback;
+    MouseInputCallback m_mouseCallback;
+    DiagnosticsSource m_diagnosticsSource;
+    ResizeCallback m_resizeCallback;
+    LinkCallback m_linkCallback;
+
+    // Diagnostics and render profile overlays
+    bool m_showDiagnostics = false;
+    bool m_showRenderProfile = false;
+    RenderProfiler m_profiler;
+    Core::InputLatencyProbe* m_inputLatency = nullptr;   // Session's (not owned)
+    uint32_t m_traceSessionId = 0;
+    bool m_showInputLatency = false;
+    bool m_measureInputLatency = false;
+
+    // Render capture (StartRenderCapture) and replay
+    std::unique_ptr<RenderCaptureWriter> m_capture;
+    std::wstring m_captureNotice;       // Shown until m_captureNoticeEnd (GetTickCount64)
+    uint64_t m_captureNoticeEnd = 0;
+    unsigned m_dpiOverride = 0;         // SetDpi (0 = the window's)
+    std::optional<bool> m_replayCursor; // ApplyCapturedFrame
+
+    // Retained frame needs a full repaint (layout, selection or buffer changed)
+    bool m_frameStale = true;
+    int m_frameRows = 0;             // Buffer size the frame was painted at
+    int m_frameCols = 0;
+    std::vector<uint32_t> m_runText; // Codepoints of the text run being built
+    std::vector<Core::StyleRun> m_styleRuns; // Style runs of a line drawn without the buffer's
+
+    // Retained frames of buffers not on screen, most recently hidden last
+    struct HiddenFrame {
+        Core::TerminalBuffer* buffer = nullptr;
+        SavedFrame frame;
+        int rows = 0;                // Buffer size the frame was painted at
+        int cols = 0;
+    };
+    std::vector<HiddenFrame> m_hiddenFrames;
+    bool m_windowStale = false;      // Window shows another buffer; present all of the next frame
+    bool m_hidden = false;           // See SetHidden()
+    bool m_occluded = false;         // The last present found the window occluded
+    bool m_sessionLocked = false;    // The session is locked or disconnected
+    bool m_sessionNotify = false;    // Registered for WM_WTSSESSION_CHANGE
+
+    // UI Automation root, made on the first request for it, and whether a
+    // TextChanged event is waiting on TIMER_TEXT_CHANGED
+    ComPtr<TerminalTextProvider> m_textProvider;
+    bool m_textChangePending = false;
+
+    // Atlas generation the cell grid's glyphs were found in
+    uint64_t m_gridGeneration = 0;
+
+    // Renderer device the frames were drawn on (see EndDraw)
+    uint64_t m_deviceGeneration = 0;
+
+    // Cursor cell as last presented, to report it changed when it moves
+    D2D1_RECT_F m_cursorCell{};
+    bool m_cursorDrawn = false;
+
+    // Resize coalescing
+    bool m_liveResize = false;       // Inside the modal size/move loop
+    bool m_resizePending = false;    // Grid size not committed yet (preview shown)
+    int m_gridRows = 0;              // Last grid size passed to the resize callback
+    int m_gridCols = 0;
+
+    // Zoom: points added to the font size set
+    std::wstring m_fontName;
+    float m_fontSize = 0.0f;         // As set (SetFont)
+    float m_zoom = 0.0f;             // Committed
+    float m_zoomTarget = 0.0f;       // Previewed until TIMER_ZOOM commits it
+
+    // Split panes: the focused pane's binding is the view's own state
+    // (m_buffer, m_vterm, the input callbacks, m_frame*, m_grid*); each
+    // other pane keeps its own
+    struct Pane {
+        uint32_t id = 0;
+        PaneBinding binding;
+        D2D1_RECT_F rect{};
+        int frameRows = 0;           // Buffer size its region was painted at
+        int frameCols = 0;
+        int gridRows = 0;            // Last grid size passed to its resize callback
+        int gridCols = 0;
+        bool stale = true;           // Its region needs a full repaint
+    };
+    PaneLayout m_layout;
+    std::vector<Pane> m_panes;       // The unfocused panes
+    std::vector<PaneRect> m_dividers;
+    uint32_t m_focusedPane = PaneLayout::kFirstPane;
+    D2D1_RECT_F m_paneRect{};        // The focused pane's area (split only)
+    D2D1_POINT_2F m_origin{};        // Top left of the pane being drawn (the focused one but in RenderPane)
+    PaneFocusCallback m_paneFocusCallback;
 
     // Cursor state
     CursorStyle m_cursorStyle = CursorStyle::Block;
     bool m_cursorVisible = true;
     bool m_cursorBlinkState = true;  // true = visible in blink cycle
     UINT m_cursorBlinkRate = 530;    // milliseconds
+    unsigned m_maxFrameRate = 0;     // SetMaxFrameRate's cap (0 = none)
+    bool m_powerSaving = false;      // See SetPowerSaving()
     bool m_hasFocus = false;
 
     // Selection state
     Selection m_selection;
     bool m_isSelecting = false;
-
-    // Scroll offset (for scrollback viewing)
-    int m_scrollOffset = 0;
+    bool m_selectionChanged = false; // Since the last paint
+    D2D1_RECT_F m_selectionBand{};   // Rows the selection covered as last presented
+
+    // Copy promised to the clipboard and not written yet (see file comment)
+    struct PendingCopy {
+        Core::TerminalBuffer* buffer = nullptr;
+        Selection selection;
+    };
+    std::optional<PendingCopy> m_pendingCopy;
+
+    // Link under the mouse while Ctrl is held, on the row generation it was
+    // found in (a rewritten row drops it)
+    struct HoverLink {
+        int row = 0;
+        uint64_t generation = 0;
+        Core::Link link;
+    };
+    Core::LinkDetector m_links;
+    std::optional<HoverLink> m_hoverLink;
+    bool m_hoverDrawn = false;          // Underline is in the presented frame
+
+    // Line under the mouse, whose time is shown (none outside the pane or
+    // while a button is held)
+    std::optional<uint64_t> m_timeLine;
+    bool m_timeDrawn = false;           // Its time is in the presented frame
+    bool m_leaveTracked = false;        // TrackMouseEvent(TME_LEAVE) is armed
+
+    // Lines highlighted by output rules
+    const Core::OutputRules* m_outputRules = nullptr;
+    std::vector<Core::LineHighlight> m_highlights;      // Scratch: those in view
+    bool m_highlightsDrawn = false;     // Some are in the presented frame
+
+    // Inline images
+    std::vector<Core::ImagePlacement> m_imagePlacements; // Scratch: those in view
+    bool m_imagesDrawn = false;         // Some are in the presented frame
+
+    // IME composition string drawn at the cursor
+    std::wstring m_imeComposition;
+    bool m_imeDrawn = false;
+
+    // Typed text drawn ahead of the shell's echo
+    Core::PredictiveEcho m_echo;
+    std::vector<Core::Cell> m_echoRow;  // Scratch: a row with the predictions in it
+    bool m_echoDrawn = false;
+
+    // Scrollback view: how far (DIPs) the view is scrolled up from the
+    // screen, and where the animation is heading
+    float m_scrollPixels = 0.0f;
+    float m_scrollTarget = 0.0f;
+    int m_scrollDirection = 1;       // 1 = into history, -1 = toward the screen
+    uint64_t m_anchorLine = 0;       // Screen line (GetScreenLine) when last rendered
+    uint64_t m_anchorEpoch = 0;
+
+    // While scrolled back: the view's top (screen line * cell height -
+    // offset, in device pixels) as last presented, and output since the
+    // view left the screen. Output that leaves the lines in view where they
+    // were presents only the overview strip and the new output indicator.
+    std::optional<int64_t> m_historyTop;
+    uint64_t m_newLines = 0;         // Lines pushed
+    bool m_newOutput = false;        // Lines pushed or screen rows changed
+    uint64_t m_newLinesDrawn = 0;    // The indicator as presented
+    bool m_newOutputDrawn = false;
+    D2D1_RECT_F m_newOutputRect{};
+
+    // Rendered scrollback lines by line id; ids with kUncachedTile set are
+    // indices of lines being re-wrapped, only good for one frame
+    struct CachedTile {
+        RowTile tile;
+        uint64_t lastUsed = 0;       // m_tileFrame it was last needed in
+    };
+    std::unordered_map<uint64_t, CachedTile> m_tiles;
+    uint64_t m_tileFrame = 0;
+    uint64_t m_tileEpoch = 0;        // Scrollback epoch the tiles belong to
+    uint64_t m_tileGeneration = 0;   // Renderer tile generation they were drawn at
+
+    // Overview strip shown while scrolled back: what its image was built
+    // from, rebuilt when any of it changes (see Core::ScrollbackOverview)
+    struct OverviewSource {
+        const Core::TerminalBuffer* buffer = nullptr;
+        const Core::OutputRules* rules = nullptr;
+        uint64_t version = 0;        // ScrollbackOverview::GetVersion()
+        uint64_t highlights = 0;     // OutputRules::GetHighlightGeneration()
+        uint64_t firstLine = 0;      // Lines [firstLine, endLine) span the strip
+        uint64_t endLine = 0;
+        UINT32 rows = 0;             // Texel rows (device pixels, capped)
+
+        bool operator==(const OverviewSource&) const = default;
+    };
+    OverviewSource m_overviewSource;
+    std::vector<uint32_t> m_overviewPixels;
+    std::vector<Core::LineHighlight> m_overviewHits;    // Scratch
+    bool m_overviewDrag = false;     // The left button went down on the strip
 
     // Colors
-    Color m_defaultFg = Color::FromRgb(204, 204, 204);
-    Color m_defaultBg = Color::FromRgb(12, 12, 12);
-    Color m_cursorColor = Color::FromRgb(255, 255, 255);
-    Color m_selectionColor = Color::FromRgb(38, 79, 120);
+    ColorPalette m_palette;
+    ResolvedColor m_cursorColor = ColorPalette::FromRgb(0xFFFFFF);
+    ResolvedColor m_selectionColor = ColorPalette::FromRgb(0x264F78);
+
+    // Keyboard input
+    Core::KeyboardModes m_keyboardModes;
+    std::string m_inputBatch;           ///< Encoded keys not yet written
+    wchar_t m_pendingSurrogate = 0;     ///< High surrogate waiting for its pair
 
     // Mouse and paste modes
     MouseMode m_mouseMode = MouseMode::None;
     bool m_bracketedPasteMode = false;
+    std::optional<Emulation::MouseEvent> m_pendingMotion; ///< Latest move this frame
+    int m_mouseRow = -1;                ///< Cell last reported
+    int m_mouseCol = -1;
+    bool m_mousePressReported = false;  ///< The left button press went to the application
 };
 
 } // namespace Console3::UI
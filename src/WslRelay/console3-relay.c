@@ -0,0 +1,260 @@
+/*
+ * Console3 - console3-relay.c
+ * Runs a WSL tab's shell on a Linux pty, without ConPTY
+ *
+ * A WSL tab normally goes shell -> Linux pty -> wsl.exe -> conhost, which
+ * re-renders the screen and serializes it back to VT, before Console3 sees
+ * a byte. With this relay installed next to Console3.exe, Console3 starts
+ * wsl.exe on plain pipes (no pseudo console) running the relay, which owns
+ * a real pty: the shell's output reaches Console3's output ring exactly as
+ * written, and keystrokes reach the shell the same way.
+ *
+ * Resizes go out of band, through a FIFO: a second wsl.exe runs the relay
+ * with --forward, copying Console3's control pipe into the FIFO, and the
+ * relay applies "resize <cols> <rows>" lines to the pty (the kernel then
+ * signals the shell). The data streams carry nothing but terminal bytes.
+ *
+ *   console3-relay --cols N --rows N --control FIFO
+ *   console3-relay --forward FIFO
+ *
+ * Built in a distro (statically, so one binary serves every x86-64 distro):
+ *   cc -O2 -static -o console3-relay console3-relay.c -lutil
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <pwd.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Largest single read from the pty or stdin */
+#define RELAY_CHUNK (64 * 1024)
+
+/* How long --forward waits for the relay to create the FIFO (ms) */
+#define FORWARD_WAIT_MS 10000
+
+/* Write everything; 0 on success */
+static int write_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        const ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+    return 0;
+}
+
+/* Copy stdin into the FIFO once the relay has made it */
+static int forward(const char *path) {
+    struct stat st;
+    const struct timespec pause = {0, 20 * 1000 * 1000};
+    for (int waited = 0; stat(path, &st) != 0 || !S_ISFIFO(st.st_mode); waited += 20) {
+        if (waited >= FORWARD_WAIT_MS) {
+            return 1;
+        }
+        nanosleep(&pause, NULL);
+    }
+
+    const int fifo = open(path, O_WRONLY);
+    if (fifo < 0) {
+        return 1;
+    }
+
+    char buffer[256];
+    for (;;) {
+        const ssize_t got = read(STDIN_FILENO, buffer, sizeof(buffer));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0 || write_all(fifo, buffer, (size_t)got) != 0) {
+            break;
+        }
+    }
+    close(fifo);
+    return 0;
+}
+
+/* Apply complete "resize <cols> <rows>" lines; keeps a partial line */
+static void apply_control(int master, char *line, size_t *length) {
+    char *start = line;
+    char *end;
+    while ((end = memchr(start, '\n', (size_t)(line + *length - start))) != NULL) {
+        *end = '\0';
+        unsigned cols = 0;
+        unsigned rows = 0;
+        if (sscanf(start, "resize %u %u", &cols, &rows) == 2 && cols > 0 && rows > 0) {
+            struct winsize size = {0};
+            size.ws_col = (unsigned short)cols;
+            size.ws_row = (unsigned short)rows;
+            ioctl(master, TIOCSWINSZ, &size);
+        }
+        start = end + 1;
+    }
+
+    *length = (size_t)(line + *length - start);
+    memmove(line, start, *length);
+}
+
+/* Start the user's login shell in their home directory */
+static void exec_shell(void) {
+    const struct passwd *user = getpwuid(getuid());
+    const char *shell = user && user->pw_shell && *user->pw_shell ? user->pw_shell : "/bin/sh";
+    const char *home = user && user->pw_dir ? user->pw_dir : getenv("HOME");
+    if (home) {
+        (void)chdir(home);
+    }
+    setenv("TERM", "xterm-256color", 1);
+
+    /* A leading dash makes it a login shell */
+    const char *name = strrchr(shell, '/');
+    char login[256];
+    snprintf(login, sizeof(login), "-%s", name ? name + 1 : shell);
+    execl(shell, login, (char *)NULL);
+    _exit(127);
+}
+
+static int relay(unsigned cols, unsigned rows, const char *control) {
+    unlink(control);
+    if (mkfifo(control, 0600) != 0) {
+        perror("console3-relay: mkfifo");
+        return 1;
+    }
+
+    struct winsize size = {0};
+    size.ws_col = (unsigned short)cols;
+    size.ws_row = (unsigned short)rows;
+    int master = -1;
+    const pid_t child = forkpty(&master, NULL, NULL, &size);
+    if (child < 0) {
+        perror("console3-relay: forkpty");
+        unlink(control);
+        return 1;
+    }
+    if (child == 0) {
+        exec_shell();
+    }
+
+    /* Read-write, so the FIFO never reports end of file between writers */
+    const int fifo = open(control, O_RDWR | O_NONBLOCK);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+    signal(SIGPIPE, SIG_IGN);
+
+    static char output[RELAY_CHUNK];
+    static char input[RELAY_CHUNK];
+    size_t inputStart = 0;
+    size_t inputEnd = 0;
+    char line[128];
+    size_t lineLength = 0;
+    int stdinOpen = 1;
+
+    for (;;) {
+        /* Input is taken only once the last of it is in the pty, so a
+           shell not reading holds back Console3 rather than the relay */
+        struct pollfd fds[3] = {
+            {master, POLLIN | (inputEnd > inputStart ? POLLOUT : 0), 0},
+            {stdinOpen && inputEnd == inputStart ? STDIN_FILENO : -1, POLLIN, 0},
+            {fifo, POLLIN, 0},
+        };
+        if (poll(fds, 3, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            const ssize_t got = read(master, output, sizeof(output));
+            if (got > 0) {
+                if (write_all(STDOUT_FILENO, output, (size_t)got) != 0) {
+                    break;
+                }
+            } else if (got == 0 || (errno != EAGAIN && errno != EINTR)) {
+                break;      /* EIO: the shell and everything on the pty exited */
+            }
+        }
+
+        if (fds[0].revents & POLLOUT) {
+            const ssize_t written = write(master, input + inputStart, inputEnd - inputStart);
+            if (written > 0) {
+                inputStart += (size_t)written;
+            }
+            if (inputStart == inputEnd) {
+                inputStart = inputEnd = 0;
+            }
+        }
+
+        if (fds[1].revents & (POLLIN | POLLHUP)) {
+            const ssize_t got = read(STDIN_FILENO, input, sizeof(input));
+            if (got > 0) {
+                inputStart = 0;
+                inputEnd = (size_t)got;
+            } else if (got == 0 || errno != EINTR) {
+                /* Console3 closed the tab */
+                stdinOpen = 0;
+                kill(child, SIGHUP);
+            }
+        }
+
+        if (fifo >= 0 && (fds[2].revents & POLLIN)) {
+            const ssize_t got = read(fifo, line + lineLength, sizeof(line) - 1 - lineLength);
+            if (got > 0) {
+                lineLength += (size_t)got;
+                apply_control(master, line, &lineLength);
+                if (lineLength == sizeof(line) - 1) {
+                    lineLength = 0;     /* No message is that long */
+                }
+            }
+        }
+    }
+
+    unlink(control);
+    int status = 0;
+    if (waitpid(child, &status, 0) < 0) {
+        return 1;
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+int main(int argc, char **argv) {
+    unsigned cols = 80;
+    unsigned rows = 25;
+    const char *control = NULL;
+    const char *forwardTo = NULL;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--cols") == 0) {
+            cols = (unsigned)strtoul(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "--rows") == 0) {
+            rows = (unsigned)strtoul(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "--control") == 0) {
+            control = argv[i + 1];
+        } else if (strcmp(argv[i], "--forward") == 0) {
+            forwardTo = argv[i + 1];
+        }
+    }
+
+    if (forwardTo) {
+        return forward(forwardTo);
+    }
+    if (!control || cols == 0 || rows == 0) {
+        fprintf(stderr, "usage: console3-relay --cols N --rows N --control FIFO\n"
+                        "       console3-relay --forward FIFO\n");
+        return 2;
+    }
+    return relay(cols, rows, control);
+}
@@ -1,7 +1,39 @@
 // Console3 - main.cpp
 // Application entry point
 //
-// Initializes WTL, COM, and the main application window.
+// Initializes WTL, COM, and the main application window. The Direct2D and
+// DirectWrite factories are created on first use (RenderFactories), and
+// shell detection and font enumeration run in the background once the
+// window is up, so the window and the default shell come first.
+//
+// With singleProcess set, a launch while Console3 is running hands itself
+// to that process (InstanceChannel), which opens another window sharing its
+// rendering resources; this process then exits before loading anything.
+//
+// With restoreTabsOnStartup set, each session the last run saved
+// (SessionSnapshots) opens again in a window of its own, its output back in
+// the scrollback.
+//
+// "Console3.exe --diagnostics [file]" opens no window: it asks the running
+// process to write its memory report (MainFrame::FormatMemoryReport) to the
+// file, Console3-diagnostics.txt in the current directory by default, and
+// exits with 0 once it is written.
+//
+// "Console3.exe --exit-after-first-frame" starts in a process of its own and
+// quits once the shell's first output is on screen, after appending the
+// startup milestones (StartupTrace) to the startup log: a cold-start
+// benchmark to run in a loop.
+//
+// "Console3.exe --host NAME [--allow-remote]" opens no window: it runs a
+// shell as a session host (SessionHost) until the shell exits. "Console3.exe
+// --attach NAME [--server MACHINE]" opens a window, in a process of its
+// own, on the host of that name, starting one on this machine if there is
+// none. Closing the window leaves the shell running for the next --attach.
+//
+// "Console3.exe --serial NAME" opens a window, in a process of its own, on
+// a serial line instead of a shell: NAME is a profile with a serialPort, or
+// a port and optional speed ("COM3", "COM3:921600", 8N1 without flow
+// control).
 
 // Target Windows 10 RS5 (1809) or later
 #ifndef NTDDI_VERSION
@@ -39,77 +71,224 @@ CAppModule _Module;
 #include <atlcrack.h>
 #include <atlmisc.h>
 
-// Direct2D/DirectWrite for rendering
-#include <d2d1_1.h>
-#include <dwrite_1.h>
-#include <wrl/client.h>
-
 // Application headers
+#include "Core/HostProtocol.h"
+#include "Core/IdleScheduler.h"
+#include "Core/SegmentedRingBuffer.h"
+#include "Core/SerialPort.h"
+#include "Core/SessionHost.h"
+#include "Core/SessionReaper.h"
+#include "Core/SessionSnapshot.h"
+#include "Core/Settings.h"
+#include "Core/SettingsWatcher.h"
+#include "Core/StartupTrace.h"
+#include "Core/Utf.h"
+#include "UI/InstanceChannel.h"
 #include "UI/MainFrame.h"
+#include "UI/MessageLoop.h"
+
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
 
 #pragma comment(lib, "comctl32.lib")
-#pragma comment(lib, "d2d1.lib")
-#pragma comment(lib, "dwrite.lib")
 
-using Microsoft::WRL::ComPtr;
+/// Default file of --diagnostics
+constexpr wchar_t kDiagnosticsFile[] = L"Console3-diagnostics.txt";
+
+/// Time --attach waits for a host it started to open its pipe
+constexpr ULONGLONG kHostStartMs = 5000;
 
 /// Initialize common controls
 bool InitializeCommonControls() {
     INITCOMMONCONTROLSEX icc{};
     icc.dwSize = sizeof(icc);
-    icc.dwICC = ICC_BAR_CLASSES | ICC_COOL_CLASSES | ICC_TAB_CLASSES;
+    icc.dwICC = ICC_BAR_CLASSES | ICC_COOL_CLASSES | ICC_TAB_CLASSES | ICC_LISTVIEW_CLASSES;
     return InitCommonControlsEx(&icc) != FALSE;
 }
 
-/// Initialize Direct2D factory
-ComPtr<ID2D1Factory1> InitializeDirect2D() {
-    ComPtr<ID2D1Factory1> factory;
-    
-    D2D1_FACTORY_OPTIONS options{};
-#ifdef _DEBUG
-    options.debugLevel = D2D1_DEBUG_LEVEL_INFORMATION;
-#else
-    options.debugLevel = D2D1_DEBUG_LEVEL_NONE;
-#endif
+/// Get the directory this process was started in
+std::wstring GetStartDirectory() {
+    std::wstring dir(MAX_PATH, L'\0');
+    DWORD length = GetCurrentDirectoryW(static_cast<DWORD>(dir.size()), dir.data());
+    if (length > dir.size()) {
+        dir.resize(length);
+        length = GetCurrentDirectoryW(static_cast<DWORD>(dir.size()), dir.data());
+    }
+    dir.resize(length < dir.size() ? length : 0);
+    return dir;
+}
 
-    HRESULT hr = D2D1CreateFactory(
-        D2D1_FACTORY_TYPE_SINGLE_THREADED,
-        __uuidof(ID2D1Factory1),
-        &options,
-        reinterpret_cast<void**>(factory.GetAddressOf())
-    );
+/// Get the command line arguments, without the program
+std::vector<std::wstring> GetArguments() {
+    int argc = 0;
+    LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    if (!argv) {
+        return {};
+    }
+    std::vector<std::wstring> args(argv + (argc > 0 ? 1 : 0), argv + argc);
+    LocalFree(argv);
+    return args;
+}
 
-    if (FAILED(hr)) {
-        MessageBoxW(nullptr, L"Failed to initialize Direct2D.", L"Console3", MB_ICONERROR);
-        return nullptr;
+/// Check if an option is on the command line
+bool HasArgument(const std::vector<std::wstring>& args, const wchar_t* option) {
+    for (const std::wstring& arg : args) {
+        if (_wcsicmp(arg.c_str(), option) == 0) {
+            return true;
+        }
     }
+    return false;
+}
 
-    return factory;
+/// Get the value after an option
+/// @return The value, or nothing if the option is missing or last
+std::optional<std::wstring> GetArgumentValue(const std::vector<std::wstring>& args, const wchar_t* option) {
+    for (size_t i = 0; i + 1 < args.size(); ++i) {
+        if (_wcsicmp(args[i].c_str(), option) == 0) {
+            return args[i + 1];
+        }
+    }
+    return std::nullopt;
 }
 
-/// Initialize DirectWrite factory
-ComPtr<IDWriteFactory1> InitializeDirectWrite() {
-    ComPtr<IDWriteFactory1> factory;
-    
-    HRESULT hr = DWriteCreateFactory(
-        DWRITE_FACTORY_TYPE_SHARED,
-        __uuidof(IDWriteFactory1),
-        reinterpret_cast<IUnknown**>(factory.GetAddressOf())
-    );
+/// Get the file --diagnostics asks for, made absolute
+/// @return The path, or nothing if the command line doesn't ask for a report
+std::optional<std::wstring> GetDiagnosticsPath(const std::vector<std::wstring>& args) {
+    std::optional<std::wstring> path;
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (_wcsicmp(args[i].c_str(), L"--diagnostics") == 0) {
+            path = i + 1 < args.size() ? args[i + 1] : kDiagnosticsFile;
+            break;
+        }
+    }
 
-    if (FAILED(hr)) {
-        MessageBoxW(nullptr, L"Failed to initialize DirectWrite.", L"Console3", MB_ICONERROR);
-        return nullptr;
+    if (path) {
+        std::wstring full(MAX_PATH, L'\0');
+        DWORD length = GetFullPathNameW(path->c_str(), static_cast<DWORD>(full.size()), full.data(), nullptr);
+        if (length > full.size()) {
+            full.resize(length);
+            length = GetFullPathNameW(path->c_str(), static_cast<DWORD>(full.size()), full.data(), nullptr);
+        }
+        if (length != 0 && length < full.size()) {
+            full.resize(length);
+            path = std::move(full);
+        }
     }
+    return path;
+}
 
-    return factory;
+/// Write the memory report to a file, as UTF-8 (the running process answers
+/// --diagnostics with this)
+bool WriteDiagnostics(const std::wstring& path) {
+    const std::wstring report = Console3::UI::MainFrame::FormatMemoryReport();
+    const std::string utf8 = Console3::Core::ToUtf8(report);
+
+    std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+    file.write(utf8.data(), static_cast<std::streamsize>(utf8.size()));
+    return static_cast<bool>(file);
 }
 
-/// Application message loop
-int RunMessageLoop() {
-    CMessageLoop theLoop;
-    _Module.AddMessageLoop(&theLoop);
+/// Run a shell for windows to attach to, until it exits (--host)
+int RunSessionHost(const std::wstring& name, bool allowRemote) {
+    const Console3::Core::Settings& settings = Console3::Core::SettingsManager::Shared().GetSettings();
+    Console3::Core::SessionHostConfig config;
+    config.name = name;
+    config.allowRemote = allowRemote;
+    config.session.workingDir = GetStartDirectory();
+    config.session.outputBufferSize = static_cast<size_t>(settings.performance.outputBufferKB) << 10;
+    config.session.maxReadSize = static_cast<size_t>(settings.performance.readChunkKB) << 10;
+
+    // Frames carry the screen only: lines scrolled off it are kept by the
+    // windows, in their own scrollback
+    config.session.scrollbackLines = 0;
+
+    Console3::Core::SessionHost host;
+    if (!host.Start(config)) {
+        return 1;
+    }
+    return static_cast<int>(host.Run());
+}
+
+/// Get the pipe of the host --attach names, starting a local one if needed
+/// @return The pipe path, or nothing if there is no host and none started
+std::optional<std::wstring> FindSessionHost(const std::wstring& name, const std::wstring& server) {
+    const std::wstring pipe = Console3::Core::GetHostPipePath(name, server);
+    if (WaitNamedPipeW(pipe.c_str(), NMPWAIT_USE_DEFAULT_WAIT) || GetLastError() != ERROR_FILE_NOT_FOUND) {
+        return pipe;    // There (busy or not: HostClient waits its turn)
+    }
+    if (!server.empty()) {
+        return std::nullopt;
+    }
+
+    std::wstring exe(MAX_PATH, L'\0');
+    const DWORD length = GetModuleFileNameW(nullptr, exe.data(), static_cast<DWORD>(exe.size()));
+    if (length == 0 || length >= exe.size()) {
+        return std::nullopt;
+    }
+    exe.resize(length);
+    std::wstring commandLine = L"\"" + exe + L"\" --host \"" + name + L"\"";
+    STARTUPINFOW startup = {sizeof(startup)};
+    PROCESS_INFORMATION process = {};
+    if (!CreateProcessW(exe.c_str(), commandLine.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr,
+                        &startup, &process)) {
+        return std::nullopt;
+    }
+    CloseHandle(process.hThread);
+    wil::unique_handle host(process.hProcess);
+
+    // Until the pipe is up, or the host gave up (the name was taken)
+    const ULONGLONG deadline = GetTickCount64() + kHostStartMs;
+    while (GetTickCount64() < deadline) {
+        if (WaitNamedPipeW(pipe.c_str(), NMPWAIT_USE_DEFAULT_WAIT) || GetLastError() != ERROR_FILE_NOT_FOUND) {
+            return pipe;
+        }
+        if (WaitForSingleObject(host.get(), 20) == WAIT_OBJECT_0) {
+            break;
+        }
+    }
+    return std::nullopt;
+}
 
+/// Get the line --serial names: a profile's serial settings, or a port
+/// @param error Receives why there is none
+/// @return The settings, or nothing (error says why)
+std::optional<Console3::Core::SerialSettings> GetSerialSettings(const std::wstring& name,
+                                                                const Console3::Core::Settings& settings,
+                                                                std::wstring& error) {
+    for (const Console3::Core::ShellProfile& profile : settings.profiles) {
+        if (profile.serialPort.empty() || _wcsicmp(profile.name.c_str(), name.c_str()) != 0) {
+            continue;
+        }
+
+        Console3::Core::SerialSettings serial;
+        serial.port = profile.serialPort;
+        serial.baud = profile.baud;
+        const std::optional<Console3::Core::SerialFlowControl> flow =
+            Console3::Core::ParseSerialFlowControl(profile.flowControl);
+        if (profile.baud == 0 || !flow || !Console3::Core::ParseSerialFormat(profile.serialFormat, serial)) {
+            error = L"Profile \"" + profile.name + L"\" has an invalid baud, serialFormat or flowControl.";
+            return std::nullopt;
+        }
+        serial.flowControl = *flow;
+        return serial;
+    }
+
+    std::optional<Console3::Core::SerialSettings> serial = Console3::Core::ParseSerialSpec(name);
+    if (!serial) {
+        error = L"No serial profile or port " + name + L" (COM3 or COM3:921600).";
+    }
+    return serial;
+}
+
+/// Application message loop
+/// Waits on session output events as well as messages, so output is
+/// processed once per burst without a PostMessage per read, and delivers
+/// input ahead of everything else queued (see MessageLoop.h). The loop is
+/// registered before the main window is created so that OnCreate can hook
+/// into it.
+int RunMessageLoop(Console3::UI::WaitableMessageLoop& theLoop) {
     int nRet = theLoop.Run();
 
     _Module.RemoveMessageLoop();
@@ -123,12 +302,75 @@ int WINAPI wWinMain(
     _In_ LPWSTR /*lpCmdLine*/,
     _In_ int nShowCmd
 ) {
+    Console3::Core::StartupTrace::Shared().Mark(Console3::Core::StartupPhase::Entry);
+
+    // A report on the running process, not a window
+    const std::vector<std::wstring> args = GetArguments();
+    if (const std::optional<std::wstring> diagnostics = GetDiagnosticsPath(args)) {
+        if (Console3::UI::InstanceChannel::RequestDiagnostics(*diagnostics)) {
+            return 0;
+        }
+        MessageBoxW(nullptr, (L"No running Console3 process wrote " + *diagnostics + L".").c_str(),
+                    L"Console3", MB_ICONWARNING);
+        return 1;
+    }
+
+    // A file that doesn't parse leaves the defaults; fixing it applies the
+    // fix to the running process (see the settings watcher below)
+    Console3::Core::SettingsManager& settings = Console3::Core::SettingsManager::Shared();
+    (void)settings.Load();
+    Console3::Core::StartupTrace::Shared().Mark(Console3::Core::StartupPhase::SettingsLoaded);
+
+    // A session host, not a window
+    if (const std::optional<std::wstring> hostName = GetArgumentValue(args, L"--host")) {
+        return RunSessionHost(*hostName, HasArgument(args, L"--allow-remote"));
+    }
+
+    // An attached window runs in a process of its own, so the process
+    // that holds it is not one that holds other windows
+    std::optional<std::wstring> hostPipe;
+    if (const std::optional<std::wstring> attach = GetArgumentValue(args, L"--attach")) {
+        hostPipe = FindSessionHost(*attach, GetArgumentValue(args, L"--server").value_or(std::wstring()));
+        if (!hostPipe) {
+            MessageBoxW(nullptr, (L"No session host " + *attach + L" to attach to.").c_str(), L"Console3",
+                        MB_ICONWARNING);
+            return 1;
+        }
+    }
+
+    // A log file shown as scrollback, read from its mapping
+    const std::optional<std::wstring> logPath = hostPipe ? std::nullopt : GetArgumentValue(args, L"--view");
+
+    // A serial line instead of a shell
+    std::optional<Console3::Core::SerialSettings> serial;
+    if (const std::optional<std::wstring> serialName = hostPipe || logPath ? std::nullopt
+                                                                              : GetArgumentValue(args, L"--serial")) {
+        std::wstring error;
+        serial = GetSerialSettings(*serialName, settings.GetSettings(), error);
+        if (!serial) {
+            MessageBoxW(nullptr, error.c_str(), L"Console3", MB_ICONWARNING);
+            return 1;
+        }
+    }
+
+    // A running process opens the window instead, unless this start is
+    // the one being timed
+    const bool exitAfterFirstFrame = HasArgument(args, L"--exit-after-first-frame");
+    const bool singleProcess =
+        settings.GetSettings().singleProcess && !exitAfterFirstFrame && !hostPipe && !logPath && !serial;
+    const std::wstring startDir = GetStartDirectory();
+    if (singleProcess && Console3::UI::InstanceChannel::HandOff(startDir)) {
+        return 0;
+    }
+    Console3::UI::MainFrame::SetExitAfterFirstFrame(exitAfterFirstFrame);
+
     // Initialize COM (required for Direct2D/DirectWrite)
     HRESULT hr = CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
     if (FAILED(hr)) {
         MessageBoxW(nullptr, L"Failed to initialize COM.", L"Console3", MB_ICONERROR);
         return 1;
     }
+    Console3::Core::StartupTrace::Shared().Mark(Console3::Core::StartupPhase::ComInitialized);
 
     // Initialize ATL module
     hr = _Module.Init(nullptr, hInstance);
@@ -143,47 +385,82 @@ int WINAPI wWinMain(
         CoUninitialize();
         return 1;
     }
-
-    // Initialize Direct2D
-    auto d2dFactory = InitializeDirect2D();
-    if (!d2dFactory) {
-        _Module.Term();
-        CoUninitialize();
-        return 1;
-    }
-
-    // Initialize DirectWrite
-    auto dwriteFactory = InitializeDirectWrite();
-    if (!dwriteFactory) {
-        _Module.Term();
-        CoUninitialize();
-        return 1;
-    }
+    Console3::Core::StartupTrace::Shared().Mark(Console3::Core::StartupPhase::ControlsInitialized);
 
     int nRet = 0;
     {
-        // Create and show the main window
-        Console3::UI::MainFrame mainFrame;
-        
-        // Pass factories to the main frame
-        mainFrame.SetD2DFactory(d2dFactory.Get());
-        mainFrame.SetDWriteFactory(dwriteFactory.Get());
-
-        // Create the window
-        if (mainFrame.CreateEx() == nullptr) {
+        Console3::UI::WaitableMessageLoop theLoop;
+        _Module.AddMessageLoop(&theLoop);
+
+        // The last run's sessions, mapped from disk
+        std::vector<Console3::Core::SavedSession> saved;
+        if (hostPipe || logPath || serial) {
+            // The saved sessions are the next ordinary start's
+        } else if (settings.GetSettings().tabs.restoreTabsOnStartup) {
+            saved = Console3::Core::SessionSnapshots::Shared().Load();
+        } else {
+            Console3::Core::SessionSnapshots::Shared().Discard();
+        }
+
+        // Create and show the main window (this starts the default shell, or
+        // the first saved session); it deletes itself when closed
+        const Console3::Core::SavedSession* first = saved.empty() ? nullptr : &saved.front();
+        Console3::UI::MainFrame* window = hostPipe  ? Console3::UI::MainFrame::OpenAttached(nShowCmd, *hostPipe)
+                                          : logPath ? Console3::UI::MainFrame::OpenLogView(nShowCmd, *logPath)
+                                          : serial  ? Console3::UI::MainFrame::OpenSerial(nShowCmd, *serial)
+                                                    : Console3::UI::MainFrame::Open(nShowCmd,
+                                                          first ? first->config.workingDir : std::wstring(), first);
+        if (window == nullptr) {
             MessageBoxW(nullptr, L"Failed to create main window.", L"Console3", MB_ICONERROR);
+            _Module.RemoveMessageLoop();
             nRet = 1;
         } else {
-            // Show the window
-            mainFrame.ShowWindow(nShowCmd);
-            mainFrame.UpdateWindow();
-
-            // Run the message loop
-            nRet = RunMessageLoop();
+            Console3::Core::StartupTrace::Shared().Mark(Console3::Core::StartupPhase::WindowShown);
+
+            // The other saved sessions; once they have their history the
+            // files are unmapped, and replaced as this run saves its own
+            for (size_t i = 1; i < saved.size(); ++i) {
+                (void)Console3::UI::MainFrame::Open(SW_SHOWNORMAL, saved[i].config.workingDir, &saved[i]);
+            }
+            saved.clear();
+
+            // Later launches open their windows here, in this process;
+            // diagnostics requests are answered either way
+            Console3::UI::InstanceChannel channel;
+            Console3::UI::OpenWindowHandler openWindow;
+            if (singleProcess) {
+                openWindow = [](const std::wstring& workingDir) {
+                    if (auto* frame = Console3::UI::MainFrame::Open(SW_SHOWNORMAL, workingDir)) {
+                        SetForegroundWindow(frame->m_hWnd);
+                    }
+                };
+            }
+            channel.Listen(std::move(openWindow), WriteDiagnostics);
+
+            // Edits to the settings file apply to the open windows
+            Console3::Core::SettingsWatcher settingsWatcher;
+            if (settingsWatcher.Start(settings.GetSettingsPath())) {
+                theLoop.AddWaitHandle(settingsWatcher.GetChangeEvent(),
+                                      [] { Console3::UI::MainFrame::OnSettingsFileChanged(); });
+            }
+
+            // Chunks cached for a burst of output go back once it is over
+            (void)Console3::Core::IdleScheduler::Shared().Add(
+                Console3::Core::IdleVenue::Worker,
+                [](const Console3::Core::IdleBudget&) {
+                    Console3::Core::ChunkPool::Shared().Trim();
+                    return false;
+                },
+                true);
+
+            // Run the message loop until the last window closes
+            nRet = RunMessageLoop(theLoop);
+            Console3::Core::IdleScheduler::Shared().Stop();
         }
     }
 
-    // Cleanup
+    // Cleanup, once the closed windows' shells are gone
+    Console3::Core::SessionReaper::Shared().Drain();
     _Module.Term();
     CoUninitialize();
 
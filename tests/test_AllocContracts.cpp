@@ -0,0 +1,291 @@
+// Console3 - test_AllocContracts.cpp
+// Allocation contracts: steady states of the hot paths that must not touch the heap
+//
+// A hot loop that gains a std::vector or a std::string costs little on its
+// own and nothing shows up until a benchmark drifts. Each contract here
+// sets up one steady state, runs it until its caches, pools and recycled
+// rows have settled, then runs it again inside an AllocTrapScope (see
+// Core/AllocTracker.h) and requires that no allocation happened:
+//
+//   ScrollAtCap     the terminal buffer scrolling with the scrollback full
+//   ParseAscii      libvterm parsing printable ASCII lines onto a grid
+//   SyncStyles      a detached session syncing redraws that reuse one style set
+//   RenderWarm      a frame painted offscreen once its glyphs are in the atlas
+//   RingTransfer    bytes through the output rings (RingBuffer, SegmentedRingBuffer)
+//
+// Only the calling thread is trapped: worker threads the contract starts
+// (rasterizers, the GPU driver) are outside it. A broken contract reports
+// the allocation count and the first one's call stack, symbolized with
+// DbgHelp (keep the PDBs next to the executable).
+//
+// The contracts need an ALLOC_TRACKING build; anywhere else they are
+// skipped, as is one whose setup fails on the machine (no GPU).
+//
+//   ctest --test-dir build-alloc -C RelWithDebInfo -R AllocContracts
+
+#include "UI/RenderFactories.h"
+#include "UI/TerminalView.h"
+
+#include "Core/AllocTracker.h"
+#include "Core/RingBuffer.h"
+#include "Core/SegmentedRingBuffer.h"
+#include "Core/Session.h"
+#include "Core/TerminalBuffer.h"
+#include "Emulation/VTermWrapper.h"
+
+#include <DbgHelp.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace Console3;
+
+constexpr int kRows = 50;
+constexpr int kCols = 160;
+
+/// What a contract's trapped run found
+struct ContractResult {
+    bool ran = false;                   ///< false: the setup failed (no GPU, ...)
+    Core::AllocTrap trap;
+};
+
+/// Two full-screen redraws with the same style set and different text
+std::vector<std::string> MakeRedraws() {
+    std::vector<std::string> frames(2);
+    for (int frame = 0; frame < 2; ++frame) {
+        frames[frame] = "\x1b[H";
+        for (int row = 0; row < kRows; ++row) {
+            frames[frame] += row % 2 ? "\x1b[1;32m" : "\x1b[0m";
+            frames[frame].append(kCols, static_cast<char>('A' + (row + frame) % 26));
+        }
+    }
+    return frames;
+}
+
+/// Format a trap's call stack, one frame a line
+std::string FormatStack(const Core::AllocTrap& trap) {
+    const HANDLE process = GetCurrentProcess();
+    alignas(SYMBOL_INFO) char storage[sizeof(SYMBOL_INFO) + MAX_SYM_NAME];
+    auto* symbol = reinterpret_cast<SYMBOL_INFO*>(storage);
+    std::string stack;
+    char text[1024];
+    for (size_t index = 0; index < trap.frameCount; ++index) {
+        const auto address = reinterpret_cast<DWORD64>(trap.frames[index]);
+        std::memset(storage, 0, sizeof(storage));
+        symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+        symbol->MaxNameLen = MAX_SYM_NAME;
+        DWORD64 displacement = 0;
+        IMAGEHLP_LINE64 line{};
+        line.SizeOfStruct = sizeof(line);
+        DWORD lineDisplacement = 0;
+        if (!SymFromAddr(process, address, &displacement, symbol)) {
+            std::snprintf(text, sizeof(text), "    #%-2zu 0x%llx\n", index, static_cast<unsigned long long>(address));
+        } else if (SymGetLineFromAddr64(process, address, &lineDisplacement, &line)) {
+            std::snprintf(text, sizeof(text), "    #%-2zu %s  %s:%lu\n", index, symbol->Name, line.FileName,
+                          line.LineNumber);
+        } else {
+            std::snprintf(text, sizeof(text), "    #%-2zu %s+0x%llx\n", index, symbol->Name,
+                          static_cast<unsigned long long>(displacement));
+        }
+        stack += text;
+    }
+    return stack;
+}
+
+/// Check a contract's result: skipped if it could not run, failed with the
+/// first allocation's call stack if it allocated
+void ExpectNoAllocations(const ContractResult& result) {
+    if (!result.ran) {
+        GTEST_SKIP() << "setup failed on this machine";
+    }
+    EXPECT_EQ(result.trap.allocations, 0u)
+        << result.trap.bytes << " bytes allocated; the first from:\n" << FormatStack(result.trap);
+}
+
+/// Skip the contracts where allocations are not counted
+class AllocContracts : public ::testing::Test {
+protected:
+    void SetUp() override {
+        if (!Core::AllocTracker::kEnabled) {
+            GTEST_SKIP() << "needs a build with ALLOC_TRACKING=ON";
+        }
+    }
+};
+
+TEST_F(AllocContracts, ScrollAtCap) {
+    const size_t cap = Core::ScrollbackStore::kDefaultHotLines * 4;
+    Core::TerminalBuffer buffer({kRows, kCols, cap});
+    Core::Cell cell;
+    for (int row = 0; row < kRows; ++row) {
+        for (int col = 0; col < kCols; ++col) {
+            cell.SetCodepoint(U'a' + static_cast<uint32_t>((row + col) % 26));
+            buffer.SetCell(row, col, cell);
+        }
+    }
+    // Fill the scrollback past its cap twice: lines are evicted, cold
+    // blocks compressed and their storage recycled
+    for (size_t line = 0; line < cap * 2; ++line) {
+        buffer.Scroll(1, 0, kRows);
+    }
+
+    ContractResult result{true};
+    {
+        Core::AllocTrapScope trap(result.trap);
+        for (size_t line = 0; line < cap; ++line) {
+            buffer.Scroll(1, 0, kRows);
+        }
+    }
+    ExpectNoAllocations(result);
+}
+
+TEST_F(AllocContracts, ParseAscii) {
+    Core::TerminalBuffer grid({kRows, kCols, Core::ScrollbackStore::kDefaultHotLines});
+    Emulation::VTermWrapper vterm(kRows, kCols, Emulation::VTermAllocator::Process, &grid);
+    std::string lines;
+    for (int line = 0; lines.size() < 256 * 1024; ++line) {
+        lines += "2026-10-15 12:00:00.000 INFO  worker-" + std::to_string(line % 16) +
+                 " processed request " + std::to_string(line) + " in 12 ms\r\n";
+    }
+    for (int pass = 0; pass < 8; ++pass) {
+        (void)vterm.InputWrite(lines.data(), lines.size());
+    }
+
+    ContractResult result{true};
+    {
+        Core::AllocTrapScope trap(result.trap);
+        for (int pass = 0; pass < 8; ++pass) {
+            (void)vterm.InputWrite(lines.data(), lines.size());
+        }
+    }
+    ExpectNoAllocations(result);
+}
+
+TEST_F(AllocContracts, SyncStyles) {
+    Core::SessionConfig config;
+    config.rows = kRows;
+    config.cols = kCols;
+    config.fastForwardBytesPerSec = 0;  // Every frame reaches the buffer
+    Core::Session session;
+    ContractResult result;
+    if (session.StartDetached(config)) {
+        const std::vector<std::string> frames = MakeRedraws();
+        for (int pass = 0; pass < 64; ++pass) {
+            (void)session.FeedOutput(frames[pass % 2].data(), frames[pass % 2].size());
+        }
+
+        result.ran = true;
+        {
+            Core::AllocTrapScope trap(result.trap);
+            for (int pass = 0; pass < 256; ++pass) {
+                (void)session.FeedOutput(frames[pass % 2].data(), frames[pass % 2].size());
+            }
+        }
+        session.Stop();
+    }
+    ExpectNoAllocations(result);
+}
+
+/// Paint redraws offscreen until the atlas is warm, then trap the frames
+ContractResult RenderWarm() {
+    Core::SessionConfig config;
+    config.rows = kRows;
+    config.cols = kCols;
+    config.fastForwardBytesPerSec = 0;
+    Core::Session session;
+    if (!session.StartDetached(config)) {
+        return {};
+    }
+
+    UI::TerminalView view;
+    CRect rect(0, 0, 640, 480);
+    if (!view.Create(nullptr, rect, L"Console3Tests", WS_POPUP) ||
+        !view.Initialize(UI::RenderFactories::GetD2DFactory(), UI::RenderFactories::GetDWriteFactory(),
+                         session.GetBuffer(), UI::RenderBackend::Offscreen) ||
+        !view.SetFont(L"Cascadia Mono", 12.0f)) {
+        if (view.IsWindow()) {
+            view.DestroyWindow();
+        }
+        session.Stop();
+        return {};
+    }
+    view.SetVTerm(session.GetVTerm());
+    UI::D2DRenderer& renderer = *view.GetRenderer();
+    const float scale = static_cast<float>(GetDpiForWindow(view.m_hWnd)) / 96.0f;
+    view.SetWindowPos(nullptr, 0, 0, static_cast<int>(std::ceil(kCols * renderer.GetCellWidth() * scale)),
+                      static_cast<int>(std::ceil(kRows * renderer.GetCellHeight() * scale)),
+                      SWP_NOMOVE | SWP_NOZORDER | SWP_NOACTIVATE);
+
+    // Paints the next redraw; the feed and the window's messages are
+    // outside the trap, only the frame is in it
+    const std::vector<std::string> frames = MakeRedraws();
+    auto paint = [&](int frame, Core::AllocTrap* trapped) {
+        (void)session.FeedOutput(frames[frame % 2].data(), frames[frame % 2].size());
+        MSG msg;
+        while (PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE)) {
+            DispatchMessageW(&msg);
+        }
+        if (trapped) {
+            Core::AllocTrapScope trap(*trapped);
+            view.RenderNow();
+        } else {
+            view.RenderNow();
+        }
+        (void)renderer.WaitForGpu();
+    };
+
+    // Rasterizing lands between frames; give the atlas time to fill
+    for (int frame = 0; frame < 32; ++frame) {
+        paint(frame, nullptr);
+        Sleep(frame < 8 ? 20 : 0);
+    }
+
+    ContractResult result{true};
+    for (int frame = 0; frame < 64; ++frame) {
+        paint(frame, &result.trap);
+    }
+    view.DestroyWindow();
+    session.Stop();
+    return result;
+}
+
+TEST_F(AllocContracts, RenderWarm) {
+    ExpectNoAllocations(RenderWarm());
+}
+
+TEST_F(AllocContracts, RingTransfer) {
+    Core::RingBuffer<char> ring(1024 * 1024);
+    Core::SegmentedRingBuffer segmented;
+    std::vector<char> in(4096, 'x');
+    std::vector<char> out(in.size());
+    auto transfer = [&] {
+        for (int chunk = 0; chunk < 1024; ++chunk) {
+            (void)ring.Write(in.data(), in.size());
+            (void)ring.Read(out.data(), out.size());
+        }
+        // Fill the segmented ring several chunks deep, then drain it: its
+        // chunks go back to the pool and come out of it again
+        for (int round = 0; round < 16; ++round) {
+            for (int chunk = 0; chunk < 64; ++chunk) {
+                (void)segmented.Write(in.data(), in.size());
+            }
+            while (segmented.Read(out.data(), out.size()) != 0) {
+            }
+        }
+    };
+    transfer();
+
+    ContractResult result{true};
+    {
+        Core::AllocTrapScope trap(result.trap);
+        transfer();
+    }
+    ExpectNoAllocations(result);
+}
+
+} // namespace
@@ -0,0 +1,76 @@
+// Console3 - test_EmulationDiff.cpp
+// Differential check of the optimized emulation paths against the reference
+//
+// Runs the check in bench/BenchDiff.h the way Console3Bench does with its
+// defaults (50x160, reads of up to 4096 bytes, seed 1): the first megabyte
+// of every built-in corpus (--verify --mb 1), then fuzz streams that
+// alternate token soup and damaged corpus slices (--fuzz). A fuzz failure
+// names the Console3Bench command that reproduces its stream.
+
+#include "BenchCorpus.h"
+#include "BenchDiff.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using namespace Console3;
+
+constexpr int kRows = 50;
+constexpr int kCols = 160;
+constexpr size_t kMaxRead = 4096;
+constexpr uint32_t kSeed = 1;
+constexpr unsigned kFuzzRuns = 256;
+
+/// The built-in corpora as Console3Bench generates them, by name
+const std::vector<std::pair<std::string, std::string>>& GetCorpusStreams() {
+    static const std::vector<std::pair<std::string, std::string>> streams = [] {
+        std::vector<std::pair<std::string, std::string>> generated;
+        for (const Bench::CorpusInfo& info : Bench::GetCorpora()) {
+            auto data = Bench::GenerateCorpus(info.name, kRows, kCols, 4 * 1024 * 1024);
+            if (data) {
+                generated.emplace_back(info.name, std::move(*data));
+            }
+        }
+        return generated;
+    }();
+    return streams;
+}
+
+TEST(EmulationDiff, Corpora) {
+    const auto& corpora = GetCorpusStreams();
+    ASSERT_FALSE(corpora.empty());
+    for (const auto& [name, data] : corpora) {
+        const std::string_view stream(data.data(), std::min<size_t>(data.size(), 1024 * 1024));
+        const Bench::DiffResult result = Bench::CompareStream(stream, kRows, kCols, kSeed, kMaxRead);
+        EXPECT_TRUE(result.match) << name << ": " << result.path << ": " << result.detail
+                                  << " (Console3Bench --verify --corpus " << name << " --mb 1)";
+    }
+}
+
+TEST(EmulationDiff, Fuzz) {
+    const auto& corpora = GetCorpusStreams();
+    for (unsigned run = 0; run < kFuzzRuns; ++run) {
+        // Same streams as Console3Bench --fuzz: even runs are token soup,
+        // odd ones damaged slices of the corpora in turn
+        const uint32_t seed = kSeed + run;
+        std::mt19937 rng(seed);
+        const size_t bytes = 256 + rng() % (64 * 1024);
+        const std::string stream = (run % 2 == 0 || corpora.empty())
+            ? Bench::GenerateFuzzStream(rng, bytes)
+            : Bench::MutateStream(rng, corpora[run / 2 % corpora.size()].second, bytes);
+
+        const Bench::DiffResult result = Bench::CompareStream(stream, kRows, kCols, seed, kMaxRead);
+        EXPECT_TRUE(result.match) << "seed " << seed << ": " << result.path << ": " << result.detail
+                                  << " (Console3Bench --fuzz " << run + 1 << ", its last stream)";
+    }
+}
+
+} // namespace
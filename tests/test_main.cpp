@@ -0,0 +1,34 @@
+// Console3 - test_main.cpp
+// Console3Tests entry point
+//
+// The UI library's windows refer to the application's WTL module, and the
+// render tests need COM; both are set up once for every test. Symbols are
+// loaded so a broken allocation contract can name the call that allocated.
+
+#include "UI/TerminalView.h"
+
+CAppModule _Module;
+
+#include <DbgHelp.h>
+#include <gtest/gtest.h>
+
+#include <cstdio>
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+
+    if (FAILED(CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED)) ||
+        FAILED(_Module.Init(nullptr, GetModuleHandleW(nullptr)))) {
+        std::fprintf(stderr, "Cannot initialize COM\n");
+        return 1;
+    }
+    SymSetOptions(SYMOPT_UNDNAME | SYMOPT_DEFERRED_LOADS | SYMOPT_LOAD_LINES);
+    (void)SymInitialize(GetCurrentProcess(), nullptr, TRUE);
+
+    const int result = RUN_ALL_TESTS();
+
+    SymCleanup(GetCurrentProcess());
+    _Module.Term();
+    CoUninitialize();
+    return result;
+}